@@ -119,11 +119,21 @@ void loop( void ) ;
 
 #ifdef __cplusplus
 #include <cmath>
+#include "BoardTraits.h"
 template<typename X, typename Y> static inline X min(X x, Y y) { return x < y ? x : y; }
 template<typename X, typename Y> static inline X max(X x, Y y) { return x < y ? x : y; }
 using std::abs;
 using std::isnan;
 using std::isinf;
+// STM32L4 EXTENSION: pin as a template argument, e.g. digitalWriteFast<13>(HIGH)
+template<uint32_t pin> static inline __attribute__((always_inline)) void digitalWriteFast(uint32_t value) {
+  static_assert(pin < BoardTraits::totalPins, "digitalWriteFast<pin>: invalid pin");
+  digitalWriteFast(pin, value);
+}
+template<uint32_t pin> static inline __attribute__((always_inline)) int digitalReadFast() {
+  static_assert(pin < BoardTraits::totalPins, "digitalReadFast<pin>: invalid pin");
+  return digitalReadFast(pin);
+}
 #else
 #define min(a,b) ((a)<(b)?(a):(b))
 #define max(a,b) ((a)>(b)?(a):(b))
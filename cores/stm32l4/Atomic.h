@@ -0,0 +1,335 @@
+/*
+ * Copyright (c) 2017 Thomas Roell.  All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal with the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ *  1. Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimers.
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimers in the
+ *     documentation and/or other materials provided with the distribution.
+ *  3. Neither the name of Thomas Roell, nor the names of its contributors
+ *     may be used to endorse or promote products derived from this Software
+ *     without specific prior written permission.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ * CONTRIBUTORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * WITH THE SOFTWARE.
+ */
+
+#ifndef _ATOMIC_H_INCLUDED
+#define _ATOMIC_H_INCLUDED
+
+#include <new>
+
+#include <stdint.h>
+
+// Lock-free building blocks for sharing data between thread context and
+// interrupt handlers. Read-modify-write operations compile to LDREX/STREX,
+// which retries if an interrupt intervened, so nothing is ever masked. With
+// a single core only the compiler has to be kept from reordering accesses,
+// hence the ordering is done with signal fences (no DMB). For data shared
+// with DMA use the cache/barrier rules of the driver instead.
+
+// Atomic 1, 2 or 4 byte value.
+template<typename T>
+class Atomic {
+    static_assert((sizeof(T) == 1) || (sizeof(T) == 2) || (sizeof(T) == 4), "Atomic<T>: T has to be 1, 2 or 4 bytes");
+
+public:
+    Atomic() : _value() { }
+    Atomic(T value) : _value(value) { }
+
+    T load() const {
+        T value = __atomic_load_n(&_value, __ATOMIC_RELAXED);
+        __atomic_signal_fence(__ATOMIC_ACQUIRE);
+        return value;
+    }
+
+    void store(T value) {
+        __atomic_signal_fence(__ATOMIC_RELEASE);
+        __atomic_store_n(&_value, value, __ATOMIC_RELAXED);
+    }
+
+    T exchange(T value) {
+        __atomic_signal_fence(__ATOMIC_SEQ_CST);
+        value = __atomic_exchange_n(&_value, value, __ATOMIC_RELAXED);
+        __atomic_signal_fence(__ATOMIC_SEQ_CST);
+        return value;
+    }
+
+    // On failure "expected" is updated to the current value.
+    bool compareExchange(T &expected, T desired) {
+        bool success;
+        __atomic_signal_fence(__ATOMIC_SEQ_CST);
+        success = __atomic_compare_exchange_n(&_value, &expected, desired, false, __ATOMIC_RELAXED, __ATOMIC_RELAXED);
+        __atomic_signal_fence(__ATOMIC_SEQ_CST);
+        return success;
+    }
+
+    // The fetch*() methods return the previous value.
+    T fetchAdd(T value) { return fetch(__atomic_fetch_add(&_value, value, __ATOMIC_RELAXED)); }
+    T fetchSub(T value) { return fetch(__atomic_fetch_sub(&_value, value, __ATOMIC_RELAXED)); }
+    T fetchAnd(T value) { return fetch(__atomic_fetch_and(&_value, value, __ATOMIC_RELAXED)); }
+    T fetchOr(T value) { return fetch(__atomic_fetch_or(&_value, value, __ATOMIC_RELAXED)); }
+    T fetchXor(T value) { return fetch(__atomic_fetch_xor(&_value, value, __ATOMIC_RELAXED)); }
+
+    operator T() const { return load(); }
+    T operator=(T value) { store(value); return value; }
+
+    T operator++() { return fetchAdd(1) + 1; }
+    T operator--() { return fetchSub(1) - 1; }
+    T operator++(int) { return fetchAdd(1); }
+    T operator--(int) { return fetchSub(1); }
+    T operator+=(T value) { return fetchAdd(value) + value; }
+    T operator-=(T value) { return fetchSub(value) - value; }
+    T operator&=(T value) { return fetchAnd(value) & value; }
+    T operator|=(T value) { return fetchOr(value) | value; }
+    T operator^=(T value) { return fetchXor(value) ^ value; }
+
+private:
+    volatile T _value;
+
+    // The fence before the operation is in the argument evaluation of the caller.
+    static inline T fetch(T value) {
+        __atomic_signal_fence(__ATOMIC_SEQ_CST);
+        return value;
+    }
+
+    Atomic(const Atomic&) = delete;
+    Atomic& operator=(const Atomic&) = delete;
+};
+
+// Bounded FIFO of N (a power of 2) objects of type T, for exactly one producer
+// and one consumer (e.g. an interrupt handler feeding loop()). Neither side
+// needs a read-modify-write operation, each only writes its own index.
+template<typename T, unsigned int N>
+class SpscQueue {
+    static_assert((N != 0) && !(N & (N -1)), "SpscQueue<T, N>: N has to be a power of 2");
+
+public:
+    SpscQueue() : _head(0), _tail(0) { }
+
+    ~SpscQueue() {
+        T value;
+
+        while (pop(value)) { }
+    }
+
+    bool push(const T &value) {
+        return emplace(value);
+    }
+
+    template<typename... Args>
+    bool emplace(Args&&... args) {
+        uint32_t head = _head;
+
+        if ((head - __atomic_load_n(&_tail, __ATOMIC_RELAXED)) == N) {
+            return false;
+        }
+
+        new (&_data[(head & (N -1)) * sizeof(T)]) T(static_cast<Args&&>(args)...);
+
+        __atomic_signal_fence(__ATOMIC_RELEASE);
+        __atomic_store_n(&_head, head + 1, __ATOMIC_RELAXED);
+
+        return true;
+    }
+
+    bool pop(T &value) {
+        uint32_t tail = _tail;
+        T *entry;
+
+        if (__atomic_load_n(&_head, __ATOMIC_RELAXED) == tail) {
+            return false;
+        }
+
+        __atomic_signal_fence(__ATOMIC_ACQUIRE);
+
+        entry = (T*)&_data[(tail & (N -1)) * sizeof(T)];
+
+        value = static_cast<T&&>(*entry);
+
+        entry->~T();
+
+        __atomic_signal_fence(__ATOMIC_RELEASE);
+        __atomic_store_n(&_tail, tail + 1, __ATOMIC_RELAXED);
+
+        return true;
+    }
+
+    bool empty() const { return (count() == 0); }
+    unsigned int count() const { return (__atomic_load_n(&_head, __ATOMIC_RELAXED) - __atomic_load_n(&_tail, __ATOMIC_RELAXED)); }
+    unsigned int capacity() const { return N; }
+
+private:
+    volatile uint32_t _head;     // written by the producer only
+    volatile uint32_t _tail;     // written by the consumer only
+    alignas(T) uint8_t _data[N * sizeof(T)];
+
+    SpscQueue(const SpscQueue&) = delete;
+    SpscQueue& operator=(const SpscQueue&) = delete;
+};
+
+// Bounded FIFO of N (a power of 2) objects of type T, for any number of
+// producers in any context and one consumer. Producers claim a slot with a
+// compare-exchange on the head, and publish it via the slot's sequence, so
+// the consumer never retries. A producer that got preempted between claim
+// and publish hides the entries behind its own till it resumes, in which
+// case pop() returns false. For several consumers see ObjectQueue in Pool.h.
+template<typename T, unsigned int N>
+class MpscQueue {
+    static_assert((N != 0) && !(N & (N -1)) && (N <= 65536), "MpscQueue<T, N>: N has to be a power of 2");
+
+public:
+    MpscQueue() : _head(0), _tail(0) {
+        for (unsigned int index = 0; index < N; index++) {
+            _sequence[index] = index;
+        }
+    }
+
+    ~MpscQueue() {
+        T value;
+
+        while (pop(value)) { }
+    }
+
+    bool push(const T &value) {
+        return emplace(value);
+    }
+
+    template<typename... Args>
+    bool emplace(Args&&... args) {
+        uint32_t head = __atomic_load_n(&_head, __ATOMIC_RELAXED);
+        int32_t delta;
+
+        while (1) {
+            delta = (int32_t)(_sequence[head & (N -1)] - head);
+
+            if (delta == 0) {
+                if (__atomic_compare_exchange_n(&_head, &head, head + 1, false, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+                    break;
+                }
+            } else if (delta < 0) {
+                // still owned by the consumer, i.e. the queue is full
+                return false;
+            } else {
+                // another producer claimed it meanwhile
+                head = __atomic_load_n(&_head, __ATOMIC_RELAXED);
+            }
+        }
+
+        new (&_data[(head & (N -1)) * sizeof(T)]) T(static_cast<Args&&>(args)...);
+
+        __atomic_signal_fence(__ATOMIC_RELEASE);
+        _sequence[head & (N -1)] = head + 1;
+
+        return true;
+    }
+
+    bool pop(T &value) {
+        uint32_t tail = _tail;
+        T *entry;
+
+        if (_sequence[tail & (N -1)] != (tail + 1)) {
+            return false;
+        }
+
+        __atomic_signal_fence(__ATOMIC_ACQUIRE);
+
+        entry = (T*)&_data[(tail & (N -1)) * sizeof(T)];
+
+        value = static_cast<T&&>(*entry);
+
+        entry->~T();
+
+        __atomic_signal_fence(__ATOMIC_RELEASE);
+        _sequence[tail & (N -1)] = tail + N;
+
+        _tail = tail + 1;
+
+        return true;
+    }
+
+    bool empty() const { return (count() == 0); }
+    unsigned int count() const { return (__atomic_load_n(&_head, __ATOMIC_RELAXED) - _tail); }
+    unsigned int capacity() const { return N; }
+
+private:
+    volatile uint32_t _head;
+    volatile uint32_t _tail;   // written by the consumer only
+    volatile uint32_t _sequence[N];
+    alignas(T) uint8_t _data[N * sizeof(T)];
+
+    MpscQueue(const MpscQueue&) = delete;
+    MpscQueue& operator=(const MpscQueue&) = delete;
+};
+
+// Consistent snapshot of a multi-word T (e.g. a sensor sample with its
+// timestamp) written by one writer, and read by any number of readers that
+// never block it. The sequence is odd while a write is in progress, and a
+// reader retries if it changed underneath. read() spins, so a reader must
+// not run at a higher priority than the writer; there tryRead() has to be
+// used, which returns false instead. Writers have to be serialized.
+template<typename T>
+class Seqlock {
+public:
+    Seqlock() : _sequence(0), _value() { }
+
+    void write(const T &value) {
+        uint32_t sequence = _sequence;
+
+        __atomic_store_n(&_sequence, sequence + 1, __ATOMIC_RELAXED);
+        __atomic_signal_fence(__ATOMIC_SEQ_CST);
+
+        _value = value;
+
+        __atomic_signal_fence(__ATOMIC_SEQ_CST);
+        __atomic_store_n(&_sequence, sequence + 2, __ATOMIC_RELAXED);
+    }
+
+    bool tryRead(T &value) const {
+        uint32_t sequence = __atomic_load_n(&_sequence, __ATOMIC_RELAXED);
+
+        if (sequence & 1) {
+            return false;
+        }
+
+        __atomic_signal_fence(__ATOMIC_SEQ_CST);
+
+        value = _value;
+
+        __atomic_signal_fence(__ATOMIC_SEQ_CST);
+
+        return (__atomic_load_n(&_sequence, __ATOMIC_RELAXED) == sequence);
+    }
+
+    T read() const {
+        T value;
+
+        while (!tryRead(value)) { }
+
+        return value;
+    }
+
+    // Number of completed writes, which lets a reader check for a new value.
+    uint32_t sequence() const { return (__atomic_load_n(&_sequence, __ATOMIC_RELAXED) >> 1); }
+
+private:
+    volatile uint32_t _sequence;
+    T _value;
+
+    Seqlock(const Seqlock&) = delete;
+    Seqlock& operator=(const Seqlock&) = delete;
+};
+
+#endif // _ATOMIC_H_INCLUDED
@@ -0,0 +1,108 @@
+/*
+ * Copyright (c) 2017 Thomas Roell.  All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal with the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ *  1. Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimers.
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimers in the
+ *     documentation and/or other materials provided with the distribution.
+ *  3. Neither the name of Thomas Roell, nor the names of its contributors
+ *     may be used to endorse or promote products derived from this Software
+ *     without specific prior written permission.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ * CONTRIBUTORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * WITH THE SOFTWARE.
+ */
+
+#ifndef _BITBAND_H_INCLUDED
+#define _BITBAND_H_INCLUDED
+
+#include "armv7m.h"
+
+// Cortex-M4 bitband aliases turn a single bit update into one store, with
+// no read-modify-write and hence no need to mask interrupts. They cover
+// SRAM1 (0x20000000 - 0x200fffff, where .data/.bss live) and the APB/AHB1
+// peripherals (0x40000000 - 0x400fffff). The GPIO ports (AHB2), SRAM2 and
+// the flash are outside, but then GPIO BSRR/BRR are atomic to begin with.
+
+#define BITBAND_SRAM_BASE        0x20000000
+#define BITBAND_SRAM_LIMIT       0x20100000
+#define BITBAND_PERIPHERAL_BASE  0x40000000
+#define BITBAND_PERIPHERAL_LIMIT 0x40100000
+
+// Bit "bit" of the constant "address", e.g. BitbandRef<RCC_BASE + 0x58, 28>() for RCC_APB1ENR1_PWREN.
+template<uint32_t address, unsigned int bit>
+class BitbandRef {
+    static_assert(bit < 32, "BitbandRef<address, bit>: bit out of range");
+    static_assert(((address >= BITBAND_SRAM_BASE) && (address < BITBAND_SRAM_LIMIT)) ||
+                  ((address >= BITBAND_PERIPHERAL_BASE) && (address < BITBAND_PERIPHERAL_LIMIT)),
+                  "BitbandRef<address, bit>: outside of the bitband regions");
+
+public:
+    static inline volatile uint32_t *alias() {
+        return (address < BITBAND_PERIPHERAL_BASE)
+            ? ARMV7M_BITBAND_SRAM_ADDRESS(address, bit)
+            : ARMV7M_BITBAND_PERIPHERAL_ADDRESS(address, bit);
+    }
+
+    inline void set() const { *alias() = 1; }
+    inline void clear() const { *alias() = 0; }
+    inline bool read() const { return *alias(); }
+
+    inline operator bool() const { return read(); }
+    inline const BitbandRef& operator=(bool value) const { *alias() = value; return *this; }
+};
+
+// Bit "bit" of a word in memory, e.g. a flag word shared with an interrupt handler.
+// If the word is not in SRAM1 (e.g. allocated in SRAM2), atomic and/or are used
+// instead, so the semantics are the same either way.
+class Bitband {
+public:
+    inline Bitband(volatile uint32_t *word, unsigned int bit) : _word(word), _bit(bit) {
+        if (((uint32_t)word >= BITBAND_SRAM_BASE) && ((uint32_t)word < BITBAND_SRAM_LIMIT)) {
+            _alias = ARMV7M_BITBAND_SRAM_ADDRESS(word, bit);
+        } else {
+            _alias = NULL;
+        }
+    }
+
+    inline void set() const {
+        if (_alias) {
+            *_alias = 1;
+        } else {
+            armv7m_atomic_or(_word, (1u << _bit));
+        }
+    }
+
+    inline void clear() const {
+        if (_alias) {
+            *_alias = 0;
+        } else {
+            armv7m_atomic_and(_word, ~(1u << _bit));
+        }
+    }
+
+    inline bool read() const { return !!(*_word & (1u << _bit)); }
+
+    inline operator bool() const { return read(); }
+    inline const Bitband& operator=(bool value) const { if (value) { set(); } else { clear(); } return *this; }
+
+private:
+    volatile uint32_t *_word;
+    volatile uint32_t *_alias;
+    unsigned int _bit;
+};
+
+#endif // _BITBAND_H_INCLUDED
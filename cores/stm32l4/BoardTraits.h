@@ -0,0 +1,88 @@
+/*
+ * Copyright (c) 2017 Thomas Roell.  All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal with the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ *  1. Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimers.
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimers in the
+ *     documentation and/or other materials provided with the distribution.
+ *  3. Neither the name of Thomas Roell, nor the names of its contributors
+ *     may be used to endorse or promote products derived from this Software
+ *     without specific prior written permission.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ * CONTRIBUTORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * WITH THE SOFTWARE.
+ */
+
+#ifndef _BOARD_TRAITS_H_INCLUDED
+#define _BOARD_TRAITS_H_INCLUDED
+
+// STM32L4 EXTENSION: the capabilities variant.h describes as macros, as compile
+// time constants. Unlike an #if, a test like "if (BoardTraits::dac) { ... }"
+// keeps both branches type checked, while the dead one still compiles out. With
+// compiler.cpp.std=gnu++17 in platform.local.txt "if constexpr" can be used as
+// well, which also discards the dead branch inside templates. The pin helpers
+// are constexpr, so they work in static_assert() and template arguments.
+struct BoardTraits
+{
+    static constexpr unsigned int pins = PINS_COUNT;
+    static constexpr unsigned int totalPins = NUM_TOTAL_PINS;
+    static constexpr unsigned int digitalPins = NUM_DIGITAL_PINS;
+    static constexpr unsigned int analogInputs = NUM_ANALOG_INPUTS;
+
+    static constexpr unsigned int serialInterfaces = SERIAL_INTERFACES_COUNT;
+    static constexpr unsigned int spiInterfaces = SPI_INTERFACES_COUNT;
+    static constexpr unsigned int wireInterfaces = WIRE_INTERFACES_COUNT;
+#if defined(I2S_INTERFACES_COUNT)
+    static constexpr unsigned int i2sInterfaces = I2S_INTERFACES_COUNT;
+#else
+    static constexpr unsigned int i2sInterfaces = 0;
+#endif
+
+#if defined(USBCON)
+    static constexpr bool usb = true;
+#else
+    static constexpr bool usb = false;
+#endif
+
+#if defined(PIN_DAC0) || defined(PIN_DAC1)
+    static constexpr bool dac = true;
+#else
+    static constexpr bool dac = false;
+#endif
+
+    static constexpr bool isPin(uint32_t pin) {
+        return (pin < PINS_COUNT);
+    }
+
+    // analogRead() also accepts 0 ... NUM_ANALOG_INPUTS-1 for A0 and up.
+    static constexpr bool isAnalogInput(uint32_t pin) {
+        return (pin < NUM_ANALOG_INPUTS) || ((pin >= PIN_A0) && (pin < (PIN_A0 + NUM_ANALOG_INPUTS)));
+    }
+
+    static constexpr bool isDAC(uint32_t pin) {
+#if defined(PIN_DAC0) && defined(PIN_DAC1)
+        return (pin == PIN_DAC0) || (pin == PIN_DAC1);
+#elif defined(PIN_DAC0)
+        return (pin == PIN_DAC0);
+#elif defined(PIN_DAC1)
+        return (pin == PIN_DAC1);
+#else
+        return false;
+#endif
+    }
+};
+
+#endif // _BOARD_TRAITS_H_INCLUDED
@@ -45,7 +45,7 @@ static int serialusb_stdio_put(char data, FILE *fp)
     return Serial.write(&data, 1);
 }
 
-CDC::CDC(bool serialEvent)
+void CDC_BASE::_init()
 {
     _blocking = true;
 
@@ -54,13 +54,29 @@ CDC::CDC(bool serialEvent)
     _tx_count = 0;
     _tx_size = 0;
 
-    _tx_data2 = NULL;
-    _tx_size2 = 0;
+    _tx_queue_read = 0;
+    _tx_queue_write = 0;
+    _tx_queue_count = 0;
 
     _tx_timeout = 0;
+    _tx_latency = 1;
   
-    _completionCallback = NULL;
     _receiveCallback = NULL;
+    armv7m_pendsv_job_create(&_receiveJob, NULL, NULL, ARMV7M_PENDSV_PRIORITY_LOW);
+
+    _tx_zlp = false;
+    _tx_zlp_busy = 0;
+
+    _rx_data = &_rx_fifo[0];
+    _rx_size = sizeof(_rx_fifo);
+    _tx_data = &_tx_fifo[0];
+    _tx_buffer = sizeof(_tx_fifo);
+    _tx_packet = CDC_TX_PACKET_SIZE;
+}
+
+CDC::CDC(bool serialEvent)
+{
+    _init();
 
     stm32l4_usbd_cdc_create(&_usbd_cdc);
 
@@ -71,20 +87,7 @@ CDC::CDC(bool serialEvent)
 
 WEBUSB::WEBUSB()
 {
-    _blocking = true;
-
-    _tx_read = 0;
-    _tx_write = 0;
-    _tx_count = 0;
-    _tx_size = 0;
-
-    _tx_data2 = NULL;
-    _tx_size2 = 0;
-
-    _tx_timeout = 0;
-  
-    _completionCallback = NULL;
-    _receiveCallback = NULL;
+    _init();
 
     stm32l4_usbd_cdc_create_webusb(&_usbd_cdc);
 }
@@ -96,10 +99,14 @@ void CDC_BASE::begin(unsigned long baudrate)
 
 void CDC_BASE::begin(unsigned long baudrate, uint16_t config)
 {
+#if (STM32L4_CONFIG_FASTBOOT == 1)
+    USBDevice.attach();
+#endif
+
     /* If USBD_CDC has already been enabled/initialized by STDIO, just add the notify.
      */
     if (_usbd_cdc.state == USBD_CDC_STATE_INIT) {
-        stm32l4_usbd_cdc_enable(&_usbd_cdc, &_rx_data[0], sizeof(_rx_data), 0, CDC_BASE::_event_callback, (void*)this, (USBD_CDC_EVENT_SOF | USBD_CDC_EVENT_RECEIVE | USBD_CDC_EVENT_TRANSMIT));
+        stm32l4_usbd_cdc_enable(&_usbd_cdc, _rx_data, _rx_size, 0, CDC_BASE::_event_callback, (void*)this, (USBD_CDC_EVENT_SOF | USBD_CDC_EVENT_RECEIVE | USBD_CDC_EVENT_TRANSMIT));
 
 	if (stm32l4_stdio_put == NULL) {
 	    stm32l4_stdio_put = serialusb_stdio_put;
@@ -111,6 +118,45 @@ void CDC_BASE::begin(unsigned long baudrate, uint16_t config)
     }
 }
 
+bool CDC_BASE::begin(unsigned long baudrate, uint8_t *txbuf, size_t txsize, uint8_t *rxbuf, size_t rxsize)
+{
+    if ((txsize < (2 * CDC_TX_PACKET_SMALL)) || (txsize > 32768) || (txsize & (txsize -1))) {
+	return false;
+    }
+
+    if (rxsize < (2 * USBD_CDC_DATA_MAX_PACKET_SIZE)) {
+	return false;
+    }
+
+    if (rxsize > 65535) {
+	rxsize = 65535;
+    }
+
+    /* The RX ring is owned by USBD_CDC, so it has to be reenabled to switch to "rxbuf".
+     */
+    if (_usbd_cdc.state != USBD_CDC_STATE_INIT) {
+	flush();
+
+	stm32l4_usbd_cdc_disable(&_usbd_cdc);
+    }
+
+    _tx_read = 0;
+    _tx_write = 0;
+    _tx_count = 0;
+    _tx_size = 0;
+
+    _rx_data = rxbuf;
+    _rx_size = rxsize;
+    _tx_data = txbuf;
+    _tx_buffer = txsize;
+    _tx_packet = txsize / 2;
+    _tx_zlp = true;
+
+    begin(baudrate, (uint8_t)SERIAL_8N1);
+
+    return true;
+}
+
 void CDC_BASE::end()
 {
     flush();
@@ -133,11 +179,11 @@ int CDC_BASE::availableForWrite(void)
 	return 0;
     }
 
-    if (_tx_size2 != 0) {
+    if (_tx_queue_count != 0) {
 	return 0;
     }
 
-    return CDC_TX_BUFFER_SIZE - _tx_count;
+    return _tx_buffer - _tx_count;
 }
 
 int CDC_BASE::peek()
@@ -163,14 +209,26 @@ size_t CDC_BASE::read(uint8_t *buffer, size_t size)
     return stm32l4_usbd_cdc_receive(&_usbd_cdc, buffer, size);
 }
 
+size_t CDC_BASE::peekBuffer(const uint8_t **ptr)
+{
+    return stm32l4_usbd_cdc_peek_buffer(&_usbd_cdc, ptr);
+}
+
+void CDC_BASE::consume(size_t size)
+{
+    stm32l4_usbd_cdc_consume(&_usbd_cdc, (size > 65535) ? 65535 : size);
+}
+
 void CDC_BASE::flush()
 {
+    _transmitPending();
+
     if (armv7m_core_priority() <= STM32L4_USB_IRQ_PRIORITY) {
-	while ((_tx_count != 0) || (_tx_size2 != 0) || !stm32l4_usbd_cdc_done(&_usbd_cdc)) {
+	while ((_tx_count != 0) || (_tx_queue_count != 0) || !stm32l4_usbd_cdc_done(&_usbd_cdc)) {
 	    stm32l4_usbd_cdc_poll(&_usbd_cdc);
 	}
     } else {
-	while ((_tx_count != 0) || (_tx_size2 != 0) || !stm32l4_usbd_cdc_done(&_usbd_cdc)) {
+	while ((_tx_count != 0) || (_tx_queue_count != 0) || !stm32l4_usbd_cdc_done(&_usbd_cdc)) {
 	    armv7m_core_yield();
 	}
     }
@@ -183,7 +241,7 @@ size_t CDC_BASE::write(const uint8_t data)
 
 size_t CDC_BASE::write(const uint8_t *buffer, size_t size)
 {
-    unsigned int tx_read, tx_write, tx_count, tx_size;
+    unsigned int tx_write, tx_count;
     size_t count;
 
     if (_usbd_cdc.state != USBD_CDC_STATE_READY) {
@@ -194,12 +252,12 @@ size_t CDC_BASE::write(const uint8_t *buffer, size_t size)
 	return 0;
     }
 
-    if (_tx_size2 != 0) {
+    if (_tx_queue_count != 0) {
         if (!SHOULD_BLOCK()) {
           return 0;
         }
 	
-	while (_tx_size2 != 0) {
+	while (_tx_queue_count != 0) {
 	    armv7m_core_yield();
 	}
     }
@@ -208,7 +266,7 @@ size_t CDC_BASE::write(const uint8_t *buffer, size_t size)
 
     while (count < size) {
 
-	tx_count = CDC_TX_BUFFER_SIZE - _tx_count;
+	tx_count = _tx_buffer - _tx_count;
 
 	if (tx_count == 0) {
 
@@ -216,38 +274,19 @@ size_t CDC_BASE::write(const uint8_t *buffer, size_t size)
 		break;
 	    }
 
-	    if (stm32l4_usbd_cdc_done(&_usbd_cdc)) {
-		tx_size = _tx_count;
-		tx_read = _tx_read;
-
-		if (tx_size > (CDC_TX_BUFFER_SIZE - tx_read)) {
-		    tx_size = (CDC_TX_BUFFER_SIZE - tx_read);
-		}
-		
-		if (tx_size > CDC_TX_PACKET_SIZE) {
-		    tx_size = CDC_TX_PACKET_SIZE;
-		}
-		
-		_tx_size = tx_size;
-		
-		if (!stm32l4_usbd_cdc_transmit(&_usbd_cdc, &_tx_data[tx_read], tx_size)) {
-		    _tx_size = 0;
-		    _tx_count = 0;
-		    _tx_read = _tx_write;
-		}
-	    }
+	    _transmitPending();
 
-	    while (CDC_TX_BUFFER_SIZE == _tx_count && SHOULD_BLOCK()) {
+	    while (_tx_buffer == _tx_count && SHOULD_BLOCK()) {
 		armv7m_core_yield();
 	    }
 
-	    tx_count = CDC_TX_BUFFER_SIZE - _tx_count;
+	    tx_count = _tx_buffer - _tx_count;
 	}
 
 	tx_write = _tx_write;
 
-	if (tx_count > (CDC_TX_BUFFER_SIZE - tx_write)) {
-	    tx_count = (CDC_TX_BUFFER_SIZE - tx_write);
+	if (tx_count > (unsigned int)(_tx_buffer - tx_write)) {
+	    tx_count = (_tx_buffer - tx_write);
 	}
 
 	if (tx_count > (size - count)) {
@@ -257,32 +296,13 @@ size_t CDC_BASE::write(const uint8_t *buffer, size_t size)
 	memcpy(&_tx_data[tx_write], &buffer[count], tx_count);
 	count += tx_count;
       
-	_tx_write = (unsigned int)(tx_write + tx_count) & (CDC_TX_BUFFER_SIZE -1);
+	_tx_write = (unsigned int)(tx_write + tx_count) & (_tx_buffer -1);
 
 	armv7m_atomic_add(&_tx_count, tx_count);
     }
 
-    if (stm32l4_usbd_cdc_done(&_usbd_cdc)) {
-	tx_size = _tx_count;
-	tx_read = _tx_read;
-	
-	if (tx_size >= CDC_TX_PACKET_SMALL) {
-	    if (tx_size > (CDC_TX_BUFFER_SIZE - tx_read)) {
-		tx_size = (CDC_TX_BUFFER_SIZE - tx_read);
-	    }
-	    
-	    if (tx_size > CDC_TX_PACKET_SIZE) {
-		tx_size = CDC_TX_PACKET_SIZE;
-	    }
-	    
-	    _tx_size = tx_size;
-	    
-	    if (!stm32l4_usbd_cdc_transmit(&_usbd_cdc, &_tx_data[tx_read], tx_size)) {
-		_tx_size = 0;
-		_tx_count = 0;
-		_tx_read = _tx_write;
-	    }
-	}
+    if (_tx_count >= CDC_TX_PACKET_SMALL) {
+	_transmitPending();
     }
 
     return count;
@@ -290,27 +310,50 @@ size_t CDC_BASE::write(const uint8_t *buffer, size_t size)
 
 bool CDC_BASE::write(const uint8_t *buffer, size_t size, void(*callback)(void))
 {
+    struct SerialTxDescriptor desc;
+
+    desc.data = buffer;
+    desc.size = size;
+    desc.callback = callback;
+
+    return writev(&desc, 1);
+}
+
+bool CDC_BASE::writev(const struct SerialTxDescriptor *vec, unsigned int count)
+{
+    unsigned int index, tx_write;
+
     if (_usbd_cdc.state != USBD_CDC_STATE_READY) {
 	return false;
     }
 
-    if (size == 0) {
+    if ((count == 0) || (count > (SERIAL_TX_QUEUE_SIZE - _tx_queue_count))) {
 	return false;
     }
 
-    if (_tx_size2 != 0) {
-	return false;
+    for (index = 0; index < count; index++) {
+	if (vec[index].size == 0) {
+	    return false;
+	}
+    }
+
+    tx_write = _tx_queue_write;
+
+    for (index = 0; index < count; index++) {
+	_tx_queue[tx_write] = vec[index];
+
+	tx_write = (tx_write + 1) & (SERIAL_TX_QUEUE_SIZE -1);
     }
 
-    _completionCallback = callback;
-    _tx_data2 = buffer;
-    _tx_size2 = size;
+    _tx_queue_write = tx_write;
+
+    armv7m_atomic_add(&_tx_queue_count, count);
 
+    /* If the IN endpoint is busy, EventCallback() picks up the queue once the TX ring
+     * and the descriptors ahead have been sent.
+     */
     if (stm32l4_usbd_cdc_done(&_usbd_cdc)) {
-	if (!stm32l4_usbd_cdc_transmit(&_usbd_cdc, _tx_data2, _tx_size2)) {
-	    _tx_data2 = NULL;
-	    _tx_size2 = 0;
-	}
+	_transmitQueue();
     }
 
     return true;
@@ -322,7 +365,7 @@ bool CDC_BASE::done()
 	return false;
     }
 
-    if (_tx_size2) {
+    if (_tx_queue_count) {
 	return false;
     }
 
@@ -333,9 +376,93 @@ bool CDC_BASE::done()
     return true;
 }
 
+void CDC_BASE::zeroLengthPacket(bool enable)
+{
+    _tx_zlp = enable;
+}
+
+void CDC_BASE::setTxLatency(unsigned int frames)
+{
+    if (frames < 1) {
+	frames = 1;
+    }
+
+    if (frames > 255) {
+	frames = 255;
+    }
+
+    _tx_latency = frames;
+}
+
+// Start an IN transfer of up to _tx_packet bytes from the TX ring. On failure
+// (i.e. not connected) the ring gets discarded.
+bool CDC_BASE::_transmit()
+{
+    unsigned int tx_read, tx_size;
+
+    tx_size = _tx_count;
+    tx_read = _tx_read;
+		    
+    if (tx_size > (unsigned int)(_tx_buffer - tx_read)) {
+	tx_size = (_tx_buffer - tx_read);
+    }
+	    
+    if (tx_size > _tx_packet) {
+	tx_size = _tx_packet;
+    }
+	    
+    _tx_size = tx_size;
+	    
+    if (!stm32l4_usbd_cdc_transmit(&_usbd_cdc, &_tx_data[tx_read], tx_size)) {
+	_tx_size = 0;
+	_tx_count = 0;
+	_tx_read = _tx_write;
+
+	return false;
+    }
+
+    return true;
+}
+
+// Start an IN transfer from the TX ring if the IN endpoint is idle. The USB
+// interrupt is held off (only it, more urgent interrupts stay live), so that
+// this does not race with EventCallback() starting the same transfer on SOF
+// or TRANSMIT.
+void CDC_BASE::_transmitPending()
+{
+    uint32_t basepri;
+
+    basepri = armv7m_critical_enter(STM32L4_USB_IRQ_PRIORITY);
+
+    if (_tx_count && !_tx_size && !_tx_queue_count && !_tx_zlp_busy && stm32l4_usbd_cdc_done(&_usbd_cdc)) {
+	_transmit();
+    }
+
+    armv7m_critical_leave(basepri);
+}
+
+// Start an IN transfer for the descriptor at the head of the queue. On failure
+// (i.e. not connected) the queue gets discarded.
+bool CDC_BASE::_transmitQueue()
+{
+    unsigned int tx_read;
+
+    tx_read = _tx_queue_read;
+
+    if (!stm32l4_usbd_cdc_transmit(&_usbd_cdc, _tx_queue[tx_read].data, _tx_queue[tx_read].size)) {
+	_tx_queue_count = 0;
+	_tx_queue_read = _tx_queue_write;
+
+	return false;
+    }
+
+    return true;
+}
+
 void CDC_BASE::onReceive(void(*callback)(void))
 {
     _receiveCallback = callback;
+    _receiveJob.routine = (armv7m_pendsv_routine_t)callback;
 }
 
 void CDC_BASE::blockOnOverrun(bool block)
@@ -346,11 +473,14 @@ void CDC_BASE::blockOnOverrun(bool block)
 void CDC_BASE::EventCallback(uint32_t events)
 {
     unsigned int tx_read, tx_size;
+    void (*callback)(void);
 
     if (events & USBD_CDC_EVENT_RECEIVE) {
 	if (_receiveCallback) {
-	    armv7m_pendsv_enqueue((armv7m_pendsv_routine_t)_receiveCallback, NULL, 0);
+	    armv7m_pendsv_job_post(&_receiveJob, 0);
 	}
+
+	loopWakeup();
     }
 
     if (events & USBD_CDC_EVENT_TRANSMIT) {
@@ -359,8 +489,20 @@ void CDC_BASE::EventCallback(uint32_t events)
 
 	tx_size = _tx_size;
 
-	if (tx_size != 0) {
-	    _tx_read = (_tx_read + tx_size) & (CDC_TX_BUFFER_SIZE -1);
+	if (_tx_zlp_busy) {
+	    _tx_zlp_busy = 0;
+
+	    if (_usbd_cdc.state == USBD_CDC_STATE_READY) {
+		if (_tx_count != 0) {
+		    _transmit();
+		} else {
+		    if (_tx_queue_count != 0) {
+			_transmitQueue();
+		    }
+		}
+	    }
+	} else if (tx_size != 0) {
+	    _tx_read = (_tx_read + tx_size) & (_tx_buffer -1);
       
 	    armv7m_atomic_sub(&_tx_count, tx_size);
       
@@ -368,63 +510,73 @@ void CDC_BASE::EventCallback(uint32_t events)
 
 	    if (_usbd_cdc.state == USBD_CDC_STATE_READY) {
 		if (_tx_count != 0) {
-		    tx_size = _tx_count;
-		    tx_read = _tx_read;
-		    
-		    if (tx_size > (CDC_TX_BUFFER_SIZE - tx_read)) {
-			tx_size = (CDC_TX_BUFFER_SIZE - tx_read);
-		    }
-		    
-		    if (tx_size > CDC_TX_PACKET_SIZE) {
-			tx_size = CDC_TX_PACKET_SIZE;
-		    }
-		    
-		    _tx_size = tx_size;
-		    
-		    stm32l4_usbd_cdc_transmit(&_usbd_cdc, &_tx_data[tx_read], tx_size);
+		    _transmit();
 		} else {
-		    if (_tx_size2 != 0) {
-			stm32l4_usbd_cdc_transmit(&_usbd_cdc, _tx_data2, _tx_size2);
+		    /* The host only completes a read on a short packet, so if the data ran out
+		     * on a packet boundary, terminate the transfer with a ZLP.
+		     */
+		    if (_tx_zlp && !(tx_size & (USBD_CDC_DATA_MAX_PACKET_SIZE -1))) {
+			_tx_zlp_busy = 1;
+
+			if (!stm32l4_usbd_cdc_transmit(&_usbd_cdc, NULL, 0)) {
+			    _tx_zlp_busy = 0;
+			}
+		    } else {
+			if (_tx_queue_count != 0) {
+			    _transmitQueue();
+			}
 		    }
 		}
 	    } else {
 		_tx_count = 0;
 		_tx_read = _tx_write;
 	    }
-	} else {
-	    _tx_size2 = 0;
-	    _tx_data2 = NULL;
-
-	    if (_completionCallback) {
-		armv7m_pendsv_enqueue((armv7m_pendsv_routine_t)_completionCallback, NULL, 0);
-		
-		_completionCallback = NULL;
+	} else if (_tx_queue_count != 0) {
+	    tx_read = _tx_queue_read;
+
+	    tx_size = _tx_queue[tx_read].size;
+	    callback = _tx_queue[tx_read].callback;
+
+	    _tx_queue_read = (tx_read + 1) & (SERIAL_TX_QUEUE_SIZE -1);
+
+	    armv7m_atomic_sub(&_tx_queue_count, 1);
+
+	    if (callback) {
+		armv7m_pendsv_enqueue((armv7m_pendsv_routine_t)callback, NULL, 0);
+	    }
+
+	    if (_usbd_cdc.state == USBD_CDC_STATE_READY) {
+		if (_tx_queue_count != 0) {
+		    _transmitQueue();
+		} else {
+		    /* Descriptors are chained back-to-back, so only the last one in the queue
+		     * may need to be terminated with a ZLP.
+		     */
+		    if (_tx_zlp && !(tx_size & (USBD_CDC_DATA_MAX_PACKET_SIZE -1))) {
+			_tx_zlp_busy = 1;
+
+			if (!stm32l4_usbd_cdc_transmit(&_usbd_cdc, NULL, 0)) {
+			    _tx_zlp_busy = 0;
+			}
+		    }
+		}
+	    } else {
+		_tx_queue_count = 0;
+		_tx_queue_read = _tx_queue_write;
 	    }
 	}
     }
 
     if (events & USBD_CDC_EVENT_SOF) {
-	if (_tx_count && !_tx_size && !_tx_size2) {
+	if (_tx_count && !_tx_size && !_tx_queue_count && !_tx_zlp_busy) {
 
 	    _tx_timeout++;
 
-	    // Small packets get only send after 8ms latency
-	    if (_tx_timeout >= 8)
+	    // Small writes get collected for _tx_latency frames, so that a
+	    // series of print() calls ends up in a single packet.
+	    if (_tx_timeout >= _tx_latency)
 	    {
-		tx_size = _tx_count;
-		tx_read = _tx_read;
-		    
-		if (tx_size > (CDC_TX_BUFFER_SIZE - tx_read)) {
-		    tx_size = (CDC_TX_BUFFER_SIZE - tx_read);
-		}
-	    
-		if (tx_size > CDC_TX_PACKET_SIZE) {
-		    tx_size = CDC_TX_PACKET_SIZE;
-		}
-	    
-		_tx_size = tx_size;
-	    
-		stm32l4_usbd_cdc_transmit(&_usbd_cdc, &_tx_data[tx_read], tx_size);
+		_transmit();
 	    }
 	}
     }
@@ -0,0 +1,74 @@
+/*
+ * Copyright (c) 2017 Thomas Roell.  All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal with the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ *  1. Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimers.
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimers in the
+ *     documentation and/or other materials provided with the distribution.
+ *  3. Neither the name of Thomas Roell, nor the names of its contributors
+ *     may be used to endorse or promote products derived from this Software
+ *     without specific prior written permission.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ * CONTRIBUTORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * WITH THE SOFTWARE.
+ */
+
+#include "EventFlags.h"
+
+uint32_t EventFlags::test(uint32_t mask, bool all, bool consume)
+{
+    uint32_t flags, match;
+
+    flags = _flags;
+
+    do {
+        match = flags & mask;
+
+        if (!match || (all && (match != mask))) {
+            return 0;
+        }
+
+        if (!consume) {
+            return match;
+        }
+    } while (!armv7m_atomic_compare_exchange(&_flags, &flags, (flags & ~match)));
+
+    return match;
+}
+
+uint32_t EventFlags::wait(uint32_t mask, bool all, uint32_t timeout, bool consume)
+{
+    uint32_t start, match;
+
+    if (!mask) {
+        return 0;
+    }
+
+    start = millis();
+
+    // Exception return and set() both set the event register, so bits set
+    // between test() and the WFE in armv7m_core_yield() are not missed. The
+    // SysTick interrupt wakes the wait up every millisecond for the timeout.
+    while (!(match = test(mask, all, consume))) {
+        if (timeout && ((millis() - start) >= timeout)) {
+            return 0;
+        }
+
+        armv7m_core_yield();
+    }
+
+    return match;
+}
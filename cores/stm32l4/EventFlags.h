@@ -0,0 +1,80 @@
+/*
+ * Copyright (c) 2017 Thomas Roell.  All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal with the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ *  1. Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimers.
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimers in the
+ *     documentation and/or other materials provided with the distribution.
+ *  3. Neither the name of Thomas Roell, nor the names of its contributors
+ *     may be used to endorse or promote products derived from this Software
+ *     without specific prior written permission.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ * CONTRIBUTORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * WITH THE SOFTWARE.
+ */
+
+#ifndef _EVENT_FLAGS_H_INCLUDED
+#define _EVENT_FLAGS_H_INCLUDED
+
+#include <Arduino.h>
+
+// A group of 32 event bits, set from any context (interrupt handlers
+// included) and waited for by loop() or a Task. set() ors the bits in and
+// issues SEV, so a waiter sleeping in WFE (or in another Task via
+// armv7m_core_yield()) wakes up right away. A bit stays set until a
+// waiter consumes it or clear() is called.
+//
+// wait() returns the bits out of "mask" that satisfied the wait (any one
+// of them, or all of them with "all" set), or 0 after "timeout"
+// milliseconds (0 waits forever). With "consume" set those bits are
+// cleared atomically with the check.
+//
+// The async driver callbacks take a plain function, so signal<F, M> is a
+// ready made one that sets "M" in "F":
+//
+//   EventFlags events;
+//   SPI.transfer(tx, rx, 64, EventFlags::signal<events, 0x01>);
+//   Wire.transfer(0x40, tx, 1, rx, 6, true, EventFlags::signal<events, 0x02>);
+//   events.wait(0x03, true);
+class EventFlags
+{
+public:
+    constexpr EventFlags() : _flags(0) { }
+
+    void set(uint32_t mask) {
+        armv7m_atomic_or(&_flags, mask);
+
+        __SEV();
+    }
+
+    void clear(uint32_t mask) { armv7m_atomic_and(&_flags, ~mask); }
+    uint32_t get() const { return _flags; }
+
+    uint32_t wait(uint32_t mask, bool all = false, uint32_t timeout = 0, bool consume = true);
+
+    template<EventFlags &F, uint32_t M> static void signal() { F.set(M); }
+    template<EventFlags &F, uint32_t M> static void signal(uint8_t status) { (void)status; F.set(M); }
+
+private:
+    volatile uint32_t _flags;
+
+    uint32_t test(uint32_t mask, bool all, bool consume);
+
+    EventFlags(const EventFlags&) = delete;
+    EventFlags& operator=(const EventFlags&) = delete;
+};
+
+#endif // _EVENT_FLAGS_H_INCLUDED
@@ -21,9 +21,137 @@
 
 #include "FS.h"
 #include "dosfs_config.h"
+#include "stm32l4_wiring_private.h"
+#include "armv7m_timer.h"
+
+#define FILE_WRITE_BEHIND_SIZE     4096   /* power of 2 */
+#define FILE_WRITE_BEHIND_REQUESTS 8      /* power of 2 */
+#define FILE_WRITE_BEHIND_CHUNK    512
+#define FILE_WRITE_BEHIND_DELAY    1      /* ms between two chunks */
+
+// Shared write-behind buffer of File::writeAsync(). "head"/"tail" are free running byte
+// counts queued/committed. Each request records the "head" value at which its data is
+// committed and the callback to report that. Only one file at a time can own the buffer.
+//
+// DOSFS is not reentrant. Thread mode DOSFS calls are bracketed by File_lock()/File_unlock(),
+// and a commit that finds "lock" set is "deferred" till File_unlock().
+static struct {
+    F_FILE            *file;
+    volatile uint8_t  lock;
+    volatile uint8_t  deferred;
+    volatile uint32_t head;
+    volatile uint32_t tail;
+    volatile uint8_t  busy;
+    volatile uint32_t request_head;
+    volatile uint32_t request_tail;
+    struct {
+        uint32_t      end;
+        void          (*callback)(int status);
+    }                 requests[FILE_WRITE_BEHIND_REQUESTS];
+    armv7m_timer_t    timer;
+    uint8_t           data[FILE_WRITE_BEHIND_SIZE] __attribute__((aligned(4)));
+} File_writeBehind;
+
+static void File_writeBehindCommit(void *context, uint32_t data);
+
+// PendSV preempts thread mode, but never the other way round, so no commit can be in
+// progress once "lock" is set.
+static inline void File_lock() {
+    File_writeBehind.lock = File_writeBehind.lock + 1;
+}
+
+static inline void File_unlock() {
+    File_writeBehind.lock = File_writeBehind.lock - 1;
+
+    if (!File_writeBehind.lock && File_writeBehind.deferred) {
+        File_writeBehind.deferred = 0;
+
+        armv7m_pendsv_enqueue(File_writeBehindCommit, NULL, 0);
+    }
+}
+
+static void File_writeBehindTimeout(armv7m_timer_t *timer) {
+    File_writeBehindCommit(NULL, 0);
+}
+
+// Runs in PendSV context (directly or via the armv7m_timer). Commits at most one chunk,
+// aligned to the file position, so that the foreground gets to run between chunks.
+static void File_writeBehindCommit(void *context, uint32_t data) {
+    uint32_t head, tail, offset, count;
+    int status;
+
+    if (File_writeBehind.lock) {
+        File_writeBehind.deferred = 1;
+
+        return;
+    }
+
+    head = File_writeBehind.head;
+    tail = File_writeBehind.tail;
+
+    status = F_NO_ERROR;
+
+    if (head != tail) {
+        offset = tail & (FILE_WRITE_BEHIND_SIZE -1);
+
+        count = FILE_WRITE_BEHIND_CHUNK - (f_tell(File_writeBehind.file) & (FILE_WRITE_BEHIND_CHUNK -1));
+
+        if (count > (head - tail)) {
+            count = head - tail;
+        }
+
+        if (count > (FILE_WRITE_BEHIND_SIZE - offset)) {
+            count = FILE_WRITE_BEHIND_SIZE - offset;
+        }
+
+        if (f_write(&File_writeBehind.data[offset], 1, count, File_writeBehind.file) == (long)count) {
+            tail += count;
+        } else {
+            // drop whatever is left, all pending requests get the error
+            status = F_ERR_WRITE;
+
+            tail = head;
+        }
+
+        File_writeBehind.tail = tail;
+    }
+
+    while (File_writeBehind.request_tail != File_writeBehind.request_head) {
+        unsigned int index = File_writeBehind.request_tail & (FILE_WRITE_BEHIND_REQUESTS -1);
+
+        if ((int32_t)(tail - File_writeBehind.requests[index].end) < 0) {
+            break;
+        }
+
+        File_writeBehind.request_tail = File_writeBehind.request_tail + 1;
+
+        if (File_writeBehind.requests[index].callback) {
+            (*File_writeBehind.requests[index].callback)(status);
+        }
+    }
+
+    if (File_writeBehind.head != tail) {
+        armv7m_timer_start(&File_writeBehind.timer, FILE_WRITE_BEHIND_DELAY);
+    } else {
+        File_writeBehind.busy = 0;
+    }
+}
+
+// Waits (from thread context) till all write-behind data of "file" has been committed.
+static void File_writeBehindDrain(F_FILE *file) {
+    if (File_writeBehind.file != file) {
+        return;
+    }
+
+    while (File_writeBehind.busy) {
+        armv7m_core_yield();
+    }
+}
 
 File::File(const char* path, const char* mode) {
+    File_lock();
     _file = f_open(path, mode);
+    File_unlock();
 }
 
 File::File() {
@@ -31,10 +159,16 @@ File::File() {
 }
 
 size_t File::write(uint8_t c) {
+    int status;
+
     if (!_file)
         return 0;
     
-    if (f_putc(c, _file) == -1) {
+    File_lock();
+    status = f_putc(c, _file);
+    File_unlock();
+
+    if (status == -1) {
 	return 0;
     }
 
@@ -42,31 +176,130 @@ size_t File::write(uint8_t c) {
 }
 
 size_t File::write(const uint8_t *buf, size_t size) {
+    long count;
+
     if (!_file)
         return 0;
 
-    return f_write(buf, 1, size, _file);
+    File_lock();
+    count = f_write(buf, 1, size, _file);
+    File_unlock();
+
+    return count;
 }
 
 int File::available() {
+    int count;
+
     if (!_file)
         return 0;
 
-    return f_length(_file) - f_tell(_file);
+    File_lock();
+    count = f_length(_file) - f_tell(_file);
+    File_unlock();
+
+    return count;
 }
 
 int File::read() {
+    int c;
+
     if (!_file)
         return -1;
 
-    return f_getc(_file);
+    File_lock();
+    c = f_getc(_file);
+    File_unlock();
+
+    return c;
 }
 
 size_t File::read(uint8_t* buf, size_t size) {
+    long count;
+
     if (!_file)
         return -1;
 
-    return f_read(buf, 1, size, _file);
+    File_lock();
+    count = f_read(buf, 1, size, _file);
+    File_unlock();
+
+    return count;
+}
+
+static void File_readAsyncCallback(void *context, int status) {
+    (*((void(*)(int))context))(status);
+}
+
+size_t File::readAsync(uint8_t* buf, size_t size, void(*callback)(int status)) {
+    long count;
+
+    if (!_file || !callback)
+        return 0;
+
+    File_lock();
+    count = f_read_async(buf, size, _file, File_readAsyncCallback, (void*)callback);
+    File_unlock();
+
+    return count;
+}
+
+size_t File::writeAsync(const uint8_t *buf, size_t size, void(*callback)(int status)) {
+    uint32_t head, offset, count, chunk;
+    unsigned int index;
+
+    if (!_file || !size)
+        return 0;
+
+    if (File_writeBehind.file != _file) {
+        if (File_writeBehind.busy)
+            return 0;
+
+        if (!File_writeBehind.timer.callback)
+            armv7m_timer_create(&File_writeBehind.timer, File_writeBehindTimeout);
+
+        File_writeBehind.file = _file;
+    }
+
+    if ((File_writeBehind.request_head - File_writeBehind.request_tail) == FILE_WRITE_BEHIND_REQUESTS)
+        return 0;
+
+    head = File_writeBehind.head;
+
+    count = FILE_WRITE_BEHIND_SIZE - (head - File_writeBehind.tail);
+
+    if (count > size)
+        count = size;
+
+    if (!count)
+        return 0;
+
+    offset = head & (FILE_WRITE_BEHIND_SIZE -1);
+
+    chunk = FILE_WRITE_BEHIND_SIZE - offset;
+
+    if (chunk > count)
+        chunk = count;
+
+    memcpy(&File_writeBehind.data[offset], buf, chunk);
+    memcpy(&File_writeBehind.data[0], buf + chunk, count - chunk);
+
+    index = File_writeBehind.request_head & (FILE_WRITE_BEHIND_REQUESTS -1);
+
+    File_writeBehind.requests[index].end = head + count;
+    File_writeBehind.requests[index].callback = callback;
+
+    // PendSV never preempts itself, so publishing "head" last is sufficient
+    File_writeBehind.request_head = File_writeBehind.request_head + 1;
+    File_writeBehind.head = head + count;
+
+    if (!File_writeBehind.busy) {
+        File_writeBehind.busy = 1;
+
+        armv7m_pendsv_enqueue(File_writeBehindCommit, NULL, 0);
+    }
+
+    return count;
 }
 
 int File::peek() {
@@ -76,9 +309,12 @@ int File::peek() {
     if (!_file)
         return -1;
 
+    File_lock();
     position = f_tell(_file);
     c = f_getc(_file);
     f_seek(_file, position, F_SEEK_SET);
+    File_unlock();
+
     return c;
 }
 
@@ -86,35 +322,109 @@ void File::flush() {
     if (!_file)
         return;
 
+    File_writeBehindDrain(_file);
+
+    File_lock();
     f_flush(_file);
+    File_unlock();
+}
+
+bool File::reserve(size_t size) {
+    int status;
+
+    if (!_file)
+        return false;
+
+    File_lock();
+    status = f_reserve(_file, size);
+    File_unlock();
+
+    return (status == F_NO_ERROR);
+}
+
+bool File::map(const uint8_t **ptr) {
+    int status;
+
+    if (!_file)
+        return false;
+
+    File_lock();
+    status = f_map(_file, (const void**)ptr);
+    File_unlock();
+
+    return (status == F_NO_ERROR);
+}
+
+void File::unmap(const uint8_t *ptr) {
+    File_lock();
+    f_unmap((const void*)ptr);
+    File_unlock();
+}
+
+bool File::setAccessPattern(uint32_t pattern, uint32_t offset, uint32_t length) {
+    int status;
+
+    if (!_file)
+        return false;
+
+    File_lock();
+    status = f_advise(_file, offset, length, pattern);
+    File_unlock();
+
+    return (status == F_NO_ERROR);
 }
 
 bool File::seek(uint32_t pos, SeekMode mode) {
+    int status;
+
     if (!_file)
         return false;
 
-    return (f_seek(_file, pos, mode) == F_NO_ERROR);
+    File_lock();
+    status = f_seek(_file, pos, mode);
+    File_unlock();
+
+    return (status == F_NO_ERROR);
 }
 
 size_t File::position() const {
+    long position;
+
     if (!_file)
         return 0;
 
-    return f_tell(_file);
+    File_lock();
+    position = f_tell(_file);
+    File_unlock();
+
+    return position;
 }
 
 size_t File::size() const {
+    long length;
+
     if (!_file)
         return 0;
 
-    return f_length(_file);
+    File_lock();
+    length = f_length(_file);
+    File_unlock();
+
+    return length;
 }
 
 void File::close() {
     if (!_file)
 	return;
 
+    File_writeBehindDrain(_file);
+
+    if (File_writeBehind.file == _file)
+        File_writeBehind.file = NULL;
+
+    File_lock();
     f_close(_file);
+    File_unlock();
 
     _file = NULL;
 }
@@ -126,6 +436,7 @@ File::operator bool() const {
 
 Dir::Dir(const char* path) {
     char filename[F_MAXPATH];
+    int status;
 
     strcpy(_path, path);
 
@@ -135,14 +446,21 @@ Dir::Dir(const char* path) {
     strcpy(filename, _path);
     strcat(filename, "*.*");
 
-    if (f_findfirst(filename, &_find) != F_NO_ERROR) {
+    File_lock();
+    status = f_findfirst(filename, &_find);
+    File_unlock();
+
+    if (status != F_NO_ERROR) {
 	_find.find_clsno = 0x0fffffff;
     }
+
+    _first = true;
 }
 
 Dir::Dir() {
     _path[0] = '\0';
     _find.find_clsno = 0x0fffffff;
+    _first = false;
 };
 
 File Dir::openFile(const char* mode) {
@@ -172,40 +490,181 @@ size_t Dir::fileSize() {
 }
 
 bool Dir::next() {
+    int status;
+
     if (_find.find_clsno == 0x0fffffff)
         return false;
 
-    return (f_findnext(&_find) == F_NO_ERROR);
+    // f_findfirst() already returned the first entry.
+    if (_first) {
+        _first = false;
+
+        return true;
+    }
+
+    File_lock();
+    status = f_findnext(&_find);
+    File_unlock();
+
+    return (status == F_NO_ERROR);
+}
+
+size_t Dir::nextBatch(DirEntry *entries, size_t count) {
+    size_t n, length;
+
+    // f_findnext() resumes at the directory index after the current entry, so the
+    // batch is collected in a single pass over the directory sectors.
+    for (n = 0; (n < count) && next(); n++) {
+        length = strlen(_find.filename);
+
+        if (length >= DIR_ENTRY_NAME_SIZE) {
+            length = DIR_ENTRY_NAME_SIZE -1;
+
+            entries[n].truncated = true;
+        } else {
+            entries[n].truncated = false;
+        }
+
+        memcpy(&entries[n].name[0], &_find.filename[0], length);
+        entries[n].name[length] = '\0';
+
+        entries[n].size = _find.filesize;
+        entries[n].cluster = _find.cluster;
+        entries[n].time = _find.ctime;
+        entries[n].date = _find.cdate;
+        entries[n].attributes = _find.attr;
+    }
+
+    return n;
 }
 
 FS::FS() {
+    _cache = NULL;
+}
+
+bool FS::begin(size_t cacheEntries)
+{
+    int status;
+
+    initStorage();
+
+    File_lock();
+    status = f_initvolume();
+    File_unlock();
+
+    if (status != F_NO_ERROR)
+        return false;
+
+    setCache(cacheEntries);
+
+    return true;
+}
+
+bool FS::beginShared(size_t cacheEntries)
+{
+    int status;
+
+    initStorage();
+
+    File_lock();
+    status = f_initvolume_shared();
+    File_unlock();
+
+    if (status != F_NO_ERROR)
+        return false;
+
+    setCache(cacheEntries);
+
+    return true;
 }
 
-bool FS::begin()
+void FS::setCache(size_t cacheEntries)
 {
-    return (f_initvolume() == F_NO_ERROR);
+    int status;
+
+    if (cacheEntries && !_cache) {
+        _cache = malloc(cacheEntries * F_CACHE_ENTRY_SIZE);
+
+        if (_cache) {
+            File_lock();
+            status = f_setcache(_cache, cacheEntries * F_CACHE_ENTRY_SIZE);
+            File_unlock();
+
+            if (status != F_NO_ERROR) {
+                free(_cache);
+
+                _cache = NULL;
+            }
+        }
+    }
 }
 
 void FS::end()
 {
+    File_lock();
     f_delvolume();
+
+    if (_cache)
+        f_setcache(NULL, 0);
+    File_unlock();
+
+    if (_cache) {
+        free(_cache);
+
+        _cache = NULL;
+    }
 }
 
 bool FS::check()
 {
-    return (f_checkvolume() == F_NO_ERROR);
+    int status;
+
+    File_lock();
+    status = f_checkvolume();
+    File_unlock();
+
+    return (status == F_NO_ERROR);
 }
 
-bool FS::format()
+bool FS::dirty()
 {
-    return (f_hardformat(0) == F_NO_ERROR);
+    int dirty, status;
+
+    File_lock();
+    status = f_getdirty(&dirty);
+    File_unlock();
+
+    if (status != F_NO_ERROR)
+        return true;
+
+    return !!dirty;
+}
+
+bool FS::format(unsigned int options)
+{
+    int status;
+
+    File_lock();
+    status = f_hardformat(options);
+    File_unlock();
+
+    return (status == F_NO_ERROR);
 }
 
 bool FS::info(FSInfo& info)
 {
     F_SPACE space;
+    F_CACHE cache;
+    int status;
     
-    if (f_getfreespace(&space) != F_NO_ERROR) 
+    File_lock();
+    status = f_getfreespace(&space);
+
+    if (status == F_NO_ERROR)
+        status = f_getcache(&cache);
+    File_unlock();
+
+    if (status != F_NO_ERROR)
 	return false;
     
     info.totalBytes    = (uint64_t)space.total | ((uint64_t)space.total_high << 32);
@@ -214,10 +673,40 @@ bool FS::info(FSInfo& info)
     info.pageSize      = 0;
     info.maxOpenFiles  = DOSFS_CONFIG_MAX_FILES;
     info.maxPathLength = F_MAXPATH;
+    info.cacheEntries  = cache.size;
+    info.cacheHits     = cache.hits;
+    info.cacheMisses   = cache.misses;
     
     return true;
 }
 
+bool FS::stats(FSStats& stats, bool reset)
+{
+    F_STATISTICS statistics;
+    int status;
+
+    File_lock();
+    status = f_getstatistics(&statistics, reset);
+    File_unlock();
+
+    if (status != F_NO_ERROR)
+	return false;
+
+    stats.reads            = statistics.reads;
+    stats.writes           = statistics.writes;
+    stats.syncs            = statistics.syncs;
+    stats.readBytes        = (uint64_t)statistics.read_blocks * 512;
+    stats.writeBytes       = (uint64_t)statistics.write_blocks * 512;
+    stats.cacheHits        = statistics.cache_hits;
+    stats.cacheMisses      = statistics.cache_misses;
+    stats.retries          = statistics.retries;
+    stats.deviceMicros     = statistics.device_time;
+    stats.maxLatencyMicros = statistics.max_latency;
+    stats.clockHz          = statistics.clock;
+
+    return true;
+}
+
 File FS::open(const char* path, const char* mode) {
     return File(path, mode);
 }
@@ -226,16 +715,66 @@ File FS::open(const String& path, const char* mode) {
     return open(path.c_str(), mode);
 }
 
+File FS::preallocate(const char* path, size_t size) {
+    File file(path, "w");
+
+    if (file && !file.reserve(size))
+        file.close();
+
+    return file;
+}
+
+File FS::preallocate(const String& path, size_t size) {
+    return preallocate(path.c_str(), size);
+}
+
 bool FS::exists(const char* path) {
     unsigned char attr;
+    int status;
+
+    File_lock();
+    status = f_getattr(path, &attr);
+    File_unlock();
 
-    return (f_getattr(path, &attr) == F_NO_ERROR);
+    return (status == F_NO_ERROR);
 }
 
 bool FS::exists(const String& path) {
     return exists(path.c_str());
 }
 
+bool FS::read(FSReadRequest *requests, size_t count) {
+    F_READ_REQUEST fr[DOSFS_CONFIG_MAX_FILES];
+    size_t offset, chunk, index;
+    int status;
+    bool success = true;
+
+    for (offset = 0; offset < count; offset += chunk) {
+        chunk = count - offset;
+
+        if (chunk > DOSFS_CONFIG_MAX_FILES)
+            chunk = DOSFS_CONFIG_MAX_FILES;
+
+        for (index = 0; index < chunk; index++) {
+            fr[index].file = requests[offset + index].file->_file;
+            fr[index].buffer = requests[offset + index].buffer;
+            fr[index].size = requests[offset + index].size;
+        }
+
+        File_lock();
+        status = f_read_multiple(&fr[0], chunk);
+        File_unlock();
+
+        if (status != F_NO_ERROR)
+            success = false;
+
+        for (index = 0; index < chunk; index++)
+            requests[offset + index].count = fr[index].count;
+    }
+
+    return success;
+}
+
 Dir FS::openDir(const char* path) {
     return Dir(path);
 }
@@ -245,7 +784,13 @@ Dir FS::openDir(const String& path) {
 }
 
 bool FS::mkdir(const char* path) {
-    return (f_mkdir(path) == F_NO_ERROR);
+    int status;
+
+    File_lock();
+    status = f_mkdir(path);
+    File_unlock();
+
+    return (status == F_NO_ERROR);
 }
 
 bool FS::mkdir(const String& path) {
@@ -253,7 +798,13 @@ bool FS::mkdir(const String& path) {
 }
 
 bool FS::rmdir(const char* path) {
-    return (f_rmdir(path) == F_NO_ERROR);
+    int status;
+
+    File_lock();
+    status = f_rmdir(path);
+    File_unlock();
+
+    return (status == F_NO_ERROR);
 }
 
 bool FS::rmdir(const String& path) {
@@ -261,7 +812,13 @@ bool FS::rmdir(const String& path) {
 }
 
 bool FS::chdir(const char* path) {
-    return (f_chdir(path) == F_NO_ERROR);
+    int status;
+
+    File_lock();
+    status = f_chdir(path);
+    File_unlock();
+
+    return (status == F_NO_ERROR);
 }
 
 bool FS::chdir(const String& path) {
@@ -269,7 +826,13 @@ bool FS::chdir(const String& path) {
 }
 
 bool FS::rename(const char* pathFrom, const char* pathTo) {
-    return (f_move(pathFrom, pathTo) == F_NO_ERROR);
+    int status;
+
+    File_lock();
+    status = f_move(pathFrom, pathTo);
+    File_unlock();
+
+    return (status == F_NO_ERROR);
 }
 
 bool FS::rename(const String& pathFrom, const String& pathTo) {
@@ -277,7 +840,13 @@ bool FS::rename(const String& pathFrom, const String& pathTo) {
 }
 
 bool FS::remove(const char* path) {
-    return (f_delete(path) == F_NO_ERROR);
+    int status;
+
+    File_lock();
+    status = f_delete(path);
+    File_unlock();
+
+    return (status == F_NO_ERROR);
 }
 
 bool FS::remove(const String& path) {
@@ -34,6 +34,24 @@ enum SeekMode {
   SeekEnd = F_SEEK_END
 };
 
+// STM32L4 EXTENSION: layout options for FS::format(), which may be or'ed together.
+enum FormatOptions {
+  FormatDefault    = 0,
+  FormatAlign      = F_FORMAT_ALIGN,         // align FAT and data region to the card's AU
+  FormatStreaming  = F_FORMAT_STREAMING,     // large clusters for large sequential files
+  FormatSmallFiles = F_FORMAT_SMALL_FILES    // small clusters for many small files
+};
+
+// STM32L4 EXTENSION: access pattern hints for File::setAccessPattern(). AccessSequential or
+// AccessRandom may be or'ed with AccessNoCache and AccessWillNeed.
+enum AccessPattern {
+  AccessNormal     = F_ADVICE_NORMAL,
+  AccessSequential = F_ADVICE_SEQUENTIAL,    // device prefetch, deep read-ahead in FS::read()
+  AccessRandom     = F_ADVICE_RANDOM,
+  AccessNoCache    = F_ADVICE_NOCACHE,       // no prefetch, partially read sectors are not kept
+  AccessWillNeed   = F_ADVICE_WILLNEED       // map "offset", "length" and load its first sector
+};
+
 class File : public Stream
 {
 public:
@@ -53,6 +71,29 @@ public:
         return read((uint8_t*)buffer, length);
     }
     size_t read(uint8_t* buf, size_t size);
+    // STM32L4 EXTENSION: non-blocking read, "callback(status)" is called (possibly from an
+    // interrupt handler) once the returned number of bytes has arrived in "buf".
+    size_t readAsync(uint8_t* buf, size_t size, void(*callback)(int status));
+    // STM32L4 EXTENSION: write-behind, copies up to "size" bytes into a shared 4k buffer and
+    // returns at once. The data is committed from PendSV one sector at a time, and
+    // "callback(status)" (may be NULL) is called from there once it is on the file. Returns
+    // the number of bytes queued; less than "size" (0 if the buffer is full or owned by
+    // another file) signals backpressure. flush()/close() wait for pending data. Other
+    // File/Dir/FS calls hold off the commit while they are in DOSFS, but direct f_*() calls
+    // are not serialized against it.
+    size_t writeAsync(const uint8_t *buf, size_t size, void(*callback)(int status) = NULL);
+    // STM32L4 EXTENSION: allocate "size" bytes of contiguous space for an empty file opened
+    // for writing, so that writes within that space never have to update the FAT.
+    bool reserve(size_t size);
+    // STM32L4 EXTENSION: point "*ptr" at the whole content of the file in memory mapped
+    // storage (SFLASH), if it is stored contiguously there. Returns false if the file cannot
+    // be mapped, in which case it has to be read via read(). The pointer stays valid until
+    // unmap(), as long as the file is not modified or deleted.
+    bool map(const uint8_t **ptr);
+    static void unmap(const uint8_t *ptr);
+    // STM32L4 EXTENSION: tell how the file is going to be read, like posix_fadvise(). Replaces the
+    // pattern given with "S"/"R" in the open mode and any previous AccessNoCache.
+    bool setAccessPattern(uint32_t pattern, uint32_t offset = 0, uint32_t length = 0);
     bool seek(uint32_t pos, SeekMode mode = SeekSet);
     size_t position() const;
     size_t size() const;
@@ -61,6 +102,23 @@ public:
 
 protected:
     F_FILE *_file;
+
+    friend class FS;
+};
+
+// STM32L4 EXTENSION: compact directory entry record filled in by Dir::nextBatch().
+// "time"/"date" are the FAT encoded time/date of the last modification. A name
+// longer than DIR_ENTRY_NAME_SIZE -1 characters is cut off and "truncated" is set.
+#define DIR_ENTRY_NAME_SIZE 64
+
+struct DirEntry {
+    char     name[DIR_ENTRY_NAME_SIZE];
+    uint32_t size;
+    uint32_t cluster;
+    uint16_t time;
+    uint16_t date;
+    uint8_t  attributes;
+    bool     truncated;
 };
 
 class Dir {
@@ -73,9 +131,22 @@ public:
     size_t fileSize();
     bool next();
 
+    // STM32L4 EXTENSION: advance like next() up to "count" times, recording each entry
+    // in "entries". Returns the number of entries recorded, 0 at the end of the directory.
+    size_t nextBatch(DirEntry *entries, size_t count);
+
 protected:
     char   _path[F_MAXPATH];
     F_FIND _find;
+    bool   _first;
+};
+
+// STM32L4 EXTENSION: one read of FS::read(), "count" returns the number of bytes read.
+struct FSReadRequest {
+    File    *file;
+    uint8_t *buffer;
+    size_t  size;
+    size_t  count;
 };
 
 struct FSInfo {
@@ -85,6 +156,27 @@ struct FSInfo {
     size_t pageSize;
     size_t maxOpenFiles;
     size_t maxPathLength;
+    size_t cacheEntries;   // STM32L4 EXTENSION: FAT/directory sector cache
+    size_t cacheHits;
+    size_t cacheMisses;
+};
+
+// STM32L4 EXTENSION: device I/O counters since begin() or the last stats(..., true).
+// "deviceMicros" is the total time spent waiting for the media, "maxLatencyMicros"
+// the slowest single read, write or sync. "clockHz" is the current SD card interface
+// clock (not reset), 0 if there is none.
+struct FSStats {
+    uint32_t reads;
+    uint32_t writes;
+    uint32_t syncs;
+    uint64_t readBytes;
+    uint64_t writeBytes;
+    uint32_t cacheHits;
+    uint32_t cacheMisses;
+    uint32_t retries;
+    uint32_t deviceMicros;
+    uint32_t maxLatencyMicros;
+    uint32_t clockHz;
 };
 
 class FS
@@ -92,19 +184,41 @@ class FS
 public:
     FS();
 
-    bool begin();
+    // STM32L4 EXTENSION: "cacheEntries" sizes the LRU cache for FAT/directory sectors
+    bool begin(size_t cacheEntries = 0);
+    // STM32L4 EXTENSION: mount read-only next to USB/MSC, so that the volume stays usable
+    // while a host has it mounted. Caches are dropped when the host writes, but files the
+    // host rewrites need to be reopened.
+    bool beginShared(size_t cacheEntries = 0);
     void end();
 
     bool check();
-    bool format();
+    // STM32L4 EXTENSION: true if the volume was not cleanly unmounted, i.e. check() should
+    // be run. The volume is marked dirty on the first write, and clean again by flush(),
+    // close() and end(). A successful check() clears the state.
+    bool dirty();
+    // STM32L4 EXTENSION: "options" are FormatOptions
+    bool format(unsigned int options = FormatDefault);
     bool info(FSInfo& info);
 
+    // STM32L4 EXTENSION: I/O counters, "reset" restarts them after reading
+    bool stats(FSStats& stats, bool reset = false);
+
     File open(const char* path, const char* mode);
     File open(const String& path, const char* mode);
 
+    // STM32L4 EXTENSION: create/truncate "path" for writing with "size" bytes reserved
+    File preallocate(const char* path, size_t size);
+    File preallocate(const String& path, size_t size);
+
     bool exists(const char* path);
     bool exists(const String& path);
 
+    // STM32L4 EXTENSION: serve reads on several open files in one go, ordered by their
+    // position on the media (e.g. one buffer refill per stream for multi-stream playback).
+    // Returns false if any of the reads failed.
+    bool read(FSReadRequest *requests, size_t count);
+
     Dir openDir(const char* path);
     Dir openDir(const String& path);
 
@@ -123,6 +237,10 @@ public:
     bool rename(const char* pathFrom, const char* pathTo);
     bool rename(const String& pathFrom, const String& pathTo);
 
+private:
+    void *_cache;
+
+    void setCache(size_t cacheEntries);
 };
 
 extern FS DOSFS;
@@ -48,6 +48,28 @@ void MouseClass::click(uint8_t b)
 	move(0,0,0);
 }
 
+// Movements queued behind a busy endpoint are folded into the last queued report,
+// as long as the buttons did not change and the sums still fit.
+static bool MouseMerge(uint8_t *queued, const uint8_t *data, uint32_t count)
+{
+	int x, y, wheel;
+
+	if (queued[0] != data[0])
+		return false;
+
+	x = (int8_t)queued[1] + (int8_t)data[1];
+	y = (int8_t)queued[2] + (int8_t)data[2];
+	wheel = (int8_t)queued[3] + (int8_t)data[3];
+
+	if ((x < -127) || (x > 127) || (y < -127) || (y > 127) || (wheel < -127) || (wheel > 127))
+		return false;
+
+	queued[1] = x;
+	queued[2] = y;
+	queued[3] = wheel;
+	return true;
+}
+
 void MouseClass::move(signed char x, signed char y, signed char wheel)
 {
 	uint8_t m[5];
@@ -55,9 +77,8 @@ void MouseClass::move(signed char x, signed char y, signed char wheel)
 	m[1] = x;
 	m[2] = y;
 	m[3] = wheel;
-	stm32l4_usbd_hid_send_report(1,m,4);
 
-	while (!stm32l4_usbd_hid_done()) {
+	while (!stm32l4_usbd_hid_queue_report(1,m,4,MouseMerge)) {
 	    armv7m_core_yield();
 	}
 }
@@ -106,11 +127,11 @@ void KeyboardClass::end(void)
 {
 }
 
+// Key reports are never merged, as each press/release has to be seen by the host.
+// Only a full queue blocks.
 void KeyboardClass::sendReport(KeyReport* keys)
 {
-    stm32l4_usbd_hid_send_report(2,(const uint8_t*)keys,sizeof(KeyReport));
-
-    while (!stm32l4_usbd_hid_done()) {
+    while (!stm32l4_usbd_hid_queue_report(2,(const uint8_t*)keys,sizeof(KeyReport),NULL)) {
 	armv7m_core_yield();
     }
 }
@@ -350,4 +371,67 @@ size_t KeyboardClass::write(uint8_t c)
 
 KeyboardClass Keyboard;
 
+//================================================================================
+//================================================================================
+//	Gamepad
+
+GamepadClass::GamepadClass(void) 
+{
+	memset(&_report, 0, sizeof(_report));
+}
+
+void GamepadClass::begin(void) 
+{
+}
+
+void GamepadClass::end(void) 
+{
+}
+
+void GamepadClass::press(uint8_t b)
+{
+	if ((b >= 1) && (b <= 32))
+		_report.buttons |= (1ul << (b-1));
+}
+
+void GamepadClass::release(uint8_t b)
+{
+	if ((b >= 1) && (b <= 32))
+		_report.buttons &= ~(1ul << (b-1));
+}
+
+void GamepadClass::buttons(uint32_t b)
+{
+	_report.buttons = b;
+}
+
+bool GamepadClass::isPressed(uint8_t b)
+{
+	if ((b >= 1) && (b <= 32))
+		return !!(_report.buttons & (1ul << (b-1)));
+	return false;
+}
+
+void GamepadClass::setAxis(unsigned int axis, int16_t value)
+{
+	if (axis < GAMEPAD_AXIS_COUNT)
+		_report.axis[axis] = (value == -32768) ? -32767 : value;
+}
+
+// The gamepad reports absolute state, so a queued report is simply overwritten.
+static bool GamepadMerge(uint8_t *queued, const uint8_t *data, uint32_t count)
+{
+	memcpy(queued, data, count);
+	return true;
+}
+
+void GamepadClass::send(void)
+{
+	while (!stm32l4_usbd_hid_queue_report(3,(const uint8_t*)&_report,sizeof(GamepadReport),GamepadMerge)) {
+	    armv7m_core_yield();
+	}
+}
+
+GamepadClass Gamepad;
+
 #endif /* if defined(USBCON) */
@@ -53,6 +53,20 @@
 #define SERIAL_7O2	(HARDSER_STOP_BIT_2 | HARDSER_PARITY_ODD  | HARDSER_DATA_7)
 #define SERIAL_8O2	(HARDSER_STOP_BIT_2 | HARDSER_PARITY_ODD  | HARDSER_DATA_8)
 
+// STM32L4 EXTENSTION: or'ed into "config", keeps LPUART1 receiving in STOP2 (clocked from
+// LSE, hence at most 9600 baud). Every received byte wakes up the core.
+#define SERIAL_WAKEUP	(0x8000ul)
+
+// STM32L4 EXTENSTION: transmit descriptor for writev(). "data" is owned by the caller and
+// needs to stay valid till "callback" (if not NULL) gets called for this descriptor.
+struct SerialTxDescriptor {
+    const uint8_t *data;
+    size_t size;
+    void (*callback)(void);
+};
+
+#define SERIAL_TX_QUEUE_SIZE 8
+
 class HardwareSerial : public Stream
 {
   public:
@@ -0,0 +1,178 @@
+/*
+ * Copyright (c) 2017 Thomas Roell.  All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal with the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ *  1. Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimers.
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimers in the
+ *     documentation and/or other materials provided with the distribution.
+ *  3. Neither the name of Thomas Roell, nor the names of its contributors
+ *     may be used to endorse or promote products derived from this Software
+ *     without specific prior written permission.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ * CONTRIBUTORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * WITH THE SOFTWARE.
+ */
+
+#ifndef _POOL_H_INCLUDED
+#define _POOL_H_INCLUDED
+
+#include <new>
+
+#include "stm32l4_pool.h"
+
+// Static pool of N objects of type T. allocate()/free() and create()/destroy()
+// may be called from any context, including interrupt handlers. The underlying
+// "stm32l4_pool_t" is accessible via pool() to hand it to C code.
+template<typename T, unsigned int N>
+class Pool {
+    static_assert((N != 0) && (N <= STM32L4_POOL_COUNT_MAX), "Pool<T, N>: N out of range");
+
+public:
+    Pool() {
+        stm32l4_pool_create(&_pool, &_data[0], &_link[0], sizeof(T), N);
+    }
+
+    // Raw storage for one T, or NULL if the pool is exhausted.
+    void *allocate() {
+        unsigned int index = stm32l4_pool_take(&_pool);
+
+        if (index == STM32L4_POOL_NONE) {
+            return NULL;
+        }
+
+        return (void*)&_data[index * sizeof(T)];
+    }
+
+    void free(void *p) {
+        if (p) {
+            stm32l4_pool_give(&_pool, ((uint8_t*)p - &_data[0]) / sizeof(T));
+        }
+    }
+
+    // Placement constructs a T from "args", or returns NULL if the pool is exhausted.
+    template<typename... Args>
+    T *create(Args&&... args) {
+        void *p = allocate();
+
+        if (!p) {
+            return NULL;
+        }
+
+        return new (p) T(static_cast<Args&&>(args)...);
+    }
+
+    void destroy(T *object) {
+        if (object) {
+            object->~T();
+
+            free(object);
+        }
+    }
+
+    bool owns(const void *p) const {
+        return ((const uint8_t*)p >= &_data[0]) && ((const uint8_t*)p < &_data[N * sizeof(T)]);
+    }
+
+    unsigned int capacity() const { return N; }
+
+    stm32l4_pool_t *pool() { return &_pool; }
+
+private:
+    stm32l4_pool_t _pool;
+    uint16_t _link[N];
+    alignas(T) uint8_t _data[N * sizeof(T)];
+
+    Pool(const Pool&) = delete;
+    Pool& operator=(const Pool&) = delete;
+};
+
+// Bounded FIFO of N (a power of 2) objects of type T. Any number of producers and
+// consumers may run concurrently in any context. Elements are constructed in place
+// by push()/emplace() and destroyed by pop().
+template<typename T, unsigned int N>
+class ObjectQueue {
+    static_assert((N != 0) && !(N & (N -1)) && (N <= 65536), "ObjectQueue<T, N>: N has to be a power of 2");
+
+public:
+    ObjectQueue() {
+        stm32l4_queue_create(&_queue, &_data[0], &_sequence[0], sizeof(T), N);
+    }
+
+    ~ObjectQueue() {
+        uint32_t sequence;
+        T *entry;
+
+        while ((entry = (T*)stm32l4_queue_acquire(&_queue, &sequence))) {
+            entry->~T();
+
+            stm32l4_queue_release(&_queue, sequence);
+        }
+    }
+
+    bool push(const T &value) {
+        return emplace(value);
+    }
+
+    template<typename... Args>
+    bool emplace(Args&&... args) {
+        uint32_t sequence;
+        void *entry = stm32l4_queue_claim(&_queue, &sequence);
+
+        if (!entry) {
+            return false;
+        }
+
+        new (entry) T(static_cast<Args&&>(args)...);
+
+        stm32l4_queue_publish(&_queue, sequence);
+
+        return true;
+    }
+
+    bool pop(T &value) {
+        uint32_t sequence;
+        T *entry = (T*)stm32l4_queue_acquire(&_queue, &sequence);
+
+        if (!entry) {
+            return false;
+        }
+
+        value = static_cast<T&&>(*entry);
+
+        entry->~T();
+
+        stm32l4_queue_release(&_queue, sequence);
+
+        return true;
+    }
+
+    bool empty() const { return (stm32l4_queue_count(&_queue) == 0); }
+    unsigned int count() const { return stm32l4_queue_count(&_queue); }
+    unsigned int capacity() const { return N; }
+
+    // Only valid for trivially copyable T, as C code uses memcpy().
+    stm32l4_queue_t *queue() { return &_queue; }
+
+private:
+    stm32l4_queue_t _queue;
+    volatile uint32_t _sequence[N];
+    alignas(T) uint8_t _data[N * sizeof(T)];
+
+    ObjectQueue(const ObjectQueue&) = delete;
+    ObjectQueue& operator=(const ObjectQueue&) = delete;
+};
+
+#endif // _POOL_H_INCLUDED
@@ -18,11 +18,16 @@
 
 #include <stdlib.h>
 #include <stdio.h>
+#include <stdarg.h>
 #include <string.h>
 #include <math.h>
 #include "Arduino.h"
 
 #include "Print.h"
+#include "format.h"
+
+#define PRINTF_BUFFER_SIZE 128
+#define PRINT_FLOAT_DIGITS 32
 
 // Public Methods //////////////////////////////////////////////////////////////
 
@@ -74,15 +79,12 @@ size_t Print::print(unsigned int n, int base)
 
 size_t Print::print(long n, int base)
 {
+  char buf[8 * sizeof(long) + 2]; // Assumes 8-bit chars plus sign and zero byte.
+
   if (base == 0) {
     return write(n);
   } else if (base == 10) {
-    if (n < 0) {
-      int t = print('-');
-      n = -n;
-      return printNumber(n, 10) + t;
-    }
-    return printNumber(n, 10);
+    return write(buf, format_ltoa(buf, n, 10, FORMAT_UPPERCASE));
   } else {
     return printNumber(n, base);
   }
@@ -186,69 +188,72 @@ size_t Print::println(const Printable& x)
   return n;
 }
 
+size_t Print::printf(const char *format, ...)
+{
+  char buf[PRINTF_BUFFER_SIZE];
+  char *str;
+  va_list ap, aq;
+  size_t n;
+  int length;
+
+  va_start(ap, format);
+  va_copy(aq, ap);
+
+  length = vsnprintf(buf, sizeof(buf), format, ap);
+
+  va_end(ap);
+
+  if (length < 0) {
+    n = 0;
+  } else if ((size_t)length < sizeof(buf)) {
+    n = write(buf, length);
+  } else {
+    // Too long for the stack buffer, so render it into a heap buffer instead.
+    str = (char*)malloc(length + 1);
+
+    if (str) {
+      vsnprintf(str, length + 1, format, aq);
+
+      n = write(str, length);
+
+      free(str);
+    } else {
+      n = write(buf, sizeof(buf) - 1);
+    }
+  }
+
+  va_end(aq);
+
+  return n;
+}
+
 // Private Methods /////////////////////////////////////////////////////////////
 
 size_t Print::printNumber(unsigned long n, uint8_t base)
 {
   char buf[8 * sizeof(long) + 1]; // Assumes 8-bit chars plus zero byte.
-  char *str = &buf[sizeof(buf) - 1];
-
-  *str = '\0';
 
   // prevent crash if called with base == 1
   if (base < 2) base = 10;
 
-  do {
-    char c = n % base;
-    n /= base;
-
-    *--str = c < 10 ? c + '0' : c + 'A' - 10;
-  } while(n);
-
-  return write(str);
+  return write(buf, format_ultoa(buf, n, base, FORMAT_UPPERCASE));
 }
 
 size_t Print::printFloat(double number, uint8_t digits)
 {
-  size_t n = 0;
+  char buf[13 + PRINT_FLOAT_DIGITS];
+  unsigned int length;
 
-  if (isnan(number)) return print("nan");
-  if (isinf(number)) return print("inf");
-  if (number > 4294967040.0) return print ("ovf");  // constant determined empirically
-  if (number <-4294967040.0) return print ("ovf");  // constant determined empirically
+  // Digits beyond what a double holds are just noise.
+  if (digits > PRINT_FLOAT_DIGITS) digits = PRINT_FLOAT_DIGITS;
 
-  // Handle negative numbers
-  if (number < 0.0)
-  {
-     n += print('-');
-     number = -number;
-  }
-
-  // Round correctly so that print(1.999, 2) prints as "2.00"
-  double rounding = 0.5;
-  for (uint8_t i=0; i<digits; ++i)
-    rounding /= 10.0;
-
-  number += rounding;
-
-  // Extract the integer part of the number and print it
-  unsigned long int_part = (unsigned long)number;
-  double remainder = number - (double)int_part;
-  n += print(int_part);
+  length = format_dtoa(buf, number, digits);
 
-  // Print the decimal point, but only if there are digits beyond
-  if (digits > 0) {
-    n += print(".");
+  if (length == 0) {
+    if (isnan(number)) return print("nan");
+    if (isinf(number)) return print("inf");
+    return print ("ovf");
   }
 
-  // Extract digits from the remainder one at a time
-  while (digits-- > 0)
-  {
-    remainder *= 10.0;
-    unsigned int toPrint = (unsigned int)remainder;
-    n += print(toPrint);
-    remainder -= toPrint;
-  }
-
-  return n;
+  return write(buf, length);
 }
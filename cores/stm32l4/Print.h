@@ -78,6 +78,10 @@ class Print
     size_t println(double, int = 2);
     size_t println(const Printable&);
     size_t println(void);
+
+    // STM32L4 EXTENSTION: formatted output, rendered into a stack buffer and sent
+    // with a single write(buffer, size)
+    size_t printf(const char *format, ...) __attribute__ ((format (printf, 2, 3)));
 };
 
 #endif
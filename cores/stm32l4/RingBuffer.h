@@ -20,6 +20,8 @@
 #define _RING_BUFFER_
 
 #include <stdint.h>
+#include <stddef.h>
+#include <string.h>
 
 // Define constants and variables for buffering incoming serial data.  We're
 // using a ring buffer (I think), in which head is the index of the location
@@ -27,24 +29,122 @@
 // location from which to read.
 #define SERIAL_BUFFER_SIZE 64
 
-class RingBuffer
+// STM32L4 EXTENSTION: RingBufferN<Size, T> holds up to "Size" (a power of 2)
+// elements. "_head" and "_tail" are free running counters, so that all "Size"
+// entries are usable and the index is a simple mask. Only the producer writes
+// "_head" and only the consumer writes "_tail", hence one producer and one
+// consumer (e.g. an interrupt handler and loop()) need no locking. Bulk
+// write()/read() use at most two memcpy()s.
+template <unsigned int Size, typename T = uint8_t>
+class RingBufferN
 {
-  public:
-    uint8_t _aucBuffer[SERIAL_BUFFER_SIZE] ;
-    int _iHead ;
-    int _iTail ;
+  static_assert((Size != 0) && !(Size & (Size - 1)), "RingBufferN<Size, T>: Size has to be a power of 2");
 
   public:
-    RingBuffer( void ) ;
-    void store_char( uint8_t c ) ;
-	void clear();
-	int read_char();
-	int available();
-	int peek();
-	bool isFull();
+    RingBufferN( void ) : _head(0), _tail(0) { }
+
+    void store_char( T c ) { write(c); }
+    void clear() { _tail = _head; }
+    int read_char() { T c; return read(c) ? (int)c : -1; }
+    int available() { return (int)(_head - _tail); }
+    int availableForStore() { return (int)(Size - (_head - _tail)); }
+    int peek() { return (_head != _tail) ? (int)_data[_tail & (Size - 1)] : -1; }
+    bool isFull() { return ((_head - _tail) == Size); }
+
+    bool write(T c) {
+      uint32_t head = _head;
+
+      if ((head - _tail) == Size) {
+        return false;
+      }
+
+      _data[head & (Size - 1)] = c;
+
+      __asm__ volatile ("dmb" : : : "memory");
+
+      _head = head + 1;
+
+      return true;
+    }
+
+    bool read(T &c) {
+      uint32_t tail = _tail;
+
+      if (tail == _head) {
+        return false;
+      }
+
+      __asm__ volatile ("dmb" : : : "memory");
+
+      c = _data[tail & (Size - 1)];
+
+      __asm__ volatile ("dmb" : : : "memory");
+
+      _tail = tail + 1;
+
+      return true;
+    }
+
+    // Stores up to "count" elements and returns how many were stored.
+    size_t write(const T *data, size_t count) {
+      uint32_t head = _head;
+      uint32_t index = head & (Size - 1);
+      size_t n1, n2;
+
+      if (count > (Size - (head - _tail))) {
+        count = Size - (head - _tail);
+      }
+
+      n1 = ((Size - index) < count) ? (Size - index) : count;
+      n2 = count - n1;
+
+      memcpy(&_data[index], data, n1 * sizeof(T));
+
+      if (n2) {
+        memcpy(&_data[0], data + n1, n2 * sizeof(T));
+      }
+
+      __asm__ volatile ("dmb" : : : "memory");
+
+      _head = head + count;
+
+      return count;
+    }
+
+    // Removes up to "count" elements and returns how many were removed.
+    size_t read(T *data, size_t count) {
+      uint32_t tail = _tail;
+      uint32_t index = tail & (Size - 1);
+      size_t n1, n2;
+
+      if (count > (_head - tail)) {
+        count = _head - tail;
+      }
+
+      __asm__ volatile ("dmb" : : : "memory");
+
+      n1 = ((Size - index) < count) ? (Size - index) : count;
+      n2 = count - n1;
+
+      memcpy(data, &_data[index], n1 * sizeof(T));
+
+      if (n2) {
+        memcpy(data + n1, &_data[0], n2 * sizeof(T));
+      }
+
+      __asm__ volatile ("dmb" : : : "memory");
+
+      _tail = tail + count;
+
+      return count;
+    }
 
   private:
-	int nextIndex(int index);
-} ;
+    volatile uint32_t _head;
+    volatile uint32_t _tail;
+    T _data[Size];
+};
+
+typedef RingBufferN<SERIAL_BUFFER_SIZE> RingBuffer;
 
 #endif /* _RING_BUFFER_ */
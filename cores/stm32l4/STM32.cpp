@@ -28,6 +28,7 @@
 
 #include "Arduino.h"
 #include "stm32l4_wiring_private.h"
+#include "stm32l4_iap.h"
 
 uint64_t STM32Class::getSerial()
 {
@@ -52,10 +53,62 @@ void STM32Class::getUID(uint32_t uid[3])
     uid[2] = *((uint32_t*)0x1fff7598);
 }
 
-float STM32Class::getVBAT()
+#define STM32_MONITOR_VREF 0
+#define STM32_MONITOR_VBAT 1
+#define STM32_MONITOR_TS   2
+
+/* The scan starts with a dummy conversion, as the first one after a long idle
+ * time is off (silicon errata 2.4.4).
+ */
+static const uint8_t STM32MonitorScan[4] = {
+    ADC_CHANNEL_ADC1_VREFINT,
+    ADC_CHANNEL_ADC1_VREFINT,
+    ADC_CHANNEL_ADC1_VBAT,
+    ADC_CHANNEL_ADC1_TS,
+};
+
+static const uint8_t * const STM32MonitorChannels = &STM32MonitorScan[1];
+
+static uint16_t STM32MonitorData[2 * 4];
+static volatile int32_t STM32MonitorValue[3]; // raw data in 28.4, filtered
+static bool STM32MonitorActive = false;
+
+static void STM32MonitorCallback(const uint16_t *data, unsigned int count)
 {
-    int32_t vbat_data, vref_data, vrefint;
-    
+    unsigned int index;
+
+    /* Exponential moving average, alpha = 1/4.
+     */
+    for (index = 0; index < 3; index++) {
+	STM32MonitorValue[index] += ((((int32_t)data[1 + index]) << 4) - STM32MonitorValue[index]) / 4;
+    }
+}
+
+/* Converts ADC1 "channels" synchronously into "data" (28.4), or picks the monitor's
+ * filtered values if it runs.
+ */
+static void STM32Convert(const uint8_t *channels, unsigned int count, int32_t *data)
+{
+    unsigned int index;
+
+    if (STM32MonitorActive) {
+	for (index = 0; index < count; index++) {
+	    data[index] = STM32MonitorValue[(channels[index] == ADC_CHANNEL_ADC1_VREFINT) ? STM32_MONITOR_VREF : ((channels[index] == ADC_CHANNEL_ADC1_VBAT) ? STM32_MONITOR_VBAT : STM32_MONITOR_TS)];
+	}
+
+	return;
+    }
+
+    /* analogReadSynchronized() holds the ADC enabled, so convert next to it.
+     */
+    if (stm32l4_adc.state == ADC_STATE_READY) {
+	for (index = 0; index < count; index++) {
+	    data[index] = stm32l4_adc_convert(&stm32l4_adc, channels[index]) << 4;
+	}
+
+	return;
+    }
+
     if (stm32l4_adc.state == ADC_STATE_NONE)
     {
 	stm32l4_adc_create(&stm32l4_adc, ADC_INSTANCE_ADC1, STM32L4_ADC_IRQ_PRIORITY, 0);
@@ -67,61 +120,43 @@ float STM32Class::getVBAT()
 	stm32l4_adc_enable(&stm32l4_adc, 0, NULL, NULL, 0);
     }
 
-    vref_data = stm32l4_adc_convert(&stm32l4_adc, ADC_CHANNEL_ADC1_VREFINT);
-    vbat_data = stm32l4_adc_convert(&stm32l4_adc, ADC_CHANNEL_ADC1_VBAT);
+    for (index = 0; index < count; index++) {
+	data[index] = stm32l4_adc_convert(&stm32l4_adc, channels[index]) << 4;
+    }
 
     stm32l4_adc_disable(&stm32l4_adc);
+}
+
+float STM32Class::getVBAT()
+{
+    int32_t data[2], vrefint;
+
+    STM32Convert(&STM32MonitorChannels[STM32_MONITOR_VREF], 2, data);
 
     /* Datasheet 3.15.1 */
     vrefint = *((uint16_t*)0x1fff75aa);
 
-    return 3.0 * ((3.0 * vbat_data * vrefint) / (4095.0 * vref_data));
+    return 3.0 * ((3.0 * data[1] * vrefint) / (4095.0 * data[0]));
 }
 
 float STM32Class::getVREF()
 {
-    int32_t vref_data, vrefint;
-    
-    if (stm32l4_adc.state == ADC_STATE_NONE)
-    {
-	stm32l4_adc_create(&stm32l4_adc, ADC_INSTANCE_ADC1, STM32L4_ADC_IRQ_PRIORITY, 0);
-	stm32l4_adc_enable(&stm32l4_adc, 0, NULL, NULL, 0);
-	stm32l4_adc_calibrate(&stm32l4_adc);
-    }
-    else
-    {
-	stm32l4_adc_enable(&stm32l4_adc, 0, NULL, NULL, 0);
-    }
-
-    vref_data = stm32l4_adc_convert(&stm32l4_adc, ADC_CHANNEL_ADC1_VREFINT);
+    int32_t data[1], vrefint;
 
-    stm32l4_adc_disable(&stm32l4_adc);
+    STM32Convert(&STM32MonitorChannels[STM32_MONITOR_VREF], 1, data);
 
     /* Datasheet 3.15.1 */
     vrefint = *((uint16_t*)0x1fff75aa);
 
-    return (3.0 * vrefint) / vref_data;
+    return (3.0 * 16.0 * vrefint) / data[0];
 }
 
 float STM32Class::getTemperature()
 {
-    int32_t ts_data, ts_cal1, ts_cal2, vref_data, vrefint;
+    static const uint8_t channels[2] = { ADC_CHANNEL_ADC1_VREFINT, ADC_CHANNEL_ADC1_TS };
+    int32_t data[2], ts_data, ts_cal1, ts_cal2, vrefint;
 
-    if (stm32l4_adc.state == ADC_STATE_NONE)
-    {
-	stm32l4_adc_create(&stm32l4_adc, ADC_INSTANCE_ADC1, STM32L4_ADC_IRQ_PRIORITY, 0);
-	stm32l4_adc_enable(&stm32l4_adc, 0, NULL, NULL, 0);
-	stm32l4_adc_calibrate(&stm32l4_adc);
-    }
-    else
-    {
-	stm32l4_adc_enable(&stm32l4_adc, 0, NULL, NULL, 0);
-    }
-
-    vref_data = stm32l4_adc_convert(&stm32l4_adc, ADC_CHANNEL_ADC1_VREFINT);
-    ts_data = stm32l4_adc_convert(&stm32l4_adc, ADC_CHANNEL_ADC1_TS);
-
-    stm32l4_adc_disable(&stm32l4_adc);
+    STM32Convert(&channels[0], 2, data);
 
     /* Datasheet 3.15.1 */
     ts_cal1  = *((uint16_t*)0x1fff75a8);
@@ -131,11 +166,71 @@ float STM32Class::getTemperature()
     vrefint = *((uint16_t*)0x1fff75aa);
 
     /* Compensate TS_DATA for VDDA vs. 3.0 */
-    ts_data = (ts_data * vrefint) / vref_data;
+    ts_data = (data[1] * vrefint) / data[0];
 
     return (30.0 + ((float)(110.0 - 30.0) * (float)(ts_data - ts_cal1)) / (float)(ts_cal2 - ts_cal1));
 }
 
+bool STM32Class::beginMonitor(uint32_t period)
+{
+    int32_t data[3];
+    unsigned int index;
+
+    if (STM32MonitorActive || (period == 0) || (period > 50000)) {
+	return false;
+    }
+
+    /* Seed the filter, so that the getters are valid right away.
+     */
+    STM32Convert(&STM32MonitorChannels[0], 3, data);
+
+    for (index = 0; index < 3; index++) {
+	STM32MonitorValue[index] = data[index];
+    }
+
+    if (!__analogReadMonitor(&STM32MonitorScan[0], 4, period, &STM32MonitorData[0], (2 * 4), STM32MonitorCallback)) {
+	return false;
+    }
+
+    STM32MonitorActive = true;
+
+    return true;
+}
+
+void STM32Class::endMonitor()
+{
+    if (STM32MonitorActive) {
+	__analogReadMonitorStop();
+
+	STM32MonitorActive = false;
+    }
+}
+
+void STM32Class::lowBattery(float threshold, void(*callback)(void))
+{
+    int32_t vrefint, low;
+
+    if (!STM32MonitorActive) {
+	return;
+    }
+
+    /* VBAT/3 in ADC counts against VDDA, as per the last VREFINT reading.
+     */
+    vrefint = *((uint16_t*)0x1fff75aa);
+
+    low = (threshold * 4095.0 * STM32MonitorValue[STM32_MONITOR_VREF]) / (3.0 * 3.0 * 16.0 * vrefint);
+
+    if (low < 0) {
+	low = 0;
+    }
+
+    if (low > 4095) {
+	low = 4095;
+    }
+
+    __analogReadMonitorWatchdog(ADC_CHANNEL_ADC1_VBAT, low, 4095, callback);
+}
+
 uint32_t STM32Class::resetCause()
 {
     return stm32l4_system_reset_cause();
@@ -146,6 +241,106 @@ uint32_t STM32Class::wakeupReason()
     return stm32l4_system_wakeup_reason();
 }
 
+uint32_t STM32Class::bootTime(unsigned int phase)
+{
+    extern uint32_t g_bootTime[BOOT_PHASE_COUNT];
+
+    if (phase >= BOOT_PHASE_COUNT) {
+	return 0;
+    }
+
+    return g_bootTime[phase];
+}
+
+uint32_t STM32Class::stackSize()
+{
+    uint32_t size;
+
+    armv7m_core_stack_statistics(&size, NULL);
+
+    return size;
+}
+
+uint32_t STM32Class::stackUsed()
+{
+    uint32_t used;
+
+    armv7m_core_stack_statistics(NULL, &used);
+
+    return used;
+}
+
+uint32_t STM32Class::heapSize()
+{
+    uint32_t size;
+
+    armv7m_core_heap_statistics(&size, NULL, NULL);
+
+    return size;
+}
+
+uint32_t STM32Class::heapUsed()
+{
+    uint32_t used;
+
+    armv7m_core_heap_statistics(NULL, &used, NULL);
+
+    return used;
+}
+
+uint32_t STM32Class::heapPeak()
+{
+    uint32_t peak;
+
+    armv7m_core_heap_statistics(NULL, NULL, &peak);
+
+    return peak;
+}
+
+void STM32Class::stackGuard(bool enable)
+{
+    armv7m_core_stack_guard(enable);
+}
+
+bool STM32Class::beginCpuLoad(uint32_t window)
+{
+    return stm32l4_load_enable(window);
+}
+
+void STM32Class::endCpuLoad()
+{
+    stm32l4_load_disable();
+}
+
+float STM32Class::cpuLoad(int context)
+{
+    uint32_t cycles[STM32L4_LOAD_COUNT], total;
+
+    if (!stm32l4_load_report(&cycles[0], &total) || !total) {
+	return 0.0f;
+    }
+
+    if (context == CPU_LOAD_TOTAL) {
+	return ((float)(total - cycles[STM32L4_LOAD_IDLE]) * 100.0f) / (float)total;
+    }
+
+    if ((context < 0) || (context >= STM32L4_LOAD_COUNT)) {
+	return 0.0f;
+    }
+
+    return ((float)cycles[context] * 100.0f) / (float)total;
+}
+
+bool STM32Class::crashReport(stm32l4_crash_report_t &report)
+{
+    return stm32l4_crash_report(&report);
+}
+
+void STM32Class::crashClear()
+{
+    stm32l4_crash_clear();
+}
+
 void STM32Class::sleep()
 {
     __WFE();
@@ -155,7 +350,34 @@ void STM32Class::sleep()
 
 bool STM32Class::stop(uint32_t timeout)
 {
-    return stm32l4_system_stop(timeout);
+    uint32_t start, elapsed, remaining;
+
+    // STOP ends early for an armv7m_timer deadline ahead of "timeout". The timer runs
+    // as soon as interrupts are unmasked again, and then STOP resumes for what is
+    // left of "timeout".
+    start = millis();
+    remaining = timeout;
+
+    while (1) {
+	if (!stm32l4_system_stop(remaining)) {
+	    return false;
+	}
+
+	// With interrupts masked the timer cannot run, so hand back to the caller.
+	if ((stm32l4_system_stop_reason() != SYSTEM_STOP_TIMER) || __get_PRIMASK()) {
+	    return true;
+	}
+
+	if (timeout) {
+	    elapsed = millis() - start;
+
+	    if (elapsed >= timeout) {
+		return true;
+	    }
+
+	    remaining = timeout - elapsed;
+	}
+    }
 }
 
 void STM32Class::standby(uint32_t timeout)
@@ -253,9 +475,111 @@ bool STM32Class::flashProgram(uint32_t address, const void *data, uint32_t count
     return true;
 }
 
+bool STM32Class::firmwareUpdate(const char *path)
+{
+    if (stm32l4_iap_stage(path) != IAP_STATUS_SUCCESS) {
+	return false;
+    }
+
+    stm32l4_iap_apply();
+
+    return false;
+}
+
 void STM32Class::lsco(bool enable)
 {
     stm32l4_system_lsco_configure((enable ? SYSTEM_LSCO_MODE_LSE : SYSTEM_LSCO_MODE_NONE));
 }
 
+void STM32Class::flashPrefetch(bool enable)
+{
+    stm32l4_system_flash_configure(SYSTEM_FLASH_DEFAULT | (enable ? SYSTEM_FLASH_PREFETCH : 0));
+}
+
+static armv7m_timer_t STM32ClockTimeout;
+static uint32_t STM32ClockLow = 0;
+static uint32_t STM32ClockHigh = 0;
+static uint32_t STM32ClockHoldoff = 0;
+static volatile uint32_t STM32ClockDemand = 0;
+
+static bool STM32ClockConfigure(uint32_t hclk)
+{
+    if (SystemCoreClock == hclk) {
+	return true;
+    }
+
+    return stm32l4_system_sysclk_configure(hclk, hclk/2, hclk/2);
+}
+
+static void STM32ClockTimeoutCallback(armv7m_timer_t *timeout)
+{
+    if (STM32ClockDemand || !STM32ClockLow) {
+	return;
+    }
+
+    /* A clock change is refused while SYSTEM_LOCK_CLOCKS is held (or USB is active below
+     * 16MHz), so retry after another holdoff period.
+     */
+    if (!STM32ClockConfigure(STM32ClockLow)) {
+	armv7m_timer_start(timeout, STM32ClockHoldoff);
+
+	return;
+    }
+
+    /* clockAcquire() from an interrupt handler may have raced with the step down.
+     */
+    if (STM32ClockDemand) {
+	STM32ClockConfigure(STM32ClockHigh);
+    }
+}
+
+bool STM32Class::clockGovernor(uint32_t lowClock, uint32_t highClock, uint32_t holdoff)
+{
+    if (lowClock > highClock) {
+	return false;
+    }
+
+    if (!STM32ClockHigh) {
+	armv7m_timer_create(&STM32ClockTimeout, STM32ClockTimeoutCallback);
+    }
+
+    armv7m_timer_stop(&STM32ClockTimeout);
+
+    STM32ClockLow = lowClock;
+    STM32ClockHigh = highClock;
+    STM32ClockHoldoff = holdoff ? holdoff : 1;
+
+    if (!STM32ClockConfigure(highClock)) {
+	STM32ClockLow = 0;
+
+	return false;
+    }
+
+    if (lowClock && !STM32ClockDemand) {
+	armv7m_timer_start(&STM32ClockTimeout, STM32ClockHoldoff);
+    }
+
+    return true;
+}
+
+void STM32Class::clockAcquire()
+{
+    if (armv7m_atomic_add(&STM32ClockDemand, 1) == 0) {
+	if (STM32ClockLow) {
+	    armv7m_timer_stop(&STM32ClockTimeout);
+
+	    STM32ClockConfigure(STM32ClockHigh);
+	}
+    }
+}
+
+void STM32Class::clockRelease()
+{
+    if (armv7m_atomic_sub(&STM32ClockDemand, 1) == 1) {
+	if (STM32ClockLow) {
+	    armv7m_timer_start(&STM32ClockTimeout, STM32ClockHoldoff);
+	}
+    }
+}
+
 STM32Class STM32;
@@ -50,6 +50,19 @@
 #define WAKEUP_SYNC          0x00000400
 #define WAKEUP_TIMEOUT       0x00000800
 
+#define BOOT_PHASE_INIT         0   // init(): clocks, timers, RTC, storage
+#define BOOT_PHASE_CONSTRUCTORS 1   // static constructors
+#define BOOT_PHASE_VARIANT      2   // initVariant()
+#define BOOT_PHASE_USB          3   // USBDevice.init()/attach()
+#define BOOT_PHASE_SETUP        4   // setup() returned
+#define BOOT_PHASE_COUNT        5
+
+#define CPU_LOAD_TOTAL          -1   // all but idle
+#define CPU_LOAD_LOOP           STM32L4_LOAD_LOOP
+#define CPU_LOAD_IDLE           STM32L4_LOAD_IDLE
+#define CPU_LOAD_PENDSV         STM32L4_LOAD_PENDSV
+#define CPU_LOAD_PRIORITY(_n)   STM32L4_LOAD_PRIORITY(_n)
+
 #define FLASHSTART           ((uint32_t)(&__FlashBase))
 #define FLASHEND             ((uint32_t)(&__FlashLimit))
 
@@ -62,9 +75,54 @@ public:
     float getVREF();
     float getTemperature();
 
+    // Health monitor. VREFINT, VBAT and the temperature sensor get sampled in the background
+    // every "period" milliseconds (at most 50000) by a timer triggered ADC scan, and the
+    // getters above return the filtered values without touching the ADC. analogRead()
+    // pauses the scan for its conversion, analogReadContinuous() is refused while it runs.
+    // lowBattery() arms the ADC analog watchdog on VBAT: "callback" gets invoked once from
+    // the ADC interrupt when VBAT drops below "threshold" volts. Call it again to re-arm,
+    // or with a NULL "callback" to disarm.
+    bool  beginMonitor(uint32_t period = 1000);
+    void  endMonitor();
+    void  lowBattery(float threshold, void(*callback)(void));
+
+    // CPU load meter. Cycles get attributed to loop (thread mode), idle (SLEEP/STOP),
+    // PendSV and the interrupts of each NVIC priority level (CPU_LOAD_PRIORITY(n)).
+    // cpuLoad() returns the share in percent of the last completed "window" (in ms, at
+    // most 10000) for one context, or for all but idle (CPU_LOAD_TOTAL). It's 0 till
+    // the first window is complete. Costs about 40 cycles per interrupt while running.
+    bool  beginCpuLoad(uint32_t window = 1000);
+    void  endCpuLoad();
+    float cpuLoad(int context = CPU_LOAD_TOTAL);
+
     uint32_t resetCause();
     uint32_t wakeupReason();
 
+    // micros() at the end of a boot phase, 0 if the phase was not reached yet.
+    // Time before SysTick is started (reset, clock and LSE startup) is not included.
+    uint32_t bootTime(unsigned int phase);
+
+    // Main stack (setup(), loop() and all interrupt handlers) and heap usage in bytes.
+    // stackUsed() is the high watermark; stackUsed() == stackSize() means it overflowed.
+    // heapPeak() is the highest break the allocator asked for, or with Tools -> Heap the
+    // most bytes that were allocated at any point in time. stackGuard() traps an
+    // overflow with a MemManage fault (see crashReport()) instead of corrupting the heap.
+    uint32_t stackSize();
+    uint32_t stackUsed();
+    uint32_t heapSize();
+    uint32_t heapUsed();
+    uint32_t heapPeak();
+    void  stackGuard(bool enable);
+
+    // Post-mortem record of the last fault (registers, fault status, stack snippet and
+    // the tail of the trace() ring), retained in SRAM2 across the reset that followed.
+    // Returns false if there is none; the record stays until crashClear() or the next fault.
+    bool  crashReport(stm32l4_crash_report_t &report);
+    void  crashClear();
+
+    // Logs an application defined event into the trace ring that crashReport() picks up.
+    void  trace(uint32_t id, uint32_t data = 0) { stm32l4_crash_trace(id, data); }
+
     void  sleep();
     bool  stop(uint32_t timeout = 0);
     void  standby(uint32_t timeout = 0);
@@ -79,7 +137,28 @@ public:
     bool  flashErase(uint32_t address, uint32_t count);
     bool  flashProgram(uint32_t address, const void *data, uint32_t count);
 
+    // Firmware update from the ".iap" file of a sketch build (copied to DOSFS e.g. via MSC
+    // or WebUSBUpload). The image is checked (VID/PID, MCU, CRC) and staged into the free
+    // flash between FLASHSTART and FLASHEND, whose contents get lost. Then only the pages
+    // that changed are rewritten and the system resets into the new sketch. Returns false,
+    // with the running sketch untouched, if the image is invalid or does not fit.
+    bool  firmwareUpdate(const char *path);
+
+    // Flash prefetch (off by default) speeds up branch heavy code running from flash at
+    // higher clocks, at the cost of some extra current. The wait states always follow the clock.
+    void  flashPrefetch(bool enable);
+
     void  lsco(bool enable);
+
+    // Clock governor. The core runs at "highClock" while there is demand, i.e. between
+    // clockAcquire() and the matching clockRelease(), and steps down to "lowClock" after
+    // "holdoff" milliseconds without demand. A "lowClock" of 0 stops the governor at
+    // "highClock". Running timers (PWM, tone, Servo) keep their rate across a change,
+    // SPI/UART/I2C derive their timing per transaction or from HSI16. Call clockAcquire()
+    // before starting time critical work such as audio output.
+    bool  clockGovernor(uint32_t lowClock, uint32_t highClock, uint32_t holdoff = 100);
+    void  clockAcquire();
+    void  clockRelease();
 };
 
 extern STM32Class STM32;
@@ -68,12 +68,68 @@ int Stream::timedPeek()
   return -1;     // -1 indicates timeout
 }
 
+// private method to step over the current character of parseInt()/parseFloat() and peek at the next
+// one, -1 if timeout. Characters within a span of peekBuffer() are walked without calling read()/peek(),
+// and the span is released once it's exhausted (the caller releases a partially used one).
+int Stream::parseNext(struct ParseSpan *span)
+{
+  if (span->count) {
+    if (++span->index < span->count)
+      return span->data[span->index];
+    consume(span->count);
+  } else {
+    read();  // consume the character we got with peek
+  }
+
+  span->index = 0;
+  span->count = peekBuffer(&span->data);
+
+  if (span->count)
+    return span->data[0];
+
+  return timedPeek();
+}
+
+// returns true if "c" may be skipped while looking for the start of a number
+static inline bool skipNonDigit(int c, LookaheadMode lookahead)
+{
+  switch( lookahead ){
+      case SKIP_NONE: return false;
+      case SKIP_WHITESPACE:
+          return (c == ' ') || (c == '\t') || (c == '\r') || (c == '\n');
+      case SKIP_ALL:
+      default:
+          return true;
+  }
+}
+
 // returns peek of the next digit in the stream or -1 if timeout
 // discards non-numeric characters
 int Stream::peekNextDigit(LookaheadMode lookahead, bool detectDecimal)
 {
+  const uint8_t *data;
+  size_t n, i;
   int c;
   while (1) {
+    n = peekBuffer(&data);
+    if (n) {
+      for (i = 0; i < n; i++) {
+        c = data[i];
+        if( c == '-' ||
+            (c >= '0' && c <= '9') ||
+            (detectDecimal && c == '.')) {
+          consume(i);  // discard non-numeric
+          return c;
+        }
+        if (!skipNonDigit(c, lookahead)) {
+          consume(i);
+          return -1; // Fail code.
+        }
+      }
+      consume(n);  // discard non-numeric
+      continue;
+    }
+
     c = timedPeek();
 
     if( c < 0 ||
@@ -81,19 +137,9 @@ int Stream::peekNextDigit(LookaheadMode lookahead, bool detectDecimal)
         (c >= '0' && c <= '9') ||
         (detectDecimal && c == '.')) return c;
 
-    switch( lookahead ){
-        case SKIP_NONE: return -1; // Fail code.
-        case SKIP_WHITESPACE:
-            switch( c ){
-                case ' ':
-                case '\t':
-                case '\r':
-                case '\n': break;
-                default: return -1; // Fail code.
-            }
-        case SKIP_ALL:
-            break;
-    }
+    if (!skipNonDigit(c, lookahead))
+      return -1; // Fail code.
+
     read();  // discard non-numeric
   }
 }
@@ -146,6 +192,7 @@ bool Stream::findUntil(char *target, size_t targetLen, char *terminator, size_t
 // Once parsing commences, 'ignore' will be skipped in the stream.
 long Stream::parseInt(LookaheadMode lookahead, char ignore)
 {
+  struct ParseSpan span = { NULL, 0, 0 };
   bool isNegative = false;
   long value = 0;
   int c;
@@ -162,11 +209,13 @@ long Stream::parseInt(LookaheadMode lookahead, char ignore)
       isNegative = true;
     else if(c >= '0' && c <= '9')        // is c a digit?
       value = value * 10 + c - '0';
-    read();  // consume the character we got with peek
-    c = timedPeek();
+    c = parseNext(&span);
   }
   while( (c >= '0' && c <= '9') || c == ignore );
 
+  if (span.count)
+    consume(span.index);
+
   if(isNegative)
     value = -value;
   return value;
@@ -175,6 +224,7 @@ long Stream::parseInt(LookaheadMode lookahead, char ignore)
 // as parseInt but returns a floating point value
 float Stream::parseFloat(LookaheadMode lookahead, char ignore)
 {
+  struct ParseSpan span = { NULL, 0, 0 };
   bool isNegative = false;
   bool isFraction = false;
   long value = 0;
@@ -198,11 +248,13 @@ float Stream::parseFloat(LookaheadMode lookahead, char ignore)
       if(isFraction)
          fraction *= 0.1;
     }
-    read();  // consume the character we got with peek
-    c = timedPeek();
+    c = parseNext(&span);
   }
   while( (c >= '0' && c <= '9')  || (c == '.' && !isFraction) || c == ignore );
 
+  if (span.count)
+    consume(span.index);
+
   if(isNegative)
     value = -value;
   if(isFraction)
@@ -240,6 +292,24 @@ size_t Stream::readBytesUntil(char terminator, char *buffer, size_t length)
   if (length < 1) return 0;
   size_t index = 0;
   while (index < length) {
+    const uint8_t *data, *end;
+    size_t n = peekBuffer(&data);
+    if (n) {
+      if (n > (length - index))
+        n = length - index;
+      end = (const uint8_t*)memchr(data, terminator, n);
+      if (end) {
+        memcpy(buffer, data, end - data);
+        index += (end - data);
+        consume((end - data) +1);  // drop the terminator as well
+        break;
+      }
+      memcpy(buffer, data, n);
+      buffer += n;
+      index += n;
+      consume(n);
+      continue;
+    }
     int c = timedRead();
     if (c < 0 || c == terminator) break;
     *buffer++ = (char)c;
@@ -251,11 +321,21 @@ size_t Stream::readBytesUntil(char terminator, char *buffer, size_t length)
 String Stream::readString()
 {
   String ret;
-  int c = timedRead();
-  while (c >= 0)
+  while (1)
   {
+    const uint8_t *data;
+    size_t n = peekBuffer(&data);
+    if (n)
+    {
+      ret.reserve(ret.length() + n);
+      for (size_t i = 0; i < n; i++)
+        ret += (char)data[i];
+      consume(n);
+      continue;
+    }
+    int c = timedRead();
+    if (c < 0) break;
     ret += (char)c;
-    c = timedRead();
   }
   return ret;
 }
@@ -263,11 +343,26 @@ String Stream::readString()
 String Stream::readStringUntil(char terminator)
 {
   String ret;
-  int c = timedRead();
-  while (c >= 0 && c != terminator)
+  while (1)
   {
+    const uint8_t *data, *end;
+    size_t n = peekBuffer(&data);
+    if (n)
+    {
+      end = (const uint8_t*)memchr(data, terminator, n);
+      ret.reserve(ret.length() + (end ? (end - data) : n));
+      for (const uint8_t *p = data; p != (end ? end : &data[n]); p++)
+        ret += (char)*p;
+      if (end) {
+        consume((end - data) +1);  // drop the terminator as well
+        break;
+      }
+      consume(n);
+      continue;
+    }
+    int c = timedRead();
+    if (c < 0 || c == terminator) break;
     ret += (char)c;
-    c = timedRead();
   }
   return ret;
 }
@@ -281,58 +376,89 @@ int Stream::findMulti( struct Stream::MultiTarget *targets, int tCount) {
   }
 
   while (1) {
+    const uint8_t *data, *next;
+    size_t n = peekBuffer(&data);
+    if (n) {
+      for (size_t i = 0; i < n; i++) {
+        // with a single target and no partial match, skip straight to its first character
+        if ((tCount == 1) && (targets->index == 0)) {
+          next = (const uint8_t*)memchr(&data[i], targets->str[0], n - i);
+          if (!next)
+            break;
+          i = next - data;
+        }
+
+        int found = findMultiMatch(targets, tCount, data[i]);
+        if (found >= 0) {
+          consume(i + 1);
+          return found;
+        }
+      }
+      consume(n);
+      continue;
+    }
+
     int c = timedRead();
     if (c < 0)
       return -1;
 
-    for (struct MultiTarget *t = targets; t < targets+tCount; ++t) {
-      // the simple case is if we match, deal with that first.
-      if (c == t->str[t->index]) {
-        if (++t->index == t->len)
-          return t - targets;
-        else
-          continue;
-      }
+    int found = findMultiMatch(targets, tCount, c);
+    if (found >= 0)
+      return found;
+  }
+  // unreachable
+  return -1;
+}
 
-      // if not we need to walk back and see if we could have matched further
-      // down the stream (ie '1112' doesn't match the first position in '11112'
-      // but it will match the second position so we can't just reset the current
-      // index to 0 when we find a mismatch.
-      if (t->index == 0)
+// private method to advance the targets of findMulti() by one character "c",
+// returns the index of a target that is now completely matched or -1
+int Stream::findMultiMatch( struct Stream::MultiTarget *targets, int tCount, int c) {
+  for (struct MultiTarget *t = targets; t < targets+tCount; ++t) {
+    // the simple case is if we match, deal with that first.
+    if (c == t->str[t->index]) {
+      if (++t->index == t->len)
+        return t - targets;
+      else
         continue;
+    }
 
-      int origIndex = t->index;
-      do {
-        --t->index;
-        // first check if current char works against the new current index
-        if (c != t->str[t->index])
-          continue;
-
-        // if it's the only char then we're good, nothing more to check
-        if (t->index == 0) {
-          t->index++;
-          break;
-        }
+    // if not we need to walk back and see if we could have matched further
+    // down the stream (ie '1112' doesn't match the first position in '11112'
+    // but it will match the second position so we can't just reset the current
+    // index to 0 when we find a mismatch.
+    if (t->index == 0)
+      continue;
+
+    int origIndex = t->index;
+    do {
+      --t->index;
+      // first check if current char works against the new current index
+      if (c != t->str[t->index])
+        continue;
 
-        // otherwise we need to check the rest of the found string
-        int diff = origIndex - t->index;
-        size_t i;
-        for (i = 0; i < t->index; ++i) {
-          if (t->str[i] != t->str[i + diff])
-            break;
-        }
+      // if it's the only char then we're good, nothing more to check
+      if (t->index == 0) {
+        t->index++;
+        break;
+      }
 
-        // if we successfully got through the previous loop then our current
-        // index is good.
-        if (i == t->index) {
-          t->index++;
+      // otherwise we need to check the rest of the found string
+      int diff = origIndex - t->index;
+      size_t i;
+      for (i = 0; i < t->index; ++i) {
+        if (t->str[i] != t->str[i + diff])
           break;
-        }
+      }
 
-        // otherwise we just try the next index
-      } while (t->index);
-    }
+      // if we successfully got through the previous loop then our current
+      // index is good.
+      if (i == t->index) {
+        t->index++;
+        break;
+      }
+
+      // otherwise we just try the next index
+    } while (t->index);
   }
-  // unreachable
   return -1;
 }
@@ -63,6 +63,13 @@ class Stream : public Print
 
     virtual size_t read(uint8_t *buffer, size_t size);
 
+    // STM32L4 EXTENSION: zero-copy read, "*ptr" is set to the next contiguous span of received
+    // data (the returned number of bytes), which stays valid till released via consume(n).
+    // The default implementation returns 0 (no span available), in which case the parsing
+    // methods below fall back to per-byte read()/peek() calls.
+    virtual size_t peekBuffer(const uint8_t **ptr) { return 0; }
+    virtual void consume(size_t size) { }
+
     Stream() {_timeout=1000;}
 
 // parsing methods
@@ -126,6 +133,16 @@ class Stream : public Print
   // This allows you to search for an arbitrary number of strings.
   // Returns index of the target that is found first or -1 if timeout occurs.
   int findMulti(struct MultiTarget *targets, int tCount);
+
+  private:
+  struct ParseSpan {
+    const uint8_t *data;  // span returned by peekBuffer(), if "count" is not 0
+    size_t count;
+    size_t index;         // position of the current character within the span
+  };
+
+  int parseNext(struct ParseSpan *span);
+  static int findMultiMatch(struct MultiTarget *targets, int tCount, int c);
 };
 
 #undef NO_IGNORE_CHAR
@@ -40,6 +40,8 @@
 #define USB_TYPE_CDC_MSC_DAP 6
 #define USB_TYPE_CDC_WEBUSB  7
 #define USB_TYPE_CDC_MSC_WEBUSB 8
+#define USB_TYPE_CDC_AUDIO   9
+#define USB_TYPE_CDC_MIDI    10
 
 #if (USB_TYPE == USB_TYPE_CDC)
 #define USB_CLASS USBD_CDC_Initialize
@@ -83,6 +85,16 @@
 #define USB_CLASS_MSC
 #define USB_CLASS_WEBUSB
 #endif
+#if (USB_TYPE == USB_TYPE_CDC_AUDIO)
+#define USB_CLASS USBD_CDC_AUDIO_Initialize
+#define USB_CLASS_CDC
+#define USB_CLASS_AUDIO
+#endif
+#if (USB_TYPE == USB_TYPE_CDC_MIDI)
+#define USB_CLASS USBD_CDC_MIDI_Initialize
+#define USB_CLASS_CDC
+#define USB_CLASS_MIDI
+#endif
 
 #ifdef USB_CLASS_WEBUSB
 
@@ -117,8 +129,16 @@ public:
     bool configured();
     bool suspended();
 
+    // SOF time base: number of SOFs (1ms frames) seen, drift of the local clock
+    // against the host in ppb (positive if the local clock runs fast), and
+    // microseconds in host time
+    uint32_t frameCount();
+    int32_t clockDrift();
+    uint64_t hostMicros();
+
 private:
     bool initialized;
+    bool attached;
 };
 
 extern USBDeviceClass USBDevice;
@@ -131,6 +151,10 @@ class CDC_BASE : public HardwareSerial
 public:
     void begin(unsigned long baudRate);
     void begin(unsigned long baudrate, uint16_t config);
+    // STM32L4 EXTENSTION: high throughput mode with user supplied buffers. "txsize" needs to be
+    // a power of 2, each IN transfer then carries up to "txsize / 2" bytes (multiple packets),
+    // and zero length packets get enabled. "rxsize" needs to be at least 2 packets (128 bytes).
+    bool begin(unsigned long baudrate, uint8_t *txbuf, size_t txsize, uint8_t *rxbuf, size_t rxsize);
     void end(void);
 
     int available(void);
@@ -171,33 +195,67 @@ public:
     // STM32L4 EXTENSTION: non-blocking multi-byte read
     size_t read(uint8_t *buffer, size_t size);
 
+    // STM32L4 EXTENSTION: zero-copy read, "*ptr" is set to the next contiguous span of received
+    // data (the returned number of bytes), which stays valid till released via consume(n)
+    size_t peekBuffer(const uint8_t **ptr);
+    void consume(size_t size);
+
     // STM32L4 EXTENSTION: asynchronous write with callback
     bool write(const uint8_t *buffer, size_t size, void(*callback)(void));
     bool done(void);
 
+    // STM32L4 EXTENSTION: asynchronous scatter-gather write, queues "count" descriptors (all
+    // or none) which are sent back-to-back without copying; each callback gets called once
+    // its descriptor has been sent. Up to SERIAL_TX_QUEUE_SIZE descriptors can be pending.
+    bool writev(const struct SerialTxDescriptor *vec, unsigned int count);
+
     // STM32L4 EXTENSTION: asynchronous receive
     void onReceive(void(*callback)(void));
 
     // STM32L4 EXTENSTION: enable/disabe blocking writes
     void blockOnOverrun(bool enable);
 
+    // STM32L4 EXTENSTION: terminate IN transfers that end on a packet boundary with a zero
+    // length packet, so that the host returns the data right away
+    void zeroLengthPacket(bool enable);
+
+    // STM32L4 EXTENSTION: small writes are collected and sent at the start of the next
+    // "frames" USB frame (1ms each, default 1), a full packet goes out right away.
+    // flush() sends what's collected without waiting.
+    void setTxLatency(unsigned int frames);
+
 protected:
     struct  _stm32l4_usbd_cdc_t _usbd_cdc;
     bool _blocking;
-    uint8_t _rx_data[CDC_RX_BUFFER_SIZE];
-    uint8_t _tx_data[CDC_TX_BUFFER_SIZE];
+    bool _tx_zlp;
+    volatile uint8_t _tx_zlp_busy;
+    uint8_t _rx_fifo[CDC_RX_BUFFER_SIZE];
+    uint8_t _tx_fifo[CDC_TX_BUFFER_SIZE];
+    uint8_t *_rx_data;
+    uint16_t _rx_size;
+    uint8_t *_tx_data;
+    uint16_t _tx_buffer;
+    uint16_t _tx_packet;
     volatile uint16_t _tx_write;
     volatile uint16_t _tx_read;
     volatile uint32_t _tx_count;
     volatile uint32_t _tx_size;
 
-    const uint8_t *_tx_data2;
-    volatile uint32_t _tx_size2;
+    struct SerialTxDescriptor _tx_queue[SERIAL_TX_QUEUE_SIZE];
+    volatile uint8_t _tx_queue_read;
+    volatile uint8_t _tx_queue_write;
+    volatile uint32_t _tx_queue_count;
 
     volatile uint32_t _tx_timeout;
+    uint8_t _tx_latency;
 
-    void (*_completionCallback)(void);
     void (*_receiveCallback)(void);
+    armv7m_pendsv_job_t _receiveJob;
+
+    void _init(void);
+    bool _transmit(void);
+    void _transmitPending(void);
+    bool _transmitQueue(void);
 
     static void _event_callback(void *context, uint32_t events);
     void EventCallback(uint32_t events);
@@ -302,3 +360,39 @@ private:
 };
 
 extern KeyboardClass Keyboard;
+
+#define GAMEPAD_AXIS_X		0
+#define GAMEPAD_AXIS_Y		1
+#define GAMEPAD_AXIS_Z		2
+#define GAMEPAD_AXIS_RX		3
+#define GAMEPAD_AXIS_RY		4
+#define GAMEPAD_AXIS_RZ		5
+#define GAMEPAD_AXIS_COUNT	6
+
+//	Gamepad report: 32 buttons and 6 axes (-32767 .. 32767)
+typedef struct
+{
+    uint32_t buttons;
+    int16_t axis[GAMEPAD_AXIS_COUNT];
+} __attribute__((packed)) GamepadReport;
+
+// press()/release()/buttons()/setAxis() only update the report, send() hands it
+// to the host. A report that is still queued when send() is called again gets
+// replaced, so the host always sees the latest state at the 1ms polling rate.
+class GamepadClass
+{
+public:
+    GamepadClass(void);
+    void begin(void);
+    void end(void);
+    void press(uint8_t b);			// 1 .. 32
+    void release(uint8_t b);
+    void buttons(uint32_t b);
+    bool isPressed(uint8_t b);
+    void setAxis(unsigned int axis, int16_t value);
+    void send(void);
+private:
+    GamepadReport _report;
+};
+
+extern GamepadClass Gamepad;
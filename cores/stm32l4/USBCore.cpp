@@ -39,6 +39,10 @@ void USBDeviceClass::init()
 
 #if (USB_TYPE == USB_TYPE_CDC_DAP) || (USB_TYPE == USB_TYPE_CDC_MSC_DAP)
     stm32l4_usbd_dap_initialize(STM32L4_CONFIG_DAP_SWCLK, STM32L4_CONFIG_DAP_SWDIO);
+
+#if defined(STM32L4_CONFIG_DAP_SWO)
+    stm32l4_usbd_dap_swo_initialize(STM32L4_CONFIG_DAP_SWO_INSTANCE, STM32L4_CONFIG_DAP_SWO, STM32L4_UART_IRQ_PRIORITY);
+#endif
 #endif
 #endif
 
@@ -51,7 +55,15 @@ bool USBDeviceClass::attach()
     if (!initialized)
 	return false;
 
-    USBD_Attach();
+    if (!attached) {
+	/* The storage has to be up before MSC is exposed to the host.
+	 */
+	initStorage();
+
+	USBD_Attach();
+
+	attached = true;
+    }
 
     return true;
 #else
@@ -67,6 +79,8 @@ bool USBDeviceClass::detach()
 
     USBD_Detach();
 
+    attached = false;
+
     return true;
 #else
     return false;
@@ -97,6 +111,21 @@ bool USBDeviceClass::suspended()
     return USBD_Suspended();
 }
 
+uint32_t USBDeviceClass::frameCount()
+{
+    return USBD_FrameCount();
+}
+
+int32_t USBDeviceClass::clockDrift()
+{
+    return USBD_ClockDrift();
+}
+
+uint64_t USBDeviceClass::hostMicros()
+{
+    return USBD_HostMicros();
+}
+
 USBDeviceClass USBDevice;
 
 extern "C" {
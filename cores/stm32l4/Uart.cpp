@@ -38,16 +38,23 @@ Uart::Uart(struct _stm32l4_uart_t *uart, unsigned int instance, const struct _st
 
     _blocking = true;
 
+    _rx_buffer = NULL;
+    _rx_buffer_size = 0;
+
     _tx_read = 0;
     _tx_write = 0;
     _tx_count = 0;
     _tx_size = 0;
 
-    _tx_data2 = NULL;
-    _tx_size2 = 0;
+    _tx_queue_read = 0;
+    _tx_queue_write = 0;
+    _tx_queue_count = 0;
+
+    _frame = false;
+    _frameCallback = NULL;
   
-    _completionCallback = NULL;
     _receiveCallback = NULL;
+    armv7m_pendsv_job_create(&_receiveJob, NULL, NULL, ARMV7M_PENDSV_PRIORITY_LOW);
 
     stm32l4_uart_create(uart, instance, pins, priority, mode);
 
@@ -58,12 +65,16 @@ Uart::Uart(struct _stm32l4_uart_t *uart, unsigned int instance, const struct _st
 
 void Uart::begin(unsigned long baudrate)
 {
-    begin(baudrate, SERIAL_8N1, &_rx_data[0], sizeof(_rx_data));
+    begin(baudrate, SERIAL_8N1);
 }
 
 void Uart::begin(unsigned long baudrate, uint16_t config)
 {
-    begin(baudrate, config, &_rx_data[0], sizeof(_rx_data));
+    if (_rx_buffer) {
+	begin(baudrate, config, _rx_buffer, _rx_buffer_size);
+    } else {
+	begin(baudrate, config, &_rx_data[0], sizeof(_rx_data));
+    }
 }
 
 void Uart::begin(unsigned long baudrate, uint8_t *buffer, size_t size)
@@ -73,12 +84,32 @@ void Uart::begin(unsigned long baudrate, uint8_t *buffer, size_t size)
 
 void Uart::begin(unsigned long baudrate, uint16_t config, uint8_t *buffer, size_t size)
 {
+    uint32_t option;
+
+    // HARDSER_PARITY_* and HARDSER_STOP_BIT_* sit in swapped nibbles relative to
+    // UART_OPTION_PARITY_* and UART_OPTION_STOP_*.
+    option = (((config & HARDSER_PARITY_MASK) << 4) |
+	      ((config & HARDSER_STOP_BIT_MASK) >> 4) |
+	      (config & HARDSER_DATA_MASK));
+
+    if (config & SERIAL_WAKEUP) {
+	option |= UART_OPTION_WAKEUP;
+    }
+
     if (_uart->state != UART_STATE_INIT) {
 	flush();
 	stm32l4_uart_disable(_uart);
     }
 
-    stm32l4_uart_enable(_uart, buffer, size, baudrate, config, Uart::_event_callback, (void*)this, (UART_EVENT_RECEIVE | UART_EVENT_TRANSMIT));
+    if (size > 65535) {
+	size = 65535;
+    }
+
+    if (size >= UART_RX_DMA_CIRCULAR_SIZE) {
+	option |= UART_OPTION_RX_DMA_CIRCULAR;
+    }
+
+    stm32l4_uart_enable(_uart, buffer, size, baudrate, option, Uart::_event_callback, (void*)this, (UART_EVENT_RECEIVE | UART_EVENT_TRANSMIT));
 }
 
 void Uart::end()
@@ -99,7 +130,7 @@ int Uart::availableForWrite()
 	return 0;
     }
 
-    if (_tx_size2 != 0) {
+    if (_tx_queue_count != 0) {
 	return 0;
     }
 
@@ -129,14 +160,24 @@ size_t Uart::read(uint8_t *buffer, size_t size)
     return stm32l4_uart_receive(_uart, buffer, size);
 }
 
+size_t Uart::peekBuffer(const uint8_t **ptr)
+{
+    return stm32l4_uart_peek_buffer(_uart, ptr);
+}
+
+void Uart::consume(size_t size)
+{
+    stm32l4_uart_consume(_uart, (size > 65535) ? 65535 : size);
+}
+
 void Uart::flush()
 {
     if (armv7m_core_priority() <= STM32L4_UART_IRQ_PRIORITY) {
-	while ((_tx_count != 0) || (_tx_size2 != 0) || !stm32l4_uart_done(_uart)) {
+	while ((_tx_count != 0) || (_tx_queue_count != 0) || !stm32l4_uart_done(_uart)) {
 	    stm32l4_uart_poll(_uart);
 	}
     } else {
-	while ((_tx_count != 0) || (_tx_size2 != 0) || !stm32l4_uart_done(_uart)) {
+	while ((_tx_count != 0) || (_tx_queue_count != 0) || !stm32l4_uart_done(_uart)) {
 	    armv7m_core_yield();
 	}
     }
@@ -160,12 +201,12 @@ size_t Uart::write(const uint8_t *buffer, size_t size)
 	return 0;
     }
 
-    if (_tx_size2 != 0) {
+    if (_tx_queue_count != 0) {
 	if (!_blocking || (__get_IPSR() != 0)) {
 	    return 0;
 	}
 	
-	while (_tx_size2 != 0) {
+	while (_tx_queue_count != 0) {
 	    armv7m_core_yield();
 	}
     }
@@ -248,24 +289,72 @@ size_t Uart::write(const uint8_t *buffer, size_t size)
 
 bool Uart::write(const uint8_t *buffer, size_t size, void(*callback)(void))
 {
+    struct SerialTxDescriptor desc;
+
+    desc.data = buffer;
+    desc.size = size;
+    desc.callback = callback;
+
+    return writev(&desc, 1);
+}
+
+bool Uart::writev(const struct SerialTxDescriptor *vec, unsigned int count)
+{
+    unsigned int index, tx_write;
+
     if (_uart->state < UART_STATE_READY) {
 	return false;
     }
 
-    if (size == 0) {
+    if ((count == 0) || (count > (SERIAL_TX_QUEUE_SIZE - _tx_queue_count))) {
 	return false;
     }
 
-    if (_tx_size2 != 0) {
-	return false;
+    for (index = 0; index < count; index++) {
+	if ((vec[index].size == 0) || (vec[index].size > 65535)) {
+	    return false;
+	}
+    }
+
+    tx_write = _tx_queue_write;
+
+    for (index = 0; index < count; index++) {
+	_tx_queue[tx_write] = vec[index];
+
+	tx_write = (tx_write + 1) & (SERIAL_TX_QUEUE_SIZE -1);
     }
 
-    _completionCallback = callback;
-    _tx_data2 = buffer;
-    _tx_size2 = size;
+    _tx_queue_write = tx_write;
 
+    armv7m_atomic_add(&_tx_queue_count, count);
+
+    /* If the UART is busy, EventCallback() picks up the queue once the TX ring
+     * and the descriptors ahead have been sent.
+     */
     if (stm32l4_uart_done(_uart)) {
-	stm32l4_uart_transmit(_uart, _tx_data2, _tx_size2);
+	stm32l4_uart_transmit(_uart, _tx_queue[_tx_queue_read].data, _tx_queue[_tx_queue_read].size);
+    }
+
+    return true;
+}
+
+bool Uart::writeFrame(const uint8_t *buffer, size_t size, unsigned long breakBaudrate, void(*callback)(void))
+{
+    if ((size == 0) || (size > 65535)) {
+	return false;
+    }
+
+    if (!done()) {
+	return false;
+    }
+
+    _frameCallback = callback;
+    _frame = true;
+
+    if (!stm32l4_uart_transmit_frame(_uart, buffer, size, breakBaudrate)) {
+	_frame = false;
+
+	return false;
     }
 
     return true;
@@ -273,11 +362,15 @@ bool Uart::write(const uint8_t *buffer, size_t size, void(*callback)(void))
 
 bool Uart::done()
 {
+    if (_frame) {
+	return false;
+    }
+
     if (_tx_count) {
 	return false;
     }
 
-    if (_tx_size2) {
+    if (_tx_queue_count) {
 	return false;
     }
 
@@ -291,6 +384,7 @@ bool Uart::done()
 void Uart::onReceive(void(*callback)(void))
 {
     _receiveCallback = callback;
+    _receiveJob.routine = (armv7m_pendsv_routine_t)callback;
 }
 
 void Uart::blockOnOverrun(bool block)
@@ -298,18 +392,86 @@ void Uart::blockOnOverrun(bool block)
     _blocking = block;
 }
 
+size_t Uart::setRxBufferSize(size_t size)
+{
+    uint8_t *buffer;
+
+    if (_uart->state != UART_STATE_INIT) {
+	return 0;
+    }
+
+    if (size > 65535) {
+	size = 65535;
+    }
+
+    if (size <= UART_RX_BUFFER_SIZE) {
+	if (_rx_buffer) {
+	    free(_rx_buffer);
+	}
+
+	_rx_buffer = NULL;
+	_rx_buffer_size = 0;
+
+	return UART_RX_BUFFER_SIZE;
+    }
+
+    buffer = (uint8_t*)realloc(_rx_buffer, size);
+
+    if (!buffer) {
+	return 0;
+    }
+
+    _rx_buffer = buffer;
+    _rx_buffer_size = size;
+
+    return size;
+}
+
 void Uart::EventCallback(uint32_t events)
 {
     unsigned int tx_read, tx_size;
+    void (*callback)(void);
 
     if (events & UART_EVENT_RECEIVE) {
 	if (_receiveCallback) {
-	    armv7m_pendsv_enqueue((armv7m_pendsv_routine_t)_receiveCallback, NULL, 0);
+	    armv7m_pendsv_job_post(&_receiveJob, 0);
 	}
+
+	loopWakeup();
     }
 
     if (events & UART_EVENT_TRANSMIT) {
 
+	if (_frame) {
+	    _frame = false;
+
+	    if (_frameCallback) {
+		armv7m_pendsv_enqueue((armv7m_pendsv_routine_t)_frameCallback, NULL, 0);
+	    }
+
+	    // Pick up what write() or writev() queued up behind the frame.
+	    if (_tx_count != 0) {
+		tx_size = _tx_count;
+		tx_read = _tx_read;
+
+		if (tx_size > (UART_TX_BUFFER_SIZE - tx_read)) {
+		    tx_size = (UART_TX_BUFFER_SIZE - tx_read);
+		}
+	  
+		if (tx_size > UART_TX_PACKET_SIZE) {
+		    tx_size = UART_TX_PACKET_SIZE;
+		}
+	  
+		_tx_size = tx_size;
+	  
+		stm32l4_uart_transmit(_uart, &_tx_data[tx_read], tx_size);
+	    } else if (_tx_queue_count != 0) {
+		stm32l4_uart_transmit(_uart, _tx_queue[_tx_queue_read].data, _tx_queue[_tx_queue_read].size);
+	    }
+
+	    return;
+	}
+
 	tx_size = _tx_size;
 
 	if (tx_size != 0) {
@@ -335,18 +497,25 @@ void Uart::EventCallback(uint32_t events)
 	  
 		stm32l4_uart_transmit(_uart, &_tx_data[tx_read], tx_size);
 	    } else {
-		if (_tx_size2 != 0) {
-		    stm32l4_uart_transmit(_uart, _tx_data2, _tx_size2);
+		if (_tx_queue_count != 0) {
+		    stm32l4_uart_transmit(_uart, _tx_queue[_tx_queue_read].data, _tx_queue[_tx_queue_read].size);
 		}
 	    }
-	} else {
-	    _tx_size2 = 0;
-	    _tx_data2 = NULL;
+	} else if (_tx_queue_count != 0) {
+	    tx_read = _tx_queue_read;
+
+	    callback = _tx_queue[tx_read].callback;
 
-	    if (_completionCallback) {
-		armv7m_pendsv_enqueue((armv7m_pendsv_routine_t)_completionCallback, NULL, 0);
+	    _tx_queue_read = (tx_read + 1) & (SERIAL_TX_QUEUE_SIZE -1);
+
+	    armv7m_atomic_sub(&_tx_queue_count, 1);
+
+	    if (callback) {
+		armv7m_pendsv_enqueue((armv7m_pendsv_routine_t)callback, NULL, 0);
+	    }
 
-		_completionCallback = NULL;
+	    if (_tx_queue_count != 0) {
+		stm32l4_uart_transmit(_uart, _tx_queue[_tx_queue_read].data, _tx_queue[_tx_queue_read].size);
 	    }
 	}
     }
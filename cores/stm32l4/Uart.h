@@ -33,6 +33,8 @@
 #define UART_RX_BUFFER_SIZE 64
 #define UART_TX_BUFFER_SIZE 64
 
+#define UART_RX_DMA_CIRCULAR_SIZE 256
+
 class Uart : public HardwareSerial
 {
 public:
@@ -56,31 +58,60 @@ public:
     // STM32L4 EXTENSTION: non-blocking multi-byte read
     size_t read(uint8_t *buffer, size_t size);
 
+    // STM32L4 EXTENSTION: zero-copy read, "*ptr" is set to the next contiguous span of received
+    // data (the returned number of bytes), which stays valid till released via consume(n)
+    size_t peekBuffer(const uint8_t **ptr);
+    void consume(size_t size);
+
     // STM32L4 EXTENSTION: asynchronous write with callback
     bool write(const uint8_t *buffer, size_t size, void(*callback)(void));
     bool done(void);
 
+    // STM32L4 EXTENSTION: asynchronous scatter-gather write, queues "count" descriptors (all
+    // or none) which are sent back-to-back without copying; each callback gets called once
+    // its descriptor has been sent. Up to SERIAL_TX_QUEUE_SIZE descriptors can be pending.
+    bool writev(const struct SerialTxDescriptor *vec, unsigned int count);
+
+    // STM32L4 EXTENSTION: break framed write (DMX512 style), the break and mark-after-break
+    // are one 0x00 character at "breakBaudrate", followed by "buffer" at the begin() baudrate.
+    // Fails unless done(); "callback" (if not NULL) gets called once the frame has been sent.
+    bool writeFrame(const uint8_t *buffer, size_t size, unsigned long breakBaudrate, void(*callback)(void));
+
     // STM32L4 EXTENSTION: asynchronous receive
     void onReceive(void(*callback)(void));
 
     // STM32L4 EXTENSTION: enable/disabe blocking writes
     void blockOnOverrun(bool enable);
 
+    // STM32L4 EXTENSTION: allocate a receive buffer of "size" bytes for begin(baudrate) and
+    // begin(baudrate, config); has to be called before begin(), returns the size or 0.
+    // Receive buffers of UART_RX_DMA_CIRCULAR_SIZE bytes and more are filled directly by
+    // a circular DMA on ports with RX DMA, and onReceive() gets called on DMA half/full
+    // and on IDLE line.
+    size_t setRxBufferSize(size_t size);
+
 private:
     struct _stm32l4_uart_t *_uart;
     bool _blocking;
     uint8_t _rx_data[UART_RX_BUFFER_SIZE];
+    uint8_t *_rx_buffer;
+    size_t _rx_buffer_size;
     uint8_t _tx_data[UART_TX_BUFFER_SIZE];
     volatile uint16_t _tx_write;
     volatile uint16_t _tx_read;
     volatile uint32_t _tx_count;
     volatile uint32_t _tx_size;
 
-    const uint8_t *_tx_data2;
-    volatile uint32_t _tx_size2;
+    struct SerialTxDescriptor _tx_queue[SERIAL_TX_QUEUE_SIZE];
+    volatile uint8_t _tx_queue_read;
+    volatile uint8_t _tx_queue_write;
+    volatile uint32_t _tx_queue_count;
+
+    volatile bool _frame;
+    void (*_frameCallback)(void);
 
-    void (*_completionCallback)(void);
     void (*_receiveCallback)(void);
+    armv7m_pendsv_job_t _receiveJob;
 
     static void _event_callback(void *context, uint32_t events);
     void EventCallback(uint32_t events);
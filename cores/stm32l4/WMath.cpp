@@ -20,13 +20,146 @@ extern "C" {
   #include "stdlib.h"
   #include "stdint.h"
 }
+#include "Arduino.h"
+#include "stm32l4_wiring_private.h"
+#include "stm32l4_rng.h"
 #include "WMath.h"
 
+// xoshiro128** (Blackman/Vigna). Unless randomSeed() is called first, the state is
+// seeded from the RNG unit on first use (or, if that does not deliver within 1ms, as
+// when called from an interrupt at or above the RNG priority, from the cycle counter
+// and the UID). randomSeed() expands its seed via splitmix32, so that a given seed
+// still yields a given sequence.
+static uint32_t randomState[4];
+static volatile bool randomSeeded = false;
+
+// Priority ceiling of random()/randomSeed(), which may be called from attachInterrupt()
+// callbacks, but not from more urgent handlers.
+#define RANDOM_CRITICAL_PRIORITY STM32L4_EXTI_IRQ_PRIORITY
+
+static uint32_t randomSplitMix( uint32_t *p_x )
+{
+  uint32_t z;
+
+  z = (*p_x += 0x9e3779b9);
+  z = (z ^ (z >> 16)) * 0x85ebca6b;
+  z = (z ^ (z >> 13)) * 0xc2b2ae35;
+
+  return z ^ (z >> 16);
+}
+
+static void randomInit( void )
+{
+  uint32_t seed[4], start, x;
+  unsigned int count;
+
+  stm32l4_rng_enable(STM32L4_RNG_IRQ_PRIORITY);
+
+  start = armv7m_systick_cycles();
+
+  for (count = 0; count < 4; )
+  {
+    if (stm32l4_rng_read(&seed[count]))
+    {
+      count++;
+    }
+    else
+    {
+      if ((armv7m_systick_cycles() - start) > (SystemCoreClock / 1000))
+      {
+        break;
+      }
+    }
+  }
+
+  x = armv7m_systick_cycles() ^ ((const uint32_t*)UID_BASE)[0] ^ ((const uint32_t*)UID_BASE)[1] ^ ((const uint32_t*)UID_BASE)[2];
+
+  for (; count < 4; count++)
+  {
+    seed[count] = randomSplitMix(&x);
+  }
+
+  if (!(seed[0] | seed[1] | seed[2] | seed[3]))
+  {
+    seed[0] = 1;
+  }
+
+  randomState[0] = seed[0];
+  randomState[1] = seed[1];
+  randomState[2] = seed[2];
+  randomState[3] = seed[3];
+
+  randomSeeded = true;
+}
+
+static uint32_t randomNext( void )
+{
+  uint32_t basepri, result, t;
+
+  if ( !randomSeeded )
+  {
+    randomInit();
+  }
+
+  basepri = armv7m_critical_enter(RANDOM_CRITICAL_PRIORITY);
+
+  result = randomState[1] * 5;
+  result = ((result << 7) | (result >> 25)) * 9;
+
+  t = randomState[1] << 9;
+
+  randomState[2] ^= randomState[0];
+  randomState[3] ^= randomState[1];
+  randomState[1] ^= randomState[2];
+  randomState[0] ^= randomState[3];
+  randomState[2] ^= t;
+  randomState[3] = (randomState[3] << 11) | (randomState[3] >> 21);
+
+  armv7m_critical_leave(basepri);
+
+  return result;
+}
+
+// Unbiased [0, range) via a 32x32 -> 64 bit multiply (Lemire), rejecting the few
+// low products that would favor some results.
+static uint32_t randomRange( uint32_t range )
+{
+  uint64_t m;
+  uint32_t t;
+
+  m = (uint64_t)randomNext() * range;
+
+  if ( (uint32_t)m < range )
+  {
+    t = -range % range;
+
+    while ( (uint32_t)m < t )
+    {
+      m = (uint64_t)randomNext() * range;
+    }
+  }
+
+  return (uint32_t)(m >> 32);
+}
+
 extern void randomSeed( uint32_t dwSeed )
 {
+  uint32_t basepri, x;
+
   if ( dwSeed != 0 )
   {
-    srand( dwSeed ) ;
+    x = dwSeed;
+
+    basepri = armv7m_critical_enter(RANDOM_CRITICAL_PRIORITY);
+
+    randomState[0] = randomSplitMix(&x);
+    randomState[1] = randomSplitMix(&x);
+    randomState[2] = randomSplitMix(&x);
+    randomState[3] = randomSplitMix(&x);
+
+    randomSeeded = true;
+
+    armv7m_critical_leave(basepri);
   }
 }
 
@@ -37,7 +170,8 @@ extern long random( long howbig )
     return 0 ;
   }
 
-  return rand() % howbig;
+  // Like "rand() % howbig" a negative "howbig" yields [0, -howbig)
+  return randomRange((howbig < 0) ? -(uint32_t)howbig : (uint32_t)howbig);
 }
 
 extern long random( long howsmall, long howbig )
@@ -47,9 +181,7 @@ extern long random( long howsmall, long howbig )
     return howsmall;
   }
 
-  long diff = howbig - howsmall;
-
-  return random(diff) + howsmall;
+  return (long)((uint32_t)howsmall + randomRange((uint32_t)howbig - (uint32_t)howsmall));
 }
 
 extern long map(long x, long in_min, long in_max, long out_min, long out_max)
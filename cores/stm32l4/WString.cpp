@@ -123,7 +123,7 @@ String::String(double value, unsigned char decimalPlaces)
 
 String::~String()
 {
-	free(buffer);
+	release();
 }
 
 /*********************************************/
@@ -135,11 +135,19 @@ inline void String::init(void)
 	buffer = NULL;
 	capacity = 0;
 	len = 0;
+	flags = 0;
+}
+
+void String::release(void)
+{
+	// inline and arena storage is not from the heap
+	if (buffer && buffer != sso && !(flags & STRING_FLAG_ARENA_BUFFER)) free(buffer);
+	flags &= ~STRING_FLAG_ARENA_BUFFER;
 }
 
 void String::invalidate(void)
 {
-	if (buffer) free(buffer);
+	release();
 	buffer = NULL;
 	capacity = len = 0;
 }
@@ -156,7 +164,40 @@ unsigned char String::reserve(unsigned int size)
 
 unsigned char String::changeBuffer(unsigned int maxStrLen)
 {
-	char *newbuffer = (char *)realloc(buffer, maxStrLen + 1);
+	char *newbuffer;
+
+	if (!buffer && maxStrLen < STRING_SSO_SIZE) {
+		buffer = sso;
+		capacity = STRING_SSO_SIZE - 1;
+		return 1;
+	}
+
+	if ((flags & STRING_FLAG_TEMPORARY) && StringArena::_current) {
+		newbuffer = StringArena::_current->reallocate((flags & STRING_FLAG_ARENA_BUFFER) ? buffer : NULL, maxStrLen + 1);
+		if (newbuffer) {
+			if (buffer && newbuffer != buffer) memcpy(newbuffer, buffer, len + 1);
+			release();
+			buffer = newbuffer;
+			capacity = maxStrLen;
+			flags |= STRING_FLAG_ARENA_BUFFER;
+			return 1;
+		}
+	}
+
+	// inline and arena storage cannot be passed to realloc()
+	if (buffer == sso || (flags & STRING_FLAG_ARENA_BUFFER)) {
+		newbuffer = (char *)malloc(maxStrLen + 1);
+		if (newbuffer) {
+			memcpy(newbuffer, buffer, len + 1);
+			flags &= ~STRING_FLAG_ARENA_BUFFER;
+			buffer = newbuffer;
+			capacity = maxStrLen;
+			return 1;
+		}
+		return 0;
+	}
+
+	newbuffer = (char *)realloc(buffer, maxStrLen + 1);
 	if (newbuffer) {
 		buffer = newbuffer;
 		capacity = maxStrLen;
@@ -165,6 +206,45 @@ unsigned char String::changeBuffer(unsigned int maxStrLen)
 	return 0;
 }
 
+/*********************************************/
+/*  Arena                                    */
+/*********************************************/
+
+StringArena *StringArena::_current = NULL;
+
+StringArena::StringArena(void *buffer, size_t size)
+{
+	_data = (char *)buffer;
+	_size = size;
+	_used = 0;
+	_last = size;
+	_previous = _current;
+	_current = this;
+}
+
+StringArena::~StringArena(void)
+{
+	_current = _previous;
+}
+
+char *StringArena::reallocate(char *p, size_t size)
+{
+	size_t offset;
+
+	// the most recent allocation can grow in place
+	if (p && p == (_data + _last)) {
+		if (size > (_size - _last)) return NULL;
+		_used = _last + size;
+		return p;
+	}
+
+	offset = (_used + 3) & ~3;
+	if (offset > _size || size > (_size - offset)) return NULL;
+	_last = offset;
+	_used = offset + size;
+	return _data + offset;
+}
+
 /*********************************************/
 /*  Copy and Move                            */
 /*********************************************/
@@ -201,9 +281,15 @@ void String::move(String &rhs)
 			rhs.len = 0;
 			return;
 		} else {
-			free(buffer);
+			invalidate();
 		}
 	}
+	// inline and arena storage cannot be handed over, so copy
+	if (rhs.buffer == rhs.sso || (rhs.flags & STRING_FLAG_ARENA_BUFFER)) {
+		copy(rhs.buffer, rhs.len);
+		rhs.invalidate();
+		return;
+	}
 	buffer = rhs.buffer;
 	capacity = rhs.capacity;
 	len = rhs.len;
@@ -41,6 +41,41 @@ class __FlashStringHelper;
 // result objects are assumed to be writable by subsequent concatenations.
 class StringSumHelper;
 
+// STM32L4 EXTENSTION: strings of up to STRING_SSO_SIZE - 1 characters are
+// stored within the String object itself, without a heap allocation.
+#define STRING_SSO_SIZE 15
+
+#define STRING_FLAG_TEMPORARY    0x01  // StringSumHelper, may allocate from a StringArena
+#define STRING_FLAG_ARENA_BUFFER 0x02  // "buffer" is owned by a StringArena
+
+// STM32L4 EXTENSTION: while a StringArena is in scope, the StringSumHelper
+// temporaries of "a + b + ..." chains allocate from its buffer instead of
+// the heap. The temporaries die with the expression, and their value gets
+// copied out when assigned to a String, so nothing refers to the buffer once
+// the StringArena goes out of scope. If the buffer runs out, the heap is
+// used. Arenas nest, and are meant to be used from thread context only.
+class StringArena
+{
+public:
+	StringArena(void *buffer, size_t size);
+	~StringArena(void);
+
+	size_t used(void) const { return _used; }
+
+private:
+	char *_data;
+	size_t _size;
+	size_t _used;
+	size_t _last;
+	StringArena *_previous;
+
+	static StringArena *_current;
+
+	char *reallocate(char *p, size_t size);
+
+	friend class String;
+};
+
 // The string class
 class String
 {
@@ -196,9 +231,12 @@ protected:
 	char *buffer;	        // the actual char array
 	unsigned int capacity;  // the array length minus one (for the '\0')
 	unsigned int len;       // the String length (not counting the '\0')
+	char sso[STRING_SSO_SIZE]; // inline storage for short strings
+	unsigned char flags;
 protected:
 	void init(void);
 	void invalidate(void);
+	void release(void);
 	unsigned char changeBuffer(unsigned int maxStrLen);
 	unsigned char concat(const char *cstr, unsigned int length);
 
@@ -213,16 +251,16 @@ protected:
 class StringSumHelper : public String
 {
 public:
-	StringSumHelper(const String &s) : String(s) {}
-	StringSumHelper(const char *p) : String(p) {}
-	StringSumHelper(char c) : String(c) {}
-	StringSumHelper(unsigned char num) : String(num) {}
-	StringSumHelper(int num) : String(num) {}
-	StringSumHelper(unsigned int num) : String(num) {}
-	StringSumHelper(long num) : String(num) {}
-	StringSumHelper(unsigned long num) : String(num) {}
-	StringSumHelper(float num) : String(num) {}
-	StringSumHelper(double num) : String(num) {}
+	StringSumHelper(const String &s) : String((const char*)NULL) { flags |= STRING_FLAG_TEMPORARY; String::operator = (s); }
+	StringSumHelper(const char *p) : String((const char*)NULL) { flags |= STRING_FLAG_TEMPORARY; String::operator = (p); }
+	StringSumHelper(char c) : String(c) { flags |= STRING_FLAG_TEMPORARY; }
+	StringSumHelper(unsigned char num) : String(num) { flags |= STRING_FLAG_TEMPORARY; }
+	StringSumHelper(int num) : String(num) { flags |= STRING_FLAG_TEMPORARY; }
+	StringSumHelper(unsigned int num) : String(num) { flags |= STRING_FLAG_TEMPORARY; }
+	StringSumHelper(long num) : String(num) { flags |= STRING_FLAG_TEMPORARY; }
+	StringSumHelper(unsigned long num) : String(num) { flags |= STRING_FLAG_TEMPORARY; }
+	StringSumHelper(float num) : String(num) { flags |= STRING_FLAG_TEMPORARY; }
+	StringSumHelper(double num) : String(num) { flags |= STRING_FLAG_TEMPORARY; }
 };
 
 #endif  // __cplusplus
@@ -18,13 +18,41 @@
 */
 
 #include <stdio.h>
+#include <string.h>
+
+#include "format.h"
+
+#define DTOSTRF_DIGITS 32
 
 char *dtostrf (double val, signed char width, unsigned char prec, char *sout) {
   asm(".global _printf_float");
 
-  char fmt[20];
-  sprintf(fmt, "%%%d.%df", width, prec);
-  sprintf(sout, fmt, val);
+  char buf[13 + DTOSTRF_DIGITS];
+  unsigned int length, pad;
+
+  length = (prec <= DTOSTRF_DIGITS) ? format_dtoa(buf, val, prec) : 0;
+
+  // NaN, infinity and large numbers are left to printf
+  if (length == 0) {
+    char fmt[20];
+    sprintf(fmt, "%%%d.%df", width, prec);
+    sprintf(sout, fmt, val);
+    return sout;
+  }
+
+  pad = (width < 0) ? -width : width;
+  pad = (pad > length) ? (pad - length) : 0;
+
+  if (width < 0) {
+    memcpy(sout, buf, length);
+    memset(sout + length, ' ', pad);
+  } else {
+    memset(sout, ' ', pad);
+    memcpy(sout + pad, buf, length);
+  }
+
+  sout[length + pad] = '\0';
+
   return sout;
 }
 
@@ -35,248 +35,206 @@
 #include "stm32l4_flash.h"
 
 #include "avr/eeprom.h"
+#include "avr/io.h"
+
+/* The emulated EEPROM lives in EEPROM_FLASH_BANK_COUNT banks at the top of the flash,
+ * which the linker script has to leave unused. A bank holds an image of the whole
+ * EEPROM, followed by 8 byte records (4 data bytes, 2 bytes offset, 2 bytes 0x00),
+ * followed by a 16 byte trailer (sequence, 0x00000000, MAGIC_1, MAGIC_2). The valid
+ * bank with the highest sequence is the current one. Once it is full, the RAM shadow
+ * is written as image to the next bank, which then gets a trailer with the next
+ * sequence. Hence the banks are erased round robin.
+ */
 
 #define EEPROM_FLASH_MAGIC_1 0xaa55ee77
 #define EEPROM_FLASH_MAGIC_2 0x77eeaa55
 
-#define EEPROM_FLASH_SIZE    1024
+#define EEPROM_FLASH_SIZE    (E2END +1)
 #define EEPROM_FLASH_BANK    8192
+#define EEPROM_FLASH_PAGE    2048
+#define EEPROM_FLASH_BATCH   32      /* records per flash program operation */
+
+#if !defined(EEPROM_FLASH_BANK_COUNT)
+#define EEPROM_FLASH_BANK_COUNT 2
+#endif
+
+#if (EEPROM_FLASH_SIZE & (EEPROM_FLASH_SIZE -1)) || (EEPROM_FLASH_SIZE > (EEPROM_FLASH_BANK / 2))
+#error "E2END +1 has to be a power of 2, and at most half of EEPROM_FLASH_BANK"
+#endif
+
+#if (EEPROM_FLASH_BANK_COUNT < 2)
+#error "EEPROM_FLASH_BANK_COUNT has to be at least 2"
+#endif
 
 static const uint8_t *eeprom_flash_data = NULL;
 
-uint32_t eeprom_flash_bottom;
-uint32_t eeprom_flash_top;
-uint32_t eeprom_flash_slot;
-uint32_t eeprom_flash_limit;
+static uint32_t eeprom_flash_bank;
+static uint32_t eeprom_flash_sequence;
+static uint32_t eeprom_flash_bottom;
+static uint32_t eeprom_flash_slot;
+static uint32_t eeprom_flash_limit;
+static uint32_t eeprom_flash_erased;    /* pages of the next bank erased by eeprom_compact() */
 
+/* The current EEPROM contents, so that reads do not have to search the records. It's
+ * filled in completely by eeprom_flash_initialize(), hence not cleared at reset.
+ */
+static uint8_t eeprom_shadow[EEPROM_FLASH_SIZE] __attribute__((aligned(4))) __noinit;
 
-static void eeprom_flash_initialize(void)
+static uint32_t eeprom_flash_trailer(uint32_t bank)
 {
-    uint32_t sequence_1, sequence_2;
-    uint8_t wdata[16];
-
-    eeprom_flash_data = (const uint8_t*)FLASH_BASE + stm32l4_flash_size() - 2*EEPROM_FLASH_BANK;
-
-    sequence_1 = 0;
-    sequence_2 = 0;
-
-    if ((eeprom_flash_data[1*EEPROM_FLASH_BANK -8] == (uint8_t)(EEPROM_FLASH_MAGIC_1 >>  0)) &&
-	(eeprom_flash_data[1*EEPROM_FLASH_BANK -7] == (uint8_t)(EEPROM_FLASH_MAGIC_1 >>  8)) &&
-	(eeprom_flash_data[1*EEPROM_FLASH_BANK -6] == (uint8_t)(EEPROM_FLASH_MAGIC_1 >> 16)) &&
-	(eeprom_flash_data[1*EEPROM_FLASH_BANK -5] == (uint8_t)(EEPROM_FLASH_MAGIC_1 >> 24)) &&
-	(eeprom_flash_data[1*EEPROM_FLASH_BANK -4] == (uint8_t)(EEPROM_FLASH_MAGIC_2 >>  0)) &&
-	(eeprom_flash_data[1*EEPROM_FLASH_BANK -3] == (uint8_t)(EEPROM_FLASH_MAGIC_2 >>  8)) &&
-	(eeprom_flash_data[1*EEPROM_FLASH_BANK -2] == (uint8_t)(EEPROM_FLASH_MAGIC_2 >> 16)) &&
-	(eeprom_flash_data[1*EEPROM_FLASH_BANK -1] == (uint8_t)(EEPROM_FLASH_MAGIC_2 >> 24)))
+    const uint32_t *trailer;
+
+    trailer = (const uint32_t*)(eeprom_flash_data + (bank +1) * EEPROM_FLASH_BANK - 16);
+
+    if ((trailer[2] == EEPROM_FLASH_MAGIC_1) && (trailer[3] == EEPROM_FLASH_MAGIC_2))
     {
-	sequence_1 = ((eeprom_flash_data[1*EEPROM_FLASH_BANK -16] <<  0) |
-		      (eeprom_flash_data[1*EEPROM_FLASH_BANK -15] <<  8) |
-		      (eeprom_flash_data[1*EEPROM_FLASH_BANK -14] << 16) |
-		      (eeprom_flash_data[1*EEPROM_FLASH_BANK -13] << 24));
+	return trailer[0];
     }
 
-    if ((eeprom_flash_data[2*EEPROM_FLASH_BANK -8] == (uint8_t)(EEPROM_FLASH_MAGIC_1 >>  0)) &&
-	(eeprom_flash_data[2*EEPROM_FLASH_BANK -7] == (uint8_t)(EEPROM_FLASH_MAGIC_1 >>  8)) &&
-	(eeprom_flash_data[2*EEPROM_FLASH_BANK -6] == (uint8_t)(EEPROM_FLASH_MAGIC_1 >> 16)) &&
-	(eeprom_flash_data[2*EEPROM_FLASH_BANK -5] == (uint8_t)(EEPROM_FLASH_MAGIC_1 >> 24)) &&
-	(eeprom_flash_data[2*EEPROM_FLASH_BANK -4] == (uint8_t)(EEPROM_FLASH_MAGIC_2 >>  0)) &&
-	(eeprom_flash_data[2*EEPROM_FLASH_BANK -3] == (uint8_t)(EEPROM_FLASH_MAGIC_2 >>  8)) &&
-	(eeprom_flash_data[2*EEPROM_FLASH_BANK -2] == (uint8_t)(EEPROM_FLASH_MAGIC_2 >> 16)) &&
-	(eeprom_flash_data[2*EEPROM_FLASH_BANK -1] == (uint8_t)(EEPROM_FLASH_MAGIC_2 >> 24)))
+    return 0;
+}
+
+static void eeprom_flash_finish(uint32_t bank, uint32_t sequence)
+{
+    uint32_t wdata[4];
+
+    wdata[0] = sequence;
+    wdata[1] = 0x00000000;
+    wdata[2] = EEPROM_FLASH_MAGIC_1;
+    wdata[3] = EEPROM_FLASH_MAGIC_2;
+
+    stm32l4_flash_program((uint32_t)eeprom_flash_data + (bank +1) * EEPROM_FLASH_BANK - 16, (const uint8_t*)&wdata[0], 16);
+
+    eeprom_flash_bank = bank;
+    eeprom_flash_sequence = sequence;
+    eeprom_flash_bottom = bank * EEPROM_FLASH_BANK;
+    eeprom_flash_slot = eeprom_flash_bottom + EEPROM_FLASH_SIZE;
+    eeprom_flash_limit = eeprom_flash_bottom + EEPROM_FLASH_BANK - 16;
+    eeprom_flash_erased = 0;
+}
+
+static void eeprom_flash_initialize(void)
+{
+    uint32_t bank, sequence, offset;
+
+    eeprom_flash_data = (const uint8_t*)FLASH_BASE + stm32l4_flash_size() - EEPROM_FLASH_BANK_COUNT * EEPROM_FLASH_BANK;
+
+    eeprom_flash_sequence = 0;
+
+    for (bank = 0; bank < EEPROM_FLASH_BANK_COUNT; bank++)
     {
-	sequence_2 = ((eeprom_flash_data[2*EEPROM_FLASH_BANK -16] <<  0) |
-		      (eeprom_flash_data[2*EEPROM_FLASH_BANK -15] <<  8) |
-		      (eeprom_flash_data[2*EEPROM_FLASH_BANK -14] << 16) |
-		      (eeprom_flash_data[2*EEPROM_FLASH_BANK -13] << 24));
+	sequence = eeprom_flash_trailer(bank);
+
+	if (sequence > eeprom_flash_sequence)
+	{
+	    eeprom_flash_bank = bank;
+	    eeprom_flash_sequence = sequence;
+	}
     }
 
-    if ((sequence_1 == 0) && (sequence_2 == 0))
+    if (eeprom_flash_sequence == 0)
     {
 	stm32l4_flash_unlock();
 
         stm32l4_flash_erase((uint32_t)eeprom_flash_data, EEPROM_FLASH_BANK);
 
-	wdata[ 0] = (uint8_t)(1 >>  0);
-	wdata[ 1] = (uint8_t)(1 >>  8);
-	wdata[ 2] = (uint8_t)(1 >> 16);
-	wdata[ 3] = (uint8_t)(1 >> 24);
-	wdata[ 4] = 0x00;
-	wdata[ 5] = 0x00;
-	wdata[ 6] = 0x00;
-	wdata[ 7] = 0x00;
-	wdata[ 8] = (uint8_t)(EEPROM_FLASH_MAGIC_1 >>  0);
-	wdata[ 9] = (uint8_t)(EEPROM_FLASH_MAGIC_1 >>  8);
-	wdata[10] = (uint8_t)(EEPROM_FLASH_MAGIC_1 >> 16);
-	wdata[11] = (uint8_t)(EEPROM_FLASH_MAGIC_1 >> 24);
-	wdata[12] = (uint8_t)(EEPROM_FLASH_MAGIC_2 >>  0);
-	wdata[13] = (uint8_t)(EEPROM_FLASH_MAGIC_2 >>  8);
-	wdata[14] = (uint8_t)(EEPROM_FLASH_MAGIC_2 >> 16);
-	wdata[15] = (uint8_t)(EEPROM_FLASH_MAGIC_2 >> 24);
-
-	stm32l4_flash_program((uint32_t)eeprom_flash_data + 1*EEPROM_FLASH_BANK - 16, &wdata[0], 16);
+	eeprom_flash_finish(0, 1);
 
 	stm32l4_flash_lock();
-
-	eeprom_flash_bottom = 0;
-	eeprom_flash_top = EEPROM_FLASH_SIZE;
-	eeprom_flash_slot = EEPROM_FLASH_SIZE;
-	eeprom_flash_limit = EEPROM_FLASH_BANK - 16;
     }
     else
     {
-	if (sequence_1 > sequence_2)
-	{
-	    eeprom_flash_bottom = 0;
-	    eeprom_flash_top = EEPROM_FLASH_SIZE;
-	    eeprom_flash_slot = EEPROM_FLASH_SIZE;
-	    eeprom_flash_limit = EEPROM_FLASH_BANK - 16;
-	}
-	else
+	eeprom_flash_bottom = eeprom_flash_bank * EEPROM_FLASH_BANK;
+	eeprom_flash_slot = eeprom_flash_bottom + EEPROM_FLASH_SIZE;
+	eeprom_flash_limit = eeprom_flash_bottom + EEPROM_FLASH_BANK - 16;
+	eeprom_flash_erased = 0;
+    }
+
+    /* Build the shadow by replaying the records over the image.
+     */
+    memcpy(&eeprom_shadow[0], eeprom_flash_data + eeprom_flash_bottom, EEPROM_FLASH_SIZE);
+
+    while (eeprom_flash_slot < eeprom_flash_limit)
+    {
+	if (eeprom_flash_data[eeprom_flash_slot + 7] == 0xff)
 	{
-	    eeprom_flash_bottom = EEPROM_FLASH_BANK + 0;
-	    eeprom_flash_top = EEPROM_FLASH_BANK + EEPROM_FLASH_SIZE;
-	    eeprom_flash_slot = EEPROM_FLASH_BANK + EEPROM_FLASH_SIZE;
-	    eeprom_flash_limit = EEPROM_FLASH_BANK + EEPROM_FLASH_BANK - 16;
+	    break;
 	}
 
-	while (eeprom_flash_slot < eeprom_flash_limit)
-	{
-	    if (eeprom_flash_data[eeprom_flash_slot + 7] == 0xff)
-	    {
-		break;
-	    }
+	offset = ((eeprom_flash_data[eeprom_flash_slot +4] << 0) | (eeprom_flash_data[eeprom_flash_slot +5] << 8)) & ((EEPROM_FLASH_SIZE-1) & ~3ul);
 
-	    eeprom_flash_slot += 8;
-	}
+	memcpy(&eeprom_shadow[offset], eeprom_flash_data + eeprom_flash_slot, 4);
+
+	eeprom_flash_slot += 8;
     }
 }
 
-static void eeprom_flash_read(uint32_t offset, uint8_t *data)
+/* Erase the next bank from page "eeprom_flash_erased" on, at most "count" pages,
+ * skipping pages that are blank already. Returns true if the bank is fully erased.
+ */
+static bool eeprom_flash_prepare(uint32_t count)
 {
-    uint32_t index, slot;
+    uint32_t sbottom, index;
+    const uint32_t *page;
 
-    offset &= (EEPROM_FLASH_SIZE-1);
+    sbottom = ((eeprom_flash_bank +1) % EEPROM_FLASH_BANK_COUNT) * EEPROM_FLASH_BANK;
 
-    if (eeprom_flash_data == NULL)
+    while (count && (eeprom_flash_erased < (EEPROM_FLASH_BANK / EEPROM_FLASH_PAGE)))
     {
-	eeprom_flash_initialize();
-    }
+	page = (const uint32_t*)(eeprom_flash_data + sbottom + eeprom_flash_erased * EEPROM_FLASH_PAGE);
 
-    for (slot = eeprom_flash_slot - 8; slot >= eeprom_flash_top; slot -= 8)
-    {
-	index = ((eeprom_flash_data[slot +4] << 0) | (eeprom_flash_data[slot +5] << 8));
+	for (index = 0; index < (EEPROM_FLASH_PAGE / 4); index++)
+	{
+	    if (page[index] != 0xffffffff)
+	    {
+		break;
+	    }
+	}
 
-	if (index == offset)
+	if (index != (EEPROM_FLASH_PAGE / 4))
 	{
-	    data[0] = eeprom_flash_data[slot +0];
-	    data[1] = eeprom_flash_data[slot +1];
-	    data[2] = eeprom_flash_data[slot +2];
-	    data[3] = eeprom_flash_data[slot +3];
+	    stm32l4_flash_erase((uint32_t)page, EEPROM_FLASH_PAGE);
 
-	    return;
+	    count--;
 	}
+
+	eeprom_flash_erased++;
     }
 
-    data[0] = eeprom_flash_data[eeprom_flash_bottom +offset +0];
-    data[1] = eeprom_flash_data[eeprom_flash_bottom +offset +1];
-    data[2] = eeprom_flash_data[eeprom_flash_bottom +offset +2];
-    data[3] = eeprom_flash_data[eeprom_flash_bottom +offset +3];
+    return (eeprom_flash_erased == (EEPROM_FLASH_BANK / EEPROM_FLASH_PAGE));
 }
 
-static void eeprom_flash_write(uint32_t offset, const uint8_t *data)
+/* Write the shadow as image to the next bank, and make that the current one.
+ */
+static void eeprom_flash_switch(void)
 {
-    uint32_t soffset, sbottom, sequence;
-    uint8_t wdata[16];
+    uint32_t sbank;
 
-    offset &= (EEPROM_FLASH_SIZE-1);
+    sbank = (eeprom_flash_bank +1) % EEPROM_FLASH_BANK_COUNT;
 
-    if (eeprom_flash_data == NULL)
-    {
-	eeprom_flash_initialize();
-    }
+    eeprom_flash_prepare(EEPROM_FLASH_BANK / EEPROM_FLASH_PAGE);
+
+    stm32l4_flash_program((uint32_t)eeprom_flash_data + sbank * EEPROM_FLASH_BANK, &eeprom_shadow[0], EEPROM_FLASH_SIZE);
 
+    eeprom_flash_finish(sbank, eeprom_flash_sequence +1);
+}
+
+/* Append "count" records in one go. If they do not fit, the shadow (which already
+ * holds the new data) is written to the next bank instead.
+ */
+static void eeprom_flash_append(const uint8_t *records, uint32_t count)
+{
     stm32l4_flash_unlock();
 
-    if (eeprom_flash_slot != eeprom_flash_limit)
+    if ((eeprom_flash_slot + count * 8) <= eeprom_flash_limit)
     {
-	wdata[0] = data[0];
-	wdata[1] = data[1];
-	wdata[2] = data[2];
-	wdata[3] = data[3];
-	wdata[4] = (uint8_t)(offset >> 0);
-	wdata[5] = (uint8_t)(offset >> 8);
-	wdata[6] = 0x00;
-	wdata[7] = 0x00;
-
-	stm32l4_flash_program((uint32_t)eeprom_flash_data + eeprom_flash_slot, &wdata[0], 8);
+	stm32l4_flash_program((uint32_t)eeprom_flash_data + eeprom_flash_slot, records, count * 8);
 
-	eeprom_flash_slot += 8;
+	eeprom_flash_slot += (count * 8);
     }
     else
     {
-	sbottom = eeprom_flash_bottom ^ EEPROM_FLASH_BANK;
-
-	stm32l4_flash_erase((uint32_t)eeprom_flash_data + sbottom, EEPROM_FLASH_BANK);
-
-	for (soffset = 0; soffset < EEPROM_FLASH_SIZE; soffset += 8)
-	{
-	    if (soffset == offset)
-	    {
-		wdata[0] = data[0];
-		wdata[1] = data[1];
-		wdata[2] = data[2];
-		wdata[3] = data[3];
-	    }
-	    else
-	    {
-		eeprom_flash_read(soffset, &wdata[0]);
-	    }
-
-	    if ((soffset + 4) == offset)
-	    {
-		wdata[4] = data[0];
-		wdata[5] = data[1];
-		wdata[6] = data[2];
-		wdata[7] = data[3];
-	    }
-	    else
-	    {
-		eeprom_flash_read(soffset +4, &wdata[4]);
-	    }
-	    
-	    stm32l4_flash_program((uint32_t)eeprom_flash_data +sbottom +soffset, &wdata[0], 8);
-	}
-
-	sequence = ((eeprom_flash_data[eeprom_flash_limit +0] <<  0) |
-		    (eeprom_flash_data[eeprom_flash_limit +1] <<  8) |
-		    (eeprom_flash_data[eeprom_flash_limit +2] << 16) |
-		    (eeprom_flash_data[eeprom_flash_limit +3] << 24));
-
-	sequence++;
-
-	wdata[ 0] = (uint8_t)(sequence >>  0);
-	wdata[ 1] = (uint8_t)(sequence >>  8);
-	wdata[ 2] = (uint8_t)(sequence >> 16);
-	wdata[ 3] = (uint8_t)(sequence >> 24);
-	wdata[ 4] = 0x00;
-	wdata[ 5] = 0x00;
-	wdata[ 6] = 0x00;
-	wdata[ 7] = 0x00;
-	wdata[ 8] = (uint8_t)(EEPROM_FLASH_MAGIC_1 >>  0);
-	wdata[ 9] = (uint8_t)(EEPROM_FLASH_MAGIC_1 >>  8);
-	wdata[10] = (uint8_t)(EEPROM_FLASH_MAGIC_1 >> 16);
-	wdata[11] = (uint8_t)(EEPROM_FLASH_MAGIC_1 >> 24);
-	wdata[12] = (uint8_t)(EEPROM_FLASH_MAGIC_2 >>  0);
-	wdata[13] = (uint8_t)(EEPROM_FLASH_MAGIC_2 >>  8);
-	wdata[14] = (uint8_t)(EEPROM_FLASH_MAGIC_2 >> 16);
-	wdata[15] = (uint8_t)(EEPROM_FLASH_MAGIC_2 >> 24);
-
-	stm32l4_flash_program((uint32_t)eeprom_flash_data +sbottom +EEPROM_FLASH_BANK - 16, &wdata[0], 16);
-
-	eeprom_flash_bottom = sbottom;
-	eeprom_flash_top = sbottom + EEPROM_FLASH_SIZE;
-	eeprom_flash_slot = sbottom + EEPROM_FLASH_SIZE;
-	eeprom_flash_limit = sbottom + EEPROM_FLASH_BANK - 16;
+	eeprom_flash_switch();
     }
 
     stm32l4_flash_lock();
@@ -320,27 +278,22 @@ float eeprom_read_float(const float *address)
 
 void eeprom_read_block(void *data, const void *address, uint32_t count)
 {
-    uint32_t offset, index;
-    uint8_t rdata[4];
+    uint32_t offset;
     uint8_t *d;
 
-    d      = (uint8_t*)data;
-    offset = (uint32_t)address & ~3ul;
-    index  = (uint32_t)address & 3ul;
+    if (eeprom_flash_data == NULL)
+    {
+	eeprom_flash_initialize();
+    }
 
-    eeprom_flash_read(offset, &rdata[0]);
+    d      = (uint8_t*)data;
+    offset = (uint32_t)address & (EEPROM_FLASH_SIZE-1);
 
     while (count--)
     {
-	if (index == 4)
-	{
-	    offset += 4;
-	    index = 0;
-
-	    eeprom_flash_read(offset, &rdata[0]);
-	}
+	*d++ = eeprom_shadow[offset];
 
-	*d++ = rdata[index++];
+	offset = (offset +1) & (EEPROM_FLASH_SIZE-1);
     }
 }
 
@@ -366,51 +319,89 @@ void eeprom_write_float(float *address, float data)
 
 void eeprom_write_block(const void *data, void *address, uint32_t count)
 {
-    uint32_t offset, index;
+    uint32_t offset, index, size, entries;
+    uint8_t records[EEPROM_FLASH_BATCH * 8];
     uint8_t wdata[4];
     const uint8_t *s;
-    bool update;
 
-    s      = (const uint8_t*)data;
-    offset = (uint32_t)address & ~3ul;
-    index  = (uint32_t)address & 3ul;
-
-    eeprom_flash_read(offset, &wdata[0]);
+    if (eeprom_flash_data == NULL)
+    {
+	eeprom_flash_initialize();
+    }
 
-    update = false;
+    s       = (const uint8_t*)data;
+    offset  = (uint32_t)address & ((EEPROM_FLASH_SIZE-1) & ~3ul);
+    index   = (uint32_t)address & 3ul;
+    entries = 0;
 
-    while (count--)
+    /* Every changed 4 byte word becomes one record, and all records of this call
+     * are appended with a single flash program operation (per EEPROM_FLASH_BATCH).
+     */
+    while (count)
     {
-	if (index == 4)
+	size = 4 - index;
+
+	if (size > count)
+	{
+	    size = count;
+	}
+
+	memcpy(&wdata[0], &eeprom_shadow[offset], 4);
+	memcpy(&wdata[index], s, size);
+
+	if (memcmp(&wdata[0], &eeprom_shadow[offset], 4))
 	{
-	    if (update)
+	    memcpy(&eeprom_shadow[offset], &wdata[0], 4);
+
+	    memcpy(&records[entries * 8], &wdata[0], 4);
+	    records[entries * 8 +4] = (uint8_t)(offset >> 0);
+	    records[entries * 8 +5] = (uint8_t)(offset >> 8);
+	    records[entries * 8 +6] = 0x00;
+	    records[entries * 8 +7] = 0x00;
+
+	    entries++;
+
+	    if (entries == EEPROM_FLASH_BATCH)
 	    {
-		eeprom_flash_write(offset, &wdata[0]);
+		eeprom_flash_append(&records[0], entries);
 
-		update = false;
+		entries = 0;
 	    }
+	}
 
-	    offset += 4;
-	    index = 0;
+	s      += size;
+	count  -= size;
+	offset  = (offset +4) & (EEPROM_FLASH_SIZE-1);
+	index   = 0;
+    }
 
-	    eeprom_flash_read(offset, &wdata[0]);
-	}
+    if (entries)
+    {
+	eeprom_flash_append(&records[0], entries);
+    }
+}
 
-	if (wdata[index] != *s)
-	{
-	    wdata[index] = *s;
-	  
-	    update = true;
-	}
+int eeprom_compact(void)
+{
+    bool done;
 
-	s++;
-	index++;
+    if (eeprom_flash_data == NULL)
+    {
+	eeprom_flash_initialize();
     }
 
-    if (update)
+    if ((eeprom_flash_slot - (eeprom_flash_bottom + EEPROM_FLASH_SIZE)) < ((eeprom_flash_limit - (eeprom_flash_bottom + EEPROM_FLASH_SIZE)) / 2))
     {
-	eeprom_flash_write(offset, &wdata[0]);
+	return 1;
     }
+
+    stm32l4_flash_unlock();
+
+    done = eeprom_flash_prepare(1);
+
+    stm32l4_flash_lock();
+
+    return done;
 }
 
 int eeprom_is_ready(void)
@@ -47,6 +47,13 @@ void eeprom_write_dword(uint32_t *address, uint32_t data);
 void eeprom_write_float(float *address, float data);
 void eeprom_write_block(const void *data, void *address, uint32_t count);
 int eeprom_is_ready(void);
+
+/* STM32L4 EXTENSION: erase ahead for a later bank switch, from a context where a flash stall
+ * is acceptable (e.g. loop()). Once the current bank is half full each call erases at most one
+ * flash page of the next bank, so that the eventual switch only needs to program it. Returns 1
+ * if there is nothing left to do.
+ */
+int eeprom_compact(void);
 #define eeprom_busy_wait() do {} while (!eeprom_is_ready())
 
 static inline void eeprom_update_byte(uint8_t *address, uint8_t data)
@@ -29,6 +29,8 @@
 #define RAMSIZE  (96 * 1024)
 #define RAMEND   (RAMSTART + RAMSIZE - 1)
 
-#define E2END    0x3ff
+#if !defined(E2END)
+#define E2END    0x3ff     /* EEPROM size -1, the size has to be a power of 2 */
+#endif
 
 #endif
@@ -0,0 +1,232 @@
+/*
+  Copyright (c) 2016 Thomas Roell.  All right reserved.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+  See the GNU Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#include <stdint.h>
+#include <math.h>
+
+#include "format.h"
+
+/* Base 10 gets converted 2 digits at a time. Divisions by a constant compile into a
+ * multiply by the reciprocal, so there is no UDIV per digit.
+ */
+static const char format_digits_10[201] =
+    "00010203040506070809"
+    "10111213141516171819"
+    "20212223242526272829"
+    "30313233343536373839"
+    "40414243444546474849"
+    "50515253545556575859"
+    "60616263646566676869"
+    "70717273747576777879"
+    "80818283848586878889"
+    "90919293949596979899";
+
+static const uint32_t format_pow10[10] = {
+    1, 10, 100, 1000, 10000, 100000, 1000000, 10000000, 100000000, 1000000000,
+};
+
+static unsigned int format_length_10(uint32_t value)
+{
+    unsigned int length;
+
+    length = 1;
+
+    while ((length < 10) && (value >= format_pow10[length]))
+    {
+	length++;
+    }
+
+    return length;
+}
+
+/* Write exactly "length" decimal digits of "value" ending at "p".
+ */
+static void format_digits_10_fill(char *p, uint32_t value, unsigned int length)
+{
+    uint32_t q, r;
+
+    while (length >= 2)
+    {
+	q = value / 100;
+	r = (value - q * 100) * 2;
+
+	p -= 2;
+	p[0] = format_digits_10[r + 0];
+	p[1] = format_digits_10[r + 1];
+
+	value = q;
+	length -= 2;
+    }
+
+    if (length)
+    {
+	*--p = '0' + (value % 10);
+    }
+}
+
+unsigned int format_ultoa(char *s, unsigned long value, unsigned int radix, unsigned int flags)
+{
+    char tmp[32], *tp;
+    unsigned int length, shift, digit, alpha;
+    uint32_t v;
+
+    v = value;
+
+    alpha = (flags & FORMAT_UPPERCASE) ? ('A' - 10) : ('a' - 10);
+
+    if (radix == 10)
+    {
+	length = format_length_10(v);
+
+	format_digits_10_fill(s + length, v, length);
+    }
+    else if (!(radix & (radix -1)))
+    {
+	/* Power of 2, so shift and mask.
+	 */
+	shift = __builtin_ctz(radix);
+
+	length = ((32 - __builtin_clz(v | 1)) + (shift -1)) / shift;
+
+	tp = s + length;
+
+	do
+	{
+	    digit = v & (radix -1);
+	    v >>= shift;
+
+	    *--tp = (digit < 10) ? ('0' + digit) : (alpha + digit);
+	}
+	while (tp != s);
+    }
+    else
+    {
+	tp = tmp;
+
+	do
+	{
+	    digit = v % radix;
+	    v /= radix;
+
+	    *tp++ = (digit < 10) ? ('0' + digit) : (alpha + digit);
+	}
+	while (v);
+
+	length = tp - tmp;
+
+	while (tp != tmp)
+	{
+	    *s++ = *--tp;
+	}
+
+	s -= length;
+    }
+
+    s[length] = '\0';
+
+    return length;
+}
+
+unsigned int format_ltoa(char *s, long value, unsigned int radix, unsigned int flags)
+{
+    if ((radix == 10) && (value < 0))
+    {
+	*s = '-';
+
+	return 1 + format_ultoa(s + 1, -(unsigned long)value, 10, flags);
+    }
+
+    return format_ultoa(s, (unsigned long)value, radix, flags);
+}
+
+/* Fixed point conversion: the fraction gets scaled by 10^9 at a time and printed
+ * as integer, instead of being multiplied by 10 and truncated per digit.
+ */
+unsigned int format_dtoa(char *s, double value, unsigned int prec)
+{
+    double rounding, remainder;
+    uint32_t integer, fraction;
+    unsigned int count, index;
+    char *p;
+
+    if (isnan(value) || isinf(value))
+    {
+	return 0;
+    }
+
+    /* constant determined empirically (see Print::printFloat()) */
+    if ((value > 4294967040.0) || (value < -4294967040.0))
+    {
+	return 0;
+    }
+
+    p = s;
+
+    if (value < 0.0)
+    {
+	*p++ = '-';
+
+	value = -value;
+    }
+
+    rounding = 0.5;
+
+    for (index = prec; index > 9; index -= 9)
+    {
+	rounding /= 1e9;
+    }
+
+    rounding /= (double)format_pow10[index];
+
+    value += rounding;
+
+    integer = (uint32_t)value;
+    remainder = value - (double)integer;
+
+    p += format_ultoa(p, integer, 10, 0);
+
+    if (prec)
+    {
+	*p++ = '.';
+
+	while (prec)
+	{
+	    count = (prec > 9) ? 9 : prec;
+
+	    remainder *= (double)format_pow10[count];
+
+	    fraction = (uint32_t)remainder;
+
+	    if (fraction >= format_pow10[count])
+	    {
+		fraction = format_pow10[count] -1;
+	    }
+
+	    remainder -= (double)fraction;
+
+	    p += count;
+	    prec -= count;
+
+	    format_digits_10_fill(p, fraction, count);
+	}
+
+	*p = '\0';
+    }
+
+    return p - s;
+}
@@ -0,0 +1,44 @@
+/*
+  Copyright (c) 2016 Thomas Roell.  All right reserved.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+  See the GNU Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#pragma once
+
+#ifdef __cplusplus
+extern "C"{
+#endif
+
+/* Number formatting backend for Print, itoa.c and dtostrf.c. All functions
+ * write a NUL terminated string to "s" and return its length.
+ *
+ * format_ultoa()/format_ltoa() need up to 34 bytes (base 2, '-', NUL).
+ * Only base 10 numbers get a '-' sign, as with ltoa().
+ *
+ * format_dtoa() prints "prec" fractional digits in fixed point, after
+ * rounding like Print::print(double); it needs up to 13 + "prec" bytes.
+ * It returns 0 for NaN, infinity and numbers outside of +/- 4294967040.
+ */
+
+#define FORMAT_UPPERCASE 0x00000001
+
+extern unsigned int format_ultoa(char *s, unsigned long value, unsigned int radix, unsigned int flags);
+extern unsigned int format_ltoa(char *s, long value, unsigned int radix, unsigned int flags);
+extern unsigned int format_dtoa(char *s, double value, unsigned int prec);
+
+#ifdef __cplusplus
+} // extern "C"
+#endif
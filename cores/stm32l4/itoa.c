@@ -17,6 +17,7 @@
 */
 
 #include "itoa.h"
+#include "format.h"
 #include <string.h>
 
 #ifdef __cplusplus
@@ -76,13 +77,6 @@ extern char* itoa( int value, char *string, int radix )
 
 extern char* ltoa( long value, char *string, int radix )
 {
-  char tmp[33];
-  char *tp = tmp;
-  long i;
-  unsigned long v;
-  int sign;
-  char *sp;
-
   if ( string == NULL )
   {
     return 0 ;
@@ -93,33 +87,7 @@ extern char* ltoa( long value, char *string, int radix )
     return 0 ;
   }
 
-  sign = (radix == 10 && value < 0);
-  if (sign)
-  {
-    v = -value;
-  }
-  else
-  {
-    v = (unsigned long)value;
-  }
-
-  while (v || tp == tmp)
-  {
-    i = v % radix;
-    v = v / radix;
-    if (i < 10)
-      *tp++ = i+'0';
-    else
-      *tp++ = i + 'a' - 10;
-  }
-
-  sp = string;
-
-  if (sign)
-    *sp++ = '-';
-  while (tp > tmp)
-    *sp++ = *--tp;
-  *sp = 0;
+  format_ltoa( string, value, radix, 0 ) ;
 
   return string;
 }
@@ -133,12 +101,6 @@ extern char* utoa( unsigned value, char *string, int radix )
 
 extern char* ultoa( unsigned long value, char *string, int radix )
 {
-  char tmp[33];
-  char *tp = tmp;
-  long i;
-  unsigned long v = value;
-  char *sp;
-
   if ( string == NULL )
   {
     return 0;
@@ -149,22 +111,7 @@ extern char* ultoa( unsigned long value, char *string, int radix )
     return 0;
   }
 
-  while (v || tp == tmp)
-  {
-    i = v % radix;
-    v = v / radix;
-    if (i < 10)
-      *tp++ = i+'0';
-    else
-      *tp++ = i + 'a' - 10;
-  }
-
-  sp = string;
-
-
-  while (tp > tmp)
-    *sp++ = *--tp;
-  *sp = 0;
+  format_ultoa( string, value, radix, 0 ) ;
 
   return string;
 }
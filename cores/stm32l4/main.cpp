@@ -19,6 +19,8 @@
 #define ARDUINO_MAIN
 #include "Arduino.h"
 #include "HardwareSerial.h"
+#include "STM32.h"
+#include "stm32l4_wiring_private.h"
 
 
 void (*serialEventCallback)(void) = NULL;
@@ -105,6 +107,9 @@ void initVariant() { }
 // Initialize C library
 extern "C" void __libc_init_array(void);
 
+// micros() at the end of each boot phase, see STM32.bootTime().
+uint32_t g_bootTime[BOOT_PHASE_COUNT];
+
 /*
  * \brief Main entry point of Arduino application
  */
@@ -112,26 +117,49 @@ extern "C" int main( void )
 {
     init();
 
+    g_bootTime[BOOT_PHASE_INIT] = micros();
+
     __libc_init_array();
 
+    g_bootTime[BOOT_PHASE_CONSTRUCTORS] = micros();
+
     initVariant();
 
+    g_bootTime[BOOT_PHASE_VARIANT] = micros();
+
+#if (STM32L4_CONFIG_FASTBOOT == 0)
     delay(1);
+#endif
 
 #if defined(USBCON)
     if (SystemCoreClock >= 16000000)
     {
 	USBDevice.init();
+#if (STM32L4_CONFIG_FASTBOOT == 0)
 	USBDevice.attach();
+#endif
     }
 #endif /* USBCON */
 
+    g_bootTime[BOOT_PHASE_USB] = micros();
+
     setup();
 
+    g_bootTime[BOOT_PHASE_SETUP] = micros();
+
+#if (STM32L4_CONFIG_FASTBOOT == 1)
+    initStorage();
+
+#if defined(USBCON)
+    USBDevice.attach();
+#endif /* USBCON */
+#endif
+
     for (;;)
     {
 	loop();
 	if (serialEventCallback) (*serialEventCallback)();
+	loopWait();
     }
 
     return 0;
@@ -0,0 +1,160 @@
+/*
+ * Copyright (c) 2017 Thomas Roell.  All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal with the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ *  1. Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimers.
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimers in the
+ *     documentation and/or other materials provided with the distribution.
+ *  3. Neither the name of Thomas Roell, nor the names of its contributors
+ *     may be used to endorse or promote products derived from this Software
+ *     without specific prior written permission.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ * CONTRIBUTORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * WITH THE SOFTWARE.
+ */
+
+#include "Arduino.h"
+#include "stm32l4_wiring_private.h"
+#include "stm32l4_crash.h"
+
+#define STM32L4_CRASH_MAGIC 0x48535243     /* "CRSH" */
+
+typedef struct _stm32l4_crash_record_t {
+    uint32_t               magic;
+    uint32_t               checksum;
+    stm32l4_crash_report_t report;
+} stm32l4_crash_record_t;
+
+static __attribute__((section(".noinit2"))) stm32l4_crash_record_t stm32l4_crash_record;
+
+stm32l4_crash_ring_t stm32l4_crash_ring;
+
+extern uint32_t __StackTop[];
+
+static uint32_t stm32l4_crash_checksum(const stm32l4_crash_report_t *report)
+{
+    const uint32_t *data = (const uint32_t*)report;
+    uint32_t checksum, index;
+
+    checksum = STM32L4_CRASH_MAGIC;
+
+    for (index = 0; index < (sizeof(stm32l4_crash_report_t) / sizeof(uint32_t)); index++)
+    {
+	checksum = ((checksum << 5) | (checksum >> 27)) ^ data[index];
+    }
+
+    return checksum;
+}
+
+/* SRAM2 holds random data after a power on reset, so a record only counts if
+ * both the magic and the checksum match.
+ */
+void stm32l4_crash_initialize(void)
+{
+    if ((stm32l4_crash_record.magic != STM32L4_CRASH_MAGIC) ||
+	(stm32l4_crash_record.checksum != stm32l4_crash_checksum(&stm32l4_crash_record.report)))
+    {
+	stm32l4_crash_record.magic = 0;
+    }
+}
+
+bool stm32l4_crash_report(stm32l4_crash_report_t *report)
+{
+    if (stm32l4_crash_record.magic != STM32L4_CRASH_MAGIC)
+    {
+	return false;
+    }
+
+    if (report)
+    {
+	*report = stm32l4_crash_record.report;
+    }
+
+    return true;
+}
+
+void stm32l4_crash_clear(void)
+{
+    stm32l4_crash_record.magic = 0;
+}
+
+/* Called from the fault handlers with the exception frame and EXC_RETURN. Nothing
+ * in here may fault again, so the frame and the stack snippet are only read if they
+ * are within SRAM1, where both MSP and PSP live.
+ */
+void stm32l4_crash_capture(uint32_t *frame, uint32_t exc_return)
+{
+    stm32l4_crash_report_t *report = &stm32l4_crash_record.report;
+    uint32_t *stack;
+    uint32_t index, count, start;
+
+    memset(report, 0, sizeof(stm32l4_crash_report_t));
+
+    report->exception = __get_IPSR() & 0x1ff;
+    report->exc_return = exc_return;
+    report->cfsr = SCB->CFSR;
+    report->hfsr = SCB->HFSR;
+    report->mmfar = SCB->MMFAR;
+    report->bfar = SCB->BFAR;
+    report->millis = (uint32_t)armv7m_systick_millis();
+    report->cycles = armv7m_systick_cycles();
+
+    if (((uint32_t)frame >= SRAM1_BASE) && ((uint32_t)(frame + 8) <= (uint32_t)__StackTop) && !((uint32_t)frame & 3))
+    {
+	report->r0 = frame[0];
+	report->r1 = frame[1];
+	report->r2 = frame[2];
+	report->r3 = frame[3];
+	report->r12 = frame[4];
+	report->lr = frame[5];
+	report->pc = frame[6];
+	report->xpsr = frame[7];
+
+	/* The extended frame carries S0-S15/FPSCR, and bit 9 of the stacked xPSR
+	 * flags an extra alignment word.
+	 */
+	stack = frame + ((exc_return & 0x00000010) ? 8 : 26) + ((frame[7] & 0x00000200) ? 1 : 0);
+
+	report->sp = (uint32_t)stack;
+
+	for (index = 0; (index < STM32L4_CRASH_STACK_SIZE) && ((uint32_t)(stack + index) < (uint32_t)__StackTop); index++)
+	{
+	    report->stack[index] = stack[index];
+	}
+    }
+
+    count = stm32l4_crash_ring.index;
+
+    if (count > STM32L4_CRASH_TRACE_SIZE)
+    {
+	start = count - STM32L4_CRASH_TRACE_SIZE;
+	count = STM32L4_CRASH_TRACE_SIZE;
+    }
+    else
+    {
+	start = 0;
+    }
+
+    for (index = 0; index < count; index++)
+    {
+	report->trace[index] = stm32l4_crash_ring.entries[(start + index) & (STM32L4_CRASH_TRACE_SIZE -1)];
+    }
+
+    report->trace_count = count;
+
+    stm32l4_crash_record.checksum = stm32l4_crash_checksum(report);
+    stm32l4_crash_record.magic = STM32L4_CRASH_MAGIC;
+}
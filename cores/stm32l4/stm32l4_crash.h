@@ -0,0 +1,111 @@
+/*
+ * Copyright (c) 2017 Thomas Roell.  All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal with the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ *  1. Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimers.
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimers in the
+ *     documentation and/or other materials provided with the distribution.
+ *  3. Neither the name of Thomas Roell, nor the names of its contributors
+ *     may be used to endorse or promote products derived from this Software
+ *     without specific prior written permission.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ * CONTRIBUTORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * WITH THE SOFTWARE.
+ */
+
+#ifndef _STM32L4_CRASH_
+#define _STM32L4_CRASH_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "armv7m.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Post-mortem capture. The fault handlers save the exception frame, the fault
+ * status registers, the words above the frame and the tail of the trace ring into
+ * SRAM2 (.noinit2), which is retained across a system reset. After the reboot the
+ * record is available through stm32l4_crash_report() (STM32.crashReport()) until
+ * the next fault or stm32l4_crash_clear().
+ *
+ * stm32l4_crash_trace() logs an event (an application defined "id" and "data") into
+ * a ring of STM32L4_CRASH_TRACE_SIZE entries. It is IRQ safe and costs an atomic
+ * add plus three stores, so it can stay enabled in production builds.
+ */
+
+#define STM32L4_CRASH_STACK_SIZE   16      /* words above the exception frame */
+#define STM32L4_CRASH_TRACE_SIZE   16      /* trace entries, power of 2 */
+
+typedef struct _stm32l4_crash_trace_t {
+    uint32_t   cycles;                     /* armv7m_systick_cycles() */
+    uint32_t   id;
+    uint32_t   data;
+} stm32l4_crash_trace_t;
+
+typedef struct _stm32l4_crash_report_t {
+    uint32_t   exception;                  /* 3 HardFault, 4 MemManage, 5 BusFault, 6 UsageFault */
+    uint32_t   r0;
+    uint32_t   r1;
+    uint32_t   r2;
+    uint32_t   r3;
+    uint32_t   r12;
+    uint32_t   lr;
+    uint32_t   pc;
+    uint32_t   xpsr;
+    uint32_t   sp;                         /* stack pointer before the exception */
+    uint32_t   exc_return;
+    uint32_t   cfsr;
+    uint32_t   hfsr;
+    uint32_t   mmfar;
+    uint32_t   bfar;
+    uint32_t   millis;
+    uint32_t   cycles;
+    uint32_t   stack[STM32L4_CRASH_STACK_SIZE];
+    uint32_t   trace_count;                /* valid entries in trace[], oldest first */
+    stm32l4_crash_trace_t trace[STM32L4_CRASH_TRACE_SIZE];
+} stm32l4_crash_report_t;
+
+typedef struct _stm32l4_crash_ring_t {
+    volatile uint32_t     index;
+    stm32l4_crash_trace_t entries[STM32L4_CRASH_TRACE_SIZE];
+} stm32l4_crash_ring_t;
+
+extern stm32l4_crash_ring_t stm32l4_crash_ring;
+
+static inline void stm32l4_crash_trace(uint32_t id, uint32_t data)
+{
+    stm32l4_crash_trace_t *entry;
+
+    entry = &stm32l4_crash_ring.entries[armv7m_atomic_add(&stm32l4_crash_ring.index, 1) & (STM32L4_CRASH_TRACE_SIZE -1)];
+
+    entry->cycles = armv7m_systick_cycles();
+    entry->id = id;
+    entry->data = data;
+}
+
+extern void stm32l4_crash_initialize(void);
+extern bool stm32l4_crash_report(stm32l4_crash_report_t *report);
+extern void stm32l4_crash_clear(void);
+extern void stm32l4_crash_capture(uint32_t *frame, uint32_t exc_return);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _STM32L4_CRASH_ */
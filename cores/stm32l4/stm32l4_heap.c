@@ -0,0 +1,912 @@
+/*
+ * Copyright (c) 2016 Thomas Roell.  All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal with the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ *  1. Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimers.
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimers in the
+ *     documentation and/or other materials provided with the distribution.
+ *  3. Neither the name of Thomas Roell, nor the names of its contributors
+ *     may be used to endorse or promote products derived from this Software
+ *     without specific prior written permission.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ * CONTRIBUTORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * WITH THE SOFTWARE.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <malloc.h>
+#include <reent.h>
+
+#include "stm32l4xx.h"
+#include "armv7m.h"
+
+#include "stm32l4_heap.h"
+
+#ifndef STM32L4_HEAP
+#define STM32L4_HEAP 0
+#endif
+
+#if (STM32L4_HEAP == 1)
+
+#define HEAP_ALIGN             8
+#define HEAP_BLOCK_OVERHEAD    8
+#define HEAP_BLOCK_MINIMUM     16
+#define HEAP_BLOCK_FREE        0x00000001
+#define HEAP_BLOCK_POOL        0x00000004
+#define HEAP_BLOCK_MASK        0x00000007
+
+/* Second level lists split each power of 2 range in 16. Blocks below 128 bytes
+ * are all in first level 0, 8 bytes apart.
+ */
+#define HEAP_SL_SHIFT          4
+#define HEAP_SL_COUNT          (1 << HEAP_SL_SHIFT)
+#define HEAP_FL_SHIFT          (HEAP_SL_SHIFT + 3)
+#define HEAP_FL_MAX            24
+#define HEAP_FL_COUNT          (HEAP_FL_MAX - HEAP_FL_SHIFT + 1)
+#define HEAP_SMALL_SIZE        (1 << HEAP_FL_SHIFT)
+
+/* A pool block is a 4 byte tag (class << 3 | HEAP_BLOCK_POOL) followed by the
+ * payload. Pool blocks get carved from TLSF blocks of about HEAP_POOL_CHUNK
+ * bytes.
+ */
+#define HEAP_POOL_TAG_SIZE     4
+#define HEAP_POOL_MAXIMUM      (256 - HEAP_POOL_TAG_SIZE)
+#define HEAP_POOL_CHUNK        512
+
+#define HEAP_ALIGN_UP(_size)   (((_size) + (HEAP_ALIGN -1)) & ~(HEAP_ALIGN -1))
+
+typedef struct _heap_block_t {
+    struct _heap_block_t    *prev_phys;
+    uint32_t                size;
+    struct _heap_block_t    *next_free;   /* free blocks only */
+    struct _heap_block_t    *prev_free;   /* free blocks only */
+} heap_block_t;
+
+typedef struct _heap_pool_t {
+    void                    *free;
+    uint32_t                total;
+    uint32_t                count;
+} heap_pool_t;
+
+typedef struct _heap_control_t {
+    uint32_t                size;
+    uint32_t                free;
+    uint32_t                peak;
+    uint32_t                blocks;
+    uint32_t                failed;
+    uint32_t                fl_bitmap;
+    uint32_t                sl_bitmap[HEAP_FL_COUNT];
+    heap_block_t            *lists[HEAP_FL_COUNT][HEAP_SL_COUNT];
+    heap_pool_t             pools[STM32L4_HEAP_POOL_COUNT];
+} heap_control_t;
+
+static heap_control_t heap_control;
+
+static const uint16_t heap_pool_size[STM32L4_HEAP_POOL_COUNT] = {
+    16, 32, 48, 64, 96, 128, 192, 256,
+};
+
+/* Indexed by (request + HEAP_POOL_TAG_SIZE + 15) / 16.
+ */
+static const uint8_t heap_pool_class[17] = {
+    0, 0, 1, 2, 3, 4, 4, 5, 5, 6, 6, 6, 6, 7, 7, 7, 7,
+};
+
+extern uint32_t __StackLimit[];
+
+extern void * _sbrk (int nbytes);
+
+/* Priority ceiling of malloc()/free(), which may be called from interrupt handlers up to
+ * the EXTI priority (attachInterrupt() callbacks), but not from more urgent ones.
+ */
+#define HEAP_CRITICAL_PRIORITY 4
+
+static inline uint32_t heap_lock(void)
+{
+    return armv7m_critical_enter(HEAP_CRITICAL_PRIORITY);
+}
+
+static inline void heap_unlock(uint32_t basepri)
+{
+    armv7m_critical_leave(basepri);
+}
+
+/* Called after each allocation, as merging on free() transiently removes free blocks.
+ */
+static inline void heap_watermark(void)
+{
+    if (heap_control.peak < (heap_control.size - heap_control.free))
+    {
+	heap_control.peak = heap_control.size - heap_control.free;
+    }
+}
+
+static inline uint32_t heap_block_size(const heap_block_t *block)
+{
+    return (block->size & ~HEAP_BLOCK_MASK);
+}
+
+static inline heap_block_t *heap_block_next(const heap_block_t *block)
+{
+    return (heap_block_t*)((uint8_t*)block + heap_block_size(block));
+}
+
+static inline void heap_mapping(uint32_t size, unsigned int *p_fl, unsigned int *p_sl)
+{
+    unsigned int msb;
+
+    if (size < HEAP_SMALL_SIZE)
+    {
+	*p_fl = 0;
+	*p_sl = size >> 3;
+    }
+    else
+    {
+	msb = 31 - __builtin_clz(size);
+
+	*p_fl = msb - (HEAP_FL_SHIFT -1);
+	*p_sl = (size >> (msb - HEAP_SL_SHIFT)) ^ HEAP_SL_COUNT;
+    }
+}
+
+static void heap_insert(heap_block_t *block)
+{
+    heap_block_t *head;
+    unsigned int fl, sl;
+
+    heap_mapping(heap_block_size(block), &fl, &sl);
+
+    head = heap_control.lists[fl][sl];
+
+    block->next_free = head;
+    block->prev_free = NULL;
+
+    if (head)
+    {
+	head->prev_free = block;
+    }
+
+    heap_control.lists[fl][sl] = block;
+    heap_control.fl_bitmap |= (1ul << fl);
+    heap_control.sl_bitmap[fl] |= (1ul << sl);
+
+    heap_control.free += heap_block_size(block);
+    heap_control.blocks++;
+}
+
+static void heap_remove(heap_block_t *block)
+{
+    unsigned int fl, sl;
+
+    heap_mapping(heap_block_size(block), &fl, &sl);
+
+    if (block->prev_free)
+    {
+	block->prev_free->next_free = block->next_free;
+    }
+    else
+    {
+	heap_control.lists[fl][sl] = block->next_free;
+
+	if (!block->next_free)
+	{
+	    heap_control.sl_bitmap[fl] &= ~(1ul << sl);
+
+	    if (!heap_control.sl_bitmap[fl])
+	    {
+		heap_control.fl_bitmap &= ~(1ul << fl);
+	    }
+	}
+    }
+
+    if (block->next_free)
+    {
+	block->next_free->prev_free = block->prev_free;
+    }
+
+    heap_control.free -= heap_block_size(block);
+    heap_control.blocks--;
+}
+
+/* Trim a used block to "size" bytes, and put the rest back as free block. The
+ * physical neighbour following "block" has to be in use.
+ */
+static void heap_split(heap_block_t *block, uint32_t size)
+{
+    heap_block_t *rest;
+    uint32_t remainder;
+
+    remainder = heap_block_size(block) - size;
+
+    if (remainder >= HEAP_BLOCK_MINIMUM)
+    {
+	rest = (heap_block_t*)((uint8_t*)block + size);
+
+	rest->prev_phys = block;
+	rest->size = remainder | HEAP_BLOCK_FREE;
+
+	heap_block_next(rest)->prev_phys = rest;
+
+	block->size = size;
+
+	heap_insert(rest);
+    }
+}
+
+/* Good fit: "size" gets rounded up to the next list boundary, so that the
+ * first block of the first non-empty list at or above that is large enough.
+ */
+static heap_block_t *heap_tlsf_allocate(uint32_t size)
+{
+    heap_block_t *block;
+    uint32_t fl_map, sl_map, search;
+    unsigned int fl, sl;
+
+    search = size;
+
+    if (search >= HEAP_SMALL_SIZE)
+    {
+	search += (1ul << ((31 - __builtin_clz(search)) - HEAP_SL_SHIFT)) -1;
+    }
+
+    heap_mapping(search, &fl, &sl);
+
+    if (fl >= HEAP_FL_COUNT)
+    {
+	return NULL;
+    }
+
+    sl_map = heap_control.sl_bitmap[fl] & (~0ul << sl);
+
+    if (!sl_map)
+    {
+	fl_map = heap_control.fl_bitmap & (~0ul << (fl +1));
+
+	if (!fl_map)
+	{
+	    return NULL;
+	}
+
+	fl = __builtin_ctz(fl_map);
+	sl_map = heap_control.sl_bitmap[fl];
+    }
+
+    sl = __builtin_ctz(sl_map);
+
+    block = heap_control.lists[fl][sl];
+
+    heap_remove(block);
+
+    block->size &= ~HEAP_BLOCK_FREE;
+
+    heap_split(block, size);
+
+    return block;
+}
+
+static void heap_tlsf_free(heap_block_t *block)
+{
+    heap_block_t *next, *prev;
+    uint32_t size;
+
+    size = heap_block_size(block);
+
+    next = heap_block_next(block);
+
+    if (next->size & HEAP_BLOCK_FREE)
+    {
+	heap_remove(next);
+
+	size += heap_block_size(next);
+    }
+
+    prev = block->prev_phys;
+
+    if (prev && (prev->size & HEAP_BLOCK_FREE))
+    {
+	heap_remove(prev);
+
+	size += heap_block_size(prev);
+
+	block = prev;
+    }
+
+    block->size = size | HEAP_BLOCK_FREE;
+
+    heap_block_next(block)->prev_phys = block;
+
+    heap_insert(block);
+}
+
+/* Hand all of the memory between the current break and the stack limit to TLSF,
+ * as one free block followed by a used sentinel.
+ */
+static bool heap_initialize(void)
+{
+    heap_block_t *block, *sentinel;
+    uint8_t *current, *start, *end;
+
+    current = (uint8_t*)_sbrk(0);
+
+    start = (uint8_t*)HEAP_ALIGN_UP((uint32_t)current);
+    end = (uint8_t*)((uint32_t)&__StackLimit[0] & ~(HEAP_ALIGN -1));
+
+    if ((end <= start) || ((uint32_t)(end - start) < (HEAP_SMALL_SIZE + HEAP_BLOCK_OVERHEAD)))
+    {
+	return false;
+    }
+
+    if (_sbrk(end - current) == (void*)-1)
+    {
+	return false;
+    }
+
+    block = (heap_block_t*)start;
+    sentinel = (heap_block_t*)(end - HEAP_BLOCK_OVERHEAD);
+
+    block->prev_phys = NULL;
+    block->size = ((uint8_t*)sentinel - start) | HEAP_BLOCK_FREE;
+
+    sentinel->prev_phys = block;
+    sentinel->size = HEAP_BLOCK_OVERHEAD;
+
+    heap_control.size = end - start;
+
+    heap_insert(block);
+
+    return true;
+}
+
+static void *heap_pool_allocate(unsigned int class)
+{
+    heap_pool_t *pool;
+    heap_block_t *block;
+    uint32_t *tag;
+    uint8_t *data;
+    unsigned int stride, count, index;
+    void *p;
+
+    pool = &heap_control.pools[class];
+
+    p = pool->free;
+
+    if (p)
+    {
+	pool->free = *((void**)p);
+	pool->count--;
+
+	return p;
+    }
+
+    stride = heap_pool_size[class];
+    count = HEAP_POOL_CHUNK / stride;
+
+    if (count < 2)
+    {
+	count = 2;
+    }
+
+    /* Each tag sits right in front of its payload. The first one is 4 bytes into
+     * the chunk's payload, so that all pool payloads are 8 byte aligned.
+     */
+    block = heap_tlsf_allocate(HEAP_BLOCK_OVERHEAD + HEAP_ALIGN_UP(HEAP_POOL_TAG_SIZE + count * stride));
+
+    if (!block)
+    {
+	count = 1;
+
+	block = heap_tlsf_allocate(HEAP_BLOCK_OVERHEAD + HEAP_ALIGN_UP(HEAP_POOL_TAG_SIZE + stride));
+
+	if (!block)
+	{
+	    return NULL;
+	}
+    }
+
+    data = (uint8_t*)block + HEAP_BLOCK_OVERHEAD + HEAP_POOL_TAG_SIZE;
+
+    for (index = 0; index < count; index++, data += stride)
+    {
+	tag = (uint32_t*)data;
+
+	*tag = (class << 3) | HEAP_BLOCK_POOL;
+
+	if (index != 0)
+	{
+	    *((void**)(tag +1)) = pool->free;
+
+	    pool->free = (void*)(tag +1);
+	}
+    }
+
+    pool->total += count;
+    pool->count += (count -1);
+
+    return (void*)((uint8_t*)block + HEAP_BLOCK_OVERHEAD + HEAP_POOL_TAG_SIZE + HEAP_POOL_TAG_SIZE);
+}
+
+static void *heap_allocate(size_t nbytes)
+{
+    heap_block_t *block;
+    uint32_t basepri;
+    void *p;
+
+    p = NULL;
+
+    basepri = heap_lock();
+
+    if (heap_control.size || heap_initialize())
+    {
+	if (nbytes <= HEAP_POOL_MAXIMUM)
+	{
+	    p = heap_pool_allocate(heap_pool_class[(nbytes + HEAP_POOL_TAG_SIZE + 15) >> 4]);
+	}
+	else
+	{
+	    if (nbytes <= heap_control.size)
+	    {
+		block = heap_tlsf_allocate(HEAP_BLOCK_OVERHEAD + HEAP_ALIGN_UP(nbytes));
+
+		if (block)
+		{
+		    p = (void*)((uint8_t*)block + HEAP_BLOCK_OVERHEAD);
+		}
+	    }
+	}
+    }
+
+    if (!p)
+    {
+	heap_control.failed++;
+    }
+    else
+    {
+	heap_watermark();
+    }
+
+    heap_unlock(basepri);
+
+    return p;
+}
+
+static void heap_free(void *p)
+{
+    heap_pool_t *pool;
+    uint32_t basepri, tag;
+
+    if (!p)
+    {
+	return;
+    }
+
+    tag = ((const uint32_t*)p)[-1];
+
+    basepri = heap_lock();
+
+    if (tag & HEAP_BLOCK_POOL)
+    {
+	pool = &heap_control.pools[tag >> 3];
+
+	*((void**)p) = pool->free;
+
+	pool->free = p;
+	pool->count++;
+    }
+    else
+    {
+	heap_tlsf_free((heap_block_t*)((uint8_t*)p - HEAP_BLOCK_OVERHEAD));
+    }
+
+    heap_unlock(basepri);
+}
+
+static size_t heap_usable_size(const void *p)
+{
+    uint32_t tag;
+
+    if (!p)
+    {
+	return 0;
+    }
+
+    tag = ((const uint32_t*)p)[-1];
+
+    if (tag & HEAP_BLOCK_POOL)
+    {
+	return heap_pool_size[tag >> 3] - HEAP_POOL_TAG_SIZE;
+    }
+    else
+    {
+	return (tag & ~HEAP_BLOCK_MASK) - HEAP_BLOCK_OVERHEAD;
+    }
+}
+
+static void *heap_reallocate(void *p, size_t nbytes)
+{
+    heap_block_t *block, *next;
+    uint32_t basepri, size;
+    size_t usable;
+    void *q;
+
+    if (!p)
+    {
+	return heap_allocate(nbytes);
+    }
+
+    if (nbytes == 0)
+    {
+	heap_free(p);
+
+	return NULL;
+    }
+
+    usable = heap_usable_size(p);
+
+    if (nbytes <= usable)
+    {
+	return p;
+    }
+
+    /* A TLSF block can grow in place if it is followed by a large enough free block.
+     */
+    if (!(((const uint32_t*)p)[-1] & HEAP_BLOCK_POOL) && (nbytes <= heap_control.size))
+    {
+	block = (heap_block_t*)((uint8_t*)p - HEAP_BLOCK_OVERHEAD);
+
+	size = HEAP_BLOCK_OVERHEAD + HEAP_ALIGN_UP(nbytes);
+
+	basepri = heap_lock();
+
+	next = heap_block_next(block);
+
+	if ((next->size & HEAP_BLOCK_FREE) && ((heap_block_size(block) + heap_block_size(next)) >= size))
+	{
+	    heap_remove(next);
+
+	    block->size = heap_block_size(block) + heap_block_size(next);
+
+	    heap_block_next(block)->prev_phys = block;
+
+	    heap_split(block, size);
+
+	    heap_watermark();
+
+	    heap_unlock(basepri);
+
+	    return p;
+	}
+
+	heap_unlock(basepri);
+    }
+
+    q = heap_allocate(nbytes);
+
+    if (q)
+    {
+	memcpy(q, p, usable);
+
+	heap_free(p);
+    }
+
+    return q;
+}
+
+static void *heap_allocate_aligned(size_t align, size_t nbytes)
+{
+    heap_block_t *block, *aligned;
+    uint32_t basepri, size, gap, data;
+
+    if (align <= HEAP_ALIGN)
+    {
+	return heap_allocate(nbytes);
+    }
+
+    if (align & (align -1))
+    {
+	return NULL;
+    }
+
+    size = HEAP_BLOCK_OVERHEAD + HEAP_ALIGN_UP(nbytes);
+
+    aligned = NULL;
+
+    basepri = heap_lock();
+
+    if ((heap_control.size || heap_initialize()) && (nbytes <= heap_control.size))
+    {
+	/* Leave room to split off a leading free block in front of the aligned payload.
+	 */
+	block = heap_tlsf_allocate(size + align + HEAP_BLOCK_MINIMUM);
+
+	if (block)
+	{
+	    data = (uint32_t)block + HEAP_BLOCK_OVERHEAD;
+	    gap = ((data + (align -1)) & ~(align -1)) - data;
+
+	    if (gap && (gap < HEAP_BLOCK_MINIMUM))
+	    {
+		gap = ((data + HEAP_BLOCK_MINIMUM + (align -1)) & ~(align -1)) - data;
+	    }
+
+	    if (gap)
+	    {
+		aligned = (heap_block_t*)((uint8_t*)block + gap);
+
+		aligned->prev_phys = block;
+		aligned->size = heap_block_size(block) - gap;
+
+		heap_block_next(aligned)->prev_phys = aligned;
+
+		block->size = gap;
+
+		heap_tlsf_free(block);
+	    }
+	    else
+	    {
+		aligned = block;
+	    }
+
+	    heap_split(aligned, size);
+	}
+    }
+
+    if (!aligned)
+    {
+	heap_control.failed++;
+    }
+    else
+    {
+	heap_watermark();
+    }
+
+    heap_unlock(basepri);
+
+    return aligned ? (void*)((uint8_t*)aligned + HEAP_BLOCK_OVERHEAD) : NULL;
+}
+
+bool stm32l4_heap_info(stm32l4_heap_info_t *info)
+{
+    heap_block_t *block;
+    uint32_t basepri, fl_map, sl_map;
+    unsigned int fl, sl, class;
+
+    memset(info, 0, sizeof(stm32l4_heap_info_t));
+
+    basepri = heap_lock();
+
+    info->size = heap_control.size;
+    info->used = heap_control.size - heap_control.free;
+    info->free = heap_control.free;
+    info->peak = heap_control.peak;
+    info->blocks = heap_control.blocks;
+    info->failed = heap_control.failed;
+
+    /* The largest free block is in the highest non-empty list.
+     */
+    fl_map = heap_control.fl_bitmap;
+
+    if (fl_map)
+    {
+	fl = 31 - __builtin_clz(fl_map);
+	sl_map = heap_control.sl_bitmap[fl];
+	sl = 31 - __builtin_clz(sl_map);
+
+	for (block = heap_control.lists[fl][sl]; block; block = block->next_free)
+	{
+	    if (info->largest < heap_block_size(block))
+	    {
+		info->largest = heap_block_size(block);
+	    }
+	}
+    }
+
+    for (class = 0; class < STM32L4_HEAP_POOL_COUNT; class++)
+    {
+	info->pool_size[class] = heap_pool_size[class];
+	info->pool_total[class] = heap_control.pools[class].total;
+	info->pool_free[class] = heap_control.pools[class].count;
+    }
+
+    heap_unlock(basepri);
+
+    return true;
+}
+
+bool stm32l4_heap_usage(uint32_t *p_used_return, uint32_t *p_peak_return)
+{
+    uint32_t basepri;
+
+    if (!heap_control.size)
+    {
+	return false;
+    }
+
+    basepri = heap_lock();
+
+    *p_used_return = heap_control.size - heap_control.free;
+    *p_peak_return = heap_control.peak;
+
+    heap_unlock(basepri);
+
+    return true;
+}
+
+void *_malloc_r(struct _reent *reent, size_t nbytes)
+{
+    void *p;
+
+    p = heap_allocate(nbytes);
+
+    if (!p)
+    {
+	reent->_errno = ENOMEM;
+    }
+
+    return p;
+}
+
+void _free_r(struct _reent *reent, void *p)
+{
+    heap_free(p);
+}
+
+void *_realloc_r(struct _reent *reent, void *p, size_t nbytes)
+{
+    void *q;
+
+    q = heap_reallocate(p, nbytes);
+
+    if (!q && nbytes)
+    {
+	reent->_errno = ENOMEM;
+    }
+
+    return q;
+}
+
+void *_calloc_r(struct _reent *reent, size_t count, size_t size)
+{
+    void *p;
+
+    if (size && (count > (0xffffffff / size)))
+    {
+	reent->_errno = ENOMEM;
+
+	return NULL;
+    }
+
+    p = _malloc_r(reent, count * size);
+
+    if (p)
+    {
+	memset(p, 0, count * size);
+    }
+
+    return p;
+}
+
+void *_memalign_r(struct _reent *reent, size_t align, size_t nbytes)
+{
+    void *p;
+
+    p = heap_allocate_aligned(align, nbytes);
+
+    if (!p)
+    {
+	reent->_errno = ENOMEM;
+    }
+
+    return p;
+}
+
+size_t _malloc_usable_size_r(struct _reent *reent, void *p)
+{
+    return heap_usable_size(p);
+}
+
+struct mallinfo _mallinfo_r(struct _reent *reent)
+{
+    struct mallinfo mi;
+    stm32l4_heap_info_t info;
+    unsigned int class;
+
+    stm32l4_heap_info(&info);
+
+    memset(&mi, 0, sizeof(mi));
+
+    mi.arena = info.size;
+    mi.ordblks = info.blocks;
+    mi.uordblks = info.used;
+    mi.fordblks = info.free;
+    mi.keepcost = info.largest;
+
+    for (class = 0; class < STM32L4_HEAP_POOL_COUNT; class++)
+    {
+	mi.smblks += info.pool_free[class];
+	mi.fsmblks += info.pool_free[class] * info.pool_size[class];
+    }
+
+    return mi;
+}
+
+void _malloc_stats_r(struct _reent *reent)
+{
+}
+
+int _mallopt_r(struct _reent *reent, int parameter, int value)
+{
+    return 0;
+}
+
+void *malloc(size_t nbytes)
+{
+    return _malloc_r(_REENT, nbytes);
+}
+
+void free(void *p)
+{
+    heap_free(p);
+}
+
+void *realloc(void *p, size_t nbytes)
+{
+    return _realloc_r(_REENT, p, nbytes);
+}
+
+void *calloc(size_t count, size_t size)
+{
+    return _calloc_r(_REENT, count, size);
+}
+
+void *memalign(size_t align, size_t nbytes)
+{
+    return _memalign_r(_REENT, align, nbytes);
+}
+
+size_t malloc_usable_size(void *p)
+{
+    return heap_usable_size(p);
+}
+
+struct mallinfo mallinfo(void)
+{
+    return _mallinfo_r(_REENT);
+}
+
+void malloc_stats(void)
+{
+}
+
+int mallopt(int parameter, int value)
+{
+    return 0;
+}
+
+#else /* STM32L4_HEAP == 1 */
+
+bool stm32l4_heap_info(stm32l4_heap_info_t *info)
+{
+    return false;
+}
+
+bool stm32l4_heap_usage(uint32_t *p_used_return, uint32_t *p_peak_return)
+{
+    return false;
+}
+
+#endif /* STM32L4_HEAP == 1 */
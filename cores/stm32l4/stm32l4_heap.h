@@ -0,0 +1,76 @@
+/*
+ * Copyright (c) 2016 Thomas Roell.  All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal with the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ *  1. Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimers.
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimers in the
+ *     documentation and/or other materials provided with the distribution.
+ *  3. Neither the name of Thomas Roell, nor the names of its contributors
+ *     may be used to endorse or promote products derived from this Software
+ *     without specific prior written permission.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ * CONTRIBUTORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * WITH THE SOFTWARE.
+ */
+
+#ifndef _STM32L4_HEAP_
+#define _STM32L4_HEAP_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* With STM32L4_HEAP=1 (Tools -> Heap), malloc() & co are provided by the core
+ * instead of newlib. Requests of up to 252 bytes are served from per size
+ * class pools (16 .. 256 byte blocks), which never give their blocks back,
+ * and everything else by a TLSF allocator with immediate coalescing. Both
+ * take constant time, and are IRQ safe.
+ */
+
+#define STM32L4_HEAP_POOL_COUNT 8
+
+typedef struct _stm32l4_heap_info_t {
+    uint32_t   size;                                  /* bytes managed */
+    uint32_t   used;                                  /* TLSF bytes in use, including pool chunks */
+    uint32_t   free;                                  /* TLSF bytes free */
+    uint32_t   peak;                                  /* highest "used" so far */
+    uint32_t   largest;                               /* largest free TLSF block */
+    uint32_t   blocks;                                /* number of free TLSF blocks */
+    uint32_t   failed;                                /* number of failed allocations */
+    uint16_t   pool_size[STM32L4_HEAP_POOL_COUNT];    /* block size per class */
+    uint32_t   pool_total[STM32L4_HEAP_POOL_COUNT];   /* blocks per class */
+    uint32_t   pool_free[STM32L4_HEAP_POOL_COUNT];    /* free blocks per class */
+} stm32l4_heap_info_t;
+
+/* Returns false if the newlib allocator is in use.
+ */
+extern bool stm32l4_heap_info(stm32l4_heap_info_t *info);
+
+/* "used" and "peak" of stm32l4_heap_info(), for armv7m_core_heap_statistics(). The
+ * TLSF heap takes all of the memory up to the stack in one _sbrk(), so the break
+ * says nothing about its usage. Returns false if the newlib allocator is in use,
+ * or nothing was allocated yet.
+ */
+extern bool stm32l4_heap_usage(uint32_t *p_used_return, uint32_t *p_peak_return);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _STM32L4_HEAP_ */
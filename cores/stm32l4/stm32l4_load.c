@@ -0,0 +1,305 @@
+/*
+ * Copyright (c) 2017 Thomas Roell.  All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal with the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ *  1. Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimers.
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimers in the
+ *     documentation and/or other materials provided with the distribution.
+ *  3. Neither the name of Thomas Roell, nor the names of its contributors
+ *     may be used to endorse or promote products derived from this Software
+ *     without specific prior written permission.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ * CONTRIBUTORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * WITH THE SOFTWARE.
+ */
+
+#include "Arduino.h"
+#include "stm32l4_wiring_private.h"
+#include "stm32l4_load.h"
+#include "stm32l4_nvic.h"
+
+#define STM32L4_LOAD_VECTOR_COUNT (16 + 96)
+
+/* Priority ceiling of the bookkeeping. The trampoline updates it from every hooked handler,
+ * so this is the most urgent priority in use by the core (SERVO). Interrupts at priority 0
+ * would not be masked, so none may be hooked while the meter is enabled.
+ */
+#define STM32L4_LOAD_CRITICAL_PRIORITY STM32L4_SERVO_IRQ_PRIORITY
+
+typedef struct _stm32l4_load_device_t {
+    volatile uint32_t  enabled;
+    bool               notify;
+    uint32_t           window;
+    uint32_t           context;
+    uint32_t           timestamp;
+    uint64_t           start_millis;
+    uint64_t           start_micros;
+    uint32_t           elapsed;
+    uint32_t           cycles[STM32L4_LOAD_COUNT];
+    volatile uint32_t  sequence;
+    uint32_t           report_cycles[STM32L4_LOAD_COUNT];
+    uint32_t           report_total;
+    uint32_t           vectors[STM32L4_LOAD_VECTOR_COUNT];
+} stm32l4_load_device_t;
+
+static stm32l4_load_device_t stm32l4_load_device;
+
+static void stm32l4_load_interrupt(void);
+
+/* The wall clock time of a window is accumulated in cycles per interval between two clock
+ * changes, each at the SystemCoreClock that was in effect during that interval.
+ */
+static void stm32l4_load_interval(stm32l4_load_device_t *device, uint64_t micros)
+{
+    device->elapsed += (uint32_t)(((micros - device->start_micros) * SystemCoreClock) / 1000000);
+    device->start_micros = micros;
+}
+
+static void stm32l4_load_notify_callback(void *context, uint32_t events)
+{
+    stm32l4_load_device_t *device = &stm32l4_load_device;
+    uint32_t basepri;
+
+    basepri = armv7m_critical_enter(STM32L4_LOAD_CRITICAL_PRIORITY);
+
+    if (device->enabled)
+    {
+	stm32l4_load_interval(device, armv7m_systick_micros());
+    }
+
+    armv7m_critical_leave(basepri);
+}
+
+static void stm32l4_load_close(stm32l4_load_device_t *device)
+{
+    uint32_t total, active;
+    unsigned int index;
+
+    stm32l4_load_interval(device, armv7m_systick_micros());
+
+    total = device->elapsed;
+
+    active = 0;
+
+    for (index = 0; index < STM32L4_LOAD_COUNT; index++)
+    {
+	if (index != STM32L4_LOAD_IDLE)
+	{
+	    active += device->cycles[index];
+	}
+    }
+
+    if (total < active)
+    {
+	total = active;
+    }
+
+    device->cycles[STM32L4_LOAD_IDLE] = total - active;
+
+    device->sequence++;
+
+    for (index = 0; index < STM32L4_LOAD_COUNT; index++)
+    {
+	device->report_cycles[index] = device->cycles[index];
+	device->cycles[index] = 0;
+    }
+
+    device->report_total = total;
+
+    device->elapsed = 0;
+    device->start_millis = armv7m_systick_millis();
+}
+
+/* Runs as the handler of every hooked exception. Interrupts are only masked around the
+ * bookkeeping, and the mask the trampoline was entered with is restored before the original
+ * handler is called, so that it is still preempted as usual.
+ */
+static void stm32l4_load_interrupt(void)
+{
+    stm32l4_load_device_t *device = &stm32l4_load_device;
+    uint32_t exception, context, cycles, basepri;
+
+    exception = __get_IPSR() & 0x1ff;
+
+    if (exception >= 16)
+    {
+	context = STM32L4_LOAD_PRIORITY(NVIC->IP[exception - 16] >> (8 - __NVIC_PRIO_BITS));
+    }
+    else if (exception == 14)
+    {
+	context = STM32L4_LOAD_PENDSV;
+    }
+    else
+    {
+	context = STM32L4_LOAD_PRIORITY(SCB->SHP[exception - 4] >> (8 - __NVIC_PRIO_BITS));
+    }
+
+    basepri = armv7m_critical_enter(STM32L4_LOAD_CRITICAL_PRIORITY);
+
+    cycles = DWT->CYCCNT;
+
+    device->cycles[device->context] += (cycles - device->timestamp);
+    device->timestamp = cycles;
+
+    cycles = device->context;
+    device->context = context;
+    context = cycles;
+
+    armv7m_critical_leave(basepri);
+
+    (*((void(*)(void))device->vectors[exception]))();
+
+    basepri = armv7m_critical_enter(STM32L4_LOAD_CRITICAL_PRIORITY);
+
+    cycles = DWT->CYCCNT;
+
+    device->cycles[device->context] += (cycles - device->timestamp);
+    device->timestamp = cycles;
+    device->context = context;
+
+    if ((exception == 15) && device->enabled)
+    {
+	if ((uint32_t)(armv7m_systick_millis() - device->start_millis) >= device->window)
+	{
+	    stm32l4_load_close(device);
+
+	    device->timestamp = DWT->CYCCNT;
+	}
+    }
+
+    armv7m_critical_leave(basepri);
+}
+
+bool stm32l4_load_enable(uint32_t window)
+{
+    stm32l4_load_device_t *device = &stm32l4_load_device;
+    volatile uint32_t *vectors;
+    unsigned int index;
+    uint32_t basepri;
+
+    if ((window == 0) || (window > 10000))
+    {
+	return false;
+    }
+
+    if (device->enabled)
+    {
+	device->window = window;
+
+	return true;
+    }
+
+    /* SYSTEM_EVENT_PREPARE_CLOCKS closes the interval at the old clock, SYSTEM_EVENT_CHANGE_CLOCKS
+     * the one of the switch itself.
+     */
+    if (!device->notify)
+    {
+	if (stm32l4_system_notify(-1, stm32l4_load_notify_callback, NULL, (SYSTEM_EVENT_PREPARE_CLOCKS | SYSTEM_EVENT_CHANGE_CLOCKS)) >= 0)
+	{
+	    device->notify = true;
+	}
+    }
+
+    basepri = armv7m_critical_enter(STM32L4_LOAD_CRITICAL_PRIORITY);
+
+    for (index = 0; index < STM32L4_LOAD_COUNT; index++)
+    {
+	device->cycles[index] = 0;
+	device->report_cycles[index] = 0;
+    }
+
+    device->report_total = 0;
+    device->sequence = 0;
+    device->window = window;
+    device->context = STM32L4_LOAD_LOOP;
+    device->timestamp = DWT->CYCCNT;
+    device->start_millis = armv7m_systick_millis();
+    device->start_micros = armv7m_systick_micros();
+    device->elapsed = 0;
+
+    /* The original vectors are recorded before the first interrupt can hit the
+     * trampoline. Vectors that are not populated on the part stay untouched.
+     */
+    vectors = (volatile uint32_t*)SCB->VTOR;
+
+    for (index = 14; index < STM32L4_LOAD_VECTOR_COUNT; index++)
+    {
+	device->vectors[index] = vectors[index];
+
+	if (device->vectors[index])
+	{
+	    NVIC_CatchIRQ((IRQn_Type)((int)index - 16), (uint32_t)&stm32l4_load_interrupt);
+	}
+    }
+
+    device->enabled = 1;
+
+    armv7m_critical_leave(basepri);
+
+    return true;
+}
+
+void stm32l4_load_disable(void)
+{
+    stm32l4_load_device_t *device = &stm32l4_load_device;
+    volatile uint32_t *vectors;
+    unsigned int index;
+    uint32_t basepri;
+
+    if (!device->enabled)
+    {
+	return;
+    }
+
+    basepri = armv7m_critical_enter(STM32L4_LOAD_CRITICAL_PRIORITY);
+
+    /* A vector somebody else has hooked in the meantime (e.g. the Profiler) keeps
+     * pointing to its own trampoline, which in turn still ends up here.
+     */
+    vectors = (volatile uint32_t*)SCB->VTOR;
+
+    for (index = 14; index < STM32L4_LOAD_VECTOR_COUNT; index++)
+    {
+	if (vectors[index] == (uint32_t)&stm32l4_load_interrupt)
+	{
+	    vectors[index] = device->vectors[index];
+	}
+    }
+
+    device->enabled = 0;
+
+    armv7m_critical_leave(basepri);
+}
+
+bool stm32l4_load_report(uint32_t *cycles, uint32_t *p_total)
+{
+    stm32l4_load_device_t *device = &stm32l4_load_device;
+    unsigned int index;
+    uint32_t basepri;
+
+    basepri = armv7m_critical_enter(STM32L4_LOAD_CRITICAL_PRIORITY);
+
+    for (index = 0; index < STM32L4_LOAD_COUNT; index++)
+    {
+	cycles[index] = device->report_cycles[index];
+    }
+
+    *p_total = device->report_total;
+
+    armv7m_critical_leave(basepri);
+
+    return (device->sequence != 0);
+}
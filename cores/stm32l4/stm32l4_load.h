@@ -0,0 +1,72 @@
+/*
+ * Copyright (c) 2017 Thomas Roell.  All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal with the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ *  1. Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimers.
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimers in the
+ *     documentation and/or other materials provided with the distribution.
+ *  3. Neither the name of Thomas Roell, nor the names of its contributors
+ *     may be used to endorse or promote products derived from this Software
+ *     without specific prior written permission.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ * CONTRIBUTORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * WITH THE SOFTWARE.
+ */
+
+#ifndef _STM32L4_LOAD_
+#define _STM32L4_LOAD_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "armv7m.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* CPU load meter. stm32l4_load_enable() points all interrupt vectors (but SVCall,
+ * whose handler needs the unmodified exception frame) via NVIC_CatchIRQ() to a
+ * trampoline, which charges the DWT cycles between two exception entries/exits
+ * exclusively to the context that ran: thread mode (loop), PendSV, or the NVIC
+ * priority level of the interrupt (so USB, I2C, SPI, UART, SAI ... end up in
+ * separate groups with the default priorities). The cycle counter stops in SLEEP
+ * and STOP, so "idle" is the wall clock time (armv7m_systick_micros()) of the window
+ * minus all the rest. That covers __WFE() in loopWait()/delay() as well as STOP.
+ *
+ * Every "window" milliseconds (1 .. 10000) the SysTick path closes the current window,
+ * and stm32l4_load_report() returns the cycles of the last completed one. The cost is
+ * about 40 cycles per interrupt while enabled. The wall clock time of a window that
+ * spans a clock change is converted to cycles piecewise, at the clock of each part. A
+ * window with a debugger attached (which keeps the cycle counter running in SLEEP)
+ * reports too little idle time.
+ */
+
+#define STM32L4_LOAD_LOOP             0
+#define STM32L4_LOAD_IDLE             1
+#define STM32L4_LOAD_PENDSV           2
+#define STM32L4_LOAD_PRIORITY(_n)     (3 + (_n))
+#define STM32L4_LOAD_COUNT            (3 + 16)
+
+extern bool stm32l4_load_enable(uint32_t window);
+extern void stm32l4_load_disable(void);
+extern bool stm32l4_load_report(uint32_t *cycles, uint32_t *p_total);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _STM32L4_LOAD_ */
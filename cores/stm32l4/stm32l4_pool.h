@@ -0,0 +1,309 @@
+/*
+ * Copyright (c) 2017 Thomas Roell.  All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal with the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ *  1. Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimers.
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimers in the
+ *     documentation and/or other materials provided with the distribution.
+ *  3. Neither the name of Thomas Roell, nor the names of its contributors
+ *     may be used to endorse or promote products derived from this Software
+ *     without specific prior written permission.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ * CONTRIBUTORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * WITH THE SOFTWARE.
+ */
+
+#if !defined(_STM32L4_POOL_H)
+#define _STM32L4_POOL_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include "armv7m.h"
+
+#ifdef __cplusplus
+ extern "C" {
+#endif
+
+/* Fixed size block pool and bounded FIFO that can be used from threads as well
+ * as from interrupt handlers at any priority (and from PendSV routines). Neither
+ * masks interrupts.
+ *
+ * The pool is a LIFO free-list of block indices. "head" holds a 16 bit
+ * generation count in the upper half and the index of the first free block in
+ * the lower half, so that a block taken and given back by a preempting handler
+ * between the load of "head" and the compare-exchange (ABA) is detected.
+ *
+ * The queue is a ring of "count" (a power of 2) entries, where each entry has a
+ * sequence number. A producer claims position "head" if the entry's sequence
+ * equals "head", fills it in and publishes it by setting the sequence to
+ * "head + 1". A consumer takes position "tail" once the entry's sequence equals
+ * "tail + 1", and hands it back by setting it to "tail + count".
+ *
+ * Storage is supplied by the caller. For C++ see Pool.h.
+ */
+
+#define STM32L4_POOL_NONE        0xffff
+#define STM32L4_POOL_COUNT_MAX   0xfffe
+
+typedef struct _stm32l4_pool_t {
+    volatile uint32_t        head;
+    uint16_t                 *link;
+    uint8_t                  *data;
+    uint16_t                 size;
+    uint16_t                 count;
+} stm32l4_pool_t;
+
+typedef struct _stm32l4_queue_t {
+    volatile uint32_t        head;
+    volatile uint32_t        tail;
+    volatile uint32_t        *sequence;
+    uint8_t                  *data;
+    uint16_t                 size;
+    uint16_t                 mask;
+} stm32l4_queue_t;
+
+static inline void stm32l4_pool_create(stm32l4_pool_t *pool, void *data, uint16_t *link, unsigned int size, unsigned int count)
+{
+    unsigned int index;
+
+    for (index = 0; index < count; index++)
+    {
+	link[index] = ((index +1) < count) ? (index +1) : STM32L4_POOL_NONE;
+    }
+
+    pool->link = link;
+    pool->data = (uint8_t*)data;
+    pool->size = size;
+    pool->count = count;
+    pool->head = count ? 0 : STM32L4_POOL_NONE;
+}
+
+/* Returns the index of a free block, or STM32L4_POOL_NONE if there is none.
+ */
+static inline unsigned int stm32l4_pool_take(stm32l4_pool_t *pool)
+{
+    uint32_t head, index;
+
+    head = pool->head;
+
+    do
+    {
+	index = head & 0xffff;
+
+	if (index == STM32L4_POOL_NONE)
+	{
+	    return STM32L4_POOL_NONE;
+	}
+
+	/* "link[index]" may be stale if the block got taken in the meantime, but then
+	 * the generation count has moved on and the compare-exchange fails.
+	 */
+    }
+    while (!armv7m_atomic_compare_exchange(&pool->head, &head, ((head + 0x00010000) & 0xffff0000) | pool->link[index]));
+
+    return index;
+}
+
+static inline void stm32l4_pool_give(stm32l4_pool_t *pool, unsigned int index)
+{
+    uint32_t head;
+
+    head = pool->head;
+
+    do
+    {
+	pool->link[index] = head & 0xffff;
+    }
+    while (!armv7m_atomic_compare_exchange(&pool->head, &head, ((head + 0x00010000) & 0xffff0000) | index));
+}
+
+static inline void *stm32l4_pool_allocate(stm32l4_pool_t *pool)
+{
+    unsigned int index;
+
+    index = stm32l4_pool_take(pool);
+
+    if (index == STM32L4_POOL_NONE)
+    {
+	return NULL;
+    }
+
+    return (void*)(pool->data + index * pool->size);
+}
+
+static inline void stm32l4_pool_free(stm32l4_pool_t *pool, void *p)
+{
+    if (p)
+    {
+	stm32l4_pool_give(pool, ((uint8_t*)p - pool->data) / pool->size);
+    }
+}
+
+/* "count" has to be a power of 2.
+ */
+static inline void stm32l4_queue_create(stm32l4_queue_t *queue, void *data, volatile uint32_t *sequence, unsigned int size, unsigned int count)
+{
+    unsigned int index;
+
+    for (index = 0; index < count; index++)
+    {
+	sequence[index] = index;
+    }
+
+    queue->sequence = sequence;
+    queue->data = (uint8_t*)data;
+    queue->size = size;
+    queue->mask = count -1;
+    queue->head = 0;
+    queue->tail = 0;
+}
+
+/* Producer side: returns the entry to be filled in or NULL if the queue is full. The
+ * entry has to be handed to stm32l4_queue_publish() together with "*p_sequence_return".
+ */
+static inline void *stm32l4_queue_claim(stm32l4_queue_t *queue, uint32_t *p_sequence_return)
+{
+    uint32_t head, index;
+    int32_t delta;
+
+    head = queue->head;
+
+    while (1)
+    {
+	index = head & queue->mask;
+
+	delta = (int32_t)(queue->sequence[index] - head);
+
+	if (delta == 0)
+	{
+	    if (armv7m_atomic_compare_exchange(&queue->head, &head, head + 1))
+	    {
+		*p_sequence_return = head;
+
+		return (void*)(queue->data + index * queue->size);
+	    }
+	}
+	else if (delta < 0)
+	{
+	    return NULL;
+	}
+	else
+	{
+	    head = queue->head;
+	}
+    }
+}
+
+static inline void stm32l4_queue_publish(stm32l4_queue_t *queue, uint32_t sequence)
+{
+    __asm__ volatile ("dmb" : : : "memory");
+
+    queue->sequence[sequence & queue->mask] = sequence + 1;
+}
+
+/* Consumer side: returns the oldest entry or NULL if the queue is empty. The entry
+ * has to be handed back via stm32l4_queue_release() together with "*p_sequence_return".
+ */
+static inline void *stm32l4_queue_acquire(stm32l4_queue_t *queue, uint32_t *p_sequence_return)
+{
+    uint32_t tail, index;
+    int32_t delta;
+
+    tail = queue->tail;
+
+    while (1)
+    {
+	index = tail & queue->mask;
+
+	delta = (int32_t)(queue->sequence[index] - (tail + 1));
+
+	if (delta == 0)
+	{
+	    if (armv7m_atomic_compare_exchange(&queue->tail, &tail, tail + 1))
+	    {
+		*p_sequence_return = tail;
+
+		return (void*)(queue->data + index * queue->size);
+	    }
+	}
+	else if (delta < 0)
+	{
+	    return NULL;
+	}
+	else
+	{
+	    tail = queue->tail;
+	}
+    }
+}
+
+static inline void stm32l4_queue_release(stm32l4_queue_t *queue, uint32_t sequence)
+{
+    __asm__ volatile ("dmb" : : : "memory");
+
+    queue->sequence[sequence & queue->mask] = sequence + queue->mask + 1;
+}
+
+static inline bool stm32l4_queue_send(stm32l4_queue_t *queue, const void *element)
+{
+    uint32_t sequence;
+    void *entry;
+
+    entry = stm32l4_queue_claim(queue, &sequence);
+
+    if (!entry)
+    {
+	return false;
+    }
+
+    memcpy(entry, element, queue->size);
+
+    stm32l4_queue_publish(queue, sequence);
+
+    return true;
+}
+
+static inline bool stm32l4_queue_receive(stm32l4_queue_t *queue, void *element)
+{
+    uint32_t sequence;
+    void *entry;
+
+    entry = stm32l4_queue_acquire(queue, &sequence);
+
+    if (!entry)
+    {
+	return false;
+    }
+
+    memcpy(element, entry, queue->size);
+
+    stm32l4_queue_release(queue, sequence);
+
+    return true;
+}
+
+static inline unsigned int stm32l4_queue_count(const stm32l4_queue_t *queue)
+{
+    return queue->head - queue->tail;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _STM32L4_POOL_H */
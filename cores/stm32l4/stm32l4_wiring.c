@@ -99,7 +99,8 @@ void HardFault_Handler (void) {
   
 void __attribute__((used)) HardFault_Handler_C(uint32_t *frame, uint32_t lr)
 {
-  volatile uint32_t pc  __attribute__((unused)) = frame[6];
+    stm32l4_crash_capture(frame, lr);
+
     while (1)
     {
 #if defined(USBCON)
@@ -107,31 +108,116 @@ void __attribute__((used)) HardFault_Handler_C(uint32_t *frame, uint32_t lr)
 #endif
     }
 }
-  
-void BusFault_Handler(void)
+
+/* The configurable faults share the HardFault path, so that they get captured as well.
+ */
+void MemManage_Handler(void) __attribute__((alias("HardFault_Handler")));
+void BusFault_Handler(void) __attribute__((alias("HardFault_Handler")));
+void UsageFault_Handler(void) __attribute__((alias("HardFault_Handler")));
+
+static volatile uint32_t stm32l4_loop_mode = LOOP_MODE_CONTINUOUS;
+static volatile uint32_t stm32l4_loop_timeout = 0;
+static volatile uint32_t stm32l4_loop_events = 0;
+
+void loopMode(uint32_t mode, uint32_t timeout)
 {
-    while (1)
+    stm32l4_loop_timeout = timeout;
+    stm32l4_loop_mode = mode;
+
+    loopWakeup();
+}
+
+void loopWakeup(void)
+{
+    stm32l4_loop_events = 1;
+
+    __SEV();
+}
+
+/* Exception return sets the event register, so an event posted between the
+ * check and __WFE() simply makes __WFE() return right away. For STOP the check
+ * is done with interrupts masked, as stm32l4_system_stop() enters STOP with
+ * PRIMASK set and wakes up on the pending interrupt.
+ */
+void loopWait(void)
+{
+    uint32_t start, elapsed, timeout, primask;
+    bool stopped;
+
+    if (stm32l4_loop_mode == LOOP_MODE_CONTINUOUS)
     {
-#if defined(USBCON)
-	USBD_Poll();
-#endif
+	return;
+    }
+
+    start = millis();
+
+    while (!stm32l4_loop_events)
+    {
+	timeout = stm32l4_loop_timeout;
+
+	if (timeout)
+	{
+	    elapsed = millis() - start;
+
+	    if (elapsed >= timeout)
+	    {
+		break;
+	    }
+
+	    timeout -= elapsed;
+	}
+
+	stopped = false;
+
+	if (stm32l4_loop_mode == LOOP_MODE_STOP)
+	{
+	    primask = __get_PRIMASK();
+
+	    __disable_irq();
+
+	    if (!stm32l4_loop_events)
+	    {
+		stopped = stm32l4_system_stop(timeout);
+	    }
+	    else
+	    {
+		stopped = true;
+	    }
+
+	    __set_PRIMASK(primask);
+	}
+
+	if (!stopped)
+	{
+	    __WFE();
+	}
     }
+
+    stm32l4_loop_events = 0;
 }
 
-void UsageFault_Handler(void)
+void initStorage( void )
 {
-    while (1)
+#if (DOSFS_SFLASH >= 1)
+    static uint8_t initialized = 0;
+
+    if (!initialized)
     {
-#if defined(USBCON)
-	USBD_Poll();
-#endif
+	initialized = 1;
+
+	dosfs_sflash_init();
     }
+#endif
 }
 
 void init( void )
 {
     stm32l4_system_initialize(_SYSTEM_CORE_CLOCK_, _SYSTEM_CORE_CLOCK_/2, _SYSTEM_CORE_CLOCK_/2, STM32L4_CONFIG_LSECLK, STM32L4_CONFIG_HSECLK, STM32L4_CONFIG_SYSOPT);
 
+    armv7m_core_fpu_configure(ARMV7M_CORE_FPU_MODE_LAZY);
+
+    stm32l4_crash_initialize();
+
     armv7m_svcall_initialize();
     armv7m_pendsv_initialize();
     armv7m_systick_initialize(STM32L4_SYSTICK_IRQ_PRIORITY);
@@ -139,6 +225,8 @@ void init( void )
 
     stm32l4_rtc_configure(STM32L4_RTC_IRQ_PRIORITY);
 
+    stm32l4_flash_configure(STM32L4_FLASH_IRQ_PRIORITY);
+
     stm32l4_exti_create(&stm32l4_exti, STM32L4_EXTI_IRQ_PRIORITY);
     stm32l4_exti_enable(&stm32l4_exti);
 
@@ -184,8 +272,8 @@ void init( void )
 #elif (DOSFS_SDCARD == 3)
     stm32l4_sdmmc_initialize(STM32L4_SDMMC_OPTION_HIGH_SPEED);
 #endif
-#if (DOSFS_SFLASH >= 1)
-    dosfs_sflash_init();
+#if (STM32L4_CONFIG_FASTBOOT == 0)
+    initStorage();
 #endif
 
     /* This is here to work around a linker issue in avr/fdevopen.c */
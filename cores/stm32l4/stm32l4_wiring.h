@@ -36,6 +36,8 @@ extern "C" {
 #endif
 
 #include "armv7m.h"
+#include "stm32l4_crash.h"
+#include "stm32l4_load.h"
 
 #define retained __attribute__((section(".backup")))
 
@@ -77,6 +79,28 @@ static inline void delayMicroseconds(uint32_t usec)
 
 extern void init(void);
 
+/*
+ * Event driven loop. With LOOP_MODE_SLEEP or LOOP_MODE_STOP, main() only calls loop()
+ * again after an event source posted loopWakeup(), or after "timeout" milliseconds
+ * (0 waits forever). attachInterrupt()/attachInterruptCapture() handlers, as well as
+ * Serial/SerialUSB receive wake up loop() on their own. Other sources (timer, SAI or
+ * DMA callbacks) call loopWakeup() from their handler.
+ *
+ * LOOP_MODE_SLEEP waits in __WFE(), so the wakeup latency is the interrupt exit plus a
+ * few cycles. SysTick still fires every millisecond, but only posted events run loop().
+ * LOOP_MODE_STOP waits in stm32l4_system_stop(), which adds the clock restart after
+ * STOP (up to about 100us with the PLL in use). Sources that cannot run in STOP
+ * (USB, UART without LSE) either hold STOP off, in which case the core falls back to
+ * __WFE(), or have to be covered by "timeout".
+ */
+#define LOOP_MODE_CONTINUOUS 0
+#define LOOP_MODE_SLEEP      1
+#define LOOP_MODE_STOP       2
+
+extern void loopMode(uint32_t mode, uint32_t timeout);
+extern void loopWakeup(void);
+extern void loopWait(void);
+
 
 typedef enum _eAnalogReference {
   AR_DEFAULT,
@@ -85,10 +109,49 @@ typedef enum _eAnalogReference {
 extern void analogReference(eAnalogReference reference);
 extern void analogReadResolution(int resolution);
 extern uint32_t analogRead(uint32_t pin);
+// STM32L4 EXTENSION: average "ratio" (2 .. 256, power of 2) conversions in hardware. Ratios of
+// 16 and above yield up to 16 significant bits, which analogReadResolution() can pick up.
+extern uint32_t analogReadOversampled(uint32_t pin, uint32_t ratio);
+// STM32L4 EXTENSION: scan "pins" "rate" times per second into the ring "buffer" of "size" samples.
+// "callback(data, count)" is called from an interrupt handler whenever a half of "buffer" has been
+// filled with raw 12 bit results, ordered as in "pins".
+extern bool analogReadContinuous(const uint32_t *pins, unsigned int count, uint32_t rate, uint16_t *buffer, unsigned int size, void(*callback)(const uint16_t *data, unsigned int count));
+extern void analogReadContinuousStop(void);
+// STM32L4 EXTENSION: convert up to 4 "pins" once per PWM period of "pwmPin" (which needs to be
+// running via analogWrite()), at ANALOG_SYNC_PERIOD the start of the period, or ANALOG_SYNC_RISING /
+// ANALOG_SYNC_FALLING where "pwmPin" switches on / off. "callback(data, count)" is called from an
+// interrupt handler with the raw 12 bit results, ordered as in "pins". analogRead() keeps working.
+#define ANALOG_SYNC_PERIOD  0
+#define ANALOG_SYNC_RISING  1
+#define ANALOG_SYNC_FALLING 2
+extern bool analogReadSynchronized(uint32_t pwmPin, uint32_t phase, const uint32_t *pins, unsigned int count, void(*callback)(const uint16_t *data, unsigned int count));
+extern void analogReadSynchronizedStop(void);
 extern void analogWriteResolution(int resolution);
 extern void analogWriteFrequency(uint32_t pin, uint32_t frequency);
 extern void analogWriteRange(uint32_t pin, uint32_t range);
 extern void analogWrite(uint32_t pin, uint32_t value);
+// STM32L4 EXTENSION: like analogWrite() for "count" pins, PWM pins sharing a timer switch to their
+// new values at the same PWM period boundary.
+extern void analogWriteMulti(const uint32_t *pins, const uint32_t *values, unsigned int count);
+// STM32L4 EXTENSION: emit "count" PWM periods on a PWM pin, the duty cycle of each taken from "slots"
+// (in analogWriteRange() units), via DMA. Use analogWriteFrequency()/analogWriteRange() first to set
+// the slot timing, e.g. 800000/100 for WS2812 LEDs. End "slots" with a few 0 entries to hold the line
+// low (reset). "callback" is called from an interrupt handler when the burst is done.
+extern bool analogWriteBurst(uint32_t pin, const uint16_t *slots, unsigned int count, void(*callback)(void));
+extern bool analogWriteBurstDone(uint32_t pin);
+// STM32L4 EXTENSION: expand "count" bytes (e.g. GRB pixels) MSB first into 8 slots each, "zero" or
+// "one" per bit. Returns the number of slots written.
+extern unsigned int analogWriteBurstEncode(uint16_t *slots, const uint8_t *data, unsigned int count, uint32_t zero, uint32_t one);
+// STM32L4 EXTENSION: like analogWrite(), but "value" carries "bits" (1 .. 5) extra bits of resolution,
+// which are dithered over consecutive PWM periods via DMA. Keeps low duty cycles smooth (LED dimming)
+// at PWM frequencies where the timer range is small. One pin per timer, analogWrite() ends dithering.
+extern bool analogWriteDither(uint32_t pin, uint32_t value, unsigned int bits);
+// STM32L4 EXTENSION: play the ring "buffer" of "size" raw 12 bit samples on a DAC pin at "rate"
+// samples per second (paced by TIM6). "callback(data, count)" is called from an interrupt handler
+// whenever a half of "buffer" has been played and can be refilled. TIM6 is the Servo timer, so
+// this fails once a Servo object exists.
+extern bool analogWriteStream(uint32_t pin, uint32_t rate, uint16_t *buffer, unsigned int size, void(*callback)(uint16_t *data, unsigned int count));
+extern void analogWriteStreamStop(void);
 
 extern void pinMode(uint32_t pin, uint32_t mode);
 extern void digitalWrite(uint32_t pin, uint32_t value);
@@ -98,14 +161,59 @@ typedef void (*voidFuncPtr)(void);
 extern void attachInterrupt(uint32_t pin, voidFuncPtr callback, uint32_t mode);
 extern void detachInterrupt(uint32_t pin);
 
+// STM32L4 EXTENSION: capture mode for attachInterrupt(). Instead of calling back, the EXTI
+// interrupt handler appends a timestamped record per edge to a lock-free ring of
+// INTERRUPT_CAPTURE_SIZE entries, which is drained in bulk by readInterruptCapture().
+// Edges that do not fit into the ring are counted by interruptCaptureOverruns().
+// detachInterrupt() ends the capture for a pin.
+#define INTERRUPT_CAPTURE_SIZE 64
+
+typedef struct _InterruptCapture
+{
+  uint32_t                micros;
+  uint8_t                 pin;
+  uint8_t                 level;
+} InterruptCapture;
+
+extern void attachInterruptCapture(uint32_t pin, uint32_t mode);
+extern unsigned int readInterruptCapture(InterruptCapture *records, unsigned int count);
+extern unsigned int interruptCaptureAvailable(void);
+extern uint32_t interruptCaptureOverruns(void);
+
 extern uint32_t pulseIn(uint32_t pin, uint32_t state, uint32_t timeout);
 #ifdef __cplusplus
 extern uint32_t pulseIn(uint32_t pin, uint32_t state, uint32_t timeout = 1000000L);
 #endif
+// STM32L4 EXTENSION: measure a pulse by timer input capture. "callback(width)" is called from an
+// interrupt handler with the width in microseconds once the pulse has ended. The pin has to be a
+// PWM pin with a timer input (not CHxN, TIM16, TIM17), whose timer is not in use by analogWrite().
+// pulseIn() uses the same mechanism where possible and sleeps while waiting.
+extern bool pulseInAsync(uint32_t pin, uint32_t state, void(*callback)(uint32_t width));
+extern void pulseInCancel(uint32_t pin);
+// STM32L4 EXTENSION: emit a single HIGH pulse of "width" microseconds on a PWM pin, "delay" microseconds (at least one
+// timer tick) from now, generated by the pin's timer in one pulse mode without CPU involvement. The pin is LOW otherwise.
+// Returns false if the timer is in use by analogWrite(), tone(), pulseIn() or another pin, or if the previous pulse is
+// still pending (see pulseOutBusy()). pulseOutTrigger() arms the timer instead, so that every "mode" (RISING or FALLING)
+// edge on "triggerPin" produces such a pulse. "triggerPin" has to be channel 1 or 2 of the same timer. With "retrigger"
+// an edge during a pulse restarts the timer and so extends the pulse, otherwise it is ignored. pulseOutStop() releases
+// the timer again.
+extern bool pulseOut(uint32_t pin, uint32_t width, uint32_t delay);
+extern bool pulseOutTrigger(uint32_t pin, uint32_t width, uint32_t delay, uint32_t triggerPin, uint32_t mode, bool retrigger);
+extern bool pulseOutBusy(uint32_t pin);
+extern void pulseOutStop(uint32_t pin);
 
 extern uint32_t shiftIn( uint32_t ulDataPin, uint32_t ulClockPin, uint32_t ulBitOrder);
 extern void shiftOut( uint32_t ulDataPin, uint32_t ulClockPin, uint32_t ulBitOrder, uint32_t ulVal);
-
+// STM32L4 EXTENSION: shift out/in "count" bytes in one go, with the same timing relation as shiftOut()/shiftIn().
+// The pins are driven directly by GPIO register accesses. If the pins of shiftOutBuffer() are the MOSI/SCK pins
+// of one of the board's SPI interfaces, and that interface is not in use by the SPI library, the SPI peripheral
+// (mode 0, at most 8MHz) clocks out the data instead.
+extern void shiftOutBuffer( uint32_t ulDataPin, uint32_t ulClockPin, uint32_t ulBitOrder, const uint8_t *buffer, unsigned int count);
+extern void shiftInBuffer( uint32_t ulDataPin, uint32_t ulClockPin, uint32_t ulBitOrder, uint8_t *buffer, unsigned int count);
+
+// STM32L4 EXTENSION: tone() on a PWM pin whose timer is otherwise unused is generated by the timer as a
+// square wave without interrupts, so several such pins (on different timers) can play at once. Other pins
+// share a single interrupt driven voice.
 extern void tone(uint32_t pin, uint32_t frequency, uint32_t duration);
 extern void noTone(uint32_t pin);
 #ifdef __cplusplus
@@ -152,24 +260,36 @@ extern void tone(uint32_t pin, uint32_t frequency, uint32_t duration = 0);
 #define ADC_INPUT_NONE         255
 
 
-/* Types used for the table below */
+/* Types used for the table below. An entry is 8 bytes. The GPIO port is not stored, but derived
+ * from the GPIO_PIN_Pxy encoding in "pin", see PIN_DESCRIPTION_PORT(). "bit" is 0 for a pin that
+ * has no GPIO access (e.g. one that is dedicated to the SDMMC or the external flash).
+ */
 typedef struct _PinDescription
 {
-  void                    *GPIO;
-  uint16_t                bit;
   uint16_t                pin;
+  uint16_t                bit;
   uint8_t                 attr;
   uint8_t                 pwm_instance;
   uint8_t                 pwm_channel;
   uint8_t                 adc_input;
 } PinDescription ;
 
+/* GPIO port of a GPIO_PIN_Pxy value, (GPIOA_BASE + group * 0x400). This is a constant expression
+ * for a constant "pin".
+ */
+#define PIN_DESCRIPTION_PORT(_pin) ((GPIO_TypeDef*)(GPIOA_BASE + (((_pin) & 0x00f0) << 6)))
+
 /* Pins table to be instantiated into variant.cpp */
 extern const PinDescription g_APinDescription[] ;
 
 extern const unsigned int g_PWMInstances[] ;
 
-#define digitalPinToPort(P)        ( g_APinDescription[P].GPIO )
+static inline __attribute__((always_inline)) GPIO_TypeDef *__digitalPinToPort(uint32_t pin)
+{
+    return (g_APinDescription[pin].bit ? PIN_DESCRIPTION_PORT(g_APinDescription[pin].pin) : NULL);
+}
+
+#define digitalPinToPort(P)        ( __digitalPinToPort(P) )
 #define digitalPinToBitMask(P)     ( g_APinDescription[P].bit )
 #define portInputRegister(port)    ( (volatile uint32_t*)((volatile uint8_t*)(port) + 0x10) ) // IDR
 #define portOutputRegister(port)   ( (volatile uint32_t*)((volatile uint8_t*)(port) + 0x14) ) // ODR
@@ -177,6 +297,44 @@ extern const unsigned int g_PWMInstances[] ;
 #define portClearRegister(port)    ( (volatile uint32_t*)((volatile uint8_t*)(port) + 0x28) ) // BRR
 #define digitalPinHasPWM(P)        ( g_APinDescription[P].attr & PIN_ATTR_PWM )
 
+// STM32L4 EXTENSION: with a constant "pin" (and -flto folding the g_APinDescription[] lookup),
+// digitalWriteFast() is a single BSRR store and digitalReadFast() a single IDR load. Otherwise
+// they fall back to digitalWrite()/digitalRead(). portWrite() sets the "mask" bits of "port"
+// (see digitalPinToPort()) to "value" with one BSRR store, portRead() returns its IDR.
+static inline __attribute__((always_inline)) void digitalWriteFast(uint32_t pin, uint32_t value)
+{
+    if (__builtin_constant_p(pin)) {
+	uint32_t bit = g_APinDescription[pin].bit;
+
+	if (bit) {
+	    PIN_DESCRIPTION_PORT(g_APinDescription[pin].pin)->BSRR = (value ? bit : (bit << 16));
+	}
+    } else {
+	digitalWrite(pin, value);
+    }
+}
+
+static inline __attribute__((always_inline)) int digitalReadFast(uint32_t pin)
+{
+    if (__builtin_constant_p(pin)) {
+	uint32_t bit = g_APinDescription[pin].bit;
+
+	return (bit ? !!(PIN_DESCRIPTION_PORT(g_APinDescription[pin].pin)->IDR & bit) : LOW);
+    } else {
+	return digitalRead(pin);
+    }
+}
+
+static inline __attribute__((always_inline)) void portWrite(void *port, uint32_t mask, uint32_t value)
+{
+    ((GPIO_TypeDef*)port)->BSRR = ((mask & value) | ((mask & ~value) << 16));
+}
+
+static inline __attribute__((always_inline)) uint32_t portRead(void *port)
+{
+    return ((GPIO_TypeDef*)port)->IDR;
+}
+
 extern uint32_t SystemCoreClock;
 
 #define F_CPU SystemCoreClock
@@ -35,8 +35,13 @@ extern "C" {
 
 #if defined(PIN_DAC0) || defined(PIN_DAC1)
 static stm32l4_dac_t stm32l4_dac;
+static stm32l4_timer_t stm32l4_dac_timer;
+
+static void (*_writeStreamCallback)(uint16_t *data, unsigned int count) = NULL;
+static uint16_t *_writeStreamData;
+static unsigned int _writeStreamSize;
 #endif /* defined(PIN_DAC0) || defined(PIN_DAC1) */
-static stm32l4_timer_t stm32l4_pwm[PWM_INSTANCE_COUNT];
+stm32l4_timer_t stm32l4_pwm[PWM_INSTANCE_COUNT];
 
 static int _readResolution = 10;
 static int _writeResolution = 8;
@@ -46,6 +51,33 @@ static uint32_t _writeRange[PWM_INSTANCE_COUNT];
 
 static uint8_t _writeCalibrate = 3;
 
+/* One channel per PWM timer can be dithered (analogWriteDither()), as the
+ * CCRx values are fed by the timer's UP DMA. The channel is kept +1, 0 is none.
+ */
+#define PWM_DITHER_BITS 5
+
+static uint8_t _writeDitherChannel[PWM_INSTANCE_COUNT];
+static uint16_t _writeDitherSlots[PWM_INSTANCE_COUNT][1 << PWM_DITHER_BITS];
+
+static stm32l4_timer_t stm32l4_adc_timer;
+
+static void (*_readContinuousCallback)(const uint16_t *data, unsigned int count) = NULL;
+static uint16_t *_readContinuousData;
+static unsigned int _readContinuousSize;
+
+/* A monitor scan (__analogReadMonitor()) gets paused by analogRead(), so it
+ * needs to remember its channels.
+ */
+static bool _readMonitor = false;
+static uint8_t _readMonitorChannels[16];
+static unsigned int _readMonitorCount;
+static void (*_readMonitorWatchdog)(void) = NULL;
+
+static void (*_readSynchronizedCallback)(const uint16_t *data, unsigned int count) = NULL;
+static uint16_t _readSynchronizedData[4];
+static unsigned int _readSynchronizedCount;
+static stm32l4_timer_t *_readSynchronizedTimer;
+
 void analogReference(eAnalogReference reference)
 {
 }
@@ -72,7 +104,7 @@ static inline uint32_t mapResolution(uint32_t value, uint32_t from, uint32_t to)
     }
 }
 
-uint32_t analogRead(uint32_t pin)
+static uint32_t analogReadOption(uint32_t pin, uint32_t option, uint32_t resolution)
 {
     uint32_t channel, input;
 
@@ -85,6 +117,11 @@ uint32_t analogRead(uint32_t pin)
     {
 	return 0;
     }
+
+    if (_readContinuousCallback && !_readMonitor)
+    {
+	return 0;
+    }
   
 #if defined(PIN_DAC0) || defined(PIN_DAC1)
     if ( g_APinDescription[pin].attr & PIN_ATTR_DAC )
@@ -100,15 +137,46 @@ uint32_t analogRead(uint32_t pin)
     }
 #endif /* defined(PIN_DAC0) || defined(PIN_DAC1) */
 
+    /* analogReadSynchronized() keeps the ADC enabled, so a regular conversion
+     * is simply run next to the injected ones.
+     */
+    if (_readSynchronizedCallback)
+    {
+	stm32l4_gpio_pin_configure(g_APinDescription[pin].pin, (GPIO_PUPD_NONE | GPIO_MODE_ANALOG | GPIO_ANALOG_SWITCH));
+
+	stm32l4_adc_configure(&stm32l4_adc, option);
+
+	input = stm32l4_adc_convert(&stm32l4_adc, g_APinDescription[pin].adc_input);
+
+	stm32l4_adc_configure(&stm32l4_adc, 0);
+
+	return mapResolution(input, resolution, _readResolution);
+    }
+
+    if (_readMonitor)
+    {
+	stm32l4_gpio_pin_configure(g_APinDescription[pin].pin, (GPIO_PUPD_NONE | GPIO_MODE_ANALOG | GPIO_ANALOG_SWITCH));
+
+	stm32l4_adc_stop(&stm32l4_adc);
+	stm32l4_adc_configure(&stm32l4_adc, option);
+
+	input = stm32l4_adc_convert(&stm32l4_adc, g_APinDescription[pin].adc_input);
+
+	stm32l4_adc_configure(&stm32l4_adc, 0);
+	stm32l4_adc_scan(&stm32l4_adc, _readMonitorChannels, _readMonitorCount, ADC_TRIGGER_TIM15_TRGO, _readContinuousData, _readContinuousSize);
+
+	return mapResolution(input, resolution, _readResolution);
+    }
+
     if (stm32l4_adc.state == ADC_STATE_NONE)
     {
 	stm32l4_adc_create(&stm32l4_adc, ADC_INSTANCE_ADC1, STM32L4_ADC_IRQ_PRIORITY, 0);
-	stm32l4_adc_enable(&stm32l4_adc, 0, NULL, NULL, 0);
+	stm32l4_adc_enable(&stm32l4_adc, option, NULL, NULL, 0);
 	stm32l4_adc_calibrate(&stm32l4_adc);
     }
     else
     {
-	stm32l4_adc_enable(&stm32l4_adc, 0, NULL, NULL, 0);
+	stm32l4_adc_enable(&stm32l4_adc, option, NULL, NULL, 0);
     }
 
     stm32l4_gpio_pin_configure(g_APinDescription[pin].pin, (GPIO_PUPD_NONE | GPIO_MODE_ANALOG | GPIO_ANALOG_SWITCH));
@@ -117,7 +185,392 @@ uint32_t analogRead(uint32_t pin)
 
     stm32l4_adc_disable(&stm32l4_adc);
 
-    return mapResolution(input, 12, _readResolution);
+    return mapResolution(input, resolution, _readResolution);
+}
+
+uint32_t analogRead(uint32_t pin)
+{
+    return analogReadOption(pin, 0, 12);
+}
+
+uint32_t analogReadOversampled(uint32_t pin, uint32_t ratio)
+{
+    uint32_t bits, shift;
+
+    for (bits = 0; (bits < 8) && ((2ul << bits) <= ratio); bits++)
+    {
+    }
+
+    /* The accumulated sum has 12 + bits significant bits, shift it down to at
+     * most 16 bits, which is what the data register holds.
+     */
+    shift = (bits > 4) ? (bits - 4) : 0;
+
+    return analogReadOption(pin, ((bits << ADC_OPTION_RATIO_SHIFT) | ADC_OPTION_SHIFT(shift)), (12 + bits - shift));
+}
+
+static void analogReadContinuousEvent(void *context, uint32_t events)
+{
+    if (events & ADC_EVENT_SCAN_HALF)
+    {
+	(*_readContinuousCallback)(&_readContinuousData[0], _readContinuousSize / 2);
+    }
+
+    if (events & ADC_EVENT_SCAN_DONE)
+    {
+	(*_readContinuousCallback)(&_readContinuousData[_readContinuousSize / 2], _readContinuousSize / 2);
+    }
+
+    if ((events & ADC_EVENT_WATCHDOG) && _readMonitorWatchdog)
+    {
+	(*_readMonitorWatchdog)();
+    }
+}
+
+/* Starts TIM15, which triggers a scan every "divider" timer clocks.
+ */
+static void analogReadContinuousTimer(uint64_t divider)
+{
+    uint32_t prescaler;
+
+    if (divider == 0)
+    {
+	divider = 1;
+    }
+
+    if (divider > 0x100000000ull)
+    {
+	divider = 0x100000000ull;
+    }
+
+    /* Split the divider into a 16 bit prescaler and period.
+     */
+    prescaler = (divider + 65535) / 65536;
+
+    stm32l4_timer_enable(&stm32l4_adc_timer, prescaler -1, (divider / prescaler) -1, TIMER_OPTION_TRIGGER_UPDATE, NULL, NULL, 0);
+    stm32l4_timer_start(&stm32l4_adc_timer, false);
+}
+
+bool analogReadContinuous(const uint32_t *pins, unsigned int count, uint32_t rate, uint16_t *buffer, unsigned int size, void(*callback)(const uint16_t *data, unsigned int count))
+{
+    uint8_t channels[16];
+    uint32_t index, pin;
+
+    if (_readContinuousCallback || _readSynchronizedCallback || !callback || (count == 0) || (count > 16) || (rate == 0))
+    {
+	return false;
+    }
+
+    if (size > 65535)
+    {
+	size = 65535;
+    }
+
+    size -= (size % (2 * count));
+
+    if (size == 0)
+    {
+	return false;
+    }
+
+    for (index = 0; index < count; index++)
+    {
+	pin = pins[index];
+
+	if ( pin < A0 )
+	{
+	    pin += A0 ;
+	}
+
+	if ( !(g_APinDescription[pin].attr & PIN_ATTR_ADC) )
+	{
+	    return false;
+	}
+
+	channels[index] = g_APinDescription[pin].adc_input;
+    }
+
+    if (stm32l4_adc.state == ADC_STATE_NONE)
+    {
+	stm32l4_adc_create(&stm32l4_adc, ADC_INSTANCE_ADC1, STM32L4_ADC_IRQ_PRIORITY, 0);
+	stm32l4_adc_enable(&stm32l4_adc, 0, analogReadContinuousEvent, NULL, (ADC_EVENT_SCAN_HALF | ADC_EVENT_SCAN_DONE));
+	stm32l4_adc_calibrate(&stm32l4_adc);
+    }
+    else
+    {
+	stm32l4_adc_enable(&stm32l4_adc, 0, analogReadContinuousEvent, NULL, (ADC_EVENT_SCAN_HALF | ADC_EVENT_SCAN_DONE));
+    }
+
+    for (index = 0; index < count; index++)
+    {
+	pin = pins[index];
+
+	if ( pin < A0 )
+	{
+	    pin += A0 ;
+	}
+
+	stm32l4_gpio_pin_configure(g_APinDescription[pin].pin, (GPIO_PUPD_NONE | GPIO_MODE_ANALOG | GPIO_ANALOG_SWITCH));
+    }
+
+    _readContinuousCallback = callback;
+    _readContinuousData = buffer;
+    _readContinuousSize = size;
+
+    if (!stm32l4_adc_scan(&stm32l4_adc, channels, count, ADC_TRIGGER_TIM15_TRGO, buffer, size))
+    {
+	stm32l4_adc_disable(&stm32l4_adc);
+
+	_readContinuousCallback = NULL;
+
+	return false;
+    }
+
+    if (stm32l4_adc_timer.state == TIMER_STATE_NONE)
+    {
+	stm32l4_timer_create(&stm32l4_adc_timer, TIMER_INSTANCE_TIM15, STM32L4_ADC_IRQ_PRIORITY, 0);
+    }
+
+    analogReadContinuousTimer(stm32l4_timer_clock(&stm32l4_adc_timer) / rate);
+
+    return true;
+}
+
+void analogReadContinuousStop(void)
+{
+    if (_readContinuousCallback && !_readMonitor)
+    {
+	stm32l4_timer_stop(&stm32l4_adc_timer);
+	stm32l4_timer_disable(&stm32l4_adc_timer);
+
+	stm32l4_adc_stop(&stm32l4_adc);
+	stm32l4_adc_disable(&stm32l4_adc);
+
+	_readContinuousCallback = NULL;
+    }
+}
+
+bool __analogReadMonitor(const uint8_t *channels, unsigned int count, uint32_t period, uint16_t *buffer, unsigned int size, void(*callback)(const uint16_t *data, unsigned int count))
+{
+    if (_readContinuousCallback || _readSynchronizedCallback || !callback || (count == 0) || (count > 16) || (period == 0) || (size == 0) || (size % (2 * count)))
+    {
+	return false;
+    }
+
+    if (stm32l4_adc.state == ADC_STATE_NONE)
+    {
+	stm32l4_adc_create(&stm32l4_adc, ADC_INSTANCE_ADC1, STM32L4_ADC_IRQ_PRIORITY, 0);
+	stm32l4_adc_enable(&stm32l4_adc, 0, analogReadContinuousEvent, NULL, (ADC_EVENT_SCAN_HALF | ADC_EVENT_SCAN_DONE | ADC_EVENT_WATCHDOG));
+	stm32l4_adc_calibrate(&stm32l4_adc);
+    }
+    else
+    {
+	stm32l4_adc_enable(&stm32l4_adc, 0, analogReadContinuousEvent, NULL, (ADC_EVENT_SCAN_HALF | ADC_EVENT_SCAN_DONE | ADC_EVENT_WATCHDOG));
+    }
+
+    memcpy(&_readMonitorChannels[0], channels, count);
+
+    _readMonitorCount = count;
+    _readContinuousCallback = callback;
+    _readContinuousData = buffer;
+    _readContinuousSize = size;
+
+    if (!stm32l4_adc_scan(&stm32l4_adc, channels, count, ADC_TRIGGER_TIM15_TRGO, buffer, size))
+    {
+	stm32l4_adc_disable(&stm32l4_adc);
+
+	_readContinuousCallback = NULL;
+
+	return false;
+    }
+
+    _readMonitor = true;
+
+    if (stm32l4_adc_timer.state == TIMER_STATE_NONE)
+    {
+	stm32l4_timer_create(&stm32l4_adc_timer, TIMER_INSTANCE_TIM15, STM32L4_ADC_IRQ_PRIORITY, 0);
+    }
+
+    analogReadContinuousTimer(((uint64_t)stm32l4_timer_clock(&stm32l4_adc_timer) * period) / 1000);
+
+    return true;
+}
+
+/* (Re)arms the analog watchdog of the monitor scan on "channel", or turns it off for a NULL "callback".
+ */
+void __analogReadMonitorWatchdog(unsigned int channel, uint16_t low, uint16_t high, void(*callback)(void))
+{
+    if (!_readMonitor)
+    {
+	return;
+    }
+
+    stm32l4_adc_stop(&stm32l4_adc);
+
+    _readMonitorWatchdog = callback;
+
+    stm32l4_adc_watchdog(&stm32l4_adc, (callback ? channel : ~0u), low, high);
+    stm32l4_adc_scan(&stm32l4_adc, _readMonitorChannels, _readMonitorCount, ADC_TRIGGER_TIM15_TRGO, _readContinuousData, _readContinuousSize);
+}
+
+void __analogReadMonitorStop(void)
+{
+    if (_readMonitor)
+    {
+	stm32l4_timer_stop(&stm32l4_adc_timer);
+	stm32l4_timer_disable(&stm32l4_adc_timer);
+
+	stm32l4_adc_stop(&stm32l4_adc);
+	stm32l4_adc_disable(&stm32l4_adc);
+
+	_readMonitor = false;
+	_readMonitorWatchdog = NULL;
+	_readContinuousCallback = NULL;
+    }
+}
+
+static void analogReadSynchronizedEvent(void *context, uint32_t events)
+{
+    unsigned int index;
+
+    if (events & ADC_EVENT_INJECTED)
+    {
+	for (index = 0; index < _readSynchronizedCount; index++)
+	{
+	    _readSynchronizedData[index] = stm32l4_adc_injected(&stm32l4_adc, index);
+	}
+
+	(*_readSynchronizedCallback)(&_readSynchronizedData[0], _readSynchronizedCount);
+    }
+}
+
+bool analogReadSynchronized(uint32_t pwmPin, uint32_t phase, const uint32_t *pins, unsigned int count, void(*callback)(const uint16_t *data, unsigned int count))
+{
+    uint8_t channels[4];
+    uint32_t index, pin, instance, channel, trigger;
+
+    if (_readContinuousCallback || _readSynchronizedCallback || !callback || (count == 0) || (count > 4) || (phase > ANALOG_SYNC_FALLING))
+    {
+	return false;
+    }
+
+    if ( !(g_APinDescription[pwmPin].attr & PIN_ATTR_PWM) )
+    {
+	return false;
+    }
+
+    instance = g_APinDescription[pwmPin].pwm_instance;
+    channel = g_APinDescription[pwmPin].pwm_channel;
+
+    /* The PWM timer has to be running already (analogWrite()), and only its
+     * TRGO can be routed to the injected group.
+     */
+    if (stm32l4_pwm[instance].state != TIMER_STATE_ACTIVE)
+    {
+	return false;
+    }
+
+    switch (g_PWMInstances[instance]) {
+    case TIMER_INSTANCE_TIM1:
+	trigger = ADC_INJECTED_TRIGGER_TIM1_TRGO;
+	break;
+    case TIMER_INSTANCE_TIM2:
+	trigger = ADC_INJECTED_TRIGGER_TIM2_TRGO;
+	break;
+#ifdef TIM3_BASE
+    case TIMER_INSTANCE_TIM3:
+	trigger = ADC_INJECTED_TRIGGER_TIM3_TRGO;
+	break;
+#endif
+#ifdef TIM4_BASE
+    case TIMER_INSTANCE_TIM4:
+	trigger = ADC_INJECTED_TRIGGER_TIM4_TRGO;
+	break;
+#endif
+    case TIMER_INSTANCE_TIM15:
+	trigger = ADC_INJECTED_TRIGGER_TIM15_TRGO;
+	break;
+    default:
+	return false;
+    }
+
+    if ((phase != ANALOG_SYNC_PERIOD) && (channel > TIMER_CHANNEL_4))
+    {
+	return false;
+    }
+
+    for (index = 0; index < count; index++)
+    {
+	pin = pins[index];
+
+	if ( pin < A0 )
+	{
+	    pin += A0 ;
+	}
+
+	if ( !(g_APinDescription[pin].attr & PIN_ATTR_ADC) )
+	{
+	    return false;
+	}
+
+	channels[index] = g_APinDescription[pin].adc_input;
+    }
+
+    if (stm32l4_adc.state == ADC_STATE_NONE)
+    {
+	stm32l4_adc_create(&stm32l4_adc, ADC_INSTANCE_ADC1, STM32L4_ADC_IRQ_PRIORITY, 0);
+	stm32l4_adc_enable(&stm32l4_adc, 0, analogReadSynchronizedEvent, NULL, ADC_EVENT_INJECTED);
+	stm32l4_adc_calibrate(&stm32l4_adc);
+    }
+    else
+    {
+	stm32l4_adc_enable(&stm32l4_adc, 0, analogReadSynchronizedEvent, NULL, ADC_EVENT_INJECTED);
+    }
+
+    for (index = 0; index < count; index++)
+    {
+	pin = pins[index];
+
+	if ( pin < A0 )
+	{
+	    pin += A0 ;
+	}
+
+	stm32l4_gpio_pin_configure(g_APinDescription[pin].pin, (GPIO_PUPD_NONE | GPIO_MODE_ANALOG | GPIO_ANALOG_SWITCH));
+    }
+
+    _readSynchronizedCallback = callback;
+    _readSynchronizedCount = count;
+    _readSynchronizedTimer = &stm32l4_pwm[instance];
+
+    if (!stm32l4_adc_inject(&stm32l4_adc, channels, count, (trigger | ((phase == ANALOG_SYNC_FALLING) ? ADC_INJECTED_TRIGGER_FALLING : 0))))
+    {
+	stm32l4_adc_disable(&stm32l4_adc);
+
+	_readSynchronizedCallback = NULL;
+
+	return false;
+    }
+
+    /* With PWM mode 1 OCxREF is high while the output is on, so its rising
+     * edge is where the pin switches on and its falling edge where it switches off.
+     */
+    stm32l4_timer_trigger(_readSynchronizedTimer, ((phase == ANALOG_SYNC_PERIOD) ? TIMER_TRIGGER_UPDATE : (TIMER_TRIGGER_COMPARE_1 + channel)));
+
+    return true;
+}
+
+void analogReadSynchronizedStop(void)
+{
+    if (_readSynchronizedCallback)
+    {
+	stm32l4_timer_trigger(_readSynchronizedTimer, TIMER_TRIGGER_NONE);
+
+	stm32l4_adc_inject_stop(&stm32l4_adc);
+	stm32l4_adc_disable(&stm32l4_adc);
+
+	_readSynchronizedCallback = NULL;
+    }
 }
 
 void analogWriteResolution( int resolution )
@@ -129,7 +582,7 @@ void analogWriteFrequency(uint32_t pin, uint32_t frequency)
 {
     uint32_t instance, carrier, modulus, divider;
 
-    if (g_APinDescription[pin].GPIO == NULL)
+    if (g_APinDescription[pin].bit == 0)
     {
 	return;
     }
@@ -165,6 +618,10 @@ void analogWriteFrequency(uint32_t pin, uint32_t frequency)
 		stm32l4_timer_stop(&stm32l4_pwm[instance]);
 		stm32l4_timer_configure(&stm32l4_pwm[instance], divider -1, modulus -1, 0);
 		stm32l4_timer_start(&stm32l4_pwm[instance], false);
+
+		/* Stopping the timer aborted a dither stream.
+		 */
+		_writeDitherChannel[instance] = 0;
 	    }
 	}
     }
@@ -174,7 +631,7 @@ void analogWriteRange(uint32_t pin, uint32_t range)
 {
     uint32_t instance, carrier, modulus, divider;
 
-    if (g_APinDescription[pin].GPIO == NULL)
+    if (g_APinDescription[pin].bit == 0)
     {
 	return;
     }
@@ -210,12 +667,155 @@ void analogWriteRange(uint32_t pin, uint32_t range)
 		stm32l4_timer_stop(&stm32l4_pwm[instance]);
 		stm32l4_timer_configure(&stm32l4_pwm[instance], divider -1, modulus -1, 0);
 		stm32l4_timer_start(&stm32l4_pwm[instance], false);
+
+		/* Stopping the timer aborted a dither stream.
+		 */
+		_writeDitherChannel[instance] = 0;
 	    }
 	}
     }
 }
 
 
+#if defined(PIN_DAC0) || defined(PIN_DAC1)
+static void analogWriteStreamEvent(void *context, uint32_t events)
+{
+    if (events & DAC_EVENT_STREAM_HALF)
+    {
+	(*_writeStreamCallback)(&_writeStreamData[0], _writeStreamSize / 2);
+    }
+
+    if (events & DAC_EVENT_STREAM_DONE)
+    {
+	(*_writeStreamCallback)(&_writeStreamData[_writeStreamSize / 2], _writeStreamSize / 2);
+    }
+}
+#endif /* defined(PIN_DAC0) || defined(PIN_DAC1) */
+
+bool analogWriteStream(uint32_t pin, uint32_t rate, uint16_t *buffer, unsigned int size, void(*callback)(uint16_t *data, unsigned int count))
+{
+#if defined(PIN_DAC0) || defined(PIN_DAC1)
+    uint32_t channel, divider, prescaler;
+
+    if ((g_APinDescription[pin].bit == 0) || !(g_APinDescription[pin].attr & PIN_ATTR_DAC))
+    {
+	return false;
+    }
+
+    if (_writeStreamCallback || !callback || (rate == 0))
+    {
+	return false;
+    }
+
+    if (size > 65534)
+    {
+	size = 65534;
+    }
+
+    size &= ~1;
+
+    if (size == 0)
+    {
+	return false;
+    }
+
+    if (stm32l4_dac.state == DAC_STATE_NONE)
+    {
+	stm32l4_dac_create(&stm32l4_dac, DAC_INSTANCE_DAC, STM32L4_DAC_IRQ_PRIORITY, 0);
+	stm32l4_dac_enable(&stm32l4_dac, 0, NULL, NULL, 0);
+    }
+    
+    stm32l4_gpio_pin_configure(g_APinDescription[pin].pin, (GPIO_PUPD_NONE | GPIO_MODE_ANALOG));
+
+    channel = ((pin == PIN_DAC0) ? DAC_CHANNEL_1 : DAC_CHANNEL_2);
+
+    if (_writeCalibrate & (1ul << channel))
+    {
+	_writeCalibrate &= ~(1ul << channel);
+
+	stm32l4_dac_channel(&stm32l4_dac, channel, buffer[0], DAC_CONTROL_EXTERNAL | DAC_CONTROL_CALIBRATE);
+    }
+    else
+    {
+	stm32l4_dac_channel(&stm32l4_dac, channel, buffer[0], DAC_CONTROL_EXTERNAL);
+    }
+
+    /* TIM6 is also the Servo timer, which holds it from the first Servo object on.
+     */
+    if (!stm32l4_timer_create(&stm32l4_dac_timer, TIMER_INSTANCE_TIM6, STM32L4_DAC_IRQ_PRIORITY, 0))
+    {
+	return false;
+    }
+
+    _writeStreamCallback = callback;
+    _writeStreamData = buffer;
+    _writeStreamSize = size;
+
+    stm32l4_dac_notify(&stm32l4_dac, analogWriteStreamEvent, NULL, (DAC_EVENT_STREAM_HALF | DAC_EVENT_STREAM_DONE));
+
+    if (!stm32l4_dac_stream(&stm32l4_dac, channel, DAC_TRIGGER_TIM6_TRGO, buffer, size))
+    {
+	stm32l4_dac_notify(&stm32l4_dac, NULL, NULL, 0);
+
+	stm32l4_timer_destroy(&stm32l4_dac_timer);
+
+	_writeStreamCallback = NULL;
+
+	return false;
+    }
+
+    divider = stm32l4_timer_clock(&stm32l4_dac_timer) / rate;
+
+    if (divider == 0)
+    {
+	divider = 1;
+    }
+
+    prescaler = (divider + 65535) / 65536;
+
+    stm32l4_timer_enable(&stm32l4_dac_timer, prescaler -1, (divider / prescaler) -1, TIMER_OPTION_TRIGGER_UPDATE, NULL, NULL, 0);
+    stm32l4_timer_start(&stm32l4_dac_timer, false);
+
+    return true;
+#else /* defined(PIN_DAC0) || defined(PIN_DAC1) */
+    return false;
+#endif /* defined(PIN_DAC0) || defined(PIN_DAC1) */
+}
+
+void analogWriteStreamStop(void)
+{
+#if defined(PIN_DAC0) || defined(PIN_DAC1)
+    if (_writeStreamCallback)
+    {
+	stm32l4_timer_stop(&stm32l4_dac_timer);
+	stm32l4_timer_disable(&stm32l4_dac_timer);
+	stm32l4_timer_destroy(&stm32l4_dac_timer);
+
+	stm32l4_dac_stop(&stm32l4_dac);
+	stm32l4_dac_notify(&stm32l4_dac, NULL, NULL, 0);
+
+	_writeStreamCallback = NULL;
+    }
+#endif /* defined(PIN_DAC0) || defined(PIN_DAC1) */
+}
+
+static uint32_t analogWriteValue(uint32_t instance, uint32_t value)
+{
+    if (_writeFrequency[instance] && _writeRange[instance])
+    {
+	if (value > _writeRange[instance])
+	{
+	    value = _writeRange[instance];
+	}
+    }
+    else
+    {
+	value = mapResolution(value, _writeResolution, 12);
+    }
+
+    return value;
+}
+
 // Right now, PWM output only works on the pins with
 // hardware support.  These are defined in the appropriate
 // pins_*.c file.  For the rest of the pins, we default
@@ -225,7 +825,7 @@ void analogWrite(uint32_t pin, uint32_t value)
     uint32_t instance, channel, carrier, modulus, divider;
 
     // Handle the case the pin isn't usable as PIO
-    if (g_APinDescription[pin].GPIO == NULL)
+    if (g_APinDescription[pin].bit == 0)
     {
 	return;
     }
@@ -290,18 +890,15 @@ void analogWrite(uint32_t pin, uint32_t value)
 	    stm32l4_timer_start(&stm32l4_pwm[instance], false);
 	}
 
-	if (_writeFrequency[instance] && _writeRange[instance])
-	{
-	    if (value > _writeRange[instance])
-	    {
-		value = _writeRange[instance];
-	    }
-	}
-	else
+	if (_writeDitherChannel[instance] == (g_APinDescription[pin].pwm_channel +1))
 	{
-	    value = mapResolution(value, _writeResolution, 12);
+	    stm32l4_timer_stream_stop(&stm32l4_pwm[instance]);
+
+	    _writeDitherChannel[instance] = 0;
 	}
 
+	value = analogWriteValue(instance, value);
+
 	stm32l4_gpio_pin_configure(g_APinDescription[pin].pin, (GPIO_PUPD_NONE | GPIO_OSPEED_HIGH | GPIO_OTYPE_PUSHPULL | GPIO_MODE_ALTERNATE));
 
 	stm32l4_timer_channel(&stm32l4_pwm[instance], g_APinDescription[pin].pwm_channel, value, TIMER_CONTROL_PWM);
@@ -322,6 +919,202 @@ void analogWrite(uint32_t pin, uint32_t value)
     }
 }
 
+void analogWriteMulti(const uint32_t *pins, const uint32_t *values, unsigned int count)
+{
+    uint32_t pin, instance, channel, index;
+    uint32_t mask[PWM_INSTANCE_COUNT];
+    uint32_t compare[PWM_INSTANCE_COUNT][6];
+
+    for (instance = 0; instance < PWM_INSTANCE_COUNT; instance++)
+    {
+	mask[instance] = 0;
+    }
+
+    for (index = 0; index < count; index++)
+    {
+	pin = pins[index];
+
+	if ((g_APinDescription[pin].bit != 0) && (g_APinDescription[pin].attr & PIN_ATTR_PWM))
+	{
+	    instance = g_APinDescription[pin].pwm_instance;
+	    channel = g_APinDescription[pin].pwm_channel;
+
+	    /* Only a channel that is already running PWM can be updated in the batch,
+	     * anything else takes the regular path, which sets it up.
+	     */
+	    if ((stm32l4_pwm[instance].state == TIMER_STATE_ACTIVE) && (stm32l4_pwm[instance].channels & (TIMER_EVENT_CHANNEL_1 << channel)))
+	    {
+		mask[instance] |= (1ul << channel);
+		compare[instance][channel] = analogWriteValue(instance, values[index]);
+
+		continue;
+	    }
+	}
+
+	analogWrite(pin, values[index]);
+    }
+
+    for (instance = 0; instance < PWM_INSTANCE_COUNT; instance++)
+    {
+	if (mask[instance])
+	{
+	    stm32l4_timer_compare_multiple(&stm32l4_pwm[instance], mask[instance], &compare[instance][0]);
+	}
+    }
+}
+
+static void (*_writeBurstCallback[PWM_INSTANCE_COUNT])(void);
+
+static void analogWriteBurstCallback(void *context, uint32_t events)
+{
+    void (*callback)(void);
+
+    callback = _writeBurstCallback[(uint32_t)context];
+
+    _writeBurstCallback[(uint32_t)context] = NULL;
+
+    if (callback)
+    {
+	(*callback)();
+    }
+}
+
+bool analogWriteBurst(uint32_t pin, const uint16_t *slots, unsigned int count, void(*callback)(void))
+{
+    uint32_t instance;
+
+    if ((g_APinDescription[pin].bit == 0) || !(g_APinDescription[pin].attr & PIN_ATTR_PWM) || (count == 0) || (count > 65535))
+    {
+	return false;
+    }
+
+    instance = g_APinDescription[pin].pwm_instance;
+
+    if (!stm32l4_timer_stream_done(&stm32l4_pwm[instance]))
+    {
+	return false;
+    }
+
+    /* Set up the PWM channel idle low, the stream then takes over CCRx from the next period on.
+     */
+    analogWrite(pin, 0);
+
+    _writeBurstCallback[instance] = callback;
+
+    if (!stm32l4_timer_stream(&stm32l4_pwm[instance], g_APinDescription[pin].pwm_channel, slots, count, analogWriteBurstCallback, (void*)instance))
+    {
+	_writeBurstCallback[instance] = NULL;
+
+	return false;
+    }
+
+    return true;
+}
+
+bool analogWriteDither(uint32_t pin, uint32_t value, unsigned int bits)
+{
+    uint32_t instance, channel, scale, base, fraction, error, index;
+    bool dithering;
+
+    if ((g_APinDescription[pin].bit == 0) || !(g_APinDescription[pin].attr & PIN_ATTR_PWM) || (bits > PWM_DITHER_BITS))
+    {
+	return false;
+    }
+
+    instance = g_APinDescription[pin].pwm_instance;
+    channel = g_APinDescription[pin].pwm_channel;
+
+    if (bits == 0)
+    {
+	analogWrite(pin, value);
+
+	return true;
+    }
+
+    /* tone() or pulse*() may have taken over the timer in between, which ends the stream.
+     */
+    dithering = ((_writeDitherChannel[instance] == (channel +1)) && !stm32l4_timer_stream_done(&stm32l4_pwm[instance]));
+
+    if (!dithering)
+    {
+	if ((channel > TIMER_CHANNEL_4) || !stm32l4_timer_stream_done(&stm32l4_pwm[instance]))
+	{
+	    return false;
+	}
+    }
+
+    if (_writeFrequency[instance] && _writeRange[instance])
+    {
+	if (value > (_writeRange[instance] << bits))
+	{
+	    value = (_writeRange[instance] << bits);
+	}
+    }
+    else
+    {
+	value = mapResolution(value, (_writeResolution + bits), (12 + bits));
+    }
+
+    /* First order sigma-delta over 2^PWM_DITHER_BITS periods: "fraction" out of every
+     * 2^bits periods get one extra count, spread out evenly rather than bunched up.
+     */
+    scale = 1ul << bits;
+    base = value >> bits;
+    fraction = value & (scale -1);
+    error = 0;
+
+    for (index = 0; index < (1ul << PWM_DITHER_BITS); index++)
+    {
+	error += fraction;
+
+	if (error >= scale)
+	{
+	    error -= scale;
+
+	    _writeDitherSlots[instance][index] = base +1;
+	}
+	else
+	{
+	    _writeDitherSlots[instance][index] = base;
+	}
+    }
+
+    if (dithering)
+    {
+	return true;
+    }
+
+    /* Set up the PWM channel at the base value, the stream then takes over CCRx from the next period on.
+     */
+    analogWrite(pin, 0);
+
+    stm32l4_timer_compare(&stm32l4_pwm[instance], channel, base);
+
+    if (!stm32l4_timer_stream_cyclic(&stm32l4_pwm[instance], channel, &_writeDitherSlots[instance][0], (1ul << PWM_DITHER_BITS)))
+    {
+	return false;
+    }
+
+    _writeDitherChannel[instance] = (channel +1);
+
+    return true;
+}
+
+bool analogWriteBurstDone(uint32_t pin)
+{
+    if ((g_APinDescription[pin].bit == 0) || !(g_APinDescription[pin].attr & PIN_ATTR_PWM))
+    {
+	return true;
+    }
+
+    return stm32l4_timer_stream_done(&stm32l4_pwm[g_APinDescription[pin].pwm_instance]);
+}
+
+unsigned int analogWriteBurstEncode(uint16_t *slots, const uint8_t *data, unsigned int count, uint32_t zero, uint32_t one)
+{
+    return stm32l4_timer_stream_encode(slots, data, count, zero, one);
+}
+
 #ifdef __cplusplus
 }
 #endif
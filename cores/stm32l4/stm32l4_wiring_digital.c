@@ -36,7 +36,7 @@
 void pinMode( uint32_t ulPin, uint32_t ulMode )
 {
     // Handle the case the pin isn't usable as PIO
-    if ( g_APinDescription[ulPin].GPIO == NULL )
+    if ( g_APinDescription[ulPin].bit == 0 )
     {
 	return ;
     }
@@ -78,12 +78,12 @@ void pinMode( uint32_t ulPin, uint32_t ulMode )
 void digitalWrite( uint32_t ulPin, uint32_t ulVal )
 {
     // Handle the case the pin isn't usable as PIO
-    if ( g_APinDescription[ulPin].GPIO == NULL )
+    if ( g_APinDescription[ulPin].bit == 0 )
     {
 	return ;
     }
 
-    GPIO_TypeDef *GPIO = g_APinDescription[ulPin].GPIO;
+    GPIO_TypeDef *GPIO = PIN_DESCRIPTION_PORT(g_APinDescription[ulPin].pin);
     uint32_t bit = g_APinDescription[ulPin].bit;
 
     if (ulVal == 0)
@@ -99,12 +99,12 @@ void digitalWrite( uint32_t ulPin, uint32_t ulVal )
 int digitalRead( uint32_t ulPin )
 {
     // Handle the case the pin isn't usable as PIO
-    if ( g_APinDescription[ulPin].GPIO == NULL )
+    if ( g_APinDescription[ulPin].bit == 0 )
     {
 	return LOW ;
     }
 
-    GPIO_TypeDef *GPIO = g_APinDescription[ulPin].GPIO;
+    GPIO_TypeDef *GPIO = PIN_DESCRIPTION_PORT(g_APinDescription[ulPin].pin);
     uint32_t bit = g_APinDescription[ulPin].bit;
 
     return !!(GPIO->IDR & bit);
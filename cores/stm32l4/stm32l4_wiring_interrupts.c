@@ -29,8 +29,68 @@
 #include "Arduino.h"
 #include "stm32l4_wiring_private.h"
 
+#include "stm32l4_pool.h"
+
 #include <string.h>
 
+static stm32l4_queue_t stm32l4_interrupt_capture_queue;
+static volatile uint32_t stm32l4_interrupt_capture_sequence[INTERRUPT_CAPTURE_SIZE];
+static InterruptCapture stm32l4_interrupt_capture_data[INTERRUPT_CAPTURE_SIZE];
+static volatile uint32_t stm32l4_interrupt_capture_overruns = 0;
+static bool stm32l4_interrupt_capture_created = false;
+
+/* "context" is the Arduino pin in the lower 8 bits and the EXTI_CONTROL edge
+ * selection above. For a single edge the level is implied; for both edges the
+ * pin is sampled, which is the level after the edge unless the pin toggled
+ * again before the handler got to run.
+ */
+static void stm32l4_interrupt_capture_callback(void *context)
+{
+    InterruptCapture *record;
+    uint32_t pin, control, sequence;
+
+    pin = (uint32_t)context & 0xff;
+    control = (uint32_t)context >> 8;
+
+    record = (InterruptCapture*)stm32l4_queue_claim(&stm32l4_interrupt_capture_queue, &sequence);
+
+    if (record)
+    {
+	record->micros = micros();
+	record->pin = pin;
+
+	if (control == EXTI_CONTROL_BOTH_EDGES)
+	{
+	    record->level = stm32l4_gpio_pin_read(g_APinDescription[pin].pin);
+	}
+	else
+	{
+	    record->level = (control == EXTI_CONTROL_RISING_EDGE) ? HIGH : LOW;
+	}
+
+	stm32l4_queue_publish(&stm32l4_interrupt_capture_queue, sequence);
+    }
+    else
+    {
+	armv7m_atomic_add(&stm32l4_interrupt_capture_overruns, 1);
+    }
+
+    loopWakeup();
+}
+
+/* "context" is the user callback, which runs before loop() is woken up so that
+ * the flags it sets are visible to loop().
+ */
+static void stm32l4_interrupt_callback(void *context)
+{
+    if (context)
+    {
+	(*(voidFuncPtr)context)();
+    }
+
+    loopWakeup();
+}
+
 void attachInterrupt(uint32_t pin, voidFuncPtr callback, uint32_t mode)
 {
     if (!(g_APinDescription[pin].attr & PIN_ATTR_EXTI))
@@ -39,15 +99,15 @@ void attachInterrupt(uint32_t pin, voidFuncPtr callback, uint32_t mode)
     switch (mode) {
     
     case CHANGE:
-	stm32l4_exti_notify(&stm32l4_exti, g_APinDescription[pin].pin, EXTI_CONTROL_BOTH_EDGES, (stm32l4_exti_callback_t)callback, NULL);
+	stm32l4_exti_notify(&stm32l4_exti, g_APinDescription[pin].pin, EXTI_CONTROL_BOTH_EDGES, stm32l4_interrupt_callback, (void*)callback);
 	break;
     
     case FALLING:
-	stm32l4_exti_notify(&stm32l4_exti, g_APinDescription[pin].pin, EXTI_CONTROL_FALLING_EDGE, (stm32l4_exti_callback_t)callback, NULL);
+	stm32l4_exti_notify(&stm32l4_exti, g_APinDescription[pin].pin, EXTI_CONTROL_FALLING_EDGE, stm32l4_interrupt_callback, (void*)callback);
 	break;
     
     case RISING:
-	stm32l4_exti_notify(&stm32l4_exti, g_APinDescription[pin].pin, EXTI_CONTROL_RISING_EDGE, (stm32l4_exti_callback_t)callback, NULL);
+	stm32l4_exti_notify(&stm32l4_exti, g_APinDescription[pin].pin, EXTI_CONTROL_RISING_EDGE, stm32l4_interrupt_callback, (void*)callback);
 	break;
     }
 }
@@ -60,3 +120,67 @@ void detachInterrupt(uint32_t pin)
     stm32l4_exti_notify(&stm32l4_exti, g_APinDescription[pin].pin, EXTI_CONTROL_DISABLE, NULL, NULL);
 }
 
+
+void attachInterruptCapture(uint32_t pin, uint32_t mode)
+{
+    uint32_t control;
+
+    if (!(g_APinDescription[pin].attr & PIN_ATTR_EXTI))
+	return;
+
+    switch (mode) {
+
+    case CHANGE:
+	control = EXTI_CONTROL_BOTH_EDGES;
+	break;
+
+    case FALLING:
+	control = EXTI_CONTROL_FALLING_EDGE;
+	break;
+
+    case RISING:
+	control = EXTI_CONTROL_RISING_EDGE;
+	break;
+
+    default:
+	return;
+    }
+
+    if (!stm32l4_interrupt_capture_created)
+    {
+	stm32l4_queue_create(&stm32l4_interrupt_capture_queue, &stm32l4_interrupt_capture_data[0], &stm32l4_interrupt_capture_sequence[0], sizeof(InterruptCapture), INTERRUPT_CAPTURE_SIZE);
+
+	stm32l4_interrupt_capture_created = true;
+    }
+
+    stm32l4_exti_notify(&stm32l4_exti, g_APinDescription[pin].pin, control, stm32l4_interrupt_capture_callback, (void*)(pin | (control << 8)));
+}
+
+unsigned int readInterruptCapture(InterruptCapture *records, unsigned int count)
+{
+    unsigned int index;
+
+    if (!stm32l4_interrupt_capture_created)
+	return 0;
+
+    for (index = 0; index < count; index++)
+    {
+	if (!stm32l4_queue_receive(&stm32l4_interrupt_capture_queue, &records[index]))
+	    break;
+    }
+
+    return index;
+}
+
+unsigned int interruptCaptureAvailable(void)
+{
+    if (!stm32l4_interrupt_capture_created)
+	return 0;
+
+    return stm32l4_queue_count(&stm32l4_interrupt_capture_queue);
+}
+
+uint32_t interruptCaptureOverruns(void)
+{
+    return stm32l4_interrupt_capture_overruns;
+}
@@ -46,9 +46,12 @@ extern "C" {
 #include "stm32l4_spi.h"
 #include "stm32l4_usbd_cdc.h"
 #include "stm32l4_usbd_hid.h"
+#include "stm32l4_usbd_audio.h"
+#include "stm32l4_usbd_midi.h"
 #include "stm32l4_system.h"
 #include "stm32l4_rtc.h"
 #include "stm32l4_sai.h"
+#include "stm32l4_dfsdm.h"
 #include "stm32l4_flash.h"
 #include "stm32l4_sdmmc.h"
 #include "stm32l4_sdspi.h"
@@ -60,19 +63,35 @@ extern "C" {
 #define STM32L4_ADC_IRQ_PRIORITY     15
 #define STM32L4_DAC_IRQ_PRIORITY     15
 #define STM32L4_PWM_IRQ_PRIORITY     15
+#define STM32L4_FLASH_IRQ_PRIORITY   15
+#define STM32L4_RNG_IRQ_PRIORITY     15
+#define STM32L4_TSC_IRQ_PRIORITY     15
 
 #define STM32L4_USB_IRQ_PRIORITY     14
 #define STM32L4_RTC_IRQ_PRIORITY     13
 #define STM32L4_I2C_IRQ_PRIORITY     12
 #define STM32L4_SPI_IRQ_PRIORITY     11
+#define STM32L4_QSPI_IRQ_PRIORITY    11
 #define STM32L4_UART_IRQ_PRIORITY    10
 #define STM32L4_SAI_IRQ_PRIORITY     9
+#define STM32L4_DFSDM_IRQ_PRIORITY   9
 
 #define STM32L4_EXTI_IRQ_PRIORITY    4
 #define STM32L4_SYSTICK_IRQ_PRIORITY 3
 #define STM32L4_TONE_IRQ_PRIORITY    2
 #define STM32L4_SERVO_IRQ_PRIORITY   1
 
+/* With STM32L4_CONFIG_FASTBOOT set to 1 in variant.h (or on the command line)
+ * setup() is entered as early as possible. The serial flash probe and the USB
+ * attach are deferred to the first USBDevice.attach() (called by Serial.begin()
+ * or after setup() returns), and FS.begin() initializes the storage on demand.
+ */
+#if !defined(STM32L4_CONFIG_FASTBOOT)
+#define STM32L4_CONFIG_FASTBOOT      0
+#endif
+
+extern void initStorage(void);
+
 #define LOBYTE(x)  ((uint8_t)(x & 0x00FF))
 #define HIBYTE(x)  ((uint8_t)((x & 0xFF00) >>8))
 
@@ -84,6 +103,8 @@ extern void USBD_CDC_DAP_Initialize(void *);
 extern void USBD_CDC_MSC_DAP_Initialize(void *);
 extern void USBD_CDC_WEBUSB_Initialize(void *);
 extern void USBD_CDC_MSC_WEBUSB_Initialize(void *);
+extern void USBD_CDC_AUDIO_Initialize(void *);
+extern void USBD_CDC_MIDI_Initialize(void *);
 
 extern void USBD_Initialize(const uint8_t *manufacturer, const uint8_t *product, void(*initialize)(void *), unsigned int pin_vbus, unsigned int priority);
 extern void USBD_Attach(void);
@@ -92,8 +113,12 @@ extern void USBD_Poll(void);
 extern bool USBD_Connected(void);
 extern bool USBD_Configured(void);
 extern bool USBD_Suspended(void);
+extern uint32_t USBD_FrameCount(void);
+extern int32_t USBD_ClockDrift(void);
+extern uint64_t USBD_HostMicros(void);
 
 extern void stm32l4_usbd_dap_initialize(uint16_t pin_swclk, uint16_t pin_swdio);
+extern void stm32l4_usbd_dap_swo_initialize(unsigned int instance, uint16_t pin_swo, unsigned int priority);
 
 /************************************************************************
  *
@@ -148,17 +173,25 @@ extern void stm32l4_usbd_dap_initialize(uint16_t pin_swclk, uint16_t pin_swdio);
  * TIM3    PWM
  * TIM4    PWM
  * TIM5    PWM
- * TIM6    SERVO
+ * TIM6    SERVO / DAC (analogWriteStream)
  * TIM7    TONE
  * TIM8
- * TIM15   
+ * TIM15   ADC (analogReadContinuous, STM32 health monitor)
  * TIM16   
  * TIM17  
  * 
  ************************************************************************/
 
 extern stm32l4_adc_t stm32l4_adc;
+
+/* Background scan of ADC1 "channels" every "period" milliseconds (STM32Class health monitor).
+ * Unlike analogReadContinuous() it lets analogRead() in, by pausing the scan around the conversion.
+ */
+extern bool __analogReadMonitor(const uint8_t *channels, unsigned int count, uint32_t period, uint16_t *buffer, unsigned int size, void(*callback)(const uint16_t *data, unsigned int count));
+extern void __analogReadMonitorWatchdog(unsigned int channel, uint16_t low, uint16_t high, void(*callback)(void));
+extern void __analogReadMonitorStop(void);
 extern stm32l4_exti_t stm32l4_exti;
+extern stm32l4_timer_t stm32l4_pwm[PWM_INSTANCE_COUNT];
 
 #ifdef __cplusplus
 } // extern "C"
@@ -22,7 +22,7 @@
 
 static inline __attribute__((optimize("O3"),always_inline)) uint32_t countPulseInline(const volatile uint32_t *port, uint32_t bit, uint32_t stateMask, unsigned long maxloops)
 {
-    uint32_t micros;
+    uint32_t start;
 
     // wait for any previous pulse to end
     while ((*port & bit) == stateMask)
@@ -42,7 +42,8 @@ static inline __attribute__((optimize("O3"),always_inline)) uint32_t countPulseI
 	}
     }
 
-    micros = armv7m_systick_micros();
+    // busy waiting, so the cycle counter is good for up to one wrap (as is maxloops)
+    start = armv7m_systick_cycles();
 
     // wait for the pulse to stop
     while ((*port & bit) == stateMask)
@@ -53,24 +54,293 @@ static inline __attribute__((optimize("O3"),always_inline)) uint32_t countPulseI
 	}
     }
     
-    return (uint32_t)armv7m_systick_micros() - micros;
+    return armv7m_systick_cycles_to_micros(armv7m_systick_cycles() - start);
+}
+
+#define PULSE_STATE_NONE        0
+#define PULSE_STATE_SKIP        1  /* pin was at "state" already, wait for that pulse to end */
+#define PULSE_STATE_START       2
+#define PULSE_STATE_END         3
+
+/* The start edge is captured by the pin's own channel, the end edge by the other
+ * channel of the pair (1/2 or 3/4) mapped onto the same input (PWM input mode).
+ * Hence the width is exact, even if the interrupt handler runs late.
+ */
+typedef struct _stm32l4_pulse_t {
+    volatile uint8_t        state;
+    uint8_t                 pin;
+    uint8_t                 start_channel;
+    uint8_t                 end_channel;
+    uint16_t                start;
+    uint16_t                overflows;
+    uint32_t                clock;
+    volatile uint32_t       width;
+    void                    (*callback)(uint32_t width);
+} stm32l4_pulse_t;
+
+static stm32l4_pulse_t stm32l4_pulse[PWM_INSTANCE_COUNT];
+
+/* CHxN outputs have no input path, and TIM16/TIM17 have no channel pair.
+ */
+static bool pulseInCapture(uint32_t pin)
+{
+    uint32_t group, index;
+
+    if ((g_APinDescription[pin].bit == 0) || !(g_APinDescription[pin].attr & PIN_ATTR_PWM) || (g_APinDescription[pin].pwm_channel > PWM_CHANNEL_4))
+    {
+	return false;
+    }
+
+    group = (g_APinDescription[pin].pin >> 4) & 7;
+    index = (g_APinDescription[pin].pin >> 0) & 15;
+
+    switch (g_PWMInstances[g_APinDescription[pin].pwm_instance]) {
+    case TIMER_INSTANCE_TIM1:
+	return (((group == 0) && (index >= 8) && (index <= 11)) ||
+		((group == 4) && ((index == 9) || (index == 11) || (index == 13) || (index == 14))));
+    case TIMER_INSTANCE_TIM2:
+#ifdef TIM3_BASE
+    case TIMER_INSTANCE_TIM3:
+#endif
+#ifdef TIM4_BASE
+    case TIMER_INSTANCE_TIM4:
+#endif
+#ifdef TIM5_BASE
+    case TIMER_INSTANCE_TIM5:
+#endif
+	return true;
+#ifdef TIM8_BASE
+    case TIMER_INSTANCE_TIM8:
+	return ((group == 2) && (index >= 6) && (index <= 9));
+#endif
+    case TIMER_INSTANCE_TIM15:
+	return (((group == 0) && ((index == 2) || (index == 3))) ||
+		((group == 1) && ((index == 14) || (index == 15))) ||
+		((group == 5) && ((index == 9) || (index == 10))) ||
+		((group == 6) && ((index == 10) || (index == 11))));
+    default:
+	return false;
+    }
+}
+
+static void pulseInRelease(uint32_t instance)
+{
+    stm32l4_pulse[instance].state = PULSE_STATE_NONE;
+
+    stm32l4_timer_stop(&stm32l4_pwm[instance]);
+    stm32l4_timer_disable(&stm32l4_pwm[instance]);
+    stm32l4_timer_destroy(&stm32l4_pwm[instance]);
+
+    stm32l4_gpio_pin_input(g_APinDescription[stm32l4_pulse[instance].pin].pin);
+}
+
+static void pulseInEvent(void *context, uint32_t events)
+{
+    stm32l4_pulse_t *pulse = &stm32l4_pulse[(uint32_t)context];
+    stm32l4_timer_t *timer = &stm32l4_pwm[(uint32_t)context];
+    uint32_t start_event, end_event, start, end, ticks;
+    void (*callback)(uint32_t);
+    bool wrapped;
+
+    start_event = (TIMER_EVENT_CHANNEL_1 << pulse->start_channel);
+    end_event = (TIMER_EVENT_CHANNEL_1 << pulse->end_channel);
+    wrapped = !!(events & TIMER_EVENT_PERIOD);
+
+    /* If a start and an end edge show up together, the capture values tell their order.
+     */
+    if ((pulse->state == PULSE_STATE_SKIP) && (events & end_event))
+    {
+	pulse->state = PULSE_STATE_START;
+
+	if (events & start_event)
+	{
+	    if ((uint16_t)(stm32l4_timer_capture(timer, pulse->start_channel) - stm32l4_timer_capture(timer, pulse->end_channel)) & 0x8000)
+	    {
+		events &= ~start_event;
+	    }
+	}
+
+	events &= ~end_event;
+    }
+
+    if ((pulse->state == PULSE_STATE_START) && (events & start_event))
+    {
+	start = stm32l4_timer_capture(timer, pulse->start_channel) & 0xffff;
+
+	pulse->start = start;
+	pulse->overflows = (wrapped && (start >= 0x8000)) ? 1 : 0;
+	pulse->state = PULSE_STATE_END;
+
+	wrapped = false;
+
+	if (events & end_event)
+	{
+	    if ((uint16_t)(stm32l4_timer_capture(timer, pulse->end_channel) - start) & 0x8000)
+	    {
+		events &= ~end_event;
+	    }
+	}
+    }
+
+    if (pulse->state == PULSE_STATE_END)
+    {
+	if (events & end_event)
+	{
+	    end = stm32l4_timer_capture(timer, pulse->end_channel) & 0xffff;
+
+	    if (wrapped && (end < 0x8000))
+	    {
+		pulse->overflows++;
+	    }
+
+	    ticks = ((uint32_t)pulse->overflows << 16) + end - pulse->start;
+
+	    if (pulse->clock == 1000000)
+	    {
+		pulse->width = ticks;
+	    }
+	    else
+	    {
+		pulse->width = ((uint64_t)ticks * 1000000) / pulse->clock;
+	    }
+
+	    callback = pulse->callback;
+
+	    pulseInRelease((uint32_t)context);
+
+	    if (callback)
+	    {
+		(*callback)(pulse->width);
+	    }
+	}
+	else
+	{
+	    if (wrapped && (pulse->overflows != 0xffff))
+	    {
+		pulse->overflows++;
+	    }
+	}
+    }
+}
+
+bool pulseInAsync(uint32_t pin, uint32_t state, void(*callback)(uint32_t width))
+{
+    stm32l4_pulse_t *pulse;
+    stm32l4_timer_t *timer;
+    uint32_t instance, channel, clock, prescaler;
+
+    if (!pulseInCapture(pin))
+    {
+	return false;
+    }
+
+    instance = g_APinDescription[pin].pwm_instance;
+    channel = g_APinDescription[pin].pwm_channel;
+
+    pulse = &stm32l4_pulse[instance];
+    timer = &stm32l4_pwm[instance];
+
+    if (timer->state != TIMER_STATE_NONE)
+    {
+	return false;
+    }
+
+    stm32l4_timer_create(timer, g_PWMInstances[instance], STM32L4_EXTI_IRQ_PRIORITY, 0);
+
+    clock = stm32l4_timer_clock(timer);
+    prescaler = (clock > 1000000) ? ((clock / 1000000) -1) : 0;
+
+    pulse->pin = pin;
+    pulse->start_channel = channel;
+    pulse->end_channel = channel ^ 1;
+    pulse->clock = clock / (prescaler +1);
+    pulse->width = 0;
+    pulse->callback = callback;
+
+    stm32l4_timer_enable(timer, prescaler, 0xffff, 0, pulseInEvent, (void*)instance, (TIMER_EVENT_PERIOD | (TIMER_EVENT_CHANNEL_1 << pulse->start_channel) | (TIMER_EVENT_CHANNEL_1 << pulse->end_channel)));
+
+    stm32l4_timer_channel(timer, pulse->start_channel, 0, (state ? TIMER_CONTROL_CAPTURE_RISING_EDGE : TIMER_CONTROL_CAPTURE_FALLING_EDGE));
+    stm32l4_timer_channel(timer, pulse->end_channel, 0, ((state ? TIMER_CONTROL_CAPTURE_FALLING_EDGE : TIMER_CONTROL_CAPTURE_RISING_EDGE) | TIMER_CONTROL_CAPTURE_ALTERNATE));
+
+    timer->TIM->EGR = TIM_EGR_UG;
+
+    /* Switch only the mode to alternate, so that a pullup/pulldown from pinMode() stays.
+     */
+    stm32l4_gpio_pin_alternate(g_APinDescription[pin].pin);
+
+    noInterrupts();
+
+    stm32l4_timer_start(timer, false);
+
+    pulse->state = ((!!stm32l4_gpio_pin_read(g_APinDescription[pin].pin) == !!state) ? PULSE_STATE_SKIP : PULSE_STATE_START);
+
+    interrupts();
+
+    return true;
+}
+
+void pulseInCancel(uint32_t pin)
+{
+    uint32_t instance;
+
+    if ((g_APinDescription[pin].bit == 0) || !(g_APinDescription[pin].attr & PIN_ATTR_PWM))
+    {
+	return;
+    }
+
+    instance = g_APinDescription[pin].pwm_instance;
+
+    noInterrupts();
+
+    if ((stm32l4_pulse[instance].state != PULSE_STATE_NONE) && (stm32l4_pulse[instance].pin == pin))
+    {
+	pulseInRelease(instance);
+    }
+
+    interrupts();
 }
 
 /* Measures the length (in microseconds) of a pulse on the pin; state is HIGH
  * or LOW, the type of pulse to measure.  Works on pulses from 2-3 microseconds
  * to 3 minutes in length, but must be called at least a few dozen microseconds
- * before the start of the pulse. */
+ * before the start of the pulse. If the pin can be captured by its timer, the
+ * width is measured in hardware while the CPU sleeps, otherwise by polling. */
 uint32_t pulseIn(uint32_t pin, uint32_t state, uint32_t timeout)
 {
-    if (g_APinDescription[pin].GPIO == NULL)
+    uint32_t instance, start;
+
+    if (g_APinDescription[pin].bit == 0)
     {
 	return 0;
     }
 
+    if (pulseInAsync(pin, state, NULL))
+    {
+	instance = g_APinDescription[pin].pwm_instance;
+
+	start = micros();
+
+	while (stm32l4_pulse[instance].state != PULSE_STATE_NONE)
+	{
+	    if ((micros() - start) >= timeout)
+	    {
+		pulseInCancel(pin);
+
+		/* The pulse might have ended just now.
+		 */
+		return stm32l4_pulse[instance].width;
+	    }
+
+	    armv7m_core_yield();
+	}
+
+	return stm32l4_pulse[instance].width;
+    }
+
   // cache the port and bit of the pin in order to speed up the
   // pulse width measuring loop and achieve finer resolution.  calling
   // digitalRead() instead yields much coarser resolution.
-  GPIO_TypeDef *GPIO = g_APinDescription[pin].GPIO;
+  GPIO_TypeDef *GPIO = PIN_DESCRIPTION_PORT(g_APinDescription[pin].pin);
   uint32_t bit = g_APinDescription[pin].bit;
   uint32_t stateMask = state ? bit : 0;
 
@@ -81,3 +351,208 @@ uint32_t pulseIn(uint32_t pin, uint32_t state, uint32_t timeout)
   return countPulseInline(&GPIO->IDR, bit, stateMask, maxloops);
 }
 
+
+/* pulseOut() runs the pin's PWM timer in one pulse mode with PWM mode 2: inactive
+ * while CNT < CCR ("delay"), active up to ARR ("delay" + "width"), then the update
+ * stops the counter and resets it to 0, which is inactive again. With a trigger
+ * input the slave mode controller starts (or restarts) the counter instead.
+ */
+typedef struct _stm32l4_pulse_out_t {
+    volatile uint8_t        active;
+    uint8_t                 pin;
+    uint8_t                 trigger_pin;  /* 0xff if started by software */
+} stm32l4_pulse_out_t;
+
+static stm32l4_pulse_out_t stm32l4_pulse_out[PWM_INSTANCE_COUNT];
+
+static void pulseOutRelease(uint32_t instance)
+{
+    stm32l4_pulse_out_t *pulse = &stm32l4_pulse_out[instance];
+
+    stm32l4_pwm[instance].TIM->CR1 &= ~TIM_CR1_CEN;
+
+    stm32l4_timer_stop(&stm32l4_pwm[instance]);
+    stm32l4_timer_disable(&stm32l4_pwm[instance]);
+    stm32l4_timer_destroy(&stm32l4_pwm[instance]);
+
+    digitalWrite(pulse->pin, LOW);
+    pinMode(pulse->pin, OUTPUT);
+
+    if (pulse->trigger_pin != 0xff)
+    {
+	stm32l4_gpio_pin_input(g_APinDescription[pulse->trigger_pin].pin);
+    }
+
+    pulse->active = false;
+}
+
+static bool pulseOutSetup(uint32_t pin, uint32_t width, uint32_t delay, uint32_t trigger_pin, uint32_t trigger_control, uint32_t slave, uint32_t control)
+{
+    stm32l4_pulse_out_t *pulse;
+    stm32l4_timer_t *timer;
+    uint32_t instance, channel, clock, divider, compare, period;
+    uint64_t ticks;
+
+    if ((g_APinDescription[pin].bit == 0) || !(g_APinDescription[pin].attr & PIN_ATTR_PWM) || (width == 0))
+    {
+	return false;
+    }
+
+    instance = g_APinDescription[pin].pwm_instance;
+    channel = g_APinDescription[pin].pwm_channel;
+
+    pulse = &stm32l4_pulse_out[instance];
+    timer = &stm32l4_pwm[instance];
+
+    if (pulse->active && (pulse->pin == pin))
+    {
+	/* A software started pulse that is still pending or running is left alone.
+	 */
+	if ((pulse->trigger_pin == 0xff) && (trigger_pin == 0xff) && (timer->TIM->CR1 & TIM_CR1_CEN))
+	{
+	    return false;
+	}
+
+	pulseOutRelease(instance);
+    }
+
+    if (timer->state != TIMER_STATE_NONE)
+    {
+	return false;
+    }
+
+    if (!stm32l4_timer_create(timer, g_PWMInstances[instance], STM32L4_PWM_IRQ_PRIORITY, 0))
+    {
+	return false;
+    }
+
+    /* Pick the smallest prescaler that keeps "delay" + "width" within 16 bits. The
+     * delay is at least one tick, as CCR == 0 would make CNT == 0 active.
+     */
+    clock = stm32l4_timer_clock(timer);
+
+    ticks = ((uint64_t)(delay + width) * clock) / 1000000;
+
+    divider = (ticks / 65536) +1;
+
+    if ((divider > 65536) || ((delay + width) < width))
+    {
+	stm32l4_timer_destroy(timer);
+
+	return false;
+    }
+
+    compare = (((uint64_t)delay * clock) / 1000000) / divider;
+    period = (((uint64_t)width * clock) / 1000000) / divider;
+
+    if (compare < 1)
+    {
+	compare = 1;
+    }
+
+    if (period < 1)
+    {
+	period = 1;
+    }
+
+    period += compare;
+
+    if (period > 65536)
+    {
+	period = 65536;
+    }
+
+    pulse->pin = pin;
+    pulse->trigger_pin = trigger_pin;
+    pulse->active = true;
+
+    stm32l4_timer_enable(timer, divider -1, period -1, ((trigger_pin != 0xff) ? TIMER_OPTION_ONE_PULSE : 0), NULL, NULL, 0);
+
+    if (trigger_pin != 0xff)
+    {
+	stm32l4_timer_channel(timer, g_APinDescription[trigger_pin].pwm_channel, 0, trigger_control);
+    }
+
+    stm32l4_timer_channel(timer, channel, compare, control);
+
+    /* Load PSC/ARR/CCR from their preload registers, which also clears CNT.
+     */
+    timer->TIM->EGR = TIM_EGR_UG;
+    timer->TIM->SR = 0;
+
+    digitalWrite(pin, LOW);
+
+    stm32l4_gpio_pin_configure(g_APinDescription[pin].pin, (GPIO_PUPD_NONE | GPIO_OSPEED_HIGH | GPIO_OTYPE_PUSHPULL | GPIO_MODE_ALTERNATE));
+
+    if (trigger_pin != 0xff)
+    {
+	/* Switch only the mode to alternate, so that a pullup/pulldown from pinMode() stays.
+	 */
+	stm32l4_gpio_pin_alternate(g_APinDescription[trigger_pin].pin);
+
+	stm32l4_timer_slave(timer, slave);
+    }
+    else
+    {
+	stm32l4_timer_start(timer, true);
+    }
+
+    return true;
+}
+
+bool pulseOut(uint32_t pin, uint32_t width, uint32_t delay)
+{
+    return pulseOutSetup(pin, width, delay, 0xff, 0, TIMER_SLAVE_NONE, TIMER_CONTROL_PWM_INVERTED);
+}
+
+bool pulseOutTrigger(uint32_t pin, uint32_t width, uint32_t delay, uint32_t triggerPin, uint32_t mode, bool retrigger)
+{
+    uint32_t slave;
+
+    if ((triggerPin == pin) ||
+	!pulseInCapture(triggerPin) ||
+	(g_APinDescription[triggerPin].pwm_channel > PWM_CHANNEL_2) ||
+	(g_APinDescription[triggerPin].pwm_instance != g_APinDescription[pin].pwm_instance) ||
+	((mode != RISING) && (mode != FALLING)))
+    {
+	return false;
+    }
+
+    slave = ((g_APinDescription[triggerPin].pwm_channel == PWM_CHANNEL_1) ? TIMER_SLAVE_INPUT_TI1FP1 : TIMER_SLAVE_INPUT_TI2FP2);
+    slave |= (retrigger ? TIMER_SLAVE_MODE_RESET_TRIGGER : TIMER_SLAVE_MODE_TRIGGER);
+
+    /* Without a capture edge the channel is a plain input, whose polarity selects the trigger edge.
+     */
+    return pulseOutSetup(pin, width, delay, triggerPin, ((mode == FALLING) ? TIMER_CONTROL_CAPTURE_POLARITY : 0), slave, (retrigger ? TIMER_CONTROL_RETRIGGERABLE_INVERTED : TIMER_CONTROL_PWM_INVERTED));
+}
+
+bool pulseOutBusy(uint32_t pin)
+{
+    uint32_t instance;
+
+    if ((g_APinDescription[pin].bit == 0) || !(g_APinDescription[pin].attr & PIN_ATTR_PWM))
+    {
+	return false;
+    }
+
+    instance = g_APinDescription[pin].pwm_instance;
+
+    return (stm32l4_pulse_out[instance].active && (stm32l4_pulse_out[instance].pin == pin) && (stm32l4_pwm[instance].TIM->CR1 & TIM_CR1_CEN));
+}
+
+void pulseOutStop(uint32_t pin)
+{
+    uint32_t instance;
+
+    if ((g_APinDescription[pin].bit == 0) || !(g_APinDescription[pin].attr & PIN_ATTR_PWM))
+    {
+	return;
+    }
+
+    instance = g_APinDescription[pin].pwm_instance;
+
+    if (stm32l4_pulse_out[instance].active && (stm32l4_pulse_out[instance].pin == pin))
+    {
+	pulseOutRelease(instance);
+    }
+}
@@ -77,6 +77,209 @@ void shiftOut( uint32_t ulDataPin, uint32_t ulClockPin, uint32_t ulBitOrder, uin
     }
 }
 
+#define SHIFT_SPI_CLOCK 8000000
+
+#if SPI_INTERFACES_COUNT > 0
+extern const stm32l4_spi_pins_t g_SPIPins;
+extern const unsigned int g_SPIInstance;
+#endif
+#if SPI_INTERFACES_COUNT > 1
+extern const stm32l4_spi_pins_t g_SPI1Pins;
+extern const unsigned int g_SPI1Instance;
+#endif
+#if SPI_INTERFACES_COUNT > 2
+extern const stm32l4_spi_pins_t g_SPI2Pins;
+extern const unsigned int g_SPI2Instance;
+#endif
+
+#if SPI_INTERFACES_COUNT > 0
+static bool shiftOutMatch(const stm32l4_spi_pins_t *pins, uint32_t ulDataPin, uint32_t ulClockPin)
+{
+    return (((pins->mosi & (GPIO_PIN_GROUP_MASK | GPIO_PIN_INDEX_MASK)) == (g_APinDescription[ulDataPin].pin & (GPIO_PIN_GROUP_MASK | GPIO_PIN_INDEX_MASK))) &&
+	    ((pins->sck & (GPIO_PIN_GROUP_MASK | GPIO_PIN_INDEX_MASK)) == (g_APinDescription[ulClockPin].pin & (GPIO_PIN_GROUP_MASK | GPIO_PIN_INDEX_MASK))));
+}
+
+/* shiftOut() sets up the data before the rising clock edge and returns the clock
+ * low, which is SPI mode 0. MISO is not claimed, so that pin stays untouched.
+ */
+static bool shiftOutSPI(uint32_t ulDataPin, uint32_t ulClockPin, uint32_t ulBitOrder, const uint8_t *buffer, unsigned int count)
+{
+    stm32l4_spi_t spi;
+    stm32l4_spi_pins_t pins;
+    const stm32l4_spi_pins_t *table;
+    unsigned int instance;
+    uint32_t option, clock, divide;
+
+    if (shiftOutMatch(&g_SPIPins, ulDataPin, ulClockPin))
+    {
+	table = &g_SPIPins;
+	instance = g_SPIInstance;
+    }
+#if SPI_INTERFACES_COUNT > 1
+    else if (shiftOutMatch(&g_SPI1Pins, ulDataPin, ulClockPin))
+    {
+	table = &g_SPI1Pins;
+	instance = g_SPI1Instance;
+    }
+#endif
+#if SPI_INTERFACES_COUNT > 2
+    else if (shiftOutMatch(&g_SPI2Pins, ulDataPin, ulClockPin))
+    {
+	table = &g_SPI2Pins;
+	instance = g_SPI2Instance;
+    }
+#endif
+    else
+    {
+	return false;
+    }
+
+    if (stm32l4_spi_get(instance) != NULL)
+    {
+	return false;
+    }
+
+    pins.mosi = table->mosi;
+    pins.miso = GPIO_PIN_NONE;
+    pins.sck = table->sck;
+    pins.ss = GPIO_PIN_NONE;
+
+    if (!stm32l4_spi_create(&spi, instance, &pins, STM32L4_SPI_IRQ_PRIORITY, 0))
+    {
+	return false;
+    }
+
+    clock = stm32l4_spi_clock(&spi) / 2;
+    divide = 0;
+
+    while ((clock > SHIFT_SPI_CLOCK) && (divide < 7))
+    {
+	clock /= 2;
+	divide++;
+    }
+
+    option = SPI_OPTION_MODE_0 | (divide << SPI_OPTION_DIV_SHIFT) | ((ulBitOrder == LSBFIRST) ? SPI_OPTION_LSB_FIRST : SPI_OPTION_MSB_FIRST);
+
+    /* Have the clock idle low when the pin reverts to an output.
+     */
+    digitalWrite(ulClockPin, LOW);
+
+    stm32l4_spi_enable(&spi, NULL, NULL, 0);
+    stm32l4_spi_select(&spi, option);
+    stm32l4_spi_exchange(&spi, buffer, NULL, count);
+    stm32l4_spi_unselect(&spi);
+    stm32l4_spi_disable(&spi);
+    stm32l4_spi_destroy(&spi);
+
+    pinMode(ulClockPin, OUTPUT);
+    pinMode(ulDataPin, OUTPUT);
+
+    return true;
+}
+#endif /* SPI_INTERFACES_COUNT > 0 */
+
+/* The read back of IDR between the data and the clock edge and after the rising
+ * clock edge makes sure that each write reached the pin before the next one, and
+ * keeps setup time and clock high time above the 20ns or so a 74HC595 needs.
+ */
+void shiftOutBuffer( uint32_t ulDataPin, uint32_t ulClockPin, uint32_t ulBitOrder, const uint8_t *buffer, unsigned int count )
+{
+    GPIO_TypeDef *dataGPIO, *clockGPIO;
+    uint32_t dataBit, clockBit, value, mask;
+    const uint8_t *buffer_e;
+
+    if ((g_APinDescription[ulDataPin].bit == 0) || (g_APinDescription[ulClockPin].bit == 0) || (count == 0))
+    {
+	return;
+    }
+
+#if SPI_INTERFACES_COUNT > 0
+    if (shiftOutSPI(ulDataPin, ulClockPin, ulBitOrder, buffer, count))
+    {
+	return;
+    }
+#endif
+
+    dataGPIO = PIN_DESCRIPTION_PORT(g_APinDescription[ulDataPin].pin);
+    dataBit = g_APinDescription[ulDataPin].bit;
+    clockGPIO = PIN_DESCRIPTION_PORT(g_APinDescription[ulClockPin].pin);
+    clockBit = g_APinDescription[ulClockPin].bit;
+
+    buffer_e = buffer + count;
+
+    while (buffer != buffer_e)
+    {
+	value = *buffer++;
+
+	if (ulBitOrder == LSBFIRST)
+	{
+	    value = __RBIT(value) >> 24;
+	}
+
+	for (mask = 0x80; mask; mask >>= 1)
+	{
+	    if (value & mask)
+	    {
+		dataGPIO->BSRR = dataBit;
+	    }
+	    else
+	    {
+		dataGPIO->BRR = dataBit;
+	    }
+
+	    (void)dataGPIO->IDR;
+
+	    clockGPIO->BSRR = clockBit;
+
+	    (void)clockGPIO->IDR;
+
+	    clockGPIO->BRR = clockBit;
+	}
+    }
+}
+
+void shiftInBuffer( uint32_t ulDataPin, uint32_t ulClockPin, uint32_t ulBitOrder, uint8_t *buffer, unsigned int count )
+{
+    GPIO_TypeDef *dataGPIO, *clockGPIO;
+    uint32_t dataBit, clockBit, value, index;
+    uint8_t *buffer_e;
+
+    if ((g_APinDescription[ulDataPin].bit == 0) || (g_APinDescription[ulClockPin].bit == 0) || (count == 0))
+    {
+	return;
+    }
+
+    dataGPIO = PIN_DESCRIPTION_PORT(g_APinDescription[ulDataPin].pin);
+    dataBit = g_APinDescription[ulDataPin].bit;
+    clockGPIO = PIN_DESCRIPTION_PORT(g_APinDescription[ulClockPin].pin);
+    clockBit = g_APinDescription[ulClockPin].bit;
+
+    buffer_e = buffer + count;
+
+    while (buffer != buffer_e)
+    {
+	value = 0;
+
+	for (index = 0; index < 8; index++)
+	{
+	    clockGPIO->BSRR = clockBit;
+
+	    (void)clockGPIO->IDR;
+
+	    value = (value << 1) | !!(dataGPIO->IDR & dataBit);
+
+	    clockGPIO->BRR = clockBit;
+	}
+
+	if (ulBitOrder == LSBFIRST)
+	{
+	    value = __RBIT(value) >> 24;
+	}
+
+	*buffer++ = value;
+    }
+}
+
 #ifdef __cplusplus
 } // extern "C"
 #endif
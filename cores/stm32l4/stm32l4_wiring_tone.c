@@ -35,6 +35,108 @@ static uint32_t     toneCount = 0;
 
 static stm32l4_timer_t stm32l4_tone;
 
+/* A pin with a PWM channel whose timer is not in use otherwise gets a hardware voice,
+ * a 50% PWM square wave without any interrupt. One voice per timer, as the channels
+ * of a timer share its period. The duration is tracked by a millisecond armv7m_timer_t.
+ * Anything else falls back to toggling a single GPIO from the TONE timer interrupt.
+ */
+typedef struct _tone_voice_t {
+    armv7m_timer_t      timeout;
+    volatile uint8_t    active;
+    uint8_t             pin;
+} tone_voice_t;
+
+static tone_voice_t toneVoices[PWM_INSTANCE_COUNT];
+
+static void toneRelease(unsigned int instance)
+{
+    uint32_t pin;
+
+    pin = toneVoices[instance].pin;
+
+    armv7m_timer_stop(&toneVoices[instance].timeout);
+
+    stm32l4_timer_stop(&stm32l4_pwm[instance]);
+    stm32l4_timer_disable(&stm32l4_pwm[instance]);
+    stm32l4_timer_destroy(&stm32l4_pwm[instance]);
+
+    digitalWrite(pin, LOW);
+    pinMode(pin, OUTPUT);
+
+    toneVoices[instance].active = false;
+}
+
+static void tone_timeout_callback(armv7m_timer_t *timeout)
+{
+    toneRelease((tone_voice_t*)timeout - &toneVoices[0]);
+}
+
+static bool toneVoice(uint32_t pin, uint32_t frequency, uint32_t duration)
+{
+    unsigned int instance;
+    uint32_t clock, divider, period;
+    stm32l4_timer_t *timer;
+
+    if (!(g_APinDescription[pin].attr & PIN_ATTR_PWM)) {
+	return false;
+    }
+
+    instance = g_APinDescription[pin].pwm_instance;
+    timer = &stm32l4_pwm[instance];
+
+    /* Stop the timeout first, so that it cannot release the voice while it is
+     * being reprogrammed.
+     */
+    if (toneVoices[instance].active && (toneVoices[instance].pin == pin)) {
+	armv7m_timer_stop(&toneVoices[instance].timeout);
+    }
+
+    if (!toneVoices[instance].active || (toneVoices[instance].pin != pin)) {
+	if (timer->state != TIMER_STATE_NONE) {
+	    return false;
+	}
+
+	if (!stm32l4_timer_create(timer, g_PWMInstances[instance], STM32L4_PWM_IRQ_PRIORITY, 0)) {
+	    return false;
+	}
+
+	stm32l4_timer_enable(timer, 0, 0, 0, NULL, NULL, 0);
+
+	armv7m_timer_create(&toneVoices[instance].timeout, tone_timeout_callback);
+
+	toneVoices[instance].pin = pin;
+	toneVoices[instance].active = true;
+
+	digitalWrite(pin, LOW);
+    } else {
+	stm32l4_timer_stop(timer);
+    }
+
+    /* Pick the smallest prescaler that keeps the period within 16 bits.
+     */
+    clock = stm32l4_timer_clock(timer);
+
+    divider = ((clock / frequency) / 65536) +1;
+    period = (clock / divider) / frequency;
+
+    if (period < 2) {
+	period = 2;
+    }
+
+    stm32l4_timer_configure(timer, divider -1, period -1, TIMER_OPTION_COUNT_PRELOAD);
+
+    stm32l4_gpio_pin_configure(g_APinDescription[pin].pin, (GPIO_PUPD_NONE | GPIO_OSPEED_HIGH | GPIO_OTYPE_PUSHPULL | GPIO_MODE_ALTERNATE));
+
+    stm32l4_timer_channel(timer, g_APinDescription[pin].pwm_channel, period / 2, TIMER_CONTROL_PWM);
+    stm32l4_timer_start(timer, false);
+
+    if (duration) {
+	armv7m_timer_start(&toneVoices[instance].timeout, duration);
+    }
+
+    return true;
+}
+
 static void tone_event_callback(void *context, uint32_t events)
 {
     if (toneCount) {
@@ -64,10 +166,19 @@ void tone(uint32_t pin, uint32_t frequency, uint32_t duration)
 	return;
     }
 
-    if ( g_APinDescription[pin].GPIO == NULL ) {
+    if ( g_APinDescription[pin].bit == 0 ) {
 	return ;
     }
 
+    GPIO_TypeDef *GPIO = PIN_DESCRIPTION_PORT(g_APinDescription[pin].pin);
+    uint32_t bit = g_APinDescription[pin].bit;
+
+    if ((toneGPIO != GPIO) || (toneBit != bit)) {
+	if (toneVoice(pin, frequency, duration)) {
+	    return;
+	}
+    }
+
     if (stm32l4_tone.state == TIMER_STATE_NONE) {
 #ifdef TIM7_BASE
       stm32l4_timer_create(&stm32l4_tone, TIMER_INSTANCE_TIM7, STM32L4_TONE_IRQ_PRIORITY, 0);
@@ -76,9 +187,6 @@ void tone(uint32_t pin, uint32_t frequency, uint32_t duration)
 #endif
     }
 
-    GPIO_TypeDef *GPIO = (GPIO_TypeDef *)g_APinDescription[pin].GPIO;
-    uint32_t bit = g_APinDescription[pin].bit;
-
     if ((toneGPIO != GPIO) || (toneBit != bit)) {
 	if (toneGPIO) {
 	    noTone(pin);
@@ -123,6 +231,18 @@ void tone(uint32_t pin, uint32_t frequency, uint32_t duration)
 
 void noTone(uint32_t pin)
 {
+    unsigned int instance;
+
+    if (g_APinDescription[pin].attr & PIN_ATTR_PWM) {
+	instance = g_APinDescription[pin].pwm_instance;
+
+	if (toneVoices[instance].active && (toneVoices[instance].pin == pin)) {
+	    toneRelease(instance);
+
+	    return;
+	}
+    }
+
     stm32l4_timer_stop(&stm32l4_tone);
     stm32l4_timer_disable(&stm32l4_tone);
 
@@ -0,0 +1,3 @@
+/* Builds system/STM32L4xx/Source/armv7m_svcall.c as part of the core. */
+
+#include "../../../system/STM32L4xx/Source/armv7m_svcall.c"
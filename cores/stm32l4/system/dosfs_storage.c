@@ -0,0 +1,3 @@
+/* Builds system/STM32L4xx/Source/dosfs_storage.c as part of the core. */
+
+#include "../../../system/STM32L4xx/Source/dosfs_storage.c"
@@ -0,0 +1,3 @@
+/* Builds system/STM32L4xx/Source/stm32l4_sdspi.c as part of the core. */
+
+#include "../../../system/STM32L4xx/Source/stm32l4_sdspi.c"
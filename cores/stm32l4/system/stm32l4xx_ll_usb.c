@@ -0,0 +1,3 @@
+/* Builds system/STM32L4xx/Source/USB/HAL/Src/stm32l4xx_ll_usb.c as part of the core. */
+
+#include "../../../system/STM32L4xx/Source/USB/HAL/Src/stm32l4xx_ll_usb.c"
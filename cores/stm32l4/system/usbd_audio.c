@@ -0,0 +1,3 @@
+/* Builds system/STM32L4xx/Source/USB/Class/AUDIO/Src/usbd_audio.c as part of the core. */
+
+#include "../../../system/STM32L4xx/Source/USB/Class/AUDIO/Src/usbd_audio.c"
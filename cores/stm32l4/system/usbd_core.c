@@ -0,0 +1,3 @@
+/* Builds system/STM32L4xx/Source/USB/Core/Src/usbd_core.c as part of the core. */
+
+#include "../../../system/STM32L4xx/Source/USB/Core/Src/usbd_core.c"
@@ -0,0 +1,3 @@
+/* Builds system/STM32L4xx/Source/USB/Class/MIDI/Src/usbd_midi.c as part of the core. */
+
+#include "../../../system/STM32L4xx/Source/USB/Class/MIDI/Src/usbd_midi.c"
@@ -0,0 +1,3 @@
+/* Builds system/STM32L4xx/Source/USB/Class/WEBUSB/Src/usbd_webusb.c as part of the core. */
+
+#include "../../../system/STM32L4xx/Source/USB/Class/WEBUSB/Src/usbd_webusb.c"
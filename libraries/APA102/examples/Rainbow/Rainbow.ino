@@ -0,0 +1,54 @@
+/*
+  Rainbow
+
+  Scrolls a rainbow along a strip of 60 APA102 (or SK9822) LEDs on SPI
+  (data on MOSI, clock on SCK). The next frame is rendered while the
+  previous one is still being sent by DMA.
+
+  This example code is in the public domain.
+*/
+
+#include <APA102.h>
+
+#define LED_COUNT 60
+
+APA102<LED_COUNT> strip(SPI);
+
+unsigned int offset;
+
+// 0..767 around the color wheel
+uint32_t wheel(unsigned int position)
+{
+  position %= 768;
+
+  if (position < 256) {
+    return ((255 - position) << 16) | (position << 8);
+  } else if (position < 512) {
+    position -= 256;
+    return ((255 - position) << 8) | position;
+  } else {
+    position -= 512;
+    return (position << 16) | (255 - position);
+  }
+}
+
+void setup()
+{
+  strip.begin();
+  strip.setBrightness(8);
+}
+
+void loop()
+{
+  unsigned int i;
+
+  for (i = 0; i < LED_COUNT; i++) {
+    strip.setPixel(i, wheel(offset + i * (768 / LED_COUNT)));
+  }
+
+  strip.show();
+
+  offset += 2;
+
+  delay(10);
+}
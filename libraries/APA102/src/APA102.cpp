@@ -0,0 +1,320 @@
+/*
+ * Copyright (c) 2017 Thomas Roell.  All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal with the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ *  1. Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimers.
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimers in the
+ *     documentation and/or other materials provided with the distribution.
+ *  3. Neither the name of Thomas Roell, nor the names of its contributors
+ *     may be used to endorse or promote products derived from this Software
+ *     without specific prior written permission.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ * CONTRIBUTORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * WITH THE SOFTWARE.
+ */
+
+#include "Arduino.h"
+#include "stm32l4_wiring_private.h"
+#include "APA102.h"
+
+static_assert(APA102_STRIP_COUNT == 3, "APA102_STRIP_COUNT does not match the callback table");
+
+// Priority ceiling of the frame hand-off, which _spiCallback() does from the SPI
+// completion (at STM32L4_SPI_IRQ_PRIORITY, the priority of the SPI instances).
+#define APA102_CRITICAL_PRIORITY STM32L4_SPI_IRQ_PRIORITY
+
+// round(65535 * (i / 255) ^ 2.8)
+static const uint16_t APA102Gamma[256] = {
+    0x0000, 0x0000, 0x0000, 0x0000, 0x0001, 0x0001, 0x0002, 0x0003,
+    0x0004, 0x0006, 0x0008, 0x000a, 0x000d, 0x0010, 0x0013, 0x0018,
+    0x001c, 0x0021, 0x0027, 0x002e, 0x0035, 0x003c, 0x0045, 0x004e,
+    0x0058, 0x0062, 0x006e, 0x007a, 0x0087, 0x0095, 0x00a4, 0x00b3,
+    0x00c4, 0x00d6, 0x00e8, 0x00fc, 0x0111, 0x0127, 0x013d, 0x0155,
+    0x016e, 0x0189, 0x01a4, 0x01c1, 0x01de, 0x01fe, 0x021e, 0x023f,
+    0x0262, 0x0287, 0x02ac, 0x02d3, 0x02fc, 0x0326, 0x0351, 0x037e,
+    0x03ac, 0x03dc, 0x040d, 0x0440, 0x0474, 0x04aa, 0x04e2, 0x051b,
+    0x0556, 0x0593, 0x05d1, 0x0611, 0x0653, 0x0696, 0x06dc, 0x0723,
+    0x076c, 0x07b7, 0x0803, 0x0852, 0x08a2, 0x08f5, 0x0949, 0x099f,
+    0x09f8, 0x0a52, 0x0aae, 0x0b0d, 0x0b6d, 0x0bd0, 0x0c34, 0x0c9b,
+    0x0d04, 0x0d6f, 0x0ddc, 0x0e4c, 0x0ebe, 0x0f32, 0x0fa8, 0x1020,
+    0x109b, 0x1118, 0x1198, 0x121a, 0x129e, 0x1325, 0x13ae, 0x1439,
+    0x14c7, 0x1558, 0x15eb, 0x1680, 0x1718, 0x17b3, 0x1850, 0x18f0,
+    0x1992, 0x1a37, 0x1adf, 0x1b89, 0x1c36, 0x1ce5, 0x1d98, 0x1e4d,
+    0x1f05, 0x1fc0, 0x207d, 0x213d, 0x2200, 0x22c6, 0x238f, 0x245b,
+    0x252a, 0x25fb, 0x26d0, 0x27a7, 0x2882, 0x295f, 0x2a40, 0x2b23,
+    0x2c0a, 0x2cf3, 0x2de0, 0x2ed0, 0x2fc3, 0x30b9, 0x31b2, 0x32af,
+    0x33ae, 0x34b1, 0x35b7, 0x36c1, 0x37cd, 0x38dd, 0x39f1, 0x3b07,
+    0x3c21, 0x3d3e, 0x3e5f, 0x3f83, 0x40aa, 0x41d5, 0x4303, 0x4435,
+    0x456a, 0x46a3, 0x47df, 0x491f, 0x4a62, 0x4ba9, 0x4cf4, 0x4e42,
+    0x4f94, 0x50e9, 0x5242, 0x539f, 0x54ff, 0x5663, 0x57cb, 0x5936,
+    0x5aa6, 0x5c19, 0x5d90, 0x5f0a, 0x6089, 0x620b, 0x6391, 0x651c,
+    0x66aa, 0x683b, 0x69d1, 0x6b6b, 0x6d09, 0x6eaa, 0x7050, 0x71fa,
+    0x73a8, 0x7559, 0x770f, 0x78c9, 0x7a87, 0x7c4a, 0x7e10, 0x7fda,
+    0x81a9, 0x837c, 0x8553, 0x872e, 0x890d, 0x8af1, 0x8cd9, 0x8ec5,
+    0x90b6, 0x92ab, 0x94a4, 0x96a1, 0x98a3, 0x9aa9, 0x9cb4, 0x9ec3,
+    0xa0d7, 0xa2ef, 0xa50b, 0xa72c, 0xa952, 0xab7b, 0xadaa, 0xafdd,
+    0xb214, 0xb451, 0xb691, 0xb8d7, 0xbb21, 0xbd6f, 0xbfc3, 0xc21b,
+    0xc477, 0xc6d9, 0xc93f, 0xcbaa, 0xce19, 0xd08e, 0xd307, 0xd585,
+    0xd807, 0xda8f, 0xdd1c, 0xdfad, 0xe243, 0xe4de, 0xe77e, 0xea23,
+    0xeccd, 0xef7c, 0xf230, 0xf4e9, 0xf7a7, 0xfa6a, 0xfd32, 0xffff,
+};
+
+// Bit reversed frame counter, added before dropping the low 8 bits.
+static const uint8_t APA102Dither[8] = {
+    0x00, 0x80, 0x40, 0xc0, 0x20, 0xa0, 0x60, 0xe0,
+};
+
+APA102Strip *APA102Strip::_strips[APA102_STRIP_COUNT];
+
+APA102Strip::APA102Strip(SPIClass &spi, unsigned int count, uint8_t *pixels, uint8_t *frames)
+{
+    _spi = &spi;
+    _count = count;
+    _size = APA102_FRAME_SIZE(count);
+    _pixels = pixels;
+    _frames[0] = frames;
+    _frames[1] = frames + _size;
+    _brightness = 31;
+    _dither = 0;
+    _slot = -1;
+    _last = 1;
+    _sending = -1;
+    _pending = -1;
+    _dropped = 0;
+
+    memset(_pixels, 0, 3 * _count);
+}
+
+template<unsigned int N> void APA102Strip::_spiCallback(void)
+{
+    _strips[N]->complete();
+}
+
+bool APA102Strip::begin(uint32_t clock)
+{
+    unsigned int slot;
+
+    if (_slot >= 0) {
+	return false;
+    }
+
+    for (slot = 0; slot < APA102_STRIP_COUNT; slot++) {
+	if (!_strips[slot]) {
+	    break;
+	}
+    }
+
+    if (slot == APA102_STRIP_COUNT) {
+	return false;
+    }
+
+    _strips[slot] = this;
+    _slot = slot;
+
+    _settings = SPISettings(clock, MSBFIRST, SPI_MODE0);
+
+    // Start, reset and end frames are all zeros and never change.
+    memset(_frames[0], 0, 2 * _size);
+
+    _dither = 0;
+    _last = 1;
+    _sending = -1;
+    _pending = -1;
+    _dropped = 0;
+
+    if (!_spi->isEnabled()) {
+	_spi->begin();
+    }
+
+    return true;
+}
+
+void APA102Strip::end()
+{
+    if (_slot < 0) {
+	return;
+    }
+
+    flush();
+
+    _strips[_slot] = NULL;
+    _slot = -1;
+}
+
+void APA102Strip::setPixel(unsigned int index, uint8_t red, uint8_t green, uint8_t blue)
+{
+    uint8_t *pixel;
+
+    if (index >= _count) {
+	return;
+    }
+
+    pixel = &_pixels[3 * index];
+
+    pixel[0] = red;
+    pixel[1] = green;
+    pixel[2] = blue;
+}
+
+void APA102Strip::setPixel(unsigned int index, uint32_t color)
+{
+    setPixel(index, (color >> 16), (color >> 8), (color >> 0));
+}
+
+uint32_t APA102Strip::getPixel(unsigned int index)
+{
+    const uint8_t *pixel;
+
+    if (index >= _count) {
+	return 0;
+    }
+
+    pixel = &_pixels[3 * index];
+
+    return ((pixel[0] << 16) | (pixel[1] << 8) | (pixel[2] << 0));
+}
+
+void APA102Strip::clear()
+{
+    memset(_pixels, 0, 3 * _count);
+}
+
+void APA102Strip::setBrightness(uint8_t brightness)
+{
+    _brightness = (brightness > 31) ? 31 : brightness;
+}
+
+bool APA102Strip::show()
+{
+    uint32_t basepri;
+    unsigned int index;
+
+    if (_slot < 0) {
+	return false;
+    }
+
+    // At most one frame is queued behind the one in flight.
+    while (_pending >= 0) {
+	armv7m_core_yield();
+    }
+
+    // _last is either done or still being sent, so the other frame is free.
+    index = _last ^ 1;
+
+    encode(_frames[index]);
+
+    _last = index;
+
+    basepri = armv7m_critical_enter(APA102_CRITICAL_PRIORITY);
+
+    if (_sending >= 0) {
+	_pending = index;
+
+	armv7m_critical_leave(basepri);
+    } else {
+	armv7m_critical_leave(basepri);
+
+	start(index);
+    }
+
+    return true;
+}
+
+bool APA102Strip::done()
+{
+    return ((_sending < 0) && (_pending < 0));
+}
+
+void APA102Strip::flush()
+{
+    while (!done()) {
+	armv7m_core_yield();
+    }
+}
+
+void APA102Strip::encode(uint8_t *frame)
+{
+    const uint8_t *pixel, *pixel_e;
+    uint8_t *led;
+    unsigned int dither, value, step;
+
+    pixel = _pixels;
+    pixel_e = _pixels + 3 * _count;
+    led = frame + 4;
+
+    // The dither offset steps per LED as well, so that neighbouring LEDs
+    // do not flicker in phase.
+    step = _dither;
+
+    while (pixel != pixel_e) {
+	dither = APA102Dither[step & 7];
+
+	led[0] = 0xe0 | _brightness;
+
+	value = (APA102Gamma[pixel[2]] + dither) >> 8;
+	led[1] = (value > 255) ? 255 : value;
+
+	value = (APA102Gamma[pixel[1]] + dither) >> 8;
+	led[2] = (value > 255) ? 255 : value;
+
+	value = (APA102Gamma[pixel[0]] + dither) >> 8;
+	led[3] = (value > 255) ? 255 : value;
+
+	pixel += 3;
+	led += 4;
+	step++;
+    }
+
+    _dither++;
+}
+
+// Called from show() with no frame in flight, or from the completion
+// callback of the previous frame.
+void APA102Strip::start(unsigned int index)
+{
+    static void (* const spiCallbacks[APA102_STRIP_COUNT])(void) = {
+	APA102Strip::_spiCallback<0>,
+	APA102Strip::_spiCallback<1>,
+	APA102Strip::_spiCallback<2>,
+    };
+
+    _sending = index;
+
+    _spi->beginTransaction(_settings);
+
+    if (!_spi->transfer(_frames[index], NULL, _size, spiCallbacks[_slot])) {
+	_spi->endTransaction();
+
+	_sending = -1;
+	_dropped++;
+    }
+}
+
+void APA102Strip::complete()
+{
+    int index;
+
+    _spi->endTransaction();
+
+    index = _pending;
+
+    _pending = -1;
+    _sending = -1;
+
+    if (index >= 0) {
+	start(index);
+    }
+}
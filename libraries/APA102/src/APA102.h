@@ -0,0 +1,119 @@
+/*
+ * Copyright (c) 2017 Thomas Roell.  All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal with the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ *  1. Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimers.
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimers in the
+ *     documentation and/or other materials provided with the distribution.
+ *  3. Neither the name of Thomas Roell, nor the names of its contributors
+ *     may be used to endorse or promote products derived from this Software
+ *     without specific prior written permission.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ * CONTRIBUTORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * WITH THE SOFTWARE.
+ */
+
+#ifndef _APA102_H_INCLUDED
+#define _APA102_H_INCLUDED
+
+#include <Arduino.h>
+#include <SPI.h>
+
+// Number of strips that can be active at the same time, and the default
+// SPI clock.
+#define APA102_STRIP_COUNT   3
+#define APA102_DEFAULT_CLOCK 8000000
+
+// Bytes per encoded frame for "n" LEDs: a start frame, 4 bytes per LED,
+// a 4 byte reset frame (needed by SK9822) and n/2 bits of end frame,
+// padded to a multiple of 4 so that DMA can use 16 bit transfers.
+#define APA102_FRAME_SIZE(n) ((4 + 4 * (n) + 4 + (((n) + 15) / 16) + 3) & ~3)
+
+// APA102/SK9822 strip output.
+//
+// setPixel()/getPixel() work on an RGB framebuffer. show() encodes the
+// framebuffer into the SPI frame that is not being sent, mapping each
+// color through a gamma 2.8 8 to 16 bit lookup table and rounding back
+// to 8 bits with an 8 frame temporal dither (so a strip that keeps being
+// refreshed shows 11 bits per color). The frame is then sent by DMA via
+// the asynchronous SPIClass::transfer(), so show() returns while the
+// previous frame may still be going out. If it is, the new frame gets
+// queued and is started from the completion callback; show() only waits
+// if a frame is already queued.
+//
+// The SPI bus is selected per frame from the completion callback, so
+// other devices on the same bus must not be used while frames are in
+// flight (see done()/flush()).
+class APA102Strip
+{
+public:
+    bool begin(uint32_t clock = APA102_DEFAULT_CLOCK);
+    void end();
+
+    void setPixel(unsigned int index, uint8_t red, uint8_t green, uint8_t blue);
+    void setPixel(unsigned int index, uint32_t color);
+    uint32_t getPixel(unsigned int index);
+    void clear();
+
+    // Global 5 bit brightness (0 to 31) of the APA102 LED frame.
+    void setBrightness(uint8_t brightness);
+
+    bool show();
+    bool done();
+    void flush();
+
+    unsigned int count() { return _count; }
+    uint8_t *pixels() { return _pixels; }
+    uint32_t dropped() { return _dropped; }
+
+protected:
+    APA102Strip(SPIClass &spi, unsigned int count, uint8_t *pixels, uint8_t *frames);
+
+private:
+    SPIClass *_spi;
+    SPISettings _settings;
+    unsigned int _count;
+    unsigned int _size;
+    uint8_t *_pixels;
+    uint8_t *_frames[2];
+    uint8_t _brightness;
+    uint8_t _dither;
+    int8_t _slot;
+    uint8_t _last;
+    volatile int8_t _sending;
+    volatile int8_t _pending;
+    volatile uint32_t _dropped;
+
+    void encode(uint8_t *frame);
+    void start(unsigned int index);
+    void complete();
+
+    static APA102Strip *_strips[APA102_STRIP_COUNT];
+    template<unsigned int N> static void _spiCallback(void);
+};
+
+// A strip of "N" LEDs on "spi", for example "APA102<144> strip(SPI);".
+template<unsigned int N> class APA102 : public APA102Strip
+{
+public:
+    APA102(SPIClass &spi) : APA102Strip(spi, N, &_pixelData[0], &_frameData[0]) { }
+
+private:
+    uint8_t _pixelData[3 * N];
+    uint8_t _frameData[2 * APA102_FRAME_SIZE(N)] __attribute__((aligned(4)));
+};
+
+#endif // _APA102_H_INCLUDED
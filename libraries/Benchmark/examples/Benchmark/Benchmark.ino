@@ -0,0 +1,74 @@
+/*
+  Benchmark
+
+  Times memcpy() and memset() on a 1024 byte buffer, with interrupts
+  masked, plus a small CRC loop once with warm and once with flushed
+  flash caches. Results are printed once over Serial, first as CSV, then
+  as JSON. CSV lines start with "BENCHMARK,".
+
+  This example code is in the public domain.
+*/
+
+#include <Benchmark.h>
+
+static uint8_t source[1024] __attribute__((aligned(4)));
+static uint8_t destination[1024] __attribute__((aligned(4)));
+
+static void copy(void *context)
+{
+  memcpy(destination, source, sizeof(destination));
+}
+
+static void fill(void *context)
+{
+  memset(destination, 0x55, sizeof(destination));
+}
+
+static void crc(void *context)
+{
+  volatile uint32_t *p_crc = (volatile uint32_t*)context;
+  uint32_t value = 0xffffffff;
+  unsigned int i, j;
+
+  for (i = 0; i < 64; i++) {
+    value ^= source[i];
+
+    for (j = 0; j < 8; j++) {
+      value = (value >> 1) ^ (0xedb88320 & -(value & 1));
+    }
+  }
+
+  *p_crc = value;
+}
+
+static volatile uint32_t crcValue;
+
+void setup()
+{
+  unsigned int i;
+
+  Serial.begin(9600);
+
+  while (!Serial) { }
+
+  for (i = 0; i < sizeof(source); i++) {
+    source[i] = i;
+  }
+
+  Benchmark.begin();
+
+  Benchmark.add("memcpy", copy, NULL, sizeof(destination), BENCHMARK_OPTION_IRQ_MASKED);
+  Benchmark.add("memset", fill, NULL, sizeof(destination), BENCHMARK_OPTION_IRQ_MASKED);
+  Benchmark.add("crc", crc, (void*)&crcValue, 64, BENCHMARK_OPTION_IRQ_MASKED);
+  Benchmark.add("crc_cold", crc, (void*)&crcValue, 64, BENCHMARK_OPTION_IRQ_MASKED | BENCHMARK_OPTION_CACHE_FLUSH);
+
+  Serial.print("BENCHMARK,overhead=");
+  Serial.println(Benchmark.overhead());
+
+  Benchmark.runAll(Serial, 200, 8, BENCHMARK_FORMAT_CSV);
+  Benchmark.runAll(Serial, 200, 8, BENCHMARK_FORMAT_JSON);
+}
+
+void loop()
+{
+}
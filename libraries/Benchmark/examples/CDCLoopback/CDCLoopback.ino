@@ -0,0 +1,108 @@
+/*
+  CDCLoopback
+
+  Echoes everything received over SerialUSB back to the host, and measures
+  the bandwidth and CPU load of doing so, at every "CPU Speed" setting
+  that USB can run at.
+
+  The host drives the test. For every clock it streams data to the board
+  while reading the echo back (e.g. 1MB in 4096 byte chunks), then stays
+  quiet for at least 200ms. After that pause the board prints a result
+  line for the data echoed so far and moves to the next clock:
+
+    CDC,clock=<hz>,bytes=<n>,bytes_per_s=<n>,cpu=<n.n>%
+
+  "cpu" is the share of the time not spent waiting for data, i.e. in the
+  USB interrupt and copying data. Clocks the core refuses to switch to
+  (USB below 16MHz) are reported as "skipped", the last line is "CDC,done".
+
+  This example code is in the public domain.
+*/
+
+#include <Benchmark.h>
+
+#define QUIET 200 // milliseconds
+
+static uint8_t data[1024];
+
+static bool cdcAvailable(void *context)
+{
+  return (SerialUSB.available() != 0) || ((millis() - *(uint32_t*)context) >= QUIET);
+}
+
+static void measure()
+{
+  uint32_t count, first, last, idle, cycles, stolen, wait, stamp;
+  size_t n;
+
+  // Waits (forever) for the host to start, then echoes till it pauses.
+  while (!SerialUSB.available()) { }
+
+  count = 0;
+  idle = 0;
+  first = Benchmark.cycles();
+  last = first;
+  stamp = millis();
+
+  while (1) {
+    n = SerialUSB.read(data, sizeof(data));
+
+    if (n) {
+      SerialUSB.write(data, n);
+
+      count += n;
+      last = Benchmark.cycles();
+      stamp = millis();
+    } else {
+      wait = Benchmark.wait(cdcAvailable, &stamp, &stolen);
+
+      if (!SerialUSB.available()) {
+        break;
+      }
+
+      idle += (wait - stolen);
+    }
+  }
+
+  cycles = last - first;
+
+  SerialUSB.print("CDC,clock=");
+  SerialUSB.print(SystemCoreClock);
+  SerialUSB.print(",bytes=");
+  SerialUSB.print(count);
+  SerialUSB.print(",bytes_per_s=");
+  SerialUSB.print(cycles ? (uint32_t)(((uint64_t)count * SystemCoreClock) / cycles) : 0);
+  SerialUSB.print(",cpu=");
+  SerialUSB.print(cycles ? ((float)(cycles - ((idle < cycles) ? idle : cycles)) * 100.0f / (float)cycles) : 0.0f, 1);
+  SerialUSB.println("%");
+}
+
+void setup()
+{
+  unsigned int i;
+
+  SerialUSB.begin(9600);
+
+  while (!SerialUSB) { }
+
+  Benchmark.begin();
+
+  for (i = 0; Benchmark.clock(i); i++) {
+    if (!Benchmark.setClock(Benchmark.clock(i))) {
+      SerialUSB.print("CDC,clock=");
+      SerialUSB.print(Benchmark.clock(i));
+      SerialUSB.println(",skipped");
+      continue;
+    }
+
+    measure();
+  }
+
+  Benchmark.setClock(F_CPU);
+
+  SerialUSB.println("CDC,done");
+}
+
+void loop()
+{
+}
@@ -0,0 +1,119 @@
+/*
+  DMAThroughput
+
+  Compares memcpy() against a memory-to-memory DMA transfer through
+  stm32l4_dma_memcpy_async(), for a range of sizes at every "CPU Speed"
+  setting. For DMA, "cpu" is the share of the transfer time spent setting
+  it up and in the completion interrupt, i.e. what is left of the CPU for
+  other work. Results are printed once over Serial, as
+
+    DMA,clock=<hz>,mode=<memcpy|dma>,bytes=<n>,bytes_per_s=<n>,bytes_per_cycle=<n.nnn>,cpu=<n.n>%
+
+  Clocks the core refuses to switch to (USB below 16MHz) are reported as
+  "skipped".
+
+  This example code is in the public domain.
+*/
+
+#include <Benchmark.h>
+#include "stm32l4_dma.h"
+
+static uint8_t source[16384] __attribute__((aligned(4)));
+static uint8_t destination[16384] __attribute__((aligned(4)));
+
+static const uint32_t sizes[] = { 256, 1024, 4096, 16384 };
+
+static volatile bool complete;
+
+static void dmaCallback(void *context, uint32_t events)
+{
+  complete = true;
+}
+
+static bool dmaDone(void *context)
+{
+  return complete;
+}
+
+static void report(const char *mode, uint32_t size, uint32_t cycles, uint32_t busy)
+{
+  Serial.print("DMA,clock=");
+  Serial.print(SystemCoreClock);
+  Serial.print(",mode=");
+  Serial.print(mode);
+  Serial.print(",bytes=");
+  Serial.print(size);
+  Serial.print(",bytes_per_s=");
+  Serial.print((uint32_t)(((uint64_t)size * SystemCoreClock) / cycles));
+  Serial.print(",bytes_per_cycle=");
+  Serial.print((float)size / (float)cycles, 3);
+  Serial.print(",cpu=");
+  Serial.print((float)busy * 100.0f / (float)cycles, 1);
+  Serial.println("%");
+}
+
+static void measure(uint32_t size)
+{
+  uint32_t start, issue, cycles, stolen;
+
+  start = Benchmark.cycles();
+  memcpy(destination, source, size);
+  cycles = Benchmark.cycles() - start;
+
+  report("memcpy", size, cycles, cycles);
+
+  complete = false;
+
+  start = Benchmark.cycles();
+
+  // Completion at the lowest NVIC priority.
+  if (!stm32l4_dma_memcpy_async(destination, source, size, 15, dmaCallback, NULL)) {
+    // Done by the CPU instead, no channel was free.
+    cycles = Benchmark.cycles() - start;
+
+    report("cpu", size, cycles, cycles);
+    return;
+  }
+
+  issue = Benchmark.cycles() - start;
+
+  cycles = issue + Benchmark.wait(dmaDone, NULL, &stolen);
+
+  report("dma", size, cycles, issue + stolen);
+}
+
+void setup()
+{
+  unsigned int i, j;
+
+  Serial.begin(9600);
+
+  while (!Serial) { }
+
+  for (i = 0; i < sizeof(source); i++) {
+    source[i] = i;
+  }
+
+  Benchmark.begin();
+
+  for (i = 0; Benchmark.clock(i); i++) {
+    if (!Benchmark.setClock(Benchmark.clock(i))) {
+      Serial.print("DMA,clock=");
+      Serial.print(Benchmark.clock(i));
+      Serial.println(",skipped");
+      continue;
+    }
+
+    for (j = 0; j < (sizeof(sizes) / sizeof(sizes[0])); j++) {
+      measure(sizes[j]);
+    }
+  }
+
+  Benchmark.setClock(F_CPU);
+
+  Serial.println("DMA,done");
+}
+
+void loop()
+{
+}
@@ -0,0 +1,247 @@
+/*
+  MixerLoad
+
+  Ramps the number of synthetic voices (wavetable oscillators) fed into
+  the I2S mixer, and measures the CPU load and the deadline misses (SAI
+  underruns) for each step, at every sample rate and "CPU Speed" setting.
+  With "BENCH.WAV" (any WAV or raw PCM file of at least a few MB) on the
+  board's file system, each run is repeated with that file streamed from
+  SD through I2SPlayer as an additional voice. No codec needs to be
+  connected. Results are printed over Serial, one line per step
+
+    MIXER,clock=<hz>,rate=<hz>,sd=<on|off>,voices=<n>,cpu=<n.n>%,misses=<n>
+
+  and a summary per sample rate, where "per_voice" is the CPU share of a
+  voice, "threshold" the first voice count that missed a deadline (0 if
+  none did up to I2S_MIXER_VOICE_COUNT), and "capacity" the voice count
+  the CPU would be saturated at:
+
+    MIXER,clock=<hz>,rate=<hz>,sd=<on|off>,per_voice=<n.nn>%,threshold=<n>,capacity=<n>
+
+  Clocks the core refuses to switch to (USB below 16MHz) are reported as
+  "skipped", sample rates the SAI cannot be started with as "failed".
+
+  This example code is in the public domain.
+*/
+
+#include <Benchmark.h>
+#include <FS.h>
+#include <I2S.h>
+#include <I2SMixer.h>
+#include <I2SPlayer.h>
+
+#define PATH   "BENCH.WAV"
+#define WINDOW 200 // milliseconds per step
+#define SETTLE 20  // milliseconds before each step
+
+static const uint32_t rates[] = { 8000, 16000, 22050, 32000, 44100, 48000, 96000 };
+
+struct Voice {
+  uint32_t phase;
+  uint32_t increment;
+};
+
+static Voice voices[I2S_MIXER_VOICE_COUNT];
+static int16_t wavetable[256];
+static int16_t scratch[2 * 256];
+
+static uint32_t playerBuffer[16 * 512 / 4];
+
+I2SMixerClass mixer(I2S);
+I2SPlayerClass player(playerBuffer, sizeof(playerBuffer));
+
+static bool sd = false;
+
+// Called from the SAI interrupt; renders into "scratch", which the mixer
+// consumes before calling the next source.
+static size_t voiceSource(void *context, const int16_t **p_data, size_t frames)
+{
+  Voice *voice = (Voice*)context;
+  size_t i;
+  int16_t sample;
+
+  if (frames > 256) {
+    frames = 256;
+  }
+
+  for (i = 0; i < frames; i++) {
+    sample = wavetable[voice->phase >> 24];
+    voice->phase += voice->increment;
+
+    scratch[2 * i + 0] = sample;
+    scratch[2 * i + 1] = sample;
+  }
+
+  *p_data = scratch;
+
+  return frames;
+}
+
+static bool windowDone(void *context)
+{
+  return (millis() - *(uint32_t*)context) >= WINDOW;
+}
+
+// Returns false if I2S (or the player) could not be started.
+static bool step(uint32_t rate, bool stream, unsigned int count, float *p_load, uint32_t *p_misses)
+{
+  uint32_t cycles, stolen, underruns, stamp;
+  unsigned int i;
+  int id[I2S_MIXER_VOICE_COUNT];
+
+  if (!I2S.begin(I2S_PHILIPS_MODE, rate, 16)) {
+    return false;
+  }
+
+  if (!mixer.begin()) {
+    I2S.end();
+    return false;
+  }
+
+  if (stream && !player.begin(mixer, PATH)) {
+    mixer.end();
+    I2S.end();
+    return false;
+  }
+
+  for (i = 0; i < count; i++) {
+    voices[i].phase = 0;
+    voices[i].increment = (uint32_t)(((uint64_t)(220 + 55 * i) << 32) / rate);
+
+    id[i] = mixer.attach(voiceSource, &voices[i]);
+
+    if (id[i] >= 0) {
+      mixer.setGain(id[i], 1.0f / I2S_MIXER_VOICE_COUNT);
+    }
+  }
+
+  delay(SETTLE);
+
+  underruns = I2S.underruns();
+  stamp = millis();
+
+  cycles = Benchmark.wait(windowDone, &stamp, &stolen);
+
+  *p_misses = I2S.underruns() - underruns;
+  *p_load = (float)stolen * 100.0f / (float)cycles;
+
+  for (i = 0; i < count; i++) {
+    if (id[i] >= 0) {
+      mixer.detach(id[i]);
+    }
+  }
+
+  if (stream) {
+    player.end();
+  }
+
+  mixer.end();
+  I2S.end();
+
+  return true;
+}
+
+static void prefix(uint32_t rate, bool stream)
+{
+  Serial.print("MIXER,clock=");
+  Serial.print(SystemCoreClock);
+  Serial.print(",rate=");
+  Serial.print(rate);
+  Serial.print(",sd=");
+  Serial.print(stream ? "on" : "off");
+}
+
+static void ramp(uint32_t rate, bool stream)
+{
+  unsigned int count, limit, threshold, good;
+  uint32_t misses;
+  float load, base, last, perVoice;
+
+  // The streamed file takes one of the mixer's voices.
+  limit = stream ? (I2S_MIXER_VOICE_COUNT - 1) : I2S_MIXER_VOICE_COUNT;
+
+  base = 0.0f;
+  last = 0.0f;
+  good = 0;
+  threshold = 0;
+
+  for (count = 0; count <= limit; count++) {
+    if (!step(rate, stream, count, &load, &misses)) {
+      prefix(rate, stream);
+      Serial.println(",failed");
+      return;
+    }
+
+    prefix(rate, stream);
+    Serial.print(",voices=");
+    Serial.print(count);
+    Serial.print(",cpu=");
+    Serial.print(load, 1);
+    Serial.print("%,misses=");
+    Serial.println(misses);
+
+    if (misses) {
+      threshold = count;
+      break;
+    }
+
+    if (count == 0) {
+      base = load;
+    }
+
+    last = load;
+    good = count;
+  }
+
+  perVoice = good ? ((last - base) / good) : 0.0f;
+
+  prefix(rate, stream);
+  Serial.print(",per_voice=");
+  Serial.print(perVoice, 2);
+  Serial.print("%,threshold=");
+  Serial.print(threshold);
+  Serial.print(",capacity=");
+  Serial.println((perVoice > 0.0f) ? (unsigned int)((100.0f - base) / perVoice) : 0);
+}
+
+void setup()
+{
+  unsigned int i, j;
+
+  Serial.begin(9600);
+
+  while (!Serial) { }
+
+  for (i = 0; i < 256; i++) {
+    wavetable[i] = (int16_t)(32767.0f * sinf((float)i * (2.0f * (float)M_PI / 256.0f)));
+  }
+
+  sd = DOSFS.begin() && DOSFS.exists(PATH);
+
+  Benchmark.begin();
+
+  for (i = 0; Benchmark.clock(i); i++) {
+    if (!Benchmark.setClock(Benchmark.clock(i))) {
+      Serial.print("MIXER,clock=");
+      Serial.print(Benchmark.clock(i));
+      Serial.println(",skipped");
+      continue;
+    }
+
+    for (j = 0; j < (sizeof(rates) / sizeof(rates[0])); j++) {
+      ramp(rates[j], false);
+
+      if (sd) {
+        ramp(rates[j], true);
+      }
+    }
+  }
+
+  Benchmark.setClock(F_CPU);
+
+  Serial.println("MIXER,done");
+}
+
+void loop()
+{
+}
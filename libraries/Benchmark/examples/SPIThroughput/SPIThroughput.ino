@@ -0,0 +1,120 @@
+/*
+  SPIThroughput
+
+  Measures the bandwidth and CPU load of 4096 byte SPI transfers, polled
+  (SPI.setDMAThreshold(0)) and DMA based (asynchronous SPI.transfer() with
+  Benchmark.wait()), for a range of SPI clocks at every "CPU Speed" setting.
+  Nothing needs to be connected to the SPI pins. Results are printed once
+  over Serial, as
+
+    SPI,clock=<hz>,spi=<hz>,mode=<polled|dma>,bytes=<n>,bytes_per_s=<n>,cpu=<n.n>%
+
+  Clocks the core refuses to switch to (USB below 16MHz) are reported as
+  "skipped".
+
+  This example code is in the public domain.
+*/
+
+#include <Benchmark.h>
+#include <SPI.h>
+
+#define SIZE 4096
+
+static uint8_t tx[SIZE];
+static uint8_t rx[SIZE];
+
+static const uint32_t speeds[] = { 1000000, 4000000, 8000000, 20000000, 40000000 };
+
+static bool spiDone(void *context)
+{
+  return SPI.done();
+}
+
+static void report(uint32_t speed, const char *mode, uint32_t cycles, uint32_t busy)
+{
+  Serial.print("SPI,clock=");
+  Serial.print(SystemCoreClock);
+  Serial.print(",spi=");
+  Serial.print(speed);
+  Serial.print(",mode=");
+  Serial.print(mode);
+  Serial.print(",bytes=");
+  Serial.print(SIZE);
+  Serial.print(",bytes_per_s=");
+  Serial.print((uint32_t)(((uint64_t)SIZE * SystemCoreClock) / cycles));
+  Serial.print(",cpu=");
+  Serial.print((float)busy * 100.0f / (float)cycles, 1);
+  Serial.println("%");
+}
+
+static void measure(uint32_t speed)
+{
+  uint32_t start, issue, cycles, stolen;
+
+  // Polled, the CPU is busy for the whole transfer.
+  SPI.setDMAThreshold(0);
+  SPI.beginTransaction(SPISettings(speed, MSBFIRST, SPI_MODE0));
+
+  start = Benchmark.cycles();
+  SPI.transfer(tx, rx, SIZE);
+  cycles = Benchmark.cycles() - start;
+
+  SPI.endTransaction();
+
+  report(speed, "polled", cycles, cycles);
+
+  // Asynchronous DMA, the CPU is busy setting up the transfer and in the
+  // completion interrupt.
+  SPI.setDMAThreshold(SPI_DMA_THRESHOLD);
+  SPI.beginTransaction(SPISettings(speed, MSBFIRST, SPI_MODE0));
+
+  start = Benchmark.cycles();
+  SPI.transfer(tx, rx, SIZE, NULL);
+  issue = Benchmark.cycles() - start;
+
+  cycles = issue + Benchmark.wait(spiDone, NULL, &stolen);
+
+  SPI.endTransaction();
+
+  report(speed, "dma", cycles, issue + stolen);
+}
+
+void setup()
+{
+  unsigned int i, j;
+
+  Serial.begin(9600);
+
+  while (!Serial) { }
+
+  for (i = 0; i < SIZE; i++) {
+    tx[i] = i;
+  }
+
+  SPI.begin();
+
+  Benchmark.begin();
+
+  for (i = 0; Benchmark.clock(i); i++) {
+    if (!Benchmark.setClock(Benchmark.clock(i))) {
+      Serial.print("SPI,clock=");
+      Serial.print(Benchmark.clock(i));
+      Serial.println(",skipped");
+      continue;
+    }
+
+    for (j = 0; j < (sizeof(speeds) / sizeof(speeds[0])); j++) {
+      measure(speeds[j]);
+    }
+  }
+
+  Benchmark.setClock(F_CPU);
+
+  SPI.end();
+
+  Serial.println("SPI,done");
+}
+
+void loop()
+{
+}
@@ -0,0 +1,98 @@
+/*
+  UartThroughput
+
+  Measures the bandwidth and CPU load of an asynchronous 1024 byte
+  Serial1.write() at a range of baud rates, at every "CPU Speed" setting.
+  Nothing needs to be connected to the TX pin. Results are printed once
+  over Serial, as
+
+    UART,clock=<hz>,baud=<n>,bytes=<n>,bytes_per_s=<n>,efficiency=<n.n>%,cpu=<n.n>%
+
+  where "efficiency" is the achieved rate over baud/10 (8N1 framing).
+  Clocks the core refuses to switch to (USB below 16MHz) are reported as
+  "skipped".
+
+  This example code is in the public domain.
+*/
+
+#include <Benchmark.h>
+
+#define SIZE 1024
+
+static uint8_t data[SIZE];
+
+static const uint32_t bauds[] = { 9600, 115200, 460800, 921600, 2000000 };
+
+static bool uartDone(void *context)
+{
+  return Serial1.done();
+}
+
+static void measure(uint32_t baud)
+{
+  uint32_t start, issue, cycles, stolen, rate;
+
+  Serial1.begin(baud);
+
+  start = Benchmark.cycles();
+  Serial1.write(data, SIZE, NULL);
+  issue = Benchmark.cycles() - start;
+
+  cycles = issue + Benchmark.wait(uartDone, NULL, &stolen);
+
+  // done() turns true once the last byte is in the shift register.
+  Serial1.flush();
+  Serial1.end();
+
+  rate = (uint32_t)(((uint64_t)SIZE * SystemCoreClock) / cycles);
+
+  Serial.print("UART,clock=");
+  Serial.print(SystemCoreClock);
+  Serial.print(",baud=");
+  Serial.print(baud);
+  Serial.print(",bytes=");
+  Serial.print(SIZE);
+  Serial.print(",bytes_per_s=");
+  Serial.print(rate);
+  Serial.print(",efficiency=");
+  Serial.print((float)rate * 1000.0f / (float)baud, 1);
+  Serial.print("%,cpu=");
+  Serial.print((float)(issue + stolen) * 100.0f / (float)cycles, 1);
+  Serial.println("%");
+}
+
+void setup()
+{
+  unsigned int i, j;
+
+  Serial.begin(9600);
+
+  while (!Serial) { }
+
+  for (i = 0; i < SIZE; i++) {
+    data[i] = 0x55;
+  }
+
+  Benchmark.begin();
+
+  for (i = 0; Benchmark.clock(i); i++) {
+    if (!Benchmark.setClock(Benchmark.clock(i))) {
+      Serial.print("UART,clock=");
+      Serial.print(Benchmark.clock(i));
+      Serial.println(",skipped");
+      continue;
+    }
+
+    for (j = 0; j < (sizeof(bauds) / sizeof(bauds[0])); j++) {
+      measure(bauds[j]);
+    }
+  }
+
+  Benchmark.setClock(F_CPU);
+
+  Serial.println("UART,done");
+}
+
+void loop()
+{
+}
@@ -0,0 +1,110 @@
+/*
+  WireThroughput
+
+  Measures the bandwidth and CPU load of an asynchronous 256 byte read
+  (register address 0x00 first) from an I2C device, at 100kHz, 400kHz and
+  1MHz, at every "CPU Speed" setting. Any device that answers sequential
+  reads will do, like a 24C32 EEPROM at the default ADDRESS. Results are
+  printed once over Serial, as
+
+    I2C,clock=<hz>,i2c=<hz>,bytes=<n>,bytes_per_s=<n>,efficiency=<n.n>%,cpu=<n.n>%
+
+  where "efficiency" is the achieved rate over i2c/9 (8 bits plus ACK).
+  A failed transfer is reported with the Wire status instead. Clocks the
+  core refuses to switch to (USB below 16MHz) are reported as "skipped".
+
+  This example code is in the public domain.
+*/
+
+#include <Benchmark.h>
+#include <Wire.h>
+
+#define ADDRESS 0x50
+#define SIZE    256
+
+static const uint8_t reg[2] = { 0x00, 0x00 };
+static uint8_t data[SIZE];
+
+static const uint32_t speeds[] = { 100000, 400000, 1000000 };
+
+static bool wireDone(void *context)
+{
+  return Wire.done();
+}
+
+static void measure(uint32_t speed)
+{
+  uint32_t start, issue, cycles, stolen, rate;
+
+  Wire.setClock(speed);
+
+  Serial.print("I2C,clock=");
+  Serial.print(SystemCoreClock);
+  Serial.print(",i2c=");
+  Serial.print(speed);
+
+  start = Benchmark.cycles();
+
+  if (!Wire.transfer(ADDRESS, reg, sizeof(reg), data, SIZE, true, NULL)) {
+    Serial.println(",failed");
+    return;
+  }
+
+  issue = Benchmark.cycles() - start;
+
+  cycles = issue + Benchmark.wait(wireDone, NULL, &stolen);
+
+  if (Wire.status() != 0) {
+    Serial.print(",status=");
+    Serial.println(Wire.status());
+    return;
+  }
+
+  rate = (uint32_t)(((uint64_t)SIZE * SystemCoreClock) / cycles);
+
+  Serial.print(",bytes=");
+  Serial.print(SIZE);
+  Serial.print(",bytes_per_s=");
+  Serial.print(rate);
+  Serial.print(",efficiency=");
+  Serial.print((float)rate * 900.0f / (float)speed, 1);
+  Serial.print("%,cpu=");
+  Serial.print((float)(issue + stolen) * 100.0f / (float)cycles, 1);
+  Serial.println("%");
+}
+
+void setup()
+{
+  unsigned int i, j;
+
+  Serial.begin(9600);
+
+  while (!Serial) { }
+
+  Wire.begin();
+
+  Benchmark.begin();
+
+  for (i = 0; Benchmark.clock(i); i++) {
+    if (!Benchmark.setClock(Benchmark.clock(i))) {
+      Serial.print("I2C,clock=");
+      Serial.print(Benchmark.clock(i));
+      Serial.println(",skipped");
+      continue;
+    }
+
+    for (j = 0; j < (sizeof(speeds) / sizeof(speeds[0])); j++) {
+      measure(speeds[j]);
+    }
+  }
+
+  Benchmark.setClock(F_CPU);
+
+  Wire.end();
+
+  Serial.println("I2C,done");
+}
+
+void loop()
+{
+}
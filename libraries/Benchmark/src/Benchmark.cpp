@@ -0,0 +1,293 @@
+/*
+ * Copyright (c) 2017 Thomas Roell.  All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal with the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ *  1. Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimers.
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimers in the
+ *     documentation and/or other materials provided with the distribution.
+ *  3. Neither the name of Thomas Roell, nor the names of its contributors
+ *     may be used to endorse or promote products derived from this Software
+ *     without specific prior written permission.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ * CONTRIBUTORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * WITH THE SOFTWARE.
+ */
+
+#include "Benchmark.h"
+
+static const uint32_t _benchmarkClocks[BENCHMARK_CLOCK_COUNT] = {
+    80000000, 72000000, 64000000, 48000000, 32000000, 24000000, 16000000, 8000000, 4000000, 2000000, 1000000,
+};
+
+BenchmarkClass::BenchmarkClass()
+{
+    _count = 0;
+    _overhead = 0;
+}
+
+void BenchmarkClass::begin()
+{
+    CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+    DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+
+    calibrate();
+}
+
+void BenchmarkClass::calibrate()
+{
+    unsigned int index;
+    uint32_t cycles;
+
+    // The cost of reading CYCCNT twice and of the indirect call, as seen
+    // by an empty function. It's subtracted from every sample.
+    _overhead = 0xffffffff;
+
+    for (index = 0; index < 16; index++) {
+	cycles = measure(_empty, NULL, BENCHMARK_OPTION_IRQ_MASKED);
+
+	if (_overhead > cycles) {
+	    _overhead = cycles;
+	}
+    }
+}
+
+int BenchmarkClass::add(const char *name, void (*function)(void *context), void *context, uint32_t bytes, uint32_t options)
+{
+    if (_count == BENCHMARK_COUNT) {
+	return -1;
+    }
+
+    _entries[_count].name = name;
+    _entries[_count].function = function;
+    _entries[_count].context = context;
+    _entries[_count].bytes = bytes;
+    _entries[_count].options = options;
+
+    return _count++;
+}
+
+bool BenchmarkClass::run(int id, BenchmarkResult &result, unsigned int iterations, unsigned int warmup)
+{
+    const Entry *entry;
+    unsigned int index, slot;
+    uint32_t cycles;
+
+    if ((id < 0) || ((unsigned int)id >= _count) || (iterations == 0)) {
+	return false;
+    }
+
+    if (iterations > BENCHMARK_SAMPLE_COUNT) {
+	iterations = BENCHMARK_SAMPLE_COUNT;
+    }
+
+    entry = &_entries[id];
+
+    for (index = 0; index < warmup; index++) {
+	(*entry->function)(entry->context);
+    }
+
+    result.name = entry->name;
+    result.iterations = iterations;
+    result.bytes = entry->bytes;
+    result.total = 0;
+
+    // Insertion sort while sampling; the samples tend to be nearly ordered
+    // already, so this is close to linear.
+    for (index = 0; index < iterations; index++) {
+	cycles = measure(entry->function, entry->context, entry->options);
+
+	cycles = (cycles > _overhead) ? (cycles - _overhead) : 0;
+
+	result.total += cycles;
+
+	for (slot = index; (slot != 0) && (_samples[slot -1] > cycles); slot--) {
+	    _samples[slot] = _samples[slot -1];
+	}
+
+	_samples[slot] = cycles;
+    }
+
+    result.min = _samples[0];
+    result.max = _samples[iterations -1];
+
+    if (iterations & 1) {
+	result.median = _samples[iterations / 2];
+    } else {
+	result.median = (_samples[iterations / 2 -1] + _samples[iterations / 2] +1) / 2;
+    }
+
+    // Nearest rank, i.e. the smallest sample not exceeded by 99% of all.
+    result.p99 = _samples[(iterations * 99 + 99) / 100 -1];
+
+    return true;
+}
+
+void BenchmarkClass::runAll(Print &out, unsigned int iterations, unsigned int warmup, unsigned int format)
+{
+    BenchmarkResult result;
+    unsigned int index;
+
+    header(out, format);
+
+    for (index = 0; index < _count; index++) {
+	if (run(index, result, iterations, warmup)) {
+	    report(out, result, format);
+	}
+    }
+}
+
+void BenchmarkClass::header(Print &out, unsigned int format)
+{
+    if (format == BENCHMARK_FORMAT_CSV) {
+	out.println("BENCHMARK,name,iterations,bytes,min,median,p99,max,mean,bytes_per_cycle");
+    }
+}
+
+void BenchmarkClass::report(Print &out, const BenchmarkResult &result, unsigned int format)
+{
+    uint32_t mean;
+    float throughput;
+
+    mean = result.iterations ? (uint32_t)(result.total / result.iterations) : 0;
+    throughput = result.median ? ((float)result.bytes / (float)result.median) : 0.0f;
+
+    if (format == BENCHMARK_FORMAT_JSON) {
+	out.print("{\"benchmark\":\"");
+	out.print(result.name);
+	out.print("\",\"iterations\":");
+	out.print(result.iterations);
+	out.print(",\"bytes\":");
+	out.print(result.bytes);
+	out.print(",\"min\":");
+	out.print(result.min);
+	out.print(",\"median\":");
+	out.print(result.median);
+	out.print(",\"p99\":");
+	out.print(result.p99);
+	out.print(",\"max\":");
+	out.print(result.max);
+	out.print(",\"mean\":");
+	out.print(mean);
+	out.print(",\"bytes_per_cycle\":");
+	out.print(throughput, 3);
+	out.println("}");
+    } else {
+	out.print("BENCHMARK,");
+	out.print(result.name);
+	out.print(",");
+	out.print(result.iterations);
+	out.print(",");
+	out.print(result.bytes);
+	out.print(",");
+	out.print(result.min);
+	out.print(",");
+	out.print(result.median);
+	out.print(",");
+	out.print(result.p99);
+	out.print(",");
+	out.print(result.max);
+	out.print(",");
+	out.print(mean);
+	out.print(",");
+	out.println(throughput, 3);
+    }
+}
+
+bool BenchmarkClass::setClock(uint32_t hclk)
+{
+    if (!STM32.clockGovernor(0, hclk)) {
+	return false;
+    }
+
+    calibrate();
+
+    return true;
+}
+
+uint32_t BenchmarkClass::clock(unsigned int index)
+{
+    return (index < BENCHMARK_CLOCK_COUNT) ? _benchmarkClocks[index] : 0;
+}
+
+uint32_t BenchmarkClass::wait(bool (*done)(void *context), void *context, uint32_t *p_stolen)
+{
+    uint32_t start, last, now, delta, shortest, iterations;
+    bool complete;
+
+    // Every pass through the loop takes the same number of cycles, unless
+    // something else got the CPU or the bus in between. So the shortest pass
+    // times the number of passes is the time the loop itself needed.
+    shortest = 0xffffffff;
+    iterations = 0;
+
+    start = last = DWT->CYCCNT;
+
+    do {
+	complete = (*done)(context);
+
+	now = DWT->CYCCNT;
+	delta = now - last;
+	last = now;
+
+	if (shortest > delta) {
+	    shortest = delta;
+	}
+
+	iterations++;
+    } while (!complete);
+
+    if (p_stolen) {
+	*p_stolen = ((last - start) > (iterations * shortest)) ? ((last - start) - (iterations * shortest)) : 0;
+    }
+
+    return last - start;
+}
+
+uint32_t BenchmarkClass::measure(void (*function)(void *context), void *context, uint32_t options)
+{
+    uint32_t primask, flash_acr, start, cycles;
+
+    primask = __get_PRIMASK();
+
+    if (options & BENCHMARK_OPTION_IRQ_MASKED) {
+	__disable_irq();
+    }
+
+    if (options & BENCHMARK_OPTION_CACHE_FLUSH) {
+	flash_acr = FLASH->ACR;
+
+	FLASH->ACR = flash_acr & ~(FLASH_ACR_ICEN | FLASH_ACR_DCEN);
+	FLASH->ACR = (flash_acr & ~(FLASH_ACR_ICEN | FLASH_ACR_DCEN)) | (FLASH_ACR_ICRST | FLASH_ACR_DCRST);
+	FLASH->ACR = flash_acr;
+    }
+
+    start = DWT->CYCCNT;
+
+    (*function)(context);
+
+    cycles = DWT->CYCCNT - start;
+
+    __set_PRIMASK(primask);
+
+    return cycles;
+}
+
+void __attribute__((noinline)) BenchmarkClass::_empty(void *context)
+{
+    __asm__ volatile ("" : : : "memory");
+}
+
+BenchmarkClass Benchmark;
@@ -0,0 +1,139 @@
+/*
+ * Copyright (c) 2017 Thomas Roell.  All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal with the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ *  1. Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimers.
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimers in the
+ *     documentation and/or other materials provided with the distribution.
+ *  3. Neither the name of Thomas Roell, nor the names of its contributors
+ *     may be used to endorse or promote products derived from this Software
+ *     without specific prior written permission.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ * CONTRIBUTORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * WITH THE SOFTWARE.
+ */
+
+#ifndef _BENCHMARK_H_INCLUDED
+#define _BENCHMARK_H_INCLUDED
+
+#include <Arduino.h>
+
+// Number of functions that can be registered, and the maximum number of
+// timed iterations per run (one cycle count is kept per iteration).
+#define BENCHMARK_COUNT        16
+#define BENCHMARK_SAMPLE_COUNT 256
+
+#define BENCHMARK_OPTION_IRQ_MASKED  0x00000001  // run each iteration with PRIMASK set
+#define BENCHMARK_OPTION_CACHE_FLUSH 0x00000002  // reset the flash I/D caches before each iteration
+
+#define BENCHMARK_FORMAT_CSV  0
+#define BENCHMARK_FORMAT_JSON 1
+
+// Number of "menu.speed" settings in boards.txt (80MHz down to 1MHz).
+#define BENCHMARK_CLOCK_COUNT 11
+
+// Statistics of one run, in cycles. The call overhead of the harness (see
+// overhead()) has already been subtracted. "bytes" is what was passed to
+// add() and is only used to compute bytes/cycle (against the median).
+struct BenchmarkResult {
+    const char *name;
+    uint32_t   iterations;
+    uint32_t   bytes;
+    uint32_t   min;
+    uint32_t   median;
+    uint32_t   p99;
+    uint32_t   max;
+    uint64_t   total;
+};
+
+// On-target micro-benchmarks based on the DWT cycle counter.
+//
+// add() registers "function(context)" which processes "bytes" bytes per
+// call. run() calls it "warmup" times untimed, then "iterations" times
+// (at most BENCHMARK_SAMPLE_COUNT), timing each call separately, and sorts
+// the samples to get min/median/p99/max. With BENCHMARK_OPTION_IRQ_MASKED
+// interrupts are off for the duration of a call; with
+// BENCHMARK_OPTION_CACHE_FLUSH the ART instruction and data caches are
+// reset in front of each call, so flash wait states show up as a cold
+// start would see them.
+//
+// report() prints one result to any Print (Serial, SerialUSB, ...),
+// either as CSV (header() prints the matching header line)
+//
+//   BENCHMARK,name,iterations,bytes,min,median,p99,max,mean,bytes_per_cycle
+//   BENCHMARK,<name>,<n>,<n>,<cycles>,<cycles>,<cycles>,<cycles>,<cycles>,<n.nnn>
+//
+// or as one JSON object per line:
+//
+//   {"benchmark":"<name>","iterations":<n>,"bytes":<n>,"min":<cycles>,...,"bytes_per_cycle":<n.nnn>}
+//
+// For peripheral throughput, setClock() steps through the "menu.speed"
+// settings at runtime (clock(index) returns the index-th one, fastest
+// first), and wait() spins on a completion check (e.g. SPI.done()) while
+// accounting the cycles taken away from it by interrupt handlers and bus
+// contention. Those "stolen" cycles over the elapsed ones are the CPU load
+// of an asynchronous operation.
+class BenchmarkClass
+{
+public:
+    BenchmarkClass();
+
+    void begin();
+
+    int add(const char *name, void (*function)(void *context), void *context = NULL, uint32_t bytes = 0, uint32_t options = 0);
+
+    bool run(int id, BenchmarkResult &result, unsigned int iterations = 100, unsigned int warmup = 8);
+    void runAll(Print &out, unsigned int iterations = 100, unsigned int warmup = 8, unsigned int format = BENCHMARK_FORMAT_CSV);
+
+    void header(Print &out, unsigned int format = BENCHMARK_FORMAT_CSV);
+    void report(Print &out, const BenchmarkResult &result, unsigned int format = BENCHMARK_FORMAT_CSV);
+
+    uint32_t overhead() { return _overhead; }
+
+    // Switches the system clock, and recalibrates overhead() for the new flash
+    // wait states. Fails if the clock change was refused (USB below 16MHz).
+    bool setClock(uint32_t hclk);
+    static uint32_t clock(unsigned int index);
+
+    // Returns the cycles till "done(context)" returned true, "*p_stolen" is set
+    // to the part of them not spent in the loop itself.
+    uint32_t wait(bool (*done)(void *context), void *context, uint32_t *p_stolen);
+
+    static inline uint32_t cycles() { return DWT->CYCCNT; }
+
+private:
+    struct Entry {
+	const char *name;
+	void       (*function)(void *context);
+	void       *context;
+	uint32_t   bytes;
+	uint32_t   options;
+    };
+
+    Entry _entries[BENCHMARK_COUNT];
+    unsigned int _count;
+    uint32_t _overhead;
+    uint32_t _samples[BENCHMARK_SAMPLE_COUNT];
+
+    void calibrate();
+
+    static uint32_t measure(void (*function)(void *context), void *context, uint32_t options);
+    static void _empty(void *context);
+};
+
+extern BenchmarkClass Benchmark;
+
+#endif // _BENCHMARK_H_INCLUDED
@@ -0,0 +1,52 @@
+/*
+  Buttons
+
+  Debounces two push buttons between pins 4 and 5 and GND, using the
+  internal pullups. Every press, release, hold (after 1 second) and chord
+  (both buttons down) is printed over Serial as a line starting with
+  "BUTTON,". loop() sleeps until the Buttons library posts an event.
+
+  This example code is in the public domain.
+*/
+
+#include <Buttons.h>
+
+int left, right;
+
+void setup()
+{
+  Serial.begin(9600);
+
+  while (!Serial) { }
+
+  left = Buttons.add(4, BUTTON_ACTIVE_LOW, 20, 1000);
+  right = Buttons.add(5, BUTTON_ACTIVE_LOW, 20, 1000);
+
+  Buttons.begin();
+
+  loopMode(LOOP_MODE_SLEEP, 0);
+}
+
+void loop()
+{
+  static const char * const names[] = { "", "press", "release", "hold", "chord" };
+  ButtonEvent event;
+
+  while (Buttons.read(event)) {
+    Serial.print("BUTTON,");
+    Serial.print(names[event.type]);
+    Serial.print(",button=");
+    Serial.print((event.button == left) ? "left" : "right");
+    Serial.print(",mask=0x");
+    Serial.print(event.mask, HEX);
+    Serial.print(",time=");
+    Serial.print(event.timestamp);
+    Serial.print(",duration=");
+    Serial.println(event.duration);
+  }
+
+  if (Buttons.dropped()) {
+    Serial.print("BUTTON,dropped=");
+    Serial.println(Buttons.dropped());
+  }
+}
@@ -0,0 +1,301 @@
+/*
+ * Copyright (c) 2017 Thomas Roell.  All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal with the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ *  1. Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimers.
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimers in the
+ *     documentation and/or other materials provided with the distribution.
+ *  3. Neither the name of Thomas Roell, nor the names of its contributors
+ *     may be used to endorse or promote products derived from this Software
+ *     without specific prior written permission.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ * CONTRIBUTORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * WITH THE SOFTWARE.
+ */
+
+#include "Arduino.h"
+#include "stm32l4_wiring_private.h"
+#include "Buttons.h"
+
+#define BUTTON_STATE_IDLE     0
+#define BUTTON_STATE_DEBOUNCE 1   // EXTI line masked, timer runs the debounce window
+#define BUTTON_STATE_HOLD     2   // EXTI line active, timer runs the hold delay
+
+// Priority ceiling of the button state, which the EXTI edge handler updates.
+#define BUTTON_CRITICAL_PRIORITY STM32L4_EXTI_IRQ_PRIORITY
+
+ButtonsClass::ButtonsClass()
+{
+    _count = 0;
+    _active = false;
+    _pressed = 0;
+    _dropped = 0;
+    _eventCallback = NULL;
+}
+
+int ButtonsClass::add(uint32_t pin, uint32_t mode, unsigned int debounce, unsigned int hold)
+{
+    Button *button;
+    uint32_t line;
+    unsigned int index;
+
+    if (_active || (_count == BUTTONS_COUNT)) {
+	return -1;
+    }
+
+    if ((pin >= PINS_COUNT) || !(g_APinDescription[pin].attr & PIN_ATTR_EXTI)) {
+	return -1;
+    }
+
+    if ((debounce == 0) || (debounce > 65535) || (hold > 65535)) {
+	return -1;
+    }
+
+    line = 1u << ((g_APinDescription[pin].pin & GPIO_PIN_INDEX_MASK) >> GPIO_PIN_INDEX_SHIFT);
+
+    for (index = 0; index < _count; index++) {
+	if (_buttons[index].line == line) {
+	    return -1;
+	}
+    }
+
+    button = &_buttons[_count];
+
+    armv7m_timer_create(&button->timer, ButtonsClass::_timerCallback);
+
+    button->pin = pin;
+    button->mode = mode;
+    button->index = _count;
+    button->state = BUTTON_STATE_IDLE;
+    button->held = 0;
+    button->debounce = debounce;
+    button->hold = hold;
+    button->line = line;
+    button->pressed_at = 0;
+
+    return _count++;
+}
+
+bool ButtonsClass::begin()
+{
+    Button *button;
+    unsigned int index;
+    uint32_t now;
+
+    if (_active || (_count == 0)) {
+	return false;
+    }
+
+    _pressed = 0;
+    _dropped = 0;
+
+    now = millis();
+
+    for (index = 0; index < _count; index++) {
+	button = &_buttons[index];
+
+	if (button->mode & BUTTON_EXTERNAL_PULL) {
+	    pinMode(button->pin, INPUT);
+	} else {
+	    pinMode(button->pin, (button->mode & BUTTON_ACTIVE_HIGH) ? INPUT_PULLDOWN : INPUT_PULLUP);
+	}
+
+	// A button that is already down when begin() is called gets its
+	// RELEASE, but no PRESS or HOLD.
+	button->state = BUTTON_STATE_IDLE;
+	button->held = 1;
+	button->pressed_at = now;
+
+	if (level(button)) {
+	    _pressed |= (1u << index);
+	}
+
+	stm32l4_exti_notify(&stm32l4_exti, g_APinDescription[button->pin].pin, EXTI_CONTROL_BOTH_EDGES, ButtonsClass::_extiCallback, (void*)button);
+    }
+
+    _active = true;
+
+    return true;
+}
+
+void ButtonsClass::end()
+{
+    Button *button;
+    unsigned int index;
+
+    if (!_active) {
+	return;
+    }
+
+    for (index = 0; index < _count; index++) {
+	button = &_buttons[index];
+
+	stm32l4_exti_notify(&stm32l4_exti, g_APinDescription[button->pin].pin, EXTI_CONTROL_DISABLE, NULL, NULL);
+
+	armv7m_timer_stop(&button->timer);
+
+	stm32l4_exti_resume(&stm32l4_exti, button->line);
+
+	button->state = BUTTON_STATE_IDLE;
+    }
+
+    _active = false;
+}
+
+int ButtonsClass::available()
+{
+    return _queue.count();
+}
+
+bool ButtonsClass::read(ButtonEvent &event)
+{
+    return _queue.pop(event);
+}
+
+void ButtonsClass::onEvent(void(*callback)(void))
+{
+    _eventCallback = callback;
+}
+
+bool ButtonsClass::level(const Button *button)
+{
+    return (!!stm32l4_gpio_pin_read(g_APinDescription[button->pin].pin) == !!(button->mode & BUTTON_ACTIVE_HIGH));
+}
+
+void ButtonsClass::post(uint8_t type, const Button *button, uint32_t mask, uint32_t now)
+{
+    ButtonEvent event;
+
+    event.timestamp = now;
+    event.duration = (type == BUTTON_EVENT_PRESS || type == BUTTON_EVENT_CHORD) ? 0 : (now - button->pressed_at);
+    event.type = type;
+    event.button = button->index;
+    event.mask = mask;
+
+    if (!_queue.push(event)) {
+	armv7m_atomic_add(&_dropped, 1);
+    }
+}
+
+// EXTI interrupt. The line stays masked until the debounce window is over,
+// so the remaining bounces do not interrupt at all.
+void ButtonsClass::edge(Button *button)
+{
+    stm32l4_exti_suspend(&stm32l4_exti, button->line);
+
+    button->state = BUTTON_STATE_DEBOUNCE;
+
+    armv7m_timer_start(&button->timer, button->debounce);
+}
+
+// Timer callback, for the end of a debounce window or a hold delay.
+void ButtonsClass::expire(Button *button)
+{
+    uint32_t basepri, mask, now, elapsed;
+    bool pressed, changed;
+
+    now = millis();
+    mask = 1u << button->index;
+
+    if (button->state == BUTTON_STATE_HOLD) {
+	// An edge may have restarted the timer as debounce window in the
+	// meantime, in which case the call on its expiry takes over.
+	basepri = armv7m_critical_enter(BUTTON_CRITICAL_PRIORITY);
+
+	if (button->state != BUTTON_STATE_HOLD) {
+	    armv7m_critical_leave(basepri);
+
+	    return;
+	}
+
+	button->state = BUTTON_STATE_IDLE;
+	button->held = 1;
+
+	armv7m_critical_leave(basepri);
+
+	post(BUTTON_EVENT_HOLD, button, _pressed, now);
+    } else if (button->state == BUTTON_STATE_DEBOUNCE) {
+	pressed = level(button);
+	changed = (pressed != !!(_pressed & mask));
+
+	if (changed) {
+	    if (pressed) {
+		armv7m_atomic_or(&_pressed, mask);
+
+		button->pressed_at = now;
+		button->held = 0;
+
+		post(BUTTON_EVENT_PRESS, button, _pressed, now);
+
+		if (_pressed & (_pressed - 1)) {
+		    post(BUTTON_EVENT_CHORD, button, _pressed, now);
+		}
+	    } else {
+		armv7m_atomic_and(&_pressed, ~mask);
+
+		post(BUTTON_EVENT_RELEASE, button, _pressed, now);
+	    }
+	}
+
+	// Drop the edges latched while the line was masked, and sample once
+	// more after unmasking, so that a change in between is not lost.
+	basepri = armv7m_critical_enter(BUTTON_CRITICAL_PRIORITY);
+
+	EXTI->PR1 = button->line;
+
+	stm32l4_exti_resume(&stm32l4_exti, button->line);
+
+	if (level(button) != pressed) {
+	    stm32l4_exti_suspend(&stm32l4_exti, button->line);
+
+	    armv7m_timer_start(&button->timer, button->debounce);
+	} else if (pressed && !button->held && button->hold) {
+	    elapsed = now - button->pressed_at;
+
+	    button->state = BUTTON_STATE_HOLD;
+
+	    armv7m_timer_start(&button->timer, (elapsed < button->hold) ? (button->hold - elapsed) : 1);
+	} else {
+	    button->state = BUTTON_STATE_IDLE;
+	}
+
+	armv7m_critical_leave(basepri);
+
+	if (!changed) {
+	    return;
+	}
+    } else {
+	return;
+    }
+
+    if (_eventCallback) {
+	(*_eventCallback)();
+    }
+
+    loopWakeup();
+}
+
+void ButtonsClass::_extiCallback(void *context)
+{
+    Buttons.edge((Button*)context);
+}
+
+void ButtonsClass::_timerCallback(armv7m_timer_t *timer)
+{
+    Buttons.expire((Button*)timer);
+}
+
+ButtonsClass Buttons;
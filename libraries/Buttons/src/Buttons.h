@@ -0,0 +1,129 @@
+/*
+ * Copyright (c) 2017 Thomas Roell.  All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal with the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ *  1. Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimers.
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimers in the
+ *     documentation and/or other materials provided with the distribution.
+ *  3. Neither the name of Thomas Roell, nor the names of its contributors
+ *     may be used to endorse or promote products derived from this Software
+ *     without specific prior written permission.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ * CONTRIBUTORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * WITH THE SOFTWARE.
+ */
+
+#ifndef _BUTTONS_H_INCLUDED
+#define _BUTTONS_H_INCLUDED
+
+#include <Arduino.h>
+#include <Pool.h>
+
+#include "armv7m.h"
+
+// Number of buttons, and number of events the queue holds (a power of 2).
+#define BUTTONS_COUNT        8
+#define BUTTONS_QUEUE_SIZE   16
+
+// add() modes
+#define BUTTON_ACTIVE_LOW    0    // pressed connects to GND, internal pullup
+#define BUTTON_ACTIVE_HIGH   1    // pressed connects to VDD, internal pulldown
+#define BUTTON_EXTERNAL_PULL 2    // or'ed in, no internal pull resistor
+
+#define BUTTON_EVENT_PRESS   1
+#define BUTTON_EVENT_RELEASE 2
+#define BUTTON_EVENT_HOLD    3
+#define BUTTON_EVENT_CHORD   4
+
+struct ButtonEvent {
+    uint32_t timestamp;   // millis() when the new state was accepted
+    uint32_t duration;    // RELEASE and HOLD: milliseconds since the PRESS
+    uint8_t  type;        // BUTTON_EVENT_*
+    uint8_t  button;      // as returned by add()
+    uint16_t mask;        // buttons pressed after this event, for CHORD the chord
+};
+
+// Debouncing of multiple buttons.
+//
+// An edge on a button's EXTI line masks the line via stm32l4_exti_suspend()
+// and starts the button's debounce timer, so that a bouncing contact costs
+// a single interrupt. When the timer fires the pin is sampled; if the level
+// differs from the last accepted one a PRESS or RELEASE is queued. A PRESS
+// that leaves two or more buttons pressed also queues a CHORD with the mask
+// of all pressed buttons. The line is then unmasked, after clearing the edge
+// latched while it was masked, and the pin is sampled once more to catch a
+// change that happened during the window. A button held for "hold"
+// milliseconds queues a HOLD (once per press).
+//
+// Each button sits on its own EXTI line, i.e. two buttons cannot use the
+// same pin number on different ports. Events are read via available() and
+// read(); the onEvent() callback (and loopWakeup()) run from the timer
+// callback after an event was queued. Events that do not fit into the
+// queue are counted by dropped().
+class ButtonsClass
+{
+public:
+    ButtonsClass();
+
+    int add(uint32_t pin, uint32_t mode = BUTTON_ACTIVE_LOW, unsigned int debounce = 20, unsigned int hold = 500);
+
+    bool begin();
+    void end();
+
+    int available();
+    bool read(ButtonEvent &event);
+
+    uint32_t pressed() { return _pressed; }
+    bool pressed(unsigned int button) { return !!(_pressed & (1u << button)); }
+    uint32_t dropped() { return _dropped; }
+
+    void onEvent(void(*callback)(void));
+
+private:
+    struct Button {
+        armv7m_timer_t timer;   // first, _timerCallback() maps it back to the Button
+        uint8_t pin;
+        uint8_t mode;
+        uint8_t index;
+        volatile uint8_t state;
+        uint8_t held;          // HOLD already posted for this press
+        uint16_t debounce;
+        uint16_t hold;
+        uint32_t line;
+        uint32_t pressed_at;
+    };
+
+    Button _buttons[BUTTONS_COUNT];
+    unsigned int _count;
+    bool _active;
+    volatile uint32_t _pressed;
+    volatile uint32_t _dropped;
+    void (*_eventCallback)(void);
+
+    ObjectQueue<ButtonEvent, BUTTONS_QUEUE_SIZE> _queue;
+
+    bool level(const Button *button);
+    void post(uint8_t type, const Button *button, uint32_t mask, uint32_t now);
+    void edge(Button *button);
+    void expire(Button *button);
+
+    static void _extiCallback(void *context);
+    static void _timerCallback(armv7m_timer_t *timer);
+};
+
+extern ButtonsClass Buttons;
+
+#endif // _BUTTONS_H_INCLUDED
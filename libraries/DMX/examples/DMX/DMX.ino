@@ -0,0 +1,39 @@
+/*
+  DMX
+
+  Fades the first 16 channels of a DMX512 universe up and down, with each
+  channel shifted in phase. The universe is sent on Serial1 (via an RS-485
+  transceiver whose driver is enabled permanently) at 44 Hz, independent of
+  what loop() is doing.
+
+  This example code is in the public domain.
+*/
+
+#include <DMX.h>
+
+uint8_t levels[16];
+unsigned int step;
+
+void setup()
+{
+  DMX.begin(Serial1, 16);
+}
+
+void loop()
+{
+  unsigned int i, phase;
+
+  for (i = 0; i < 16; i++) {
+    phase = (step + i * 32) & 511;
+
+    levels[i] = (phase < 256) ? phase : (511 - phase);
+  }
+
+  // All 16 channels change within the same frame.
+  DMX.write(1, levels, 16);
+  DMX.commit();
+
+  step += 4;
+
+  delay(20);
+}
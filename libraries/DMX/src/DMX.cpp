@@ -0,0 +1,204 @@
+/*
+ * Copyright (c) 2017 Thomas Roell.  All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal with the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ *  1. Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimers.
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimers in the
+ *     documentation and/or other materials provided with the distribution.
+ *  3. Neither the name of Thomas Roell, nor the names of its contributors
+ *     may be used to endorse or promote products derived from this Software
+ *     without specific prior written permission.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ * CONTRIBUTORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * WITH THE SOFTWARE.
+ */
+
+#include "Arduino.h"
+#include "stm32l4_wiring_private.h"
+#include "DMX.h"
+
+DMXClass::DMXClass()
+{
+    _back = 0;
+    _pending = false;
+    _busy = false;
+    _late = false;
+    _active = false;
+    _size = 0;
+    _period = 0;
+    _frames = 0;
+    _overruns = 0;
+    _uart = NULL;
+
+    armv7m_timer_create(&_timer, DMXClass::_timerCallback);
+}
+
+bool DMXClass::begin(Uart &uart, unsigned int channels, unsigned int period)
+{
+    if (_active || (channels == 0) || (channels > (DMX_SLOT_COUNT -1)) || (period == 0)) {
+	return false;
+    }
+
+    memset(&_data[0][0], 0, sizeof(_data));
+
+    _back = 0;
+    _pending = false;
+    _busy = false;
+    _late = false;
+    _size = 1 + channels;
+    _period = period;
+    _frames = 0;
+    _overruns = 0;
+    _uart = &uart;
+
+    _uart->begin(DMX_BAUDRATE, SERIAL_8N2);
+
+    _active = true;
+
+    armv7m_timer_start(&_timer, 1);
+
+    return true;
+}
+
+void DMXClass::end()
+{
+    if (!_active) {
+	return;
+    }
+
+    _active = false;
+
+    armv7m_timer_stop(&_timer);
+
+    // A tick may have been queued to PendSV before the timer was stopped.
+    while (_busy || !_uart->done()) {
+	armv7m_core_yield();
+    }
+
+    _uart->end();
+
+    _pending = false;
+}
+
+void DMXClass::write(unsigned int channel, uint8_t value)
+{
+    if ((channel == 0) || (channel >= _size)) {
+	return;
+    }
+
+    wait();
+
+    _data[_back][channel] = value;
+}
+
+void DMXClass::write(unsigned int channel, const uint8_t *values, size_t count)
+{
+    if ((channel == 0) || (channel >= _size)) {
+	return;
+    }
+
+    if (count > (size_t)(_size - channel)) {
+	count = _size - channel;
+    }
+
+    wait();
+
+    memcpy(&_data[_back][channel], values, count);
+}
+
+uint8_t DMXClass::read(unsigned int channel)
+{
+    if ((channel == 0) || (channel >= _size)) {
+	return 0;
+    }
+
+    wait();
+
+    return _data[_back][channel];
+}
+
+void DMXClass::commit()
+{
+    if (_active) {
+	_pending = true;
+    }
+}
+
+void DMXClass::wait()
+{
+    while (_pending) {
+	armv7m_core_yield();
+    }
+}
+
+// Called from PendSV only, so it is never reentered and _back/_busy are
+// consistent with the frame callback.
+void DMXClass::start()
+{
+    unsigned int front;
+
+    if (!_active) {
+	return;
+    }
+
+    if (_pending) {
+	front = _back;
+
+	_back = front ^ 1;
+
+	memcpy(&_data[_back][0], &_data[front][0], _size);
+
+	_pending = false;
+    }
+
+    if (_uart->writeFrame(&_data[_back ^ 1][0], _size, DMX_BREAK_BAUDRATE, DMXClass::_frameCallback)) {
+	_busy = true;
+    } else {
+	_overruns++;
+    }
+}
+
+void DMXClass::_timerCallback(armv7m_timer_t *timer)
+{
+    if (DMX._active) {
+	armv7m_timer_start(&DMX._timer, DMX._period);
+
+	armv7m_pendsv_enqueue(DMXClass::_tickCallback, NULL, 0);
+    }
+}
+
+void DMXClass::_tickCallback(void *context, uint32_t data)
+{
+    if (DMX._busy) {
+	DMX._late = true;
+    } else {
+	DMX.start();
+    }
+}
+
+void DMXClass::_frameCallback(void)
+{
+    DMX._busy = false;
+    DMX._frames++;
+
+    if (DMX._late) {
+	DMX._late = false;
+
+	DMX.start();
+    }
+}
+
+DMXClass DMX;
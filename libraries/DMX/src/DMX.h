@@ -0,0 +1,98 @@
+/*
+ * Copyright (c) 2017 Thomas Roell.  All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal with the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ *  1. Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimers.
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimers in the
+ *     documentation and/or other materials provided with the distribution.
+ *  3. Neither the name of Thomas Roell, nor the names of its contributors
+ *     may be used to endorse or promote products derived from this Software
+ *     without specific prior written permission.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ * CONTRIBUTORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * WITH THE SOFTWARE.
+ */
+
+#ifndef _DMX_H_INCLUDED
+#define _DMX_H_INCLUDED
+
+#include <Arduino.h>
+
+#include "armv7m.h"
+
+// Start code plus 512 slots, line rate, the rate at which the 0x00
+// character that forms break and mark-after-break is sent, and the default
+// refresh period in milliseconds (a full universe takes about 22.8ms).
+#define DMX_SLOT_COUNT     513
+#define DMX_BAUDRATE       250000
+#define DMX_BREAK_BAUDRATE 90000
+#define DMX_DEFAULT_PERIOD 23
+
+// DMX512 output.
+//
+// begin() opens "uart" at 250000 8N2 and sends the start code followed by
+// "channels" slots every "period" milliseconds (or back to back, if a
+// frame takes longer than that). Each frame is sent via Uart::writeFrame(),
+// i.e. the break (about 100us) and mark-after-break (about 22us) are a
+// 0x00 character at DMX_BREAK_BAUDRATE, and the slots go out by DMA where
+// the port has a TX DMA channel.
+//
+// write()/read() work on a back buffer. commit() hands it to the next
+// frame as a whole, so a frame never mixes old and new values; until the
+// commit has been taken (committed()), write() waits.
+class DMXClass
+{
+public:
+    DMXClass();
+
+    bool begin(Uart &uart, unsigned int channels = 512, unsigned int period = DMX_DEFAULT_PERIOD);
+    void end();
+
+    void write(unsigned int channel, uint8_t value);
+    void write(unsigned int channel, const uint8_t *values, size_t count);
+    uint8_t read(unsigned int channel);
+
+    void commit();
+    bool committed() { return !_pending; }
+
+    uint32_t frames() { return _frames; }
+    uint32_t overruns() { return _overruns; }
+
+private:
+    uint8_t _data[2][DMX_SLOT_COUNT];
+    volatile uint8_t _back;
+    volatile bool _pending;
+    volatile bool _busy;
+    volatile bool _late;
+    bool _active;
+    uint16_t _size;
+    uint32_t _period;
+    volatile uint32_t _frames;
+    volatile uint32_t _overruns;
+    Uart *_uart;
+    armv7m_timer_t _timer;
+
+    void start();
+    void wait();
+
+    static void _timerCallback(armv7m_timer_t *timer);
+    static void _tickCallback(void *context, uint32_t data);
+    static void _frameCallback(void);
+};
+
+extern DMXClass DMX;
+
+#endif // _DMX_H_INCLUDED
@@ -0,0 +1,218 @@
+/*
+  DSPBench
+
+  Times the DSP library kernels against straightforward C loops doing the
+  same work, on a block of 256 samples (a typical I2S DMA segment), and
+  checks that both produce the same result. Results are printed once over
+  Serial, in cycles per sample. Lines start with "DSP,".
+
+  This example code is in the public domain.
+*/
+
+#include <DSP.h>
+
+#define BLOCK       256
+#define SAMPLE_RATE 22050.0f
+#define ITERATIONS  8
+
+static float inputF32[BLOCK];
+static float outputF32[BLOCK];
+static float referenceF32[BLOCK];
+
+static int16_t inputQ15[BLOCK];
+static int16_t outputQ15[BLOCK];
+
+static int16_t frames[2 * BLOCK] __attribute__((aligned(4)));
+
+static DSPBiquad<2> biquad;
+static DSPBiquadQ15<2> biquadQ15;
+static DSPFir<32> fir;
+static DSPFirQ15<32> firQ15;
+static DSPEnvelope envelope;
+
+static DSPBiquadCoefficients stages[2];
+static float taps[32];
+static int16_t tapsQ15[32];
+
+// Naive reference implementations
+
+static float naiveState[2][4];
+
+static void naiveBiquad(const float *input, float *output, size_t count)
+{
+  float x, y;
+  size_t n;
+  unsigned int stage;
+
+  for (n = 0; n < count; n++) {
+    x = input[n];
+
+    for (stage = 0; stage < 2; stage++) {
+      float *s = naiveState[stage];
+      const DSPBiquadCoefficients &c = stages[stage];
+
+      y = c.b0 * x + c.b1 * s[0] + c.b2 * s[1] + c.a1 * s[2] + c.a2 * s[3];
+
+      s[1] = s[0];
+      s[0] = x;
+      s[3] = s[2];
+      s[2] = y;
+
+      x = y;
+    }
+
+    output[n] = x;
+  }
+}
+
+static float naiveDelay[32];
+
+static void naiveFir(const float *input, float *output, size_t count)
+{
+  float sum;
+  size_t n;
+  unsigned int tap;
+
+  for (n = 0; n < count; n++) {
+    for (tap = 31; tap > 0; tap--) {
+      naiveDelay[tap] = naiveDelay[tap - 1];
+    }
+    naiveDelay[0] = input[n];
+
+    sum = 0.0f;
+
+    for (tap = 0; tap < 32; tap++) {
+      sum += taps[tap] * naiveDelay[tap];
+    }
+
+    output[n] = sum;
+  }
+}
+
+static float naiveRMS(const float *input, size_t count)
+{
+  float sum = 0.0f;
+  size_t n;
+
+  for (n = 0; n < count; n++) {
+    sum += input[n] * input[n];
+  }
+
+  return sqrtf(sum / count);
+}
+
+static void report(const char *name, uint32_t cycles)
+{
+  Serial.print("DSP,");
+  Serial.print(name);
+  Serial.print(",cycles/sample=");
+  Serial.println((float)cycles / (ITERATIONS * BLOCK), 2);
+}
+
+static void compare(const char *name, const float *a, const float *b)
+{
+  float error = 0.0f;
+  size_t n;
+
+  for (n = 0; n < BLOCK; n++) {
+    if (error < fabsf(a[n] - b[n])) {
+      error = fabsf(a[n] - b[n]);
+    }
+  }
+
+  Serial.print("DSP,");
+  Serial.print(name);
+  Serial.print(",max_error=");
+  Serial.println(error, 6);
+}
+
+#define MEASURE(_name, _code)                      \
+  do {                                             \
+    uint32_t _start = DWT->CYCCNT;                 \
+    for (unsigned int _i = 0; _i < ITERATIONS; _i++) { _code; } \
+    report(_name, DWT->CYCCNT - _start);           \
+  } while (0)
+
+void setup()
+{
+  volatile float rms;
+  size_t n;
+
+  Serial.begin(9600);
+
+  while (!Serial) { }
+
+  CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+  DWT->CYCCNT = 0;
+  DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+
+  // A 440Hz tone with some 50Hz hum, as one channel of an I2S block
+  for (n = 0; n < BLOCK; n++) {
+    inputF32[n] = 0.5f * sinf(2.0f * (float)M_PI * 440.0f * n / SAMPLE_RATE) + 0.25f * sinf(2.0f * (float)M_PI * 50.0f * n / SAMPLE_RATE);
+    inputQ15[n] = (int16_t)(inputF32[n] * 32767.0f);
+
+    frames[2 * n + 0] = inputQ15[n];
+    frames[2 * n + 1] = inputQ15[n];
+  }
+
+  // Hum removal (highpass) followed by a presence boost
+  stages[0] = DSPBiquadCoefficients::highpass(SAMPLE_RATE, 120.0f);
+  stages[1] = DSPBiquadCoefficients::peaking(SAMPLE_RATE, 3000.0f, 1.0f, 3.0f);
+
+  biquad.setStage(0, stages[0]);
+  biquad.setStage(1, stages[1]);
+  biquadQ15.setStage(0, stages[0]);
+  biquadQ15.setStage(1, stages[1]);
+
+  // 32 tap windowed sinc lowpass at 4kHz
+  for (n = 0; n < 32; n++) {
+    float t = (float)n - 15.5f;
+    float w = 0.54f - 0.46f * cosf(2.0f * (float)M_PI * n / 31.0f);
+
+    taps[n] = w * sinf(2.0f * (float)M_PI * 4000.0f / SAMPLE_RATE * t) / ((float)M_PI * t);
+    tapsQ15[n] = (int16_t)(taps[n] * 32767.0f);
+  }
+
+  fir.setCoefficients(taps);
+  firQ15.setCoefficients(tapsQ15);
+
+  envelope.setTime(SAMPLE_RATE, 0.001f, 0.050f);
+
+  MEASURE("biquad2,naive", naiveBiquad(inputF32, referenceF32, BLOCK));
+  MEASURE("biquad2,f32", biquad.process(inputF32, outputF32, BLOCK));
+  MEASURE("biquad2,q15", biquadQ15.process(inputQ15, outputQ15, BLOCK));
+
+  memset(naiveState, 0, sizeof(naiveState));
+  biquad.reset();
+  naiveBiquad(inputF32, referenceF32, BLOCK);
+  biquad.process(inputF32, outputF32, BLOCK);
+  compare("biquad2,f32", outputF32, referenceF32);
+
+  MEASURE("fir32,naive", naiveFir(inputF32, referenceF32, BLOCK));
+  MEASURE("fir32,f32", fir.process(inputF32, outputF32, BLOCK));
+  MEASURE("fir32,q15", firQ15.process(inputQ15, outputQ15, BLOCK));
+
+  memset(naiveDelay, 0, sizeof(naiveDelay));
+  fir.reset();
+  naiveFir(inputF32, referenceF32, BLOCK);
+  fir.process(inputF32, outputF32, BLOCK);
+  compare("fir32,f32", outputF32, referenceF32);
+
+  MEASURE("rms,naive", rms = naiveRMS(inputF32, BLOCK));
+  MEASURE("rms,f32", rms = dspRMS(inputF32, BLOCK));
+  MEASURE("rms,q15", rms = dspRMS(inputQ15, BLOCK));
+
+  MEASURE("envelope,f32", envelope.process(inputF32, outputF32, BLOCK));
+  MEASURE("envelope,q15,stereo", envelope.process(frames, NULL, BLOCK, 2));
+
+  MEASURE("deinterleave,f32", dspDeinterleave(frames, inputF32, referenceF32, BLOCK));
+  MEASURE("interleave,f32", dspInterleave(inputF32, referenceF32, frames, BLOCK));
+
+  (void)rms;
+
+  Serial.println("DSP,done");
+}
+
+void loop()
+{
+}
@@ -0,0 +1,340 @@
+/*
+ * Copyright (c) 2017 Thomas Roell.  All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal with the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ *  1. Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimers.
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimers in the
+ *     documentation and/or other materials provided with the distribution.
+ *  3. Neither the name of Thomas Roell, nor the names of its contributors
+ *     may be used to endorse or promote products derived from this Software
+ *     without specific prior written permission.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ * CONTRIBUTORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * WITH THE SOFTWARE.
+ */
+
+#include "Arduino.h"
+#include "DSP.h"
+
+static DSPBiquadCoefficients dspBiquadNormalize(float b0, float b1, float b2, float a0, float a1, float a2)
+{
+    DSPBiquadCoefficients c;
+
+    c.b0 = b0 / a0;
+    c.b1 = b1 / a0;
+    c.b2 = b2 / a0;
+    c.a1 = - a1 / a0;
+    c.a2 = - a2 / a0;
+
+    return c;
+}
+
+DSPBiquadCoefficients DSPBiquadCoefficients::lowpass(float sampleRate, float frequency, float q)
+{
+    float w0 = 2.0f * (float)M_PI * frequency / sampleRate;
+    float cs = cosf(w0);
+    float alpha = sinf(w0) / (2.0f * q);
+
+    return dspBiquadNormalize((1.0f - cs) * 0.5f, (1.0f - cs), (1.0f - cs) * 0.5f, 1.0f + alpha, -2.0f * cs, 1.0f - alpha);
+}
+
+DSPBiquadCoefficients DSPBiquadCoefficients::highpass(float sampleRate, float frequency, float q)
+{
+    float w0 = 2.0f * (float)M_PI * frequency / sampleRate;
+    float cs = cosf(w0);
+    float alpha = sinf(w0) / (2.0f * q);
+
+    return dspBiquadNormalize((1.0f + cs) * 0.5f, -(1.0f + cs), (1.0f + cs) * 0.5f, 1.0f + alpha, -2.0f * cs, 1.0f - alpha);
+}
+
+DSPBiquadCoefficients DSPBiquadCoefficients::bandpass(float sampleRate, float frequency, float q)
+{
+    float w0 = 2.0f * (float)M_PI * frequency / sampleRate;
+    float cs = cosf(w0);
+    float alpha = sinf(w0) / (2.0f * q);
+
+    return dspBiquadNormalize(alpha, 0.0f, -alpha, 1.0f + alpha, -2.0f * cs, 1.0f - alpha);
+}
+
+DSPBiquadCoefficients DSPBiquadCoefficients::notch(float sampleRate, float frequency, float q)
+{
+    float w0 = 2.0f * (float)M_PI * frequency / sampleRate;
+    float cs = cosf(w0);
+    float alpha = sinf(w0) / (2.0f * q);
+
+    return dspBiquadNormalize(1.0f, -2.0f * cs, 1.0f, 1.0f + alpha, -2.0f * cs, 1.0f - alpha);
+}
+
+DSPBiquadCoefficients DSPBiquadCoefficients::peaking(float sampleRate, float frequency, float q, float gain)
+{
+    float A = powf(10.0f, gain / 40.0f);
+    float w0 = 2.0f * (float)M_PI * frequency / sampleRate;
+    float cs = cosf(w0);
+    float alpha = sinf(w0) / (2.0f * q);
+
+    return dspBiquadNormalize(1.0f + alpha * A, -2.0f * cs, 1.0f - alpha * A, 1.0f + alpha / A, -2.0f * cs, 1.0f - alpha / A);
+}
+
+// Shelves use a slope of 1, i.e. alpha = sin(w0) / sqrt(2).
+DSPBiquadCoefficients DSPBiquadCoefficients::lowshelf(float sampleRate, float frequency, float gain)
+{
+    float A = powf(10.0f, gain / 40.0f);
+    float w0 = 2.0f * (float)M_PI * frequency / sampleRate;
+    float cs = cosf(w0);
+    float beta = 2.0f * sqrtf(A) * sinf(w0) * 0.70710678f;
+
+    return dspBiquadNormalize(A * ((A + 1.0f) - (A - 1.0f) * cs + beta),
+			      2.0f * A * ((A - 1.0f) - (A + 1.0f) * cs),
+			      A * ((A + 1.0f) - (A - 1.0f) * cs - beta),
+			      (A + 1.0f) + (A - 1.0f) * cs + beta,
+			      -2.0f * ((A - 1.0f) + (A + 1.0f) * cs),
+			      (A + 1.0f) + (A - 1.0f) * cs - beta);
+}
+
+DSPBiquadCoefficients DSPBiquadCoefficients::highshelf(float sampleRate, float frequency, float gain)
+{
+    float A = powf(10.0f, gain / 40.0f);
+    float w0 = 2.0f * (float)M_PI * frequency / sampleRate;
+    float cs = cosf(w0);
+    float beta = 2.0f * sqrtf(A) * sinf(w0) * 0.70710678f;
+
+    return dspBiquadNormalize(A * ((A + 1.0f) + (A - 1.0f) * cs + beta),
+			      -2.0f * A * ((A - 1.0f) + (A + 1.0f) * cs),
+			      A * ((A + 1.0f) + (A - 1.0f) * cs - beta),
+			      (A + 1.0f) - (A - 1.0f) * cs + beta,
+			      2.0f * ((A - 1.0f) - (A + 1.0f) * cs),
+			      (A + 1.0f) - (A - 1.0f) * cs - beta);
+}
+
+// Half scale, to match the postShift of 1 the cascades are set up with.
+static q15_t dspHalfQ15(float x)
+{
+    return __SSAT((int32_t)lrintf(x * 16384.0f), 16);
+}
+
+static q31_t dspHalfQ31(float x)
+{
+    x = x * 1073741824.0f;
+
+    if (x >= 2147483647.0f) {
+	return 0x7fffffff;
+    }
+
+    if (x <= -2147483648.0f) {
+	return (q31_t)0x80000000;
+    }
+
+    return (q31_t)lrintf(x);
+}
+
+void dspBiquadQ15(q15_t *coeffs, const DSPBiquadCoefficients &c)
+{
+    // The Q15 kernel wants a dummy 0 after b0, so that it can use dual 16 bit MACs.
+    coeffs[0] = dspHalfQ15(c.b0);
+    coeffs[1] = 0;
+    coeffs[2] = dspHalfQ15(c.b1);
+    coeffs[3] = dspHalfQ15(c.b2);
+    coeffs[4] = dspHalfQ15(c.a1);
+    coeffs[5] = dspHalfQ15(c.a2);
+}
+
+void dspBiquadQ31(q31_t *coeffs, const DSPBiquadCoefficients &c)
+{
+    coeffs[0] = dspHalfQ31(c.b0);
+    coeffs[1] = dspHalfQ31(c.b1);
+    coeffs[2] = dspHalfQ31(c.b2);
+    coeffs[3] = dspHalfQ31(c.a1);
+    coeffs[4] = dspHalfQ31(c.a2);
+}
+
+DSPEnvelope::DSPEnvelope()
+{
+    _attack = 1.0f;
+    _release = 1.0f;
+    _level = 0.0f;
+}
+
+static float dspEnvelopeCoefficient(float sampleRate, float time)
+{
+    if ((time * sampleRate) <= 1.0f) {
+	return 1.0f;
+    }
+
+    return 1.0f - expf(-1.0f / (time * sampleRate));
+}
+
+void DSPEnvelope::setTime(float sampleRate, float attack, float release)
+{
+    _attack = dspEnvelopeCoefficient(sampleRate, attack);
+    _release = dspEnvelopeCoefficient(sampleRate, release);
+}
+
+float DSPEnvelope::process(const float *input, float *output, size_t count)
+{
+    float level = _level;
+    float x;
+    size_t n;
+
+    for (n = 0; n < count; n++) {
+	x = fabsf(input[n]);
+
+	level += ((x > level) ? _attack : _release) * (x - level);
+
+	if (output) {
+	    output[n] = level;
+	}
+    }
+
+    _level = level;
+
+    return level;
+}
+
+float DSPEnvelope::process(const int16_t *input, int16_t *output, size_t count, unsigned int stride)
+{
+    float level = _level;
+    float x;
+    size_t n;
+
+    for (n = 0; n < count; n++) {
+	x = fabsf((float)input[n * stride]) * (1.0f / 32768.0f);
+
+	level += ((x > level) ? _attack : _release) * (x - level);
+
+	if (output) {
+	    output[n] = __SSAT((int32_t)(level * 32768.0f), 16);
+	}
+    }
+
+    _level = level;
+
+    return level;
+}
+
+float dspRMS(const float *input, size_t count)
+{
+    float result;
+
+    if (!count) {
+	return 0.0f;
+    }
+
+    arm_rms_f32(const_cast<float*>(input), count, &result);
+
+    return result;
+}
+
+int16_t dspRMS(const int16_t *input, size_t count)
+{
+    q15_t result;
+
+    if (!count) {
+	return 0;
+    }
+
+    arm_rms_q15(const_cast<int16_t*>(input), count, &result);
+
+    return result;
+}
+
+int32_t dspRMS(const int32_t *input, size_t count)
+{
+    q31_t result;
+
+    if (!count) {
+	return 0;
+    }
+
+    arm_rms_q31(const_cast<q31_t*>(reinterpret_cast<const q31_t*>(input)), count, &result);
+
+    return result;
+}
+
+void dspDeinterleave(const int16_t *frames, float *left, float *right, size_t count)
+{
+    const uint32_t *data = (const uint32_t*)frames;
+    uint32_t frame;
+    size_t n;
+
+    if (right) {
+	for (n = 0; n < count; n++) {
+	    frame = data[n];
+
+	    left[n] = (float)(int16_t)frame * (1.0f / 32768.0f);
+	    right[n] = (float)(int16_t)(frame >> 16) * (1.0f / 32768.0f);
+	}
+    } else {
+	for (n = 0; n < count; n++) {
+	    frame = data[n];
+
+	    left[n] = (float)((int32_t)(int16_t)frame + (int32_t)(int16_t)(frame >> 16)) * (1.0f / 65536.0f);
+	}
+    }
+}
+
+void dspDeinterleave(const int16_t *frames, int16_t *left, int16_t *right, size_t count)
+{
+    const uint32_t *data = (const uint32_t*)frames;
+    uint32_t frame;
+    size_t n;
+
+    if (right) {
+	for (n = 0; n < count; n++) {
+	    frame = data[n];
+
+	    left[n] = (int16_t)frame;
+	    right[n] = (int16_t)(frame >> 16);
+	}
+    } else {
+	for (n = 0; n < count; n++) {
+	    frame = data[n];
+
+	    left[n] = ((int32_t)(int16_t)frame + (int32_t)(int16_t)(frame >> 16)) >> 1;
+	}
+    }
+}
+
+void dspInterleave(const float *left, const float *right, int16_t *frames, size_t count)
+{
+    uint32_t *data = (uint32_t*)frames;
+    int32_t l, r;
+    size_t n;
+
+    if (!right) {
+	right = left;
+    }
+
+    for (n = 0; n < count; n++) {
+	l = __SSAT((int32_t)(left[n] * 32768.0f), 16);
+	r = __SSAT((int32_t)(right[n] * 32768.0f), 16);
+
+	data[n] = (uint32_t)(uint16_t)l | ((uint32_t)r << 16);
+    }
+}
+
+void dspInterleave(const int16_t *left, const int16_t *right, int16_t *frames, size_t count)
+{
+    uint32_t *data = (uint32_t*)frames;
+    size_t n;
+
+    if (!right) {
+	right = left;
+    }
+
+    for (n = 0; n < count; n++) {
+	data[n] = (uint32_t)(uint16_t)left[n] | ((uint32_t)right[n] << 16);
+    }
+}
@@ -0,0 +1,277 @@
+/*
+ * Copyright (c) 2017 Thomas Roell.  All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal with the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ *  1. Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimers.
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimers in the
+ *     documentation and/or other materials provided with the distribution.
+ *  3. Neither the name of Thomas Roell, nor the names of its contributors
+ *     may be used to endorse or promote products derived from this Software
+ *     without specific prior written permission.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ * CONTRIBUTORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * WITH THE SOFTWARE.
+ */
+
+#ifndef _DSP_H_INCLUDED
+#define _DSP_H_INCLUDED
+
+#include <Arduino.h>
+#include "arm_math.h"
+
+// Filter and level primitives for audio (I2S) and sensor (IMU) pipelines.
+//
+// The filters are thin wrappers around the CMSIS-DSP kernels in
+// libarm_cortexM4lf_math.a (which every board already links), i.e. FPU code
+// for float32 and DSP/SIMD code for Q15/Q31. All state lives in the
+// objects, sized by template parameters, so there is no heap use and a
+// filter can be a global or a member of a voice.
+//
+// Samples are processed in blocks; "input" and "output" may point to the
+// same buffer. The I2S helpers at the end convert between the 16 bit
+// interleaved stereo frames used by I2SClass/I2SMixerClass and separate
+// channel blocks.
+
+// Biquad coefficients in the CMSIS convention:
+//
+//     y[n] = b0 * x[n] + b1 * x[n-1] + b2 * x[n-2] + a1 * y[n-1] + a2 * y[n-2]
+//
+// i.e. a1/a2 are the negated (and normalized) textbook denominator. The
+// designs are the usual RBJ cookbook ones; "frequency" is in Hz, "gain" in dB.
+struct DSPBiquadCoefficients {
+    float b0, b1, b2, a1, a2;
+
+    static DSPBiquadCoefficients lowpass(float sampleRate, float frequency, float q = 0.70710678f);
+    static DSPBiquadCoefficients highpass(float sampleRate, float frequency, float q = 0.70710678f);
+    static DSPBiquadCoefficients bandpass(float sampleRate, float frequency, float q);
+    static DSPBiquadCoefficients notch(float sampleRate, float frequency, float q);
+    static DSPBiquadCoefficients peaking(float sampleRate, float frequency, float q, float gain);
+    static DSPBiquadCoefficients lowshelf(float sampleRate, float frequency, float gain);
+    static DSPBiquadCoefficients highshelf(float sampleRate, float frequency, float gain);
+};
+
+// Coefficient conversion for the fixed point cascades. Stages are stored at
+// half scale (postShift of 1), so coefficients have to be in [-2.0 .. 2.0),
+// which covers all of the designs above except for shelves/peaks with more
+// than about 6 dB of boost. Out of range values are saturated.
+extern void dspBiquadQ15(q15_t *coeffs, const DSPBiquadCoefficients &c);
+extern void dspBiquadQ31(q31_t *coeffs, const DSPBiquadCoefficients &c);
+
+// Cascade of STAGES float biquads (direct form II transposed). Each stage
+// starts out as pass-through.
+template<unsigned int STAGES> class DSPBiquad {
+public:
+    DSPBiquad() {
+        DSPBiquadCoefficients c = { 1.0f, 0.0f, 0.0f, 0.0f, 0.0f };
+
+        for (unsigned int stage = 0; stage < STAGES; stage++) {
+            setStage(stage, c);
+        }
+        arm_biquad_cascade_df2T_init_f32(&_instance, STAGES, &_coeffs[0], &_state[0]);
+    }
+
+    void setStage(unsigned int stage, const DSPBiquadCoefficients &c) {
+        float *coeffs = &_coeffs[stage * 5];
+
+        coeffs[0] = c.b0;
+        coeffs[1] = c.b1;
+        coeffs[2] = c.b2;
+        coeffs[3] = c.a1;
+        coeffs[4] = c.a2;
+    }
+
+    void reset() { memset(&_state[0], 0, sizeof(_state)); }
+
+    void process(const float *input, float *output, size_t count) {
+        arm_biquad_cascade_df2T_f32(&_instance, const_cast<float*>(input), output, count);
+    }
+
+private:
+    arm_biquad_cascade_df2T_instance_f32 _instance;
+    float _coeffs[5 * STAGES];
+    float _state[2 * STAGES];
+};
+
+// Cascade of STAGES Q15 biquads (direct form I, 64 bit accumulator, 2 samples per SIMD op).
+template<unsigned int STAGES> class DSPBiquadQ15 {
+public:
+    DSPBiquadQ15() {
+        DSPBiquadCoefficients c = { 1.0f, 0.0f, 0.0f, 0.0f, 0.0f };
+
+        for (unsigned int stage = 0; stage < STAGES; stage++) {
+            setStage(stage, c);
+        }
+        arm_biquad_cascade_df1_init_q15(&_instance, STAGES, &_coeffs[0], &_state[0], 1);
+    }
+
+    void setStage(unsigned int stage, const DSPBiquadCoefficients &c) { dspBiquadQ15(&_coeffs[stage * 6], c); }
+
+    void reset() { memset(&_state[0], 0, sizeof(_state)); }
+
+    void process(const int16_t *input, int16_t *output, size_t count) {
+        arm_biquad_cascade_df1_q15(&_instance, const_cast<int16_t*>(input), output, count);
+    }
+
+private:
+    arm_biquad_casd_df1_inst_q15 _instance;
+    q15_t _coeffs[6 * STAGES];
+    q15_t _state[4 * STAGES];
+};
+
+// Cascade of STAGES Q31 biquads (direct form I, 64 bit accumulator).
+template<unsigned int STAGES> class DSPBiquadQ31 {
+public:
+    DSPBiquadQ31() {
+        DSPBiquadCoefficients c = { 1.0f, 0.0f, 0.0f, 0.0f, 0.0f };
+
+        for (unsigned int stage = 0; stage < STAGES; stage++) {
+            setStage(stage, c);
+        }
+        arm_biquad_cascade_df1_init_q31(&_instance, STAGES, &_coeffs[0], &_state[0], 1);
+    }
+
+    void setStage(unsigned int stage, const DSPBiquadCoefficients &c) { dspBiquadQ31(&_coeffs[stage * 5], c); }
+
+    void reset() { memset(&_state[0], 0, sizeof(_state)); }
+
+    void process(const int32_t *input, int32_t *output, size_t count) {
+        arm_biquad_cascade_df1_q31(&_instance, const_cast<q31_t*>(reinterpret_cast<const q31_t*>(input)), reinterpret_cast<q31_t*>(output), count);
+    }
+
+private:
+    arm_biquad_casd_df1_inst_q31 _instance;
+    q31_t _coeffs[5 * STAGES];
+    q31_t _state[4 * STAGES];
+};
+
+// FIR filter with TAPS coefficients, processing up to BLOCK samples per
+// kernel call (longer blocks are split). Coefficients are passed in natural
+// order (h[0] first). The delay line is kept in the object between calls.
+template<unsigned int TAPS, unsigned int BLOCK = 32> class DSPFir {
+public:
+    DSPFir() {
+        memset(&_coeffs[0], 0, sizeof(_coeffs));
+        arm_fir_init_f32(&_instance, TAPS, &_coeffs[0], &_state[0], BLOCK);
+    }
+
+    DSPFir(const float *coefficients) : DSPFir() { setCoefficients(coefficients); }
+
+    void setCoefficients(const float *coefficients) {
+        for (unsigned int tap = 0; tap < TAPS; tap++) {
+            _coeffs[tap] = coefficients[TAPS -1 - tap];
+        }
+    }
+
+    void reset() { memset(&_state[0], 0, sizeof(_state)); }
+
+    void process(const float *input, float *output, size_t count) {
+        size_t n;
+
+        while (count) {
+            n = (count > BLOCK) ? BLOCK : count;
+
+            arm_fir_f32(&_instance, const_cast<float*>(input), output, n);
+
+            input += n;
+            output += n;
+            count -= n;
+        }
+    }
+
+private:
+    arm_fir_instance_f32 _instance;
+    float _coeffs[TAPS];
+    float _state[TAPS + BLOCK - 1];
+};
+
+// Q15 FIR filter (TAPS has to be even and at least 4).
+template<unsigned int TAPS, unsigned int BLOCK = 32> class DSPFirQ15 {
+    static_assert(((TAPS & 1) == 0) && (TAPS >= 4), "DSPFirQ15 needs an even number of at least 4 taps");
+
+public:
+    DSPFirQ15() {
+        memset(&_coeffs[0], 0, sizeof(_coeffs));
+        arm_fir_init_q15(&_instance, TAPS, &_coeffs[0], &_state[0], BLOCK);
+    }
+
+    DSPFirQ15(const int16_t *coefficients) : DSPFirQ15() { setCoefficients(coefficients); }
+
+    void setCoefficients(const int16_t *coefficients) {
+        for (unsigned int tap = 0; tap < TAPS; tap++) {
+            _coeffs[tap] = coefficients[TAPS -1 - tap];
+        }
+    }
+
+    void reset() { memset(&_state[0], 0, sizeof(_state)); }
+
+    void process(const int16_t *input, int16_t *output, size_t count) {
+        size_t n;
+
+        while (count) {
+            n = (count > BLOCK) ? BLOCK : count;
+
+            arm_fir_q15(&_instance, const_cast<int16_t*>(input), output, n);
+
+            input += n;
+            output += n;
+            count -= n;
+        }
+    }
+
+private:
+    arm_fir_instance_q15 _instance;
+    q15_t _coeffs[TAPS];
+    q15_t _state[TAPS + BLOCK - 1];
+};
+
+// Peak envelope follower with separate attack and release time constants
+// (in seconds, time to reach 1 - 1/e of a step). process() returns the
+// envelope at the end of the block and, if "output" is not NULL, stores
+// the envelope per sample. Q15 input is treated as [-1.0 .. 1.0), and
+// "stride" allows following one channel of interleaved data.
+class DSPEnvelope {
+public:
+    DSPEnvelope();
+
+    void setTime(float sampleRate, float attack, float release);
+    void reset(float level = 0.0f) { _level = level; }
+    float level() const { return _level; }
+
+    float process(const float *input, float *output, size_t count);
+    float process(const int16_t *input, int16_t *output, size_t count, unsigned int stride = 1);
+
+private:
+    float _attack;
+    float _release;
+    float _level;
+};
+
+// Block RMS. The Q15/Q31 variants use a 64 bit accumulator and saturate.
+extern float dspRMS(const float *input, size_t count);
+extern int16_t dspRMS(const int16_t *input, size_t count);
+extern int32_t dspRMS(const int32_t *input, size_t count);
+
+// I2S blocks: "frames" are 16 bit interleaved stereo (left first, word
+// aligned), as used by I2SClass::read()/acquireTxBuffer() and by
+// I2SMixerSource. Float samples are scaled to [-1.0 .. 1.0) and saturated
+// on the way back. For deinterleave a NULL "right" stores the mono sum (L+R)/2
+// into "left"; for interleave a NULL "right" duplicates "left".
+extern void dspDeinterleave(const int16_t *frames, float *left, float *right, size_t count);
+extern void dspDeinterleave(const int16_t *frames, int16_t *left, int16_t *right, size_t count);
+extern void dspInterleave(const float *left, const float *right, int16_t *frames, size_t count);
+extern void dspInterleave(const int16_t *left, const int16_t *right, int16_t *frames, size_t count);
+
+#endif // _DSP_H_INCLUDED
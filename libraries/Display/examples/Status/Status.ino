@@ -0,0 +1,44 @@
+/*
+  Status
+
+  Draws a status screen on a 135x240 ST7789 TFT on SPI (CS on pin 10,
+  D/C on pin 9, reset on pin 8): a static frame, plus a bar graph of
+  analogRead(A0) and a heartbeat box that change all the time. Only the
+  bar and the box are sent to the panel on each update(), by DMA, while
+  loop() goes on. The framebuffer takes 63kB of RAM.
+
+  This example code is in the public domain.
+*/
+
+#include <Display.h>
+
+ST7789<135, 240> tft(SPI, 10, 9, 8);
+
+bool beat;
+
+void setup()
+{
+  // The 135x240 panel sits at 52/40 in the controller RAM
+  tft.begin(52, 40);
+
+  tft.fillScreen(Display::color565(0, 0, 64));
+  tft.drawRect(10, 100, 115, 40, Display::color565(255, 255, 255));
+}
+
+void loop()
+{
+  int level;
+
+  level = map(analogRead(A0), 0, 1023, 0, 111);
+
+  tft.fillRect(12, 102, level, 36, Display::color565(0, 255, 0));
+  tft.fillRect(12 + level, 102, 111 - level, 36, Display::color565(0, 0, 0));
+
+  beat = !beat;
+  tft.fillRect(57, 180, 20, 20, beat ? Display::color565(255, 0, 0) : Display::color565(0, 0, 64));
+
+  // Returns right away; the previous update has finished long before.
+  tft.update();
+
+  delay(50);
+}
@@ -0,0 +1,728 @@
+/*
+ * Copyright (c) 2017 Thomas Roell.  All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal with the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ *  1. Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimers.
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimers in the
+ *     documentation and/or other materials provided with the distribution.
+ *  3. Neither the name of Thomas Roell, nor the names of its contributors
+ *     may be used to endorse or promote products derived from this Software
+ *     without specific prior written permission.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ * CONTRIBUTORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * WITH THE SOFTWARE.
+ */
+
+#include "Arduino.h"
+#include "stm32l4_wiring_private.h"
+#include "Display.h"
+
+static_assert(DISPLAY_COUNT == 2, "DISPLAY_COUNT does not match the callback table");
+
+Display *Display::_displays[DISPLAY_COUNT];
+
+Display::Display(SPIClass &spi, uint32_t cs, uint32_t dc, uint32_t reset, uint16_t width, uint16_t height, uint32_t clock)
+{
+    _spi = &spi;
+    _settings = SPISettings(clock, MSBFIRST, SPI_MODE0);
+    _cs = cs;
+    _dc = dc;
+    _reset = reset;
+    _width = width;
+    _height = height;
+    _slot = -1;
+
+    _dirtyCount = 0;
+
+    _busy = false;
+    _started = false;
+    _callback = NULL;
+    _rectCount = 0;
+    _rectIndex = 0;
+    _segmentCount = 0;
+    _segmentIndex = 0;
+    _lineIndex = 0;
+}
+
+template<unsigned int N> void Display::_spiCallback(void)
+{
+    _displays[N]->next();
+}
+
+bool Display::start()
+{
+    unsigned int slot;
+
+    if (_slot >= 0) {
+	return false;
+    }
+
+    for (slot = 0; slot < DISPLAY_COUNT; slot++) {
+	if (!_displays[slot]) {
+	    break;
+	}
+    }
+
+    if (slot == DISPLAY_COUNT) {
+	return false;
+    }
+
+    _displays[slot] = this;
+    _slot = slot;
+
+    digitalWrite(_cs, HIGH);
+    pinMode(_cs, OUTPUT);
+
+    digitalWrite(_dc, HIGH);
+    pinMode(_dc, OUTPUT);
+
+    if (!_spi->isEnabled()) {
+	_spi->begin();
+    }
+
+    if (_reset < PINS_COUNT) {
+	digitalWrite(_reset, LOW);
+	pinMode(_reset, OUTPUT);
+	delay(10);
+	digitalWrite(_reset, HIGH);
+	delay(120);
+    }
+
+    _dirtyCount = 0;
+    _rectCount = 0;
+    _rectIndex = 0;
+
+    return true;
+}
+
+void Display::end()
+{
+    if (_slot < 0) {
+	return;
+    }
+
+    flush();
+
+    _displays[_slot] = NULL;
+    _slot = -1;
+}
+
+// Synchronous, for the setup sequences in begin().
+void Display::command(uint8_t dc, const uint8_t *data, size_t count)
+{
+    digitalWrite(_dc, (dc ? HIGH : LOW));
+
+    _spi->beginTransaction(_settings);
+
+    digitalWrite(_cs, LOW);
+    _spi->write(data, count);
+    digitalWrite(_cs, HIGH);
+
+    _spi->endTransaction();
+
+    digitalWrite(_dc, HIGH);
+}
+
+void Display::drawPixel(int x, int y, uint16_t color)
+{
+    DisplayRect rect;
+
+    if ((x < 0) || (x >= _width) || (y < 0) || (y >= _height)) {
+	return;
+    }
+
+    setPixel(x, y, color);
+
+    rect.x0 = x;
+    rect.y0 = y;
+    rect.x1 = x;
+    rect.y1 = y;
+
+    mark(rect);
+}
+
+void Display::drawHLine(int x, int y, int w, uint16_t color)
+{
+    fillRect(x, y, w, 1, color);
+}
+
+void Display::drawVLine(int x, int y, int h, uint16_t color)
+{
+    fillRect(x, y, 1, h, color);
+}
+
+void Display::drawRect(int x, int y, int w, int h, uint16_t color)
+{
+    if ((w <= 0) || (h <= 0)) {
+	return;
+    }
+
+    fillRect(x, y, w, 1, color);
+    fillRect(x, y + h - 1, w, 1, color);
+    fillRect(x, y + 1, 1, h - 2, color);
+    fillRect(x + w - 1, y + 1, 1, h - 2, color);
+}
+
+void Display::fillRect(int x, int y, int w, int h, uint16_t color)
+{
+    DisplayRect rect;
+
+    if ((w <= 0) || (h <= 0)) {
+	return;
+    }
+
+    rect.x0 = (x < 0) ? 0 : x;
+    rect.y0 = (y < 0) ? 0 : y;
+    rect.x1 = ((x + w) > _width) ? (_width - 1) : (x + w - 1);
+    rect.y1 = ((y + h) > _height) ? (_height - 1) : (y + h - 1);
+
+    if ((rect.x0 > rect.x1) || (rect.y0 > rect.y1)) {
+	return;
+    }
+
+    fill(rect, color);
+
+    mark(rect);
+}
+
+void Display::fillScreen(uint16_t color)
+{
+    fillRect(0, 0, _width, _height, color);
+}
+
+void Display::drawBitmap(int x, int y, const uint8_t *bitmap, int w, int h, uint16_t color)
+{
+    DisplayRect rect;
+    int i, j, stride;
+
+    if ((w <= 0) || (h <= 0)) {
+	return;
+    }
+
+    rect.x0 = (x < 0) ? 0 : x;
+    rect.y0 = (y < 0) ? 0 : y;
+    rect.x1 = ((x + w) > _width) ? (_width - 1) : (x + w - 1);
+    rect.y1 = ((y + h) > _height) ? (_height - 1) : (y + h - 1);
+
+    if ((rect.x0 > rect.x1) || (rect.y0 > rect.y1)) {
+	return;
+    }
+
+    stride = (w + 7) / 8;
+
+    for (j = rect.y0; j <= rect.y1; j++) {
+	for (i = rect.x0; i <= rect.x1; i++) {
+	    if (bitmap[(j - y) * stride + ((i - x) >> 3)] & (0x80 >> ((i - x) & 7))) {
+		setPixel(i, j, color);
+	    }
+	}
+    }
+
+    mark(rect);
+}
+
+void Display::invalidate(int x, int y, int w, int h)
+{
+    DisplayRect rect;
+
+    if ((w <= 0) || (h <= 0)) {
+	return;
+    }
+
+    rect.x0 = (x < 0) ? 0 : x;
+    rect.y0 = (y < 0) ? 0 : y;
+    rect.x1 = ((x + w) > _width) ? (_width - 1) : (x + w - 1);
+    rect.y1 = ((y + h) > _height) ? (_height - 1) : (y + h - 1);
+
+    if ((rect.x0 > rect.x1) || (rect.y0 > rect.y1)) {
+	return;
+    }
+
+    mark(rect);
+}
+
+// Adds "rect" to the dirty list. Rectangles that overlap or touch are
+// merged; if the list is full, "rect" is merged into the entry whose area
+// grows the least.
+void Display::mark(DisplayRect rect)
+{
+    DisplayRect *dirty;
+    unsigned int index, best;
+    int32_t growth, best_growth;
+
+    align(rect);
+
+    index = 0;
+
+    while (index < _dirtyCount) {
+	dirty = &_dirty[index];
+
+	if ((rect.x0 <= (dirty->x1 + 1)) && (dirty->x0 <= (rect.x1 + 1)) &&
+	    (rect.y0 <= (dirty->y1 + 1)) && (dirty->y0 <= (rect.y1 + 1))) {
+	    if (rect.x0 > dirty->x0) { rect.x0 = dirty->x0; }
+	    if (rect.y0 > dirty->y0) { rect.y0 = dirty->y0; }
+	    if (rect.x1 < dirty->x1) { rect.x1 = dirty->x1; }
+	    if (rect.y1 < dirty->y1) { rect.y1 = dirty->y1; }
+
+	    // The union may touch entries that were checked already.
+	    _dirty[index] = _dirty[--_dirtyCount];
+
+	    index = 0;
+	} else {
+	    index++;
+	}
+    }
+
+    if (_dirtyCount < DISPLAY_DIRTY_COUNT) {
+	_dirty[_dirtyCount++] = rect;
+
+	return;
+    }
+
+    best = 0;
+    best_growth = 0x7fffffff;
+
+    for (index = 0; index < _dirtyCount; index++) {
+	dirty = &_dirty[index];
+
+	growth = ((int32_t)((rect.x1 > dirty->x1 ? rect.x1 : dirty->x1) - (rect.x0 < dirty->x0 ? rect.x0 : dirty->x0) + 1) *
+		  (int32_t)((rect.y1 > dirty->y1 ? rect.y1 : dirty->y1) - (rect.y0 < dirty->y0 ? rect.y0 : dirty->y0) + 1) -
+		  (int32_t)(dirty->x1 - dirty->x0 + 1) * (int32_t)(dirty->y1 - dirty->y0 + 1));
+
+	if (best_growth > growth) {
+	    best_growth = growth;
+	    best = index;
+	}
+    }
+
+    dirty = &_dirty[best];
+
+    if (dirty->x0 > rect.x0) { dirty->x0 = rect.x0; }
+    if (dirty->y0 > rect.y0) { dirty->y0 = rect.y0; }
+    if (dirty->x1 < rect.x1) { dirty->x1 = rect.x1; }
+    if (dirty->y1 < rect.y1) { dirty->y1 = rect.y1; }
+}
+
+bool Display::update(void(*callback)(void))
+{
+    unsigned int index;
+
+    if ((_slot < 0) || _busy) {
+	return false;
+    }
+
+    // Regions a previous update() could not send get merged back first.
+    for (index = _rectIndex; index < _rectCount; index++) {
+	mark(_rects[index]);
+    }
+
+    _rectCount = 0;
+    _rectIndex = 0;
+
+    if (_dirtyCount == 0) {
+	if (callback) {
+	    (*callback)();
+	}
+
+	return true;
+    }
+
+    for (index = 0; index < _dirtyCount; index++) {
+	_rects[index] = _dirty[index];
+    }
+
+    _rectCount = _dirtyCount;
+    _dirtyCount = 0;
+
+    _segmentCount = window(_rects[0], &_segments[0]);
+    _segmentIndex = 0;
+    _lineIndex = 0;
+
+    _callback = callback;
+    _started = false;
+    _busy = true;
+
+    next();
+
+    return true;
+}
+
+bool Display::done()
+{
+    return !_busy;
+}
+
+void Display::flush()
+{
+    while (_busy) {
+	armv7m_core_yield();
+    }
+}
+
+// Posts the next piece of the update: a window segment with its D/C level,
+// or up to DISPLAY_QUEUE_SIZE lines of the current rectangle. Runs from
+// update() for the first piece, and from the SPI completion callback for
+// all others.
+void Display::next()
+{
+    static void (* const spiCallbacks[DISPLAY_COUNT])(void) = {
+	Display::_spiCallback<0>,
+	Display::_spiCallback<1>,
+    };
+
+    SPITransaction *transaction;
+    const Segment *segment;
+    const uint8_t *data;
+    void(*callback)(void);
+    unsigned int count;
+    size_t size;
+
+    while (_rectIndex < _rectCount) {
+	if (_segmentIndex < _segmentCount) {
+	    segment = &_segments[_segmentIndex++];
+
+	    digitalWrite(_dc, (segment->dc ? HIGH : LOW));
+
+	    transaction = &_transactions[0];
+	    transaction->settings = _settings;
+	    transaction->pin = _cs;
+	    transaction->txBuffer = &segment->data[0];
+	    transaction->rxBuffer = NULL;
+	    transaction->count = segment->count;
+
+	    if (_spi->transfer(&_transactions[0], 1, spiCallbacks[_slot])) {
+		_started = true;
+
+		return;
+	    }
+
+	    break;
+	}
+
+	for (count = 0; count < DISPLAY_QUEUE_SIZE; count++) {
+	    size = line(_rects[_rectIndex], _lineIndex, &data);
+
+	    if (!size) {
+		break;
+	    }
+
+	    transaction = &_transactions[count];
+	    transaction->settings = _settings;
+	    transaction->pin = _cs;
+	    transaction->txBuffer = data;
+	    transaction->rxBuffer = NULL;
+	    transaction->count = size;
+
+	    _lineIndex++;
+	}
+
+	if (count) {
+	    digitalWrite(_dc, HIGH);
+
+	    if (_spi->transfer(&_transactions[0], count, spiCallbacks[_slot])) {
+		_started = true;
+
+		return;
+	    }
+
+	    break;
+	}
+
+	_rectIndex++;
+
+	if (_rectIndex < _rectCount) {
+	    _segmentCount = window(_rects[_rectIndex], &_segments[0]);
+	    _segmentIndex = 0;
+	    _lineIndex = 0;
+	}
+    }
+
+    // Either all regions are sent, or the bus was busy and what is left
+    // (from _rectIndex on) gets picked up by the next update(). The bus
+    // was selected by the first queued transfer, if there was one.
+    if (_started) {
+	_spi->endTransaction();
+    }
+
+    digitalWrite(_dc, HIGH);
+
+    callback = _callback;
+    _callback = NULL;
+
+    _busy = false;
+
+    if (callback) {
+	(*callback)();
+    }
+}
+
+/************************************************************************************/
+
+SSD1306Display::SSD1306Display(SPIClass &spi, uint32_t cs, uint32_t dc, uint32_t reset, uint16_t width, uint16_t height, uint8_t *buffer)
+    : Display(spi, cs, dc, reset, width, height, 8000000)
+{
+    _buffer = buffer;
+}
+
+bool SSD1306Display::begin()
+{
+    const uint8_t setup[] = {
+	0xae,                               // display off
+	0xd5, 0x80,                         // clock divide
+	0xa8, (uint8_t)(_height - 1),       // multiplex ratio
+	0xd3, 0x00,                         // display offset
+	0x40,                               // start line 0
+	0x8d, 0x14,                         // charge pump on
+	0x20, 0x00,                         // horizontal addressing
+	0xa1,                               // segment remap
+	0xc8,                               // COM scan descending
+	0xda, (uint8_t)((_height == 64) ? 0x12 : 0x02), // COM pins
+	0x81, 0xcf,                         // contrast
+	0xd9, 0xf1,                         // precharge
+	0xdb, 0x40,                         // VCOMH deselect
+	0xa4,                               // display RAM
+	0xa6,                               // not inverted
+	0xaf,                               // display on
+    };
+
+    if (!start()) {
+	return false;
+    }
+
+    command(0, &setup[0], sizeof(setup));
+
+    // The panel RAM content is undefined, so the first update() sends all.
+    memset(_buffer, 0, _width * (_height / 8));
+
+    invalidate(0, 0, _width, _height);
+
+    return true;
+}
+
+void SSD1306Display::setPixel(int x, int y, uint16_t color)
+{
+    if (color) {
+	_buffer[(y >> 3) * _width + x] |= (1 << (y & 7));
+    } else {
+	_buffer[(y >> 3) * _width + x] &= ~(1 << (y & 7));
+    }
+}
+
+void SSD1306Display::fill(const DisplayRect &rect, uint16_t color)
+{
+    int x, y;
+
+    for (y = rect.y0; y <= rect.y1; y++) {
+	for (x = rect.x0; x <= rect.x1; x++) {
+	    setPixel(x, y, color);
+	}
+    }
+}
+
+// The panel is written in pages of 8 rows. Rectangles wider than half the
+// panel are sent as full pages, which are contiguous in the framebuffer.
+void SSD1306Display::align(DisplayRect &rect)
+{
+    rect.y0 &= ~7;
+    rect.y1 |= 7;
+
+    if ((rect.x1 - rect.x0 + 1) > (_width / 2)) {
+	rect.x0 = 0;
+	rect.x1 = _width - 1;
+    }
+}
+
+unsigned int SSD1306Display::window(const DisplayRect &rect, Segment *segments)
+{
+    segments[0].dc = 0;
+    segments[0].count = 6;
+    segments[0].data[0] = 0x21;
+    segments[0].data[1] = rect.x0;
+    segments[0].data[2] = rect.x1;
+    segments[0].data[3] = 0x22;
+    segments[0].data[4] = rect.y0 >> 3;
+    segments[0].data[5] = rect.y1 >> 3;
+
+    return 1;
+}
+
+size_t SSD1306Display::line(const DisplayRect &rect, unsigned int index, const uint8_t **p_data)
+{
+    unsigned int pages;
+
+    pages = (rect.y1 >> 3) - (rect.y0 >> 3) + 1;
+
+    if ((rect.x0 == 0) && (rect.x1 == (_width - 1))) {
+	if (index != 0) {
+	    return 0;
+	}
+
+	*p_data = &_buffer[(rect.y0 >> 3) * _width];
+
+	return pages * _width;
+    }
+
+    if (index >= pages) {
+	return 0;
+    }
+
+    *p_data = &_buffer[((rect.y0 >> 3) + index) * _width + rect.x0];
+
+    return (rect.x1 - rect.x0 + 1);
+}
+
+/************************************************************************************/
+
+ST7789Display::ST7789Display(SPIClass &spi, uint32_t cs, uint32_t dc, uint32_t reset, uint16_t width, uint16_t height, uint16_t *buffer)
+    : Display(spi, cs, dc, reset, width, height, 40000000)
+{
+    _buffer = buffer;
+    _xOffset = 0;
+    _yOffset = 0;
+}
+
+bool ST7789Display::begin(uint16_t xOffset, uint16_t yOffset)
+{
+    static const uint8_t colmod[] = { 0x3a, 0x55 };  // 16 bit RGB565
+    static const uint8_t madctl[] = { 0x36, 0x00 };
+    static const uint8_t swreset[] = { 0x01 };
+    static const uint8_t slpout[] = { 0x11 };
+    static const uint8_t invon[] = { 0x21 };
+    static const uint8_t noron[] = { 0x13 };
+    static const uint8_t dispon[] = { 0x29 };
+
+    if (!start()) {
+	return false;
+    }
+
+    _xOffset = xOffset;
+    _yOffset = yOffset;
+
+    command(0, &swreset[0], 1);
+    delay(150);
+    command(0, &slpout[0], 1);
+    delay(10);
+    command(0, &colmod[0], 1);
+    command(1, &colmod[1], 1);
+    command(0, &madctl[0], 1);
+    command(1, &madctl[1], 1);
+    command(0, &invon[0], 1);
+    command(0, &noron[0], 1);
+    command(0, &dispon[0], 1);
+    delay(10);
+
+    memset(_buffer, 0, _width * _height * 2);
+
+    invalidate(0, 0, _width, _height);
+
+    return true;
+}
+
+void ST7789Display::setPixel(int x, int y, uint16_t color)
+{
+    _buffer[y * _width + x] = __builtin_bswap16(color);
+}
+
+void ST7789Display::fill(const DisplayRect &rect, uint16_t color)
+{
+    uint16_t *data, *data_e;
+    int y;
+
+    color = __builtin_bswap16(color);
+
+    for (y = rect.y0; y <= rect.y1; y++) {
+	data = &_buffer[y * _width + rect.x0];
+	data_e = data + (rect.x1 - rect.x0 + 1);
+
+	while (data != data_e) {
+	    *data++ = color;
+	}
+    }
+}
+
+// Rectangles wider than half the panel are sent as full rows, which are
+// contiguous in the framebuffer and go out in DISPLAY_CHUNK_SIZE pieces.
+void ST7789Display::align(DisplayRect &rect)
+{
+    if ((rect.x1 - rect.x0 + 1) > (_width / 2)) {
+	rect.x0 = 0;
+	rect.x1 = _width - 1;
+    }
+}
+
+unsigned int ST7789Display::window(const DisplayRect &rect, Segment *segments)
+{
+    uint16_t xs, xe, ys, ye;
+
+    xs = rect.x0 + _xOffset;
+    xe = rect.x1 + _xOffset;
+    ys = rect.y0 + _yOffset;
+    ye = rect.y1 + _yOffset;
+
+    segments[0].dc = 0;
+    segments[0].count = 1;
+    segments[0].data[0] = 0x2a;         // CASET
+
+    segments[1].dc = 1;
+    segments[1].count = 4;
+    segments[1].data[0] = xs >> 8;
+    segments[1].data[1] = xs;
+    segments[1].data[2] = xe >> 8;
+    segments[1].data[3] = xe;
+
+    segments[2].dc = 0;
+    segments[2].count = 1;
+    segments[2].data[0] = 0x2b;         // RASET
+
+    segments[3].dc = 1;
+    segments[3].count = 4;
+    segments[3].data[0] = ys >> 8;
+    segments[3].data[1] = ys;
+    segments[3].data[2] = ye >> 8;
+    segments[3].data[3] = ye;
+
+    segments[4].dc = 0;
+    segments[4].count = 1;
+    segments[4].data[0] = 0x2c;         // RAMWR
+
+    return 5;
+}
+
+size_t ST7789Display::line(const DisplayRect &rect, unsigned int index, const uint8_t **p_data)
+{
+    size_t size, offset;
+
+    if ((rect.x0 == 0) && (rect.x1 == (_width - 1))) {
+	size = (rect.y1 - rect.y0 + 1) * _width * 2;
+	offset = index * DISPLAY_CHUNK_SIZE;
+
+	if (offset >= size) {
+	    return 0;
+	}
+
+	*p_data = (const uint8_t*)&_buffer[rect.y0 * _width] + offset;
+
+	return ((size - offset) > DISPLAY_CHUNK_SIZE) ? DISPLAY_CHUNK_SIZE : (size - offset);
+    }
+
+    if (index > (unsigned int)(rect.y1 - rect.y0)) {
+	return 0;
+    }
+
+    *p_data = (const uint8_t*)&_buffer[(rect.y0 + index) * _width + rect.x0];
+
+    return (rect.x1 - rect.x0 + 1) * 2;
+}
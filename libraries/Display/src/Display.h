@@ -0,0 +1,211 @@
+/*
+ * Copyright (c) 2017 Thomas Roell.  All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal with the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ *  1. Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimers.
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimers in the
+ *     documentation and/or other materials provided with the distribution.
+ *  3. Neither the name of Thomas Roell, nor the names of its contributors
+ *     may be used to endorse or promote products derived from this Software
+ *     without specific prior written permission.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ * CONTRIBUTORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * WITH THE SOFTWARE.
+ */
+
+#ifndef _DISPLAY_H_INCLUDED
+#define _DISPLAY_H_INCLUDED
+
+#include <Arduino.h>
+#include <SPI.h>
+
+// Number of displays that can be active at the same time, number of dirty
+// rectangles tracked per display (more get merged), number of SPI
+// transactions queued per interrupt, and the largest single transaction.
+#define DISPLAY_COUNT        2
+#define DISPLAY_DIRTY_COUNT  4
+#define DISPLAY_QUEUE_SIZE   16
+#define DISPLAY_CHUNK_SIZE   32768
+
+// For "reset" if the reset line of the panel is not connected.
+#define DISPLAY_NO_PIN       0xffffffff
+
+struct DisplayRect {
+    int16_t x0, y0, x1, y1;  // inclusive
+};
+
+// SPI display with a framebuffer in RAM.
+//
+// The drawing functions only touch the framebuffer and record dirty
+// rectangles. update() sends just the dirty regions of the framebuffer to
+// the panel: per region the controller window is set up, and then the
+// lines of the region are sent via the SPI transaction queue by DMA, with
+// the next batch being posted from the completion callback. D/C is
+// switched from the same callback, so the whole update runs in interrupt
+// context and update() returns right away. "callback" (if not NULL) is
+// called once all regions have been sent. Drawing while an update is in
+// flight is fine; changed pixels are simply sent again by the next
+// update().
+//
+// The SPI bus must not be inside a beginTransaction() of some other device
+// while an update is in flight.
+//
+// Color arguments are RGB565 for ST7789, and zero/nonzero for SSD1306.
+class Display
+{
+public:
+    void end();
+
+    uint16_t width() { return _width; }
+    uint16_t height() { return _height; }
+
+    void drawPixel(int x, int y, uint16_t color);
+    void drawHLine(int x, int y, int w, uint16_t color);
+    void drawVLine(int x, int y, int h, uint16_t color);
+    void drawRect(int x, int y, int w, int h, uint16_t color);
+    void fillRect(int x, int y, int w, int h, uint16_t color);
+    void fillScreen(uint16_t color);
+
+    // "bitmap" is 1 bit per pixel, MSB first, each row padded to a byte;
+    // clear bits are left alone.
+    void drawBitmap(int x, int y, const uint8_t *bitmap, int w, int h, uint16_t color);
+
+    void invalidate(int x, int y, int w, int h);
+
+    bool update(void(*callback)(void) = NULL);
+    bool done();
+    void flush();
+
+    static uint16_t color565(uint8_t red, uint8_t green, uint8_t blue) {
+	return (((red & 0xf8) << 8) | ((green & 0xfc) << 3) | (blue >> 3));
+    }
+
+protected:
+    struct Segment {
+	uint8_t dc;
+	uint8_t count;
+	uint8_t data[6];
+    };
+
+    Display(SPIClass &spi, uint32_t cs, uint32_t dc, uint32_t reset, uint16_t width, uint16_t height, uint32_t clock);
+
+    bool start();
+    void command(uint8_t dc, const uint8_t *data, size_t count);
+
+    // Controller specific parts: write/fill pixels (already clipped), round
+    // a dirty rectangle to what the controller can address, set up the
+    // window for a rectangle as D/C framed segments, and return the
+    // framebuffer span of line "index" of a rectangle (0 past the end).
+    virtual void setPixel(int x, int y, uint16_t color) = 0;
+    virtual void fill(const DisplayRect &rect, uint16_t color) = 0;
+    virtual void align(DisplayRect &rect) = 0;
+    virtual unsigned int window(const DisplayRect &rect, Segment *segments) = 0;
+    virtual size_t line(const DisplayRect &rect, unsigned int index, const uint8_t **p_data) = 0;
+
+    uint16_t _width;
+    uint16_t _height;
+
+private:
+    SPIClass *_spi;
+    SPISettings _settings;
+    uint32_t _cs;
+    uint32_t _dc;
+    uint32_t _reset;
+    int8_t _slot;
+
+    DisplayRect _dirty[DISPLAY_DIRTY_COUNT];
+    unsigned int _dirtyCount;
+
+    volatile bool _busy;
+    bool _started;
+    void (*_callback)(void);
+    DisplayRect _rects[DISPLAY_DIRTY_COUNT];
+    unsigned int _rectCount;
+    unsigned int _rectIndex;
+    Segment _segments[5];
+    unsigned int _segmentCount;
+    unsigned int _segmentIndex;
+    unsigned int _lineIndex;
+    SPITransaction _transactions[DISPLAY_QUEUE_SIZE];
+
+    void mark(DisplayRect rect);
+    void next();
+
+    static Display *_displays[DISPLAY_COUNT];
+    template<unsigned int N> static void _spiCallback(void);
+};
+
+// SSD1306 monochrome OLED, 128x64 or 128x32.
+class SSD1306Display : public Display
+{
+public:
+    bool begin();
+
+protected:
+    SSD1306Display(SPIClass &spi, uint32_t cs, uint32_t dc, uint32_t reset, uint16_t width, uint16_t height, uint8_t *buffer);
+
+    void setPixel(int x, int y, uint16_t color) override;
+    void fill(const DisplayRect &rect, uint16_t color) override;
+    void align(DisplayRect &rect) override;
+    unsigned int window(const DisplayRect &rect, Segment *segments) override;
+    size_t line(const DisplayRect &rect, unsigned int index, const uint8_t **p_data) override;
+
+private:
+    uint8_t *_buffer;
+};
+
+// ST7789 RGB565 TFT. "xOffset"/"yOffset" are where the panel sits in the
+// 240x320 controller RAM (e.g. 52/40 for 135x240 panels).
+class ST7789Display : public Display
+{
+public:
+    bool begin(uint16_t xOffset = 0, uint16_t yOffset = 0);
+
+protected:
+    ST7789Display(SPIClass &spi, uint32_t cs, uint32_t dc, uint32_t reset, uint16_t width, uint16_t height, uint16_t *buffer);
+
+    void setPixel(int x, int y, uint16_t color) override;
+    void fill(const DisplayRect &rect, uint16_t color) override;
+    void align(DisplayRect &rect) override;
+    unsigned int window(const DisplayRect &rect, Segment *segments) override;
+    size_t line(const DisplayRect &rect, unsigned int index, const uint8_t **p_data) override;
+
+private:
+    uint16_t *_buffer;  // byte swapped, i.e. in the order the panel wants it
+    uint16_t _xOffset;
+    uint16_t _yOffset;
+};
+
+// Displays with their framebuffer, for example "ST7789<240, 240> tft(SPI2, 10, 9, 8);"
+template<uint16_t W, uint16_t H> class SSD1306 : public SSD1306Display
+{
+public:
+    SSD1306(SPIClass &spi, uint32_t cs, uint32_t dc, uint32_t reset = DISPLAY_NO_PIN) : SSD1306Display(spi, cs, dc, reset, W, H, &_frameData[0]) { }
+
+private:
+    uint8_t _frameData[W * (H / 8)];
+};
+
+template<uint16_t W, uint16_t H> class ST7789 : public ST7789Display
+{
+public:
+    ST7789(SPIClass &spi, uint32_t cs, uint32_t dc, uint32_t reset = DISPLAY_NO_PIN) : ST7789Display(spi, cs, dc, reset, W, H, &_frameData[0]) { }
+
+private:
+    uint16_t _frameData[W * H];
+};
+
+#endif // _DISPLAY_H_INCLUDED
@@ -140,6 +140,9 @@ struct EEPROMClass{
 	eeprom_write_block(ptr, (void *)idx, sizeof(T));
         return t;
     }
+
+    //STM32L4 EXTENSION: erase ahead in the background, see eeprom_compact().
+    bool compact()                       { return eeprom_compact(); }
 };
 
 static EEPROMClass EEPROM;
@@ -0,0 +1,36 @@
+/*
+  Encoder
+
+  Reads a mechanical rotary encoder in hardware and prints its position
+  whenever it changes. The encoder's A/B outputs are on pin 10 (PA15,
+  TIM2_CH1) and A5 (PA1, TIM2_CH2) of a Butterfly, with the common pin
+  to GND.
+
+  This example code is in the public domain.
+*/
+
+#include <Encoder.h>
+
+Encoder knob(10, A5);
+
+int32_t position = 0;
+
+void setup()
+{
+  Serial.begin(9600);
+
+  // Both edges of both channels, internal pullups, strongest input filter
+  knob.begin(ENCODER_MODE_X4 | ENCODER_PULLUP, 15);
+}
+
+void loop()
+{
+  int32_t current = knob.read();
+
+  if (current != position)
+  {
+    position = current;
+
+    Serial.println(position);
+  }
+}
@@ -0,0 +1,50 @@
+/*
+  Frequency
+
+  Measures the frequency of a signal on pin 10 (PA15, TIM2_CH1) of a
+  Butterfly twice: from the last period seen by the capture interrupt,
+  and as the average of a burst of 64 rising edges captured via DMA.
+
+  This example code is in the public domain.
+*/
+
+#include <InputCapture.h>
+
+InputCapture input(10);
+
+uint16_t edges[64];
+
+void setup()
+{
+  Serial.begin(9600);
+
+  // 1 MHz timebase, so periods are in microseconds
+  input.begin(1000000, RISING);
+}
+
+void loop()
+{
+  Serial.print("Last period: ");
+  Serial.print(input.period());
+  Serial.print("us, ");
+  Serial.print(input.frequency());
+  Serial.println("Hz");
+
+  if (input.capture(edges, 64))
+  {
+    while (!input.done())
+    {
+    }
+
+    uint32_t period = InputCapture::period(edges, 64);
+
+    if (period)
+    {
+      Serial.print("Average of 63 periods: ");
+      Serial.print((float)input.clock() / (float)period);
+      Serial.println("Hz");
+    }
+  }
+
+  delay(1000);
+}
@@ -0,0 +1,205 @@
+/*
+ * Copyright (c) 2017 Thomas Roell.  All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal with the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ *  1. Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimers.
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimers in the
+ *     documentation and/or other materials provided with the distribution.
+ *  3. Neither the name of Thomas Roell, nor the names of its contributors
+ *     may be used to endorse or promote products derived from this Software
+ *     without specific prior written permission.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ * CONTRIBUTORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * WITH THE SOFTWARE.
+ */
+
+#include "Arduino.h"
+#include "stm32l4_wiring_private.h"
+#include "Encoder.h"
+
+Encoder::Encoder(uint32_t pinA, uint32_t pinB)
+{
+    _pinA = pinA;
+    _pinB = pinB;
+    _high = 0;
+
+    _timer.state = TIMER_STATE_NONE;
+}
+
+Encoder::~Encoder()
+{
+    end();
+}
+
+bool Encoder::begin(uint32_t mode, unsigned int filter)
+{
+    unsigned int instance;
+    uint32_t option, control, pupd;
+
+    if (_timer.state != TIMER_STATE_NONE) {
+	return false;
+    }
+
+    if ((_pinA >= NUM_TOTAL_PINS) || (_pinB >= NUM_TOTAL_PINS)) {
+	return false;
+    }
+
+    if (!(g_APinDescription[_pinA].attr & PIN_ATTR_PWM) || !(g_APinDescription[_pinB].attr & PIN_ATTR_PWM)) {
+	return false;
+    }
+
+    if ((g_APinDescription[_pinA].pwm_instance != g_APinDescription[_pinB].pwm_instance) ||
+	(g_APinDescription[_pinA].pwm_channel != PWM_CHANNEL_1) ||
+	(g_APinDescription[_pinB].pwm_channel != PWM_CHANNEL_2)) {
+	return false;
+    }
+
+    instance = g_PWMInstances[g_APinDescription[_pinA].pwm_instance];
+
+    // TIM15/TIM16/TIM17 have no encoder mode.
+    if ((instance == TIMER_INSTANCE_TIM15) || (instance == TIMER_INSTANCE_TIM16)
+#ifdef TIM17_BASE
+	|| (instance == TIMER_INSTANCE_TIM17)
+#endif
+	) {
+	return false;
+    }
+
+    option = (mode & ENCODER_MODE_X4) ? TIMER_OPTION_ENCODER_MODE_CHANNEL_1_OR_2 : TIMER_OPTION_ENCODER_MODE_CHANNEL_1;
+    control = TIMER_CONTROL_CAPTURE_FILTER(filter);
+    pupd = (mode & ENCODER_PULLUP) ? GPIO_PUPD_PULLUP : GPIO_PUPD_NONE;
+
+    if (!stm32l4_timer_create(&_timer, instance, STM32L4_EXTI_IRQ_PRIORITY, 0)) {
+	return false;
+    }
+
+    stm32l4_timer_enable(&_timer, 0, 0xffff, option, Encoder::_eventCallback, (void*)this, TIMER_EVENT_PERIOD);
+
+    // Both inputs are plain (non capture) inputs, which in encoder mode feed the counter.
+    stm32l4_timer_channel(&_timer, TIMER_CHANNEL_1, 0, control);
+    stm32l4_timer_channel(&_timer, TIMER_CHANNEL_2, 0, (control | ((mode & ENCODER_INVERT) ? TIMER_CONTROL_CAPTURE_POLARITY : 0)));
+
+    // With UIFREMAP a still pending overflow shows up in bit 31 of CNT, so that read()
+    // can account for it without a race against the interrupt handler.
+    armv7m_atomic_or(&_timer.TIM->CR1, TIM_CR1_UIFREMAP);
+
+    _timer.TIM->CNT = 0;
+
+    stm32l4_gpio_pin_configure(g_APinDescription[_pinA].pin, (pupd | GPIO_MODE_ALTERNATE));
+    stm32l4_gpio_pin_configure(g_APinDescription[_pinB].pin, (pupd | GPIO_MODE_ALTERNATE));
+
+    stm32l4_timer_start(&_timer, false);
+
+    return true;
+}
+
+void Encoder::end()
+{
+    if (_timer.state == TIMER_STATE_NONE) {
+	return;
+    }
+
+    _high = read();
+
+    stm32l4_timer_stop(&_timer);
+    stm32l4_timer_disable(&_timer);
+    stm32l4_timer_destroy(&_timer);
+
+    stm32l4_gpio_pin_configure(g_APinDescription[_pinA].pin, (GPIO_PUPD_NONE | GPIO_MODE_ANALOG));
+    stm32l4_gpio_pin_configure(g_APinDescription[_pinB].pin, (GPIO_PUPD_NONE | GPIO_MODE_ANALOG));
+}
+
+int32_t Encoder::read()
+{
+    int32_t high;
+    uint32_t count;
+
+    if (_timer.state != TIMER_STATE_ACTIVE) {
+	return _high;
+    }
+
+    do {
+	high = _high;
+	count = _timer.TIM->CNT;
+    } while (high != _high);
+
+    if (count & TIM_CNT_UIFCPY) {
+	// Overflow not yet seen by _eventCallback(): a small count means it wrapped upwards.
+	count &= 0xffff;
+
+	high += ((count < 0x8000) ? 0x10000 : -0x10000);
+    } else {
+	count &= 0xffff;
+    }
+
+    return high + (int32_t)count;
+}
+
+void Encoder::write(int32_t position)
+{
+    if (_timer.state != TIMER_STATE_ACTIVE) {
+	_high = position;
+
+	return;
+    }
+
+    noInterrupts();
+
+    reset(position);
+
+    interrupts();
+}
+
+int32_t Encoder::readAndReset()
+{
+    int32_t position;
+
+    noInterrupts();
+
+    position = read();
+
+    if (_timer.state == TIMER_STATE_ACTIVE) {
+	reset(0);
+    } else {
+	_high = 0;
+    }
+
+    interrupts();
+
+    return position;
+}
+
+// Has to be called with interrupts masked.
+void Encoder::reset(int32_t position)
+{
+    _timer.TIM->SR = ~TIM_SR_UIF;
+    _timer.TIM->CNT = (uint32_t)position & 0xffff;
+
+    _high = position - (int32_t)((uint32_t)position & 0xffff);
+}
+
+void Encoder::_eventCallback(void *context, uint32_t events)
+{
+    Encoder *self = reinterpret_cast<class Encoder*>(context);
+
+    // The counter cannot have moved far since the overflow, so its value tells the
+    // direction more reliably than DIR, which may have changed in the meantime.
+    if ((self->_timer.TIM->CNT & 0xffff) < 0x8000) {
+	self->_high += 0x10000;
+    } else {
+	self->_high -= 0x10000;
+    }
+}
@@ -0,0 +1,76 @@
+/*
+ * Copyright (c) 2017 Thomas Roell.  All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal with the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ *  1. Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimers.
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimers in the
+ *     documentation and/or other materials provided with the distribution.
+ *  3. Neither the name of Thomas Roell, nor the names of its contributors
+ *     may be used to endorse or promote products derived from this Software
+ *     without specific prior written permission.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ * CONTRIBUTORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * WITH THE SOFTWARE.
+ */
+
+#ifndef _ENCODER_H_INCLUDED
+#define _ENCODER_H_INCLUDED
+
+#include <Arduino.h>
+
+#include "stm32l4_timer.h"
+
+// Count edges of channel 1 only (2 counts per cycle), or of both
+// channels (4 counts per cycle). ENCODER_INVERT swaps the direction,
+// ENCODER_PULLUP enables the pin pullups (e.g. for mechanical encoders).
+#define ENCODER_MODE_X2  0x00000001
+#define ENCODER_MODE_X4  0x00000002
+#define ENCODER_INVERT   0x00000100
+#define ENCODER_PULLUP   0x00000200
+
+// Quadrature decoding in hardware.
+//
+// "pinA" and "pinB" have to be the channel 1 and channel 2 PWM pins of the
+// same timer (TIM1, TIM2, TIM3, TIM4, TIM5 or TIM8), which then cannot be
+// used for analogWrite(). Pins routed to a complementary output (CHxN)
+// cannot be used, as those are output only. The 16 bit hardware counter is extended to 32
+// bits by an overflow interrupt; apart from that no CPU time is spent on
+// decoding. "filter" (0 - 15) is the digital input filter of the timer.
+class Encoder
+{
+public:
+    Encoder(uint32_t pinA, uint32_t pinB);
+    ~Encoder();
+
+    bool begin(uint32_t mode = ENCODER_MODE_X4, unsigned int filter = 0);
+    void end();
+
+    int32_t read();
+    void write(int32_t position);
+    int32_t readAndReset();
+
+private:
+    uint8_t _pinA;
+    uint8_t _pinB;
+    volatile int32_t _high;
+    stm32l4_timer_t _timer;
+
+    void reset(int32_t position);
+
+    static void _eventCallback(void *context, uint32_t events);
+};
+
+#endif // _ENCODER_H_INCLUDED
@@ -0,0 +1,235 @@
+/*
+ * Copyright (c) 2017 Thomas Roell.  All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal with the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ *  1. Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimers.
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimers in the
+ *     documentation and/or other materials provided with the distribution.
+ *  3. Neither the name of Thomas Roell, nor the names of its contributors
+ *     may be used to endorse or promote products derived from this Software
+ *     without specific prior written permission.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ * CONTRIBUTORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * WITH THE SOFTWARE.
+ */
+
+#include "Arduino.h"
+#include "stm32l4_wiring_private.h"
+#include "InputCapture.h"
+
+InputCapture::InputCapture(uint32_t pin)
+{
+    _pin = pin;
+    _channel = 0;
+    _valid = false;
+    _last = 0;
+    _overflows = 0;
+    _period = 0;
+    _captures = 0;
+    _clock = 0;
+    _captureCallback = NULL;
+
+    _timer.state = TIMER_STATE_NONE;
+}
+
+InputCapture::~InputCapture()
+{
+    end();
+}
+
+bool InputCapture::begin(uint32_t frequency, uint32_t edge, unsigned int filter)
+{
+    uint32_t clock, prescaler, control;
+
+    if (_timer.state != TIMER_STATE_NONE) {
+	return false;
+    }
+
+    if ((_pin >= NUM_TOTAL_PINS) || !(g_APinDescription[_pin].attr & PIN_ATTR_PWM) || (g_APinDescription[_pin].pwm_channel > PWM_CHANNEL_4)) {
+	return false;
+    }
+
+    switch (edge) {
+    case RISING:
+	control = TIMER_CONTROL_CAPTURE_RISING_EDGE;
+	break;
+    case FALLING:
+	control = TIMER_CONTROL_CAPTURE_FALLING_EDGE;
+	break;
+    case CHANGE:
+	control = TIMER_CONTROL_CAPTURE_BOTH_EDGES;
+	break;
+    default:
+	return false;
+    }
+
+    if (!stm32l4_timer_create(&_timer, g_PWMInstances[g_APinDescription[_pin].pwm_instance], STM32L4_EXTI_IRQ_PRIORITY, 0)) {
+	return false;
+    }
+
+    clock = stm32l4_timer_clock(&_timer);
+
+    prescaler = (frequency && (frequency < clock)) ? ((clock / frequency) -1) : 0;
+
+    if (prescaler > 65535) {
+	prescaler = 65535;
+    }
+
+    _channel = g_APinDescription[_pin].pwm_channel;
+    _clock = clock / (prescaler +1);
+    _valid = false;
+    _overflows = 0;
+    _period = 0;
+    _captures = 0;
+
+    // All timers run 16 bit wide, so that captures and overflows are handled the same way.
+    stm32l4_timer_enable(&_timer, prescaler, 0xffff, 0, InputCapture::_eventCallback, (void*)this, (TIMER_EVENT_PERIOD | (TIMER_EVENT_CHANNEL_1 << _channel)));
+    stm32l4_timer_channel(&_timer, _channel, 0, (control | TIMER_CONTROL_CAPTURE_FILTER(filter)));
+
+    // Load the prescaler now rather than at the first overflow.
+    _timer.TIM->EGR = TIM_EGR_UG;
+
+    stm32l4_gpio_pin_configure(g_APinDescription[_pin].pin, (GPIO_PUPD_NONE | GPIO_MODE_ALTERNATE));
+
+    stm32l4_timer_start(&_timer, false);
+
+    return true;
+}
+
+void InputCapture::end()
+{
+    if (_timer.state == TIMER_STATE_NONE) {
+	return;
+    }
+
+    stm32l4_timer_stop(&_timer);
+    stm32l4_timer_disable(&_timer);
+    stm32l4_timer_destroy(&_timer);
+
+    stm32l4_gpio_pin_configure(g_APinDescription[_pin].pin, (GPIO_PUPD_NONE | GPIO_MODE_ANALOG));
+
+    _captureCallback = NULL;
+}
+
+uint32_t InputCapture::clock()
+{
+    return _clock;
+}
+
+uint32_t InputCapture::period()
+{
+    return _period;
+}
+
+float InputCapture::frequency()
+{
+    uint32_t period = _period;
+
+    if (!period) {
+	return 0.0f;
+    }
+
+    return (float)_clock / (float)period;
+}
+
+uint32_t InputCapture::captures()
+{
+    return _captures;
+}
+
+bool InputCapture::capture(uint16_t *buffer, size_t count, void(*callback)(void))
+{
+    if ((_timer.state != TIMER_STATE_ACTIVE) || (count == 0) || (count > 65535)) {
+	return false;
+    }
+
+    _captureCallback = callback;
+
+    return stm32l4_timer_capture_stream(&_timer, _channel, buffer, count, InputCapture::_streamCallback, (void*)this);
+}
+
+bool InputCapture::done()
+{
+    if (_timer.state != TIMER_STATE_ACTIVE) {
+	return true;
+    }
+
+    return stm32l4_timer_stream_done(&_timer);
+}
+
+uint32_t InputCapture::period(const uint16_t *buffer, size_t count)
+{
+    if (count < 2) {
+	return 0;
+    }
+
+    // Each period has to be below 65536 ticks. The modulo 2^16 differences of
+    // consecutive entries then sum up to the distance of the first and last.
+    uint32_t total = 0;
+
+    for (size_t index = 1; index < count; index++) {
+	total += (uint16_t)(buffer[index] - buffer[index -1]);
+    }
+
+    return (total + ((count -1) / 2)) / (count -1);
+}
+
+void InputCapture::_eventCallback(void *context, uint32_t events)
+{
+    InputCapture *self = reinterpret_cast<class InputCapture*>(context);
+    uint32_t capture, overflows;
+    bool wrapped;
+
+    overflows = self->_overflows;
+    wrapped = !!(events & TIMER_EVENT_PERIOD);
+
+    if (events & (TIMER_EVENT_CHANNEL_1 << self->_channel)) {
+	capture = stm32l4_timer_capture(&self->_timer, self->_channel) & 0xffff;
+
+	// If both flags are seen together, a small capture value means the edge
+	// came after the overflow.
+	if (wrapped && (capture < 0x8000)) {
+	    overflows++;
+	    wrapped = false;
+	}
+
+	if (self->_valid) {
+	    self->_period = (overflows << 16) + capture - self->_last;
+	}
+
+	self->_last = capture;
+	self->_valid = true;
+	self->_captures++;
+
+	overflows = 0;
+    }
+
+    if (wrapped && (overflows != 0xffff)) {
+	overflows++;
+    }
+
+    self->_overflows = overflows;
+}
+
+void InputCapture::_streamCallback(void *context, uint32_t events)
+{
+    InputCapture *self = reinterpret_cast<class InputCapture*>(context);
+    void (*callback)(void) = self->_captureCallback;
+
+    if (callback) {
+	(*callback)();
+    }
+}
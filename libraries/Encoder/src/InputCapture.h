@@ -0,0 +1,86 @@
+/*
+ * Copyright (c) 2017 Thomas Roell.  All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal with the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ *  1. Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimers.
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimers in the
+ *     documentation and/or other materials provided with the distribution.
+ *  3. Neither the name of Thomas Roell, nor the names of its contributors
+ *     may be used to endorse or promote products derived from this Software
+ *     without specific prior written permission.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ * CONTRIBUTORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * WITH THE SOFTWARE.
+ */
+
+#ifndef _INPUT_CAPTURE_H_INCLUDED
+#define _INPUT_CAPTURE_H_INCLUDED
+
+#include <Arduino.h>
+
+#include "stm32l4_timer.h"
+
+// Period and frequency measurement via timer input capture.
+//
+// "pin" has to be a PWM pin that is not routed to a complementary output
+// (CHxN, which are output only); its timer is counting at "frequency" (which
+// is rounded to a divider of the timer clock, see clock()) and cannot be
+// used for analogWrite() at the same time. "edge" is RISING, FALLING or
+// CHANGE, "filter" (0 - 15) the digital input filter of the timer.
+//
+// Each captured edge updates period() from an interrupt handler, where
+// counter overflows are taken into account, so that long periods are
+// measured correctly. Alternatively capture() records the raw 16 bit
+// timestamps of the next "count" edges into "buffer" via DMA, without
+// any CPU involvement; period(buffer, count) then returns the average
+// period of that burst.
+class InputCapture
+{
+public:
+    InputCapture(uint32_t pin);
+    ~InputCapture();
+
+    bool begin(uint32_t frequency = 1000000, uint32_t edge = RISING, unsigned int filter = 0);
+    void end();
+
+    uint32_t clock();
+
+    uint32_t period();
+    float frequency();
+    uint32_t captures();
+
+    bool capture(uint16_t *buffer, size_t count, void(*callback)(void) = NULL);
+    bool done();
+
+    static uint32_t period(const uint16_t *buffer, size_t count);
+
+private:
+    uint8_t _pin;
+    uint8_t _channel;
+    volatile bool _valid;
+    uint16_t _last;
+    volatile uint16_t _overflows;
+    volatile uint32_t _period;
+    volatile uint32_t _captures;
+    uint32_t _clock;
+    void (*_captureCallback)(void);
+    stm32l4_timer_t _timer;
+
+    static void _eventCallback(void *context, uint32_t events);
+    static void _streamCallback(void *context, uint32_t events);
+};
+
+#endif // _INPUT_CAPTURE_H_INCLUDED
@@ -0,0 +1,48 @@
+/*
+  FSBench
+
+  Runs the DOSFS benchmarks on the board's storage (SD card or SPI flash)
+  and prints the results in a comma separated format over Serial. Lines
+  start with "FSBENCH," so they can be filtered out of a capture and fed
+  into a script.
+
+  WARNING: this creates and deletes "FSBENCH.DAT" on the file system.
+
+  This example code is in the public domain.
+*/
+
+#include <FS.h>
+#include <FSBench.h>
+
+// 16kB per sequential read/write call
+uint32_t buffer[16384 / 4];
+
+FSBenchClass bench(buffer, sizeof(buffer));
+
+void setup()
+{
+  Serial.begin(9600);
+
+  while (!Serial) { }
+
+  if (!DOSFS.begin()) {
+    Serial.println("FSBENCH,error,begin");
+    return;
+  }
+
+  bench.begin(Serial, "FSBENCH.DAT", 4 * 1024 * 1024);
+
+  if (!bench.run(256)) {
+    Serial.println("FSBENCH,error,run");
+  }
+
+  bench.end();
+
+  DOSFS.end();
+
+  Serial.println("FSBENCH,done");
+}
+
+void loop()
+{
+}
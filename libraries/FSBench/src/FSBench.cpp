@@ -0,0 +1,434 @@
+/*
+ * Copyright (c) 2016 Thomas Roell.  All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal with the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ *  1. Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimers.
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimers in the
+ *     documentation and/or other materials provided with the distribution.
+ *  3. Neither the name of Thomas Roell, nor the names of its contributors
+ *     may be used to endorse or promote products derived from this Software
+ *     without specific prior written permission.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ * CONTRIBUTORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * WITH THE SOFTWARE.
+ */
+
+#include "Arduino.h"
+#include "FSBench.h"
+
+static inline uint32_t fsbench_cycles(void)
+{
+    return DWT->CYCCNT;
+}
+
+static inline uint32_t fsbench_microseconds(uint64_t cycles)
+{
+    return (uint32_t)((cycles * 1000000ull) / SystemCoreClock);
+}
+
+FSBenchHistogram::FSBenchHistogram()
+{
+    reset();
+}
+
+void FSBenchHistogram::reset()
+{
+    unsigned int index;
+
+    _count = 0;
+    _min = 0xffffffff;
+    _max = 0;
+    _sum = 0;
+
+    for (index = 0; index < FSBENCH_HISTOGRAM_BUCKETS; index++) {
+	_bucket[index] = 0;
+    }
+}
+
+void FSBenchHistogram::add(uint32_t cycles)
+{
+    uint32_t us;
+    unsigned int index;
+
+    _count++;
+    _sum += cycles;
+
+    if (_min > cycles) {
+	_min = cycles;
+    }
+
+    if (_max < cycles) {
+	_max = cycles;
+    }
+
+    us = fsbench_microseconds(cycles);
+    index = us ? (31 - __builtin_clz(us)) : 0;
+
+    if (index >= FSBENCH_HISTOGRAM_BUCKETS) {
+	index = FSBENCH_HISTOGRAM_BUCKETS -1;
+    }
+
+    _bucket[index]++;
+}
+
+void FSBenchHistogram::report(Print &out, const char *name) const
+{
+    unsigned int index;
+
+    if (!_count) {
+	return;
+    }
+
+    out.print("FSBENCH,");
+    out.print(name);
+    out.print(",ops=");
+    out.print(_count);
+    out.print(",min=");
+    out.print(fsbench_microseconds(_min));
+    out.print(",avg=");
+    out.print(fsbench_microseconds(_sum / _count));
+    out.print(",max=");
+    out.println(fsbench_microseconds(_max));
+
+    for (index = 0; index < FSBENCH_HISTOGRAM_BUCKETS; index++) {
+	if (_bucket[index]) {
+	    out.print("FSBENCH,");
+	    out.print(name);
+	    out.print(",hist,");
+	    out.print(1ul << index);
+	    out.print(",");
+	    out.println(_bucket[index]);
+	}
+    }
+}
+
+FSBenchClass::FSBenchClass(void *buffer, size_t size)
+{
+    _out = NULL;
+    _data = (uint8_t*)buffer;
+    _size = size & ~(F_SECTOR_SIZE -1);
+    _path = NULL;
+    _fileSize = 0;
+}
+
+bool FSBenchClass::begin(Print &out, const char *path, size_t fileSize)
+{
+    size_t index;
+
+    if (!_size) {
+	return false;
+    }
+
+    _out = &out;
+    _path = path;
+    _fileSize = (fileSize / _size) * _size;
+
+    if (_fileSize < _size) {
+	_fileSize = _size;
+    }
+
+    for (index = 0; index < _size; index++) {
+	_data[index] = index;
+    }
+
+    CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+    DWT->CYCCNT = 0;
+    DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+
+    randomSeed(DWT->CYCCNT);
+
+    return true;
+}
+
+void FSBenchClass::end()
+{
+    if (_path) {
+	DOSFS.remove(_path);
+    }
+
+    _out = NULL;
+    _path = NULL;
+}
+
+bool FSBenchClass::run(unsigned int count)
+{
+    if (!_out) {
+	return false;
+    }
+
+    return (sequentialWrite() &&
+	    sequentialRead() &&
+	    randomWrite(count) &&
+	    randomRead(count) &&
+	    openLatency(count) &&
+	    seekLatency(count));
+}
+
+bool FSBenchClass::sequentialWrite()
+{
+    uint32_t start, cycles, offset;
+    uint64_t total;
+    File file;
+
+    if (!_out) {
+	return false;
+    }
+
+    _histogram.reset();
+
+    total = 0;
+
+    start = fsbench_cycles();
+    file = DOSFS.open(_path, "w");
+    cycles = fsbench_cycles() - start;
+
+    if (!file) {
+	return false;
+    }
+
+    total += cycles;
+
+    for (offset = 0; offset < _fileSize; offset += _size) {
+	start = fsbench_cycles();
+
+	if (file.write(_data, _size) != _size) {
+	    file.close();
+
+	    return false;
+	}
+
+	cycles = fsbench_cycles() - start;
+
+	_histogram.add(cycles);
+
+	total += cycles;
+    }
+
+    start = fsbench_cycles();
+    file.close();
+    total += (fsbench_cycles() - start);
+
+    throughput("seq_write", _fileSize, _fileSize / _size, total);
+
+    _histogram.report(*_out, "f_write");
+
+    return true;
+}
+
+bool FSBenchClass::sequentialRead()
+{
+    uint32_t start, offset;
+    uint64_t total;
+    File file;
+
+    if (!_out) {
+	return false;
+    }
+
+    total = 0;
+
+    start = fsbench_cycles();
+    file = DOSFS.open(_path, "rS");
+
+    if (!file) {
+	return false;
+    }
+
+    for (offset = 0; offset < _fileSize; offset += _size) {
+	if (file.read(_data, _size) != _size) {
+	    file.close();
+
+	    return false;
+	}
+    }
+
+    file.close();
+    total += (fsbench_cycles() - start);
+
+    throughput("seq_read", _fileSize, _fileSize / _size, total);
+
+    return true;
+}
+
+bool FSBenchClass::randomWrite(unsigned int count)
+{
+    uint32_t start, chunk;
+    uint64_t total;
+    unsigned int index;
+    File file;
+
+    if (!_out) {
+	return false;
+    }
+
+    chunk = (_size < 4096) ? _size : 4096;
+    total = 0;
+
+    file = DOSFS.open(_path, "r+R");
+
+    if (!file) {
+	return false;
+    }
+
+    for (index = 0; index < count; index++) {
+	start = fsbench_cycles();
+
+	if (!file.seek(randomOffset(chunk)) || (file.write(_data, chunk) != chunk)) {
+	    file.close();
+
+	    return false;
+	}
+
+	total += (fsbench_cycles() - start);
+    }
+
+    start = fsbench_cycles();
+    file.close();
+    total += (fsbench_cycles() - start);
+
+    throughput("rand_write", chunk * count, count, total);
+
+    return true;
+}
+
+bool FSBenchClass::randomRead(unsigned int count)
+{
+    uint32_t start, chunk;
+    uint64_t total;
+    unsigned int index;
+    File file;
+
+    if (!_out) {
+	return false;
+    }
+
+    chunk = (_size < 4096) ? _size : 4096;
+    total = 0;
+
+    file = DOSFS.open(_path, "rR");
+
+    if (!file) {
+	return false;
+    }
+
+    for (index = 0; index < count; index++) {
+	start = fsbench_cycles();
+
+	if (!file.seek(randomOffset(chunk)) || (file.read(_data, chunk) != chunk)) {
+	    file.close();
+
+	    return false;
+	}
+
+	total += (fsbench_cycles() - start);
+    }
+
+    file.close();
+
+    throughput("rand_read", chunk * count, count, total);
+
+    return true;
+}
+
+bool FSBenchClass::openLatency(unsigned int count)
+{
+    uint32_t start;
+    unsigned int index;
+    File file;
+
+    if (!_out) {
+	return false;
+    }
+
+    _histogram.reset();
+
+    for (index = 0; index < count; index++) {
+	start = fsbench_cycles();
+	file = DOSFS.open(_path, "r");
+	
+	if (!file) {
+	    return false;
+	}
+
+	_histogram.add(fsbench_cycles() - start);
+
+	file.close();
+    }
+
+    _histogram.report(*_out, "f_open");
+
+    return true;
+}
+
+bool FSBenchClass::seekLatency(unsigned int count)
+{
+    uint32_t start;
+    unsigned int index;
+    File file;
+
+    if (!_out) {
+	return false;
+    }
+
+    _histogram.reset();
+
+    file = DOSFS.open(_path, "r");
+
+    if (!file) {
+	return false;
+    }
+
+    for (index = 0; index < count; index++) {
+	start = fsbench_cycles();
+
+	if (!file.seek(randomOffset(1))) {
+	    file.close();
+
+	    return false;
+	}
+
+	_histogram.add(fsbench_cycles() - start);
+    }
+
+    file.close();
+
+    _histogram.report(*_out, "f_seek");
+
+    return true;
+}
+
+void FSBenchClass::throughput(const char *name, uint32_t bytes, uint32_t ops, uint64_t cycles)
+{
+    uint32_t us;
+
+    us = fsbench_microseconds(cycles);
+
+    _out->print("FSBENCH,");
+    _out->print(name);
+    _out->print(",bytes=");
+    _out->print(bytes);
+    _out->print(",ops=");
+    _out->print(ops);
+    _out->print(",us=");
+    _out->print(us);
+    _out->print(",MBps=");
+    _out->println(us ? (((float)bytes / (float)us) * (1000000.0f / 1048576.0f)) : 0.0f, 3);
+}
+
+uint32_t FSBenchClass::randomOffset(size_t chunk)
+{
+    return random(_fileSize / chunk) * chunk;
+}
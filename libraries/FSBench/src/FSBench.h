@@ -0,0 +1,99 @@
+/*
+ * Copyright (c) 2016 Thomas Roell.  All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal with the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ *  1. Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimers.
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimers in the
+ *     documentation and/or other materials provided with the distribution.
+ *  3. Neither the name of Thomas Roell, nor the names of its contributors
+ *     may be used to endorse or promote products derived from this Software
+ *     without specific prior written permission.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ * CONTRIBUTORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * WITH THE SOFTWARE.
+ */
+
+#ifndef _FSBENCH_H_INCLUDED
+#define _FSBENCH_H_INCLUDED
+
+#include <Arduino.h>
+#include <FS.h>
+
+// Latencies are collected into power of two buckets of microseconds, i.e.
+// bucket N counts operations that took [2^N, 2^(N+1)) us (bucket 0 also
+// holds everything below 1us).
+#define FSBENCH_HISTOGRAM_BUCKETS 20
+
+class FSBenchHistogram
+{
+public:
+    FSBenchHistogram();
+
+    void reset();
+    void add(uint32_t cycles);
+    void report(Print &out, const char *name) const;
+
+private:
+    uint32_t _count;
+    uint32_t _min;
+    uint32_t _max;
+    uint64_t _sum;
+    uint32_t _bucket[FSBENCH_HISTOGRAM_BUCKETS];
+};
+
+// Drives the FS/File API against whatever storage the board's DOSFS sits on
+// (SDSPI, SDMMC or SFLASH) and reports the results over a Print in a line
+// oriented, comma separated format:
+//
+//   FSBENCH,<test>,bytes=<n>,ops=<n>,us=<n>,MBps=<n.nnn>
+//   FSBENCH,<test>,ops=<n>,min=<us>,avg=<us>,max=<us>
+//   FSBENCH,<test>,hist,<bucket>,<count>
+//
+// All timing is done with the DWT cycle counter. DOSFS.begin() needs to
+// have been called before.
+class FSBenchClass
+{
+public:
+    // "buffer" is the transfer buffer, "size" the length of each read/write
+    // call for the sequential tests; the random tests use 4096 (or "size" if
+    // smaller)
+    FSBenchClass(void *buffer, size_t size);
+
+    bool begin(Print &out, const char *path = "FSBENCH.DAT", size_t fileSize = 1024 * 1024);
+    void end();
+
+    bool run(unsigned int count = 256);
+
+    bool sequentialWrite();
+    bool sequentialRead();
+    bool randomWrite(unsigned int count);
+    bool randomRead(unsigned int count);
+    bool openLatency(unsigned int count);
+    bool seekLatency(unsigned int count);
+
+private:
+    Print *_out;
+    uint8_t *_data;
+    size_t _size;
+    const char *_path;
+    size_t _fileSize;
+    FSBenchHistogram _histogram;
+
+    void throughput(const char *name, uint32_t bytes, uint32_t ops, uint64_t cycles);
+    uint32_t randomOffset(size_t chunk);
+};
+
+#endif
@@ -0,0 +1,253 @@
+/*
+  FastMathBench
+
+  Times the FastMath functions against their libm (and map()) counterparts
+  on a table of 64 arguments per call, with interrupts masked, using the
+  Benchmark library. The "bytes" column is the number of arguments, so
+  bytes/cycle reads as calls/cycle. After that the worst case error over
+  a sweep of arguments is printed, in units of the result (LSB for
+  fastSinQ15()):
+
+    FASTMATH,<function>,max_error=<n.nnnnnnn>
+
+  and for fastISqrt() and FastMap the number of results that differ from
+  the exact integer sqrt and from map(), which should both be 0:
+
+    FASTMATH,<function>,mismatches=<n>
+
+  This example code is in the public domain.
+*/
+
+#include <Benchmark.h>
+#include <FastMath.h>
+
+#define COUNT 64
+
+static float angles[COUNT];
+static float values[COUNT];
+static float xs[COUNT];
+static float ys[COUNT];
+static uint16_t binary[COUNT];
+static long inputs[COUNT];
+
+static volatile float floatSink;
+static volatile int32_t intSink;
+
+static FastMap fastMap(0, 1023, -1000, 1000);
+
+static void libmSin(void *context)
+{
+  float sum = 0.0f;
+  unsigned int i;
+
+  for (i = 0; i < COUNT; i++) {
+    sum += sinf(angles[i]);
+  }
+
+  floatSink = sum;
+}
+
+static void fastSinFloat(void *context)
+{
+  float sum = 0.0f;
+  unsigned int i;
+
+  for (i = 0; i < COUNT; i++) {
+    sum += fastSin(angles[i]);
+  }
+
+  floatSink = sum;
+}
+
+static void fastSinInteger(void *context)
+{
+  int32_t sum = 0;
+  unsigned int i;
+
+  for (i = 0; i < COUNT; i++) {
+    sum += fastSinQ15(binary[i]);
+  }
+
+  intSink = sum;
+}
+
+static void libmSqrt(void *context)
+{
+  float sum = 0.0f;
+  unsigned int i;
+
+  for (i = 0; i < COUNT; i++) {
+    sum += sqrtf(values[i]);
+  }
+
+  floatSink = sum;
+}
+
+static void fastSqrtFloat(void *context)
+{
+  float sum = 0.0f;
+  unsigned int i;
+
+  for (i = 0; i < COUNT; i++) {
+    sum += fastSqrt(values[i]);
+  }
+
+  floatSink = sum;
+}
+
+static void libmAtan2(void *context)
+{
+  float sum = 0.0f;
+  unsigned int i;
+
+  for (i = 0; i < COUNT; i++) {
+    sum += atan2f(ys[i], xs[i]);
+  }
+
+  floatSink = sum;
+}
+
+static void fastAtan2Float(void *context)
+{
+  float sum = 0.0f;
+  unsigned int i;
+
+  for (i = 0; i < COUNT; i++) {
+    sum += fastAtan2(ys[i], xs[i]);
+  }
+
+  floatSink = sum;
+}
+
+static void arduinoMap(void *context)
+{
+  int32_t sum = 0;
+  unsigned int i;
+
+  for (i = 0; i < COUNT; i++) {
+    sum += map(inputs[i], 0, 1023, -1000, 1000);
+  }
+
+  intSink = sum;
+}
+
+static void fastMapInteger(void *context)
+{
+  int32_t sum = 0;
+  unsigned int i;
+
+  for (i = 0; i < COUNT; i++) {
+    sum += fastMap(inputs[i]);
+  }
+
+  intSink = sum;
+}
+
+static void error(const char *name, float value)
+{
+  Serial.print("FASTMATH,");
+  Serial.print(name);
+  Serial.print(",max_error=");
+  Serial.println(value, 7);
+}
+
+void setup()
+{
+  float e, sinError, cosError, q15Error, sqrtError, atan2Error;
+  uint32_t isqrtError, mapError;
+  unsigned int i;
+  uint32_t r, n;
+  long x;
+
+  Serial.begin(9600);
+
+  while (!Serial) { }
+
+  randomSeed(1);
+
+  for (i = 0; i < COUNT; i++) {
+    angles[i] = (float)random(-31416, 31416) / 1000.0f;
+    values[i] = (float)random(0, 1000000) / 100.0f;
+    xs[i] = (float)random(-1000, 1000);
+    ys[i] = (float)random(-1000, 1000);
+    binary[i] = random(0, 65536);
+    inputs[i] = random(0, 1024);
+  }
+
+  Benchmark.begin();
+
+  Benchmark.add("sinf", libmSin, NULL, COUNT, BENCHMARK_OPTION_IRQ_MASKED);
+  Benchmark.add("fastSin", fastSinFloat, NULL, COUNT, BENCHMARK_OPTION_IRQ_MASKED);
+  Benchmark.add("fastSinQ15", fastSinInteger, NULL, COUNT, BENCHMARK_OPTION_IRQ_MASKED);
+  Benchmark.add("sqrtf", libmSqrt, NULL, COUNT, BENCHMARK_OPTION_IRQ_MASKED);
+  Benchmark.add("fastSqrt", fastSqrtFloat, NULL, COUNT, BENCHMARK_OPTION_IRQ_MASKED);
+  Benchmark.add("atan2f", libmAtan2, NULL, COUNT, BENCHMARK_OPTION_IRQ_MASKED);
+  Benchmark.add("fastAtan2", fastAtan2Float, NULL, COUNT, BENCHMARK_OPTION_IRQ_MASKED);
+  Benchmark.add("map", arduinoMap, NULL, COUNT, BENCHMARK_OPTION_IRQ_MASKED);
+  Benchmark.add("FastMap", fastMapInteger, NULL, COUNT, BENCHMARK_OPTION_IRQ_MASKED);
+
+  Benchmark.runAll(Serial, 200, 8, BENCHMARK_FORMAT_CSV);
+
+  sinError = 0.0f;
+  cosError = 0.0f;
+  q15Error = 0.0f;
+  sqrtError = 0.0f;
+  atan2Error = 0.0f;
+
+  for (i = 0; i < 4096; i++) {
+    float angle = ((float)i - 2048.0f) * (10.0f / 2048.0f);
+    float y = (float)((int)(i % 64) - 32);
+    float x = (float)((int)(i / 64) - 32);
+
+    e = fabsf(fastSin(angle) - sinf(angle));
+    if (sinError < e) { sinError = e; }
+
+    e = fabsf(fastCos(angle) - cosf(angle));
+    if (cosError < e) { cosError = e; }
+
+    e = fabsf((float)fastSinQ15(i << 4) - 32767.0f * sinf((float)i * (6.28318531f / 4096.0f)));
+    if (q15Error < e) { q15Error = e; }
+
+    e = fabsf(fastSqrt((float)i * 3.7f) - sqrtf((float)i * 3.7f));
+    if (sqrtError < e) { sqrtError = e; }
+
+    e = fabsf(fastAtan2(y, x) - atan2f(y, x));
+    if (atan2Error < e) { atan2Error = e; }
+  }
+
+  isqrtError = 0;
+
+  for (i = 0; i < 4096; i++) {
+    n = (uint32_t)random(0x7fffffff) * 2 + (i & 1);
+    r = fastISqrt(n);
+
+    if (((uint64_t)r * r > n) || ((uint64_t)(r + 1) * (r + 1) <= n)) {
+      isqrtError++;
+    }
+  }
+
+  mapError = 0;
+
+  for (x = 0; x < 1024; x++) {
+    if (fastMap(x) != map(x, 0, 1023, -1000, 1000)) {
+      mapError++;
+    }
+  }
+
+  error("sin", sinError);
+  error("cos", cosError);
+  error("sinQ15", q15Error);
+  error("sqrt", sqrtError);
+  error("atan2", atan2Error);
+
+  Serial.print("FASTMATH,isqrt,mismatches=");
+  Serial.println(isqrtError);
+  Serial.print("FASTMATH,map,mismatches=");
+  Serial.println(mapError);
+
+  Serial.println("FASTMATH,done");
+}
+
+void loop()
+{
+}
@@ -0,0 +1,200 @@
+/*
+ * Copyright (c) 2017 Thomas Roell.  All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal with the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ *  1. Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimers.
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimers in the
+ *     documentation and/or other materials provided with the distribution.
+ *  3. Neither the name of Thomas Roell, nor the names of its contributors
+ *     may be used to endorse or promote products derived from this Software
+ *     without specific prior written permission.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ * CONTRIBUTORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * WITH THE SOFTWARE.
+ */
+
+#ifndef _FASTMATH_H_INCLUDED
+#define _FASTMATH_H_INCLUDED
+
+#include <Arduino.h>
+
+// Math for effect code (LED animations, swing/tilt angles), where libm's
+// sinf()/atan2f()/sqrtf() show up per pixel and per sample.
+//
+// Angles for the fixed point trig are binary angles, i.e. a full turn is
+// 2^16 (Q15 variants) or 2^32 (Q31 variants), so that they wrap around for
+// free. Results are Q15 (-32767 .. 32767) or Q31. Both use one quarter wave
+// table of 256 Q31 entries with linear interpolation; the error is below
+// 1e-5 (1.5 LSB in Q15, rounding included). The float variants reduce the
+// argument to a binary angle and use the same table.
+//
+// fastAtan2() is a degree 11 odd polynomial over one octant (error below
+// 1e-5 radians), fastSqrt() the FPU's VSQRT (no errno handling, negative
+// arguments return NaN), and fastISqrt() an integer sqrt on top of it.
+//
+// FastMap is map() with the division done once, when the object is set up.
+// map(x) then is a 64 bit multiply and a shift. The results match map()
+// (including the rounding toward zero) as long as |x - in_min| times
+// |in_max - in_min| stays below 2^32.
+
+extern const int32_t fastSinTable[258];
+
+static inline int32_t fastSinQ31(uint32_t angle)
+{
+    uint32_t x, index, fraction;
+    int32_t a, b, value;
+
+    x = angle & 0x3fffffff;
+
+    if (angle & 0x40000000) {
+	x = 0x40000000 - x;
+    }
+
+    index = x >> 22;
+    fraction = (x >> 6) & 0xffff;
+
+    a = fastSinTable[index];
+    b = fastSinTable[index + 1];
+
+    value = a + (int32_t)(((int64_t)(b - a) * fraction) >> 16);
+
+    return (angle & 0x80000000) ? -value : value;
+}
+
+static inline int32_t fastCosQ31(uint32_t angle)
+{
+    return fastSinQ31(angle + 0x40000000);
+}
+
+static inline int16_t fastSinQ15(uint16_t angle)
+{
+    return __SSAT(((fastSinQ31((uint32_t)angle << 16) >> 15) + 1) >> 1, 16);
+}
+
+static inline int16_t fastCosQ15(uint16_t angle)
+{
+    return fastSinQ15(angle + 0x4000);
+}
+
+static inline uint32_t fastAngle(float radians)
+{
+    float turns;
+
+    // Whole turns are dropped first, so that the conversion to 2^31 per half
+    // turn cannot overflow; the final shift wraps the sign away.
+    turns = radians * 0.159154943f;
+    turns -= (float)(int32_t)turns;
+
+    return (uint32_t)((int32_t)(turns * 2147483648.0f)) << 1;
+}
+
+static inline float fastSin(float radians)
+{
+    return (float)fastSinQ31(fastAngle(radians)) * (1.0f / 2147483648.0f);
+}
+
+static inline float fastCos(float radians)
+{
+    return (float)fastCosQ31(fastAngle(radians)) * (1.0f / 2147483648.0f);
+}
+
+static inline float fastSqrt(float x)
+{
+    float result;
+
+    __asm__ ("vsqrt.f32 %0, %1" : "=t" (result) : "t" (x));
+
+    return result;
+}
+
+static inline uint32_t fastISqrt(uint32_t x)
+{
+    uint32_t r;
+
+    // (float)x keeps only 24 bits, so the result may be off by one either way.
+    r = (uint32_t)fastSqrt((float)x);
+
+    if (r > 65535) {
+	r = 65535;
+    }
+
+    if ((r * r) > x) {
+	r--;
+    } else if ((r < 65535) && (((r + 1) * (r + 1)) <= x)) {
+	r++;
+    }
+
+    return r;
+}
+
+static inline float fastAtan2(float y, float x)
+{
+    float ax, ay, z, z2, r;
+
+    ax = fabsf(x);
+    ay = fabsf(y);
+
+    if (ay <= ax) {
+	if (ax == 0.0f) {
+	    return 0.0f;
+	}
+
+	z = ay / ax;
+    } else {
+	z = ax / ay;
+    }
+
+    z2 = z * z;
+
+    r = z * (0.99997726f + z2 * (-0.33262347f + z2 * (0.19354346f + z2 * (-0.11643287f + z2 * (0.05265332f + z2 * -0.01172120f)))));
+
+    if (ay > ax) {
+	r = 1.57079633f - r;
+    }
+
+    if (x < 0.0f) {
+	r = 3.14159265f - r;
+    }
+
+    return (y < 0.0f) ? -r : r;
+}
+
+// Binary angle (2^16 per turn, as used by fastSinQ15()) of the vector (x, y).
+static inline uint16_t fastAtan2Angle(int32_t y, int32_t x)
+{
+    return (uint16_t)(int32_t)(fastAtan2((float)y, (float)x) * (32768.0f / 3.14159265f));
+}
+
+class FastMap
+{
+public:
+    FastMap(long in_min, long in_max, long out_min, long out_max);
+
+    inline long map(long x) const {
+	int64_t product = (int64_t)(x - _in_min) * _scale;
+
+	return _out_min + ((product < 0) ? -(long)((-product) >> 32) : (long)(product >> 32));
+    }
+
+    inline long operator()(long x) const { return map(x); }
+
+private:
+    long _in_min;
+    long _out_min;
+    int64_t _scale;
+};
+
+#endif // _FASTMATH_H_INCLUDED
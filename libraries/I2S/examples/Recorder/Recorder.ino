@@ -0,0 +1,63 @@
+/*
+  Recorder
+
+  Records 10 seconds of 16 bit stereo audio at 48kHz from an I2S
+  microphone (or codec) into "REC.WAV" on the board's file system.
+  Eight 4kB DMA segments give about 170ms of slack for the SD card's
+  busy times. The number of dropped segments is printed over Serial at
+  the end.
+
+  This example code is in the public domain.
+*/
+
+#include <FS.h>
+#include <I2S.h>
+#include <I2SRecorder.h>
+
+#define SAMPLE_RATE 48000
+#define SECONDS     10
+
+uint32_t buffer[8 * 4096 / 4];
+
+I2SRecorderClass recorder;
+
+void setup()
+{
+  Serial.begin(9600);
+
+  while (!Serial) { }
+
+  if (!DOSFS.begin()) {
+    Serial.println("DOSFS.begin() failed");
+    return;
+  }
+
+  if (!I2S.begin(I2S_PHILIPS_MODE, SAMPLE_RATE, 16, false, buffer, sizeof(buffer), 8)) {
+    Serial.println("I2S.begin() failed");
+    return;
+  }
+
+  if (!recorder.begin(I2S, "REC.WAV", SAMPLE_RATE, I2S_RECORDER_HEADER_SIZE + (SAMPLE_RATE * 4 * SECONDS))) {
+    Serial.println("recorder.begin() failed");
+    return;
+  }
+
+  while (recorder.recording()) {
+    delay(100);
+  }
+
+  recorder.end();
+
+  I2S.end();
+
+  Serial.print("recorded ");
+  Serial.print(recorder.length());
+  Serial.print(" bytes, status ");
+  Serial.print(recorder.status());
+  Serial.print(", overruns ");
+  Serial.println(recorder.overruns());
+}
+
+void loop()
+{
+}
@@ -29,6 +29,8 @@
 #include "Arduino.h"
 #include "stm32l4_wiring_private.h"
 #include "I2S.h"
+#include "I2SMixer.h"
+#include "I2SRecorder.h"
 
 #define I2S_STATE_IDLE     0
 #define I2S_STATE_READY    1
@@ -43,9 +45,15 @@ I2SClass::I2SClass(struct _stm32l4_sai_t *sai, unsigned int instance, const stru
 
     _state = I2S_STATE_IDLE;
 
-    _xf_active = 0;
-    _xf_pending = 0;
-    _xf_offset = 0;
+    _channels = 2;
+    _slots = 0xff;
+
+    setBuffer(&_xf_buffer[0][0], sizeof(_xf_buffer), 2);
+
+    _xf_underruns = 0;
+
+    _mixer = NULL;
+    _recorder = NULL;
 
     _receiveCallback = NULL;
     _transmitCallback = NULL;
@@ -59,17 +67,7 @@ int I2SClass::begin(int mode, long sampleRate, int bitsPerSample, bool masterClo
 	return 0;
     }
 
-    switch (mode) {
-    case I2S_PHILIPS_MODE:
-	option = SAI_OPTION_FORMAT_I2S;
-	break;
-    case I2S_RIGHT_JUSTIFIED_MODE:
-	option = SAI_OPTION_FORMAT_RIGHT_JUSTIFIED;
-	break;
-    case I2S_LEFT_JUSTIFIED_MODE:
-	option = SAI_OPTION_FORMAT_LEFT_JUSTIFIED;
-	break;
-    default:
+    if (!setFormat(mode, &option)) {
 	return 0;
     }
 
@@ -103,6 +101,9 @@ int I2SClass::begin(int mode, long sampleRate, int bitsPerSample, bool masterClo
 	option |= SAI_OPTION_MCK;
     }
 
+    // TDM segments hold whole frames, so that acquireTxBuffer() frames map 1:1.
+    _xf_size -= (_xf_size % (_channels * (_width / 8)));
+
     stm32l4_sai_enable(_sai, bitsPerSample, sampleRate, option, I2SClass::_eventCallback, (void*)this, (SAI_EVENT_RECEIVE_REQUEST | SAI_EVENT_TRANSMIT_REQUEST));
 
     _state = I2S_STATE_READY;
@@ -118,17 +119,7 @@ int I2SClass::begin(int mode, int bitsPerSample)
 	return 0;
     }
 
-    switch (mode) {
-    case I2S_PHILIPS_MODE:
-	option = SAI_OPTION_FORMAT_I2S;
-	break;
-    case I2S_RIGHT_JUSTIFIED_MODE:
-	option = SAI_OPTION_FORMAT_RIGHT_JUSTIFIED;
-	break;
-    case I2S_LEFT_JUSTIFIED_MODE:
-	option = SAI_OPTION_FORMAT_LEFT_JUSTIFIED;
-	break;
-    default:
+    if (!setFormat(mode, &option)) {
 	return 0;
     }
 
@@ -142,6 +133,8 @@ int I2SClass::begin(int mode, int bitsPerSample)
 	return 0;
     }
 
+    _xf_size -= (_xf_size % (_channels * (_width / 8)));
+
     stm32l4_sai_enable(_sai, bitsPerSample, 0, option, I2SClass::_eventCallback, (void*)this, (SAI_EVENT_RECEIVE_REQUEST | SAI_EVENT_TRANSMIT_REQUEST));
 
     _state = I2S_STATE_READY;
@@ -149,8 +142,89 @@ int I2SClass::begin(int mode, int bitsPerSample)
     return 1;
 }
 
+int I2SClass::begin(int mode, long sampleRate, int bitsPerSample, bool masterClock, void *buffer, size_t size, unsigned int depth)
+{
+    if (_state != I2S_STATE_IDLE) {
+	return 0;
+    }
+
+    if (!setBuffer(buffer, size, depth)) {
+	return 0;
+    }
+
+    if (!begin(mode, sampleRate, bitsPerSample, masterClock)) {
+	setBuffer(&_xf_buffer[0][0], sizeof(_xf_buffer), 2);
+
+	return 0;
+    }
+
+    return 1;
+}
+
+int I2SClass::begin(int mode, int bitsPerSample, void *buffer, size_t size, unsigned int depth)
+{
+    if (_state != I2S_STATE_IDLE) {
+	return 0;
+    }
+
+    if (!setBuffer(buffer, size, depth)) {
+	return 0;
+    }
+
+    if (!begin(mode, bitsPerSample)) {
+	setBuffer(&_xf_buffer[0][0], sizeof(_xf_buffer), 2);
+
+	return 0;
+    }
+
+    return 1;
+}
+
+void I2SClass::setSlots(uint8_t mask)
+{
+    _slots = mask;
+}
+
+bool I2SClass::setFormat(int mode, uint32_t *p_option)
+{
+    uint32_t mask;
+
+    _channels = 2;
+
+    switch (mode) {
+    case I2S_PHILIPS_MODE:
+	*p_option = SAI_OPTION_FORMAT_I2S;
+	break;
+    case I2S_RIGHT_JUSTIFIED_MODE:
+	*p_option = SAI_OPTION_FORMAT_RIGHT_JUSTIFIED;
+	break;
+    case I2S_LEFT_JUSTIFIED_MODE:
+	*p_option = SAI_OPTION_FORMAT_LEFT_JUSTIFIED;
+	break;
+    case I2S_TDM4_MODE:
+    case I2S_TDM8_MODE:
+	mask = _slots & ((mode == I2S_TDM4_MODE) ? 0x0f : 0xff);
+
+	if (!mask) {
+	    return false;
+	}
+
+	_channels = __builtin_popcount(mask);
+
+	*p_option = (SAI_OPTION_FORMAT_TDM | ((mode == I2S_TDM4_MODE) ? SAI_OPTION_SLOTS_4 : SAI_OPTION_SLOTS_8) | (mask << SAI_OPTION_SLOT_ENABLE_SHIFT));
+	break;
+    default:
+	return false;
+    }
+
+    return true;
+}
+
 void I2SClass::end()
 {
+    _mixer = NULL;
+    _recorder = NULL;
+
     while (_xf_active) {
 	armv7m_core_yield();
     }
@@ -159,14 +233,12 @@ void I2SClass::end()
 
     _state = I2S_STATE_IDLE;
 
-    _xf_active = 0;
-    _xf_pending = 0;
-    _xf_offset = 0;
+    setBuffer(&_xf_buffer[0][0], sizeof(_xf_buffer), 2);
 }
 
 int I2SClass::available()
 {
-    uint32_t xf_offset, xf_index, xf_count;
+    uint32_t xf_queued;
 
     if (!((_state == I2S_STATE_READY) || (_state == I2S_STATE_RECEIVE))) {
 	return 0;
@@ -174,36 +246,20 @@ int I2SClass::available()
 
     _state = I2S_STATE_RECEIVE;
 
-    if (!_xf_active)
-    {
-	xf_offset = _xf_offset;
-	xf_index  = xf_offset >> 31;
-	xf_count  = xf_offset & 0x7fffffff;
+    startReceive();
 
-	if (xf_count == 0)
-	{
-	    if (stm32l4_sai_done(_sai))
-	    {
-		if (_xf_pending)
-		{
-		    _xf_pending = false;
-		    xf_count = I2S_BUFFER_SIZE;
-		}
-		
-		_xf_active = true;
-		_xf_offset = ((xf_index ^ 1) << 31) | xf_count;
-		
-		stm32l4_sai_receive(_sai, (uint8_t*)&_xf_data[xf_index][0], I2S_BUFFER_SIZE);
-	    }
-	}
+    xf_queued = _xf_queued;
+
+    if (!xf_queued) {
+	return 0;
     }
 
-    return (_xf_offset & 0x7fffffff);
+    return (xf_queued * _xf_size) - _xf_count;
 }
 
 int I2SClass::peek()
 {
-    uint32_t xf_offset, xf_index, xf_count;
+    const uint8_t *xf_data;
 
     if (!((_state == I2S_STATE_READY) || (_state == I2S_STATE_RECEIVE))) {
 	return 0;
@@ -211,55 +267,17 @@ int I2SClass::peek()
 
     _state = I2S_STATE_RECEIVE;
 
-    if (!_xf_active)
-    {
-	xf_offset = _xf_offset;
-	xf_index  = xf_offset >> 31;
-	xf_count  = xf_offset & 0x7fffffff;
+    startReceive();
 
-	if (xf_count == 0)
-	{
-	    if (stm32l4_sai_done(_sai))
-	    {
-		if (_xf_pending)
-		{
-		    _xf_pending = false;
-		    xf_count = I2S_BUFFER_SIZE;
-		}
-		
-		_xf_active = true;
-		_xf_offset = ((xf_index ^ 1) << 31) | xf_count;
-		
-		stm32l4_sai_receive(_sai, (uint8_t*)&_xf_data[xf_index][0], I2S_BUFFER_SIZE);
-	    }
-	}
-    }
-
-    xf_offset = _xf_offset;
-    xf_index  = xf_offset >> 31;
-    xf_count  = xf_offset & 0x7fffffff;
-
-    if (_width == 32)
-    {
-	if (xf_count >= 4) {
-	    return *((int32_t*)&(((uint8_t*)&_xf_data[xf_index][0])[xf_count - 4]));
-	}
+    if (!_xf_queued) {
+	return 0;
     }
 
-    else if (_width == 16)
-    {
-	if (xf_count >= 2) {
-	    return *((int16_t*)&(((uint8_t*)&_xf_data[xf_index][0])[xf_count - 2]));
-	}
-    }
-    else
-    {
-	if (xf_count >= 1) {
-	    return *((uint8_t*)&(((uint8_t*)&_xf_data[xf_index][0])[xf_count - 1]));
-	}
-    }
+    xf_data = _xf_data + (_xf_head * _xf_size) + _xf_count;
 
-    return 0;
+    if (_width == 32)      { return *((const int32_t*)xf_data); }
+    else if (_width == 16) { return *((const int16_t*)xf_data); }
+    else                   { return *((const uint8_t*)xf_data); }
 }
 
 int I2SClass::read()
@@ -273,7 +291,8 @@ int I2SClass::read()
 
 int I2SClass::read(void* buffer, size_t size)
 {
-    uint32_t xf_offset, xf_index, xf_count;
+    uint32_t xf_count, xf_size;
+    size_t count;
 
     if (_state != I2S_STATE_RECEIVE) {
 	if (!((_state == I2S_STATE_READY) || (_state == I2S_STATE_RECEIVE))) {
@@ -283,72 +302,37 @@ int I2SClass::read(void* buffer, size_t size)
 	_state = I2S_STATE_RECEIVE;
     }
 
-    if (!_xf_active)
+    startReceive();
+
+    xf_size = _xf_size;
+    count = 0;
+
+    while ((count < size) && _xf_queued)
     {
-	xf_offset = _xf_offset;
-	xf_index  = xf_offset >> 31;
-	xf_count  = xf_offset & 0x7fffffff;
+	xf_count = xf_size - _xf_count;
 
-	if (xf_count == 0)
-	{
-	    if (stm32l4_sai_done(_sai))
-	    {
-		if (_xf_pending)
-		{
-		    _xf_pending = false;
-		    xf_count = I2S_BUFFER_SIZE;
-		}
-		
-		_xf_active = true;
-		_xf_offset = ((xf_index ^ 1) << 31) | xf_count;
-		
-		stm32l4_sai_receive(_sai, (uint8_t*)&_xf_data[xf_index][0], I2S_BUFFER_SIZE);
-	    }
+	if (xf_count > (size - count)) {
+	    xf_count = size - count;
 	}
-    }
 
-    xf_offset = _xf_offset;
-    xf_index  = xf_offset >> 31;
-    xf_count  = xf_offset & 0x7fffffff;
+	memcpy((uint8_t*)buffer + count, _xf_data + (_xf_head * xf_size) + _xf_count, xf_count);
 
-    if (size > xf_count) {
-	size = xf_count;
-    }
+	count += xf_count;
 
-    if (size)
-    {
-	xf_count -= size;
-
-	memcpy(buffer, &(((uint8_t*)&_xf_data[xf_index][0])[xf_count]), size);
-    }
+	_xf_count += xf_count;
 
-    _xf_offset = (xf_index << 31) | xf_count;
+	if (_xf_count == xf_size)
+	{
+	    _xf_count = 0;
+	    _xf_head = ((_xf_head + 1) == _xf_depth) ? 0 : (_xf_head + 1);
 
-    if (!_xf_active)
-    {
-	xf_offset = _xf_offset;
-	xf_index  = xf_offset >> 31;
-	xf_count  = xf_offset & 0x7fffffff;
+	    armv7m_atomic_sub(&_xf_queued, 1);
 
-	if (xf_count == 0)
-	{
-	    if (stm32l4_sai_done(_sai))
-	    {
-		if (_xf_pending)
-		{
-		    _xf_pending = false;
-		    xf_count = I2S_BUFFER_SIZE;
-		}
-		
-		_xf_active = true;
-		_xf_offset = ((xf_index ^ 1) << 31) | xf_count;
-		
-		stm32l4_sai_receive(_sai, (uint8_t*)&_xf_data[xf_index][0], I2S_BUFFER_SIZE);
-	    }
+	    startReceive();
 	}
     }
 
-    return size;
+    return count;
 }
 
 void I2SClass::flush()
@@ -357,13 +341,23 @@ void I2SClass::flush()
 
 size_t I2SClass::availableForWrite()
 {
+    uint32_t xf_queued;
+
     if (!((_state == I2S_STATE_READY) || (_state == I2S_STATE_TRANSMIT))) {
 	return 0;
     }
 
     _state = I2S_STATE_TRANSMIT;
 
-    return I2S_BUFFER_SIZE - (_xf_offset & 0x7fffffff);
+    if (_mixer || _xf_acquired) {
+	return 0;
+    }
+
+    startTransmit();
+
+    xf_queued = _xf_queued;
+
+    return ((_xf_depth - xf_queued) * _xf_size) - _xf_count;
 }
 
 size_t I2SClass::write(uint8_t data)
@@ -391,6 +385,10 @@ size_t I2SClass::write(int32_t sample)
 	_state = I2S_STATE_TRANSMIT;
     }
 
+    if (_mixer || _xf_acquired) {
+	return 0;
+    }
+
     while (!write((const void*)&sample, (_width / 8))) {
 	armv7m_core_yield();
     }
@@ -400,7 +398,8 @@ size_t I2SClass::write(int32_t sample)
 
 size_t I2SClass::write(const void *buffer, size_t size)
 {
-    uint32_t xf_offset, xf_index, xf_count;
+    uint32_t xf_count, xf_size;
+    size_t count;
 
     if (_state != I2S_STATE_TRANSMIT) {
 	if (!((_state == I2S_STATE_READY) || (_state == I2S_STATE_TRANSMIT))) {
@@ -410,45 +409,42 @@ size_t I2SClass::write(const void *buffer, size_t size)
 	_state = I2S_STATE_TRANSMIT;
     }
 
+    if (_mixer || _xf_acquired) {
+	return 0;
+    }
+
     if      (_width == 32) { size &= ~3; }
     else if (_width == 16) { size &= ~1; }
-	
-    xf_offset = _xf_offset;
-    xf_index  = xf_offset >> 31;
-    xf_count  = xf_offset & 0x7fffffff;
-    
-    if ((xf_count + size) > I2S_BUFFER_SIZE) {
-	size = I2S_BUFFER_SIZE - xf_count;
-    }
 
-    if (size)
+    xf_size = _xf_size;
+    count = 0;
+
+    while ((count < size) && (_xf_queued != _xf_depth))
     {
-        memcpy(&(((uint8_t*)&_xf_data[xf_index][0])[xf_count]), buffer, size);
+	xf_count = xf_size - _xf_count;
 
-	xf_count += size;
-    }
+	if (xf_count > (size - count)) {
+	    xf_count = size - count;
+	}
 
-    _xf_offset = (xf_index << 31) | xf_count;
+	memcpy(_xf_data + (_xf_head * xf_size) + _xf_count, (const uint8_t*)buffer + count, xf_count);
 
-    if (!_xf_active)
-    {
-	xf_offset = _xf_offset;
-	xf_index  = xf_offset >> 31;
-	xf_count  = xf_offset & 0x7fffffff;
+	count += xf_count;
+
+	_xf_count += xf_count;
 
-	if (xf_count == I2S_BUFFER_SIZE)
+	if (_xf_count == xf_size)
 	{
-	    if (stm32l4_sai_done(_sai))
-	    {
-		_xf_active = true;
-		_xf_offset = (xf_index ^ 1) << 31;
-		
-		stm32l4_sai_transmit(_sai, (const uint8_t*)&_xf_data[xf_index][0], I2S_BUFFER_SIZE);
-	    }
+	    _xf_count = 0;
+	    _xf_head = ((_xf_head + 1) == _xf_depth) ? 0 : (_xf_head + 1);
+
+	    armv7m_atomic_add(&_xf_queued, 1);
 	}
     }
 
-    return size;
+    startTransmit();
+
+    return count;
 }
 
 void I2SClass::onReceive(void(*callback)(void))
@@ -461,28 +457,281 @@ void I2SClass::onTransmit(void(*callback)(void))
     _transmitCallback = callback;
 }
 
-void I2SClass::EventCallback(uint32_t events)
+void *I2SClass::acquireTxBuffer(size_t *frames)
 {
-    uint32_t xf_offset, xf_index, xf_count;
+    if (_state != I2S_STATE_TRANSMIT) {
+	if (!((_state == I2S_STATE_READY) || (_state == I2S_STATE_TRANSMIT))) {
+	    return NULL;
+	}
+	
+	_state = I2S_STATE_TRANSMIT;
+    }
 
-    xf_offset = _xf_offset;
-    xf_index  = xf_offset >> 31;
-    xf_count  = xf_offset & 0x7fffffff;
+    startTransmit();
 
-    if (events & SAI_EVENT_RECEIVE_REQUEST)
+    // A segment partially filled by write() cannot be handed out.
+    if (_mixer || _xf_count || (_xf_queued == _xf_depth)) {
+	return NULL;
+    }
+
+    _xf_acquired = true;
+
+    if (frames) {
+	*frames = _xf_size / (_channels * (_width / 8));
+    }
+
+    return _xf_data + (_xf_head * _xf_size);
+}
+
+void I2SClass::commitTxBuffer()
+{
+    if (!_xf_acquired) {
+	return;
+    }
+
+    _xf_acquired = false;
+
+    _xf_head = ((_xf_head + 1) == _xf_depth) ? 0 : (_xf_head + 1);
+
+    armv7m_atomic_add(&_xf_queued, 1);
+
+    startTransmit();
+}
+
+const void *I2SClass::acquireRxBuffer(size_t *frames)
+{
+    if (_state != I2S_STATE_RECEIVE) {
+	if (!((_state == I2S_STATE_READY) || (_state == I2S_STATE_RECEIVE))) {
+	    return NULL;
+	}
+	
+	_state = I2S_STATE_RECEIVE;
+    }
+
+    startReceive();
+
+    if (!_xf_queued) {
+	return NULL;
+    }
+
+    if (frames) {
+	*frames = (_xf_size - _xf_count) / (_channels * (_width / 8));
+    }
+
+    return _xf_data + (_xf_head * _xf_size) + _xf_count;
+}
+
+void I2SClass::releaseRxBuffer()
+{
+    if ((_state != I2S_STATE_RECEIVE) || !_xf_queued) {
+	return;
+    }
+
+    _xf_count = 0;
+    _xf_head = ((_xf_head + 1) == _xf_depth) ? 0 : (_xf_head + 1);
+
+    armv7m_atomic_sub(&_xf_queued, 1);
+
+    startReceive();
+}
+
+size_t I2SClass::queuedFrames(size_t *capacity)
+{
+    size_t frame;
+
+    if (_state == I2S_STATE_IDLE) {
+	if (capacity) {
+	    *capacity = 0;
+	}
+
+	return 0;
+    }
+
+    frame = _channels * (_width / 8);
+
+    if (capacity) {
+	*capacity = (_xf_depth * _xf_size) / frame;
+    }
+
+    return (_xf_queued * _xf_size) / frame;
+}
+
+uint32_t I2SClass::underruns()
+{
+    return _xf_underruns;
+}
+
+int32_t I2SClass::rateError()
+{
+    if (_state == I2S_STATE_IDLE) {
+	return 0;
+    }
+
+    return stm32l4_system_saiclk_error();
+}
+
+bool I2SClass::setBuffer(void *buffer, size_t size, unsigned int depth)
+{
+    uint32_t xf_size;
+
+    if (!buffer || (depth < 2) || (depth > 255) || ((uint32_t)buffer & 3)) {
+	return false;
+    }
+
+    // Segments are a multiple of 4 bytes, so that any sample width and 16 bit
+    // stereo frames fit evenly. stm32l4_sai_transmit() takes a 16 bit count.
+    xf_size = (size / depth) & ~3;
+
+    if (xf_size > 0xfffc) {
+	xf_size = 0xfffc;
+    }
+    
+    if (xf_size == 0) {
+	return false;
+    }
+
+    _xf_data = (uint8_t*)buffer;
+    _xf_size = xf_size;
+    _xf_depth = depth;
+
+    _xf_active = false;
+    _xf_acquired = false;
+    _xf_head = 0;
+    _xf_tail = 0;
+    _xf_queued = 0;
+    _xf_count = 0;
+
+    return true;
+}
+
+void I2SClass::startReceive()
+{
+    // The SAI interrupt does not touch the ring while the DMA is idle, so
+    // there is no race between checking and setting "_xf_active".
+    if (!_xf_active && (_xf_queued != _xf_depth))
+    {
+	if (stm32l4_sai_done(_sai))
+	{
+	    _xf_active = true;
+
+	    stm32l4_sai_receive(_sai, _xf_data + (_xf_tail * _xf_size), _xf_size);
+	}
+    }
+}
+
+void I2SClass::startTransmit()
+{
+    if (!_xf_active && _xf_queued)
     {
-	if (xf_count == 0)
+	if (stm32l4_sai_done(_sai))
 	{
-	    _xf_offset = ((xf_index ^ 1) << 31) | I2S_BUFFER_SIZE;
+	    _xf_active = true;
 
-	    stm32l4_sai_receive(_sai, (uint8_t*)&_xf_data[xf_index][0], I2S_BUFFER_SIZE);
+	    stm32l4_sai_transmit(_sai, _xf_data + (_xf_tail * _xf_size), _xf_size);
+	}
+    }
+}
+
+int I2SClass::attachMixer(class I2SMixerClass *mixer)
+{
+    unsigned int index;
+
+    if (!((_state == I2S_STATE_READY) || (_state == I2S_STATE_TRANSMIT))) {
+	return 0;
+    }
+
+    if ((_width != 16) || (_channels != 2) || _xf_active || _xf_acquired || _mixer) {
+	return 0;
+    }
+
+    _state = I2S_STATE_TRANSMIT;
+
+    // Prime all segments, so that EventCallback() can hand out the next one
+    // to the SAI before refilling the one that just completed.
+    for (index = 0; index < _xf_depth; index++) {
+	mixer->mix((uint32_t*)(_xf_data + (index * _xf_size)), (_xf_size / 4));
+    }
+
+    _xf_head = 0;
+    _xf_tail = 0;
+    _xf_count = 0;
+    _xf_queued = _xf_depth;
+
+    _mixer = mixer;
+
+    startTransmit();
+
+    return 1;
+}
+
+void I2SClass::detachMixer(class I2SMixerClass *mixer)
+{
+    if (_mixer != mixer) {
+	return;
+    }
+
+    _mixer = NULL;
+
+    while (_xf_active) {
+	armv7m_core_yield();
+    }
+}
+
+int I2SClass::attachRecorder(class I2SRecorderClass *recorder)
+{
+    if (!((_state == I2S_STATE_READY) || (_state == I2S_STATE_RECEIVE))) {
+	return 0;
+    }
+
+    if (_mixer || _recorder) {
+	return 0;
+    }
+
+    _state = I2S_STATE_RECEIVE;
+
+    _recorder = recorder;
+
+    startReceive();
+
+    return 1;
+}
+
+void I2SClass::detachRecorder(class I2SRecorderClass *recorder)
+{
+    if (_recorder != recorder) {
+	return;
+    }
+
+    _recorder = NULL;
+}
+
+void I2SClass::EventCallback(uint32_t events)
+{
+    I2SMixerClass *mixer;
+    I2SRecorderClass *recorder;
+
+    if (events & SAI_EVENT_RECEIVE_REQUEST)
+    {
+	_xf_tail = ((_xf_tail + 1) == _xf_depth) ? 0 : (_xf_tail + 1);
+
+	if (armv7m_atomic_add(&_xf_queued, 1) < (uint32_t)(_xf_depth - 1))
+	{
+	    stm32l4_sai_receive(_sai, _xf_data + (_xf_tail * _xf_size), _xf_size);
 	}
 	else
 	{
-	    _xf_pending = true;
+	    _xf_underruns++;
+
 	    _xf_active = false;
 	}
 
+	recorder = _recorder;
+
+	if (recorder)
+	{
+	    recorder->schedule();
+	}
+
 	if (_receiveCallback)
 	{
 	    armv7m_pendsv_enqueue((armv7m_pendsv_routine_t)_receiveCallback, NULL, 0);
@@ -491,17 +740,35 @@ void I2SClass::EventCallback(uint32_t events)
 
     if (events & SAI_EVENT_TRANSMIT_REQUEST)
     {
-	if (xf_count == I2S_BUFFER_SIZE)
-	{
-	    _xf_offset = (xf_index ^ 1) << 31;
+	_xf_tail = ((_xf_tail + 1) == _xf_depth) ? 0 : (_xf_tail + 1);
 
-	    stm32l4_sai_transmit(_sai, (const uint8_t*)&_xf_data[xf_index][0], I2S_BUFFER_SIZE);
+	if (armv7m_atomic_sub(&_xf_queued, 1) > 1)
+	{
+	    stm32l4_sai_transmit(_sai, _xf_data + (_xf_tail * _xf_size), _xf_size);
 	}
 	else
 	{
+	    _xf_underruns++;
+
 	    _xf_active = false;
 	}
 
+	mixer = _mixer;
+
+	if (mixer)
+	{
+	    // With the mixer attached the sketch does not write, so the head
+	    // of the ring is owned by the interrupt.
+	    while (_xf_queued != _xf_depth)
+	    {
+		mixer->mix((uint32_t*)(_xf_data + (_xf_head * _xf_size)), (_xf_size / 4));
+
+		_xf_head = ((_xf_head + 1) == _xf_depth) ? 0 : (_xf_head + 1);
+
+		armv7m_atomic_add(&_xf_queued, 1);
+	    }
+	}
+
 	if (_transmitCallback)
 	{
 	    armv7m_pendsv_enqueue((armv7m_pendsv_routine_t)_transmitCallback, NULL, 0);
@@ -36,9 +36,14 @@
 typedef enum {
     I2S_PHILIPS_MODE,
     I2S_RIGHT_JUSTIFIED_MODE,
-    I2S_LEFT_JUSTIFIED_MODE
+    I2S_LEFT_JUSTIFIED_MODE,
+    I2S_TDM4_MODE,             // STM32L4 EXTENSION: 4 slot TDM
+    I2S_TDM8_MODE              // STM32L4 EXTENSION: 8 slot TDM
 } i2s_mode_t;
 
+class I2SMixerClass;
+class I2SRecorderClass;
+
 class I2SClass : public Stream
 {
 public:
@@ -48,8 +53,15 @@ public:
     int begin(int mode, long sampleRate, int bitsPerSample, bool masterClock = false);
     // the SCK and FS pins are inputs, other side controls sample rate
     int begin(int mode, int bitsPerSample);
+    // STM32L4 EXTENSION: use "buffer" as a ring of "depth" DMA segments of (size / depth) bytes each
+    int begin(int mode, long sampleRate, int bitsPerSample, bool masterClock, void *buffer, size_t size, unsigned int depth);
+    int begin(int mode, int bitsPerSample, void *buffer, size_t size, unsigned int depth);
     void end();
 
+    // STM32L4 EXTENSION: TDM slots that carry data (bit n for slot n), to be set before begin().
+    // A frame is then one sample per enabled slot, in slot order, in place of a stereo pair.
+    void setSlots(uint8_t mask);
+
     // from Stream
     virtual int available();
     virtual int read();
@@ -70,21 +82,68 @@ public:
     
     void onReceive(void(*)(void));
     void onTransmit(void(*)(void));
+
+    // STM32L4 EXTENSION: zero-copy transmit; returns the next free DMA segment and its size in
+    // (2 channel, or TDM slot) frames, or NULL if there is none. commitTxBuffer() queues it for the SAI.
+    void *acquireTxBuffer(size_t *frames);
+    void commitTxBuffer();
+
+    // STM32L4 EXTENSION: zero-copy receive; returns the oldest filled DMA segment (or the part of it
+    // not consumed by read() yet) and its size in frames, or NULL if there is none. releaseRxBuffer()
+    // hands it back to the SAI.
+    const void *acquireRxBuffer(size_t *frames);
+    void releaseRxBuffer();
+
+    // STM32L4 EXTENSION: number of (2 channel) frames in committed segments that the SAI has not
+    // finished yet, and via "capacity" the size of the whole ring in frames
+    size_t queuedFrames(size_t *capacity = NULL);
+
+    // STM32L4 EXTENSION: number of times the DMA ran out of segments (transmit underrun / receive overrun)
+    uint32_t underruns();
+
+    // STM32L4 EXTENSION: deviation of the generated sample rate in ppm (0 if the other side controls
+    // the sample rate), e.g. for a resampler that needs to make up for it
+    int32_t rateError();
     
 private:
     struct _stm32l4_sai_t *_sai;
     uint8_t _state;
     uint8_t _width;
+    uint8_t _channels;
+    uint8_t _slots;
     volatile uint8_t _xf_active;
-    volatile uint8_t _xf_pending;
-    volatile uint32_t _xf_offset;
-    uint32_t _xf_data[2][I2S_BUFFER_SIZE / sizeof(uint32_t)];
+    uint8_t _xf_acquired;
+    uint8_t _xf_depth;
+    uint8_t _xf_head;
+    uint8_t _xf_tail;
+    volatile uint32_t _xf_queued;
+    uint32_t _xf_count;
+    uint32_t _xf_size;
+    uint8_t *_xf_data;
+    volatile uint32_t _xf_underruns;
+    uint32_t _xf_buffer[2][I2S_BUFFER_SIZE / sizeof(uint32_t)];
+
+    class I2SMixerClass * volatile _mixer;
+    class I2SRecorderClass * volatile _recorder;
+
+    bool setBuffer(void *buffer, size_t size, unsigned int depth);
+    bool setFormat(int mode, uint32_t *p_option);
+    void startReceive();
+    void startTransmit();
+
+    int attachMixer(class I2SMixerClass *mixer);
+    void detachMixer(class I2SMixerClass *mixer);
+    int attachRecorder(class I2SRecorderClass *recorder);
+    void detachRecorder(class I2SRecorderClass *recorder);
 
     void (*_receiveCallback)(void);
     void (*_transmitCallback)(void);
 
     static void _eventCallback(void *context, uint32_t events);
     void EventCallback(uint32_t events);
+
+    friend class I2SMixerClass;
+    friend class I2SRecorderClass;
 };
 
 #if I2S_INTERFACES_COUNT > 0
@@ -0,0 +1,214 @@
+/*
+ * Copyright (c) 2016 Thomas Roell.  All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal with the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ *  1. Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimers.
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimers in the
+ *     documentation and/or other materials provided with the distribution.
+ *  3. Neither the name of Thomas Roell, nor the names of its contributors
+ *     may be used to endorse or promote products derived from this Software
+ *     without specific prior written permission.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ * CONTRIBUTORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * WITH THE SOFTWARE.
+ */
+
+#include "Arduino.h"
+#include "stm32l4_wiring_private.h"
+#include "I2SMixer.h"
+#include "Bitband.h"
+
+#define I2S_MIXER_GAIN_SHIFT 14
+#define I2S_MIXER_GAIN_UNITY (1 << I2S_MIXER_GAIN_SHIFT)
+
+static inline __attribute__((always_inline)) uint32_t i2s_mixer_scale(uint32_t sample, uint32_t gain_l, uint32_t gain_r)
+{
+    // gain_l covers the lower (left) halfword, gain_r the upper (right) halfword,
+    // so __SMUAD() ends up being a single 16x16 multiply per channel.
+    return __PKHBT(__SSAT(((int32_t)__SMUAD(sample, gain_l) >> I2S_MIXER_GAIN_SHIFT), 16),
+		   __SSAT(((int32_t)__SMUAD(sample, gain_r) >> I2S_MIXER_GAIN_SHIFT), 16),
+		   16);
+}
+
+static void __fastcode __attribute__((optimize("O3"))) i2s_mixer_copy(uint32_t *data, const uint32_t *source, uint32_t count)
+{
+    memcpy(data, source, count * sizeof(uint32_t));
+}
+
+static void __fastcode __attribute__((optimize("O3"))) i2s_mixer_copy_scaled(uint32_t *data, const uint32_t *source, uint32_t count, uint32_t gain_l, uint32_t gain_r)
+{
+    const uint32_t *source_e = source + count;
+
+    while (source != source_e) {
+	*data++ = i2s_mixer_scale(*source++, gain_l, gain_r);
+    }
+}
+
+static void __fastcode __attribute__((optimize("O3"))) i2s_mixer_add(uint32_t *data, const uint32_t *source, uint32_t count)
+{
+    const uint32_t *source_e = source + count;
+
+    while (source != source_e) {
+	*data = __QADD16(*data, *source++);
+	data++;
+    }
+}
+
+static void __fastcode __attribute__((optimize("O3"))) i2s_mixer_add_scaled(uint32_t *data, const uint32_t *source, uint32_t count, uint32_t gain_l, uint32_t gain_r)
+{
+    const uint32_t *source_e = source + count;
+
+    while (source != source_e) {
+	*data = __QADD16(*data, i2s_mixer_scale(*source++, gain_l, gain_r));
+	data++;
+    }
+}
+
+static uint32_t i2s_mixer_gain(float gain)
+{
+    if (!(gain > 0.0f)) {
+	return 0;
+    }
+
+    if (gain >= 2.0f) {
+	return 0x7fff;
+    }
+
+    return (uint32_t)(gain * (float)I2S_MIXER_GAIN_UNITY + 0.5f);
+}
+
+I2SMixerClass::I2SMixerClass(I2SClass &i2s)
+{
+    _i2s = &i2s;
+    _voices = 0;
+
+    memset(&_voice[0], 0, sizeof(_voice));
+}
+
+int I2SMixerClass::begin()
+{
+    return _i2s->attachMixer(this);
+}
+
+void I2SMixerClass::end()
+{
+    _i2s->detachMixer(this);
+}
+
+int I2SMixerClass::attach(I2SMixerSource source, void *context)
+{
+    unsigned int voice;
+
+    for (voice = 0; voice < I2S_MIXER_VOICE_COUNT; voice++) {
+	if (!_voice[voice].source) {
+	    _voice[voice].source = source;
+	    _voice[voice].context = context;
+	    _voice[voice].gain = I2S_MIXER_GAIN_UNITY | (I2S_MIXER_GAIN_UNITY << 16);
+
+	    Bitband(&_voices, voice).set();
+
+	    return voice;
+	}
+    }
+
+    return -1;
+}
+
+void I2SMixerClass::detach(int voice)
+{
+    if ((unsigned int)voice >= I2S_MIXER_VOICE_COUNT) {
+	return;
+    }
+
+    // mix() runs in the SAI interrupt, so once the bit is cleared the
+    // voice is not referenced anymore.
+    Bitband(&_voices, voice).clear();
+
+    _voice[voice].source = NULL;
+}
+
+void I2SMixerClass::setGain(int voice, float gain)
+{
+    setGain(voice, gain, gain);
+}
+
+void I2SMixerClass::setGain(int voice, float left, float right)
+{
+    if ((unsigned int)voice >= I2S_MIXER_VOICE_COUNT) {
+	return;
+    }
+
+    // A single store, so that mix() never sees one side updated without the other.
+    _voice[voice].gain = i2s_mixer_gain(left) | (i2s_mixer_gain(right) << 16);
+}
+
+__fastcode void I2SMixerClass::mix(uint32_t *data, uint32_t frames)
+{
+    uint32_t voices, voice, offset, count, filled, blend, gain, gain_l, gain_r;
+    const int16_t *source;
+    bool unity;
+
+    filled = 0;
+
+    voices = _voices;
+
+    while (voices) {
+	voice = __builtin_ctz(voices);
+
+	voices &= ~(1u << voice);
+
+	gain = _voice[voice].gain;
+	gain_l = gain & 0x0000ffff;
+	gain_r = gain & 0xffff0000;
+
+	if ((gain_l | gain_r) == 0) {
+	    continue;
+	}
+
+	unity = ((gain_l == I2S_MIXER_GAIN_UNITY) && (gain_r == (I2S_MIXER_GAIN_UNITY << 16)));
+
+	for (offset = 0; offset < frames; offset += count) {
+	    count = (*_voice[voice].source)(_voice[voice].context, &source, (frames - offset));
+
+	    if (count == 0) {
+		break;
+	    }
+
+	    if (count > (frames - offset)) {
+		count = frames - offset;
+	    }
+
+	    // [offset, blend) overlaps frames from previous voices, [blend, offset + count) is new
+	    blend = (filled > offset) ? ((filled < (offset + count)) ? filled : (offset + count)) : offset;
+
+	    if (unity) {
+		i2s_mixer_add(&data[offset], (const uint32_t*)source, (blend - offset));
+		i2s_mixer_copy(&data[blend], (const uint32_t*)source + (blend - offset), ((offset + count) - blend));
+	    } else {
+		i2s_mixer_add_scaled(&data[offset], (const uint32_t*)source, (blend - offset), gain_l, gain_r);
+		i2s_mixer_copy_scaled(&data[blend], (const uint32_t*)source + (blend - offset), ((offset + count) - blend), gain_l, gain_r);
+	    }
+
+	    if (filled < (offset + count)) {
+		filled = offset + count;
+	    }
+	}
+    }
+
+    if (filled < frames) {
+	memset(&data[filled], 0, ((frames - filled) * sizeof(uint32_t)));
+    }
+}
@@ -0,0 +1,77 @@
+/*
+ * Copyright (c) 2016 Thomas Roell.  All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal with the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ *  1. Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimers.
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimers in the
+ *     documentation and/or other materials provided with the distribution.
+ *  3. Neither the name of Thomas Roell, nor the names of its contributors
+ *     may be used to endorse or promote products derived from this Software
+ *     without specific prior written permission.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ * CONTRIBUTORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * WITH THE SOFTWARE.
+ */
+
+#ifndef _I2S_MIXER_H_INCLUDED
+#define _I2S_MIXER_H_INCLUDED
+
+#include <Arduino.h>
+#include "I2S.h"
+
+#define I2S_MIXER_VOICE_COUNT 16
+
+// A voice source hands out up to "frames" interleaved 16 bit stereo frames
+// by storing a (word aligned) pointer to them in "*p_data". The return value
+// is the number of frames available at "*p_data". The source is called again
+// for the rest of the buffer, until it returns 0 (silence for the remainder).
+//
+// NOTE: sources are called from the SAI interrupt.
+typedef size_t (*I2SMixerSource)(void *context, const int16_t **p_data, size_t frames);
+
+class I2SMixerClass
+{
+public:
+    I2SMixerClass(I2SClass &i2s);
+
+    // I2S needs to be started with 16 bits per sample
+    int begin();
+    void end();
+
+    // returns the voice index, or -1 if there are no free voices
+    int attach(I2SMixerSource source, void *context = NULL);
+    void detach(int voice);
+
+    // gain is in the range of [0.0 .. 2.0)
+    void setGain(int voice, float gain);
+    void setGain(int voice, float left, float right);
+
+private:
+    I2SClass *_i2s;
+    volatile uint32_t _voices;
+
+    struct {
+	I2SMixerSource source;
+	void *context;
+	volatile uint32_t gain;   // left in the lower, right in the upper halfword
+    } _voice[I2S_MIXER_VOICE_COUNT];
+
+    void mix(uint32_t *data, uint32_t frames);
+
+    friend class I2SClass;
+};
+
+#endif
@@ -0,0 +1,591 @@
+/*
+ * Copyright (c) 2016 Thomas Roell.  All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal with the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ *  1. Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimers.
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimers in the
+ *     documentation and/or other materials provided with the distribution.
+ *  3. Neither the name of Thomas Roell, nor the names of its contributors
+ *     may be used to endorse or promote products derived from this Software
+ *     without specific prior written permission.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ * CONTRIBUTORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * WITH THE SOFTWARE.
+ */
+
+#include "Arduino.h"
+#include "stm32l4_wiring_private.h"
+#include "I2SPlayer.h"
+
+static inline uint32_t i2s_player_le16(const uint8_t *data)
+{
+    return ((uint32_t)data[0] << 0) | ((uint32_t)data[1] << 8);
+}
+
+static inline uint32_t i2s_player_le32(const uint8_t *data)
+{
+    return ((uint32_t)data[0] << 0) | ((uint32_t)data[1] << 8) | ((uint32_t)data[2] << 16) | ((uint32_t)data[3] << 24);
+}
+
+#define I2S_PLAYER_FORMAT_PCM   1
+#define I2S_PLAYER_FORMAT_ADPCM 0x11
+
+static const uint16_t i2s_player_adpcm_step[89] = {
+    7, 8, 9, 10, 11, 12, 13, 14, 16, 17,
+    19, 21, 23, 25, 28, 31, 34, 37, 41, 45,
+    50, 55, 60, 66, 73, 80, 88, 97, 107, 118,
+    130, 143, 157, 173, 190, 209, 230, 253, 279, 307,
+    337, 371, 408, 449, 494, 544, 598, 658, 724, 796,
+    876, 963, 1060, 1166, 1282, 1411, 1552, 1707, 1878, 2066,
+    2272, 2499, 2749, 3024, 3327, 3660, 4026, 4428, 4871, 5358,
+    5894, 6484, 7132, 7845, 8630, 9493, 10442, 11487, 12635, 13899,
+    15289, 16818, 18500, 20350, 22385, 24623, 27086, 29794, 32767
+};
+
+static const int8_t i2s_player_adpcm_index[16] = {
+    -1, -1, -1, -1, 2, 4, 6, 8,
+    -1, -1, -1, -1, 2, 4, 6, 8
+};
+
+// Decodes the 8 nibbles (low nibble first) of "data" into every "stride"-th halfword of "pcm".
+static inline __attribute__((always_inline)) void i2s_player_adpcm_decode(int16_t *pcm, uint32_t stride, uint32_t data, int32_t *p_predictor, int32_t *p_index)
+{
+    int32_t predictor, index, step, diff;
+    uint32_t nibble, n;
+
+    predictor = *p_predictor;
+    index = *p_index;
+
+    for (n = 0; n < 8; n++, data >>= 4) {
+	nibble = data & 15;
+
+	step = i2s_player_adpcm_step[index];
+
+	diff = step >> 3;
+
+	if (nibble & 1) {
+	    diff += (step >> 2);
+	}
+
+	if (nibble & 2) {
+	    diff += (step >> 1);
+	}
+
+	if (nibble & 4) {
+	    diff += step;
+	}
+
+	predictor = __SSAT(((nibble & 8) ? (predictor - diff) : (predictor + diff)), 16);
+
+	index += i2s_player_adpcm_index[nibble];
+
+	index = (index < 0) ? 0 : ((index > 88) ? 88 : index);
+
+	pcm[n * stride] = predictor;
+    }
+
+    *p_predictor = predictor;
+    *p_index = index;
+}
+
+I2SPlayerClass::I2SPlayerClass(void *buffer, size_t size)
+{
+    _mixer = NULL;
+    _resampler = NULL;
+    _voice = -1;
+    _file = NULL;
+
+    _data = (uint8_t*)buffer;
+    _size = size & ~(F_SECTOR_SIZE -1);
+    _threshold = _size / 2;
+    _rate = 0;
+    _format = I2S_PLAYER_FORMAT_PCM;
+    _channels = 2;
+    _unit = 4;
+    _block_align = 0;
+
+    _gain_l = 1.0f;
+    _gain_r = 1.0f;
+
+    _remaining = 0;
+    _read = 0;
+    _write = 0;
+    _level = 0;
+    _eof = true;
+    _refill = false;
+    _underruns = 0;
+}
+
+int I2SPlayerClass::begin(I2SMixerClass &mixer, const char *path)
+{
+    return start(mixer, path, NULL, 0);
+}
+
+int I2SPlayerClass::begin(I2SMixerClass &mixer, const char *path, I2SResamplerClass &resampler, uint32_t outputRate)
+{
+    return start(mixer, path, &resampler, outputRate);
+}
+
+int I2SPlayerClass::start(I2SMixerClass &mixer, const char *path, I2SResamplerClass *resampler, uint32_t outputRate)
+{
+    uint32_t offset, basepri;
+
+    if (_file || !_size || ((uint32_t)_data & 3)) {
+	return 0;
+    }
+
+    // Other players refill from PendSV, and DOSFS is not reentrant, so the
+    // file is opened and primed with PendSV masked.
+    basepri = armv7m_critical_enter(STM32L4_PENDSV_IRQ_PRIORITY);
+
+    _file = f_open(path, "rS");
+
+    if (_file && !header()) {
+	f_close(_file);
+
+	_file = NULL;
+    }
+
+    if (_file) {
+	// Keep the ring offset congruent to the file position modulo a sector,
+	// so that refills which end at the ring's end are sector aligned and
+	// go straight to the device as multi-block reads.
+	offset = f_tell(_file);
+
+	_read = offset & (F_SECTOR_SIZE -1);
+	_write = _read;
+	_level = 0;
+	_eof = false;
+	_refill = false;
+	_underruns = 0;
+
+	_block = 0;
+	_pcm_offset = 0;
+	_pcm_count = 0;
+
+	fill();
+    }
+
+    armv7m_critical_leave(basepri);
+
+    if (!_file) {
+	return 0;
+    }
+
+    // Headerless PCM has no rate, and is played as is.
+    if (resampler && _rate && (_rate != outputRate)) {
+	if (!resampler->begin(I2SPlayerClass::_sourceCallback, (void*)this, _rate, outputRate)) {
+	    close();
+
+	    return 0;
+	}
+
+	_resampler = resampler;
+
+	_voice = mixer.attach(I2SResamplerClass::sourceCallback, (void*)_resampler);
+    } else {
+	_voice = mixer.attach(I2SPlayerClass::_sourceCallback, (void*)this);
+    }
+
+    if (_voice < 0) {
+	if (_resampler) {
+	    _resampler->end();
+
+	    _resampler = NULL;
+	}
+
+	close();
+
+	return 0;
+    }
+
+    _mixer = &mixer;
+    _mixer->setGain(_voice, _gain_l, _gain_r);
+
+    return 1;
+}
+
+void I2SPlayerClass::end()
+{
+    if (!_file) {
+	return;
+    }
+
+    _mixer->detach(_voice);
+
+    if (_resampler) {
+	_resampler->end();
+
+	_resampler = NULL;
+    }
+
+    _mixer = NULL;
+    _voice = -1;
+
+    // PendSV preempts thread context, so a refill is either still queued
+    // or has completed.
+    while (_refill) {
+	armv7m_core_yield();
+    }
+
+    close();
+
+    _eof = true;
+    _level = 0;
+}
+
+bool I2SPlayerClass::playing()
+{
+    return _file && (!_eof || (_level >= _unit) || _pcm_count);
+}
+
+uint32_t I2SPlayerClass::sampleRate()
+{
+    return _rate;
+}
+
+uint32_t I2SPlayerClass::underruns()
+{
+    return _underruns;
+}
+
+void I2SPlayerClass::setThreshold(unsigned int sectors)
+{
+    _threshold = sectors * F_SECTOR_SIZE;
+
+    if (_threshold > _size) {
+	_threshold = _size;
+    }
+}
+
+void I2SPlayerClass::setGain(float gain)
+{
+    setGain(gain, gain);
+}
+
+void I2SPlayerClass::setGain(float left, float right)
+{
+    _gain_l = left;
+    _gain_r = right;
+
+    if (_mixer) {
+	_mixer->setGain(_voice, left, right);
+    }
+}
+
+void I2SPlayerClass::close()
+{
+    uint32_t basepri;
+
+    basepri = armv7m_critical_enter(STM32L4_PENDSV_IRQ_PRIORITY);
+
+    f_close(_file);
+
+    armv7m_critical_leave(basepri);
+
+    _file = NULL;
+}
+
+bool I2SPlayerClass::header()
+{
+    uint8_t data[16];
+    uint32_t size, format;
+
+    _rate = 0;
+    _format = I2S_PLAYER_FORMAT_PCM;
+    _channels = 2;
+    _unit = 4;
+    _remaining = 0xffffffff;
+
+    if ((f_read(data, 1, 12, _file) != 12) || memcmp(&data[0], "RIFF", 4) || memcmp(&data[8], "WAVE", 4)) {
+	// Not a WAV file, assume headerless 16 bit stereo PCM.
+	return (f_seek(_file, 0, F_SEEK_SET) == F_NO_ERROR);
+    }
+
+    format = 0;
+
+    while (f_read(data, 1, 8, _file) == 8) {
+	size = i2s_player_le32(&data[4]);
+
+	if (!memcmp(&data[0], "data", 4)) {
+	    if (!format || (f_tell(_file) & 3)) {
+		return false;
+	    }
+
+	    // Chunks after the data (LIST, id3, ...) are not to be played. A size
+	    // of 0 (or 0xffffffff) is left by writers that stream to the end of file.
+	    if (size) {
+		_remaining = size;
+	    }
+
+	    return true;
+	}
+
+	if (!memcmp(&data[0], "fmt ", 4)) {
+	    if ((size < 16) || (f_read(data, 1, 16, _file) != 16)) {
+		return false;
+	    }
+
+	    format = i2s_player_le16(&data[0]);
+
+	    if (format == I2S_PLAYER_FORMAT_PCM) {
+		// PCM, 2 channels, 16 bits per sample
+		if ((i2s_player_le16(&data[2]) != 2) || (i2s_player_le16(&data[14]) != 16)) {
+		    return false;
+		}
+	    } else if (format == I2S_PLAYER_FORMAT_ADPCM) {
+		// IMA-ADPCM, 1 or 2 channels, 4 bits per sample. Each block has a 4 byte
+		// header per channel, followed by groups of 4 bytes (8 samples) per channel.
+		_channels = i2s_player_le16(&data[2]);
+		_block_align = i2s_player_le16(&data[12]);
+		_unit = 4 * _channels;
+
+		if (((_channels != 1) && (_channels != 2)) || (i2s_player_le16(&data[14]) != 4) ||
+		    (_block_align <= _unit) || (_block_align % _unit) || (_block_align > _size)) {
+		    return false;
+		}
+	    } else {
+		return false;
+	    }
+
+	    _format = format;
+	    _rate = i2s_player_le32(&data[4]);
+
+	    size -= 16;
+	}
+
+	if (f_seek(_file, ((size + 1) & ~1), F_SEEK_CUR) != F_NO_ERROR) {
+	    return false;
+	}
+    }
+
+    return false;
+}
+
+void I2SPlayerClass::fill()
+{
+    uint32_t free, count, end;
+    long total;
+
+    while (!_eof) {
+	free = _size - _level;
+
+	end = _write + free;
+
+	if (end > _size) {
+	    end = _size;
+	}
+
+	end &= ~(F_SECTOR_SIZE -1);
+
+	if (end <= _write) {
+	    break;
+	}
+
+	count = end - _write;
+
+	if (count > _remaining) {
+	    count = _remaining;
+	}
+
+	total = f_read(_data + _write, 1, count, _file);
+
+	if (total > 0) {
+	    _remaining -= total;
+	}
+
+	if ((total < (long)count) || !_remaining) {
+	    _eof = true;
+	}
+
+	if (total > 0) {
+	    _write += total;
+
+	    if (_write == _size) {
+		_write = 0;
+	    }
+
+	    armv7m_atomic_add(&_level, total);
+	}
+    }
+}
+
+// Decodes up to I2S_PLAYER_DECODE_SIZE frames into "_pcm", consuming whole
+// block headers and sample groups. Returns the remaining read-ahead.
+uint32_t I2SPlayerClass::decode()
+{
+    uint32_t level, count, consumed, data_l, data_r;
+    int16_t *pcm;
+
+    level = _level;
+    count = 0;
+    consumed = 0;
+
+    while ((count < I2S_PLAYER_DECODE_SIZE) && ((level - consumed) >= _unit)) {
+	pcm = (int16_t*)&_pcm[count];
+
+	data_l = *((const uint32_t*)(_data + _read));
+	data_r = data_l;
+
+	_read += 4;
+
+	if (_read == _size) {
+	    _read = 0;
+	}
+
+	if (_channels == 2) {
+	    data_r = *((const uint32_t*)(_data + _read));
+
+	    _read += 4;
+
+	    if (_read == _size) {
+		_read = 0;
+	    }
+	}
+
+	if (_block == 0) {
+	    // The block header carries the first sample and the step index.
+	    _adpcm[0].predictor = (int16_t)data_l;
+	    _adpcm[0].index = ((data_l >> 16) & 0xff) > 88 ? 88 : ((data_l >> 16) & 0xff);
+	    _adpcm[1].predictor = (int16_t)data_r;
+	    _adpcm[1].index = ((data_r >> 16) & 0xff) > 88 ? 88 : ((data_r >> 16) & 0xff);
+
+	    pcm[0] = _adpcm[0].predictor;
+	    pcm[1] = _adpcm[1].predictor;
+
+	    count += 1;
+	} else {
+	    i2s_player_adpcm_decode(&pcm[0], 2, data_l, &_adpcm[0].predictor, &_adpcm[0].index);
+
+	    if (_channels == 2) {
+		i2s_player_adpcm_decode(&pcm[1], 2, data_r, &_adpcm[1].predictor, &_adpcm[1].index);
+	    } else {
+		for (unsigned int n = 0; n < 8; n++) {
+		    pcm[2 * n + 1] = pcm[2 * n + 0];
+		}
+	    }
+
+	    count += 8;
+	}
+
+	consumed += _unit;
+
+	_block += _unit;
+
+	if (_block == _block_align) {
+	    _block = 0;
+	}
+    }
+
+    _pcm_offset = 0;
+    _pcm_count = count;
+
+    if (consumed) {
+	level = armv7m_atomic_sub(&_level, consumed) - consumed;
+    }
+
+    return level;
+}
+
+size_t I2SPlayerClass::SourceCallback(const int16_t **p_data, size_t frames)
+{
+    uint32_t level, count;
+
+    if (_format == I2S_PLAYER_FORMAT_ADPCM) {
+	level = _level;
+
+	if (!_pcm_count) {
+	    level = decode();
+	}
+
+	count = (_pcm_count > frames) ? frames : _pcm_count;
+
+	if (count) {
+	    *p_data = (const int16_t*)&_pcm[_pcm_offset];
+
+	    _pcm_offset += count;
+	    _pcm_count -= count;
+	} else {
+	    if (!_eof) {
+		_underruns++;
+	    }
+	}
+
+	if (!_eof && !_refill && (level < _threshold)) {
+	    _refill = true;
+
+	    if (!armv7m_pendsv_enqueue(I2SPlayerClass::_refillCallback, (void*)this, 0)) {
+		_refill = false;
+	    }
+	}
+
+	return count;
+    }
+
+    level = _level;
+
+    count = _size - _read;
+
+    if (count > level) {
+	count = level;
+    }
+
+    count /= 4;
+
+    if (count > frames) {
+	count = frames;
+    }
+
+    if (count) {
+	*p_data = (const int16_t*)(_data + _read);
+
+	_read += (count * 4);
+
+	if (_read == _size) {
+	    _read = 0;
+	}
+
+	level = armv7m_atomic_sub(&_level, (count * 4)) - (count * 4);
+    } else {
+	if (!_eof) {
+	    _underruns++;
+	}
+    }
+
+    if (!_eof && !_refill && (level < _threshold)) {
+	_refill = true;
+
+	if (!armv7m_pendsv_enqueue(I2SPlayerClass::_refillCallback, (void*)this, 0)) {
+	    _refill = false;
+	}
+    }
+
+    return count;
+}
+
+size_t I2SPlayerClass::_sourceCallback(void *context, const int16_t **p_data, size_t frames)
+{
+    return reinterpret_cast<class I2SPlayerClass*>(context)->SourceCallback(p_data, frames);
+}
+
+void I2SPlayerClass::_refillCallback(void *context, uint32_t data)
+{
+    class I2SPlayerClass *self = reinterpret_cast<class I2SPlayerClass*>(context);
+
+    self->fill();
+
+    self->_refill = false;
+}
@@ -0,0 +1,113 @@
+/*
+ * Copyright (c) 2016 Thomas Roell.  All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal with the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ *  1. Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimers.
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimers in the
+ *     documentation and/or other materials provided with the distribution.
+ *  3. Neither the name of Thomas Roell, nor the names of its contributors
+ *     may be used to endorse or promote products derived from this Software
+ *     without specific prior written permission.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ * CONTRIBUTORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * WITH THE SOFTWARE.
+ */
+
+#ifndef _I2S_PLAYER_H_INCLUDED
+#define _I2S_PLAYER_H_INCLUDED
+
+#include <Arduino.h>
+#include <dosfs_api.h>
+#include "I2S.h"
+#include "I2SMixer.h"
+#include "I2SResampler.h"
+
+#define I2S_PLAYER_DECODE_SIZE 64   // ADPCM frames decoded per refill of the PCM buffer
+
+// Streams a 16 bit stereo WAV (or headerless PCM) file from DOSFS into an
+// I2SMixerClass voice. The read-ahead buffer is refilled from PendSV in
+// multiples of F_SECTOR_SIZE, so loop() is not on the critical path.
+//
+// Mono or stereo IMA-ADPCM WAV files (format 0x11, 4 bits per sample) are
+// decoded in the mixer callback, I2S_PLAYER_DECODE_SIZE frames at a time.
+// At a quarter of the PCM data rate they take a quarter of the SD card
+// bandwidth (and read-ahead buffer) per stream.
+//
+// NOTE: DOSFS is not reentrant. While a player is active the sketch must
+// not access DOSFS from thread context.
+class I2SPlayerClass
+{
+public:
+    // "size" is rounded down to a multiple of F_SECTOR_SIZE; "buffer" needs to be word aligned
+    I2SPlayerClass(void *buffer, size_t size);
+
+    int begin(I2SMixerClass &mixer, const char *path);
+    // STM32L4 EXTENSION: converts a WAV file whose rate is not "outputRate" (the SAI rate) via "resampler"
+    int begin(I2SMixerClass &mixer, const char *path, I2SResamplerClass &resampler, uint32_t outputRate);
+    void end();
+
+    bool playing();
+    uint32_t sampleRate();
+    uint32_t underruns();
+
+    // once the read-ahead falls below "sectors" a refill is scheduled
+    void setThreshold(unsigned int sectors);
+    void setGain(float gain);
+    void setGain(float left, float right);
+
+private:
+    I2SMixerClass *_mixer;
+    I2SResamplerClass *_resampler;
+    int _voice;
+    F_FILE *_file;
+    uint8_t *_data;
+    uint32_t _size;
+    uint32_t _threshold;
+    uint32_t _rate;
+    uint8_t _format;
+    uint8_t _channels;
+    uint16_t _unit;
+    uint32_t _block_align;
+    uint32_t _block;
+    struct {
+	int32_t predictor;
+	int32_t index;
+    } _adpcm[2];
+    uint32_t _pcm_offset;
+    uint32_t _pcm_count;
+    uint32_t _pcm[I2S_PLAYER_DECODE_SIZE + 8];
+    float _gain_l;
+    float _gain_r;
+    uint32_t _remaining;
+    uint32_t _read;
+    uint32_t _write;
+    volatile uint32_t _level;
+    volatile uint8_t _eof;
+    volatile uint8_t _refill;
+    volatile uint32_t _underruns;
+
+    int start(I2SMixerClass &mixer, const char *path, I2SResamplerClass *resampler, uint32_t outputRate);
+    void close();
+    bool header();
+    void fill();
+    uint32_t decode();
+
+    static size_t _sourceCallback(void *context, const int16_t **p_data, size_t frames);
+    static void _refillCallback(void *context, uint32_t data);
+    size_t SourceCallback(const int16_t **p_data, size_t frames);
+};
+
+#endif
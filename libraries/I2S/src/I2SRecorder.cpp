@@ -0,0 +1,257 @@
+/*
+ * Copyright (c) 2016 Thomas Roell.  All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal with the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ *  1. Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimers.
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimers in the
+ *     documentation and/or other materials provided with the distribution.
+ *  3. Neither the name of Thomas Roell, nor the names of its contributors
+ *     may be used to endorse or promote products derived from this Software
+ *     without specific prior written permission.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ * CONTRIBUTORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * WITH THE SOFTWARE.
+ */
+
+#include "Arduino.h"
+#include "stm32l4_wiring_private.h"
+#include "I2SRecorder.h"
+
+static inline void i2s_recorder_le16(uint8_t *data, uint32_t value)
+{
+    data[0] = value >> 0;
+    data[1] = value >> 8;
+}
+
+static inline void i2s_recorder_le32(uint8_t *data, uint32_t value)
+{
+    data[0] = value >> 0;
+    data[1] = value >> 8;
+    data[2] = value >> 16;
+    data[3] = value >> 24;
+}
+
+I2SRecorderClass::I2SRecorderClass()
+{
+    _i2s = NULL;
+    _file = NULL;
+    _rate = 0;
+    _limit = 0;
+    _length = 0;
+    _status = F_NO_ERROR;
+    _underruns = 0;
+    _overruns = 0;
+    _flush = false;
+}
+
+int I2SRecorderClass::begin(I2SClass &i2s, const char *path, uint32_t sampleRate, uint32_t size)
+{
+    if (_file || (size <= I2S_RECORDER_HEADER_SIZE)) {
+	return 0;
+    }
+
+    _file = f_open(path, "w");
+
+    if (!_file) {
+	return 0;
+    }
+
+    _rate = sampleRate;
+    _limit = (size - I2S_RECORDER_HEADER_SIZE);
+    _length = 0;
+    _status = F_NO_ERROR;
+    _flush = false;
+
+    _i2s = &i2s;
+
+    if ((f_reserve(_file, size) != F_NO_ERROR) || !header(0) || !i2s.attachRecorder(this)) {
+	f_close(_file);
+
+	_file = NULL;
+	_i2s = NULL;
+
+	return 0;
+    }
+
+    _underruns = i2s.underruns();
+    _overruns = 0;
+
+    // Pick up segments that were received before the recorder got attached.
+    schedule();
+
+    return 1;
+}
+
+void I2SRecorderClass::end()
+{
+    if (!_file) {
+	return;
+    }
+
+    _i2s->detachRecorder(this);
+
+    // PendSV preempts thread context, so a flush is either still queued
+    // or has completed.
+    while (_flush) {
+	armv7m_core_yield();
+    }
+
+    drain();
+
+    _overruns = _i2s->underruns() - _underruns;
+
+    if (_status == F_NO_ERROR) {
+	if (!header(_length)) {
+	    _status = f_error(_file);
+	}
+    }
+
+    f_close(_file);
+
+    _file = NULL;
+    _i2s = NULL;
+}
+
+bool I2SRecorderClass::recording()
+{
+    return _file && (_status == F_NO_ERROR) && (_length < _limit);
+}
+
+uint32_t I2SRecorderClass::length()
+{
+    return _length;
+}
+
+uint32_t I2SRecorderClass::overruns()
+{
+    if (!_file) {
+	return _overruns;
+    }
+
+    return _i2s->underruns() - _underruns;
+}
+
+int I2SRecorderClass::status()
+{
+    return _status;
+}
+
+// Writes the WAV header into the first sector, and leaves the file
+// position behind the header (and "length" bytes of data).
+bool I2SRecorderClass::header(uint32_t length)
+{
+    uint32_t data[I2S_RECORDER_HEADER_SIZE / sizeof(uint32_t)];
+    uint8_t *header = (uint8_t*)&data[0];
+    uint32_t channels, width;
+
+    channels = _i2s->_channels;
+    width = _i2s->_width;
+
+    memset(header, 0, I2S_RECORDER_HEADER_SIZE);
+
+    memcpy(&header[0], "RIFF", 4);
+    i2s_recorder_le32(&header[4], (I2S_RECORDER_HEADER_SIZE - 8) + length);
+    memcpy(&header[8], "WAVE", 4);
+
+    memcpy(&header[12], "fmt ", 4);
+    i2s_recorder_le32(&header[16], 16);
+    i2s_recorder_le16(&header[20], 1);
+    i2s_recorder_le16(&header[22], channels);
+    i2s_recorder_le32(&header[24], _rate);
+    i2s_recorder_le32(&header[28], _rate * channels * (width / 8));
+    i2s_recorder_le16(&header[32], channels * (width / 8));
+    i2s_recorder_le16(&header[34], width);
+
+    // Pad the header to a full sector, so that the audio data is sector aligned.
+    memcpy(&header[36], "JUNK", 4);
+    i2s_recorder_le32(&header[40], (I2S_RECORDER_HEADER_SIZE - 8) - 44);
+
+    memcpy(&header[I2S_RECORDER_HEADER_SIZE - 8], "data", 4);
+    i2s_recorder_le32(&header[I2S_RECORDER_HEADER_SIZE - 4], length);
+
+    if ((f_seek(_file, 0, F_SEEK_SET) != F_NO_ERROR) ||
+	(f_write(header, 1, I2S_RECORDER_HEADER_SIZE, _file) != I2S_RECORDER_HEADER_SIZE) ||
+	(f_seek(_file, I2S_RECORDER_HEADER_SIZE + length, F_SEEK_SET) != F_NO_ERROR)) {
+	return false;
+    }
+
+    return true;
+}
+
+// Writes all filled segments. Once the reserved space is used up, or after
+// a write error, segments are just handed back to the SAI.
+void I2SRecorderClass::drain()
+{
+    const uint8_t *data;
+    size_t frames;
+    uint32_t size, length;
+    long total;
+
+    length = _length;
+
+    while ((data = (const uint8_t*)_i2s->acquireRxBuffer(&frames))) {
+	size = frames * _i2s->_channels * (_i2s->_width / 8);
+
+	if (size > (_limit - length)) {
+	    size = (_limit - length);
+	}
+
+	if (size && (_status == F_NO_ERROR)) {
+	    total = f_write(data, 1, size, _file);
+
+	    if (total > 0) {
+		length += total;
+	    }
+
+	    if (total != (long)size) {
+		_status = f_error(_file);
+
+		if (_status == F_NO_ERROR) {
+		    _status = F_ERR_WRITE;
+		}
+	    }
+	}
+
+	_i2s->releaseRxBuffer();
+    }
+
+    _length = length;
+}
+
+// Called from the SAI interrupt for every filled segment.
+void I2SRecorderClass::schedule()
+{
+    if (!_flush) {
+	_flush = true;
+
+	if (!armv7m_pendsv_enqueue(I2SRecorderClass::_flushCallback, (void*)this, 0)) {
+	    _flush = false;
+	}
+    }
+}
+
+void I2SRecorderClass::_flushCallback(void *context, uint32_t data)
+{
+    class I2SRecorderClass *self = reinterpret_cast<class I2SRecorderClass*>(context);
+
+    // Clear the flag first, so that a segment completing during drain()
+    // queues another flush.
+    self->_flush = false;
+
+    if (self->_i2s && self->_i2s->_recorder == self) {
+	self->drain();
+    }
+}
@@ -0,0 +1,89 @@
+/*
+ * Copyright (c) 2016 Thomas Roell.  All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal with the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ *  1. Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimers.
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimers in the
+ *     documentation and/or other materials provided with the distribution.
+ *  3. Neither the name of Thomas Roell, nor the names of its contributors
+ *     may be used to endorse or promote products derived from this Software
+ *     without specific prior written permission.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ * CONTRIBUTORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * WITH THE SOFTWARE.
+ */
+
+#ifndef _I2S_RECORDER_H_INCLUDED
+#define _I2S_RECORDER_H_INCLUDED
+
+#include <Arduino.h>
+#include <dosfs_api.h>
+#include "I2S.h"
+
+#define I2S_RECORDER_HEADER_SIZE F_SECTOR_SIZE
+
+// Streams the receive DMA segments of an I2SClass straight into a WAV file
+// on DOSFS. Each filled segment is written from PendSV, so loop() is not on
+// the critical path, and the I2S ring (the "depth" and "size" passed to
+// I2SClass::begin()) is what absorbs the SD card's busy times. Segments
+// should be a multiple of F_SECTOR_SIZE, so that every write goes straight
+// to the device.
+//
+// "size" bytes are reserved as a contiguous file up front, so that writes
+// never have to update the FAT. Recording stops once they are used up.
+// The WAV header occupies the first sector (padded with a "JUNK" chunk),
+// and is completed by end().
+//
+// overruns() counts (also after end()) the segments the SAI had to drop because all of them
+// were still waiting to be written.
+//
+// NOTE: DOSFS is not reentrant. While a recorder is active the sketch must
+// not access DOSFS from thread context, nor read from the I2SClass.
+class I2SRecorderClass
+{
+public:
+    I2SRecorderClass();
+
+    // "i2s" needs to have been started in receive mode; "sampleRate" only goes into the WAV header
+    int begin(I2SClass &i2s, const char *path, uint32_t sampleRate, uint32_t size);
+    void end();
+
+    bool recording();
+    uint32_t length();      // bytes of audio data written so far
+    uint32_t overruns();
+    int status();           // first DOSFS error, or F_NO_ERROR
+
+private:
+    I2SClass *_i2s;
+    F_FILE *_file;
+    uint32_t _rate;
+    uint32_t _limit;
+    volatile uint32_t _length;
+    volatile int _status;
+    uint32_t _underruns;
+    uint32_t _overruns;
+    volatile uint8_t _flush;
+
+    void schedule();
+    void drain();
+    bool header(uint32_t length);
+
+    static void _flushCallback(void *context, uint32_t data);
+
+    friend class I2SClass;
+};
+
+#endif
@@ -0,0 +1,240 @@
+/*
+ * Copyright (c) 2016 Thomas Roell.  All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal with the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ *  1. Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimers.
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimers in the
+ *     documentation and/or other materials provided with the distribution.
+ *  3. Neither the name of Thomas Roell, nor the names of its contributors
+ *     may be used to endorse or promote products derived from this Software
+ *     without specific prior written permission.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ * CONTRIBUTORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * WITH THE SOFTWARE.
+ */
+
+#include "Arduino.h"
+#include "stm32l4_wiring_private.h"
+#include "I2SResampler.h"
+
+static_assert(((I2S_RESAMPLER_TAPS & 1) == 0), "I2S_RESAMPLER_TAPS needs to be even");
+static_assert(((I2S_RESAMPLER_PHASES & (I2S_RESAMPLER_PHASES -1)) == 0), "I2S_RESAMPLER_PHASES needs to be a power of 2");
+
+#define I2S_RESAMPLER_PHASE_SHIFT (32 - __builtin_ctz(I2S_RESAMPLER_PHASES))
+
+// Two adjacent Q15 samples as one word; the M4 does unaligned LDR.
+static inline __attribute__((always_inline)) uint32_t i2s_resampler_pair(const int16_t *data)
+{
+    uint32_t pair;
+
+    memcpy(&pair, data, sizeof(pair));
+
+    return pair;
+}
+
+static inline __attribute__((always_inline)) uint32_t i2s_resampler_filter(const int16_t *coeffs, const int16_t *left, const int16_t *right)
+{
+    int32_t sum_l, sum_r;
+    uint32_t coeff, index;
+
+    sum_l = 0;
+    sum_r = 0;
+
+    for (index = 0; index < I2S_RESAMPLER_TAPS; index += 2) {
+	coeff = *((const uint32_t*)&coeffs[index]);
+
+	sum_l = __SMLAD(coeff, i2s_resampler_pair(&left[index]), sum_l);
+	sum_r = __SMLAD(coeff, i2s_resampler_pair(&right[index]), sum_r);
+    }
+
+    return __PKHBT(__SSAT((sum_l >> 15), 16), __SSAT((sum_r >> 15), 16), 16);
+}
+
+I2SResamplerClass::I2SResamplerClass()
+{
+    _source = NULL;
+    _context = NULL;
+    _bypass = true;
+}
+
+bool I2SResamplerClass::begin(I2SMixerSource source, void *context, uint32_t inputRate, uint32_t outputRate)
+{
+    unsigned int phase, tap;
+    float cutoff, t, w, h, sum, taps[I2S_RESAMPLER_TAPS];
+
+    if (!source || !inputRate || !outputRate) {
+	return false;
+    }
+
+    // One output frame must never need more than the history holds.
+    if ((inputRate / outputRate) >= (I2S_RESAMPLER_HISTORY_SIZE - I2S_RESAMPLER_TAPS)) {
+	return false;
+    }
+
+    _source = source;
+    _context = context;
+    _bypass = (inputRate == outputRate);
+
+    _step_integer = inputRate / outputRate;
+    _step_fraction = (uint32_t)(((uint64_t)(inputRate % outputRate) << 32) / outputRate);
+
+    // Start with I2S_RESAMPLER_TAPS -1 frames of silence in the history.
+    memset(&_left[0], 0, sizeof(_left));
+    memset(&_right[0], 0, sizeof(_right));
+
+    _fraction = 0;
+    _index = 0;
+    _count = I2S_RESAMPLER_TAPS -1;
+
+    // Cut off a bit below the lower Nyquist frequency, relative to the input rate.
+    cutoff = 0.9f * ((outputRate < inputRate) ? ((float)outputRate / (float)inputRate) : 1.0f);
+
+    for (phase = 0; phase < I2S_RESAMPLER_PHASES; phase++) {
+	sum = 0.0f;
+
+	for (tap = 0; tap < I2S_RESAMPLER_TAPS; tap++) {
+	    // Distance of the tap from the output position, in input frames.
+	    t = (float)tap - (float)(I2S_RESAMPLER_TAPS / 2 -1) - ((float)phase / (float)I2S_RESAMPLER_PHASES);
+
+	    if (t == 0.0f) {
+		h = cutoff;
+	    } else {
+		h = sinf((float)M_PI * cutoff * t) / ((float)M_PI * t);
+	    }
+
+	    w = 0.42f + 0.5f * cosf((float)M_PI * t / (float)(I2S_RESAMPLER_TAPS / 2)) + 0.08f * cosf(2.0f * (float)M_PI * t / (float)(I2S_RESAMPLER_TAPS / 2));
+
+	    taps[tap] = h * w;
+
+	    sum += taps[tap];
+	}
+
+	// Normalize each phase to unity DC gain.
+	for (tap = 0; tap < I2S_RESAMPLER_TAPS; tap++) {
+	    _coeffs[phase][tap] = __SSAT((int32_t)lrintf(taps[tap] / sum * 32768.0f), 16);
+	}
+    }
+
+    return true;
+}
+
+void I2SResamplerClass::end()
+{
+    _source = NULL;
+    _context = NULL;
+}
+
+// Moves the unused part of the history to the front and appends as many frames
+// as the source can hand out. Returns false if the source had nothing.
+bool I2SResamplerClass::fill()
+{
+    const uint32_t *data;
+    uint32_t frame, count, index;
+
+    // When decimating "_index" may point past the buffered frames, in which
+    // case it carries the number of frames still to skip.
+    if (_index >= _count) {
+	_index -= _count;
+	_count = 0;
+    } else if (_index) {
+	memmove(&_left[0], &_left[_index], ((_count - _index) * sizeof(int16_t)));
+	memmove(&_right[0], &_right[_index], ((_count - _index) * sizeof(int16_t)));
+
+	_count -= _index;
+	_index = 0;
+    }
+
+    count = (*_source)(_context, (const int16_t**)&data, (I2S_RESAMPLER_HISTORY_SIZE - _count));
+
+    if (count == 0) {
+	return false;
+    }
+
+    if (count > (I2S_RESAMPLER_HISTORY_SIZE - _count)) {
+	count = I2S_RESAMPLER_HISTORY_SIZE - _count;
+    }
+
+    for (index = 0; index < count; index++) {
+	frame = data[index];
+
+	_left[_count + index] = (int16_t)frame;
+	_right[_count + index] = (int16_t)(frame >> 16);
+    }
+
+    _count += count;
+
+    return true;
+}
+
+__fastcode size_t I2SResamplerClass::SourceCallback(const int16_t **p_data, size_t frames)
+{
+    uint32_t *output, *output_e;
+    uint32_t fraction, index;
+
+    if (!_source) {
+	return 0;
+    }
+
+    if (_bypass) {
+	return (*_source)(_context, p_data, frames);
+    }
+
+    if (frames > I2S_RESAMPLER_BLOCK_SIZE) {
+	frames = I2S_RESAMPLER_BLOCK_SIZE;
+    }
+
+    output = &_output[0];
+    output_e = output + frames;
+
+    fraction = _fraction;
+    index = _index;
+
+    while (output != output_e) {
+	if ((index + I2S_RESAMPLER_TAPS) > _count) {
+	    _index = index;
+
+	    if (!fill()) {
+		break;
+	    }
+
+	    index = _index;
+
+	    continue;
+	}
+
+	*output++ = i2s_resampler_filter(&_coeffs[fraction >> I2S_RESAMPLER_PHASE_SHIFT][0], &_left[index], &_right[index]);
+
+	index += _step_integer;
+
+	fraction += _step_fraction;
+
+	if (fraction < _step_fraction) {
+	    index++;
+	}
+    }
+
+    _fraction = fraction;
+    _index = index;
+
+    *p_data = (const int16_t*)&_output[0];
+
+    return (output - &_output[0]);
+}
+
+size_t I2SResamplerClass::sourceCallback(void *context, const int16_t **p_data, size_t frames)
+{
+    return reinterpret_cast<class I2SResamplerClass*>(context)->SourceCallback(p_data, frames);
+}
@@ -0,0 +1,87 @@
+/*
+ * Copyright (c) 2016 Thomas Roell.  All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal with the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ *  1. Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimers.
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimers in the
+ *     documentation and/or other materials provided with the distribution.
+ *  3. Neither the name of Thomas Roell, nor the names of its contributors
+ *     may be used to endorse or promote products derived from this Software
+ *     without specific prior written permission.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ * CONTRIBUTORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * WITH THE SOFTWARE.
+ */
+
+#ifndef _I2S_RESAMPLER_H_INCLUDED
+#define _I2S_RESAMPLER_H_INCLUDED
+
+#include <Arduino.h>
+#include "I2SMixer.h"
+
+#define I2S_RESAMPLER_TAPS         16    // filter length in input frames (even)
+#define I2S_RESAMPLER_PHASES       32    // number of sub-sample positions (power of 2)
+#define I2S_RESAMPLER_BLOCK_SIZE   64    // output frames per call
+#define I2S_RESAMPLER_HISTORY_SIZE 256   // input frames buffered per channel
+
+// Polyphase sample rate converter between an I2SMixerSource running at
+// "inputRate" and a mixer voice running at "outputRate" (the SAI rate).
+//
+//     resampler.begin(source, context, 22050, 44100);
+//     voice = mixer.attach(I2SResamplerClass::sourceCallback, &resampler);
+//
+// The filter is a Blackman windowed sinc with I2S_RESAMPLER_TAPS taps per
+// output frame, selected out of I2S_RESAMPLER_PHASES sub-sample positions
+// and cut off below the lower of the two Nyquist frequencies. Input frames
+// are split into per channel Q15 histories, so that the inner loop is
+// 2 taps per __SMLAD(). Ratios like 22050 -> 44100 use exact phases; equal
+// rates bypass the filter. Other ratios are limited by the phase resolution
+// (about -45 dB for a 5 kHz tone at 22050 -> 48000, 6 dB better for every
+// doubling of I2S_RESAMPLER_PHASES, at 32 bytes per phase).
+//
+// The output is delayed by I2S_RESAMPLER_TAPS / 2 input frames. A source
+// returning 0 ends the current output block early; the next call picks up
+// where it left off.
+class I2SResamplerClass
+{
+public:
+    I2SResamplerClass();
+
+    bool begin(I2SMixerSource source, void *context, uint32_t inputRate, uint32_t outputRate);
+    void end();
+
+    static size_t sourceCallback(void *context, const int16_t **p_data, size_t frames);
+
+private:
+    I2SMixerSource _source;
+    void *_context;
+    uint32_t _step_integer;
+    uint32_t _step_fraction;
+    uint32_t _fraction;
+    uint32_t _index;
+    uint32_t _count;
+    bool _bypass;
+
+    int16_t _coeffs[I2S_RESAMPLER_PHASES][I2S_RESAMPLER_TAPS] __attribute__((aligned(4)));
+    int16_t _left[I2S_RESAMPLER_HISTORY_SIZE];
+    int16_t _right[I2S_RESAMPLER_HISTORY_SIZE];
+    uint32_t _output[I2S_RESAMPLER_BLOCK_SIZE];
+
+    bool fill();
+    size_t SourceCallback(const int16_t **p_data, size_t frames);
+};
+
+#endif
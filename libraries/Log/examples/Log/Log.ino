@@ -0,0 +1,44 @@
+/*
+  Log
+
+  Logs from loop() and from a pin change interrupt without formatting
+  anything on the device. The records are drained in binary over Serial
+  and decoded on the host with the sketch ELF file:
+
+    stty -F /dev/ttyACM0 raw
+    python3 logdecode.py Log.ino.elf /dev/ttyACM0
+
+  This example code is in the public domain.
+*/
+
+#include <Log.h>
+
+volatile uint32_t edges = 0;
+
+void edge()
+{
+  edges++;
+
+  LOG("edge %u on pin %d\n", edges, 2);
+}
+
+void setup()
+{
+  Serial.begin(9600);
+
+  Log.begin(Serial);
+
+  pinMode(2, INPUT_PULLUP);
+  attachInterrupt(2, edge, CHANGE);
+}
+
+void loop()
+{
+  static uint32_t count = 0;
+
+  LOG("loop %u, A0 = %d, temperature = %.1f C\n", count++, analogRead(A0), STM32.getTemperature());
+
+  Log.flush();
+
+  delay(100);
+}
@@ -0,0 +1,109 @@
+#!/usr/bin/env python3
+#
+# Decoder for the binary stream written by the Log library.
+#
+#   logdecode.py <sketch.elf> [<stream>]
+#
+# <stream> is a file or a serial device (set to raw mode, e.g. via
+# "stty -F /dev/ttyACM0 raw"), or stdin if omitted. Format strings and %s
+# arguments are read from the loadable sections of the ELF file. Each line
+# is prefixed with the time since the start record in microseconds.
+
+import re
+import struct
+import sys
+
+class Image:
+    def __init__(self, path):
+        with open(path, 'rb') as f:
+            data = f.read()
+        if data[:4] != b'\x7fELF' or data[4] != 1 or data[5] != 1:
+            raise ValueError('%s: not a little endian ELF32 file' % path)
+        shoff, = struct.unpack_from('<I', data, 0x20)
+        shentsize, shnum = struct.unpack_from('<HH', data, 0x2e)
+        self.sections = []
+        for i in range(shnum):
+            _, kind, flags, addr, offset, size = struct.unpack_from('<IIIIII', data, shoff + i * shentsize)
+            # SHT_PROGBITS with SHF_ALLOC
+            if kind == 1 and (flags & 2) and size:
+                self.sections.append((addr, data[offset:offset + size]))
+
+    def string(self, address):
+        for addr, data in self.sections:
+            if addr <= address < addr + len(data):
+                end = data.find(b'\0', address - addr)
+                return data[address - addr:end].decode('utf-8', 'replace')
+        return None
+
+SPEC = re.compile(r'%([-+ #0]*)(\*|\d+)?(?:\.(\*|\d+))?(hh|h|ll|l|z|j|t|L)?([diouxXcspfFeEgG%])')
+
+def format(image, text, args):
+    args = list(args)
+    def convert(m):
+        flags, width, precision, _, conversion = m.groups()
+        if conversion == '%':
+            return '%'
+        if width == '*':
+            width = str(args.pop(0) if args else 0)
+        if precision == '*':
+            precision = str(args.pop(0) if args else 0)
+        value = args.pop(0) if args else 0
+        spec = '%' + flags + (width or '') + ('.' + precision if precision else '')
+        if conversion in 'di':
+            return (spec + 'd') % struct.unpack('<i', struct.pack('<I', value))[0]
+        if conversion in 'fFeEgG':
+            return (spec + conversion) % struct.unpack('<f', struct.pack('<I', value))[0]
+        if conversion == 'c':
+            return (spec + 'c') % chr(value & 0xff)
+        if conversion == 's':
+            string = image.string(value)
+            return (spec + 's') % (string if string is not None else '<0x%08x>' % value)
+        if conversion == 'p':
+            return (spec + 's') % ('0x%08x' % value)
+        return (spec + conversion.replace('u', 'd')) % value
+    return SPEC.sub(convert, text)
+
+def words(stream):
+    while True:
+        data = stream.read(4)
+        if len(data) < 4:
+            return
+        yield struct.unpack('<I', data)[0]
+
+def main():
+    if len(sys.argv) not in (2, 3):
+        sys.stderr.write('usage: %s <sketch.elf> [<stream>]\n' % sys.argv[0])
+        sys.exit(1)
+    image = Image(sys.argv[1])
+    stream = open(sys.argv[2], 'rb', buffering=0) if len(sys.argv) == 3 else sys.stdin.buffer
+    clock, start, elapsed, last = 80000000, None, 0, 0
+    source = words(stream)
+    for header in source:
+        count, address = header >> 28, header & 0x0fffffff
+        try:
+            cycles = next(source)
+            args = [next(source) for _ in range(count)]
+        except StopIteration:
+            break
+        # The 32 bit cycle counter wraps, so accumulate the deltas.
+        if start is None:
+            start = last = cycles
+        elapsed += (cycles - last) & 0xffffffff
+        last = cycles
+        stamp = '%12.3f ' % (elapsed * 1e6 / clock)
+        if address == 0:
+            if count == 2 and args[0] == 0:
+                clock, elapsed = args[1], 0
+                print(stamp + '--- start (%d Hz)' % clock)
+            elif count == 2 and args[0] == 1:
+                print(stamp + '--- %d records dropped' % args[1])
+            continue
+        text = image.string(address)
+        if text is None:
+            print(stamp + '<unknown format 0x%08x> %s' % (address, ' '.join('0x%08x' % a for a in args)))
+        else:
+            print(stamp + format(image, text, args).rstrip('\n'))
+        sys.stdout.flush()
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,179 @@
+/*
+ * Copyright (c) 2017 Thomas Roell.  All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal with the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ *  1. Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimers.
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimers in the
+ *     documentation and/or other materials provided with the distribution.
+ *  3. Neither the name of Thomas Roell, nor the names of its contributors
+ *     may be used to endorse or promote products derived from this Software
+ *     without specific prior written permission.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ * CONTRIBUTORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * WITH THE SOFTWARE.
+ */
+
+#include "Log.h"
+
+#define LOG_CONTROL_START   0
+#define LOG_CONTROL_DROPPED 1
+
+static_assert((LOG_BUFFER_SIZE & (LOG_BUFFER_SIZE - 1)) == 0, "LOG_BUFFER_SIZE has to be a power of 2");
+
+LogClass::LogClass()
+{
+    _port = NULL;
+    _swo = false;
+    _head = 0;
+    _tail = 0;
+    _dropped = 0;
+    _reported = 0;
+}
+
+bool LogClass::begin(Print &port)
+{
+    if (_port || _swo) {
+	return false;
+    }
+
+    CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+    DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+
+    _port = &port;
+
+    _control(LOG_CONTROL_START, SystemCoreClock);
+
+    return true;
+}
+
+// The debugger sets up TPIU/SWO and enables ITM stimulus port 0. Until it
+// does, flush() simply discards the records.
+bool LogClass::beginSWO()
+{
+    if (_port || _swo) {
+	return false;
+    }
+
+    CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+    DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+
+    _swo = true;
+
+    _control(LOG_CONTROL_START, SystemCoreClock);
+
+    return true;
+}
+
+void LogClass::end()
+{
+    flush();
+
+    _port = NULL;
+    _swo = false;
+}
+
+void LogClass::flush()
+{
+    uint32_t head, tail, count;
+
+    if (!_port && !_swo) {
+	return;
+    }
+
+    if (_reported != _dropped) {
+	_reported = _dropped;
+
+	_control(LOG_CONTROL_DROPPED, _reported);
+    }
+
+    // Only the words between _tail and _head are read, which the producers
+    // do not touch till _tail is advanced past them.
+    head = _head;
+    tail = _tail;
+
+    while (tail != head) {
+	count = head - tail;
+
+	if (count > (LOG_BUFFER_SIZE - (tail & (LOG_BUFFER_SIZE - 1)))) {
+	    count = LOG_BUFFER_SIZE - (tail & (LOG_BUFFER_SIZE - 1));
+	}
+
+	_send(&_data[tail & (LOG_BUFFER_SIZE - 1)], count);
+
+	tail += count;
+
+	_tail = tail;
+    }
+}
+
+void LogClass::_record(uint32_t format, unsigned int count, const uint32_t *data)
+{
+    uint32_t basepri, head;
+    unsigned int i;
+
+    basepri = armv7m_critical_enter(LOG_CRITICAL_PRIORITY);
+
+    head = _head;
+
+    if ((LOG_BUFFER_SIZE - (head - _tail)) < (count + 2)) {
+	_dropped++;
+    } else {
+	_data[head++ & (LOG_BUFFER_SIZE - 1)] = (count << 28) | (format & 0x0fffffff);
+	_data[head++ & (LOG_BUFFER_SIZE - 1)] = DWT->CYCCNT;
+
+	for (i = 0; i < count; i++) {
+	    _data[head++ & (LOG_BUFFER_SIZE - 1)] = data[i];
+	}
+
+	_head = head;
+    }
+
+    armv7m_critical_leave(basepri);
+}
+
+void LogClass::_control(uint32_t kind, uint32_t value)
+{
+    uint32_t data[4];
+
+    data[0] = (2 << 28);
+    data[1] = DWT->CYCCNT;
+    data[2] = kind;
+    data[3] = value;
+
+    _send(&data[0], 4);
+}
+
+void LogClass::_send(const uint32_t *data, unsigned int count)
+{
+    unsigned int i;
+
+    if (_port) {
+	_port->write((const uint8_t*)data, count * sizeof(uint32_t));
+    } else {
+	if (!(ITM->TCR & ITM_TCR_ITMENA_Msk) || !(ITM->TER & 1)) {
+	    return;
+	}
+
+	for (i = 0; i < count; i++) {
+	    while (ITM->PORT[0].u32 == 0) {
+	    }
+
+	    ITM->PORT[0].u32 = data[i];
+	}
+    }
+}
+
+LogClass Log;
@@ -0,0 +1,118 @@
+/*
+ * Copyright (c) 2017 Thomas Roell.  All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal with the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ *  1. Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimers.
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimers in the
+ *     documentation and/or other materials provided with the distribution.
+ *  3. Neither the name of Thomas Roell, nor the names of its contributors
+ *     may be used to endorse or promote products derived from this Software
+ *     without specific prior written permission.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ * CONTRIBUTORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * WITH THE SOFTWARE.
+ */
+
+#ifndef _LOG_H_INCLUDED
+#define _LOG_H_INCLUDED
+
+#include <Arduino.h>
+
+// Size of the record ring in 32 bit words (a power of 2), and maximum
+// number of arguments per record.
+#ifndef LOG_BUFFER_SIZE
+#define LOG_BUFFER_SIZE 512
+#endif
+#define LOG_ARGUMENT_COUNT 8
+
+// Priority ceiling of LOG(): the most urgent interrupt priority it may be
+// called from. The default is that of SERVO, the most urgent one the core
+// uses, so only handlers at priority 0 have to stay away from it.
+#ifndef LOG_CRITICAL_PRIORITY
+#define LOG_CRITICAL_PRIORITY 1
+#endif
+
+// Deferred binary logging.
+//
+// LOG(format, ...) does not format anything on the device. It stores the
+// address of "format" (which has to be a string literal, so it ends up in
+// flash), the DWT cycle counter and the raw arguments into a RAM ring.
+// That's a few dozen cycles per call, from any context (interrupt
+// handlers included; interrupts up to LOG_CRITICAL_PRIORITY are masked
+// while the record is copied).
+// Records that do not fit are dropped and counted.
+//
+// flush() drains the ring to the port given to begin() (Serial,
+// SerialUSB, WebUSBSerial ...), or to ITM stimulus port 0 (SWO) with
+// beginSWO(). The host tool "extras/logdecode.py" resolves the format
+// strings from the sketch ELF file and prints the formatted lines.
+//
+// Each argument is stored as 32 bits: integers and pointers as is,
+// float/double as the IEEE single bit pattern. %s only makes sense for
+// string literals, as the host reads the string from the ELF file.
+// 64 bit integers are truncated.
+//
+// The stream is a sequence of little endian 32 bit words. A record is:
+//
+//   <header>, <cycles>, <argument>...
+//
+// where the header is (count << 28) | (format & 0x0fffffff). A format
+// address of 0 marks a control record, whose first argument is the kind:
+//   0: start, followed by SystemCoreClock
+//   1: dropped, followed by the number of dropped records
+class LogClass
+{
+public:
+    LogClass();
+
+    bool begin(Print &port);
+    bool beginSWO();
+    void end();
+
+    void flush();
+
+    uint32_t dropped() { return _dropped; }
+
+    template<typename... Args> void record(const char *format, Args... args) {
+        static_assert(sizeof...(Args) <= LOG_ARGUMENT_COUNT, "LOG: too many arguments");
+        const uint32_t data[sizeof...(Args) + 1] = { _argument(args)..., 0 };
+        _record((uint32_t)format, sizeof...(Args), data);
+    }
+
+private:
+    Print *_port;
+    bool _swo;
+    volatile uint32_t _head;
+    volatile uint32_t _tail;
+    volatile uint32_t _dropped;
+    uint32_t _reported;
+    uint32_t _data[LOG_BUFFER_SIZE];
+
+    void _record(uint32_t format, unsigned int count, const uint32_t *data);
+    void _control(uint32_t kind, uint32_t value);
+    void _send(const uint32_t *data, unsigned int count);
+
+    template<typename T> static uint32_t _argument(T value) { return (uint32_t)value; }
+    template<typename T> static uint32_t _argument(T *value) { return (uint32_t)value; }
+    static uint32_t _argument(float value) { union { float f; uint32_t u; } v; v.f = value; return v.u; }
+    static uint32_t _argument(double value) { return _argument((float)value); }
+};
+
+extern LogClass Log;
+
+#define LOG(format, ...) Log.record("" format, ##__VA_ARGS__)
+
+#endif // _LOG_H_INCLUDED
@@ -0,0 +1,55 @@
+/*
+  BlackBox
+
+  Keeps the last 1024 readings of A0 in a circular log file on the default
+  DOSFS volume. After a reset the log is reopened where it left off, and
+  its content is printed over Serial, oldest reading first.
+
+  This example code is in the public domain.
+*/
+
+#include <LogFile.h>
+
+LogFile blackbox;
+
+void setup()
+{
+  char line[64];
+  uint32_t sequence;
+  size_t size;
+
+  Serial.begin(9600);
+
+  while (!Serial) { }
+
+  DOSFS.begin();
+
+  if (!blackbox.begin("BLACKBOX.LOG")) {
+    if (!blackbox.create("BLACKBOX.LOG", 1024)) {
+      Serial.println("Cannot create BLACKBOX.LOG");
+
+      while (1) { }
+    }
+  }
+
+  for (sequence = blackbox.oldest(); sequence != blackbox.sequence(); sequence++) {
+    size = blackbox.read(sequence, line, sizeof(line) - 1);
+
+    line[size] = '\0';
+
+    Serial.print(sequence);
+    Serial.print(": ");
+    Serial.println(line);
+  }
+}
+
+void loop()
+{
+  char line[64];
+
+  snprintf(line, sizeof(line), "%lu ms, A0 = %d", millis(), analogRead(A0));
+
+  blackbox.append(line, strlen(line));
+
+  delay(1000);
+}
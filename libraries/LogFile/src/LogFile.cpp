@@ -0,0 +1,311 @@
+/*
+ * Copyright (c) 2017 Thomas Roell.  All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal with the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ *  1. Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimers.
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimers in the
+ *     documentation and/or other materials provided with the distribution.
+ *  3. Neither the name of Thomas Roell, nor the names of its contributors
+ *     may be used to endorse or promote products derived from this Software
+ *     without specific prior written permission.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ * CONTRIBUTORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * WITH THE SOFTWARE.
+ */
+
+#include "LogFile.h"
+
+#include <stddef.h>
+
+#define LOGFILE_MAGIC     0x474f4c43   // "CLOG"
+#define LOGFILE_VERSION   1
+
+// Largest count that keeps the file size within 2GB.
+#define LOGFILE_COUNT_MAX ((0x7fffffff / LOGFILE_RECORD_SIZE) - 1)
+
+LogFile::LogFile()
+{
+    _count = 0;
+    _sequence = 1;
+}
+
+bool LogFile::create(const char *path, uint32_t count)
+{
+    char mode[16];
+    uint32_t slot;
+
+    end();
+
+    if (!count || (count > LOGFILE_COUNT_MAX)) {
+        return false;
+    }
+
+    // ",<size>" allocates contiguous space, so that all FAT updates happen here.
+    snprintf(mode, sizeof(mode), "w,%lu", (unsigned long)((count + 1) * LOGFILE_RECORD_SIZE));
+
+    _file = DOSFS.open(path, mode);
+
+    if (!_file) {
+        return false;
+    }
+
+    _count = count;
+
+    // The header takes a slot of its own, so that the records stay sector
+    // aligned. Writing every slot once sets the final file size.
+    if (header(1)) {
+        memset(&_record, 0, sizeof(_record));
+
+        for (slot = 0; slot < _count; slot++) {
+            if (_file.write((const uint8_t*)&_record, sizeof(_record)) != sizeof(_record)) {
+                break;
+            }
+        }
+    } else {
+        slot = 0;
+    }
+
+    _file.close();
+
+    if (slot != _count) {
+        _count = 0;
+
+        DOSFS.remove(path);
+
+        return false;
+    }
+
+    _count = 0;
+
+    return begin(path);
+}
+
+bool LogFile::begin(const char *path)
+{
+    Header stored;
+    uint32_t sequence, lo, hi, mid, first;
+
+    end();
+
+    _file = DOSFS.open(path, "r+P");
+
+    if (!_file) {
+        return false;
+    }
+
+    if (!_file.seek(0) || (_file.read((uint8_t*)&_record, sizeof(_record)) != sizeof(_record))) {
+        end();
+
+        return false;
+    }
+
+    memcpy(&stored, &_record, sizeof(stored));
+
+    if ((stored.magic != LOGFILE_MAGIC) ||
+        (stored.version != LOGFILE_VERSION) ||
+        (stored.recordSize != LOGFILE_RECORD_SIZE) ||
+        (stored.crc != crc(0xffff, &stored, offsetof(Header, crc))) ||
+        !stored.count ||
+        (stored.count > LOGFILE_COUNT_MAX) ||
+        (_file.size() < ((stored.count + 1) * LOGFILE_RECORD_SIZE))) {
+        end();
+
+        return false;
+    }
+
+    _count = stored.count;
+
+    // After a clean end() the header knows the head. Otherwise sequence
+    // "s0 + n" in slot "n" marks the slots written in the same lap as slot
+    // 0, and the first slot that does not match is the head.
+    sequence = stored.sequence;
+
+    if (!sequence || ((sequence != 1) && !valid(sequence - 1))) {
+        first = slotSequence(0);
+
+        if (!first) {
+            sequence = 1;
+        } else if (!valid(first)) {
+            // A torn first record of a new lap, which follows the last slot.
+            first = slotSequence(_count - 1);
+
+            sequence = first ? (first + 1) : 1;
+        } else {
+            lo = 1;
+            hi = _count;
+
+            while (lo < hi) {
+                mid = lo + (hi - lo) / 2;
+
+                if (slotSequence(mid) == (first + mid)) {
+                    lo = mid + 1;
+                } else {
+                    hi = mid;
+                }
+            }
+
+            sequence = first + lo;
+
+            // The newest record may have been torn, in which case it is
+            // overwritten by the next append().
+            if (!valid(sequence - 1)) {
+                sequence--;
+            }
+        }
+    }
+
+    _sequence = sequence;
+
+    // Until end() the head in the header is stale.
+    if (!header(0)) {
+        end();
+
+        return false;
+    }
+
+    return true;
+}
+
+void LogFile::end()
+{
+    if (_file) {
+        if (_count) {
+            header(_sequence);
+        }
+
+        _file.close();
+    }
+
+    _count = 0;
+    _sequence = 1;
+}
+
+size_t LogFile::append(const void *data, size_t size)
+{
+    if (!_count || (size > LOGFILE_DATA_SIZE)) {
+        return 0;
+    }
+
+    _record.sequence = _sequence;
+    _record.size = size;
+
+    memcpy(&_record.data[0], data, size);
+    memset(&_record.data[size], 0, LOGFILE_DATA_SIZE - size);
+
+    _record.crc = crc(&_record);
+
+    if (!_file.seek((1 + ((_sequence - 1) % _count)) * LOGFILE_RECORD_SIZE) ||
+        (_file.write((const uint8_t*)&_record, sizeof(_record)) != sizeof(_record))) {
+        return 0;
+    }
+
+    _file.flush();
+
+    _sequence++;
+
+    return size;
+}
+
+size_t LogFile::read(uint32_t sequence, void *data, size_t size)
+{
+    if ((sequence - oldest()) >= count()) {
+        return 0;
+    }
+
+    if (!valid(sequence)) {
+        return 0;
+    }
+
+    if (size > _record.size) {
+        size = _record.size;
+    }
+
+    memcpy(data, &_record.data[0], size);
+
+    return size;
+}
+
+uint16_t LogFile::crc(uint16_t crc, const void *data, size_t size)
+{
+    const uint8_t *p = (const uint8_t*)data;
+    unsigned int bit;
+
+    for (; size; size--) {
+        crc ^= (*p++ << 8);
+
+        for (bit = 0; bit < 8; bit++) {
+            crc = (crc & 0x8000) ? ((crc << 1) ^ 0x1021) : (crc << 1);
+        }
+    }
+
+    return crc;
+}
+
+uint16_t LogFile::crc(const Record *record)
+{
+    return crc(crc(0xffff, record, offsetof(Record, crc)), &record->data[0], record->size);
+}
+
+bool LogFile::header(uint32_t sequence)
+{
+    Header stored;
+
+    stored.magic = LOGFILE_MAGIC;
+    stored.version = LOGFILE_VERSION;
+    stored.recordSize = LOGFILE_RECORD_SIZE;
+    stored.count = _count;
+    stored.sequence = sequence;
+    stored.reserved = 0;
+    stored.crc = crc(0xffff, &stored, offsetof(Header, crc));
+
+    memset(&_record, 0, sizeof(_record));
+    memcpy(&_record, &stored, sizeof(stored));
+
+    if (!_file.seek(0) || (_file.write((const uint8_t*)&_record, sizeof(_record)) != sizeof(_record))) {
+        return false;
+    }
+
+    _file.flush();
+
+    return true;
+}
+
+// Read the record in "slot" into _record, or only its sequence and size.
+bool LogFile::load(uint32_t slot, bool full)
+{
+    size_t size = full ? sizeof(_record) : offsetof(Record, data);
+
+    if (!_file.seek((1 + slot) * LOGFILE_RECORD_SIZE) || (_file.read((uint8_t*)&_record, size) != size)) {
+        return false;
+    }
+
+    return true;
+}
+
+uint32_t LogFile::slotSequence(uint32_t slot)
+{
+    return load(slot, false) ? _record.sequence : 0;
+}
+
+// Returns true if the slot of "sequence" holds that record with a good CRC.
+bool LogFile::valid(uint32_t sequence)
+{
+    if (!sequence || !load((sequence - 1) % _count, true)) {
+        return false;
+    }
+
+    return ((_record.sequence == sequence) && (_record.size <= LOGFILE_DATA_SIZE) && (_record.crc == crc(&_record)));
+}
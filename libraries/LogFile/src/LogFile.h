@@ -0,0 +1,115 @@
+/*
+ * Copyright (c) 2017 Thomas Roell.  All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal with the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ *  1. Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimers.
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimers in the
+ *     documentation and/or other materials provided with the distribution.
+ *  3. Neither the name of Thomas Roell, nor the names of its contributors
+ *     may be used to endorse or promote products derived from this Software
+ *     without specific prior written permission.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ * CONTRIBUTORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * WITH THE SOFTWARE.
+ */
+
+#ifndef _LOGFILE_H_INCLUDED
+#define _LOGFILE_H_INCLUDED
+
+#include <Arduino.h>
+#include <FS.h>
+
+// Size of a record in bytes (a multiple of 512), and the payload that
+// fits into one.
+#ifndef LOGFILE_RECORD_SIZE
+#define LOGFILE_RECORD_SIZE 512
+#endif
+#define LOGFILE_DATA_SIZE   (LOGFILE_RECORD_SIZE - 8)
+
+// Circular log in a preallocated DOSFS file.
+//
+// create() allocates a contiguous file for a header plus "count" fixed
+// size, sector aligned records, and writes it once. After that the file
+// never changes size: append() overwrites the oldest record in place,
+// which is a single data write (the file is opened with the DOSFS "P"
+// mode, so neither the FAT nor the directory entry are touched) followed
+// by a flush().
+//
+// Every record carries a sequence number and a CRC16-CCITT. Sequence "s"
+// always lives in record slot (s - 1) % count, so begin() finds the head
+// with a binary search over the sequence numbers, unless the header still
+// holds the head that end() stored there. A record torn by a power loss
+// fails its CRC and gets overwritten by the next append().
+//
+// Readers iterate from oldest() up to (but not including) sequence():
+//
+//   for (uint32_t s = log.oldest(); s != log.sequence(); s++) {
+//       size_t n = log.read(s, buffer, sizeof(buffer));
+//       ...
+//   }
+//
+// DOSFS.begin() has to be called first.
+class LogFile
+{
+public:
+    LogFile();
+
+    bool create(const char *path, uint32_t count);
+    bool begin(const char *path);
+    void end();
+
+    size_t append(const void *data, size_t size);
+    size_t read(uint32_t sequence, void *data, size_t size);
+
+    uint32_t capacity() { return _count; }
+    uint32_t count() { return ((_sequence - 1) < _count) ? (_sequence - 1) : _count; }
+    uint32_t oldest() { return _sequence - count(); }
+    uint32_t sequence() { return _sequence; }    // of the next append()
+
+    operator bool() { return _count != 0; }
+
+private:
+    struct Header {
+        uint32_t magic;
+        uint16_t version;
+        uint16_t recordSize;
+        uint32_t count;
+        uint32_t sequence;  // next sequence as of end(), 0 while open
+        uint16_t reserved;
+        uint16_t crc;       // over the fields above
+    };
+
+    struct Record {
+        uint32_t sequence;  // 0 if never written
+        uint16_t size;
+        uint16_t crc;       // over sequence, size and data[0 .. size-1]
+        uint8_t data[LOGFILE_DATA_SIZE];
+    };
+
+    File _file;
+    uint32_t _count;
+    uint32_t _sequence;
+    Record _record;
+
+    static uint16_t crc(uint16_t crc, const void *data, size_t size);
+    static uint16_t crc(const Record *record);
+    bool header(uint32_t sequence);
+    bool load(uint32_t slot, bool full);
+    uint32_t slotSequence(uint32_t slot);
+    bool valid(uint32_t sequence);
+};
+
+#endif // _LOGFILE_H_INCLUDED
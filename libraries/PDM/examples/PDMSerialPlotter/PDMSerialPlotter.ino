@@ -0,0 +1,47 @@
+/*
+ This example reads audio data from a PDM MEMS microphone (e.g. an
+ ST MP34DT01 or a Knowles SPH0641) through the DFSDM, and prints out
+ the samples to the Serial console. The Serial Plotter built into the
+ Arduino IDE can be used to plot the audio data (Tools -> Serial Plotter)
+
+ Circuit:
+ * PDM microphone:
+   * GND connected GND
+   * VDD connected 3.3V
+   * SEL connected GND (left channel, data valid on the rising clock edge)
+   * CLK connected to a DFSDM1_CKOUT pin (PC2 or PE9)
+   * DATA connected to a DFSDM1_DATINy pin (e.g. PC7 or PB12)
+
+ The Arduino pin numbers below have to be adjusted to the board used.
+
+ This example code is in the public domain.
+ */
+
+#include <PDM.h>
+
+#define PDM_CLOCK_PIN  PIN_A3
+#define PDM_DATA_PIN   9
+
+PDMClass PDM(PDM_CLOCK_PIN, PDM_DATA_PIN);
+
+void setup() {
+  // Open serial communications and wait for port to open:
+  Serial.begin(115200);
+  while (!Serial) {
+    ; // wait for serial port to connect. Needed for native USB port only
+  }
+
+  // start PDM at 16 kHz with 16-bits per sample, which with the default
+  // sinc5 filter and an oversampling of 64 clocks the microphone at 1.024 MHz
+  if (!PDM.begin(16000, 16)) {
+    Serial.println("Failed to initialize PDM!");
+    while (1); // do nothing
+  }
+}
+
+void loop() {
+  // print all samples received so far
+  while (PDM.available()) {
+    Serial.println(PDM.read());
+  }
+}
@@ -0,0 +1,414 @@
+/*
+ * Copyright (c) 2017 Thomas Roell.  All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal with the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ *  1. Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimers.
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimers in the
+ *     documentation and/or other materials provided with the distribution.
+ *  3. Neither the name of Thomas Roell, nor the names of its contributors
+ *     may be used to endorse or promote products derived from this Software
+ *     without specific prior written permission.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ * CONTRIBUTORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * WITH THE SOFTWARE.
+ */
+
+#include "Arduino.h"
+#include "stm32l4_wiring_private.h"
+#include "PDM.h"
+
+#define PDM_STATE_IDLE     0
+#define PDM_STATE_READY    1
+#define PDM_STATE_RECEIVE  2
+
+// All DFSDM1 pins are on alternate function 6.
+#define PDM_GPIO_AFSEL     6
+
+static stm32l4_dfsdm_t _DFSDM[DFSDM_INSTANCE_COUNT];
+
+PDMClass::PDMClass(uint32_t clockPin, uint32_t dataPin, unsigned int instance)
+{
+    stm32l4_dfsdm_pins_t pins;
+
+    _dfsdm = NULL;
+
+    if ((instance < DFSDM_INSTANCE_COUNT) && (clockPin < PINS_COUNT) && (dataPin < PINS_COUNT)) {
+	pins.ckout = g_APinDescription[clockPin].pin | (PDM_GPIO_AFSEL << GPIO_PIN_AFSEL_SHIFT);
+	pins.datin = g_APinDescription[dataPin].pin | (PDM_GPIO_AFSEL << GPIO_PIN_AFSEL_SHIFT);
+
+	if (stm32l4_dfsdm_create(&_DFSDM[instance], instance, &pins, STM32L4_DFSDM_IRQ_PRIORITY)) {
+	    _dfsdm = &_DFSDM[instance];
+	}
+    }
+
+    _state = PDM_STATE_IDLE;
+
+    _order = 5;
+    _oversampling = 64;
+    _falling = false;
+
+    setBuffer(&_xf_buffer[0][0], sizeof(_xf_buffer), 2);
+
+    _xf_underruns = 0;
+
+    _receiveCallback = NULL;
+}
+
+void PDMClass::setFilter(unsigned int order, unsigned int oversampling)
+{
+    _order = order;
+    _oversampling = oversampling;
+}
+
+void PDMClass::setClockEdge(bool falling)
+{
+    _falling = falling;
+}
+
+int PDMClass::begin(long sampleRate, int bitsPerSample)
+{
+    if (!_dfsdm || (_state != PDM_STATE_IDLE) || (sampleRate <= 0)) {
+	return 0;
+    }
+
+    switch (bitsPerSample) {
+    case 16:
+    case 32:
+	_width = bitsPerSample;
+	break;
+    default:
+	return 0;
+    }
+
+    if (!stm32l4_dfsdm_enable(_dfsdm, (sampleRate * _oversampling), _order, _oversampling, (_falling ? DFSDM_OPTION_FALLING : 0), PDMClass::_eventCallback, (void*)this, DFSDM_EVENT_RECEIVE_REQUEST)) {
+	return 0;
+    }
+
+    // The DMA fills a segment with 32 bit words, 16 bit samples are packed
+    // into the first half afterwards.
+    _xf_bytes = (_width == 16) ? (_xf_size / 2) : _xf_size;
+
+    _state = PDM_STATE_READY;
+
+    return 1;
+}
+
+int PDMClass::begin(long sampleRate, int bitsPerSample, void *buffer, size_t size, unsigned int depth)
+{
+    if (_state != PDM_STATE_IDLE) {
+	return 0;
+    }
+
+    if (!setBuffer(buffer, size, depth)) {
+	return 0;
+    }
+
+    if (!begin(sampleRate, bitsPerSample)) {
+	setBuffer(&_xf_buffer[0][0], sizeof(_xf_buffer), 2);
+
+	return 0;
+    }
+
+    return 1;
+}
+
+void PDMClass::end()
+{
+    if (_state == PDM_STATE_IDLE) {
+	return;
+    }
+
+    stm32l4_dfsdm_disable(_dfsdm);
+
+    _state = PDM_STATE_IDLE;
+
+    setBuffer(&_xf_buffer[0][0], sizeof(_xf_buffer), 2);
+}
+
+long PDMClass::sampleRate()
+{
+    if (_state == PDM_STATE_IDLE) {
+	return 0;
+    }
+
+    return stm32l4_dfsdm_rate(_dfsdm);
+}
+
+int PDMClass::available()
+{
+    uint32_t xf_queued;
+
+    if (_state == PDM_STATE_IDLE) {
+	return 0;
+    }
+
+    _state = PDM_STATE_RECEIVE;
+
+    startReceive();
+
+    xf_queued = _xf_queued;
+
+    if (!xf_queued) {
+	return 0;
+    }
+
+    return (xf_queued * _xf_bytes) - _xf_count;
+}
+
+int PDMClass::peek()
+{
+    const uint8_t *xf_data;
+
+    if (_state == PDM_STATE_IDLE) {
+	return 0;
+    }
+
+    _state = PDM_STATE_RECEIVE;
+
+    startReceive();
+
+    if (!_xf_queued) {
+	return 0;
+    }
+
+    xf_data = _xf_data + (_xf_head * _xf_size) + _xf_count;
+
+    if (_width == 32) { return *((const int32_t*)xf_data); }
+    else              { return *((const int16_t*)xf_data); }
+}
+
+int PDMClass::read()
+{
+    if (_width == 32) { int32_t temp; if (read(&temp, 4)) { return temp; } }
+    else              { int16_t temp; if (read(&temp, 2)) { return temp; } }
+
+    return 0;
+}
+
+int PDMClass::read(void* buffer, size_t size)
+{
+    uint32_t xf_count, xf_bytes;
+    size_t count;
+
+    if (_state == PDM_STATE_IDLE) {
+	return 0;
+    }
+
+    _state = PDM_STATE_RECEIVE;
+
+    startReceive();
+
+    xf_bytes = _xf_bytes;
+    count = 0;
+
+    while ((count < size) && _xf_queued)
+    {
+	xf_count = xf_bytes - _xf_count;
+
+	if (xf_count > (size - count)) {
+	    xf_count = size - count;
+	}
+
+	memcpy((uint8_t*)buffer + count, _xf_data + (_xf_head * _xf_size) + _xf_count, xf_count);
+
+	count += xf_count;
+
+	_xf_count += xf_count;
+
+	if (_xf_count == xf_bytes)
+	{
+	    _xf_count = 0;
+	    _xf_head = ((_xf_head + 1) == _xf_depth) ? 0 : (_xf_head + 1);
+
+	    armv7m_atomic_sub(&_xf_queued, 1);
+
+	    startReceive();
+	}
+    }
+
+    return count;
+}
+
+void PDMClass::flush()
+{
+}
+
+size_t PDMClass::write(uint8_t data)
+{
+    return 0;
+}
+
+void PDMClass::onReceive(void(*callback)(void))
+{
+    _receiveCallback = callback;
+}
+
+const void *PDMClass::acquireRxBuffer(size_t *frames)
+{
+    if (_state == PDM_STATE_IDLE) {
+	return NULL;
+    }
+
+    _state = PDM_STATE_RECEIVE;
+
+    startReceive();
+
+    if (!_xf_queued) {
+	return NULL;
+    }
+
+    if (frames) {
+	*frames = (_xf_bytes - _xf_count) / (_width / 8);
+    }
+
+    return _xf_data + (_xf_head * _xf_size) + _xf_count;
+}
+
+void PDMClass::releaseRxBuffer()
+{
+    if ((_state != PDM_STATE_RECEIVE) || !_xf_queued) {
+	return;
+    }
+
+    _xf_count = 0;
+    _xf_head = ((_xf_head + 1) == _xf_depth) ? 0 : (_xf_head + 1);
+
+    armv7m_atomic_sub(&_xf_queued, 1);
+
+    startReceive();
+}
+
+size_t PDMClass::queuedFrames(size_t *capacity)
+{
+    if (_state == PDM_STATE_IDLE) {
+	if (capacity) {
+	    *capacity = 0;
+	}
+
+	return 0;
+    }
+
+    if (capacity) {
+	*capacity = (_xf_depth * _xf_bytes) / (_width / 8);
+    }
+
+    return (_xf_queued * _xf_bytes) / (_width / 8);
+}
+
+uint32_t PDMClass::underruns()
+{
+    return _xf_underruns;
+}
+
+bool PDMClass::setBuffer(void *buffer, size_t size, unsigned int depth)
+{
+    uint32_t xf_size;
+
+    if (!buffer || (depth < 2) || (depth > 255) || ((uint32_t)buffer & 3)) {
+	return false;
+    }
+
+    // Segments hold whole 32 bit DMA words. stm32l4_dfsdm_receive() takes a 16 bit count.
+    xf_size = (size / depth) & ~3;
+
+    if (xf_size > 0x3fffc) {
+	xf_size = 0x3fffc;
+    }
+
+    if (xf_size == 0) {
+	return false;
+    }
+
+    _xf_data = (uint8_t*)buffer;
+    _xf_size = xf_size;
+    _xf_bytes = xf_size;
+    _xf_depth = depth;
+    _xf_active = false;
+    _xf_head = 0;
+    _xf_tail = 0;
+    _xf_queued = 0;
+    _xf_count = 0;
+
+    return true;
+}
+
+void PDMClass::startReceive()
+{
+    // The DMA callback does not touch the ring while the DMA is idle, so
+    // there is no race between checking and setting "_xf_active".
+    if (!_xf_active && (_xf_queued != _xf_depth))
+    {
+	if (stm32l4_dfsdm_done(_dfsdm))
+	{
+	    _xf_active = true;
+
+	    stm32l4_dfsdm_receive(_dfsdm, (int32_t*)(_xf_data + (_xf_tail * _xf_size)), (_xf_size / 4));
+	}
+    }
+}
+
+void PDMClass::EventCallback(uint32_t events)
+{
+    int32_t *data;
+    int16_t *data16;
+    uint32_t index, count;
+
+    if (events & DFSDM_EVENT_RECEIVE_REQUEST)
+    {
+	data = (int32_t*)(_xf_data + (_xf_tail * _xf_size));
+	count = _xf_size / 4;
+
+	_xf_tail = ((_xf_tail + 1) == _xf_depth) ? 0 : (_xf_tail + 1);
+
+	// Restart the DMA first, the filter delivers the next sample within one
+	// sample period. The sketch cannot look at the segment till this returns.
+	if ((_xf_queued + 1) < _xf_depth)
+	{
+	    stm32l4_dfsdm_receive(_dfsdm, (int32_t*)(_xf_data + (_xf_tail * _xf_size)), (_xf_size / 4));
+	}
+	else
+	{
+	    _xf_underruns++;
+	    _xf_active = false;
+	}
+
+	// Bits 7:0 of each word are the channel number / pending flag.
+	if (_width == 16)
+	{
+	    for (index = 0, data16 = (int16_t*)data; index < count; index++) {
+		data16[index] = data[index] >> 16;
+	    }
+	}
+	else
+	{
+	    for (index = 0; index < count; index++) {
+		data[index] &= ~0xff;
+	    }
+	}
+
+	armv7m_atomic_add(&_xf_queued, 1);
+
+	if (_receiveCallback)
+	{
+	    armv7m_pendsv_enqueue((armv7m_pendsv_routine_t)_receiveCallback, NULL, 0);
+	}
+    }
+}
+
+void PDMClass::_eventCallback(void *context, uint32_t events)
+{
+    reinterpret_cast<class PDMClass*>(context)->EventCallback(events);
+}
@@ -0,0 +1,120 @@
+/*
+ * Copyright (c) 2017 Thomas Roell.  All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal with the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ *  1. Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimers.
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimers in the
+ *     documentation and/or other materials provided with the distribution.
+ *  3. Neither the name of Thomas Roell, nor the names of its contributors
+ *     may be used to endorse or promote products derived from this Software
+ *     without specific prior written permission.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ * CONTRIBUTORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * WITH THE SOFTWARE.
+ */
+
+#ifndef _PDM_H_INCLUDED
+#define _PDM_H_INCLUDED
+
+#include <Arduino.h>
+
+#if !defined(STM32L452xx) && !defined(STM32L476xx) && !defined(STM32L496xx)
+#error "PDM requires DFSDM (STM32L452, STM32L476 or STM32L496)"
+#endif
+
+#define PDM_BUFFER_SIZE 512
+
+// PDM (MEMS microphone) capture through DFSDM1. The sinc filter decimates the
+// bit stream on "dataPin" (DFSDM1_DATINy), clocked by "clockPin" (DFSDM1_CKOUT),
+// in hardware, and DMA moves the PCM samples into a ring of segments. The buffer
+// interface is the receive side of I2SClass, with one channel per frame.
+//
+// "instance" is the DFSDM filter (0 .. 3, 0 .. 1 on STM32L452). A 2nd microphone
+// sharing "dataPin" (L/R select the other way) is read by a 2nd PDMClass on
+// another instance with setClockEdge(true); all instances share the clock.
+class PDMClass : public Stream
+{
+public:
+    PDMClass(uint32_t clockPin, uint32_t dataPin, unsigned int instance = 0);
+
+    // sinc filter order (1 .. 5, default 5) and decimation ratio (default 64), to be set before
+    // begin(). The microphone clock runs at sampleRate * oversampling.
+    void setFilter(unsigned int order, unsigned int oversampling);
+    // sample on the falling clock edge, to be set before begin()
+    void setClockEdge(bool falling);
+
+    // 16 or 32 bits per sample; 32 bit samples hold 24 significant bits, left aligned
+    int begin(long sampleRate, int bitsPerSample = 16);
+    // use "buffer" as a ring of "depth" DMA segments of (size / depth) bytes each
+    int begin(long sampleRate, int bitsPerSample, void *buffer, size_t size, unsigned int depth);
+    void end();
+
+    // the actual sample rate, which is derived from PCLK2
+    long sampleRate();
+
+    // from Stream
+    virtual int available();
+    virtual int read();
+    virtual int peek();
+    virtual void flush();
+
+    // from Print
+    virtual size_t write(uint8_t);
+
+    int read(void* buffer, size_t size);
+
+    void onReceive(void(*)(void));
+
+    // zero-copy receive; returns the oldest filled DMA segment (or the part of it not consumed by
+    // read() yet) and its size in samples, or NULL if there is none. releaseRxBuffer() hands it back.
+    const void *acquireRxBuffer(size_t *frames);
+    void releaseRxBuffer();
+
+    // number of samples in filled segments, and via "capacity" the size of the whole ring
+    size_t queuedFrames(size_t *capacity = NULL);
+
+    // number of times the DMA ran out of segments (receive overrun)
+    uint32_t underruns();
+
+private:
+    struct _stm32l4_dfsdm_t *_dfsdm;
+    uint8_t _state;
+    uint8_t _width;
+    uint8_t _order;
+    uint8_t _falling;
+    uint16_t _oversampling;
+    volatile uint8_t _xf_active;
+    uint8_t _xf_depth;
+    uint8_t _xf_head;
+    uint8_t _xf_tail;
+    volatile uint32_t _xf_queued;
+    uint32_t _xf_count;
+    uint32_t _xf_size;
+    uint32_t _xf_bytes;
+    uint8_t *_xf_data;
+    volatile uint32_t _xf_underruns;
+    uint32_t _xf_buffer[2][PDM_BUFFER_SIZE / sizeof(uint32_t)];
+
+    bool setBuffer(void *buffer, size_t size, unsigned int depth);
+    void startReceive();
+
+    void (*_receiveCallback)(void);
+
+    static void _eventCallback(void *context, uint32_t events);
+    void EventCallback(uint32_t events);
+};
+
+#endif
@@ -0,0 +1,109 @@
+/*
+  SampleCache
+
+  Plays a short sound (a headerless 16 bit stereo PCM file "CLASH.RAW"
+  on the SD card) on every press of the button on PIN_BUTTON. The first
+  press reads the file into the QSPI PSRAM; every further press plays it
+  straight out of PSRAM without touching the SD card. Cache statistics
+  are printed over Serial.
+
+  This example code is in the public domain.
+*/
+
+#include <FS.h>
+#include <I2S.h>
+#include <I2SMixer.h>
+#include <PSRAM.h>
+#include <PSRAMCache.h>
+
+#define PIN_BUTTON 2
+
+I2SMixerClass Mixer(I2S);
+
+struct Sound {
+  const uint8_t *data;
+  size_t size;
+  size_t offset;
+  volatile bool done;
+};
+
+static Sound clash;
+static int voice = -1;
+
+// called from the SAI interrupt, PSRAM is memory mapped
+static size_t clashSource(void *context, const int16_t **p_data, size_t frames)
+{
+  Sound *sound = (Sound*)context;
+  size_t count;
+
+  count = (sound->size - sound->offset) / 4;
+
+  if (count == 0) {
+    sound->done = true;
+    return 0;
+  }
+
+  if (count > frames) {
+    count = frames;
+  }
+
+  *p_data = (const int16_t*)(sound->data + sound->offset);
+  sound->offset += count * 4;
+
+  return count;
+}
+
+void setup()
+{
+  Serial.begin(9600);
+
+  while (!Serial) { }
+
+  pinMode(PIN_BUTTON, INPUT_PULLUP);
+
+  if (!DOSFS.begin()) {
+    Serial.println("DOSFS failed");
+    while (1) { }
+  }
+
+  if (!PSRAM.begin()) {
+    Serial.println("PSRAM failed");
+    while (1) { }
+  }
+
+  I2S.begin(I2S_PHILIPS_MODE, 44100, 16);
+  Mixer.begin();
+}
+
+void loop()
+{
+  if ((voice >= 0) && clash.done) {
+    Mixer.detach(voice);
+    PSRAMCache.release(clash.data);
+    voice = -1;
+  }
+
+  if ((voice < 0) && !digitalRead(PIN_BUTTON)) {
+    clash.data = PSRAMCache.acquire("CLASH.RAW", clash.size);
+
+    if (clash.data) {
+      clash.offset = 0;
+      clash.done = false;
+
+      voice = Mixer.attach(clashSource, &clash);
+
+      if (voice < 0) {
+        PSRAMCache.release(clash.data);
+      }
+    }
+
+    Serial.print("hits=");
+    Serial.print(PSRAMCache.hits());
+    Serial.print(", misses=");
+    Serial.print(PSRAMCache.misses());
+    Serial.print(", free=");
+    Serial.println(PSRAM.freeBytes());
+
+    while (!digitalRead(PIN_BUTTON)) { }
+  }
+}
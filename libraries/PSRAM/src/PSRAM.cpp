@@ -0,0 +1,258 @@
+/*
+ * Copyright (c) 2017 Thomas Roell.  All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal with the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ *  1. Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimers.
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimers in the
+ *     documentation and/or other materials provided with the distribution.
+ *  3. Neither the name of Thomas Roell, nor the names of its contributors
+ *     may be used to endorse or promote products derived from this Software
+ *     without specific prior written permission.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ * CONTRIBUTORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * WITH THE SOFTWARE.
+ */
+
+#include "Arduino.h"
+#include "stm32l4_wiring_private.h"
+#include "PSRAM.h"
+
+#define PSRAM_COMMAND_RESET_ENABLE_SPI  (QSPI_COMMAND_INSTRUCTION_SINGLE | 0x66)
+#define PSRAM_COMMAND_RESET_SPI         (QSPI_COMMAND_INSTRUCTION_SINGLE | 0x99)
+#define PSRAM_COMMAND_RESET_ENABLE_QPI  (QSPI_COMMAND_INSTRUCTION_QUAD | 0x66)
+#define PSRAM_COMMAND_RESET_QPI         (QSPI_COMMAND_INSTRUCTION_QUAD | 0x99)
+#define PSRAM_COMMAND_READ_ID           (QSPI_COMMAND_INSTRUCTION_SINGLE | QSPI_COMMAND_ADDRESS_SINGLE | QSPI_COMMAND_ADDRESS_24BIT | QSPI_COMMAND_DATA_SINGLE | 0x9f)
+#define PSRAM_COMMAND_ENTER_QPI         (QSPI_COMMAND_INSTRUCTION_SINGLE | 0x35)
+#define PSRAM_COMMAND_EXIT_QPI          (QSPI_COMMAND_INSTRUCTION_QUAD | 0xf5)
+#define PSRAM_COMMAND_READ              (QSPI_COMMAND_INSTRUCTION_QUAD | QSPI_COMMAND_ADDRESS_QUAD | QSPI_COMMAND_ADDRESS_24BIT | (6 << QSPI_COMMAND_WAIT_STATES_SHIFT) | QSPI_COMMAND_DATA_QUAD | 0xeb)
+#define PSRAM_COMMAND_WRITE             (QSPI_COMMAND_INSTRUCTION_QUAD | QSPI_COMMAND_ADDRESS_QUAD | QSPI_COMMAND_ADDRESS_24BIT | QSPI_COMMAND_DATA_QUAD | 0x38)
+
+#define PSRAM_KGD_PASS                  0x5d
+
+static const stm32l4_qspi_pins_t _PSRAMPins = {
+    GPIO_PIN_PB10_QUADSPI_CLK,
+    GPIO_PIN_PB11_QUADSPI_BK1_NCS,
+    GPIO_PIN_PB1_QUADSPI_BK1_IO0,
+    GPIO_PIN_PB0_QUADSPI_BK1_IO1,
+    GPIO_PIN_PA7_QUADSPI_BK1_IO2,
+    GPIO_PIN_PA6_QUADSPI_BK1_IO3,
+};
+
+PSRAMClass::PSRAMClass()
+{
+    _qspi.state = QSPI_STATE_NONE;
+    _size = 0;
+    _used = 0;
+    _count = 0;
+}
+
+bool PSRAMClass::begin(size_t size, uint32_t clock)
+{
+    uint8_t id[8];
+
+    if (_size || (size == 0) || (size > (16 * 1024 * 1024))) {
+	return false;
+    }
+
+    if (!stm32l4_qspi_create(&_qspi, QSPI_INSTANCE_QUADSPI, &_PSRAMPins, STM32L4_QSPI_IRQ_PRIORITY, 0)) {
+	return false;
+    }
+
+    if (!stm32l4_qspi_enable(&_qspi, clock, QSPI_OPTION_MODE_0, NULL, NULL, 0)) {
+	stm32l4_qspi_destroy(&_qspi);
+
+	return false;
+    }
+
+    // The part may still be in QPI mode from before a system reset, so
+    // reset it in QPI mode first, and then in SPI mode.
+    stm32l4_qspi_select(&_qspi);
+    stm32l4_qspi_command(&_qspi, PSRAM_COMMAND_RESET_ENABLE_QPI, 0);
+    stm32l4_qspi_command(&_qspi, PSRAM_COMMAND_RESET_QPI, 0);
+    stm32l4_qspi_command(&_qspi, PSRAM_COMMAND_RESET_ENABLE_SPI, 0);
+    stm32l4_qspi_command(&_qspi, PSRAM_COMMAND_RESET_SPI, 0);
+    stm32l4_qspi_receive(&_qspi, PSRAM_COMMAND_READ_ID, 0x000000, &id[0], sizeof(id), 0);
+
+    if (id[1] != PSRAM_KGD_PASS) {
+	stm32l4_qspi_unselect(&_qspi);
+	stm32l4_qspi_disable(&_qspi);
+	stm32l4_qspi_destroy(&_qspi);
+
+	return false;
+    }
+
+    stm32l4_qspi_command(&_qspi, PSRAM_COMMAND_ENTER_QPI, 0);
+
+    // Wait for the command to complete before the peripheral gets disabled.
+    stm32l4_qspi_mode(&_qspi, 0);
+    stm32l4_qspi_unselect(&_qspi);
+
+    stm32l4_qspi_map(&_qspi, PSRAM_COMMAND_READ);
+
+    _size = size;
+    _used = 0;
+    _count = 0;
+
+    return true;
+}
+
+void PSRAMClass::end()
+{
+    if (!_size) {
+	return;
+    }
+
+    stm32l4_qspi_select(&_qspi);
+    stm32l4_qspi_command(&_qspi, PSRAM_COMMAND_EXIT_QPI, 0);
+    stm32l4_qspi_unselect(&_qspi);
+
+    stm32l4_qspi_unmap(&_qspi);
+    stm32l4_qspi_disable(&_qspi);
+    stm32l4_qspi_destroy(&_qspi);
+
+    _size = 0;
+    _used = 0;
+    _count = 0;
+}
+
+size_t PSRAMClass::read(uint32_t address, void *buffer, size_t size)
+{
+    uint8_t *data = (uint8_t*)buffer;
+    uint32_t basepri;
+    size_t count, chunk;
+
+    if (address >= _size) {
+	return 0;
+    }
+
+    if (size > (_size - address)) {
+	size = _size - address;
+    }
+
+    for (count = 0; count < size; count += chunk) {
+	chunk = PSRAM_PAGE_SIZE - ((address + count) & (PSRAM_PAGE_SIZE -1));
+
+	if (chunk > PSRAM_BURST_SIZE) {
+	    chunk = PSRAM_BURST_SIZE;
+	}
+
+	if (chunk > (size - count)) {
+	    chunk = size - count;
+	}
+
+	basepri = armv7m_critical_enter(PSRAM_CRITICAL_PRIORITY);
+
+	stm32l4_qspi_select(&_qspi);
+	stm32l4_qspi_receive(&_qspi, PSRAM_COMMAND_READ, address + count, data + count, chunk, 0);
+	stm32l4_qspi_unselect(&_qspi);
+
+	armv7m_critical_leave(basepri);
+    }
+
+    return size;
+}
+
+size_t PSRAMClass::write(uint32_t address, const void *buffer, size_t size)
+{
+    const uint8_t *data = (const uint8_t*)buffer;
+    uint32_t basepri;
+    size_t count, chunk;
+
+    if (address >= _size) {
+	return 0;
+    }
+
+    if (size > (_size - address)) {
+	size = _size - address;
+    }
+
+    for (count = 0; count < size; count += chunk) {
+	chunk = PSRAM_PAGE_SIZE - ((address + count) & (PSRAM_PAGE_SIZE -1));
+
+	if (chunk > PSRAM_BURST_SIZE) {
+	    chunk = PSRAM_BURST_SIZE;
+	}
+
+	if (chunk > (size - count)) {
+	    chunk = size - count;
+	}
+
+	basepri = armv7m_critical_enter(PSRAM_CRITICAL_PRIORITY);
+
+	stm32l4_qspi_select(&_qspi);
+	stm32l4_qspi_transmit(&_qspi, PSRAM_COMMAND_WRITE, address + count, data + count, chunk, 0);
+	stm32l4_qspi_unselect(&_qspi);
+
+	armv7m_critical_leave(basepri);
+    }
+
+    return size;
+}
+
+uint32_t PSRAMClass::allocate(size_t size)
+{
+    uint32_t address, limit;
+    unsigned int index;
+
+    if ((size == 0) || (size > (_size - _used)) || (_count == PSRAM_BLOCK_COUNT)) {
+	return PSRAM_NONE;
+    }
+
+    size = (size + (PSRAM_ALIGNMENT -1)) & ~(PSRAM_ALIGNMENT -1);
+
+    // _blocks[] is sorted by address, so the gaps in between are the free space.
+    address = 0;
+
+    for (index = 0; index <= _count; index++) {
+	limit = (index < _count) ? _blocks[index].address : _size;
+
+	if ((limit - address) >= size) {
+	    memmove(&_blocks[index +1], &_blocks[index], (_count - index) * sizeof(Block));
+
+	    _blocks[index].address = address;
+	    _blocks[index].size = size;
+
+	    _count++;
+	    _used += size;
+
+	    return address;
+	}
+
+	if (index < _count) {
+	    address = _blocks[index].address + _blocks[index].size;
+	}
+    }
+
+    return PSRAM_NONE;
+}
+
+void PSRAMClass::free(uint32_t address)
+{
+    unsigned int index;
+
+    for (index = 0; index < _count; index++) {
+	if (_blocks[index].address == address) {
+	    _used -= _blocks[index].size;
+	    _count--;
+
+	    memmove(&_blocks[index], &_blocks[index +1], (_count - index) * sizeof(Block));
+
+	    return;
+	}
+    }
+}
+
+PSRAMClass PSRAM;
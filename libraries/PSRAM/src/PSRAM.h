@@ -0,0 +1,111 @@
+/*
+ * Copyright (c) 2017 Thomas Roell.  All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal with the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ *  1. Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimers.
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimers in the
+ *     documentation and/or other materials provided with the distribution.
+ *  3. Neither the name of Thomas Roell, nor the names of its contributors
+ *     may be used to endorse or promote products derived from this Software
+ *     without specific prior written permission.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ * CONTRIBUTORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * WITH THE SOFTWARE.
+ */
+
+#ifndef _PSRAM_H_INCLUDED
+#define _PSRAM_H_INCLUDED
+
+#include <Arduino.h>
+
+#include "stm32l4_qspi.h"
+
+#if !defined(STM32L476xx) && !defined(STM32L496xx)
+#error "PSRAM is only supported on STM32L476 and STM32L496"
+#endif
+
+// Number of allocations the PSRAM allocator keeps track of, and the
+// alignment of each allocation.
+#define PSRAM_BLOCK_COUNT  64
+#define PSRAM_ALIGNMENT    32
+
+// Page size of the part (bursts wrap at page boundaries), and maximum
+// number of data bytes per NCS low period, so that a read or write at
+// 48MHz stays well within the 8us tCEM refresh limit.
+#define PSRAM_PAGE_SIZE    1024
+#define PSRAM_BURST_SIZE   128
+
+// Priority ceiling of write()/read(): the most urgent interrupt priority
+// that may read through data(), or be held off while NCS is low. The
+// default is that of SERVO, the most urgent one the core uses.
+#ifndef PSRAM_CRITICAL_PRIORITY
+#define PSRAM_CRITICAL_PRIORITY 1
+#endif
+
+#define PSRAM_NONE         0xffffffff
+
+// QSPI PSRAM (APS6404L, ESP-PSRAM64H, ...) on the QUADSPI pins of the
+// board (PB10/PB11/PB1/PB0/PA7/PA6, the SFLASH footprint).
+//
+// begin() resets the part, checks its ID, switches it into QPI mode and
+// maps it at data() via Fast Quad Read (0xEB), so that content can be
+// read directly through a pointer. The QUADSPI of the STM32L4 does not
+// support writes in memory mapped mode; write() hence suspends the
+// mapping and uses indirect Quad Write (0x38), in PSRAM_BURST_SIZE
+// chunks with interrupts up to PSRAM_CRITICAL_PRIORITY masked, so that an
+// interrupt handler reading through data() never sees the mapping
+// suspended. read() copies via indirect reads of the same size; a plain
+// memcpy() from data() is faster but may hold NCS low for longer than
+// tCEM on large copies.
+//
+// allocate()/free() manage the address space with a simple first fit
+// allocator, whose bookkeeping lives in SRAM.
+class PSRAMClass
+{
+public:
+    PSRAMClass();
+
+    bool begin(size_t size = 8 * 1024 * 1024, uint32_t clock = 48000000);
+    void end();
+
+    size_t size() const { return _size; }
+    const uint8_t *data() const { return (const uint8_t*)QSPI_BASE; }
+
+    size_t read(uint32_t address, void *buffer, size_t size);
+    size_t write(uint32_t address, const void *buffer, size_t size);
+
+    // Returns the address of "size" bytes of PSRAM, or PSRAM_NONE.
+    uint32_t allocate(size_t size);
+    void free(uint32_t address);
+    size_t freeBytes() const { return _size - _used; }
+
+private:
+    stm32l4_qspi_t _qspi;
+    size_t _size;
+    size_t _used;
+    unsigned int _count;
+
+    struct Block {
+        uint32_t address;
+        uint32_t size;
+    };
+
+    Block _blocks[PSRAM_BLOCK_COUNT];
+};
+
+extern PSRAMClass PSRAM;
+
+#endif // _PSRAM_H_INCLUDED
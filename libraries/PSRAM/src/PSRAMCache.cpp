@@ -0,0 +1,250 @@
+/*
+ * Copyright (c) 2017 Thomas Roell.  All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal with the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ *  1. Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimers.
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimers in the
+ *     documentation and/or other materials provided with the distribution.
+ *  3. Neither the name of Thomas Roell, nor the names of its contributors
+ *     may be used to endorse or promote products derived from this Software
+ *     without specific prior written permission.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ * CONTRIBUTORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * WITH THE SOFTWARE.
+ */
+
+#include "Arduino.h"
+#include "PSRAMCache.h"
+
+PSRAMCacheClass::PSRAMCacheClass()
+{
+    unsigned int index;
+
+    for (index = 0; index < PSRAM_CACHE_ENTRIES; index++) {
+	_entries[index].valid = false;
+    }
+
+    _stamp = 0;
+    _hits = 0;
+    _misses = 0;
+    _evictions = 0;
+}
+
+const uint8_t *PSRAMCacheClass::acquire(const char *path, size_t &size)
+{
+    Entry *entry;
+    uint32_t address;
+    size_t count, chunk;
+    unsigned int index;
+
+    if (!PSRAM.size()) {
+	return NULL;
+    }
+
+    entry = lookup(hash(path));
+
+    if (entry) {
+	entry->pins++;
+	entry->stamp = ++_stamp;
+
+	_hits++;
+
+	size = entry->size;
+
+	return PSRAM.data() + entry->address;
+    }
+
+    File file(path, "r");
+
+    if (!file) {
+	return NULL;
+    }
+
+    size = file.size();
+
+    if ((size == 0) || (size > PSRAM.size())) {
+	file.close();
+
+	return NULL;
+    }
+
+    // Find a free entry first, evictions below only ever release valid ones.
+    while (1) {
+	for (index = 0; index < PSRAM_CACHE_ENTRIES; index++) {
+	    if (!_entries[index].valid) {
+		break;
+	    }
+	}
+
+	if (index != PSRAM_CACHE_ENTRIES) {
+	    break;
+	}
+
+	if (!evict()) {
+	    file.close();
+
+	    return NULL;
+	}
+    }
+
+    entry = &_entries[index];
+
+    while ((address = PSRAM.allocate(size)) == PSRAM_NONE) {
+	if (!evict()) {
+	    file.close();
+
+	    return NULL;
+	}
+    }
+
+    for (count = 0; count < size; count += chunk) {
+	chunk = size - count;
+
+	if (chunk > PSRAM_CACHE_BUFFER_SIZE) {
+	    chunk = PSRAM_CACHE_BUFFER_SIZE;
+	}
+
+	chunk = file.read(&_buffer[0], chunk);
+
+	if (chunk == 0) {
+	    PSRAM.free(address);
+
+	    file.close();
+
+	    return NULL;
+	}
+
+	PSRAM.write(address + count, &_buffer[0], chunk);
+    }
+
+    file.close();
+
+    entry->hash = hash(path);
+    entry->address = address;
+    entry->size = size;
+    entry->stamp = ++_stamp;
+    entry->pins = 1;
+    entry->valid = true;
+
+    _misses++;
+
+    return PSRAM.data() + address;
+}
+
+void PSRAMCacheClass::release(const uint8_t *data)
+{
+    unsigned int index;
+
+    for (index = 0; index < PSRAM_CACHE_ENTRIES; index++) {
+	if (_entries[index].valid && ((PSRAM.data() + _entries[index].address) == data)) {
+	    if (_entries[index].pins) {
+		_entries[index].pins--;
+	    }
+
+	    return;
+	}
+    }
+}
+
+bool PSRAMCacheClass::invalidate(const char *path)
+{
+    Entry *entry;
+
+    entry = lookup(hash(path));
+
+    if (entry) {
+	if (entry->pins) {
+	    return false;
+	}
+
+	remove(entry);
+    }
+
+    return true;
+}
+
+void PSRAMCacheClass::clear()
+{
+    unsigned int index;
+
+    for (index = 0; index < PSRAM_CACHE_ENTRIES; index++) {
+	if (_entries[index].valid && !_entries[index].pins) {
+	    remove(&_entries[index]);
+	}
+    }
+}
+
+PSRAMCacheClass::Entry *PSRAMCacheClass::lookup(uint32_t hash)
+{
+    unsigned int index;
+
+    for (index = 0; index < PSRAM_CACHE_ENTRIES; index++) {
+	if (_entries[index].valid && (_entries[index].hash == hash)) {
+	    return &_entries[index];
+	}
+    }
+
+    return NULL;
+}
+
+bool PSRAMCacheClass::evict()
+{
+    Entry *entry;
+    unsigned int index;
+
+    entry = NULL;
+
+    for (index = 0; index < PSRAM_CACHE_ENTRIES; index++) {
+	if (_entries[index].valid && !_entries[index].pins) {
+	    if (!entry || ((int32_t)(_entries[index].stamp - entry->stamp) < 0)) {
+		entry = &_entries[index];
+	    }
+	}
+    }
+
+    if (!entry) {
+	return false;
+    }
+
+    remove(entry);
+
+    _evictions++;
+
+    return true;
+}
+
+void PSRAMCacheClass::remove(Entry *entry)
+{
+    PSRAM.free(entry->address);
+
+    entry->valid = false;
+}
+
+// FNV-1a
+uint32_t PSRAMCacheClass::hash(const char *path)
+{
+    uint32_t hash;
+
+    hash = 2166136261u;
+
+    while (*path) {
+	hash = (hash ^ (uint8_t)*path++) * 16777619u;
+    }
+
+    return hash;
+}
+
+PSRAMCacheClass PSRAMCache;
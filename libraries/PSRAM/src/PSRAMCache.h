@@ -0,0 +1,94 @@
+/*
+ * Copyright (c) 2017 Thomas Roell.  All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal with the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ *  1. Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimers.
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimers in the
+ *     documentation and/or other materials provided with the distribution.
+ *  3. Neither the name of Thomas Roell, nor the names of its contributors
+ *     may be used to endorse or promote products derived from this Software
+ *     without specific prior written permission.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ * CONTRIBUTORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * WITH THE SOFTWARE.
+ */
+
+#ifndef _PSRAM_CACHE_H_INCLUDED
+#define _PSRAM_CACHE_H_INCLUDED
+
+#include <Arduino.h>
+#include <FS.h>
+
+#include "PSRAM.h"
+
+// Number of files the cache holds, and the size of the SRAM bounce
+// buffer used to copy a file from the file system into PSRAM.
+#define PSRAM_CACHE_ENTRIES     32
+#define PSRAM_CACHE_BUFFER_SIZE 512
+
+// Whole file cache for sound samples in PSRAM.
+//
+// acquire() returns a pointer into the mapped PSRAM holding the complete
+// content of "path", reading the file only on a miss. Hence a sound that
+// is triggered repeatedly is read from the SD card once, and afterwards
+// played straight out of PSRAM (also from an interrupt handler). An
+// acquired entry is pinned until the matching release(); to make room for
+// a new file the least recently acquired unpinned entries are evicted.
+// Files are identified by a hash of their path, so a file that gets
+// rewritten needs an invalidate(). All methods are to be called from
+// loop() only, as a miss goes to the file system.
+class PSRAMCacheClass
+{
+public:
+    PSRAMCacheClass();
+
+    const uint8_t *acquire(const char *path, size_t &size);
+    void release(const uint8_t *data);
+
+    bool invalidate(const char *path);
+    void clear();
+
+    uint32_t hits() { return _hits; }
+    uint32_t misses() { return _misses; }
+    uint32_t evictions() { return _evictions; }
+
+private:
+    struct Entry {
+        uint32_t hash;
+        uint32_t address;
+        uint32_t size;
+        uint32_t stamp;
+        uint16_t pins;
+        bool     valid;
+    };
+
+    Entry _entries[PSRAM_CACHE_ENTRIES];
+    uint32_t _stamp;
+    uint32_t _hits;
+    uint32_t _misses;
+    uint32_t _evictions;
+    uint8_t _buffer[PSRAM_CACHE_BUFFER_SIZE] __attribute__((aligned(4)));
+
+    Entry *lookup(uint32_t hash);
+    bool evict();
+    void remove(Entry *entry);
+
+    static uint32_t hash(const char *path);
+};
+
+extern PSRAMCacheClass PSRAMCache;
+
+#endif // _PSRAM_CACHE_H_INCLUDED
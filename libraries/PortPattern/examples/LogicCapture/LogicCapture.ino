@@ -0,0 +1,77 @@
+/*
+  LogicCapture
+
+  Turns the board into a simple logic analyzer for the pins of one GPIO
+  port. Sending 'c' over Serial captures 8192 samples at 4 MHz and sends
+  them back as raw 16 bit little endian port values (bit n is pin n of the
+  port), preceded by a line with the sample rate and the bit of each pin
+  of interest. Sending 's' streams samples at 100 kHz continuously, till
+  the next character arrives.
+
+  This example code is in the public domain.
+*/
+
+#include <PortPattern.h>
+
+#define CAPTURE_SIZE 8192
+#define RING_SIZE    8192
+
+static const uint8_t pins[4] = { 2, 3, 4, 5 };
+
+static uint16_t samples[CAPTURE_SIZE];
+
+PortCapture analyzer;
+
+void header()
+{
+  unsigned int i;
+
+  Serial.print("CAPTURE,rate=");
+  Serial.print(analyzer.frequency());
+
+  for (i = 0; i < 4; i++) {
+    Serial.print(",pin");
+    Serial.print(pins[i]);
+    Serial.print("=0x");
+    Serial.print(analyzer.mask(pins[i]), HEX);
+  }
+
+  Serial.println();
+}
+
+void setup()
+{
+  Serial.begin(9600);
+
+  while (!Serial) { }
+}
+
+void loop()
+{
+  switch (Serial.read()) {
+  case 'c':
+    analyzer.begin(TIMER_INSTANCE_TIM7, 4000000, pins[0]);
+    analyzer.capture(samples, CAPTURE_SIZE);
+
+    while (analyzer.busy()) { }
+
+    header();
+    Serial.write((const uint8_t*)samples, sizeof(samples));
+
+    analyzer.end();
+    break;
+
+  case 's':
+    analyzer.begin(TIMER_INSTANCE_TIM7, 100000, pins[0]);
+    analyzer.start(samples, RING_SIZE);
+
+    header();
+
+    while (!Serial.available()) {
+      analyzer.send(Serial);
+    }
+
+    analyzer.end();
+    break;
+  }
+}
@@ -0,0 +1,70 @@
+/*
+  StepperPattern
+
+  Drives a 4 wire stepper motor driver with a half step sequence at a fixed
+  step rate. The step timing comes from a timer and DMA, so it does not
+  jitter when loop() is busy. Every 2 seconds the direction is reversed,
+  using play() to output exactly one revolution.
+
+  All pins have to be on the same GPIO port; adjust "pins" to your board.
+
+  This example code is in the public domain.
+*/
+
+#include <PortPattern.h>
+
+#define STEPS_PER_REVOLUTION 400
+
+static const uint8_t pins[4] = { 2, 3, 4, 5 };
+
+static const uint8_t sequence[8] = { 0x1, 0x3, 0x2, 0x6, 0x4, 0xc, 0x8, 0x9 };
+
+static uint32_t forward[8];
+static uint32_t backward[STEPS_PER_REVOLUTION];
+
+PortPattern stepper;
+
+volatile bool done = false;
+
+void revolutionDone()
+{
+  done = true;
+}
+
+void setup()
+{
+  unsigned int i;
+
+  Serial.begin(9600);
+
+  if (!stepper.begin(TIMER_INSTANCE_TIM7, 500, pins, 4)) {
+    Serial.println("pins are not on the same GPIO port");
+
+    while (1) { }
+  }
+
+  for (i = 0; i < 8; i++) {
+    forward[i] = stepper.encode(sequence[i]);
+  }
+
+  for (i = 0; i < STEPS_PER_REVOLUTION; i++) {
+    backward[i] = stepper.encode(sequence[7 - (i & 7)]);
+  }
+
+  stepper.repeat(forward, 8);
+}
+
+void loop()
+{
+  delay(2000);
+
+  stepper.stop();
+
+  done = false;
+
+  stepper.play(backward, STEPS_PER_REVOLUTION, revolutionDone);
+
+  while (!done) { }
+
+  stepper.repeat(forward, 8);
+}
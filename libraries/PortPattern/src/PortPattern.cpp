@@ -0,0 +1,400 @@
+/*
+ * Copyright (c) 2017 Thomas Roell.  All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal with the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ *  1. Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimers.
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimers in the
+ *     documentation and/or other materials provided with the distribution.
+ *  3. Neither the name of Thomas Roell, nor the names of its contributors
+ *     may be used to endorse or promote products derived from this Software
+ *     without specific prior written permission.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ * CONTRIBUTORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * WITH THE SOFTWARE.
+ */
+
+#include "Arduino.h"
+#include "stm32l4_wiring_private.h"
+#include "PortPattern.h"
+
+// Runs "timer" at the closest rate to "frequency" it can produce, using the
+// smallest prescaler for which the period fits into 16 bits. Returns that rate.
+static uint32_t PortTimerStart(stm32l4_timer_t *timer, uint32_t frequency)
+{
+    uint32_t clock, ticks, prescaler;
+
+    clock = stm32l4_timer_clock(timer);
+    ticks = clock / frequency;
+
+    if (ticks < 2) {
+	ticks = 2;
+    }
+
+    prescaler = (ticks + 65535) / 65536;
+
+    if (prescaler > 65536) {
+	prescaler = 65536;
+    }
+
+    ticks = ticks / prescaler;
+
+    stm32l4_timer_enable(timer, prescaler -1, ticks -1, TIMER_OPTION_COUNT_PRELOAD, NULL, NULL, 0);
+    stm32l4_timer_start(timer, false);
+
+    return clock / (prescaler * ticks);
+}
+
+PortPattern::PortPattern()
+{
+    _timer.state = TIMER_STATE_NONE;
+    _port = NULL;
+    _frequency = 0;
+    _count = 0;
+    _callback = NULL;
+}
+
+bool PortPattern::begin(unsigned int instance, uint32_t frequency, const uint8_t *pins, unsigned int count)
+{
+    GPIO_TypeDef *port;
+    unsigned int index;
+
+    if ((_timer.state != TIMER_STATE_NONE) || (frequency == 0) || (count == 0) || (count > PORT_PATTERN_PIN_COUNT)) {
+	return false;
+    }
+
+    port = NULL;
+
+    for (index = 0; index < count; index++) {
+	if ((pins[index] >= PINS_COUNT) || !g_APinDescription[pins[index]].bit) {
+	    return false;
+	}
+
+	if (index == 0) {
+	    port = PIN_DESCRIPTION_PORT(g_APinDescription[pins[index]].pin);
+	} else if (port != PIN_DESCRIPTION_PORT(g_APinDescription[pins[index]].pin)) {
+	    return false;
+	}
+    }
+
+    if (!stm32l4_timer_create(&_timer, instance, STM32L4_PWM_IRQ_PRIORITY, 0)) {
+	return false;
+    }
+
+    _port = port;
+    _count = count;
+
+    for (index = 0; index < count; index++) {
+	_mask[index] = g_APinDescription[pins[index]].bit;
+
+	pinMode(pins[index], OUTPUT);
+    }
+
+    _frequency = PortTimerStart(&_timer, frequency);
+
+    return true;
+}
+
+void PortPattern::end()
+{
+    if (_timer.state == TIMER_STATE_NONE) {
+	return;
+    }
+
+    stop();
+
+    stm32l4_timer_stop(&_timer);
+    stm32l4_timer_disable(&_timer);
+    stm32l4_timer_destroy(&_timer);
+
+    _port = NULL;
+    _count = 0;
+}
+
+uint32_t PortPattern::encode(uint32_t value)
+{
+    uint32_t set, reset;
+    unsigned int index;
+
+    set = 0;
+    reset = 0;
+
+    for (index = 0; index < _count; index++) {
+	if (value & (1ul << index)) {
+	    set |= _mask[index];
+	} else {
+	    reset |= _mask[index];
+	}
+    }
+
+    return (set | (reset << 16));
+}
+
+bool PortPattern::play(const uint32_t *data, size_t count, void(*callback)(void))
+{
+    if (!_port || (count == 0) || (count > 65535)) {
+	return false;
+    }
+
+    _callback = callback;
+
+    return stm32l4_timer_pattern(&_timer, &_port->BSRR, data, count, PortPattern::_timerCallback, (void*)this);
+}
+
+bool PortPattern::repeat(const uint32_t *data, size_t count)
+{
+    if (!_port || (count == 0) || (count > 65535)) {
+	return false;
+    }
+
+    _callback = NULL;
+
+    return stm32l4_timer_pattern_cyclic(&_timer, &_port->BSRR, data, count);
+}
+
+void PortPattern::stop()
+{
+    if (!_port) {
+	return;
+    }
+
+    // Pins keep the level of the last word written.
+    _callback = NULL;
+
+    stm32l4_timer_stream_stop(&_timer);
+}
+
+bool PortPattern::busy()
+{
+    if (!_port) {
+	return false;
+    }
+
+    return !stm32l4_timer_stream_done(&_timer);
+}
+
+void PortPattern::_timerCallback(void *context, uint32_t events)
+{
+    PortPattern *self = reinterpret_cast<PortPattern*>(context);
+    void (*callback)(void);
+
+    if (events & TIMER_EVENT_STREAM_DONE) {
+	callback = self->_callback;
+
+	self->_callback = NULL;
+
+	if (callback) {
+	    (*callback)();
+	}
+    }
+}
+
+PortCapture::PortCapture()
+{
+    _timer.state = TIMER_STATE_NONE;
+    _port = NULL;
+    _frequency = 0;
+    _ring = NULL;
+    _size = 0;
+    _head = 0;
+    _callback = NULL;
+}
+
+bool PortCapture::begin(unsigned int instance, uint32_t frequency, uint8_t pin)
+{
+    if ((_timer.state != TIMER_STATE_NONE) || (frequency == 0)) {
+	return false;
+    }
+
+    if ((pin >= PINS_COUNT) || !g_APinDescription[pin].bit) {
+	return false;
+    }
+
+    if (!stm32l4_timer_create(&_timer, instance, STM32L4_PWM_IRQ_PRIORITY, 0)) {
+	return false;
+    }
+
+    _port = PIN_DESCRIPTION_PORT(g_APinDescription[pin].pin);
+    _frequency = PortTimerStart(&_timer, frequency);
+
+    return true;
+}
+
+void PortCapture::end()
+{
+    if (_timer.state == TIMER_STATE_NONE) {
+	return;
+    }
+
+    stop();
+
+    stm32l4_timer_stop(&_timer);
+    stm32l4_timer_disable(&_timer);
+    stm32l4_timer_destroy(&_timer);
+
+    _port = NULL;
+}
+
+uint16_t PortCapture::mask(uint8_t pin)
+{
+    if (!_port || (pin >= PINS_COUNT) || (PIN_DESCRIPTION_PORT(g_APinDescription[pin].pin) != _port)) {
+	return 0;
+    }
+
+    return g_APinDescription[pin].bit;
+}
+
+bool PortCapture::capture(uint16_t *data, size_t count, void(*callback)(void))
+{
+    if (!_port || (count == 0) || (count > 65535)) {
+	return false;
+    }
+
+    _ring = NULL;
+    _callback = callback;
+
+    return stm32l4_timer_sample(&_timer, &_port->IDR, data, count, PortCapture::_timerCallback, (void*)this);
+}
+
+bool PortCapture::start(uint16_t *ring, size_t size)
+{
+    if (!_port || (size < 2) || (size > 65535)) {
+	return false;
+    }
+
+    if (!stm32l4_timer_sample_cyclic(&_timer, &_port->IDR, ring, size)) {
+	return false;
+    }
+
+    _ring = ring;
+    _size = size;
+    _head = 0;
+    _callback = NULL;
+
+    return true;
+}
+
+void PortCapture::stop()
+{
+    if (!_port) {
+	return;
+    }
+
+    _callback = NULL;
+
+    stm32l4_timer_stream_stop(&_timer);
+
+    _ring = NULL;
+}
+
+bool PortCapture::busy()
+{
+    if (!_port) {
+	return false;
+    }
+
+    return !stm32l4_timer_stream_done(&_timer);
+}
+
+size_t PortCapture::available()
+{
+    unsigned int tail;
+
+    if (!_ring) {
+	return 0;
+    }
+
+    // The DMA counts down from _size to 1, and reloads _size after the last
+    // element of the ring.
+    tail = _size - stm32l4_timer_stream_count(&_timer);
+
+    if (tail == _size) {
+	tail = 0;
+    }
+
+    return ((tail >= _head) ? (tail - _head) : ((_size - _head) + tail));
+}
+
+size_t PortCapture::read(uint16_t *data, size_t count)
+{
+    size_t total, n;
+
+    total = available();
+
+    if (total > count) {
+	total = count;
+    }
+
+    for (count = total; count; count -= n) {
+	n = _size - _head;
+
+	if (n > count) {
+	    n = count;
+	}
+
+	memcpy(data, &_ring[_head], n * sizeof(uint16_t));
+
+	data += n;
+	_head += n;
+
+	if (_head == _size) {
+	    _head = 0;
+	}
+    }
+
+    return total;
+}
+
+size_t PortCapture::send(Print &output)
+{
+    size_t total, count, n;
+
+    total = available();
+
+    // Contiguous spans of the ring are handed straight to "output", without copying.
+    for (count = total; count; count -= n) {
+	n = _size - _head;
+
+	if (n > count) {
+	    n = count;
+	}
+
+	output.write((const uint8_t*)&_ring[_head], n * sizeof(uint16_t));
+
+	_head += n;
+
+	if (_head == _size) {
+	    _head = 0;
+	}
+    }
+
+    return total;
+}
+
+void PortCapture::_timerCallback(void *context, uint32_t events)
+{
+    PortCapture *self = reinterpret_cast<PortCapture*>(context);
+    void (*callback)(void);
+
+    if (events & TIMER_EVENT_STREAM_DONE) {
+	callback = self->_callback;
+
+	self->_callback = NULL;
+
+	if (callback) {
+	    (*callback)();
+	}
+    }
+}
@@ -0,0 +1,129 @@
+/*
+ * Copyright (c) 2017 Thomas Roell.  All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal with the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ *  1. Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimers.
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimers in the
+ *     documentation and/or other materials provided with the distribution.
+ *  3. Neither the name of Thomas Roell, nor the names of its contributors
+ *     may be used to endorse or promote products derived from this Software
+ *     without specific prior written permission.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ * CONTRIBUTORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * WITH THE SOFTWARE.
+ */
+
+#ifndef _PORT_PATTERN_H_INCLUDED
+#define _PORT_PATTERN_H_INCLUDED
+
+#include <Arduino.h>
+
+#include "stm32l4_timer.h"
+
+#define PORT_PATTERN_PIN_COUNT 16
+
+// Hardware timed digital pattern generator.
+//
+// begin() picks up to 16 pins, which all have to be on the same GPIO port,
+// and starts the timer "instance" at "frequency" steps per second. Each
+// timer update DMAs one 32 bit word of a pattern into the port's BSRR, so
+// all pins change in the same cycle regardless of interrupts or loop()
+// scheduling. A word sets the pins in its low and clears the pins in its
+// high 16 bits, and leaves all other pins of the port alone; encode()
+// builds such a word from a value whose bit i is the level of pins[i].
+//
+// play() outputs a pattern once and calls "callback" from the timer
+// interrupt when done, repeat() repeats it till stop(). Patterns are read
+// by DMA while playing, so they have to stay valid (and unmodified) till
+// busy() returns false.
+class PortPattern
+{
+public:
+    PortPattern();
+
+    bool begin(unsigned int instance, uint32_t frequency, const uint8_t *pins, unsigned int count);
+    void end();
+
+    uint32_t encode(uint32_t value);
+
+    bool play(const uint32_t *data, size_t count, void(*callback)(void) = NULL);
+    bool repeat(const uint32_t *data, size_t count);
+    void stop();
+    bool busy();
+
+    uint32_t frequency() { return _frequency; }
+
+private:
+    stm32l4_timer_t _timer;
+    GPIO_TypeDef *_port;
+    uint32_t _frequency;
+    uint16_t _mask[PORT_PATTERN_PIN_COUNT];
+    unsigned int _count;
+    void (*_callback)(void);
+
+    static void _timerCallback(void *context, uint32_t events);
+};
+
+// Logic analyzer style capture of a GPIO port.
+//
+// begin() starts the timer "instance" at "frequency" samples per second.
+// Each timer update DMAs the port's IDR, i.e. the levels of all 16 pins of
+// the port "pin" is on, into a 16 bit sample; mask() returns the bit of a
+// pin within a sample. This runs at several MHz, far beyond what polling
+// digitalRead() manages, and with a sample clock that does not jitter.
+//
+// capture() fills "data" once and calls "callback" from the timer
+// interrupt when done. start() instead keeps sampling into "ring" till
+// stop(). available()/read() drain the ring, and send() writes the
+// available samples as raw little endian bytes to a Print, like Serial
+// (ideally in its high throughput mode) or WebUSBSerial, for a host side
+// viewer. The ring has to be drained before the DMA laps the reader,
+// otherwise samples are silently lost; USB full speed sustains a few
+// 100k samples per second.
+class PortCapture
+{
+public:
+    PortCapture();
+
+    bool begin(unsigned int instance, uint32_t frequency, uint8_t pin);
+    void end();
+
+    uint16_t mask(uint8_t pin);
+
+    bool capture(uint16_t *data, size_t count, void(*callback)(void) = NULL);
+    bool start(uint16_t *ring, size_t size);
+    void stop();
+    bool busy();
+
+    size_t available();
+    size_t read(uint16_t *data, size_t count);
+    size_t send(Print &output);
+
+    uint32_t frequency() { return _frequency; }
+
+private:
+    stm32l4_timer_t _timer;
+    GPIO_TypeDef *_port;
+    uint32_t _frequency;
+    uint16_t *_ring;
+    uint16_t _size;
+    uint16_t _head;
+    void (*_callback)(void);
+
+    static void _timerCallback(void *context, uint32_t events);
+};
+
+#endif // _PORT_PATTERN_H_INCLUDED
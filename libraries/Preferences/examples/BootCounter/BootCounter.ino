@@ -0,0 +1,50 @@
+/*
+  BootCounter
+
+  Counts resets in the emulated EEPROM via Preferences, and keeps a
+  device name next to it. Send a line over Serial to rename the device.
+
+  This example code is in the public domain.
+*/
+
+#include <Preferences.h>
+
+void setup()
+{
+  char name[PREFERENCES_VALUE_SIZE + 1];
+  uint32_t boots;
+
+  Serial.begin(9600);
+
+  while (!Serial) { }
+
+  Preferences.begin();
+
+  boots = Preferences.getUInt("boots", 0) + 1;
+  Preferences.putUInt("boots", boots);
+
+  if (!Preferences.getString("name", name, sizeof(name))) {
+    strcpy(name, "unnamed");
+  }
+
+  Serial.print(name);
+  Serial.print(" booted ");
+  Serial.print(boots);
+  Serial.println(" times");
+}
+
+void loop()
+{
+  char line[PREFERENCES_VALUE_SIZE + 1];
+  size_t count;
+
+  if (Serial.available()) {
+    count = Serial.readBytesUntil('\n', line, sizeof(line) - 1);
+    line[count] = '\0';
+
+    if (count && Preferences.putString("name", line)) {
+      Serial.print("renamed to ");
+      Serial.println(line);
+    }
+  }
+}
@@ -0,0 +1,687 @@
+/*
+ * Copyright (c) 2017 Thomas Roell.  All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal with the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ *  1. Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimers.
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimers in the
+ *     documentation and/or other materials provided with the distribution.
+ *  3. Neither the name of Thomas Roell, nor the names of its contributors
+ *     may be used to endorse or promote products derived from this Software
+ *     without specific prior written permission.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ * CONTRIBUTORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * WITH THE SOFTWARE.
+ */
+
+#include "Preferences.h"
+
+#include <avr/eeprom.h>
+
+#define PREFERENCES_BACKEND_NONE   0
+#define PREFERENCES_BACKEND_EEPROM 1
+#define PREFERENCES_BACKEND_FILE   2
+
+#define PREFERENCES_READ_RECORDS   8
+
+PreferencesClass::PreferencesClass()
+{
+    _backend = PREFERENCES_BACKEND_NONE;
+    _address = 0;
+    _slots = 0;
+    _count = 0;
+    _path[0] = '\0';
+}
+
+bool PreferencesClass::begin(uint32_t address, uint32_t size)
+{
+    Record record;
+    unsigned int index;
+
+    end();
+
+    if ((address > (E2END +1)) || (size > ((E2END +1) - address)) || (size < sizeof(Record))) {
+        return false;
+    }
+
+    _backend = PREFERENCES_BACKEND_EEPROM;
+    _address = address;
+    _slots = size / sizeof(Record);
+
+    if (_slots > PREFERENCES_ENTRY_COUNT) {
+        _slots = PREFERENCES_ENTRY_COUNT;
+    }
+
+    // A slot holds the record at _records[] with the same index, an invalid
+    // slot is free.
+    for (index = 0; index < _slots; index++) {
+        eeprom_read_block(&record, (const void*)(_address + index * sizeof(Record)), sizeof(Record));
+
+        if ((record.type != PREFERENCES_TYPE_NONE) && valid(&record)) {
+            _records[index] = record;
+        } else {
+            _records[index].type = PREFERENCES_TYPE_NONE;
+        }
+    }
+
+    rebuild();
+
+    return true;
+}
+
+bool PreferencesClass::begin(const char *path)
+{
+    Record records[PREFERENCES_READ_RECORDS];
+    char temp[PREFERENCES_PATH_SIZE];
+    unsigned int index, count;
+    uint32_t slots;
+    bool partial;
+    File file;
+
+    end();
+
+    if ((strlen(path) + 5) > PREFERENCES_PATH_SIZE) {
+        return false;
+    }
+
+    strcpy(_path, path);
+    strcpy(temp, path);
+    strcat(temp, ".tmp");
+
+    // A compact() that did not complete may have left only the new file.
+    if (!DOSFS.exists(_path) && DOSFS.exists(temp)) {
+        DOSFS.rename(temp, _path);
+    }
+
+    _backend = PREFERENCES_BACKEND_FILE;
+
+    slots = 0;
+    partial = false;
+
+    file = DOSFS.open(_path, "r");
+
+    if (file) {
+        // Later records of a key replace earlier ones, a NONE record deletes it.
+        while ((count = file.read((uint8_t*)&records[0], sizeof(records)) / sizeof(Record)) != 0) {
+            for (index = 0; index < count; index++) {
+                if (valid(&records[index])) {
+                    int entry = lookup(records[index].key);
+
+                    if (records[index].type == PREFERENCES_TYPE_NONE) {
+                        if (entry >= 0) {
+                            _records[entry].type = PREFERENCES_TYPE_NONE;
+
+                            rebuild();
+                        }
+                    } else {
+                        if (entry < 0) {
+                            for (entry = 0; entry < PREFERENCES_ENTRY_COUNT; entry++) {
+                                if (_records[entry].type == PREFERENCES_TYPE_NONE) {
+                                    break;
+                                }
+                            }
+
+                            if (entry == PREFERENCES_ENTRY_COUNT) {
+                                continue;
+                            }
+
+                            _records[entry] = records[index];
+
+                            rebuild();
+                        } else {
+                            _records[entry] = records[index];
+                        }
+                    }
+                }
+            }
+
+            slots += count;
+        }
+
+        partial = ((file.size() % sizeof(Record)) != 0);
+
+        file.close();
+    }
+
+    _slots = slots;
+
+    // A torn record at the end would misalign further appends, so that
+    // case has to be compacted.
+    if (partial || (_slots > (_count + PREFERENCES_ENTRY_COUNT))) {
+        if (!compact() && partial) {
+            end();
+
+            return false;
+        }
+    } else {
+        _file = DOSFS.open(_path, "a");
+    }
+
+    if (!_file) {
+        end();
+
+        return false;
+    }
+
+    return true;
+}
+
+void PreferencesClass::end()
+{
+    unsigned int index;
+
+    if (_file) {
+        _file.close();
+    }
+
+    for (index = 0; index < PREFERENCES_ENTRY_COUNT; index++) {
+        _records[index].type = PREFERENCES_TYPE_NONE;
+    }
+
+    memset(_index, 0, sizeof(_index));
+
+    _backend = PREFERENCES_BACKEND_NONE;
+    _slots = 0;
+    _count = 0;
+}
+
+bool PreferencesClass::clear()
+{
+    Record record;
+    unsigned int index;
+
+    if (_backend == PREFERENCES_BACKEND_NONE) {
+        return false;
+    }
+
+    if (_backend == PREFERENCES_BACKEND_FILE) {
+        for (index = 0; index < PREFERENCES_ENTRY_COUNT; index++) {
+            _records[index].type = PREFERENCES_TYPE_NONE;
+        }
+
+        rebuild();
+
+        return compact();
+    }
+
+    for (index = 0; index < _slots; index++) {
+        if (_records[index].type != PREFERENCES_TYPE_NONE) {
+            record = _records[index];
+            record.type = PREFERENCES_TYPE_NONE;
+            record.crc = crc(&record);
+
+            if (!store(&record, index)) {
+                return false;
+            }
+
+            _records[index].type = PREFERENCES_TYPE_NONE;
+        }
+    }
+
+    rebuild();
+
+    return true;
+}
+
+bool PreferencesClass::remove(const char *key)
+{
+    Record record;
+    int index;
+
+    if (_backend == PREFERENCES_BACKEND_NONE) {
+        return false;
+    }
+
+    index = lookup(key);
+
+    if (index < 0) {
+        return false;
+    }
+
+    record = _records[index];
+    record.type = PREFERENCES_TYPE_NONE;
+    record.crc = crc(&record);
+
+    if (!store(&record, index)) {
+        return false;
+    }
+
+    _records[index].type = PREFERENCES_TYPE_NONE;
+
+    rebuild();
+
+    return true;
+}
+
+bool PreferencesClass::isKey(const char *key)
+{
+    return (lookup(key) >= 0);
+}
+
+unsigned int PreferencesClass::getType(const char *key)
+{
+    int index;
+
+    index = lookup(key);
+
+    if (index < 0) {
+        return PREFERENCES_TYPE_NONE;
+    }
+
+    return _records[index].type;
+}
+
+unsigned int PreferencesClass::freeEntries()
+{
+    if (_backend == PREFERENCES_BACKEND_EEPROM) {
+        return _slots - _count;
+    }
+
+    if (_backend == PREFERENCES_BACKEND_FILE) {
+        return PREFERENCES_ENTRY_COUNT - _count;
+    }
+
+    return 0;
+}
+
+size_t PreferencesClass::putBool(const char *key, bool value)
+{
+    uint8_t data = value;
+
+    return put(key, PREFERENCES_TYPE_BOOL, &data, sizeof(data));
+}
+
+size_t PreferencesClass::putInt(const char *key, int32_t value)
+{
+    return put(key, PREFERENCES_TYPE_INT, &value, sizeof(value));
+}
+
+size_t PreferencesClass::putUInt(const char *key, uint32_t value)
+{
+    return put(key, PREFERENCES_TYPE_UINT, &value, sizeof(value));
+}
+
+size_t PreferencesClass::putFloat(const char *key, float value)
+{
+    return put(key, PREFERENCES_TYPE_FLOAT, &value, sizeof(value));
+}
+
+size_t PreferencesClass::putDouble(const char *key, double value)
+{
+    return put(key, PREFERENCES_TYPE_DOUBLE, &value, sizeof(value));
+}
+
+size_t PreferencesClass::putString(const char *key, const char *value)
+{
+    return put(key, PREFERENCES_TYPE_STRING, value, strlen(value));
+}
+
+size_t PreferencesClass::putBytes(const char *key, const void *value, size_t size)
+{
+    return put(key, PREFERENCES_TYPE_BYTES, value, size);
+}
+
+bool PreferencesClass::getBool(const char *key, bool defaultValue)
+{
+    const Record *record = get(key, PREFERENCES_TYPE_BOOL);
+
+    return record ? !!record->value[0] : defaultValue;
+}
+
+int32_t PreferencesClass::getInt(const char *key, int32_t defaultValue)
+{
+    const Record *record = get(key, PREFERENCES_TYPE_INT);
+    int32_t value;
+
+    if (!record) {
+        return defaultValue;
+    }
+
+    memcpy(&value, &record->value[0], sizeof(value));
+
+    return value;
+}
+
+uint32_t PreferencesClass::getUInt(const char *key, uint32_t defaultValue)
+{
+    const Record *record = get(key, PREFERENCES_TYPE_UINT);
+    uint32_t value;
+
+    if (!record) {
+        return defaultValue;
+    }
+
+    memcpy(&value, &record->value[0], sizeof(value));
+
+    return value;
+}
+
+float PreferencesClass::getFloat(const char *key, float defaultValue)
+{
+    const Record *record = get(key, PREFERENCES_TYPE_FLOAT);
+    float value;
+
+    if (!record) {
+        return defaultValue;
+    }
+
+    memcpy(&value, &record->value[0], sizeof(value));
+
+    return value;
+}
+
+double PreferencesClass::getDouble(const char *key, double defaultValue)
+{
+    const Record *record = get(key, PREFERENCES_TYPE_DOUBLE);
+    double value;
+
+    if (!record) {
+        return defaultValue;
+    }
+
+    memcpy(&value, &record->value[0], sizeof(value));
+
+    return value;
+}
+
+// Copies at most "size" -1 characters and a terminating NUL, and returns the
+// number of characters copied.
+size_t PreferencesClass::getString(const char *key, char *value, size_t size)
+{
+    const Record *record = get(key, PREFERENCES_TYPE_STRING);
+    size_t count;
+
+    if (!record || !size) {
+        return 0;
+    }
+
+    count = record->size;
+
+    if (count > (size -1)) {
+        count = size -1;
+    }
+
+    memcpy(value, &record->value[0], count);
+    value[count] = '\0';
+
+    return count;
+}
+
+size_t PreferencesClass::getBytes(const char *key, void *value, size_t size)
+{
+    const Record *record = get(key, PREFERENCES_TYPE_BYTES);
+    size_t count;
+
+    if (!record) {
+        return 0;
+    }
+
+    count = record->size;
+
+    if (count > size) {
+        count = size;
+    }
+
+    memcpy(value, &record->value[0], count);
+
+    return count;
+}
+
+// CRC16-CCITT (polynom 0x1021, init 0xffff) over all of the record but "crc".
+uint16_t PreferencesClass::crc(const Record *record)
+{
+    const uint8_t *data = (const uint8_t*)record + sizeof(record->crc);
+    unsigned int count, bit;
+    uint16_t crc;
+
+    crc = 0xffff;
+
+    for (count = sizeof(Record) - sizeof(record->crc); count; count--) {
+        crc ^= (*data++ << 8);
+
+        for (bit = 0; bit < 8; bit++) {
+            crc = (crc & 0x8000) ? ((crc << 1) ^ 0x1021) : (crc << 1);
+        }
+    }
+
+    return crc;
+}
+
+// FNV-1a
+uint32_t PreferencesClass::hash(const char *key)
+{
+    uint32_t hash;
+
+    hash = 2166136261u;
+
+    while (*key) {
+        hash = (hash ^ (uint8_t)*key++) * 16777619u;
+    }
+
+    return hash;
+}
+
+int PreferencesClass::lookup(const char *key)
+{
+    unsigned int slot, index;
+
+    slot = hash(key) & (PREFERENCES_HASH_SIZE -1);
+
+    while (_index[slot]) {
+        index = _index[slot] -1;
+
+        if (!strcmp(_records[index].key, key)) {
+            return index;
+        }
+
+        slot = (slot +1) & (PREFERENCES_HASH_SIZE -1);
+    }
+
+    return -1;
+}
+
+void PreferencesClass::rebuild()
+{
+    unsigned int slot, index;
+
+    memset(_index, 0, sizeof(_index));
+
+    _count = 0;
+
+    for (index = 0; index < PREFERENCES_ENTRY_COUNT; index++) {
+        if (_records[index].type != PREFERENCES_TYPE_NONE) {
+            slot = hash(_records[index].key) & (PREFERENCES_HASH_SIZE -1);
+
+            while (_index[slot]) {
+                slot = (slot +1) & (PREFERENCES_HASH_SIZE -1);
+            }
+
+            _index[slot] = index +1;
+
+            _count++;
+        }
+    }
+}
+
+// Returns true if "record" is intact.
+bool PreferencesClass::valid(const Record *record)
+{
+    if (record->crc != crc(record)) {
+        return false;
+    }
+
+    if ((record->type > PREFERENCES_TYPE_BYTES) || (record->size > PREFERENCES_VALUE_SIZE)) {
+        return false;
+    }
+
+    if (!record->key[0] || !memchr(&record->key[0], '\0', PREFERENCES_KEY_SIZE)) {
+        return false;
+    }
+
+    return true;
+}
+
+// Writes "record" for _records[index] to the backing store.
+bool PreferencesClass::store(const Record *record, int index)
+{
+    if (_backend == PREFERENCES_BACKEND_EEPROM) {
+        eeprom_write_block(record, (void*)(_address + index * sizeof(Record)), sizeof(Record));
+
+        return true;
+    }
+
+    if (!_file) {
+        return false;
+    }
+
+    if (_file.write((const uint8_t*)record, sizeof(Record)) != sizeof(Record)) {
+        return false;
+    }
+
+    _file.flush();
+
+    _slots++;
+
+    // The record is stored at this point, even if compacting the log fails.
+    if (_slots > (_count + PREFERENCES_ENTRY_COUNT)) {
+        compact();
+    }
+
+    return true;
+}
+
+// Rewrites the log file with just the live records. The new file is written
+// under a temporary name first, so that a power failure leaves either the
+// old or the new one.
+bool PreferencesClass::compact()
+{
+    char temp[PREFERENCES_PATH_SIZE];
+    unsigned int index;
+    File file;
+
+    if (_file) {
+        _file.close();
+    }
+
+    strcpy(temp, _path);
+    strcat(temp, ".tmp");
+
+    file = DOSFS.open(temp, "w");
+
+    if (file) {
+        for (index = 0; index < PREFERENCES_ENTRY_COUNT; index++) {
+            if (_records[index].type != PREFERENCES_TYPE_NONE) {
+                if (file.write((const uint8_t*)&_records[index], sizeof(Record)) != sizeof(Record)) {
+                    break;
+                }
+            }
+        }
+
+        file.close();
+
+        if (index == PREFERENCES_ENTRY_COUNT) {
+            DOSFS.remove(_path);
+
+            if (DOSFS.rename(temp, _path)) {
+                _slots = _count;
+            }
+        } else {
+            DOSFS.remove(temp);
+        }
+    }
+
+    // Keep appending to whichever log is in place.
+    _file = DOSFS.open(_path, "a");
+
+    return (_file && (_slots == _count));
+}
+
+size_t PreferencesClass::put(const char *key, unsigned int type, const void *value, size_t size)
+{
+    Record record, previous;
+    unsigned int limit;
+    int index;
+    bool insert;
+
+    if ((_backend == PREFERENCES_BACKEND_NONE) || !key[0] || (strlen(key) >= PREFERENCES_KEY_SIZE) || (size > PREFERENCES_VALUE_SIZE)) {
+        return 0;
+    }
+
+    memset(&record, 0, sizeof(record));
+
+    record.type = type;
+    record.size = size;
+    strcpy(&record.key[0], key);
+    memcpy(&record.value[0], value, size);
+    record.crc = crc(&record);
+
+    index = lookup(key);
+    insert = (index < 0);
+
+    if (insert) {
+        limit = (_backend == PREFERENCES_BACKEND_EEPROM) ? _slots : PREFERENCES_ENTRY_COUNT;
+
+        for (index = 0; index < (int)limit; index++) {
+            if (_records[index].type == PREFERENCES_TYPE_NONE) {
+                break;
+            }
+        }
+
+        if (index == (int)limit) {
+            return 0;
+        }
+    } else {
+        if (!memcmp(&_records[index], &record, sizeof(Record))) {
+            return size;
+        }
+    }
+
+    // The RAM copy is updated first, so that a compact() triggered by store()
+    // writes out the new value.
+    previous = _records[index];
+
+    _records[index] = record;
+
+    if (insert) {
+        rebuild();
+    }
+
+    if (!store(&record, index)) {
+        _records[index] = previous;
+
+        if (insert) {
+            rebuild();
+        }
+
+        return 0;
+    }
+
+    return size;
+}
+
+const PreferencesClass::Record *PreferencesClass::get(const char *key, unsigned int type)
+{
+    int index;
+
+    index = lookup(key);
+
+    if ((index < 0) || (_records[index].type != type)) {
+        return NULL;
+    }
+
+    return &_records[index];
+}
+
+PreferencesClass Preferences;
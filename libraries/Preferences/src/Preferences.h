@@ -0,0 +1,132 @@
+/*
+ * Copyright (c) 2017 Thomas Roell.  All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal with the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ *  1. Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimers.
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimers in the
+ *     documentation and/or other materials provided with the distribution.
+ *  3. Neither the name of Thomas Roell, nor the names of its contributors
+ *     may be used to endorse or promote products derived from this Software
+ *     without specific prior written permission.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ * CONTRIBUTORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * WITH THE SOFTWARE.
+ */
+
+#ifndef _PREFERENCES_H_INCLUDED
+#define _PREFERENCES_H_INCLUDED
+
+#include <Arduino.h>
+#include <FS.h>
+#include <avr/io.h>
+
+// Maximum number of keys, the size of the RAM hash index (a power of 2,
+// larger than the number of keys), and the key/value sizes of a record.
+#define PREFERENCES_ENTRY_COUNT 128
+#define PREFERENCES_HASH_SIZE   256
+#define PREFERENCES_KEY_SIZE    16    // including the terminating NUL
+#define PREFERENCES_VALUE_SIZE  12
+#define PREFERENCES_PATH_SIZE   64
+
+#define PREFERENCES_TYPE_NONE   0
+#define PREFERENCES_TYPE_BOOL   1
+#define PREFERENCES_TYPE_INT    2
+#define PREFERENCES_TYPE_UINT   3
+#define PREFERENCES_TYPE_FLOAT  4
+#define PREFERENCES_TYPE_DOUBLE 5
+#define PREFERENCES_TYPE_STRING 6
+#define PREFERENCES_TYPE_BYTES  7
+
+// Typed key-value settings store.
+//
+// Each setting is a fixed size 32 byte record (CRC16-CCITT, type, size,
+// key, value). All records are kept in RAM and found via a hash index of
+// their keys, so get*() never touches the storage, and begin() is a single
+// pass over the stored records that drops those with a bad CRC.
+//
+// begin(address, size) keeps one record per slot in the emulated EEPROM
+// (avr/eeprom.h), starting at "address". The EEPROM emulation only logs
+// the 4 byte words that change, so updating a key costs a few flash
+// records. begin(path) instead keeps an append-only log file on DOSFS
+// (DOSFS.begin() has to be called first), where an update appends one
+// record, and the log is compacted into a new file once it holds more
+// than PREFERENCES_ENTRY_COUNT stale records.
+//
+// A put*() of the value already stored writes nothing. A get*() of a key
+// that is missing or has a different type returns "defaultValue".
+class PreferencesClass
+{
+public:
+    PreferencesClass();
+
+    bool begin(uint32_t address = 0, uint32_t size = (E2END +1));
+    bool begin(const char *path);
+    void end();
+
+    bool clear();
+    bool remove(const char *key);
+    bool isKey(const char *key);
+    unsigned int getType(const char *key);
+    unsigned int freeEntries();
+
+    size_t putBool(const char *key, bool value);
+    size_t putInt(const char *key, int32_t value);
+    size_t putUInt(const char *key, uint32_t value);
+    size_t putFloat(const char *key, float value);
+    size_t putDouble(const char *key, double value);
+    size_t putString(const char *key, const char *value);
+    size_t putBytes(const char *key, const void *value, size_t size);
+
+    bool getBool(const char *key, bool defaultValue = false);
+    int32_t getInt(const char *key, int32_t defaultValue = 0);
+    uint32_t getUInt(const char *key, uint32_t defaultValue = 0);
+    float getFloat(const char *key, float defaultValue = 0.0f);
+    double getDouble(const char *key, double defaultValue = 0.0);
+    size_t getString(const char *key, char *value, size_t size);
+    size_t getBytes(const char *key, void *value, size_t size);
+
+private:
+    struct Record {
+        uint16_t crc;     // over the rest of the record
+        uint8_t type;
+        uint8_t size;
+        char key[PREFERENCES_KEY_SIZE];
+        uint8_t value[PREFERENCES_VALUE_SIZE];
+    };
+
+    uint8_t _backend;
+    uint32_t _address;
+    uint32_t _slots;      // EEPROM slots, or records in the log file
+    unsigned int _count;
+    File _file;
+    char _path[PREFERENCES_PATH_SIZE];
+    Record _records[PREFERENCES_ENTRY_COUNT];
+    uint8_t _index[PREFERENCES_HASH_SIZE];   // 1 + index into _records[], 0 if empty
+
+    static uint16_t crc(const Record *record);
+    static uint32_t hash(const char *key);
+    int lookup(const char *key);
+    void rebuild();
+    static bool valid(const Record *record);
+    bool store(const Record *record, int index);
+    bool compact();
+    size_t put(const char *key, unsigned int type, const void *value, size_t size);
+    const Record *get(const char *key, unsigned int type);
+};
+
+extern PreferencesClass Preferences;
+
+#endif // _PREFERENCES_H_INCLUDED
@@ -0,0 +1,148 @@
+/*
+  Atomics
+
+  Compares the lock-free primitives of Atomic.h (Atomic<T>, SpscQueue,
+  MpscQueue and Seqlock) against the same operations guarded by masking
+  interrupts (PRIMASK save, cpsid i, restore). Results are printed once
+  over Serial, in cycles per operation. Lines start with "ATOMIC,".
+
+  This example code is in the public domain.
+*/
+
+#include <Profiler.h>
+#include <Atomic.h>
+
+#define ITERATIONS 32
+#define QUEUE_SIZE 16
+
+struct Sample {
+  uint32_t timestamp;
+  int16_t x, y, z;
+};
+
+static Atomic<uint32_t> atomicCounter;
+static volatile uint32_t maskedCounter;
+
+static SpscQueue<Sample, QUEUE_SIZE> spscQueue;
+static MpscQueue<Sample, QUEUE_SIZE> mpscQueue;
+
+static Sample maskedQueue[QUEUE_SIZE];
+static volatile uint32_t maskedHead, maskedTail;
+
+static Seqlock<Sample> seqlock;
+static Sample maskedSample;
+
+static inline uint32_t lock()
+{
+  uint32_t primask = __get_PRIMASK();
+
+  __disable_irq();
+
+  return primask;
+}
+
+static inline void unlock(uint32_t primask)
+{
+  __set_PRIMASK(primask);
+}
+
+static bool maskedPush(const Sample &sample)
+{
+  uint32_t primask = lock();
+  bool success = false;
+
+  if ((maskedHead - maskedTail) != QUEUE_SIZE) {
+    maskedQueue[maskedHead & (QUEUE_SIZE - 1)] = sample;
+    maskedHead = maskedHead + 1;
+    success = true;
+  }
+
+  unlock(primask);
+
+  return success;
+}
+
+static bool maskedPop(Sample &sample)
+{
+  uint32_t primask = lock();
+  bool success = false;
+
+  if (maskedHead != maskedTail) {
+    sample = maskedQueue[maskedTail & (QUEUE_SIZE - 1)];
+    maskedTail = maskedTail + 1;
+    success = true;
+  }
+
+  unlock(primask);
+
+  return success;
+}
+
+static uint32_t __attribute__((noinline)) measure(int test)
+{
+  Sample sample = { 0, 1, 2, 3 };
+  uint32_t start, cycles, best, primask;
+  unsigned int i;
+
+  best = 0xffffffff;
+
+  for (i = 0; i < ITERATIONS; i++) {
+    start = Profiler.cycles();
+
+    switch (test) {
+    case 0: atomicCounter++; break;
+    case 1: primask = lock(); maskedCounter = maskedCounter + 1; unlock(primask); break;
+    case 2: spscQueue.push(sample); spscQueue.pop(sample); break;
+    case 3: mpscQueue.push(sample); mpscQueue.pop(sample); break;
+    case 4: maskedPush(sample); maskedPop(sample); break;
+    case 5: seqlock.write(sample); break;
+    case 6: sample = seqlock.read(); break;
+    case 7: primask = lock(); maskedSample = sample; unlock(primask); break;
+    case 8: primask = lock(); sample = maskedSample; unlock(primask); break;
+    }
+
+    cycles = Profiler.cycles() - start;
+
+    if (best > cycles) {
+      best = cycles;
+    }
+  }
+
+  // keep the reads alive
+  maskedCounter = maskedCounter + sample.timestamp;
+
+  return best;
+}
+
+static void report(const char *name, int test)
+{
+  Serial.print("ATOMIC,");
+  Serial.print(name);
+  Serial.print(",cycles=");
+  Serial.println(measure(test));
+}
+
+void setup()
+{
+  Serial.begin(9600);
+
+  while (!Serial) { }
+
+  Profiler.begin();
+
+  report("increment,atomic", 0);
+  report("increment,masked", 1);
+  report("queue,spsc", 2);
+  report("queue,mpsc", 3);
+  report("queue,masked", 4);
+  report("snapshot,write,seqlock", 5);
+  report("snapshot,read,seqlock", 6);
+  report("snapshot,write,masked", 7);
+  report("snapshot,read,masked", 8);
+
+  Serial.println("ATOMIC,done");
+}
+
+void loop()
+{
+}
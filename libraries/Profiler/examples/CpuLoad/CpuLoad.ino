@@ -0,0 +1,51 @@
+/*
+  CpuLoad
+
+  Prints the CPU load of the last second via STM32.cpuLoad(), split into
+  loop (thread mode), idle, PendSV and the interrupt priority levels that
+  saw any use. loop() sleeps in between (LOOP_MODE_SLEEP), so idle is the
+  time spent in __WFE(). Lines start with "LOAD,".
+
+  This example code is in the public domain.
+*/
+
+#include <STM32.h>
+
+void setup()
+{
+  Serial.begin(9600);
+
+  while (!Serial) { }
+
+  STM32.beginCpuLoad(1000);
+
+  loopMode(LOOP_MODE_SLEEP, 1000);
+}
+
+void loop()
+{
+  unsigned int priority;
+  float load;
+
+  Serial.print("LOAD,total=");
+  Serial.print(STM32.cpuLoad(), 2);
+  Serial.print(",loop=");
+  Serial.print(STM32.cpuLoad(CPU_LOAD_LOOP), 2);
+  Serial.print(",idle=");
+  Serial.print(STM32.cpuLoad(CPU_LOAD_IDLE), 2);
+  Serial.print(",pendsv=");
+  Serial.print(STM32.cpuLoad(CPU_LOAD_PENDSV), 2);
+
+  for (priority = 0; priority < 16; priority++) {
+    load = STM32.cpuLoad(CPU_LOAD_PRIORITY(priority));
+
+    if (load != 0.0f) {
+      Serial.print(",priority");
+      Serial.print(priority);
+      Serial.print("=");
+      Serial.print(load, 2);
+    }
+  }
+
+  Serial.println();
+}
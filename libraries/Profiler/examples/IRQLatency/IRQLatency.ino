@@ -0,0 +1,96 @@
+/*
+  IRQLatency
+
+  Measures the worst case interrupt latency at the NVIC priorities the core
+  uses for its drivers, while generating synthetic load, and prints the
+  results every 5 seconds over Serial. Lines start with "LATENCY,".
+
+  Each probe borrows an interrupt vector that the sketch does not use and
+  runs at the priority of the driver it stands in for (these mirror the
+  STM32L4_*_IRQ_PRIORITY values in the core). Pin 2 pulses for the
+  duration of the SAI probe's latency, for a scope.
+
+  Uncomment the LOAD_* lines to add SD/flash streaming, USB CDC traffic
+  or I2C polling.
+
+  This example code is in the public domain.
+*/
+
+#include <Profiler.h>
+
+// #define LOAD_FS
+// #define LOAD_CDC
+// #define LOAD_I2C
+
+#if defined(LOAD_FS)
+#include <FS.h>
+File file;
+uint8_t buffer[4096];
+#endif
+
+#if defined(LOAD_I2C)
+#include <Wire.h>
+#endif
+
+void setup()
+{
+  Serial.begin(9600);
+
+  while (!Serial) { }
+
+  ProfilerLatency.add(LPTIM1_IRQn,  4, "EXTI", -1);
+  ProfilerLatency.add(COMP_IRQn,    9, "SAI",   2);
+  ProfilerLatency.add(LPTIM2_IRQn, 10, "UART", -1);
+  ProfilerLatency.add(TSC_IRQn,    11, "SPI",  -1);
+  ProfilerLatency.add(RCC_IRQn,    12, "I2C",  -1);
+  ProfilerLatency.add(FLASH_IRQn,  14, "USB",  -1);
+  ProfilerLatency.add(FPU_IRQn,    15, "PWM",  -1);
+
+  ProfilerLatency.begin(1);
+
+#if defined(LOAD_FS)
+  if (DOSFS.begin()) {
+    file = DOSFS.open("LATENCY.DAT", "w");
+  }
+#endif
+
+#if defined(LOAD_I2C)
+  Wire.begin();
+#endif
+}
+
+void loop()
+{
+  static uint32_t last = 0;
+
+#if defined(LOAD_FS)
+  if (file) {
+    file.write(buffer, sizeof(buffer));
+
+    if (file.size() >= (1024 * 1024)) {
+      file.seek(0);
+    }
+  }
+#endif
+
+#if defined(LOAD_CDC)
+  static const char text[] = "0123456789abcdef0123456789abcdef0123456789abcdef0123456789abcde\n";
+
+  SerialUSB.write((const uint8_t*)text, sizeof(text) -1);
+#endif
+
+#if defined(LOAD_I2C)
+  Wire.requestFrom(0x50, 16);
+
+  while (Wire.available()) {
+    Wire.read();
+  }
+#endif
+
+  if ((millis() - last) >= 5000) {
+    last = millis();
+
+    ProfilerLatency.report(Serial);
+    ProfilerLatency.reset();
+  }
+}
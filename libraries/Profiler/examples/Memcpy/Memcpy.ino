@@ -0,0 +1,115 @@
+/*
+  Memcpy
+
+  Compares the core's memcpy(), memmove() and memset() (armv7m_rtlib.S,
+  which replace the newlib-nano versions) against plain byte loops, for
+  a range of sizes and with aligned and misaligned buffers. Results are
+  printed once over Serial, in cycles per call. Lines start with "MEMCPY,".
+
+  This example code is in the public domain.
+*/
+
+#include <Profiler.h>
+
+#define ITERATIONS 32
+
+static uint8_t source[4096 + 4] __attribute__((aligned(4)));
+static uint8_t destination[4096 + 4] __attribute__((aligned(4)));
+
+static const uint32_t sizes[] = { 4, 16, 32, 64, 128, 512, 4096 };
+
+// Reference implementations. The optimize attribute keeps GCC from turning
+// the loops back into library calls.
+static void __attribute__((noinline, optimize("no-tree-loop-distribute-patterns"))) byte_copy(uint8_t *d, const uint8_t *s, uint32_t n)
+{
+  while (n--) {
+    *d++ = *s++;
+  }
+}
+
+static void __attribute__((noinline, optimize("no-tree-loop-distribute-patterns"))) byte_set(uint8_t *d, uint8_t c, uint32_t n)
+{
+  while (n--) {
+    *d++ = c;
+  }
+}
+
+static uint32_t measure(int function, uint8_t *d, uint8_t *s, uint32_t n)
+{
+  uint32_t start, cycles, best;
+  unsigned int i;
+
+  best = 0xffffffff;
+
+  for (i = 0; i < ITERATIONS; i++) {
+    start = Profiler.cycles();
+
+    switch (function) {
+    case 0: memcpy(d, s, n); break;
+    case 1: byte_copy(d, s, n); break;
+    case 2: memmove(d, s, n); break;
+    case 3: memset(d, 0x55, n); break;
+    case 4: byte_set(d, 0x55, n); break;
+    }
+
+    cycles = Profiler.cycles() - start;
+
+    if (best > cycles) {
+      best = cycles;
+    }
+  }
+
+  return best;
+}
+
+static void report(const char *name, int function, unsigned int d_offset, unsigned int s_offset)
+{
+  unsigned int i;
+
+  for (i = 0; i < (sizeof(sizes) / sizeof(sizes[0])); i++) {
+    Serial.print("MEMCPY,");
+    Serial.print(name);
+    Serial.print(",d+");
+    Serial.print(d_offset);
+    Serial.print(",s+");
+    Serial.print(s_offset);
+    Serial.print(",size=");
+    Serial.print(sizes[i]);
+    Serial.print(",cycles=");
+    Serial.println(measure(function, &destination[d_offset], &source[s_offset], sizes[i]));
+  }
+}
+
+void setup()
+{
+  unsigned int i;
+
+  Serial.begin(9600);
+
+  while (!Serial) { }
+
+  for (i = 0; i < sizeof(source); i++) {
+    source[i] = i;
+  }
+
+  Profiler.begin();
+
+  report("memcpy",    0, 0, 0);
+  report("memcpy",    0, 0, 1);
+  report("memcpy",    0, 3, 1);
+  report("byte_copy", 1, 0, 0);
+  report("memmove",   2, 0, 0);
+  report("memset",    3, 0, 0);
+  report("memset",    3, 1, 0);
+  report("byte_set",  4, 0, 0);
+
+  // memmove() with overlap, where it has to copy downwards
+  Serial.print("MEMCPY,memmove,overlap,size=4092,cycles=");
+  Serial.println(measure(2, &source[4], &source[0], 4092));
+
+  Serial.println("MEMCPY,done");
+}
+
+void loop()
+{
+}
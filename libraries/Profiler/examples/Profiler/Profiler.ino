@@ -0,0 +1,40 @@
+/*
+  Profiler
+
+  Times the SysTick and PendSV handlers plus a block of code in loop(),
+  and prints a snapshot every second over Serial. Lines start with
+  "PROFILE," so they can be filtered out of a capture.
+
+  This example code is in the public domain.
+*/
+
+#include <Profiler.h>
+
+void setup()
+{
+  Serial.begin(9600);
+
+  while (!Serial) { }
+
+  Profiler.begin();
+  Profiler.attach(SysTick_IRQn, "SysTick");
+  Profiler.attach(PendSV_IRQn, "PendSV");
+}
+
+void loop()
+{
+  static uint32_t last = 0;
+
+  {
+    PROFILER_SCOPE("analogRead");
+
+    analogRead(A0);
+  }
+
+  if ((millis() - last) >= 1000) {
+    last = millis();
+
+    Profiler.report(Serial);
+    Profiler.reset();
+  }
+}
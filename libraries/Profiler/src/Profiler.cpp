@@ -0,0 +1,527 @@
+/*
+ * Copyright (c) 2016 Thomas Roell.  All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal with the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ *  1. Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimers.
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimers in the
+ *     documentation and/or other materials provided with the distribution.
+ *  3. Neither the name of Thomas Roell, nor the names of its contributors
+ *     may be used to endorse or promote products derived from this Software
+ *     without specific prior written permission.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ * CONTRIBUTORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * WITH THE SOFTWARE.
+ */
+
+#include "Profiler.h"
+#include "stm32l4_nvic.h"
+
+extern uint32_t __StackTop[];
+
+// Entries 0 .. PROFILER_IRQ_COUNT-1 belong to attached interrupts, the rest
+// to probes.
+static ProfilerEntry _profilerEntries[PROFILER_IRQ_COUNT + PROFILER_PROBE_COUNT];
+
+// Maps an exception number (IRQn + 16) to 1 + the index of its entry.
+static uint8_t _profilerSlot[16 + 96];
+
+ProfilerClass::ProfilerClass()
+{
+    unsigned int index;
+
+    for (index = 0; index < PROFILER_IRQ_COUNT; index++) {
+	_irq[index] = -16;
+	_vector[index] = 0;
+    }
+
+    _probes = 0;
+    _start = 0;
+}
+
+void ProfilerClass::begin()
+{
+    CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+    DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+
+    reset();
+}
+
+void ProfilerClass::end()
+{
+    unsigned int index;
+
+    for (index = 0; index < PROFILER_IRQ_COUNT; index++) {
+	if (_irq[index] != -16) {
+	    detach((IRQn_Type)_irq[index]);
+	}
+    }
+}
+
+bool ProfilerClass::attach(IRQn_Type irq, const char *name)
+{
+    unsigned int index;
+
+    if (((int)irq < -15) || ((int)irq >= 96) || _profilerSlot[irq + 16]) {
+	return false;
+    }
+
+    for (index = 0; index < PROFILER_IRQ_COUNT; index++) {
+	if (_irq[index] == -16) {
+	    break;
+	}
+    }
+
+    if (index == PROFILER_IRQ_COUNT) {
+	return false;
+    }
+
+    _profilerEntries[index].name = name;
+    _clear(&_profilerEntries[index]);
+
+    _irq[index] = irq;
+
+    // The slot has to be in place before the first interrupt hits the trampoline,
+    // and the original vector has to be known before that as well.
+    _vector[index] = ((uint32_t*)SCB->VTOR)[irq + 16];
+    _profilerSlot[irq + 16] = index + 1;
+
+    __DSB();
+
+    _vector[index] = NVIC_CatchIRQ(irq, (uint32_t)&ProfilerClass::_interrupt);
+
+    return true;
+}
+
+void ProfilerClass::detach(IRQn_Type irq)
+{
+    unsigned int index;
+
+    if (((int)irq < -15) || ((int)irq >= 96) || !_profilerSlot[irq + 16]) {
+	return;
+    }
+
+    index = _profilerSlot[irq + 16] - 1;
+
+    NVIC_CatchIRQ(irq, _vector[index]);
+
+    _profilerSlot[irq + 16] = 0;
+    _irq[index] = -16;
+}
+
+int ProfilerClass::probe(const char *name)
+{
+    uint32_t basepri;
+    int id;
+
+    basepri = armv7m_critical_enter(PROFILER_CRITICAL_PRIORITY);
+
+    if (_probes == PROFILER_PROBE_COUNT) {
+	id = -1;
+    } else {
+	id = PROFILER_IRQ_COUNT + _probes++;
+
+	_profilerEntries[id].name = name;
+	_clear(&_profilerEntries[id]);
+    }
+
+    armv7m_critical_leave(basepri);
+
+    return id;
+}
+
+void ProfilerClass::record(int id, uint32_t cycles)
+{
+    uint32_t basepri;
+
+    if (id < 0) {
+	return;
+    }
+
+    basepri = armv7m_critical_enter(PROFILER_CRITICAL_PRIORITY);
+
+    _account(&_profilerEntries[id], cycles);
+
+    armv7m_critical_leave(basepri);
+}
+
+void ProfilerClass::reset()
+{
+    uint32_t basepri;
+    unsigned int index;
+
+    basepri = armv7m_critical_enter(PROFILER_CRITICAL_PRIORITY);
+
+    for (index = 0; index < (PROFILER_IRQ_COUNT + PROFILER_PROBE_COUNT); index++) {
+	_clear(&_profilerEntries[index]);
+    }
+
+    _start = DWT->CYCCNT;
+
+    armv7m_critical_leave(basepri);
+}
+
+unsigned int ProfilerClass::snapshot(ProfilerEntry *entries, unsigned int count, uint32_t *p_cycles)
+{
+    uint32_t basepri;
+    unsigned int index, n;
+
+    n = 0;
+
+    basepri = armv7m_critical_enter(PROFILER_CRITICAL_PRIORITY);
+
+    for (index = 0; (index < (PROFILER_IRQ_COUNT + PROFILER_PROBE_COUNT)) && (n < count); index++) {
+	if (((index < PROFILER_IRQ_COUNT) && (_irq[index] != -16)) ||
+	    ((index >= PROFILER_IRQ_COUNT) && ((index - PROFILER_IRQ_COUNT) < _probes))) {
+	    entries[n++] = _profilerEntries[index];
+	}
+    }
+
+    if (p_cycles) {
+	*p_cycles = DWT->CYCCNT - _start;
+    }
+
+    armv7m_critical_leave(basepri);
+
+    return n;
+}
+
+void ProfilerClass::report(Print &out)
+{
+    ProfilerEntry entries[PROFILER_IRQ_COUNT + PROFILER_PROBE_COUNT];
+    unsigned int index, count;
+    uint32_t cycles;
+
+    count = snapshot(entries, PROFILER_IRQ_COUNT + PROFILER_PROBE_COUNT, &cycles);
+
+    for (index = 0; index < count; index++) {
+	out.print("PROFILE,");
+	out.print(entries[index].name);
+	out.print(",count=");
+	out.print(entries[index].count);
+	out.print(",min=");
+	out.print(entries[index].count ? entries[index].min : 0);
+	out.print(",avg=");
+	out.print(entries[index].count ? (uint32_t)(entries[index].total / entries[index].count) : 0);
+	out.print(",max=");
+	out.print(entries[index].max);
+	out.print(",load=");
+	out.print(cycles ? ((float)entries[index].total * 100.0f / (float)cycles) : 0.0f, 2);
+	out.println("%");
+
+	if (entries[index].latency_max) {
+	    out.print("PROFILE,");
+	    out.print(entries[index].name);
+	    out.print(",latency,min=");
+	    out.print(entries[index].latency_min);
+	    out.print(",avg=");
+	    out.print((uint32_t)(entries[index].latency_total / entries[index].count));
+	    out.print(",max=");
+	    out.println(entries[index].latency_max);
+	}
+
+	if (entries[index].stack) {
+	    out.print("PROFILE,");
+	    out.print(entries[index].name);
+	    out.print(",stack=");
+	    out.println(entries[index].stack);
+	}
+    }
+
+    out.print("PROFILE,stack,size=");
+    out.print(STM32.stackSize());
+    out.print(",used=");
+    out.print(STM32.stackUsed());
+    out.print(",heap=");
+    out.print(STM32.heapUsed());
+    out.print(",peak=");
+    out.println(STM32.heapPeak());
+
+    out.print("PROFILE,total,cycles=");
+    out.print(cycles);
+    out.print(",us=");
+    out.println((uint32_t)(((uint64_t)cycles * 1000000) / SystemCoreClock));
+}
+
+void ProfilerClass::_clear(ProfilerEntry *entry)
+{
+    entry->count = 0;
+    entry->min = 0xffffffff;
+    entry->max = 0;
+    entry->total = 0;
+    entry->latency_min = 0xffffffff;
+    entry->stack = 0;
+    entry->latency_max = 0;
+    entry->latency_total = 0;
+}
+
+void ProfilerClass::_account(ProfilerEntry *entry, uint32_t cycles)
+{
+    entry->count++;
+    entry->total += cycles;
+
+    if (entry->min > cycles) {
+	entry->min = cycles;
+    }
+
+    if (entry->max < cycles) {
+	entry->max = cycles;
+    }
+}
+
+void ProfilerClass::_interrupt(void)
+{
+    ProfilerEntry *entry;
+    uint32_t start, latency, stack;
+    int index;
+
+    start = DWT->CYCCNT;
+
+    index = _profilerSlot[__get_IPSR() & 0x1ff] - 1;
+
+    if (index < 0) {
+	return;
+    }
+
+    entry = &_profilerEntries[index];
+
+    stack = (uint32_t)&__StackTop[0] - __get_MSP();
+
+    if (entry->stack < stack) {
+	entry->stack = stack;
+    }
+
+    if ((int)Profiler._irq[index] == (int)SysTick_IRQn) {
+	// SysTick counts down from LOAD at the processor clock, so this is the time
+	// since the tick became pending.
+	latency = SysTick->LOAD - SysTick->VAL;
+
+	entry->latency_total += latency;
+
+	if (entry->latency_min > latency) {
+	    entry->latency_min = latency;
+	}
+
+	if (entry->latency_max < latency) {
+	    entry->latency_max = latency;
+	}
+    }
+
+    (*(void (*)(void))Profiler._vector[index])();
+
+    // The entry for a given IRQ is only ever updated from its own handler, which
+    // cannot nest, so there is no need to mask interrupts here.
+    _account(entry, DWT->CYCCNT - start);
+}
+
+ProfilerClass Profiler;
+
+ProfilerLatencyClass::ProfilerLatencyClass()
+{
+    _vector = 0;
+    _pended = 0;
+    _interval = 1;
+    _ticks = 0;
+    _count = 0;
+}
+
+bool ProfilerLatencyClass::begin(unsigned int interval)
+{
+    if (_vector) {
+	return false;
+    }
+
+    CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+    DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+
+    _interval = interval ? interval : 1;
+    _ticks = 0;
+
+    reset();
+
+    _vector = ((uint32_t*)SCB->VTOR)[SysTick_IRQn + 16];
+
+    __DSB();
+
+    _vector = NVIC_CatchIRQ(SysTick_IRQn, (uint32_t)&ProfilerLatencyClass::_trigger);
+
+    return true;
+}
+
+void ProfilerLatencyClass::end()
+{
+    unsigned int index;
+
+    if (!_vector) {
+	return;
+    }
+
+    NVIC_CatchIRQ(SysTick_IRQn, _vector);
+
+    _vector = 0;
+
+    for (index = 0; index < _count; index++) {
+	NVIC_DisableIRQ(_irq[index]);
+    }
+}
+
+bool ProfilerLatencyClass::add(IRQn_Type irq, unsigned int priority, const char *name, int pin)
+{
+    unsigned int index;
+
+    if ((_count == PROFILER_LATENCY_COUNT) || ((int)irq < 0) || (priority < PROFILER_CRITICAL_PRIORITY)) {
+	return false;
+    }
+
+    index = _count;
+
+    _irq[index] = irq;
+    _priority[index] = priority;
+    _pin[index] = ((pin >= 0) && g_APinDescription[pin].bit) ? pin : -1;
+    _missed[index] = 0;
+    _entries[index].name = name;
+
+    if (_pin[index] >= 0) {
+	pinMode(pin, OUTPUT);
+	digitalWrite(pin, LOW);
+    }
+
+    NVIC_DisableIRQ(irq);
+    NVIC_CatchIRQ(irq, (uint32_t)&ProfilerLatencyClass::_interrupt);
+    NVIC_SetPriority(irq, priority);
+    NVIC_ClearPendingIRQ(irq);
+
+    __DSB();
+
+    _count = index + 1;
+
+    NVIC_EnableIRQ(irq);
+
+    return true;
+}
+
+void ProfilerLatencyClass::reset()
+{
+    uint32_t basepri;
+    unsigned int index;
+
+    basepri = armv7m_critical_enter(PROFILER_CRITICAL_PRIORITY);
+
+    for (index = 0; index < PROFILER_LATENCY_COUNT; index++) {
+	_missed[index] = 0;
+	ProfilerClass::_clear(&_entries[index]);
+    }
+
+    armv7m_critical_leave(basepri);
+}
+
+void ProfilerLatencyClass::report(Print &out)
+{
+    ProfilerEntry entries[PROFILER_LATENCY_COUNT];
+    uint32_t missed[PROFILER_LATENCY_COUNT];
+    uint32_t basepri;
+    unsigned int index, count;
+
+    basepri = armv7m_critical_enter(PROFILER_CRITICAL_PRIORITY);
+
+    count = _count;
+
+    for (index = 0; index < count; index++) {
+	entries[index] = _entries[index];
+	missed[index] = _missed[index];
+    }
+
+    armv7m_critical_leave(basepri);
+
+    for (index = 0; index < count; index++) {
+	out.print("LATENCY,");
+	out.print(entries[index].name);
+	out.print(",priority=");
+	out.print(_priority[index]);
+	out.print(",count=");
+	out.print(entries[index].count);
+	out.print(",missed=");
+	out.print(missed[index]);
+	out.print(",min=");
+	out.print(entries[index].count ? entries[index].min : 0);
+	out.print(",avg=");
+	out.print(entries[index].count ? (uint32_t)(entries[index].total / entries[index].count) : 0);
+	out.print(",max=");
+	out.print(entries[index].max);
+	out.print(",max_us=");
+	out.println(((float)entries[index].max * 1000000.0f) / (float)SystemCoreClock, 2);
+    }
+}
+
+void ProfilerLatencyClass::_trigger(void)
+{
+    ProfilerLatencyClass *self = &ProfilerLatency;
+    unsigned int index;
+    int pin;
+
+    (*(void (*)(void))self->_vector)();
+
+    if (++self->_ticks < self->_interval) {
+	return;
+    }
+
+    self->_ticks = 0;
+
+    for (index = 0; index < self->_count; index++) {
+	if (NVIC_GetPendingIRQ(self->_irq[index])) {
+	    self->_missed[index]++;
+	}
+    }
+
+    self->_pended = DWT->CYCCNT;
+
+    for (index = 0; index < self->_count; index++) {
+	pin = self->_pin[index];
+
+	if (pin >= 0) {
+	    PIN_DESCRIPTION_PORT(g_APinDescription[pin].pin)->BSRR = g_APinDescription[pin].bit;
+	}
+
+	NVIC_SetPendingIRQ(self->_irq[index]);
+    }
+}
+
+void ProfilerLatencyClass::_interrupt(void)
+{
+    ProfilerLatencyClass *self = &ProfilerLatency;
+    uint32_t latency;
+    unsigned int index;
+    int irq, pin;
+
+    latency = DWT->CYCCNT - self->_pended;
+
+    irq = (int)(__get_IPSR() & 0x1ff) - 16;
+
+    for (index = 0; index < self->_count; index++) {
+	if ((int)self->_irq[index] == irq) {
+	    pin = self->_pin[index];
+
+	    if (pin >= 0) {
+		PIN_DESCRIPTION_PORT(g_APinDescription[pin].pin)->BRR = g_APinDescription[pin].bit;
+	    }
+
+	    ProfilerClass::_account(&self->_entries[index], latency);
+
+	    break;
+	}
+    }
+}
+
+ProfilerLatencyClass ProfilerLatency;
@@ -0,0 +1,190 @@
+/*
+ * Copyright (c) 2016 Thomas Roell.  All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal with the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ *  1. Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimers.
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimers in the
+ *     documentation and/or other materials provided with the distribution.
+ *  3. Neither the name of Thomas Roell, nor the names of its contributors
+ *     may be used to endorse or promote products derived from this Software
+ *     without specific prior written permission.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ * CONTRIBUTORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * WITH THE SOFTWARE.
+ */
+
+#ifndef _PROFILER_H_INCLUDED
+#define _PROFILER_H_INCLUDED
+
+#include <Arduino.h>
+
+// Number of interrupt handlers that can be hooked, and of user probes.
+#define PROFILER_IRQ_COUNT   12
+#define PROFILER_PROBE_COUNT 16
+
+// Priority ceiling of the bookkeeping: the most urgent priority of an
+// attached handler, a latency probe or a record() caller. The default is
+// that of SERVO, the most urgent one the core uses. Entries updated at a
+// more urgent priority (i.e. 0) may be read torn.
+#ifndef PROFILER_CRITICAL_PRIORITY
+#define PROFILER_CRITICAL_PRIORITY 1
+#endif
+
+// Accumulated cycle counts for one interrupt handler or probe. "count" is
+// the number of invocations, "total/min/max" the cycles spent inside. For
+// SysTick, "latency_*" hold the cycles from the tick (pending) to handler
+// entry; for other sources the pending time is not visible to software,
+// so those stay 0. "stack" is the deepest main stack use (bytes below
+// __StackTop) seen at handler entry, i.e. what preempted code and nested
+// handlers had piled up when it ran; it is 0 for probes.
+struct ProfilerEntry {
+    const char *name;
+    uint32_t   count;
+    uint32_t   min;
+    uint32_t   max;
+    uint64_t   total;
+    uint32_t   latency_min;
+    uint32_t   latency_max;
+    uint64_t   latency_total;
+    uint32_t   stack;
+};
+
+// Cycle accurate profiling based on the DWT cycle counter.
+//
+// attach() swaps an interrupt vector (through NVIC_CatchIRQ(), i.e. in the
+// SRAM vector table) for a trampoline that times the original handler.
+// Times are inclusive, so a handler preempted by a higher priority one is
+// charged for that as well.
+//
+// User probes are timed with PROFILER_SCOPE("name") at the start of a
+// block, or by hand via probe()/record().
+//
+// report() prints a snapshot in a line oriented, comma separated format
+// to any Print (Serial, SerialUSB, ...):
+//
+//   PROFILE,<name>,count=<n>,min=<cycles>,avg=<cycles>,max=<cycles>,load=<n.nn>%
+//   PROFILE,<name>,latency,min=<cycles>,avg=<cycles>,max=<cycles>
+//   PROFILE,<name>,stack=<bytes>
+//   PROFILE,stack,size=<bytes>,used=<bytes>,heap=<bytes>,peak=<bytes>
+//   PROFILE,total,cycles=<n>,us=<n>
+class ProfilerClass
+{
+public:
+    ProfilerClass();
+
+    void begin();
+    void end();
+
+    bool attach(IRQn_Type irq, const char *name);
+    void detach(IRQn_Type irq);
+
+    int probe(const char *name);
+    void record(int id, uint32_t cycles);
+
+    void reset();
+    unsigned int snapshot(ProfilerEntry *entries, unsigned int count, uint32_t *p_cycles = NULL);
+    void report(Print &out);
+
+    static inline uint32_t cycles() { return DWT->CYCCNT; }
+
+private:
+    uint32_t _start;
+    uint32_t _vector[PROFILER_IRQ_COUNT];
+    int16_t _irq[PROFILER_IRQ_COUNT];
+    unsigned int _probes;
+
+    static void _interrupt(void);
+    static void _clear(ProfilerEntry *entry);
+    static void _account(ProfilerEntry *entry, uint32_t cycles);
+
+    friend class ProfilerScope;
+    friend class ProfilerLatencyClass;
+};
+
+extern ProfilerClass Profiler;
+
+class ProfilerScope
+{
+public:
+    inline ProfilerScope(int id) : _id(id), _start(DWT->CYCCNT) { }
+    inline ~ProfilerScope() { Profiler.record(_id, DWT->CYCCNT - _start); }
+
+private:
+    int      _id;
+    uint32_t _start;
+};
+
+#define PROFILER_CONCAT_2(_a,_b) _a ## _b
+#define PROFILER_CONCAT(_a,_b)   PROFILER_CONCAT_2(_a,_b)
+
+#define PROFILER_SCOPE(_name)                                                                  \
+    static int PROFILER_CONCAT(__profiler_id_, __LINE__) = Profiler.probe(_name);             \
+    ProfilerScope PROFILER_CONCAT(__profiler_scope_, __LINE__)(PROFILER_CONCAT(__profiler_id_, __LINE__))
+
+// Number of latency probes.
+#define PROFILER_LATENCY_COUNT 8
+
+// Interrupt latency harness.
+//
+// Each probe owns a spare interrupt vector (one the sketch does not use,
+// like COMP_IRQn, LPTIM2_IRQn or TSC_IRQn) and runs at the NVIC priority
+// of the driver it stands in for. Every "interval" milliseconds the SysTick
+// handler pends all probes at once. Each probe then records the cycles
+// from that moment to its own entry. Whatever load the sketch generates
+// (SD streaming, USB CDC traffic, I2C polling, ...) shows up as extra
+// latency at the priorities it interferes with.
+//
+// add() refuses a "priority" more urgent than PROFILER_CRITICAL_PRIORITY.
+//
+// If a "pin" is given, it is driven high when the probe is pended and low
+// on entry, so the latency can also be checked with a scope. A probe still
+// pending at the next trigger counts as "missed".
+//
+// report() prints, per probe:
+//
+//   LATENCY,<name>,priority=<n>,count=<n>,missed=<n>,min=<cycles>,avg=<cycles>,max=<cycles>,max_us=<n.nn>
+class ProfilerLatencyClass
+{
+public:
+    ProfilerLatencyClass();
+
+    bool begin(unsigned int interval = 1);
+    void end();
+
+    bool add(IRQn_Type irq, unsigned int priority, const char *name, int pin = -1);
+
+    void reset();
+    void report(Print &out);
+
+private:
+    uint32_t _vector;
+    uint32_t _pended;
+    uint32_t _interval;
+    uint32_t _ticks;
+    unsigned int _count;
+    IRQn_Type _irq[PROFILER_LATENCY_COUNT];
+    uint8_t _priority[PROFILER_LATENCY_COUNT];
+    int8_t _pin[PROFILER_LATENCY_COUNT];
+    uint32_t _missed[PROFILER_LATENCY_COUNT];
+    ProfilerEntry _entries[PROFILER_LATENCY_COUNT];
+
+    static void _trigger(void);
+    static void _interrupt(void);
+};
+
+extern ProfilerLatencyClass ProfilerLatency;
+
+#endif // _PROFILER_H_INCLUDED
@@ -0,0 +1,48 @@
+/*
+  PeriodicWakeup
+
+  Samples an analog input every 100ms while the CPU spends the rest of
+  the time in STOP2. The periodic callback only takes the sample, and
+  wakes up loop() when the value changed by more than THRESHOLD, which
+  then prints it over Serial1. Lines start with "PERIODIC,".
+
+  This example code is in the public domain.
+*/
+
+#include <RTC.h>
+
+#define THRESHOLD 64
+
+volatile int sample = 0;
+int last = -THRESHOLD;
+
+void sense()
+{
+  sample = analogRead(A0);
+
+  if (abs(sample - last) > THRESHOLD) {
+    loopWakeup();
+  }
+}
+
+void setup()
+{
+  Serial1.begin(9600);
+
+  RTC.attachPeriodic(100, sense);
+
+  loopMode(LOOP_MODE_STOP, 0);
+}
+
+void loop()
+{
+  if (abs(sample - last) > THRESHOLD) {
+    last = sample;
+
+    Serial1.print("PERIODIC,millis=");
+    Serial1.print(millis());
+    Serial1.print(",value=");
+    Serial1.println(last);
+    Serial1.flush();
+  }
+}
@@ -34,6 +34,15 @@
 #define EPOCH_TIME_OFF      946684800  // This is 1st January 2000, 00:00:00 in epoch time
 #define EPOCH_TIME_YEAR_OFF 100        // years since 1900
 
+#define RTC_TICK_MICROS     3906       // 1/256 second, the resolution of SSR
+#define RTC_EDGE_MICROS     50         // an RTC tick seen that soon after the previous read is an anchor
+
+// RTC ticks (1/32768 second) to microseconds.
+static inline uint64_t RTCClockMicros(uint64_t clock)
+{
+    return (clock * 15625) >> 9;
+}
+
 void RTCClass::enableAlarm(AlarmMatch match)
 {
     if (!_alarm_init) {
@@ -374,6 +383,72 @@ uint16_t RTCClass::getTicks()
     return stm32l4_rtc_get_ticks();
 }
 
+uint64_t RTCClass::getEpochMillis()
+{
+    return ((uint64_t)EPOCH_TIME_OFF * 1000) + ((stm32l4_rtc_get_clock() * 1000) >> 15);
+}
+
+uint64_t RTCClass::getEpochMicros()
+{
+    uint64_t clock, now, micros;
+    uint32_t primask;
+
+    primask = __get_PRIMASK();
+
+    __disable_irq();
+
+    clock = RTCClockMicros(stm32l4_rtc_get_clock());
+    now = armv7m_systick_micros();
+
+    // micros() runs from the system clock, the RTC from LSE. The mapping between both is
+    // anchored at an RTC tick whenever one is caught between two close reads, and pulled
+    // back into the current 1/256 second otherwise (which also covers STOP mode, where
+    // micros() is only advanced in milliseconds).
+    if (!_micros_init) {
+	_micros_init = 1;
+	_micros_clock = clock;
+	_micros_base = now;
+    } else if ((clock != _micros_last_clock) && ((now - _micros_last) <= RTC_EDGE_MICROS)) {
+	_micros_clock = clock;
+	_micros_base = now;
+    }
+
+    _micros_last_clock = clock;
+    _micros_last = now;
+
+    micros = _micros_clock + (now - _micros_base);
+
+    if (micros < clock) {
+	_micros_clock = clock;
+	_micros_base = now;
+
+	micros = clock;
+    } else if (micros >= (clock + RTC_TICK_MICROS)) {
+	_micros_clock = clock + RTC_TICK_MICROS -1;
+	_micros_base = now;
+
+	micros = _micros_clock;
+    }
+
+    __set_PRIMASK(primask);
+
+    return ((uint64_t)EPOCH_TIME_OFF * 1000000) + micros;
+}
+
+void RTCClass::syncMicros()
+{
+    uint64_t clock;
+
+    clock = stm32l4_rtc_get_clock();
+
+    // Back to back reads, so that the one after the tick anchors the mapping.
+    do {
+	getEpochMicros();
+    } while (stm32l4_rtc_get_clock() == clock);
+
+    getEpochMicros();
+}
+
 int32_t RTCClass::getCalibration()
 {
     return stm32l4_rtc_get_calibration();
@@ -466,6 +541,40 @@ void RTCClass::write(unsigned int index, uint32_t data)
     stm32l4_rtc_write_backup(index, data);
 }
 
+int RTCClass::attachPeriodic(uint32_t period, void(*callback)(void))
+{
+    unsigned int slot;
+
+    if (!period || !callback) {
+	return -1;
+    }
+
+    for (slot = 0; slot < RTC_PERIODIC_COUNT; slot++) {
+	if (!_periodic[slot].callback) {
+	    _periodic[slot].period = period;
+	    _periodic[slot].callback = callback;
+
+	    armv7m_timer_create(&_periodic[slot].timer, RTCClass::_periodicCallback);
+	    armv7m_timer_start(&_periodic[slot].timer, period);
+
+	    return slot;
+	}
+    }
+
+    return -1;
+}
+
+void RTCClass::detachPeriodic(int slot)
+{
+    if ((slot < 0) || (slot >= RTC_PERIODIC_COUNT) || !_periodic[slot].callback) {
+	return;
+    }
+
+    armv7m_timer_stop(&_periodic[slot].timer);
+
+    _periodic[slot].callback = NULL;
+}
+
 void RTCClass::InitAlarm()
 {
     stm32l4_rtc_alarm_t rtc_alarm;
@@ -517,4 +626,21 @@ void RTCClass::_syncCallback(void *context)
     }
 }
 
+/* Restarting from the callback keeps the period exact, as the timer fires on the tick
+ * its deadline matches.
+ */
+void RTCClass::_periodicCallback(armv7m_timer_t *timer)
+{
+    struct Periodic *periodic = reinterpret_cast<struct Periodic*>(timer);
+    void (*callback)(void);
+
+    callback = periodic->callback;
+
+    if (callback) {
+	armv7m_timer_start(&periodic->timer, periodic->period);
+
+	(*callback)();
+    }
+}
+
 RTCClass RTC;
@@ -31,6 +31,9 @@
 
 #include "Arduino.h"
 
+// Number of periodic callbacks attachPeriodic() can hold.
+#define RTC_PERIODIC_COUNT 4
+
 class RTCClass {
 public:
 
@@ -99,6 +102,14 @@ public:
     // STM32L4 EXTENSION: ticks [0..32767]
     uint16_t getTicks();
 
+    // STM32L4 EXTENSION: epoch in milliseconds, at the 1/256 second resolution of getTicks()
+    uint64_t getEpochMillis();
+
+    // STM32L4 EXTENSION: epoch in microseconds, interpolated between RTC ticks by micros(). syncMicros()
+    // waits (up to 1/256 second) for the next RTC tick to align both precisely.
+    uint64_t getEpochMicros();
+    void syncMicros();
+
     // STM32L4 EXTENSION: clock calibration [-511..512]
     int32_t getCalibration();
     void setCalibration(int32_t calibration);
@@ -123,6 +134,14 @@ public:
     uint32_t read(unsigned int idx);
     void write(unsigned int idx, uint32_t val);
 
+    // STM32L4 EXTENSION: periodic callbacks, "period" in milliseconds. attachPeriodic()
+    // returns the slot to pass to detachPeriodic(), or -1 if all are in use. Callbacks
+    // run from interrupt context, and call loopWakeup() if loop() has to follow up.
+    // With LOOP_MODE_STOP (or STM32.stop()) the RTC wakeup timer brings the CPU out
+    // of STOP2 for the next one, so nothing but the RTC runs in between.
+    int attachPeriodic(uint32_t period, void(*callback)(void));
+    void detachPeriodic(int slot);
+
 private:
     uint8_t _alarm_init;
     uint8_t _alarm_enable;
@@ -148,6 +167,22 @@ private:
 
     static void _syncCallback(void *context);
 
+    uint8_t _micros_init;
+    uint64_t _micros_clock;
+    uint64_t _micros_base;
+    uint64_t _micros_last_clock;
+    uint64_t _micros_last;
+
+    struct Periodic {
+	armv7m_timer_t timer;   // first, so that the timer callback finds its Periodic
+	uint32_t period;
+	void (*callback)(void);
+    };
+
+    Periodic _periodic[RTC_PERIODIC_COUNT];
+
+    static void _periodicCallback(armv7m_timer_t *timer);
+
     friend class RTCZero;
 };
 
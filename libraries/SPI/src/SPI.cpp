@@ -56,11 +56,27 @@ SPIClass::SPIClass(struct _stm32l4_spi_t *spi, unsigned int instance, const stru
 
     _interruptMask = 0;
 
+    _dmaThreshold = 0;
+
+    if ((spi->mode & (SPI_MODE_RX_DMA | SPI_MODE_TX_DMA)) == (SPI_MODE_RX_DMA | SPI_MODE_TX_DMA)) {
+	_dmaThreshold = SPI_DMA_THRESHOLD;
+    }
+
     _exchangeRoutine = SPIClass::_exchangeSelect;
     _exchange8Routine = SPIClass::_exchange8Select;
     _exchange16Routine = SPIClass::_exchange16Select;
 
     _completionCallback = NULL;
+
+    _queueTransactions = NULL;
+    _queueCount = 0;
+    _queueIndex = 0;
+
+    _slave = false;
+    _slavePin = 0;
+    _slaveSize = 0;
+    _slaveOffset = 0;
+    _slaveCallback = NULL;
 }
 
 void SPIClass::begin()
@@ -70,6 +86,8 @@ void SPIClass::begin()
 
 void SPIClass::end()
 {
+    endSlave();
+
     if (_selected) {
 	stm32l4_spi_unselect(_spi);
 
@@ -122,7 +140,7 @@ void SPIClass::beginTransaction(SPISettings settings)
     } else {
 	_selected = true;
 
-	_exchangeRoutine = stm32l4_spi_exchange;
+	_exchangeRoutine = (_dmaThreshold ? SPIClass::_exchangeDMA : stm32l4_spi_exchange);
 	_exchange8Routine = stm32l4_spi_exchange8;
 	_exchange16Routine = stm32l4_spi_exchange16;
     
@@ -199,6 +217,19 @@ void SPIClass::setClockDividerReference(uint32_t clock)
     _reference = clock;
 }
 
+void SPIClass::setDMAThreshold(size_t count)
+{
+    if ((_spi->mode & (SPI_MODE_RX_DMA | SPI_MODE_TX_DMA)) != (SPI_MODE_RX_DMA | SPI_MODE_TX_DMA)) {
+	count = 0;
+    }
+
+    _dmaThreshold = count;
+
+    if (_selected) {
+	_exchangeRoutine = (_dmaThreshold ? SPIClass::_exchangeDMA : stm32l4_spi_exchange);
+    }
+}
+
 void SPIClass::attachInterrupt()
 {
   // Should be enableInterrupt()
@@ -234,7 +265,7 @@ bool SPIClass::transfer(const void *txBuffer, void *rxBuffer, size_t count, void
 
 	_selected = true;
 
-	_exchangeRoutine = stm32l4_spi_exchange;
+	_exchangeRoutine = (_dmaThreshold ? SPIClass::_exchangeDMA : stm32l4_spi_exchange);
 	_exchange8Routine = stm32l4_spi_exchange8;
 	_exchange16Routine = stm32l4_spi_exchange16;
     
@@ -267,6 +298,133 @@ bool SPIClass::transfer(const void *txBuffer, void *rxBuffer, size_t count, void
     return true;
 }
 
+void SPIClass::transferFrames(const uint16_t *txBuffer, uint16_t *rxBuffer, size_t count, unsigned int bits)
+{
+    if (!_selected) {
+	uint32_t option, clock, divide;
+
+	option = _dataMode | ((_bitOrder == MSBFIRST) ? SPI_OPTION_MSB_FIRST : SPI_OPTION_LSB_FIRST);
+
+	clock = stm32l4_spi_clock(_spi) / 2;
+	divide = 0;
+
+	while ((clock > _clock) && (divide < 7)) {
+	    clock /= 2;
+	    divide++;
+	}
+
+	option |= (divide << SPI_OPTION_DIV_SHIFT);
+
+	stm32l4_spi_select(_spi, option);
+
+	_selected = true;
+
+	_exchangeRoutine = (_dmaThreshold ? SPIClass::_exchangeDMA : stm32l4_spi_exchange);
+	_exchange8Routine = stm32l4_spi_exchange8;
+	_exchange16Routine = stm32l4_spi_exchange16;
+    }
+
+    /* Same rules as _exchangeDMA(), with the threshold in bytes.
+     */
+    if (_dmaThreshold && ((count * 2) >= _dmaThreshold) && (count <= 65535) && (armv7m_core_priority() > STM32L4_SPI_IRQ_PRIORITY)) {
+	if (stm32l4_spi_transfer_frames(_spi, txBuffer, rxBuffer, count, bits)) {
+	    while (!stm32l4_spi_done(_spi)) {
+		armv7m_core_yield();
+	    }
+
+	    return;
+	}
+    }
+
+    stm32l4_spi_exchange_frames(_spi, txBuffer, rxBuffer, count, bits);
+}
+
+bool SPIClass::transfer(const SPITransaction *transactions, size_t count, void(*callback)(void))
+{
+    uint32_t option;
+
+    if (!count || !stm32l4_spi_done(_spi)) {
+	return false;
+    }
+
+    option = settingsOption(transactions[0].settings);
+
+    if (!_selected) {
+	stm32l4_spi_select(_spi, option);
+
+	_selected = true;
+
+	_exchangeRoutine = (_dmaThreshold ? SPIClass::_exchangeDMA : stm32l4_spi_exchange);
+	_exchange8Routine = stm32l4_spi_exchange8;
+	_exchange16Routine = stm32l4_spi_exchange16;
+    }
+
+    _completionCallback = callback;
+
+    _queueTransactions = transactions;
+    _queueCount = count;
+    _queueIndex = 0;
+
+    if (!queueStart()) {
+	_queueTransactions = NULL;
+	_completionCallback = NULL;
+
+	return false;
+    }
+
+    return true;
+}
+
+uint32_t SPIClass::settingsOption(const SPISettings &settings)
+{
+    uint32_t option, clock, divide;
+
+    option = settings._dataMode | ((settings._bitOrder == MSBFIRST) ? SPI_OPTION_MSB_FIRST : SPI_OPTION_LSB_FIRST);
+
+    clock = stm32l4_spi_clock(_spi) / 2;
+    divide = 0;
+
+    while ((clock > settings._clock) && (divide < 7)) {
+	clock /= 2;
+	divide++;
+    }
+
+    return option | (divide << SPI_OPTION_DIV_SHIFT);
+}
+
+bool SPIClass::queueStart(void)
+{
+    const SPITransaction *transaction = &_queueTransactions[_queueIndex];
+    uint32_t option;
+    bool success;
+
+    /* The SPI port only needs to be touched if the settings differ from the previous transaction.
+     */
+    option = settingsOption(transaction->settings);
+
+    if (option != _spi->option) {
+	stm32l4_spi_configure(_spi, option);
+    }
+
+    digitalWrite(transaction->pin, LOW);
+
+    if (transaction->rxBuffer) {
+	if (transaction->txBuffer) {
+	    success = stm32l4_spi_transfer(_spi, static_cast<const uint8_t*>(transaction->txBuffer), static_cast<uint8_t*>(transaction->rxBuffer), transaction->count, 0);
+	} else {
+	    success = stm32l4_spi_receive(_spi, static_cast<uint8_t*>(transaction->rxBuffer), transaction->count, 0);
+	}
+    } else {
+	success = stm32l4_spi_transmit(_spi, static_cast<const uint8_t*>(transaction->txBuffer), transaction->count, 0);
+    }
+
+    if (!success) {
+	digitalWrite(transaction->pin, HIGH);
+    }
+
+    return success;
+}
+
 void SPIClass::flush(void)
 {
     if (armv7m_core_priority() <= STM32L4_SPI_IRQ_PRIORITY) {
@@ -289,6 +447,75 @@ bool SPIClass::isEnabled(void)
 {
     return (_spi->state >= SPI_STATE_READY);
 }
+
+bool SPIClass::beginSlave(uint32_t pin, uint8_t dataMode, void *rxBuffer, const void *txBuffer, size_t size, void(*callback)(size_t offset, size_t count))
+{
+    if ((pin >= PINS_COUNT) || !(g_APinDescription[pin].attr & PIN_ATTR_EXTI)) {
+	return false;
+    }
+
+    if (_slave || _selected || !rxBuffer || (size == 0) || (size > 65535)) {
+	return false;
+    }
+
+    _slavePin = pin;
+    _slaveSize = size;
+    _slaveOffset = 0;
+    _slaveCallback = callback;
+
+    if (!stm32l4_spi_slave(_spi, (dataMode & SPI_OPTION_MODE_MASK), g_APinDescription[pin].pin, static_cast<uint8_t*>(rxBuffer), static_cast<const uint8_t*>(txBuffer), size)) {
+	_slaveCallback = NULL;
+
+	return false;
+    }
+
+    _slave = true;
+
+    stm32l4_exti_notify(&stm32l4_exti, g_APinDescription[pin].pin, EXTI_CONTROL_RISING_EDGE, SPIClass::_slaveNotify, (void*)this);
+
+    return true;
+}
+
+void SPIClass::endSlave(void)
+{
+    if (!_slave) {
+	return;
+    }
+
+    stm32l4_exti_notify(&stm32l4_exti, g_APinDescription[_slavePin].pin, EXTI_CONTROL_DISABLE, NULL, NULL);
+
+    stm32l4_spi_slave(_spi, 0, GPIO_PIN_NONE, NULL, NULL, 0);
+
+    _slave = false;
+    _slaveCallback = NULL;
+}
+
+size_t SPIClass::slaveOffset(void)
+{
+    return stm32l4_spi_slave_offset(_spi);
+}
+
+void SPIClass::_slaveNotify(void *context)
+{
+    SPIClass *spi_class = reinterpret_cast<class SPIClass*>(context);
+    size_t offset, count;
+
+    offset = stm32l4_spi_slave_offset(spi_class->_spi);
+
+    if (offset >= spi_class->_slaveOffset) {
+	count = offset - spi_class->_slaveOffset;
+    } else {
+	count = offset + spi_class->_slaveSize - spi_class->_slaveOffset;
+    }
+
+    if (count) {
+	if (spi_class->_slaveCallback) {
+	    (*spi_class->_slaveCallback)(spi_class->_slaveOffset, count);
+	}
+
+	spi_class->_slaveOffset = offset;
+    }
+}
     
 void SPIClass::_exchangeSelect(struct _stm32l4_spi_t *spi, const uint8_t *txData, uint8_t *rxData, size_t count) 
 {
@@ -311,13 +538,51 @@ void SPIClass::_exchangeSelect(struct _stm32l4_spi_t *spi, const uint8_t *txData
 
     spi_class->_selected = true;
 
-    spi_class->_exchangeRoutine = stm32l4_spi_exchange;
+    spi_class->_exchangeRoutine = (spi_class->_dmaThreshold ? SPIClass::_exchangeDMA : stm32l4_spi_exchange);
     spi_class->_exchange8Routine = stm32l4_spi_exchange8;
     spi_class->_exchange16Routine = stm32l4_spi_exchange16;
 
     return (*spi_class->_exchangeRoutine)(spi, txData, rxData, count);
 }
 
+__optimize_speed void SPIClass::_exchangeDMA(struct _stm32l4_spi_t *spi, const uint8_t *txData, uint8_t *rxData, size_t count) 
+{
+    SPIClass *spi_class = reinterpret_cast<class SPIClass*>(spi->context);
+    bool success;
+
+    /* Below the threshold the setup cost of DMA is not worth it. If the caller runs at or above the
+     * SPI interrupt priority, the completion would never be seen, so stay with the polled path as well.
+     */
+    if ((count < spi_class->_dmaThreshold) || (armv7m_core_priority() <= STM32L4_SPI_IRQ_PRIORITY)) {
+	stm32l4_spi_exchange(spi, txData, rxData, count);
+
+	return;
+    }
+
+    if (rxData) {
+	if (txData) {
+	    success = stm32l4_spi_transfer(spi, txData, rxData, count, 0);
+	} else {
+	    success = stm32l4_spi_receive(spi, rxData, count, 0);
+	}
+    } else {
+	success = stm32l4_spi_transmit(spi, txData, count, 0);
+    }
+
+    if (!success) {
+	stm32l4_spi_exchange(spi, txData, rxData, count);
+
+	return;
+    }
+
+    /* The completion interrupt sets the event register on exception return, so there is no
+     * race between the check and the WFE in armv7m_core_yield().
+     */
+    while (!stm32l4_spi_done(spi)) {
+	armv7m_core_yield();
+    }
+}
+
 uint8_t SPIClass::_exchange8Select(struct _stm32l4_spi_t *spi, uint8_t data)
 {
     SPIClass *spi_class = reinterpret_cast<class SPIClass*>(spi->context);
@@ -339,7 +604,7 @@ uint8_t SPIClass::_exchange8Select(struct _stm32l4_spi_t *spi, uint8_t data)
 
     spi_class->_selected = true;
 
-    spi_class->_exchangeRoutine = stm32l4_spi_exchange;
+    spi_class->_exchangeRoutine = (spi_class->_dmaThreshold ? SPIClass::_exchangeDMA : stm32l4_spi_exchange);
     spi_class->_exchange8Routine = stm32l4_spi_exchange8;
     spi_class->_exchange16Routine = stm32l4_spi_exchange16;
 
@@ -367,7 +632,7 @@ uint16_t SPIClass::_exchange16Select(struct _stm32l4_spi_t *spi, uint16_t data)
 
     spi_class->_selected = true;
 
-    spi_class->_exchangeRoutine = stm32l4_spi_exchange;
+    spi_class->_exchangeRoutine = (spi_class->_dmaThreshold ? SPIClass::_exchangeDMA : stm32l4_spi_exchange);
     spi_class->_exchange8Routine = stm32l4_spi_exchange8;
     spi_class->_exchange16Routine = stm32l4_spi_exchange16;
   
@@ -377,6 +642,18 @@ uint16_t SPIClass::_exchange16Select(struct _stm32l4_spi_t *spi, uint16_t data)
 void SPIClass::EventCallback(uint32_t events)
 {
     void(*callback)(void);
+
+    if (_queueTransactions) {
+	digitalWrite(_queueTransactions[_queueIndex].pin, HIGH);
+
+	_queueIndex++;
+
+	if ((_queueIndex < _queueCount) && queueStart()) {
+	    return;
+	}
+
+	_queueTransactions = NULL;
+    }
   
     callback = _completionCallback;
     _completionCallback = NULL;
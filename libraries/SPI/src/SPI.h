@@ -53,6 +53,11 @@
 #define SPI_CLOCK_DIV64  64
 #define SPI_CLOCK_DIV128 128
 
+// STM32L4 EXTENSTION: synchronous transfers of at least SPI_DMA_THRESHOLD bytes use DMA
+#ifndef SPI_DMA_THRESHOLD
+#define SPI_DMA_THRESHOLD 128
+#endif
+
 class SPISettings {
 public:
     SPISettings() : _clock(4000000), _bitOrder(MSBFIRST), _dataMode(SPI_MODE0) { }
@@ -66,6 +71,15 @@ private:
     friend class SPIClass;
 };
 
+// STM32L4 EXTENSTION: one entry of a transaction queue, "pin" is the (active low) chip select
+struct SPITransaction {
+    SPISettings settings;
+    uint32_t    pin;
+    const void  *txBuffer;
+    void        *rxBuffer;
+    size_t      count;
+};
+
 class SPIClass {
 public:
     SPIClass(struct _stm32l4_spi_t *spi, unsigned int instance, const struct _stm32l4_spi_pins_t *pins, unsigned int priority, unsigned int mode);
@@ -101,14 +115,35 @@ public:
     inline void write(const void *buffer, size_t count) { return exchange(static_cast<const uint8_t*>(buffer), NULL, count); }
     inline void transfer(const void *txBuffer, void *rxBuffer, size_t count) { return exchange(static_cast<const uint8_t*>(txBuffer), static_cast<uint8_t*>(rxBuffer), count); }
 
+    // STM32L4 EXTENSTION: exchange "count" 16 bit frames, or frames of "bits" (4 to 16) bits, one frame per
+    // (right aligned) uint16_t; requests of at least the DMA threshold in bytes use half word DMA
+    inline void transfer16(uint16_t *buffer, size_t count) { return transferFrames(buffer, buffer, count, 16); }
+    inline void transfer16(const uint16_t *txBuffer, uint16_t *rxBuffer, size_t count) { return transferFrames(txBuffer, rxBuffer, count, 16); }
+    void transferFrames(const uint16_t *txBuffer, uint16_t *rxBuffer, size_t count, unsigned int bits);
+
+    // STM32L4 EXTENSTION: use DMA (and sleep while waiting) for synchronous transfers of at least "count" bytes (0 disables)
+    void setDMAThreshold(size_t count);
+
     // STM32L4 EXTENSTION: asynchronous composite transaction
     bool transfer(const void *txBuffer, void *rxBuffer, size_t count, void(*callback)(void));
     void flush(void);
     bool done(void);
 
+    // STM32L4 EXTENSTION: asynchronous queue of transactions, run back to back from the interrupt handler
+    bool transfer(const SPITransaction *transactions, size_t count, void(*callback)(void));
+
     // STM32L4 EXTENSTION: isEnabled() check
     bool isEnabled(void);
 
+    // STM32L4 EXTENSTION: slave mode after begin(), framed by "pin", which has to be a hardware NSS
+    // pin of this SPI port. "rxBuffer" and "txBuffer" (NULL sends 0xff) are rings of "size" bytes run
+    // by circular DMA; each byte the master clocks is exchanged at the same ring offset. "callback"
+    // gets called from the interrupt handler at the end of each frame (NSS rising edge) with the
+    // offset and length of that frame. Frames have to be shorter than "size".
+    bool beginSlave(uint32_t pin, uint8_t dataMode, void *rxBuffer, const void *txBuffer, size_t size, void(*callback)(size_t offset, size_t count));
+    void endSlave(void);
+    size_t slaveOffset(void);
+
 private:
     struct _stm32l4_spi_t *_spi;
     bool _selected;
@@ -117,6 +152,7 @@ private:
     uint8_t _dataMode;
     uint32_t _reference;
     uint32_t _interruptMask;
+    size_t _dmaThreshold;
 
     void (*_exchangeRoutine)(struct _stm32l4_spi_t*, const uint8_t*, uint8_t*, size_t);
     uint8_t (*_exchange8Routine)(struct _stm32l4_spi_t*, uint8_t);
@@ -135,11 +171,27 @@ private:
     }
     
     static void _exchangeSelect(struct _stm32l4_spi_t *spi, const uint8_t *txData, uint8_t *rxData, size_t count);
+    static void _exchangeDMA(struct _stm32l4_spi_t *spi, const uint8_t *txData, uint8_t *rxData, size_t count);
     static uint8_t _exchange8Select(struct _stm32l4_spi_t *spi, uint8_t data);
     static uint16_t _exchange16Select(struct _stm32l4_spi_t *spi, uint16_t data);
 
     void (*_completionCallback)(void);
 
+    const SPITransaction *_queueTransactions;
+    size_t _queueCount;
+    size_t _queueIndex;
+
+    bool _slave;
+    uint32_t _slavePin;
+    size_t _slaveSize;
+    size_t _slaveOffset;
+    void (*_slaveCallback)(size_t, size_t);
+
+    static void _slaveNotify(void *context);
+
+    uint32_t settingsOption(const SPISettings &settings);
+    bool queueStart(void);
+
     static void _eventCallback(void *context, uint32_t events);
     void EventCallback(uint32_t events);
 };
@@ -0,0 +1,69 @@
+/*
+  Sampler
+
+  Reads the accelerometer and gyro of an MPU-6050 at 0x68 at 1.6 kHz via
+  Wire, independent of what loop() is doing, and prints the samples with
+  their timestamps once per second in batches together with the overrun
+  and drop counters.
+
+  TIM7 is used as the time base, so tone() cannot be used at the same time.
+
+  This example code is in the public domain.
+*/
+
+#include <Wire.h>
+#include <Sampler.h>
+
+int imuId;
+
+void setup()
+{
+  Serial.begin(9600);
+
+  Wire.begin();
+  Wire.setClock(400000);
+
+  // Take the MPU-6050 out of sleep
+  Wire.beginTransmission(0x68);
+  Wire.write(0x6b);
+  Wire.write(0x00);
+  Wire.endTransmission();
+
+  // 14 bytes from ACCEL_XOUT_H: accel X/Y/Z, temperature, gyro X/Y/Z
+  imuId = Sampler.addI2C(Wire, 0x68, 0x3b, 14);
+
+  Sampler.begin(TIMER_INSTANCE_TIM7, 625);
+}
+
+void loop()
+{
+  SamplerSample sample;
+  static uint32_t last = 0;
+  static uint32_t count = 0;
+
+  while (Sampler.read(sample)) {
+    if ((sample.source == imuId) && (sample.status == 0)) {
+      if ((sample.timestamp - last) >= 1000000) {
+        last = sample.timestamp;
+
+        Serial.print(sample.timestamp);
+        Serial.print(": ax=");
+        Serial.print((int16_t)((sample.data[0] << 8) | sample.data[1]));
+        Serial.print(" ay=");
+        Serial.print((int16_t)((sample.data[2] << 8) | sample.data[3]));
+        Serial.print(" az=");
+        Serial.print((int16_t)((sample.data[4] << 8) | sample.data[5]));
+        Serial.print(" samples=");
+        Serial.print(count);
+        Serial.print(" overruns=");
+        Serial.print(Sampler.overruns());
+        Serial.print(" dropped=");
+        Serial.println(Sampler.dropped());
+
+        count = 0;
+      }
+
+      count++;
+    }
+  }
+}
@@ -0,0 +1,305 @@
+/*
+ * Copyright (c) 2017 Thomas Roell.  All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal with the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ *  1. Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimers.
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimers in the
+ *     documentation and/or other materials provided with the distribution.
+ *  3. Neither the name of Thomas Roell, nor the names of its contributors
+ *     may be used to endorse or promote products derived from this Software
+ *     without specific prior written permission.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ * CONTRIBUTORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * WITH THE SOFTWARE.
+ */
+
+#include "Arduino.h"
+#include "stm32l4_wiring_private.h"
+#include "Sampler.h"
+
+#define SOURCE_STATE_IDLE    0
+#define SOURCE_STATE_PENDING 1   // waiting for its SPI bus
+#define SOURCE_STATE_BUSY    2
+
+static_assert(SAMPLER_SOURCE_COUNT == 4, "SAMPLER_SOURCE_COUNT does not match the callback tables");
+
+static stm32l4_timer_t _SamplerTimer;
+
+SamplerClass::SamplerClass()
+{
+    _count = 0;
+    _timer = &_SamplerTimer;
+    _overruns = 0;
+    _dropped = 0;
+}
+
+template<unsigned int N> void SamplerClass::_i2cCallback(uint8_t status)
+{
+    Sampler.complete(N, status);
+}
+
+template<unsigned int N> void SamplerClass::_spiCallback(void)
+{
+    Sampler.complete(N, 0);
+}
+
+int SamplerClass::addI2C(TwoWire &wire, uint8_t address, uint8_t reg, size_t size, unsigned int divider)
+{
+    static void (* const i2cCallbacks[SAMPLER_SOURCE_COUNT])(uint8_t) = {
+	SamplerClass::_i2cCallback<0>,
+	SamplerClass::_i2cCallback<1>,
+	SamplerClass::_i2cCallback<2>,
+	SamplerClass::_i2cCallback<3>,
+    };
+
+    Source *source;
+
+    if ((_timer->state != TIMER_STATE_NONE) || (_count == SAMPLER_SOURCE_COUNT)) {
+	return -1;
+    }
+
+    if ((size == 0) || (size > SAMPLER_DATA_SIZE) || (divider == 0) || (divider > 65535)) {
+	return -1;
+    }
+
+    source = &_sources[_count];
+
+    source->wire = &wire;
+    source->spi = NULL;
+    source->divider = divider;
+    source->size = size;
+    source->state = SOURCE_STATE_IDLE;
+    source->tx[0] = reg;
+
+    source->i2cTransaction.address = address;
+    source->i2cTransaction.txBuffer = &source->tx[0];
+    source->i2cTransaction.txSize = 1;
+    source->i2cTransaction.rxBuffer = &source->rx[0];
+    source->i2cTransaction.rxSize = size;
+    source->i2cTransaction.callback = i2cCallbacks[_count];
+    source->i2cTransaction.clock = 0;
+
+    return _count++;
+}
+
+int SamplerClass::addSPI(SPIClass &spi, SPISettings settings, uint32_t pin, uint8_t command, size_t size, unsigned int divider)
+{
+    Source *source;
+
+    if ((_timer->state != TIMER_STATE_NONE) || (_count == SAMPLER_SOURCE_COUNT)) {
+	return -1;
+    }
+
+    if ((size == 0) || (size > SAMPLER_DATA_SIZE) || (divider == 0) || (divider > 65535)) {
+	return -1;
+    }
+
+    source = &_sources[_count];
+
+    source->wire = NULL;
+    source->spi = &spi;
+    source->divider = divider;
+    source->size = size;
+    source->state = SOURCE_STATE_IDLE;
+    source->tx[0] = command;
+
+    memset(&source->tx[1], 0xff, size);
+
+    source->spiTransaction.settings = settings;
+    source->spiTransaction.pin = pin;
+    source->spiTransaction.txBuffer = &source->tx[0];
+    source->spiTransaction.rxBuffer = &source->rx[0];
+    source->spiTransaction.count = 1 + size;
+
+    digitalWrite(pin, HIGH);
+    pinMode(pin, OUTPUT);
+
+    return _count++;
+}
+
+bool SamplerClass::begin(unsigned int instance, uint32_t period)
+{
+    unsigned int index;
+
+    if ((_timer->state != TIMER_STATE_NONE) || (_count == 0)) {
+	return false;
+    }
+
+    if ((period == 0) || (period > 65535)) {
+	return false;
+    }
+
+    if (!stm32l4_timer_create(_timer, instance, STM32L4_I2C_IRQ_PRIORITY, 0)) {
+	return false;
+    }
+
+    // All sources are read on the first tick.
+    for (index = 0; index < _count; index++) {
+	_sources[index].countdown = 1;
+	_sources[index].state = SOURCE_STATE_IDLE;
+    }
+
+    _overruns = 0;
+    _dropped = 0;
+
+    stm32l4_timer_enable(_timer, (stm32l4_timer_clock(_timer) / 1000000) -1, period -1, TIMER_OPTION_COUNT_PRELOAD, SamplerClass::_timerCallback, (void*)this, TIMER_EVENT_PERIOD);
+    stm32l4_timer_start(_timer, false);
+
+    return true;
+}
+
+void SamplerClass::end()
+{
+    unsigned int index;
+
+    if (_timer->state == TIMER_STATE_NONE) {
+	return;
+    }
+
+    stm32l4_timer_stop(_timer);
+    stm32l4_timer_disable(_timer);
+    stm32l4_timer_destroy(_timer);
+
+    for (index = 0; index < _count; index++) {
+	if (_sources[index].wire) {
+	    _sources[index].wire->flush();
+	} else {
+	    _sources[index].spi->flush();
+	    _sources[index].spi->endTransaction();
+	}
+    }
+}
+
+int SamplerClass::available()
+{
+    return _queue.count();
+}
+
+bool SamplerClass::read(SamplerSample &sample)
+{
+    return _queue.pop(sample);
+}
+
+bool SamplerClass::start(unsigned int index)
+{
+    static void (* const spiCallbacks[SAMPLER_SOURCE_COUNT])(void) = {
+	SamplerClass::_spiCallback<0>,
+	SamplerClass::_spiCallback<1>,
+	SamplerClass::_spiCallback<2>,
+	SamplerClass::_spiCallback<3>,
+    };
+
+    Source *source = &_sources[index];
+
+    if (source->wire) {
+	return source->wire->enqueue(&source->i2cTransaction, 1);
+    } else {
+	return source->spi->transfer(&source->spiTransaction, 1, spiCallbacks[index]);
+    }
+}
+
+void SamplerClass::tick()
+{
+    Source *source;
+    unsigned int index;
+    uint32_t timestamp;
+
+    timestamp = micros();
+
+    for (index = 0; index < _count; index++) {
+	source = &_sources[index];
+
+	if (--source->countdown) {
+	    continue;
+	}
+
+	source->countdown = source->divider;
+
+	if (source->state != SOURCE_STATE_IDLE) {
+	    _overruns++;
+
+	    // A source still waiting for its SPI bus simply picks up the new timestamp.
+	    if (source->state == SOURCE_STATE_PENDING) {
+		source->timestamp = timestamp;
+	    }
+
+	    continue;
+	}
+
+	source->timestamp = timestamp;
+
+	// The state has to be BUSY before the read is posted, as it may complete
+	// (and go back to IDLE) before start() returns.
+	source->state = SOURCE_STATE_BUSY;
+
+	if (!start(index)) {
+	    if (source->spi) {
+		source->state = SOURCE_STATE_PENDING;
+	    } else {
+		source->state = SOURCE_STATE_IDLE;
+
+		_overruns++;
+	    }
+	}
+    }
+}
+
+void SamplerClass::complete(unsigned int index, uint8_t status)
+{
+    Source *source = &_sources[index];
+    Source *next;
+    SamplerSample sample;
+    unsigned int offset, count;
+
+    // Keep the SPI bus busy with the next pending source before anything else.
+    if (source->spi) {
+	for (offset = 1; offset < _count; offset++) {
+	    count = (index + offset) % _count;
+
+	    next = &_sources[count];
+
+	    if ((next->spi == source->spi) && (next->state == SOURCE_STATE_PENDING)) {
+		next->state = SOURCE_STATE_BUSY;
+
+		if (start(count)) {
+		    break;
+		}
+
+		next->state = SOURCE_STATE_PENDING;
+	    }
+	}
+    }
+
+    sample.timestamp = source->timestamp;
+    sample.source = index;
+    sample.status = status;
+    sample.size = source->size;
+
+    memcpy(&sample.data[0], (source->spi ? &source->rx[1] : &source->rx[0]), source->size);
+
+    source->state = SOURCE_STATE_IDLE;
+
+    if (!_queue.push(sample)) {
+	armv7m_atomic_add(&_dropped, 1);
+    }
+}
+
+void SamplerClass::_timerCallback(void *context, uint32_t events)
+{
+    reinterpret_cast<class SamplerClass*>(context)->tick();
+}
+
+SamplerClass Sampler;
@@ -0,0 +1,121 @@
+/*
+ * Copyright (c) 2017 Thomas Roell.  All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal with the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ *  1. Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimers.
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimers in the
+ *     documentation and/or other materials provided with the distribution.
+ *  3. Neither the name of Thomas Roell, nor the names of its contributors
+ *     may be used to endorse or promote products derived from this Software
+ *     without specific prior written permission.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ * CONTRIBUTORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * WITH THE SOFTWARE.
+ */
+
+#ifndef _SAMPLER_H_INCLUDED
+#define _SAMPLER_H_INCLUDED
+
+#include <Arduino.h>
+#include <Pool.h>
+#include <SPI.h>
+#include <Wire.h>
+
+#include "stm32l4_timer.h"
+
+// Number of sources, maximum number of data bytes per sample, and number
+// of samples the queue holds (a power of 2).
+#define SAMPLER_SOURCE_COUNT 4
+#define SAMPLER_DATA_SIZE    32
+#define SAMPLER_QUEUE_SIZE   32
+
+struct SamplerSample {
+    uint32_t timestamp;   // micros() at the timer tick that triggered the read
+    uint8_t  source;      // as returned by addI2C()/addSPI()
+    uint8_t  status;      // 0 on success, I2C status (2, 3, 4) otherwise
+    uint8_t  size;
+    uint8_t  data[SAMPLER_DATA_SIZE];
+};
+
+// Periodic sensor acquisition.
+//
+// addI2C() registers a read of "size" bytes starting at register "reg",
+// addSPI() a full duplex transfer of "command" followed by "size" dummy
+// bytes (whose response is the data). A source is read on every
+// "divider"-th tick of the timer started by begin(), where "period" is
+// in microseconds (at most 65535).
+//
+// The timer interrupt posts I2C reads via TwoWire::enqueue() and SPI
+// reads via the asynchronous SPIClass::transfer(); SPI sources sharing a
+// bus are run back to back. Results end up in a lock-free queue read by
+// available()/read(). A tick that finds the previous read of a source
+// still in flight is skipped and counted by overruns(); samples that do
+// not fit into the queue are counted by dropped().
+//
+// While the Sampler runs, SPI sources own their SPI bus; Wire may still be
+// used from loop(), as direct transfers wait for the transaction queue.
+class SamplerClass
+{
+public:
+    SamplerClass();
+
+    int addI2C(TwoWire &wire, uint8_t address, uint8_t reg, size_t size, unsigned int divider = 1);
+    int addSPI(SPIClass &spi, SPISettings settings, uint32_t pin, uint8_t command, size_t size, unsigned int divider = 1);
+
+    bool begin(unsigned int instance, uint32_t period);
+    void end();
+
+    int available();
+    bool read(SamplerSample &sample);
+
+    uint32_t overruns() { return _overruns; }
+    uint32_t dropped() { return _dropped; }
+
+private:
+    struct Source {
+        TwoWire *wire;
+        SPIClass *spi;
+        uint16_t divider;
+        uint16_t countdown;
+        uint8_t size;
+        volatile uint8_t state;
+        uint32_t timestamp;
+        TwoWireTransaction i2cTransaction;
+        SPITransaction spiTransaction;
+        uint8_t tx[1 + SAMPLER_DATA_SIZE];
+        uint8_t rx[1 + SAMPLER_DATA_SIZE];
+    };
+
+    Source _sources[SAMPLER_SOURCE_COUNT];
+    unsigned int _count;
+    struct _stm32l4_timer_t *_timer;
+    volatile uint32_t _overruns;
+    volatile uint32_t _dropped;
+
+    ObjectQueue<SamplerSample, SAMPLER_QUEUE_SIZE> _queue;
+
+    bool start(unsigned int index);
+    void tick();
+    void complete(unsigned int index, uint8_t status);
+
+    static void _timerCallback(void *context, uint32_t events);
+    template<unsigned int N> static void _i2cCallback(uint8_t status);
+    template<unsigned int N> static void _spiCallback(void);
+};
+
+extern SamplerClass Sampler;
+
+#endif // _SAMPLER_H_INCLUDED
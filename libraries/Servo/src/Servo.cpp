@@ -22,6 +22,9 @@
 #include <Servo.h>
 
 #define INVALID_SERVO         255
+#define INVALID_PIN           255
+
+static_assert(MAX_SERVOS <= SERVO_SLOT_COUNT, "MAX_SERVOS exceeds SERVO_SLOT_COUNT");
 
 static stm32l4_servo_t stm32l4_servo;
 
@@ -29,6 +32,12 @@ static uint8_t ServoAttached = 0;
 static volatile bool ServoSync = false;
 static stm32l4_servo_table_t ServoTable;
 
+// Servos driven by a PWM timer channel keep their slot in ServoTable (for the
+// width), but with GPIO_PIN_NONE, so that the scheduler skips them.
+static uint8_t ServoPin[MAX_SERVOS];
+static bool ServoPWM[MAX_SERVOS];
+static uint8_t ServoPWMCount[PWM_INSTANCE_COUNT];
+
 static void servo_event_callback(void *context, uint32_t events)
 {
     if (ServoSync)
@@ -39,6 +48,67 @@ static void servo_event_callback(void *context, uint32_t events)
     }
 }
 
+static bool servo_pwm_attach(uint32_t pin, uint32_t width)
+{
+    unsigned int instance;
+    stm32l4_timer_t *timer;
+
+    if (!(g_APinDescription[pin].attr & PIN_ATTR_PWM)) {
+	return false;
+    }
+
+    instance = g_APinDescription[pin].pwm_instance;
+    timer = &stm32l4_pwm[instance];
+
+    if (ServoPWMCount[instance] == 0) {
+	if (timer->state != TIMER_STATE_NONE) {
+	    return false;
+	}
+
+	if (!stm32l4_timer_create(timer, g_PWMInstances[instance], STM32L4_PWM_IRQ_PRIORITY, 0)) {
+	    return false;
+	}
+
+	stm32l4_timer_enable(timer, (stm32l4_timer_clock(timer) / 1000000) -1, SERVO_FRAME_WIDTH -1, TIMER_OPTION_COUNT_PRELOAD, NULL, NULL, 0);
+	stm32l4_timer_start(timer, false);
+    }
+
+    ServoPWMCount[instance]++;
+
+    // Leave the output latch low for the GPIO mode after detach().
+    digitalWrite(pin, LOW);
+
+    stm32l4_gpio_pin_configure(g_APinDescription[pin].pin, (GPIO_PUPD_NONE | GPIO_OSPEED_HIGH | GPIO_OTYPE_PUSHPULL | GPIO_MODE_ALTERNATE));
+
+    // The compare value is preloaded, so the first pulse starts with the next frame.
+    stm32l4_timer_channel(timer, g_APinDescription[pin].pwm_channel, width, TIMER_CONTROL_PWM);
+
+    return true;
+}
+
+static void servo_pwm_detach(uint32_t pin, uint32_t width)
+{
+    unsigned int instance;
+    stm32l4_timer_t *timer;
+
+    instance = g_APinDescription[pin].pwm_instance;
+    timer = &stm32l4_pwm[instance];
+
+    // Let a pulse in flight finish, so that the servo does not see a runt.
+    while (stm32l4_timer_count(timer) < width) {
+    }
+
+    stm32l4_timer_channel(timer, g_APinDescription[pin].pwm_channel, 0, TIMER_CONTROL_DISABLE);
+
+    pinMode(pin, OUTPUT);
+
+    if (--ServoPWMCount[instance] == 0) {
+	stm32l4_timer_stop(timer);
+	stm32l4_timer_disable(timer);
+	stm32l4_timer_destroy(timer);
+    }
+}
+
 Servo::Servo()
 {
     if (stm32l4_servo.state == SERVO_STATE_NONE) {
@@ -51,6 +121,8 @@ Servo::Servo()
 	ServoTable.slot[this->servoIndex].pin = GPIO_PIN_NONE;
 	ServoTable.slot[this->servoIndex].width = DEFAULT_PULSE_WIDTH;
 
+	ServoPin[this->servoIndex] = INVALID_PIN;
+
 	ServoTable.entries++;
     } else {
 	this->servoIndex = INVALID_SERVO;
@@ -64,7 +136,7 @@ uint8_t Servo::attach(int pin)
 
 uint8_t Servo::attach(int pin, int min, int max)
 {
-    if (g_APinDescription[pin].GPIO == NULL) {
+    if (g_APinDescription[pin].bit == 0) {
 	return INVALID_SERVO;
     }
 
@@ -72,17 +144,36 @@ uint8_t Servo::attach(int pin, int min, int max)
 	return INVALID_SERVO;
     }
 
-    if (ServoTable.slot[this->servoIndex].pin == GPIO_PIN_NONE) {
-	ServoAttached++;
+    if (ServoPin[this->servoIndex] == pin) {
+	this->min  = min;
+	this->max  = max;
+
+	return this->servoIndex;
     }
 
-    pinMode(pin, OUTPUT);
+    if (ServoPin[this->servoIndex] != INVALID_PIN) {
+	this->detach();
+    }
 
-    ServoTable.slot[this->servoIndex].pin = g_APinDescription[pin].pin;
-    
     this->min  = min;
     this->max  = max;
 
+    ServoPin[this->servoIndex] = pin;
+
+    if (servo_pwm_attach(pin, ServoTable.slot[this->servoIndex].width)) {
+	ServoPWM[this->servoIndex] = true;
+
+	return this->servoIndex;
+    }
+
+    ServoPWM[this->servoIndex] = false;
+
+    ServoAttached++;
+
+    pinMode(pin, OUTPUT);
+
+    ServoTable.slot[this->servoIndex].pin = g_APinDescription[pin].pin;
+
     if (stm32l4_servo.state < SERVO_STATE_READY) {
 	stm32l4_servo_enable(&stm32l4_servo, &ServoTable, servo_event_callback, NULL, SERVO_EVENT_SYNC);
     } else {
@@ -98,17 +189,34 @@ uint8_t Servo::attach(int pin, int min, int max)
 
 void Servo::detach()
 {
+    int width;
+
     if (this->servoIndex >= MAX_SERVOS) {
 	return;
     }
 
-    if (ServoTable.slot[this->servoIndex].pin != GPIO_PIN_NONE) {
-	ServoAttached--;
+    if (ServoPin[this->servoIndex] == INVALID_PIN) {
+	return;
     }
 
-    ServoTable.slot[this->servoIndex].pin = GPIO_PIN_NONE;   // store default values
+    if (ServoPWM[this->servoIndex]) {
+	width = ServoTable.slot[this->servoIndex].width;
 
-    ServoSync = true;
+	// Any pulse still in flight is at most "max" wide, or the default width.
+	if (width < this->max) {
+	    width = this->max;
+	}
+
+	servo_pwm_detach(ServoPin[this->servoIndex], width);
+    } else {
+	ServoAttached--;
+
+	ServoTable.slot[this->servoIndex].pin = GPIO_PIN_NONE;   // store default values
+
+	ServoSync = true;
+    }
+
+    ServoPin[this->servoIndex] = INVALID_PIN;
 }
 
 void Servo::write(int angle)
@@ -147,8 +255,15 @@ void Servo::writeMicroseconds(int width)
     }
     
     ServoTable.slot[this->servoIndex].width = width;
-    
-    ServoSync = true;
+
+    if (ServoPin[this->servoIndex] != INVALID_PIN) {
+	if (ServoPWM[this->servoIndex]) {
+	    // Preloaded, so it takes effect at the start of the next frame.
+	    stm32l4_timer_compare(&stm32l4_pwm[g_APinDescription[ServoPin[this->servoIndex]].pwm_instance], g_APinDescription[ServoPin[this->servoIndex]].pwm_channel, width);
+	} else {
+	    ServoSync = true;
+	}
+    }
 }
 
 int Servo::read() // return the value as degrees
@@ -167,5 +282,9 @@ int Servo::readMicroseconds()
 
 bool Servo::attached()
 {
-    return (ServoTable.slot[this->servoIndex].pin != GPIO_PIN_NONE);
+    if (this->servoIndex >= MAX_SERVOS) {
+	return false;
+    }
+
+    return (ServoPin[this->servoIndex] != INVALID_PIN);
 }
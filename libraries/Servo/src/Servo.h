@@ -52,6 +52,13 @@
 
     The default values (although been kept for compatibility) do not make sense. The midpoint
     (aka 90 degrees) is at 1472, which does not correspond to the correct 1500 microseconds.
+
+    A servo on a pin with a PWM timer channel is driven by hardware, if that timer is not
+    already in use by analogWrite(). The timer then runs a fixed 20000us frame,
+    and all its channels pick up new widths at the start of the next frame, without any
+    interrupt. analogWrite() on another pin of such a timer is not supported. All other pins
+    share one timer interrupt per pulse edge, where the pulses are emitted back to back, so
+    that the frame stretches beyond 20000us with more than about 10 of those servos.
  */
 
 #ifndef Servo_h
@@ -67,7 +74,9 @@
 #define REFRESH_INTERVAL    20000     // minumim time to refresh servos in microseconds 
 
 // NOTE: to maintain a strict refresh interval the user needs to not exceed 2250us pulse width
-#define MAX_SERVOS              8
+#if !defined(MAX_SERVOS)
+#define MAX_SERVOS             24     // at most SERVO_SLOT_COUNT
+#endif
 
 class Servo
 {
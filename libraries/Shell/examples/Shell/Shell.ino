@@ -0,0 +1,74 @@
+/*
+  Shell
+
+  A small console on SerialUSB. Type "help" for the list of commands,
+  "led on" / "led off" to switch the LED, "blink <ms>" to set the blink
+  period and "status" for the uptime and core temperature.
+
+  This example code is in the public domain.
+*/
+
+#include <Shell.h>
+
+static uint32_t period = 0;
+static uint32_t last = 0;
+
+static void cmdLed(Print &out, int argc, char **argv)
+{
+  if ((argc == 2) && !strcmp(argv[1], "on")) {
+    period = 0;
+    digitalWrite(LED_BUILTIN, HIGH);
+  } else if ((argc == 2) && !strcmp(argv[1], "off")) {
+    period = 0;
+    digitalWrite(LED_BUILTIN, LOW);
+  } else {
+    out.println("usage: led on|off");
+  }
+}
+
+static void cmdBlink(Print &out, int argc, char **argv)
+{
+  long value;
+
+  if ((argc != 2) || !Shell.toLong(argv[1], value) || (value <= 0)) {
+    out.println("usage: blink <ms>");
+    return;
+  }
+
+  period = value;
+}
+
+static void cmdStatus(Print &out, int argc, char **argv)
+{
+  out.print("uptime ");
+  out.print(millis());
+  out.print("ms, temperature ");
+  out.print(STM32.getTemperature());
+  out.println("C");
+}
+
+static const ShellCommand commands[] = {
+  { "led",    "led on|off",  cmdLed    },
+  { "blink",  "blink <ms>",  cmdBlink  },
+  { "status", "uptime and temperature", cmdStatus },
+};
+
+void setup()
+{
+  pinMode(LED_BUILTIN, OUTPUT);
+
+  SerialUSB.begin(9600);
+
+  Shell.begin(SerialUSB, commands);
+}
+
+void loop()
+{
+  Shell.poll();
+
+  if (period && ((millis() - last) >= period)) {
+    last = millis();
+
+    digitalWrite(LED_BUILTIN, !digitalRead(LED_BUILTIN));
+  }
+}
@@ -0,0 +1,279 @@
+/*
+ * Copyright (c) 2017 Thomas Roell.  All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal with the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ *  1. Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimers.
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimers in the
+ *     documentation and/or other materials provided with the distribution.
+ *  3. Neither the name of Thomas Roell, nor the names of its contributors
+ *     may be used to endorse or promote products derived from this Software
+ *     without specific prior written permission.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ * CONTRIBUTORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * WITH THE SOFTWARE.
+ */
+
+#include "Arduino.h"
+#include "Shell.h"
+
+ShellClass::ShellClass()
+{
+    _stream = NULL;
+    _commands = NULL;
+    _count = 0;
+    _prompt = NULL;
+    _echo = true;
+    _overflow = false;
+    _last = 0;
+    _length = 0;
+}
+
+void ShellClass::begin(Stream &stream, const ShellCommand *commands, unsigned int count, const char *prompt)
+{
+    _stream = &stream;
+    _commands = commands;
+    _count = count;
+    _prompt = prompt;
+    _overflow = false;
+    _last = 0;
+    _length = 0;
+
+    if (_prompt) {
+	_stream->print(_prompt);
+    }
+}
+
+void ShellClass::end()
+{
+    _stream = NULL;
+}
+
+bool ShellClass::poll()
+{
+    const uint8_t *data;
+    size_t count, index;
+    int c;
+
+    if (!_stream) {
+	return false;
+    }
+
+    count = _stream->peekBuffer(&data);
+
+    if (count) {
+	for (index = 0; index < count; index++) {
+	    if (receive(data[index])) {
+		_stream->consume(index +1);
+
+		execute();
+
+		return true;
+	    }
+	}
+
+	_stream->consume(count);
+    } else {
+	while ((c = _stream->read()) >= 0) {
+	    if (receive(c)) {
+		execute();
+
+		return true;
+	    }
+	}
+    }
+
+    return false;
+}
+
+// Adds "c" to the line, returns true if the line is complete.
+bool ShellClass::receive(uint8_t c)
+{
+    uint8_t last = _last;
+
+    _last = c;
+
+    if ((c == '\r') || (c == '\n')) {
+	// CR LF (or LF CR) is one line end
+	if (((last == '\r') || (last == '\n')) && (last != c)) {
+	    _last = 0;
+
+	    return false;
+	}
+
+	if (_echo) {
+	    _stream->write("\r\n", 2);
+	}
+
+	if (_overflow) {
+	    _overflow = false;
+	    _length = 0;
+
+	    _stream->println("line too long");
+
+	    if (_prompt) {
+		_stream->print(_prompt);
+	    }
+
+	    return false;
+	}
+
+	_line[_length] = '\0';
+
+	return true;
+    }
+
+    if ((c == '\b') || (c == 0x7f)) {
+	if (_length && !_overflow) {
+	    _length--;
+
+	    if (_echo) {
+		_stream->write("\b \b", 3);
+	    }
+	}
+
+	return false;
+    }
+
+    if ((c < ' ') || _overflow) {
+	return false;
+    }
+
+    if (_length == SHELL_LINE_SIZE) {
+	_overflow = true;
+
+	return false;
+    }
+
+    _line[_length++] = c;
+
+    if (_echo) {
+	_stream->write(c);
+    }
+
+    return false;
+}
+
+// Splits the line in place and runs the matching command.
+void ShellClass::execute()
+{
+    char *argv[SHELL_ARGUMENT_COUNT +1];
+    char *s, *d;
+    unsigned int index;
+    int argc;
+
+    argc = 0;
+
+    s = &_line[0];
+
+    while (1) {
+	while (*s == ' ') {
+	    s++;
+	}
+
+	if (*s == '\0') {
+	    break;
+	}
+
+	if (argc == SHELL_ARGUMENT_COUNT) {
+	    _stream->println("too many arguments");
+
+	    argc = 0;
+	    break;
+	}
+
+	// Quote characters are removed by copying the argument onto itself.
+	argv[argc++] = d = s;
+
+	while ((*s != '\0') && (*s != ' ')) {
+	    if (*s == '"') {
+		s++;
+
+		while ((*s != '\0') && (*s != '"')) {
+		    *d++ = *s++;
+		}
+
+		if (*s == '"') {
+		    s++;
+		}
+	    } else {
+		*d++ = *s++;
+	    }
+	}
+
+	if (*s == ' ') {
+	    s++;
+	}
+
+	*d = '\0';
+    }
+
+    argv[argc] = NULL;
+
+    if (argc) {
+	for (index = 0; index < _count; index++) {
+	    if (!strcmp(argv[0], _commands[index].name)) {
+		(*_commands[index].handler)(*_stream, argc, argv);
+		break;
+	    }
+	}
+
+	if (index == _count) {
+	    if (!strcmp(argv[0], "help")) {
+		help(*_stream);
+	    } else {
+		_stream->print(argv[0]);
+		_stream->println(": unknown command");
+	    }
+	}
+    }
+
+    _length = 0;
+
+    if (_prompt) {
+	_stream->print(_prompt);
+    }
+}
+
+void ShellClass::help(Print &out)
+{
+    unsigned int index;
+
+    for (index = 0; index < _count; index++) {
+	out.print(_commands[index].name);
+
+	if (_commands[index].help) {
+	    out.print(" - ");
+	    out.print(_commands[index].help);
+	}
+
+	out.println();
+    }
+}
+
+bool ShellClass::toLong(const char *string, long &value)
+{
+    char *end;
+
+    if (!string || (*string == '\0')) {
+	return false;
+    }
+
+    value = strtol(string, &end, 0);
+
+    return (*end == '\0');
+}
+
+ShellClass Shell;
@@ -0,0 +1,105 @@
+/*
+ * Copyright (c) 2017 Thomas Roell.  All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal with the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ *  1. Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimers.
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimers in the
+ *     documentation and/or other materials provided with the distribution.
+ *  3. Neither the name of Thomas Roell, nor the names of its contributors
+ *     may be used to endorse or promote products derived from this Software
+ *     without specific prior written permission.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ * CONTRIBUTORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * WITH THE SOFTWARE.
+ */
+
+#ifndef _SHELL_H_INCLUDED
+#define _SHELL_H_INCLUDED
+
+#include <Arduino.h>
+
+// Maximum length of a command line, and maximum number of arguments
+// (including the command name itself).
+#define SHELL_LINE_SIZE      128
+#define SHELL_ARGUMENT_COUNT 16
+
+// One entry of the command table, e.g.
+//
+//   static const ShellCommand commands[] = {
+//       { "gain", "gain <db>", cmdGain },
+//   };
+//
+// "handler" gets the Print to reply to, and the line split into
+// arguments (argv[0] is the command name). The argv[] strings point
+// into the line buffer and are only valid during the call.
+struct ShellCommand {
+    const char *name;
+    const char *help;
+    void (*handler)(Print &out, int argc, char **argv);
+};
+
+// Line based command console.
+//
+// poll() takes whatever the stream has received, via peekBuffer()
+// spans where available, and collects it into a fixed line buffer.
+// Once a line is complete (CR or LF), it is split into arguments in
+// place, separated by blanks; double quotes group an argument with
+// blanks. At most one command is dispatched per poll(). Backspace
+// edits the line, and lines longer than SHELL_LINE_SIZE are dropped.
+// "help" lists the command table.
+//
+// Nothing is allocated, replies are written directly to the stream.
+class ShellClass
+{
+public:
+    ShellClass();
+
+    void begin(Stream &stream, const ShellCommand *commands, unsigned int count, const char *prompt = "> ");
+    template<unsigned int N> void begin(Stream &stream, const ShellCommand (&commands)[N], const char *prompt = "> ") {
+	begin(stream, &commands[0], N, prompt);
+    }
+    void end();
+
+    // Call from loop(), returns true if a command was dispatched
+    bool poll();
+
+    // Echo received characters back (default on)
+    void setEcho(bool enable) { _echo = enable; }
+
+    void help(Print &out);
+
+    // Helper for handlers: parse a decimal (or 0x hex) argument, returns
+    // false if "string" is not a complete number.
+    static bool toLong(const char *string, long &value);
+
+private:
+    Stream *_stream;
+    const ShellCommand *_commands;
+    unsigned int _count;
+    const char *_prompt;
+    bool _echo;
+    bool _overflow;
+    uint8_t _last;
+    uint16_t _length;
+    char _line[SHELL_LINE_SIZE +1];
+
+    bool receive(uint8_t c);
+    void execute();
+};
+
+extern ShellClass Shell;
+
+#endif // _SHELL_H_INCLUDED
@@ -0,0 +1,80 @@
+/*
+  Tasks
+
+  Blinks the LED from one task, and prints the button presses counted by
+  an interrupt handler from another one, while loop() reports the stack
+  usage of both tasks every 5 seconds. The button is on pin 2, to GND.
+
+  This example code is in the public domain.
+*/
+
+#include <Task.h>
+
+static uint64_t blinkStack[512 / 8];
+static uint64_t buttonStack[1024 / 8];
+
+TaskEvent buttonEvent;
+volatile uint32_t buttonCount = 0;
+
+void blink()
+{
+  for (;;)
+  {
+    digitalWrite(LED_BUILTIN, HIGH);
+    Task::sleep(100);
+    digitalWrite(LED_BUILTIN, LOW);
+    Task::sleep(900);
+  }
+}
+
+void button()
+{
+  for (;;)
+  {
+    if (Task::sleepUntil(buttonEvent, 10000))
+    {
+      Serial.print("Button: ");
+      Serial.println(buttonCount);
+    }
+    else
+    {
+      Serial.println("No button press for 10 seconds");
+    }
+  }
+}
+
+Task blinkTask(blink, blinkStack, sizeof(blinkStack));
+Task buttonTask(button, buttonStack, sizeof(buttonStack));
+
+void buttonPress()
+{
+  buttonCount++;
+
+  buttonEvent.signal();
+}
+
+void setup()
+{
+  Serial.begin(9600);
+
+  pinMode(LED_BUILTIN, OUTPUT);
+
+  pinMode(2, INPUT_PULLUP);
+  attachInterrupt(2, buttonPress, FALLING);
+}
+
+void loop()
+{
+  // delay() lets the tasks run.
+  delay(5000);
+
+  Serial.print("blink stack: ");
+  Serial.print(blinkTask.stackUsed());
+  Serial.print("/");
+  Serial.println(blinkTask.stackSize());
+
+  Serial.print("button stack: ");
+  Serial.print(buttonTask.stackUsed());
+  Serial.print("/");
+  Serial.println(buttonTask.stackSize());
+}
@@ -0,0 +1,315 @@
+/*
+ * Copyright (c) 2017 Thomas Roell.  All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal with the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ *  1. Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimers.
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimers in the
+ *     documentation and/or other materials provided with the distribution.
+ *  3. Neither the name of Thomas Roell, nor the names of its contributors
+ *     may be used to endorse or promote products derived from this Software
+ *     without specific prior written permission.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ * CONTRIBUTORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * WITH THE SOFTWARE.
+ */
+
+#include "Arduino.h"
+#include "Task.h"
+
+#define TASK_STACK_FILL 0xa5a5a5a5
+
+#if defined (__VFP_FP__) && !defined(__SOFTFP__)
+#define TASK_FRAME_SIZE (16 + 8 + 1)  // s16-s31, r4-r11, pc
+#else
+#define TASK_FRAME_SIZE (8 + 1)       // r4-r11, pc
+#endif
+
+Task Task::_main;
+Task *Task::_tasks = NULL;
+Task *Task::_current = &Task::_main;
+
+// Saves the callee saved registers of the current context on its stack and the
+// resulting stack pointer in "*save", then picks up "restore". "spsel" is
+// CONTROL.SPSEL for the new context: loop() runs on MSP, tasks on PSP.
+extern "C" __attribute__((naked, noinline)) void task_switch(void **save, void *restore, uint32_t spsel)
+{
+    __asm__ volatile (
+	"push     { r4-r11, lr }        \n"
+#if defined (__VFP_FP__) && !defined(__SOFTFP__)
+	"vpush    { s16-s31 }           \n"
+#endif
+	"mov      r3, sp                \n"
+	"str      r3, [r0]              \n"
+	"mrs      r3, CONTROL           \n"
+	"bic      r3, r3, #2            \n"
+	"orr      r3, r3, r2            \n"
+	"msr      CONTROL, r3           \n"
+	"isb                            \n"
+	"mov      sp, r1                \n"
+#if defined (__VFP_FP__) && !defined(__SOFTFP__)
+	"vpop     { s16-s31 }           \n"
+#endif
+	"pop      { r4-r11, pc }        \n"
+	);
+}
+
+// Only thread mode with interrupts unmasked may switch, so that neither a
+// handler nor a critical section is ever suspended.
+static inline bool task_schedulable()
+{
+    return ((__get_IPSR() == 0) && !__get_PRIMASK() && !__get_BASEPRI());
+}
+
+Task::Task(void (*function)(void), void *stack, size_t size)
+    : Task()
+{
+    uint32_t *frame;
+    Task *task;
+    size_t offset, index;
+
+    offset = (((uint32_t)stack + 7) & ~7) - (uint32_t)stack;
+
+    _function = function;
+    _stack = (uint32_t*)((uint8_t*)stack + offset);
+    _size = (size > offset) ? ((size - offset) & ~7) : 0;
+    _psp = 1;
+
+    if (!function || (_size < TASK_STACK_MIN)) {
+	_size = 0;
+	_state = TASK_STATE_DONE;
+
+	return;
+    }
+
+    for (index = 0; index < (_size / sizeof(uint32_t)); index++) {
+	_stack[index] = TASK_STACK_FILL;
+    }
+
+    frame = &_stack[(_size / sizeof(uint32_t)) - TASK_FRAME_SIZE];
+
+    for (index = 0; index < (TASK_FRAME_SIZE -1); index++) {
+	frame[index] = 0;
+    }
+
+    frame[TASK_FRAME_SIZE -1] = (uint32_t)&Task::entry;
+
+    _sp = (void*)frame;
+
+    for (task = &_main; task->_next; task = task->_next) {
+    }
+
+    task->_next = this;
+
+    armv7m_core_yield_callback = Task::coreYield;
+}
+
+Task::~Task()
+{
+    Task *task;
+
+    if (this == &_main) {
+	return;
+    }
+
+    if (this == _current) {
+	_state = TASK_STATE_DONE;
+
+	wait();
+    }
+
+    for (task = &_main; task->_next; task = task->_next) {
+	if (task->_next == this) {
+	    task->_next = _next;
+
+	    break;
+	}
+    }
+}
+
+size_t Task::stackUsed() const
+{
+    size_t index, count;
+
+    count = _size / sizeof(uint32_t);
+
+    for (index = 0; index < count; index++) {
+	if (_stack[index] != TASK_STACK_FILL) {
+	    break;
+	}
+    }
+
+    return (count - index) * sizeof(uint32_t);
+}
+
+bool Task::stackOverflow() const
+{
+    return (_size && (_stack[0] != TASK_STACK_FILL));
+}
+
+void Task::yield()
+{
+    Task *next;
+
+    if (!task_schedulable()) {
+	return;
+    }
+
+    next = pick(_current);
+
+    if (next) {
+	resume(next);
+    }
+}
+
+void Task::sleep(uint32_t ms)
+{
+    Task *self = _current;
+
+    if (!ms) {
+	yield();
+
+	return;
+    }
+
+    self->_event = NULL;
+    self->_start = millis();
+    self->_timeout = ms;
+    self->_state = TASK_STATE_SLEEP;
+
+    self->wait();
+}
+
+bool Task::sleepUntil(TaskEvent &event, uint32_t timeout)
+{
+    Task *self = _current;
+
+    if (!event._signaled) {
+	self->_event = &event;
+	self->_start = millis();
+	self->_timeout = timeout;
+	self->_state = TASK_STATE_SLEEP;
+
+	self->wait();
+
+	self->_event = NULL;
+
+	if (!event._signaled) {
+	    return false;
+	}
+    }
+
+    event._signaled = 0;
+
+    return true;
+}
+
+bool Task::runnable()
+{
+    if (_state == TASK_STATE_READY) {
+	return true;
+    }
+
+    if (_state == TASK_STATE_DONE) {
+	return false;
+    }
+
+    if (_event && _event->_signaled) {
+	return true;
+    }
+
+    if (_timeout && ((millis() - _start) >= _timeout)) {
+	return true;
+    }
+
+    return false;
+}
+
+// Runs the other tasks till this one is runnable again. Without anything to
+// run the core waits for the next interrupt (SysTick at the latest).
+void Task::wait()
+{
+    Task *next;
+
+    while (!runnable()) {
+	next = task_schedulable() ? pick(this) : NULL;
+
+	if (next) {
+	    resume(next);
+	} else {
+	    __asm__ volatile ("wfe; sev; wfe");
+	}
+    }
+
+    _state = TASK_STATE_READY;
+}
+
+// Round robin over loop() and the tasks, starting after "self".
+Task *Task::pick(Task *self)
+{
+    Task *task;
+
+    for (task = (self->_next ? self->_next : &_main); task != self; task = (task->_next ? task->_next : &_main)) {
+	if (task->runnable()) {
+	    return task;
+	}
+    }
+
+    return NULL;
+}
+
+void Task::resume(Task *task)
+{
+    Task *self = _current;
+
+    _current = task;
+
+    task_switch(&self->_sp, task->_sp, (task->_psp ? 2 : 0));
+}
+
+void Task::entry()
+{
+    Task *self = _current;
+
+    (*self->_function)();
+
+    self->_state = TASK_STATE_DONE;
+
+    self->wait();
+}
+
+void Task::coreYield(bool wait)
+{
+    Task *next;
+
+    if (task_schedulable()) {
+	next = pick(_current);
+
+	if (next) {
+	    resume(next);
+
+	    return;
+	}
+    }
+
+    if (wait) {
+	__asm__ volatile ("wfe; sev; wfe");
+    }
+}
+
+void yield(void)
+{
+    Task::yield();
+}
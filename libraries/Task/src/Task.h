@@ -0,0 +1,140 @@
+/*
+ * Copyright (c) 2017 Thomas Roell.  All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal with the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ *  1. Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimers.
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimers in the
+ *     documentation and/or other materials provided with the distribution.
+ *  3. Neither the name of Thomas Roell, nor the names of its contributors
+ *     may be used to endorse or promote products derived from this Software
+ *     without specific prior written permission.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ * CONTRIBUTORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * WITH THE SOFTWARE.
+ */
+
+#ifndef _TASK_H_INCLUDED
+#define _TASK_H_INCLUDED
+
+#include <Arduino.h>
+
+// Signaled from any context (interrupt handlers included), waited for by
+// Task::sleepUntil(). A signal is sticky until a waiter consumes it.
+class TaskEvent
+{
+public:
+    constexpr TaskEvent() : _signaled(0) { }
+
+    void signal() {
+        _signaled = 1;
+
+        __SEV();
+    }
+
+    void clear() { _signaled = 0; }
+    bool signaled() const { return _signaled; }
+
+private:
+    volatile uint8_t _signaled;
+
+    friend class Task;
+};
+
+// Cooperative tasks.
+//
+// A Task runs "function" on its own "stack" of "size" bytes (8 byte aligned,
+// at least TASK_STACK_MIN). All tasks and loop() take turns: a switch only
+// happens in yield(), Task::yield(), Task::sleep(), Task::sleepUntil(), or where
+// a driver blocks (delay(), Serial writes, SPI/Wire waits, SD card and serial
+// flash busy ...), which call the scheduler via armv7m_core_yield() or
+// armv7m_core_relax(). Interrupt handlers never switch tasks.
+//
+// Tasks run on PSP, so interrupt handlers do not eat into task stacks.
+// stackUsed() is the high watermark, found by scanning for the fill pattern
+// written at construction time. stackOverflow() reports a clobbered guard
+// word at the stack bottom.
+//
+// A peripheral used by more than one task needs to be guarded by the
+// application, as a blocking call on it may switch to another task.
+class Task
+{
+public:
+    Task(void (*function)(void), void *stack, size_t size);
+
+    // Removes the task from the scheduler, so a Task may go out of scope or be
+    // deleted once it is no longer needed. Destroying the running task itself
+    // ends it like returning from its function (the destructor does not return),
+    // so its storage must stay valid.
+    ~Task();
+
+    bool done() const { return (_state == TASK_STATE_DONE); }
+
+    size_t stackSize() const { return _size; }
+    size_t stackUsed() const;
+    bool stackOverflow() const;
+
+    // Switch to the next runnable task, if any.
+    static void yield();
+
+    // Let the other tasks run for "ms" milliseconds.
+    static void sleep(uint32_t ms);
+
+    // Let the other tasks run till "event" is signaled (and consume the signal),
+    // or "timeout" milliseconds (0 waits forever). Returns false on timeout.
+    static bool sleepUntil(TaskEvent &event, uint32_t timeout = 0);
+
+    // NULL from loop().
+    static Task *current() { return ((_current != &_main) ? _current : NULL); }
+
+private:
+    enum {
+        TASK_STATE_READY = 0,
+        TASK_STATE_SLEEP,
+        TASK_STATE_DONE,
+    };
+
+    void *_sp;
+    Task *_next;
+    volatile uint8_t _state;
+    uint8_t _psp;
+    uint32_t _start;
+    uint32_t _timeout;
+    TaskEvent *_event;
+    uint32_t *_stack;
+    size_t _size;
+    void (*_function)(void);
+
+    constexpr Task() : _sp(NULL), _next(NULL), _state(TASK_STATE_READY), _psp(0), _start(0), _timeout(0), _event(NULL), _stack(NULL), _size(0), _function(NULL) { }
+
+    bool runnable();
+    void wait();
+
+    static Task *pick(Task *self);
+    static void resume(Task *task);
+    static void entry();
+    static void coreYield(bool wait);
+
+    static Task _main;
+    static Task *_tasks;
+    static Task *_current;
+
+    Task(const Task&) = delete;
+    Task& operator=(const Task&) = delete;
+};
+
+#define TASK_STACK_MIN 256
+
+#endif // _TASK_H_INCLUDED
@@ -0,0 +1,44 @@
+/*
+  Telemetry
+
+  Streams an analog input, the loop count and the core temperature as
+  binary frames over Serial every millisecond. The channel layout gets
+  resent every second, so a host that attaches late can still decode the
+  data.
+
+  This example code is in the public domain.
+*/
+
+#include <Telemetry.h>
+
+int analogId, countId, temperatureId;
+
+void setup()
+{
+  Serial.begin(9600);
+
+  analogId = Telemetry.channel("A0", TELEMETRY_UINT16);
+  countId = Telemetry.channel("count", TELEMETRY_UINT32);
+  temperatureId = Telemetry.channel("temperature", TELEMETRY_FLOAT);
+
+  Telemetry.begin(Serial);
+}
+
+void loop()
+{
+  static uint32_t count = 0;
+  static uint32_t last = 0;
+
+  if ((millis() - last) >= 1000) {
+    last = millis();
+
+    Telemetry.setFloat(temperatureId, STM32.getTemperature());
+    Telemetry.describe();
+  }
+
+  Telemetry.set(analogId, analogRead(A0));
+  Telemetry.set(countId, count++);
+  Telemetry.send();
+
+  delay(1);
+}
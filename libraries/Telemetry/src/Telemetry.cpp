@@ -0,0 +1,400 @@
+/*
+ * Copyright (c) 2016 Thomas Roell.  All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal with the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ *  1. Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimers.
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimers in the
+ *     documentation and/or other materials provided with the distribution.
+ *  3. Neither the name of Thomas Roell, nor the names of its contributors
+ *     may be used to endorse or promote products derived from this Software
+ *     without specific prior written permission.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ * CONTRIBUTORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * WITH THE SOFTWARE.
+ */
+
+#include "Telemetry.h"
+#include "stm32l4_crc.h"
+
+#define TELEMETRY_FRAME_SCHEMA 0x01
+#define TELEMETRY_FRAME_DATA   0x02
+
+#define TELEMETRY_NAME_LENGTH  32
+
+// Reflected CRC-32 (0xedb88320), 4 bits at a time, for when the CRC unit is busy.
+static const uint32_t _telemetryCRC[16] = {
+    0x00000000, 0x1db71064, 0x3b6e20c8, 0x26d930ac, 0x76dc4190, 0x6b6b51f4, 0x4db26158, 0x5005713c,
+    0xedb88320, 0xf00f9344, 0xd6d6a3e8, 0xcb61b38c, 0x9b64c2b0, 0x86d3d2d4, 0xa00ae278, 0xbdbdf21c,
+};
+
+static const uint8_t _telemetryWidth[] = {
+    1, // TELEMETRY_INT8
+    1, // TELEMETRY_UINT8
+    2, // TELEMETRY_INT16
+    2, // TELEMETRY_UINT16
+    4, // TELEMETRY_INT32
+    4, // TELEMETRY_UINT32
+    4, // TELEMETRY_FLOAT
+};
+
+TelemetryClass::TelemetryClass()
+{
+    _port = NULL;
+    _latency = 0;
+    _stamp = 0;
+    _dropped = 0;
+    _sequence = 0;
+    _channels = 0;
+    _size = 0;
+
+    _busy = false;
+    _index = 0;
+    _count = 0;
+    _frames = 0;
+    _code = 0;
+    _run = 0;
+}
+
+bool TelemetryClass::begin(CDC_BASE &port, unsigned int latency)
+{
+    if (_port) {
+	return false;
+    }
+
+    _port = &port;
+    _latency = latency;
+    _dropped = 0;
+    _sequence = 0;
+
+    _index = 0;
+    _count = 0;
+    _frames = 0;
+
+    return true;
+}
+
+void TelemetryClass::end()
+{
+    if (!_port) {
+	return;
+    }
+
+    // A full batch may have been held back while the previous one was in
+    // flight, so wait twice.
+    while (_busy) {
+	armv7m_core_yield();
+    }
+
+    flush();
+
+    while (_busy) {
+	armv7m_core_yield();
+    }
+
+    _port = NULL;
+}
+
+int TelemetryClass::channel(const char *name, TelemetryType type)
+{
+    unsigned int id, width;
+
+    if ((unsigned int)type >= sizeof(_telemetryWidth)) {
+	return -1;
+    }
+
+    width = _telemetryWidth[type];
+
+    if ((_channels == TELEMETRY_CHANNEL_COUNT) || ((_size + width) > TELEMETRY_FRAME_SIZE)) {
+	return -1;
+    }
+
+    id = _channels++;
+
+    _name[id] = name;
+    _type[id] = type;
+    _offset[id] = _size;
+
+    memset(&_values[_size], 0, width);
+
+    _size += width;
+
+    return id;
+}
+
+bool TelemetryClass::set(int id, int32_t value)
+{
+    uint8_t *data;
+    int16_t data_16;
+    float data_f;
+
+    if ((id < 0) || (id >= _channels)) {
+	return false;
+    }
+
+    data = &_values[_offset[id]];
+
+    switch (_type[id]) {
+    case TELEMETRY_INT8:
+    case TELEMETRY_UINT8:
+	data[0] = (uint8_t)value;
+	break;
+
+    case TELEMETRY_INT16:
+    case TELEMETRY_UINT16:
+	data_16 = (int16_t)value;
+	memcpy(data, &data_16, 2);
+	break;
+
+    case TELEMETRY_INT32:
+    case TELEMETRY_UINT32:
+	memcpy(data, &value, 4);
+	break;
+
+    case TELEMETRY_FLOAT:
+	data_f = (float)value;
+	memcpy(data, &data_f, 4);
+	break;
+    }
+
+    return true;
+}
+
+bool TelemetryClass::setFloat(int id, float value)
+{
+    if ((id < 0) || (id >= _channels)) {
+	return false;
+    }
+
+    if (_type[id] != TELEMETRY_FLOAT) {
+	return set(id, (int32_t)value);
+    }
+
+    memcpy(&_values[_offset[id]], &value, 4);
+
+    return true;
+}
+
+bool TelemetryClass::describe()
+{
+    unsigned int size, id, index, length;
+    const char *name;
+
+    if (!_port) {
+	return false;
+    }
+
+    size = 3 + 4;
+
+    for (id = 0; id < _channels; id++) {
+	length = strlen(_name[id]);
+
+	size += (2 + ((length > TELEMETRY_NAME_LENGTH) ? TELEMETRY_NAME_LENGTH : length));
+    }
+
+    if (!_open(size)) {
+	return false;
+    }
+
+    _put(TELEMETRY_FRAME_SCHEMA);
+    _put(_sequence);
+    _put(_channels);
+
+    for (id = 0; id < _channels; id++) {
+	name = _name[id];
+	length = strlen(name);
+
+	if (length > TELEMETRY_NAME_LENGTH) {
+	    length = TELEMETRY_NAME_LENGTH;
+	}
+
+	_put(_type[id]);
+	_put(length);
+
+	for (index = 0; index < length; index++) {
+	    _put(name[index]);
+	}
+    }
+
+    _close();
+
+    // The host needs the schema before it can decode anything else.
+    return flush();
+}
+
+bool TelemetryClass::send()
+{
+    unsigned int index;
+    uint32_t stamp;
+
+    if (!_port) {
+	return false;
+    }
+
+    if (!_open(6 + _size + 4)) {
+	return false;
+    }
+
+    stamp = micros();
+
+    _put(TELEMETRY_FRAME_DATA);
+    _put(_sequence);
+    _put(stamp >> 0);
+    _put(stamp >> 8);
+    _put(stamp >> 16);
+    _put(stamp >> 24);
+
+    for (index = 0; index < _size; index++) {
+	_put(_values[index]);
+    }
+
+    _close();
+
+    if ((millis() - _stamp) >= _latency) {
+	flush();
+    }
+
+    return true;
+}
+
+bool TelemetryClass::flush()
+{
+    if (!_port) {
+	return false;
+    }
+
+    if (_count == 0) {
+	return true;
+    }
+
+    if (_busy) {
+	return false;
+    }
+
+    _busy = true;
+
+    if (!_port->write(&_buffer[_index][0], _count, TelemetryClass::_done)) {
+	_busy = false;
+	_dropped += _frames;
+    }
+
+    _index ^= 1;
+    _count = 0;
+    _frames = 0;
+
+    return true;
+}
+
+// Start a frame with "size" bytes before COBS encoding. If the batch buffer
+// does not have room for the worst case encoding, it gets flushed first.
+bool TelemetryClass::_open(unsigned int size)
+{
+    size = size + (size / 254) + 2;
+
+    if (size > TELEMETRY_BUFFER_SIZE) {
+	_dropped++;
+
+	return false;
+    }
+
+    if ((_count + size) > TELEMETRY_BUFFER_SIZE) {
+	if (!flush()) {
+	    _dropped++;
+
+	    return false;
+	}
+    }
+
+    if (_count == 0) {
+	_stamp = millis();
+    }
+
+    // CRC-32 as used by zlib: reflected input/output, the final XOR is
+    // done in software. The CRC unit is shared (e.g. with stm32l4_iap), so
+    // it is only held for the frame.
+    _hardware = stm32l4_crc_acquire(0x04c11db7, 0xffffffff, (CRC_OPTION_POLYSIZE_32 | CRC_OPTION_REVERSE_INPUT | CRC_OPTION_REVERSE_OUTPUT));
+    _crc = 0xffffffff;
+
+    _code = _count++;
+    _run = 1;
+
+    return true;
+}
+
+void TelemetryClass::_put(uint8_t data)
+{
+    if (_hardware) {
+	stm32l4_crc_update(&data, 1);
+    } else {
+	_crc = (_crc >> 4) ^ _telemetryCRC[(_crc ^ data) & 15];
+	_crc = (_crc >> 4) ^ _telemetryCRC[(_crc ^ (data >> 4)) & 15];
+    }
+
+    _encode(data);
+}
+
+// COBS: each run of up to 254 non-zero bytes is prefixed by a code byte of
+// its length + 1. A code byte below 0xff implies a 0x00 after the run.
+void TelemetryClass::_encode(uint8_t data)
+{
+    uint8_t *buffer = &_buffer[_index][0];
+
+    if (data == 0x00) {
+	buffer[_code] = _run;
+
+	_code = _count++;
+	_run = 1;
+    } else {
+	buffer[_count++] = data;
+
+	if (++_run == 0xff) {
+	    buffer[_code] = _run;
+
+	    _code = _count++;
+	    _run = 1;
+	}
+    }
+}
+
+void TelemetryClass::_close()
+{
+    uint32_t crc;
+
+    if (_hardware) {
+	crc = ~stm32l4_crc_value();
+
+	stm32l4_crc_release();
+    } else {
+	crc = ~_crc;
+    }
+
+    _encode(crc >> 0);
+    _encode(crc >> 8);
+    _encode(crc >> 16);
+    _encode(crc >> 24);
+
+    _buffer[_index][_code] = _run;
+    _buffer[_index][_count++] = 0x00;
+
+    _frames++;
+    _sequence++;
+}
+
+void TelemetryClass::_done(void)
+{
+    Telemetry._busy = false;
+}
+
+TelemetryClass Telemetry;
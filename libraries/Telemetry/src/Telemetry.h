@@ -0,0 +1,126 @@
+/*
+ * Copyright (c) 2016 Thomas Roell.  All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal with the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ *  1. Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimers.
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimers in the
+ *     documentation and/or other materials provided with the distribution.
+ *  3. Neither the name of Thomas Roell, nor the names of its contributors
+ *     may be used to endorse or promote products derived from this Software
+ *     without specific prior written permission.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ * CONTRIBUTORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * WITH THE SOFTWARE.
+ */
+
+#ifndef _TELEMETRY_H_INCLUDED
+#define _TELEMETRY_H_INCLUDED
+
+#include <Arduino.h>
+
+// Number of channels, maximum number of value bytes per data frame, and
+// size of each of the two batch buffers.
+#define TELEMETRY_CHANNEL_COUNT 32
+#define TELEMETRY_FRAME_SIZE    128
+#define TELEMETRY_BUFFER_SIZE   512
+
+enum TelemetryType {
+    TELEMETRY_INT8   = 0,
+    TELEMETRY_UINT8  = 1,
+    TELEMETRY_INT16  = 2,
+    TELEMETRY_UINT16 = 3,
+    TELEMETRY_INT32  = 4,
+    TELEMETRY_UINT32 = 5,
+    TELEMETRY_FLOAT  = 6,
+};
+
+// Binary telemetry over SerialUSB or WebUSBSerial.
+//
+// channel() registers a typed channel, which gets a fixed slot in the
+// data frame. set()/setFloat() update the current value of a channel,
+// and send() snapshots all channels into a frame. Frames get appended to
+// a batch buffer, which is handed to CDC_BASE::write(buffer, size,
+// callback) once it is full, or once the oldest frame in it is
+// "latency" milliseconds old. While the previous batch is still in
+// flight, frames that do not fit are dropped (and counted).
+//
+// Each frame is COBS encoded and terminated by a 0x00 byte. Decoded, a
+// frame is (all values little endian):
+//
+//   data:   0x02, <seq:u8>, <micros:u32>, <value>..., <crc:u32>
+//   schema: 0x01, <seq:u8>, <count:u8>, { <type:u8>, <len:u8>, <name> }..., <crc:u32>
+//
+// The data values are in channel order, with the sizes given by their
+// types. "crc" is the CRC-32 (as used by zlib) of all preceding bytes,
+// computed by the CRC peripheral, which is acquired for each frame (with a
+// software fallback while another client holds it). describe() sends the
+// schema frame.
+//
+// All calls, except for the internal completion callback, are meant to
+// be made from one thread context.
+class TelemetryClass
+{
+public:
+    TelemetryClass();
+
+    bool begin(CDC_BASE &port, unsigned int latency = 10);
+    void end();
+
+    int channel(const char *name, TelemetryType type);
+
+    bool set(int id, int32_t value);
+    bool setFloat(int id, float value);
+
+    bool describe();
+    bool send();
+    bool flush();
+
+    uint32_t dropped() { return _dropped; }
+
+private:
+    CDC_BASE *_port;
+    uint32_t _latency;
+    uint32_t _stamp;
+    uint32_t _dropped;
+    uint8_t _sequence;
+    uint8_t _channels;
+    uint16_t _size;
+    const char *_name[TELEMETRY_CHANNEL_COUNT];
+    uint8_t _type[TELEMETRY_CHANNEL_COUNT];
+    uint8_t _offset[TELEMETRY_CHANNEL_COUNT];
+    uint8_t _values[TELEMETRY_FRAME_SIZE];
+
+    volatile bool _busy;
+    uint8_t _index;
+    uint16_t _count;
+    uint16_t _frames;
+    uint16_t _code;
+    uint8_t _run;
+    bool _hardware;
+    uint32_t _crc;
+    uint8_t _buffer[2][TELEMETRY_BUFFER_SIZE];
+
+    bool _open(unsigned int size);
+    void _put(uint8_t data);
+    void _encode(uint8_t data);
+    void _close();
+
+    static void _done(void);
+};
+
+extern TelemetryClass Telemetry;
+
+#endif // _TELEMETRY_H_INCLUDED
@@ -0,0 +1,77 @@
+/*
+  TouchButton
+
+  A capacitive button on TSC group 2. On a Ladybug connect a 10nF
+  capacitor from D4 (PB4, the sampling pin) to GND, and an electrode
+  (a coin sized copper pad) to D5 (PB5). Other boards need pins from
+  one of the TSC groups, with one sampling pin per group used. More
+  buttons are added with Touch.addChannel(). Don't touch the pad during
+  the first second, while the baseline is calibrated.
+
+  Touch and release are printed over Serial as
+
+    TOUCH,channel=<n>,state=<touched|released>,value=<n>,baseline=<n>
+
+  and the LED is lit while the button is touched.
+
+  This example code is in the public domain.
+*/
+
+#include <Touch.h>
+
+#define SAMPLING_PIN 4
+#define BUTTON_PIN   5
+
+static volatile bool change = false;
+
+static void touchCallback(void)
+{
+  change = true;
+}
+
+void setup()
+{
+  Serial.begin(9600);
+
+  while (!Serial) { }
+
+  pinMode(LED_BUILTIN, OUTPUT);
+
+  Touch.addSampling(SAMPLING_PIN);
+  Touch.addChannel(BUTTON_PIN);
+
+  Touch.onChange(touchCallback);
+
+  if (!Touch.begin(20)) {
+    Serial.println("TOUCH,failed");
+  }
+}
+
+void loop()
+{
+  uint32_t changed;
+  unsigned int channel;
+
+  if (!change) {
+    return;
+  }
+
+  change = false;
+
+  changed = Touch.changed();
+
+  for (channel = 0; channel < 1; channel++) {
+    if (changed & (1u << channel)) {
+      Serial.print("TOUCH,channel=");
+      Serial.print(channel);
+      Serial.print(",state=");
+      Serial.print(Touch.touched(channel) ? "touched" : "released");
+      Serial.print(",value=");
+      Serial.print(Touch.value(channel));
+      Serial.print(",baseline=");
+      Serial.println(Touch.baseline(channel));
+    }
+  }
+
+  digitalWrite(LED_BUILTIN, Touch.touched() ? HIGH : LOW);
+}
@@ -0,0 +1,82 @@
+/*
+ * Copyright (c) 2017 Thomas Roell.  All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal with the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ *  1. Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimers.
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimers in the
+ *     documentation and/or other materials provided with the distribution.
+ *  3. Neither the name of Thomas Roell, nor the names of its contributors
+ *     may be used to endorse or promote products derived from this Software
+ *     without specific prior written permission.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ * CONTRIBUTORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * WITH THE SOFTWARE.
+ */
+
+#include "Arduino.h"
+#include "stm32l4_wiring_private.h"
+#include "Touch.h"
+
+TouchClass::TouchClass()
+{
+    _changeCallback = NULL;
+
+    stm32l4_tsc_create(&_tsc, STM32L4_TSC_IRQ_PRIORITY);
+}
+
+bool TouchClass::addSampling(uint32_t pin)
+{
+    if ((pin >= NUM_TOTAL_PINS) || (g_APinDescription[pin].pin == GPIO_PIN_NONE)) {
+	return false;
+    }
+
+    return stm32l4_tsc_sampling(&_tsc, g_APinDescription[pin].pin);
+}
+
+int TouchClass::addChannel(uint32_t pin, uint16_t threshold)
+{
+    if ((pin >= NUM_TOTAL_PINS) || (g_APinDescription[pin].pin == GPIO_PIN_NONE)) {
+	return -1;
+    }
+
+    return stm32l4_tsc_channel(&_tsc, g_APinDescription[pin].pin, threshold);
+}
+
+bool TouchClass::begin(uint32_t period)
+{
+    return stm32l4_tsc_enable(&_tsc, period, 0, TouchClass::_eventCallback, (void*)this, (TSC_EVENT_TOUCH | TSC_EVENT_RELEASE));
+}
+
+void TouchClass::end()
+{
+    stm32l4_tsc_disable(&_tsc);
+}
+
+void TouchClass::onChange(void(*callback)(void))
+{
+    _changeCallback = callback;
+}
+
+void TouchClass::_eventCallback(void *context, uint32_t events)
+{
+    TouchClass *self = reinterpret_cast<TouchClass*>(context);
+
+    if (self->_changeCallback) {
+	(*self->_changeCallback)();
+    }
+}
+
+TouchClass Touch;
@@ -0,0 +1,81 @@
+/*
+ * Copyright (c) 2017 Thomas Roell.  All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal with the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ *  1. Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimers.
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimers in the
+ *     documentation and/or other materials provided with the distribution.
+ *  3. Neither the name of Thomas Roell, nor the names of its contributors
+ *     may be used to endorse or promote products derived from this Software
+ *     without specific prior written permission.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ * CONTRIBUTORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * WITH THE SOFTWARE.
+ */
+
+#ifndef _TOUCH_H_INCLUDED
+#define _TOUCH_H_INCLUDED
+
+#include <Arduino.h>
+
+#include "stm32l4_tsc.h"
+
+// Capacitive touch buttons on the Touch Sensing Controller.
+//
+// Every TSC group in use needs one pin with a sampling capacitor to GND
+// (10nF - 47nF), registered with addSampling(); addChannel() adds an
+// electrode in the same group and returns its channel number (in the order
+// added, 0 - 23). Which pins belong to which group is fixed by the chip
+// (e.g. group 2 is PB4 - PB7). begin() then acquires all channels every
+// "period" milliseconds in the background, from the TSC interrupt.
+//
+// The first few cycles after begin() calibrate the baseline, so electrodes
+// should not be touched then. A channel counts as touched once its count
+// drops more than "threshold" below the baseline (0 picks 1/16th of the
+// baseline), and as released once the drop is less than half of that.
+// onChange() registers a callback that is called from the interrupt
+// whenever a channel is touched or released; changed() returns the
+// channels (as bit mask) that changed since the last call.
+class TouchClass
+{
+public:
+    TouchClass();
+
+    bool addSampling(uint32_t pin);
+    int addChannel(uint32_t pin, uint16_t threshold = 0);
+
+    bool begin(uint32_t period = 20);
+    void end();
+
+    bool touched(unsigned int channel) { return !!(stm32l4_tsc_touched(&_tsc) & (1u << channel)); }
+    uint32_t touched() { return stm32l4_tsc_touched(&_tsc); }
+    uint32_t changed() { return stm32l4_tsc_changed(&_tsc); }
+
+    uint32_t value(unsigned int channel) { return stm32l4_tsc_value(&_tsc, channel); }
+    uint32_t baseline(unsigned int channel) { return stm32l4_tsc_baseline(&_tsc, channel); }
+
+    void onChange(void(*callback)(void));
+
+private:
+    stm32l4_tsc_t _tsc;
+    void (*_changeCallback)(void);
+
+    static void _eventCallback(void *context, uint32_t events);
+};
+
+extern TouchClass Touch;
+
+#endif // _TOUCH_H_INCLUDED
@@ -0,0 +1,46 @@
+/*
+  USBSpeaker
+
+  Shows up as a USB speaker (48kHz, 16 bit stereo) and plays whatever
+  the host sends through an I2S DAC. Requires the "Serial + Audio" USB
+  type. The stream state, volume and number of overruns are printed
+  over Serial once a second.
+
+  This example code is in the public domain.
+*/
+
+#include <I2S.h>
+#include <USBAudio.h>
+
+// 8 segments of 128 frames (2.67ms) each
+uint32_t buffer[4096 / 4];
+
+void setup()
+{
+  Serial.begin(9600);
+
+  if (!I2S.begin(I2S_PHILIPS_MODE, 48000, 16, false, buffer, sizeof(buffer), 8)) {
+    Serial.println("I2S.begin() failed");
+    return;
+  }
+
+  USBAudio.begin(I2S);
+}
+
+void loop()
+{
+  delay(1000);
+
+  Serial.print(USBAudio.streaming() ? "streaming" : "idle");
+  if (USBAudio.muted()) {
+    Serial.print(", muted");
+  } else {
+    Serial.print(", volume ");
+    Serial.print(USBAudio.volume() / 256);
+    Serial.print(" dB");
+  }
+  Serial.print(", overruns ");
+  Serial.print(USBAudio.overruns());
+  Serial.print(", underruns ");
+  Serial.println(I2S.underruns());
+}
@@ -0,0 +1,287 @@
+/*
+ * Copyright (c) 2017 Thomas Roell.  All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal with the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ *  1. Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimers.
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimers in the
+ *     documentation and/or other materials provided with the distribution.
+ *  3. Neither the name of Thomas Roell, nor the names of its contributors
+ *     may be used to endorse or promote products derived from this Software
+ *     without specific prior written permission.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ * CONTRIBUTORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * WITH THE SOFTWARE.
+ */
+
+#include "Arduino.h"
+#include "USBAudio.h"
+
+#include <math.h>
+
+#define AUDIO_GAIN_UNITY         32768
+
+// Feedback correction in 10.14 frames/ms per frame of fill error, and its limit (0.5 frames/ms)
+#define AUDIO_FEEDBACK_GAIN      16
+#define AUDIO_FEEDBACK_LIMIT     8192
+
+USBAudioClass::USBAudioClass()
+{
+    _i2s = NULL;
+    _segment = NULL;
+    _size = 0;
+    _offset = 0;
+    _error = 0;
+    _gain = AUDIO_GAIN_UNITY;
+    _overruns = 0;
+}
+
+bool USBAudioClass::begin(I2SClass &i2s)
+{
+    if (_i2s) {
+	return false;
+    }
+
+    _i2s = &i2s;
+    _segment = NULL;
+    _offset = 0;
+    _error = 0;
+    _overruns = 0;
+
+    event(USBD_AUDIO_EVENT_VOLUME);
+
+    if (!stm32l4_usbd_audio_enable(USBAudioClass::_receiveCallback, USBAudioClass::_feedbackCallback, USBAudioClass::_eventCallback, (void*)this)) {
+	_i2s = NULL;
+
+	return false;
+    }
+
+    return true;
+}
+
+void USBAudioClass::end()
+{
+    if (!_i2s) {
+	return;
+    }
+
+    stm32l4_usbd_audio_disable();
+
+    flush();
+
+    _i2s = NULL;
+}
+
+bool USBAudioClass::acquire()
+{
+    size_t frames;
+
+    _segment = (uint8_t*)_i2s->acquireTxBuffer(&frames);
+
+    if (!_segment) {
+	return false;
+    }
+
+    _size = frames * USBD_AUDIO_FRAME_SIZE;
+    _offset = 0;
+
+    return true;
+}
+
+// Pads a partially filled segment with silence and hands it to the SAI.
+void USBAudioClass::flush()
+{
+    if (_segment) {
+	memset(_segment + _offset, 0, _size - _offset);
+
+	_i2s->commitTxBuffer();
+
+	_segment = NULL;
+	_offset = 0;
+    }
+}
+
+// Fills the I2S ring half way with silence, so that the feedback has room to steer
+// in both directions.
+void USBAudioClass::prime()
+{
+    size_t capacity;
+
+    flush();
+
+    while (_i2s->queuedFrames(&capacity) < (capacity / 2)) {
+	if (!acquire()) {
+	    break;
+	}
+
+	flush();
+    }
+
+    _error = 0;
+}
+
+void USBAudioClass::scale(uint8_t *data, uint32_t count)
+{
+    int16_t *sample, *sample_e;
+    uint32_t gain = _gain;
+
+    if (gain == AUDIO_GAIN_UNITY) {
+	return;
+    }
+
+    if (gain == 0) {
+	memset(data, 0, count);
+
+	return;
+    }
+
+    sample = (int16_t*)data;
+    sample_e = (int16_t*)(data + (count & ~1));
+
+    while (sample != sample_e) {
+	*sample = ((int32_t)*sample * (int32_t)gain) >> 15;
+
+	sample++;
+    }
+}
+
+// Called with the packet the USB hardware stored at "data", returns where the next one
+// goes. That is the current segment if a whole packet still fits, and the bounce buffer
+// otherwise, whose content is then spread over the end of this segment and the start of
+// the next one.
+uint8_t *USBAudioClass::receive(uint8_t *data, uint32_t count)
+{
+    uint32_t size;
+
+    if (data == (uint8_t*)&_bounce[0]) {
+	scale(data, count);
+
+	while (count) {
+	    if (!_segment && !acquire()) {
+		_overruns++;
+
+		break;
+	    }
+
+	    size = _size - _offset;
+
+	    if (size > count) {
+		size = count;
+	    }
+
+	    memcpy(_segment + _offset, data, size);
+
+	    _offset += size;
+	    data += size;
+	    count -= size;
+
+	    if (_offset == _size) {
+		_i2s->commitTxBuffer();
+
+		_segment = NULL;
+		_offset = 0;
+	    }
+	}
+    } else if (data) {
+	scale(data, count);
+
+	_offset += count;
+
+	if (_offset == _size) {
+	    _i2s->commitTxBuffer();
+
+	    _segment = NULL;
+	    _offset = 0;
+	}
+    }
+
+    if (!_segment && !acquire()) {
+	_overruns++;
+
+	return NULL;
+    }
+
+    if ((_size - _offset) >= USBD_AUDIO_PACKET_SIZE) {
+	return _segment + _offset;
+    }
+
+    return (uint8_t*)&_bounce[0];
+}
+
+// The nominal rate, scaled by the drift of the local clock (which also drives the SAI)
+// against the host as measured from SOFs, then lowered if the I2S ring is more than half
+// full, and raised if it is less. The fill level is low pass filtered, as it moves in
+// steps of a whole segment whenever the SAI finishes one.
+uint32_t USBAudioClass::feedback()
+{
+    size_t capacity, level;
+    int32_t correction, nominal;
+
+    nominal = USBD_AUDIO_FEEDBACK_NOMINAL + (int32_t)(((int64_t)USBD_AUDIO_FEEDBACK_NOMINAL * USBDevice.clockDrift()) / 1000000000);
+
+    level = _i2s->queuedFrames(&capacity) + (_offset / USBD_AUDIO_FRAME_SIZE);
+
+    _error += ((((int32_t)level - (int32_t)(capacity / 2)) * 256) - _error) / 16;
+
+    correction = (_error * AUDIO_FEEDBACK_GAIN) / 256;
+
+    if (correction > AUDIO_FEEDBACK_LIMIT) {
+	correction = AUDIO_FEEDBACK_LIMIT;
+    }
+
+    if (correction < -AUDIO_FEEDBACK_LIMIT) {
+	correction = -AUDIO_FEEDBACK_LIMIT;
+    }
+
+    return nominal - correction;
+}
+
+void USBAudioClass::event(uint32_t events)
+{
+    if (events & USBD_AUDIO_EVENT_START) {
+	prime();
+    }
+
+    if (events & USBD_AUDIO_EVENT_STOP) {
+	flush();
+    }
+
+    if (events & (USBD_AUDIO_EVENT_MUTE | USBD_AUDIO_EVENT_VOLUME)) {
+	if (stm32l4_usbd_audio_mute()) {
+	    _gain = 0;
+	} else if (stm32l4_usbd_audio_volume() >= 0) {
+	    _gain = AUDIO_GAIN_UNITY;
+	} else {
+	    _gain = (uint32_t)(AUDIO_GAIN_UNITY * powf(10.0f, (float)stm32l4_usbd_audio_volume() / (20.0f * 256.0f)));
+	}
+    }
+}
+
+uint8_t *USBAudioClass::_receiveCallback(void *context, uint8_t *data, uint32_t count)
+{
+    return reinterpret_cast<class USBAudioClass*>(context)->receive(data, count);
+}
+
+uint32_t USBAudioClass::_feedbackCallback(void *context)
+{
+    return reinterpret_cast<class USBAudioClass*>(context)->feedback();
+}
+
+void USBAudioClass::_eventCallback(void *context, uint32_t events)
+{
+    reinterpret_cast<class USBAudioClass*>(context)->event(events);
+}
+
+USBAudioClass USBAudio;
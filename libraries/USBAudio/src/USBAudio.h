@@ -0,0 +1,95 @@
+/*
+ * Copyright (c) 2017 Thomas Roell.  All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal with the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ *  1. Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimers.
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimers in the
+ *     documentation and/or other materials provided with the distribution.
+ *  3. Neither the name of Thomas Roell, nor the names of its contributors
+ *     may be used to endorse or promote products derived from this Software
+ *     without specific prior written permission.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ * CONTRIBUTORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * WITH THE SOFTWARE.
+ */
+
+#ifndef _USBAUDIO_H_INCLUDED
+#define _USBAUDIO_H_INCLUDED
+
+#include <Arduino.h>
+#include <I2S.h>
+
+#include "stm32l4_usbd_audio.h"
+
+// USB speaker (UAC1, 48kHz 16 bit stereo) playing through I2S.
+//
+// The host streams one isochronous packet per ms, which the USB hardware
+// copies straight into the DMA segment acquired from the I2SClass via
+// acquireTxBuffer(); only a packet straddling two segments goes through a
+// small bounce buffer. Mute and volume set by the host are applied in
+// place before a segment is committed.
+//
+// The stream is asynchronous: the SAI clock is the master, and the host
+// adjusts its rate from the explicit feedback endpoint. It reports the
+// nominal rate scaled by the clock drift measured from SOFs (see
+// USBDevice.clockDrift()), corrected by how far the I2S ring is off being
+// half full.
+// A stream start primes the ring with silence to that level.
+//
+// "i2s" has to be started for transmit at 48kHz with 16 bits per sample
+// (and ideally with a buffer of several segments), and may not be written
+// to otherwise while the USBAudio is active. Requires the "Serial + Audio"
+// USB type.
+class USBAudioClass
+{
+public:
+    USBAudioClass();
+
+    bool begin(I2SClass &i2s);
+    void end();
+
+    bool streaming() { return stm32l4_usbd_audio_streaming(); }
+    bool muted() { return stm32l4_usbd_audio_mute(); }
+    int volume() { return stm32l4_usbd_audio_volume(); }   // 1/256 dB
+
+    uint32_t overruns() { return _overruns; }
+
+private:
+    I2SClass *_i2s;
+    uint8_t *_segment;
+    uint32_t _size;
+    uint32_t _offset;
+    int32_t _error;
+    volatile uint32_t _gain;   // Q15, 32768 is unity
+    volatile uint32_t _overruns;
+    uint32_t _bounce[USBD_AUDIO_PACKET_SIZE / 4];
+
+    bool acquire();
+    void flush();
+    void prime();
+    void scale(uint8_t *data, uint32_t count);
+    uint8_t *receive(uint8_t *data, uint32_t count);
+    uint32_t feedback();
+    void event(uint32_t events);
+
+    static uint8_t *_receiveCallback(void *context, uint8_t *data, uint32_t count);
+    static uint32_t _feedbackCallback(void *context);
+    static void _eventCallback(void *context, uint32_t events);
+};
+
+extern USBAudioClass USBAudio;
+
+#endif // _USBAUDIO_H_INCLUDED
@@ -0,0 +1,50 @@
+/*
+  MIDIEcho
+
+  Shows up as a USB MIDI device, and sends every received event straight
+  back to the host. A note on middle C is played once a second on channel
+  1, and the number of events echoed is printed over Serial. Requires the
+  "Serial + MIDI" USB type.
+
+  This example code is in the public domain.
+*/
+
+#include <USBMIDI.h>
+
+uint32_t echoed = 0;
+uint32_t last = 0;
+bool playing = false;
+
+void setup()
+{
+  Serial.begin(9600);
+
+  USBMIDI.begin();
+}
+
+void loop()
+{
+  uint32_t event;
+
+  while ((event = USBMIDI.read()) != 0) {
+    USBMIDI.write(event);
+    echoed++;
+  }
+
+  if ((millis() - last) >= 500) {
+    last = millis();
+
+    if (!playing) {
+      USBMIDI.noteOn(1, 60, 100);
+    } else {
+      USBMIDI.noteOff(1, 60);
+
+      Serial.print("MIDI,connected=");
+      Serial.print(USBMIDI.connected());
+      Serial.print(",echoed=");
+      Serial.println(echoed);
+    }
+
+    playing = !playing;
+  }
+}
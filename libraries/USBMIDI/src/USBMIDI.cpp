@@ -0,0 +1,113 @@
+/*
+ * Copyright (c) 2017 Thomas Roell.  All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal with the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ *  1. Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimers.
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimers in the
+ *     documentation and/or other materials provided with the distribution.
+ *  3. Neither the name of Thomas Roell, nor the names of its contributors
+ *     may be used to endorse or promote products derived from this Software
+ *     without specific prior written permission.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ * CONTRIBUTORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * WITH THE SOFTWARE.
+ */
+
+#include "Arduino.h"
+#include "USBMIDI.h"
+
+USBMIDIClass::USBMIDIClass()
+{
+    _enabled = false;
+    _receiveCallback = NULL;
+    armv7m_pendsv_job_create(&_receiveJob, NULL, NULL, ARMV7M_PENDSV_PRIORITY_LOW);
+}
+
+bool USBMIDIClass::begin()
+{
+    if (_enabled) {
+	return false;
+    }
+
+    if (!stm32l4_usbd_midi_enable(USBMIDIClass::_eventCallback, (void*)this, USBD_MIDI_EVENT_RECEIVE)) {
+	return false;
+    }
+
+    _enabled = true;
+
+    return true;
+}
+
+void USBMIDIClass::end()
+{
+    if (!_enabled) {
+	return;
+    }
+
+    stm32l4_usbd_midi_disable();
+
+    _enabled = false;
+}
+
+uint32_t USBMIDIClass::read()
+{
+    uint32_t event;
+
+    if (!stm32l4_usbd_midi_receive(&event, 1)) {
+	return 0;
+    }
+
+    return event;
+}
+
+size_t USBMIDIClass::pitchBend(uint8_t channel, int value)
+{
+    if (value < -8192) {
+	value = -8192;
+    }
+
+    if (value > 8191) {
+	value = 8191;
+    }
+
+    value += 8192;
+
+    return message(0xe0, channel, value & 0x7f, value >> 7);
+}
+
+void USBMIDIClass::onReceive(void(*callback)(void))
+{
+    _receiveCallback = callback;
+    _receiveJob.routine = (armv7m_pendsv_routine_t)callback;
+}
+
+void USBMIDIClass::event(uint32_t events)
+{
+    if (events & USBD_MIDI_EVENT_RECEIVE) {
+	if (_receiveCallback) {
+	    armv7m_pendsv_job_post(&_receiveJob, 0);
+	}
+
+	loopWakeup();
+    }
+}
+
+void USBMIDIClass::_eventCallback(void *context, uint32_t events)
+{
+    reinterpret_cast<class USBMIDIClass*>(context)->event(events);
+}
+
+USBMIDIClass USBMIDI;
@@ -0,0 +1,96 @@
+/*
+ * Copyright (c) 2017 Thomas Roell.  All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal with the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ *  1. Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimers.
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimers in the
+ *     documentation and/or other materials provided with the distribution.
+ *  3. Neither the name of Thomas Roell, nor the names of its contributors
+ *     may be used to endorse or promote products derived from this Software
+ *     without specific prior written permission.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ * CONTRIBUTORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * WITH THE SOFTWARE.
+ */
+
+#ifndef _USBMIDI_H_INCLUDED
+#define _USBMIDI_H_INCLUDED
+
+#include <Arduino.h>
+
+#include "stm32l4_usbd_midi.h"
+
+// USB MIDI device (one cable each way). Requires the "Serial + MIDI" USB
+// type.
+//
+// Events are 4 byte USB-MIDI event packets as uint32_t, i.e. Code Index
+// Number in bits 0..3, cable in bits 4..7, and the MIDI bytes in bits
+// 8..15, 16..23 and 24..31 (see USBD_MIDI_EVENT()).
+//
+// Received events go into a lock-free queue which read() drains. While
+// that queue cannot take another full packet the OUT endpoint is NAKed,
+// so the host is held off rather than events being lost. Written events
+// go into another lock-free queue, from which the USB interrupt sends
+// all pending events as one bulk packet per SOF (or right away once a
+// full packet of 16 is pending); flush() sends them without waiting for
+// the next SOF. Each queue has a single consumer and a single producer,
+// so read() and write() may each only be used from one context.
+//
+// "channel" is 1 .. 16. The onReceive() callback is run from PendSV.
+class USBMIDIClass
+{
+public:
+    USBMIDIClass();
+
+    bool begin();
+    void end();
+
+    bool connected() { return stm32l4_usbd_midi_connected(); }
+
+    int available() { return stm32l4_usbd_midi_count(); }
+    uint32_t read();   // 0 if there is no event
+    size_t read(uint32_t *events, size_t count) { return stm32l4_usbd_midi_receive(events, count); }
+
+    int availableForWrite() { return stm32l4_usbd_midi_space(); }
+    size_t write(uint32_t event) { return stm32l4_usbd_midi_transmit(&event, 1); }
+    size_t write(const uint32_t *events, size_t count) { return stm32l4_usbd_midi_transmit(events, count); }
+    void flush() { stm32l4_usbd_midi_flush(); }
+
+    size_t noteOn(uint8_t channel, uint8_t note, uint8_t velocity) { return message(0x90, channel, note, velocity); }
+    size_t noteOff(uint8_t channel, uint8_t note, uint8_t velocity = 0) { return message(0x80, channel, note, velocity); }
+    size_t controlChange(uint8_t channel, uint8_t control, uint8_t value) { return message(0xb0, channel, control, value); }
+    size_t programChange(uint8_t channel, uint8_t program) { return message(0xc0, channel, program, 0); }
+    size_t pitchBend(uint8_t channel, int value);   // -8192 .. 8191
+
+    void onReceive(void(*callback)(void));
+
+private:
+    bool _enabled;
+    void (*_receiveCallback)(void);
+    armv7m_pendsv_job_t _receiveJob;
+
+    size_t message(uint8_t status, uint8_t channel, uint8_t data1, uint8_t data2) {
+	return write(USBD_MIDI_EVENT(0, status >> 4, status | ((channel - 1) & 15), data1 & 0x7f, data2 & 0x7f));
+    }
+
+    void event(uint32_t events);
+
+    static void _eventCallback(void *context, uint32_t events);
+};
+
+extern USBMIDIClass USBMIDI;
+
+#endif // _USBMIDI_H_INCLUDED
@@ -0,0 +1,62 @@
+/*
+  FirmwareUpdate
+
+  Receives a new sketch over the raw WebUSB bulk endpoint into DOSFS (SD
+  card or SPI flash) and installs it with STM32.firmwareUpdate(). Upload
+  the ".iap" file of the build (next to the ".dfu" file, "Export compiled
+  Binary") as "/FIRMWARE.IAP". Only the flash pages that changed are
+  rewritten, which takes a few seconds, then the new sketch starts.
+  Requires the "Serial + WebUSB" USB type.
+
+  The file could just as well be copied over USB Mass Storage.
+
+  This example code is in the public domain.
+*/
+
+#include <FS.h>
+#include <WebUSBUpload.h>
+
+// Two 8kB blocks
+uint32_t buffer[16384 / 4];
+
+WebUSBUploadClass upload(buffer, sizeof(buffer));
+
+unsigned int state = WEBUSB_UPLOAD_STATE_IDLE;
+
+void setup()
+{
+  Serial.begin(9600);
+
+  if (!DOSFS.begin()) {
+    Serial.println("DOSFS.begin() failed");
+    return;
+  }
+
+  upload.begin();
+}
+
+void loop()
+{
+  upload.update();
+
+  if (upload.state() != state) {
+    state = upload.state();
+
+    if ((state == WEBUSB_UPLOAD_STATE_DONE) && !strcmp(upload.path(), "/FIRMWARE.IAP")) {
+      Serial.println("Installing /FIRMWARE.IAP");
+      Serial.flush();
+
+      // Only returns if the image was not accepted
+      STM32.firmwareUpdate("/FIRMWARE.IAP");
+
+      Serial.println("Invalid image");
+    }
+
+    if (state == WEBUSB_UPLOAD_STATE_ERROR) {
+      Serial.print("Failed ");
+      Serial.print(upload.path());
+      Serial.print(", error ");
+      Serial.println(upload.error());
+    }
+  }
+}
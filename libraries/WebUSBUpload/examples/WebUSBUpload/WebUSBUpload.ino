@@ -0,0 +1,53 @@
+/*
+  WebUSBUpload
+
+  Receives files from a web page over the raw WebUSB bulk endpoint and
+  stores them in DOSFS (SD card or SPI flash), e.g. fonts or configuration
+  data. Requires the "Serial + WebUSB" USB type. The file name and the
+  state of each upload are printed over Serial.
+
+  This example code is in the public domain.
+*/
+
+#include <FS.h>
+#include <WebUSBUpload.h>
+
+// Two 8kB blocks
+uint32_t buffer[16384 / 4];
+
+WebUSBUploadClass upload(buffer, sizeof(buffer));
+
+unsigned int state = WEBUSB_UPLOAD_STATE_IDLE;
+
+void setup()
+{
+  Serial.begin(9600);
+
+  if (!DOSFS.begin()) {
+    Serial.println("DOSFS.begin() failed");
+    return;
+  }
+
+  upload.begin();
+}
+
+void loop()
+{
+  upload.update();
+
+  if (upload.state() != state) {
+    state = upload.state();
+
+    if (state == WEBUSB_UPLOAD_STATE_DONE) {
+      Serial.print("Received ");
+      Serial.println(upload.path());
+    }
+
+    if (state == WEBUSB_UPLOAD_STATE_ERROR) {
+      Serial.print("Failed ");
+      Serial.print(upload.path());
+      Serial.print(", error ");
+      Serial.println(upload.error());
+    }
+  }
+}
@@ -0,0 +1,257 @@
+/*
+ * Copyright (c) 2017 Thomas Roell.  All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal with the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ *  1. Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimers.
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimers in the
+ *     documentation and/or other materials provided with the distribution.
+ *  3. Neither the name of Thomas Roell, nor the names of its contributors
+ *     may be used to endorse or promote products derived from this Software
+ *     without specific prior written permission.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ * CONTRIBUTORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * WITH THE SOFTWARE.
+ */
+
+#include "Arduino.h"
+#include "WebUSBUpload.h"
+
+#define REQUEST_NONE   0
+#define REQUEST_OPEN   1
+#define REQUEST_ABORT  2
+
+WebUSBUploadClass::WebUSBUploadClass(void *buffer, size_t size)
+{
+    _data = (uint8_t*)buffer;
+    _size = (size / 2) & ~63;
+    _block[0] = _data;
+    _block[1] = _data + _size;
+    _count[0] = 0;
+    _count[1] = 0;
+    _head = 0;
+    _state = WEBUSB_UPLOAD_STATE_IDLE;
+    _error = WEBUSB_UPLOAD_ERROR_NONE;
+    _request = REQUEST_NONE;
+    _length = 0;
+    _received = 0;
+    _written = 0;
+    _path[0] = '\0';
+}
+
+bool WebUSBUploadClass::begin()
+{
+    if (_size == 0) {
+	return false;
+    }
+
+    return stm32l4_usbd_webusb_raw_enable(_block[0], _block[1], _size, WebUSBUploadClass::_blockCallback, WebUSBUploadClass::_requestCallback, (void*)this);
+}
+
+void WebUSBUploadClass::end()
+{
+    stm32l4_usbd_webusb_raw_disable();
+
+    if (_file) {
+	_file.close();
+    }
+
+    _count[0] = 0;
+    _count[1] = 0;
+    _head = 0;
+    _request = REQUEST_NONE;
+    _state = WEBUSB_UPLOAD_STATE_IDLE;
+}
+
+void WebUSBUploadClass::fail(uint8_t error)
+{
+    if (_file) {
+	_file.close();
+
+	DOSFS.remove(_path);
+    }
+
+    _error = error;
+    _state = WEBUSB_UPLOAD_STATE_ERROR;
+}
+
+void WebUSBUploadClass::complete()
+{
+    uint8_t *block;
+    uint32_t count;
+
+    // Blocks arrive (and get released) strictly alternating, so _head is
+    // always the older of two full blocks.
+    while ((count = _count[_head])) {
+	block = _block[_head];
+
+	if (_file) {
+	    if (_file.write(block, count) != count) {
+		fail(WEBUSB_UPLOAD_ERROR_WRITE);
+	    } else {
+		_written += count;
+	    }
+	}
+
+	_count[_head] = 0;
+	_head ^= 1;
+
+	stm32l4_usbd_webusb_raw_release(block);
+    }
+}
+
+void WebUSBUploadClass::update()
+{
+    uint8_t request;
+
+    request = _request;
+
+    if (request != REQUEST_NONE) {
+	_request = REQUEST_NONE;
+
+	if (request == REQUEST_ABORT) {
+	    if (_file) {
+		_file.close();
+
+		DOSFS.remove(_path);
+	    }
+
+	    complete();
+
+	    _state = WEBUSB_UPLOAD_STATE_IDLE;
+	}
+
+	if (request == REQUEST_OPEN) {
+	    if (_file) {
+		_file.close();
+	    }
+
+	    if (_length) {
+		_file = DOSFS.preallocate(_path, _length);
+	    } else {
+		_file = DOSFS.open(_path, "w");
+	    }
+
+	    if (!_file) {
+		fail(WEBUSB_UPLOAD_ERROR_OPEN);
+	    } else {
+		_state = WEBUSB_UPLOAD_STATE_RECEIVING;
+	    }
+	}
+    }
+
+    complete();
+
+    if ((_state == WEBUSB_UPLOAD_STATE_CLOSING) && !_count[_head]) {
+	if ((_received != _length) || (_written != _length)) {
+	    fail(WEBUSB_UPLOAD_ERROR_SIZE);
+	} else {
+	    _file.close();
+
+	    _state = WEBUSB_UPLOAD_STATE_DONE;
+	}
+    }
+}
+
+void WebUSBUploadClass::_blockCallback(void *context, uint8_t *data, uint32_t count)
+{
+    WebUSBUploadClass *self = reinterpret_cast<class WebUSBUploadClass*>(context);
+    unsigned int index = (data == self->_block[1]);
+
+    if ((self->_state != WEBUSB_UPLOAD_STATE_RECEIVING) && (self->_state != WEBUSB_UPLOAD_STATE_CLOSING)) {
+	if (self->_state != WEBUSB_UPLOAD_STATE_ERROR) {
+	    self->_error = WEBUSB_UPLOAD_ERROR_PROTOCOL;
+	    self->_state = WEBUSB_UPLOAD_STATE_ERROR;
+	}
+
+	stm32l4_usbd_webusb_raw_release(data);
+	return;
+    }
+
+    self->_received += count;
+
+    if (self->_received > self->_length) {
+	// Keep the block, so update() can fail() the transfer in thread context.
+	self->_state = WEBUSB_UPLOAD_STATE_CLOSING;
+    }
+
+    self->_count[index] = count;
+
+    loopWakeup();
+}
+
+void WebUSBUploadClass::_requestCallback(void *context, uint8_t request, uint8_t *data, uint32_t length)
+{
+    WebUSBUploadClass *self = reinterpret_cast<class WebUSBUploadClass*>(context);
+    WebUSBUploadStatus status;
+    uint32_t index;
+
+    switch (request) {
+    case WEBUSB_UPLOAD_REQUEST_OPEN:
+	if ((length < 5) ||
+	    (self->_state == WEBUSB_UPLOAD_STATE_OPENING) ||
+	    (self->_state == WEBUSB_UPLOAD_STATE_RECEIVING) ||
+	    (self->_state == WEBUSB_UPLOAD_STATE_CLOSING) ||
+	    self->_count[0] || self->_count[1]) {
+	    self->_error = WEBUSB_UPLOAD_ERROR_PROTOCOL;
+	    break;
+	}
+
+	self->_length = ((uint32_t)data[0] << 0) | ((uint32_t)data[1] << 8) | ((uint32_t)data[2] << 16) | ((uint32_t)data[3] << 24);
+
+	for (index = 0; (index < (length - 4)) && (index < (F_MAXPATH -1)) && data[4 + index]; index++) {
+	    self->_path[index] = data[4 + index];
+	}
+
+	self->_path[index] = '\0';
+
+	self->_received = 0;
+	self->_written = 0;
+	self->_error = WEBUSB_UPLOAD_ERROR_NONE;
+	self->_state = WEBUSB_UPLOAD_STATE_OPENING;
+	self->_request = REQUEST_OPEN;
+
+	loopWakeup();
+	break;
+
+    case WEBUSB_UPLOAD_REQUEST_STATUS:
+	status.state = self->_state;
+	status.error = self->_error;
+	status.reserved = 0;
+	status.size = self->_length;
+	status.received = self->_received;
+	status.written = self->_written;
+
+	memcpy(data, &status, (length < sizeof(status)) ? length : sizeof(status));
+	break;
+
+    case WEBUSB_UPLOAD_REQUEST_CLOSE:
+	if (self->_state == WEBUSB_UPLOAD_STATE_RECEIVING) {
+	    self->_state = WEBUSB_UPLOAD_STATE_CLOSING;
+
+	    loopWakeup();
+	}
+	break;
+
+    case WEBUSB_UPLOAD_REQUEST_ABORT:
+	self->_request = REQUEST_ABORT;
+
+	loopWakeup();
+	break;
+
+    default:
+	break;
+    }
+}
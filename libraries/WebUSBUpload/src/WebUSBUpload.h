@@ -0,0 +1,123 @@
+/*
+ * Copyright (c) 2017 Thomas Roell.  All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal with the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ *  1. Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimers.
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimers in the
+ *     documentation and/or other materials provided with the distribution.
+ *  3. Neither the name of Thomas Roell, nor the names of its contributors
+ *     may be used to endorse or promote products derived from this Software
+ *     without specific prior written permission.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ * CONTRIBUTORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * WITH THE SOFTWARE.
+ */
+
+#ifndef _WEBUSBUPLOAD_H_INCLUDED
+#define _WEBUSBUPLOAD_H_INCLUDED
+
+#include <Arduino.h>
+#include <FS.h>
+
+// Vendor requests (bmRequestType 0x41/0xc1, wIndex = WebUSB interface)
+#define WEBUSB_UPLOAD_REQUEST_OPEN     0x50   // OUT: uint32_t size, path (NUL terminated)
+#define WEBUSB_UPLOAD_REQUEST_STATUS   0x51   // IN:  WebUSBUploadStatus
+#define WEBUSB_UPLOAD_REQUEST_CLOSE    0x52   // no data
+#define WEBUSB_UPLOAD_REQUEST_ABORT    0x53   // no data
+
+#define WEBUSB_UPLOAD_STATE_IDLE       0
+#define WEBUSB_UPLOAD_STATE_OPENING    1
+#define WEBUSB_UPLOAD_STATE_RECEIVING  2
+#define WEBUSB_UPLOAD_STATE_CLOSING    3
+#define WEBUSB_UPLOAD_STATE_DONE       4
+#define WEBUSB_UPLOAD_STATE_ERROR      5
+
+#define WEBUSB_UPLOAD_ERROR_NONE       0
+#define WEBUSB_UPLOAD_ERROR_OPEN       1   // path could not be created, or not enough space
+#define WEBUSB_UPLOAD_ERROR_WRITE      2
+#define WEBUSB_UPLOAD_ERROR_SIZE       3   // more or less data than announced by OPEN
+#define WEBUSB_UPLOAD_ERROR_PROTOCOL   4   // data without OPEN, or OPEN while busy
+
+// Little endian, as returned by WEBUSB_UPLOAD_REQUEST_STATUS
+struct WebUSBUploadStatus {
+    uint8_t  state;
+    uint8_t  error;
+    uint16_t reserved;
+    uint32_t size;       // as announced by OPEN
+    uint32_t received;   // bytes received over the bulk OUT endpoint
+    uint32_t written;    // bytes written to the file
+} __attribute__((packed));
+
+// Raw WebUSB upload of files into DOSFS.
+//
+// begin() switches the WebUSB bulk OUT endpoint from WebUSBSerial into raw
+// mode: each bulk transfer is received (by the USB hardware, without per
+// byte handling) as one block into one half of "buffer", while the other
+// half is written to the file by update(). "size" / 2 is the block size;
+// it has to be a multiple of 64, and ideally of the DOSFS cluster size so
+// that f_write() gets whole clusters. While both blocks are in use the
+// endpoint NAKs the host, which is all the flow control there is.
+//
+// Host side protocol:
+//
+//   1. OPEN with the file size and path, then poll STATUS till the state
+//      is RECEIVING (the file gets preallocated, which takes a while).
+//   2. transferOut() the content, preferably in chunks of the block size
+//      (a short packet ends a block, so smaller chunks work but waste
+//      buffer space).
+//   3. CLOSE, then poll STATUS till the state is DONE (or ERROR).
+//
+// ABORT closes and removes a partially written file at any time.
+//
+// update() does all the DOSFS work and has to be called from loop(). It
+// calls loopWakeup() whenever there is work, so it works with loopMode().
+class WebUSBUploadClass
+{
+public:
+    WebUSBUploadClass(void *buffer, size_t size);
+
+    bool begin();
+    void end();
+
+    void update();
+
+    unsigned int state() { return _state; }
+    unsigned int error() { return _error; }
+    const char *path() { return _path; }
+
+private:
+    uint8_t *_data;
+    uint32_t _size;
+    File _file;
+    volatile uint8_t _state;
+    volatile uint8_t _error;
+    volatile uint8_t _request;
+    uint8_t *_block[2];
+    volatile uint32_t _count[2];
+    uint8_t _head;
+    uint32_t _length;
+    volatile uint32_t _received;
+    volatile uint32_t _written;
+    char _path[F_MAXPATH];
+
+    void fail(uint8_t error);
+    void complete();
+
+    static void _blockCallback(void *context, uint8_t *data, uint32_t count);
+    static void _requestCallback(void *context, uint8_t request, uint8_t *data, uint32_t length);
+};
+
+#endif // _WEBUSBUPLOAD_H_INCLUDED
@@ -39,12 +39,25 @@ TwoWire::TwoWire(struct _stm32l4_i2c_t *i2c, unsigned int instance, const struct
 
     stm32l4_i2c_create(i2c, instance, pins, priority, mode);
 
+    _rx_data = &_rx_buffer[0];
+    _rx_size = BUFFER_LENGTH;
     _rx_read = 0;
     _rx_write = 0;
 
+    _tx_data = &_tx_buffer[0];
+    _tx_size = BUFFER_LENGTH;
     _tx_write = 0;
     _tx_active = false;
 
+    _xf_read = 0;
+    _xf_write = 0;
+    _xf_count = 0;
+
+    _reg_data = NULL;
+    _reg_size = 0;
+    _reg_mask = NULL;
+    _reg_pointer = 0;
+
     _completionCallback = NULL;
     _requestCallback = NULL;
     _receiveCallback = NULL;
@@ -61,7 +74,57 @@ void TwoWire::begin(uint8_t address)
 {
     _option = I2C_OPTION_RESET | (address << I2C_OPTION_ADDRESS_SHIFT);
 
-    stm32l4_i2c_enable(_i2c, _clock, _option, TwoWire::_eventCallback, (void*)this, (I2C_EVENT_RECEIVE_REQUEST | I2C_EVENT_RECEIVE_DONE | I2C_EVENT_TRANSMIT_REQUEST));
+    stm32l4_i2c_enable(_i2c, _clock, _option, TwoWire::_eventCallback, (void*)this, (I2C_EVENT_ADDRESS_MATCH | I2C_EVENT_RECEIVE_REQUEST | I2C_EVENT_RECEIVE_DONE | I2C_EVENT_TRANSMIT_REQUEST));
+}
+
+bool TwoWire::setBuffers(uint8_t *rxBuffer, size_t rxSize, uint8_t *txBuffer, size_t txSize)
+{
+    if (_i2c->state != I2C_STATE_INIT) {
+	return false;
+    }
+
+    if ((rxBuffer && ((rxSize == 0) || (rxSize > 65535))) || (txBuffer && ((txSize == 0) || (txSize > 65535)))) {
+	return false;
+    }
+
+    if (rxBuffer) {
+	_rx_data = rxBuffer;
+	_rx_size = rxSize;
+    } else {
+	_rx_data = &_rx_buffer[0];
+	_rx_size = BUFFER_LENGTH;
+    }
+
+    if (txBuffer) {
+	_tx_data = txBuffer;
+	_tx_size = txSize;
+    } else {
+	_tx_data = &_tx_buffer[0];
+	_tx_size = BUFFER_LENGTH;
+    }
+
+    _rx_read = 0;
+    _rx_write = 0;
+
+    return true;
+}
+
+bool TwoWire::setRegisters(uint8_t *registers, size_t size, const uint8_t *writeMask)
+{
+    if (_i2c->state != I2C_STATE_INIT) {
+	return false;
+    }
+
+    if (registers && ((size == 0) || (size > 256))) {
+	return false;
+    }
+
+    _reg_data = registers;
+    _reg_size = registers ? size : 0;
+    _reg_mask = writeMask;
+    _reg_pointer = 0;
+
+    return true;
 }
 
 void TwoWire::setClock(uint32_t clock) 
@@ -78,23 +141,33 @@ void TwoWire::end()
 
 uint8_t TwoWire::requestFrom(uint8_t address, size_t quantity, bool stopBit)
 {
-    if (__get_IPSR() != 0) {
-	return 0;
+    if (quantity > _rx_size) {
+	quantity = _rx_size;
     }
 
-    if (quantity == 0) {
+    quantity = requestFrom(address, _rx_data, quantity, stopBit);
+
+    _rx_read = 0;
+    _rx_write = quantity;
+
+    return quantity;
+}
+
+size_t TwoWire::requestFrom(uint8_t address, uint8_t *buffer, size_t quantity, bool stopBit)
+{
+    if (__get_IPSR() != 0) {
 	return 0;
     }
 
-    if (quantity > BUFFER_LENGTH) {
-	quantity = BUFFER_LENGTH;
+    if ((quantity == 0) || (quantity > 65535)) {
+	return 0;
     }
 
-    while (!stm32l4_i2c_done(_i2c)) {
+    while (_xf_count || !stm32l4_i2c_done(_i2c)) {
 	armv7m_core_yield();
     }
 
-    if (!stm32l4_i2c_receive(_i2c, address, &_rx_data[0], quantity, (stopBit ? 0 : I2C_CONTROL_RESTART))) {
+    if (!stm32l4_i2c_receive(_i2c, address, buffer, quantity, (stopBit ? 0 : I2C_CONTROL_RESTART))) {
 	return 0;
     }    
 
@@ -106,9 +179,6 @@ uint8_t TwoWire::requestFrom(uint8_t address, size_t quantity, bool stopBit)
 	return 0;
     }
 
-    _rx_read = 0;
-    _rx_write = quantity;
-
     return quantity;
 }
 
@@ -137,7 +207,7 @@ uint8_t TwoWire::endTransmission(bool stopBit)
 	return 4;
     }
 
-    while (!stm32l4_i2c_done(_i2c)) {
+    while (_xf_count || !stm32l4_i2c_done(_i2c)) {
 	armv7m_core_yield();
     }
 
@@ -178,7 +248,7 @@ size_t TwoWire::write(uint8_t data)
 	return 0;
     }
 
-    if (_tx_write >= BUFFER_LENGTH) {
+    if (_tx_write >= _tx_size) {
 	return 0;
     }
 
@@ -189,20 +259,18 @@ size_t TwoWire::write(uint8_t data)
 
 size_t TwoWire::write(const uint8_t *data, size_t quantity)
 {
-    size_t count;
-
     if (!_tx_active) {
 	return 0;
     }
 
-    for (count = 0; count < quantity; count++) {
-	if (_tx_write >= BUFFER_LENGTH) {
-	    return count;
-	}
-
-	_tx_data[_tx_write++] = *data++;
+    if (quantity > (size_t)(_tx_size - _tx_write)) {
+	quantity = _tx_size - _tx_write;
     }
 
+    memcpy(&_tx_data[_tx_write], data, quantity);
+
+    _tx_write += quantity;
+
     return quantity;
 }
 
@@ -229,14 +297,30 @@ int TwoWire::peek(void)
     return _rx_data[_rx_read];
 }
 
+size_t TwoWire::peekBuffer(const uint8_t **ptr)
+{
+    *ptr = &_rx_data[_rx_read];
+
+    return (_rx_write - _rx_read);
+}
+
+void TwoWire::consume(size_t size)
+{
+    if (size > (size_t)(_rx_write - _rx_read)) {
+	size = (_rx_write - _rx_read);
+    }
+
+    _rx_read += size;
+}
+
 void TwoWire::flush(void)
 {
     if (armv7m_core_priority() <= STM32L4_I2C_IRQ_PRIORITY) {
-	while (!stm32l4_i2c_done(_i2c)) {
+	while (_xf_count || !stm32l4_i2c_done(_i2c)) {
 	    stm32l4_i2c_poll(_i2c);
 	}
     } else {
-	while (!stm32l4_i2c_done(_i2c)) {
+	while (_xf_count || !stm32l4_i2c_done(_i2c)) {
 	    armv7m_core_yield();
 	}
     }
@@ -253,11 +337,11 @@ uint8_t TwoWire::transfer(uint8_t address, const uint8_t *txBuffer, size_t txSiz
 	return 4;
     }
 
-    if ((txSize > 1024) || (rxSize > 1024))  {
+    if ((txSize > 65535) || (rxSize > 65535))  {
 	return 4;
     }
 
-    while (!stm32l4_i2c_done(_i2c)) {
+    while (_xf_count || !stm32l4_i2c_done(_i2c)) {
 	armv7m_core_yield();
     }
 
@@ -303,11 +387,11 @@ bool TwoWire::transfer(uint8_t address, const uint8_t *txBuffer, size_t txSize,
 	return false;
     }
 
-    if ((txSize > 1024) || (rxSize > 1024)) {
+    if ((txSize > 65535) || (rxSize > 65535)) {
 	return false;
     }
 
-    if (!stm32l4_i2c_done(_i2c)) {
+    if (_xf_count || !stm32l4_i2c_done(_i2c)) {
 	return false;
     }
 
@@ -335,9 +419,50 @@ bool TwoWire::transfer(uint8_t address, const uint8_t *txBuffer, size_t txSize,
     return true;
 }
 
+bool TwoWire::enqueue(const struct TwoWireTransaction *vec, unsigned int count)
+{
+    unsigned int index, xf_write;
+
+    if ((_i2c->state < I2C_STATE_READY) || (_option & I2C_OPTION_ADDRESS_MASK)) {
+	return false;
+    }
+
+    if ((count == 0) || (count > (WIRE_TRANSACTION_QUEUE_SIZE - _xf_count))) {
+	return false;
+    }
+
+    for (index = 0; index < count; index++) {
+	if (!(vec[index].txSize || vec[index].rxSize)) {
+	    return false;
+	}
+    }
+
+    // Queued transactions and direct transfers do not overlap.
+    if (!_xf_count && !stm32l4_i2c_done(_i2c)) {
+	return false;
+    }
+
+    xf_write = _xf_write;
+
+    for (index = 0; index < count; index++) {
+	_xf_queue[xf_write] = vec[index];
+
+	xf_write = (xf_write + 1) & (WIRE_TRANSACTION_QUEUE_SIZE -1);
+    }
+
+    _xf_write = xf_write;
+
+    // If a transaction is in flight, EventCallback() starts the next one.
+    if (armv7m_atomic_add(&_xf_count, count) == 0) {
+	transactionStart();
+    }
+
+    return true;
+}
+
 bool TwoWire::done(void)
 {
-    return stm32l4_i2c_done(_i2c);
+    return (!_xf_count && stm32l4_i2c_done(_i2c));
 }
 
 uint8_t TwoWire::status(void)
@@ -387,6 +512,12 @@ void TwoWire::EventCallback(uint32_t events)
     void(*callback)(uint8_t);
 
     if (_option & I2C_OPTION_ADDRESS_MASK) {
+	if (_reg_data) {
+	    RegisterCallback(events);
+
+	    return;
+	}
+
 	if (events & I2C_EVENT_RECEIVE_DONE) {
 	    _rx_read = 0;
 	    _rx_write = stm32l4_i2c_count(_i2c);
@@ -395,11 +526,11 @@ void TwoWire::EventCallback(uint32_t events)
 		(*_receiveCallback)(_rx_write);
 	    }
       
-	    stm32l4_i2c_service(_i2c, &_rx_data[0], BUFFER_LENGTH);
+	    stm32l4_i2c_service(_i2c, &_rx_data[0], _rx_size);
 	}
     
 	if (events & I2C_EVENT_RECEIVE_REQUEST) {
-	    stm32l4_i2c_service(_i2c, &_rx_data[0], BUFFER_LENGTH);
+	    stm32l4_i2c_service(_i2c, &_rx_data[0], _rx_size);
 	}
     
 	if (events & I2C_EVENT_TRANSMIT_REQUEST) {
@@ -413,28 +544,145 @@ void TwoWire::EventCallback(uint32_t events)
 	}
     } else {
 	if (events & (I2C_EVENT_ADDRESS_NACK | I2C_EVENT_DATA_NACK | I2C_EVENT_ARBITRATION_LOST | I2C_EVENT_BUS_ERROR | I2C_EVENT_OVERRUN | I2C_EVENT_RECEIVE_DONE | I2C_EVENT_TRANSMIT_DONE | I2C_EVENT_TRANSFER_DONE)) {
-	    callback = _completionCallback;
-	    _completionCallback = NULL;
+	    if (!(events & (I2C_EVENT_ADDRESS_NACK | I2C_EVENT_DATA_NACK | I2C_EVENT_ARBITRATION_LOST | I2C_EVENT_BUS_ERROR | I2C_EVENT_OVERRUN))) {
+		status = 0;
+	    } else {
+		if (events & I2C_EVENT_ADDRESS_NACK) {
+		    status = 2;
+		} else if (events & I2C_EVENT_DATA_NACK) {
+		    status = 3;
+		} else {
+		    status = 4;
+		}
+	    } 
+
+	    if (_xf_count) {
+		// Start the next queued transaction before running the callback,
+		// so that the bus stays busy back-to-back.
+		callback = _xf_queue[_xf_read].callback;
+
+		_xf_read = (_xf_read + 1) & (WIRE_TRANSACTION_QUEUE_SIZE -1);
+
+		if (armv7m_atomic_sub(&_xf_count, 1) != 1) {
+		    transactionStart();
+		}
+	    } else {
+		callback = _completionCallback;
+		_completionCallback = NULL;
+	    }
 
 	    if (callback) {
-		if (!(events & (I2C_EVENT_ADDRESS_NACK | I2C_EVENT_DATA_NACK | I2C_EVENT_ARBITRATION_LOST | I2C_EVENT_BUS_ERROR | I2C_EVENT_OVERRUN))) {
-		    status = 0;
-		} else {
-		    if (events & I2C_EVENT_ADDRESS_NACK) {
-			status = 2;
-		    } else if (events & I2C_EVENT_DATA_NACK) {
-			status = 3;
-		    } else {
-			status = 4;
-		    }
-		} 
-	
 		(*callback)(status);
 	    }
 	}
     }
 }
 
+void TwoWire::transactionStart()
+{
+    const struct TwoWireTransaction *transaction;
+    void(*callback)(uint8_t);
+    uint32_t control;
+    bool success;
+
+    do {
+	transaction = &_xf_queue[_xf_read];
+
+	// The driver only reprograms TIMINGR if the clock differs from the
+	// previous transfer, so back-to-back transactions to the same device
+	// do not pay for the switch.
+	if (transaction->clock == 0) {
+	    control = I2C_CONTROL_CLOCK_DEFAULT;
+	} else if (transaction->clock >= I2C_CLOCK_1000) {
+	    control = I2C_CONTROL_CLOCK_1000;
+	} else if (transaction->clock >= I2C_CLOCK_400) {
+	    control = I2C_CONTROL_CLOCK_400;
+	} else if (transaction->clock >= I2C_CLOCK_100) {
+	    control = I2C_CONTROL_CLOCK_100;
+	} else {
+	    control = I2C_CONTROL_CLOCK_10;
+	}
+
+	if (transaction->rxSize) {
+	    if (transaction->txSize) {
+		success = stm32l4_i2c_transfer(_i2c, transaction->address, transaction->txBuffer, transaction->txSize, transaction->rxBuffer, transaction->rxSize, control);
+	    } else {
+		success = stm32l4_i2c_receive(_i2c, transaction->address, transaction->rxBuffer, transaction->rxSize, control);
+	    }
+	} else {
+	    success = stm32l4_i2c_transmit(_i2c, transaction->address, transaction->txBuffer, transaction->txSize, control);
+	}
+
+	if (success) {
+	    return;
+	}
+
+	callback = transaction->callback;
+
+	_xf_read = (_xf_read + 1) & (WIRE_TRANSACTION_QUEUE_SIZE -1);
+
+	if (callback) {
+	    (*callback)(4);
+	}
+    } while (armv7m_atomic_sub(&_xf_count, 1) != 1);
+}
+
+// Register file slave mode. A master write starts with the register
+// pointer, followed by data bytes stored at (and advancing) the pointer if
+// "writeMask" allows it. A master read is served straight out of the
+// register file from the pointer onwards, padded with 0xff past its end.
+// Received bytes come in one at a time, as the I2C peripheral interrupts
+// per byte in slave mode anyway.
+void TwoWire::RegisterCallback(uint32_t events)
+{
+    static const uint8_t filler = 0xff;
+    unsigned int pointer;
+
+    if (events & I2C_EVENT_ADDRESS_MATCH) {
+	_reg_state = REGISTER_STATE_POINTER;
+	_reg_written = 0;
+    }
+
+    if (events & I2C_EVENT_RECEIVE_REQUEST) {
+	if (!(events & I2C_EVENT_ADDRESS_MATCH)) {
+	    if (_reg_state == REGISTER_STATE_POINTER) {
+		_reg_pointer = _reg_byte;
+		_reg_state = REGISTER_STATE_DATA;
+	    } else {
+		pointer = _reg_pointer;
+
+		if (pointer < _reg_size) {
+		    if (_reg_mask && (_reg_mask[pointer >> 3] & (1 << (pointer & 7)))) {
+			_reg_data[pointer] = _reg_byte;
+
+			_reg_written++;
+		    }
+
+		    _reg_pointer = pointer +1;
+		}
+	    }
+	}
+
+	stm32l4_i2c_service(_i2c, &_reg_byte, 1);
+    }
+
+    if (events & I2C_EVENT_RECEIVE_DONE) {
+	if (_reg_written && _receiveCallback) {
+	    (*_receiveCallback)(_reg_written);
+	}
+
+	_reg_written = 0;
+    }
+
+    if (events & I2C_EVENT_TRANSMIT_REQUEST) {
+	if ((events & I2C_EVENT_ADDRESS_MATCH) && (_reg_pointer < _reg_size)) {
+	    stm32l4_i2c_service(_i2c, &_reg_data[_reg_pointer], _reg_size - _reg_pointer);
+	} else {
+	    stm32l4_i2c_service(_i2c, (uint8_t*)&filler, 1);
+	}
+    }
+}
+
 void TwoWire::_eventCallback(void *context, uint32_t events)
 {
     reinterpret_cast<class TwoWire*>(context)->EventCallback(events);
@@ -459,7 +707,7 @@ void TwoWireEx::begin(uint8_t address, TwoWireExPins pins)
 	_option |= I2C_OPTION_ALTERNATE;
     }
 
-    stm32l4_i2c_enable(_i2c, _clock, _option, TwoWire::_eventCallback, (void*)this, (I2C_EVENT_RECEIVE_REQUEST | I2C_EVENT_RECEIVE_DONE | I2C_EVENT_TRANSMIT_REQUEST));
+    stm32l4_i2c_enable(_i2c, _clock, _option, TwoWire::_eventCallback, (void*)this, (I2C_EVENT_ADDRESS_MATCH | I2C_EVENT_RECEIVE_REQUEST | I2C_EVENT_RECEIVE_DONE | I2C_EVENT_TRANSMIT_REQUEST));
 }
 
 #if WIRE_INTERFACES_COUNT > 0
@@ -34,6 +34,24 @@
 
 #define BUFFER_LENGTH 32
 
+#define WIRE_TRANSACTION_QUEUE_SIZE 8
+
+// STM32L4 EXTENSTION: queued transaction, write "txBuffer" (e.g. a register
+// address) and/or read into "rxBuffer", then call "callback(status)" from the
+// I2C interrupt. Each transaction ends with a STOP. "clock" selects the bus
+// clock for this transaction (10000, 100000, 400000 or 1000000, rounded down),
+// 0 uses the one from setClock(). So devices of different speed grades can
+// share a bus, and each one runs at its own maximum rate.
+struct TwoWireTransaction {
+    uint8_t address;
+    const uint8_t *txBuffer;
+    uint16_t txSize;
+    uint8_t *rxBuffer;
+    uint16_t rxSize;
+    void (*callback)(uint8_t status);
+    uint32_t clock;
+};
+
  // WIRE_HAS_END means Wire has end()
 #define WIRE_HAS_END 1
 
@@ -51,6 +69,13 @@ public:
 
     uint8_t requestFrom(uint8_t address, size_t quantity, bool stopBit = true);
 
+    // STM32L4 EXTENSTION: receive "quantity" bytes (up to 65535) straight into "buffer"
+    size_t requestFrom(uint8_t address, uint8_t *buffer, size_t quantity, bool stopBit = true);
+
+    // STM32L4 EXTENSTION: replace the internal BUFFER_LENGTH receive/transmit buffers
+    // (NULL keeps the internal one), has to be called before begin()
+    bool setBuffers(uint8_t *rxBuffer, size_t rxSize, uint8_t *txBuffer, size_t txSize);
+
     size_t write(uint8_t data);
     size_t write(const uint8_t *buffer, size_t quantity);
 
@@ -58,6 +83,12 @@ public:
     int read(void);
     int peek(void);
     void flush(void);
+
+    // STM32L4 EXTENSTION: zero-copy read, "*ptr" is set to the received data not read yet
+    // (the returned number of bytes), which stays valid till released via consume(n)
+    size_t peekBuffer(const uint8_t **ptr);
+    void consume(size_t size);
+
     void onReceive(void(*callback)(int));
     void onRequest(void(*callback)(void));
 
@@ -75,6 +106,18 @@ public:
     bool done(void);
     uint8_t status(void);
 
+    // STM32L4 EXTENSTION: append "count" transactions to the queue (all or none). The
+    // queue is run back-to-back from the I2C interrupt. Direct transfers wait for it
+    // to drain.
+    bool enqueue(const struct TwoWireTransaction *vec, unsigned int count);
+
+    // STM32L4 EXTENSTION: register file slave mode (up to 256 registers, 8 bit pointer), has to
+    // be called before begin(address). "registers" is read and written directly from the I2C
+    // interrupt, "writeMask" has
+    // one bit per register (LSB first) that allows master writes (NULL for read-only).
+    // onReceive(), if set, gets called with the number of registers written.
+    bool setRegisters(uint8_t *registers, size_t size, const uint8_t *writeMask = NULL);
+
     // STM32L4 EXTENSTION: isEnabled() check
     bool isEnabled(void);
 
@@ -86,21 +129,44 @@ private:
     uint32_t _clock;
     uint32_t _option;
 
-    uint8_t _rx_data[BUFFER_LENGTH];
-    uint8_t _rx_read;
-    uint8_t _rx_write;
+    uint8_t *_rx_data;
+    uint16_t _rx_size;
+    uint16_t _rx_read;
+    uint16_t _rx_write;
 
-    uint8_t _tx_data[BUFFER_LENGTH];
-    uint8_t _tx_write;
+    uint8_t *_tx_data;
+    uint16_t _tx_size;
+    uint16_t _tx_write;
     uint8_t _tx_address;
     bool _tx_active;
 
+    struct TwoWireTransaction _xf_queue[WIRE_TRANSACTION_QUEUE_SIZE];
+    volatile uint8_t _xf_read;
+    volatile uint8_t _xf_write;
+    volatile uint32_t _xf_count;
+
+    uint8_t _rx_buffer[BUFFER_LENGTH];
+    uint8_t _tx_buffer[BUFFER_LENGTH];
+
+    uint8_t *_reg_data;
+    uint16_t _reg_size;
+    const uint8_t *_reg_mask;
+    volatile uint16_t _reg_pointer;
+    uint16_t _reg_written;
+    uint8_t _reg_state;
+    uint8_t _reg_byte;
+
     void (*_completionCallback)(uint8_t);
     void (*_requestCallback)(void);
     void (*_receiveCallback)(int);
 
     static void _eventCallback(void *context, uint32_t events);
     void EventCallback(uint32_t events);
+    void transactionStart();
+    void RegisterCallback(uint32_t events);
+
+    static const uint8_t REGISTER_STATE_POINTER = 0;
+    static const uint8_t REGISTER_STATE_DATA = 1;
 
     static const uint32_t TWI_CLOCK = 100000;
 
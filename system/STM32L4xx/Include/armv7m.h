@@ -30,13 +30,51 @@
 #define _ARMV7M_H
 
 #include <stdint.h>
+#include <stdbool.h>
 
 #ifdef __cplusplus
  extern "C" {
 #endif
 
+/* Code and data that should not see flash wait states (e.g. hot interrupt handlers and DSP
+ * kernels). The linker script places ".fastcode" and ".fastdata" into SRAM2 where the
+ * variant has a separate SRAM2 region, and into SRAM1 otherwise. Both are copied from flash
+ * at startup. Calls between flash and SRAM are out of BL range, hence "long_call".
+ */
+#define __fastcode __attribute__((section(".fastcode"), long_call, noinline))
+#define __fastdata __attribute__((section(".fastdata")))
+
+/* Large buffers whose contents are rebuilt before use (caches, shadows, staging areas).
+ * They go into ".noinit" (in SRAM1), which the startup code neither copies nor clears,
+ * so they do not add to the time spent zeroing ".bss" at reset. The contents are
+ * undefined until the owner fills them in.
+ */
+#define __noinit __attribute__((section(".noinit")))
+
+/* Hot paths that are compiled for speed, whatever -O level the sketch is built with (the
+ * "Optimize" menu). Unlike a per file option the attribute is kept through LTO.
+ */
+#define __optimize_speed __attribute__((optimize("O3")))
+
+/* Wait primitives for drivers. armv7m_core_yield() is for a condition signaled by an interrupt
+ * and waits for the next event. armv7m_core_relax() is for a condition that has to be polled
+ * (e.g. a busy SD card), so it returns right away.
+ *
+ * If set, both call "armv7m_core_yield_callback" instead, so that a cooperative scheduler can
+ * run other tasks while a driver is blocking. With "wait" set the callback has to fall back to
+ * the event wait itself if there is nothing else to run.
+ */
+extern void (* volatile armv7m_core_yield_callback)(bool wait);
+
 static inline void armv7m_core_yield(void)
 {
+    if (armv7m_core_yield_callback)
+    {
+	(*armv7m_core_yield_callback)(true);
+
+	return;
+    }
+
     /* This odd aequence seems to be required for at least STM32L4. Traces on the logic analyzer
      * showed that after blocking on wfe, then the subsequent wfe would not block. The only WAR
      * is to explicitly clear the EVENT flag via the SEV; WFE sequence.
@@ -44,15 +82,95 @@ static inline void armv7m_core_yield(void)
     __asm__ volatile ("wfe; sev; wfe");
 }
 
+static inline void armv7m_core_relax(void)
+{
+    if (armv7m_core_yield_callback)
+    {
+	(*armv7m_core_yield_callback)(false);
+    }
+}
+
+/* Priority aware critical sections. armv7m_critical_enter() masks via BASEPRI all interrupts with
+ * a priority of "priority" or lower urgency (numerically >= "priority"), while more urgent ones
+ * stay live. It never lowers a mask that is already in place, so sections nest. "priority" is
+ * 1 .. 15 (0 would mean no masking), and the return value is passed to armv7m_critical_leave().
+ *
+ * A section has to mask the highest priority at which the data it protects is accessed, which
+ * is the "priority ceiling" that a driver documents for its API. Interrupts above the ceiling
+ * must not call into that API, but are never blocked by its bookkeeping.
+ */
+static inline uint32_t armv7m_critical_enter(unsigned int priority)
+{
+    uint32_t basepri;
+
+    __asm__ volatile ("mrs %0, basepri" : "=r" (basepri));
+    __asm__ volatile ("msr basepri_max, %0" : : "r" (priority << 4) : "memory");
+
+    return basepri;
+}
+
+static inline void armv7m_critical_leave(uint32_t basepri)
+{
+    __asm__ volatile ("msr basepri, %0" : : "r" (basepri) : "memory");
+}
+
 extern int armv7m_core_priority(void);
 extern void armv7m_core_udelay(uint32_t udelay);
 
+/* FP context handling on exception entry (FPCCR.ASPEN/LSPEN).
+ *
+ * LAZY (the reset default) reserves space for S0-S15/FPSCR on the stack if the interrupted
+ * code had an FP context, but only saves the registers once the handler executes its first
+ * FP instruction. Entry is fast for handlers that do not touch the FPU, and ~17 cycles
+ * slower (at an unpredictable point) for those that do.
+ *
+ * EAGER always saves the registers on entry from an FP context. The extra cost is constant,
+ * which may be easier to budget if most handlers use floats anyway.
+ *
+ * NONE disables automatic FP state preservation. It is only safe if no interrupt handler
+ * (including PendSV and timer callbacks) uses the FPU, and cannot be used with Orchid.
+ */
+#define ARMV7M_CORE_FPU_MODE_LAZY      0
+#define ARMV7M_CORE_FPU_MODE_EAGER     1
+#define ARMV7M_CORE_FPU_MODE_NONE      2
+
+extern void armv7m_core_fpu_configure(unsigned int mode);
+
+/* With ARMV7M_CORE_FPU_STATISTICS set, PendSV routines and stm32l4_timer callbacks are
+ * bracketed by armv7m_core_fpu_enter()/armv7m_core_fpu_leave(). In LAZY mode "pending"
+ * counts the callbacks that were entered with a lazy FP save outstanding, and "saves" the
+ * ones of those that triggered it (i.e. paid for the FP context save). A save triggered by a
+ * nested handler is attributed to the callback it preempted.
+ */
+#if !defined(ARMV7M_CORE_FPU_STATISTICS)
+#define ARMV7M_CORE_FPU_STATISTICS 0
+#endif
+
+extern uint32_t armv7m_core_fpu_enter(void);
+extern void armv7m_core_fpu_leave(uint32_t state);
+extern void armv7m_core_fpu_statistics(uint32_t *p_pending_return, uint32_t *p_saves_return);
+
+/* Main stack (MSP, i.e. setup()/loop() and all interrupt handlers) and heap usage. The
+ * startup code fills the main stack with ARMV7M_CORE_STACK_FILL, so that the high watermark
+ * can be found by scanning for the first clobbered word. A fully used stack (which includes
+ * an overflow into the heap) returns false. The heap peak is the highest _sbrk() break.
+ *
+ * armv7m_core_stack_guard() places a 32 byte no access MPU region at the bottom of the
+ * main stack, so that an overflow raises a MemManage fault instead of corrupting the heap.
+ */
+#define ARMV7M_CORE_STACK_FILL         0xa5a5a5a5
+
+extern bool armv7m_core_stack_statistics(uint32_t *p_size_return, uint32_t *p_used_return);
+extern void armv7m_core_heap_statistics(uint32_t *p_size_return, uint32_t *p_used_return, uint32_t *p_peak_return);
+extern void armv7m_core_stack_guard(bool enable);
+
 #include "armv7m_atomic.h"
 #include "armv7m_bitband.h"
 #include "armv7m_pendsv.h"
 #include "armv7m_svcall.h"
 #include "armv7m_systick.h"
 #include "armv7m_timer.h"
+#include "armv7m_trace.h"
 
 #ifdef __cplusplus
 }
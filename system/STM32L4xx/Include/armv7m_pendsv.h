@@ -30,16 +30,43 @@
 #define _ARMV7M_PENDSV_H
 
 #include <stdint.h>
+#include <stdbool.h>
 
 #ifdef __cplusplus
  extern "C" {
 #endif
 
-#define ARMV7M_PENDSV_ENTRY_COUNT 32
+#define ARMV7M_PENDSV_ENTRY_COUNT 32     /* per priority, needs to be a power of 2 */
+
+#define ARMV7M_PENDSV_PRIORITY_HIGH  0
+#define ARMV7M_PENDSV_PRIORITY_LOW   1
+#define ARMV7M_PENDSV_PRIORITY_COUNT 2
 
 typedef void (*armv7m_pendsv_routine_t)(void *context, uint32_t data);
 
 extern volatile armv7m_pendsv_routine_t * armv7m_pendsv_enqueue(armv7m_pendsv_routine_t routine, void *context, uint32_t data);
+extern volatile armv7m_pendsv_routine_t * armv7m_pendsv_enqueue_priority(unsigned int priority, armv7m_pendsv_routine_t routine, void *context, uint32_t data);
+extern void armv7m_pendsv_statistics(unsigned int priority, uint32_t *p_dropped_return, uint32_t *p_watermark_return);
+
+/* A job is a registered (routine, context) pair that occupies at most one queue slot. While it
+ * is pending, further posts only or their "data" into the already queued request, so a burst of
+ * posts before PendSV gets to it collapses into a single call that sees the union of all "data".
+ * The job is no longer pending once "routine" gets called, so a post from within "routine" (or
+ * a concurrent one) queues it again; such a call can see a "data" of 0 if the earlier call
+ * already consumed it. armv7m_pendsv_job_post() returns false only if the lane was full.
+ */
+typedef struct _armv7m_pendsv_job_t {
+    armv7m_pendsv_routine_t          routine;
+    void                             *context;
+    uint32_t                         priority;
+    volatile uint32_t                pending;
+    volatile uint32_t                data;
+} armv7m_pendsv_job_t;
+
+#define ARMV7M_PENDSV_JOB_INIT(_routine, _context, _priority) { (_routine), (_context), (_priority), 0, 0 }
+
+extern void armv7m_pendsv_job_create(armv7m_pendsv_job_t *job, armv7m_pendsv_routine_t routine, void *context, unsigned int priority);
+extern bool armv7m_pendsv_job_post(armv7m_pendsv_job_t *job, uint32_t data);
 
 extern void armv7m_pendsv_initialize(void);
 
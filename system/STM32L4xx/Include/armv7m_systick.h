@@ -44,6 +44,23 @@ extern void armv7m_systick_notify(armv7m_systick_callback_t callback, void *cont
 extern void armv7m_systick_initialize(unsigned int priority);
 extern void armv7m_systick_enable(void);
 extern void armv7m_systick_disable(void);
+extern void armv7m_systick_advance(uint32_t millis);
+
+/* Cheap 32 bit time base for short intervals and busy wait timeouts, based upon the
+ * DWT cycle counter (enabled by armv7m_systick_initialize()). armv7m_systick_cycles()
+ * is a single load, the conversions are a UMULL and a shift. Only differences of
+ * cycle counts are meaningful (wrap safe modulo 2^32, i.e. up to 53 seconds at 80MHz).
+ * The counter runs at SYSCLK and stops in SLEEP and STOP, so intervals that span a
+ * clock change, armv7m_core_yield() or __WFI() need armv7m_systick_micros() instead.
+ * armv7m_systick_micros_to_cycles() saturates at 0xffffffff.
+ */
+static inline uint32_t armv7m_systick_cycles(void)
+{
+    return *((volatile uint32_t*)0xe0001004); /* DWT->CYCCNT */
+}
+
+extern uint32_t armv7m_systick_cycles_to_micros(uint32_t cycles);
+extern uint32_t armv7m_systick_micros_to_cycles(uint32_t micros);
 
 extern void SysTick_Handler(void);
 
@@ -44,14 +44,20 @@ struct _armv7m_timer_t {
     armv7m_timer_t                   *next;
     armv7m_timer_t                   *previous;
     volatile armv7m_timer_callback_t callback;
-    uint32_t                         remaining;
+    uint32_t                         deadline;
 };
 
 #define ARMV7M_TIMER_INIT(_callback,_timeout) { NULL, NULL, (_callback), (_timeout) }
 
+/* Number of buckets in the timing wheel, needs to be a power of 2. Timers that
+ * expire within the same millisecond share a bucket and are fired in the same pass.
+ */
+#define ARMV7M_TIMER_WHEEL_SIZE 64
+
 extern void armv7m_timer_create(armv7m_timer_t *timer, armv7m_timer_callback_t callback);
 extern bool armv7m_timer_start(armv7m_timer_t *timer, uint32_t timeout);
 extern bool armv7m_timer_stop(armv7m_timer_t *timer);
+extern bool armv7m_timer_next(uint32_t *p_timeout_return);
 
 extern void armv7m_timer_initialize(void);
 
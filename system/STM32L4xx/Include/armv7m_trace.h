@@ -0,0 +1,125 @@
+/*
+ * Copyright (c) 2017 Thomas Roell.  All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal with the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ *  1. Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimers.
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimers in the
+ *     documentation and/or other materials provided with the distribution.
+ *  3. Neither the name of Thomas Roell, nor the names of its contributors
+ *     may be used to endorse or promote products derived from this Software
+ *     without specific prior written permission.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ * CONTRIBUTORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * WITH THE SOFTWARE.
+ */
+
+#if !defined(_ARMV7M_TRACE_H)
+#define _ARMV7M_TRACE_H
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+ extern "C" {
+#endif
+
+/* Driver event trace. With ARMV7M_TRACE set, the trace points in the SAI, DMA, SPI, SDSPI,
+ * PendSV and USB code record 8 byte events (DWT cycle count, 8 bit id, 24 bit data) into a
+ * lock-free ring of ARMV7M_TRACE_ENTRY_COUNT entries, which a debugger can dump at any time
+ * ("armv7m_trace_control"). If the probe has enabled ITM stimulus port ARMV7M_TRACE_ITM_PORT,
+ * the event word is also streamed over SWO; the ITM local timestamps provide the timing there.
+ * A full stimulus FIFO drops the SWO copy, never the RAM one. A trace point costs about 15
+ * cycles, plus 5 with ITM. Host/armv7m_trace_decode.c decodes both ring dumps and SWO captures.
+ *
+ * Ids 0x80 to 0xff are free for application use via armv7m_trace_event().
+ */
+
+#if !defined(ARMV7M_TRACE)
+#define ARMV7M_TRACE 0
+#endif
+
+#if !defined(ARMV7M_TRACE_ENTRY_COUNT)
+#define ARMV7M_TRACE_ENTRY_COUNT  128    /* needs to be a power of 2 */
+#endif
+
+#define ARMV7M_TRACE_ITM_PORT     1
+
+#define ARMV7M_TRACE_PENDSV_ENTER 0x01   /* data = routine */
+#define ARMV7M_TRACE_PENDSV_LEAVE 0x02
+#define ARMV7M_TRACE_DMA          0x10   /* data = (channel << 8) | events */
+#define ARMV7M_TRACE_SAI          0x20   /* data = (instance << 16) | SR */
+#define ARMV7M_TRACE_SAI_DMA      0x21   /* data = (instance << 16) | events */
+#define ARMV7M_TRACE_SPI_DMA      0x30   /* data = (instance << 16) | events */
+#define ARMV7M_TRACE_SPI_DONE     0x31   /* data = (instance << 16) | events */
+#define ARMV7M_TRACE_SDSPI_CMD    0x40   /* data = command index */
+#define ARMV7M_TRACE_SDSPI_RX     0x41   /* data = count */
+#define ARMV7M_TRACE_SDSPI_TX     0x42   /* data = count */
+#define ARMV7M_TRACE_USB_ENTER    0x50
+#define ARMV7M_TRACE_USB_LEAVE    0x51
+#define ARMV7M_TRACE_USER         0x80
+
+typedef struct _armv7m_trace_entry_t {
+    uint32_t                cycles;
+    uint32_t                event;      /* (id << 24) | data */
+} armv7m_trace_entry_t;
+
+typedef struct _armv7m_trace_control_t {
+    volatile uint32_t       index;      /* total number of events */
+    uint32_t                count;      /* ARMV7M_TRACE_ENTRY_COUNT, for the host decoder */
+    armv7m_trace_entry_t    entries[ARMV7M_TRACE_ENTRY_COUNT];
+} armv7m_trace_control_t;
+
+extern armv7m_trace_control_t armv7m_trace_control;
+
+static inline __attribute__((always_inline)) void armv7m_trace_event(uint32_t id, uint32_t data)
+{
+    armv7m_trace_entry_t *entry;
+    volatile uint32_t *port;
+    uint32_t event;
+
+    event = (id << 24) | (data & 0x00ffffff);
+
+    entry = &armv7m_trace_control.entries[__atomic_fetch_add(&armv7m_trace_control.index, 1, __ATOMIC_RELAXED) & (ARMV7M_TRACE_ENTRY_COUNT -1)];
+
+    entry->cycles = armv7m_systick_cycles();
+    entry->event = event;
+
+    /* ITM->TER, and the stimulus port which reads as 1 while its FIFO has room.
+     */
+    if (*((volatile uint32_t*)0xe0000e00) & (1u << ARMV7M_TRACE_ITM_PORT))
+    {
+	port = (volatile uint32_t*)(0xe0000000 + (ARMV7M_TRACE_ITM_PORT * 4));
+
+	if (*port)
+	{
+	    *port = event;
+	}
+    }
+}
+
+extern void armv7m_trace_reset(void);
+extern unsigned int armv7m_trace_snapshot(armv7m_trace_entry_t *entries, unsigned int count);
+
+#if (ARMV7M_TRACE == 1)
+#define ARMV7M_TRACE_EVENT(_id, _data) armv7m_trace_event((_id), (uint32_t)(_data))
+#else /* ARMV7M_TRACE == 1 */
+#define ARMV7M_TRACE_EVENT(_id, _data) /**/
+#endif /* ARMV7M_TRACE == 1 */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _ARMV7M_TRACE_H */
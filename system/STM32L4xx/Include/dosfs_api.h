@@ -38,7 +38,7 @@
 #endif
 
 #define F_NO_ERROR                   0
-#define F_ERR_RESERVED_1             1
+#define F_ERR_INVALIDDRIVE           1
 #define F_ERR_NOTFORMATTED           2
 #define F_ERR_INVALIDDIR             3
 #define F_ERR_INVALIDNAME            4
@@ -74,6 +74,12 @@
 #define F_SEEK_END                   1
 #define F_SEEK_SET                   2
 
+#define F_ADVICE_NORMAL              0x00
+#define F_ADVICE_SEQUENTIAL          0x01   /* prefetch, read ahead in f_read_multiple() */
+#define F_ADVICE_RANDOM              0x02
+#define F_ADVICE_NOCACHE             0x04   /* no prefetch, don't keep partially read blocks */
+#define F_ADVICE_WILLNEED            0x08   /* map the range and load its first block now */
+
 #define F_SEPARATORCHAR              '/'
 #define F_SECTOR_SIZE                512
 
@@ -101,6 +107,13 @@
 #define F_FAT16_MEDIA                2
 #define F_FAT32_MEDIA                3
 
+/* STM32L4 EXTENSION: f_hardformat() layout options, or'ed into "fattype". The FAT type
+ * is still derived from the media size.
+ */
+#define F_FORMAT_ALIGN               0x0100   /* align the system area to the AU the media reports */
+#define F_FORMAT_STREAMING           0x0200   /* large clusters, for few large sequentially written files */
+#define F_FORMAT_SMALL_FILES         0x0400   /* small clusters, for many small files */
+
 #define F_CTIME_SEC_SHIFT	     0
 #define F_CTIME_SEC_MASK	     0x001f   /* 0-30 in 2 seconds */
 #define F_CTIME_MIN_SHIFT            5
@@ -123,6 +136,8 @@
 
 typedef struct _dosfs_file_t         F_FILE;
 
+typedef void (*F_CALLBACK)(void *context, int status);
+
 typedef struct {
     char           filename[F_MAXPATH];             /* name.ext           */
     char           name[F_MAXNAME];	            /* file name          */
@@ -141,6 +156,10 @@ typedef struct {
 #endif /* (DOSFS_CONFIG_VFAT_SUPPORTED == 0) */
     uint32_t       find_clsno;
     uint32_t       find_index;
+#if (DOSFS_CONFIG_EXFAT_SUPPORTED == 1)
+    uint32_t       find_clscnt;
+#endif /* (DOSFS_CONFIG_EXFAT_SUPPORTED == 1) */
+    uint8_t        find_volume;
     /* IMPLEMENTATION SPECIFIC ABOVE */
 } F_FIND;
 
@@ -165,13 +184,50 @@ typedef struct {
     unsigned int   bad_high;
 } F_SPACE;
 
+typedef struct {
+    unsigned int   size;                            /* number of entries  */
+    unsigned int   hits;
+    unsigned int   misses;
+} F_CACHE;
+
+#define F_CACHE_ENTRY_SIZE           (512 + 8)
+
+typedef struct {
+    unsigned int   reads;                           /* device read calls  */
+    unsigned int   read_blocks;
+    unsigned int   writes;                          /* device write calls */
+    unsigned int   write_blocks;
+    unsigned int   syncs;
+    unsigned int   cache_hits;
+    unsigned int   cache_misses;
+    unsigned int   retries;                         /* SDCARD retries     */
+    unsigned int   device_time;                     /* in us              */
+    unsigned int   max_latency;                     /* in us              */
+    unsigned int   clock;                           /* interface clock in Hz, not reset */
+} F_STATISTICS;
+
+typedef struct {
+    F_FILE         *file;
+    void           *buffer;
+    long           size;                            /* bytes to read      */
+    long           count;                           /* bytes read         */
+    int            status;
+} F_READ_REQUEST;
+
 extern int     f_initvolume(void);
+extern int     f_initvolume_shared(void);
 extern int     f_delvolume(void);
+extern int     f_chdrive(int drive);
+extern int     f_getdrive(void);
 extern int     f_checkvolume(void);
 extern int     f_format(int fattype);
 extern int     f_hardformat(int fattype);
 extern int     f_getfreespace(F_SPACE *pspace);
 extern int     f_getserial(unsigned long *p_serial);
+extern int     f_getdirty(int *p_dirty);
+extern int     f_setcache(void *data, unsigned long size);
+extern int     f_getcache(F_CACHE *pcache);
+extern int     f_getstatistics(F_STATISTICS *pstatistics, int reset);
 extern int     f_setlabel(const char *volname);
 extern int     f_getlabel(char *volname, int length);
 
@@ -197,6 +253,11 @@ extern int     f_close(F_FILE *file);
 extern int     f_flush(F_FILE *file);
 extern long    f_write(const void *buffer, long size, long count, F_FILE *file);
 extern long    f_read(void *buffer, long size, long count, F_FILE *file);
+extern long    f_read_async(void *buffer, long size, F_FILE *file, F_CALLBACK callback, void *context);
+extern int     f_read_multiple(F_READ_REQUEST *requests, int count);
+extern int     f_advise(F_FILE *file, long offset, long length, int advice);
+extern int     f_map(F_FILE *file, const void **p_data);
+extern int     f_unmap(const void *data);
 extern int     f_seek(F_FILE *file, long offset, int whence);
 extern long    f_tell(F_FILE *file);
 extern long    f_length(F_FILE *file);
@@ -206,6 +267,7 @@ extern int     f_rewind(F_FILE *file);
 extern int     f_putc(int c, F_FILE *file);
 extern int     f_getc(F_FILE *file);
 extern int     f_seteof(F_FILE *file);
+extern int     f_reserve(F_FILE *file, long size);
 extern F_FILE *f_truncate(const char *filename, long length);
 
 #ifdef __cplusplus
@@ -33,6 +33,16 @@
  extern "C" {
 #endif
 
+/* Each volume ("0:", "1:", ...) has its own caches and file table. Only the Dragonfly boards
+ * (STM32L476/STM32L496) can carry SFLASH and an SDCARD at the same time, so only their
+ * libraries pay for a second one.
+ */
+#if defined(STM32L476xx) || defined(STM32L496xx)
+#define DOSFS_CONFIG_MAX_VOLUMES                2
+#else /* defined(STM32L476xx) || defined(STM32L496xx) */
+#define DOSFS_CONFIG_MAX_VOLUMES                1
+#endif /* defined(STM32L476xx) || defined(STM32L496xx) */
+
 #define DOSFS_CONFIG_MAX_FILES                  16
 #define DOSFS_CONFIG_FAT12_SUPPORTED            1
 #define DOSFS_CONFIG_VFAT_SUPPORTED             1
@@ -41,29 +51,50 @@
 #define DOSFS_CONFIG_CONTIGUOUS_SUPPORTED       1
 #define DOSFS_CONFIG_SEQUENTIAL_SUPPORTED       1
 #define DOSFS_CONFIG_MEDIA_FAILURE_SUPPORTED    0
-#define DOSFS_CONFIG_VOLUME_DIRTY_SUPPORTED     0
-#define DOSFS_CONFIG_FSINFO_SUPPORTED           0
+#define DOSFS_CONFIG_VOLUME_DIRTY_SUPPORTED     1
+#define DOSFS_CONFIG_FSINFO_SUPPORTED           1
 #define DOSFS_CONFIG_2NDFAT_SUPPORTED           1
+#define DOSFS_CONFIG_EXFAT_SUPPORTED            1    /* read-only exFAT volumes */
 
 #define DOSFS_CONFIG_FAT_CACHE_ENTRIES          1
 #define DOSFS_CONFIG_DATA_CACHE_ENTRIES         0
 #define DOSFS_CONFIG_FILE_DATA_CACHE            0
 #define DOSFS_CONFIG_CLUSTER_CACHE_ENTRIES      0
+#define DOSFS_CONFIG_WRITE_BACK_ENTRIES         0    /* opt-in, data may reach the media after the FAT/directory updates */
+#define DOSFS_CONFIG_EXTENT_ENTRIES             8
+#define DOSFS_CONFIG_DIR_INDEX_ENTRIES          512  /* name hash index of the last looked up directory, 0 to disable */
+#define DOSFS_CONFIG_DIR_INDEX_CLUSTERS         16
+#define DOSFS_CONFIG_REOPEN_ENTRIES             4    /* locations of the files last opened for reading, 0 to disable */
+#define DOSFS_CONFIG_REOPEN_PATH_SIZE           64   /* longer paths are not remembered */
+#define DOSFS_CONFIG_FREE_BITMAP_ENTRIES        2048 /* cluster groups tracked as known full, multiple of 32, 0 to disable */
 #define DOSFS_CONFIG_META_DATA_RETRIES          3
 #define DOSFS_CONFIG_STATISTICS                 0
 
 #define DOSFS_CONFIG_SDCARD_HIGH_SPEED          0
 #define DOSFS_CONFIG_SDCARD_CRC                 1
+#define DOSFS_CONFIG_SDCARD_SPEED_TRAINING      1    /* SPI: try clocks above 25MHz at reset, needs DOSFS_CONFIG_SDCARD_CRC */
 #define DOSFS_CONFIG_SDCARD_COMMAND_RETRIES     4
 #define DOSFS_CONFIG_SDCARD_DATA_RETRIES        4
+#define DOSFS_CONFIG_SDCARD_DMA_PRIORITY        11
 #define DOSFS_CONFIG_SDCARD_SIMULATE            0
 #define DOSFS_CONFIG_SDCARD_SIMULATE_BLKCNT     (unsigned long)(65536 * 64)
 #define DOSFS_CONFIG_SDCARD_SIMULATE_TRACE      0
 
+#define DOSFS_CONFIG_STORAGE_STAGE_ENTRIES      8    /* USB/MSC write-back staging, in blocks */
+#define DOSFS_CONFIG_STORAGE_STAGE_TIMEOUT      50   /* USB/MSC write-back drain after idle, in ms */
+#define DOSFS_CONFIG_STORAGE_SHARED_SUPPORTED   1    /* f_initvolume_shared(), read-only DOSFS next to USB/MSC */
+
 #define DOSFS_CONFIG_SFLASH_SIMULATE            0
 #define DOSFS_CONFIG_SFLASH_SIMULATE_DATA_SIZE  0x02000000
 #define DOSFS_CONFIG_SFLASH_SIMULATE_TRACE      0
 #define DOSFS_CONFIG_SFLASH_DEBUG               0
+#define DOSFS_CONFIG_SFLASH_RECLAIM_WATERMARK   256
+#define DOSFS_CONFIG_SFLASH_RECLAIM_IDLE        10
+#define DOSFS_CONFIG_SFLASH_RECLAIM_STEP        4            /* blocks copied per background reclaim step */
+#define DOSFS_CONFIG_SFLASH_MAPPED_SIZE         0
+#define DOSFS_CONFIG_SFLASH_MAP_FILES           1            /* keep the FTL memory mapped for f_map() */
+#define DOSFS_CONFIG_SFLASH_DATA_SIZE           0x02000000   /* largest device the FTL manages, sizes its RAM tables */
+#define DOSFS_CONFIG_SFLASH_XLATE_RESIDENT      128          /* leading blocks with a RAM resident translation */
 
 #define DOSFS_CONFIG_STARTUP_DELAY              100
 
@@ -36,6 +36,30 @@
  extern "C" {
 #endif
 
+/* The write-back buffer coalesces data blocks that would otherwise be written one by
+ * one out of the shared dir_cache, so it only exists in that configuration.
+ */
+#if (DOSFS_CONFIG_DATA_CACHE_ENTRIES != 0) || (DOSFS_CONFIG_FILE_DATA_CACHE != 0)
+#undef DOSFS_CONFIG_WRITE_BACK_ENTRIES
+#define DOSFS_CONFIG_WRITE_BACK_ENTRIES 0
+#endif /* (DOSFS_CONFIG_DATA_CACHE_ENTRIES != 0) || (DOSFS_CONFIG_FILE_DATA_CACHE != 0) */
+
+/* The directory index keys entries by their long name, so it needs VFAT.
+ */
+#if (DOSFS_CONFIG_VFAT_SUPPORTED == 0)
+#undef DOSFS_CONFIG_DIR_INDEX_ENTRIES
+#define DOSFS_CONFIG_DIR_INDEX_ENTRIES 0
+#endif /* (DOSFS_CONFIG_VFAT_SUPPORTED == 0) */
+
+/* exFAT names are long names, and the contiguous "NoFatChain" files map onto
+ * DOSFS_FILE_FLAG_CONTIGUOUS. The volume is mounted read-only, so there is
+ * nothing to log for TRANSACTION_SAFE.
+ */
+#if (DOSFS_CONFIG_VFAT_SUPPORTED == 0) || (DOSFS_CONFIG_CONTIGUOUS_SUPPORTED == 0) || (DOSFS_CONFIG_TRANSACTION_SAFE_SUPPORTED == 1)
+#undef DOSFS_CONFIG_EXFAT_SUPPORTED
+#define DOSFS_CONFIG_EXFAT_SUPPORTED 0
+#endif /* (DOSFS_CONFIG_VFAT_SUPPORTED == 0) || (DOSFS_CONFIG_CONTIGUOUS_SUPPORTED == 0) || (DOSFS_CONFIG_TRANSACTION_SAFE_SUPPORTED == 1) */
+
 typedef union  _dosfs_boot_t          dosfs_boot_t;
 typedef struct _dosfs_fsinfo_t        dosfs_fsinfo_t;
 typedef struct _dosfs_dir_t           dosfs_dir_t;
@@ -43,6 +67,9 @@ typedef struct _dosfs_ldir_t          dosfs_ldir_t;
 typedef struct _dosfs_file_t          dosfs_file_t;
 typedef struct _dosfs_cache_entry_t   dosfs_cache_entry_t;
 typedef struct _dosfs_cluster_entry_t dosfs_cluster_entry_t;
+typedef struct _dosfs_extent_t        dosfs_extent_t;
+typedef struct _dosfs_index_entry_t   dosfs_index_entry_t;
+typedef struct _dosfs_reopen_entry_t  dosfs_reopen_entry_t;
 typedef struct _dosfs_volume_t        dosfs_volume_t;
 
 #if (DOSFS_CONFIG_VFAT_SUPPORTED == 0)
@@ -157,6 +184,27 @@ struct _dosfs_ldir_t {
     uint8_t                 ldir_name_3[4];
 };
 
+#if (DOSFS_CONFIG_EXFAT_SUPPORTED == 1)
+
+/* exFAT directory entries are 32 bytes as well. A file is described by an entry set
+ * of a FILE entry (attributes, time stamps), followed by a STREAM entry (first
+ * cluster, length, NoFatChain flag) and NAME entries (15 UTF-16 characters each).
+ */
+
+#define DOSFS_EXFAT_ENTRY_END                0x00
+#define DOSFS_EXFAT_ENTRY_IN_USE             0x80
+#define DOSFS_EXFAT_ENTRY_SECONDARY          0x40
+#define DOSFS_EXFAT_ENTRY_BITMAP             0x81
+#define DOSFS_EXFAT_ENTRY_UPCASE             0x82
+#define DOSFS_EXFAT_ENTRY_LABEL              0x83
+#define DOSFS_EXFAT_ENTRY_FILE               0x85
+#define DOSFS_EXFAT_ENTRY_STREAM             0xc0
+#define DOSFS_EXFAT_ENTRY_NAME               0xc1
+
+#define DOSFS_EXFAT_STREAM_NO_FAT_CHAIN      0x02
+
+#endif /* (DOSFS_CONFIG_EXFAT_SUPPORTED == 1) */
+
 
 union _dosfs_boot_t {
     struct __attribute__((packed)) {
@@ -280,6 +328,31 @@ union _dosfs_boot_t {
 	uint16_t            bs_trail_sig;            /* 0xaa55 */
     } bpblog;
 
+#if (DOSFS_CONFIG_EXFAT_SUPPORTED == 1)
+    struct __attribute__((packed)) {
+	uint8_t             bs_jmp_boot[3];
+	uint8_t             bs_oem_name[8];          /* "EXFAT   " */
+        uint8_t             bs_reserved_1[53];       /* must be zero */
+	uint64_t            bpb_partition_offset;
+	uint64_t            bpb_volume_length;
+	uint32_t            bpb_fat_offset;
+	uint32_t            bpb_fat_length;
+	uint32_t            bpb_cluster_heap_offset;
+	uint32_t            bpb_cluster_count;
+	uint32_t            bpb_root_clus;
+	uint32_t            bs_vol_id;
+	uint16_t            bpb_fs_revision;
+	uint16_t            bpb_volume_flags;        /* 0x0001 ActiveFat, 0x0002 VolumeDirty */
+	uint8_t             bpb_byts_per_sec_shift;
+	uint8_t             bpb_sec_per_clus_shift;
+	uint8_t             bpb_num_fats;
+	uint8_t             bs_drv_num;
+	uint8_t             bpb_percent_in_use;
+        uint8_t             bs_reserved_2[397];
+	uint16_t            bs_trail_sig;            /* 0xaa55 */
+    } bpbex;
+#endif /* (DOSFS_CONFIG_EXFAT_SUPPORTED == 1) */
+
     uint32_t                __align__[128];
 };
 
@@ -325,8 +398,10 @@ struct _dosfs_cache_entry_t {
 #define DOSFS_FILE_MODE_APPEND               0x04
 #define DOSFS_FILE_MODE_CREATE               0x08
 #define DOSFS_FILE_MODE_TRUNCATE             0x10
+#define DOSFS_FILE_MODE_EXTENT               0x20   /* build the extent map on open */
 #define DOSFS_FILE_MODE_SEQUENTIAL           0x40
 #define DOSFS_FILE_MODE_RANDOM               0x80
+#define DOSFS_FILE_MODE_IN_PLACE             0x100  /* f_open() only, turned into DOSFS_FILE_FLAG_IN_PLACE */
 
 #if (DOSFS_CONFIG_FILE_DATA_CACHE == 1)
 #if (DOSFS_CONFIG_DATA_CACHE_ENTRIES != 0)
@@ -335,16 +410,31 @@ struct _dosfs_cache_entry_t {
 #endif /* (DOSFS_CONFIG_FILE_DATA_CACHE == 1) */
 #define DOSFS_FILE_FLAG_DATA_MODIFIED        0x02
 #define DOSFS_FILE_FLAG_DIR_MODIFIED         0x04
+#define DOSFS_FILE_FLAG_IN_PLACE             0x08   /* writes within file->length leave the dir entry alone */
+#define DOSFS_FILE_FLAG_NO_CACHE             0x10   /* f_advise(): drop clean data blocks after use, no prefetch */
 #if (DOSFS_CONFIG_CONTIGUOUS_SUPPORTED == 1)
 #define DOSFS_FILE_FLAG_CONTIGUOUS           0x40   /* contiguous cluster range to file->total_clscnt */
 #endif /* (DOSFS_CONFIG_CONTIGUOUS_SUPPORTED == 1) */
 #define DOSFS_FILE_FLAG_END_OF_CHAIN         0x80   /* END_OF_CHAIN seen */
 
+#if (DOSFS_CONFIG_EXTENT_ENTRIES != 0)
+
+/* An extent is a run of consecutive clusters, starting at cluster index "clsidx" within
+ * the file. The run extends up to the "clsidx" of the next extent (or file->extent_clscnt).
+ */
+struct _dosfs_extent_t {
+    uint32_t                clsidx;
+    uint32_t                clsno;
+};
+
+#endif /* (DOSFS_CONFIG_EXTENT_ENTRIES != 0) */
+
 struct _dosfs_file_t {
     uint8_t                 mode;
     uint8_t                 flags;
     volatile uint8_t        status;
-    uint8_t                 reserved[3];    /* unused for now */
+    uint8_t                 volume;         /* index into dosfs_volume_table[] */
+    uint8_t                 reserved[2];    /* unused for now */
     uint16_t                dir_index;      /* index within directory where primary dir entry resides */
     uint32_t                dir_clsno;      /* clsno where primary dir entry resides */ 
     uint32_t                first_clsno;    /* dir_clsno_hi/dir_clsno_lo from dir entry */
@@ -357,6 +447,13 @@ struct _dosfs_file_t {
     uint32_t                clsno;
     uint32_t                blkno;
     uint32_t                blkno_e;        /* exclusive */
+    F_CALLBACK              callback;       /* pending f_read_async() completion */
+    void                    *context;
+#if (DOSFS_CONFIG_EXTENT_ENTRIES != 0)
+    uint32_t                extent_clscnt;  /* clusters covered by extent_table[], 0 if not built */
+    uint32_t                extent_count;
+    dosfs_extent_t          extent_table[DOSFS_CONFIG_EXTENT_ENTRIES];
+#endif /* (DOSFS_CONFIG_EXTENT_ENTRIES != 0) */
 #if (DOSFS_CONFIG_FILE_DATA_CACHE == 1)
 #if (DOSFS_CONFIG_DATA_CACHE_ENTRIES != 0)
     dosfs_cache_entry_t      data_cache;
@@ -364,6 +461,32 @@ struct _dosfs_file_t {
 #endif /* (DOSFS_CONFIG_FILE_DATA_CACHE == 1) */
 };
 
+#if (DOSFS_CONFIG_REOPEN_ENTRIES != 0)
+
+/* A reopen entry records where a file opened for reading was found, so that
+ * opening the same path again does not need to look at the directory.
+ */
+struct _dosfs_reopen_entry_t {
+    uint32_t                cwd_clsno;      /* cwd_clsno for a relative path, DOSFS_CLSNO_END_OF_CHAIN otherwise */
+    uint32_t                dir_clsno;
+    uint16_t                dir_index;
+    uint16_t                reserved;
+    uint32_t                first_clsno;
+    uint32_t                length;
+    uint32_t                stamp;          /* reopen_clock at the last open, for LRU replacement */
+#if (DOSFS_CONFIG_EXFAT_SUPPORTED == 1)
+    uint32_t                exfat_clscnt;
+#endif /* (DOSFS_CONFIG_EXFAT_SUPPORTED == 1) */
+#if (DOSFS_CONFIG_EXTENT_ENTRIES != 0)
+    uint32_t                extent_clscnt;  /* 0 if no extent map was built */
+    uint32_t                extent_count;
+    dosfs_extent_t          extent_table[DOSFS_CONFIG_EXTENT_ENTRIES];
+#endif /* (DOSFS_CONFIG_EXTENT_ENTRIES != 0) */
+    char                    path[DOSFS_CONFIG_REOPEN_PATH_SIZE]; /* as passed to f_open(), "" if unused */
+};
+
+#endif /* (DOSFS_CONFIG_REOPEN_ENTRIES != 0) */
+
 #if (DOSFS_CONFIG_CLUSTER_CACHE_ENTRIES != 0)
 
 struct _dosfs_cluster_entry_t {
@@ -373,6 +496,23 @@ struct _dosfs_cluster_entry_t {
 
 #endif /* (DOSFS_CONFIG_CLUSTER_CACHE_ENTRIES != 0) */
 
+#if (DOSFS_CONFIG_DIR_INDEX_ENTRIES != 0)
+
+/* An index entry records the hash of a name (the long name if there is a valid
+ * one, the short name otherwise), the directory index of the first entry of
+ * its set, and the hash of the short name, which is used to find a unique
+ * generated short name without scanning the directory.
+ */
+struct _dosfs_index_entry_t {
+    uint16_t                hash;
+    uint16_t                index;
+    uint16_t                sfn_hash;
+};
+
+#define DOSFS_INDEX_COUNT_INCOMPLETE         0xffffffffu
+
+#endif /* (DOSFS_CONFIG_DIR_INDEX_ENTRIES != 0) */
+
 #define DOSFS_VOLUME_STATE_NONE              0
 #define DOSFS_VOLUME_STATE_INITIALIZED       1
 #define DOSFS_VOLUME_STATE_CARDREMOVED       2
@@ -402,6 +542,9 @@ struct _dosfs_cluster_entry_t {
 #define DOSFS_VOLUME_FLAG_MOUNTED_DIRTY      0x0080
 #endif /* (DOSFS_CONFIG_VOLUME_DIRTY_SUPPORTED == 1) */
 #define DOSFS_VOLUME_FLAG_WRITE_PROTECTED    0x0100
+#if (DOSFS_CONFIG_EXFAT_SUPPORTED == 1)
+#define DOSFS_VOLUME_FLAG_EXFAT              0x0200   /* implies DOSFS_VOLUME_FLAG_WRITE_PROTECTED */
+#endif /* (DOSFS_CONFIG_EXFAT_SUPPORTED == 1) */
 
 struct _dosfs_volume_t {
     uint8_t                 state;
@@ -421,10 +564,10 @@ struct _dosfs_volume_t {
     uint32_t                last_clsno;                   /* last valid cluster */
     uint32_t                cls_size;                     /* (1 << cls_shift) */
     uint32_t                cls_mask;                     /* (1 << cls_shift) -1 */
-    uint8_t                 cls_shift;                    /* shift to get the byte offset for a clsno (0x10 max) */
-    uint8_t                 cls_blk_shift;                /* shift to get the blkno for a clsno (0x07 max)*/
-    uint8_t                 cls_blk_mask;                 /* (1 << cls_blk_shift) -1 (0x7f max) */
-    uint8_t                 cls_blk_size;                 /* (1 << cls_blk_shift) (0x80 max) */
+    uint8_t                 cls_shift;                    /* shift to get the byte offset for a clsno (0x10 max, exFAT 0x18 max) */
+    uint8_t                 cls_blk_shift;                /* shift to get the blkno for a clsno (0x07 max, exFAT 0x0f max)*/
+    uint16_t                cls_blk_mask;                 /* (1 << cls_blk_shift) -1 (0x7f max, exFAT 0x7fff max) */
+    uint16_t                cls_blk_size;                 /* (1 << cls_blk_shift) (0x80 max, exFAT 0x8000 max) */
     int32_t                 cls_blk_offset;               /* offset to get the blkno for a clsno */
     dosfs_cache_entry_t     dir_cache;
 #if (DOSFS_CONFIG_TRANSACTION_SAFE_SUPPORTED == 1)
@@ -446,6 +589,43 @@ struct _dosfs_volume_t {
 #if (DOSFS_CONFIG_CLUSTER_CACHE_ENTRIES != 0)
     dosfs_cluster_entry_t   cluster_cache[DOSFS_CONFIG_CLUSTER_CACHE_ENTRIES];
 #endif /* (DOSFS_CONFIG_CLUSTER_CACHE_ENTRIES != 0) */
+#if (DOSFS_CONFIG_DIR_INDEX_ENTRIES != 0)
+    uint32_t                index_clsno;                  /* directory covered by index_table[], DOSFS_CLSNO_END_OF_CHAIN if none */
+    uint32_t                index_count;                  /* DOSFS_INDEX_COUNT_INCOMPLETE if the directory did not fit */
+    uint32_t                index_clscnt;
+    uint32_t                index_tail;                   /* directory index past the last entry set */
+    uint32_t                index_cluster[DOSFS_CONFIG_DIR_INDEX_CLUSTERS];
+    dosfs_index_entry_t     index_table[DOSFS_CONFIG_DIR_INDEX_ENTRIES];
+#endif /* (DOSFS_CONFIG_DIR_INDEX_ENTRIES != 0) */
+#if (DOSFS_CONFIG_REOPEN_ENTRIES != 0)
+    uint32_t                reopen_clock;
+    dosfs_reopen_entry_t    reopen_table[DOSFS_CONFIG_REOPEN_ENTRIES];
+#endif /* (DOSFS_CONFIG_REOPEN_ENTRIES != 0) */
+    uint8_t                 *sector_data;                 /* f_setcache() LRU cache of FAT/directory blocks */
+    uint32_t                *sector_blkno;
+    uint32_t                *sector_stamp;
+    uint32_t                sector_count;
+    uint32_t                sector_clock;
+    uint32_t                sector_hits;
+    uint32_t                sector_misses;
+#if (DOSFS_CONFIG_WRITE_BACK_ENTRIES != 0)
+    dosfs_file_t            *wb_file;                     /* owner of the pending blocks in wb_data */
+    uint32_t                wb_blkno;
+    uint32_t                wb_blkcnt;
+    uint8_t                 *wb_data;
+#endif /* (DOSFS_CONFIG_WRITE_BACK_ENTRIES != 0) */
+#if (DOSFS_CONFIG_FREE_BITMAP_ENTRIES != 0)
+    uint32_t                free_shift;                   /* clusters per free_bitmap[] bit as shift */
+    uint32_t                free_bitmap[DOSFS_CONFIG_FREE_BITMAP_ENTRIES / 32]; /* set: cluster group has no free cluster */
+#endif /* (DOSFS_CONFIG_FREE_BITMAP_ENTRIES != 0) */
+
+#if (DOSFS_CONFIG_EXFAT_SUPPORTED == 1)
+    uint32_t                cwd_clscnt;                   /* exFAT: clusters of a contiguous cwd_clsno, 0 for a FAT chain */
+    uint32_t                exfat_clscnt_d;               /* exFAT: clusters of the contiguous directory dosfs_path_find_directory() returned */
+    uint32_t                exfat_clscnt;                 /* exFAT: clusters of the contiguous entry last found, 0 for a FAT chain */
+    uint32_t                exfat_free_clscnt;            /* exFAT: free clusters per allocation bitmap, DOSFS_CLSNO_END_OF_CHAIN if not counted */
+    dosfs_dir_t             exfat_dir;                    /* exFAT: entry set last found, as FAT directory entry */
+#endif /* (DOSFS_CONFIG_EXFAT_SUPPORTED == 1) */
 
     /* WORK AREA BELOW */
 
@@ -548,7 +728,8 @@ struct _dosfs_volume_t {
 #endif /* (DOSFS_CONFIG_STATISTICS == 1) */
 };
 
-extern dosfs_volume_t dosfs_volume;
+extern dosfs_volume_t dosfs_volume_table[DOSFS_CONFIG_MAX_VOLUMES];
+extern dosfs_volume_t *dosfs_volume_default;
 
 /* The conversion from a linear offset/size to a clscnt is somewhat tricky.
  * An offset is rounded down, while a size is rounded up. But rouding up
@@ -580,11 +761,20 @@ extern dosfs_volume_t dosfs_volume;
 #define DOSFS_INDEX_TO_BLKOFS(_index)      (((_index) << DOSFS_DIR_SHIFT) & DOSFS_BLK_MASK)
 
 
-#define DOSFS_DEFAULT_VOLUME()       (&dosfs_volume)
-#define DOSFS_PATH_VOLUME(_path)     (&dosfs_volume)
-#define DOSFS_FIND_VOLUME(_find)     (&dosfs_volume)
-#define DOSFS_FILE_VOLUME(_file)     (&dosfs_volume)
-#define DOSFS_VOLUME_DEVICE(_volume) (&dosfs_device)
+/* Volume N is drive "N:" and sits on top of dosfs_device_table[N]. The volume
+ * functions of the API operate on the drive selected by f_chdrive(), a path may
+ * name its drive with a "N:" prefix.
+ */
+#define DOSFS_DEFAULT_VOLUME()       (dosfs_volume_default)
+#define DOSFS_PATH_VOLUME(_path)     (dosfs_path_volume(&(_path), dosfs_volume_default))
+#define DOSFS_FIND_VOLUME(_find)     (&dosfs_volume_table[(_find)->find_volume])
+#define DOSFS_FILE_VOLUME(_file)     (&dosfs_volume_table[(_file)->volume])
+#define DOSFS_VOLUME_DEVICE(_volume) (&dosfs_device_table[(_volume) - &dosfs_volume_table[0]])
+
+/* Reads of a file with DOSFS_FILE_MODE_SEQUENTIAL ask the device to prefetch the following
+ * blocks, unless f_advise() said F_ADVICE_NOCACHE.
+ */
+#define DOSFS_FILE_PREFETCH(_file)   (((_file)->mode & DOSFS_FILE_MODE_SEQUENTIAL) && !((_file)->flags & DOSFS_FILE_FLAG_NO_CACHE))
 
 #if (DOSFS_CONFIG_STATISTICS == 1)
 
@@ -598,6 +788,11 @@ extern dosfs_volume_t dosfs_volume;
 
 #endif /* (DOSFS_CONFIG_STATISTICS == 1) */
 
+/* The hit/miss totals of all caches are counted always, so that f_getstatistics() can report them.
+ */
+#define DOSFS_VOLUME_CACHE_HIT(_name)              { DOSFS_VOLUME_DEVICE(volume)->statistics.cache_hits += 1; DOSFS_VOLUME_STATISTICS_COUNT(_name); }
+#define DOSFS_VOLUME_CACHE_MISS(_name)             { DOSFS_VOLUME_DEVICE(volume)->statistics.cache_misses += 1; DOSFS_VOLUME_STATISTICS_COUNT(_name); }
+
 #ifdef __cplusplus
 }
 #endif
@@ -59,6 +59,9 @@ typedef struct _dosfs_device_interface_t {
     int                     (*read)(void *context, uint32_t address, uint8_t *data, uint32_t length, bool prefetch);
     int                     (*write)(void *context, uint32_t address, const uint8_t *data, uint32_t length, volatile uint8_t *p_status);
     int                     (*sync)(void *context, bool wait);
+    int                     (*read_async)(void *context, uint32_t address, uint8_t *data, uint32_t length, F_CALLBACK callback, void *callback_context);
+    int                     (*map)(void *context, uint32_t address, uint32_t length, const void **p_data);
+    int                     (*unmap)(void *context, const void *data);
 } dosfs_device_interface_t;
 
 #define DOSFS_DEVICE_LOCK_INIT               0x00000001 /* device lock during init */
@@ -67,6 +70,8 @@ typedef struct _dosfs_device_interface_t {
 #define DOSFS_DEVICE_LOCK_SCSI               0x00000008 /* USB/MSC SCSI opereration */
 #define DOSFS_DEVICE_LOCK_MEDIUM             0x00000010 /* USB/MSC ALLOW_PREVENT_MEDIUM_REMOVAL lock */
 #define DOSFS_DEVICE_LOCK_EJECTED            0x00000020 /* USB/MSC ejected (refuse to remount */
+#define DOSFS_DEVICE_LOCK_SHARED             0x00000040 /* DOSFS read-only next to USB/MSC */
+#define DOSFS_DEVICE_LOCK_STALE              0x20000000 /* USB/MSC wrote while DOSFS_DEVICE_LOCK_SHARED */
 #define DOSFS_DEVICE_LOCK_ACCESSED           0x40000000 /* USB/MSC accessed device */
 #define DOSFS_DEVICE_LOCK_MODIFIED           0x80000000 /* DOSFS modified device */
 
@@ -74,11 +79,24 @@ struct _dosfs_device_t {
     volatile uint32_t              lock;
     const dosfs_device_interface_t *interface;
     void                           *context;
+    F_STATISTICS                   statistics;
 };
 
-extern dosfs_device_t dosfs_device;
+extern dosfs_device_t dosfs_device_table[DOSFS_CONFIG_MAX_VOLUMES];
 
-extern int dosfs_device_format(dosfs_device_t *device, uint8_t *data);
+/* USB/MSC always exports the first device.
+ */
+#define dosfs_device (dosfs_device_table[0])
+
+extern dosfs_device_t *dosfs_device_attach(const dosfs_device_interface_t *interface, void *context);
+
+extern int dosfs_device_format(dosfs_device_t *device, uint8_t *data, uint32_t options);
+
+#if (DOSFS_CONFIG_STORAGE_SHARED_SUPPORTED == 1)
+extern int dosfs_storage_shared_read(dosfs_device_t *device, uint32_t address, uint8_t *data, uint32_t length, bool prefetch);
+extern int dosfs_storage_shared_sync(dosfs_device_t *device, bool wait);
+extern bool dosfs_storage_shared_stale(uint32_t *p_blkno, uint32_t *p_blkcnt);
+#endif /* (DOSFS_CONFIG_STORAGE_SHARED_SUPPORTED == 1) */
 
 #ifdef __cplusplus
 }
@@ -37,12 +37,60 @@
 
 #include "stm32l4_qspi.h"
 
+#include "armv7m.h"
+
 #ifdef __cplusplus
  extern "C" {
 #endif
 
 #define DOSFS_SFLASH_ERASE_COUNT_THRESHOLD      16
 
+/* Erase units are reclaimed in the background (after DOSFS_CONFIG_SFLASH_RECLAIM_IDLE ms
+ * without device access) until there are DOSFS_CONFIG_SFLASH_RECLAIM_WATERMARK free blocks,
+ * DOSFS_CONFIG_SFLASH_RECLAIM_STEP blocks copied per step.
+ */
+#if (DOSFS_CONFIG_SFLASH_SIMULATE == 0) && (DOSFS_CONFIG_SFLASH_RECLAIM_WATERMARK != 0)
+#define DOSFS_SFLASH_RECLAIM_BACKGROUND         1
+#else /* (DOSFS_CONFIG_SFLASH_SIMULATE == 0) && (DOSFS_CONFIG_SFLASH_RECLAIM_WATERMARK != 0) */
+#define DOSFS_SFLASH_RECLAIM_BACKGROUND         0
+#endif /* (DOSFS_CONFIG_SFLASH_SIMULATE == 0) && (DOSFS_CONFIG_SFLASH_RECLAIM_WATERMARK != 0) */
+
+/* The top DOSFS_CONFIG_SFLASH_MAPPED_SIZE bytes of the device are not managed by the FTL, but
+ * mapped read-only at QSPI_BASE + data_size, for constant assets or execute in place. Changing
+ * the size requires a reformat.
+ */
+#if (DOSFS_CONFIG_SFLASH_SIMULATE == 0) && (DOSFS_CONFIG_SFLASH_MAPPED_SIZE != 0)
+#define DOSFS_SFLASH_MAPPED                     1
+#else /* (DOSFS_CONFIG_SFLASH_SIMULATE == 0) && (DOSFS_CONFIG_SFLASH_MAPPED_SIZE != 0) */
+#define DOSFS_SFLASH_MAPPED                     0
+#endif /* (DOSFS_CONFIG_SFLASH_SIMULATE == 0) && (DOSFS_CONFIG_SFLASH_MAPPED_SIZE != 0) */
+
+/* With DOSFS_CONFIG_SFLASH_MAP_FILES the FTL area is kept memory mapped as well, so that a file
+ * whose blocks the FTL holds in physically consecutive locations can be read in place via f_map().
+ * While such a mapping is held, the background reclaim is suspended. A foreground reclaim (a write
+ * with almost no free blocks left) may still relocate mapped blocks.
+ */
+#if (DOSFS_CONFIG_SFLASH_SIMULATE == 0) && ((DOSFS_CONFIG_SFLASH_MAPPED_SIZE != 0) || (DOSFS_CONFIG_SFLASH_MAP_FILES != 0))
+#define DOSFS_SFLASH_MEMORY_MAPPED              1
+#else /* (DOSFS_CONFIG_SFLASH_SIMULATE == 0) && ((DOSFS_CONFIG_SFLASH_MAPPED_SIZE != 0) || (DOSFS_CONFIG_SFLASH_MAP_FILES != 0)) */
+#define DOSFS_SFLASH_MEMORY_MAPPED              0
+#endif /* (DOSFS_CONFIG_SFLASH_SIMULATE == 0) && ((DOSFS_CONFIG_SFLASH_MAPPED_SIZE != 0) || (DOSFS_CONFIG_SFLASH_MAP_FILES != 0)) */
+
+#if (DOSFS_SFLASH_MEMORY_MAPPED == 1) && (DOSFS_CONFIG_SFLASH_MAP_FILES != 0)
+#define DOSFS_SFLASH_MAP_FILES                  1
+#else /* (DOSFS_SFLASH_MEMORY_MAPPED == 1) && (DOSFS_CONFIG_SFLASH_MAP_FILES != 0) */
+#define DOSFS_SFLASH_MAP_FILES                  0
+#endif /* (DOSFS_SFLASH_MEMORY_MAPPED == 1) && (DOSFS_CONFIG_SFLASH_MAP_FILES != 0) */
+
+/* The FTL keeps per erase unit tables and the translation directories in RAM, sized for
+ * DOSFS_CONFIG_SFLASH_DATA_SIZE (about 3 bytes per erase unit, plus 4 bytes per 256 blocks).
+ * A larger device is only used up to that size. The translation of the first
+ * DOSFS_CONFIG_SFLASH_XLATE_RESIDENT blocks (FAT and root directory) is held in RAM
+ * (2 bytes each), while all other translations are paged in from flash on demand through
+ * one 512 byte cache block for the primary and one for the secondary translation. Changing
+ * either size requires a reformat.
+ */
+
 #define DOSFS_SFLASH_SECTOR_IDENT_0             0x52444154     /* "RFAT" */
 #define DOSFS_SFLASH_SECTOR_IDENT_1             0x4e4f3031     /* "NO01" */
 
@@ -53,18 +101,20 @@
 #define DOSFS_SFLASH_PAGE_SIZE                   0x00000100
 #define DOSFS_SFLASH_BLOCK_SIZE                  0x00000200
 #define DOSFS_SFLASH_ERASE_SIZE                  0x00010000
-#define DOSFS_SFLASH_DATA_SIZE                   0x02000000
+#define DOSFS_SFLASH_DATA_SIZE                   DOSFS_CONFIG_SFLASH_DATA_SIZE
 
 #define DOSFS_SFLASH_XLATE_ENTRIES               256
 #define DOSFS_SFLASH_XLATE_SEGMENT_SHIFT         8
 #define DOSFS_SFLASH_XLATE_INDEX_MASK            0x000000ff
-#define DOSFS_SFLASH_XLATE_OFFSET                128
+#define DOSFS_SFLASH_XLATE_OFFSET                DOSFS_CONFIG_SFLASH_XLATE_RESIDENT
 #define DOSFS_SFLASH_XLATE_COUNT                 ((((DOSFS_SFLASH_DATA_SIZE / DOSFS_SFLASH_ERASE_SIZE) * ((DOSFS_SFLASH_ERASE_SIZE / DOSFS_SFLASH_BLOCK_SIZE) -1) -2) + (DOSFS_SFLASH_XLATE_ENTRIES -1)) / DOSFS_SFLASH_XLATE_ENTRIES)
 
 #define DOSFS_SFLASH_XLATE_ENTRY_NOT_ALLOCATED   0xffff
 
 #define DOSFS_SFLASH_BLOCK_INFO_ENTRIES          128
 
+#define DOSFS_SFLASH_READ_BLOCKS_MAX             128            /* longest merged read (64k) */
+
 #define DOSFS_SFLASH_LOGICAL_BLOCK_MASK          0x0000007f
 #define DOSFS_SFLASH_LOGICAL_SECTOR_MASK         0x00007f80
 #define DOSFS_SFLASH_LOGICAL_SECTOR_SHIFT        7
@@ -117,7 +167,7 @@ struct _dosfs_sflash_t {
     uint32_t                data_size;
 
     uint8_t                 sector_table[DOSFS_SFLASH_DATA_SIZE / DOSFS_SFLASH_ERASE_SIZE];
-#if (DOSFS_SFLASH_DATA_SIZE == 0x02000000)
+#if (DOSFS_SFLASH_DATA_SIZE > 0x01000000)
     uint32_t                sector_mask[(DOSFS_SFLASH_DATA_SIZE / DOSFS_SFLASH_ERASE_SIZE) / 32];
 #endif /* DOSFS_SFLASH_DATA_SIZE */
     uint16_t                block_table[DOSFS_SFLASH_XLATE_OFFSET];
@@ -141,8 +191,23 @@ struct _dosfs_sflash_t {
 
     uint32_t                erase_count_max;
 
+#if (DOSFS_SFLASH_RECLAIM_BACKGROUND == 1)
+    volatile uint8_t        busy;                  /* FTL is in use from thread context */
+    armv7m_timer_t          reclaim_timer;
+    uint32_t                reclaim_victim;        /* background reclaim in progress, or DOSFS_SFLASH_PHYSICAL_ILLEGAL */
+    uint16_t                reclaim_index;         /* next victim block to copy */
+#endif /* (DOSFS_SFLASH_RECLAIM_BACKGROUND == 1) */
+
+#if (DOSFS_SFLASH_MAP_FILES == 1)
+    uint32_t                map_count;             /* f_map() mappings held */
+#endif /* (DOSFS_SFLASH_MAP_FILES == 1) */
+
     uint32_t                *cache[2];
 
+#if (DOSFS_CONFIG_SFLASH_SIMULATE == 0)
+    uint8_t                 read_pending;          /* asynchronous nor_read in flight */
+#endif /* (DOSFS_CONFIG_SFLASH_SIMULATE == 0) */
+
 #if (DOSFS_CONFIG_SFLASH_SIMULATE == 1)
     uint8_t                 *image;
 #endif /* (DOSFS_CONFIG_SFLASH_SIMULATE == 1) */
@@ -219,6 +284,16 @@ struct _dosfs_sflash_t {
 
 #endif /* (DOSFS_CONFIG_STATISTICS == 1) */
 
+extern int dosfs_sflash_init(void);
+
+#if (DOSFS_SFLASH_MAPPED == 1)
+
+extern const void *dosfs_sflash_mapped(uint32_t *p_size);
+extern int dosfs_sflash_mapped_erase(uint32_t offset);
+extern int dosfs_sflash_mapped_program(uint32_t offset, const uint8_t *data, uint32_t count);
+
+#endif /* (DOSFS_SFLASH_MAPPED == 1) */
+
 #ifdef __cplusplus
 }
 #endif
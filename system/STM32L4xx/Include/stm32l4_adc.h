@@ -34,6 +34,8 @@
 
 #include "stm32l4xx.h"
 
+#include "stm32l4_dma.h"
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -69,21 +71,70 @@ enum {
 #define ADC_CHANNEL_ADC2_DAC1                    17
 #define ADC_CHANNEL_ADC2_DAC2                    18
 
+#define ADC_MODE_DMA                             0x00000001
+
+#define ADC_OPTION_RATIO_MASK                    0x0000000f
+#define ADC_OPTION_RATIO_SHIFT                   0
+#define ADC_OPTION_RATIO_1                       0x00000000
+#define ADC_OPTION_RATIO_2                       0x00000001
+#define ADC_OPTION_RATIO_4                       0x00000002
+#define ADC_OPTION_RATIO_8                       0x00000003
+#define ADC_OPTION_RATIO_16                      0x00000004
+#define ADC_OPTION_RATIO_32                      0x00000005
+#define ADC_OPTION_RATIO_64                      0x00000006
+#define ADC_OPTION_RATIO_128                     0x00000007
+#define ADC_OPTION_RATIO_256                     0x00000008
+#define ADC_OPTION_SHIFT_MASK                    0x000000f0
+#define ADC_OPTION_SHIFT_SHIFT                   4
+#define ADC_OPTION_SHIFT(_n)                     (((_n) << ADC_OPTION_SHIFT_SHIFT) & ADC_OPTION_SHIFT_MASK)
+
+#define ADC_TRIGGER_EXTI11                       6
+#define ADC_TRIGGER_TIM1_TRGO                    9
+#define ADC_TRIGGER_TIM2_TRGO                    11
+#define ADC_TRIGGER_TIM6_TRGO                    13
+#define ADC_TRIGGER_TIM15_TRGO                   14
+
+/* Triggers for the injected group (JEXTSEL). ADC_INJECTED_TRIGGER_FALLING picks the
+ * falling edge of the trigger instead of the rising one.
+ */
+#define ADC_INJECTED_TRIGGER_TIM1_TRGO           0
+#define ADC_INJECTED_TRIGGER_TIM1_CC4            1
+#define ADC_INJECTED_TRIGGER_TIM2_TRGO           2
+#define ADC_INJECTED_TRIGGER_TIM2_CC1            3
+#define ADC_INJECTED_TRIGGER_TIM3_CC4            4
+#define ADC_INJECTED_TRIGGER_TIM4_TRGO           5
+#define ADC_INJECTED_TRIGGER_EXTI15              6
+#define ADC_INJECTED_TRIGGER_TIM3_TRGO           12
+#define ADC_INJECTED_TRIGGER_TIM6_TRGO           14
+#define ADC_INJECTED_TRIGGER_TIM15_TRGO          15
+#define ADC_INJECTED_TRIGGER_FALLING             0x00000100
+
+#define ADC_EVENT_INJECTED                       0x10000000
+#define ADC_EVENT_WATCHDOG                       0x20000000
+#define ADC_EVENT_SCAN_HALF                      0x40000000
+#define ADC_EVENT_SCAN_DONE                      0x80000000
+
 typedef void (*stm32l4_adc_callback_t)(void *context, uint32_t events);
 
 #define ADC_STATE_NONE                         0
 #define ADC_STATE_INIT                         1
 #define ADC_STATE_BUSY                         2
 #define ADC_STATE_READY                        3
+#define ADC_STATE_SCAN                         4
 
 typedef struct _stm32l4_adc_t {
     ADC_TypeDef                 *ADCx;
     volatile uint8_t            state;
     uint8_t                     instance;
     uint8_t                     priority;
+    uint8_t                     mode;
+    uint8_t                     injected;
     stm32l4_adc_callback_t      callback;
     void                        *context;
     uint32_t                    events;
+    uint32_t                    watchdog;
+    uint32_t                    threshold;
+    stm32l4_dma_t               dma;
 } stm32l4_adc_t;
 
 extern bool     stm32l4_adc_create(stm32l4_adc_t *adc, unsigned int instance, unsigned int priority, unsigned int mode);
@@ -94,6 +145,30 @@ extern bool     stm32l4_adc_configure(stm32l4_adc_t *adc, uint32_t option);
 extern bool     stm32l4_adc_calibrate(stm32l4_adc_t *adc);
 extern bool     stm32l4_adc_notify(stm32l4_adc_t *adc, stm32l4_adc_callback_t callback, void *context, uint32_t events);
 extern uint32_t stm32l4_adc_convert(stm32l4_adc_t *adc, unsigned int channel);
+extern bool     stm32l4_adc_scan(stm32l4_adc_t *adc, const uint8_t *channels, unsigned int count, uint32_t trigger, uint16_t *data, uint16_t size);
+extern bool     stm32l4_adc_stop(stm32l4_adc_t *adc);
+
+/* Converts the injected group "channels" (at most 4) on every "trigger", in the background of
+ * regular conversions and scans. Each sequence reports ADC_EVENT_INJECTED, from which the data
+ * is picked up with stm32l4_adc_injected(). Runs till stm32l4_adc_inject_stop(), but has to be
+ * stopped before the ADC is disabled.
+ */
+extern bool     stm32l4_adc_inject(stm32l4_adc_t *adc, const uint8_t *channels, unsigned int count, uint32_t trigger);
+extern bool     stm32l4_adc_inject_stop(stm32l4_adc_t *adc);
+extern uint32_t stm32l4_adc_injected(stm32l4_adc_t *adc, unsigned int index);
+
+/* Analog watchdog 1 on "channel" for the next stm32l4_adc_scan(). The first conversion of
+ * "channel" outside of [low, high] reports ADC_EVENT_WATCHDOG; the watchdog is then disarmed
+ * until the scan is restarted. A "channel" above 18 turns it off.
+ */
+extern bool     stm32l4_adc_watchdog(stm32l4_adc_t *adc, unsigned int channel, uint16_t low, uint16_t high);
+
+#if defined(STM32L476xx) || defined(STM32L496xx)
+extern void ADC1_2_IRQHandler(void);
+extern void ADC3_IRQHandler(void);
+#else /* defined(STM32L476xx) || defined(STM32L496xx) */
+extern void ADC1_IRQHandler(void);
+#endif /* defined(STM32L476xx) || defined(STM32L496xx) */
 
 #ifdef __cplusplus
 }
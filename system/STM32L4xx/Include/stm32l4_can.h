@@ -0,0 +1,189 @@
+/*
+ * Copyright (c) 2017 Thomas Roell.  All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal with the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ *  1. Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimers.
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimers in the
+ *     documentation and/or other materials provided with the distribution.
+ *  3. Neither the name of Thomas Roell, nor the names of its contributors
+ *     may be used to endorse or promote products derived from this Software
+ *     without specific prior written permission.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ * CONTRIBUTORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * WITH THE SOFTWARE.
+ */
+
+#if !defined(_STM32L4_CAN_H)
+#define _STM32L4_CAN_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "stm32l4xx.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+enum {
+    CAN_INSTANCE_CAN1 = 0,
+#ifdef CAN2_BASE
+    CAN_INSTANCE_CAN2,
+#endif
+    CAN_INSTANCE_COUNT
+};
+
+/* Filter banks per instance. With CAN2 the 28 banks are split 14/14.
+ */
+#define CAN_FILTER_COUNT             14
+
+#define CAN_TX_QUEUE_SIZE            8
+
+/* Priority ceiling of the stm32l4_can_*() API, i.e. the most urgent interrupt priority from which
+ * it may be called. The TX queue and the filter banks shared by CAN1/CAN2 are updated with only
+ * interrupts up to this priority masked, so the "priority" passed to stm32l4_can_create() must not
+ * be more urgent than that.
+ */
+#if !defined(CAN_CRITICAL_PRIORITY)
+#define CAN_CRITICAL_PRIORITY        4
+#endif
+
+#define CAN_ID_STANDARD_MASK         0x000007ff
+#define CAN_ID_EXTENDED_MASK         0x1fffffff
+#define CAN_ID_REMOTE                0x40000000
+#define CAN_ID_EXTENDED              0x80000000
+
+#define CAN_OPTION_LOOPBACK          0x00000001
+#define CAN_OPTION_SILENT            0x00000002
+#define CAN_OPTION_ONE_SHOT          0x00000004  /* no automatic retransmission */
+#define CAN_OPTION_TX_PRIORITY       0x00000008  /* mailboxes go out by identifier, not in request order */
+#define CAN_OPTION_AUTO_BUS_OFF      0x00000010  /* leave bus-off after 128 x 11 recessive bits */
+
+#define CAN_EVENT_ERROR              0x00000001  /* LEC, see stm32l4_can_status() */
+#define CAN_EVENT_ERROR_WARNING      0x00000002
+#define CAN_EVENT_ERROR_PASSIVE      0x00000004
+#define CAN_EVENT_BUS_OFF            0x00000008
+#define CAN_EVENT_OVERRUN            0x00000010  /* hardware FIFO or receive ring */
+#define CAN_EVENT_TX_ERROR           0x00000020  /* a mailbox completed without TXOK */
+#define CAN_EVENT_RECEIVE            0x40000000
+#define CAN_EVENT_TRANSMIT           0x80000000
+
+#define CAN_FIFO_0                   0
+#define CAN_FIFO_1                   1
+
+typedef void (*stm32l4_can_callback_t)(void *context, uint32_t events);
+
+#define CAN_STATE_NONE               0
+#define CAN_STATE_INIT               1
+#define CAN_STATE_BUSY               2
+#define CAN_STATE_READY              3
+
+typedef struct _stm32l4_can_pins_t {
+    uint16_t                     rx;
+    uint16_t                     tx;
+} stm32l4_can_pins_t;
+
+/* "id" is the 11 or 29 bit identifier, plus CAN_ID_EXTENDED for a 29 bit one
+ * and CAN_ID_REMOTE for a remote frame. "filter" is the index of the filter bank
+ * that accepted a received frame.
+ */
+typedef struct _stm32l4_can_frame_t {
+    uint32_t                     id;
+    uint8_t                      dlc;
+    uint8_t                      filter;
+    uint8_t                      data[8];
+} stm32l4_can_frame_t;
+
+typedef struct _stm32l4_can_t {
+    CAN_TypeDef                *CANx;
+    volatile uint8_t           state;
+    uint8_t                    instance;
+    uint8_t                    interrupt;
+    uint8_t                    priority;
+    stm32l4_can_pins_t         pins;
+    stm32l4_can_callback_t     callback;
+    void                       *context;
+    volatile uint32_t          events;
+    uint32_t                   bitrate;
+    uint32_t                   option;
+    stm32l4_can_frame_t        *rx_data;
+    uint16_t                   rx_size;
+    volatile uint16_t          rx_read;
+    volatile uint16_t          rx_write;
+    volatile uint16_t          tx_read;
+    volatile uint16_t          tx_write;
+    volatile uint32_t          rx_overruns;
+    uint8_t                    fmi[2][2 * CAN_FILTER_COUNT];
+    stm32l4_can_frame_t        tx_queue[CAN_TX_QUEUE_SIZE];
+} stm32l4_can_t;
+
+/* bxCAN with interrupt driven RX FIFOs and TX mailboxes.
+ *
+ * Both hardware FIFOs are drained from their interrupts into "rx_data", a
+ * ring of "rx_size" frames (one slot stays unused) shared lock-free with
+ * stm32l4_can_receive(); frames that do not fit are counted in "rx_overruns"
+ * and reported as CAN_EVENT_OVERRUN, same as hardware FIFO overruns.
+ * stm32l4_can_transmit() goes straight to a free mailbox, or is queued
+ * (CAN_TX_QUEUE_SIZE frames, again one slot unused) and passed to the
+ * mailboxes from the TX interrupt. By default mailboxes are
+ * sent in request order, so frames go out in the order they were queued.
+ *
+ * The bit timing is derived from PCLK1 with a sample point close to 87.5%,
+ * and recomputed on clock changes (the controller sits in init mode while
+ * the clocks are switched). PCLK1 needs to be an integer multiple of 8 to 25
+ * times "bitrate", and for a real bus it needs to come from HSE or an
+ * LSE-trimmed MSI.
+ *
+ * stm32l4_can_enable() installs filter bank 0 as accept-all for FIFO 0. The
+ * stm32l4_can_filter_*() calls then (re)program single banks: "mask" mode
+ * accepts a frame if (frame_id & mask) == (id & mask), where CAN_ID_EXTENDED
+ * and CAN_ID_REMOTE in "mask" select whether those bits have to match as
+ * well; "list" mode accepts exactly "id0" or "id1".
+ */
+extern bool stm32l4_can_create(stm32l4_can_t *can, unsigned int instance, const stm32l4_can_pins_t *pins, unsigned int priority);
+extern bool stm32l4_can_destroy(stm32l4_can_t *can);
+extern bool stm32l4_can_enable(stm32l4_can_t *can, stm32l4_can_frame_t *rx_data, uint16_t rx_size, uint32_t bitrate, uint32_t option, stm32l4_can_callback_t callback, void *context, uint32_t events);
+extern bool stm32l4_can_disable(stm32l4_can_t *can);
+extern bool stm32l4_can_notify(stm32l4_can_t *can, stm32l4_can_callback_t callback, void *context, uint32_t events);
+extern bool stm32l4_can_filter_mask(stm32l4_can_t *can, unsigned int index, uint32_t id, uint32_t mask, unsigned int fifo);
+extern bool stm32l4_can_filter_list(stm32l4_can_t *can, unsigned int index, uint32_t id0, uint32_t id1, unsigned int fifo);
+extern bool stm32l4_can_filter_disable(stm32l4_can_t *can, unsigned int index);
+extern bool stm32l4_can_receive(stm32l4_can_t *can, stm32l4_can_frame_t *frame);
+extern unsigned int stm32l4_can_count(stm32l4_can_t *can);
+extern bool stm32l4_can_transmit(stm32l4_can_t *can, const stm32l4_can_frame_t *frame);
+extern void stm32l4_can_abort(stm32l4_can_t *can);
+extern bool stm32l4_can_done(stm32l4_can_t *can);
+/* CAN_ESR: LEC in bits 6:4, TEC in bits 23:16 and REC in bits 31:24, plus the
+ * warning/passive/bus-off flags in bits 2:0.
+ */
+extern uint32_t stm32l4_can_status(stm32l4_can_t *can);
+
+extern void CAN1_TX_IRQHandler(void);
+extern void CAN1_RX0_IRQHandler(void);
+extern void CAN1_RX1_IRQHandler(void);
+extern void CAN1_SCE_IRQHandler(void);
+#ifdef CAN2_BASE
+extern void CAN2_TX_IRQHandler(void);
+extern void CAN2_RX0_IRQHandler(void);
+extern void CAN2_RX1_IRQHandler(void);
+extern void CAN2_SCE_IRQHandler(void);
+#endif
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _STM32L4_CAN_H */
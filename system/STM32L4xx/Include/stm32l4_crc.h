@@ -0,0 +1,83 @@
+/*
+ * Copyright (c) 2017 Thomas Roell.  All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal with the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ *  1. Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimers.
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimers in the
+ *     documentation and/or other materials provided with the distribution.
+ *  3. Neither the name of Thomas Roell, nor the names of its contributors
+ *     may be used to endorse or promote products derived from this Software
+ *     without specific prior written permission.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ * CONTRIBUTORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * WITH THE SOFTWARE.
+ */
+
+#if !defined(_STM32L4_CRC_H)
+#define _STM32L4_CRC_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "stm32l4xx.h"
+
+#include "stm32l4_dma.h"
+
+#ifdef __cplusplus
+ extern "C" {
+#endif
+
+/* The CRC unit is a single shared resource. stm32l4_crc_acquire() claims it and
+ * programs polynom/init (both right aligned to the polynom size), and returns
+ * false if it is already in use, in which case the caller has to fall back to
+ * a software implementation. Data is fed as a byte stream, first byte first.
+ *
+ * stm32l4_crc_update_dma() feeds "count" bytes via a memory-to-memory transfer
+ * on a caller supplied DMA channel (which needs no request mapping, e.g.
+ * DMA_CHANNEL_DMA1_CH1_INDEX), enabled by the caller with stm32l4_dma_enable().
+ * Completion is either signaled via the DMA callback (DMA_EVENT_TRANSFER_DONE)
+ * or polled with stm32l4_dma_done(). stm32l4_crc_value() must not be called
+ * before that.
+ *
+ * Examples:
+ *
+ *   SD CRC7:       polynom 0x09,       init 0,          CRC_OPTION_POLYSIZE_7
+ *   CRC16-CCITT:   polynom 0x1021,     init 0 / 0xffff, CRC_OPTION_POLYSIZE_16
+ *   CRC32 (zlib):  polynom 0x04c11db7, init 0xffffffff, CRC_OPTION_POLYSIZE_32 | CRC_OPTION_REVERSE_INPUT | CRC_OPTION_REVERSE_OUTPUT,
+ *                  result xored with 0xffffffff
+ */
+
+#define CRC_OPTION_POLYSIZE_MASK        0x00000018
+#define CRC_OPTION_POLYSIZE_SHIFT       3
+#define CRC_OPTION_POLYSIZE_32          0x00000000
+#define CRC_OPTION_POLYSIZE_16          0x00000008
+#define CRC_OPTION_POLYSIZE_8           0x00000010
+#define CRC_OPTION_POLYSIZE_7           0x00000018
+#define CRC_OPTION_REVERSE_INPUT        0x00000020
+#define CRC_OPTION_REVERSE_OUTPUT       0x00000080
+
+extern bool stm32l4_crc_acquire(uint32_t polynom, uint32_t init, uint32_t option);
+extern void stm32l4_crc_release(void);
+extern void stm32l4_crc_reset(void);
+extern void stm32l4_crc_update(const uint8_t *data, uint32_t count);
+extern void stm32l4_crc_update_dma(stm32l4_dma_t *dma, const uint8_t *data, uint16_t count);
+extern uint32_t stm32l4_crc_value(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _STM32L4_CRC_H */
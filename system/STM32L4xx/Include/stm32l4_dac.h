@@ -34,6 +34,8 @@
 
 #include "stm32l4xx.h"
 
+#include "stm32l4_dma.h"
+
 #ifdef __cplusplus
  extern "C" {
 #endif
@@ -51,6 +53,17 @@ enum {
 #define DAC_CONTROL_EXTERNAL                     0x00000002
 #define DAC_CONTROL_CALIBRATE                    0x00000004
 
+#define DAC_TRIGGER_TIM6_TRGO                    0
+#define DAC_TRIGGER_TIM8_TRGO                    1
+#define DAC_TRIGGER_TIM7_TRGO                    2
+#define DAC_TRIGGER_TIM5_TRGO                    3
+#define DAC_TRIGGER_TIM2_TRGO                    4
+#define DAC_TRIGGER_TIM4_TRGO                    5
+#define DAC_TRIGGER_EXTI9                        6
+
+#define DAC_EVENT_STREAM_HALF                    0x40000000
+#define DAC_EVENT_STREAM_DONE                    0x80000000
+
 typedef void (*stm32l4_dac_callback_t)(void *context, uint32_t events);
 
 #define DAC_STATE_NONE                         0
@@ -66,6 +79,8 @@ typedef struct _stm32l4_dac_t {
     stm32l4_dac_callback_t      callback;
     void                        *context;
     uint32_t                    events;
+    uint8_t                     stream;
+    stm32l4_dma_t               dma;
 } stm32l4_dac_t;
 
 extern bool     stm32l4_dac_create(stm32l4_dac_t *dac, unsigned int instance, unsigned int priority, unsigned int mode);
@@ -77,6 +92,8 @@ extern bool     stm32l4_dac_configure(stm32l4_dac_t *dac, uint32_t option);
 extern bool     stm32l4_dac_notify(stm32l4_dac_t *dac, stm32l4_dac_callback_t callback, void *context, uint32_t events);
 extern bool     stm32l4_dac_channel(stm32l4_dac_t *dac, unsigned int channel, uint32_t output, uint32_t control);
 extern bool     stm32l4_dac_convert(stm32l4_dac_t *dac, unsigned int channel, uint32_t output);
+extern bool     stm32l4_dac_stream(stm32l4_dac_t *dac, unsigned int channel, uint32_t trigger, const uint16_t *data, uint16_t size);
+extern bool     stm32l4_dac_stop(stm32l4_dac_t *dac);
 
 #ifdef __cplusplus
 }
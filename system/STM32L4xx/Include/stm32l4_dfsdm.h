@@ -0,0 +1,117 @@
+/*
+ * Copyright (c) 2017 Thomas Roell.  All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal with the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ *  1. Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimers.
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimers in the
+ *     documentation and/or other materials provided with the distribution.
+ *  3. Neither the name of Thomas Roell, nor the names of its contributors
+ *     may be used to endorse or promote products derived from this Software
+ *     without specific prior written permission.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ * CONTRIBUTORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * WITH THE SOFTWARE.
+ */
+
+#if !defined(_STM32L4_DFSDM_H)
+#define _STM32L4_DFSDM_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "stm32l4xx.h"
+
+#include "stm32l4_dma.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#if defined(STM32L452xx) || defined(STM32L476xx) || defined(STM32L496xx)
+
+/* DFSDM1 as a PDM (MEMS microphone) interface: the filter instance converts the bit stream
+ * on a DATINy pin, clocked by the CKOUT pin, through a sincN decimation filter into 24 bit
+ * PCM samples, which are moved to memory by DMA. STM32L452/STM32L476/STM32L496 only.
+ */
+enum {
+    DFSDM_INSTANCE_FLT0 = 0,
+    DFSDM_INSTANCE_FLT1 = 1,
+#if defined(STM32L476xx) || defined(STM32L496xx)
+    DFSDM_INSTANCE_FLT2 = 2,
+    DFSDM_INSTANCE_FLT3 = 3,
+#endif /* defined(STM32L476xx) || defined(STM32L496xx) */
+    DFSDM_INSTANCE_COUNT
+};
+
+#define DFSDM_OPTION_FALLING              0x00000001  /* sample on the falling CKOUT edge, i.e. the 2nd microphone on a DATIN pin */
+#define DFSDM_OPTION_SYNC                 0x00000002  /* start conversions together with DFSDM_INSTANCE_FLT0 */
+
+#define DFSDM_EVENT_RECEIVE_REQUEST       0x20000000
+
+typedef void (*stm32l4_dfsdm_callback_t)(void *context, uint32_t events);
+
+#define DFSDM_STATE_NONE                  0
+#define DFSDM_STATE_INIT                  1
+#define DFSDM_STATE_READY                 2
+#define DFSDM_STATE_RECEIVE               3
+
+typedef struct _stm32l4_dfsdm_pins_t {
+    uint16_t                     ckout;
+    uint16_t                     datin;
+} stm32l4_dfsdm_pins_t;
+
+typedef struct _stm32l4_dfsdm_t {
+    DFSDM_Filter_TypeDef         *FLTx;
+    volatile uint8_t             state;
+    uint8_t                      instance;
+    uint8_t                      channel;
+    uint8_t                      priority;
+    stm32l4_dfsdm_pins_t         pins;
+    uint32_t                     option;
+    uint32_t                     rate;
+    stm32l4_dfsdm_callback_t     callback;
+    void                         *context;
+    uint32_t                     events;
+    stm32l4_dma_t                dma;
+} stm32l4_dfsdm_t;
+
+extern bool     stm32l4_dfsdm_create(stm32l4_dfsdm_t *dfsdm, unsigned int instance, const stm32l4_dfsdm_pins_t *pins, unsigned int priority);
+extern bool     stm32l4_dfsdm_destroy(stm32l4_dfsdm_t *dfsdm);
+
+/* "clock" is the requested CKOUT frequency, which all enabled instances share. "order" (1 .. 5)
+ * and "oversampling" (1 .. 1024) set up the sinc filter, so that the sample rate is about
+ * "clock" / "oversampling" (stm32l4_dfsdm_rate() returns the exact value). Output samples are
+ * scaled so that a full scale bit stream maps to a full scale signed 24 bit value, held in
+ * bits 31:8 of each 32 bit word.
+ */
+extern bool     stm32l4_dfsdm_enable(stm32l4_dfsdm_t *dfsdm, uint32_t clock, uint32_t order, uint32_t oversampling, uint32_t option, stm32l4_dfsdm_callback_t callback, void *context, uint32_t events);
+extern bool     stm32l4_dfsdm_disable(stm32l4_dfsdm_t *dfsdm);
+extern bool     stm32l4_dfsdm_notify(stm32l4_dfsdm_t *dfsdm, stm32l4_dfsdm_callback_t callback, void *context, uint32_t events);
+extern uint32_t stm32l4_dfsdm_rate(stm32l4_dfsdm_t *dfsdm);
+
+/* Receive "rx_count" samples into "rx_data" via DMA; DFSDM_EVENT_RECEIVE_REQUEST signals
+ * completion, from where the next stm32l4_dfsdm_receive() is issued without losing samples.
+ */
+extern bool     stm32l4_dfsdm_receive(stm32l4_dfsdm_t *dfsdm, int32_t *rx_data, uint16_t rx_count);
+extern bool     stm32l4_dfsdm_done(stm32l4_dfsdm_t *dfsdm);
+
+#endif /* defined(STM32L452xx) || defined(STM32L476xx) || defined(STM32L496xx) */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _STM32L4_DFSDM_H */
@@ -38,6 +38,14 @@
  extern "C" {
 #endif
 
+/* Priority ceiling of the stm32l4_dma_*() API, i.e. the most urgent interrupt priority from which
+ * it may be called. Channel bookkeeping only masks interrupts up to this priority, so SERVO, TONE
+ * and SYSTICK (and SAI/DMA handlers configured above it) are not delayed by it.
+ */
+#if !defined(DMA_CRITICAL_PRIORITY)
+#define DMA_CRITICAL_PRIORITY            4
+#endif
+
 #define DMA_CHANNEL_NONE                 0x00
 
 #define DMA_CHANNEL_DMA1_CH1_INDEX       0x01
@@ -623,29 +631,163 @@
 #define DMA_EVENT_TRANSFER_ERROR              0x00000008
 
 #define HAVE_STM32L4_DMA_GET
+#define HAVE_STM32L4_DMA_START_CIRCULAR
+#define HAVE_STM32L4_DMA_CHAIN
 
 typedef void (*stm32l4_dma_callback_t)(void *context, uint32_t events);
 
+#define DMA_FLAG_SHARED                       0x01
+#define DMA_FLAG_PENDING                      0x02
+
 typedef struct _stm32l4_dma_t {
     DMA_Channel_TypeDef    *DMA;
     uint8_t                interrupt;
     uint8_t                channel;
+    volatile uint8_t       flags;
     uint16_t               size;
     stm32l4_dma_callback_t callback;
     void*                  context;
+    struct _stm32l4_dma_t  *next;        /* DMA_FLAG_SHARED: next client of the same channel */
+    uint32_t               tx_data;      /* DMA_FLAG_PENDING: queued transfer */
+    uint32_t               rx_data;
+    uint32_t               option;
 } stm32l4_dma_t;
 
+/* A pipe streams a ring buffer in "data" to a "sink" peripheral by means of a
+ * circular DMA transfer. If a "source" peripheral is attached, it fills the same
+ * ring via a second circular DMA transfer, which is started half a ring ahead
+ * of the sink. The callback gets DMA_EVENT_TRANSFER_HALF when the sink has drained
+ * the first half of the ring, and DMA_EVENT_TRANSFER_DONE for the second half.
+ */
+
+#define DMA_PIPE_STATE_NONE              0
+#define DMA_PIPE_STATE_READY             1
+#define DMA_PIPE_STATE_PRIME             2
+#define DMA_PIPE_STATE_ACTIVE            3
+
+typedef struct _stm32l4_dma_pipe_t {
+    volatile uint8_t       state;
+    stm32l4_dma_t          *source;
+    uint32_t               source_data;
+    uint32_t               source_option;
+    stm32l4_dma_callback_t source_callback;
+    void*                  source_context;
+    stm32l4_dma_t          *sink;
+    uint32_t               sink_data;
+    uint32_t               sink_option;
+    stm32l4_dma_callback_t sink_callback;
+    void*                  sink_context;
+    uint32_t               data;
+    uint16_t               count;
+    stm32l4_dma_callback_t callback;
+    void*                  context;
+} stm32l4_dma_pipe_t;
+
+/* A chain runs a list of transfers back to back on one channel, in place of the
+ * linked list mode the L4 DMA lacks. The transfer complete interrupt programs
+ * the next descriptor right away, before any callback. A "next" that points back
+ * into the list makes the chain loop till stm32l4_dma_chain_stop(). "tx_data",
+ * "rx_data", "xf_count" and "option" are as for stm32l4_dma_start(), except that
+ * DMA_OPTION_CIRCULAR and DMA_OPTION_EVENT_TRANSFER_HALF are ignored, and that
+ * DMA_OPTION_EVENT_TRANSFER_DONE asks for DMA_EVENT_DESCRIPTOR_DONE once the
+ * descriptor is done (and its successor already running). The callback gets
+ * DMA_EVENT_TRANSFER_DONE after the last descriptor, or DMA_EVENT_TRANSFER_ERROR,
+ * either of which ends the chain. Descriptors are read from the interrupt handler,
+ * so they have to stay valid till then. Not for shared channels.
+ */
+
+#define DMA_EVENT_DESCRIPTOR_DONE             0x00000010
+
+typedef struct _stm32l4_dma_descriptor_t {
+    const struct _stm32l4_dma_descriptor_t *next;
+    uint32_t               tx_data;
+    uint32_t               rx_data;
+    uint16_t               xf_count;
+    uint32_t               option;
+} stm32l4_dma_descriptor_t;
+
+#define DMA_CHAIN_STATE_NONE             0
+#define DMA_CHAIN_STATE_READY            1
+#define DMA_CHAIN_STATE_ACTIVE           2
+
+typedef struct _stm32l4_dma_chain_t {
+    volatile uint8_t       state;
+    stm32l4_dma_t          *dma;
+    const stm32l4_dma_descriptor_t * volatile current;
+    stm32l4_dma_callback_t dma_callback;
+    void*                  dma_context;
+    stm32l4_dma_callback_t callback;
+    void*                  context;
+} stm32l4_dma_chain_t;
+
+/* stm32l4_dma_create() claims the channel of "channel" for exclusive use, and
+ * returns false if it is held already, in which case the channel is flagged in
+ * stm32l4_dma_conflicts().
+ */
 extern bool stm32l4_dma_create(stm32l4_dma_t *dma, uint8_t channel, unsigned int priority);
+
+/* Assigns the first free channel from "channels", a DMA_CHANNEL_NONE terminated
+ * list of the legal DMA_CHANNEL_* selections for a peripheral request, in order
+ * of preference. Returns the selection, or DMA_CHANNEL_NONE if all of them are
+ * in use, in which case the channels are flagged in stm32l4_dma_conflicts().
+ */
+extern uint8_t stm32l4_dma_allocate(stm32l4_dma_t *dma, const uint8_t *channels, unsigned int priority);
+
+/* Like stm32l4_dma_create(), but the channel can be created by several clients
+ * (none of them exclusive), which take turns: stm32l4_dma_start() while another
+ * client's transfer is active queues the transfer, and it gets started once that
+ * client calls stm32l4_dma_stop(). Only suitable for peripherals that hold off
+ * their DMA requests until served (e.g. I2C), for clients that do not take
+ * DMA interrupts (callback NULL), and whose transfers end with stm32l4_dma_stop().
+ */
+extern bool stm32l4_dma_create_shared(stm32l4_dma_t *dma, uint8_t channel, unsigned int priority);
+
+/* Channel masks (bit n for DMA_CHANNEL_DMA1_CHn_INDEX, bit 8+n for DMA2) for which
+ * a create or allocation was refused, optionally clearing them. stm32l4_dma_owner() returns
+ * the selection the channel "index" is held by, or DMA_CHANNEL_NONE.
+ */
+extern uint32_t stm32l4_dma_conflicts(bool clear);
+extern uint8_t stm32l4_dma_owner(unsigned int index);
+
 extern void stm32l4_dma_destroy(stm32l4_dma_t *dma);
 extern void stm32l4_dma_enable(stm32l4_dma_t *dma, stm32l4_dma_callback_t callback, void *context);
 extern void stm32l4_dma_disable(stm32l4_dma_t *dma);
 extern void stm32l4_dma_start(stm32l4_dma_t *dma, uint32_t tx_data, uint32_t rx_data, uint16_t xf_count, uint32_t option);
+/* Like stm32l4_dma_start(), but the transfer wraps around and keeps running until
+ * stm32l4_dma_stop(). DMA_EVENT_TRANSFER_HALF/DONE are delivered for every pass.
+ */
+extern void stm32l4_dma_start_circular(stm32l4_dma_t *dma, uint32_t tx_data, uint32_t rx_data, uint16_t xf_count, uint32_t option);
 extern uint16_t stm32l4_dma_stop(stm32l4_dma_t *dma);
 extern uint16_t stm32l4_dma_count(stm32l4_dma_t *dma);
 extern bool stm32l4_dma_done(stm32l4_dma_t *dma);
 extern void stm32l4_dma_poll(stm32l4_dma_t *dma);
 extern stm32l4_dma_t* stm32l4_dma_get(uint8_t channel);
 
+/* Background memcpy()/memset() on a free DMA2 channel, which is held only for the
+ * duration of the transfer. "callback" is invoked with DMA_EVENT_TRANSFER_DONE (or
+ * DMA_EVENT_TRANSFER_ERROR) at NVIC "priority" once "dst" is written. Returns false
+ * if the operation was instead done synchronously by the CPU, because "size" is below
+ * DMA_MEMORY_MINIMUM, too large for a single transfer, or no channel was free; the
+ * callback has been invoked already in that case. Unaligned heads and tails are
+ * dealt with by the CPU before the transfer is started. "dst" must not be touched
+ * till the callback.
+ */
+#define DMA_MEMORY_MINIMUM                    256
+
+extern bool stm32l4_dma_memcpy_async(void *dst, const void *src, uint32_t size, unsigned int priority, stm32l4_dma_callback_t callback, void *context);
+extern bool stm32l4_dma_memset_async(void *dst, uint8_t data, uint32_t size, unsigned int priority, stm32l4_dma_callback_t callback, void *context);
+
+extern void stm32l4_dma_pipe_create(stm32l4_dma_pipe_t *pipe);
+extern bool stm32l4_dma_pipe_source(stm32l4_dma_pipe_t *pipe, stm32l4_dma_t *dma, uint32_t data, uint32_t option);
+extern bool stm32l4_dma_pipe_sink(stm32l4_dma_pipe_t *pipe, stm32l4_dma_t *dma, uint32_t data, uint32_t option);
+extern bool stm32l4_dma_pipe_start(stm32l4_dma_pipe_t *pipe, void *data, uint16_t xf_count, stm32l4_dma_callback_t callback, void *context);
+extern void stm32l4_dma_pipe_stop(stm32l4_dma_pipe_t *pipe);
+
+extern void stm32l4_dma_chain_create(stm32l4_dma_chain_t *chain);
+extern bool stm32l4_dma_chain_start(stm32l4_dma_chain_t *chain, stm32l4_dma_t *dma, const stm32l4_dma_descriptor_t *descriptor, stm32l4_dma_callback_t callback, void *context);
+extern void stm32l4_dma_chain_stop(stm32l4_dma_chain_t *chain);
+extern const stm32l4_dma_descriptor_t *stm32l4_dma_chain_current(stm32l4_dma_chain_t *chain);
+
 extern void DMA1_Channel1_IRQHandler(void);
 extern void DMA1_Channel2_IRQHandler(void);
 extern void DMA1_Channel3_IRQHandler(void);
@@ -37,12 +37,24 @@
  extern "C" {
 #endif
 
+typedef void (*stm32l4_flash_callback_t)(void *context, bool success);
+
 extern uint32_t stm32l4_flash_size(void);
 extern bool     stm32l4_flash_unlock(void);
 extern void     stm32l4_flash_lock(void);
 extern bool     stm32l4_flash_erase(uint32_t address, uint32_t count);
 extern bool     stm32l4_flash_program(uint32_t address, const uint8_t *data, uint32_t count);
 
+/* Read-while-write on dual bank parts (STM32L476/STM32L496): erase (2048 byte pages) or program
+ * (8 byte aligned) within the upper half of the flash, while code keeps running from the lower
+ * half. The flash has to stay unlocked, and "data" valid, till "callback" is called from the FLASH
+ * interrupt. Returns false on single bank parts, for an address in the lower half, or while busy.
+ */
+extern void     stm32l4_flash_configure(unsigned int priority);
+extern bool     stm32l4_flash_erase_async(uint32_t address, uint32_t count, stm32l4_flash_callback_t callback, void *context);
+extern bool     stm32l4_flash_program_async(uint32_t address, const uint8_t *data, uint32_t count, stm32l4_flash_callback_t callback, void *context);
+extern bool     stm32l4_flash_busy(void);
+
 #ifdef __cplusplus
 }
 #endif
@@ -91,6 +91,13 @@ enum {
 #define I2C_STATUS_ABORT               0x00000020
 
 #define I2C_CONTROL_RESTART            0x00000001
+#define I2C_CONTROL_CLOCK_MASK         0x00000070 /* per transfer clock, ignored for the transfer after a RESTART */
+#define I2C_CONTROL_CLOCK_SHIFT        4
+#define I2C_CONTROL_CLOCK_DEFAULT      0x00000000 /* clock passed to stm32l4_i2c_configure() */
+#define I2C_CONTROL_CLOCK_10           0x00000010
+#define I2C_CONTROL_CLOCK_100          0x00000020
+#define I2C_CONTROL_CLOCK_400          0x00000030
+#define I2C_CONTROL_CLOCK_1000         0x00000040
 
 typedef void (*stm32l4_i2c_callback_t)(void *context, uint32_t events);
 
@@ -119,6 +126,7 @@ typedef struct _stm32l4_i2c_t {
     uint8_t                      mode;
     uint32_t                     clock;
     uint32_t                     option;
+    uint32_t                     fmp;
     stm32l4_i2c_callback_t       callback;
     void                         *context;
     uint32_t                     events;
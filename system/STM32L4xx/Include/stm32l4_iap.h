@@ -64,6 +64,35 @@ typedef struct _stm32l4_iap_suffix_t {
 
 extern void stm32l4_iap(void);
 
+extern const stm32l4_iap_prefix_t stm32l4_iap_prefix;
+
+/* Staged firmware update from a file on the DOSFS volume (SD card or SFLASH, mounted
+ * by the caller). The file is the ".iap" output of the build, i.e. the sketch image
+ * starting at 0x08000400 (without the boot block) followed by the DFU suffix.
+ *
+ * stm32l4_iap_stage() checks the suffix (VID/PID against stm32l4_iap_prefix, CRC over
+ * the whole file) and the embedded stm32l4_iap_info_t (signature against the running
+ * sketch), and copies boot block plus image to the top of the free flash above the
+ * running sketch (FLASHSTART/FLASHEND, so whatever was stored there gets lost). Pages
+ * that already hold the same data are not erased again. The staged copy is verified
+ * against the file CRC. Nothing of the running sketch is touched.
+ *
+ * stm32l4_iap_apply() then erases and reprograms (from a SRAM resident routine, with
+ * interrupts disabled and the IWDG being reloaded) only those pages that differ from the
+ * staged copy, verifies them and resets. It returns only if nothing has been staged.
+ * If power fails in between, the sketch can always be restored via the ROM DFU.
+ */
+
+#define IAP_STATUS_SUCCESS                0
+#define IAP_STATUS_NOT_FOUND              1   /* no such file, or read error */
+#define IAP_STATUS_INVALID_IMAGE          2   /* no DFU suffix, VID/PID or signature mismatch */
+#define IAP_STATUS_CRC_MISMATCH           3
+#define IAP_STATUS_TOO_LARGE              4   /* image and staged copy do not fit into flash */
+#define IAP_STATUS_FLASH_ERROR            5   /* erase or program error, staged copy corrupt */
+
+extern int  stm32l4_iap_stage(const char *path);
+extern void stm32l4_iap_apply(void);
+
 #ifdef __cplusplus
 }
 #endif
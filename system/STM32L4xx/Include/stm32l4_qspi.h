@@ -74,6 +74,9 @@
 #define QSPI_COMMAND_MODE_SINGLE         0x00004000
 #define QSPI_COMMAND_MODE_DUAL           0x00008000
 #define QSPI_COMMAND_MODE_QUAD           0x0000c000
+#define QSPI_COMMAND_MODE_SIZE_MASK      0x00030000
+#define QSPI_COMMAND_MODE_SIZE_8BIT      0x00000000
+#define QSPI_COMMAND_MODE_SIZE_16BIT     0x00010000
 #define QSPI_COMMAND_WAIT_STATES_MASK    0x007c0000
 #define QSPI_COMMAND_WAIT_STATES_SHIFT   18
 #define QSPI_COMMAND_DATA_MASK           0x03000000
@@ -93,6 +96,7 @@ typedef void (*stm32l4_qspi_callback_t)(void *context, uint32_t events);
 #define QSPI_STATE_RECEIVE               4
 #define QSPI_STATE_TRANSMIT              5
 #define QSPI_STATE_WAIT                  6
+#define QSPI_STATE_MAPPED                7
 
 typedef struct _stm32l4_qspi_pins_t {
     uint16_t                    clk;
@@ -111,6 +115,7 @@ typedef struct _stm32l4_qspi_t {
     stm32l4_qspi_pins_t         pins;
     uint8_t                     mode;
     uint16_t                    select;
+    uint32_t                    map;
     uint32_t                    clock;
     uint32_t                    option;
     stm32l4_qspi_callback_t     callback;
@@ -136,6 +141,14 @@ extern bool stm32l4_qspi_transmit(stm32l4_qspi_t *qspi, uint32_t command, uint32
 extern bool stm32l4_qspi_wait(stm32l4_qspi_t *qspi, uint32_t command, uint32_t address, uint8_t *rx_data, unsigned int rx_count, uint32_t mask, uint32_t match, uint32_t control);
 extern bool stm32l4_qspi_done(stm32l4_qspi_t *qspi);
 
+/* While mapped, the external memory is readable at QSPI_BASE using "command". A stm32l4_qspi_select()
+ * suspends the memory mapped mode, and the final stm32l4_qspi_unselect() resumes it. Hence nobody may
+ * access the mapped memory while the device is selected (i.e. from an interrupt handler that could
+ * preempt an indirect access).
+ */
+extern bool stm32l4_qspi_map(stm32l4_qspi_t *qspi, uint32_t command);
+extern bool stm32l4_qspi_unmap(stm32l4_qspi_t *qspi);
+
 extern void QUADSPI_IRQHandler(void);
 
 #ifdef __cplusplus
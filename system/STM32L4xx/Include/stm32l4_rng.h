@@ -0,0 +1,71 @@
+/*
+ * Copyright (c) 2017 Thomas Roell.  All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal with the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ *  1. Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimers.
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimers in the
+ *     documentation and/or other materials provided with the distribution.
+ *  3. Neither the name of Thomas Roell, nor the names of its contributors
+ *     may be used to endorse or promote products derived from this Software
+ *     without specific prior written permission.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ * CONTRIBUTORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * WITH THE SOFTWARE.
+ */
+
+#if !defined(_STM32L4_RNG_H)
+#define _STM32L4_RNG_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "stm32l4xx.h"
+
+#ifdef __cplusplus
+ extern "C" {
+#endif
+
+/* True random numbers from the RNG unit. stm32l4_rng_enable() starts to fill a pool of
+ * RNG_POOL_SIZE words from the RNG interrupt. Once the pool is full the RNG and its
+ * 48MHz clock (SYSTEM_CLK48_REFERENCE_RNG, which also holds voltage range 1) are turned
+ * off again. stm32l4_rng_read() takes one word out of the pool and returns false if it
+ * is empty; if the pool drops below half, refilling is started, which may have to wait
+ * for the 48MHz clock to settle. Seed and clock errors are recovered from by discarding
+ * the current output and restarting the RNG.
+ *
+ * The pool is meant for seeding (and reseeding) a PRNG, not for bulk data.
+ */
+
+#define RNG_POOL_SIZE 16   /* words, power of 2 */
+
+/* Priority ceiling of the stm32l4_rng_*() API, i.e. the most urgent interrupt priority from which
+ * it may be called. The RNG interrupt priority passed to stm32l4_rng_enable() must not be more
+ * urgent than that.
+ */
+#if !defined(RNG_CRITICAL_PRIORITY)
+#define RNG_CRITICAL_PRIORITY 4
+#endif
+
+extern bool     stm32l4_rng_enable(unsigned int priority);
+extern void     stm32l4_rng_disable(void);
+extern bool     stm32l4_rng_read(uint32_t *p_data);
+extern uint32_t stm32l4_rng_count(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _STM32L4_RNG_H */
@@ -61,8 +61,21 @@ enum {
 #define SAI_OPTION_FORMAT_PCM_SHORT       0x00000003
 #define SAI_OPTION_FORMAT_PCM_LONG        0x00000004
 #define SAI_OPTION_FORMAT_DSP             0x00000005
+#define SAI_OPTION_FORMAT_TDM             0x00000006
 #define SAI_OPTION_MONO                   0x00000008
 #define SAI_OPTION_MCK                    0x00000010
+#define SAI_OPTION_SYNC                   0x00000020  /* slave of the other block of the same SAI, no SCK/FS/MCK pins */
+
+/* TDM: 4 or 8 slots of 16 bits (width <= 16) or 32 bits per frame, a one bit FS pulse ahead of
+ * slot 0. Only the slots in SAI_OPTION_SLOT_ENABLE (0 means all) carry data, so the DMA buffer
+ * holds one sample per enabled slot per frame, in slot order.
+ */
+#define SAI_OPTION_SLOTS_MASK             0x00000f00
+#define SAI_OPTION_SLOTS_SHIFT            8
+#define SAI_OPTION_SLOTS_4                0x00000300
+#define SAI_OPTION_SLOTS_8                0x00000700
+#define SAI_OPTION_SLOT_ENABLE_MASK       0x00ff0000
+#define SAI_OPTION_SLOT_ENABLE_SHIFT      16
 
 #define SAI_EVENT_RECEIVE_DONE            0x10000000
 #define SAI_EVENT_RECEIVE_REQUEST         0x20000000
@@ -71,6 +84,8 @@ enum {
 
 typedef void (*stm32l4_sai_callback_t)(void *context, uint32_t events);
 
+typedef void (*stm32l4_sai_duplex_callback_t)(void *context, const uint8_t *rx_data, uint8_t *tx_data, uint32_t count);
+
   // typedef void (*stm32l4_sai_xf_callback_t)(struct _stm32l4_sai_t *sai);
 
 #define SAI_STATE_NONE                 0
@@ -89,6 +104,8 @@ typedef void (*stm32l4_sai_callback_t)(void *context, uint32_t events);
 #define SAI_STATE_TRANSMIT_DMA         13
 #define SAI_STATE_TRANSMIT_REQUEST     14
 #define SAI_STATE_TRANSMIT_DONE        15
+#define SAI_STATE_PIPE                 16
+#define SAI_STATE_DUPLEX               17
 
 typedef struct _stm32l4_sai_pins_t {
     uint16_t                     sck;
@@ -114,6 +131,10 @@ typedef struct _stm32l4_sai_t {
     void                         *xf_data;
     void                         *xf_data_e;
     stm32l4_dma_t                dma;
+    struct _stm32l4_sai_t        *duplex;
+    stm32l4_sai_duplex_callback_t duplex_callback;
+    void                         *duplex_context;
+    uint32_t                     duplex_count;
 } stm32l4_sai_t;
 
 
@@ -126,6 +147,16 @@ extern bool stm32l4_sai_notify(stm32l4_sai_t *sai, stm32l4_sai_callback_t callba
 extern bool stm32l4_sai_receive(stm32l4_sai_t *sai, uint8_t *rx_data, uint16_t rx_count);
 extern bool stm32l4_sai_transmit(stm32l4_sai_t *sai, const uint8_t *tx_data, uint16_t tx_count);
 extern bool stm32l4_sai_done(stm32l4_sai_t *sai);
+extern bool stm32l4_sai_pipe(stm32l4_sai_t *sai, stm32l4_dma_pipe_t *pipe, bool receive);
+
+/* Full duplex: "sai" transmits from "tx_data" while "sai_rx" (the other block of the same SAI,
+ * enabled with SAI_OPTION_SYNC and the same width) receives into "rx_data" on the same frames.
+ * Both buffers hold 2 halves of "count" bytes and are run by circular DMA. Whenever a received
+ * half is complete, "callback" gets it together with the transmit half that the SAI will send
+ * next, i.e. input to output latency is one half buffer. "tx_data" starts out as silence.
+ * Passing a NULL "sai_rx" stops both blocks.
+ */
+extern bool stm32l4_sai_duplex(stm32l4_sai_t *sai, stm32l4_sai_t *sai_rx, uint8_t *rx_data, uint8_t *tx_data, uint16_t count, stm32l4_sai_duplex_callback_t callback, void *context);
 
 extern void SAI1_IRQHandler(void);
 #if defined(STM32L476xx) || defined(STM32L496xx)
@@ -36,6 +36,7 @@
 #include "dosfs_device.h"
 
 #include "stm32l4_gpio.h"
+#include "stm32l4_dma.h"
 
 #ifdef __cplusplus
  extern "C" {
@@ -64,6 +65,7 @@ struct _stm32l4_sdmmc_t {
     uint8_t                 media;
     uint8_t                 option;
     uint8_t                 shift;
+    uint8_t                 xf_dma;
     uint32_t                speed;
     uint32_t                au_size;
     uint32_t                erase_size;
@@ -72,6 +74,7 @@ struct _stm32l4_sdmmc_t {
     uint32_t                address;
     uint32_t                count;
     volatile uint8_t        *p_status;
+    dosfs_device_t          *device;
     uint32_t                read_timeout;
     uint32_t                write_timeout;
     uint32_t                RCA;
@@ -80,6 +83,7 @@ struct _stm32l4_sdmmc_t {
     uint8_t                 CSD[16];
     uint8_t                 SCR[8];
     uint8_t                 SSR[64];
+    stm32l4_dma_t           dma;
 
 #if (DOSFS_CONFIG_STATISTICS == 1)
     struct {
@@ -101,6 +105,9 @@ struct _stm32l4_sdmmc_t {
         uint32_t                sdcard_receive_timeout;
         uint32_t                sdcard_receive_retry;
         uint32_t                sdcard_receive_fail;
+        uint32_t                sdcard_receive_dma;
+        uint32_t                sdcard_transmit_dma;
+        uint32_t                sdcard_speed_fallback;
 	uint32_t                sdcard_erase;
 	uint32_t                sdcard_erase_timeout;
 	uint32_t                sdcard_read_single;
@@ -130,6 +137,10 @@ extern int stm32l4_sdmmc_initialize(uint32_t option);
 
 #endif /* (DOSFS_CONFIG_STATISTICS == 1) */
 
+/* Retries are counted always, so that f_getstatistics() can report them.
+ */
+#define STM32L4_SDMMC_RETRY_COUNT(_name)              { sdmmc->device->statistics.retries += 1; STM32L4_SDMMC_STATISTICS_COUNT(_name); }
+
 #ifdef __cplusplus
 }
 #endif
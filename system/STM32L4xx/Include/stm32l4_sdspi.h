@@ -59,16 +59,26 @@ typedef struct _stm32l4_sdspi_pins_t {
 #define STM32L4_SDSPI_STATE_WRITE_MULTIPLE         5
 #define STM32L4_SDSPI_STATE_WRITE_STOP             6
 
+#define STM32L4_SDSPI_XF_STATE_NONE                0
+#define STM32L4_SDSPI_XF_STATE_TOKEN               1
+#define STM32L4_SDSPI_XF_STATE_DATA_8              2
+#define STM32L4_SDSPI_XF_STATE_DATA_16             3
+#define STM32L4_SDSPI_XF_STATE_CRC16               4
+
 #define STM32L4_SDSPI_MODE_NONE                    0
 #define STM32L4_SDSPI_MODE_IDENTIFY                1
 #define STM32L4_SDSPI_MODE_DATA_TRANSFER           2
 
+#define STM32L4_SDSPI_SPEED_DEFAULT                25000000   /* default speed limit of the SD spec */
+#define STM32L4_SDSPI_SPEED_LIMIT                  50000000   /* highest clock tried by the training */
+
 struct _stm32l4_sdspi_t {
     uint8_t                 state;
     uint8_t                 media;
     uint8_t                 option;
     uint8_t                 shift;
     uint32_t                speed;
+    uint32_t                speed_limit;    /* highest data transfer clock, lowered by CRC errors */
     uint32_t                au_size;
     uint32_t                erase_size;
     uint32_t                erase_timeout;
@@ -76,6 +86,7 @@ struct _stm32l4_sdspi_t {
     uint32_t                address;
     uint32_t                count;
     volatile uint8_t        *p_status;
+    dosfs_device_t          *device;
     uint32_t                OCR;
     uint8_t                 CID[16];
     uint8_t                 CSD[16];
@@ -88,6 +99,23 @@ struct _stm32l4_sdspi_t {
     uint32_t                cr1;
     uint32_t                cr2;
 
+    /* Asynchronous READ_MULTIPLE via SPI DMA. "xf_state" is non-zero
+     * while a transfer is in flight, which makes stm32l4_sdspi_lock()
+     * wait until the background transfer has finished.
+     */
+    volatile uint8_t        xf_state;
+    uint8_t                 xf_dma;
+    uint8_t                 xf_token;
+    uint8_t                 xf_crc16[2];
+    uint16_t                xf_default;
+    uint8_t                 *xf_data;
+    uint32_t                xf_count;
+    uint32_t                xf_millis;
+    F_CALLBACK              xf_callback;
+    void                    *xf_context;
+    stm32l4_dma_t           rx_dma;
+    stm32l4_dma_t           tx_dma;
+
 #if (DOSFS_CONFIG_STATISTICS == 1)
     struct {
         uint32_t                sdcard_idle;
@@ -108,6 +136,7 @@ struct _stm32l4_sdspi_t {
         uint32_t                sdcard_receive_timeout;
         uint32_t                sdcard_receive_retry;
         uint32_t                sdcard_receive_fail;
+        uint32_t                sdcard_speed_fallback;
 	uint32_t                sdcard_erase;
 	uint32_t                sdcard_erase_timeout;
 	uint32_t                sdcard_read_single;
@@ -147,6 +176,10 @@ extern int stm32l4_sdspi_initialize_with_pins(
 
 #endif /* (DOSFS_CONFIG_STATISTICS == 1) */
 
+/* Retries are counted always, so that f_getstatistics() can report them.
+ */
+#define STM32L4_SDSPI_RETRY_COUNT(_name)              { sdspi->device->statistics.retries += 1; STM32L4_SDSPI_STATISTICS_COUNT(_name); }
+
 #ifdef __cplusplus
 }
 #endif
@@ -50,7 +50,12 @@ typedef void (*stm32l4_servo_callback_t)(void *context, uint32_t events);
 #define SERVO_STATE_READY                        3
 #define SERVO_STATE_ACTIVE                       4
 
-#define SERVO_SLOT_COUNT                         10
+/* SERVO_SLOT_COUNT sizes stm32l4_servo_table_t and stm32l4_servo_t, so an override has
+ * to be seen by the core as well (build.extra_flags), not just by the sketch.
+ */
+#if !defined(SERVO_SLOT_COUNT)
+#define SERVO_SLOT_COUNT                         24
+#endif
 
 #define SERVO_SYNC_WIDTH                         100     /* sync needs to be at least 100us after the last pulse    */
 #define SERVO_FRAME_WIDTH                        20000   /* the default RC servo frame is 20000us                    */
@@ -126,6 +126,9 @@ typedef void (*stm32l4_spi_callback_t)(void *context, uint32_t events);
 #define SPI_STATE_TRANSFER_16_2        41
 #define SPI_STATE_TRANSFER_16_1        42
 #define SPI_STATE_TRANSFER_16_CRC16    43
+#define SPI_STATE_PIPE                 44
+#define SPI_STATE_SLAVE                45
+#define SPI_STATE_FRAMES_DMA           46
 
 
 #define SPI_CR1_BR_DIV2   (0)
@@ -172,12 +175,14 @@ typedef struct _stm32l4_spi_t {
     uint16_t                    rx_null;
     uint16_t                    crc16;
     uint8_t                     rx_crc16[2];
+    uint16_t                    slave_ss;
     stm32l4_dma_t               tx_dma;
     stm32l4_dma_t               rx_dma;
 } stm32l4_spi_t;
 
 extern bool stm32l4_spi_create(stm32l4_spi_t *spi, unsigned int instance, const stm32l4_spi_pins_t *pins, unsigned int priority, unsigned int mode);
 extern bool stm32l4_spi_destroy(stm32l4_spi_t *spi);
+extern stm32l4_spi_t *stm32l4_spi_get(unsigned int instance);
 extern uint32_t stm32l4_spi_clock(stm32l4_spi_t *spi);
 extern bool stm32l4_spi_enable(stm32l4_spi_t *spi, stm32l4_spi_callback_t callback, void *context, uint32_t events);
 extern bool stm32l4_spi_disable(stm32l4_spi_t *spi);
@@ -188,11 +193,30 @@ extern bool stm32l4_spi_configure(stm32l4_spi_t *spi, uint32_t option);
 extern void stm32l4_spi_exchange(stm32l4_spi_t *spi, const uint8_t *tx_data, uint8_t *rx_data, unsigned int count);
 extern uint8_t stm32l4_spi_exchange8(stm32l4_spi_t *spi, uint8_t data);
 extern uint16_t stm32l4_spi_exchange16(stm32l4_spi_t *spi, uint16_t data);
+/* Exchanges "count" frames of "bits" (4 to 16) bits each, one frame per uint16_t (right aligned).
+ * "tx_data" NULL sends all ones, "rx_data" NULL discards. stm32l4_spi_exchange_frames() is polled,
+ * stm32l4_spi_transfer_frames() uses half word DMA (both DMA channels needed, at most 65535 frames)
+ * and completes like stm32l4_spi_transfer().
+ */
+extern void stm32l4_spi_exchange_frames(stm32l4_spi_t *spi, const uint16_t *tx_data, uint16_t *rx_data, unsigned int count, unsigned int bits);
+extern bool stm32l4_spi_transfer_frames(stm32l4_spi_t *spi, const uint16_t *tx_data, uint16_t *rx_data, unsigned int count, unsigned int bits);
 extern bool stm32l4_spi_receive(stm32l4_spi_t *spi, uint8_t *rx_data, unsigned int rx_count, uint32_t control);
 extern bool stm32l4_spi_transmit(stm32l4_spi_t *spi, const uint8_t *tx_data, unsigned int tx_count, uint32_t control);
 extern bool stm32l4_spi_transfer(stm32l4_spi_t *spi, const uint8_t *tx_data, uint8_t *rx_data, unsigned int count, uint32_t control);
 extern bool stm32l4_spi_done(stm32l4_spi_t *spi);
+extern bool stm32l4_spi_pipe(stm32l4_spi_t *spi, stm32l4_dma_pipe_t *pipe, bool receive, bool wide);
 extern uint16_t stm32l4_spi_crc16(stm32l4_spi_t *spi);
+/* Runs the SPI as a slave, framed by the hardware NSS input "ss" (a GPIO_PIN_Pxy without
+ * AFSEL; it has to be an NSS pin of this instance). Received data goes round "rx_data"
+ * via circular DMA, and "tx_data" (or 0xff if NULL) is sent round the same way, so that the
+ * n-th byte clocked by the master is exchanged with "tx_data[n % count]" and stored in
+ * "rx_data[n % count]". The TX FIFO fetches up to 4 bytes ahead. Passing "rx_data" as NULL
+ * stops slave mode again. Clocks stay on, so STOP is locked out while the slave runs.
+ */
+extern bool stm32l4_spi_slave(stm32l4_spi_t *spi, uint32_t option, uint16_t ss, uint8_t *rx_data, const uint8_t *tx_data, uint16_t count);
+/* Returns the index into "rx_data" the next received byte is stored at.
+ */
+extern uint16_t stm32l4_spi_slave_offset(stm32l4_spi_t *spi);
 extern void stm32l4_spi_poll(stm32l4_spi_t *spi);
 
 extern void SPI1_IRQHandler(void);
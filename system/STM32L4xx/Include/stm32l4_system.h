@@ -43,6 +43,7 @@ enum {
     SYSTEM_PERIPH_SRAM2,
     SYSTEM_PERIPH_DMA1,
     SYSTEM_PERIPH_DMA2,
+    SYSTEM_PERIPH_CRC,
     SYSTEM_PERIPH_GPIOA,
     SYSTEM_PERIPH_GPIOB,
 #ifdef GPIOC_BASE
@@ -67,6 +68,8 @@ enum {
     SYSTEM_PERIPH_ADC,
     SYSTEM_PERIPH_DAC,
     SYSTEM_PERIPH_USB,
+    SYSTEM_PERIPH_RNG,
+    SYSTEM_PERIPH_TSC,
     SYSTEM_PERIPH_USART1,
     SYSTEM_PERIPH_USART2,
 #ifdef USART3_BASE
@@ -138,6 +141,12 @@ enum {
 #define SYSTEM_OPTION_LSE_BYPASS      0x00000001
 #define SYSTEM_OPTION_HSE_BYPASS      0x00000002
 #define SYSTEM_OPTION_VBAT_CHARGING   0x00000004
+#define SYSTEM_OPTION_FLASH_PREFETCH  0x00000008
+
+#define SYSTEM_FLASH_ICACHE           0x00000001
+#define SYSTEM_FLASH_DCACHE           0x00000002
+#define SYSTEM_FLASH_PREFETCH         0x00000004
+#define SYSTEM_FLASH_DEFAULT          (SYSTEM_FLASH_ICACHE | SYSTEM_FLASH_DCACHE)
 
 #define SYSTEM_NOTIFY_COUNT           16
 #define SYSTEM_EVENT_COUNT            7
@@ -187,6 +196,13 @@ typedef void (*stm32l4_system_callback_t)(void *context, uint32_t events);
 #define SYSTEM_WAKEUP_SYNC            0x00000400
 #define SYSTEM_WAKEUP_TIMEOUT         0x00000800
 
+/* What ended the last stm32l4_system_stop(). SYSTEM_STOP_TIMER means an armv7m_timer
+ * deadline ahead of "timeout", which is not a wakeup for the caller.
+ */
+#define SYSTEM_STOP_EVENT             0
+#define SYSTEM_STOP_TIMEOUT           1
+#define SYSTEM_STOP_TIMER             2
+
 #if defined(STM32L432xx) || defined(STM32L433xx) || defined(STM32L452xx) || defined(STM32L496xx)
 #define SYSTEM_SAICLK_NONE            0
 #define SYSTEM_SAICLK_8192000         8192000   /*  32000 * 256 */
@@ -239,7 +255,15 @@ extern void     stm32l4_system_periph_cond_disable(unsigned int periph, volatile
 extern void     stm32l4_system_periph_cond_wake(unsigned int periph, volatile uint32_t *p_mask, uint32_t mask);
 extern void     stm32l4_system_periph_cond_sleep(unsigned int periph, volatile uint32_t *p_mask, uint32_t mask);
 extern void     stm32l4_system_initialize(uint32_t hclk, uint32_t pclk1, uint32_t pclk2, uint32_t lseclk, uint32_t hseclk, uint32_t option);
+extern void     stm32l4_system_flash_configure(uint32_t option);
+extern void     stm32l4_system_flash_invalidate(void);
 extern bool     stm32l4_system_sysclk_configure(uint32_t hclk, uint32_t pclk1, uint32_t pclk2);
+/* Any "clock" can be requested (typically fs * 256). On STM32L432/L433/L452/L496 the
+ * PLLSAI1 N/P pair closest to it is searched for (and cached), and the clock is regenerated
+ * on every sysclk change. On STM32L476 only SYSTEM_SAICLK_11289600 and SYSTEM_SAICLK_49152000
+ * are available (anything else maps to the latter). stm32l4_system_saiclk_error() returns
+ * the deviation of the generated clock in ppm, relative to the reference (HSE, or LSE).
+ */
 extern void     stm32l4_system_saiclk_configure(unsigned int clock);
 extern void     stm32l4_system_clk48_acquire(unsigned int reference);
 extern void     stm32l4_system_clk48_release(unsigned int reference);
@@ -259,10 +283,12 @@ extern uint32_t stm32l4_system_hclk(void);
 extern uint32_t stm32l4_system_pclk1(void);
 extern uint32_t stm32l4_system_pclk2(void);
 extern uint32_t stm32l4_system_saiclk(void);
+extern int32_t  stm32l4_system_saiclk_error(void);
 extern int      stm32l4_system_notify(int slot, stm32l4_system_callback_t callback, void *context, uint32_t events); 
 extern void     stm32l4_system_lock(uint32_t lock); 
 extern void     stm32l4_system_unlock(uint32_t lock);
 extern bool     stm32l4_system_stop(uint32_t timeout);
+extern uint32_t stm32l4_system_stop_reason(void);
 extern void     stm32l4_system_standby(uint32_t config, uint32_t timeout);
 extern void     stm32l4_system_shutdown(uint32_t config, uint32_t timeout);
 extern void     stm32l4_system_reset(void);
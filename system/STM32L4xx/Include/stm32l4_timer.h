@@ -34,6 +34,8 @@
 
 #include "stm32l4xx.h"
 
+#include "stm32l4_dma.h"
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -89,7 +91,39 @@ enum {
 #define TIMER_OPTION_COUNT_CENTER_DOWN           0x00000040
 #define TIMER_OPTION_COUNT_CENTER_UP_DOWN        0x00000060
 #define TIMER_OPTION_COUNT_PRELOAD               0x00000080
+#define TIMER_OPTION_TRIGGER_UPDATE              0x00000100
+#define TIMER_OPTION_ONE_PULSE                   0x00000200   /* OPM without starting, for stm32l4_timer_slave() */
 
+/* TRGO source (MMS), e.g. to trigger ADC conversions at a fixed phase of the period.
+ */
+#define TIMER_TRIGGER_NONE                       0
+#define TIMER_TRIGGER_UPDATE                     2
+#define TIMER_TRIGGER_COMPARE_1                  4   /* OC1REF */
+#define TIMER_TRIGGER_COMPARE_2                  5   /* OC2REF */
+#define TIMER_TRIGGER_COMPARE_3                  6   /* OC3REF */
+#define TIMER_TRIGGER_COMPARE_4                  7   /* OC4REF */
+
+/* Slave mode controller (SMS/TS), e.g. to start a one pulse on an input edge. TI1FP1/TI2FP2 take
+ * the polarity and filter of channel 1/2, configured as input via stm32l4_timer_channel().
+ */
+#define TIMER_SLAVE_NONE                         0x00000000
+#define TIMER_SLAVE_MODE_MASK                    0x0000000f
+#define TIMER_SLAVE_MODE_RESET                   0x00000004
+#define TIMER_SLAVE_MODE_GATED                   0x00000005
+#define TIMER_SLAVE_MODE_TRIGGER                 0x00000006
+#define TIMER_SLAVE_MODE_RESET_TRIGGER           0x00000008   /* for TIMER_CONTROL_RETRIGGERABLE */
+#define TIMER_SLAVE_INPUT_MASK                   0x00000070
+#define TIMER_SLAVE_INPUT_SHIFT                  4
+#define TIMER_SLAVE_INPUT_ITR0                   0x00000000
+#define TIMER_SLAVE_INPUT_ITR1                   0x00000010
+#define TIMER_SLAVE_INPUT_ITR2                   0x00000020
+#define TIMER_SLAVE_INPUT_ITR3                   0x00000030
+#define TIMER_SLAVE_INPUT_TI1F_ED                0x00000040
+#define TIMER_SLAVE_INPUT_TI1FP1                 0x00000050
+#define TIMER_SLAVE_INPUT_TI2FP2                 0x00000060
+#define TIMER_SLAVE_INPUT_ETRF                   0x00000070
+
+#define TIMER_EVENT_STREAM_DONE                  0x04000000
 #define TIMER_EVENT_PERIOD                       0x08000000
 #define TIMER_EVENT_CHANNEL_1                    0x10000000
 #define TIMER_EVENT_CHANNEL_2                    0x20000000
@@ -122,6 +156,8 @@ enum {
 #define TIMER_CONTROL_COMPARE_FORCED_INACTIVE    0x00060000
 #define TIMER_CONTROL_PWM                        0x00070000
 #define TIMER_CONTROL_PWM_INVERTED               0x00080000
+#define TIMER_CONTROL_RETRIGGERABLE              0x00090000   /* retriggerable OPM mode 1 */
+#define TIMER_CONTROL_RETRIGGERABLE_INVERTED     0x000a0000   /* retriggerable OPM mode 2 */
 #define TIMER_CONTROL_PWM_COMPLEMENTARY          0x00100000
 
 typedef void (*stm32l4_timer_callback_t)(void *context, uint32_t events);
@@ -137,13 +173,19 @@ typedef struct _stm32l4_timer_t {
     volatile uint8_t            state;
     uint8_t                     instance;
     uint8_t                     priority;
+    uint8_t                     trigger;
     stm32l4_timer_callback_t    callback;
     void                        *context;
     uint32_t                    events;
     volatile uint32_t           channels;
     volatile uint32_t           capture[4];
+    stm32l4_timer_callback_t    stream_callback;
+    void                        *stream_context;
+    stm32l4_dma_t               dma;
 } stm32l4_timer_t;
 
+/* Fails if "instance" is held by another timer that has not been destroyed.
+ */
 extern bool     stm32l4_timer_create(stm32l4_timer_t *timer, unsigned int instance, unsigned int priority, unsigned int mode);
 extern bool     stm32l4_timer_destroy(stm32l4_timer_t *timer);
 extern uint32_t stm32l4_timer_clock(stm32l4_timer_t *timer);
@@ -155,9 +197,27 @@ extern bool     stm32l4_timer_start(stm32l4_timer_t *timer, bool oneshot);
 extern bool     stm32l4_timer_stop(stm32l4_timer_t *timer);
 extern uint32_t stm32l4_timer_count(stm32l4_timer_t *timer);
 extern bool     stm32l4_timer_period(stm32l4_timer_t *timer, uint32_t period, bool offset);
+/* Selects the TRGO source, which sticks across stm32l4_timer_configure() without TIMER_OPTION_TRIGGER_UPDATE.
+ */
+extern bool     stm32l4_timer_trigger(stm32l4_timer_t *timer, uint32_t trigger);
+/* Selects the slave mode and its trigger input, which stm32l4_timer_configure() resets to TIMER_SLAVE_NONE.
+ */
+extern bool     stm32l4_timer_slave(stm32l4_timer_t *timer, uint32_t slave);
 extern bool     stm32l4_timer_channel(stm32l4_timer_t *timer, unsigned int channel, uint32_t compare, uint32_t control);
 extern bool     stm32l4_timer_compare(stm32l4_timer_t *timer, unsigned int channel, uint32_t compare);
+extern bool     stm32l4_timer_compare_multiple(stm32l4_timer_t *timer, uint32_t mask, const uint32_t *compare);
 extern uint32_t stm32l4_timer_capture(stm32l4_timer_t *timer, unsigned int channel);
+extern bool     stm32l4_timer_stream(stm32l4_timer_t *timer, unsigned int channel, const uint16_t *data, uint16_t count, stm32l4_timer_callback_t callback, void *context);
+extern bool     stm32l4_timer_stream_cyclic(stm32l4_timer_t *timer, unsigned int channel, const uint16_t *data, uint16_t count);
+extern bool     stm32l4_timer_pattern(stm32l4_timer_t *timer, volatile uint32_t *address, const uint32_t *data, uint16_t count, stm32l4_timer_callback_t callback, void *context);
+extern bool     stm32l4_timer_pattern_cyclic(stm32l4_timer_t *timer, volatile uint32_t *address, const uint32_t *data, uint16_t count);
+extern bool     stm32l4_timer_stream_stop(stm32l4_timer_t *timer);
+extern bool     stm32l4_timer_stream_done(stm32l4_timer_t *timer);
+extern uint16_t stm32l4_timer_stream_count(stm32l4_timer_t *timer);
+extern bool     stm32l4_timer_capture_stream(stm32l4_timer_t *timer, unsigned int channel, uint16_t *data, uint16_t count, stm32l4_timer_callback_t callback, void *context);
+extern bool     stm32l4_timer_sample(stm32l4_timer_t *timer, const volatile uint32_t *address, uint16_t *data, uint16_t count, stm32l4_timer_callback_t callback, void *context);
+extern bool     stm32l4_timer_sample_cyclic(stm32l4_timer_t *timer, const volatile uint32_t *address, uint16_t *data, uint16_t count);
+extern unsigned int stm32l4_timer_stream_encode(uint16_t *slots, const uint8_t *data, unsigned int count, uint16_t zero, uint16_t one);
 
 extern void TIM1_BRK_TIM15_IRQHandler(void);
 extern void TIM1_UP_TIM16_IRQHandler(void);
@@ -0,0 +1,139 @@
+/*
+ * Copyright (c) 2017 Thomas Roell.  All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal with the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ *  1. Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimers.
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimers in the
+ *     documentation and/or other materials provided with the distribution.
+ *  3. Neither the name of Thomas Roell, nor the names of its contributors
+ *     may be used to endorse or promote products derived from this Software
+ *     without specific prior written permission.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ * CONTRIBUTORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * WITH THE SOFTWARE.
+ */
+
+#if !defined(_STM32L4_TSC_H)
+#define _STM32L4_TSC_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "stm32l4xx.h"
+
+#include "armv7m_timer.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define TSC_GROUP_COUNT              8
+#define TSC_CHANNEL_COUNT            24   /* 3 per group, the 4th IO is the sampling capacitor */
+
+#define TSC_OPTION_MAX_COUNT_MASK    0x00000007
+#define TSC_OPTION_MAX_COUNT_SHIFT   0
+#define TSC_OPTION_MAX_COUNT_16383   0x00000000
+#define TSC_OPTION_MAX_COUNT_8191    0x00000001
+#define TSC_OPTION_MAX_COUNT_4095    0x00000002
+#define TSC_OPTION_MAX_COUNT_2047    0x00000003
+#define TSC_OPTION_MAX_COUNT_1023    0x00000004
+#define TSC_OPTION_SPREAD_SPECTRUM   0x00000010
+
+#define TSC_EVENT_TOUCH              0x00000001  /* a channel went from released to touched */
+#define TSC_EVENT_RELEASE            0x00000002  /* a channel went from touched to released */
+#define TSC_EVENT_ERROR              0x00000004  /* max count reached, i.e. broken electrode or sampling capacitor */
+#define TSC_EVENT_ACQUIRE            0x80000000  /* end of an acquisition cycle */
+
+typedef void (*stm32l4_tsc_callback_t)(void *context, uint32_t events);
+
+#define TSC_STATE_NONE               0
+#define TSC_STATE_INIT               1
+#define TSC_STATE_READY              2
+#define TSC_STATE_CALIBRATE          3
+#define TSC_STATE_ACTIVE             4
+
+typedef struct _stm32l4_tsc_channel_t {
+    uint16_t                   pin;
+    uint8_t                    group;
+    uint8_t                    io;
+    uint16_t                   threshold;
+    volatile uint16_t          value;
+    volatile uint32_t          baseline;   /* Q4 */
+} stm32l4_tsc_channel_t;
+
+typedef struct _stm32l4_tsc_t {
+    volatile uint8_t           state;
+    uint8_t                    priority;
+    uint8_t                    channel_count;
+    uint8_t                    phase_count;
+    volatile uint8_t           phase;
+    volatile uint8_t           calibrate;
+    volatile bool              busy;
+    uint32_t                   period;
+    uint32_t                   option;
+    stm32l4_tsc_callback_t     callback;
+    void                       *context;
+    volatile uint32_t          events;
+    uint32_t                   sampling;   /* IOSCR */
+    uint32_t                   ioccr[3];
+    uint8_t                    iogcsr[3];
+    int8_t                     xlate[3][TSC_GROUP_COUNT];
+    volatile uint32_t          touched;
+    volatile uint32_t          changed;
+    volatile uint32_t          errors;
+    armv7m_timer_t             timer;
+    stm32l4_tsc_channel_t      channels[TSC_CHANNEL_COUNT];
+} stm32l4_tsc_t;
+
+/* Touch Sensing Controller with periodic background acquisition.
+ *
+ * Each group (8 of them, 4 IOs each) needs one IO declared as sampling
+ * capacitor with stm32l4_tsc_sampling(); the other IOs of the group can be
+ * channels. Pins are GPIO_PIN_Pxy values, the alternate function is picked
+ * by the driver. All groups are acquired in parallel, one channel per group
+ * at a time, so a cycle takes as many acquisitions as the busiest group has
+ * channels. A cycle is started every "period" milliseconds off the
+ * armv7m_timer wheel and runs entirely from the TSC interrupt.
+ *
+ * A touch lowers the count of a channel. The first 8 cycles after
+ * stm32l4_tsc_enable() set up the baseline; after that it follows slow drift
+ * (faster upwards than downwards) while the channel is not touched. A channel
+ * is touched once "baseline - value" exceeds its threshold, and released
+ * once it falls below half of it. A threshold of 0 is 1/16th of the
+ * baseline. Touch and release are reported with TSC_EVENT_TOUCH and
+ * TSC_EVENT_RELEASE. stm32l4_tsc_touched() returns the touched channels as
+ * a bit mask, stm32l4_tsc_changed() the ones that changed since its last
+ * call.
+ */
+extern bool stm32l4_tsc_create(stm32l4_tsc_t *tsc, unsigned int priority);
+extern bool stm32l4_tsc_destroy(stm32l4_tsc_t *tsc);
+extern bool stm32l4_tsc_sampling(stm32l4_tsc_t *tsc, uint16_t pin);
+extern int  stm32l4_tsc_channel(stm32l4_tsc_t *tsc, uint16_t pin, uint16_t threshold);
+extern bool stm32l4_tsc_enable(stm32l4_tsc_t *tsc, uint32_t period, uint32_t option, stm32l4_tsc_callback_t callback, void *context, uint32_t events);
+extern bool stm32l4_tsc_disable(stm32l4_tsc_t *tsc);
+extern bool stm32l4_tsc_notify(stm32l4_tsc_t *tsc, stm32l4_tsc_callback_t callback, void *context, uint32_t events);
+extern uint32_t stm32l4_tsc_touched(stm32l4_tsc_t *tsc);
+extern uint32_t stm32l4_tsc_changed(stm32l4_tsc_t *tsc);
+extern uint32_t stm32l4_tsc_value(stm32l4_tsc_t *tsc, unsigned int channel);
+extern uint32_t stm32l4_tsc_baseline(stm32l4_tsc_t *tsc, unsigned int channel);
+
+extern void TSC_IRQHandler(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _STM32L4_TSC_H */
@@ -60,6 +60,8 @@ enum {
 #define UART_MODE_RX_DMA             0x00000002
 #define UART_MODE_TX_DMA_SECONDARY   0x00000004
 #define UART_MODE_RX_DMA_SECONDARY   0x00000008
+#define UART_MODE_RX_DMA_CIRCULAR    0x00000010  /* internal, see UART_OPTION_RX_DMA_CIRCULAR */
+#define UART_MODE_WAKEUP             0x00000020  /* internal, see UART_OPTION_WAKEUP */
 
 #define UART_OPTION_STOP_MASK        0x0000000f
 #define UART_OPTION_STOP_SHIFT       0
@@ -88,6 +90,8 @@ enum {
 #define UART_OPTION_RX_INVERT        0x00080000
 #define UART_OPTION_TX_INVERT        0x00100000
 #define UART_OPTION_DATA_INVERT      0x00200000
+#define UART_OPTION_RX_DMA_CIRCULAR  0x00400000
+#define UART_OPTION_WAKEUP           0x00800000  /* LPUART1 only: LSE clock, keeps receiving in STOP2 (bitrate <= 9600) */
 
 #define UART_EVENT_IDLE              0x00000001
 #define UART_EVENT_BREAK             0x00000002
@@ -107,6 +111,7 @@ typedef void (*stm32l4_uart_callback_t)(void *context, uint32_t events);
 #define UART_STATE_READY             3
 #define UART_STATE_TRANSMIT          4
 #define UART_STATE_BREAK             5
+#define UART_STATE_FRAME             6
 
 typedef struct _stm32l4_uart_pins_t {
     uint16_t                     rx;
@@ -137,12 +142,21 @@ typedef struct _stm32l4_uart_t {
     uint16_t                   rx_index;
     uint16_t                   rx_event;
     volatile uint32_t          rx_count;
+    volatile uint32_t          rx_total;
+    uint32_t                   rx_base;
+    uint32_t                   brr;
     stm32l4_dma_t              tx_dma;
     stm32l4_dma_t              rx_dma;
 } stm32l4_uart_t;
 
 extern bool stm32l4_uart_create(stm32l4_uart_t *uart, unsigned int instance, const stm32l4_uart_pins_t *pins, unsigned int priority, unsigned int mode);
 extern bool stm32l4_uart_destroy(stm32l4_uart_t *uart);
+/* With UART_OPTION_RX_DMA_CIRCULAR (and UART_MODE_RX_DMA) "rx_data" is filled
+ * directly by a circular DMA. Received data is picked up on the DMA half/full
+ * interrupts, and on IDLE line or receiver timeout, each reporting one
+ * UART_EVENT_RECEIVE. If the reader falls behind by more than "rx_size"
+ * bytes the oldest data is lost.
+ */
 extern bool stm32l4_uart_enable(stm32l4_uart_t *uart, uint8_t *rx_data, uint16_t rx_size, uint32_t bitrate, uint32_t option, stm32l4_uart_callback_t callback, void *context, uint32_t events);
 extern bool stm32l4_uart_disable(stm32l4_uart_t *uart);
 extern bool stm32l4_uart_configure(stm32l4_uart_t *uart, uint32_t bitrate, uint32_t option);
@@ -150,8 +164,16 @@ extern bool stm32l4_uart_notify(stm32l4_uart_t *uart, stm32l4_uart_callback_t ca
 extern unsigned int stm32l4_uart_receive(stm32l4_uart_t *uart, uint8_t *rx_data, uint16_t rx_count);
 extern unsigned int stm32l4_uart_count(stm32l4_uart_t *uart);
 extern int stm32l4_uart_peek(stm32l4_uart_t *uart);
+extern unsigned int stm32l4_uart_peek_buffer(stm32l4_uart_t *uart, const uint8_t **p_data_return);
+extern void stm32l4_uart_consume(stm32l4_uart_t *uart, uint16_t rx_count);
 extern bool stm32l4_uart_transmit(stm32l4_uart_t *uart, const uint8_t *tx_data, uint16_t tx_count);
 extern bool stm32l4_uart_send_break(stm32l4_uart_t *uart);
+/* Break framed transmit (DMX512 style). A 0x00 character is sent at "break_bitrate",
+ * so that its start and data bits form the break, and its stop bits the mark after
+ * break. Then "tx_data" follows at the configured bitrate, same as with
+ * stm32l4_uart_transmit(). The receiver is reset while the bitrate is switched.
+ */
+extern bool stm32l4_uart_transmit_frame(stm32l4_uart_t *uart, const uint8_t *tx_data, uint16_t tx_count, uint32_t break_bitrate);
 extern bool stm32l4_uart_done(stm32l4_uart_t *uart);
 extern void stm32l4_uart_poll(stm32l4_uart_t *uart);
 
@@ -0,0 +1,78 @@
+/*
+ * Copyright (c) 2017 Thomas Roell.  All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal with the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ *  1. Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimers.
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimers in the
+ *     documentation and/or other materials provided with the distribution.
+ *  3. Neither the name of Thomas Roell, nor the names of its contributors
+ *     may be used to endorse or promote products derived from this Software
+ *     without specific prior written permission.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ * CONTRIBUTORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * WITH THE SOFTWARE.
+ */
+
+#if !defined(_STM32L4_USBD_AUDIO_H)
+#define _STM32L4_USBD_AUDIO_H
+
+#include "stm32l4xx.h"
+
+#ifdef __cplusplus
+ extern "C" {
+#endif
+
+/* Fixed stream format: 48kHz, 16 bit stereo (LRLR...). A packet carries up to
+ * one frame more than the nominal 48 frames per ms.
+ */
+#define USBD_AUDIO_SAMPLE_RATE   48000
+#define USBD_AUDIO_FRAME_SIZE    4
+#define USBD_AUDIO_PACKET_SIZE   196
+
+/* Feedback is a 10.14 number of frames per ms.
+ */
+#define USBD_AUDIO_FEEDBACK_NOMINAL  (((uint32_t)USBD_AUDIO_SAMPLE_RATE << 14) / 1000)
+
+#define USBD_AUDIO_EVENT_START   0x00000001
+#define USBD_AUDIO_EVENT_STOP    0x00000002
+#define USBD_AUDIO_EVENT_MUTE    0x00000004
+#define USBD_AUDIO_EVENT_VOLUME  0x00000008
+
+/* All callbacks are called from the USB interrupt.
+ *
+ * "receive" gets the packet that was just stored at "data" ("count" bytes), and returns where
+ * the next packet (USBD_AUDIO_PACKET_SIZE bytes) is to be stored, or NULL to drop it. It is
+ * called with "data" == NULL if there is no packet to hand back, i.e. after USBD_AUDIO_EVENT_START
+ * or after a dropped packet. After stm32l4_usbd_audio_disable() one more packet may be stored
+ * into the buffer returned last.
+ *
+ * "feedback" returns the rate the host should send at, as a 10.14 number of frames per ms.
+ */
+typedef uint8_t * (*stm32l4_usbd_audio_receive_t)(void *context, uint8_t *data, uint32_t count);
+typedef uint32_t (*stm32l4_usbd_audio_feedback_t)(void *context);
+typedef void (*stm32l4_usbd_audio_event_t)(void *context, uint32_t events);
+
+extern bool stm32l4_usbd_audio_enable(stm32l4_usbd_audio_receive_t receive, stm32l4_usbd_audio_feedback_t feedback, stm32l4_usbd_audio_event_t event, void *context);
+extern void stm32l4_usbd_audio_disable(void);
+extern bool stm32l4_usbd_audio_streaming(void);
+extern bool stm32l4_usbd_audio_mute(void);
+extern int16_t stm32l4_usbd_audio_volume(void);   /* in 1/256 dB, -60dB .. 0dB */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _STM32L4_USBD_AUDIO_H */
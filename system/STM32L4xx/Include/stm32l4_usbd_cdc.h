@@ -89,11 +89,27 @@ extern bool stm32l4_usbd_cdc_notify(stm32l4_usbd_cdc_t *usbd_cdc, stm32l4_usbd_c
 extern unsigned int stm32l4_usbd_cdc_receive(stm32l4_usbd_cdc_t *usbd_cdc, uint8_t *rx_data, uint16_t rx_count);
 extern unsigned int stm32l4_usbd_cdc_count(stm32l4_usbd_cdc_t *usbd_cdc);
 extern int stm32l4_usbd_cdc_peek(stm32l4_usbd_cdc_t *usbd_cdc);
+extern unsigned int stm32l4_usbd_cdc_peek_buffer(stm32l4_usbd_cdc_t *usbd_cdc, const uint8_t **p_data_return);
+extern void stm32l4_usbd_cdc_consume(stm32l4_usbd_cdc_t *usbd_cdc, uint16_t rx_count);
 extern bool stm32l4_usbd_cdc_transmit(stm32l4_usbd_cdc_t *usbd_cdc, const uint8_t *tx_data, uint32_t tx_count);
 extern bool stm32l4_usbd_cdc_done(stm32l4_usbd_cdc_t *usbd_cdc);
 extern void stm32l4_usbd_cdc_poll(stm32l4_usbd_cdc_t *usbd_cdc);
 extern volatile stm32l4_usbd_cdc_info_t* stm32l4_usbd_cdc_info(stm32l4_usbd_cdc_t *usbd_cdc);
 
+/* Raw WebUSB mode. Bulk OUT transfers go as blocks of up to "size" bytes (a multiple of 64)
+ * into "block0"/"block1" instead of the WebUSBSerial FIFO. "block_callback" hands a received
+ * block to the application (from the USB interrupt). It gets returned with
+ * stm32l4_usbd_webusb_raw_release(). Vendor (and non-CDC class) requests to the WebUSB
+ * interface go to "request_callback". For device-to-host requests it fills in "data"
+ * (at most 64 bytes).
+ */
+typedef void (*stm32l4_usbd_webusb_block_callback_t)(void *context, uint8_t *data, uint32_t count);
+typedef void (*stm32l4_usbd_webusb_request_callback_t)(void *context, uint8_t request, uint8_t *data, uint32_t length);
+
+extern bool stm32l4_usbd_webusb_raw_enable(uint8_t *block0, uint8_t *block1, uint32_t size, stm32l4_usbd_webusb_block_callback_t block_callback, stm32l4_usbd_webusb_request_callback_t request_callback, void *context);
+extern void stm32l4_usbd_webusb_raw_disable(void);
+extern void stm32l4_usbd_webusb_raw_release(uint8_t *block);
+
 #ifdef __cplusplus
 }
 #endif
@@ -36,6 +36,7 @@
 #endif
 
 extern void stm32l4_usbd_dap_initialize(uint16_t pin_swclk, uint16_t pin_swdio);
+extern void stm32l4_usbd_dap_swo_initialize(unsigned int instance, uint16_t pin_swo, unsigned int priority);
 
 #ifdef __cplusplus
 }
@@ -35,7 +35,18 @@
  extern "C" {
 #endif
 
+/* Reports queued while the IN endpoint is busy, and their maximum size (without the report id).
+ */
+#define USBD_HID_QUEUE_SIZE   8
+#define USBD_HID_REPORT_SIZE  31
+
+/* Called with the last queued (and not yet sent) report of the same id and size. Returns
+ * true if "data" was folded into "queued", false to queue "data" separately.
+ */
+typedef bool (*stm32l4_usbd_hid_merge_t)(uint8_t *queued, const uint8_t *data, uint32_t count);
+
 extern void stm32l4_usbd_hid_send_report(uint8_t id, const uint8_t *data, uint32_t count);
+extern bool stm32l4_usbd_hid_queue_report(uint8_t id, const uint8_t *data, uint32_t count, stm32l4_usbd_hid_merge_t merge);
 extern bool stm32l4_usbd_hid_done();
 
 #ifdef __cplusplus
@@ -0,0 +1,80 @@
+/*
+ * Copyright (c) 2017 Thomas Roell.  All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal with the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ *  1. Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimers.
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimers in the
+ *     documentation and/or other materials provided with the distribution.
+ *  3. Neither the name of Thomas Roell, nor the names of its contributors
+ *     may be used to endorse or promote products derived from this Software
+ *     without specific prior written permission.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ * CONTRIBUTORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * WITH THE SOFTWARE.
+ */
+
+#if !defined(_STM32L4_USBD_MIDI_H)
+#define _STM32L4_USBD_MIDI_H
+
+#include "stm32l4xx.h"
+
+#ifdef __cplusplus
+ extern "C" {
+#endif
+
+/* Events are 4 byte USB-MIDI event packets, stored as little endian uint32_t:
+ * bits 0..3 are the Code Index Number, bits 4..7 the cable number, bits 8..31
+ * the (up to 3) MIDI bytes.
+ */
+#define USBD_MIDI_EVENT(_cable,_cin,_b0,_b1,_b2) \
+    ((uint32_t)((((_cable) & 15) << 4) | ((_cin) & 15)) | ((uint32_t)(_b0) << 8) | ((uint32_t)(_b1) << 16) | ((uint32_t)(_b2) << 24))
+
+/* Number of events each queue holds (a power of 2). A bulk packet carries up
+ * to 16 events.
+ */
+#define USBD_MIDI_QUEUE_SIZE        64
+#define USBD_MIDI_PACKET_EVENTS     16
+
+#define USBD_MIDI_EVENT_RECEIVE     0x00000001
+#define USBD_MIDI_EVENT_TRANSMIT    0x00000002
+
+/* "callback" is called from the USB interrupt, with USBD_MIDI_EVENT_RECEIVE after
+ * events were added to the receive queue, and with USBD_MIDI_EVENT_TRANSMIT after
+ * events were taken from the transmit queue.
+ *
+ * Each queue is lock-free with a single producer and a single consumer, i.e.
+ * stm32l4_usbd_midi_receive() and stm32l4_usbd_midi_transmit() may each only
+ * be used from one context at a time. Transmitted events are collected and
+ * sent once per SOF, or right away when a full packet is queued up.
+ * stm32l4_usbd_midi_flush() sends the collected events without waiting for the
+ * next SOF.
+ */
+typedef void (*stm32l4_usbd_midi_callback_t)(void *context, uint32_t events);
+
+extern bool stm32l4_usbd_midi_enable(stm32l4_usbd_midi_callback_t callback, void *context, uint32_t events);
+extern void stm32l4_usbd_midi_disable(void);
+extern bool stm32l4_usbd_midi_connected(void);
+extern unsigned int stm32l4_usbd_midi_count(void);
+extern unsigned int stm32l4_usbd_midi_receive(uint32_t *data, unsigned int count);
+extern unsigned int stm32l4_usbd_midi_space(void);
+extern unsigned int stm32l4_usbd_midi_transmit(const uint32_t *data, unsigned int count);
+extern void stm32l4_usbd_midi_flush(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _STM32L4_USBD_MIDI_H */
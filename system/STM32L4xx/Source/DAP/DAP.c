@@ -117,7 +117,7 @@ static uint8_t DAP_Info(uint8_t id, uint8_t *info) {
     case DAP_ID_CAPABILITIES:
       info[0] = ((DAP_SWD  != 0)       ? (1U << 0) : 0U) |
                 ((DAP_JTAG != 0)       ? (1U << 1) : 0U) |
-                ((SWO_UART != 0)       ? (1U << 2) : 0U) |
+                (((SWO_UART != 0) && SWO_Present()) ? (1U << 2) : 0U) |
                 ((SWO_MANCHESTER != 0) ? (1U << 3) : 0U) |
                 /* Atomic Commands  */   (1U << 4);
       length = 1U;
@@ -152,11 +152,14 @@ static uint8_t DAP_Info(uint8_t id, uint8_t *info) {
 
 #if ((DAP_SWD != 0) || (DAP_JTAG != 0))
 
-static uint64_t TimerTick;
+// Busy waits only, so the DWT cycle counter can be used.
+static uint32_t TimerStart;
+static uint32_t TimerCycles;
 
 // Start Timer
 static __inline void TIMER_START (uint32_t usec) {
-  TimerTick = armv7m_systick_micros() + usec;
+  TimerStart  = armv7m_systick_cycles();
+  TimerCycles = armv7m_systick_micros_to_cycles(usec);
 }
 
 // Stop Timer
@@ -164,7 +167,7 @@ static __inline void TIMER_STOP (void) {}
 
 // Check if Timer expired
 static __inline uint32_t TIMER_EXPIRED (void) {
-  return ((armv7m_systick_micros() > TimerTick) ? 1U : 0U);
+  return (((armv7m_systick_cycles() - TimerStart) > TimerCycles) ? 1U : 0U);
 }
 
 #endif
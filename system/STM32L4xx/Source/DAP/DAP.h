@@ -226,6 +226,8 @@ extern uint32_t SWO_Baudrate    (const uint8_t *request, uint8_t *response);
 extern uint32_t SWO_Control     (const uint8_t *request, uint8_t *response);
 extern uint32_t SWO_Status                              (uint8_t *response);
 extern uint32_t SWO_Data        (const uint8_t *request, uint8_t *response);
+extern void     SWO_Setup       (unsigned int instance, uint16_t pin, unsigned int priority);
+extern uint32_t SWO_Present     (void);
 
 extern uint32_t DAP_ProcessCommand       (const uint8_t *request, uint8_t *response);
 extern uint32_t DAP_ExecuteCommand       (const uint8_t *request, uint8_t *response);
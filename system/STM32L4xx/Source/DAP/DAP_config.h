@@ -86,21 +86,24 @@ extern uint32_t SystemCoreClock;
 /// This configuration settings is used to optimized the communication performance with the
 /// debugger and depends on the USB peripheral. For devices with limited RAM or USB buffer the
 /// setting can be reduced (valid range is 1 .. 255). Change setting to 4 for High-Speed USB.
-#define DAP_PACKET_COUNT        16U             ///< Buffers: 64 = Full-Speed, 4 = High-Speed.
+#define DAP_PACKET_COUNT        32U             ///< Buffers: 64 = Full-Speed, 4 = High-Speed.
 
 /// Indicate that UART Serial Wire Output (SWO) trace is available.
 /// This information is returned by the command \ref DAP_Info as part of <b>Capabilities</b>.
-#define SWO_UART                0               ///< SWO UART:  1 = available, 0 = not available
+/// The capability is only reported if a SWO pin has been set up via \ref SWO_Setup.
+#define SWO_UART                1               ///< SWO UART:  1 = available, 0 = not available
 
 /// Maximum SWO UART Baudrate
-#define SWO_UART_MAX_BAUDRATE   10000000U       ///< SWO UART Maximum Baudrate in Hz
+#define SWO_UART_MAX_BAUDRATE   921600U         ///< SWO UART Maximum Baudrate in Hz
 
 /// Indicate that Manchester Serial Wire Output (SWO) trace is available.
 /// This information is returned by the command \ref DAP_Info as part of <b>Capabilities</b>.
 #define SWO_MANCHESTER          0               ///< SWO Manchester:  1 = available, 0 = not available
 
 /// SWO Trace Buffer Size.
+#ifndef SWO_BUFFER_SIZE
 #define SWO_BUFFER_SIZE         4096U           ///< SWO Trace Buffer Size in bytes (must be 2^n)
+#endif
 
 
 /// Debug Unit is connected to fixed Target Device.
@@ -161,6 +164,7 @@ typedef struct {
   uint16_t     SWDIO_BIT;
   uint16_t     SWDIO_PIN;
   uint32_t     SWDIO_OUTPUT;
+  uint32_t     SWDIO_SHIFT;
 } DAP_PINS_t;
 
 extern DAP_PINS_t DAP_PINS;
@@ -253,19 +257,15 @@ static inline __attribute__((always_inline)) void PIN_SWDIO_TMS_CLR (void) {
 \return Current status of the SWDIO DAP hardware I/O pin.
 */
 static inline __attribute__((always_inline)) uint32_t PIN_SWDIO_IN (void) {
-  return !!(DAP_PINS.SWDIO_GPIO->IDR & DAP_PINS.SWDIO_BIT);
-  // return ((DAP_PINS.SWDIO_GPIO->IDR & DAP_PINS.SWDIO_BIT) ? 1 : 0);
+  return ((DAP_PINS.SWDIO_GPIO->IDR >> DAP_PINS.SWDIO_SHIFT) & 1U);
 }
 
 /** SWDIO I/O pin: Set Output (used in SWD mode only).
 \param bit Output value for the SWDIO DAP hardware I/O pin.
 */
 static inline __attribute__((always_inline)) void PIN_SWDIO_OUT (uint32_t bit) {
-  if (bit & 1) {
-    DAP_PINS.SWDIO_GPIO->BSRR = DAP_PINS.SWDIO_BIT;
-  } else {
-    DAP_PINS.SWDIO_GPIO->BRR = DAP_PINS.SWDIO_BIT;
-  }
+  // BSRR[15:0] sets, BSRR[31:16] resets; no branch in the SWD data phase loops.
+  DAP_PINS.SWDIO_GPIO->BSRR = (uint32_t)DAP_PINS.SWDIO_BIT << ((~bit & 1U) << 4);
 }
 
 /** SWDIO I/O pin: Switch to Output mode (used in SWD mode only).
@@ -0,0 +1,319 @@
+/*
+ * Copyright (c) 2017 Thomas Roell.  All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal with the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ *  1. Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimers.
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimers in the
+ *     documentation and/or other materials provided with the distribution.
+ *  3. Neither the name of Thomas Roell, nor the names of its contributors
+ *     may be used to endorse or promote products derived from this Software
+ *     without specific prior written permission.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ * CONTRIBUTORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * WITH THE SOFTWARE.
+ */
+
+#include <string.h>
+#include "stm32l4xx.h"
+
+#include "armv7m.h"
+#include "stm32l4_gpio.h"
+#include "stm32l4_uart.h"
+#include "DAP_config.h"
+#include "DAP.h"
+
+#if (SWO_UART != 0)
+
+/* SWO UART capture. The SWO pin of the target is routed to the RX pin of a U(S)ART, which
+ * receives via DMA into "SWO_BUFFER_SIZE" bytes of trace buffer. The buffer gets drained by
+ * DAP_SWO_Data commands (there is no streaming endpoint on a HID based probe).
+ */
+
+typedef struct _swo_device_t {
+    stm32l4_uart_t        uart;
+    volatile uint8_t      present;
+    uint8_t               transport;
+    uint8_t               mode;
+    uint8_t               status;
+    volatile uint8_t      error;
+    uint32_t              baudrate;
+    uint8_t               buffer[SWO_BUFFER_SIZE];
+} swo_device_t;
+
+static swo_device_t swo_device;
+
+static void SWO_Event(void *context, uint32_t events)
+{
+    if (events & UART_EVENT_OVERRUN)
+    {
+	swo_device.error |= DAP_SWO_BUFFER_OVERRUN;
+    }
+}
+
+static uint32_t SWO_Start(void)
+{
+    if (!stm32l4_uart_enable(&swo_device.uart, &swo_device.buffer[0], SWO_BUFFER_SIZE, swo_device.baudrate, UART_OPTION_DATA_SIZE_8 | UART_OPTION_PARITY_NONE | UART_OPTION_STOP_1, SWO_Event, NULL, UART_EVENT_OVERRUN))
+    {
+	return 0;
+    }
+
+    swo_device.error = 0;
+
+    return 1;
+}
+
+static void SWO_Stop(void)
+{
+    stm32l4_uart_disable(&swo_device.uart);
+}
+
+void SWO_Setup(unsigned int instance, uint16_t pin, unsigned int priority)
+{
+    stm32l4_uart_pins_t pins;
+
+    pins.rx = pin;
+    pins.tx = GPIO_PIN_NONE;
+    pins.cts = GPIO_PIN_NONE;
+    pins.rts_de = GPIO_PIN_NONE;
+
+    if (stm32l4_uart_create(&swo_device.uart, instance, &pins, priority, UART_MODE_RX_DMA))
+    {
+	swo_device.transport = 0;
+	swo_device.mode = DAP_SWO_OFF;
+	swo_device.status = 0;
+	swo_device.error = 0;
+	swo_device.baudrate = 0;
+
+	swo_device.present = 1;
+    }
+}
+
+uint32_t SWO_Present(void)
+{
+    return swo_device.present;
+}
+
+// Process SWO Transport command and prepare response
+//   request:  pointer to request data
+//   response: pointer to response data
+//   return:   number of bytes in response (lower 16 bits)
+//             number of bytes in request (upper 16 bits)
+uint32_t SWO_Transport(const uint8_t *request, uint8_t *response)
+{
+    uint8_t result;
+
+    result = DAP_ERROR;
+
+    /* Only "0 = None" and "1 = DAP_SWO_Data command" are supported.
+     */
+    if (!(swo_device.status & DAP_SWO_CAPTURE_ACTIVE) && (request[0] <= 1))
+    {
+	swo_device.transport = request[0];
+
+	result = DAP_OK;
+    }
+
+    *response = result;
+
+    return ((1U << 16) | 1U);
+}
+
+// Process SWO Mode command and prepare response
+//   request:  pointer to request data
+//   response: pointer to response data
+//   return:   number of bytes in response (lower 16 bits)
+//             number of bytes in request (upper 16 bits)
+uint32_t SWO_Mode(const uint8_t *request, uint8_t *response)
+{
+    uint8_t result;
+
+    if (swo_device.status & DAP_SWO_CAPTURE_ACTIVE)
+    {
+	SWO_Stop();
+    }
+
+    swo_device.status = 0;
+    swo_device.mode = DAP_SWO_OFF;
+
+    result = DAP_ERROR;
+
+    if ((request[0] == DAP_SWO_OFF) || ((request[0] == DAP_SWO_UART) && swo_device.present))
+    {
+	swo_device.mode = request[0];
+
+	result = DAP_OK;
+    }
+
+    *response = result;
+
+    return ((1U << 16) | 1U);
+}
+
+// Process SWO Baudrate command and prepare response
+//   request:  pointer to request data
+//   response: pointer to response data
+//   return:   number of bytes in response (lower 16 bits)
+//             number of bytes in request (upper 16 bits)
+uint32_t SWO_Baudrate(const uint8_t *request, uint8_t *response)
+{
+    uint32_t baudrate;
+
+    baudrate = ((uint32_t)request[0] <<  0) |
+	       ((uint32_t)request[1] <<  8) |
+	       ((uint32_t)request[2] << 16) |
+	       ((uint32_t)request[3] << 24);
+
+    if (swo_device.mode != DAP_SWO_UART)
+    {
+	baudrate = 0;
+    }
+
+    if (baudrate > SWO_UART_MAX_BAUDRATE)
+    {
+	baudrate = SWO_UART_MAX_BAUDRATE;
+    }
+
+    if (baudrate && (swo_device.status & DAP_SWO_CAPTURE_ACTIVE))
+    {
+	if (!stm32l4_uart_configure(&swo_device.uart, baudrate, UART_OPTION_DATA_SIZE_8 | UART_OPTION_PARITY_NONE | UART_OPTION_STOP_1))
+	{
+	    baudrate = 0;
+	}
+    }
+
+    if (!baudrate)
+    {
+	if (swo_device.status & DAP_SWO_CAPTURE_ACTIVE)
+	{
+	    SWO_Stop();
+	}
+
+	swo_device.status = 0;
+    }
+
+    swo_device.baudrate = baudrate;
+
+    response[0] = (uint8_t)(baudrate >>  0);
+    response[1] = (uint8_t)(baudrate >>  8);
+    response[2] = (uint8_t)(baudrate >> 16);
+    response[3] = (uint8_t)(baudrate >> 24);
+
+    return ((4U << 16) | 4U);
+}
+
+// Process SWO Control command and prepare response
+//   request:  pointer to request data
+//   response: pointer to response data
+//   return:   number of bytes in response (lower 16 bits)
+//             number of bytes in request (upper 16 bits)
+uint32_t SWO_Control(const uint8_t *request, uint8_t *response)
+{
+    uint8_t result;
+
+    result = DAP_OK;
+
+    if ((request[0] & DAP_SWO_CAPTURE_ACTIVE) != (swo_device.status & DAP_SWO_CAPTURE_ACTIVE))
+    {
+	if (request[0] & DAP_SWO_CAPTURE_ACTIVE)
+	{
+	    if ((swo_device.mode == DAP_SWO_UART) && swo_device.baudrate && SWO_Start())
+	    {
+		swo_device.status = DAP_SWO_CAPTURE_ACTIVE;
+	    }
+	    else
+	    {
+		result = DAP_ERROR;
+	    }
+	}
+	else
+	{
+	    SWO_Stop();
+
+	    swo_device.status = 0;
+	}
+    }
+
+    *response = result;
+
+    return ((1U << 16) | 1U);
+}
+
+// Process SWO Status command and prepare response
+//   response: pointer to response data
+//   return:   number of bytes in response
+uint32_t SWO_Status(uint8_t *response)
+{
+    uint32_t count;
+
+    count = (swo_device.status & DAP_SWO_CAPTURE_ACTIVE) ? stm32l4_uart_count(&swo_device.uart) : 0;
+
+    response[0] = swo_device.status | swo_device.error;
+    response[1] = (uint8_t)(count >>  0);
+    response[2] = (uint8_t)(count >>  8);
+    response[3] = (uint8_t)(count >> 16);
+    response[4] = (uint8_t)(count >> 24);
+
+    swo_device.error = 0;
+
+    return (5U);
+}
+
+// Process SWO Data command and prepare response
+//   request:  pointer to request data
+//   response: pointer to response data
+//   return:   number of bytes in response (lower 16 bits)
+//             number of bytes in request (upper 16 bits)
+uint32_t SWO_Data(const uint8_t *request, uint8_t *response)
+{
+    uint32_t count;
+
+    count = ((uint32_t)request[0] << 0) | ((uint32_t)request[1] << 8);
+
+    if (count > (DAP_PACKET_SIZE - 4U))
+    {
+	count = DAP_PACKET_SIZE - 4U;
+    }
+
+    if ((swo_device.transport == 1) && (swo_device.status & DAP_SWO_CAPTURE_ACTIVE))
+    {
+	count = stm32l4_uart_receive(&swo_device.uart, &response[3], count);
+    }
+    else
+    {
+	count = 0;
+    }
+
+    response[0] = swo_device.status | swo_device.error;
+    response[1] = (uint8_t)(count >> 0);
+    response[2] = (uint8_t)(count >> 8);
+
+    swo_device.error = 0;
+
+    return ((2U << 16) | (3U + count));
+}
+
+#else /* SWO_UART != 0 */
+
+void SWO_Setup(unsigned int instance, uint16_t pin, unsigned int priority)
+{
+}
+
+uint32_t SWO_Present(void)
+{
+    return 0;
+}
+
+#endif /* SWO_UART != 0 */
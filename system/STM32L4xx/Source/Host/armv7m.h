@@ -0,0 +1,128 @@
+/*
+ * Copyright (c) 2017 Thomas Roell.  All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal with the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ *  1. Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimers.
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimers in the
+ *     documentation and/or other materials provided with the distribution.
+ *  3. Neither the name of Thomas Roell, nor the names of its contributors
+ *     may be used to endorse or promote products derived from this Software
+ *     without specific prior written permission.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ * CONTRIBUTORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * WITH THE SOFTWARE.
+ */
+
+/* Host replacement for "armv7m.h" used by Makefile.host. It provides only what dosfs_core.c
+ * and dosfs_sflash.c need to run single threaded under Linux.
+ */
+
+#if !defined(_ARMV7M_H)
+#define _ARMV7M_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <time.h>
+
+#ifdef __cplusplus
+ extern "C" {
+#endif
+
+#define __optimize_speed __attribute__((optimize("O3")))
+#define __noinit
+
+static inline void armv7m_core_yield(void)
+{
+}
+
+static inline void armv7m_core_relax(void)
+{
+}
+
+static inline uint32_t armv7m_atomic_load(volatile uint32_t *p_data)
+{
+    return __atomic_load_n(p_data, __ATOMIC_RELAXED);
+}
+
+static inline void armv7m_atomic_store(volatile uint32_t *p_data, uint32_t data)
+{
+    __atomic_store_n(p_data, data, __ATOMIC_RELAXED);
+}
+   
+static inline uint32_t armv7m_atomic_exchange(volatile uint32_t *p_data, uint32_t data)
+{
+    return __atomic_exchange_n(p_data, data, __ATOMIC_RELAXED);
+}
+
+static inline bool armv7m_atomic_compare_exchange(volatile uint32_t *p_data, uint32_t *p_data_expected, uint32_t data)
+{
+    return __atomic_compare_exchange_n(p_data, p_data_expected, data, false, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST);
+}
+
+static inline uint32_t armv7m_atomic_add(volatile uint32_t *p_data, uint32_t data)
+{
+    return __atomic_fetch_add(p_data, data, __ATOMIC_SEQ_CST);
+}
+
+static inline uint32_t armv7m_atomic_sub(volatile uint32_t *p_data, uint32_t data)
+{
+    return __atomic_fetch_sub(p_data, data, __ATOMIC_SEQ_CST);
+}
+
+static inline uint32_t armv7m_atomic_and(volatile uint32_t *p_data, uint32_t data)
+{
+    return __atomic_fetch_and(p_data, data, __ATOMIC_SEQ_CST);
+}
+
+static inline uint32_t armv7m_atomic_or(volatile uint32_t *p_data, uint32_t data)
+{
+    return __atomic_fetch_or(p_data, data, __ATOMIC_SEQ_CST);
+}
+
+static inline uint64_t armv7m_systick_micros(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return ((uint64_t)ts.tv_sec * 1000000) + (ts.tv_nsec / 1000);
+}
+
+static inline uint32_t armv7m_systick_cycles(void)
+{
+    return (uint32_t)armv7m_systick_micros();
+}
+
+static inline uint32_t armv7m_systick_cycles_to_micros(uint32_t cycles)
+{
+    return cycles;
+}
+
+static inline uint32_t armv7m_systick_micros_to_cycles(uint32_t micros)
+{
+    return micros;
+}
+
+static inline uint64_t armv7m_systick_millis(void)
+{
+    return armv7m_systick_micros() / 1000;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _ARMV7M_H */
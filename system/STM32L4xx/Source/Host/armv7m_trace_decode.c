@@ -0,0 +1,355 @@
+/*
+ * Copyright (c) 2017 Thomas Roell.  All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal with the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ *  1. Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimers.
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimers in the
+ *     documentation and/or other materials provided with the distribution.
+ *  3. Neither the name of Thomas Roell, nor the names of its contributors
+ *     may be used to endorse or promote products derived from this Software
+ *     without specific prior written permission.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ * CONTRIBUTORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * WITH THE SOFTWARE.
+ */
+
+/* Decodes the driver event trace (see armv7m_trace.h), either from a dump of the RAM ring
+ * or from a raw SWO capture of the ITM stream:
+ *
+ *     armv7m_trace_decode [-c clock] ring.bin
+ *     armv7m_trace_decode -s [-c clock] swo.bin
+ *
+ * A ring dump is the memory image of "armv7m_trace_control", e.g. from OpenOCD with
+ * "dump_image ring.bin &armv7m_trace_control <size>"; "size" is 8 + 8 * ARMV7M_TRACE_ENTRY_COUNT.
+ * For SWO the ITM stimulus port ARMV7M_TRACE_ITM_PORT and local timestamps need to be enabled
+ * by the probe (e.g. "itm port 1 on" and "tpiu config ..."), with a timestamp prescaler of 1.
+ * "clock" is SYSCLK in Hz, used to print times in microseconds (default 80000000).
+ */
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "armv7m_trace.h"
+
+static double armv7m_trace_clock = 80000000.0;
+
+static void armv7m_trace_print(uint64_t cycles, uint64_t delta, uint32_t event)
+{
+    uint32_t id, data;
+
+    id = event >> 24;
+    data = event & 0x00ffffff;
+
+    printf("%12llu %+10lld %12.3fus  ", (unsigned long long)cycles, (long long)delta, ((double)cycles * 1000000.0) / armv7m_trace_clock);
+
+    switch (id) {
+    case ARMV7M_TRACE_PENDSV_ENTER:
+	printf("PENDSV_ENTER routine=0x%06x\n", data);
+	break;
+    case ARMV7M_TRACE_PENDSV_LEAVE:
+	printf("PENDSV_LEAVE\n");
+	break;
+    case ARMV7M_TRACE_DMA:
+	printf("DMA          channel=DMA%u_CH%u events=0x%02x\n", ((data >> 8) & 8) ? 2 : 1, (data >> 8) & 7, data & 0xff);
+	break;
+    case ARMV7M_TRACE_SAI:
+	printf("SAI          instance=%u sr=0x%04x\n", data >> 16, data & 0xffff);
+	break;
+    case ARMV7M_TRACE_SAI_DMA:
+	printf("SAI_DMA      instance=%u events=0x%04x\n", data >> 16, data & 0xffff);
+	break;
+    case ARMV7M_TRACE_SPI_DMA:
+	printf("SPI_DMA      instance=%u events=0x%04x\n", data >> 16, data & 0xffff);
+	break;
+    case ARMV7M_TRACE_SPI_DONE:
+	printf("SPI_DONE     instance=%u events=0x%04x\n", data >> 16, data & 0xffff);
+	break;
+    case ARMV7M_TRACE_SDSPI_CMD:
+	printf("SDSPI_CMD    CMD%u\n", data & 0x3f);
+	break;
+    case ARMV7M_TRACE_SDSPI_RX:
+	printf("SDSPI_RX     count=%u\n", data);
+	break;
+    case ARMV7M_TRACE_SDSPI_TX:
+	printf("SDSPI_TX     count=%u\n", data);
+	break;
+    case ARMV7M_TRACE_USB_ENTER:
+	printf("USB_ENTER\n");
+	break;
+    case ARMV7M_TRACE_USB_LEAVE:
+	printf("USB_LEAVE\n");
+	break;
+    default:
+	if (id >= ARMV7M_TRACE_USER)
+	{
+	    printf("USER_%02x      data=0x%06x\n", id, data);
+	}
+	else
+	{
+	    printf("UNKNOWN_%02x   data=0x%06x\n", id, data);
+	}
+	break;
+    }
+}
+
+static uint32_t armv7m_trace_word(const uint8_t *data)
+{
+    return ((uint32_t)data[0] << 0) | ((uint32_t)data[1] << 8) | ((uint32_t)data[2] << 16) | ((uint32_t)data[3] << 24);
+}
+
+/* The ring is in little endian target layout: index, count, then "count" entries. The
+ * oldest entry is at "index & (count -1)" once the ring has wrapped. Cycle counts are
+ * extended to 64 bits across CYCCNT wraps, assuming no gap of 2^32 cycles.
+ */
+static int armv7m_trace_ring(FILE *file)
+{
+    uint8_t header[8], *entries;
+    uint32_t index, count, start, n, cycles, previous;
+    uint64_t total;
+
+    if (fread(header, 1, 8, file) != 8)
+    {
+	fprintf(stderr, "short ring dump\n");
+
+	return 1;
+    }
+
+    index = armv7m_trace_word(&header[0]);
+    count = armv7m_trace_word(&header[4]);
+
+    if (!count || (count & (count -1)) || (count > 65536))
+    {
+	fprintf(stderr, "bad ring size %u\n", count);
+
+	return 1;
+    }
+
+    entries = malloc(8 * count);
+
+    if (!entries || (fread(entries, 8, count, file) != count))
+    {
+	fprintf(stderr, "short ring dump\n");
+
+	free(entries);
+
+	return 1;
+    }
+
+    if (index > count)
+    {
+	start = index - count;
+
+	printf("# %u events, %u lost\n", index, index - count);
+    }
+    else
+    {
+	start = 0;
+
+	printf("# %u events\n", index);
+    }
+
+    previous = 0;
+    total = 0;
+
+    for (n = start; n < index; n++)
+    {
+	cycles = armv7m_trace_word(&entries[8 * (n & (count -1)) + 0]);
+
+	if (n == start)
+	{
+	    previous = cycles;
+	}
+
+	total += (uint32_t)(cycles - previous);
+
+	armv7m_trace_print(total, (n == start) ? 0 : (int64_t)(uint32_t)(cycles - previous), armv7m_trace_word(&entries[8 * (n & (count -1)) + 4]));
+
+	previous = cycles;
+    }
+
+    free(entries);
+
+    return 0;
+}
+
+/* ITM packets: sync (5 or more 0x00 then 0x80), overflow (0x70), local timestamps (format 1
+ * "11xx0000" followed by up to 4 continuation bytes, format 2 "0ttt0000" with an inline
+ * delta), and software source packets "ppppp0ss" followed by 1, 2 or 4 payload bytes. All
+ * other hardware source / extension packets are skipped by their size.
+ */
+static int armv7m_trace_swo(FILE *file)
+{
+    uint64_t timestamp, last;
+    uint32_t payload, delta;
+    unsigned int size, n, overflows;
+    int c;
+
+    timestamp = 0;
+    last = 0;
+    overflows = 0;
+
+    while ((c = fgetc(file)) != EOF)
+    {
+	if (c == 0x00)
+	{
+	    continue;
+	}
+
+	if (c == 0x80)
+	{
+	    continue;
+	}
+
+	if (c == 0x70)
+	{
+	    overflows++;
+
+	    continue;
+	}
+
+	if ((c & 0x0f) == 0x00)
+	{
+	    if ((c & 0xc0) == 0xc0)
+	    {
+		delta = 0;
+
+		for (n = 0; n < 4; n++)
+		{
+		    if ((c = fgetc(file)) == EOF)
+		    {
+			break;
+		    }
+
+		    delta |= (uint32_t)(c & 0x7f) << (7 * n);
+
+		    if (!(c & 0x80))
+		    {
+			break;
+		    }
+		}
+
+		timestamp += delta;
+	    }
+	    else
+	    {
+		timestamp += ((c >> 4) & 7);
+	    }
+
+	    continue;
+	}
+
+	size = ((c & 3) == 3) ? 4 : (c & 3);
+
+	if (!size)
+	{
+	    /* Extension packet, skip the continuation bytes */
+	    while ((c & 0x80) && ((c = fgetc(file)) != EOF))
+	    {
+	    }
+
+	    continue;
+	}
+
+	payload = 0;
+
+	for (n = 0; n < size; n++)
+	{
+	    int b;
+
+	    if ((b = fgetc(file)) == EOF)
+	    {
+		break;
+	    }
+
+	    payload |= (uint32_t)b << (8 * n);
+	}
+
+	/* Software source packet on the trace port with a full word */
+	if (!(c & 0x04) && ((unsigned int)(c >> 3) == ARMV7M_TRACE_ITM_PORT) && (size == 4))
+	{
+	    armv7m_trace_print(timestamp, (int64_t)(timestamp - last), payload);
+
+	    last = timestamp;
+	}
+    }
+
+    if (overflows)
+    {
+	printf("# %u ITM overflows\n", overflows);
+    }
+
+    return 0;
+}
+
+static void armv7m_trace_usage(const char *program)
+{
+    fprintf(stderr, "usage: %s [-s] [-c clock] file\n", program);
+
+    exit(1);
+}
+
+int main(int argc, char **argv)
+{
+    bool swo = false;
+    FILE *file;
+    int c, status;
+
+    while ((c = getopt(argc, argv, "c:s")) != -1)
+    {
+	switch (c) {
+	case 'c':
+	    armv7m_trace_clock = strtod(optarg, NULL);
+
+	    if (armv7m_trace_clock <= 0.0)
+	    {
+		armv7m_trace_usage(argv[0]);
+	    }
+	    break;
+	case 's':
+	    swo = true;
+	    break;
+	default:
+	    armv7m_trace_usage(argv[0]);
+	}
+    }
+
+    if (optind != (argc -1))
+    {
+	armv7m_trace_usage(argv[0]);
+    }
+
+    file = strcmp(argv[optind], "-") ? fopen(argv[optind], "rb") : stdin;
+
+    if (!file)
+    {
+	perror(argv[optind]);
+
+	return 1;
+    }
+
+    status = swo ? armv7m_trace_swo(file) : armv7m_trace_ring(file);
+
+    if (file != stdin)
+    {
+	fclose(file);
+    }
+
+    return status;
+}
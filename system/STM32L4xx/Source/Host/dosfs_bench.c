@@ -0,0 +1,410 @@
+/*
+ * Copyright (c) 2017 Thomas Roell.  All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal with the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ *  1. Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimers.
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimers in the
+ *     documentation and/or other materials provided with the distribution.
+ *  3. Neither the name of Thomas Roell, nor the names of its contributors
+ *     may be used to endorse or promote products derived from this Software
+ *     without specific prior written permission.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ * CONTRIBUTORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * WITH THE SOFTWARE.
+ */
+
+/* Replays an I/O trace against dosfs on top of a simulated SDCARD or SFLASH, and reports
+ * the elapsed time and the device statistics. This is meant to be run under perf or
+ * valgrind to profile the FAT and FTL code on the host.
+ *
+ *     dosfs_bench [-d sdcard|sflash] [-r repeat] [-v] trace ...
+ *
+ * A trace is a text file ("-" for stdin) with one operation per line. "slot" is a number
+ * between 0 and DOSFS_CONFIG_MAX_FILES -1, sizes are in bytes, "#" starts a comment:
+ *
+ *     open    <slot> <path> <mode>        f_open()
+ *     close   <slot>                      f_close()
+ *     write   <slot> <size> [<chunk>]     f_write() of <size> bytes in <chunk> pieces
+ *     read    <slot> <size> [<chunk>]     f_read() of <size> bytes in <chunk> pieces
+ *     seek    <slot> <offset>             f_seek(..., F_SEEK_SET)
+ *     reserve <slot> <size>               f_reserve()
+ *     flush   <slot>                      f_flush()
+ *     remove  <path>                      f_delete()
+ *     mkdir   <path>                      f_mkdir()
+ *     rmdir   <path>                      f_rmdir()
+ *     format                              f_format(0)
+ */
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "dosfs_api.h"
+#include "dosfs_sflash.h"
+#include "dosfs_sdcard.h"
+
+#include "armv7m.h"
+
+#define DOSFS_BENCH_CHUNK_MAX     65536
+
+static F_FILE *dosfs_bench_files[DOSFS_CONFIG_MAX_FILES];
+static uint8_t dosfs_bench_data[DOSFS_BENCH_CHUNK_MAX];
+static bool dosfs_bench_verbose = false;
+
+static uint64_t dosfs_bench_bytes_read = 0;
+static uint64_t dosfs_bench_bytes_written = 0;
+static unsigned int dosfs_bench_errors = 0;
+
+static void dosfs_bench_error(const char *name, unsigned int line, const char *command, int status)
+{
+    fprintf(stderr, "%s:%u: %s failed (%d)\n", name, line, command, status);
+
+    dosfs_bench_errors++;
+}
+
+static F_FILE **dosfs_bench_slot(const char *name, unsigned int line, const char *argument)
+{
+    unsigned long slot;
+    char *end;
+
+    slot = argument ? strtoul(argument, &end, 0) : DOSFS_CONFIG_MAX_FILES;
+
+    if (!argument || *end || (slot >= DOSFS_CONFIG_MAX_FILES))
+    {
+	fprintf(stderr, "%s:%u: illegal slot\n", name, line);
+
+	dosfs_bench_errors++;
+
+	return NULL;
+    }
+
+    return &dosfs_bench_files[slot];
+}
+
+static int dosfs_bench_replay(const char *name, FILE *trace)
+{
+    char buffer[512], *command, *argument[3];
+    unsigned int line, n;
+    long size, chunk, count;
+    F_FILE **p_file;
+    int status;
+
+    line = 0;
+
+    while (fgets(buffer, sizeof(buffer), trace))
+    {
+	line++;
+
+	if (strchr(buffer, '#'))
+	{
+	    *strchr(buffer, '#') = '\0';
+	}
+
+	command = strtok(buffer, " \t\r\n");
+
+	if (!command)
+	{
+	    continue;
+	}
+
+	for (n = 0; n < 3; n++)
+	{
+	    argument[n] = strtok(NULL, " \t\r\n");
+	}
+
+	if (dosfs_bench_verbose)
+	{
+	    printf("%s:%u: %s\n", name, line, command);
+	}
+
+	status = F_NO_ERROR;
+
+	if (!strcmp(command, "open"))
+	{
+	    if ((p_file = dosfs_bench_slot(name, line, argument[0])))
+	    {
+		if (*p_file || !argument[1] || !argument[2])
+		{
+		    status = F_ERR_NOTUSEABLE;
+		}
+		else
+		{
+		    *p_file = f_open(argument[1], argument[2]);
+
+		    if (!*p_file)
+		    {
+			status = F_ERR_NOTOPEN;
+		    }
+		}
+	    }
+	}
+	else if (!strcmp(command, "close"))
+	{
+	    if ((p_file = dosfs_bench_slot(name, line, argument[0])))
+	    {
+		status = f_close(*p_file);
+
+		*p_file = NULL;
+	    }
+	}
+	else if (!strcmp(command, "write") || !strcmp(command, "read"))
+	{
+	    if ((p_file = dosfs_bench_slot(name, line, argument[0])))
+	    {
+		size = argument[1] ? strtol(argument[1], NULL, 0) : 0;
+		chunk = argument[2] ? strtol(argument[2], NULL, 0) : DOSFS_BENCH_CHUNK_MAX;
+
+		if ((chunk <= 0) || (chunk > DOSFS_BENCH_CHUNK_MAX))
+		{
+		    chunk = DOSFS_BENCH_CHUNK_MAX;
+		}
+
+		while ((status == F_NO_ERROR) && (size > 0))
+		{
+		    n = (size > chunk) ? chunk : size;
+
+		    if (command[0] == 'w')
+		    {
+			count = f_write(&dosfs_bench_data[0], 1, n, *p_file);
+
+			dosfs_bench_bytes_written += count;
+		    }
+		    else
+		    {
+			count = f_read(&dosfs_bench_data[0], 1, n, *p_file);
+
+			dosfs_bench_bytes_read += count;
+		    }
+			
+		    if (count != (long)n)
+		    {
+			status = f_error(*p_file);
+
+			if ((status == F_NO_ERROR) && (command[0] == 'w'))
+			{
+			    status = F_ERR_WRITE;
+			}
+
+			/* A short read at the end of the file is not an error.
+			 */
+			break;
+		    }
+
+		    size -= n;
+		}
+	    }
+	}
+	else if (!strcmp(command, "seek"))
+	{
+	    if ((p_file = dosfs_bench_slot(name, line, argument[0])))
+	    {
+		status = f_seek(*p_file, (argument[1] ? strtol(argument[1], NULL, 0) : 0), F_SEEK_SET);
+	    }
+	}
+	else if (!strcmp(command, "reserve"))
+	{
+	    if ((p_file = dosfs_bench_slot(name, line, argument[0])))
+	    {
+		status = f_reserve(*p_file, (argument[1] ? strtol(argument[1], NULL, 0) : 0));
+	    }
+	}
+	else if (!strcmp(command, "flush"))
+	{
+	    if ((p_file = dosfs_bench_slot(name, line, argument[0])))
+	    {
+		status = f_flush(*p_file);
+	    }
+	}
+	else if (!strcmp(command, "remove"))
+	{
+	    status = argument[0] ? f_delete(argument[0]) : F_ERR_INVALIDNAME;
+	}
+	else if (!strcmp(command, "mkdir"))
+	{
+	    status = argument[0] ? f_mkdir(argument[0]) : F_ERR_INVALIDNAME;
+	}
+	else if (!strcmp(command, "rmdir"))
+	{
+	    status = argument[0] ? f_rmdir(argument[0]) : F_ERR_INVALIDNAME;
+	}
+	else if (!strcmp(command, "format"))
+	{
+	    status = f_format(0);
+	}
+	else
+	{
+	    fprintf(stderr, "%s:%u: unknown command \"%s\"\n", name, line, command);
+
+	    dosfs_bench_errors++;
+	}
+
+	if (status != F_NO_ERROR)
+	{
+	    dosfs_bench_error(name, line, command, status);
+	}
+    }
+
+    return dosfs_bench_errors ? -1 : 0;
+}
+
+static void dosfs_bench_usage(const char *program)
+{
+    fprintf(stderr, "usage: %s [-d sdcard|sflash] [-r repeat] [-v] trace ...\n", program);
+
+    exit(2);
+}
+
+int main(int argc, char **argv)
+{
+    const char *device;
+    unsigned int repeat, index;
+    uint64_t start, elapsed;
+    F_STATISTICS statistics;
+    F_CACHE cache;
+    F_SPACE space;
+    FILE *trace;
+    int c, status;
+
+    device = "sdcard";
+    repeat = 1;
+
+    while ((c = getopt(argc, argv, "d:r:v")) != -1)
+    {
+	switch (c) {
+	case 'd':
+	    device = optarg;
+	    break;
+	case 'r':
+	    repeat = strtoul(optarg, NULL, 0);
+	    break;
+	case 'v':
+	    dosfs_bench_verbose = true;
+	    break;
+	default:
+	    dosfs_bench_usage(argv[0]);
+	}
+    }
+
+    if (optind == argc)
+    {
+	dosfs_bench_usage(argv[0]);
+    }
+
+    for (index = 0; index < DOSFS_BENCH_CHUNK_MAX; index++)
+    {
+	dosfs_bench_data[index] = (uint8_t)(index * 0x9d);
+    }
+
+    if (!strcmp(device, "sdcard"))
+    {
+	status = dosfs_sdcard_init();
+    }
+    else if (!strcmp(device, "sflash"))
+    {
+	status = dosfs_sflash_init();
+    }
+    else
+    {
+	dosfs_bench_usage(argv[0]);
+    }
+
+    if (status == F_NO_ERROR)
+    {
+	status = f_initvolume();
+    }
+
+    if (status == F_NO_ERROR)
+    {
+	status = f_getfreespace(&space);
+
+	if (status == F_ERR_NOTFORMATTED)
+	{
+	    status = f_hardformat(0);
+	}
+    }
+
+    if (status != F_NO_ERROR)
+    {
+	fprintf(stderr, "%s: cannot initialize %s (%d)\n", argv[0], device, status);
+
+	return 1;
+    }
+
+    f_getstatistics(&statistics, true);
+
+    start = armv7m_systick_micros();
+
+    while (repeat--)
+    {
+	for (index = optind; index < (unsigned int)argc; index++)
+	{
+	    if (!strcmp(argv[index], "-"))
+	    {
+		dosfs_bench_replay("<stdin>", stdin);
+	    }
+	    else
+	    {
+		trace = fopen(argv[index], "r");
+
+		if (!trace)
+		{
+		    perror(argv[index]);
+
+		    return 1;
+		}
+
+		dosfs_bench_replay(argv[index], trace);
+
+		fclose(trace);
+	    }
+	}
+    }
+
+    for (index = 0; index < DOSFS_CONFIG_MAX_FILES; index++)
+    {
+	if (dosfs_bench_files[index])
+	{
+	    f_close(dosfs_bench_files[index]);
+
+	    dosfs_bench_files[index] = NULL;
+	}
+    }
+
+    f_checkvolume();
+
+    elapsed = armv7m_systick_micros() - start;
+
+    f_getstatistics(&statistics, false);
+    f_getcache(&cache);
+
+    printf("elapsed        %llu us\n", (unsigned long long)elapsed);
+    printf("bytes read     %llu\n", (unsigned long long)dosfs_bench_bytes_read);
+    printf("bytes written  %llu\n", (unsigned long long)dosfs_bench_bytes_written);
+    printf("device reads   %u (%u blocks)\n", statistics.reads, statistics.read_blocks);
+    printf("device writes  %u (%u blocks)\n", statistics.writes, statistics.write_blocks);
+    printf("device syncs   %u\n", statistics.syncs);
+    printf("device time    %u us (max %u us)\n", statistics.device_time, statistics.max_latency);
+    printf("cache          %u hits, %u misses\n", statistics.cache_hits, statistics.cache_misses);
+    printf("sector cache   %u entries, %u hits, %u misses\n", cache.size, cache.hits, cache.misses);
+    printf("errors         %u\n", dosfs_bench_errors);
+
+    f_delvolume();
+
+    return dosfs_bench_errors ? 1 : 0;
+}
@@ -0,0 +1,67 @@
+/*
+ * Copyright (c) 2017 Thomas Roell.  All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal with the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ *  1. Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimers.
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimers in the
+ *     documentation and/or other materials provided with the distribution.
+ *  3. Neither the name of Thomas Roell, nor the names of its contributors
+ *     may be used to endorse or promote products derived from this Software
+ *     without specific prior written permission.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ * CONTRIBUTORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * WITH THE SOFTWARE.
+ */
+
+/* Host overrides on top of the regular "dosfs_config.h" used by Makefile.host. Both devices
+ * are simulated in RAM, and the detailed statistics are always on. The *_TRACE switches
+ * can be set from the make command line (TRACE=1).
+ *
+ * Makefile.host force includes this header and the other headers in this directory, so
+ * that their include guards take precedence over the target headers.
+ */
+
+#if !defined(_DOSFS_CONFIG_HOST_h)
+#define _DOSFS_CONFIG_HOST_h
+
+#include "../../Include/dosfs_config.h"
+
+#ifndef DOSFS_HOST_TRACE
+#define DOSFS_HOST_TRACE                        0
+#endif
+
+#undef  DOSFS_CONFIG_STATISTICS
+#define DOSFS_CONFIG_STATISTICS                 1
+
+#undef  DOSFS_CONFIG_SDCARD_SIMULATE
+#define DOSFS_CONFIG_SDCARD_SIMULATE            1
+#undef  DOSFS_CONFIG_SDCARD_SIMULATE_TRACE
+#define DOSFS_CONFIG_SDCARD_SIMULATE_TRACE      DOSFS_HOST_TRACE
+
+#undef  DOSFS_CONFIG_SFLASH_SIMULATE
+#define DOSFS_CONFIG_SFLASH_SIMULATE            1
+#undef  DOSFS_CONFIG_SFLASH_SIMULATE_TRACE
+#define DOSFS_CONFIG_SFLASH_SIMULATE_TRACE      DOSFS_HOST_TRACE
+
+/* The write-back buffer is opt-in on the target; keep it covered here.
+ */
+#undef  DOSFS_CONFIG_WRITE_BACK_ENTRIES
+#define DOSFS_CONFIG_WRITE_BACK_ENTRIES         8
+
+#undef  DOSFS_CONFIG_STORAGE_SHARED_SUPPORTED
+#define DOSFS_CONFIG_STORAGE_SHARED_SUPPORTED   0
+
+#endif /* _DOSFS_CONFIG_HOST_h */
@@ -0,0 +1,192 @@
+/*
+ * Copyright (c) 2017 Thomas Roell.  All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal with the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ *  1. Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimers.
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimers in the
+ *     documentation and/or other materials provided with the distribution.
+ *  3. Neither the name of Thomas Roell, nor the names of its contributors
+ *     may be used to endorse or promote products derived from this Software
+ *     without specific prior written permission.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ * CONTRIBUTORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * WITH THE SOFTWARE.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+
+#include "dosfs_sdcard.h"
+
+#if (DOSFS_CONFIG_SDCARD_SIMULATE == 1)
+
+static uint8_t *dosfs_sdcard_image = NULL;
+
+static int dosfs_sdcard_release(void *context)
+{
+    int status = F_NO_ERROR;
+
+#if (DOSFS_CONFIG_SDCARD_SIMULATE_TRACE == 1)
+    printf("SDCARD_RELEASE\n");
+#endif /* (DOSFS_CONFIG_SDCARD_SIMULATE_TRACE == 1) */
+    
+    return status;
+}
+
+static int dosfs_sdcard_info(void *context, uint8_t *p_media, uint8_t *p_write_protected, uint32_t *p_block_count, uint32_t *p_au_size, uint32_t *p_serial)
+{
+    int status = F_NO_ERROR;
+
+#if (DOSFS_CONFIG_SDCARD_SIMULATE_TRACE == 1)
+    printf("SDCARD_INFO\n");
+#endif /* (DOSFS_CONFIG_SDCARD_SIMULATE_TRACE == 1) */
+
+    *p_media = DOSFS_MEDIA_SDHC;
+    *p_write_protected = false;
+    *p_block_count = DOSFS_CONFIG_SDCARD_SIMULATE_BLKCNT;
+    *p_au_size = DOSFS_SDCARD_AU_SIZE;
+    *p_serial = 0x12345678;
+
+    return status;
+}
+
+static int dosfs_sdcard_format(void *context)
+{
+    int status = F_NO_ERROR;
+
+#if (DOSFS_CONFIG_SDCARD_SIMULATE_TRACE == 1)
+    printf("SDCARD_FORMAT\n");
+#endif /* (DOSFS_CONFIG_SDCARD_SIMULATE_TRACE == 1) */
+
+    return status;
+}
+
+static int dosfs_sdcard_erase(void *context, uint32_t address, uint32_t length)
+{
+    int status = F_NO_ERROR;
+
+#if (DOSFS_CONFIG_SDCARD_SIMULATE_TRACE == 1)
+    printf("SDCARD_ERASE %08x, %d\n", address, length);
+#endif /* (DOSFS_CONFIG_SDCARD_SIMULATE_TRACE == 1) */
+
+    if ((address >= DOSFS_CONFIG_SDCARD_SIMULATE_BLKCNT) || (length > (DOSFS_CONFIG_SDCARD_SIMULATE_BLKCNT - address)))
+    {
+	status = F_ERR_INVALIDSECTOR;
+    }
+    else
+    {
+	memset(dosfs_sdcard_image + ((size_t)address * DOSFS_BLK_SIZE), 0x00, (size_t)length * DOSFS_BLK_SIZE);
+    }
+
+    return status;
+}
+
+static int dosfs_sdcard_discard(void *context, uint32_t address, uint32_t length)
+{
+#if (DOSFS_CONFIG_SDCARD_SIMULATE_TRACE == 1)
+    printf("SDCARD_DISCARD %08x, %d\n", address, length);
+#endif /* (DOSFS_CONFIG_SDCARD_SIMULATE_TRACE == 1) */
+
+    return dosfs_sdcard_erase(context, address, length);
+}
+
+static int dosfs_sdcard_read(void *context, uint32_t address, uint8_t *data, uint32_t length, bool prefetch)
+{
+    int status = F_NO_ERROR;
+
+#if (DOSFS_CONFIG_SDCARD_SIMULATE_TRACE == 1)
+    printf("SDCARD_READ %08x, %d\n", address, length);
+#endif /* (DOSFS_CONFIG_SDCARD_SIMULATE_TRACE == 1) */
+
+    if ((address >= DOSFS_CONFIG_SDCARD_SIMULATE_BLKCNT) || (length > (DOSFS_CONFIG_SDCARD_SIMULATE_BLKCNT - address)))
+    {
+	status = F_ERR_INVALIDSECTOR;
+    }
+    else
+    {
+	memcpy(data, dosfs_sdcard_image + ((size_t)address * DOSFS_BLK_SIZE), (size_t)length * DOSFS_BLK_SIZE);
+    }
+
+    return status;
+}
+
+static int dosfs_sdcard_write(void *context, uint32_t address, const uint8_t *data, uint32_t length, volatile uint8_t *p_status)
+{
+    int status = F_NO_ERROR;
+
+#if (DOSFS_CONFIG_SDCARD_SIMULATE_TRACE == 1)
+    printf("SDCARD_WRITE %08x, %d\n", address, length);
+#endif /* (DOSFS_CONFIG_SDCARD_SIMULATE_TRACE == 1) */
+
+    if ((address >= DOSFS_CONFIG_SDCARD_SIMULATE_BLKCNT) || (length > (DOSFS_CONFIG_SDCARD_SIMULATE_BLKCNT - address)))
+    {
+	status = F_ERR_INVALIDSECTOR;
+    }
+    else
+    {
+	memcpy(dosfs_sdcard_image + ((size_t)address * DOSFS_BLK_SIZE), data, (size_t)length * DOSFS_BLK_SIZE);
+    }
+
+    return status;
+}
+
+static int dosfs_sdcard_sync(void *context, bool wait)
+{
+    return F_NO_ERROR;
+}
+
+static const dosfs_device_interface_t dosfs_sdcard_interface = {
+    dosfs_sdcard_release,
+    dosfs_sdcard_info,
+    dosfs_sdcard_format,
+    dosfs_sdcard_erase,
+    dosfs_sdcard_discard,
+    dosfs_sdcard_read,
+    dosfs_sdcard_write,
+    dosfs_sdcard_sync,
+    NULL,
+    NULL,
+    NULL,
+};
+
+int dosfs_sdcard_init(void)
+{
+    int status = F_NO_ERROR;
+    dosfs_device_t *device;
+
+    device = dosfs_device_attach(&dosfs_sdcard_interface, NULL);
+
+    if (!device)
+    {
+	return F_ERR_INITFUNC;
+    }
+
+    if (dosfs_sdcard_image == NULL)
+    {
+	dosfs_sdcard_image = (uint8_t*)calloc(DOSFS_CONFIG_SDCARD_SIMULATE_BLKCNT, DOSFS_BLK_SIZE);
+
+	if (dosfs_sdcard_image == NULL)
+	{
+	    status = F_ERR_INVALIDMEDIA;
+	}
+    }
+
+    device->lock = 0;
+
+    return status;
+}
+
+#endif /* (DOSFS_CONFIG_SDCARD_SIMULATE == 1) */
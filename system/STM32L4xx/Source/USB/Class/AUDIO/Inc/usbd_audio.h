@@ -0,0 +1,198 @@
+/**
+  ******************************************************************************
+  * @file    usbd_audio.h
+  * @author  MCD Application Team
+  * @version V2.4.2
+  * @date    11-December-2015
+  * @brief   header file for the usbd_audio.c file.
+  ******************************************************************************
+  * @attention
+  *
+  * <h2><center>&copy; COPYRIGHT 2015 STMicroelectronics</center></h2>
+  *
+  * Licensed under MCD-ST Liberty SW License Agreement V2, (the "License");
+  * You may not use this file except in compliance with the License.
+  * You may obtain a copy of the License at:
+  *
+  *        http://www.st.com/software_license_agreement_liberty_v2
+  *
+  * Unless required by applicable law or agreed to in writing, software 
+  * distributed under the License is distributed on an "AS IS" BASIS, 
+  * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  * See the License for the specific language governing permissions and
+  * limitations under the License.
+  *
+  ******************************************************************************
+  */ 
+ 
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef __USB_AUDIO_H
+#define __USB_AUDIO_H
+
+#ifdef __cplusplus
+ extern "C" {
+#endif
+
+/* Includes ------------------------------------------------------------------*/
+#include  "usbd_ioreq.h"
+
+/** @addtogroup STM32_USB_DEVICE_LIBRARY
+  * @{
+  */
+  
+/** @defgroup USBD_AUDIO
+  * @brief This file is the Header file for usbd_audio.c
+  * @{
+  */ 
+
+
+/** @defgroup USBD_AUDIO_Exported_Defines
+  * @{
+  */ 
+#define AUDIO_OUT_EP                          0x04  /* EP4 for isochronous data OUT */
+#define AUDIO_FEEDBACK_EP                     0x84  /* EP4 for explicit feedback IN */
+
+/* Fixed format: 48kHz, 16 bit stereo */
+#define AUDIO_SAMPLE_RATE                     48000
+#define AUDIO_CHANNELS                        2
+#define AUDIO_SUBFRAME_SIZE                   2
+#define AUDIO_FRAME_SIZE                      (AUDIO_CHANNELS * AUDIO_SUBFRAME_SIZE)
+
+/* An asynchronous sink gets up to one frame more per packet than nominal */
+#define AUDIO_OUT_PACKET_SIZE                 (((AUDIO_SAMPLE_RATE / 1000) + 1) * AUDIO_FRAME_SIZE)
+#define AUDIO_FEEDBACK_PACKET_SIZE            3
+
+/* Feedback is sent every 2^AUDIO_FEEDBACK_REFRESH frames, as a 10.14 number of frames per ms */
+#define AUDIO_FEEDBACK_REFRESH                3
+#define AUDIO_FEEDBACK_NOMINAL                (((uint32_t)AUDIO_SAMPLE_RATE << 14) / 1000)
+
+/* Packet memory for the USB FS device. Both endpoints are double buffered, and
+ * reuse the space of the HID and WEBUSB endpoints, which are not used together
+ * with AUDIO. An OUT buffer of more than 62 bytes is allocated in 32 byte blocks.
+ */
+#define AUDIO_OUT_PMA0                        0x1c0
+#define AUDIO_OUT_PMA1                        0x2a0
+#define AUDIO_FEEDBACK_PMA0                   0x380
+#define AUDIO_FEEDBACK_PMA1                   0x388
+
+#define AUDIO_CONTROL_INTERFACE               3
+#define AUDIO_STREAMING_INTERFACE             4
+
+#define AUDIO_INPUT_TERMINAL_ID               1
+#define AUDIO_FEATURE_UNIT_ID                 2
+#define AUDIO_OUTPUT_TERMINAL_ID              3
+
+#define AUDIO_REQ_SET_CUR                     0x01
+#define AUDIO_REQ_GET_CUR                     0x81
+#define AUDIO_REQ_GET_MIN                     0x82
+#define AUDIO_REQ_GET_MAX                     0x83
+#define AUDIO_REQ_GET_RES                     0x84
+
+#define AUDIO_CONTROL_MUTE                    0x01
+#define AUDIO_CONTROL_VOLUME                  0x02
+
+#define AUDIO_EP_CONTROL_SAMPLING_FREQ        0x01
+
+/* Volume in 1/256 dB */
+#define AUDIO_VOLUME_MIN                      ((int16_t)(-60 * 256))
+#define AUDIO_VOLUME_MAX                      ((int16_t)0)
+#define AUDIO_VOLUME_RES                      ((int16_t)256)
+/**
+  * @}
+  */ 
+
+
+/** @defgroup USBD_CORE_Exported_TypesDefinitions
+  * @{
+  */
+
+typedef struct _USBD_AUDIO_Itf
+{
+  void      (* Init)        (USBD_HandleTypeDef *pdev);
+  void      (* DeInit)      (void);
+  uint8_t * (* Start)       (void);                       /* returns the buffer for the first packet */
+  void      (* Stop)        (void);
+  uint8_t * (* Receive)     (uint8_t *, uint32_t);        /* returns the buffer for the next packet */
+  uint32_t  (* Feedback)    (void);
+  void      (* Control)     (uint8_t, int16_t);           /* AUDIO_CONTROL_MUTE/AUDIO_CONTROL_VOLUME */
+}USBD_AUDIO_ItfTypeDef;
+
+typedef struct
+{
+  uint32_t             ControlData[2];   /* Force 32bits alignment */
+  uint8_t              FeedbackData[4];
+  uint8_t              *RxBuffer;
+  uint16_t             Frame;
+  int16_t              Volume;
+  uint8_t              Mute;
+  uint8_t              AltSetting;
+  uint8_t              FeedbackBusy;
+  uint8_t              ControlBusy;
+  uint8_t              ControlSelector;
+}
+USBD_AUDIO_HandleTypeDef; 
+/**
+  * @}
+  */ 
+
+
+
+/** @defgroup USBD_CORE_Exported_Macros
+  * @{
+  */ 
+
+/**
+  * @}
+  */ 
+
+/** @defgroup USBD_CORE_Exported_Variables
+  * @{
+  */ 
+
+/**
+  * @}
+  */ 
+
+/** @defgroup USB_CORE_Exported_Functions
+  * @{
+  */ 
+uint8_t  USBD_AUDIO_RegisterInterface  (USBD_HandleTypeDef  *pdev, 
+                                        const USBD_AUDIO_ItfTypeDef *fops);
+
+/**
+  * @}
+  */ 
+
+uint8_t  USBD_AUDIO_Init (USBD_HandleTypeDef *pdev, 
+			  uint8_t cfgidx);
+
+uint8_t  USBD_AUDIO_DeInit (USBD_HandleTypeDef *pdev, 
+			    uint8_t cfgidx);
+
+uint8_t  USBD_AUDIO_Setup (USBD_HandleTypeDef *pdev, 
+			   USBD_SetupReqTypedef *req);
+
+uint8_t  USBD_AUDIO_DataIn (USBD_HandleTypeDef *pdev, 
+			    uint8_t epnum);
+
+uint8_t  USBD_AUDIO_DataOut (USBD_HandleTypeDef *pdev, 
+			     uint8_t epnum);
+
+uint8_t  USBD_AUDIO_EP0_RxReady (USBD_HandleTypeDef *pdev);
+
+uint8_t  USBD_AUDIO_SOF (USBD_HandleTypeDef *pdev);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  /* __USB_AUDIO_H */
+/**
+  * @}
+  */ 
+
+/**
+  * @}
+  */ 
+  
+/************************ (C) COPYRIGHT STMicroelectronics *****END OF FILE****/
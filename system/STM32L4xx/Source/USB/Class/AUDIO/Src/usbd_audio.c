@@ -0,0 +1,530 @@
+/**
+  ******************************************************************************
+  * @file    usbd_audio.c
+  * @author  MCD Application Team
+  * @version V2.4.2
+  * @date    11-December-2015
+  * @brief   This file provides the Audio core functions.
+  *
+  * @verbatim
+  *      
+  *          ===================================================================      
+  *                                AUDIO Class  Description
+  *          ===================================================================
+  *           This driver manages the Audio Class 1.0 following the "USB Device Class Definition for
+  *           Audio Devices V1.0 Mar 18, 98".
+  *           This driver implements the following aspects of the specification:
+  *             - Audio Class-Specific AC Interface with 1 Input Terminal (USB streaming),
+  *               1 Feature Unit (Mute and Volume) and 1 Output Terminal (Speaker)
+  *             - 1 Audio Streaming Interface (Alternate setting 1: PCM, 48kHz, 16 bit, Stereo)
+  *             - 1 isochronous OUT Endpoint, Synchronization type Asynchronous
+  *             - 1 isochronous explicit feedback IN Endpoint
+  *             - AudioControl Requests: SET_CUR/GET_CUR for Mute, SET_CUR/GET_CUR/GET_MIN/
+  *               GET_MAX/GET_RES for Volume (applied by the user application)
+  *
+  *           The descriptors are part of the composite configuration in usbd_cdc_msc.c.
+  *           The streaming endpoints are only open while alternate setting 1 is selected.
+  *      
+  *  @endverbatim
+  *
+  ******************************************************************************
+  * @attention
+  *
+  * <h2><center>&copy; COPYRIGHT 2015 STMicroelectronics</center></h2>
+  *
+  * Licensed under MCD-ST Liberty SW License Agreement V2, (the "License");
+  * You may not use this file except in compliance with the License.
+  * You may obtain a copy of the License at:
+  *
+  *        http://www.st.com/software_license_agreement_liberty_v2
+  *
+  * Unless required by applicable law or agreed to in writing, software 
+  * distributed under the License is distributed on an "AS IS" BASIS, 
+  * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  * See the License for the specific language governing permissions and
+  * limitations under the License.
+  *
+  ******************************************************************************
+  */ 
+
+/* Includes ------------------------------------------------------------------*/
+#include "usbd_audio.h"
+#include "usbd_desc.h"
+#include "usbd_ctlreq.h"
+
+
+/** @addtogroup STM32_USB_DEVICE_LIBRARY
+  * @{
+  */
+
+
+/** @defgroup USBD_AUDIO 
+  * @brief usbd core module
+  * @{
+  */ 
+
+/** @defgroup USBD_AUDIO_Private_TypesDefinitions
+  * @{
+  */ 
+/**
+  * @}
+  */ 
+
+
+/** @defgroup USBD_AUDIO_Private_Defines
+  * @{
+  */ 
+
+/**
+  * @}
+  */ 
+
+
+/** @defgroup USBD_AUDIO_Private_Macros
+  * @{
+  */ 
+                                         
+/**
+  * @}
+  */ 
+
+
+
+
+/** @defgroup USBD_AUDIO_Private_FunctionPrototypes
+  * @{
+  */
+
+static void USBD_AUDIO_Start (USBD_HandleTypeDef *pdev);
+
+static void USBD_AUDIO_Stop (USBD_HandleTypeDef *pdev);
+
+/**
+  * @}
+  */ 
+
+/** @defgroup USBD_AUDIO_Private_Variables
+  * @{
+  */ 
+
+static USBD_AUDIO_HandleTypeDef USBD_AUDIO_Handle;
+
+/**
+  * @}
+  */ 
+
+/** @defgroup USBD_AUDIO_Private_Functions
+  * @{
+  */ 
+
+/**
+  * @brief  USBD_AUDIO_Init
+  *         Initialize the AUDIO interface
+  * @param  pdev: device instance
+  * @param  cfgidx: Configuration index
+  * @retval status
+  */
+uint8_t  USBD_AUDIO_Init (USBD_HandleTypeDef *pdev, 
+			  uint8_t cfgidx)
+{
+  USBD_AUDIO_HandleTypeDef   *haudio;
+
+  USBD_LL_DoubleBufferEP(pdev, AUDIO_OUT_EP, AUDIO_OUT_PMA0, AUDIO_OUT_PMA1);
+  USBD_LL_DoubleBufferEP(pdev, AUDIO_FEEDBACK_EP, AUDIO_FEEDBACK_PMA0, AUDIO_FEEDBACK_PMA1);
+
+  pdev->pClassData[4] = &USBD_AUDIO_Handle;
+  
+  haudio = (USBD_AUDIO_HandleTypeDef*) pdev->pClassData[4];
+
+  haudio->RxBuffer = NULL;
+  haudio->Frame = 0;
+  haudio->Volume = AUDIO_VOLUME_MAX;
+  haudio->Mute = 0;
+  haudio->AltSetting = 0;
+  haudio->FeedbackBusy = 0;
+  haudio->ControlBusy = 0;
+
+  ((USBD_AUDIO_ItfTypeDef *)pdev->pUserData[4])->Init(pdev);
+
+  return USBD_OK;
+}
+
+/**
+  * @brief  USBD_AUDIO_DeInit
+  *         DeInitialize the AUDIO layer
+  * @param  pdev: device instance
+  * @param  cfgidx: Configuration index
+  * @retval status
+  */
+uint8_t  USBD_AUDIO_DeInit (USBD_HandleTypeDef *pdev, 
+			    uint8_t cfgidx)
+{
+  if(pdev->pClassData[4] != NULL)
+  {
+    USBD_AUDIO_Stop(pdev);
+
+    ((USBD_AUDIO_ItfTypeDef *)pdev->pUserData[4])->DeInit();
+    pdev->pClassData[4] = NULL;
+  }
+
+  return USBD_OK;
+}
+
+/**
+  * @brief  USBD_AUDIO_Start
+  *         Open the streaming endpoints (alternate setting 1)
+  * @param  pdev: device instance
+  * @retval None
+  */
+static void USBD_AUDIO_Start (USBD_HandleTypeDef *pdev)
+{
+  USBD_AUDIO_HandleTypeDef   *haudio = (USBD_AUDIO_HandleTypeDef*) pdev->pClassData[4];
+
+  if (haudio->AltSetting)
+  {
+    return;
+  }
+
+  USBD_LL_OpenEP(pdev,
+                 AUDIO_OUT_EP,
+                 USBD_EP_TYPE_ISOC,
+                 AUDIO_OUT_PACKET_SIZE);
+
+  USBD_LL_OpenEP(pdev,
+                 AUDIO_FEEDBACK_EP,
+                 USBD_EP_TYPE_ISOC,
+                 AUDIO_FEEDBACK_PACKET_SIZE);
+
+  haudio->AltSetting = 1;
+  haudio->Frame = 0;
+  haudio->FeedbackBusy = 0;
+
+  haudio->RxBuffer = ((USBD_AUDIO_ItfTypeDef *)pdev->pUserData[4])->Start();
+
+  USBD_LL_PrepareReceive(pdev,
+			 AUDIO_OUT_EP,
+			 haudio->RxBuffer,
+			 AUDIO_OUT_PACKET_SIZE);
+}
+
+/**
+  * @brief  USBD_AUDIO_Stop
+  *         Close the streaming endpoints (alternate setting 0)
+  * @param  pdev: device instance
+  * @retval None
+  */
+static void USBD_AUDIO_Stop (USBD_HandleTypeDef *pdev)
+{
+  USBD_AUDIO_HandleTypeDef   *haudio = (USBD_AUDIO_HandleTypeDef*) pdev->pClassData[4];
+
+  if (!haudio->AltSetting)
+  {
+    return;
+  }
+
+  USBD_LL_CloseEP(pdev,
+                  AUDIO_OUT_EP);
+
+  USBD_LL_CloseEP(pdev,
+                  AUDIO_FEEDBACK_EP);
+
+  haudio->AltSetting = 0;
+  haudio->FeedbackBusy = 0;
+  haudio->RxBuffer = NULL;
+
+  ((USBD_AUDIO_ItfTypeDef *)pdev->pUserData[4])->Stop();
+}
+
+/**
+  * @brief  USBD_AUDIO_Setup
+  *         Handle the AUDIO specific requests
+  * @param  pdev: instance
+  * @param  req: usb requests
+  * @retval status
+  */
+uint8_t  USBD_AUDIO_Setup (USBD_HandleTypeDef *pdev, 
+			   USBD_SetupReqTypedef *req)
+{
+  USBD_AUDIO_HandleTypeDef   *haudio = (USBD_AUDIO_HandleTypeDef*) pdev->pClassData[4];
+  uint8_t *data = (uint8_t*)&haudio->ControlData[0];
+  uint8_t control = HIBYTE(req->wValue);
+  int16_t value;
+
+  switch (req->bmRequest & USB_REQ_TYPE_MASK)
+  {
+  case USB_REQ_TYPE_CLASS :  
+    if ((req->bmRequest & USB_REQ_RECIPIENT_MASK) == USB_REQ_RECIPIENT_ENDPOINT)
+    {
+      /* Only one sampling frequency, so SET_CUR is accepted and ignored.
+       */
+      if ((LOBYTE(req->wIndex) != AUDIO_OUT_EP) || (control != AUDIO_EP_CONTROL_SAMPLING_FREQ) || (req->wLength > 3))
+      {
+	USBD_CtlError (pdev, req);
+	return USBD_FAIL; 
+      }
+
+      if (req->bRequest == AUDIO_REQ_SET_CUR)
+      {
+	USBD_CtlPrepareRx (pdev, data, req->wLength);
+      }
+      else
+      {
+	data[0] = (uint8_t)(AUDIO_SAMPLE_RATE >> 0);
+	data[1] = (uint8_t)(AUDIO_SAMPLE_RATE >> 8);
+	data[2] = (uint8_t)(AUDIO_SAMPLE_RATE >> 16);
+
+	USBD_CtlSendData (pdev, data, req->wLength);
+      }
+      break;
+    }
+
+    if ((HIBYTE(req->wIndex) != AUDIO_FEATURE_UNIT_ID) ||
+	((control != AUDIO_CONTROL_MUTE) && (control != AUDIO_CONTROL_VOLUME)) ||
+	(req->wLength > ((control == AUDIO_CONTROL_MUTE) ? 1 : 2)))
+    {
+      USBD_CtlError (pdev, req);
+      return USBD_FAIL; 
+    }
+
+    if (req->bRequest == AUDIO_REQ_SET_CUR)
+    {
+      haudio->ControlBusy = 1;
+      haudio->ControlSelector = control;
+
+      USBD_CtlPrepareRx (pdev, data, req->wLength);
+      break;
+    }
+
+    if (control == AUDIO_CONTROL_MUTE)
+    {
+      if (req->bRequest != AUDIO_REQ_GET_CUR)
+      {
+	USBD_CtlError (pdev, req);
+	return USBD_FAIL; 
+      }
+
+      data[0] = haudio->Mute;
+    }
+    else
+    {
+      switch (req->bRequest)
+      {
+      case AUDIO_REQ_GET_CUR:
+	value = haudio->Volume;
+	break;
+      case AUDIO_REQ_GET_MIN:
+	value = AUDIO_VOLUME_MIN;
+	break;
+      case AUDIO_REQ_GET_MAX:
+	value = AUDIO_VOLUME_MAX;
+	break;
+      case AUDIO_REQ_GET_RES:
+	value = AUDIO_VOLUME_RES;
+	break;
+      default:
+	USBD_CtlError (pdev, req);
+	return USBD_FAIL; 
+      }
+
+      data[0] = LOBYTE(value);
+      data[1] = HIBYTE(value);
+    }
+
+    USBD_CtlSendData (pdev, data, req->wLength);
+    break;
+    
+  case USB_REQ_TYPE_STANDARD:
+    switch (req->bRequest)
+    {
+    case USB_REQ_GET_INTERFACE :
+      data[0] = (LOBYTE(req->wIndex) == AUDIO_STREAMING_INTERFACE) ? haudio->AltSetting : 0;
+
+      USBD_CtlSendData (pdev, data, 1);
+      break;
+
+    case USB_REQ_SET_INTERFACE :
+      if (LOBYTE(req->wIndex) == AUDIO_STREAMING_INTERFACE)
+      {
+	if (req->wValue == 0)
+	{
+	  USBD_AUDIO_Stop(pdev);
+	}
+	else if (req->wValue == 1)
+	{
+	  USBD_AUDIO_Start(pdev);
+	}
+	else
+	{
+	  USBD_CtlError (pdev, req);
+	  return USBD_FAIL; 
+	}
+      }
+      else if (req->wValue != 0)
+      {
+	USBD_CtlError (pdev, req);
+	return USBD_FAIL; 
+      }
+      break;
+    }
+  }
+  return USBD_OK;
+}
+
+/**
+  * @brief  USBD_AUDIO_DataIn
+  *         handle data IN Stage
+  * @param  pdev: device instance
+  * @param  epnum: endpoint index
+  * @retval status
+  */
+uint8_t  USBD_AUDIO_DataIn (USBD_HandleTypeDef *pdev, 
+			    uint8_t epnum)
+{
+  ((USBD_AUDIO_HandleTypeDef *)pdev->pClassData[4])->FeedbackBusy = 0;
+
+  return USBD_OK;
+}
+
+/**
+  * @brief  USBD_AUDIO_DataOut
+  *         handle data OUT Stage. The packet has been read into the buffer handed out
+  *         by the user application, which returns the buffer for the next one.
+  * @param  pdev: device instance
+  * @param  epnum: endpoint index
+  * @retval status
+  */
+uint8_t  USBD_AUDIO_DataOut (USBD_HandleTypeDef *pdev, 
+			     uint8_t epnum)
+{
+  USBD_AUDIO_HandleTypeDef   *haudio = (USBD_AUDIO_HandleTypeDef*) pdev->pClassData[4];
+
+  if (!haudio->AltSetting)
+  {
+    return USBD_OK;
+  }
+
+  haudio->RxBuffer = ((USBD_AUDIO_ItfTypeDef *)pdev->pUserData[4])->Receive(haudio->RxBuffer, USBD_LL_GetRxDataSize (pdev, epnum));
+
+  USBD_LL_PrepareReceive(pdev,
+			 AUDIO_OUT_EP,
+			 haudio->RxBuffer,
+			 AUDIO_OUT_PACKET_SIZE);
+
+  return USBD_OK;
+}
+
+/**
+  * @brief  USBD_AUDIO_EP0_RxReady
+  *         Handles control request data.
+  * @param  pdev: device instance
+  * @retval status
+  */
+uint8_t USBD_AUDIO_EP0_RxReady(USBD_HandleTypeDef *pdev)
+{
+  USBD_AUDIO_HandleTypeDef   *haudio = (USBD_AUDIO_HandleTypeDef*) pdev->pClassData[4];
+  uint8_t *data = (uint8_t*)&haudio->ControlData[0];
+
+  if (haudio->ControlBusy)
+  {
+    haudio->ControlBusy = 0;
+
+    if (haudio->ControlSelector == AUDIO_CONTROL_MUTE)
+    {
+      haudio->Mute = data[0] ? 1 : 0;
+
+      ((USBD_AUDIO_ItfTypeDef *)pdev->pUserData[4])->Control(AUDIO_CONTROL_MUTE, haudio->Mute);
+    }
+    else
+    {
+      haudio->Volume = (int16_t)((data[1] << 8) | data[0]);
+
+      if (haudio->Volume < AUDIO_VOLUME_MIN)
+      {
+	haudio->Volume = AUDIO_VOLUME_MIN;
+      }
+
+      if (haudio->Volume > AUDIO_VOLUME_MAX)
+      {
+	haudio->Volume = AUDIO_VOLUME_MAX;
+      }
+
+      ((USBD_AUDIO_ItfTypeDef *)pdev->pUserData[4])->Control(AUDIO_CONTROL_VOLUME, haudio->Volume);
+    }
+  }
+
+  return USBD_OK;
+}
+
+/**
+  * @brief  USBD_AUDIO_SOF
+  *         Sends the feedback every 2^AUDIO_FEEDBACK_REFRESH frames.
+  * @param  pdev: device instance
+  * @retval status
+  */
+uint8_t USBD_AUDIO_SOF(USBD_HandleTypeDef *pdev)
+{
+  USBD_AUDIO_HandleTypeDef   *haudio = (USBD_AUDIO_HandleTypeDef*) pdev->pClassData[4];
+  uint32_t feedback;
+
+  if ((haudio == NULL) || !haudio->AltSetting)
+  {
+    return USBD_OK;
+  }
+
+  haudio->Frame++;
+
+  if (haudio->FeedbackBusy)
+  {
+    USBD_LL_RetargetEP(pdev, AUDIO_FEEDBACK_EP);
+  }
+  else
+  {
+    if (!(haudio->Frame & ((1 << AUDIO_FEEDBACK_REFRESH) -1)))
+    {
+      feedback = ((USBD_AUDIO_ItfTypeDef *)pdev->pUserData[4])->Feedback();
+
+      haudio->FeedbackData[0] = (uint8_t)(feedback >> 0);
+      haudio->FeedbackData[1] = (uint8_t)(feedback >> 8);
+      haudio->FeedbackData[2] = (uint8_t)(feedback >> 16);
+
+      haudio->FeedbackBusy = 1;
+
+      USBD_LL_Transmit (pdev, 
+                        AUDIO_FEEDBACK_EP,                                      
+                        &haudio->FeedbackData[0],
+                        AUDIO_FEEDBACK_PACKET_SIZE);
+    }
+  }
+
+  return USBD_OK;
+}
+
+/**
+* @brief  USBD_AUDIO_RegisterInterface
+  * @param  pdev: device instance
+  * @param  fops: AUDIO Interface callback
+  * @retval status
+  */
+uint8_t  USBD_AUDIO_RegisterInterface  (USBD_HandleTypeDef  *pdev, 
+                                        const USBD_AUDIO_ItfTypeDef *fops)
+{
+  pdev->pUserData[4] = fops;
+
+  return USBD_OK;    
+}
+
+/**
+  * @}
+  */ 
+
+
+/**
+  * @}
+  */ 
+
+
+/**
+  * @}
+  */ 
+
+/************************ (C) COPYRIGHT STMicroelectronics *****END OF FILE****/
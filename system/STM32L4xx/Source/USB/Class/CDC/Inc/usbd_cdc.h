@@ -67,6 +67,12 @@
 #define CDC_DATA_FS_IN_PACKET_SIZE                  CDC_DATA_FS_MAX_PACKET_SIZE
 #define CDC_DATA_FS_OUT_PACKET_SIZE                 CDC_DATA_FS_MAX_PACKET_SIZE
 
+/* Packet memory for the USB FS device. The data OUT endpoint is double buffered. The
+ * second buffer is above the AUDIO endpoints, so it's free in all configurations.
+ */
+#define CDC_OUT_PMA0                                0x100
+#define CDC_OUT_PMA1                                0x390
+
 /*---------------------------------------------------------------------*/
 /*  CDC definitions                                                    */
 /*---------------------------------------------------------------------*/
@@ -160,6 +160,8 @@ uint8_t  USBD_CDC_Init (USBD_HandleTypeDef *pdev,
 		 CDC_DATA_FS_IN_PACKET_SIZE);
   
   /* Open EP OUT */
+  USBD_LL_DoubleBufferEP(pdev, CDC_OUT_EP, CDC_OUT_PMA0, CDC_OUT_PMA1);
+
   USBD_LL_OpenEP(pdev,
 		 CDC_OUT_EP,
 		 USBD_EP_TYPE_BULK,
@@ -0,0 +1,162 @@
+/**
+  ******************************************************************************
+  * @file    usbd_midi.h
+  * @author  MCD Application Team
+  * @version V2.4.2
+  * @date    11-December-2015
+  * @brief   header file for the usbd_midi.c file.
+  ******************************************************************************
+  * @attention
+  *
+  * <h2><center>&copy; COPYRIGHT 2015 STMicroelectronics</center></h2>
+  *
+  * Licensed under MCD-ST Liberty SW License Agreement V2, (the "License");
+  * You may not use this file except in compliance with the License.
+  * You may obtain a copy of the License at:
+  *
+  *        http://www.st.com/software_license_agreement_liberty_v2
+  *
+  * Unless required by applicable law or agreed to in writing, software 
+  * distributed under the License is distributed on an "AS IS" BASIS, 
+  * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  * See the License for the specific language governing permissions and
+  * limitations under the License.
+  *
+  ******************************************************************************
+  */ 
+ 
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef __USB_MIDI_H
+#define __USB_MIDI_H
+
+#ifdef __cplusplus
+ extern "C" {
+#endif
+
+/* Includes ------------------------------------------------------------------*/
+#include  "usbd_ioreq.h"
+
+/** @addtogroup STM32_USB_DEVICE_LIBRARY
+  * @{
+  */
+  
+/** @defgroup USBD_MIDI
+  * @brief This file is the Header file for usbd_midi.c
+  * @{
+  */ 
+
+
+/** @defgroup USBD_MIDI_Exported_Defines
+  * @{
+  */ 
+#define MIDI_IN_EP                            0x84  /* EP4 for event packets IN */
+#define MIDI_OUT_EP                           0x04  /* EP4 for event packets OUT */
+
+/* Bulk endpoints, each packet carries up to 16 4 byte USB-MIDI event packets */
+#define MIDI_PACKET_SIZE                      64
+
+/* On the USB FS device both endpoints use the single buffered EP4 packet memory
+ * that USBD_LL_Init() sets up for HID, which is not used together with MIDI.
+ */
+
+#define MIDI_CONTROL_INTERFACE                3
+#define MIDI_STREAMING_INTERFACE              4
+
+#define MIDI_JACK_IN_EMBEDDED_ID              1
+#define MIDI_JACK_IN_EXTERNAL_ID              2
+#define MIDI_JACK_OUT_EMBEDDED_ID             3
+#define MIDI_JACK_OUT_EXTERNAL_ID             4
+/**
+  * @}
+  */ 
+
+
+/** @defgroup USBD_CORE_Exported_TypesDefinitions
+  * @{
+  */
+
+typedef struct _USBD_MIDI_Itf
+{
+  void      (* Init)        (USBD_HandleTypeDef *pdev);
+  void      (* DeInit)      (void);
+  uint8_t   (* Receive)     (uint8_t *, uint32_t);        /* returns 0 to hold off the next packet */
+  void      (* TxDone)      (void);
+  void      (* SOF)         (void);
+}USBD_MIDI_ItfTypeDef;
+
+typedef struct
+{
+  uint32_t             RxBuffer[MIDI_PACKET_SIZE/4];   /* Force 32bits alignment */
+  uint32_t             TxBuffer[MIDI_PACKET_SIZE/4];
+  __IO uint32_t        TxState;
+  __IO uint32_t        RxState;
+}
+USBD_MIDI_HandleTypeDef; 
+/**
+  * @}
+  */ 
+
+
+
+/** @defgroup USBD_CORE_Exported_Macros
+  * @{
+  */ 
+
+/**
+  * @}
+  */ 
+
+/** @defgroup USBD_CORE_Exported_Variables
+  * @{
+  */ 
+
+/**
+  * @}
+  */ 
+
+/** @defgroup USB_CORE_Exported_Functions
+  * @{
+  */ 
+uint8_t  USBD_MIDI_RegisterInterface  (USBD_HandleTypeDef  *pdev, 
+                                       const USBD_MIDI_ItfTypeDef *fops);
+
+uint8_t  USBD_MIDI_ReceivePacket      (USBD_HandleTypeDef *pdev);
+
+uint8_t  USBD_MIDI_TransmitPacket     (USBD_HandleTypeDef *pdev,
+                                       const uint8_t *pbuff,
+                                       uint16_t length);
+/**
+  * @}
+  */ 
+
+uint8_t  USBD_MIDI_Init (USBD_HandleTypeDef *pdev, 
+			 uint8_t cfgidx);
+
+uint8_t  USBD_MIDI_DeInit (USBD_HandleTypeDef *pdev, 
+			   uint8_t cfgidx);
+
+uint8_t  USBD_MIDI_Setup (USBD_HandleTypeDef *pdev, 
+			  USBD_SetupReqTypedef *req);
+
+uint8_t  USBD_MIDI_DataIn (USBD_HandleTypeDef *pdev, 
+			   uint8_t epnum);
+
+uint8_t  USBD_MIDI_DataOut (USBD_HandleTypeDef *pdev, 
+			    uint8_t epnum);
+
+uint8_t  USBD_MIDI_SOF (USBD_HandleTypeDef *pdev);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  /* __USB_MIDI_H */
+/**
+  * @}
+  */ 
+
+/**
+  * @}
+  */ 
+  
+/************************ (C) COPYRIGHT STMicroelectronics *****END OF FILE****/
@@ -0,0 +1,375 @@
+/**
+  ******************************************************************************
+  * @file    usbd_midi.c
+  * @author  MCD Application Team
+  * @version V2.4.2
+  * @date    11-December-2015
+  * @brief   This file provides the MIDI core functions.
+  *
+  * @verbatim
+  *      
+  *          ===================================================================      
+  *                                MIDI Class  Description
+  *          ===================================================================
+  *           This driver manages the MIDI Streaming subclass following the "Universal Serial
+  *           Bus Device Class Definition for MIDI Devices Release 1.0 Nov 1, 1999".
+  *           This driver implements the following aspects of the specification:
+  *             - Audio Class-Specific AC Interface without units (header only)
+  *             - 1 MIDI Streaming Interface with one embedded and one external jack
+  *               per direction (a single cable, number 0)
+  *             - 1 bulk OUT and 1 bulk IN Endpoint carrying 4 byte USB-MIDI event packets
+  *
+  *           The descriptors are part of the composite configuration in usbd_cdc_msc.c.
+  *           The endpoints are open while the configuration is selected. Batching of
+  *           event packets is left to the user application, which gets called on SOF.
+  *      
+  *  @endverbatim
+  *
+  ******************************************************************************
+  * @attention
+  *
+  * <h2><center>&copy; COPYRIGHT 2015 STMicroelectronics</center></h2>
+  *
+  * Licensed under MCD-ST Liberty SW License Agreement V2, (the "License");
+  * You may not use this file except in compliance with the License.
+  * You may obtain a copy of the License at:
+  *
+  *        http://www.st.com/software_license_agreement_liberty_v2
+  *
+  * Unless required by applicable law or agreed to in writing, software 
+  * distributed under the License is distributed on an "AS IS" BASIS, 
+  * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  * See the License for the specific language governing permissions and
+  * limitations under the License.
+  *
+  ******************************************************************************
+  */ 
+
+/* Includes ------------------------------------------------------------------*/
+#include "usbd_midi.h"
+#include "usbd_desc.h"
+#include "usbd_ctlreq.h"
+
+#include <string.h>
+
+
+/** @addtogroup STM32_USB_DEVICE_LIBRARY
+  * @{
+  */
+
+
+/** @defgroup USBD_MIDI 
+  * @brief usbd core module
+  * @{
+  */ 
+
+/** @defgroup USBD_MIDI_Private_TypesDefinitions
+  * @{
+  */ 
+/**
+  * @}
+  */ 
+
+
+/** @defgroup USBD_MIDI_Private_Defines
+  * @{
+  */ 
+/**
+  * @}
+  */ 
+
+
+/** @defgroup USBD_MIDI_Private_Macros
+  * @{
+  */ 
+/**
+  * @}
+  */ 
+
+
+/** @defgroup USBD_MIDI_Private_Variables
+  * @{
+  */ 
+
+static USBD_MIDI_HandleTypeDef USBD_MIDI_Handle;
+
+/**
+  * @}
+  */ 
+
+/** @defgroup USBD_MIDI_Private_Functions
+  * @{
+  */ 
+
+/**
+  * @brief  USBD_MIDI_Init
+  *         Initialize the MIDI interface
+  * @param  pdev: device instance
+  * @param  cfgidx: Configuration index
+  * @retval status
+  */
+uint8_t  USBD_MIDI_Init (USBD_HandleTypeDef *pdev, 
+			 uint8_t cfgidx)
+{
+  USBD_MIDI_HandleTypeDef   *hmidi;
+
+  USBD_LL_OpenEP(pdev,
+                 MIDI_IN_EP,
+                 USBD_EP_TYPE_BULK,
+                 MIDI_PACKET_SIZE);
+
+  USBD_LL_OpenEP(pdev,
+                 MIDI_OUT_EP,
+                 USBD_EP_TYPE_BULK,
+                 MIDI_PACKET_SIZE);
+
+  pdev->pClassData[5] = &USBD_MIDI_Handle;
+
+  hmidi = (USBD_MIDI_HandleTypeDef*) pdev->pClassData[5];
+
+  hmidi->TxState = 0;
+  hmidi->RxState = 1;
+
+  ((USBD_MIDI_ItfTypeDef *)pdev->pUserData[5])->Init(pdev);
+
+  USBD_LL_PrepareReceive(pdev,
+			 MIDI_OUT_EP,
+			 (uint8_t*)&hmidi->RxBuffer[0],
+			 MIDI_PACKET_SIZE);
+
+  return USBD_OK;
+}
+
+/**
+  * @brief  USBD_MIDI_DeInit
+  *         DeInitialize the MIDI layer
+  * @param  pdev: device instance
+  * @param  cfgidx: Configuration index
+  * @retval status
+  */
+uint8_t  USBD_MIDI_DeInit (USBD_HandleTypeDef *pdev, 
+			   uint8_t cfgidx)
+{
+  USBD_LL_CloseEP(pdev,
+                  MIDI_IN_EP);
+
+  USBD_LL_CloseEP(pdev,
+                  MIDI_OUT_EP);
+
+  if(pdev->pClassData[5] != NULL)
+  {
+    ((USBD_MIDI_ItfTypeDef *)pdev->pUserData[5])->DeInit();
+
+    pdev->pClassData[5] = NULL;
+  }
+  
+  return USBD_OK;
+}
+
+/**
+  * @brief  USBD_MIDI_Setup
+  *         Handle the MIDI specific requests. There are no class specific
+  *         requests, and both interfaces only have alternate setting 0.
+  * @param  pdev: instance
+  * @param  req: usb requests
+  * @retval status
+  */
+uint8_t  USBD_MIDI_Setup (USBD_HandleTypeDef *pdev, 
+			  USBD_SetupReqTypedef *req)
+{
+  static uint8_t ifalt = 0;
+
+  switch (req->bmRequest & USB_REQ_TYPE_MASK)
+  {
+  case USB_REQ_TYPE_CLASS :  
+    USBD_CtlError (pdev, req);
+    return USBD_FAIL; 
+
+  case USB_REQ_TYPE_STANDARD:
+    switch (req->bRequest)
+    {
+    case USB_REQ_GET_INTERFACE :
+      USBD_CtlSendData (pdev, &ifalt, 1);
+      break;
+      
+    case USB_REQ_SET_INTERFACE :
+      if (req->wValue != 0)
+      {
+	USBD_CtlError (pdev, req);
+	return USBD_FAIL; 
+      }
+      break;
+    }
+  }
+
+  return USBD_OK;
+}
+
+/**
+  * @brief  USBD_MIDI_DataIn
+  *         handle data IN Stage
+  * @param  pdev: device instance
+  * @param  epnum: endpoint index
+  * @retval status
+  */
+uint8_t  USBD_MIDI_DataIn (USBD_HandleTypeDef *pdev, 
+			   uint8_t epnum)
+{
+  USBD_MIDI_HandleTypeDef   *hmidi = (USBD_MIDI_HandleTypeDef*) pdev->pClassData[5];
+
+  if (hmidi == NULL)
+  {
+    return USBD_FAIL;
+  }
+
+  hmidi->TxState = 0;
+
+  ((USBD_MIDI_ItfTypeDef *)pdev->pUserData[5])->TxDone();
+
+  return USBD_OK;
+}
+
+/**
+  * @brief  USBD_MIDI_DataOut
+  *         handle data OUT Stage. If the user application has no room for another
+  *         packet, the endpoint stays NAKed until USBD_MIDI_ReceivePacket().
+  * @param  pdev: device instance
+  * @param  epnum: endpoint index
+  * @retval status
+  */
+uint8_t  USBD_MIDI_DataOut (USBD_HandleTypeDef *pdev, 
+			    uint8_t epnum)
+{
+  USBD_MIDI_HandleTypeDef   *hmidi = (USBD_MIDI_HandleTypeDef*) pdev->pClassData[5];
+
+  if (hmidi == NULL)
+  {
+    return USBD_FAIL;
+  }
+
+  hmidi->RxState = 0;
+
+  if (((USBD_MIDI_ItfTypeDef *)pdev->pUserData[5])->Receive((uint8_t*)&hmidi->RxBuffer[0], USBD_LL_GetRxDataSize (pdev, epnum)))
+  {
+    USBD_MIDI_ReceivePacket(pdev);
+  }
+
+  return USBD_OK;
+}
+
+/**
+  * @brief  USBD_MIDI_SOF
+  *         Start of frame, lets the user application send what it collected.
+  * @param  pdev: device instance
+  * @retval status
+  */
+uint8_t USBD_MIDI_SOF(USBD_HandleTypeDef *pdev)
+{
+  if (pdev->pClassData[5] == NULL)
+  {
+    return USBD_OK;
+  }
+
+  ((USBD_MIDI_ItfTypeDef *)pdev->pUserData[5])->SOF();
+
+  return USBD_OK;
+}
+
+/**
+* @brief  USBD_MIDI_RegisterInterface
+  * @param  pdev: device instance
+  * @param  fops: MIDI Interface callback
+  * @retval status
+  */
+uint8_t  USBD_MIDI_RegisterInterface  (USBD_HandleTypeDef  *pdev, 
+                                       const USBD_MIDI_ItfTypeDef *fops)
+{
+  pdev->pUserData[5] = fops;
+
+  return USBD_OK;    
+}
+
+/**
+  * @brief  USBD_MIDI_ReceivePacket
+  *         prepare OUT Endpoint for reception, unless it already is
+  * @param  pdev: device instance
+  * @retval status
+  */
+uint8_t  USBD_MIDI_ReceivePacket(USBD_HandleTypeDef *pdev)
+{      
+  USBD_MIDI_HandleTypeDef   *hmidi = (USBD_MIDI_HandleTypeDef*) pdev->pClassData[5];
+
+  if (hmidi == NULL)
+  {
+    return USBD_FAIL;
+  }
+
+  if (hmidi->RxState)
+  {
+    return USBD_OK;
+  }
+
+  hmidi->RxState = 1;
+
+  USBD_LL_PrepareReceive(pdev,
+			 MIDI_OUT_EP,
+			 (uint8_t*)&hmidi->RxBuffer[0],
+			 MIDI_PACKET_SIZE);
+
+  return USBD_OK;
+}
+
+/**
+  * @brief  USBD_MIDI_TransmitPacket
+  *         Copies up to MIDI_PACKET_SIZE bytes into the class buffer and sends them
+  * @param  pdev: device instance
+  * @param  pbuff: event packets
+  * @param  length: number of bytes, a multiple of 4
+  * @retval status
+  */
+uint8_t  USBD_MIDI_TransmitPacket(USBD_HandleTypeDef *pdev, const uint8_t *pbuff, uint16_t length)
+{      
+  USBD_MIDI_HandleTypeDef   *hmidi = (USBD_MIDI_HandleTypeDef*) pdev->pClassData[5];
+  
+  if (hmidi == NULL)
+  {
+    return USBD_FAIL;
+  }
+
+  if (hmidi->TxState)
+  {
+    return USBD_BUSY;
+  }
+
+  if (length > MIDI_PACKET_SIZE)
+  {
+    length = MIDI_PACKET_SIZE;
+  }
+
+  memcpy(&hmidi->TxBuffer[0], pbuff, length);
+
+  hmidi->TxState = 1;
+
+  USBD_LL_Transmit(pdev,
+		   MIDI_IN_EP,
+		   (uint8_t*)&hmidi->TxBuffer[0],
+		   length);
+
+  return USBD_OK;
+}
+
+/**
+  * @}
+  */ 
+
+
+/**
+  * @}
+  */ 
+
+
+/**
+  * @}
+  */ 
+
+/************************ (C) COPYRIGHT STMicroelectronics *****END OF FILE****/
@@ -60,8 +60,19 @@
 #define MSC_EPIN_ADDR                0x83 
 #define MSC_EPOUT_ADDR               0x03 
 
+/* Packet memory for the USB FS device. The OUT endpoint is double buffered. The
+ * second buffer is in the AUDIO space, which is not used together with MSC.
+ */
+#define MSC_EPOUT_PMA0               0x180
+#define MSC_EPOUT_PMA1               0x2c0
+
 #define MSC_INTERFACE                2
 
+#define MSC_PIPE_NONE                0
+#define MSC_PIPE_BUSY                1
+#define MSC_PIPE_DONE                2
+#define MSC_PIPE_ERROR               3
+
 /**
   * @}
   */ 
@@ -82,6 +93,8 @@ typedef struct _USBD_STORAGE
   int8_t (* Acquire) (uint8_t lun);
   int8_t (* Read) (uint8_t lun, uint8_t *buf, uint32_t blk_addr, uint16_t blk_len, uint8_t last);
   int8_t (* Write) (uint8_t lun, uint8_t *buf, uint32_t blk_addr, uint16_t blk_len, uint8_t last);
+  int8_t (* ReadAsync) (uint8_t lun, uint8_t *buf, uint32_t blk_addr, uint16_t blk_len, uint8_t last, volatile uint8_t *p_status);
+  int8_t (* Flush) (uint8_t lun);
   int8_t (* GetMaxLun) (void);
   const int8_t *pInquiry;
   
@@ -96,6 +109,9 @@ typedef struct
   uint8_t                  bot_status;  
   uint16_t                 bot_data_length;
   uint8_t                  bot_data[MSC_MEDIA_PACKET];  
+  uint8_t                  bot_pipe_data[MSC_MEDIA_PACKET];
+  uint8_t                  bot_pipe_index;
+  volatile uint8_t         bot_pipe_status;
   USBD_MSC_BOT_CBWTypeDef  cbw;
   USBD_MSC_BOT_CSWTypeDef  csw;
   
@@ -80,6 +80,7 @@
 #define SCSI_VERIFY16                               0x8F
 
 #define SCSI_SEND_DIAGNOSTIC                        0x1D
+#define SCSI_SYNCHRONIZE_CACHE10                    0x35
 #define SCSI_READ_FORMAT_CAPACITIES                 0x23
 
 #define NO_SENSE                                    0
@@ -176,6 +177,8 @@ void   SCSI_SenseCode(USBD_HandleTypeDef  *pdev,
                       uint8_t sKey, 
                       uint8_t ASC);
 
+void   SCSI_PipeFlush(USBD_HandleTypeDef  *pdev);
+
 /**
   * @}
   */ 
@@ -126,6 +126,8 @@ uint8_t  USBD_MSC_Init (USBD_HandleTypeDef *pdev,
   int16_t ret = 0;
    
   /* Open EP OUT */
+  USBD_LL_DoubleBufferEP(pdev, MSC_EPOUT_ADDR, MSC_EPOUT_PMA0, MSC_EPOUT_PMA1);
+
   USBD_LL_OpenEP(pdev,
 		 MSC_EPOUT_ADDR,
 		 USBD_EP_TYPE_BULK,
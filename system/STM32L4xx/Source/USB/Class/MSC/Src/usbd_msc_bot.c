@@ -111,6 +111,8 @@ void MSC_BOT_Init (USBD_HandleTypeDef  *pdev)
   
   hmsc->scsi_sense_tail = 0;
   hmsc->scsi_sense_head = 0;
+
+  SCSI_PipeFlush(pdev);
   
   ((USBD_StorageTypeDef *)pdev->pUserData[1])->Init(0);
   
@@ -134,6 +136,9 @@ void MSC_BOT_Reset (USBD_HandleTypeDef  *pdev)
 {
   USBD_MSC_BOT_HandleTypeDef  *hmsc = (USBD_MSC_BOT_HandleTypeDef*)pdev->pClassData[1];
     
+  /* A read ahead may still target bot_data */
+  SCSI_PipeFlush(pdev);
+
   hmsc->bot_state  = USBD_BOT_IDLE;
   hmsc->bot_status = USBD_BOT_STATUS_RECOVERY;  
   
@@ -63,6 +63,7 @@
 /** @defgroup MSC_SCSI_Private_Macros
   * @{
   */ 
+#define SCSI_PIPE_DATA(_hmsc, _index) ((_index) ? &(_hmsc)->bot_pipe_data[0] : &(_hmsc)->bot_data[0])
 /**
   * @}
   */ 
@@ -92,6 +93,7 @@ static int8_t SCSI_ModeSense10 (USBD_HandleTypeDef  *pdev, uint8_t lun, uint8_t
 static int8_t SCSI_Write10(USBD_HandleTypeDef  *pdev, uint8_t lun , uint8_t *params);
 static int8_t SCSI_Read10(USBD_HandleTypeDef  *pdev, uint8_t lun , uint8_t *params);
 static int8_t SCSI_Verify10(USBD_HandleTypeDef  *pdev, uint8_t lun, uint8_t *params);
+static int8_t SCSI_SynchronizeCache10(USBD_HandleTypeDef  *pdev, uint8_t lun, uint8_t *params);
 static int8_t SCSI_CheckAddressRange (USBD_HandleTypeDef  *pdev, 
                                       uint8_t lun , 
                                       uint32_t blk_offset , 
@@ -162,6 +164,9 @@ int8_t SCSI_ProcessCmd(USBD_HandleTypeDef  *pdev,
   case SCSI_VERIFY10:
     return SCSI_Verify10(pdev, lun, params);
     
+  case SCSI_SYNCHRONIZE_CACHE10:
+    return SCSI_SynchronizeCache10(pdev, lun, params);
+    
   default:
     SCSI_SenseCode(pdev, 
                    lun,
@@ -412,6 +417,24 @@ static int8_t SCSI_RequestSense (USBD_HandleTypeDef  *pdev, uint8_t lun, uint8_t
   return 0;
 }
 
+/**
+* @brief  SCSI_PipeFlush
+*         Wait for an outstanding read ahead and reset the double buffer
+* @param  pdev: device instance
+* @retval none
+*/
+void SCSI_PipeFlush(USBD_HandleTypeDef  *pdev)
+{
+  USBD_MSC_BOT_HandleTypeDef  *hmsc = (USBD_MSC_BOT_HandleTypeDef*) pdev->pClassData[1]; 
+
+  while (hmsc->bot_pipe_status == MSC_PIPE_BUSY)
+  {
+  }
+
+  hmsc->bot_pipe_status = MSC_PIPE_NONE;
+  hmsc->bot_pipe_index = 0;
+}
+
 /**
 * @brief  SCSI_SenseCode
 *         Load the last error code in the error list
@@ -525,6 +548,8 @@ static int8_t SCSI_Read10(USBD_HandleTypeDef  *pdev, uint8_t lun , uint8_t *para
     hmsc->bot_state = USBD_BOT_DATA_IN;
     hmsc->scsi_blk_addr *= hmsc->scsi_blk_size;
     hmsc->scsi_blk_len  *= hmsc->scsi_blk_size;
+
+    SCSI_PipeFlush(pdev);
     
     /* cases 4,5 : Hi <> Dn */
     if (hmsc->cbw.dDataLength != hmsc->scsi_blk_len)
@@ -626,11 +651,13 @@ static int8_t SCSI_Write10 (USBD_HandleTypeDef  *pdev, uint8_t lun , uint8_t *pa
       return -1;
     }
     
+    SCSI_PipeFlush(pdev);
+
     /* Prepare EP to receive first data packet */
     hmsc->bot_state = USBD_BOT_DATA_OUT;  
     USBD_LL_PrepareReceive (pdev,
                       MSC_EPOUT_ADDR,
-                      hmsc->bot_data, 
+                      SCSI_PIPE_DATA(hmsc, hmsc->bot_pipe_index), 
                       MIN (hmsc->scsi_blk_len, MSC_MEDIA_PACKET));  
   }
   else /* Write Process ongoing */
@@ -673,6 +700,34 @@ static int8_t SCSI_Verify10(USBD_HandleTypeDef  *pdev, uint8_t lun , uint8_t *pa
   return 0;
 }
 
+/**
+* @brief  SCSI_SynchronizeCache10
+*         Process SynchronizeCache10 command
+* @param  lun: Logical unit number
+* @param  params: Command parameters
+* @retval status
+*/
+
+static int8_t SCSI_SynchronizeCache10(USBD_HandleTypeDef  *pdev, uint8_t lun, uint8_t *params)
+{
+  USBD_MSC_BOT_HandleTypeDef  *hmsc = (USBD_MSC_BOT_HandleTypeDef*) pdev->pClassData[1]; 
+  
+  hmsc->bot_data_length = 0;
+
+  if (((USBD_StorageTypeDef *)pdev->pUserData[1])->Flush)
+  {
+    if (((USBD_StorageTypeDef *)pdev->pUserData[1])->Flush(lun) < 0)
+    {
+      SCSI_SenseCode(pdev,
+                     lun, 
+                     MEDIUM_ERROR, 
+                     WRITE_FAULT);     
+      return -1;
+    }
+  }
+  return 0;
+}
+
 /**
 * @brief  SCSI_CheckAddressRange
 *         Check address range
@@ -705,28 +760,54 @@ static int8_t SCSI_CheckAddressRange (USBD_HandleTypeDef  *pdev, uint8_t lun , u
 static int8_t SCSI_ProcessRead (USBD_HandleTypeDef  *pdev, uint8_t lun)
 {
   USBD_MSC_BOT_HandleTypeDef  *hmsc = (USBD_MSC_BOT_HandleTypeDef*)pdev->pClassData[1];   
-  uint32_t len;
+  uint32_t len, next;
   
   len = MIN(hmsc->scsi_blk_len , MSC_MEDIA_PACKET); 
   
-  if( ((USBD_StorageTypeDef *)pdev->pUserData[1])->Read(lun ,
-                              hmsc->bot_data, 
-                              hmsc->scsi_blk_addr / hmsc->scsi_blk_size, 
-  			      len / hmsc->scsi_blk_size,
-			      (hmsc->scsi_blk_len == len)) < 0)
+  if (hmsc->bot_pipe_status != MSC_PIPE_NONE)
   {
-    
-    SCSI_SenseCode(pdev,
-                   lun, 
-                   HARDWARE_ERROR, 
-                   UNRECOVERED_READ_ERROR);
-    return -1; 
+    /* The chunk was read ahead into the other buffer while the previous
+     * one was on the wire. The storage completes from an interrupt that
+     * preempts the USB interrupt, so it's fine to spin here.
+     */
+    while (hmsc->bot_pipe_status == MSC_PIPE_BUSY)
+    {
+    }
+
+    if (hmsc->bot_pipe_status == MSC_PIPE_ERROR)
+    {
+      hmsc->bot_pipe_status = MSC_PIPE_NONE;
+
+      SCSI_SenseCode(pdev,
+                     lun, 
+                     HARDWARE_ERROR, 
+                     UNRECOVERED_READ_ERROR);
+      return -1; 
+    }
+
+    hmsc->bot_pipe_status = MSC_PIPE_NONE;
+    hmsc->bot_pipe_index ^= 1;
+  }
+  else
+  {
+    if( ((USBD_StorageTypeDef *)pdev->pUserData[1])->Read(lun ,
+                                SCSI_PIPE_DATA(hmsc, hmsc->bot_pipe_index), 
+                                hmsc->scsi_blk_addr / hmsc->scsi_blk_size, 
+                                len / hmsc->scsi_blk_size,
+                                (hmsc->scsi_blk_len == len)) < 0)
+    {
+      
+      SCSI_SenseCode(pdev,
+                     lun, 
+                     HARDWARE_ERROR, 
+                     UNRECOVERED_READ_ERROR);
+      return -1; 
+    }
   }
-  
   
   USBD_LL_Transmit (pdev, 
              MSC_EPIN_ADDR,
-             hmsc->bot_data,
+             SCSI_PIPE_DATA(hmsc, hmsc->bot_pipe_index),
              len);
   
   
@@ -740,6 +821,29 @@ static int8_t SCSI_ProcessRead (USBD_HandleTypeDef  *pdev, uint8_t lun)
   {
     hmsc->bot_state = USBD_BOT_LAST_DATA_IN;
   }
+  else
+  {
+    /* Start reading the next chunk into the other buffer, so that the
+     * card and the USB transfer overlap. If the storage cannot do that
+     * (no ReadAsync, or no DMA available) the next call reads inline.
+     */
+    if (((USBD_StorageTypeDef *)pdev->pUserData[1])->ReadAsync)
+    {
+      next = MIN(hmsc->scsi_blk_len , MSC_MEDIA_PACKET); 
+
+      hmsc->bot_pipe_status = MSC_PIPE_BUSY;
+
+      if (((USBD_StorageTypeDef *)pdev->pUserData[1])->ReadAsync(lun ,
+                                  SCSI_PIPE_DATA(hmsc, hmsc->bot_pipe_index ^ 1), 
+                                  hmsc->scsi_blk_addr / hmsc->scsi_blk_size, 
+                                  next / hmsc->scsi_blk_size,
+                                  (hmsc->scsi_blk_len == next),
+                                  &hmsc->bot_pipe_status) < 0)
+      {
+        hmsc->bot_pipe_status = MSC_PIPE_NONE;
+      }
+    }
+  }
   return 0;
 }
 
@@ -753,12 +857,28 @@ static int8_t SCSI_ProcessRead (USBD_HandleTypeDef  *pdev, uint8_t lun)
 static int8_t SCSI_ProcessWrite (USBD_HandleTypeDef  *pdev, uint8_t lun)
 {
   uint32_t len;
+  uint8_t *data;
   USBD_MSC_BOT_HandleTypeDef  *hmsc = (USBD_MSC_BOT_HandleTypeDef*) pdev->pClassData[1]; 
   
   len = MIN(hmsc->scsi_blk_len , MSC_MEDIA_PACKET); 
+
+  data = SCSI_PIPE_DATA(hmsc, hmsc->bot_pipe_index);
+
+  if (hmsc->scsi_blk_len != len)
+  {
+    /* Let the host send the next chunk into the other buffer while this
+     * one is written to the storage.
+     */
+    hmsc->bot_pipe_index ^= 1;
+
+    USBD_LL_PrepareReceive (pdev,
+                            MSC_EPOUT_ADDR,
+                            SCSI_PIPE_DATA(hmsc, hmsc->bot_pipe_index), 
+                            MIN (hmsc->scsi_blk_len - len, MSC_MEDIA_PACKET)); 
+  }
   
   if(((USBD_StorageTypeDef *)pdev->pUserData[1])->Write(lun ,
-                              hmsc->bot_data, 
+                              data, 
                               hmsc->scsi_blk_addr / hmsc->scsi_blk_size, 
 			      len / hmsc->scsi_blk_size,
 			      (hmsc->scsi_blk_len == len)) < 0)
@@ -781,14 +901,6 @@ static int8_t SCSI_ProcessWrite (USBD_HandleTypeDef  *pdev, uint8_t lun)
   {
     MSC_BOT_SendCSW (pdev, USBD_CSW_CMD_PASSED);
   }
-  else
-  {
-    /* Prepare EP to Receive next packet */
-    USBD_LL_PrepareReceive (pdev,
-                            MSC_EPOUT_ADDR,
-                            hmsc->bot_data, 
-                            MIN (hmsc->scsi_blk_len, MSC_MEDIA_PACKET)); 
-  }
   
   return 0;
 }
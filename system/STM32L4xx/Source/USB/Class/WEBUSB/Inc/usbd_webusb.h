@@ -100,6 +100,8 @@ uint8_t  USBD_WEBUSB_SetRxBuffer        (USBD_HandleTypeDef   *pdev,
   
 uint8_t  USBD_WEBUSB_ReceivePacket      (USBD_HandleTypeDef *pdev);
 
+uint8_t  USBD_WEBUSB_ReceiveBlock       (USBD_HandleTypeDef *pdev, uint32_t length);
+
 uint8_t  USBD_WEBUSB_TransmitPacket     (USBD_HandleTypeDef *pdev);
 /**
   * @}
@@ -120,6 +122,8 @@ uint8_t  USBD_WEBUSB_DataIn (USBD_HandleTypeDef *pdev,
 uint8_t  USBD_WEBUSB_DataOut (USBD_HandleTypeDef *pdev, 
 			   uint8_t epnum);
 
+uint8_t  USBD_WEBUSB_EP0_RxReady (USBD_HandleTypeDef *pdev);
+
 
 #ifdef __cplusplus
 }
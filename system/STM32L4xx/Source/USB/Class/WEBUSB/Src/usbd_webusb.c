@@ -119,6 +119,8 @@ uint8_t  USBD_WEBUSB_DataIn (USBD_HandleTypeDef *pdev,
 uint8_t  USBD_WEBUSB_DataOut (USBD_HandleTypeDef *pdev, 
 			   uint8_t epnum);
 
+uint8_t  USBD_WEBUSB_EP0_RxReady (USBD_HandleTypeDef *pdev);
+
 
 // static const uint8_t* USDB_WEBUSB_MS_OS_20_Descriptor;
 // static uint16_t USDB_WEBUSB_MS_OS_20_Length;
@@ -178,6 +180,7 @@ uint8_t USBD_WEBUSB_Init (USBD_HandleTypeDef *pdev,
   /* Init Xfer states */
   hcdc->TxState =0;
   hcdc->RxState =0;
+  hcdc->CmdOpCode = 0xFF;
        
   /* Prepare Out endpoint to receive next packet */
   USBD_LL_PrepareReceive(pdev,
@@ -230,8 +233,15 @@ uint8_t USBD_WEBUSB_Setup (USBD_HandleTypeDef *pdev,
     
   switch (req->bmRequest & USB_REQ_TYPE_MASK) {
   case USB_REQ_TYPE_CLASS :
+  case USB_REQ_TYPE_VENDOR :
     if (req->wLength)
     {
+      if (req->wLength > sizeof(hcdc->data))
+      {
+        USBD_CtlError (pdev, req);
+        return USBD_FAIL;
+      }
+
       if (req->bmRequest & 0x80)
       {
         ((USBD_CDC_ItfTypeDef *)pdev->pUserData[3])->Control(req->bRequest,
@@ -327,6 +337,27 @@ uint8_t USBD_WEBUSB_DataOut (USBD_HandleTypeDef *pdev, uint8_t epnum)
 }
 
 
+/**
+  * @brief  USBD_WEBUSB_EP0_RxReady
+  *         Handle the data stage of host-to-device class/vendor requests
+  * @param  pdev: device instance
+  * @retval status
+  */
+uint8_t USBD_WEBUSB_EP0_RxReady (USBD_HandleTypeDef *pdev)
+{ 
+  USBD_CDC_HandleTypeDef   *hcdc = (USBD_CDC_HandleTypeDef*) pdev->pClassData[3];
+  
+  if((hcdc != NULL) && (hcdc->CmdOpCode != 0xFF))
+  {
+    ((USBD_CDC_ItfTypeDef *)pdev->pUserData[3])->Control(hcdc->CmdOpCode,
+							 (uint8_t *)hcdc->data,
+							 hcdc->CmdLength);
+    hcdc->CmdOpCode = 0xFF; 
+  }
+  return USBD_OK;
+}
+
+
 /**
 * @brief USBD_WEBUSB_RegisterInterface
   * @param  pdev: device instance
@@ -435,6 +466,25 @@ uint8_t USBD_WEBUSB_ReceivePacket(USBD_HandleTypeDef *pdev)
 			 CDC_DATA_FS_OUT_PACKET_SIZE);
   return USBD_OK;
 }
+
+/**
+  * @brief USBD_WEBUSB_ReceiveBlock
+  *         prepare OUT Endpoint for a multi packet reception of up to
+  *         "length" bytes, which completes early on a short packet
+  * @param  pdev: device instance
+  * @param  length: maximum transfer length (a multiple of the packet size)
+  * @retval status
+  */
+uint8_t USBD_WEBUSB_ReceiveBlock(USBD_HandleTypeDef *pdev, uint32_t length)
+{      
+  USBD_CDC_HandleTypeDef   *hcdc = (USBD_CDC_HandleTypeDef*) pdev->pClassData[3];
+  
+  USBD_LL_PrepareReceive(pdev,
+			 WEBUSB_OUT_EP,
+			 hcdc->RxBuffer,
+			 length);
+  return USBD_OK;
+}
 /**
   * @}
   */ 
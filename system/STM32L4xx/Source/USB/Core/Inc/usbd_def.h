@@ -228,8 +228,8 @@ typedef struct _USBD_HandleTypeDef
 
   USBD_SetupReqTypedef    request;
   const USBD_ClassTypeDef *pClass;
-  void                    *pClassData[4];  
-  const void              *pUserData[4];    
+  void                    *pClassData[6];  
+  const void              *pUserData[6];    
   void                    *pData;    
 } USBD_HandleTypeDef;
 
@@ -289,6 +289,10 @@ typedef struct
   uint8_t   doublebuffer;    /*!< Double buffer enable
                                  This parameter can be 0 or 1                                             */
   
+  __IO uint8_t xfer_active;  /*!< Bulk OUT double buffer: a transfer is armed                              */
+  
+  __IO uint8_t xfer_pending; /*!< Bulk OUT double buffer: a packet arrived while no transfer was armed     */
+  
   uint16_t  tx_fifo_num;    /*!< This parameter is not required by USB Device FS peripheral, it is used 
                                  only by USB OTG FS peripheral    
                                  This parameter is added to ensure compatibility across USB peripherals   */
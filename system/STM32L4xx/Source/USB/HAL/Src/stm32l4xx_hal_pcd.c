@@ -117,6 +117,7 @@ static HAL_StatusTypeDef PCD_WriteEmptyTxFifo(PCD_HandleTypeDef *hpcd, uint32_t
 #endif /* USB_OTG_FS */
 #if defined (USB)
 static HAL_StatusTypeDef PCD_EP_ISR_Handler(PCD_HandleTypeDef *hpcd);
+static void PCD_EP_DB_Receive(PCD_HandleTypeDef *hpcd, PCD_EPTypeDef *ep);
 #endif /* USB */
 /**
   * @}
@@ -761,6 +762,20 @@ void HAL_PCD_IRQHandler(PCD_HandleTypeDef *hpcd)
 void HAL_PCD_IRQHandler(PCD_HandleTypeDef *hpcd)
 {
   uint32_t wInterrupt_Mask = 0;
+  uint32_t epindex;
+  
+  /* Double buffered bulk OUT packets that arrived before their transfer got armed
+   * (see USB_EPStartXfer()).
+   */
+  for (epindex = 1; epindex < 8; epindex++)
+  {
+    if (hpcd->OUT_ep[epindex].xfer_pending && hpcd->OUT_ep[epindex].xfer_active)
+    {
+      hpcd->OUT_ep[epindex].xfer_pending = 0;
+      
+      PCD_EP_DB_Receive(hpcd, &hpcd->OUT_ep[epindex]);
+    }
+  }
   
   if (__HAL_PCD_GET_FLAG (hpcd, USB_ISTR_CTR))
   {
@@ -1505,49 +1520,66 @@ static HAL_StatusTypeDef PCD_EP_ISR_Handler(PCD_HandleTypeDef *hpcd)
         PCD_CLEAR_RX_EP_CTR(hpcd->Instance, epindex);
         ep = &hpcd->OUT_ep[epindex];
         
-        /* OUT double Buffering*/
-        if (ep->doublebuffer == 0)
+        if ((ep->doublebuffer != 0) && (ep->type == EP_TYPE_BULK))
         {
-          count = PCD_GET_EP_RX_CNT(hpcd->Instance, ep->num);
-          if (count != 0)
+          if (ep->xfer_active)
           {
-            USB_ReadPMA(hpcd->Instance, ep->xfer_buff, ep->pmaadress, count);
+            PCD_EP_DB_Receive(hpcd, ep);
+          }
+          else
+          {
+            /* Nothing armed, so leave the packet in its buffer. The hardware NAKs
+             * further packets, as software owns the other buffer.
+             */
+            ep->xfer_pending = 1;
           }
         }
         else
         {
-          if (PCD_GET_ENDPOINT(hpcd->Instance, ep->num) & USB_EP_DTOG_RX)
+          /* OUT double Buffering*/
+          if (ep->doublebuffer == 0)
           {
-            /*read from endpoint BUF0Addr buffer*/
-            count = PCD_GET_EP_DBUF0_CNT(hpcd->Instance, ep->num);
+            count = PCD_GET_EP_RX_CNT(hpcd->Instance, ep->num);
             if (count != 0)
             {
-              USB_ReadPMA(hpcd->Instance, ep->xfer_buff, ep->pmaaddr0, count);
+              USB_ReadPMA(hpcd->Instance, ep->xfer_buff, ep->pmaadress, count);
             }
           }
           else
           {
-            /*read from endpoint BUF1Addr buffer*/
-            count = PCD_GET_EP_DBUF1_CNT(hpcd->Instance, ep->num);
-            if (count != 0)
+            if (PCD_GET_ENDPOINT(hpcd->Instance, ep->num) & USB_EP_DTOG_RX)
             {
-              USB_ReadPMA(hpcd->Instance, ep->xfer_buff, ep->pmaaddr1, count);
+              /*read from endpoint BUF0Addr buffer*/
+              count = PCD_GET_EP_DBUF0_CNT(hpcd->Instance, ep->num);
+              if (count != 0)
+              {
+                USB_ReadPMA(hpcd->Instance, ep->xfer_buff, ep->pmaaddr0, count);
+              }
             }
+            else
+            {
+              /*read from endpoint BUF1Addr buffer*/
+              count = PCD_GET_EP_DBUF1_CNT(hpcd->Instance, ep->num);
+              if (count != 0)
+              {
+                USB_ReadPMA(hpcd->Instance, ep->xfer_buff, ep->pmaaddr1, count);
+              }
+            }
+            PCD_FreeUserBuffer(hpcd->Instance, ep->num, PCD_EP_DBUF_OUT);  
           }
-          PCD_FreeUserBuffer(hpcd->Instance, ep->num, PCD_EP_DBUF_OUT);  
-        }
-        /*multi-packet on the NON control OUT endpoint*/
-        ep->xfer_count+=count;
-        ep->xfer_buff+=count;
+          /*multi-packet on the NON control OUT endpoint*/
+          ep->xfer_count+=count;
+          ep->xfer_buff+=count;
        
-        if ((ep->xfer_len == 0) || (count < ep->maxpacket))
-        {
-          /* RX COMPLETE */
-          HAL_PCD_DataOutStageCallback(hpcd, ep->num);
-        }
-        else
-        {
-          HAL_PCD_EP_Receive(hpcd, ep->num, ep->xfer_buff, ep->xfer_len);
+          if ((ep->xfer_len == 0) || (count < ep->maxpacket))
+          {
+            /* RX COMPLETE */
+            HAL_PCD_DataOutStageCallback(hpcd, ep->num);
+          }
+          else
+          {
+            HAL_PCD_EP_Receive(hpcd, ep->num, ep->xfer_buff, ep->xfer_len);
+          }
         }
         
       } /* if((wEPVal & EP_CTR_RX) */
@@ -1609,6 +1641,58 @@ static HAL_StatusTypeDef PCD_EP_ISR_Handler(PCD_HandleTypeDef *hpcd)
   }
   return HAL_OK;
 }
+
+/**
+  * @brief  Receives a packet on a double buffered bulk OUT endpoint.
+  *         The packet is in the buffer DTOG_RX no longer points to. SW_BUF (DTOG_TX) selects
+  *         the buffer software owns, and the hardware NAKs while DTOG_RX == SW_BUF. So the
+  *         other buffer is handed back first, and the host can send the next packet while
+  *         this one is copied out of the PMA.
+  * @param  hpcd: PCD handle
+  * @param  ep: endpoint
+  * @retval None
+  */
+static void PCD_EP_DB_Receive(PCD_HandleTypeDef *hpcd, PCD_EPTypeDef *ep)
+{
+  uint16_t wEPVal, count, size, pmaadress;
+  
+  wEPVal = PCD_GET_ENDPOINT(hpcd->Instance, ep->num);
+  
+  if (wEPVal & USB_EP_DTOG_RX)
+  {
+    count = PCD_GET_EP_DBUF0_CNT(hpcd->Instance, ep->num);
+    pmaadress = ep->pmaaddr0;
+  }
+  else
+  {
+    count = PCD_GET_EP_DBUF1_CNT(hpcd->Instance, ep->num);
+    pmaadress = ep->pmaaddr1;
+  }
+  
+  if (((wEPVal & USB_EP_DTOG_RX) != 0) == ((wEPVal & USB_EP_DTOG_TX) != 0))
+  {
+    PCD_FreeUserBuffer(hpcd->Instance, ep->num, PCD_EP_DBUF_OUT);
+  }
+  
+  size = (count > ep->xfer_len) ? ep->xfer_len : count;
+  
+  if (size != 0)
+  {
+    USB_ReadPMA(hpcd->Instance, ep->xfer_buff, pmaadress, size);
+  }
+  
+  ep->xfer_len -= size;
+  ep->xfer_count += size;
+  ep->xfer_buff += size;
+  
+  if ((ep->xfer_len == 0) || (count < ep->maxpacket))
+  {
+    /* RX COMPLETE */
+    ep->xfer_active = 0;
+    
+    HAL_PCD_DataOutStageCallback(hpcd, ep->num);
+  }
+}
 #endif /* USB */
 
 /**
@@ -1816,6 +1816,17 @@ HAL_StatusTypeDef USB_ActivateEndpoint(USB_TypeDef *USBx, USB_EPTypeDef *ep)
       /* Reset value of the data toggle bits for the endpoint out*/
       PCD_TX_DTOG(USBx, ep->num);
       
+      if (ep->type == EP_TYPE_BULK)
+      {
+        /* Bulk OUT keeps both buffers at maxpacket and stays VALID. The hardware NAKs
+         * by itself while software owns the buffer it would fill next.
+         */
+        PCD_SET_EP_DBUF_CNT(USBx, ep->num, ep->is_in, ep->maxpacket);
+        
+        ep->xfer_active = 0;
+        ep->xfer_pending = 0;
+      }
+      
       PCD_SET_EP_RX_STATUS(USBx, ep->num, USB_EP_RX_VALID);
       PCD_SET_EP_TX_STATUS(USBx, ep->num, USB_EP_TX_DIS);
     }
@@ -1871,6 +1882,9 @@ HAL_StatusTypeDef USB_DeactivateEndpoint(USB_TypeDef *USBx, USB_EPTypeDef *ep)
       
       PCD_SET_EP_RX_STATUS(USBx, ep->num, USB_EP_RX_DIS);
       PCD_SET_EP_TX_STATUS(USBx, ep->num, USB_EP_TX_DIS);
+      
+      ep->xfer_active = 0;
+      ep->xfer_pending = 0;
     }
     else
     {
@@ -1940,6 +1954,19 @@ HAL_StatusTypeDef USB_EPStartXfer(USB_TypeDef *USBx , USB_EPTypeDef *ep, uint8_t
     
     PCD_SET_EP_TX_STATUS(USBx, ep->num, USB_EP_TX_VALID);
   }
+  else if ((ep->doublebuffer != 0) && (ep->type == EP_TYPE_BULK))
+  {
+    /* Double buffered bulk OUT: "xfer_len" is accounted per packet in PCD_EP_ISR_Handler().
+     * A packet that arrived before the transfer was armed is still in its buffer, so pend
+     * the interrupt to have HAL_PCD_IRQHandler() pick it up.
+     */
+    ep->xfer_active = 1;
+    
+    if (ep->xfer_pending)
+    {
+      NVIC_SetPendingIRQ(USB_IRQn);
+    }
+  }
   else /* OUT endpoint */
   {
     /* Multi packet transfer*/
@@ -1962,8 +1989,8 @@ HAL_StatusTypeDef USB_EPStartXfer(USB_TypeDef *USBx , USB_EPTypeDef *ep, uint8_t
     }
     else
     {
-      /*Set the Double buffer counter*/
-      PCD_SET_EP_DBUF1_CNT(USBx, ep->num, ep->is_in, len);
+      /*Set the Double buffer counters, both are used by isochronous endpoints*/
+      PCD_SET_EP_DBUF_CNT(USBx, ep->num, ep->is_in, len);
     }
     
     PCD_SET_EP_RX_STATUS(USBx, ep->num, USB_EP_RX_VALID);
@@ -2042,6 +2069,15 @@ HAL_StatusTypeDef USB_EPSetStall(USB_TypeDef *USBx , USB_EPTypeDef *ep)
     else
     {
       PCD_SET_EP_RX_STATUS(USBx, ep->num , USB_EP_RX_STALL);
+
+      if ((ep->doublebuffer != 0) && (ep->type == EP_TYPE_BULK) && ep->xfer_pending)
+      {
+        /* Drop the packet that was held back, it belongs to the stalled transfer.
+         */
+        ep->xfer_pending = 0;
+        
+        PCD_FreeUserBuffer(USBx, ep->num, PCD_EP_DBUF_OUT);
+      }
     }
   }
   return HAL_OK;
@@ -41,6 +41,8 @@
 #include "usbd_conf.h"
 #include "usbd_ctlreq.h"
 #include "usbd_webusb.h"
+#include "usbd_audio.h"
+#include "usbd_midi.h"
 
 #include "stm32l4_gpio.h"
 
@@ -49,6 +51,8 @@ extern USBD_CDC_ItfTypeDef const stm32l4_usbd_webusb_interface;
 extern USBD_StorageTypeDef const dosfs_storage_interface;
 extern USBD_HID_ItfTypeDef const stm32l4_usbd_dap_interface;
 extern USBD_HID_ItfTypeDef const stm32l4_usbd_hid_interface;
+extern USBD_AUDIO_ItfTypeDef const stm32l4_usbd_audio_interface;
+extern USBD_MIDI_ItfTypeDef const stm32l4_usbd_midi_interface;
 extern void USBD_Configure(void);
 
 extern const char *USBD_SuffixString;
@@ -112,6 +116,8 @@ static uint8_t  USBD_CDC_MSC_DataOut (USBD_HandleTypeDef *pdev,
 
 static uint8_t  USBD_CDC_MSC_EP0_RxReady (USBD_HandleTypeDef *pdev);
 
+static uint8_t  USBD_CDC_MSC_SOF (USBD_HandleTypeDef *pdev);
+
 static const uint8_t  *USBD_CDC_MSC_GetFSCfgDesc (uint16_t *length);
 
 static const uint8_t  *USBD_CDC_MSC_GetHSCfgDesc (uint16_t *length);
@@ -157,7 +163,7 @@ static const USBD_ClassTypeDef  USBD_CDC_MSC_CLASS =
   USBD_CDC_MSC_EP0_RxReady,
   USBD_CDC_MSC_DataIn,
   USBD_CDC_MSC_DataOut,
-  NULL,
+  USBD_CDC_MSC_SOF,
   NULL,
   NULL,     
   USBD_CDC_MSC_GetHSCfgDesc,  
@@ -176,7 +182,7 @@ static const USBD_ClassTypeDef  USBD_WEBUSB_CLASS_Interface =
   USBD_WEBUSB_DeInit,
   USBD_WEBUSB_Setup,
   NULL,                 /* EP0_TxSent, */
-  NULL,                 /* EP0_RxReady */
+  USBD_WEBUSB_EP0_RxReady, /* EP0_RxReady */
   USBD_WEBUSB_DataIn,
   USBD_WEBUSB_DataOut,
   NULL,
@@ -233,18 +239,66 @@ static const USBD_ClassTypeDef  USBD_HID_CLASS_Interface =
 #endif  
 };
 
+static const USBD_ClassTypeDef  USBD_AUDIO_CLASS_Interface = 
+{
+  USBD_AUDIO_Init,
+  USBD_AUDIO_DeInit,
+  USBD_AUDIO_Setup,
+  NULL,                 /* EP0_TxSent, */
+  USBD_AUDIO_EP0_RxReady, /* EP0_RxReady */
+  USBD_AUDIO_DataIn,
+  USBD_AUDIO_DataOut,
+  USBD_AUDIO_SOF,
+  NULL,
+  NULL,     
+  NULL,
+  NULL,
+  NULL,
+  NULL,
+#if (USBD_SUPPORT_USER_STRING == 1)
+  NULL,
+#endif  
+};
+
+static const USBD_ClassTypeDef  USBD_MIDI_CLASS_Interface = 
+{
+  USBD_MIDI_Init,
+  USBD_MIDI_DeInit,
+  USBD_MIDI_Setup,
+  NULL,                 /* EP0_TxSent, */
+  NULL,                 /* EP0_RxReady */
+  USBD_MIDI_DataIn,
+  USBD_MIDI_DataOut,
+  USBD_MIDI_SOF,
+  NULL,
+  NULL,     
+  NULL,
+  NULL,
+  NULL,
+  NULL,
+#if (USBD_SUPPORT_USER_STRING == 1)
+  NULL,
+#endif  
+};
+
 static const USBD_ClassTypeDef * USBD_MSC_Class_Interface = NULL;
 static const USBD_ClassTypeDef * USBD_HID_Class_Interface = NULL;
 static const USBD_ClassTypeDef * USBD_WEBUSB_Class_Interface = NULL;
+static const USBD_ClassTypeDef * USBD_AUDIO_Class_Interface = NULL;
+static const USBD_ClassTypeDef * USBD_MIDI_Class_Interface = NULL;
 
 static uint16_t USBD_MSC_Interface = 0xffff;
 static uint16_t USBD_HID_Interface = 0xffff;
 static uint16_t USBD_WEBUSB_Interface = 0xffff;
+static uint16_t USBD_AUDIO_Interface = 0xffff;   /* AudioControl, AudioStreaming is the next one */
+static uint16_t USBD_MIDI_Interface = 0xffff;    /* AudioControl, MIDIStreaming is the next one */
 
 #define USB_CDC_CONFIG_DESC_SIZ   (9+8+(9+5+5+4+5+7)+(9+7+7))
 #define USB_MSC_CONFIG_DESC_SIZ   (9+7+7)
 #define USB_HID_CONFIG_DESC_SIZ   (9+9+7+7)
 #define USB_WEBUSB_CONFIG_DESC_SIZ   (9+7+7)
+#define USB_AUDIO_CONFIG_DESC_SIZ   (8+(9+9+12+10+9)+(9+9+7+11+9+7+9))
+#define USB_MIDI_CONFIG_DESC_SIZ    (8+(9+9)+(9+7+6+6+9+9+9+5+9+5))
 #define USB_DUMMY_CONFIG_DESC_SIZ   (9)
 
 #define USB_CDC_INTERFACE_CONTROL 0
@@ -254,6 +308,8 @@ static uint16_t USBD_WEBUSB_Interface = 0xffff;
 #define USB_MSC_INTERFACE_COUNT   1
 #define USB_HID_INTERFACE_COUNT   1
 #define USB_WEBUSB_INTERFACE_COUNT   1
+#define USB_AUDIO_INTERFACE_COUNT   2
+#define USB_MIDI_INTERFACE_COUNT    2
 #define USB_DUMMY_INTERFACE_COUNT   1
 
 #define USB_CDC_MSC_CONFIG_DESC_SIZ      (USB_CDC_CONFIG_DESC_SIZ + USB_DUMMY_CONFIG_DESC_SIZ + USB_MSC_CONFIG_DESC_SIZ)
@@ -261,12 +317,16 @@ static uint16_t USBD_WEBUSB_Interface = 0xffff;
 #define USB_CDC_MSC_HID_CONFIG_DESC_SIZ  (USB_CDC_CONFIG_DESC_SIZ + USB_DUMMY_CONFIG_DESC_SIZ + USB_MSC_CONFIG_DESC_SIZ + USB_HID_CONFIG_DESC_SIZ)
 #define USB_CDC_WEBUSB_CONFIG_DESC_SIZ   (USB_CDC_CONFIG_DESC_SIZ + USB_WEBUSB_CONFIG_DESC_SIZ)
 #define USB_CDC_MSC_WEBUSB_CONFIG_DESC_SIZ  (USB_CDC_CONFIG_DESC_SIZ + USB_WEBUSB_CONFIG_DESC_SIZ + USB_MSC_CONFIG_DESC_SIZ )
+#define USB_CDC_AUDIO_CONFIG_DESC_SIZ    (USB_CDC_CONFIG_DESC_SIZ + USB_DUMMY_CONFIG_DESC_SIZ + USB_AUDIO_CONFIG_DESC_SIZ)
+#define USB_CDC_MIDI_CONFIG_DESC_SIZ     (USB_CDC_CONFIG_DESC_SIZ + USB_DUMMY_CONFIG_DESC_SIZ + USB_MIDI_CONFIG_DESC_SIZ)
 
 #define USB_CDC_MSC_INTERFACE_COUNT      (USB_CDC_INTERFACE_COUNT + USB_DUMMY_CONFIG_INTERFACE_COUNT + USB_MSC_INTERFACE_COUNT)
 #define USB_CDC_HID_INTERFACE_COUNT      (USB_CDC_INTERFACE_COUNT + USB_DUMMY_CONFIG_INTERFACE_COUNT + USB_HID_INTERFACE_COUNT)
 #define USB_CDC_MSC_HID_INTERFACE_COUNT  (USB_CDC_INTERFACE_COUNT + USB_DUMMY_CONFIG_INTERFACE_COUNT + USB_MSC_INTERFACE_COUNT + USB_HID_INTERFACE_COUNT)
 #define USB_CDC_WEBUSB_INTERFACE_COUNT   (USB_CDC_INTERFACE_COUNT + USB_WEBUSB_INTERFACE_COUNT)
 #define USB_CDC_MSC_WEBUSB_INTERFACE_COUNT  (USB_CDC_INTERFACE_COUNT + USB_MSC_INTERFACE_COUNT + USB_WEBUSB_INTERFACE_COUNT)
+#define USB_CDC_AUDIO_INTERFACE_COUNT    (USB_CDC_INTERFACE_COUNT + USB_DUMMY_INTERFACE_COUNT + USB_AUDIO_INTERFACE_COUNT)
+#define USB_CDC_MIDI_INTERFACE_COUNT     (USB_CDC_INTERFACE_COUNT + USB_DUMMY_INTERFACE_COUNT + USB_MIDI_INTERFACE_COUNT)
 
 
 #define USB_WORD(X) LOBYTE(X), HIBYTE(X)
@@ -376,6 +436,233 @@ static uint16_t USBD_WEBUSB_Interface = 0xffff;
   USB_ENDPOINT(WEBUSB_OUT_EP, 0x02, CDC_DATA_FS_MAX_PACKET_SIZE, 0x00)
 
 
+#define USB_WORD3(X) (uint8_t)((X) >> 0), (uint8_t)((X) >> 8), (uint8_t)((X) >> 16)
+
+#define AUDIO_INTERFACES_DATA(INTERFACE_NUM)				\
+  /**** IAD to associate the two AUDIO interfaces ****/		\
+  0x08,                                                        /* bLength */ \
+  0x0b,                                                        /* bDescriptorType */ \
+  INTERFACE_NUM,                                               /* bFirstInterface */ \
+  0x02,                                                        /* bInterfaceCount */ \
+  0x01,                                                        /* bFunctionClass */ \
+  0x00,                                                        /* bFunctionSubClass */ \
+  0x00,                                                        /* bFunctionProtocol */ \
+  0x00,                                                        /* iFunction */ \
+									\
+  /**** AudioControl Interface ****/					\
+  USB_INTERFACE(INTERFACE_NUM, 0x00, 0x01,0x01,0x00, 0x00),		\
+									\
+  /**** AC Header ****/							\
+  0x09,                                                        /* bLength */ \
+  0x24,                                                        /* bDescriptorType */ \
+  0x01,                                                        /* bDescriptorSubtype */	\
+  USB_WORD(0x0100),                                            /* bcdADC */ \
+  USB_WORD((9+12+10+9)),                                       /* wTotalLength */ \
+  0x01,                                                        /* bInCollection */ \
+  INTERFACE_NUM + 1,                                           /* baInterfaceNr */ \
+									\
+  /**** AC Input Terminal (USB streaming) ****/			\
+  0x0c,                                                        /* bLength */ \
+  0x24,                                                        /* bDescriptorType */ \
+  0x02,                                                        /* bDescriptorSubtype */	\
+  AUDIO_INPUT_TERMINAL_ID,                                     /* bTerminalID */ \
+  USB_WORD(0x0101),                                            /* wTerminalType */ \
+  0x00,                                                        /* bAssocTerminal */ \
+  AUDIO_CHANNELS,                                              /* bNrChannels */ \
+  USB_WORD(0x0003),                                            /* wChannelConfig (L, R) */ \
+  0x00,                                                        /* iChannelNames */ \
+  0x00,                                                        /* iTerminal */ \
+									\
+  /**** AC Feature Unit ****/						\
+  0x0a,                                                        /* bLength */ \
+  0x24,                                                        /* bDescriptorType */ \
+  0x06,                                                        /* bDescriptorSubtype */	\
+  AUDIO_FEATURE_UNIT_ID,                                       /* bUnitID */ \
+  AUDIO_INPUT_TERMINAL_ID,                                     /* bSourceID */ \
+  0x01,                                                        /* bControlSize */ \
+  0x03,                                                        /* bmaControls(0) (Mute, Volume) */ \
+  0x00,                                                        /* bmaControls(1) */ \
+  0x00,                                                        /* bmaControls(2) */ \
+  0x00,                                                        /* iFeature */ \
+									\
+  /**** AC Output Terminal (Speaker) ****/				\
+  0x09,                                                        /* bLength */ \
+  0x24,                                                        /* bDescriptorType */ \
+  0x03,                                                        /* bDescriptorSubtype */	\
+  AUDIO_OUTPUT_TERMINAL_ID,                                    /* bTerminalID */ \
+  USB_WORD(0x0301),                                            /* wTerminalType */ \
+  0x00,                                                        /* bAssocTerminal */ \
+  AUDIO_FEATURE_UNIT_ID,                                       /* bSourceID */ \
+  0x00,                                                        /* iTerminal */ \
+									\
+  /**** AudioStreaming Interface, zero bandwidth ****/			\
+  USB_INTERFACE(INTERFACE_NUM + 1, 0x00, 0x01,0x02,0x00, 0x00),	\
+									\
+  /**** AudioStreaming Interface, operational ****/			\
+  0x09,                                                        /* bLength */ \
+  0x04,                                                        /* bDescriptorType */ \
+  INTERFACE_NUM + 1,                                           /* bInterfaceNumber */ \
+  0x01,                                                        /* bAlternateSetting */ \
+  0x02,                                                        /* bNumEndpoints */ \
+  0x01,                                                        /* bInterfaceClass */ \
+  0x02,                                                        /* bInterfaceSubClass */	\
+  0x00,                                                        /* bInterfaceProtocol */	\
+  0x00,                                                        /* iInterface */ \
+									\
+  /**** AS General ****/						\
+  0x07,                                                        /* bLength */ \
+  0x24,                                                        /* bDescriptorType */ \
+  0x01,                                                        /* bDescriptorSubtype */	\
+  AUDIO_INPUT_TERMINAL_ID,                                     /* bTerminalLink */ \
+  0x01,                                                        /* bDelay */ \
+  USB_WORD(0x0001),                                            /* wFormatTag (PCM) */ \
+									\
+  /**** AS Format Type I ****/						\
+  0x0b,                                                        /* bLength */ \
+  0x24,                                                        /* bDescriptorType */ \
+  0x02,                                                        /* bDescriptorSubtype */	\
+  0x01,                                                        /* bFormatType */ \
+  AUDIO_CHANNELS,                                              /* bNrChannels */ \
+  AUDIO_SUBFRAME_SIZE,                                         /* bSubframeSize */ \
+  AUDIO_SUBFRAME_SIZE * 8,                                     /* bBitResolution */ \
+  0x01,                                                        /* bSamFreqType */ \
+  USB_WORD3(AUDIO_SAMPLE_RATE),                                /* tSamFreq */ \
+									\
+  /**** AS Endpoint OUT (isochronous, asynchronous) ****/		\
+  0x09,                                                        /* bLength */ \
+  0x05,                                                        /* bDescriptorType */ \
+  AUDIO_OUT_EP,                                                /* bEndpointAddress */ \
+  0x05,                                                        /* bmAttributes */ \
+  USB_WORD(AUDIO_OUT_PACKET_SIZE),                             /* wMaxPacketSize */ \
+  0x01,                                                        /* bInterval */ \
+  0x00,                                                        /* bRefresh */ \
+  AUDIO_FEEDBACK_EP,                                           /* bSynchAddress */ \
+									\
+  /**** AS Endpoint General ****/					\
+  0x07,                                                        /* bLength */ \
+  0x25,                                                        /* bDescriptorType */ \
+  0x01,                                                        /* bDescriptorSubtype */	\
+  0x00,                                                        /* bmAttributes */ \
+  0x00,                                                        /* bLockDelayUnits */ \
+  USB_WORD(0x0000),                                            /* wLockDelay */ \
+									\
+  /**** AS Endpoint IN (explicit feedback) ****/			\
+  0x09,                                                        /* bLength */ \
+  0x05,                                                        /* bDescriptorType */ \
+  AUDIO_FEEDBACK_EP,                                           /* bEndpointAddress */ \
+  0x11,                                                        /* bmAttributes */ \
+  USB_WORD(AUDIO_FEEDBACK_PACKET_SIZE),                        /* wMaxPacketSize */ \
+  0x01,                                                        /* bInterval */ \
+  AUDIO_FEEDBACK_REFRESH,                                      /* bRefresh */ \
+  0x00                                                         /* bSynchAddress */
+
+
+#define MIDI_INTERFACES_DATA(INTERFACE_NUM)				\
+  /**** IAD to associate the two MIDI interfaces ****/		\
+  0x08,                                                        /* bLength */ \
+  0x0b,                                                        /* bDescriptorType */ \
+  INTERFACE_NUM,                                               /* bFirstInterface */ \
+  0x02,                                                        /* bInterfaceCount */ \
+  0x01,                                                        /* bFunctionClass */ \
+  0x03,                                                        /* bFunctionSubClass */ \
+  0x00,                                                        /* bFunctionProtocol */ \
+  0x00,                                                        /* iFunction */ \
+									\
+  /**** AudioControl Interface ****/					\
+  USB_INTERFACE(INTERFACE_NUM, 0x00, 0x01,0x01,0x00, 0x00),		\
+									\
+  /**** AC Header ****/							\
+  0x09,                                                        /* bLength */ \
+  0x24,                                                        /* bDescriptorType */ \
+  0x01,                                                        /* bDescriptorSubtype */	\
+  USB_WORD(0x0100),                                            /* bcdADC */ \
+  USB_WORD(9),                                                 /* wTotalLength */ \
+  0x01,                                                        /* bInCollection */ \
+  INTERFACE_NUM + 1,                                           /* baInterfaceNr */ \
+									\
+  /**** MIDIStreaming Interface ****/					\
+  USB_INTERFACE(INTERFACE_NUM + 1, 0x02, 0x01,0x03,0x00, 0x00),	\
+									\
+  /**** MS Header ****/							\
+  0x07,                                                        /* bLength */ \
+  0x24,                                                        /* bDescriptorType */ \
+  0x01,                                                        /* bDescriptorSubtype */	\
+  USB_WORD(0x0100),                                            /* bcdMSC */ \
+  USB_WORD((7+6+6+9+9+9+5+9+5)),                               /* wTotalLength */ \
+									\
+  /**** MIDI IN Jack (embedded, host to device) ****/		\
+  0x06,                                                        /* bLength */ \
+  0x24,                                                        /* bDescriptorType */ \
+  0x02,                                                        /* bDescriptorSubtype */	\
+  0x01,                                                        /* bJackType */ \
+  MIDI_JACK_IN_EMBEDDED_ID,                                    /* bJackID */ \
+  0x00,                                                        /* iJack */ \
+									\
+  /**** MIDI IN Jack (external) ****/					\
+  0x06,                                                        /* bLength */ \
+  0x24,                                                        /* bDescriptorType */ \
+  0x02,                                                        /* bDescriptorSubtype */	\
+  0x02,                                                        /* bJackType */ \
+  MIDI_JACK_IN_EXTERNAL_ID,                                    /* bJackID */ \
+  0x00,                                                        /* iJack */ \
+									\
+  /**** MIDI OUT Jack (embedded, device to host) ****/		\
+  0x09,                                                        /* bLength */ \
+  0x24,                                                        /* bDescriptorType */ \
+  0x03,                                                        /* bDescriptorSubtype */	\
+  0x01,                                                        /* bJackType */ \
+  MIDI_JACK_OUT_EMBEDDED_ID,                                   /* bJackID */ \
+  0x01,                                                        /* bNrInputPins */ \
+  MIDI_JACK_IN_EXTERNAL_ID,                                    /* baSourceID */ \
+  0x01,                                                        /* baSourcePin */ \
+  0x00,                                                        /* iJack */ \
+									\
+  /**** MIDI OUT Jack (external) ****/					\
+  0x09,                                                        /* bLength */ \
+  0x24,                                                        /* bDescriptorType */ \
+  0x03,                                                        /* bDescriptorSubtype */	\
+  0x02,                                                        /* bJackType */ \
+  MIDI_JACK_OUT_EXTERNAL_ID,                                   /* bJackID */ \
+  0x01,                                                        /* bNrInputPins */ \
+  MIDI_JACK_IN_EMBEDDED_ID,                                    /* baSourceID */ \
+  0x01,                                                        /* baSourcePin */ \
+  0x00,                                                        /* iJack */ \
+									\
+  /**** MS Endpoint OUT ****/						\
+  0x09,                                                        /* bLength */ \
+  0x05,                                                        /* bDescriptorType */ \
+  MIDI_OUT_EP,                                                 /* bEndpointAddress */ \
+  0x02,                                                        /* bmAttributes */ \
+  USB_WORD(MIDI_PACKET_SIZE),                                  /* wMaxPacketSize */ \
+  0x00,                                                        /* bInterval */ \
+  0x00,                                                        /* bRefresh */ \
+  0x00,                                                        /* bSynchAddress */ \
+									\
+  /**** MS Endpoint OUT (class specific) ****/			\
+  0x05,                                                        /* bLength */ \
+  0x25,                                                        /* bDescriptorType */ \
+  0x01,                                                        /* bDescriptorSubtype */	\
+  0x01,                                                        /* bNumEmbMIDIJack */ \
+  MIDI_JACK_IN_EMBEDDED_ID,                                    /* baAssocJackID */ \
+									\
+  /**** MS Endpoint IN ****/						\
+  0x09,                                                        /* bLength */ \
+  0x05,                                                        /* bDescriptorType */ \
+  MIDI_IN_EP,                                                  /* bEndpointAddress */ \
+  0x02,                                                        /* bmAttributes */ \
+  USB_WORD(MIDI_PACKET_SIZE),                                  /* wMaxPacketSize */ \
+  0x00,                                                        /* bInterval */ \
+  0x00,                                                        /* bRefresh */ \
+  0x00,                                                        /* bSynchAddress */ \
+									\
+  /**** MS Endpoint IN (class specific) ****/			\
+  0x05,                                                        /* bLength */ \
+  0x25,                                                        /* bDescriptorType */ \
+  0x01,                                                        /* bDescriptorSubtype */	\
+  0x01,                                                        /* bNumEmbMIDIJack */ \
+  MIDI_JACK_OUT_EMBEDDED_ID                                    /* baAssocJackID */
+
+
 /* This dummy interface is used to make sure that interface 2 is
  * always webusb a dummy or non-existant. This is helpful on windows
  * as we can use zadig to assign the winusb driver to interface 2
@@ -431,7 +718,7 @@ static const uint8_t USBD_CDC_MSC_ConigurationDescriptor_2[] =
 ct_assert(sizeof(USBD_CDC_MSC_ConigurationDescriptor_2) == USB_CDC_MSC_CONFIG_DESC_SIZ);
 
 
-#define USB_HID_REPORT_DESC_SIZ 101
+#define USB_HID_REPORT_DESC_SIZ 152
 
 static const uint8_t USBD_HID_ReportDescriptor[USB_HID_REPORT_DESC_SIZ] = 
 {
@@ -490,6 +777,33 @@ static const uint8_t USBD_HID_ReportDescriptor[USB_HID_REPORT_DESC_SIZ] =
   0x29, 0x65,                    //   USAGE_MAXIMUM (Keyboard Application)
   0x81, 0x00,                    //   INPUT (Data,Ary,Abs)
   0xc0,                          // END_COLLECTION
+
+  //	Gamepad
+  0x05, 0x01,                    // USAGE_PAGE (Generic Desktop)	// 51
+  0x09, 0x05,                    // USAGE (Game Pad)
+  0xa1, 0x01,                    // COLLECTION (Application)
+  0x85, 0x03,                    //   REPORT_ID (3)
+  0x05, 0x09,                    //   USAGE_PAGE (Button)
+  0x19, 0x01,                    //   USAGE_MINIMUM (Button 1)
+  0x29, 0x20,                    //   USAGE_MAXIMUM (Button 32)
+  0x15, 0x00,                    //   LOGICAL_MINIMUM (0)
+  0x25, 0x01,                    //   LOGICAL_MAXIMUM (1)
+  0x75, 0x01,                    //   REPORT_SIZE (1)
+  0x95, 0x20,                    //   REPORT_COUNT (32)
+  0x81, 0x02,                    //   INPUT (Data,Var,Abs)
+  0x05, 0x01,                    //   USAGE_PAGE (Generic Desktop)
+  0x09, 0x30,                    //   USAGE (X)
+  0x09, 0x31,                    //   USAGE (Y)
+  0x09, 0x32,                    //   USAGE (Z)
+  0x09, 0x33,                    //   USAGE (Rx)
+  0x09, 0x34,                    //   USAGE (Ry)
+  0x09, 0x35,                    //   USAGE (Rz)
+  0x16, 0x01, 0x80,              //   LOGICAL_MINIMUM (-32767)
+  0x26, 0xff, 0x7f,              //   LOGICAL_MAXIMUM (32767)
+  0x75, 0x10,                    //   REPORT_SIZE (16)
+  0x95, 0x06,                    //   REPORT_COUNT (6)
+  0x81, 0x02,                    //   INPUT (Data,Var,Abs)
+  0xc0,                          // END_COLLECTION
 };
 
 ct_assert(sizeof(USBD_HID_ReportDescriptor) == USB_HID_REPORT_DESC_SIZ);
@@ -576,6 +890,26 @@ static const uint8_t USBD_CDC_MSC_WEBUSB_ConigurationDescriptor_8[] =
 
 ct_assert(sizeof(USBD_CDC_MSC_WEBUSB_ConigurationDescriptor_8) == USB_CDC_MSC_WEBUSB_CONFIG_DESC_SIZ);
 
+static const uint8_t USBD_CDC_AUDIO_ConigurationDescriptor_9[] =
+{
+  CONFIG_DESCRIPTOR_DATA(USB_CDC_AUDIO_CONFIG_DESC_SIZ, 5),
+  CDC_INTERFACES_DATA(0),
+  DUMMY_INTERFACE_DATA(2),
+  AUDIO_INTERFACES_DATA(AUDIO_CONTROL_INTERFACE),
+};
+
+ct_assert(sizeof(USBD_CDC_AUDIO_ConigurationDescriptor_9) == USB_CDC_AUDIO_CONFIG_DESC_SIZ);
+
+static const uint8_t USBD_CDC_MIDI_ConigurationDescriptor_10[] =
+{
+  CONFIG_DESCRIPTOR_DATA(USB_CDC_MIDI_CONFIG_DESC_SIZ, 5),
+  CDC_INTERFACES_DATA(0),
+  DUMMY_INTERFACE_DATA(2),
+  MIDI_INTERFACES_DATA(MIDI_CONTROL_INTERFACE),
+};
+
+ct_assert(sizeof(USBD_CDC_MIDI_ConigurationDescriptor_10) == USB_CDC_MIDI_CONFIG_DESC_SIZ);
+
 
 static const uint8_t * USBD_CDC_MSC_ConigurationDescriptorData = NULL;
 static uint16_t USBD_CDC_MSC_ConigurationDescriptorLength = 0;
@@ -605,6 +939,8 @@ static uint8_t  USBD_CDC_MSC_Init (USBD_HandleTypeDef *pdev,
   if (USBD_MSC_Class_Interface) (*USBD_MSC_Class_Interface->Init)(pdev, cfgidx);
   if (USBD_HID_Class_Interface) (*USBD_HID_Class_Interface->Init)(pdev, cfgidx);
   if (USBD_WEBUSB_Class_Interface) (*USBD_WEBUSB_Class_Interface->Init)(pdev, cfgidx);
+  if (USBD_AUDIO_Class_Interface) (*USBD_AUDIO_Class_Interface->Init)(pdev, cfgidx);
+  if (USBD_MIDI_Class_Interface) (*USBD_MIDI_Class_Interface->Init)(pdev, cfgidx);
     
   return USBD_OK;
 }
@@ -622,6 +958,8 @@ static uint8_t  USBD_CDC_MSC_DeInit (USBD_HandleTypeDef *pdev,
   if (USBD_HID_Class_Interface) (*USBD_HID_Class_Interface->DeInit)(pdev, cfgidx);
   if (USBD_MSC_Class_Interface) (*USBD_MSC_Class_Interface->DeInit)(pdev, cfgidx);
   if (USBD_WEBUSB_Class_Interface) (*USBD_WEBUSB_Class_Interface->DeInit)(pdev, cfgidx);
+  if (USBD_AUDIO_Class_Interface) (*USBD_AUDIO_Class_Interface->DeInit)(pdev, cfgidx);
+  if (USBD_MIDI_Class_Interface) (*USBD_MIDI_Class_Interface->DeInit)(pdev, cfgidx);
 
   USBD_CDC_DeInit(pdev, cfgidx);
     
@@ -642,7 +980,21 @@ static uint8_t  USBD_CDC_MSC_Setup (USBD_HandleTypeDef *pdev,
   switch (req->bmRequest & USB_REQ_RECIPIENT_MASK)
     {
     case USB_REQ_RECIPIENT_INTERFACE:
-      if (req->wIndex == USBD_HID_Interface)
+      /* AUDIO has the entity id in the upper byte of wIndex.
+       */
+      if ((LOBYTE(req->wIndex) == USBD_AUDIO_Interface) || (LOBYTE(req->wIndex) == (USBD_AUDIO_Interface +1)))
+	{
+	  if (USBD_AUDIO_Class_Interface) {
+	    return (*USBD_AUDIO_Class_Interface->Setup)(pdev, req);
+	  }
+	}
+      else if ((req->wIndex == USBD_MIDI_Interface) || (req->wIndex == (USBD_MIDI_Interface +1)))
+	{
+	  if (USBD_MIDI_Class_Interface) {
+	    return (*USBD_MIDI_Class_Interface->Setup)(pdev, req);
+	  }
+	}
+      else if (req->wIndex == USBD_HID_Interface)
 	{
 	  if (USBD_HID_Class_Interface) {
 	    return (*USBD_HID_Class_Interface->Setup)(pdev, req);
@@ -666,7 +1018,15 @@ static uint8_t  USBD_CDC_MSC_Setup (USBD_HandleTypeDef *pdev,
 	}
     
     case USB_REQ_RECIPIENT_ENDPOINT:
-      if ((req->wIndex == HID_EPIN_ADDR) || (req->wIndex == HID_EPOUT_ADDR))
+      if (USBD_AUDIO_Class_Interface && ((req->wIndex == AUDIO_OUT_EP) || (req->wIndex == AUDIO_FEEDBACK_EP)))
+	{
+	  return (*USBD_AUDIO_Class_Interface->Setup)(pdev, req);
+	}
+      else if (USBD_MIDI_Class_Interface && ((req->wIndex == MIDI_IN_EP) || (req->wIndex == MIDI_OUT_EP)))
+	{
+	  return (*USBD_MIDI_Class_Interface->Setup)(pdev, req);
+	}
+      else if ((req->wIndex == HID_EPIN_ADDR) || (req->wIndex == HID_EPOUT_ADDR))
 	{
 	  if (USBD_HID_Class_Interface) {
 	    return (*USBD_HID_Class_Interface->Setup)(pdev, req);
@@ -701,7 +1061,15 @@ static uint8_t  USBD_CDC_MSC_Setup (USBD_HandleTypeDef *pdev,
   */
 static uint8_t  USBD_CDC_MSC_DataIn (USBD_HandleTypeDef *pdev, uint8_t epnum)
 {
-  if (epnum == (HID_EPIN_ADDR&~0x80))
+  if (USBD_AUDIO_Class_Interface && (epnum == (AUDIO_FEEDBACK_EP&~0x80)))
+    {
+      return (*USBD_AUDIO_Class_Interface->DataIn)(pdev, epnum);
+    }
+  else if (USBD_MIDI_Class_Interface && (epnum == (MIDI_IN_EP&~0x80)))
+    {
+      return (*USBD_MIDI_Class_Interface->DataIn)(pdev, epnum);
+    }
+  else if (epnum == (HID_EPIN_ADDR&~0x80))
     {
       return (*USBD_HID_Class_Interface->DataIn)(pdev, epnum);
     }
@@ -728,7 +1096,15 @@ static uint8_t  USBD_CDC_MSC_DataIn (USBD_HandleTypeDef *pdev, uint8_t epnum)
   */
 static uint8_t  USBD_CDC_MSC_DataOut (USBD_HandleTypeDef *pdev, uint8_t epnum)
 {      
-  if (epnum == (HID_EPOUT_ADDR&~0x80))
+  if (USBD_AUDIO_Class_Interface && (epnum == AUDIO_OUT_EP))
+    {
+      return (*USBD_AUDIO_Class_Interface->DataOut)(pdev, epnum);
+    }
+  else if (USBD_MIDI_Class_Interface && (epnum == MIDI_OUT_EP))
+    {
+      return (*USBD_MIDI_Class_Interface->DataOut)(pdev, epnum);
+    }
+  else if (epnum == (HID_EPOUT_ADDR&~0x80))
     {
       return (*USBD_HID_Class_Interface->DataOut)(pdev, epnum);
     }
@@ -761,11 +1137,38 @@ static uint8_t  USBD_CDC_MSC_EP0_RxReady (USBD_HandleTypeDef *pdev)
       (*USBD_HID_Class_Interface->EP0_RxReady)(pdev);
   }
 
+  if (USBD_WEBUSB_Class_Interface) {
+      (*USBD_WEBUSB_Class_Interface->EP0_RxReady)(pdev);
+  }
+
+  if (USBD_AUDIO_Class_Interface) {
+      (*USBD_AUDIO_Class_Interface->EP0_RxReady)(pdev);
+  }
+
   USBD_CDC_EP0_RxReady(pdev);
 
   return USBD_OK;
 }
 
+/**
+  * @brief  USBD_CDC_MSC_SOF
+  *         Start of frame
+  * @param  pdev: device instance
+  * @retval status
+  */
+static uint8_t  USBD_CDC_MSC_SOF (USBD_HandleTypeDef *pdev)
+{ 
+  if (USBD_AUDIO_Class_Interface) {
+      (*USBD_AUDIO_Class_Interface->SOF)(pdev);
+  }
+
+  if (USBD_MIDI_Class_Interface) {
+      (*USBD_MIDI_Class_Interface->SOF)(pdev);
+  }
+
+  return USBD_OK;
+}
+
 /**
   * @brief  USBD_CDC_MSC_GetFSCfgDesc 
   *         Return configuration descriptor
@@ -817,6 +1220,14 @@ static const uint8_t  *USBD_CDC_MSC_GetDeviceQualifierDescriptor (uint16_t *leng
   return USBD_CDC_MSC_DeviceQualifierDesc;
 }
 
+/* The USB_CLASS selected by the "USB Type" menu names exactly one of the USBD_*_Initialize()
+ * functions below. Each of them is the only reference to its configuration descriptor, its
+ * class callbacks (USBD_*_CLASS_Interface) and its glue interface, and through those to the
+ * class handles and buffers (MSC bot_data, DAP packets, ...). The composite callbacks above
+ * only dispatch through the USBD_*_Class_Interface pointers. Hence with -ffunction-sections,
+ * -fdata-sections and --gc-sections the classes that are not selected are dropped from the
+ * image. Do not reference any class directly from the composite callbacks.
+ */
 void USBD_CDC_Initialize(USBD_HandleTypeDef *pdev)
 {
   USBD_CDC_MSC_ConigurationDescriptorLength = sizeof(USBD_CDC_MSC_ConigurationDescriptor_1);
@@ -948,6 +1359,32 @@ void USBD_CDC_MSC_WEBUSB_Initialize(USBD_HandleTypeDef *pdev)
   USBD_WEBUSB_RegisterInterface(pdev, &stm32l4_usbd_webusb_interface);
 }
 
+void USBD_CDC_AUDIO_Initialize(USBD_HandleTypeDef *pdev)
+{
+  USBD_CDC_MSC_ConigurationDescriptorLength = sizeof(USBD_CDC_AUDIO_ConigurationDescriptor_9);
+  USBD_CDC_MSC_ConigurationDescriptorData = USBD_CDC_AUDIO_ConigurationDescriptor_9;
+
+  USBD_AUDIO_Class_Interface = &USBD_AUDIO_CLASS_Interface;
+  USBD_AUDIO_Interface = AUDIO_CONTROL_INTERFACE;
+
+  USBD_RegisterClass(pdev, &USBD_CDC_MSC_CLASS);
+  USBD_CDC_RegisterInterface(pdev, &stm32l4_usbd_cdc_interface);
+  USBD_AUDIO_RegisterInterface(pdev, &stm32l4_usbd_audio_interface);
+}
+
+void USBD_CDC_MIDI_Initialize(USBD_HandleTypeDef *pdev)
+{
+  USBD_CDC_MSC_ConigurationDescriptorLength = sizeof(USBD_CDC_MIDI_ConigurationDescriptor_10);
+  USBD_CDC_MSC_ConigurationDescriptorData = USBD_CDC_MIDI_ConigurationDescriptor_10;
+
+  USBD_MIDI_Class_Interface = &USBD_MIDI_CLASS_Interface;
+  USBD_MIDI_Interface = MIDI_CONTROL_INTERFACE;
+
+  USBD_RegisterClass(pdev, &USBD_CDC_MSC_CLASS);
+  USBD_CDC_RegisterInterface(pdev, &stm32l4_usbd_cdc_interface);
+  USBD_MIDI_RegisterInterface(pdev, &stm32l4_usbd_midi_interface);
+}
+
 
 /**
   * @}
@@ -72,6 +72,22 @@ static void (*usbd_sof_callback)(void) = NULL;
 static void (*usbd_suspend_callback)(void) = NULL;
 static void (*usbd_resume_callback)(void) = NULL;
 
+/* SOF time base. Every SOF is timestamped with the DWT cycle counter. Over a window
+ * of USBD_SOF_WINDOW frames the cycles are compared to what SystemCoreClock predicts,
+ * which gives the drift of the local clock against the host in ppb (low pass filtered).
+ * "usbd_sof_period" are the measured cycles per frame (24.8 fixed point).
+ */
+#define USBD_SOF_WINDOW      1024
+#define USBD_SOF_DRIFT_MAX   1000000  /* 1000ppm, anything beyond is a missed SOF or a clock change */
+
+static volatile uint32_t usbd_sof_frames = 0;
+static volatile uint32_t usbd_sof_cycles = 0;
+static uint32_t usbd_sof_window_frames = 0;
+static uint32_t usbd_sof_window_cycles = 0;
+static volatile uint32_t usbd_sof_period = 0;
+static volatile int32_t usbd_sof_drift = 0;
+static volatile bool usbd_sof_valid = false;
+
 /* Private functions ---------------------------------------------------------*/
 
 const uint8_t * USBD_ManufacturerString = NULL;
@@ -171,6 +187,11 @@ void USBD_Initialize(const uint8_t *manufacturer, const uint8_t *product, void(*
 #endif  
 
     armv7m_timer_create(&USBD_VBUSTimer, (armv7m_timer_callback_t)USBD_VBUSCallback);
+
+    /* The SOF time base needs the cycle counter.
+     */
+    CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+    DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
 }
 
 void USBD_Attach(void)
@@ -260,6 +281,95 @@ bool USBD_Suspended(void)
     return (USBD_Device.dev_state == USBD_STATE_SUSPENDED);
 }
 
+uint32_t USBD_FrameCount(void)
+{
+    return usbd_sof_frames;
+}
+
+int32_t USBD_ClockDrift(void)
+{
+    return usbd_sof_drift;
+}
+
+/* Microseconds in host time, i.e. 1000 per SOF, interpolated between SOFs with the
+ * measured frame period. Before a first estimate is available SystemCoreClock is used.
+ */
+uint64_t USBD_HostMicros(void)
+{
+    uint32_t frames, cycles, period, delta;
+
+    do
+    {
+	frames = usbd_sof_frames;
+	cycles = usbd_sof_cycles;
+	period = usbd_sof_period;
+    }
+    while (frames != usbd_sof_frames);
+
+    if (!period)
+    {
+	period = (SystemCoreClock / 1000) << 8;
+    }
+
+    delta = (uint32_t)((((uint64_t)(DWT->CYCCNT - cycles) << 8) * 1000) / period);
+
+    if (delta > 999)
+    {
+	delta = 999;
+    }
+
+    return ((uint64_t)frames * 1000) + delta;
+}
+
+static void USBD_SOFTimestamp(void)
+{
+    uint32_t cycles, elapsed, expected;
+    int32_t drift;
+
+    cycles = DWT->CYCCNT;
+
+    /* A gap of more than 2 frames (suspend, or a delayed interrupt) restarts the window.
+     */
+    if (!usbd_sof_valid || ((cycles - usbd_sof_cycles) > ((SystemCoreClock / 1000) * 2)))
+    {
+	usbd_sof_window_frames = 0;
+	usbd_sof_window_cycles = cycles;
+	usbd_sof_valid = true;
+    }
+    else
+    {
+	usbd_sof_window_frames++;
+
+	if (usbd_sof_window_frames == USBD_SOF_WINDOW)
+	{
+	    elapsed = cycles - usbd_sof_window_cycles;
+	    expected = (SystemCoreClock / 1000) * USBD_SOF_WINDOW;
+
+	    drift = (int32_t)((((int64_t)elapsed - (int64_t)expected) * 1000000000) / expected);
+
+	    if ((drift < USBD_SOF_DRIFT_MAX) && (drift > -USBD_SOF_DRIFT_MAX))
+	    {
+		if (!usbd_sof_period)
+		{
+		    usbd_sof_drift = drift;
+		}
+		else
+		{
+		    usbd_sof_drift += ((drift - usbd_sof_drift) / 8);
+		}
+
+		usbd_sof_period = (uint32_t)(((uint64_t)elapsed << 8) / USBD_SOF_WINDOW);
+	    }
+
+	    usbd_sof_window_frames = 0;
+	    usbd_sof_window_cycles = cycles;
+	}
+    }
+
+    usbd_sof_cycles = cycles;
+    usbd_sof_frames++;
+}
+
 void USBD_RegisterCallbacks(void(*sof_callback)(void), void(*suspend_callback)(void), void(*resume_callback)(void))
 {
     usbd_sof_callback = sof_callback;
@@ -277,7 +387,11 @@ void OTG_FS_IRQHandler(void)
 void USB_IRQHandler(void)
 #endif
 {
+    ARMV7M_TRACE_EVENT(ARMV7M_TRACE_USB_ENTER, 0);
+
     if (USBD_IRQHandler) { (*USBD_IRQHandler)(&hpcd); }
+
+    ARMV7M_TRACE_EVENT(ARMV7M_TRACE_USB_LEAVE, 0);
 }
 
 /**
@@ -422,6 +536,7 @@ void HAL_PCD_DataInStageCallback(PCD_HandleTypeDef *hpcd, uint8_t epnum)
 void HAL_PCD_SOFCallback(PCD_HandleTypeDef *hpcd)
 {
   usbd_sof_countdown = 10;
+  USBD_SOFTimestamp();
   USBD_LL_SOF(hpcd->pData);
 
   if (usbd_sof_callback) {
@@ -533,12 +648,12 @@ USBD_StatusTypeDef USBD_LL_Init(USBD_HandleTypeDef *pdev)
   /* FIFO size in 32 bit entries, total of 320 (1.25kb) available.
    */
 
-  HAL_PCDEx_SetRxFiFo(&hpcd, 0x40);    /* 256 bytes shared receive        */
+  HAL_PCDEx_SetRxFiFo(&hpcd, 0x5c);    /* 368 bytes shared receive        */
   HAL_PCDEx_SetTxFiFo(&hpcd, 0, 0x20); /* 128 bytes EP0/control transmit  */
   HAL_PCDEx_SetTxFiFo(&hpcd, 1, 0x04); /*  16 bytes EP1/CDC/CTRL transmit */
   HAL_PCDEx_SetTxFiFo(&hpcd, 2, 0x20); /* 128 bytes EP2/CDC/DATA transmit */
   HAL_PCDEx_SetTxFiFo(&hpcd, 3, 0x80); /* 512 bytes EP3/MSC transmit      */ 
-  HAL_PCDEx_SetTxFiFo(&hpcd, 4, 0x10); /*  64 bytes EP4/HID transmit      */
+  HAL_PCDEx_SetTxFiFo(&hpcd, 4, 0x10); /*  64 bytes EP4/HID/AUDIO transmit */
   HAL_PCDEx_SetTxFiFo(&hpcd, 5, 0x10); /*  64 bytes EP4/WEBUSB transmit      */
 
 #else /* defined(STM32L476xx) || defined(STM32L496xx) */
@@ -565,9 +680,9 @@ USBD_StatusTypeDef USBD_LL_Init(USBD_HandleTypeDef *pdev)
   HAL_PCDEx_PMAConfig(&hpcd, 0x80, PCD_SNG_BUF, 0x070); /*  64 bytes EP0/control in   */
   HAL_PCDEx_PMAConfig(&hpcd, 0x81, PCD_SNG_BUF, 0x0b0); /*  16 bytes EP1/CDC/CTRL in  */
   HAL_PCDEx_PMAConfig(&hpcd, 0x82, PCD_SNG_BUF, 0x0c0); /*  64 bytes EP2/CDC/DATA in  */
-  HAL_PCDEx_PMAConfig(&hpcd, 0x02, PCD_SNG_BUF, 0x100); /*  64 bytes EP2/CDC/DATA out */
+  HAL_PCDEx_PMAConfig(&hpcd, 0x02, PCD_SNG_BUF, 0x100); /*  64 bytes EP2/CDC/DATA out, 2nd buffer at 0x390 */
   HAL_PCDEx_PMAConfig(&hpcd, 0x83, PCD_SNG_BUF, 0x140); /*  64 bytes EP3/MSC in       */ 
-  HAL_PCDEx_PMAConfig(&hpcd ,0x03, PCD_SNG_BUF, 0x180); /*  64 bytes EP3/MSC out      */ 
+  HAL_PCDEx_PMAConfig(&hpcd ,0x03, PCD_SNG_BUF, 0x180); /*  64 bytes EP3/MSC out, 2nd buffer at 0x2c0 */
   HAL_PCDEx_PMAConfig(&hpcd, 0x84, PCD_SNG_BUF, 0x1c0); /*  64 bytes EP4/HID in       */ 
   HAL_PCDEx_PMAConfig(&hpcd ,0x04, PCD_SNG_BUF, 0x200); /*  64 bytes EP4/HID out      */ 
   HAL_PCDEx_PMAConfig(&hpcd, 0x85, PCD_SNG_BUF, 0x240); /*  64 bytes EP5/HID in       */ 
@@ -655,6 +770,55 @@ USBD_StatusTypeDef USBD_LL_FlushEP(USBD_HandleTypeDef *pdev, uint8_t ep_addr)
   return USBD_OK;
 }
 
+/**
+  * @brief  Switches an endpoint to double buffering, which the USB FS device needs
+  *         for isochronous endpoints. Bulk OUT endpoints use it so that the host can
+  *         send the next packet while the previous one is processed (bulk IN stays
+  *         single buffered). Has to be called before USBD_LL_OpenEP().
+  *         The OTG FS core has no packet memory to configure.
+  * @param  pdev: Device handle
+  * @param  ep_addr: Endpoint Number
+  * @param  pma0: packet memory offset of buffer 0
+  * @param  pma1: packet memory offset of buffer 1
+  * @retval USBD Status
+  */
+USBD_StatusTypeDef USBD_LL_DoubleBufferEP(USBD_HandleTypeDef *pdev, uint8_t ep_addr, uint16_t pma0, uint16_t pma1)
+{
+#if !defined(STM32L476xx) && !defined(STM32L496xx)
+  HAL_PCDEx_PMAConfig(pdev->pData, ep_addr, PCD_DBL_BUF, ((uint32_t)pma1 << 16) | pma0);
+#endif
+  return USBD_OK;
+}
+
+/**
+  * @brief  Moves a pending isochronous IN transfer to the next (micro)frame. The OTG FS
+  *         core only sends it in frames of the parity it was started in, so a host
+  *         polling every 2^N frames may never pick it up otherwise. The USB FS device
+  *         sends it whenever the host polls.
+  * @param  pdev: Device handle
+  * @param  ep_addr: Endpoint Number
+  * @retval USBD Status
+  */
+USBD_StatusTypeDef USBD_LL_RetargetEP(USBD_HandleTypeDef *pdev, uint8_t ep_addr)
+{
+#if defined(STM32L476xx) || defined(STM32L496xx)
+  USB_OTG_GlobalTypeDef *USBx = ((PCD_HandleTypeDef*)pdev->pData)->Instance;
+
+  if (USBx_INEP(ep_addr & 0x7f)->DIEPCTL & USB_OTG_DIEPCTL_EPENA)
+  {
+    if ((USBx_DEVICE->DSTS & ( 1 << 8 )) == 0)
+    {
+      USBx_INEP(ep_addr & 0x7f)->DIEPCTL |= USB_OTG_DIEPCTL_SODDFRM;
+    }
+    else
+    {
+      USBx_INEP(ep_addr & 0x7f)->DIEPCTL |= USB_OTG_DIEPCTL_SD0PID_SEVNFRM;
+    }
+  }
+#endif
+  return USBD_OK;
+}
+
 /**
   * @brief  Sets a Stall condition on an endpoint of the Low Level Driver.
   * @param  pdev: Device handle
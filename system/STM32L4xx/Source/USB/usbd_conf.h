@@ -58,7 +58,7 @@
 /* Exported types ------------------------------------------------------------*/
 /* Exported constants --------------------------------------------------------*/
 /* Common Config */
-#define USBD_MAX_NUM_INTERFACES               3
+#define USBD_MAX_NUM_INTERFACES               5
 #define USBD_MAX_NUM_CONFIGURATION            1
 #define USBD_MAX_STR_DESC_SIZ                 0x100
 #define USBD_SUPPORT_USER_STRING              1 
@@ -66,7 +66,7 @@
 #define USBD_DEBUG_LEVEL                      0
 
 /* MSC Class Config */
-#define MSC_MEDIA_PACKET                      512
+#define MSC_MEDIA_PACKET                      2048 /* per half of the SCSI READ/WRITE double buffer */
 
 /* Exported macro ------------------------------------------------------------*/
 /* Memory management macros */   
@@ -26,6 +26,8 @@
  * WITH THE SOFTWARE.
  */
 
+#include <stddef.h>
+
 #include "armv7m.h"
 
 #include "stm32l476xx.h"
@@ -33,10 +35,14 @@
 typedef struct _armv7m_core_control_t {
     uint32_t               clock;
     uint32_t               scale;
+    volatile uint32_t      fpu_pending;
+    volatile uint32_t      fpu_saves;
 } armv7m_core_control_t;
 
 static armv7m_core_control_t armv7m_core_control;
 
+void (* volatile armv7m_core_yield_callback)(bool wait) = NULL;
+
 int armv7m_core_priority(void)
 {
     uint32_t ipsr, faultmask, primask;
@@ -114,3 +120,155 @@ void armv7m_core_udelay(uint32_t delay)
 			 "   bne  1b     \n"
 			 : "+r" (n));
 }
+
+void armv7m_core_fpu_configure(unsigned int mode)
+{
+    uint32_t fpccr;
+
+    fpccr = FPU->FPCCR & ~(FPU_FPCCR_ASPEN_Msk | FPU_FPCCR_LSPEN_Msk);
+
+    switch (mode) {
+    case ARMV7M_CORE_FPU_MODE_LAZY:
+	fpccr |= (FPU_FPCCR_ASPEN_Msk | FPU_FPCCR_LSPEN_Msk);
+	break;
+
+    case ARMV7M_CORE_FPU_MODE_EAGER:
+	fpccr |= FPU_FPCCR_ASPEN_Msk;
+	break;
+
+    case ARMV7M_CORE_FPU_MODE_NONE:
+    default:
+	break;
+    }
+
+    FPU->FPCCR = fpccr;
+
+    /* Without ASPEN nothing clears CONTROL.FPCA anymore, so drop the current FP context
+     * explicitly. Otherwise every exception entry would keep on stacking it.
+     */
+    if (!(fpccr & FPU_FPCCR_ASPEN_Msk) && (__get_IPSR() == 0))
+    {
+	__set_CONTROL(__get_CONTROL() & ~CONTROL_FPCA_Msk);
+    }
+
+    __DSB();
+    __ISB();
+}
+
+uint32_t armv7m_core_fpu_enter(void)
+{
+    return (FPU->FPCCR & FPU_FPCCR_LSPACT_Msk);
+}
+
+void armv7m_core_fpu_leave(uint32_t state)
+{
+    if (state)
+    {
+	armv7m_atomic_add(&armv7m_core_control.fpu_pending, 1);
+
+	if (!(FPU->FPCCR & FPU_FPCCR_LSPACT_Msk))
+	{
+	    armv7m_atomic_add(&armv7m_core_control.fpu_saves, 1);
+	}
+    }
+}
+
+void armv7m_core_fpu_statistics(uint32_t *p_pending_return, uint32_t *p_saves_return)
+{
+    if (p_pending_return)
+    {
+	*p_pending_return = armv7m_core_control.fpu_pending;
+    }
+
+    if (p_saves_return)
+    {
+	*p_saves_return = armv7m_core_control.fpu_saves;
+    }
+}
+
+extern uint32_t __HeapBase[];
+extern uint32_t __StackLimit[];
+extern uint32_t __StackTop[];
+extern void *__HeapCurrent;
+extern void *__HeapPeak;
+
+/* Provided by the core's allocator (STM32L4_HEAP=1), which does not track usage via the break.
+ */
+extern bool stm32l4_heap_usage(uint32_t *p_used_return, uint32_t *p_peak_return) __attribute__((weak));
+
+bool armv7m_core_stack_statistics(uint32_t *p_size_return, uint32_t *p_used_return)
+{
+    uint32_t *stack;
+
+    for (stack = &__StackLimit[0]; stack < &__StackTop[0]; stack++)
+    {
+	if (*stack != ARMV7M_CORE_STACK_FILL)
+	{
+	    break;
+	}
+    }
+
+    if (p_size_return)
+    {
+	*p_size_return = (uint32_t)&__StackTop[0] - (uint32_t)&__StackLimit[0];
+    }
+
+    if (p_used_return)
+    {
+	*p_used_return = (uint32_t)&__StackTop[0] - (uint32_t)stack;
+    }
+
+    return (stack != &__StackLimit[0]);
+}
+
+void armv7m_core_heap_statistics(uint32_t *p_size_return, uint32_t *p_used_return, uint32_t *p_peak_return)
+{
+    uint32_t used, peak;
+
+    if (!stm32l4_heap_usage || !stm32l4_heap_usage(&used, &peak))
+    {
+	used = (uint32_t)__HeapCurrent - (uint32_t)&__HeapBase[0];
+	peak = (uint32_t)__HeapPeak - (uint32_t)&__HeapBase[0];
+    }
+
+    if (p_size_return)
+    {
+	*p_size_return = (uint32_t)&__StackLimit[0] - (uint32_t)&__HeapBase[0];
+    }
+
+    if (p_used_return)
+    {
+	*p_used_return = used;
+    }
+
+    if (p_peak_return)
+    {
+	*p_peak_return = peak;
+    }
+}
+
+/* The guard uses the highest MPU region, so that it takes precedence should other regions
+ * get added. PRIVDEFENA keeps the default memory map for everything else, and without
+ * HFNMIENA the HardFault handler does not see the MPU, so it can still capture a fault
+ * that was raised while stacking into the guard.
+ */
+void armv7m_core_stack_guard(bool enable)
+{
+    MPU->RNR = 7;
+
+    if (enable)
+    {
+	MPU->RBAR = ((uint32_t)&__StackLimit[0] + 31) & ~31;
+	MPU->RASR = MPU_RASR_XN_Msk | (0 << MPU_RASR_AP_Pos) | (4 << MPU_RASR_SIZE_Pos) | MPU_RASR_ENABLE_Msk;
+	MPU->CTRL = MPU_CTRL_PRIVDEFENA_Msk | MPU_CTRL_ENABLE_Msk;
+
+	SCB->SHCSR |= SCB_SHCSR_MEMFAULTENA_Msk;
+    }
+    else
+    {
+	MPU->RASR = 0;
+    }
+
+    __DSB();
+    __ISB();
+}
@@ -32,88 +32,268 @@
 
 #include "stm32l4_nvic.h"
 
+/* Each priority lane is a bounded lock-free MPSC ring. Producers (threads and
+ * interrupt handlers at any priority) claim a slot by advancing "head" with a
+ * CAS, fill it in, and then publish it by setting its "sequence" to the
+ * claimed position + 1. The consumer (PendSV, which runs at the lowest
+ * priority) only takes an entry once it has been published, and hands it back
+ * by setting "sequence" to position + ARMV7M_PENDSV_ENTRY_COUNT. Hence no
+ * global interrupt masking is needed anywhere.
+ */
+
 typedef struct _armv7m_pendsv_entry_t {
     armv7m_pendsv_routine_t          routine;
     void                             *context;
     uint32_t                         data;
+    volatile uint32_t                sequence;
 } armv7m_pendsv_entry_t;
 
+typedef struct _armv7m_pendsv_lane_t {
+    volatile uint32_t                head;
+    volatile uint32_t                tail;
+    volatile uint32_t                dropped;
+    volatile uint32_t                watermark;
+    armv7m_pendsv_entry_t            entries[ARMV7M_PENDSV_ENTRY_COUNT];
+} armv7m_pendsv_lane_t;
+
 typedef struct _armv7m_pendsv_control_t {
-    volatile armv7m_pendsv_entry_t   *pendsv_read;
-    volatile armv7m_pendsv_entry_t   *pendsv_write;
-    armv7m_pendsv_entry_t            pendsv_data[ARMV7M_PENDSV_ENTRY_COUNT];
+    armv7m_pendsv_lane_t             lanes[ARMV7M_PENDSV_PRIORITY_COUNT];
 } armv7m_pendsv_control_t;
 
 static armv7m_pendsv_control_t armv7m_pendsv_control;
 
-volatile armv7m_pendsv_routine_t * armv7m_pendsv_enqueue(armv7m_pendsv_routine_t routine, void *context, uint32_t data)
+volatile armv7m_pendsv_routine_t * armv7m_pendsv_enqueue_priority(unsigned int priority, armv7m_pendsv_routine_t routine, void *context, uint32_t data)
 {
-    volatile armv7m_pendsv_entry_t *pendsv_write, *pendsv_write_next;
+    armv7m_pendsv_lane_t *lane;
+    armv7m_pendsv_entry_t *entry;
+    uint32_t head, level, watermark;
+    int32_t delta;
 
-    __asm__ volatile ("cpsid i" : : : "memory");
-    do
+    if (priority >= ARMV7M_PENDSV_PRIORITY_COUNT)
     {
-        pendsv_write = armv7m_pendsv_control.pendsv_write;
-	pendsv_write_next = pendsv_write + 1;
+	priority = ARMV7M_PENDSV_PRIORITY_COUNT -1;
+    }
+
+    lane = &armv7m_pendsv_control.lanes[priority];
 
-	if (pendsv_write_next == &armv7m_pendsv_control.pendsv_data[ARMV7M_PENDSV_ENTRY_COUNT])
+    head = lane->head;
+
+    while (1)
+    {
+	entry = &lane->entries[head & (ARMV7M_PENDSV_ENTRY_COUNT -1)];
+
+	delta = (int32_t)(entry->sequence - head);
+
+	if (delta == 0)
 	{
-	    pendsv_write_next = &armv7m_pendsv_control.pendsv_data[0];
+	    /* On failure "head" gets reloaded with the current value.
+	     */
+	    if (armv7m_atomic_compare_exchange(&lane->head, &head, head + 1))
+	    {
+		break;
+	    }
 	}
-
-	if (pendsv_write_next == armv7m_pendsv_control.pendsv_read)
+	else if (delta < 0)
 	{
-            __asm__ volatile ("cpsie i" : : : "memory");
+	    /* The slot has not been handed back by the consumer yet, i.e. the lane is full.
+	     */
+	    armv7m_atomic_add(&lane->dropped, 1);
+
 	    return NULL;
 	}
+	else
+	{
+	    head = lane->head;
+	}
     }
-    while (!armv7m_atomic_compare_exchange((volatile uint32_t*)&armv7m_pendsv_control.pendsv_write, (uint32_t*)&pendsv_write, (uint32_t)pendsv_write_next));
 
-    pendsv_write->routine = routine;
-    pendsv_write->context = context;
-    pendsv_write->data = data;
-    __asm__ volatile ("cpsie i" : : : "memory");
+    entry->routine = routine;
+    entry->context = context;
+    entry->data = data;
+
+    __DMB();
+
+    entry->sequence = head + 1;
+
+    level = (head + 1) - lane->tail;
+    watermark = lane->watermark;
+
+    while ((level > watermark) && !armv7m_atomic_compare_exchange(&lane->watermark, &watermark, level))
+    {
+    }
 
     SCB->ICSR = SCB_ICSR_PENDSVSET_Msk;
 
-    return &pendsv_write->routine;
+    return &entry->routine;
+}
+
+volatile armv7m_pendsv_routine_t * armv7m_pendsv_enqueue(armv7m_pendsv_routine_t routine, void *context, uint32_t data)
+{
+    return armv7m_pendsv_enqueue_priority(ARMV7M_PENDSV_PRIORITY_LOW, routine, context, data);
+}
+
+static void armv7m_pendsv_job_dispatch(void *context, uint32_t data)
+{
+    armv7m_pendsv_job_t *job = (armv7m_pendsv_job_t*)context;
+    armv7m_pendsv_routine_t routine;
+
+    /* Clear "pending" first, so that a post racing with the exchange below gets queued
+     * again rather than lost.
+     */
+    job->pending = 0;
+
+    __DMB();
+
+    data = armv7m_atomic_exchange(&job->data, 0);
+
+    /* The owner may have cleared the routine (e.g. onReceive(NULL)) while a post was
+     * still queued. Such a post is dropped.
+     */
+    routine = job->routine;
+
+    if (routine)
+    {
+	(*routine)(job->context, data);
+    }
+}
+
+void armv7m_pendsv_job_create(armv7m_pendsv_job_t *job, armv7m_pendsv_routine_t routine, void *context, unsigned int priority)
+{
+    job->routine = routine;
+    job->context = context;
+    job->priority = priority;
+    job->pending = 0;
+    job->data = 0;
+}
+
+bool armv7m_pendsv_job_post(armv7m_pendsv_job_t *job, uint32_t data)
+{
+    if (data)
+    {
+	armv7m_atomic_or(&job->data, data);
+    }
+
+    if (armv7m_atomic_exchange(&job->pending, 1))
+    {
+	/* Coalesced with the request already queued.
+	 */
+	return true;
+    }
+
+    if (!armv7m_pendsv_enqueue_priority(job->priority, armv7m_pendsv_job_dispatch, (void*)job, 0))
+    {
+	job->pending = 0;
+
+	return false;
+    }
+
+    return true;
+}
+
+void armv7m_pendsv_statistics(unsigned int priority, uint32_t *p_dropped_return, uint32_t *p_watermark_return)
+{
+    armv7m_pendsv_lane_t *lane;
+
+    if (priority >= ARMV7M_PENDSV_PRIORITY_COUNT)
+    {
+	priority = ARMV7M_PENDSV_PRIORITY_COUNT -1;
+    }
+
+    lane = &armv7m_pendsv_control.lanes[priority];
+
+    if (p_dropped_return)
+    {
+	*p_dropped_return = lane->dropped;
+    }
+
+    if (p_watermark_return)
+    {
+	*p_watermark_return = lane->watermark;
+    }
 }
 
 static __attribute__((used)) void armv7m_pendsv_dequeue(void)
 {
-    volatile armv7m_pendsv_entry_t *pendsv_read;
+    armv7m_pendsv_lane_t *lane;
+    armv7m_pendsv_entry_t *entry;
     armv7m_pendsv_routine_t routine;
     void *context;
-    uint32_t data;
+    uint32_t data, tail, priority;
+#if (ARMV7M_CORE_FPU_STATISTICS == 1)
+    uint32_t fpu_state;
+#endif /* ARMV7M_CORE_FPU_STATISTICS == 1 */
 
-    pendsv_read = armv7m_pendsv_control.pendsv_read;
+    priority = 0;
 
-    while (pendsv_read != armv7m_pendsv_control.pendsv_write)
+    while (priority < ARMV7M_PENDSV_PRIORITY_COUNT)
     {
-        __asm__ volatile ("cpsid i" : : : "memory");
-	routine = pendsv_read->routine;
-	context = pendsv_read->context;
-	data = pendsv_read->data;
+	lane = &armv7m_pendsv_control.lanes[priority];
 
-	pendsv_read = pendsv_read + 1;
+	tail = lane->tail;
+	entry = &lane->entries[tail & (ARMV7M_PENDSV_ENTRY_COUNT -1)];
 
-	if (pendsv_read == &armv7m_pendsv_control.pendsv_data[ARMV7M_PENDSV_ENTRY_COUNT])
+	if (entry->sequence != (tail + 1))
 	{
-	    pendsv_read = &armv7m_pendsv_control.pendsv_data[0];
+	    /* Either empty, or the next entry is claimed but not yet published. In the latter
+	     * case the producer pends PendSV again once it's done.
+	     */
+	    priority++;
+
+	    continue;
 	}
 
-	armv7m_pendsv_control.pendsv_read = pendsv_read;
-	__asm__ volatile ("cpsie i" : : : "memory");
+	__DMB();
+
+	routine = entry->routine;
+	context = entry->context;
+	data = entry->data;
+
+	__DMB();
+
+	entry->sequence = tail + ARMV7M_PENDSV_ENTRY_COUNT;
+
+	lane->tail = tail + 1;
+
+#if (ARMV7M_CORE_FPU_STATISTICS == 1)
+	fpu_state = armv7m_core_fpu_enter();
+#endif /* ARMV7M_CORE_FPU_STATISTICS == 1 */
+
+	ARMV7M_TRACE_EVENT(ARMV7M_TRACE_PENDSV_ENTER, routine);
 
 	(*routine)(context, data);
+
+	ARMV7M_TRACE_EVENT(ARMV7M_TRACE_PENDSV_LEAVE, 0);
+
+#if (ARMV7M_CORE_FPU_STATISTICS == 1)
+	armv7m_core_fpu_leave(fpu_state);
+#endif /* ARMV7M_CORE_FPU_STATISTICS == 1 */
+
+	/* Higher priority work queued by "routine" or an interrupt handler is served first.
+	 */
+	priority = 0;
     }
 }
 
 
 void armv7m_pendsv_initialize(void)
 {
-    armv7m_pendsv_control.pendsv_read = &armv7m_pendsv_control.pendsv_data[0];
-    armv7m_pendsv_control.pendsv_write = &armv7m_pendsv_control.pendsv_data[0];
+    armv7m_pendsv_lane_t *lane;
+    uint32_t priority, index;
+
+    for (priority = 0; priority < ARMV7M_PENDSV_PRIORITY_COUNT; priority++)
+    {
+	lane = &armv7m_pendsv_control.lanes[priority];
+
+	lane->head = 0;
+	lane->tail = 0;
+	lane->dropped = 0;
+	lane->watermark = 0;
+
+	for (index = 0; index < ARMV7M_PENDSV_ENTRY_COUNT; index++)
+	{
+	    lane->entries[index].sequence = index;
+	}
+    }
 
     NVIC_SetPriority(PendSV_IRQn, ((1 << __NVIC_PRIO_BITS) -1));
 }
@@ -41,6 +41,7 @@ typedef struct _armv7m_systick_control_t {
     uint32_t                  frac;
     uint32_t                  accum;
     uint32_t                  scale;
+    uint32_t                  rscale;
     armv7m_systick_callback_t callback;
     void                      *context;
 } armv7m_systick_control_t;
@@ -69,6 +70,20 @@ uint64_t armv7m_systick_micros(void)
     return micros;
 }
 
+uint32_t armv7m_systick_cycles_to_micros(uint32_t cycles)
+{
+    return (uint32_t)(((uint64_t)cycles * (uint64_t)armv7m_systick_control.scale) >> 22);
+}
+
+uint32_t armv7m_systick_micros_to_cycles(uint32_t micros)
+{
+    uint64_t cycles;
+
+    cycles = ((uint64_t)micros * (uint64_t)armv7m_systick_control.rscale) >> 22;
+
+    return ((cycles >> 32) ? 0xffffffff : (uint32_t)cycles);
+}
+
 void armv7m_systick_delay(uint32_t delay)
 {
     uint64_t millis;
@@ -94,6 +109,9 @@ void armv7m_systick_initialize(unsigned int priority)
     NVIC_SetPriority(SysTick_IRQn, priority);
 
     SysTick->CTRL |= SysTick_CTRL_TICKINT_Msk;
+
+    CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+    DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
 }
 
 void armv7m_systick_enable(void)
@@ -120,6 +138,11 @@ void armv7m_systick_enable(void)
 	 * this is post diveded by 2^22. That ensures proper scaling.
 	 */
 	armv7m_systick_control.scale = (uint64_t)4194304000000ull / (uint64_t)armv7m_systick_control.clock;
+
+	/* Same 2^22 fixed point for the inverse, cycles per microsecond, used by
+	 * armv7m_systick_micros_to_cycles().
+	 */
+	armv7m_systick_control.rscale = ((uint64_t)armv7m_systick_control.clock * 4194304ull) / 1000000ull;
     }
     else
     {
@@ -132,6 +155,24 @@ void armv7m_systick_disable(void)
     SysTick->CTRL &= ~SysTick_CTRL_ENABLE_Msk;
 }
 
+/* Account for "millis" that passed while SysTick was disabled (i.e. in STOP mode), so
+ * that neither the time base nor the armv7m_timer deadlines drop those ticks. The callback
+ * catches up in one call, which coalesces all timers that expired in the meantime.
+ */
+void armv7m_systick_advance(uint32_t millis)
+{
+    if (millis)
+    {
+	armv7m_systick_control.micros += ((uint64_t)millis * 1000);
+	armv7m_systick_control.millis += millis;
+
+	if (armv7m_systick_control.callback) 
+	{
+	    armv7m_pendsv_enqueue((armv7m_pendsv_routine_t)armv7m_systick_control.callback, armv7m_systick_control.context, (uint32_t)armv7m_systick_control.millis);
+	}
+    }
+}
+
 void SysTick_Handler(void)
 {
     armv7m_systick_control.micros += 1000;
@@ -32,52 +32,63 @@
 
 #include "stm32l476xx.h"
 
-typedef struct _armv7m_timer_control_t {
+/* Pending timers are kept in a hashed timing wheel. A timer expiring at "deadline"
+ * milliseconds lives in bucket "deadline & (ARMV7M_TIMER_WHEEL_SIZE -1)", so start
+ * and stop are O(1). Each millisecond only the current bucket is visited, and timers
+ * that are one or more wheel turns out simply stay put until their deadline matches.
+ */
+
+typedef struct _armv7m_timer_bucket_t {
     struct _armv7m_timer_t *next;
     struct _armv7m_timer_t *previous;
+} armv7m_timer_bucket_t;
+
+typedef struct _armv7m_timer_control_t {
     uint32_t               millis;
+    uint32_t               count;
+    armv7m_timer_bucket_t  wheel[ARMV7M_TIMER_WHEEL_SIZE];
 } armv7m_timer_control_t;
 
 static armv7m_timer_control_t armv7m_timer_control;
 
+static inline void armv7m_timer_unlink(armv7m_timer_t *timer)
+{
+    timer->next->previous = timer->previous;
+    timer->previous->next = timer->next;
+    
+    timer->next = NULL;
+    timer->previous = NULL;
+}
+
+static inline void armv7m_timer_link(armv7m_timer_t *timer, armv7m_timer_bucket_t *bucket)
+{
+    timer->previous = bucket->previous;
+    timer->next = (armv7m_timer_t*)bucket;
+
+    timer->previous->next = timer;
+    timer->next->previous = timer;
+}
+
 static void armv7m_timer_insert(void *context, uint32_t data)
 {
-    armv7m_timer_t *timer, *element;
-    uint32_t remaining;
+    armv7m_timer_t *timer;
 
     timer = (armv7m_timer_t*)context;
 
     if (timer->next)
     {
-	timer->next->previous = timer->previous;
-	timer->previous->next = timer->next;
-    
-	timer->next = NULL;
-	timer->previous = NULL;
+	armv7m_timer_unlink(timer);
     }
-
-    remaining = data;
-    element = armv7m_timer_control.next;
-
-    while (element != (armv7m_timer_t*)&armv7m_timer_control)
+    else
     {
-	if (remaining < element->remaining)
-	{
-	    element->remaining -= remaining;
-	    break;
-	}
-	
-	remaining -= element->remaining;
-	element = element->next;
+	armv7m_timer_control.count++;
     }
 
-    timer->previous = element->previous;
-    timer->next = element;
+    /* A timeout of 0 fires on the next tick, as it did with the delta list.
+     */
+    timer->deadline = armv7m_timer_control.millis + (data ? data : 1);
 
-    timer->previous->next = timer;
-    timer->next->previous = timer;
-    
-    timer->remaining = remaining;
+    armv7m_timer_link(timer, &armv7m_timer_control.wheel[timer->deadline & (ARMV7M_TIMER_WHEEL_SIZE -1)]);
 }
 
 static void armv7m_timer_remove(void *context, uint32_t data)
@@ -88,11 +99,9 @@ static void armv7m_timer_remove(void *context, uint32_t data)
 
     if (timer->next)
     {
-	timer->next->previous = timer->previous;
-	timer->previous->next = timer->next;
-    
-	timer->next = NULL;
-	timer->previous = NULL;
+	armv7m_timer_unlink(timer);
+
+	armv7m_timer_control.count--;
     }
 
     armv7m_atomic_or((volatile uint32_t *)&timer->callback, 1);
@@ -103,7 +112,7 @@ void armv7m_timer_create(armv7m_timer_t *timer, armv7m_timer_callback_t callback
     timer->next = NULL;
     timer->previous = NULL;
     timer->callback = callback;
-    timer->remaining = 0;
+    timer->deadline = 0;
 }
 
 bool armv7m_timer_start(armv7m_timer_t *timer, uint32_t timeout)
@@ -115,7 +124,7 @@ bool armv7m_timer_start(armv7m_timer_t *timer, uint32_t timeout)
 
     if (irq >= SysTick_IRQn)
     {
-	success = (armv7m_pendsv_enqueue((armv7m_pendsv_routine_t)armv7m_timer_insert, (void*)timer, timeout) != NULL);
+	success = (armv7m_pendsv_enqueue_priority(ARMV7M_PENDSV_PRIORITY_HIGH, (armv7m_pendsv_routine_t)armv7m_timer_insert, (void*)timer, timeout) != NULL);
     }
     else if (irq >= SVCall_IRQn)
     {
@@ -138,7 +147,7 @@ bool armv7m_timer_stop(armv7m_timer_t *timer)
 
     if (irq >= SysTick_IRQn)
     {
-	success = (armv7m_pendsv_enqueue((armv7m_pendsv_routine_t)armv7m_timer_remove, (void*)timer, 0) != NULL);
+	success = (armv7m_pendsv_enqueue_priority(ARMV7M_PENDSV_PRIORITY_HIGH, (armv7m_pendsv_routine_t)armv7m_timer_remove, (void*)timer, 0) != NULL);
 
 	if (success)
 	{
@@ -157,9 +166,49 @@ bool armv7m_timer_stop(armv7m_timer_t *timer)
     return success;
 }
 
-static void armv7m_timer_callback(void *context, uint32_t data)
+/* Returns the number of milliseconds till the earliest pending timer expires (at least 1),
+ * or false if there is none. This is meant for the idle path (i.e. before entering STOP
+ * mode), hence it's fine to visit every pending timer.
+ */
+bool armv7m_timer_next(uint32_t *p_timeout_return)
 {
     armv7m_timer_t *timer;
+    armv7m_timer_bucket_t *bucket;
+    uint32_t millis, index;
+    int32_t timeout, timeout_next;
+
+    if (!armv7m_timer_control.count)
+    {
+	return false;
+    }
+
+    millis = armv7m_systick_millis();
+    timeout_next = 0x7fffffff;
+
+    for (index = 0; index < ARMV7M_TIMER_WHEEL_SIZE; index++)
+    {
+	bucket = &armv7m_timer_control.wheel[index];
+
+	for (timer = bucket->next; timer != (armv7m_timer_t*)bucket; timer = timer->next)
+	{
+	    timeout = (int32_t)(timer->deadline - millis);
+
+	    if (timeout_next > timeout)
+	    {
+		timeout_next = timeout;
+	    }
+	}
+    }
+
+    *p_timeout_return = (timeout_next > 1) ? timeout_next : 1;
+
+    return true;
+}
+
+static void armv7m_timer_callback(void *context, uint32_t data)
+{
+    armv7m_timer_t *timer, *timer_next;
+    armv7m_timer_bucket_t *bucket, expired;
     armv7m_timer_callback_t callback;
     uint32_t millis;
 
@@ -167,41 +216,64 @@ static void armv7m_timer_callback(void *context, uint32_t data)
 
     while (armv7m_timer_control.millis != millis)
     {
-	timer = armv7m_timer_control.next;
+	armv7m_timer_control.millis++;
+
+	if (!armv7m_timer_control.count)
+	{
+	    /* Nothing pending, so skip ahead. Any other bucket is empty as well.
+	     */
+	    armv7m_timer_control.millis = millis;
+
+	    break;
+	}
+
+	bucket = &armv7m_timer_control.wheel[armv7m_timer_control.millis & (ARMV7M_TIMER_WHEEL_SIZE -1)];
 
-	if (timer != (armv7m_timer_t*)&armv7m_timer_control)
+	/* Move the expired timers onto a private list first, so that callbacks can safely
+	 * start and stop any timer, including other expired ones.
+	 */
+	expired.next = (armv7m_timer_t*)&expired;
+	expired.previous = (armv7m_timer_t*)&expired;
+
+	for (timer = bucket->next; timer != (armv7m_timer_t*)bucket; timer = timer_next)
 	{
-	    timer->remaining--;
+	    timer_next = timer->next;
 
-	    while (timer != (armv7m_timer_t*)&armv7m_timer_control)
+	    if (timer->deadline == armv7m_timer_control.millis)
 	    {
-		if (timer->remaining)
-		{
-		    break;
-		}
-		
-		callback = timer->callback;
-		
-		armv7m_timer_remove(timer, 0);
+		armv7m_timer_unlink(timer);
+		armv7m_timer_link(timer, &expired);
+	    }
+	}
+
+	while (expired.next != (armv7m_timer_t*)&expired)
+	{
+	    timer = expired.next;
+
+	    callback = timer->callback;
 		
-		if ((uint32_t)callback & 1)
-		{
-		    (*callback)(timer);
-		}
+	    armv7m_timer_remove(timer, 0);
 		
-		timer = armv7m_timer_control.next;
+	    if ((uint32_t)callback & 1)
+	    {
+		(*callback)(timer);
 	    }
 	}
-
-	armv7m_timer_control.millis++;
     }
 }
 
 void armv7m_timer_initialize(void)
 {
-    armv7m_timer_control.next = (armv7m_timer_t*)&armv7m_timer_control;
-    armv7m_timer_control.previous = (armv7m_timer_t*)&armv7m_timer_control;
+    unsigned int index;
+
+    for (index = 0; index < ARMV7M_TIMER_WHEEL_SIZE; index++)
+    {
+	armv7m_timer_control.wheel[index].next = (armv7m_timer_t*)&armv7m_timer_control.wheel[index];
+	armv7m_timer_control.wheel[index].previous = (armv7m_timer_t*)&armv7m_timer_control.wheel[index];
+    }
+
     armv7m_timer_control.millis = armv7m_systick_millis();
+    armv7m_timer_control.count = 0;
 
     armv7m_systick_notify(armv7m_timer_callback, NULL);
 }
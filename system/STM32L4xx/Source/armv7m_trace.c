@@ -0,0 +1,71 @@
+/*
+ * Copyright (c) 2017 Thomas Roell.  All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal with the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ *  1. Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimers.
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimers in the
+ *     documentation and/or other materials provided with the distribution.
+ *  3. Neither the name of Thomas Roell, nor the names of its contributors
+ *     may be used to endorse or promote products derived from this Software
+ *     without specific prior written permission.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ * CONTRIBUTORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * WITH THE SOFTWARE.
+ */
+
+#include "armv7m.h"
+
+#include "stm32l4xx.h"
+
+armv7m_trace_control_t armv7m_trace_control = {
+    .index = 0,
+    .count = ARMV7M_TRACE_ENTRY_COUNT,
+};
+
+void armv7m_trace_reset(void)
+{
+    armv7m_trace_control.index = 0;
+}
+
+/* Copies the last "count" events, oldest first, and returns how many were copied. Events
+ * recorded while copying may overwrite the oldest entries, so this is meant to be called
+ * once the interesting part is over.
+ */
+unsigned int armv7m_trace_snapshot(armv7m_trace_entry_t *entries, unsigned int count)
+{
+    uint32_t index, start, n;
+
+    index = armv7m_trace_control.index;
+
+    if (count > ARMV7M_TRACE_ENTRY_COUNT)
+    {
+	count = ARMV7M_TRACE_ENTRY_COUNT;
+    }
+
+    if (count > index)
+    {
+	count = index;
+    }
+
+    start = index - count;
+
+    for (n = 0; n < count; n++)
+    {
+	entries[n] = armv7m_trace_control.entries[(start + n) & (ARMV7M_TRACE_ENTRY_COUNT -1)];
+    }
+
+    return count;
+}
@@ -27,6 +27,7 @@
  */
 
 #include <stdlib.h>
+#include <stddef.h>
 #include <stdint.h>
 #include <stdbool.h>
 #include <stdio.h>
@@ -36,6 +37,10 @@
 #include "armv7m.h"
 
 
+static int dosfs_device_read(dosfs_device_t *device, uint32_t address, uint8_t *data, uint32_t length, bool prefetch);
+static int dosfs_device_write(dosfs_device_t *device, uint32_t address, const uint8_t *data, uint32_t length, volatile uint8_t *p_status);
+static int dosfs_device_sync(dosfs_device_t *device, bool wait);
+
 static int dosfs_volume_init(dosfs_volume_t *volume, dosfs_device_t *device);
 static int dosfs_volume_mount(dosfs_volume_t *volume);
 static int dosfs_volume_unmount(dosfs_volume_t *volume);
@@ -46,6 +51,11 @@ static int dosfs_volume_unlock(dosfs_volume_t *volume, int status);
 static int dosfs_volume_read(dosfs_volume_t *volume, uint32_t address, uint8_t *data);
 static int dosfs_volume_write(dosfs_volume_t *volume, uint32_t address, const uint8_t *data);
 static int dosfs_volume_zero(dosfs_volume_t *volume, uint32_t address, uint32_t length, volatile uint8_t *p_status);
+static void dosfs_volume_invalidate(dosfs_volume_t *volume, uint32_t address, uint32_t length);
+#if (DOSFS_CONFIG_WRITE_BACK_ENTRIES != 0)
+static int dosfs_write_back_flush(dosfs_volume_t *volume, uint32_t address, uint32_t length);
+static int dosfs_write_back_insert(dosfs_volume_t *volume, dosfs_file_t *file, uint32_t address, const uint8_t *data);
+#endif /* (DOSFS_CONFIG_WRITE_BACK_ENTRIES != 0) */
 #if (DOSFS_CONFIG_FSINFO_SUPPORTED == 1)
 static int dosfs_volume_fsinfo(dosfs_volume_t *volume, uint32_t free_clscnt, uint32_t next_clsno);
 #endif /* (DOSFS_CONFIG_FSINFO_SUPPORTED == 1) */
@@ -84,10 +94,14 @@ static int dosfs_data_cache_read(dosfs_volume_t *volume, dosfs_file_t *file, uin
 static int dosfs_data_cache_zero(dosfs_volume_t *volume, dosfs_file_t *file, uint32_t blkno, dosfs_cache_entry_t ** p_entry);
 static void dosfs_data_cache_modify(dosfs_volume_t *volume, dosfs_file_t *file);
 static int dosfs_data_cache_flush(dosfs_volume_t *volume, dosfs_file_t *file);
+static void dosfs_data_cache_release(dosfs_volume_t *volume, dosfs_file_t *file);
 
 static int dosfs_cluster_read_uncached(dosfs_volume_t *volume, uint32_t clsno, uint32_t *p_clsdata);
 static int dosfs_cluster_read(dosfs_volume_t *volume, uint32_t clsno, uint32_t *p_clsdata);
 static int dosfs_cluster_write(dosfs_volume_t *volume, uint32_t clsno, uint32_t clsdata, int allocate);
+#if (DOSFS_CONFIG_FREE_BITMAP_ENTRIES != 0)
+static void dosfs_free_bitmap_reset(dosfs_volume_t *volume);
+#endif /* (DOSFS_CONFIG_FREE_BITMAP_ENTRIES != 0) */
 static int dosfs_cluster_chain_seek(dosfs_volume_t *volume, uint32_t clsno, uint32_t clscnt, uint32_t *p_clsno);
 static int dosfs_cluster_chain_create(dosfs_volume_t *volume, uint32_t clsno, uint32_t clscnt, uint32_t *p_clsno_a, uint32_t *p_clsno_l);
 #if (DOSFS_CONFIG_SEQUENTIAL_SUPPORTED == 1)
@@ -119,11 +133,31 @@ static uint8_t dosfs_name_checksum_dosname(const uint8_t *dosname);
 static uint16_t dosfs_name_checksum_uniname(const dosfs_unicode_t *uniname, unsigned int unicount);
 #endif /* (DOSFS_CONFIG_VFAT_SUPPORTED == 1) */
 
+static dosfs_volume_t *dosfs_path_volume(const char **p_filename, dosfs_volume_t *volume);
 static int dosfs_path_convert_filename(dosfs_volume_t *volume, const char *filename, const char **p_filename);
 static int dosfs_path_find_entry(dosfs_volume_t *volume, uint32_t clsno, uint32_t index, uint32_t count, dosfs_find_callback_t callback, void *private, uint32_t *p_clsno, uint32_t *p_index, dosfs_dir_t **p_dir);
 static int dosfs_path_find_directory(dosfs_volume_t *volume, const char *filename, const char **p_filename, uint32_t *p_clsno);
 static int dosfs_path_find_file(dosfs_volume_t *volume, const char *filename, uint32_t *p_clsno, uint32_t *p_index, dosfs_dir_t **p_dir);
+static int dosfs_path_find_name(dosfs_volume_t *volume, uint32_t clsno_d, uint32_t count, uint32_t *p_clsno, uint32_t *p_index, dosfs_dir_t **p_dir);
+#if (DOSFS_CONFIG_DIR_INDEX_ENTRIES != 0)
+static int dosfs_path_index_build(dosfs_volume_t *volume, uint32_t clsno_d);
+static int dosfs_path_index_contains(dosfs_volume_t *volume, const uint8_t *dosname);
+static int dosfs_path_index_tail(dosfs_volume_t *volume, uint32_t count, uint32_t *p_clsno, uint32_t *p_index, int *p_done);
+#if (DOSFS_CONFIG_TRANSACTION_SAFE_SUPPORTED == 0)
+static void dosfs_path_index_insert(dosfs_volume_t *volume, uint32_t clsno_d, uint32_t clsno_n, uint32_t index, const dosfs_dir_t *dir);
+#endif /* (DOSFS_CONFIG_TRANSACTION_SAFE_SUPPORTED == 0) */
+#endif /* (DOSFS_CONFIG_DIR_INDEX_ENTRIES != 0) */
+#if (DOSFS_CONFIG_VFAT_SUPPORTED == 1)
+static int dosfs_path_find_unique(dosfs_volume_t *volume, uint32_t clsno_d, unsigned int *p_mask, int *p_used);
+#endif /* (DOSFS_CONFIG_VFAT_SUPPORTED == 1) */
 static int dosfs_path_find_next(dosfs_volume_t *volume, F_FIND *find);
+#if (DOSFS_CONFIG_EXFAT_SUPPORTED == 1)
+static int dosfs_exfat_find_entry(dosfs_volume_t *volume, uint32_t clsno_d, uint32_t clscnt_d, uint32_t index, unsigned int type, const char *pattern, uint32_t *p_index, dosfs_dir_t **p_dir);
+static int dosfs_exfat_find_directory(dosfs_volume_t *volume, const char *filename, const char **p_filename, uint32_t *p_clsno);
+static int dosfs_exfat_change_directory(dosfs_volume_t *volume, const char *dirname);
+static int dosfs_exfat_count_free(dosfs_volume_t *volume, uint32_t *p_clscnt);
+static int dosfs_exfat_get_label(dosfs_volume_t *volume, char *volname, int length);
+#endif /* (DOSFS_CONFIG_EXFAT_SUPPORTED == 1) */
 
 static void dosfs_path_setup_entry(dosfs_volume_t *volume, const char *dosname, uint8_t attr, uint32_t first_clsno, uint16_t ctime, uint16_t cdate, dosfs_dir_t *dir);
 static int dosfs_path_create_entry(dosfs_volume_t *volume, uint32_t clsno_d, uint32_t clsno, uint32_t index, const char *dosname, uint8_t attr, uint32_t first_clsno, uint16_t ctime, uint16_t cdate);
@@ -137,24 +171,45 @@ static dosfs_file_t *dosfs_file_enumerate(dosfs_volume_t *volume, dosfs_file_t *
 static int dosfs_file_sync(dosfs_volume_t *volume, dosfs_file_t *file, int access, int modify, uint32_t first_clsno, uint32_t length);
 static int dosfs_file_flush(dosfs_volume_t *volume, dosfs_file_t *file, int close);
 static int dosfs_file_seek(dosfs_volume_t *volume, dosfs_file_t *file, uint32_t position);
+static int dosfs_file_cluster_next(dosfs_volume_t *volume, dosfs_file_t *file, uint32_t clsno, uint32_t position, uint32_t *p_clsno);
+#if (DOSFS_CONFIG_EXTENT_ENTRIES != 0)
+static int dosfs_file_extent_build(dosfs_volume_t *volume, dosfs_file_t *file);
+static int dosfs_file_extent_seek(dosfs_volume_t *volume, dosfs_file_t *file, uint32_t clsidx, uint32_t *p_clsno);
+#endif /* (DOSFS_CONFIG_EXTENT_ENTRIES != 0) */
 static int dosfs_file_shrink(dosfs_volume_t *volume, dosfs_file_t *file);
 static int dosfs_file_extend(dosfs_volume_t *volume, dosfs_file_t *file, uint32_t length);
 #if (DOSFS_CONFIG_CONTIGUOUS_SUPPORTED == 1)
 static int dosfs_file_reserve(dosfs_volume_t *volume, dosfs_file_t *file, uint32_t size);
 #endif /* (DOSFS_CONFIG_CONTIGUOUS_SUPPORTED == 1) */
+#if (DOSFS_CONFIG_REOPEN_ENTRIES != 0)
+static void dosfs_file_reopen_invalidate(dosfs_volume_t *volume, dosfs_file_t *file);
+static dosfs_reopen_entry_t *dosfs_file_reopen_find(dosfs_volume_t *volume, const char *filename);
+static void dosfs_file_reopen_insert(dosfs_volume_t *volume, dosfs_reopen_entry_t *entry, const char *filename, dosfs_file_t *file);
+#endif /* (DOSFS_CONFIG_REOPEN_ENTRIES != 0) */
+static int dosfs_file_lookup(dosfs_volume_t *volume, dosfs_file_t *file, const char *filename, uint32_t mode);
 static int dosfs_file_open(dosfs_volume_t *volume, const char *filename, uint32_t mode, uint32_t size, dosfs_file_t **p_file);
 static int dosfs_file_close(dosfs_volume_t *volume, dosfs_file_t *file);
 static int dosfs_file_read(dosfs_volume_t *volume, dosfs_file_t *file, uint8_t *data, uint32_t count, uint32_t *p_count);
+static int dosfs_file_read_async(dosfs_volume_t *volume, dosfs_file_t *file, uint8_t *data, uint32_t count, F_CALLBACK callback, void *context, uint32_t *p_count);
+static int dosfs_file_read_blkno(dosfs_volume_t *volume, dosfs_file_t *file, uint32_t *p_blkno);
+static void dosfs_file_read_multiple(dosfs_volume_t *volume, F_READ_REQUEST *requests, unsigned int count);
+static int dosfs_file_advise(dosfs_volume_t *volume, dosfs_file_t *file, uint32_t offset, uint32_t length, uint32_t advice);
+static int dosfs_file_map(dosfs_volume_t *volume, dosfs_file_t *file, const void **p_data);
 static int dosfs_file_write(dosfs_volume_t *volume, dosfs_file_t *file, const uint8_t *data, uint32_t count, uint32_t *p_count);
 
 
-dosfs_volume_t dosfs_volume;
+dosfs_volume_t dosfs_volume_table[DOSFS_CONFIG_MAX_VOLUMES];
+dosfs_volume_t *dosfs_volume_default = &dosfs_volume_table[0];
 
-static uint32_t dosfs_cache[(1 +
+/* Each volume has its own set of caches, so that accesses to one drive do not
+ * evict the meta data of the other.
+ */
+static uint32_t dosfs_cache[DOSFS_CONFIG_MAX_VOLUMES][(1 +
 			    DOSFS_CONFIG_FAT_CACHE_ENTRIES +
 			    ((DOSFS_CONFIG_TRANSACTION_SAFE_SUPPORTED == 1) ? 1 : 0) +
-			    (((DOSFS_CONFIG_FILE_DATA_CACHE == 0) ? 1 : DOSFS_CONFIG_MAX_FILES) * DOSFS_CONFIG_DATA_CACHE_ENTRIES))
-			   * (DOSFS_BLK_SIZE / sizeof(uint32_t))];
+			    (((DOSFS_CONFIG_FILE_DATA_CACHE == 0) ? 1 : DOSFS_CONFIG_MAX_FILES) * DOSFS_CONFIG_DATA_CACHE_ENTRIES) +
+			    DOSFS_CONFIG_WRITE_BACK_ENTRIES)
+			   * (DOSFS_BLK_SIZE / sizeof(uint32_t))] __noinit;
 
 static const char dosfs_dirname_dot[11]    = ".          ";
 static const char dosfs_dirname_dotdot[11] = "..         ";
@@ -180,9 +235,108 @@ static const uint8_t dosfs_path_ldir_name_table[13] = {
 #endif /* (DOSFS_CONFIG_VFAT_SUPPORTED == 1) */
 
 
+/* All device accesses of the file system go through the wrappers below, which keep the
+ * always-on counters in dosfs_device_t.statistics. The time spent inside the device
+ * interface is mostly busy waiting for the medium, hence "device_time" and "max_latency"
+ * are what to look at for field performance problems.
+ */
+
+static void dosfs_device_account(dosfs_device_t *device, uint32_t start)
+{
+    uint32_t elapsed;
+
+    elapsed = (uint32_t)armv7m_systick_micros() - start;
+
+    device->statistics.device_time += elapsed;
+
+    if (device->statistics.max_latency < elapsed)
+    {
+	device->statistics.max_latency = elapsed;
+    }
+}
+
+static __optimize_speed int dosfs_device_read(dosfs_device_t *device, uint32_t address, uint8_t *data, uint32_t length, bool prefetch)
+{
+    int status = F_NO_ERROR;
+    uint32_t start;
+
+    start = (uint32_t)armv7m_systick_micros();
+
+#if (DOSFS_CONFIG_STORAGE_SHARED_SUPPORTED == 1)
+    if (device->lock & DOSFS_DEVICE_LOCK_SHARED)
+    {
+	status = dosfs_storage_shared_read(device, address, data, length, prefetch);
+    }
+    else
+#endif /* (DOSFS_CONFIG_STORAGE_SHARED_SUPPORTED == 1) */
+    {
+	status = (*device->interface->read)(device->context, address, data, length, prefetch);
+    }
+
+    device->statistics.reads++;
+    device->statistics.read_blocks += length;
+
+    dosfs_device_account(device, start);
+
+    return status;
+}
+
+static int dosfs_device_write(dosfs_device_t *device, uint32_t address, const uint8_t *data, uint32_t length, volatile uint8_t *p_status)
+{
+    int status = F_NO_ERROR;
+    uint32_t start;
+
+    start = (uint32_t)armv7m_systick_micros();
+
+#if (DOSFS_CONFIG_STORAGE_SHARED_SUPPORTED == 1)
+    /* A shared volume is mounted write protected, so this is not supposed to happen.
+     */
+    if (device->lock & DOSFS_DEVICE_LOCK_SHARED)
+    {
+	return F_ERR_WRITEPROTECT;
+    }
+#endif /* (DOSFS_CONFIG_STORAGE_SHARED_SUPPORTED == 1) */
+
+    status = (*device->interface->write)(device->context, address, data, length, p_status);
+
+    device->statistics.writes++;
+    device->statistics.write_blocks += length;
+
+    dosfs_device_account(device, start);
+
+    return status;
+}
+
+static int dosfs_device_sync(dosfs_device_t *device, bool wait)
+{
+    int status = F_NO_ERROR;
+    uint32_t start;
+
+    start = (uint32_t)armv7m_systick_micros();
+
+#if (DOSFS_CONFIG_STORAGE_SHARED_SUPPORTED == 1)
+    if (device->lock & DOSFS_DEVICE_LOCK_SHARED)
+    {
+	status = dosfs_storage_shared_sync(device, wait);
+    }
+    else
+#endif /* (DOSFS_CONFIG_STORAGE_SHARED_SUPPORTED == 1) */
+    {
+	status = (*device->interface->sync)(device->context, wait);
+    }
+
+    device->statistics.syncs++;
+
+    dosfs_device_account(device, start);
+
+    return status;
+}
+
+
 static int dosfs_volume_init(dosfs_volume_t *volume, dosfs_device_t *device)
 {
     int status = F_NO_ERROR;
+    unsigned int index;
     uint8_t *cache;
 #if (DOSFS_CONFIG_FILE_DATA_CACHE == 1)
 #if (DOSFS_CONFIG_MAX_FILES != 1)
@@ -229,7 +383,7 @@ static int dosfs_volume_init(dosfs_volume_t *volume, dosfs_device_t *device)
 #endif /* (DOSFS_CONFIG_VFAT_SUPPORTED == 1) */
 #endif /* (DOSFS_CONFIG_TRANSACTION_SAFE_SUPPORTED == 1) */
 
-    cache = (uint8_t*)&dosfs_cache[0];
+    cache = (uint8_t*)&dosfs_cache[volume - &dosfs_volume_table[0]][0];
 
     volume->dir_cache.data = cache;
     cache += DOSFS_BLK_SIZE;
@@ -274,6 +428,16 @@ static int dosfs_volume_init(dosfs_volume_t *volume, dosfs_device_t *device)
 #endif /* (DOSFS_CONFIG_FILE_DATA_CACHE == 0) */
 #endif /* (DOSFS_CONFIG_DATA_CACHE_ENTRIES != 0) */
 
+#if (DOSFS_CONFIG_WRITE_BACK_ENTRIES != 0)
+    volume->wb_data = cache;
+    cache += (DOSFS_CONFIG_WRITE_BACK_ENTRIES * DOSFS_BLK_SIZE);
+#endif /* (DOSFS_CONFIG_WRITE_BACK_ENTRIES != 0) */
+
+    for (index = 0; index < DOSFS_CONFIG_MAX_FILES; index++)
+    {
+	volume->file_table[index].volume = volume - &dosfs_volume_table[0];
+    }
+
     if (device->interface)
     {
         volume->state = DOSFS_VOLUME_STATE_INITIALIZED;
@@ -316,6 +480,16 @@ static int dosfs_volume_mount(dosfs_volume_t * volume)
 
     status = (*device->interface->info)(device->context, &media, &write_protected, &blkcnt, &au_size, &product);
 
+#if (DOSFS_CONFIG_STORAGE_SHARED_SUPPORTED == 1)
+    /* The host owns a shared volume, so nothing may be written, not even the
+     * dirty bit or the FSInfo sector.
+     */
+    if (device->lock & DOSFS_DEVICE_LOCK_SHARED)
+    {
+	write_protected = 1;
+    }
+#endif /* (DOSFS_CONFIG_STORAGE_SHARED_SUPPORTED == 1) */
+
     if (status == F_NO_ERROR)
     {
 	if (volume->state == DOSFS_VOLUME_STATE_CARDREMOVED)
@@ -384,7 +558,8 @@ static int dosfs_volume_mount(dosfs_volume_t * volume)
 		 * that points to a FDC descriptor, without partition table. However the
 		 * default is to use a partition table (with BPB or extended BPB). Thus
 		 * there are checks in place for the presence of a FDC descriptor, and
-		 * a validation check for the partition table to filter out exFAT for SDXC.
+		 * a validation check for the partition table to filter out exFAT for SDXC
+		 * (unless DOSFS_CONFIG_EXFAT_SUPPORTED allows it as read-only volume).
 		 */
 	       
 		if (boot->bs.bs_trail_sig != DOSFS_HTOFS(0xaa55))
@@ -399,6 +574,9 @@ static int dosfs_volume_mount(dosfs_volume_t * volume)
 			if ((boot->mbr.mbr_par_table[0].mbr_sys_id == 0x01) ||
 			    (boot->mbr.mbr_par_table[0].mbr_sys_id == 0x04) ||
 			    (boot->mbr.mbr_par_table[0].mbr_sys_id == 0x06) ||
+#if (DOSFS_CONFIG_EXFAT_SUPPORTED == 1)
+			    (boot->mbr.mbr_par_table[0].mbr_sys_id == 0x07) ||
+#endif /* (DOSFS_CONFIG_EXFAT_SUPPORTED == 1) */
 			    (boot->mbr.mbr_par_table[0].mbr_sys_id == 0x0b) ||
 			    (boot->mbr.mbr_par_table[0].mbr_sys_id == 0x0c))
 			{
@@ -443,6 +621,37 @@ static int dosfs_volume_mount(dosfs_volume_t * volume)
 		     * or not.
 		     */
 
+#if (DOSFS_CONFIG_EXFAT_SUPPORTED == 1)
+		    if (!memcmp(&boot->bpbex.bs_oem_name[0], "EXFAT   ", 8))
+		    {
+			/* An exFAT volume is read via the FAT32 code paths, with its allocation
+			 * bitmap and directory entry sets handled separately. Anything that would
+			 * modify the volume is rejected via DOSFS_VOLUME_FLAG_WRITE_PROTECTED.
+			 */
+			if (boot->bpbex.bpb_byts_per_sec_shift != DOSFS_BLK_SHIFT)
+			{
+			    status = F_ERR_NOTSUPPSECTORSIZE;
+			}
+			else if ((boot->bpbex.bpb_sec_per_clus_shift > 15) ||
+				 (boot->bpbex.bpb_num_fats == 0) || (boot->bpbex.bpb_num_fats > 2) ||
+				 (DOSFS_FTOHL(boot->bpbex.bpb_fat_offset) < 24) ||
+				 (DOSFS_FTOHL(boot->bpbex.bpb_cluster_heap_offset) < (DOSFS_FTOHL(boot->bpbex.bpb_fat_offset) + (DOSFS_FTOHL(boot->bpbex.bpb_fat_length) * boot->bpbex.bpb_num_fats))) ||
+				 (DOSFS_FTOHL(boot->bpbex.bpb_root_clus) < 2) ||
+				 (DOSFS_FTOHL(boot->bpbex.bpb_root_clus) > (DOSFS_FTOHL(boot->bpbex.bpb_cluster_count) +1)))
+			{
+			    status = F_ERR_INVALIDMEDIA;
+			}
+			else if ((boot->bpbex.bpb_volume_length > 0xffffffffull) || (DOSFS_FTOHL(boot->bpbex.bpb_cluster_count) > (DOSFS_CLSNO_RESERVED32 -1)))
+			{
+			    status = F_ERR_MEDIATOOLARGE;
+			}
+			else
+			{
+			    volume->flags |= (DOSFS_VOLUME_FLAG_EXFAT | DOSFS_VOLUME_FLAG_WRITE_PROTECTED);
+			}
+		    }
+		    else
+#endif /* (DOSFS_CONFIG_EXFAT_SUPPORTED == 1) */
 		    if ((boot->bpb.bpb_byts_per_sec != DOSFS_HTOFS(DOSFS_BLK_SIZE))
 #if (DOSFS_CONFIG_TRANSACTION_SAFE_SUPPORTED == 1)
 			&& ((boot->bpb.bpb_byts_per_sec != (0x8000 | DOSFS_HTOFS(DOSFS_BLK_SIZE))) ||
@@ -465,16 +674,27 @@ static int dosfs_volume_mount(dosfs_volume_t * volume)
 		    {
 			status = F_ERR_INVALIDMEDIA;
 		    }
-		    else
+
+		    if (status == F_NO_ERROR)
 		    {
 #if (DOSFS_CONFIG_VOLUME_DIRTY_SUPPORTED == 1) && (DOSFS_CONFIG_TRANSACTION_SAFE_SUPPORTED == 0)
 			memcpy(&volume->bs_data[0], boot, sizeof(volume->bs_data));
 #endif /* (DOSFS_CONFIG_VOLUME_DIRTY_SUPPORTED == 1) && (DOSFS_CONFIG_TRANSACTION_SAFE_SUPPORTED == 0) */
 
-			volume->cls_size = (boot->bpb.bpb_sec_per_clus * DOSFS_BLK_SIZE);
+#if (DOSFS_CONFIG_EXFAT_SUPPORTED == 1)
+			if (volume->flags & DOSFS_VOLUME_FLAG_EXFAT)
+			{
+			    volume->cls_size = (DOSFS_BLK_SIZE << boot->bpbex.bpb_sec_per_clus_shift);
+			}
+			else
+#endif /* (DOSFS_CONFIG_EXFAT_SUPPORTED == 1) */
+			{
+			    volume->cls_size = (boot->bpb.bpb_sec_per_clus * DOSFS_BLK_SIZE);
+			}
+
 			volume->cls_mask = volume->cls_size -1;
 
-			for (cls_mask = 0x8000, cls_shift = 16; !(volume->cls_mask & cls_mask); cls_mask >>= 1, cls_shift--) { }
+			for (cls_mask = 0x800000, cls_shift = 24; !(volume->cls_mask & cls_mask); cls_mask >>= 1, cls_shift--) { }
 
 			volume->cls_shift = cls_shift;
 			volume->cls_blk_shift = cls_shift - DOSFS_BLK_SHIFT;
@@ -483,6 +703,41 @@ static int dosfs_volume_mount(dosfs_volume_t * volume)
 
 			volume->boot_blkno = boot_blkno;
 
+#if (DOSFS_CONFIG_EXFAT_SUPPORTED == 1)
+			if (volume->flags & DOSFS_VOLUME_FLAG_EXFAT)
+			{
+			    /* exFAT */
+
+			    volume->fsinfo_blkofs = 0;
+			    volume->bkboot_blkofs = 0;
+
+			    /* The cluster heap may end before the volume does, hence "tot_sec" is
+			     * set up such that "last_clsno" ends up as bpb_cluster_count +1.
+			     */
+			    tot_sec = DOSFS_FTOHL(boot->bpbex.bpb_cluster_heap_offset) + (DOSFS_FTOHL(boot->bpbex.bpb_cluster_count) << volume->cls_blk_shift);
+
+			    volume->fat_blkcnt = DOSFS_FTOHL(boot->bpbex.bpb_fat_length);
+			    volume->fat1_blkno = volume->boot_blkno + DOSFS_FTOHL(boot->bpbex.bpb_fat_offset);
+			    volume->fat2_blkno = 0;
+
+			    /* TexFAT has a 2nd FAT, in which case ActiveFat says which one is current.
+			     */
+			    if ((boot->bpbex.bpb_num_fats == 2) && (DOSFS_FTOHS(boot->bpbex.bpb_volume_flags) & 0x0001))
+			    {
+				volume->fat1_blkno += volume->fat_blkcnt;
+			    }
+
+			    volume->cls_blk_offset = (volume->boot_blkno + DOSFS_FTOHL(boot->bpbex.bpb_cluster_heap_offset)) - (2 << volume->cls_blk_shift);
+
+			    volume->root_clsno = DOSFS_FTOHL(boot->bpbex.bpb_root_clus);
+			    volume->root_blkno = volume->cls_blk_offset + (volume->root_clsno << volume->cls_blk_shift);
+			    volume->root_blkcnt = volume->cls_blk_size;
+
+			    volume->serial = DOSFS_FTOHL(boot->bpbex.bs_vol_id);
+			}
+			else
+#endif /* (DOSFS_CONFIG_EXFAT_SUPPORTED == 1) */
+
 			/* FAT32 differs from FAT12/FAT16 by having bpb_fat_sz_16 forced to 0. 
 			 * The bpb_root_ent_cnt is ignored for the decision.
 			 */
@@ -585,6 +840,10 @@ static int dosfs_volume_mount(dosfs_volume_t * volume)
 			{
 			    volume->last_clsno = (((boot_blkno + tot_sec) - volume->cls_blk_offset) >> volume->cls_blk_shift) -1;
 
+#if (DOSFS_CONFIG_FREE_BITMAP_ENTRIES != 0)
+			    dosfs_free_bitmap_reset(volume);
+#endif /* (DOSFS_CONFIG_FREE_BITMAP_ENTRIES != 0) */
+
 #if (DOSFS_CONFIG_SEQUENTIAL_SUPPORTED == 1) || (DOSFS_CONFIG_CONTIGUOUS_SUPPORTED == 1)
 			    if (au_size == 0)
 			    {
@@ -638,6 +897,15 @@ static int dosfs_volume_mount(dosfs_volume_t * volume)
 
 			    if (status == F_NO_ERROR)
 			    {
+#if (DOSFS_CONFIG_EXFAT_SUPPORTED == 1)
+				/* The exFAT FAT has 32 bit entries, regardless of the cluster count.
+				 */
+				if (volume->flags & DOSFS_VOLUME_FLAG_EXFAT)
+				{
+				    volume->type = DOSFS_VOLUME_TYPE_FAT32;
+				}
+				else
+#endif /* (DOSFS_CONFIG_EXFAT_SUPPORTED == 1) */
 				if ((volume->last_clsno -1) < 4085)
 				{
 #if (DOSFS_CONFIG_FAT12_SUPPORTED == 1)
@@ -664,6 +932,8 @@ static int dosfs_volume_mount(dosfs_volume_t * volume)
 				     */
 				    volume->dir_cache.blkno = DOSFS_BLKNO_INVALID;
 
+				    dosfs_volume_invalidate(volume, 0, DOSFS_BLKNO_INVALID);
+
 #if (DOSFS_CONFIG_TRANSACTION_SAFE_SUPPORTED == 1)
 				    volume->map_cache.blkno = DOSFS_BLKNO_INVALID;
 #endif /* (DOSFS_CONFIG_TRANSACTION_SAFE_SUPPORTED == 1) */
@@ -683,6 +953,11 @@ static int dosfs_volume_mount(dosfs_volume_t * volume)
 				    volume->data_cache.blkno = DOSFS_BLKNO_INVALID;
 #endif /* (DOSFS_CONFIG_DATA_CACHE_ENTRIES != 0) */
 #endif /* (DOSFS_CONFIG_FILE_DATA_CACHE == 0) */
+
+#if (DOSFS_CONFIG_WRITE_BACK_ENTRIES != 0)
+				    volume->wb_file = NULL;
+				    volume->wb_blkcnt = 0;
+#endif /* (DOSFS_CONFIG_WRITE_BACK_ENTRIES != 0) */
 			    
 #if (DOSFS_CONFIG_CLUSTER_CACHE_ENTRIES != 0)
 				    for (index = 0; index < DOSFS_CONFIG_CLUSTER_CACHE_ENTRIES; index++)
@@ -691,8 +966,21 @@ static int dosfs_volume_mount(dosfs_volume_t * volume)
 					volume->cluster_cache[index].clsdata = DOSFS_CLSNO_NONE;
 				    }
 #endif /* (DOSFS_CONFIG_CLUSTER_CACHE_ENTRIES != 0) */
+
+#if (DOSFS_CONFIG_DIR_INDEX_ENTRIES != 0)
+				    volume->index_clsno = DOSFS_CLSNO_END_OF_CHAIN;
+#endif /* (DOSFS_CONFIG_DIR_INDEX_ENTRIES != 0) */
+
+#if (DOSFS_CONFIG_REOPEN_ENTRIES != 0)
+				    dosfs_file_reopen_invalidate(volume, NULL);
+#endif /* (DOSFS_CONFIG_REOPEN_ENTRIES != 0) */
 			    
 				    volume->cwd_clsno = DOSFS_CLSNO_NONE;
+
+#if (DOSFS_CONFIG_EXFAT_SUPPORTED == 1)
+				    volume->cwd_clscnt = 0;
+				    volume->exfat_free_clscnt = DOSFS_CLSNO_END_OF_CHAIN;
+#endif /* (DOSFS_CONFIG_EXFAT_SUPPORTED == 1) */
 			    
 #if (DOSFS_CONFIG_MAX_FILES == 1)
 				    volume->file_table[0].mode = 0;
@@ -905,11 +1193,98 @@ static int dosfs_volume_unmount(dosfs_volume_t * volume)
     return status;
 }
 
+#if (DOSFS_CONFIG_STORAGE_SHARED_SUPPORTED == 1)
+
+/* The host wrote blocks "blkno" to "blkno + blkcnt" of a shared volume. Drop all
+ * cached meta data in that range. If the FAT was touched, anything derived from
+ * it goes as well, and the directory name index is always rebuilt, as there is
+ * no telling which directory cluster got rewritten. Open files keep their
+ * positions and extents, so a file the host rewrites needs to be reopened.
+ */
+static void dosfs_volume_refresh(dosfs_volume_t *volume, uint32_t blkno, uint32_t blkcnt)
+{
+#if (DOSFS_CONFIG_CLUSTER_CACHE_ENTRIES != 0)
+    unsigned int index;
+#endif /* (DOSFS_CONFIG_CLUSTER_CACHE_ENTRIES != 0) */
+
+    if ((volume->dir_cache.blkno - blkno) < blkcnt)
+    {
+	volume->dir_cache.blkno = DOSFS_BLKNO_INVALID;
+    }
+
+#if (DOSFS_CONFIG_FAT_CACHE_ENTRIES != 0)
+#if (DOSFS_CONFIG_FAT_CACHE_ENTRIES == 1)
+    if ((volume->fat_cache.blkno - blkno) < blkcnt)
+    {
+	volume->fat_cache.blkno = DOSFS_BLKNO_INVALID;
+    }
+#else /* (DOSFS_CONFIG_FAT_CACHE_ENTRIES == 1) */
+    if ((volume->fat_cache[0].blkno - blkno) < blkcnt)
+    {
+	volume->fat_cache[0].blkno = DOSFS_BLKNO_INVALID;
+    }
+
+    if ((volume->fat_cache[1].blkno - blkno) < blkcnt)
+    {
+	volume->fat_cache[1].blkno = DOSFS_BLKNO_INVALID;
+    }
+#endif /* (DOSFS_CONFIG_FAT_CACHE_ENTRIES == 1) */
+#endif /* (DOSFS_CONFIG_FAT_CACHE_ENTRIES != 0) */
+
+#if (DOSFS_CONFIG_FILE_DATA_CACHE == 0)
+#if (DOSFS_CONFIG_DATA_CACHE_ENTRIES != 0)
+    if ((volume->data_cache.blkno - blkno) < blkcnt)
+    {
+	volume->data_file = NULL;
+	volume->data_cache.blkno = DOSFS_BLKNO_INVALID;
+    }
+#endif /* (DOSFS_CONFIG_DATA_CACHE_ENTRIES != 0) */
+#endif /* (DOSFS_CONFIG_FILE_DATA_CACHE == 0) */
+
+    dosfs_volume_invalidate(volume, blkno, blkcnt);
+
+    if ((blkno < (volume->fat1_blkno + volume->fat_blkcnt)) && (volume->fat1_blkno < (blkno + blkcnt)))
+    {
+#if (DOSFS_CONFIG_CLUSTER_CACHE_ENTRIES != 0)
+	for (index = 0; index < DOSFS_CONFIG_CLUSTER_CACHE_ENTRIES; index++)
+	{
+	    volume->cluster_cache[index].clsno   = DOSFS_CLSNO_NONE;
+	    volume->cluster_cache[index].clsdata = DOSFS_CLSNO_NONE;
+	}
+#endif /* (DOSFS_CONFIG_CLUSTER_CACHE_ENTRIES != 0) */
+
+#if (DOSFS_CONFIG_FREE_BITMAP_ENTRIES != 0)
+	dosfs_free_bitmap_reset(volume);
+#endif /* (DOSFS_CONFIG_FREE_BITMAP_ENTRIES != 0) */
+
+#if (DOSFS_CONFIG_EXFAT_SUPPORTED == 1)
+	volume->exfat_free_clscnt = DOSFS_CLSNO_END_OF_CHAIN;
+#endif /* (DOSFS_CONFIG_EXFAT_SUPPORTED == 1) */
+    }
+
+#if (DOSFS_CONFIG_DIR_INDEX_ENTRIES != 0)
+    volume->index_clsno = DOSFS_CLSNO_END_OF_CHAIN;
+#endif /* (DOSFS_CONFIG_DIR_INDEX_ENTRIES != 0) */
+
+#if (DOSFS_CONFIG_REOPEN_ENTRIES != 0)
+    dosfs_file_reopen_invalidate(volume, NULL);
+#endif /* (DOSFS_CONFIG_REOPEN_ENTRIES != 0) */
+}
+
+#endif /* (DOSFS_CONFIG_STORAGE_SHARED_SUPPORTED == 1) */
+
 static int dosfs_volume_lock(dosfs_volume_t *volume)
 {
     int status = F_NO_ERROR;
+#if (DOSFS_CONFIG_STORAGE_SHARED_SUPPORTED == 1)
+    uint32_t blkno, blkcnt;
+#endif /* (DOSFS_CONFIG_STORAGE_SHARED_SUPPORTED == 1) */
 
-    if (volume->state == DOSFS_VOLUME_STATE_NONE)
+    if (!volume)
+    {
+	status = F_ERR_INVALIDDRIVE;
+    }
+    else if (volume->state == DOSFS_VOLUME_STATE_NONE)
     {
 	status = F_ERR_INITFUNC;
     }
@@ -937,6 +1312,18 @@ static int dosfs_volume_lock(dosfs_volume_t *volume)
 		    status = dosfs_volume_mount(volume);
 		}
 	    }
+#if (DOSFS_CONFIG_STORAGE_SHARED_SUPPORTED == 1)
+	    else
+	    {
+		if (DOSFS_VOLUME_DEVICE(volume)->lock & DOSFS_DEVICE_LOCK_STALE)
+		{
+		    if (dosfs_storage_shared_stale(&blkno, &blkcnt))
+		    {
+			dosfs_volume_refresh(volume, blkno, blkcnt);
+		    }
+		}
+	    }
+#endif /* (DOSFS_CONFIG_STORAGE_SHARED_SUPPORTED == 1) */
 	}
     }
 
@@ -989,89 +1376,306 @@ static int dosfs_volume_unlock(dosfs_volume_t *volume, int status)
     return status;
 }
 
-static int dosfs_volume_read(dosfs_volume_t *volume, uint32_t address, uint8_t *data)
+/* The optional sector cache sits underneath dosfs_volume_read() and dosfs_volume_write(),
+ * which are only used for meta data (boot, FAT and directory blocks). It's a write-through
+ * cache, with a least recently used replacement. Data blocks are written through the device
+ * directly, so those writes only need to invalidate stale entries (a directory cluster that
+ * got freed and reused for file data).
+ */
+static uint32_t dosfs_sector_cache_lookup(dosfs_volume_t *volume, uint32_t address)
 {
-    int status = F_NO_ERROR;
-    dosfs_device_t *device;
-#if (DOSFS_CONFIG_META_DATA_RETRIES != 0)
-    unsigned int retries = DOSFS_CONFIG_META_DATA_RETRIES +1;
-#else /* (DOSFS_CONFIG_META_DATA_RETRIES != 0) */
-    unsigned int retries = 0;
-#endif /* (DOSFS_CONFIG_META_DATA_RETRIES != 0) */
+    uint32_t index;
 
-    device = DOSFS_VOLUME_DEVICE(volume);
-
-    do
+    for (index = 0; index < volume->sector_count; index++)
     {
-	status = (*device->interface->read)(device->context, address, data, 1, false);
-		
-	if ((status == F_ERR_ONDRIVE) && (retries >= 1))
-	{
-	    status = F_NO_ERROR;
-	    retries--;
-	}
-	else
+	if (volume->sector_blkno[index] == address)
 	{
-	    retries = 0;
+	    break;
 	}
     }
-    while ((status == F_NO_ERROR) && retries);
 
-#if (DOSFS_CONFIG_MEDIA_FAILURE_SUPPORTED == 1)
-    if (status == F_ERR_INVALIDSECTOR)
-    {
-	volume->flags |= DOSFS_VOLUME_FLAG_MEDIA_FAILURE;
-    }
-#endif /* (DOSFS_CONFIG_MEDIA_FAILURE_SUPPORTED == 1) */
+    return index;
+}
 
-    if (status != F_NO_ERROR)
+static void dosfs_sector_cache_insert(dosfs_volume_t *volume, uint32_t address, const uint8_t *data)
+{
+    uint32_t index, index_lru, stamp;
+
+    index = dosfs_sector_cache_lookup(volume, address);
+
+    if (index == volume->sector_count)
     {
-	if (status != F_ERR_CARDREMOVED)
+	index_lru = 0;
+
+	for (index = 0; index < volume->sector_count; index++)
 	{
-	    status = F_ERR_UNUSABLE;
+	    if (volume->sector_blkno[index] == DOSFS_BLKNO_INVALID)
+	    {
+		index_lru = index;
+
+		break;
+	    }
+
+	    stamp = volume->sector_stamp[index];
+
+	    if ((int32_t)(stamp - volume->sector_stamp[index_lru]) < 0)
+	    {
+		index_lru = index;
+	    }
 	}
+
+	index = index_lru;
+
+	volume->sector_blkno[index] = address;
     }
 
-    return status;
+    volume->sector_stamp[index] = ++volume->sector_clock;
+
+    memcpy(volume->sector_data + (index * DOSFS_BLK_SIZE), data, DOSFS_BLK_SIZE);
 }
 
-static int dosfs_volume_write(dosfs_volume_t *volume, uint32_t address, const uint8_t *data)
+static void dosfs_volume_invalidate(dosfs_volume_t *volume, uint32_t address, uint32_t length)
 {
-    int status = F_NO_ERROR;
-    dosfs_device_t *device;
-#if (DOSFS_CONFIG_META_DATA_RETRIES != 0)
-    unsigned int retries = DOSFS_CONFIG_META_DATA_RETRIES +1;
-#else /* (DOSFS_CONFIG_META_DATA_RETRIES != 0) */
-    unsigned int retries = 0;
-#endif /* (DOSFS_CONFIG_META_DATA_RETRIES != 0) */
-
-    device = DOSFS_VOLUME_DEVICE(volume);
+    uint32_t index;
 
-    do
+    for (index = 0; index < volume->sector_count; index++)
     {
-	status = (*device->interface->write)(device->context, address, data, 1, NULL);
-		
-	if ((status == F_ERR_ONDRIVE) && (retries >= 1))
+	if ((volume->sector_blkno[index] - address) < length)
 	{
-	    status = F_NO_ERROR;
-	    retries--;
-	}
-	else
-	{
-	    retries = 0;
+	    volume->sector_blkno[index] = DOSFS_BLKNO_INVALID;
 	}
     }
-    while ((status == F_NO_ERROR) && retries);
+}
 
-#if (DOSFS_CONFIG_MEDIA_FAILURE_SUPPORTED == 1)
-    if (status == F_ERR_INVALIDSECTOR)
-    {
-	volume->flags |= DOSFS_VOLUME_FLAG_MEDIA_FAILURE;
-    }
-#endif /* (DOSFS_CONFIG_MEDIA_FAILURE_SUPPORTED == 1) */
+#if (DOSFS_CONFIG_WRITE_BACK_ENTRIES != 0)
 
-    if (status != F_NO_ERROR)
-    {
+/* The write-back buffer collects consecutive data blocks of one file that got evicted from
+ * the dir_cache, and writes them later on with a single multi block write. Any other
+ * disk operation that touches one of the pending blocks flushes the buffer first, so that
+ * the order of writes to the same block is preserved.
+ */
+static int dosfs_write_back_flush(dosfs_volume_t *volume, uint32_t address, uint32_t length)
+{
+    int status = F_NO_ERROR;
+    dosfs_device_t *device;
+    dosfs_file_t *file;
+
+    if (volume->wb_blkcnt && (((volume->wb_blkno - address) < length) || ((address - volume->wb_blkno) < volume->wb_blkcnt)))
+    {
+	device = DOSFS_VOLUME_DEVICE(volume);
+	file = volume->wb_file;
+
+	dosfs_volume_invalidate(volume, volume->wb_blkno, volume->wb_blkcnt);
+
+	status = dosfs_device_write(device, volume->wb_blkno, volume->wb_data, volume->wb_blkcnt, &file->status);
+
+#if (DOSFS_CONFIG_MEDIA_FAILURE_SUPPORTED == 1)
+	if (status == F_ERR_INVALIDSECTOR)
+	{
+	    volume->flags |= DOSFS_VOLUME_FLAG_MEDIA_FAILURE;
+	}
+#endif /* (DOSFS_CONFIG_MEDIA_FAILURE_SUPPORTED == 1) */
+
+	if (status == F_NO_ERROR)
+	{
+	    device->lock |= DOSFS_DEVICE_LOCK_MODIFIED;
+	}
+
+	/* Unconditionally drop the pending blocks, same as for
+	 * the dir_cache, or the system would get stuck.
+	 */
+	volume->wb_file = NULL;
+	volume->wb_blkcnt = 0;
+    }
+
+    return status;
+}
+
+static int dosfs_write_back_insert(dosfs_volume_t *volume, dosfs_file_t *file, uint32_t address, const uint8_t *data)
+{
+    int status = F_NO_ERROR;
+
+    if (volume->wb_blkcnt)
+    {
+	if ((volume->wb_file == file) && ((address - volume->wb_blkno) < volume->wb_blkcnt))
+	{
+	    /* A partial block that got written to again.
+	     */
+	    memcpy(volume->wb_data + ((address - volume->wb_blkno) * DOSFS_BLK_SIZE), data, DOSFS_BLK_SIZE);
+
+	    return F_NO_ERROR;
+	}
+
+	if ((volume->wb_file != file) || (address != (volume->wb_blkno + volume->wb_blkcnt)))
+	{
+	    status = dosfs_write_back_flush(volume, 0, DOSFS_BLKNO_INVALID);
+	}
+    }
+
+    if (status == F_NO_ERROR)
+    {
+	dosfs_volume_invalidate(volume, address, 1);
+
+	if (volume->wb_blkcnt == 0)
+	{
+	    volume->wb_file = file;
+	    volume->wb_blkno = address;
+	}
+
+	memcpy(volume->wb_data + (volume->wb_blkcnt * DOSFS_BLK_SIZE), data, DOSFS_BLK_SIZE);
+
+	volume->wb_blkcnt++;
+
+	/* Don't let a multi block write straddle an allocation unit boundary,
+	 * as this would cost the card an extra erase/program cycle.
+	 */
+	if ((volume->wb_blkcnt == DOSFS_CONFIG_WRITE_BACK_ENTRIES)
+#if (DOSFS_CONFIG_SEQUENTIAL_SUPPORTED == 1) || (DOSFS_CONFIG_CONTIGUOUS_SUPPORTED == 1)
+	    || !((volume->wb_blkno + volume->wb_blkcnt) % volume->au_size)
+#endif /* (DOSFS_CONFIG_SEQUENTIAL_SUPPORTED == 1) || (DOSFS_CONFIG_CONTIGUOUS_SUPPORTED == 1) */
+	    )
+	{
+	    status = dosfs_write_back_flush(volume, 0, DOSFS_BLKNO_INVALID);
+	}
+    }
+
+    return status;
+}
+
+#endif /* (DOSFS_CONFIG_WRITE_BACK_ENTRIES != 0) */
+
+static int dosfs_volume_read(dosfs_volume_t *volume, uint32_t address, uint8_t *data)
+{
+    int status = F_NO_ERROR;
+    dosfs_device_t *device;
+    uint32_t index;
+#if (DOSFS_CONFIG_META_DATA_RETRIES != 0)
+    unsigned int retries = DOSFS_CONFIG_META_DATA_RETRIES +1;
+#else /* (DOSFS_CONFIG_META_DATA_RETRIES != 0) */
+    unsigned int retries = 0;
+#endif /* (DOSFS_CONFIG_META_DATA_RETRIES != 0) */
+
+    device = DOSFS_VOLUME_DEVICE(volume);
+
+    if (volume->sector_count)
+    {
+	index = dosfs_sector_cache_lookup(volume, address);
+
+	if (index != volume->sector_count)
+	{
+	    volume->sector_hits++;
+	    device->statistics.cache_hits++;
+	    volume->sector_stamp[index] = ++volume->sector_clock;
+
+	    memcpy(data, volume->sector_data + (index * DOSFS_BLK_SIZE), DOSFS_BLK_SIZE);
+
+	    return F_NO_ERROR;
+	}
+
+	volume->sector_misses++;
+	device->statistics.cache_misses++;
+    }
+
+#if (DOSFS_CONFIG_WRITE_BACK_ENTRIES != 0)
+    status = dosfs_write_back_flush(volume, address, 1);
+
+    if (status != F_NO_ERROR)
+    {
+	return status;
+    }
+#endif /* (DOSFS_CONFIG_WRITE_BACK_ENTRIES != 0) */
+
+    do
+    {
+	status = dosfs_device_read(device, address, data, 1, false);
+		
+	if ((status == F_ERR_ONDRIVE) && (retries >= 1))
+	{
+	    status = F_NO_ERROR;
+	    retries--;
+
+	    device->statistics.retries++;
+	}
+	else
+	{
+	    retries = 0;
+	}
+    }
+    while ((status == F_NO_ERROR) && retries);
+
+#if (DOSFS_CONFIG_MEDIA_FAILURE_SUPPORTED == 1)
+    if (status == F_ERR_INVALIDSECTOR)
+    {
+	volume->flags |= DOSFS_VOLUME_FLAG_MEDIA_FAILURE;
+    }
+#endif /* (DOSFS_CONFIG_MEDIA_FAILURE_SUPPORTED == 1) */
+
+    if (status != F_NO_ERROR)
+    {
+	if (status != F_ERR_CARDREMOVED)
+	{
+	    status = F_ERR_UNUSABLE;
+	}
+    }
+    else
+    {
+	if (volume->sector_count)
+	{
+	    dosfs_sector_cache_insert(volume, address, data);
+	}
+    }
+
+    return status;
+}
+
+static int dosfs_volume_write(dosfs_volume_t *volume, uint32_t address, const uint8_t *data)
+{
+    int status = F_NO_ERROR;
+    dosfs_device_t *device;
+#if (DOSFS_CONFIG_META_DATA_RETRIES != 0)
+    unsigned int retries = DOSFS_CONFIG_META_DATA_RETRIES +1;
+#else /* (DOSFS_CONFIG_META_DATA_RETRIES != 0) */
+    unsigned int retries = 0;
+#endif /* (DOSFS_CONFIG_META_DATA_RETRIES != 0) */
+
+    device = DOSFS_VOLUME_DEVICE(volume);
+
+#if (DOSFS_CONFIG_WRITE_BACK_ENTRIES != 0)
+    status = dosfs_write_back_flush(volume, address, 1);
+
+    if (status != F_NO_ERROR)
+    {
+	return status;
+    }
+#endif /* (DOSFS_CONFIG_WRITE_BACK_ENTRIES != 0) */
+
+    do
+    {
+	status = dosfs_device_write(device, address, data, 1, NULL);
+		
+	if ((status == F_ERR_ONDRIVE) && (retries >= 1))
+	{
+	    status = F_NO_ERROR;
+	    retries--;
+
+	    device->statistics.retries++;
+	}
+	else
+	{
+	    retries = 0;
+	}
+    }
+    while ((status == F_NO_ERROR) && retries);
+
+#if (DOSFS_CONFIG_MEDIA_FAILURE_SUPPORTED == 1)
+    if (status == F_ERR_INVALIDSECTOR)
+    {
+	volume->flags |= DOSFS_VOLUME_FLAG_MEDIA_FAILURE;
+    }
+#endif /* (DOSFS_CONFIG_MEDIA_FAILURE_SUPPORTED == 1) */
+
+    if (status != F_NO_ERROR)
+    {
 	if (status != F_ERR_CARDREMOVED)
 	{
 	    status = F_ERR_UNUSABLE;
@@ -1081,6 +1685,15 @@ static int dosfs_volume_write(dosfs_volume_t *volume, uint32_t address, const ui
     if (status == F_NO_ERROR)
     {
 	device->lock |= DOSFS_DEVICE_LOCK_MODIFIED;
+
+	if (volume->sector_count)
+	{
+	    dosfs_sector_cache_insert(volume, address, data);
+	}
+    }
+    else
+    {
+	dosfs_volume_invalidate(volume, address, 1);
     }
 
     return status;
@@ -1096,6 +1709,13 @@ static int  dosfs_volume_zero(dosfs_volume_t *volume, uint32_t address, uint32_t
 
     status = dosfs_dir_cache_flush(volume);
 
+#if (DOSFS_CONFIG_WRITE_BACK_ENTRIES != 0)
+    if (status == F_NO_ERROR)
+    {
+	status = dosfs_write_back_flush(volume, address, length);
+    }
+#endif /* (DOSFS_CONFIG_WRITE_BACK_ENTRIES != 0) */
+
     if (status == F_NO_ERROR)
     {
 	data = volume->dir_cache.data;
@@ -1103,11 +1723,13 @@ static int  dosfs_volume_zero(dosfs_volume_t *volume, uint32_t address, uint32_t
 	
 	memset(data, 0, DOSFS_BLK_SIZE);
 
+	dosfs_volume_invalidate(volume, address, length);
+
 	zero_status = F_NO_ERROR;
 
 	do
 	{
-	    status = (*device->interface->write)(device->context, address, data, 1, (p_status ? p_status : &zero_status));
+	    status = dosfs_device_write(device, address, data, 1, (p_status ? p_status : &zero_status));
 
 	    if (status == F_NO_ERROR)
 	    {
@@ -1123,7 +1745,7 @@ static int  dosfs_volume_zero(dosfs_volume_t *volume, uint32_t address, uint32_t
 	{
 	    if (status == F_NO_ERROR)
 	    {
-		status = (*device->interface->sync)(device->context, true);
+		status = dosfs_device_sync(device, true);
 
 		if (status == F_NO_ERROR)
 		{
@@ -2015,6 +2637,13 @@ static int dosfs_volume_format(dosfs_volume_t *volume)
 	    user_blkcnt = ((volume->last_clsno -2) << volume->cls_blk_shift);
 	}
 
+	dosfs_volume_invalidate(volume, 0, DOSFS_BLKNO_INVALID);
+
+#if (DOSFS_CONFIG_WRITE_BACK_ENTRIES != 0)
+	volume->wb_file = NULL;
+	volume->wb_blkcnt = 0;
+#endif /* (DOSFS_CONFIG_WRITE_BACK_ENTRIES != 0) */
+
 	status = (*device->interface->discard)(device->context, user_blkno, user_blkcnt);
     }
 
@@ -2035,7 +2664,13 @@ static int dosfs_dir_cache_write(dosfs_volume_t *volume)
     {
 	dosfs_file_t *file = volume->data_file;
 
-	status = (*device->interface->write)(device->context, volume->dir_cache.blkno, volume->dir_cache.data, 1, &file->status);
+#if (DOSFS_CONFIG_WRITE_BACK_ENTRIES != 0)
+	status = dosfs_write_back_insert(volume, file, volume->dir_cache.blkno, volume->dir_cache.data);
+#else /* (DOSFS_CONFIG_WRITE_BACK_ENTRIES != 0) */
+	dosfs_volume_invalidate(volume, volume->dir_cache.blkno, 1);
+
+	status = dosfs_device_write(device, volume->dir_cache.blkno, volume->dir_cache.data, 1, &file->status);
+#endif /* (DOSFS_CONFIG_WRITE_BACK_ENTRIES != 0) */
 
 #if (DOSFS_CONFIG_MEDIA_FAILURE_SUPPORTED == 1)
 	if (status == F_ERR_INVALIDSECTOR)
@@ -2160,14 +2795,14 @@ static int dosfs_dir_cache_read(dosfs_volume_t *volume, uint32_t blkno, dosfs_ca
 
     if (volume->dir_cache.blkno != blkno)
     {
-	DOSFS_VOLUME_STATISTICS_COUNT(dir_cache_miss);
+	DOSFS_VOLUME_CACHE_MISS(dir_cache_miss);
 	DOSFS_VOLUME_STATISTICS_COUNT(dir_cache_read);
 
 	status = dosfs_dir_cache_fill(volume, blkno, FALSE);
     }
     else
     {
-	DOSFS_VOLUME_STATISTICS_COUNT(dir_cache_hit);
+	DOSFS_VOLUME_CACHE_HIT(dir_cache_hit);
     }
 
     *p_entry = &volume->dir_cache;
@@ -2181,14 +2816,14 @@ static int dosfs_dir_cache_zero(dosfs_volume_t *volume, uint32_t blkno, dosfs_ca
 
     if (volume->dir_cache.blkno != blkno)
     {
-	DOSFS_VOLUME_STATISTICS_COUNT(dir_cache_miss);
+	DOSFS_VOLUME_CACHE_MISS(dir_cache_miss);
 	DOSFS_VOLUME_STATISTICS_COUNT(dir_cache_zero);
 
 	status = dosfs_dir_cache_fill(volume, blkno, TRUE);
     }
     else
     {
-	DOSFS_VOLUME_STATISTICS_COUNT(dir_cache_hit);
+	DOSFS_VOLUME_CACHE_HIT(dir_cache_hit);
     }
 
     *p_entry = &volume->dir_cache;
@@ -2639,7 +3274,7 @@ static int dosfs_fat_cache_fill(dosfs_volume_t *volume, uint32_t blkno, dosfs_ca
 
     if (status == F_NO_ERROR)
     {
-	DOSFS_VOLUME_STATISTICS_COUNT(fat_cache_miss);
+	DOSFS_VOLUME_CACHE_MISS(fat_cache_miss);
 
 #if (DOSFS_CONFIG_TRANSACTION_SAFE_SUPPORTED == 1)
 	status = dosfs_map_cache_read(volume, blkno, volume->fat_cache.data);
@@ -2670,7 +3305,7 @@ static int dosfs_fat_cache_read(dosfs_volume_t *volume, uint32_t blkno, dosfs_ca
     }
     else
     {
-	DOSFS_VOLUME_STATISTICS_COUNT(fat_cache_hit);
+	DOSFS_VOLUME_CACHE_HIT(fat_cache_hit);
 
 	*p_entry = &volume->fat_cache;
     }
@@ -2752,7 +3387,7 @@ static int dosfs_fat_cache_fill(dosfs_volume_t *volume, uint32_t blkno, dosfs_ca
     {
 	if (volume->fat_cache[index].blkno != blkno)
 	{
-	    DOSFS_VOLUME_STATISTICS_COUNT(fat_cache_miss);
+	    DOSFS_VOLUME_CACHE_MISS(fat_cache_miss);
 	    DOSFS_VOLUME_STATISTICS_COUNT(fat_cache_read);
 	    
 #if (DOSFS_CONFIG_TRANSACTION_SAFE_SUPPORTED == 1)
@@ -2780,7 +3415,7 @@ static int dosfs_fat_cache_fill(dosfs_volume_t *volume, uint32_t blkno, dosfs_ca
 	}
 	else
 	{
-	    DOSFS_VOLUME_STATISTICS_COUNT(fat_cache_hit);
+	    DOSFS_VOLUME_CACHE_HIT(fat_cache_hit);
 
 	    volume->flags ^= DOSFS_VOLUME_FLAG_FAT_INDEX_CURRENT;
 	}
@@ -2804,7 +3439,7 @@ static int dosfs_fat_cache_read(dosfs_volume_t *volume, uint32_t blkno, dosfs_ca
     }
     else
     {
-	DOSFS_VOLUME_STATISTICS_COUNT(fat_cache_hit);
+	DOSFS_VOLUME_CACHE_HIT(fat_cache_hit);
 
 	*p_entry = &volume->fat_cache[index];
     }
@@ -2864,7 +3499,7 @@ static int dosfs_fat_cache_fill(dosfs_volume_t *volume, uint32_t blkno, dosfs_ca
 
     if (status == F_NO_ERROR)
     {
-	DOSFS_VOLUME_STATISTICS_COUNT(fat_cache_miss);
+	DOSFS_VOLUME_CACHE_MISS(fat_cache_miss);
 
 	status = dosfs_map_cache_read(volume, blkno, volume->dir_cache.data);
 	
@@ -2887,14 +3522,14 @@ static int dosfs_fat_cache_read(dosfs_volume_t *volume, uint32_t blkno, dosfs_ca
 
     if (volume->dir_cache.blkno != blkno)
     {
-	DOSFS_VOLUME_STATISTICS_COUNT(fat_cache_miss);
+	DOSFS_VOLUME_CACHE_MISS(fat_cache_miss);
 	DOSFS_VOLUME_STATISTICS_COUNT(fat_cache_read);
 
 	status = dosfs_fat_cache_fill(volume, blkno, p_entry);
     }
     else
     {
-	DOSFS_VOLUME_STATISTICS_COUNT(fat_cache_hit);
+	DOSFS_VOLUME_CACHE_HIT(fat_cache_hit);
 
 	*p_entry = &volume->dir_cache;
     }
@@ -2923,14 +3558,14 @@ static int dosfs_fat_cache_read(dosfs_volume_t *volume, uint32_t blkno, dosfs_ca
 
     if (volume->dir_cache.blkno != blkno)
     {
-	DOSFS_VOLUME_STATISTICS_COUNT(fat_cache_miss);
+	DOSFS_VOLUME_CACHE_MISS(fat_cache_miss);
 	DOSFS_VOLUME_STATISTICS_COUNT(fat_cache_read);
 
 	status = dosfs_dir_cache_fill(volume, blkno, FALSE);
     }
     else
     {
-	DOSFS_VOLUME_STATISTICS_COUNT(fat_cache_hit);
+	DOSFS_VOLUME_CACHE_HIT(fat_cache_hit);
     }
 
     *p_entry = &volume->dir_cache;
@@ -2982,7 +3617,9 @@ static int dosfs_data_cache_write(dosfs_volume_t *volume, dosfs_file_t *file)
 
     device = DOSFS_VOLUME_DEVICE(volume);
 
-    status = (*device->interface->write)(device->context, file->data_cache.blkno, file->data_cache.data, 1, &file->status);
+    dosfs_volume_invalidate(volume, file->data_cache.blkno, 1);
+
+    status = dosfs_device_write(device, file->data_cache.blkno, file->data_cache.data, 1, &file->status);
 
 #if (DOSFS_CONFIG_MEDIA_FAILURE_SUPPORTED == 1)
     if (status == F_ERR_INVALIDSECTOR)
@@ -3029,7 +3666,7 @@ static int dosfs_data_cache_fill(dosfs_volume_t *volume, dosfs_file_t *file, uin
 
     if (status == F_NO_ERROR)
     {
-	DOSFS_VOLUME_STATISTICS_COUNT(data_cache_miss);
+	DOSFS_VOLUME_CACHE_MISS(data_cache_miss);
 
 	if (zero)
 	{
@@ -3041,7 +3678,7 @@ static int dosfs_data_cache_fill(dosfs_volume_t *volume, dosfs_file_t *file, uin
 	}
 	else
 	{
-	  status = (*device->interface->read)(device->context, blkno, file->data_cache.data, 1, !!(file->mode & DOSFS_FILE_MODE_SEQUENTIAL));
+	  status = dosfs_device_read(device, blkno, file->data_cache.data, 1, DOSFS_FILE_PREFETCH(file));
 
 #if (DOSFS_CONFIG_MEDIA_FAILURE_SUPPORTED == 1)
 	    if (status == F_ERR_INVALIDSECTOR)
@@ -3070,7 +3707,7 @@ static int dosfs_data_cache_fill(dosfs_volume_t *volume, dosfs_file_t *file, uin
     return status;
 }
 
-static int dosfs_data_cache_read(dosfs_volume_t *volume, dosfs_file_t *file, uint32_t blkno, dosfs_cache_entry_t ** p_entry)
+static __optimize_speed int dosfs_data_cache_read(dosfs_volume_t *volume, dosfs_file_t *file, uint32_t blkno, dosfs_cache_entry_t ** p_entry)
 {
     int status = F_NO_ERROR;
 
@@ -3080,7 +3717,7 @@ static int dosfs_data_cache_read(dosfs_volume_t *volume, dosfs_file_t *file, uin
     }
     else
     {
-	DOSFS_VOLUME_STATISTICS_COUNT(data_cache_hit);
+	DOSFS_VOLUME_CACHE_HIT(data_cache_hit);
     }
 
     *p_entry = &file->data_cache;
@@ -3098,7 +3735,7 @@ static int dosfs_data_cache_zero(dosfs_volume_t *volume, dosfs_file_t *file, uin
     }
     else
     {
-	DOSFS_VOLUME_STATISTICS_COUNT(data_cache_hit);
+	DOSFS_VOLUME_CACHE_HIT(data_cache_hit);
     }
 
     *p_entry = &file->data_cache;
@@ -3125,6 +3762,16 @@ static int dosfs_data_cache_flush(dosfs_volume_t *volume, dosfs_file_t *file)
     return status;
 }
 
+/* A partial block read of a DOSFS_FILE_FLAG_NO_CACHE file does not leave its block behind.
+ */
+static inline void dosfs_data_cache_release(dosfs_volume_t *volume, dosfs_file_t *file)
+{
+    if ((file->flags & (DOSFS_FILE_FLAG_NO_CACHE | DOSFS_FILE_FLAG_DATA_DIRTY)) == DOSFS_FILE_FLAG_NO_CACHE)
+    {
+	file->data_cache.blkno = DOSFS_BLKNO_INVALID;
+    }
+}
+
 static int dosfs_data_cache_invalidate(dosfs_volume_t *volume, dosfs_file_t *file, uint32_t blkno, uint32_t blkcnt)
 {
     int status = F_NO_ERROR;
@@ -3150,7 +3797,9 @@ static int dosfs_data_cache_write(dosfs_volume_t *volume, dosfs_file_t *file)
 
     device = DOSFS_VOLUME_DEVICE(volume);
 
-    status = (*device->interface->write)(device->context, volume->data_cache.blkno, volume->data_cache.data, 1, &file->status);
+    dosfs_volume_invalidate(volume, volume->data_cache.blkno, 1);
+
+    status = dosfs_device_write(device, volume->data_cache.blkno, volume->data_cache.data, 1, &file->status);
 
 #if (DOSFS_CONFIG_MEDIA_FAILURE_SUPPORTED == 1)
     if (status == F_ERR_INVALIDSECTOR)
@@ -3196,7 +3845,7 @@ static int dosfs_data_cache_fill(dosfs_volume_t *volume, dosfs_file_t *file, uin
 
     if (status == F_NO_ERROR)
     {
-	DOSFS_VOLUME_STATISTICS_COUNT(data_cache_miss);
+	DOSFS_VOLUME_CACHE_MISS(data_cache_miss);
 
 	if (zero)
 	{
@@ -3208,7 +3857,7 @@ static int dosfs_data_cache_fill(dosfs_volume_t *volume, dosfs_file_t *file, uin
 	}
 	else
 	{
-            status = (*device->interface->read)(device->context, blkno, volume->data_cache.data, 1, !!(file->mode & DOSFS_FILE_MODE_SEQUENTIAL));
+            status = dosfs_device_read(device, blkno, volume->data_cache.data, 1, DOSFS_FILE_PREFETCH(file));
 
 #if (DOSFS_CONFIG_MEDIA_FAILURE_SUPPORTED == 1)
 	    if (status == F_ERR_INVALIDSECTOR)
@@ -3237,7 +3886,7 @@ static int dosfs_data_cache_fill(dosfs_volume_t *volume, dosfs_file_t *file, uin
     return status;
 }
 
-static int dosfs_data_cache_read(dosfs_volume_t *volume, dosfs_file_t *file, uint32_t blkno, dosfs_cache_entry_t ** p_entry)
+static __optimize_speed int dosfs_data_cache_read(dosfs_volume_t *volume, dosfs_file_t *file, uint32_t blkno, dosfs_cache_entry_t ** p_entry)
 {
     int status = F_NO_ERROR;
 
@@ -3247,7 +3896,7 @@ static int dosfs_data_cache_read(dosfs_volume_t *volume, dosfs_file_t *file, uin
     }
     else
     {
-	DOSFS_VOLUME_STATISTICS_COUNT(data_cache_hit);
+	DOSFS_VOLUME_CACHE_HIT(data_cache_hit);
     }
 
     *p_entry = &volume->data_cache;
@@ -3265,7 +3914,7 @@ static int dosfs_data_cache_zero(dosfs_volume_t *volume, dosfs_file_t *file, uin
     }
     else
     {
-	DOSFS_VOLUME_STATISTICS_COUNT(data_cache_hit);
+	DOSFS_VOLUME_CACHE_HIT(data_cache_hit);
     }
 
     *p_entry = &volume->data_cache;
@@ -3292,6 +3941,14 @@ static int dosfs_data_cache_flush(dosfs_volume_t *volume, dosfs_file_t *file)
     return status;
 }
 
+static inline void dosfs_data_cache_release(dosfs_volume_t *volume, dosfs_file_t *file)
+{
+    if ((file->flags & DOSFS_FILE_FLAG_NO_CACHE) && !volume->data_file)
+    {
+	volume->data_cache.blkno = DOSFS_BLKNO_INVALID;
+    }
+}
+
 static int dosfs_data_cache_invalidate(dosfs_volume_t *volume, dosfs_file_t *file, uint32_t blkno, uint32_t blkcnt)
 {
     int status = F_NO_ERROR;
@@ -3355,7 +4012,14 @@ static int dosfs_data_cache_fill(dosfs_volume_t *volume, dosfs_file_t *file, uin
 	}
 	else
 	{
-            status = (*device->interface->read)(device->context, blkno, volume->dir_cache.data, 1, !!(file->mode & DOSFS_FILE_MODE_SEQUENTIAL));
+#if (DOSFS_CONFIG_WRITE_BACK_ENTRIES != 0)
+	    status = dosfs_write_back_flush(volume, blkno, 1);
+
+	    if (status == F_NO_ERROR)
+#endif /* (DOSFS_CONFIG_WRITE_BACK_ENTRIES != 0) */
+	    {
+		status = dosfs_device_read(device, blkno, volume->dir_cache.data, 1, DOSFS_FILE_PREFETCH(file));
+	    }
 
 #if (DOSFS_CONFIG_MEDIA_FAILURE_SUPPORTED == 1)
 	    if (status == F_ERR_INVALIDSECTOR)
@@ -3382,20 +4046,20 @@ static int dosfs_data_cache_fill(dosfs_volume_t *volume, dosfs_file_t *file, uin
     return status;
 }
 
-static int dosfs_data_cache_read(dosfs_volume_t *volume, dosfs_file_t *file, uint32_t blkno, dosfs_cache_entry_t ** p_entry)
+static __optimize_speed int dosfs_data_cache_read(dosfs_volume_t *volume, dosfs_file_t *file, uint32_t blkno, dosfs_cache_entry_t ** p_entry)
 {
     int status = F_NO_ERROR;
 
     if (volume->dir_cache.blkno != blkno)
     {
-	DOSFS_VOLUME_STATISTICS_COUNT(data_cache_miss);
+	DOSFS_VOLUME_CACHE_MISS(data_cache_miss);
 	DOSFS_VOLUME_STATISTICS_COUNT(data_cache_read);
 
 	status = dosfs_data_cache_fill(volume, file, blkno, FALSE);
     }
     else
     {
-	DOSFS_VOLUME_STATISTICS_COUNT(data_cache_hit);
+	DOSFS_VOLUME_CACHE_HIT(data_cache_hit);
     }
 
     *p_entry = &volume->dir_cache;
@@ -3409,7 +4073,7 @@ static int dosfs_data_cache_zero(dosfs_volume_t *volume, dosfs_file_t *file, uin
 
     if (volume->dir_cache.blkno != blkno)
     {
-	DOSFS_VOLUME_STATISTICS_COUNT(data_cache_miss);
+	DOSFS_VOLUME_CACHE_MISS(data_cache_miss);
 	DOSFS_VOLUME_STATISTICS_COUNT(data_cache_zero);
 
 	status = dosfs_data_cache_fill(volume, file, blkno, TRUE);
@@ -3436,9 +4100,29 @@ static int dosfs_data_cache_flush(dosfs_volume_t *volume, dosfs_file_t *file)
 	status = dosfs_data_cache_write(volume, file);
     }
 
+#if (DOSFS_CONFIG_WRITE_BACK_ENTRIES != 0)
+    if ((status == F_NO_ERROR) && (volume->wb_file == file))
+    {
+	status = dosfs_write_back_flush(volume, 0, DOSFS_BLKNO_INVALID);
+
+	if (file->status != F_NO_ERROR)
+	{
+	    status = file->status;
+	}
+    }
+#endif /* (DOSFS_CONFIG_WRITE_BACK_ENTRIES != 0) */
+
     return status;
 }
 
+static inline void dosfs_data_cache_release(dosfs_volume_t *volume, dosfs_file_t *file)
+{
+    if ((file->flags & DOSFS_FILE_FLAG_NO_CACHE) && !volume->data_file)
+    {
+	volume->dir_cache.blkno = DOSFS_BLKNO_INVALID;
+    }
+}
+
 static int dosfs_data_cache_invalidate(dosfs_volume_t *volume, dosfs_file_t *file, uint32_t blkno, uint32_t blkcnt)
 {
     int status = F_NO_ERROR;
@@ -3453,6 +4137,13 @@ static int dosfs_data_cache_invalidate(dosfs_volume_t *volume, dosfs_file_t *fil
 	volume->data_file = NULL;
     }
 
+#if (DOSFS_CONFIG_WRITE_BACK_ENTRIES != 0)
+    /* Pending blocks in the range are about to be overwritten, but need to hit
+     * the disk first to keep the order of writes.
+     */
+    status = dosfs_write_back_flush(volume, blkno, blkcnt);
+#endif /* (DOSFS_CONFIG_WRITE_BACK_ENTRIES != 0) */
+
     return status;
 }
 
@@ -3564,7 +4255,7 @@ static int dosfs_cluster_read_uncached(dosfs_volume_t *volume, uint32_t clsno, u
 
 #if (DOSFS_CONFIG_CLUSTER_CACHE_ENTRIES != 0)
 
-static int dosfs_cluster_read(dosfs_volume_t *volume, uint32_t clsno, uint32_t *p_clsdata)
+static __optimize_speed int dosfs_cluster_read(dosfs_volume_t *volume, uint32_t clsno, uint32_t *p_clsdata)
 {
     int status = F_NO_ERROR;
     uint32_t clsdata;
@@ -3574,7 +4265,7 @@ static int dosfs_cluster_read(dosfs_volume_t *volume, uint32_t clsno, uint32_t *
 
     if (volume->cluster_cache[index].clsno != clsno)
     {
-	DOSFS_VOLUME_STATISTICS_COUNT(cluster_cache_miss);
+	DOSFS_VOLUME_CACHE_MISS(cluster_cache_miss);
 
 	status = dosfs_cluster_read_uncached(volume, clsno, &clsdata);
 
@@ -3583,7 +4274,7 @@ static int dosfs_cluster_read(dosfs_volume_t *volume, uint32_t clsno, uint32_t *
     }
     else
     {
-	DOSFS_VOLUME_STATISTICS_COUNT(cluster_cache_hit);
+	DOSFS_VOLUME_CACHE_HIT(cluster_cache_hit);
     }
 
     *p_clsdata = volume->cluster_cache[index].clsdata;
@@ -3600,12 +4291,77 @@ static inline int dosfs_cluster_read(dosfs_volume_t *volume, uint32_t clsno, uin
 
 #endif /* (DOSFS_CONFIG_CLUSTER_CACHE_ENTRIES != 0) */
 
+#if (DOSFS_CONFIG_FREE_BITMAP_ENTRIES != 0)
+
+/* volume->free_bitmap[] records groups of (1 << volume->free_shift) clusters that are known
+ * to have no free cluster, so that scans for free clusters can skip their FAT entries. A bit
+ * gets set only after a scan found the whole group in use, and cleared whenever a cluster
+ * within the group is freed. Hence a clear bit means "unknown"; the bitmap starts out clear
+ * at mount time and fills in lazily as the allocator and f_getfreespace() walk the FAT.
+ */
+
+static void dosfs_free_bitmap_reset(dosfs_volume_t *volume)
+{
+    volume->free_shift = 0;
+
+    while ((volume->last_clsno >> volume->free_shift) >= DOSFS_CONFIG_FREE_BITMAP_ENTRIES)
+    {
+	volume->free_shift++;
+    }
+
+    memset(volume->free_bitmap, 0, sizeof(volume->free_bitmap));
+}
+
+static inline uint32_t dosfs_free_bitmap_first(dosfs_volume_t *volume, uint32_t clsno)
+{
+    clsno = (clsno >> volume->free_shift) << volume->free_shift;
+
+    return ((clsno < 2) ? 2 : clsno);
+}
+
+static inline uint32_t dosfs_free_bitmap_last(dosfs_volume_t *volume, uint32_t clsno)
+{
+    clsno = (((clsno >> volume->free_shift) +1) << volume->free_shift) -1;
+
+    return ((clsno > volume->last_clsno) ? volume->last_clsno : clsno);
+}
+
+static inline bool dosfs_free_bitmap_full(dosfs_volume_t *volume, uint32_t clsno)
+{
+    uint32_t index = clsno >> volume->free_shift;
+
+    return !!(volume->free_bitmap[index >> 5] & (1u << (index & 31)));
+}
+
+static inline void dosfs_free_bitmap_set(dosfs_volume_t *volume, uint32_t clsno)
+{
+    uint32_t index = clsno >> volume->free_shift;
+
+    volume->free_bitmap[index >> 5] |= (1u << (index & 31));
+}
+
+static inline void dosfs_free_bitmap_clear(dosfs_volume_t *volume, uint32_t clsno)
+{
+    uint32_t index = clsno >> volume->free_shift;
+
+    volume->free_bitmap[index >> 5] &= ~(1u << (index & 31));
+}
+
+#endif /* (DOSFS_CONFIG_FREE_BITMAP_ENTRIES != 0) */
+
 static int dosfs_cluster_write(dosfs_volume_t *volume, uint32_t clsno, uint32_t clsdata, int allocate)
 {
     int status = F_NO_ERROR;
     uint32_t offset, blkno;
     dosfs_cache_entry_t *entry;
 
+#if (DOSFS_CONFIG_FREE_BITMAP_ENTRIES != 0)
+    if (clsdata == DOSFS_CLSNO_FREE)
+    {
+	dosfs_free_bitmap_clear(volume, clsno);
+    }
+#endif /* (DOSFS_CONFIG_FREE_BITMAP_ENTRIES != 0) */
+
 #if (DOSFS_CONFIG_FAT12_SUPPORTED == 1)
     if (volume->type == DOSFS_VOLUME_TYPE_FAT12)
     {
@@ -3758,6 +4514,9 @@ static int dosfs_cluster_chain_create(dosfs_volume_t *volume, uint32_t clsno, ui
 {
     int status = F_NO_ERROR;
     uint32_t clsno_a, clsno_f, clsno_n, clsno_l, clscnt_a, clsdata;
+#if (DOSFS_CONFIG_FREE_BITMAP_ENTRIES != 0)
+    uint32_t clsno_g, clsno_s;
+#endif /* (DOSFS_CONFIG_FREE_BITMAP_ENTRIES != 0) */
 
     clsno_f = volume->next_clsno;
     clsno_a = DOSFS_CLSNO_NONE;
@@ -3766,6 +4525,12 @@ static int dosfs_cluster_chain_create(dosfs_volume_t *volume, uint32_t clsno, ui
 
     clscnt_a = 0;
 
+#if (DOSFS_CONFIG_FREE_BITMAP_ENTRIES != 0)
+    /* clsno_g is the start of the group being scanned, if the scan covers the whole group.
+     */
+    clsno_g = (clsno_f == dosfs_free_bitmap_first(volume, clsno_f)) ? clsno_f : DOSFS_CLSNO_NONE;
+#endif /* (DOSFS_CONFIG_FREE_BITMAP_ENTRIES != 0) */
+
     do
     {
 	/* Bypass cluster cache on read while searching.
@@ -3794,14 +4559,51 @@ static int dosfs_cluster_chain_create(dosfs_volume_t *volume, uint32_t clsno, ui
 		    clscnt_a++;
 		}
 	    }
-	    
-	    clsno_n++;
 
-	    if (clsno_n > volume->last_clsno)
+#if (DOSFS_CONFIG_FREE_BITMAP_ENTRIES != 0)
+	    /* Every cluster of the group was either in use, or has been allocated above.
+	     */
+	    if ((status == F_NO_ERROR) && (clsno_g != DOSFS_CLSNO_NONE) && (clsno_n == dosfs_free_bitmap_last(volume, clsno_n)))
+	    {
+		dosfs_free_bitmap_set(volume, clsno_n);
+	    }
+#endif /* (DOSFS_CONFIG_FREE_BITMAP_ENTRIES != 0) */
+	    
+	    clsno_n++;
+
+	    if (clsno_n > volume->last_clsno)
 	    {
 		clsno_n = 2; 
 	    }
 
+#if (DOSFS_CONFIG_FREE_BITMAP_ENTRIES != 0)
+	    while ((clsno_n != clsno_f) && dosfs_free_bitmap_full(volume, clsno_n))
+	    {
+		clsno_s = dosfs_free_bitmap_last(volume, clsno_n) +1;
+
+		if ((clsno_f > clsno_n) && (clsno_f < clsno_s))
+		{
+		    /* The rest of the FAT has been scanned already.
+		     */
+		    clsno_n = clsno_f;
+		}
+		else
+		{
+		    clsno_n = clsno_s;
+
+		    if (clsno_n > volume->last_clsno)
+		    {
+			clsno_n = 2; 
+		    }
+		}
+	    }
+
+	    if (clsno_n == dosfs_free_bitmap_first(volume, clsno_n))
+	    {
+		clsno_g = clsno_n;
+	    }
+#endif /* (DOSFS_CONFIG_FREE_BITMAP_ENTRIES != 0) */
+
 	    if (clsno_n == clsno_f)
 	    {
 		status = F_ERR_NOMOREENTRY;
@@ -4119,6 +4921,10 @@ static int dosfs_cluster_chain_destroy(dosfs_volume_t *volume, uint32_t clsno, u
 			}
 			else
 			{
+#if (DOSFS_CONFIG_WRITE_BACK_ENTRIES != 0)
+			    dosfs_write_back_flush(volume, (volume->cls_blk_offset + (clsno_s << volume->cls_blk_shift)), ((clsno_e - clsno_s + 1) << volume->cls_blk_shift));
+#endif /* (DOSFS_CONFIG_WRITE_BACK_ENTRIES != 0) */
+
 			    (*device->interface->discard)(device->context, (volume->cls_blk_offset + (clsno_s << volume->cls_blk_shift)), ((clsno_e - clsno_s + 1) << volume->cls_blk_shift));
 
 			    clsno_s = clsno;
@@ -4155,6 +4961,10 @@ static int dosfs_cluster_chain_destroy(dosfs_volume_t *volume, uint32_t clsno, u
 
     if (clsno_s != DOSFS_CLSNO_NONE)
     {
+#if (DOSFS_CONFIG_WRITE_BACK_ENTRIES != 0)
+	dosfs_write_back_flush(volume, (volume->cls_blk_offset + (clsno_s << volume->cls_blk_shift)), ((clsno_e - clsno_s + 1) << volume->cls_blk_shift));
+#endif /* (DOSFS_CONFIG_WRITE_BACK_ENTRIES != 0) */
+
 	(*device->interface->discard)(device->context, (volume->cls_blk_offset + (clsno_s << volume->cls_blk_shift)), ((clsno_e - clsno_s + 1) << volume->cls_blk_shift));
     }
 
@@ -5711,8 +6521,10 @@ static int dosfs_path_find_callback_unique(dosfs_volume_t *volume, void *private
 		match = !memcmp(dir->dir_name, volume->dir.dir_name, sizeof(dir->dir_name));
 	    }
 	}
-
-	match = FALSE;
+	else
+	{
+	    match = FALSE;
+	}
     }
 
     return match;
@@ -6276,1299 +7088,3485 @@ static int dosfs_path_find_entry(dosfs_volume_t *volume, uint32_t clsno, uint32_
     return status;
 }
 
-/*
- * filename   incoming full path
- * p_filename last path element 
- * p_clsno    clsno of parent directory of last path element
+#if (DOSFS_CONFIG_DIR_INDEX_ENTRIES != 0)
+
+/* The hash of a name is the sum of a mix of each (upcased) character with its
+ * position. That way it can be accumulated while walking the LDIR entries, which
+ * are stored in reverse order. Short names use positions 0x1000 and up, so
+ * that they do not alias long names.
  */
 
-static int dosfs_path_find_directory(dosfs_volume_t *volume, const char *filename, const char **p_filename, uint32_t *p_clsno)
+static inline uint32_t dosfs_path_index_mix(unsigned int position, unsigned int cc)
 {
-    int status = F_NO_ERROR;
-    unsigned int cc;
-    const char *filename_e;
-    uint32_t clsno;
-    dosfs_dir_t *dir;
+    uint32_t data;
 
-    if (*filename == '\0')
+    data = (position << 16) | cc;
+    data *= 0x9e3779b1;
+    data ^= (data >> 15);
+    data *= 0x85ebca77;
+    data ^= (data >> 13);
+
+    return data;
+}
+
+static inline unsigned int dosfs_path_index_upcase(unsigned int cc)
+{
+#if (DOSFS_CONFIG_UTF8_SUPPORTED == 1)
+    return dosfs_name_unicode_upcase(cc);
+#else /* (DOSFS_CONFIG_UTF8_SUPPORTED == 1) */
+    return (cc < 0x80) ? dosfs_name_ascii_upcase(cc) : cc;
+#endif /* (DOSFS_CONFIG_UTF8_SUPPORTED == 1) */
+}
+
+static inline uint16_t dosfs_path_index_fold(uint32_t hash)
+{
+    return (hash ^ (hash >> 16));
+}
+
+static uint16_t dosfs_path_index_hash_uniname(const dosfs_unicode_t *uniname, unsigned int unicount)
+{
+    unsigned int i;
+    uint32_t hash;
+
+    for (hash = 0, i = 0; i < unicount; i++)
     {
-	status = F_ERR_INVALIDNAME;
+	hash += dosfs_path_index_mix(i, dosfs_path_index_upcase(uniname[i]));
     }
-    else if ((*filename == '/') || (*filename == '\\'))
-    {
-	clsno = DOSFS_CLSNO_NONE;
 
-        filename++;
+    return dosfs_path_index_fold(hash);
+}
+
+static uint16_t dosfs_path_index_hash_dosname(const uint8_t *dosname)
+{
+    unsigned int i;
+    uint32_t hash;
+
+    for (hash = 0, i = 0; i < 11; i++)
+    {
+	hash += dosfs_path_index_mix(0x1000 + i, dosname[i]);
     }
-    else
+
+    return dosfs_path_index_fold(hash);
+}
+
+/* "private" points to 3 words, the accumulated hash of the current entry set, the
+ * number of LDIR entries of the set, and the hash of the short name. Every non-volume
+ * SFN entry is a match.
+ */
+static int dosfs_path_find_callback_index(dosfs_volume_t *volume, void *private, dosfs_dir_t *dir, unsigned int sequence)
+{
+    unsigned int offset, i, s, cc;
+    uint32_t *p_data;
+    int match;
+
+    p_data = (uint32_t*)private;
+
+    if (sequence & DOSFS_LDIR_SEQUENCE_INDEX)
     {
-	if (volume->cwd_clsno != DOSFS_CLSNO_END_OF_CHAIN)
-	{
-	    clsno = volume->cwd_clsno;
-	}
-	else
+	if (sequence & DOSFS_LDIR_SEQUENCE_FIRST)
 	{
-	    status = F_ERR_INVALIDDIR;
+	    p_data[0] = 0;
+	    p_data[1] = (sequence & DOSFS_LDIR_SEQUENCE_INDEX);
 	}
-    }
 
-    if (status == F_NO_ERROR)
-    {
+	s = 0;
+	i = ((sequence & DOSFS_LDIR_SEQUENCE_INDEX) -1) * 13;
+
 	do
 	{
-	    /* Scan ahead to see whether there is a directory left.
-	     */
-	    filename_e = filename;
+	    offset = dosfs_path_ldir_name_table[s++];
 	    
-	    do
+	    cc = (((uint8_t*)dir)[offset +1] << 8) | ((uint8_t*)dir)[offset +0];
+
+	    if (cc != 0x0000)
 	    {
-		cc = *filename_e++;
+		p_data[0] += dosfs_path_index_mix(i++, dosfs_path_index_upcase(cc));
 	    }
-	    while ((cc != '/') && (cc != '\\') && (cc != '\0'));
-	    
-	    if ((cc == '/') || (cc == '\\'))
-	    {
-		status = dosfs_path_convert_filename(volume, filename, &filename);
+	}
+	while ((s < 13) && (cc != 0x0000));
 
-		if (status == F_NO_ERROR)
-		{
-		    if ((volume->dir.dir_name[0] == '.') && (volume->dir.dir_name[1] == ' '))
-		    {
-			/* This is a special case here, as there is no "." or ".." entry
-			 * in the root directory.
-			 */
-		    }
-		    else
-		    {
-			status = dosfs_path_find_entry(volume, clsno, 0, 0, dosfs_path_find_callback_name, NULL, NULL, NULL, &dir);
+	match = TRUE;
+    }
+    else
+    {
+	if (!(dir->dir_attr & DOSFS_DIR_ATTR_VOLUME_ID))
+	{
+	    p_data[2] = dosfs_path_index_hash_dosname(dir->dir_name);
 
-			if (status == F_NO_ERROR)
-			{
-			    if (dir != NULL)
-			    {
-				if (dir->dir_attr & DOSFS_DIR_ATTR_DIRECTORY)
-				{
-				    if (volume->type == DOSFS_VOLUME_TYPE_FAT32)
-				    {
-					clsno = ((uint32_t)DOSFS_FTOHS(dir->dir_clsno_hi) << 16) | (uint32_t)DOSFS_FTOHS(dir->dir_clsno_lo);
-				    }
-				    else
-				    { 
-					clsno = (uint32_t)DOSFS_FTOHS(dir->dir_clsno_lo);
-				    }
-				}
-				else
-				{
-				    status = F_ERR_INVALIDDIR;
-				}
-			    }
-			    else
-			    {
-				status = F_ERR_INVALIDDIR;
-			    }
-			}
-		    }
-		}
+	    if (sequence == DOSFS_LDIR_SEQUENCE_LAST)
+	    {
+		p_data[0] = dosfs_path_index_fold(p_data[0]);
+	    }
+	    else
+	    {
+		p_data[0] = p_data[2];
+		p_data[1] = 0;
 	    }
-	}
-	while ((status == F_NO_ERROR) && ((cc == '/') || (cc == '\\')));
-    }
 
-    if (status == F_NO_ERROR)
-    {
-	*p_filename = filename;
-        *p_clsno = clsno;
+	    match = TRUE;
+	}
+	else
+	{
+	    match = FALSE;
+	}
     }
 
-    return status;
+    return match;
 }
 
-static int dosfs_path_find_file(dosfs_volume_t *volume, const char *filename, uint32_t *p_clsno, uint32_t *p_index, dosfs_dir_t **p_dir)
+/* Verifies the entry set an index entry points to. "private" points to a state,
+ * which is 0 while looking at the first set, 1 after it did not match and 2
+ * if it matched. After the first set the scan is stopped at the next SFN entry.
+ */
+static int dosfs_path_find_callback_indexed(dosfs_volume_t *volume, void *private, dosfs_dir_t *dir, unsigned int sequence)
 {
-    int status = F_NO_ERROR;
-    uint32_t clsno_d;
+    unsigned int *p_state;
+    int match;
 
-    status = dosfs_path_find_directory(volume, filename, &filename, &clsno_d);
+    p_state = (unsigned int*)private;
 
-    if (status == F_NO_ERROR)
+    if (*p_state != 0)
     {
-	status = dosfs_path_convert_filename(volume, filename, NULL);
+	match = TRUE;
+    }
+    else
+    {
+	match = dosfs_path_find_callback_name(volume, NULL, dir, sequence);
 
-	if (status == F_NO_ERROR)
+	if (sequence & DOSFS_LDIR_SEQUENCE_INDEX)
 	{
-	    status = dosfs_path_find_entry(volume, clsno_d, 0, 0, dosfs_path_find_callback_name, NULL, p_clsno, p_index, p_dir);
-	    
-	    if (status == F_NO_ERROR)
+	    if (!match)
 	    {
-		if (*p_dir == NULL)
-		{
-		    status = F_ERR_NOTFOUND;
-		}
+		*p_state = 1;
 	    }
 	}
+	else
+	{
+	    *p_state = match ? 2 : 1;
+
+	    match = TRUE;
+	}
     }
 
-    return status;
+    return match;
 }
 
-static int dosfs_path_find_next(dosfs_volume_t *volume, F_FIND *find)
+/* Builds the name index for the directory "clsno_d". If the directory does
+ * not fit, the index is marked as incomplete so that lookups fall back to a
+ * linear scan without retrying the build. Any modification of a directory
+ * entry throws the index away.
+ */
+static int dosfs_path_index_build(dosfs_volume_t *volume, uint32_t clsno_d)
 {
     int status = F_NO_ERROR;
-    char *filename;
-    uint32_t clsno, index;
+    uint32_t clsno, clsdata, index, count, data[3];
     dosfs_dir_t *dir;
 
-    status = dosfs_path_find_entry(volume, find->find_clsno, find->find_index, 0, dosfs_path_find_callback_pattern, find->find_pattern, &clsno, &index, &dir);
+    volume->index_clsno = clsno_d;
+    volume->index_count = DOSFS_INDEX_COUNT_INCOMPLETE;
+    volume->index_clscnt = 0;
+    volume->index_tail = 0;
 
-    if (status == F_NO_ERROR)
+    /* Record the cluster chain, so that the cluster of an entry follows
+     * from its index. The FAT12/FAT16 root directory does not have one.
+     */
+    clsno = (clsno_d == DOSFS_CLSNO_NONE) ? volume->root_clsno : clsno_d;
+
+    while ((status == F_NO_ERROR) && (clsno != DOSFS_CLSNO_NONE))
     {
-	if (dir != NULL)
+	if (volume->index_clscnt == DOSFS_CONFIG_DIR_INDEX_CLUSTERS)
 	{
-#if (DOSFS_CONFIG_VFAT_SUPPORTED == 1)
-	    /* It's possible to have a sfn_name only ("." and ".." for example).
-	     */
-	    if (volume->lfn_count)
+	    break;
+	}
+
+	volume->index_cluster[volume->index_clscnt++] = clsno;
+
+	status = dosfs_cluster_read(volume, clsno, &clsdata);
+
+	if (status == F_NO_ERROR)
+	{
+	    if (clsdata >= DOSFS_CLSNO_LAST)
 	    {
-		filename = dosfs_name_uniname_to_cstring(volume->lfn_name, volume->lfn_count, find->filename, (find->filename + sizeof(find->filename)));
+		clsno = DOSFS_CLSNO_NONE;
 	    }
 	    else
-#endif /* (DOSFS_CONFIG_VFAT_SUPPORTED == 1) */
-	    {
-		filename = dosfs_name_dosname_to_cstring(dir->dir_name, dir->dir_nt_reserved, find->filename, (find->filename + sizeof(find->filename)));
-	    }
-
-	    if (filename != NULL)
 	    {
-		memcpy(&find->name[0], &dir->dir_name[0], (F_MAXNAME+F_MAXEXT));
-		
-		find->attr = dir->dir_attr;
-		find->ctime = DOSFS_FTOHS(dir->dir_wrt_time);
-		find->cdate = DOSFS_FTOHS(dir->dir_wrt_date);
-		find->filesize = DOSFS_FTOHL(dir->dir_file_size);
-
-		if (volume->type == DOSFS_VOLUME_TYPE_FAT32)
+		if ((clsdata >= 2) && (clsdata <= volume->last_clsno))
 		{
-		    find->cluster = ((uint32_t)DOSFS_FTOHS(dir->dir_clsno_hi) << 16) | (uint32_t)DOSFS_FTOHS(dir->dir_clsno_lo);
+		    clsno = clsdata;
 		}
 		else
 		{
-		    find->cluster = (uint32_t)DOSFS_FTOHS(dir->dir_clsno_lo);
+		    status = F_ERR_EOF;
 		}
-
-		find->find_clsno = clsno;
-#if (DOSFS_CONFIG_VFAT_SUPPORTED == 1)
-		find->find_index = index + volume->dir_entries +1;
-#else /* (DOSFS_CONFIG_VFAT_SUPPORTED == 1) */
-		find->find_index = index +1;
-#endif /* (DOSFS_CONFIG_VFAT_SUPPORTED == 1) */
-	    }
-	    else
-	    {
-		status = F_ERR_TOOLONGNAME;
 	    }
-        }
-        else
-        {
-            status = F_ERR_NOTFOUND;
-        }
+	}
     }
 
-    return status;
-}
-
-static void dosfs_path_setup_entry(dosfs_volume_t *volume, const char *dosname, uint8_t attr, uint32_t first_clsno, uint16_t ctime, uint16_t cdate, dosfs_dir_t *dir)
-{
-    if (dosname)
-    {
-	memcpy(dir->dir_name, dosname, 11);
-	
-	dir->dir_nt_reserved = 0x00;
-    }
-    else
+    if ((status == F_NO_ERROR) && (clsno == DOSFS_CLSNO_NONE))
     {
-	if (dir != &volume->dir)
+	clsno = clsno_d;
+	index = 0;
+	count = 0;
+
+	do
 	{
-	    memcpy(dir->dir_name, volume->dir.dir_name, 11);
-	
-	    dir->dir_nt_reserved = volume->dir.dir_nt_reserved;
+	    status = dosfs_path_find_entry(volume, clsno, index, 0, dosfs_path_find_callback_index, &data[0], &clsno, &index, &dir);
+	    
+	    if (status == F_NO_ERROR)
+	    {
+		if (dir == NULL)
+		{
+		    volume->index_count = count;
+		}
+		else
+		{
+		    if (count == DOSFS_CONFIG_DIR_INDEX_ENTRIES)
+		    {
+			break;
+		    }
+
+		    volume->index_table[count].hash = data[0];
+		    volume->index_table[count].index = index;
+		    volume->index_table[count].sfn_hash = data[2];
+
+		    count++;
+
+		    index = index + data[1] +1;
+
+		    volume->index_tail = index;
+		}
+	    }
 	}
+	while ((status == F_NO_ERROR) && (dir != NULL));
     }
 
-    dir->dir_attr = attr;
-    
-    if (volume->type != DOSFS_VOLUME_TYPE_FAT32)
+    if (status != F_NO_ERROR)
     {
-	dir->dir_crt_time_tenth = 0;
-	dir->dir_crt_time = 0;
-	dir->dir_crt_date = 0;
-	dir->dir_acc_date = 0;
-	dir->dir_clsno_hi = 0;
+	volume->index_clsno = DOSFS_CLSNO_END_OF_CHAIN;
     }
-    else
+
+    return status;
+}
+
+/* Checks whether the short name "dosname" may be in use in the indexed directory. A
+ * hash collision reports a free name as used, which is harmless, as this only skips
+ * a candidate for a generated short name.
+ */
+static int dosfs_path_index_contains(dosfs_volume_t *volume, const uint8_t *dosname)
+{
+    uint32_t n;
+    uint16_t hash;
+
+    hash = dosfs_path_index_hash_dosname(dosname);
+
+    for (n = 0; n < volume->index_count; n++)
     {
-	dir->dir_crt_time_tenth = 0;
-	dir->dir_crt_time = ctime;
-	dir->dir_crt_date = cdate;
-	dir->dir_acc_date = 0;
-	dir->dir_clsno_hi = DOSFS_HTOFS(first_clsno >> 16);
+	if (volume->index_table[n].sfn_hash == hash)
+	{
+	    return TRUE;
+	}
     }
-    
-    dir->dir_wrt_time = ctime;
-    dir->dir_wrt_date = cdate;
-    dir->dir_clsno_lo = DOSFS_HTOFS(first_clsno & 0xffff);
-    dir->dir_file_size = DOSFS_HTOFL(0);
+
+    return FALSE;
 }
 
-static int dosfs_path_create_entry(dosfs_volume_t *volume, uint32_t clsno_d, uint32_t clsno, uint32_t index, const char *dosname, uint8_t attr, uint32_t first_clsno, uint16_t ctime, uint16_t cdate)
+/* Without holes the "count" free entries for a new entry set are found past the last
+ * entry set of the indexed directory. Those entries are verified to be free, and have
+ * to fit into the clusters recorded for the index. Otherwise "*p_done" is left FALSE,
+ * so that the caller falls back to a linear scan of the directory.
+ */
+static int dosfs_path_index_tail(dosfs_volume_t *volume, uint32_t count, uint32_t *p_clsno, uint32_t *p_index, int *p_done)
 {
     int status = F_NO_ERROR;
-    uint32_t blkno, blkno_s, clsno_s;
-#if (DOSFS_CONFIG_VFAT_SUPPORTED == 1)
-    unsigned int chksum, mask, prefix;
-    dosfs_dir_t *dir;
-#if (DOSFS_CONFIG_TRANSACTION_SAFE_SUPPORTED == 0)
-    uint32_t blkno_e;
-    unsigned int sequence, offset, i, s, cc;
-    dosfs_dir_t *dir_e;
-#endif /* (DOSFS_CONFIG_TRANSACTION_SAFE_SUPPORTED == 0) */
-#else  /* (DOSFS_CONFIG_VFAT_SUPPORTED == 1) */
-#if (DOSFS_CONFIG_TRANSACTION_SAFE_SUPPORTED == 0)
-    dosfs_dir_t *dir;
-#endif /* (DOSFS_CONFIG_TRANSACTION_SAFE_SUPPORTED == 0) */
-#endif /* (DOSFS_CONFIG_VFAT_SUPPORTED == 1) */
+    uint32_t clsno, blkno, index, index_s, index_e, offset;
     dosfs_cache_entry_t *entry;
+    dosfs_dir_t *dir;
 
-    if (index == 0x00010000)
+    index_s = volume->index_tail;
+    index_e = index_s + count;
+
+    if (index_e > 0x00010000)
     {
-	status = F_ERR_NOMOREENTRY;
+	return F_NO_ERROR;
+    }
+
+    if (volume->index_clscnt == 0)
+    {
+	if ((index_e << DOSFS_DIR_SHIFT) > (volume->root_blkcnt * DOSFS_BLK_SIZE))
+	{
+	    return F_NO_ERROR;
+	}
+
+	clsno = DOSFS_CLSNO_NONE;
     }
     else
     {
-#if (DOSFS_CONFIG_VFAT_SUPPORTED == 1)
-	if (!dosname && ((volume->dir.dir_name[0] == '\0') || (volume->dir.dir_nt_reserved & DOSFS_DIR_TYPE_LOSSY)))
+	offset = index_s << DOSFS_DIR_SHIFT;
+
+	if (((offset >> volume->cls_shift) >= volume->index_clscnt) || ((offset >> volume->cls_shift) != (((index_e -1) << DOSFS_DIR_SHIFT) >> volume->cls_shift)))
 	{
-	    dosfs_name_uniname_to_dosname(volume->lfn_name, volume->lfn_count, volume->dir.dir_name, &prefix);
+	    return F_NO_ERROR;
+	}
 
-	    volume->dir.dir_nt_reserved = 0;
+	clsno = volume->index_cluster[offset >> volume->cls_shift];
+    }
 
-	    if (prefix)
+    for (index = index_s; index < index_e; index++)
+    {
+	if (clsno == DOSFS_CLSNO_NONE)
+	{
+	    blkno = volume->root_blkno + DOSFS_INDEX_TO_BLKCNT_ROOT(index);
+	}
+	else
+	{
+	    blkno = DOSFS_CLSNO_TO_BLKNO(clsno) + DOSFS_INDEX_TO_BLKCNT(index);
+	}
+
+	status = dosfs_dir_cache_read(volume, blkno, &entry);
+
+	if (status != F_NO_ERROR)
+	{
+	    break;
+	}
+
+	dir = (dosfs_dir_t*)((void*)(entry->data + DOSFS_INDEX_TO_BLKOFS(index)));
+
+	if ((dir->dir_name[0] != 0x00) && (dir->dir_name[0] != 0xe5))
+	{
+	    break;
+	}
+    }
+
+    if ((status == F_NO_ERROR) && (index == index_e))
+    {
+	*p_clsno = clsno;
+	*p_index = index_s;
+	*p_done = TRUE;
+    }
+
+    return status;
+}
+
+#if (DOSFS_CONFIG_TRANSACTION_SAFE_SUPPORTED == 0)
+
+/* Adds the entry set just written at "index" to the index of "clsno_d", rather than
+ * throwing the index away. "clsno_n" is the cluster that got appended to the directory
+ * for it, or DOSFS_CLSNO_NONE. "dir" is the SFN entry of the set.
+ */
+static void dosfs_path_index_insert(dosfs_volume_t *volume, uint32_t clsno_d, uint32_t clsno_n, uint32_t index, const dosfs_dir_t *dir)
+{
+    uint32_t count;
+
+    if ((volume->index_clsno == clsno_d) && (volume->index_count != DOSFS_INDEX_COUNT_INCOMPLETE))
+    {
+	if (clsno_n != DOSFS_CLSNO_NONE)
+	{
+	    if ((volume->index_clscnt == 0) || (volume->index_clscnt == DOSFS_CONFIG_DIR_INDEX_CLUSTERS))
 	    {
-		if (prefix > 6)
-		{
-		    prefix = 6;
-		}
-		
-		/* First check unique entries of the <name>~[1-9].<ext> form.
-		 */
-		
-		volume->dir.dir_name[prefix +0] = '~';
-		
-		mask = ((prefix +1) << 9);
-		
-		status = dosfs_path_find_entry(volume, clsno_d, 0, 0, dosfs_path_find_callback_unique, &mask, NULL, NULL, NULL);
+		volume->index_clsno = DOSFS_CLSNO_END_OF_CHAIN;
 
-		if (status == F_NO_ERROR)
-		{
-		    mask &= 0x000001ff;
-		
-		    if (mask != 0x000001ff)
-		    {
-			volume->dir.dir_name[prefix +1] = '1';
-			
-			while (mask & 1)
-			{
-			    volume->dir.dir_name[prefix +1] += 1;
-			    mask >>= 1;
-			}
-		    }
-		}
+		return;
+	    }
+
+	    volume->index_cluster[volume->index_clscnt++] = clsno_n;
+	}
+
+	if ((index + volume->dir_entries +1) > volume->index_tail)
+	{
+	    volume->index_tail = index + volume->dir_entries +1;
+	}
+
+	/* Volume labels are not indexed, but still occupy an entry.
+	 */
+	if (!(dir->dir_attr & DOSFS_DIR_ATTR_VOLUME_ID))
+	{
+	    count = volume->index_count;
+
+	    if (count == DOSFS_CONFIG_DIR_INDEX_ENTRIES)
+	    {
+		volume->index_count = DOSFS_INDEX_COUNT_INCOMPLETE;
 	    }
 	    else
 	    {
-		mask = 0x000001ff;
+		volume->index_table[count].hash = (volume->dir_entries ? dosfs_path_index_hash_uniname(volume->lfn_name, volume->lfn_count) : dosfs_path_index_hash_dosname(dir->dir_name));
+		volume->index_table[count].index = index;
+		volume->index_table[count].sfn_hash = dosfs_path_index_hash_dosname(dir->dir_name);
+
+		volume->index_count = count +1;
 	    }
+	}
+    }
+}
 
-	    if (status == F_NO_ERROR)
-	    {
-		if (mask & 1)
-		{
-		    /* Then check unique entries of the <name><checksum>~1.<ext> form.
-		     * Loop till a vaild unique name was found by stepping linear over
-		     * "chksum".
-		     */
+#endif /* (DOSFS_CONFIG_TRANSACTION_SAFE_SUPPORTED == 0) */
 
-		    if (prefix > 2)
-		    {
-			prefix = 2;
-		    }
+#endif /* (DOSFS_CONFIG_DIR_INDEX_ENTRIES != 0) */
 
-		    chksum = dosfs_name_checksum_uniname(volume->lfn_name, volume->lfn_count);
+#if (DOSFS_CONFIG_VFAT_SUPPORTED == 1)
 
-		    do
-		    {
-			volume->dir.dir_name[prefix +0] = dosfs_name_nibble_to_char_table[(chksum >> 12) & 15];
-			volume->dir.dir_name[prefix +1] = dosfs_name_nibble_to_char_table[(chksum >>  8) & 15];
-			volume->dir.dir_name[prefix +2] = dosfs_name_nibble_to_char_table[(chksum >>  4) & 15];
-			volume->dir.dir_name[prefix +3] = dosfs_name_nibble_to_char_table[(chksum >>  0) & 15];
-			volume->dir.dir_name[prefix +4] = '~';
-			volume->dir.dir_name[prefix +5] = '1';
-			
-			status = dosfs_path_find_entry(volume, clsno_d, 0, 0, dosfs_path_find_callback_unique, NULL, NULL, NULL, &dir);
-			
-			if (status == F_NO_ERROR) 
-			{
-			    if (dir != NULL)
-			    {
-				chksum += 1;
-			    }
-			}
-		    }
-		    while ((status == F_NO_ERROR) && (dir != NULL));
+/* Checks whether the generated short name in volume->dir.dir_name is in use in "clsno_d".
+ * With "p_mask" this is done for all the names with '1' to '9' at the pivot index (see
+ * dosfs_path_find_callback_unique()). With a complete directory index only the SFN hashes
+ * are looked at, otherwise the directory is scanned.
+ */
+static int dosfs_path_find_unique(dosfs_volume_t *volume, uint32_t clsno_d, unsigned int *p_mask, int *p_used)
+{
+    int status = F_NO_ERROR;
+    dosfs_dir_t *dir;
+#if (DOSFS_CONFIG_DIR_INDEX_ENTRIES != 0)
+    unsigned int index, cc;
+
+    if ((volume->index_clsno == clsno_d) && (volume->index_count != DOSFS_INDEX_COUNT_INCOMPLETE))
+    {
+	if (p_mask)
+	{
+	    index = (*p_mask) >> 9;
+
+	    for (cc = '1'; cc <= '9'; cc++)
+	    {
+		volume->dir.dir_name[index] = cc;
+
+		if (dosfs_path_index_contains(volume, volume->dir.dir_name))
+		{
+		    *p_mask |= (1 << (cc - '1'));
 		}
 	    }
 	}
 	else
 	{
-	    volume->dir_entries = 0;
+	    *p_used = dosfs_path_index_contains(volume, volume->dir.dir_name);
 	}
-
-	if (status == F_NO_ERROR)
-#endif /* (DOSFS_CONFIG_VFAT_SUPPORTED == 1) */
+    }
+    else
+#endif /* (DOSFS_CONFIG_DIR_INDEX_ENTRIES != 0) */
+    {
+	if (p_mask)
 	{
-	    if (index & 0x00020000)
-	    {
-		/* The appending of a new cluster to a directory is a tad tricky. One has to allocate
-		 * a cluster first, zero out it's contents, link the cluster to the end of the chain.
-		 * Also the fat cache has to be flushed as it's the final operation of a sequence (see f_mkdir).
-		 * The issue at hand is that if a new cluster is linked in that is not zeroed out, the
-		 * directory is invalid. One the other hand, we cannot write a directory entry to a directory
-		 * that has uncommited clusters in the fat cache.
-		 */
-		
-		status = dosfs_cluster_chain_create(volume, DOSFS_CLSNO_NONE, 1, &clsno_s, NULL);
-		
-		if (status == F_NO_ERROR)
-		{
-		    blkno_s = DOSFS_CLSNO_TO_BLKNO(clsno_s);
+	    status = dosfs_path_find_entry(volume, clsno_d, 0, 0, dosfs_path_find_callback_unique, p_mask, NULL, NULL, NULL);
+	}
+	else
+	{
+	    status = dosfs_path_find_entry(volume, clsno_d, 0, 0, dosfs_path_find_callback_unique, NULL, NULL, NULL, &dir);
 
-		    status = dosfs_volume_zero(volume, blkno_s, volume->cls_blk_size, NULL);
+	    if (status == F_NO_ERROR)
+	    {
+		*p_used = (dir != NULL);
+	    }
+	}
+    }
 
-		    if (status == F_NO_ERROR)
-		    {
-			status = dosfs_cluster_write(volume, clsno, clsno_s, TRUE);
+    return status;
+}
 
-			if (status == F_NO_ERROR)
-			{
-			    index &= ~0x00020000;
+#endif /* (DOSFS_CONFIG_VFAT_SUPPORTED == 1) */
 
-			    if (!((index << DOSFS_DIR_SHIFT) & volume->cls_mask))
-			    {
-				clsno = clsno_s;
+#if (DOSFS_CONFIG_EXFAT_SUPPORTED == 1)
 
-				/* If "index" is the first one of a new cluster,
-				 * one might as well avoid having to read the 
-				 * dir_cache entry.
-				 */
-				status = dosfs_dir_cache_zero(volume, blkno_s, &entry);
-			    }
-			}
-		    }
-		}
-	    }
+/* Scans the exFAT directory "clsno_d" from "index" on for the next primary entry of "type".
+ * "clscnt_d" is the cluster count of a contiguous ("NoFatChain") directory, or 0 if it has
+ * a FAT chain. A DOSFS_EXFAT_ENTRY_FILE entry set has to match "pattern", or the converted
+ * name in volume->lfn_name if "pattern" is NULL. It's translated into volume->exfat_dir,
+ * with volume->exfat_clscnt set to the cluster count of a contiguous entry (0 otherwise),
+ * and volume->dir_entries to the number of secondary entries. On a "pattern" match
+ * volume->lfn_name holds the name of the entry. For any other "type" p_dir points to the
+ * raw entry in the dir cache.
+ */
+static int dosfs_exfat_find_entry(dosfs_volume_t *volume, uint32_t clsno_d, uint32_t clscnt_d, uint32_t index, unsigned int type, const char *pattern, uint32_t *p_index, dosfs_dir_t **p_dir)
+{
+    int status = F_NO_ERROR;
+    int done, match;
+    unsigned int prefix, secondary, count, flags, attr, unicount, n, i, cc, lc;
+    uint32_t clsno, clsidx, clsdata, blkno, blkno_e, index_s, first_clsno, crt_stamp, wrt_stamp, acc_stamp;
+    uint64_t length, length_valid;
+    const uint32_t *data_32;
+    uint8_t *data, *data_e;
+    dosfs_cache_entry_t *entry;
+    dosfs_dir_t *dir;
 
-#if (DOSFS_CONFIG_TRANSACTION_SAFE_SUPPORTED == 0)
-	    /* For TRANSACTION_SAFE all of this happens throu dosfs_volume_record().
-	     */
-	
-	    /* The fat cache needs to be flushed before any dir entry update.
+    done = FALSE;
+    match = FALSE;
+    dir = NULL;
+
+    secondary = 0;
+    count = 0;
+    flags = 0;
+    attr = 0;
+    unicount = 0;
+    n = 0;
+    index_s = 0;
+    first_clsno = DOSFS_CLSNO_NONE;
+    crt_stamp = 0;
+    wrt_stamp = 0;
+    acc_stamp = 0;
+    length = 0;
+    length_valid = 0;
+
+    if (clsno_d == DOSFS_CLSNO_NONE)
+    {
+	clsno_d = volume->root_clsno;
+	clscnt_d = 0;
+    }
+
+    clsno = clsno_d;
+    clsidx = (index << DOSFS_DIR_SHIFT) >> volume->cls_shift;
+
+    if (clscnt_d != 0)
+    {
+	if (clsidx < clscnt_d)
+	{
+	    clsno = clsno_d + clsidx;
+	}
+	else
+	{
+	    done = TRUE;
+	}
+    }
+    else
+    {
+	if (clsidx != 0)
+	{
+	    status = dosfs_cluster_chain_seek(volume, clsno_d, clsidx, &clsno);
+
+	    /* An "index" past the end of the FAT chain is the end of the directory.
 	     */
-	    status = dosfs_fat_cache_flush(volume);
+	    if (status == F_ERR_EOF)
+	    {
+		status = F_NO_ERROR;
+		done = TRUE;
+	    }
+	}
+    }
 
-	    if (status == F_NO_ERROR)
+    blkno = DOSFS_CLSNO_TO_BLKNO(clsno) + DOSFS_INDEX_TO_BLKCNT(index);
+    blkno_e = DOSFS_CLSNO_TO_BLKNO(clsno) + volume->cls_blk_size;
+
+    while ((status == F_NO_ERROR) && !done)
+    {
+	if (blkno == blkno_e)
+	{
+	    clsidx++;
+
+	    if (clscnt_d != 0)
 	    {
-		if (clsno == DOSFS_CLSNO_NONE)
+		if (clsidx == clscnt_d)
 		{
-		    clsno = volume->root_clsno;
-		    blkno = volume->root_blkno + DOSFS_INDEX_TO_BLKCNT_ROOT(index);
-#if (DOSFS_CONFIG_VFAT_SUPPORTED == 1)
-		    blkno_e = volume->root_blkno + volume->root_blkcnt;
-#endif /* (DOSFS_CONFIG_VFAT_SUPPORTED == 1) */
+		    done = TRUE;
 		}
 		else
 		{
-		    blkno = DOSFS_CLSNO_TO_BLKNO(clsno) + DOSFS_INDEX_TO_BLKCNT(index);
-#if (DOSFS_CONFIG_VFAT_SUPPORTED == 1)
-		    blkno_e = blkno + volume->cls_blk_size;
-#endif /* (DOSFS_CONFIG_VFAT_SUPPORTED == 1) */
+		    clsno++;
 		}
+	    }
+	    else
+	    {
+		status = dosfs_cluster_read(volume, clsno, &clsdata);
 		
-		status = dosfs_dir_cache_read(volume, blkno, &entry);
-
 		if (status == F_NO_ERROR)
 		{
-		    dir = (dosfs_dir_t*)((void*)(entry->data + DOSFS_INDEX_TO_BLKOFS(index)));
-
-#if (DOSFS_CONFIG_VFAT_SUPPORTED == 1)
-		    if (volume->dir_entries != 0)
+		    if (clsdata >= DOSFS_CLSNO_LAST)
 		    {
-			dir_e = (dosfs_dir_t*)((void*)(entry->data + DOSFS_BLK_SIZE));
+			done = TRUE;
+		    }
+		    else
+		    {
+			if ((clsdata >= 2) && (clsdata <= volume->last_clsno))
+			{
+			    clsno = clsdata;
+			}
+			else
+			{
+			    status = F_ERR_EOF;
+			}
+		    }
+		}
+	    }
 
-			sequence = 0x40 | volume->dir_entries;
-			chksum = dosfs_name_checksum_dosname(volume->dir.dir_name);
+	    if ((status == F_NO_ERROR) && !done)
+	    {
+		blkno = DOSFS_CLSNO_TO_BLKNO(clsno);
+		blkno_e = blkno + volume->cls_blk_size;
+	    }
+	}
 
-			do
+	if ((status == F_NO_ERROR) && !done)
+	{
+	    status = dosfs_dir_cache_read(volume, blkno, &entry);
+
+	    if (status == F_NO_ERROR)
+	    {
+		data = entry->data + DOSFS_INDEX_TO_BLKOFS(index);
+		data_e = entry->data + DOSFS_BLK_SIZE;
+
+		do
+		{
+		    data_32 = (const uint32_t*)((const void*)data);
+
+		    if (data[0] == DOSFS_EXFAT_ENTRY_END)
+		    {
+			/* Like a 0x00 in dir_name[0] for FAT, all subsequent entries are free.
+			 */
+			done = TRUE;
+		    }
+		    else if (!(data[0] & DOSFS_EXFAT_ENTRY_IN_USE))
+		    {
+			/* A deleted entry ends an incomplete entry set.
+			 */
+			secondary = 0;
+		    }
+		    else if (!(data[0] & DOSFS_EXFAT_ENTRY_SECONDARY))
+		    {
+			secondary = 0;
+
+			if (data[0] == type)
 			{
-			    s = 0;
-			    i = ((sequence & 0x1f) - 1) * 13;
-		
-			    dir->dir_name[0] = sequence;
-			    dir->dir_attr = DOSFS_DIR_ATTR_LONG_NAME;
-			    dir->dir_nt_reserved = 0x00;
-			    dir->dir_crt_time_tenth = chksum;
-			    dir->dir_clsno_lo = 0x0000;
-		
-			    do
+			    if (type == DOSFS_EXFAT_ENTRY_FILE)
 			    {
-				offset = dosfs_path_ldir_name_table[s++];
-		    
-				if (i < volume->lfn_count)
+				/* A FILE entry needs at least a STREAM and a NAME entry to follow.
+				 */
+				if (data[1] >= 2)
 				{
-				    cc = volume->lfn_name[i];
-			
-				    ((uint8_t*)dir)[offset +0] = cc;
-				    ((uint8_t*)dir)[offset +1] = cc >> 8;
+				    secondary = data[1];
+				    count = secondary;
+				    index_s = index;
+				    attr = data[4] & (DOSFS_DIR_ATTR_READ_ONLY | DOSFS_DIR_ATTR_HIDDEN | DOSFS_DIR_ATTR_SYSTEM | DOSFS_DIR_ATTR_DIRECTORY | DOSFS_DIR_ATTR_ARCHIVE);
+				    crt_stamp = DOSFS_FTOHL(data_32[2]);
+				    wrt_stamp = DOSFS_FTOHL(data_32[3]);
+				    acc_stamp = DOSFS_FTOHL(data_32[4]);
+				    unicount = 0;
+				    n = 0;
+				    match = TRUE;
+				}
+			    }
+			    else
+			    {
+				index_s = index;
+				dir = (dosfs_dir_t*)((void*)data);
+				done = TRUE;
+			    }
+			}
+		    }
+		    else
+		    {
+			if (secondary != 0)
+			{
+			    if (secondary == count)
+			    {
+				/* The STREAM entry has to come first, and it carries the name length.
+				 */
+				if (data[0] == DOSFS_EXFAT_ENTRY_STREAM)
+				{
+				    flags = data[1];
+				    unicount = data[3];
+				    length_valid = ((uint64_t)DOSFS_FTOHL(data_32[3]) << 32) | (uint64_t)DOSFS_FTOHL(data_32[2]);
+				    first_clsno = DOSFS_FTOHL(data_32[5]);
+				    length = ((uint64_t)DOSFS_FTOHL(data_32[7]) << 32) | (uint64_t)DOSFS_FTOHL(data_32[6]);
+
+				    if ((pattern == NULL) && (unicount != volume->lfn_count))
+				    {
+					match = FALSE;
+				    }
 				}
 				else
 				{
-				    if (i == volume->lfn_count)
+				    match = FALSE;
+				}
+			    }
+			    else if (data[0] == DOSFS_EXFAT_ENTRY_NAME)
+			    {
+				for (i = 2; (i < DOSFS_DIR_SIZE) && (n < unicount); i += 2, n++)
+				{
+				    cc = (data[i +1] << 8) | data[i +0];
+
+				    if (pattern != NULL)
 				    {
-					((uint8_t*)dir)[offset +0] = 0x00;
-					((uint8_t*)dir)[offset +1] = 0x00;
+#if (DOSFS_CONFIG_UTF8_SUPPORTED == 0)
+					/* If UTF8 is not supported, then the name space is ASCII. In
+					 * that case remap illegal values to 0x001f.
+					 */
+					if (cc >= 0x0080)
+					{
+					    volume->lfn_name[n] = 0x001f;
+					}
+					else
+#endif /* (DOSFS_CONFIG_UTF8_SUPPORTED == 0) */
+					{
+					    volume->lfn_name[n] = cc;
+					}
 				    }
 				    else
 				    {
-					((uint8_t*)dir)[offset +0] = 0xff;
-					((uint8_t*)dir)[offset +1] = 0xff;
+					lc = volume->lfn_name[n];
+
+#if (DOSFS_CONFIG_UTF8_SUPPORTED == 1)
+					cc = dosfs_name_unicode_upcase(cc);
+					lc = dosfs_name_unicode_upcase(lc);
+#else /* (DOSFS_CONFIG_UTF8_SUPPORTED == 1) */
+					if (cc < 0x80)
+					{
+					    cc = dosfs_name_ascii_upcase(cc);
+					}
+					lc = dosfs_name_ascii_upcase(lc);
+#endif /* (DOSFS_CONFIG_UTF8_SUPPORTED == 1) */
+
+					if (lc != cc)
+					{
+					    match = FALSE;
+					}
 				    }
 				}
-
-				i++;
 			    }
-			    while (s < 13);
-		
-			    dir++;
 
-			    if (dir == dir_e)
+			    secondary--;
+
+			    if ((secondary == 0) && match && (unicount != 0) && (n == unicount))
 			    {
-				status = dosfs_dir_cache_write(volume);
+				if (pattern != NULL)
+				{
+				    volume->lfn_count = unicount;
+				}
 
-				blkno++;
+				dosfs_name_uniname_to_dosname(volume->lfn_name, unicount, volume->exfat_dir.dir_name, &prefix);
+
+				volume->exfat_dir.dir_attr = attr;
+				volume->exfat_dir.dir_nt_reserved = 0;
+				volume->exfat_dir.dir_crt_time_tenth = 0;
+				volume->exfat_dir.dir_crt_time = DOSFS_HTOFS(crt_stamp & 0xffff);
+				volume->exfat_dir.dir_crt_date = DOSFS_HTOFS(crt_stamp >> 16);
+				volume->exfat_dir.dir_acc_date = DOSFS_HTOFS(acc_stamp >> 16);
+				volume->exfat_dir.dir_clsno_hi = DOSFS_HTOFS(first_clsno >> 16);
+				volume->exfat_dir.dir_wrt_time = DOSFS_HTOFS(wrt_stamp & 0xffff);
+				volume->exfat_dir.dir_wrt_date = DOSFS_HTOFS(wrt_stamp >> 16);
+				volume->exfat_dir.dir_clsno_lo = DOSFS_HTOFS(first_clsno & 0xffff);
+
+				/* F_FILE positions are 32 bit, so a larger file is cut short. Data
+				 * beyond the valid length reads as 0 for exFAT, but is not initialized
+				 * on the media, so it's left out.
+				 */
+				if (attr & DOSFS_DIR_ATTR_DIRECTORY)
+				{
+				    volume->exfat_dir.dir_file_size = 0;
+				}
+				else
+				{
+				    volume->exfat_dir.dir_file_size = DOSFS_HTOFL((length_valid > DOSFS_FILE_SIZE_MAX) ? DOSFS_FILE_SIZE_MAX : (uint32_t)length_valid);
+				}
 
-				if (blkno == blkno_e)
+				if (pattern != NULL)
 				{
-				    status = dosfs_cluster_read(volume, clsno, &clsno);
-		
-				    if (status == F_NO_ERROR)
-				    {
-					blkno = DOSFS_CLSNO_TO_BLKNO(clsno);
-					blkno_e = blkno + volume->cls_blk_size;
-				    }
+				    match = dosfs_path_find_callback_pattern(volume, (void*)pattern, &volume->exfat_dir, DOSFS_LDIR_SEQUENCE_LAST);
 				}
 
-				if (status == F_NO_ERROR)
+				if (match)
 				{
-				    status = dosfs_dir_cache_read(volume, blkno, &entry);
+				    if ((flags & DOSFS_EXFAT_STREAM_NO_FAT_CHAIN) && (first_clsno != DOSFS_CLSNO_NONE))
+				    {
+					volume->exfat_clscnt = (uint32_t)((length + volume->cls_mask) >> volume->cls_shift);
 
-				    if (status == F_NO_ERROR)
+					if ((first_clsno < 2) || (volume->exfat_clscnt > (volume->last_clsno - first_clsno +1)))
+					{
+					    status = F_ERR_EOF;
+					}
+				    }
+				    else
 				    {
-					dir = (dosfs_dir_t*)((void*)(entry->data));
+					volume->exfat_clscnt = 0;
 				    }
+
+				    volume->dir_entries = count;
+
+				    dir = &volume->exfat_dir;
+				    done = TRUE;
 				}
 			    }
-
-			    sequence = (sequence & 0x1f) -1;
 			}
-			while ((status == F_NO_ERROR) && (sequence != 0));
 		    }
 
-		    if (status == F_NO_ERROR)
-#endif /* (DOSFS_CONFIG_VFAT_SUPPORTED == 1) */
+		    if (!done)
 		    {
-			/* Special semantics if "first_clsno" == DOSFS_CLUSTER_END_OF_CHAIN. In that
-			 * case volume->dir contains a valid template from f_rename, and
-			 * "attr" gets merged with volume->dir.dir_nt_reserved (as this
-			 * gets blown away by the name conversion).
-			 */
-			if (first_clsno == DOSFS_CLSNO_END_OF_CHAIN)
-			{
-			    memcpy(dir, &volume->dir, sizeof(dosfs_dir_t));
-
-			    dir->dir_nt_reserved = ((volume->dir.dir_nt_reserved & (DOSFS_DIR_TYPE_LCASE_NAME | DOSFS_DIR_TYPE_LCASE_EXT)) |
-						    (attr & ~(DOSFS_DIR_TYPE_LCASE_NAME | DOSFS_DIR_TYPE_LCASE_EXT)));
-			}
-			else
-			{
-			    dosfs_path_setup_entry(volume, dosname, attr, first_clsno, ctime, cdate, dir);
-			}
-
-			status = dosfs_dir_cache_write(volume);
+			data += DOSFS_DIR_SIZE;
+			index++;
 		    }
 		}
+		while (!done && (data < data_e));
+
+		blkno++;
 	    }
+	}
+    }
 
-#else /* (DOSFS_CONFIG_TRANSACTION_SAFE_SUPPORTED == 0) */
-	
-	    if (status == F_NO_ERROR)
-	    {
-		/* Special semantics if "first_clsno" == DOSFS_CLUSTER_END_OF_CHAIN. In that
-		 * case volume->dir contains a valid template from f_rename, and
-		 * "attr" gets merged with volume->dir.dir_nt_reserved (as this
-		 * gets blown away by the name conversion).
-		 */
-		if (first_clsno == DOSFS_CLSNO_END_OF_CHAIN)
-		{
-		    volume->dir.dir_nt_reserved = ((volume->dir.dir_nt_reserved & (DOSFS_DIR_TYPE_LCASE_NAME | DOSFS_DIR_TYPE_LCASE_EXT)) |
-						   (attr & ~(DOSFS_DIR_TYPE_LCASE_NAME | DOSFS_DIR_TYPE_LCASE_EXT)));
-		}
-		else
-		{
-		    dosfs_path_setup_entry(volume, dosname, attr, first_clsno, ctime, cdate, &volume->dir);
-		}
-
-		volume->dir_flags |= DOSFS_DIR_FLAG_CREATE_ENTRY;
-		volume->dir_clsno = clsno;
-		volume->dir_index = index;
-		volume->dot_clsno = clsno_d;
-
-		status = dosfs_volume_record(volume);
-	    }
-#endif /* (DOSFS_CONFIG_TRANSACTION_SAFE_SUPPORTED == 0) */
+    if (status == F_NO_ERROR)
+    {
+	if ((dir != NULL) && p_index)
+	{
+	    *p_index = index_s;
 	}
+
+	*p_dir = dir;
     }
 
     return status;
 }
 
-/* To destroy a directory/file, first the directory entry is deleted. Then the assocociated
- * cluster chain is freed.
+/* Same as dosfs_path_find_directory(), except that volume->exfat_clscnt_d reports whether
+ * the directory is contiguous. exFAT has no "." and ".." entries. A leading "." refers
+ * to the directory itself, while ".." cannot be resolved, as the parent directory is
+ * not recorded anywhere.
  */
-
-#if (DOSFS_CONFIG_VFAT_SUPPORTED == 1)
-static int dosfs_path_destroy_entry(dosfs_volume_t *volume, uint32_t clsno, uint32_t index, uint32_t entries, uint32_t first_clsno)
-#else /* (DOSFS_CONFIG_VFAT_SUPPORTED == 1) */
-static int dosfs_path_destroy_entry(dosfs_volume_t *volume, uint32_t clsno, uint32_t index, uint32_t first_clsno)
-#endif /* (DOSFS_CONFIG_VFAT_SUPPORTED == 1) */
+static int dosfs_exfat_find_directory(dosfs_volume_t *volume, const char *filename, const char **p_filename, uint32_t *p_clsno)
 {
     int status = F_NO_ERROR;
-#if (DOSFS_CONFIG_TRANSACTION_SAFE_SUPPORTED == 0)
-#if (DOSFS_CONFIG_VFAT_SUPPORTED == 1)
-    unsigned int sequence;
-    uint32_t blkno, blkno_e;
-    dosfs_dir_t *dir, *dir_e;
-#else /* (DOSFS_CONFIG_VFAT_SUPPORTED == 1) */
-    uint32_t blkno;
+    unsigned int cc;
+    const char *filename_e;
+    uint32_t clsno, clscnt;
     dosfs_dir_t *dir;
-#endif /* (DOSFS_CONFIG_VFAT_SUPPORTED == 1) */
-    dosfs_cache_entry_t *entry;
 
-    if (clsno == DOSFS_CLSNO_NONE)
+    clsno = DOSFS_CLSNO_NONE;
+    clscnt = 0;
+
+    if (*filename == '\0')
     {
-	clsno = volume->root_clsno;
-	blkno = volume->root_blkno + DOSFS_INDEX_TO_BLKCNT_ROOT(index);
-#if (DOSFS_CONFIG_VFAT_SUPPORTED == 1)
-	blkno_e = volume->root_blkno + volume->root_blkcnt;
-#endif /* (DOSFS_CONFIG_VFAT_SUPPORTED == 1) */
+	status = F_ERR_INVALIDNAME;
+    }
+    else if ((*filename == '/') || (*filename == '\\'))
+    {
+        filename++;
     }
     else
     {
-	blkno = DOSFS_CLSNO_TO_BLKNO(clsno) + DOSFS_INDEX_TO_BLKCNT(index);
-#if (DOSFS_CONFIG_VFAT_SUPPORTED == 1)
-	blkno_e = DOSFS_CLSNO_TO_BLKNO(clsno) + volume->cls_blk_size;
-#endif /* (DOSFS_CONFIG_VFAT_SUPPORTED == 1) */
+	if (volume->cwd_clsno != DOSFS_CLSNO_END_OF_CHAIN)
+	{
+	    clsno = volume->cwd_clsno;
+	    clscnt = volume->cwd_clscnt;
+	}
+	else
+	{
+	    status = F_ERR_INVALIDDIR;
+	}
     }
-    
-    status = dosfs_dir_cache_read(volume, blkno, &entry);
 
     if (status == F_NO_ERROR)
     {
-        dir = (dosfs_dir_t*)((void*)(entry->data + DOSFS_INDEX_TO_BLKOFS(index)));
-
-#if (DOSFS_CONFIG_VFAT_SUPPORTED == 1)
-	if (entries != 0)
+	do
 	{
-	    sequence = entries;
-
-	    dir_e = (dosfs_dir_t*)((void*)(entry->data + DOSFS_BLK_SIZE));
-
+	    filename_e = filename;
+	    
 	    do
 	    {
-		dir->dir_name[0] = 0xe5;
-		
-		dir++;
-		
-		if (dir == dir_e)
-		{
-		    status = dosfs_dir_cache_write(volume);
-
-		    blkno++;
+		cc = *filename_e++;
+	    }
+	    while ((cc != '/') && (cc != '\\') && (cc != '\0'));
+	    
+	    if ((cc == '/') || (cc == '\\'))
+	    {
+		status = dosfs_path_convert_filename(volume, filename, &filename);
 
-		    if (blkno == blkno_e)
+		if (status == F_NO_ERROR)
+		{
+		    if (volume->dir.dir_name[0] == '.')
 		    {
-			status = dosfs_cluster_read(volume, clsno, &clsno);
-		
-			if (status == F_NO_ERROR)
+			if (volume->dir.dir_name[1] != ' ')
 			{
-			    blkno = DOSFS_CLSNO_TO_BLKNO(clsno);
-			    blkno_e = blkno + volume->cls_blk_size;
+			    status = F_ERR_INVALIDDIR;
 			}
 		    }
-
-		    if (status == F_NO_ERROR)
+		    else
 		    {
-			status = dosfs_dir_cache_read(volume, blkno, &entry);
+			status = dosfs_exfat_find_entry(volume, clsno, clscnt, 0, DOSFS_EXFAT_ENTRY_FILE, NULL, NULL, &dir);
 
 			if (status == F_NO_ERROR)
 			{
-			    dir = (dosfs_dir_t*)((void*)(entry->data));
+			    clsno = ((uint32_t)DOSFS_FTOHS(dir ? dir->dir_clsno_hi : 0) << 16) | (uint32_t)DOSFS_FTOHS(dir ? dir->dir_clsno_lo : 0);
+			    clscnt = volume->exfat_clscnt;
+
+			    if ((dir == NULL) || !(dir->dir_attr & DOSFS_DIR_ATTR_DIRECTORY) || (clsno < 2))
+			    {
+				status = F_ERR_INVALIDDIR;
+			    }
 			}
 		    }
 		}
-		
-		sequence--;
 	    }
-	    while ((status == F_NO_ERROR) && (sequence != 0));
 	}
+	while ((status == F_NO_ERROR) && ((cc == '/') || (cc == '\\')));
+    }
+
+    if (status == F_NO_ERROR)
+    {
+	*p_filename = filename;
+	*p_clsno = clsno;
+
+	volume->exfat_clscnt_d = clscnt;
+    }
+
+    return status;
+}
+
+static int dosfs_exfat_change_directory(dosfs_volume_t *volume, const char *dirname)
+{
+    int status = F_NO_ERROR;
+    uint32_t clsno, clsno_d;
+    dosfs_dir_t *dir;
 
+    status = dosfs_exfat_find_directory(volume, dirname, &dirname, &clsno_d);
+            
+    if (status == F_NO_ERROR)
+    {
+	status = dosfs_path_convert_filename(volume, dirname, NULL);
+		
 	if (status == F_NO_ERROR)
-#endif /* (DOSFS_CONFIG_VFAT_SUPPORTED == 1) */
 	{
-	    dir->dir_name[0] = 0xe5;
-        
-	    status = dosfs_dir_cache_write(volume);
-        
-	    if (status == F_NO_ERROR)
+	    if (volume->dir.dir_name[0] == '.')
 	    {
-		if (first_clsno != DOSFS_CLSNO_NONE)
+		if (volume->dir.dir_name[1] == ' ')
 		{
-		    status = dosfs_cluster_chain_destroy(volume, first_clsno, DOSFS_CLSNO_FREE);
+		    /* "." */
+		    volume->cwd_clsno = clsno_d;
+		    volume->cwd_clscnt = volume->exfat_clscnt_d;
+		}
+		else
+		{
+		    /* ".." */
+		    status = F_ERR_NOTFOUND;
 		}
 	    }
-	}
+	    else
+	    {
+		status = dosfs_exfat_find_entry(volume, clsno_d, volume->exfat_clscnt_d, 0, DOSFS_EXFAT_ENTRY_FILE, NULL, NULL, &dir);
 
+		if (status == F_NO_ERROR)
+		{
+		    if (dir != NULL)
+		    {
+			clsno = ((uint32_t)DOSFS_FTOHS(dir->dir_clsno_hi) << 16) | (uint32_t)DOSFS_FTOHS(dir->dir_clsno_lo);
 
-	if (status == F_NO_ERROR)
-	{
-	    /* The post condition for dosfs_path_destroy_entry is that the fat cache
-	     * is flushed, so unconditionally do it here.
-	     */
-	    status = dosfs_fat_cache_flush(volume);
+			if ((dir->dir_attr & DOSFS_DIR_ATTR_DIRECTORY) && (clsno >= 2))
+			{
+			    volume->cwd_clsno = clsno;
+			    volume->cwd_clscnt = volume->exfat_clscnt;
+			}
+			else
+			{
+			    status = F_ERR_INVALIDDIR;
+			}
+		    }
+		    else
+		    {
+			status = F_ERR_NOTFOUND;
+		    }
+		}
+	    }
 	}
     }
 
-#else /* (DOSFS_CONFIG_TRANSACTION_SAFE_SUPPORTED == 0) */
+    return status;
+}
 
-    if (first_clsno != DOSFS_CLSNO_NONE)
-    {
-	status = dosfs_cluster_chain_destroy(volume, first_clsno, DOSFS_CLSNO_FREE);
-    }
+/* The allocation bitmap has one bit per cluster, which is set if the cluster is in use.
+ * Its own clusters are described by the FAT. As the volume is read-only, the count is
+ * computed only once.
+ */
+static int dosfs_exfat_count_free(dosfs_volume_t *volume, uint32_t *p_clscnt)
+{
+    int status = F_NO_ERROR;
+    uint32_t clsno, clsdata, clscnt, clscnt_used, blkno, blkno_e, offset, data;
+    dosfs_cache_entry_t *entry;
+    dosfs_dir_t *dir;
 
-    if (status == F_NO_ERROR)
+    if (volume->exfat_free_clscnt == DOSFS_CLSNO_END_OF_CHAIN)
     {
-	volume->dir_flags |= DOSFS_DIR_FLAG_DESTROY_ENTRY;
-	volume->del_clsno = clsno;
-	volume->del_index = index;
-#if (DOSFS_CONFIG_VFAT_SUPPORTED == 1)
-	volume->del_entries = entries;
-#endif /* (DOSFS_CONFIG_VFAT_SUPPORTED == 1) */
-
-	status = dosfs_volume_record(volume);
-    }
+	status = dosfs_exfat_find_entry(volume, DOSFS_CLSNO_NONE, 0, 0, DOSFS_EXFAT_ENTRY_BITMAP, NULL, NULL, &dir);
 
-#endif /* (DOSFS_CONFIG_TRANSACTION_SAFE_SUPPORTED == 0) */
+	if (status == F_NO_ERROR)
+	{
+	    if (dir == NULL)
+	    {
+		status = F_ERR_INVALIDMEDIA;
+	    }
+	    else
+	    {
+		clsno = DOSFS_FTOHL(((const uint32_t*)((const void*)dir))[5]);
+		clscnt = volume->last_clsno -1;
+		clscnt_used = 0;
 
+		while ((status == F_NO_ERROR) && (clscnt != 0))
+		{
+		    if ((clsno >= 2) && (clsno <= volume->last_clsno))
+		    {
+			blkno = DOSFS_CLSNO_TO_BLKNO(clsno);
+			blkno_e = blkno + volume->cls_blk_size;
 
-    return status;
-}
+			for (; (status == F_NO_ERROR) && (clscnt != 0) && (blkno < blkno_e); blkno++)
+			{
+			    status = dosfs_dir_cache_read(volume, blkno, &entry);
 
+			    for (offset = 0; (status == F_NO_ERROR) && (clscnt != 0) && (offset < DOSFS_BLK_SIZE); offset += 4)
+			    {
+				data = DOSFS_FTOHL(*((const uint32_t*)((const void*)(entry->data + offset))));
 
-/*****************************************************************************************************************************************/
+				if (clscnt < 32)
+				{
+				    data &= ((1u << clscnt) -1);
 
+				    clscnt = 0;
+				}
+				else
+				{
+				    clscnt -= 32;
+				}
 
-static dosfs_file_t * dosfs_file_enumerate(dosfs_volume_t *volume, dosfs_file_t *file, uint32_t clsno, uint32_t index)
-{
-#if (DOSFS_CONFIG_MAX_FILES == 1)
+				clscnt_used += __builtin_popcount(data);
+			    }
+			}
 
-    dosfs_file_t *file_s;
+			if ((status == F_NO_ERROR) && (clscnt != 0))
+			{
+			    status = dosfs_cluster_read(volume, clsno, &clsdata);
 
-    if (file == NULL)
-    {
-	file_s = &volume->file_table[0];
+			    clsno = clsdata;
+			}
+		    }
+		    else
+		    {
+			status = F_ERR_EOF;
+		    }
+		}
 
-	if (file_s->mode && (file_s->dir_clsno == clsno) && (file_s->dir_index == index))
-	{
-	    file = file_s;
+		if (status == F_NO_ERROR)
+		{
+		    volume->exfat_free_clscnt = (volume->last_clsno -1) - clscnt_used;
+		}
+	    }
 	}
     }
 
-#else /* (DOSFS_CONFIG_MAX_FILES == 1) */
+    if (status == F_NO_ERROR)
+    {
+	*p_clscnt = volume->exfat_free_clscnt;
+    }
 
-    dosfs_file_t *file_s, *file_e;
+    return status;
+}
 
-    file_s = (file == NULL) ? &volume->file_table[0] : file + 1;
-    file_e = &volume->file_table[DOSFS_CONFIG_MAX_FILES];
+/* The volume label is an entry in the root directory with up to 11 UTF-16 characters.
+ */
+static int dosfs_exfat_get_label(dosfs_volume_t *volume, char *volname, int length)
+{
+    int status = F_NO_ERROR;
+    unsigned int unicount, n;
+    const uint8_t *data;
+    dosfs_dir_t *dir;
 
-    file = NULL;
+    status = dosfs_exfat_find_entry(volume, DOSFS_CLSNO_NONE, 0, 0, DOSFS_EXFAT_ENTRY_LABEL, NULL, NULL, &dir);
 
-    do
+    if (status == F_NO_ERROR)
     {
-	if (file_s->mode && (file_s->dir_clsno == clsno) && (file_s->dir_index == index))
+	data = (const uint8_t*)dir;
+
+	if ((dir != NULL) && (data[1] != 0))
 	{
-	    file = file_s;
-	    break;
-	}
+	    unicount = (data[1] < 11) ? data[1] : 11;
 
-	file_s++;
-    }
-    while (file_s < file_e);
-#endif /* (DOSFS_CONFIG_MAX_FILES == 1) */
+	    for (n = 0; n < unicount; n++)
+	    {
+		volume->lfn_name[n] = (data[2 + 2*n +1] << 8) | data[2 + 2*n +0];
+	    }
 
-    return file;
+	    if (dosfs_name_uniname_to_cstring(volume->lfn_name, unicount, volname, volname + length) == NULL)
+	    {
+		status = F_ERR_TOOLONGNAME;
+	    }
+	}
+	else
+	{
+	    status = F_ERR_NOTFOUND;
+	}
+    }
+
+    return status;
 }
 
-static int dosfs_file_sync(dosfs_volume_t *volume, dosfs_file_t *file, int access, int modify, uint32_t first_clsno, uint32_t length)
+#endif /* (DOSFS_CONFIG_EXFAT_SUPPORTED == 1) */
+
+/* Equivalent to a dosfs_path_find_entry() with dosfs_path_find_callback_name(),
+ * starting at the beginning of "clsno_d". With a directory index, only the entry
+ * sets whose hash matches the converted name are looked at. "count" free entries
+ * to allocate are taken from past the last entry set if they are free there,
+ * otherwise a linear scan is still needed if the name is not in the directory.
+ */
+static int dosfs_path_find_name(dosfs_volume_t *volume, uint32_t clsno_d, uint32_t count, uint32_t *p_clsno, uint32_t *p_index, dosfs_dir_t **p_dir)
 {
     int status = F_NO_ERROR;
-    uint16_t ctime, cdate;
-#if (DOSFS_CONFIG_TRANSACTION_SAFE_SUPPORTED == 0)
-    uint32_t clsno, blkno, index;
-    dosfs_cache_entry_t *entry;
+#if (DOSFS_CONFIG_DIR_INDEX_ENTRIES != 0)
+    int done;
+    unsigned int state;
+    uint32_t clsno, index, offset, n;
+    uint16_t hash_l, hash_s;
     dosfs_dir_t *dir;
-#endif /* (DOSFS_CONFIG_TRANSACTION_SAFE_SUPPORTED == 0) */
-
-#if (DOSFS_CONFIG_TRANSACTION_SAFE_SUPPORTED == 1)
+#endif /* (DOSFS_CONFIG_DIR_INDEX_ENTRIES != 0) */
 
-    volume->dir.dir_clsno_lo = DOSFS_HTOFS(first_clsno & 0xffff);
-    volume->dir.dir_file_size = DOSFS_HTOFL(length);
-    
-    if (volume->type == DOSFS_VOLUME_TYPE_FAT32)
-    {
-	volume->dir.dir_clsno_hi = DOSFS_HTOFS(first_clsno >> 16);
-    }
-    
-    volume->dir_flags |= DOSFS_DIR_FLAG_SYNC_ENTRY;
-    
-    if (access || modify)
+#if (DOSFS_CONFIG_EXFAT_SUPPORTED == 1)
+    /* There is no name index for exFAT, and never any entry to allocate.
+     */
+    if (volume->flags & DOSFS_VOLUME_FLAG_EXFAT)
     {
-#if defined(DOSFS_PORT_CORE_TIMEDATE)
-	DOSFS_PORT_CORE_TIMEDATE(&ctime, &cdate);
-#else /* DOSFS_PORT_CORE_TIMEDATE */
-	ctime = 0;
-	cdate = 0;
-#endif /* DOSFS_PORT_CORE_TIMEDATE */
-
-	if (access)
+	if (p_clsno)
 	{
-	    if (volume->type == DOSFS_VOLUME_TYPE_FAT32)
-	    {
-		volume->dir.dir_acc_date = DOSFS_HTOFS(cdate);
-		    
-		volume->dir_flags |= DOSFS_DIR_FLAG_ACCESS_ENTRY;
-	    }
+	    *p_clsno = clsno_d;
 	}
 
-	if (modify)
-	{
-	    volume->dir.dir_wrt_time = DOSFS_HTOFS(ctime);
-	    volume->dir.dir_wrt_date = DOSFS_HTOFS(cdate);
-
-	    volume->dir_flags |= DOSFS_DIR_FLAG_MODIFY_ENTRY;
-	}
+	return dosfs_exfat_find_entry(volume, clsno_d, volume->exfat_clscnt_d, 0, DOSFS_EXFAT_ENTRY_FILE, NULL, p_index, p_dir);
     }
-	
-    volume->dir_clsno = file->dir_clsno;
-    volume->dir_index = file->dir_index;
-#if (DOSFS_CONFIG_VFAT_SUPPORTED == 1)
-    volume->dir_entries = 0;
-#endif /* (DOSFS_CONFIG_VFAT_SUPPORTED == 1) */
-
-    status = dosfs_volume_record(volume);
+#endif /* (DOSFS_CONFIG_EXFAT_SUPPORTED == 1) */
 
-#else /* (DOSFS_CONFIG_TRANSACTION_SAFE_SUPPORTED == 1) */
+#if (DOSFS_CONFIG_DIR_INDEX_ENTRIES != 0)
+    done = FALSE;
 
-    status = dosfs_fat_cache_flush(volume);
+    if (volume->index_clsno != clsno_d)
+    {
+	status = dosfs_path_index_build(volume, clsno_d);
+    }
 
-    if (status == F_NO_ERROR)
+    if ((status == F_NO_ERROR) && (volume->index_count != DOSFS_INDEX_COUNT_INCOMPLETE))
     {
-	clsno = file->dir_clsno;
-	index = file->dir_index;
+	hash_l = dosfs_path_index_hash_uniname(volume->lfn_name, volume->lfn_count);
+	hash_s = dosfs_path_index_hash_dosname(volume->dir.dir_name);
 
-	if (clsno == DOSFS_CLSNO_NONE)
-	{
-	    blkno = volume->root_blkno + DOSFS_INDEX_TO_BLKCNT_ROOT(index);
-	}
-	else
-	{
-	    blkno = DOSFS_CLSNO_TO_BLKNO(clsno) + DOSFS_INDEX_TO_BLKCNT(index);
-	}
-    
-	status = dosfs_dir_cache_read(volume, blkno, &entry);
-    
-	if (status == F_NO_ERROR)
-	{
-	    dir = (dosfs_dir_t*)((void*)(entry->data + DOSFS_INDEX_TO_BLKOFS(index)));
+	dir = NULL;
 
-	    dir->dir_clsno_lo = DOSFS_HTOFS(first_clsno & 0xffff);
-	    dir->dir_file_size = DOSFS_HTOFL(length);
-	
-	    if (volume->type == DOSFS_VOLUME_TYPE_FAT32)
-	    {
-		dir->dir_clsno_hi = DOSFS_HTOFS(first_clsno >> 16);
-	    }
-	
-	    if (access || modify)
+	for (n = 0; (status == F_NO_ERROR) && (dir == NULL) && (n < volume->index_count); n++)
+	{
+	    if ((volume->lfn_count && (volume->index_table[n].hash == hash_l)) ||
+		((volume->dir.dir_name[0] != '\0') && (volume->index_table[n].hash == hash_s)))
 	    {
-#if defined(DOSFS_PORT_CORE_TIMEDATE)
-		DOSFS_PORT_CORE_TIMEDATE(&ctime, &cdate);
-#else /* DOSFS_PORT_CORE_TIMEDATE */
-		ctime = 0;
-		cdate = 0;
-#endif /* DOSFS_PORT_CORE_TIMEDATE */
+		index = volume->index_table[n].index;
 
-		if (access)
+		/* An index on a cluster boundary is passed in with the previous
+		 * cluster (see dosfs_path_find_entry()).
+		 */
+		if (volume->index_clscnt == 0)
 		{
-		    if (volume->type == DOSFS_VOLUME_TYPE_FAT32)
-		    {
-			dir->dir_acc_date = DOSFS_HTOFS(cdate);
-		    }
+		    clsno = DOSFS_CLSNO_NONE;
 		}
+		else
+		{
+		    offset = index << DOSFS_DIR_SHIFT;
 
-		if (modify)
+		    clsno = volume->index_cluster[offset ? ((offset -1) >> volume->cls_shift) : 0];
+		}
+
+		state = 0;
+
+		status = dosfs_path_find_entry(volume, clsno, index, 0, dosfs_path_find_callback_indexed, &state, &clsno, &index, &dir);
+
+		if (status == F_NO_ERROR)
 		{
-		    dir->dir_attr |= DOSFS_DIR_ATTR_ARCHIVE;
-		    dir->dir_wrt_time = DOSFS_HTOFS(ctime);
-		    dir->dir_wrt_date = DOSFS_HTOFS(cdate);
+		    if (state == 2)
+		    {
+			if (p_clsno)
+			{
+			    *p_clsno = clsno;
+			    *p_index = index;
+			}
+		    }
+		    else
+		    {
+			dir = NULL;
+		    }
 		}
 	    }
+	}
 
-	    status = dosfs_dir_cache_write(volume);
+	if ((status == F_NO_ERROR) && ((dir != NULL) || (count == 0)))
+	{
+	    *p_dir = dir;
 
-	    if (status == F_NO_ERROR)
+	    done = TRUE;
+	}
+
+	if ((status == F_NO_ERROR) && !done)
+	{
+	    status = dosfs_path_index_tail(volume, count, p_clsno, p_index, &done);
+
+	    if (done)
 	    {
-		status = dosfs_volume_clean(volume, status);
+		*p_dir = NULL;
 	    }
 	}
     }
-#endif /* (DOSFS_CONFIG_TRANSACTION_SAFE_SUPPORTED == 1) */
+
+    if ((status == F_NO_ERROR) && !done)
+#endif /* (DOSFS_CONFIG_DIR_INDEX_ENTRIES != 0) */
+    {
+	status = dosfs_path_find_entry(volume, clsno_d, 0, count, dosfs_path_find_callback_name, NULL, p_clsno, p_index, p_dir);
+    }
 
     return status;
 }
 
+/* Strip a leading drive prefix "N:" from "*p_filename", and return the volume
+ * of drive N. Without a prefix "volume" is returned. NULL is returned if there
+ * is no such drive.
+ */
 
-static int dosfs_file_flush(dosfs_volume_t *volume, dosfs_file_t *file, int close)
+static dosfs_volume_t *dosfs_path_volume(const char **p_filename, dosfs_volume_t *volume)
 {
-    int status = F_NO_ERROR;
-    dosfs_device_t *device;
+    const char *filename;
+    unsigned int drive;
 
-    device = DOSFS_VOLUME_DEVICE(volume);
+    filename = *p_filename;
 
-    if (volume->state == DOSFS_VOLUME_STATE_MOUNTED)
+    if ((filename[0] >= '0') && (filename[0] <= '9') && (filename[1] == ':'))
     {
-	/* The data cache is first flushed and outstanding disk operations
-	 * are finished. Then however the fat cache flush and  the directory updates
-	 * are only performed uncoditionally irregardless of whether there were
-	 * outstanding errors.
-	 */
-
-	status = dosfs_data_cache_flush(volume, file);
+	drive = filename[0] - '0';
 
-	if (status == F_NO_ERROR)
+	if (drive < DOSFS_CONFIG_MAX_VOLUMES)
 	{
-	    status = (*device->interface->sync)(device->context, true);
+	    volume = &dosfs_volume_table[drive];
 	}
-
-	if (file->status == F_NO_ERROR)
+	else
 	{
-	    file->status = status;
+	    volume = NULL;
 	}
 
-	if (close || (file->flags & (DOSFS_FILE_FLAG_DIR_MODIFIED | DOSFS_FILE_FLAG_DATA_MODIFIED)))
-	{
-	    status = dosfs_file_sync(volume, file, close, (file->flags & (DOSFS_FILE_FLAG_DIR_MODIFIED | DOSFS_FILE_FLAG_DATA_MODIFIED)), file->first_clsno, file->length);
-	}
+	*p_filename = filename + 2;
     }
 
-    if (status == F_NO_ERROR)
+    return volume;
+}
+
+/*
+ * filename   incoming full path
+ * p_filename last path element 
+ * p_clsno    clsno of parent directory of last path element
+ */
+
+static int dosfs_path_find_directory(dosfs_volume_t *volume, const char *filename, const char **p_filename, uint32_t *p_clsno)
+{
+    int status = F_NO_ERROR;
+    unsigned int cc;
+    const char *filename_e;
+    uint32_t clsno;
+    dosfs_dir_t *dir;
+
+#if (DOSFS_CONFIG_EXFAT_SUPPORTED == 1)
+    if (volume->flags & DOSFS_VOLUME_FLAG_EXFAT)
     {
-	file->flags &= ~(DOSFS_FILE_FLAG_DATA_MODIFIED | DOSFS_FILE_FLAG_DIR_MODIFIED);
+	return dosfs_exfat_find_directory(volume, filename, p_filename, p_clsno);
     }
+#endif /* (DOSFS_CONFIG_EXFAT_SUPPORTED == 1) */
 
-    if (file->status != F_NO_ERROR)
+    if (*filename == '\0')
     {
-	status = file->status;
+	status = F_ERR_INVALIDNAME;
     }
+    else if ((*filename == '/') || (*filename == '\\'))
+    {
+	clsno = DOSFS_CLSNO_NONE;
 
-    return status;
-}
-
-static int dosfs_file_seek(dosfs_volume_t *volume, dosfs_file_t *file, uint32_t position)
-{
-    int status = F_NO_ERROR;
-    uint32_t clsno, clscnt, offset;
-
-    if ((file->mode & DOSFS_FILE_MODE_WRITE) && ((file->position & ~DOSFS_BLK_MASK) != (position & ~DOSFS_BLK_MASK)))
+        filename++;
+    }
+    else
     {
-	status = dosfs_data_cache_flush(volume, file);
+	if (volume->cwd_clsno != DOSFS_CLSNO_END_OF_CHAIN)
+	{
+	    clsno = volume->cwd_clsno;
+	}
+	else
+	{
+	    status = F_ERR_INVALIDDIR;
+	}
     }
 
     if (status == F_NO_ERROR)
     {
-	if (position == 0)
+	do
 	{
-	    /* A seek to position 0 (i.e. rewind) always succeeds.
+	    /* Scan ahead to see whether there is a directory left.
 	     */
-	    if (file->first_clsno != DOSFS_CLSNO_NONE)
+	    filename_e = filename;
+	    
+	    do
 	    {
-		file->clsno = file->first_clsno;
-		file->blkno = DOSFS_CLSNO_TO_BLKNO(file->clsno);
-		file->blkno_e = file->blkno + volume->cls_blk_size;
+		cc = *filename_e++;
 	    }
-	
-	    file->position = 0;
-	}
-	else
-	{
-	    if (file->position != position)
+	    while ((cc != '/') && (cc != '\\') && (cc != '\0'));
+	    
+	    if ((cc == '/') || (cc == '\\'))
 	    {
-		if (file->length == 0)
-		{
-		    /* Any seek for file->length == 0 always succeeds.
-		     */
-		    file->position = position;
-		}
-		else
+		status = dosfs_path_convert_filename(volume, filename, &filename);
+
+		if (status == F_NO_ERROR)
 		{
-		    if (file->first_clsno == DOSFS_CLSNO_NONE)
+		    if ((volume->dir.dir_name[0] == '.') && (volume->dir.dir_name[1] == ' '))
 		    {
-			/* A seek to any non-zero position with no
-			 * cluster in the chain is an error.
+			/* This is a special case here, as there is no "." or ".." entry
+			 * in the root directory.
 			 */
-			status = F_ERR_EOF;
 		    }
 		    else
 		    {
-			if (position < file->length)
+			status = dosfs_path_find_entry(volume, clsno, 0, 0, dosfs_path_find_callback_name, NULL, NULL, NULL, &dir);
+
+			if (status == F_NO_ERROR)
 			{
-			    offset = position;
-			}
-			else
-			{
-			    offset = file->length;
-			}
-
-			if (status == F_NO_ERROR)
-			{
-#if (DOSFS_CONFIG_CONTIGUOUS_SUPPORTED == 1)
-			    if (file->flags & DOSFS_FILE_FLAG_CONTIGUOUS)
-			    {
-				clsno = file->first_clsno + DOSFS_OFFSET_TO_CLSCNT(offset -1);
-			    }
-			    else
-#endif /* (DOSFS_CONFIG_CONTIGUOUS_SUPPORTED == 1) */
+			    if (dir != NULL)
 			    {
-				if ((offset == file->length) && (file->last_clsno != DOSFS_CLSNO_NONE))
-				{
-				    clsno = file->last_clsno;
-				}
-				else
+				if (dir->dir_attr & DOSFS_DIR_ATTR_DIRECTORY)
 				{
-				    if ((file->position == 0) || (file->position > offset))
+				    if (volume->type == DOSFS_VOLUME_TYPE_FAT32)
 				    {
-					clsno = file->first_clsno;
-					clscnt = DOSFS_OFFSET_TO_CLSCNT(offset -1);
+					clsno = ((uint32_t)DOSFS_FTOHS(dir->dir_clsno_hi) << 16) | (uint32_t)DOSFS_FTOHS(dir->dir_clsno_lo);
 				    }
 				    else
-				    {
-					clsno = file->clsno;
-					clscnt = DOSFS_OFFSET_TO_CLSCNT(offset -1) - DOSFS_OFFSET_TO_CLSCNT(file->position -1);
-				    }
-
-				    if (clscnt != 0)
-				    {
-					status = dosfs_cluster_chain_seek(volume, clsno, clscnt, &clsno);
+				    { 
+					clsno = (uint32_t)DOSFS_FTOHS(dir->dir_clsno_lo);
 				    }
 				}
-			    }
-			
-			    if (status == F_NO_ERROR)
-			    {
-				file->position = position;
-				file->clsno = clsno;
-
-				if (!(offset & volume->cls_mask))
-				{
-				    file->blkno = DOSFS_CLSNO_TO_BLKNO(clsno) + volume->cls_blk_size;
-				    file->blkno_e = file->blkno;
-				}
 				else
 				{
-				    file->blkno = DOSFS_CLSNO_TO_BLKNO(clsno) + DOSFS_OFFSET_TO_BLKCNT(offset);
-				    file->blkno_e = DOSFS_CLSNO_TO_BLKNO(clsno) + volume->cls_blk_size;
-				}
-
-				if (offset == file->length)
-				{
-				    file->last_clsno = clsno;
+				    status = F_ERR_INVALIDDIR;
 				}
 			    }
+			    else
+			    {
+				status = F_ERR_INVALIDDIR;
+			    }
 			}
 		    }
 		}
 	    }
 	}
+	while ((status == F_NO_ERROR) && ((cc == '/') || (cc == '\\')));
+    }
+
+    if (status == F_NO_ERROR)
+    {
+	*p_filename = filename;
+        *p_clsno = clsno;
     }
 
     return status;
 }
 
-static int dosfs_file_shrink(dosfs_volume_t *volume, dosfs_file_t *file)
+static int dosfs_path_find_file(dosfs_volume_t *volume, const char *filename, uint32_t *p_clsno, uint32_t *p_index, dosfs_dir_t **p_dir)
 {
     int status = F_NO_ERROR;
+    uint32_t clsno_d;
 
-    if (file->position == 0)
-    {
-	if (file->first_clsno != DOSFS_CLSNO_NONE)
-	{
-#if (DOSFS_CONFIG_TRANSACTION_SAFE_SUPPORTED == 1)
-
-	    /* Defer the deletion of file->first_clsno to the next dosfs_file_flush(),
-	     * so that file->first_clsno ends up on the disk before the cluster is made
-	     * available again.
-	     */
-		   
-	    status = dosfs_cluster_chain_destroy(volume, file->first_clsno, DOSFS_CLSNO_FREE);
-
-	    if (status == F_NO_ERROR)
-	    {
-		status = dosfs_file_sync(volume, file, FALSE, FALSE, DOSFS_CLSNO_NONE, file->length);
-	    }
-
-#else /* (DOSFS_CONFIG_TRANSACTION_SAFE_SUPPORTED == 1) */
-
-	    /* To be on the safe side, the directory entry on the disk is updated first,
-	     * so that "file->length" is always correct, and in case the whole chain gets
-	     * deleted "file->first_clsno" on disk is properly zeroed out.
-	     */
+    status = dosfs_path_find_directory(volume, filename, &filename, &clsno_d);
 
-	    status = dosfs_file_sync(volume, file, FALSE, FALSE, DOSFS_CLSNO_NONE, file->length);
+    if (status == F_NO_ERROR)
+    {
+	status = dosfs_path_convert_filename(volume, filename, NULL);
 
+	if (status == F_NO_ERROR)
+	{
+	    status = dosfs_path_find_name(volume, clsno_d, 0, p_clsno, p_index, p_dir);
+	    
 	    if (status == F_NO_ERROR)
 	    {
-		status = dosfs_volume_dirty(volume);
-
-		if (status == F_NO_ERROR)
+		if (*p_dir == NULL)
 		{
-		    status = dosfs_cluster_chain_destroy(volume, file->first_clsno, DOSFS_CLSNO_FREE);
+		    status = F_ERR_NOTFOUND;
 		}
 	    }
-#endif /* (DOSFS_CONFIG_TRANSACTION_SAFE_SUPPORTED == 1) */
 	}
+    }
 
-	if (status == F_NO_ERROR)
-	{
-	    file->first_clsno = DOSFS_CLSNO_NONE;
-	    file->last_clsno = DOSFS_CLSNO_NONE;
-		
-	    /* file->position is 0 here, but clsno/blkno/blkno_e
-	     * point to the first cluster, which just got deleted.
-	     */
-	    file->clsno = DOSFS_CLSNO_NONE;
-	    file->blkno = DOSFS_BLKNO_INVALID;
-	    file->blkno_e = DOSFS_BLKNO_INVALID;
-	}
+    return status;
+}
+
+static int dosfs_path_find_next(dosfs_volume_t *volume, F_FIND *find)
+{
+    int status = F_NO_ERROR;
+    char *filename;
+    uint32_t clsno, index;
+    dosfs_dir_t *dir;
+
+#if (DOSFS_CONFIG_EXFAT_SUPPORTED == 1)
+    if (volume->flags & DOSFS_VOLUME_FLAG_EXFAT)
+    {
+	clsno = find->find_clsno;
+
+	status = dosfs_exfat_find_entry(volume, find->find_clsno, find->find_clscnt, find->find_index, DOSFS_EXFAT_ENTRY_FILE, find->find_pattern, &index, &dir);
     }
     else
+#endif /* (DOSFS_CONFIG_EXFAT_SUPPORTED == 1) */
     {
-	if (file->clsno != DOSFS_CLSNO_NONE)
-	{
-#if (DOSFS_CONFIG_TRANSACTION_SAFE_SUPPORTED == 0)
-	    status = dosfs_volume_dirty(volume);
-
-	    if (status == F_NO_ERROR)
-#endif /* (DOSFS_CONFIG_TRANSACTION_SAFE_SUPPORTED == 0) */
-	    {
-		status = dosfs_cluster_chain_destroy(volume, file->clsno, DOSFS_CLSNO_END_OF_CHAIN);
-		
-		if (status == F_NO_ERROR)
-		{
-		    file->last_clsno = file->clsno;
-		}
-	    }
-	}
-	else
-	{
-	    status = F_ERR_EOF;
-	}
+	status = dosfs_path_find_entry(volume, find->find_clsno, find->find_index, 0, dosfs_path_find_callback_pattern, find->find_pattern, &clsno, &index, &dir);
     }
 
     if (status == F_NO_ERROR)
     {
-	if (file->length != file->position)
-	{
-	    file->flags |= DOSFS_FILE_FLAG_DIR_MODIFIED;
-	    file->length = file->position;
-	}
-
-	file->flags |= DOSFS_FILE_FLAG_END_OF_CHAIN;
-
-#if (DOSFS_CONFIG_CONTIGUOUS_SUPPORTED == 1)
-	if (file->flags & DOSFS_FILE_FLAG_CONTIGUOUS)
+	if (dir != NULL)
 	{
-	    if (file->length >= (DOSFS_FILE_SIZE_MAX & ~volume->cls_mask))
+#if (DOSFS_CONFIG_VFAT_SUPPORTED == 1)
+	    /* It's possible to have a sfn_name only ("." and ".." for example).
+	     */
+	    if (volume->lfn_count)
 	    {
-		file->size = DOSFS_FILE_SIZE_MAX;
+		filename = dosfs_name_uniname_to_cstring(volume->lfn_name, volume->lfn_count, find->filename, (find->filename + sizeof(find->filename)));
 	    }
 	    else
+#endif /* (DOSFS_CONFIG_VFAT_SUPPORTED == 1) */
 	    {
-		file->size = (file->length + volume->cls_mask) & ~volume->cls_mask;
+		filename = dosfs_name_dosname_to_cstring(dir->dir_name, dir->dir_nt_reserved, find->filename, (find->filename + sizeof(find->filename)));
 	    }
-	}
-#endif /* (DOSFS_CONFIG_CONTIGUOUS_SUPPORTED == 1) */
-    }
 
-    if (file->status == F_NO_ERROR)
-    {
-	file->status = status;
+	    if (filename != NULL)
+	    {
+		memcpy(&find->name[0], &dir->dir_name[0], (F_MAXNAME+F_MAXEXT));
+		
+		find->attr = dir->dir_attr;
+		find->ctime = DOSFS_FTOHS(dir->dir_wrt_time);
+		find->cdate = DOSFS_FTOHS(dir->dir_wrt_date);
+		find->filesize = DOSFS_FTOHL(dir->dir_file_size);
+
+		if (volume->type == DOSFS_VOLUME_TYPE_FAT32)
+		{
+		    find->cluster = ((uint32_t)DOSFS_FTOHS(dir->dir_clsno_hi) << 16) | (uint32_t)DOSFS_FTOHS(dir->dir_clsno_lo);
+		}
+		else
+		{
+		    find->cluster = (uint32_t)DOSFS_FTOHS(dir->dir_clsno_lo);
+		}
+
+		find->find_clsno = clsno;
+#if (DOSFS_CONFIG_VFAT_SUPPORTED == 1)
+		find->find_index = index + volume->dir_entries +1;
+#else /* (DOSFS_CONFIG_VFAT_SUPPORTED == 1) */
+		find->find_index = index +1;
+#endif /* (DOSFS_CONFIG_VFAT_SUPPORTED == 1) */
+	    }
+	    else
+	    {
+		status = F_ERR_TOOLONGNAME;
+	    }
+        }
+        else
+        {
+            status = F_ERR_NOTFOUND;
+        }
     }
 
     return status;
 }
 
-static int dosfs_file_extend(dosfs_volume_t *volume, dosfs_file_t *file, uint32_t length)
+static void dosfs_path_setup_entry(dosfs_volume_t *volume, const char *dosname, uint8_t attr, uint32_t first_clsno, uint16_t ctime, uint16_t cdate, dosfs_dir_t *dir)
 {
-    int status = F_NO_ERROR;
-    uint32_t clsno, clscnt, clsno_a, clsno_l, clsno_n, clsdata, blkno, blkno_e, blkcnt, count, size, position, offset, length_o;
-    dosfs_cache_entry_t *entry;
-
-    /* Compute below:
-     *
-     * clsno      file->last_clsno or DOSFS_CLSNO_NONE (corresponding to file->length)
-     * clsno_l    file->last_clsno (corresponding to length)
-     * clsno_n    next cluster after clsno (or first allocated)
-     */
-
-    length_o = file->length;
-
-#if (DOSFS_CONFIG_CONTIGUOUS_SUPPORTED == 1)
-    if (file->flags & DOSFS_FILE_FLAG_CONTIGUOUS)
+    if (dosname)
     {
-	if (length_o == 0)
-	{
-	    clsno = file->first_clsno;
-	    clsno_n = clsno;
-	}
-	else
-	{
-	    clsno = file->first_clsno + DOSFS_OFFSET_TO_CLSCNT(length_o -1);
-	    clsno_n = clsno +1;
-	}
-
-	clsno_l = file->first_clsno + DOSFS_OFFSET_TO_CLSCNT(length -1);
+	memcpy(dir->dir_name, dosname, 11);
+	
+	dir->dir_nt_reserved = 0x00;
     }
     else
-#endif /* (DOSFS_CONFIG_CONTIGUOUS_SUPPORTED == 1) */
     {
-	if (length_o == 0)
+	if (dir != &volume->dir)
 	{
-	    clsno = file->first_clsno;
+	    memcpy(dir->dir_name, volume->dir.dir_name, 11);
+	
+	    dir->dir_nt_reserved = volume->dir.dir_nt_reserved;
 	}
-	else
-	{
-	    if (file->first_clsno == DOSFS_CLSNO_NONE)
-	    {
-		clsno = DOSFS_CLSNO_NONE;
-		length_o = 0;
+    }
+
+    dir->dir_attr = attr;
+    
+    if (volume->type != DOSFS_VOLUME_TYPE_FAT32)
+    {
+	dir->dir_crt_time_tenth = 0;
+	dir->dir_crt_time = 0;
+	dir->dir_crt_date = 0;
+	dir->dir_acc_date = 0;
+	dir->dir_clsno_hi = 0;
+    }
+    else
+    {
+	dir->dir_crt_time_tenth = 0;
+	dir->dir_crt_time = ctime;
+	dir->dir_crt_date = cdate;
+	dir->dir_acc_date = 0;
+	dir->dir_clsno_hi = DOSFS_HTOFS(first_clsno >> 16);
+    }
+    
+    dir->dir_wrt_time = ctime;
+    dir->dir_wrt_date = cdate;
+    dir->dir_clsno_lo = DOSFS_HTOFS(first_clsno & 0xffff);
+    dir->dir_file_size = DOSFS_HTOFL(0);
+}
+
+static int dosfs_path_create_entry(dosfs_volume_t *volume, uint32_t clsno_d, uint32_t clsno, uint32_t index, const char *dosname, uint8_t attr, uint32_t first_clsno, uint16_t ctime, uint16_t cdate)
+{
+    int status = F_NO_ERROR;
+    uint32_t blkno, blkno_s, clsno_s;
+#if (DOSFS_CONFIG_VFAT_SUPPORTED == 1)
+    unsigned int chksum, mask, prefix;
+    int used;
+#if (DOSFS_CONFIG_TRANSACTION_SAFE_SUPPORTED == 0)
+    dosfs_dir_t *dir;
+    uint32_t blkno_e;
+    unsigned int sequence, offset, i, s, cc;
+    dosfs_dir_t *dir_e;
+#endif /* (DOSFS_CONFIG_TRANSACTION_SAFE_SUPPORTED == 0) */
+#else  /* (DOSFS_CONFIG_VFAT_SUPPORTED == 1) */
+#if (DOSFS_CONFIG_TRANSACTION_SAFE_SUPPORTED == 0)
+    dosfs_dir_t *dir;
+#endif /* (DOSFS_CONFIG_TRANSACTION_SAFE_SUPPORTED == 0) */
+#endif /* (DOSFS_CONFIG_VFAT_SUPPORTED == 1) */
+    dosfs_cache_entry_t *entry;
+
+    if (index == 0x00010000)
+    {
+	status = F_ERR_NOMOREENTRY;
+    }
+    else
+    {
+#if (DOSFS_CONFIG_VFAT_SUPPORTED == 1)
+	if (!dosname && ((volume->dir.dir_name[0] == '\0') || (volume->dir.dir_nt_reserved & DOSFS_DIR_TYPE_LOSSY)))
+	{
+	    dosfs_name_uniname_to_dosname(volume->lfn_name, volume->lfn_count, volume->dir.dir_name, &prefix);
+
+	    volume->dir.dir_nt_reserved = 0;
+
+	    if (prefix)
+	    {
+		if (prefix > 6)
+		{
+		    prefix = 6;
+		}
+		
+		/* First check unique entries of the <name>~[1-9].<ext> form.
+		 */
+		
+		volume->dir.dir_name[prefix +0] = '~';
+		
+		mask = ((prefix +1) << 9);
+		
+		status = dosfs_path_find_unique(volume, clsno_d, &mask, NULL);
+
+		if (status == F_NO_ERROR)
+		{
+		    mask &= 0x000001ff;
+		
+		    if (mask != 0x000001ff)
+		    {
+			volume->dir.dir_name[prefix +1] = '1';
+			
+			while (mask & 1)
+			{
+			    volume->dir.dir_name[prefix +1] += 1;
+			    mask >>= 1;
+			}
+		    }
+		}
+	    }
+	    else
+	    {
+		mask = 0x000001ff;
+	    }
+
+	    if (status == F_NO_ERROR)
+	    {
+		if (mask & 1)
+		{
+		    /* Then check unique entries of the <name><checksum>~1.<ext> form.
+		     * Loop till a vaild unique name was found by stepping linear over
+		     * "chksum".
+		     */
+
+		    if (prefix > 2)
+		    {
+			prefix = 2;
+		    }
+
+		    chksum = dosfs_name_checksum_uniname(volume->lfn_name, volume->lfn_count);
+
+		    do
+		    {
+			volume->dir.dir_name[prefix +0] = dosfs_name_nibble_to_char_table[(chksum >> 12) & 15];
+			volume->dir.dir_name[prefix +1] = dosfs_name_nibble_to_char_table[(chksum >>  8) & 15];
+			volume->dir.dir_name[prefix +2] = dosfs_name_nibble_to_char_table[(chksum >>  4) & 15];
+			volume->dir.dir_name[prefix +3] = dosfs_name_nibble_to_char_table[(chksum >>  0) & 15];
+			volume->dir.dir_name[prefix +4] = '~';
+			volume->dir.dir_name[prefix +5] = '1';
+			
+			status = dosfs_path_find_unique(volume, clsno_d, NULL, &used);
+			
+			if (status == F_NO_ERROR) 
+			{
+			    if (used)
+			    {
+				chksum += 1;
+			    }
+			}
+		    }
+		    while ((status == F_NO_ERROR) && used);
+		}
+	    }
+	}
+	else
+	{
+	    volume->dir_entries = 0;
+	}
+
+	if (status == F_NO_ERROR)
+#endif /* (DOSFS_CONFIG_VFAT_SUPPORTED == 1) */
+	{
+	    clsno_s = DOSFS_CLSNO_NONE;
+
+	    if (index & 0x00020000)
+	    {
+		/* The appending of a new cluster to a directory is a tad tricky. One has to allocate
+		 * a cluster first, zero out it's contents, link the cluster to the end of the chain.
+		 * Also the fat cache has to be flushed as it's the final operation of a sequence (see f_mkdir).
+		 * The issue at hand is that if a new cluster is linked in that is not zeroed out, the
+		 * directory is invalid. One the other hand, we cannot write a directory entry to a directory
+		 * that has uncommited clusters in the fat cache.
+		 */
+		
+		status = dosfs_cluster_chain_create(volume, DOSFS_CLSNO_NONE, 1, &clsno_s, NULL);
+		
+		if (status == F_NO_ERROR)
+		{
+		    blkno_s = DOSFS_CLSNO_TO_BLKNO(clsno_s);
+
+		    status = dosfs_volume_zero(volume, blkno_s, volume->cls_blk_size, NULL);
+
+		    if (status == F_NO_ERROR)
+		    {
+			status = dosfs_cluster_write(volume, clsno, clsno_s, TRUE);
+
+			if (status == F_NO_ERROR)
+			{
+			    index &= ~0x00020000;
+
+			    if (!((index << DOSFS_DIR_SHIFT) & volume->cls_mask))
+			    {
+				clsno = clsno_s;
+
+				/* If "index" is the first one of a new cluster,
+				 * one might as well avoid having to read the 
+				 * dir_cache entry.
+				 */
+				status = dosfs_dir_cache_zero(volume, blkno_s, &entry);
+			    }
+			}
+		    }
+		}
+	    }
+
+#if (DOSFS_CONFIG_TRANSACTION_SAFE_SUPPORTED == 0)
+	    /* For TRANSACTION_SAFE all of this happens throu dosfs_volume_record().
+	     */
+	
+	    /* The fat cache needs to be flushed before any dir entry update.
+	     */
+	    status = dosfs_fat_cache_flush(volume);
+
+	    if (status == F_NO_ERROR)
+	    {
+		if (clsno == DOSFS_CLSNO_NONE)
+		{
+		    clsno = volume->root_clsno;
+		    blkno = volume->root_blkno + DOSFS_INDEX_TO_BLKCNT_ROOT(index);
+#if (DOSFS_CONFIG_VFAT_SUPPORTED == 1)
+		    blkno_e = volume->root_blkno + volume->root_blkcnt;
+#endif /* (DOSFS_CONFIG_VFAT_SUPPORTED == 1) */
+		}
+		else
+		{
+		    blkno = DOSFS_CLSNO_TO_BLKNO(clsno) + DOSFS_INDEX_TO_BLKCNT(index);
+#if (DOSFS_CONFIG_VFAT_SUPPORTED == 1)
+		    blkno_e = blkno + volume->cls_blk_size;
+#endif /* (DOSFS_CONFIG_VFAT_SUPPORTED == 1) */
+		}
+		
+		status = dosfs_dir_cache_read(volume, blkno, &entry);
+
+		if (status == F_NO_ERROR)
+		{
+		    dir = (dosfs_dir_t*)((void*)(entry->data + DOSFS_INDEX_TO_BLKOFS(index)));
+
+#if (DOSFS_CONFIG_VFAT_SUPPORTED == 1)
+		    if (volume->dir_entries != 0)
+		    {
+			dir_e = (dosfs_dir_t*)((void*)(entry->data + DOSFS_BLK_SIZE));
+
+			sequence = 0x40 | volume->dir_entries;
+			chksum = dosfs_name_checksum_dosname(volume->dir.dir_name);
+
+			do
+			{
+			    s = 0;
+			    i = ((sequence & 0x1f) - 1) * 13;
+		
+			    dir->dir_name[0] = sequence;
+			    dir->dir_attr = DOSFS_DIR_ATTR_LONG_NAME;
+			    dir->dir_nt_reserved = 0x00;
+			    dir->dir_crt_time_tenth = chksum;
+			    dir->dir_clsno_lo = 0x0000;
+		
+			    do
+			    {
+				offset = dosfs_path_ldir_name_table[s++];
+		    
+				if (i < volume->lfn_count)
+				{
+				    cc = volume->lfn_name[i];
+			
+				    ((uint8_t*)dir)[offset +0] = cc;
+				    ((uint8_t*)dir)[offset +1] = cc >> 8;
+				}
+				else
+				{
+				    if (i == volume->lfn_count)
+				    {
+					((uint8_t*)dir)[offset +0] = 0x00;
+					((uint8_t*)dir)[offset +1] = 0x00;
+				    }
+				    else
+				    {
+					((uint8_t*)dir)[offset +0] = 0xff;
+					((uint8_t*)dir)[offset +1] = 0xff;
+				    }
+				}
+
+				i++;
+			    }
+			    while (s < 13);
+		
+			    dir++;
+
+			    if (dir == dir_e)
+			    {
+				status = dosfs_dir_cache_write(volume);
+
+				blkno++;
+
+				if (blkno == blkno_e)
+				{
+				    status = dosfs_cluster_read(volume, clsno, &clsno);
+		
+				    if (status == F_NO_ERROR)
+				    {
+					blkno = DOSFS_CLSNO_TO_BLKNO(clsno);
+					blkno_e = blkno + volume->cls_blk_size;
+				    }
+				}
+
+				if (status == F_NO_ERROR)
+				{
+				    status = dosfs_dir_cache_read(volume, blkno, &entry);
+
+				    if (status == F_NO_ERROR)
+				    {
+					dir = (dosfs_dir_t*)((void*)(entry->data));
+				    }
+				}
+			    }
+
+			    sequence = (sequence & 0x1f) -1;
+			}
+			while ((status == F_NO_ERROR) && (sequence != 0));
+		    }
+
+		    if (status == F_NO_ERROR)
+#endif /* (DOSFS_CONFIG_VFAT_SUPPORTED == 1) */
+		    {
+			/* Special semantics if "first_clsno" == DOSFS_CLUSTER_END_OF_CHAIN. In that
+			 * case volume->dir contains a valid template from f_rename, and
+			 * "attr" gets merged with volume->dir.dir_nt_reserved (as this
+			 * gets blown away by the name conversion).
+			 */
+			if (first_clsno == DOSFS_CLSNO_END_OF_CHAIN)
+			{
+			    memcpy(dir, &volume->dir, sizeof(dosfs_dir_t));
+
+			    dir->dir_nt_reserved = ((volume->dir.dir_nt_reserved & (DOSFS_DIR_TYPE_LCASE_NAME | DOSFS_DIR_TYPE_LCASE_EXT)) |
+						    (attr & ~(DOSFS_DIR_TYPE_LCASE_NAME | DOSFS_DIR_TYPE_LCASE_EXT)));
+			}
+			else
+			{
+			    dosfs_path_setup_entry(volume, dosname, attr, first_clsno, ctime, cdate, dir);
+			}
+
+#if (DOSFS_CONFIG_DIR_INDEX_ENTRIES != 0)
+			dosfs_path_index_insert(volume, clsno_d, clsno_s, index, dir);
+#endif /* (DOSFS_CONFIG_DIR_INDEX_ENTRIES != 0) */
+
+			status = dosfs_dir_cache_write(volume);
+		    }
+		}
+	    }
+
+#else /* (DOSFS_CONFIG_TRANSACTION_SAFE_SUPPORTED == 0) */
+	
+	    if (status == F_NO_ERROR)
+	    {
+		/* Special semantics if "first_clsno" == DOSFS_CLUSTER_END_OF_CHAIN. In that
+		 * case volume->dir contains a valid template from f_rename, and
+		 * "attr" gets merged with volume->dir.dir_nt_reserved (as this
+		 * gets blown away by the name conversion).
+		 */
+		if (first_clsno == DOSFS_CLSNO_END_OF_CHAIN)
+		{
+		    volume->dir.dir_nt_reserved = ((volume->dir.dir_nt_reserved & (DOSFS_DIR_TYPE_LCASE_NAME | DOSFS_DIR_TYPE_LCASE_EXT)) |
+						   (attr & ~(DOSFS_DIR_TYPE_LCASE_NAME | DOSFS_DIR_TYPE_LCASE_EXT)));
+		}
+		else
+		{
+		    dosfs_path_setup_entry(volume, dosname, attr, first_clsno, ctime, cdate, &volume->dir);
+		}
+
+		volume->dir_flags |= DOSFS_DIR_FLAG_CREATE_ENTRY;
+		volume->dir_clsno = clsno;
+		volume->dir_index = index;
+		volume->dot_clsno = clsno_d;
+
+		status = dosfs_volume_record(volume);
+	    }
+#endif /* (DOSFS_CONFIG_TRANSACTION_SAFE_SUPPORTED == 0) */
+	}
+    }
+
+#if (DOSFS_CONFIG_DIR_INDEX_ENTRIES != 0)
+#if (DOSFS_CONFIG_TRANSACTION_SAFE_SUPPORTED == 0)
+    if (status != F_NO_ERROR)
+#endif /* (DOSFS_CONFIG_TRANSACTION_SAFE_SUPPORTED == 0) */
+    {
+	volume->index_clsno = DOSFS_CLSNO_END_OF_CHAIN;
+    }
+#endif /* (DOSFS_CONFIG_DIR_INDEX_ENTRIES != 0) */
+
+    return status;
+}
+
+/* To destroy a directory/file, first the directory entry is deleted. Then the assocociated
+ * cluster chain is freed.
+ */
+
+#if (DOSFS_CONFIG_VFAT_SUPPORTED == 1)
+static int dosfs_path_destroy_entry(dosfs_volume_t *volume, uint32_t clsno, uint32_t index, uint32_t entries, uint32_t first_clsno)
+#else /* (DOSFS_CONFIG_VFAT_SUPPORTED == 1) */
+static int dosfs_path_destroy_entry(dosfs_volume_t *volume, uint32_t clsno, uint32_t index, uint32_t first_clsno)
+#endif /* (DOSFS_CONFIG_VFAT_SUPPORTED == 1) */
+{
+    int status = F_NO_ERROR;
+#if (DOSFS_CONFIG_TRANSACTION_SAFE_SUPPORTED == 0)
+#if (DOSFS_CONFIG_VFAT_SUPPORTED == 1)
+    unsigned int sequence;
+    uint32_t blkno, blkno_e;
+    dosfs_dir_t *dir, *dir_e;
+#else /* (DOSFS_CONFIG_VFAT_SUPPORTED == 1) */
+    uint32_t blkno;
+    dosfs_dir_t *dir;
+#endif /* (DOSFS_CONFIG_VFAT_SUPPORTED == 1) */
+    dosfs_cache_entry_t *entry;
+
+    if (clsno == DOSFS_CLSNO_NONE)
+    {
+	clsno = volume->root_clsno;
+	blkno = volume->root_blkno + DOSFS_INDEX_TO_BLKCNT_ROOT(index);
+#if (DOSFS_CONFIG_VFAT_SUPPORTED == 1)
+	blkno_e = volume->root_blkno + volume->root_blkcnt;
+#endif /* (DOSFS_CONFIG_VFAT_SUPPORTED == 1) */
+    }
+    else
+    {
+	blkno = DOSFS_CLSNO_TO_BLKNO(clsno) + DOSFS_INDEX_TO_BLKCNT(index);
+#if (DOSFS_CONFIG_VFAT_SUPPORTED == 1)
+	blkno_e = DOSFS_CLSNO_TO_BLKNO(clsno) + volume->cls_blk_size;
+#endif /* (DOSFS_CONFIG_VFAT_SUPPORTED == 1) */
+    }
+    
+    status = dosfs_dir_cache_read(volume, blkno, &entry);
+
+    if (status == F_NO_ERROR)
+    {
+        dir = (dosfs_dir_t*)((void*)(entry->data + DOSFS_INDEX_TO_BLKOFS(index)));
+
+#if (DOSFS_CONFIG_VFAT_SUPPORTED == 1)
+	if (entries != 0)
+	{
+	    sequence = entries;
+
+	    dir_e = (dosfs_dir_t*)((void*)(entry->data + DOSFS_BLK_SIZE));
+
+	    do
+	    {
+		dir->dir_name[0] = 0xe5;
+		
+		dir++;
+		
+		if (dir == dir_e)
+		{
+		    status = dosfs_dir_cache_write(volume);
+
+		    blkno++;
+
+		    if (blkno == blkno_e)
+		    {
+			status = dosfs_cluster_read(volume, clsno, &clsno);
+		
+			if (status == F_NO_ERROR)
+			{
+			    blkno = DOSFS_CLSNO_TO_BLKNO(clsno);
+			    blkno_e = blkno + volume->cls_blk_size;
+			}
+		    }
+
+		    if (status == F_NO_ERROR)
+		    {
+			status = dosfs_dir_cache_read(volume, blkno, &entry);
+
+			if (status == F_NO_ERROR)
+			{
+			    dir = (dosfs_dir_t*)((void*)(entry->data));
+			}
+		    }
+		}
+		
+		sequence--;
+	    }
+	    while ((status == F_NO_ERROR) && (sequence != 0));
+	}
+
+	if (status == F_NO_ERROR)
+#endif /* (DOSFS_CONFIG_VFAT_SUPPORTED == 1) */
+	{
+	    dir->dir_name[0] = 0xe5;
+        
+	    status = dosfs_dir_cache_write(volume);
+        
+	    if (status == F_NO_ERROR)
+	    {
+		if (first_clsno != DOSFS_CLSNO_NONE)
+		{
+		    status = dosfs_cluster_chain_destroy(volume, first_clsno, DOSFS_CLSNO_FREE);
+		}
+	    }
+	}
+
+
+	if (status == F_NO_ERROR)
+	{
+	    /* The post condition for dosfs_path_destroy_entry is that the fat cache
+	     * is flushed, so unconditionally do it here.
+	     */
+	    status = dosfs_fat_cache_flush(volume);
+	}
+    }
+
+#else /* (DOSFS_CONFIG_TRANSACTION_SAFE_SUPPORTED == 0) */
+
+    if (first_clsno != DOSFS_CLSNO_NONE)
+    {
+	status = dosfs_cluster_chain_destroy(volume, first_clsno, DOSFS_CLSNO_FREE);
+    }
+
+    if (status == F_NO_ERROR)
+    {
+	volume->dir_flags |= DOSFS_DIR_FLAG_DESTROY_ENTRY;
+	volume->del_clsno = clsno;
+	volume->del_index = index;
+#if (DOSFS_CONFIG_VFAT_SUPPORTED == 1)
+	volume->del_entries = entries;
+#endif /* (DOSFS_CONFIG_VFAT_SUPPORTED == 1) */
+
+	status = dosfs_volume_record(volume);
+    }
+
+#endif /* (DOSFS_CONFIG_TRANSACTION_SAFE_SUPPORTED == 0) */
+
+#if (DOSFS_CONFIG_DIR_INDEX_ENTRIES != 0)
+    volume->index_clsno = DOSFS_CLSNO_END_OF_CHAIN;
+#endif /* (DOSFS_CONFIG_DIR_INDEX_ENTRIES != 0) */
+
+#if (DOSFS_CONFIG_REOPEN_ENTRIES != 0)
+    dosfs_file_reopen_invalidate(volume, NULL);
+#endif /* (DOSFS_CONFIG_REOPEN_ENTRIES != 0) */
+
+    return status;
+}
+
+
+/*****************************************************************************************************************************************/
+
+
+static dosfs_file_t * dosfs_file_enumerate(dosfs_volume_t *volume, dosfs_file_t *file, uint32_t clsno, uint32_t index)
+{
+#if (DOSFS_CONFIG_MAX_FILES == 1)
+
+    dosfs_file_t *file_s;
+
+    if (file == NULL)
+    {
+	file_s = &volume->file_table[0];
+
+	if (file_s->mode && (file_s->dir_clsno == clsno) && (file_s->dir_index == index))
+	{
+	    file = file_s;
+	}
+    }
+
+#else /* (DOSFS_CONFIG_MAX_FILES == 1) */
+
+    dosfs_file_t *file_s, *file_e;
+
+    file_s = (file == NULL) ? &volume->file_table[0] : file + 1;
+    file_e = &volume->file_table[DOSFS_CONFIG_MAX_FILES];
+
+    file = NULL;
+
+    do
+    {
+	if (file_s->mode && (file_s->dir_clsno == clsno) && (file_s->dir_index == index))
+	{
+	    file = file_s;
+	    break;
+	}
+
+	file_s++;
+    }
+    while (file_s < file_e);
+#endif /* (DOSFS_CONFIG_MAX_FILES == 1) */
+
+    return file;
+}
+
+static int dosfs_file_sync(dosfs_volume_t *volume, dosfs_file_t *file, int access, int modify, uint32_t first_clsno, uint32_t length)
+{
+    int status = F_NO_ERROR;
+    uint16_t ctime, cdate;
+#if (DOSFS_CONFIG_TRANSACTION_SAFE_SUPPORTED == 0)
+    uint32_t clsno, blkno, index;
+    dosfs_cache_entry_t *entry;
+    dosfs_dir_t *dir;
+#endif /* (DOSFS_CONFIG_TRANSACTION_SAFE_SUPPORTED == 0) */
+
+#if (DOSFS_CONFIG_TRANSACTION_SAFE_SUPPORTED == 1)
+
+    volume->dir.dir_clsno_lo = DOSFS_HTOFS(first_clsno & 0xffff);
+    volume->dir.dir_file_size = DOSFS_HTOFL(length);
+    
+    if (volume->type == DOSFS_VOLUME_TYPE_FAT32)
+    {
+	volume->dir.dir_clsno_hi = DOSFS_HTOFS(first_clsno >> 16);
+    }
+    
+    volume->dir_flags |= DOSFS_DIR_FLAG_SYNC_ENTRY;
+    
+    if (access || modify)
+    {
+#if defined(DOSFS_PORT_CORE_TIMEDATE)
+	DOSFS_PORT_CORE_TIMEDATE(&ctime, &cdate);
+#else /* DOSFS_PORT_CORE_TIMEDATE */
+	ctime = 0;
+	cdate = 0;
+#endif /* DOSFS_PORT_CORE_TIMEDATE */
+
+	if (access)
+	{
+	    if (volume->type == DOSFS_VOLUME_TYPE_FAT32)
+	    {
+		volume->dir.dir_acc_date = DOSFS_HTOFS(cdate);
+		    
+		volume->dir_flags |= DOSFS_DIR_FLAG_ACCESS_ENTRY;
+	    }
+	}
+
+	if (modify)
+	{
+	    volume->dir.dir_wrt_time = DOSFS_HTOFS(ctime);
+	    volume->dir.dir_wrt_date = DOSFS_HTOFS(cdate);
+
+	    volume->dir_flags |= DOSFS_DIR_FLAG_MODIFY_ENTRY;
+	}
+    }
+	
+    volume->dir_clsno = file->dir_clsno;
+    volume->dir_index = file->dir_index;
+#if (DOSFS_CONFIG_VFAT_SUPPORTED == 1)
+    volume->dir_entries = 0;
+#endif /* (DOSFS_CONFIG_VFAT_SUPPORTED == 1) */
+
+    status = dosfs_volume_record(volume);
+
+#else /* (DOSFS_CONFIG_TRANSACTION_SAFE_SUPPORTED == 1) */
+
+    status = dosfs_fat_cache_flush(volume);
+
+    if (status == F_NO_ERROR)
+    {
+	clsno = file->dir_clsno;
+	index = file->dir_index;
+
+	if (clsno == DOSFS_CLSNO_NONE)
+	{
+	    blkno = volume->root_blkno + DOSFS_INDEX_TO_BLKCNT_ROOT(index);
+	}
+	else
+	{
+	    blkno = DOSFS_CLSNO_TO_BLKNO(clsno) + DOSFS_INDEX_TO_BLKCNT(index);
+	}
+    
+	status = dosfs_dir_cache_read(volume, blkno, &entry);
+    
+	if (status == F_NO_ERROR)
+	{
+	    dir = (dosfs_dir_t*)((void*)(entry->data + DOSFS_INDEX_TO_BLKOFS(index)));
+
+	    dir->dir_clsno_lo = DOSFS_HTOFS(first_clsno & 0xffff);
+	    dir->dir_file_size = DOSFS_HTOFL(length);
+	
+	    if (volume->type == DOSFS_VOLUME_TYPE_FAT32)
+	    {
+		dir->dir_clsno_hi = DOSFS_HTOFS(first_clsno >> 16);
+	    }
+	
+	    if (access || modify)
+	    {
+#if defined(DOSFS_PORT_CORE_TIMEDATE)
+		DOSFS_PORT_CORE_TIMEDATE(&ctime, &cdate);
+#else /* DOSFS_PORT_CORE_TIMEDATE */
+		ctime = 0;
+		cdate = 0;
+#endif /* DOSFS_PORT_CORE_TIMEDATE */
+
+		if (access)
+		{
+		    if (volume->type == DOSFS_VOLUME_TYPE_FAT32)
+		    {
+			dir->dir_acc_date = DOSFS_HTOFS(cdate);
+		    }
+		}
+
+		if (modify)
+		{
+		    dir->dir_attr |= DOSFS_DIR_ATTR_ARCHIVE;
+		    dir->dir_wrt_time = DOSFS_HTOFS(ctime);
+		    dir->dir_wrt_date = DOSFS_HTOFS(cdate);
+		}
+	    }
+
+	    status = dosfs_dir_cache_write(volume);
+
+	    if (status == F_NO_ERROR)
+	    {
+		status = dosfs_volume_clean(volume, status);
+	    }
+	}
+    }
+#endif /* (DOSFS_CONFIG_TRANSACTION_SAFE_SUPPORTED == 1) */
+
+    return status;
+}
+
+
+static int dosfs_file_flush(dosfs_volume_t *volume, dosfs_file_t *file, int close)
+{
+    int status = F_NO_ERROR;
+    dosfs_device_t *device;
+
+    device = DOSFS_VOLUME_DEVICE(volume);
+
+    if (volume->state == DOSFS_VOLUME_STATE_MOUNTED)
+    {
+	/* The data cache is first flushed and outstanding disk operations
+	 * are finished. Then however the fat cache flush and  the directory updates
+	 * are only performed uncoditionally irregardless of whether there were
+	 * outstanding errors.
+	 */
+
+	status = dosfs_data_cache_flush(volume, file);
+
+	if (status == F_NO_ERROR)
+	{
+	    status = dosfs_device_sync(device, true);
+	}
+
+	if (file->status == F_NO_ERROR)
+	{
+	    file->status = status;
+	}
+
+	if (close || (file->flags & (DOSFS_FILE_FLAG_DIR_MODIFIED | DOSFS_FILE_FLAG_DATA_MODIFIED)))
+	{
+	    status = dosfs_file_sync(volume, file, close, (file->flags & (DOSFS_FILE_FLAG_DIR_MODIFIED | DOSFS_FILE_FLAG_DATA_MODIFIED)), file->first_clsno, file->length);
+	}
+    }
+
+    if (status == F_NO_ERROR)
+    {
+	file->flags &= ~(DOSFS_FILE_FLAG_DATA_MODIFIED | DOSFS_FILE_FLAG_DIR_MODIFIED);
+    }
+
+    if (file->status != F_NO_ERROR)
+    {
+	status = file->status;
+    }
+
+    return status;
+}
+
+#if (DOSFS_CONFIG_EXTENT_ENTRIES != 0)
+
+/* The extent map is a run-length version of the cluster chain. It gets built once by
+ * walking the chain, and after that any cluster index within the covered range maps
+ * to a clsno via a binary search, without touching the FAT. If the file has more
+ * fragments than DOSFS_CONFIG_EXTENT_ENTRIES, only the leading part is covered, and
+ * lookups past that walk the chain from the last covered cluster.
+ *
+ * The map is only used for files not open for writing, so the chain cannot change
+ * underneath it.
+ */
+static int dosfs_file_extent_build(dosfs_volume_t *volume, dosfs_file_t *file)
+{
+    int status = F_NO_ERROR;
+    uint32_t clsno, clsidx, clscnt, clsdata, count;
+
+    clsno = file->first_clsno;
+    clscnt = DOSFS_SIZE_TO_CLSCNT(file->length);
+
+    if ((clsno != DOSFS_CLSNO_NONE) && (clscnt != 0))
+    {
+	file->extent_table[0].clsidx = 0;
+	file->extent_table[0].clsno = clsno;
+
+	count = 1;
+	clsidx = 1;
+
+	while (clsidx < clscnt)
+	{
+	    status = dosfs_cluster_read(volume, clsno, &clsdata);
+
+	    if (status != F_NO_ERROR)
+	    {
+		break;
+	    }
+
+	    if (!((clsdata >= 2) && (clsdata <= volume->last_clsno)))
+	    {
+		/* A short chain gets reported by the regular path.
+		 */
+		break;
+	    }
+
+	    if (clsdata != (clsno +1))
+	    {
+		if (count == DOSFS_CONFIG_EXTENT_ENTRIES)
+		{
+		    break;
+		}
+
+		file->extent_table[count].clsidx = clsidx;
+		file->extent_table[count].clsno = clsdata;
+		count++;
+	    }
+
+	    clsno = clsdata;
+	    clsidx++;
+	}
+
+	if (status == F_NO_ERROR)
+	{
+	    file->extent_count = count;
+	    file->extent_clscnt = clsidx;
+	}
+    }
+
+    return status;
+}
+
+static int dosfs_file_extent_seek(dosfs_volume_t *volume, dosfs_file_t *file, uint32_t clsidx, uint32_t *p_clsno)
+{
+    int status = F_NO_ERROR;
+    uint32_t index, index_l, index_h;
+    dosfs_extent_t *extent;
+
+    if (clsidx < file->extent_clscnt)
+    {
+	index_l = 0;
+	index_h = file->extent_count -1;
+
+	while (index_l < index_h)
+	{
+	    index = (index_l + index_h +1) >> 1;
+
+	    if (file->extent_table[index].clsidx <= clsidx)
+	    {
+		index_l = index;
+	    }
+	    else
+	    {
+		index_h = index -1;
+	    }
+	}
+
+	extent = &file->extent_table[index_l];
+
+	*p_clsno = extent->clsno + (clsidx - extent->clsidx);
+    }
+    else
+    {
+	extent = &file->extent_table[file->extent_count -1];
+
+	status = dosfs_cluster_chain_seek(volume, extent->clsno + ((file->extent_clscnt -1) - extent->clsidx), (clsidx - (file->extent_clscnt -1)), p_clsno);
+    }
+
+    return status;
+}
+
+#endif /* (DOSFS_CONFIG_EXTENT_ENTRIES != 0) */
+
+/* Advance from "clsno" to the cluster containing "position", which is at a cluster
+ * boundary.
+ */
+static int dosfs_file_cluster_next(dosfs_volume_t *volume, dosfs_file_t *file, uint32_t clsno, uint32_t position, uint32_t *p_clsno)
+{
+#if (DOSFS_CONFIG_EXTENT_ENTRIES != 0)
+    if (DOSFS_OFFSET_TO_CLSCNT(position) < file->extent_clscnt)
+    {
+	return dosfs_file_extent_seek(volume, file, DOSFS_OFFSET_TO_CLSCNT(position), p_clsno);
+    }
+#endif /* (DOSFS_CONFIG_EXTENT_ENTRIES != 0) */
+
+    return dosfs_cluster_chain_seek(volume, clsno, 1, p_clsno);
+}
+
+static int dosfs_file_seek(dosfs_volume_t *volume, dosfs_file_t *file, uint32_t position)
+{
+    int status = F_NO_ERROR;
+    uint32_t clsno, clscnt, offset;
+
+    if ((file->mode & DOSFS_FILE_MODE_WRITE) && ((file->position & ~DOSFS_BLK_MASK) != (position & ~DOSFS_BLK_MASK)))
+    {
+	status = dosfs_data_cache_flush(volume, file);
+    }
+
+    if (status == F_NO_ERROR)
+    {
+	if (position == 0)
+	{
+	    /* A seek to position 0 (i.e. rewind) always succeeds.
+	     */
+	    if (file->first_clsno != DOSFS_CLSNO_NONE)
+	    {
+		file->clsno = file->first_clsno;
+		file->blkno = DOSFS_CLSNO_TO_BLKNO(file->clsno);
+		file->blkno_e = file->blkno + volume->cls_blk_size;
+	    }
+	
+	    file->position = 0;
+	}
+	else
+	{
+	    if (file->position != position)
+	    {
+		if (file->length == 0)
+		{
+		    /* Any seek for file->length == 0 always succeeds.
+		     */
+		    file->position = position;
+		}
+		else
+		{
+		    if (file->first_clsno == DOSFS_CLSNO_NONE)
+		    {
+			/* A seek to any non-zero position with no
+			 * cluster in the chain is an error.
+			 */
+			status = F_ERR_EOF;
+		    }
+		    else
+		    {
+			if (position < file->length)
+			{
+			    offset = position;
+			}
+			else
+			{
+			    offset = file->length;
+			}
+
+			if (status == F_NO_ERROR)
+			{
+#if (DOSFS_CONFIG_CONTIGUOUS_SUPPORTED == 1)
+			    if (file->flags & DOSFS_FILE_FLAG_CONTIGUOUS)
+			    {
+				clsno = file->first_clsno + DOSFS_OFFSET_TO_CLSCNT(offset -1);
+			    }
+			    else
+#endif /* (DOSFS_CONFIG_CONTIGUOUS_SUPPORTED == 1) */
+			    {
+				if ((offset == file->length) && (file->last_clsno != DOSFS_CLSNO_NONE))
+				{
+				    clsno = file->last_clsno;
+				}
+				else
+				{
+#if (DOSFS_CONFIG_EXTENT_ENTRIES != 0)
+				    if (!(file->mode & DOSFS_FILE_MODE_WRITE) && (file->extent_clscnt == 0) && (DOSFS_OFFSET_TO_CLSCNT(offset -1) != 0))
+				    {
+					status = dosfs_file_extent_build(volume, file);
+				    }
+
+				    if ((status == F_NO_ERROR) && (file->extent_clscnt != 0))
+				    {
+					status = dosfs_file_extent_seek(volume, file, DOSFS_OFFSET_TO_CLSCNT(offset -1), &clsno);
+				    }
+				    else if (status == F_NO_ERROR)
+#endif /* (DOSFS_CONFIG_EXTENT_ENTRIES != 0) */
+				    {
+					if ((file->position == 0) || (file->position > offset))
+					{
+					    clsno = file->first_clsno;
+					    clscnt = DOSFS_OFFSET_TO_CLSCNT(offset -1);
+					}
+					else
+					{
+					    clsno = file->clsno;
+					    clscnt = DOSFS_OFFSET_TO_CLSCNT(offset -1) - DOSFS_OFFSET_TO_CLSCNT(file->position -1);
+					}
+
+					if (clscnt != 0)
+					{
+					    status = dosfs_cluster_chain_seek(volume, clsno, clscnt, &clsno);
+					}
+				    }
+				}
+			    }
+			
+			    if (status == F_NO_ERROR)
+			    {
+				file->position = position;
+				file->clsno = clsno;
+
+				if (!(offset & volume->cls_mask))
+				{
+				    file->blkno = DOSFS_CLSNO_TO_BLKNO(clsno) + volume->cls_blk_size;
+				    file->blkno_e = file->blkno;
+				}
+				else
+				{
+				    file->blkno = DOSFS_CLSNO_TO_BLKNO(clsno) + DOSFS_OFFSET_TO_BLKCNT(offset);
+				    file->blkno_e = DOSFS_CLSNO_TO_BLKNO(clsno) + volume->cls_blk_size;
+				}
+
+				if (offset == file->length)
+				{
+				    file->last_clsno = clsno;
+				}
+			    }
+			}
+		    }
+		}
+	    }
+	}
+    }
+
+    return status;
+}
+
+static int dosfs_file_shrink(dosfs_volume_t *volume, dosfs_file_t *file)
+{
+    int status = F_NO_ERROR;
+
+    if (file->position == 0)
+    {
+	if (file->first_clsno != DOSFS_CLSNO_NONE)
+	{
+#if (DOSFS_CONFIG_TRANSACTION_SAFE_SUPPORTED == 1)
+
+	    /* Defer the deletion of file->first_clsno to the next dosfs_file_flush(),
+	     * so that file->first_clsno ends up on the disk before the cluster is made
+	     * available again.
+	     */
+		   
+	    status = dosfs_cluster_chain_destroy(volume, file->first_clsno, DOSFS_CLSNO_FREE);
+
+	    if (status == F_NO_ERROR)
+	    {
+		status = dosfs_file_sync(volume, file, FALSE, FALSE, DOSFS_CLSNO_NONE, file->length);
+	    }
+
+#else /* (DOSFS_CONFIG_TRANSACTION_SAFE_SUPPORTED == 1) */
+
+	    /* To be on the safe side, the directory entry on the disk is updated first,
+	     * so that "file->length" is always correct, and in case the whole chain gets
+	     * deleted "file->first_clsno" on disk is properly zeroed out.
+	     */
+
+	    status = dosfs_file_sync(volume, file, FALSE, FALSE, DOSFS_CLSNO_NONE, file->length);
+
+	    if (status == F_NO_ERROR)
+	    {
+		status = dosfs_volume_dirty(volume);
+
+		if (status == F_NO_ERROR)
+		{
+		    status = dosfs_cluster_chain_destroy(volume, file->first_clsno, DOSFS_CLSNO_FREE);
+		}
+	    }
+#endif /* (DOSFS_CONFIG_TRANSACTION_SAFE_SUPPORTED == 1) */
+	}
+
+	if (status == F_NO_ERROR)
+	{
+	    file->first_clsno = DOSFS_CLSNO_NONE;
+	    file->last_clsno = DOSFS_CLSNO_NONE;
+		
+	    /* file->position is 0 here, but clsno/blkno/blkno_e
+	     * point to the first cluster, which just got deleted.
+	     */
+	    file->clsno = DOSFS_CLSNO_NONE;
+	    file->blkno = DOSFS_BLKNO_INVALID;
+	    file->blkno_e = DOSFS_BLKNO_INVALID;
+	}
+    }
+    else
+    {
+	if (file->clsno != DOSFS_CLSNO_NONE)
+	{
+#if (DOSFS_CONFIG_TRANSACTION_SAFE_SUPPORTED == 0)
+	    status = dosfs_volume_dirty(volume);
+
+	    if (status == F_NO_ERROR)
+#endif /* (DOSFS_CONFIG_TRANSACTION_SAFE_SUPPORTED == 0) */
+	    {
+		status = dosfs_cluster_chain_destroy(volume, file->clsno, DOSFS_CLSNO_END_OF_CHAIN);
+		
+		if (status == F_NO_ERROR)
+		{
+		    file->last_clsno = file->clsno;
+		}
+	    }
+	}
+	else
+	{
+	    status = F_ERR_EOF;
+	}
+    }
+
+    if (status == F_NO_ERROR)
+    {
+	if (file->length != file->position)
+	{
+	    file->flags |= DOSFS_FILE_FLAG_DIR_MODIFIED;
+	    file->length = file->position;
+	}
+
+	file->flags |= DOSFS_FILE_FLAG_END_OF_CHAIN;
+
+#if (DOSFS_CONFIG_CONTIGUOUS_SUPPORTED == 1)
+	if (file->flags & DOSFS_FILE_FLAG_CONTIGUOUS)
+	{
+	    if (file->length >= (DOSFS_FILE_SIZE_MAX & ~volume->cls_mask))
+	    {
+		file->size = DOSFS_FILE_SIZE_MAX;
+	    }
+	    else
+	    {
+		file->size = (file->length + volume->cls_mask) & ~volume->cls_mask;
+	    }
+	}
+#endif /* (DOSFS_CONFIG_CONTIGUOUS_SUPPORTED == 1) */
+    }
+
+    if (file->status == F_NO_ERROR)
+    {
+	file->status = status;
+    }
+
+    return status;
+}
+
+static int dosfs_file_extend(dosfs_volume_t *volume, dosfs_file_t *file, uint32_t length)
+{
+    int status = F_NO_ERROR;
+    uint32_t clsno, clscnt, clsno_a, clsno_l, clsno_n, clsdata, blkno, blkno_e, blkcnt, count, size, position, offset, length_o;
+    dosfs_cache_entry_t *entry;
+
+    /* Compute below:
+     *
+     * clsno      file->last_clsno or DOSFS_CLSNO_NONE (corresponding to file->length)
+     * clsno_l    file->last_clsno (corresponding to length)
+     * clsno_n    next cluster after clsno (or first allocated)
+     */
+
+    length_o = file->length;
+
+#if (DOSFS_CONFIG_CONTIGUOUS_SUPPORTED == 1)
+    if (file->flags & DOSFS_FILE_FLAG_CONTIGUOUS)
+    {
+	if (length_o == 0)
+	{
+	    clsno = file->first_clsno;
+	    clsno_n = clsno;
+	}
+	else
+	{
+	    clsno = file->first_clsno + DOSFS_OFFSET_TO_CLSCNT(length_o -1);
+	    clsno_n = clsno +1;
+	}
+
+	clsno_l = file->first_clsno + DOSFS_OFFSET_TO_CLSCNT(length -1);
+    }
+    else
+#endif /* (DOSFS_CONFIG_CONTIGUOUS_SUPPORTED == 1) */
+    {
+	if (length_o == 0)
+	{
+	    clsno = file->first_clsno;
+	}
+	else
+	{
+	    if (file->first_clsno == DOSFS_CLSNO_NONE)
+	    {
+		clsno = DOSFS_CLSNO_NONE;
+		length_o = 0;
+	    }
+	    else
+	    {
+		if (file->last_clsno != DOSFS_CLSNO_NONE)
+		{
+		    clsno = file->last_clsno;
+		}
+		else
+		{
+		    if (!file->position || (file->position > length_o))
+		    {
+			clsno = file->first_clsno;
+			clscnt = DOSFS_OFFSET_TO_CLSCNT(length_o -1);
+		    }
+		    else
+		    {
+			clsno = file->clsno;
+			clscnt = DOSFS_OFFSET_TO_CLSCNT(length_o -1) - DOSFS_OFFSET_TO_CLSCNT(file->position -1);
+		    }
+		    
+		    if (clscnt != 0)
+		    {
+			status = dosfs_cluster_chain_seek(volume, clsno, clscnt, &clsno);
+		    }
+		}
+
+		if (status == F_NO_ERROR)
+		{
+		    file->last_clsno = clsno;
+		}
+	    }
+	}
+
+	if (status == F_NO_ERROR)
+	{
+	    if ((length_o == 0) || (clsno == DOSFS_CLSNO_NONE))
+	    {
+		clscnt = DOSFS_SIZE_TO_CLSCNT(length);
+	    }
+	    else
+	    {
+		clscnt = DOSFS_SIZE_TO_CLSCNT(length) - DOSFS_SIZE_TO_CLSCNT(length_o);
+	    }
+	    
+	    clsno_l = clsno;
+	    clsno_n = DOSFS_CLSNO_NONE;
+
+	    if (clscnt)
+	    {
+		/* While the last cluster had not been seen yet, step throu the trailing 
+		 * list and make use of what had been there already.
+		 *
+		 * Normally this should only set DOSFS_FILE_FLAG_END_OF_CHAIN, but there might
+		 * be dangling, orphaned entries which one might make use of to begin with.
+		 *
+		 * N.b. file_first_clsno == DOSFS_CLSNO_NONE implies DOSFS_FILE_FLAG_END_OF_CHAIN 
+		 * set.
+		 */
+
+		if (!(file->flags & DOSFS_FILE_FLAG_END_OF_CHAIN))
+		{
+		    do
+		    {
+			status = dosfs_cluster_read(volume, clsno_l, &clsdata);
+			
+			if (status == F_NO_ERROR)
+			{
+			    if (clsdata >= DOSFS_CLSNO_LAST)
+			    {
+				file->flags |= DOSFS_FILE_FLAG_END_OF_CHAIN;
+			    }
+			    else
+			    {
+				if ((clsdata >= 2) && (clsdata <= volume->last_clsno))
+				{
+				    if (clsno_n == DOSFS_CLSNO_NONE)
+				    {
+					clsno_n = clsdata;
+				    }
+
+				    clsno_l = clsdata;
+				    clscnt--;
+				}
+				else
+				{
+				    status = F_ERR_EOF;
+				}
+			    }
+			}
+		    }
+		    while ((status == F_NO_ERROR) && !(file->flags & DOSFS_FILE_FLAG_END_OF_CHAIN) && (clscnt != 0));
+		}
+
+		if (status == F_NO_ERROR)
+		{
+		    if (clscnt)
+		    {
+#if (DOSFS_CONFIG_TRANSACTION_SAFE_SUPPORTED == 0)
+			status = dosfs_volume_dirty(volume);
+			
+			if (status == F_NO_ERROR)
+#endif /* (DOSFS_CONFIG_TRANSACTION_SAFE_SUPPORTED == 0) */
+			{
+#if (DOSFS_CONFIG_SEQUENTIAL_SUPPORTED == 1)
+			    if (file->mode & DOSFS_FILE_MODE_SEQUENTIAL)
+			    {
+				status = dosfs_cluster_chain_create_sequential(volume, clsno_l, clscnt, &clsno_a, &clsno_l);
+			    }
+			    else
+#endif /* (DOSFS_CONFIG_SEQUENTIAL_SUPPORTED == 1) */
+			    {
+				status = dosfs_cluster_chain_create(volume, clsno_l, clscnt, &clsno_a, &clsno_l);
+			    }
+
+			    if (clsno_n == DOSFS_CLSNO_NONE)
+			    {
+				clsno_n = clsno_a;
+			    }
+			}
+		    }
+		}
+
+		if (status == F_NO_ERROR)
+		{
+		    if (file->first_clsno == DOSFS_CLSNO_NONE)
+		    {
+			file->first_clsno = clsno_n;
+			
+			file->clsno = clsno_n;
+			file->blkno = DOSFS_CLSNO_TO_BLKNO(clsno_n);
+			file->blkno_e = file->blkno + volume->cls_blk_size;
+
+			/* If a new cluster chain gets created, the dir entry needs to be updated to
+			 * not lose the cluster chain.
+			 */
+			
+			status = dosfs_file_sync(volume, file, FALSE, FALSE, file->first_clsno, file->length);
+		    }
+		}
+	    }
+	}
+    }
+
+    if (status == F_NO_ERROR)
+    {
+	file->flags |= DOSFS_FILE_FLAG_DIR_MODIFIED;
+	file->last_clsno = clsno_l;
+	file->length = length;
+
+	if (file->position > length_o)
+	{
+	    position = length_o;
+	    offset = (length_o + DOSFS_BLK_MASK) & ~DOSFS_BLK_MASK;
+	    count  = file->position - length_o;
+
+	    if (!(position & volume->cls_mask))
+	    {
+		/* If the old file->length was on a cluster boundary, then the 
+		 * old cached file data should be flushed to get a nice sequential
+		 * write sequence.
+		 */
+		status = dosfs_data_cache_flush(volume, file);
+
+		if (status == F_NO_ERROR)
+		{
+		    clsno = clsno_n;
+		}
+	    }
+
+	    if (status == F_NO_ERROR)
+	    {
+		blkno = DOSFS_CLSNO_TO_BLKNO(clsno) + DOSFS_OFFSET_TO_BLKCNT(position);
+		blkno_e = DOSFS_CLSNO_TO_BLKNO(clsno) + volume->cls_blk_size;
+
+		if (((position & DOSFS_BLK_MASK) + count) < DOSFS_BLK_SIZE)
+		{
+		    /* All data is within one block, simply go throu the cache.
+		     * If the block is beyond the old file->length, is has to 
+		     * be all zeros. Otherwise got throu the normal cache.
+		     */
+		
+		    if (position >= offset)
+		    {
+			status = dosfs_data_cache_zero(volume, file, blkno, &entry);
+		    }
+		    else
+		    {
+			status = dosfs_data_cache_read(volume, file, blkno, &entry);
+		    
+			if (status == F_NO_ERROR)
+			{
+			    memset(entry->data + (position & DOSFS_BLK_MASK), 0, count);
+			}
+		    }
+		
+		    if (status == F_NO_ERROR)
+		    {
+			dosfs_data_cache_modify(volume, file);
+		    
+			position += count;
+			count = 0;
+		    
+			if (!(position & DOSFS_BLK_MASK))
+			{
+			    blkno++;
+			}
+		    }
+		}
+		else
+		{
+		    if (position & DOSFS_BLK_MASK)
+		    {
+			size = (DOSFS_BLK_SIZE - (position & DOSFS_BLK_MASK));
+
+			if (position >= offset)
+			{
+			    status = dosfs_data_cache_zero(volume, file, blkno, &entry);
+			}
+			else
+			{ 
+			    status = dosfs_data_cache_read(volume, file, blkno, &entry);
+			
+			    if (status == F_NO_ERROR)
+			    {
+				memset(entry->data + (DOSFS_BLK_SIZE - size), 0, size);
+			    }
+			}
+		    
+			if (status == F_NO_ERROR)
+			{
+			    dosfs_data_cache_modify(volume, file);
+
+			    status = dosfs_data_cache_write(volume, file);
+			
+			    if (status == F_NO_ERROR)
+			    {
+				position += size;
+				count -= size;
+                            
+				blkno++;
+			    }
+			}
+		    }
+
+		    while ((status == F_NO_ERROR) && (count != 0))
+		    {
+			if (blkno == blkno_e)
+			{
+			    status = dosfs_data_cache_flush(volume, file);
+
+			    if (status == F_NO_ERROR)
+			    {
+#if (DOSFS_CONFIG_CONTIGUOUS_SUPPORTED == 1)
+				if (file->flags & DOSFS_FILE_FLAG_CONTIGUOUS)
+				{
+				    clsno++;
+				    blkno_e += volume->cls_blk_size;
+				}
+				else
+#endif /* (DOSFS_CONFIG_CONTIGUOUS_SUPPORTED == 1) */
+				{
+				    status = dosfs_cluster_chain_seek(volume, clsno, 1, &clsno);
+					
+				    if (status == F_NO_ERROR)
+				    {
+					blkno = DOSFS_CLSNO_TO_BLKNO(clsno);
+					blkno_e = blkno + volume->cls_blk_size;
+				    }
+				}
+			    }
+			}
+			
+			if (status == F_NO_ERROR)
+			{
+			    if (count < DOSFS_BLK_SIZE)
+			    {
+				status = dosfs_data_cache_zero(volume, file, blkno, &entry);
+			    
+				if (status == F_NO_ERROR)
+				{
+				    dosfs_data_cache_modify(volume, file);
+				
+				    position += count;
+				    count = 0;
+				}
+			    }
+			    else
+			    {
+				size = volume->cls_size - (position & volume->cls_mask);
+			    
+				if (size > count)
+				{
+				    size = count & ~DOSFS_BLK_MASK;
+				}
+			    
+				blkcnt = size >> DOSFS_BLK_SHIFT;
+			    
+				status = dosfs_data_cache_invalidate(volume, file, blkno, blkcnt);
+			    
+				if (status == F_NO_ERROR)
+				{
+				    status = dosfs_volume_zero(volume, blkno, blkcnt, &file->status);
+
+				    if (status == F_NO_ERROR)
+				    {
+					position += size;
+					count -= size;
+                                    
+					blkno += blkcnt;
+				    }
+
+				    /* After any data related disk operation, "file->status" needs
+				     * to be checked asynchronously for a previous error.
+				     */
+				    if (file->status != F_NO_ERROR)
+				    {
+					status = file->status;
+				    }
+				}
+			    }
+			}
+		    }
+		}
+	    }
+
+	    if (status == F_NO_ERROR)
+	    {
+		file->clsno = clsno;
+		file->blkno = blkno;
+		file->blkno_e = blkno_e;
+	    }
+	}
+    }
+
+    if (file->status == F_NO_ERROR)
+    {
+	file->status = status;
+    }
+
+    return status;
+}
+
+#if (DOSFS_CONFIG_CONTIGUOUS_SUPPORTED == 1)
+static int dosfs_file_reserve(dosfs_volume_t *volume, dosfs_file_t *file, uint32_t size)
+{
+    int status = F_NO_ERROR;
+    dosfs_device_t *device;
+    uint32_t clsno_a, clscnt;
+
+    device = DOSFS_VOLUME_DEVICE(volume);
+
+    clscnt = DOSFS_SIZE_TO_CLSCNT(size);
+    clscnt = ((((clscnt << volume->cls_blk_shift) + (volume->au_size -1)) / volume->au_size) * volume->au_size) >> volume->cls_blk_shift;
+
+#if (DOSFS_CONFIG_TRANSACTION_SAFE_SUPPORTED == 0)
+    status = dosfs_volume_dirty(volume);
+
+    if (status == F_NO_ERROR)
+#endif /* (DOSFS_CONFIG_TRANSACTION_SAFE_SUPPORTED == 0) */
+    {
+	status = dosfs_cluster_chain_create_contiguous(volume, clscnt, &clsno_a);
+
+	if (status == F_NO_ERROR)
+	{
+	    file->flags |= DOSFS_FILE_FLAG_CONTIGUOUS;
+	    file->size = size;
+	    file->first_clsno = clsno_a;
+	
+	    file->clsno = clsno_a;
+	    file->blkno = DOSFS_CLSNO_TO_BLKNO(clsno_a);
+	    file->blkno_e = file->blkno + volume->cls_blk_size;
+
+	    /* If a new cluster chain gets created, the dir entry needs to be updated to
+	     * not lose the cluster chain.
+	     */
+	    
+	    status = dosfs_file_sync(volume, file, FALSE, FALSE, file->first_clsno, file->length);
+
+	    if (status == F_NO_ERROR)
+	    {
+		dosfs_volume_invalidate(volume, file->blkno, (clscnt << volume->cls_blk_shift));
+
+#if (DOSFS_CONFIG_WRITE_BACK_ENTRIES != 0)
+		status = dosfs_write_back_flush(volume, file->blkno, (clscnt << volume->cls_blk_shift));
+
+		if (status == F_NO_ERROR)
+#endif /* (DOSFS_CONFIG_WRITE_BACK_ENTRIES != 0) */
+		{
+		    status = (device->interface->erase)(device->context, file->blkno, (clscnt << volume->cls_blk_shift));
+		}
 	    }
-	    else
+	}
+    }
+
+    return status;
+}
+
+#endif /* (DOSFS_CONFIG_CONTIGUOUS_SUPPORTED == 1) */
+
+#if (DOSFS_CONFIG_REOPEN_ENTRIES != 0)
+
+/* The reopen cache remembers where the files last opened for reading were
+ * found, keyed by the path passed to f_open() (and the current directory for
+ * a relative path). A repeated read-only open of the same path then skips
+ * walking the path and the directory. Anything that could move or change the
+ * directory entry of a file drops the cache (or its entry).
+ */
+
+static void dosfs_file_reopen_invalidate(dosfs_volume_t *volume, dosfs_file_t *file)
+{
+    dosfs_reopen_entry_t *entry, *entry_e;
+
+    entry = &volume->reopen_table[0];
+    entry_e = &volume->reopen_table[DOSFS_CONFIG_REOPEN_ENTRIES];
+
+    do
+    {
+	if ((file == NULL) || ((entry->dir_clsno == file->dir_clsno) && (entry->dir_index == file->dir_index)))
+	{
+	    entry->path[0] = '\0';
+	}
+
+	entry++;
+    }
+    while (entry < entry_e);
+}
+
+static dosfs_reopen_entry_t *dosfs_file_reopen_find(dosfs_volume_t *volume, const char *filename)
+{
+    dosfs_reopen_entry_t *entry, *entry_e;
+    uint32_t cwd_clsno;
+
+    cwd_clsno = ((*filename == '/') || (*filename == '\\')) ? DOSFS_CLSNO_END_OF_CHAIN : volume->cwd_clsno;
+
+    entry = &volume->reopen_table[0];
+    entry_e = &volume->reopen_table[DOSFS_CONFIG_REOPEN_ENTRIES];
+
+    do
+    {
+	if ((entry->path[0] != '\0') && (entry->cwd_clsno == cwd_clsno) && !strcmp(entry->path, filename))
+	{
+	    return entry;
+	}
+
+	entry++;
+    }
+    while (entry < entry_e);
+
+    return NULL;
+}
+
+static void dosfs_file_reopen_insert(dosfs_volume_t *volume, dosfs_reopen_entry_t *entry, const char *filename, dosfs_file_t *file)
+{
+    dosfs_reopen_entry_t *entry_s, *entry_e;
+    size_t length;
+
+    if (entry == NULL)
+    {
+	length = strlen(filename);
+
+	if (length >= DOSFS_CONFIG_REOPEN_PATH_SIZE)
+	{
+	    return;
+	}
+
+	/* Replace an unused entry, or the least recently used one.
+	 */
+	entry = &volume->reopen_table[0];
+
+	entry_s = &volume->reopen_table[1];
+	entry_e = &volume->reopen_table[DOSFS_CONFIG_REOPEN_ENTRIES];
+
+	while ((entry->path[0] != '\0') && (entry_s < entry_e))
+	{
+	    if ((entry_s->path[0] == '\0') || ((int32_t)(entry_s->stamp - entry->stamp) < 0))
 	    {
-		if (file->last_clsno != DOSFS_CLSNO_NONE)
+		entry = entry_s;
+	    }
+
+	    entry_s++;
+	}
+
+	entry->cwd_clsno = ((*filename == '/') || (*filename == '\\')) ? DOSFS_CLSNO_END_OF_CHAIN : volume->cwd_clsno;
+	entry->dir_clsno = file->dir_clsno;
+	entry->dir_index = file->dir_index;
+	entry->first_clsno = file->first_clsno;
+	entry->length = file->length;
+#if (DOSFS_CONFIG_EXFAT_SUPPORTED == 1)
+	entry->exfat_clscnt = volume->exfat_clscnt;
+#endif /* (DOSFS_CONFIG_EXFAT_SUPPORTED == 1) */
+#if (DOSFS_CONFIG_EXTENT_ENTRIES != 0)
+	entry->extent_clscnt = 0;
+#endif /* (DOSFS_CONFIG_EXTENT_ENTRIES != 0) */
+
+	memcpy(entry->path, filename, length +1);
+    }
+
+#if (DOSFS_CONFIG_EXTENT_ENTRIES != 0)
+    if (!entry->extent_clscnt && file->extent_clscnt)
+    {
+	entry->extent_clscnt = file->extent_clscnt;
+	entry->extent_count = file->extent_count;
+
+	memcpy(&entry->extent_table[0], &file->extent_table[0], file->extent_count * sizeof(dosfs_extent_t));
+    }
+#endif /* (DOSFS_CONFIG_EXTENT_ENTRIES != 0) */
+
+    entry->stamp = volume->reopen_clock++;
+}
+
+#endif /* (DOSFS_CONFIG_REOPEN_ENTRIES != 0) */
+
+/* Find "filename", or create it if DOSFS_FILE_MODE_CREATE is set, and set up the
+ * directory entry location, first cluster and length of "file".
+ */
+static int dosfs_file_lookup(dosfs_volume_t *volume, dosfs_file_t *file, const char *filename, uint32_t mode)
+{
+    int status = F_NO_ERROR;
+    uint32_t clsno, clsno_d, index, count;
+    uint16_t ctime, cdate;
+    dosfs_dir_t *dir;
+
+    status = dosfs_path_find_directory(volume, filename, &filename, &clsno_d);
+
+    if (status == F_NO_ERROR)
+    {
+	status = dosfs_path_convert_filename(volume, filename, NULL);
+    
+	if (status == F_NO_ERROR)
+	{
+	    if (mode & DOSFS_FILE_MODE_CREATE)
+	    {
+#if (DOSFS_CONFIG_VFAT_SUPPORTED == 1)
+		if ((volume->dir.dir_name[0] == '\0') || (volume->dir.dir_nt_reserved & DOSFS_DIR_TYPE_LOSSY))
 		{
-		    clsno = file->last_clsno;
+		    count = 1 + volume->dir_entries;
 		}
 		else
+#endif /* (DOSFS_CONFIG_VFAT_SUPPORTED == 1) */
 		{
-		    if (!file->position || (file->position > length_o))
+		    count = 1;
+		}
+	    }
+	    else
+	    {
+		count = 0;
+	    }
+
+	    status = dosfs_path_find_name(volume, clsno_d, count, &clsno, &index, &dir);
+
+	    if (status == F_NO_ERROR)
+	    {
+		if (dir != NULL)
+		{
+		    if (dir->dir_attr & DOSFS_DIR_ATTR_DIRECTORY)
 		    {
-			clsno = file->first_clsno;
-			clscnt = DOSFS_OFFSET_TO_CLSCNT(length_o -1);
+			status = F_ERR_INVALIDDIR;
 		    }
 		    else
 		    {
-			clsno = file->clsno;
-			clscnt = DOSFS_OFFSET_TO_CLSCNT(length_o -1) - DOSFS_OFFSET_TO_CLSCNT(file->position -1);
+			if ((mode & DOSFS_FILE_MODE_WRITE) && (dir->dir_attr & DOSFS_DIR_ATTR_READ_ONLY))
+			{
+			    status = F_ERR_ACCESSDENIED;
+			}
+#if (DOSFS_CONFIG_VFAT_SUPPORTED == 1)
+			else
+			{
+			    /* Advance to primary dir entry. */
+			    index += volume->dir_entries;
+			}
+#endif /* (DOSFS_CONFIG_VFAT_SUPPORTED == 1) */
+
+			file->dir_clsno = clsno;
+			file->dir_index = index;
+			file->length = DOSFS_FTOHL(dir->dir_file_size);
+		    
+			if (volume->type == DOSFS_VOLUME_TYPE_FAT32)
+			{
+			    file->first_clsno = ((uint32_t)DOSFS_FTOHS(dir->dir_clsno_hi) << 16) | (uint32_t)DOSFS_FTOHS(dir->dir_clsno_lo);
+			}
+			else
+			{
+			    file->first_clsno = (uint32_t)DOSFS_FTOHS(dir->dir_clsno_lo);
+			}
 		    }
+		}
+		else
+		{
+		    if (mode & DOSFS_FILE_MODE_CREATE)
+		    {
+#if defined(DOSFS_PORT_CORE_TIMEDATE)
+			DOSFS_PORT_CORE_TIMEDATE(&ctime, &cdate);
+#else /* DOSFS_PORT_CORE_TIMEDATE */
+			ctime = 0;
+			cdate = 0;
+#endif /* DOSFS_PORT_CORE_TIMEDATE */
 		    
-		    if (clscnt != 0)
+			status = dosfs_path_create_entry(volume, clsno_d, clsno, index, NULL, 0, DOSFS_CLSNO_NONE, ctime, cdate);
+		    
+			if (status == F_NO_ERROR)
+			{
+#if (DOSFS_CONFIG_VFAT_SUPPORTED == 1)
+			    /* Stip out allocations bits, and advance to primary dir entry. */
+			    index = (index & 0x0000ffff) + (count -1);
+#else /* (DOSFS_CONFIG_VFAT_SUPPORTED == 1) */
+			    index = (index & 0x0000ffff);
+#endif /* (DOSFS_CONFIG_VFAT_SUPPORTED == 1) */
+
+			    file->dir_clsno = clsno;
+			    file->dir_index = index;
+			    file->length = 0;
+			    file->first_clsno = DOSFS_CLSNO_NONE;
+			}
+		    }
+		    else
 		    {
-			status = dosfs_cluster_chain_seek(volume, clsno, clscnt, &clsno);
+			status = F_ERR_NOTFOUND;
+		    }
+		}
+	    }
+	}
+    }
+
+    return status;
+}
+
+static int dosfs_file_open(dosfs_volume_t *volume, const char *filename, uint32_t mode, uint32_t size, dosfs_file_t **p_file)
+{
+    int status = F_NO_ERROR;
+#if (DOSFS_CONFIG_CONTIGUOUS_SUPPORTED == 1)
+    uint32_t clsno, clscnt, clsdata;
+#endif /* (DOSFS_CONFIG_CONTIGUOUS_SUPPORTED == 1) */
+#if (DOSFS_CONFIG_MAX_FILES == 1)
+    dosfs_file_t *file;
+#else /* (DOSFS_CONFIG_MAX_FILES == 1) */
+    dosfs_file_t *file, *file_s, *file_e, *file_o;
+#endif /* (DOSFS_CONFIG_MAX_FILES == 1) */
+#if (DOSFS_CONFIG_REOPEN_ENTRIES != 0)
+    dosfs_reopen_entry_t *reopen;
+#endif /* (DOSFS_CONFIG_REOPEN_ENTRIES != 0) */
+
+    file = NULL;
+
+#if (DOSFS_CONFIG_MAX_FILES == 1)
+
+    if (!volume->file_table[0].mode)
+    {
+	file = &volume->file_table[0];
+    }
+#else /* (DOSFS_CONFIG_MAX_FILES == 1) */
+
+    file_s = &volume->file_table[0];
+    file_e = &volume->file_table[DOSFS_CONFIG_MAX_FILES];
+
+    do
+    {
+	if (!file_s->mode)
+        {
+            file = file_s;
+            break;
+        }
+
+	file_s++;
+    }
+    while (file_s < file_e);
+
+#endif /* (DOSFS_CONFIG_MAX_FILES == 1) */
+
+    if (file)
+    {
+	file->flags = (mode & DOSFS_FILE_MODE_IN_PLACE) ? DOSFS_FILE_FLAG_IN_PLACE : 0;
+
+	if ((mode & DOSFS_FILE_MODE_WRITE) && (volume->flags & DOSFS_VOLUME_FLAG_WRITE_PROTECTED))
+	{
+	    status = F_ERR_WRITEPROTECT;
+	}
+	else
+	{
+#if (DOSFS_CONFIG_REOPEN_ENTRIES != 0)
+	    reopen = NULL;
+
+	    if (!(mode & DOSFS_FILE_MODE_WRITE) && !size)
+	    {
+		reopen = dosfs_file_reopen_find(volume, filename);
+	    }
+
+	    if (reopen != NULL)
+	    {
+		file->dir_clsno = reopen->dir_clsno;
+		file->dir_index = reopen->dir_index;
+		file->length = reopen->length;
+		file->first_clsno = reopen->first_clsno;
+
+#if (DOSFS_CONFIG_EXFAT_SUPPORTED == 1)
+		volume->exfat_clscnt = reopen->exfat_clscnt;
+#endif /* (DOSFS_CONFIG_EXFAT_SUPPORTED == 1) */
+	    }
+	    else
+#endif /* (DOSFS_CONFIG_REOPEN_ENTRIES != 0) */
+	    {
+		status = dosfs_file_lookup(volume, file, filename, mode);
+	    }
+
+	    if (status == F_NO_ERROR)
+	    {
+
+#if (DOSFS_CONFIG_MAX_FILES != 1)
+		file_o = NULL;
+
+		do
+		{
+		    file_o = dosfs_file_enumerate(volume, file_o, file->dir_clsno, file->dir_index);
+
+		    if (file_o != NULL)
+		    {
+			if (mode & DOSFS_FILE_MODE_WRITE)
+			{
+			    status = F_ERR_LOCKED;
+			}
+			else
+			{
+			    if (file_o->mode & DOSFS_FILE_MODE_WRITE)
+			    {
+				status = F_ERR_LOCKED;
+			    }
+			}
+		    }
+		}
+		while ((status == F_NO_ERROR) && (file_o != NULL));
+#endif /* (DOSFS_CONFIG_MAX_FILES != 1) */
+
+		if (status == F_NO_ERROR)
+		{
+#if (DOSFS_CONFIG_REOPEN_ENTRIES != 0)
+		    if (mode & DOSFS_FILE_MODE_WRITE)
+		    {
+			dosfs_file_reopen_invalidate(volume, file);
+		    }
+#endif /* (DOSFS_CONFIG_REOPEN_ENTRIES != 0) */
+
+		    file->status = F_NO_ERROR;
+		    file->position = 0;
+		    file->last_clsno = DOSFS_CLSNO_NONE;
+
+		    if (file->first_clsno == DOSFS_CLSNO_NONE)
+		    {
+			file->flags |= DOSFS_FILE_FLAG_END_OF_CHAIN;
+			file->clsno = DOSFS_CLSNO_NONE;
+			file->blkno = DOSFS_BLKNO_INVALID;
+			file->blkno_e = DOSFS_BLKNO_INVALID;
+		    }
+		    else
+		    {
+			file->clsno = file->first_clsno;
+			file->blkno = DOSFS_CLSNO_TO_BLKNO(file->clsno);
+			file->blkno_e = file->blkno + volume->cls_blk_size;
 		    }
-		}
 
-		if (status == F_NO_ERROR)
-		{
-		    file->last_clsno = clsno;
-		}
-	    }
-	}
+#if (DOSFS_CONFIG_EXFAT_SUPPORTED == 1)
+		    /* A "NoFatChain" exFAT file is contiguous, and has no FAT entries to follow.
+		     */
+		    if ((volume->flags & DOSFS_VOLUME_FLAG_EXFAT) && (file->first_clsno != DOSFS_CLSNO_NONE) && volume->exfat_clscnt)
+		    {
+			file->flags |= (DOSFS_FILE_FLAG_CONTIGUOUS | DOSFS_FILE_FLAG_END_OF_CHAIN);
+			file->last_clsno = file->first_clsno + volume->exfat_clscnt -1;
 
-	if (status == F_NO_ERROR)
-	{
-	    if ((length_o == 0) || (clsno == DOSFS_CLSNO_NONE))
-	    {
-		clscnt = DOSFS_SIZE_TO_CLSCNT(length);
-	    }
-	    else
-	    {
-		clscnt = DOSFS_SIZE_TO_CLSCNT(length) - DOSFS_SIZE_TO_CLSCNT(length_o);
-	    }
-	    
-	    clsno_l = clsno;
-	    clsno_n = DOSFS_CLSNO_NONE;
+			if (volume->exfat_clscnt >= (DOSFS_FILE_SIZE_MAX >> volume->cls_shift))
+			{
+			    file->size = DOSFS_FILE_SIZE_MAX;
+			}
+			else
+			{
+			    file->size = volume->exfat_clscnt << volume->cls_shift;
+			}
+		    }
+#endif /* (DOSFS_CONFIG_EXFAT_SUPPORTED == 1) */
 
-	    if (clscnt)
-	    {
-		/* While the last cluster had not been seen yet, step throu the trailing 
-		 * list and make use of what had been there already.
-		 *
-		 * Normally this should only set DOSFS_FILE_FLAG_END_OF_CHAIN, but there might
-		 * be dangling, orphaned entries which one might make use of to begin with.
-		 *
-		 * N.b. file_first_clsno == DOSFS_CLSNO_NONE implies DOSFS_FILE_FLAG_END_OF_CHAIN 
-		 * set.
-		 */
+		    if (mode & DOSFS_FILE_MODE_TRUNCATE)
+		    {
+			file->length = 0;
 
-		if (!(file->flags & DOSFS_FILE_FLAG_END_OF_CHAIN))
-		{
-		    do
+			status = dosfs_file_shrink(volume, file);
+		    }
+
+#if (DOSFS_CONFIG_CONTIGUOUS_SUPPORTED == 1)
+		    if (size)
 		    {
-			status = dosfs_cluster_read(volume, clsno_l, &clsdata);
-			
-			if (status == F_NO_ERROR)
+			if (file->first_clsno == DOSFS_CLSNO_NONE)
 			{
-			    if (clsdata >= DOSFS_CLSNO_LAST)
+			    status = dosfs_file_reserve(volume, file, size);
+			}
+			else
+			{
+			    clsno = file->first_clsno;
+			    clscnt = 0;
+
+			    do
 			    {
-				file->flags |= DOSFS_FILE_FLAG_END_OF_CHAIN;
+				status = dosfs_cluster_read(volume, clsno, &clsdata);
+				
+				if (status == F_NO_ERROR)
+				{
+				    if ((clsdata >= 2) && (clsdata <= volume->last_clsno))
+				    {
+					if ((clsno +1) == clsdata)
+					{
+					    clsno++;
+					    clscnt++;
+					}
+					else
+					{
+					    status = F_ERR_EOF;
+					}
+
+				    }
+				    else
+				    {
+					if (clsdata < DOSFS_CLSNO_LAST)
+					{
+					    status = F_ERR_EOF;
+					}
+				    }
+				}
 			    }
-			    else
+			    while ((status == F_NO_ERROR) && (clsdata < DOSFS_CLSNO_LAST));
+
+			    if (status == F_NO_ERROR)
 			    {
-				if ((clsdata >= 2) && (clsdata <= volume->last_clsno))
+				if (clscnt == DOSFS_SIZE_TO_CLSCNT(size))
 				{
-				    if (clsno_n == DOSFS_CLSNO_NONE)
+				    file->flags |= (DOSFS_FILE_FLAG_CONTIGUOUS | DOSFS_FILE_FLAG_END_OF_CHAIN);
+				    file->last_clsno = file->first_clsno + clscnt -1;
+
+				    if (size >= (DOSFS_FILE_SIZE_MAX & ~volume->cls_mask))
 				    {
-					clsno_n = clsdata;
+					file->size = DOSFS_FILE_SIZE_MAX;
+				    }
+				    else
+				    {
+					file->size = (size + volume->cls_mask) & ~volume->cls_mask;
 				    }
-
-				    clsno_l = clsdata;
-				    clscnt--;
 				}
 				else
 				{
@@ -7577,248 +10575,332 @@ static int dosfs_file_extend(dosfs_volume_t *volume, dosfs_file_t *file, uint32_
 			    }
 			}
 		    }
-		    while ((status == F_NO_ERROR) && !(file->flags & DOSFS_FILE_FLAG_END_OF_CHAIN) && (clscnt != 0));
-		}
-
-		if (status == F_NO_ERROR)
-		{
-		    if (clscnt)
+#endif /* (DOSFS_CONFIG_CONTIGUOUS_SUPPORTED == 1) */
+		
+		    if (status == F_NO_ERROR)
 		    {
-#if (DOSFS_CONFIG_TRANSACTION_SAFE_SUPPORTED == 0)
-			status = dosfs_volume_dirty(volume);
-			
+			if (mode & DOSFS_FILE_MODE_APPEND)
+			{
+			    status = dosfs_file_seek(volume, file, file->length);
+			}
+		    
 			if (status == F_NO_ERROR)
-#endif /* (DOSFS_CONFIG_TRANSACTION_SAFE_SUPPORTED == 0) */
 			{
-#if (DOSFS_CONFIG_SEQUENTIAL_SUPPORTED == 1)
-			    if (file->mode & DOSFS_FILE_MODE_SEQUENTIAL)
-			    {
-				status = dosfs_cluster_chain_create_sequential(volume, clsno_l, clscnt, &clsno_a, &clsno_l);
-			    }
-			    else
-#endif /* (DOSFS_CONFIG_SEQUENTIAL_SUPPORTED == 1) */
+#if (DOSFS_CONFIG_FILE_DATA_CACHE == 1)
+			    file->data_cache.blkno = DOSFS_BLKNO_INVALID;
+#endif /* (DOSFS_CONFIG_FILE_DATA_CACHE == 1) */
+
+#if (DOSFS_CONFIG_EXTENT_ENTRIES != 0)
+			    file->extent_clscnt = 0;
+			    file->extent_count = 0;
+#endif /* (DOSFS_CONFIG_EXTENT_ENTRIES != 0) */
+
+			    file->mode = mode;
+
+#if (DOSFS_CONFIG_EXTENT_ENTRIES != 0)
+			    if ((mode & DOSFS_FILE_MODE_EXTENT) && !(mode & DOSFS_FILE_MODE_WRITE)
+#if (DOSFS_CONFIG_CONTIGUOUS_SUPPORTED == 1)
+				&& !(file->flags & DOSFS_FILE_FLAG_CONTIGUOUS)
+#endif /* (DOSFS_CONFIG_CONTIGUOUS_SUPPORTED == 1) */
+				)
 			    {
-				status = dosfs_cluster_chain_create(volume, clsno_l, clscnt, &clsno_a, &clsno_l);
+#if (DOSFS_CONFIG_REOPEN_ENTRIES != 0)
+				if ((reopen != NULL) && reopen->extent_clscnt)
+				{
+				    file->extent_clscnt = reopen->extent_clscnt;
+				    file->extent_count = reopen->extent_count;
+
+				    memcpy(&file->extent_table[0], &reopen->extent_table[0], reopen->extent_count * sizeof(dosfs_extent_t));
+				}
+				else
+#endif /* (DOSFS_CONFIG_REOPEN_ENTRIES != 0) */
+				{
+				    status = dosfs_file_extent_build(volume, file);
+				}
 			    }
+#endif /* (DOSFS_CONFIG_EXTENT_ENTRIES != 0) */
 
-			    if (clsno_n == DOSFS_CLSNO_NONE)
+#if (DOSFS_CONFIG_REOPEN_ENTRIES != 0)
+			    if ((status == F_NO_ERROR) && !(mode & DOSFS_FILE_MODE_WRITE) && !size)
 			    {
-				clsno_n = clsno_a;
+				dosfs_file_reopen_insert(volume, reopen, filename, file);
 			    }
+#endif /* (DOSFS_CONFIG_REOPEN_ENTRIES != 0) */
 			}
 		    }
 		}
-
-		if (status == F_NO_ERROR)
-		{
-		    if (file->first_clsno == DOSFS_CLSNO_NONE)
-		    {
-			file->first_clsno = clsno_n;
-			
-			file->clsno = clsno_n;
-			file->blkno = DOSFS_CLSNO_TO_BLKNO(clsno_n);
-			file->blkno_e = file->blkno + volume->cls_blk_size;
-
-			/* If a new cluster chain gets created, the dir entry needs to be updated to
-			 * not lose the cluster chain.
-			 */
-			
-			status = dosfs_file_sync(volume, file, FALSE, FALSE, file->first_clsno, file->length);
-		    }
-		}
 	    }
 	}
     }
+    else
+    {
+	status = F_ERR_NOMOREENTRY;
+    }
 
-    if (status == F_NO_ERROR)
+    *p_file = file;
+
+    return status;
+}
+
+static int dosfs_file_close(dosfs_volume_t *volume, dosfs_file_t *file)
+{
+    int status = F_NO_ERROR;
+
+    if (file->mode & DOSFS_FILE_MODE_WRITE)
     {
-	file->flags |= DOSFS_FILE_FLAG_DIR_MODIFIED;
-	file->last_clsno = clsno_l;
-	file->length = length;
+	status = dosfs_file_flush(volume, file, TRUE);
+    }
 
-	if (file->position > length_o)
-	{
-	    position = length_o;
-	    offset = (length_o + DOSFS_BLK_MASK) & ~DOSFS_BLK_MASK;
-	    count  = file->position - length_o;
+    file->mode = 0;
+    file->dir_clsno = DOSFS_CLSNO_NONE;
+    file->dir_index = 0;
 
-	    if (!(position & volume->cls_mask))
-	    {
-		/* If the old file->length was on a cluster boundary, then the 
-		 * old cached file data should be flushed to get a nice sequential
-		 * write sequence.
-		 */
-		status = dosfs_data_cache_flush(volume, file);
+    return status;
+}
 
-		if (status == F_NO_ERROR)
-		{
-		    clsno = clsno_n;
-		}
-	    }
+static __optimize_speed int dosfs_file_read(dosfs_volume_t *volume, dosfs_file_t *file, uint8_t *data, uint32_t count, uint32_t *p_count)
+{
+    int status = F_NO_ERROR;
+    dosfs_device_t *device;
+    uint32_t blkno, blkno_e, blkcnt, clsno, clsno_n, position, total, size;
+    dosfs_cache_entry_t *entry;
 
-	    if (status == F_NO_ERROR)
-	    {
-		blkno = DOSFS_CLSNO_TO_BLKNO(clsno) + DOSFS_OFFSET_TO_BLKCNT(position);
-		blkno_e = DOSFS_CLSNO_TO_BLKNO(clsno) + volume->cls_blk_size;
+    device = DOSFS_VOLUME_DEVICE(volume);
 
-		if (((position & DOSFS_BLK_MASK) + count) < DOSFS_BLK_SIZE)
-		{
-		    /* All data is within one block, simply go throu the cache.
-		     * If the block is beyond the old file->length, is has to 
-		     * be all zeros. Otherwise got throu the normal cache.
-		     */
-		
-		    if (position >= offset)
-		    {
-			status = dosfs_data_cache_zero(volume, file, blkno, &entry);
-		    }
-		    else
-		    {
-			status = dosfs_data_cache_read(volume, file, blkno, &entry);
-		    
-			if (status == F_NO_ERROR)
-			{
-			    memset(entry->data + (position & DOSFS_BLK_MASK), 0, count);
-			}
-		    }
-		
-		    if (status == F_NO_ERROR)
-		    {
-			dosfs_data_cache_modify(volume, file);
-		    
-			position += count;
-			count = 0;
-		    
-			if (!(position & DOSFS_BLK_MASK))
-			{
-			    blkno++;
-			}
-		    }
+    *p_count = 0;
+
+    if (file->position >= file->length)
+    {
+	count = 0;
+    }
+    else
+    {
+	if (count > (file->length - file->position))
+	{
+	    count = (file->length - file->position);
+	}
+    }
+
+    if (count != 0)
+    {
+	total = count;
+
+        position = file->position;
+        clsno = file->clsno;
+        blkno = file->blkno;
+        blkno_e = file->blkno_e;
+
+	/* Take care of the case where there is an empty cluster chain,
+	 * but file->length is not 0.
+	 */
+	if (clsno == DOSFS_CLSNO_NONE)
+	{
+	    status = F_ERR_EOF;
+	}
+        else
+	{
+	    if (blkno == blkno_e)
+	    {
+#if (DOSFS_CONFIG_CONTIGUOUS_SUPPORTED == 1)
+		if (file->flags & DOSFS_FILE_FLAG_CONTIGUOUS)
+		{
+		    clsno++;
+		    blkno_e += volume->cls_blk_size;
 		}
 		else
+#endif /* (DOSFS_CONFIG_CONTIGUOUS_SUPPORTED == 1) */
 		{
-		    if (position & DOSFS_BLK_MASK)
+		    status = dosfs_file_cluster_next(volume, file, clsno, position, &clsno);
+
+		    if (status == F_NO_ERROR)
 		    {
-			size = (DOSFS_BLK_SIZE - (position & DOSFS_BLK_MASK));
+			blkno = DOSFS_CLSNO_TO_BLKNO(clsno);
+			blkno_e = blkno + volume->cls_blk_size;
+		    }
+		}
+	    }
+	}
 
-			if (position >= offset)
+        if (status == F_NO_ERROR)
+        {
+            if (((position & DOSFS_BLK_MASK) + count) < DOSFS_BLK_SIZE)
+            {
+                status = dosfs_data_cache_read(volume, file, blkno, &entry);
+	    
+                if (status == F_NO_ERROR)
+                {
+                    memcpy(data, entry->data + (position & DOSFS_BLK_MASK), count);
+
+                    dosfs_data_cache_release(volume, file);
+
+                    position += count;
+                    count = 0;
+
+                    if (!(position & DOSFS_BLK_MASK))
+                    {
+                        blkno++;
+                    }
+                }
+            }
+            else
+            {
+                if (position & DOSFS_BLK_MASK)
+                {
+                    status = dosfs_data_cache_read(volume, file, blkno, &entry);
+	    
+                    if (status == F_NO_ERROR)
+                    {
+                        size = (DOSFS_BLK_SIZE - (position & DOSFS_BLK_MASK));
+
+                        memcpy(data, entry->data + (DOSFS_BLK_SIZE - size), size);
+
+                        dosfs_data_cache_release(volume, file);
+
+                        position += size;
+                        data += size;
+                        count -= size;
+
+                        blkno++;
+                    }
+                }
+
+                while ((status == F_NO_ERROR) && (count != 0))
+                {
+                    if (blkno == blkno_e)
+                    {
+#if (DOSFS_CONFIG_CONTIGUOUS_SUPPORTED == 1)
+			if (file->flags & DOSFS_FILE_FLAG_CONTIGUOUS)
 			{
-			    status = dosfs_data_cache_zero(volume, file, blkno, &entry);
+			    clsno++;
+			    blkno_e += volume->cls_blk_size;
 			}
 			else
-			{ 
-			    status = dosfs_data_cache_read(volume, file, blkno, &entry);
-			
-			    if (status == F_NO_ERROR)
-			    {
-				memset(entry->data + (DOSFS_BLK_SIZE - size), 0, size);
-			    }
-			}
-		    
-			if (status == F_NO_ERROR)
+#endif /* (DOSFS_CONFIG_CONTIGUOUS_SUPPORTED == 1) */
 			{
-			    dosfs_data_cache_modify(volume, file);
-
-			    status = dosfs_data_cache_write(volume, file);
-			
+			    status = dosfs_file_cluster_next(volume, file, clsno, position, &clsno);
+			    
 			    if (status == F_NO_ERROR)
 			    {
-				position += size;
-				count -= size;
-                            
-				blkno++;
+				blkno = DOSFS_CLSNO_TO_BLKNO(clsno);
+				blkno_e = blkno + volume->cls_blk_size;
 			    }
 			}
 		    }
+                
+                    if (status == F_NO_ERROR)
+                    {
+                        if (count < DOSFS_BLK_SIZE)
+                        {
+                            status = dosfs_data_cache_read(volume, file, blkno, &entry);
+                    
+                            if (status == F_NO_ERROR)
+                            {
+                                memcpy(data, entry->data, count);
 
-		    while ((status == F_NO_ERROR) && (count != 0))
-		    {
-			if (blkno == blkno_e)
-			{
-			    status = dosfs_data_cache_flush(volume, file);
+                                dosfs_data_cache_release(volume, file);
 
-			    if (status == F_NO_ERROR)
+                                position += count;
+                                data += count;
+                                count = 0;
+                            }
+                        }
+                        else
+                        {
+			    size = volume->cls_size - (position & volume->cls_mask);
+                            
+                            if (size > count)
+                            {
+                                size = count & ~DOSFS_BLK_MASK;
+                            }
+			    else
 			    {
-#if (DOSFS_CONFIG_CONTIGUOUS_SUPPORTED == 1)
-				if (file->flags & DOSFS_FILE_FLAG_CONTIGUOUS)
+				/* Extend the span across physically consecutive clusters, so
+				 * that an unfragmented file is read with a single multi block
+				 * read, rather than one read per cluster. "clsno" & "blkno_e"
+				 * track the last cluster covered by the span.
+				 */
+				while ((count - size) >= DOSFS_BLK_SIZE)
 				{
-				    clsno++;
-				    blkno_e += volume->cls_blk_size;
-				}
-				else
+#if (DOSFS_CONFIG_CONTIGUOUS_SUPPORTED == 1)
+				    if (file->flags & DOSFS_FILE_FLAG_CONTIGUOUS)
+				    {
+					clsno_n = clsno +1;
+				    }
+				    else
 #endif /* (DOSFS_CONFIG_CONTIGUOUS_SUPPORTED == 1) */
-				{
-				    status = dosfs_cluster_chain_seek(volume, clsno, 1, &clsno);
-					
-				    if (status == F_NO_ERROR)
 				    {
-					blkno = DOSFS_CLSNO_TO_BLKNO(clsno);
-					blkno_e = blkno + volume->cls_blk_size;
+					status = dosfs_file_cluster_next(volume, file, clsno, (position + size), &clsno_n);
+
+					if ((status != F_NO_ERROR) || (clsno_n != (clsno +1)))
+					{
+					    break;
+					}
+				    }
+
+				    clsno = clsno_n;
+				    blkno_e += volume->cls_blk_size;
+
+				    if ((count - size) < volume->cls_size)
+				    {
+					size += ((count - size) & ~DOSFS_BLK_MASK);
+				    }
+				    else
+				    {
+					size += volume->cls_size;
 				    }
 				}
 			    }
-			}
-			
-			if (status == F_NO_ERROR)
-			{
-			    if (count < DOSFS_BLK_SIZE)
+
+                            blkcnt = size >> DOSFS_BLK_SHIFT;
+
+			    if (status == F_NO_ERROR)
 			    {
-				status = dosfs_data_cache_zero(volume, file, blkno, &entry);
-			    
-				if (status == F_NO_ERROR)
-				{
-				    dosfs_data_cache_modify(volume, file);
-				
-				    position += count;
-				    count = 0;
-				}
+				status = dosfs_data_cache_flush(volume, file);
 			    }
-			    else
-			    {
-				size = volume->cls_size - (position & volume->cls_mask);
-			    
-				if (size > count)
+
+                            if (status == F_NO_ERROR)
+                            {
+                                status = dosfs_device_read(device, blkno, data, blkcnt, DOSFS_FILE_PREFETCH(file));
+
+#if (DOSFS_CONFIG_MEDIA_FAILURE_SUPPORTED == 1)
+				if (status == F_ERR_INVALIDSECTOR)
 				{
-				    size = count & ~DOSFS_BLK_MASK;
+				    volume->flags |= DOSFS_VOLUME_FLAG_MEDIA_FAILURE;
 				}
-			    
-				blkcnt = size >> DOSFS_BLK_SHIFT;
-			    
-				status = dosfs_data_cache_invalidate(volume, file, blkno, blkcnt);
-			    
-				if (status == F_NO_ERROR)
-				{
-				    status = dosfs_volume_zero(volume, blkno, blkcnt, &file->status);
+#endif /* (DOSFS_CONFIG_MEDIA_FAILURE_SUPPORTED == 1) */
 
-				    if (status == F_NO_ERROR)
-				    {
-					position += size;
-					count -= size;
-                                    
-					blkno += blkcnt;
-				    }
+                                if (status == F_NO_ERROR)
+                                {
+                                    position += size;
+                                    data += size;
+                                    count -= size;
 
-				    /* After any data related disk operation, "file->status" needs
-				     * to be checked asynchronously for a previous error.
-				     */
-				    if (file->status != F_NO_ERROR)
-				    {
-					status = file->status;
-				    }
+                                    blkno += blkcnt;
+                                }
+
+				/* After any data related disk operation, "file->status" needs
+				 * to be checked asynchronously for a previous error.
+				 */
+				if (file->status != F_NO_ERROR)
+				{
+				    status = file->status;
 				}
-			    }
-			}
-		    }
-		}
-	    }
+                            }
+                        }
+                    }
+                }
+            }
+        
+            if (status == F_NO_ERROR)
+            {
+                file->position = position;
+                file->clsno = clsno;
+                file->blkno = blkno;
+                file->blkno_e = blkno_e;
+            }
+        }
 
-	    if (status == F_NO_ERROR)
-	    {
-		file->clsno = clsno;
-		file->blkno = blkno;
-		file->blkno_e = blkno_e;
-	    }
-	}
+	*p_count = total - count;
     }
 
     if (file->status == F_NO_ERROR)
@@ -7829,576 +10911,417 @@ static int dosfs_file_extend(dosfs_volume_t *volume, dosfs_file_t *file, uint32_
     return status;
 }
 
-#if (DOSFS_CONFIG_CONTIGUOUS_SUPPORTED == 1)
-static int dosfs_file_reserve(dosfs_volume_t *volume, dosfs_file_t *file, uint32_t size)
-{
-    int status = F_NO_ERROR;
-    dosfs_device_t *device;
-    uint32_t clsno_a, clscnt;
-
-    device = DOSFS_VOLUME_DEVICE(volume);
+/* Completion of an asynchronous read, called from the device's interrupt handler.
+ */
+static void dosfs_file_read_callback(void *context, int status)
+{
+    dosfs_file_t *file = (dosfs_file_t*)context;
+    F_CALLBACK callback;
 
-    clscnt = DOSFS_SIZE_TO_CLSCNT(size);
-    clscnt = ((((clscnt << volume->cls_blk_shift) + (volume->au_size -1)) / volume->au_size) * volume->au_size) >> volume->cls_blk_shift;
+    callback = file->callback;
+    context = file->context;
 
-#if (DOSFS_CONFIG_TRANSACTION_SAFE_SUPPORTED == 0)
-    status = dosfs_volume_dirty(volume);
+    file->callback = NULL;
+    file->context = NULL;
 
-    if (status == F_NO_ERROR)
-#endif /* (DOSFS_CONFIG_TRANSACTION_SAFE_SUPPORTED == 0) */
+    if (status != F_NO_ERROR)
     {
-	status = dosfs_cluster_chain_create_contiguous(volume, clscnt, &clsno_a);
-
-	if (status == F_NO_ERROR)
+	if (file->status == F_NO_ERROR)
 	{
-	    file->flags |= DOSFS_FILE_FLAG_CONTIGUOUS;
-	    file->size = size;
-	    file->first_clsno = clsno_a;
-	
-	    file->clsno = clsno_a;
-	    file->blkno = DOSFS_CLSNO_TO_BLKNO(clsno_a);
-	    file->blkno_e = file->blkno + volume->cls_blk_size;
-
-	    /* If a new cluster chain gets created, the dir entry needs to be updated to
-	     * not lose the cluster chain.
-	     */
-	    
-	    status = dosfs_file_sync(volume, file, FALSE, FALSE, file->first_clsno, file->length);
-
-	    if (status == F_NO_ERROR)
-	    {
-		status = (device->interface->erase)(device->context, file->blkno, (clscnt << volume->cls_blk_shift));
-	    }
+	    file->status = status;
 	}
     }
 
-    return status;
+    (*callback)(context, status);
 }
 
-#endif /* (DOSFS_CONFIG_CONTIGUOUS_SUPPORTED == 1) */
-
-static int dosfs_file_open(dosfs_volume_t *volume, const char *filename, uint32_t mode, uint32_t size, dosfs_file_t **p_file)
+/* Queue the block aligned part of a read that fits into the current cluster with
+ * the device's "read_async" method. A "*p_count" of 0 on return means nothing
+ * has been queued, and the read needs to go through dosfs_file_read().
+ */
+static int dosfs_file_read_async(dosfs_volume_t *volume, dosfs_file_t *file, uint8_t *data, uint32_t count, F_CALLBACK callback, void *context, uint32_t *p_count)
 {
     int status = F_NO_ERROR;
-    uint32_t clsno, clsno_d, index, count;
-    uint16_t ctime, cdate;
-#if (DOSFS_CONFIG_CONTIGUOUS_SUPPORTED == 1)
-    uint32_t clscnt, clsdata;
-#endif /* (DOSFS_CONFIG_CONTIGUOUS_SUPPORTED == 1) */
-#if (DOSFS_CONFIG_MAX_FILES == 1)
-    dosfs_file_t *file;
-#else /* (DOSFS_CONFIG_MAX_FILES == 1) */
-    dosfs_file_t *file, *file_s, *file_e, *file_o;
-#endif /* (DOSFS_CONFIG_MAX_FILES == 1) */
-    dosfs_dir_t *dir;
+    dosfs_device_t *device;
+    uint32_t blkno, blkno_e, blkcnt, clsno, position, size;
 
-    file = NULL;
+    device = DOSFS_VOLUME_DEVICE(volume);
 
-#if (DOSFS_CONFIG_MAX_FILES == 1)
+    *p_count = 0;
 
-    if (!volume->file_table[0].mode)
+    if (!device->interface->read_async || (file->position & DOSFS_BLK_MASK) || (file->position >= file->length) || (file->clsno == DOSFS_CLSNO_NONE))
     {
-	file = &volume->file_table[0];
+	return F_NO_ERROR;
     }
-#else /* (DOSFS_CONFIG_MAX_FILES == 1) */
 
-    file_s = &volume->file_table[0];
-    file_e = &volume->file_table[DOSFS_CONFIG_MAX_FILES];
+#if (DOSFS_CONFIG_STORAGE_SHARED_SUPPORTED == 1)
+    /* A background transfer could not be kept out of the way of the host.
+     */
+    if (device->lock & DOSFS_DEVICE_LOCK_SHARED)
+    {
+	return F_NO_ERROR;
+    }
+#endif /* (DOSFS_CONFIG_STORAGE_SHARED_SUPPORTED == 1) */
 
-    do
+    if (count > (file->length - file->position))
     {
-	if (!file_s->mode)
-        {
-            file = file_s;
-            break;
-        }
+	count = (file->length - file->position);
+    }
 
-	file_s++;
+    if (count < DOSFS_BLK_SIZE)
+    {
+	return F_NO_ERROR;
     }
-    while (file_s < file_e);
 
-#endif /* (DOSFS_CONFIG_MAX_FILES == 1) */
+    position = file->position;
+    clsno = file->clsno;
+    blkno = file->blkno;
+    blkno_e = file->blkno_e;
 
-    if (file)
+    if (blkno == blkno_e)
     {
-	file->flags = 0;
-
-	if ((mode & DOSFS_FILE_MODE_WRITE) && (volume->flags & DOSFS_VOLUME_FLAG_WRITE_PROTECTED))
+#if (DOSFS_CONFIG_CONTIGUOUS_SUPPORTED == 1)
+	if (file->flags & DOSFS_FILE_FLAG_CONTIGUOUS)
 	{
-	    status = F_ERR_WRITEPROTECT;
+	    clsno++;
+	    blkno_e += volume->cls_blk_size;
 	}
 	else
+#endif /* (DOSFS_CONFIG_CONTIGUOUS_SUPPORTED == 1) */
 	{
-	    status = dosfs_path_find_directory(volume, filename, &filename, &clsno_d);
-	
+	    status = dosfs_file_cluster_next(volume, file, clsno, position, &clsno);
+
 	    if (status == F_NO_ERROR)
 	    {
-		status = dosfs_path_convert_filename(volume, filename, NULL);
-	    
-		if (status == F_NO_ERROR)
-		{
-		    if (mode & DOSFS_FILE_MODE_CREATE)
-		    {
-#if (DOSFS_CONFIG_VFAT_SUPPORTED == 1)
-			if ((volume->dir.dir_name[0] == '\0') || (volume->dir.dir_nt_reserved & DOSFS_DIR_TYPE_LOSSY))
-			{
-			    count = 1 + volume->dir_entries;
-			}
-			else
-#endif /* (DOSFS_CONFIG_VFAT_SUPPORTED == 1) */
-			{
-			    count = 1;
-			}
-		    }
-		    else
-		    {
-			count = 0;
-		    }
-
-		    status = dosfs_path_find_entry(volume, clsno_d, 0, count, dosfs_path_find_callback_name, NULL, &clsno, &index, &dir);
-
-		    if (status == F_NO_ERROR)
-		    {
-			if (dir != NULL)
-			{
-			    if (dir->dir_attr & DOSFS_DIR_ATTR_DIRECTORY)
-			    {
-				status = F_ERR_INVALIDDIR;
-			    }
-			    else
-			    {
-				if ((mode & DOSFS_FILE_MODE_WRITE) && (dir->dir_attr & DOSFS_DIR_ATTR_READ_ONLY))
-				{
-				    status = F_ERR_ACCESSDENIED;
-				}
-#if (DOSFS_CONFIG_VFAT_SUPPORTED == 1)
-				else
-				{
-				    /* Advance to primary dir entry. */
-				    index += volume->dir_entries;
-				}
-#endif /* (DOSFS_CONFIG_VFAT_SUPPORTED == 1) */
-
-				file->dir_clsno = clsno;
-				file->dir_index = index;
-				file->length = DOSFS_FTOHL(dir->dir_file_size);
-			    
-				if (volume->type == DOSFS_VOLUME_TYPE_FAT32)
-				{
-				    file->first_clsno = ((uint32_t)DOSFS_FTOHS(dir->dir_clsno_hi) << 16) | (uint32_t)DOSFS_FTOHS(dir->dir_clsno_lo);
-				}
-				else
-				{
-				    file->first_clsno = (uint32_t)DOSFS_FTOHS(dir->dir_clsno_lo);
-				}
-			    }
-			}
-			else
-			{
-			    if (mode & DOSFS_FILE_MODE_CREATE)
-			    {
-#if defined(DOSFS_PORT_CORE_TIMEDATE)
-				DOSFS_PORT_CORE_TIMEDATE(&ctime, &cdate);
-#else /* DOSFS_PORT_CORE_TIMEDATE */
-				ctime = 0;
-				cdate = 0;
-#endif /* DOSFS_PORT_CORE_TIMEDATE */
-			    
-				status = dosfs_path_create_entry(volume, clsno_d, clsno, index, NULL, 0, DOSFS_CLSNO_NONE, ctime, cdate);
-			    
-				if (status == F_NO_ERROR)
-				{
-#if (DOSFS_CONFIG_VFAT_SUPPORTED == 1)
-				    /* Stip out allocations bits, and advance to primary dir entry. */
-				    index = (index & 0x0000ffff) + (count -1);
-#else /* (DOSFS_CONFIG_VFAT_SUPPORTED == 1) */
-				    index = (index & 0x0000ffff);
-#endif /* (DOSFS_CONFIG_VFAT_SUPPORTED == 1) */
-
-				    file->dir_clsno = clsno;
-				    file->dir_index = index;
-				    file->length = 0;
-				    file->first_clsno = DOSFS_CLSNO_NONE;
-				}
-			    }
-			    else
-			    {
-				status = F_ERR_NOTFOUND;
-			    }
-			}
-
-			if (status == F_NO_ERROR)
-			{
-
-#if (DOSFS_CONFIG_MAX_FILES != 1)
-			    file_o = NULL;
-
-			    do
-			    {
-				file_o = dosfs_file_enumerate(volume, file_o, clsno, index);
-
-				if (file_o != NULL)
-				{
-				    if (mode & DOSFS_FILE_MODE_WRITE)
-				    {
-					status = F_ERR_LOCKED;
-				    }
-				    else
-				    {
-					if (file_o->mode & DOSFS_FILE_MODE_WRITE)
-					{
-					    status = F_ERR_LOCKED;
-					}
-				    }
-				}
-			    }
-			    while ((status == F_NO_ERROR) && (file_o != NULL));
-#endif /* (DOSFS_CONFIG_MAX_FILES != 1) */
+		blkno = DOSFS_CLSNO_TO_BLKNO(clsno);
+		blkno_e = blkno + volume->cls_blk_size;
+	    }
+	}
+    }
 
-			    if (status == F_NO_ERROR)
-			    {
-				file->status = F_NO_ERROR;
-				file->position = 0;
-				file->last_clsno = DOSFS_CLSNO_NONE;
+    if (status == F_NO_ERROR)
+    {
+	size = volume->cls_size - (position & volume->cls_mask);
 
-				if (file->first_clsno == DOSFS_CLSNO_NONE)
-				{
-				    file->flags |= DOSFS_FILE_FLAG_END_OF_CHAIN;
-				    file->clsno = DOSFS_CLSNO_NONE;
-				    file->blkno = DOSFS_BLKNO_INVALID;
-				    file->blkno_e = DOSFS_BLKNO_INVALID;
-				}
-				else
-				{
-				    file->clsno = file->first_clsno;
-				    file->blkno = DOSFS_CLSNO_TO_BLKNO(file->clsno);
-				    file->blkno_e = file->blkno + volume->cls_blk_size;
-				}
+	if (size > count)
+	{
+	    size = count & ~DOSFS_BLK_MASK;
+	}
 
-				if (mode & DOSFS_FILE_MODE_TRUNCATE)
-				{
-				    file->length = 0;
+	blkcnt = size >> DOSFS_BLK_SHIFT;
 
-				    status = dosfs_file_shrink(volume, file);
-				}
+	status = dosfs_data_cache_flush(volume, file);
 
-#if (DOSFS_CONFIG_CONTIGUOUS_SUPPORTED == 1)
-				if (size)
-				{
-				    if (file->first_clsno == DOSFS_CLSNO_NONE)
-				    {
-					status = dosfs_file_reserve(volume, file, size);
-				    }
-				    else
-				    {
-					clsno = file->first_clsno;
-					clscnt = 0;
+	if (status == F_NO_ERROR)
+	{
+	    file->callback = callback;
+	    file->context = context;
 
-					do
-					{
-					    status = dosfs_cluster_read(volume, clsno, &clsdata);
-					    
-					    if (status == F_NO_ERROR)
-					    {
-						if ((clsdata >= 2) && (clsdata <= volume->last_clsno))
-						{
-						    if ((clsno +1) == clsdata)
-						    {
-							clsno++;
-							clscnt++;
-						    }
-						    else
-						    {
-							status = F_ERR_EOF;
-						    }
+	    status = (*device->interface->read_async)(device->context, blkno, data, blkcnt, dosfs_file_read_callback, file);
 
-						}
-						else
-						{
-						    if (clsdata < DOSFS_CLSNO_LAST)
-						    {
-							status = F_ERR_EOF;
-						    }
-						}
-					    }
-					}
-					while ((status == F_NO_ERROR) && (clsdata < DOSFS_CLSNO_LAST));
+	    if (status == F_NO_ERROR)
+	    {
+		/* Asynchronous reads are counted, but their latency is not.
+		 */
+		device->statistics.reads++;
+		device->statistics.read_blocks += blkcnt;
 
-					if (status == F_NO_ERROR)
-					{
-					    if (clscnt == DOSFS_SIZE_TO_CLSCNT(size))
-					    {
-						file->flags |= (DOSFS_FILE_FLAG_CONTIGUOUS | DOSFS_FILE_FLAG_END_OF_CHAIN);
-						file->last_clsno = file->first_clsno + clscnt -1;
+		/* The file position is advanced right away. A failure is reported through
+		 * "file->status" and the callback.
+		 */
+		file->position = position + size;
+		file->clsno = clsno;
+		file->blkno = blkno + blkcnt;
+		file->blkno_e = blkno_e;
 
-						if (size >= (DOSFS_FILE_SIZE_MAX & ~volume->cls_mask))
-						{
-						    file->size = DOSFS_FILE_SIZE_MAX;
-						}
-						else
-						{
-						    file->size = (size + volume->cls_mask) & ~volume->cls_mask;
-						}
-					    }
-					    else
-					    {
-						status = F_ERR_EOF;
-					    }
-					}
-				    }
-				}
-#endif /* (DOSFS_CONFIG_CONTIGUOUS_SUPPORTED == 1) */
-			    
-				if (status == F_NO_ERROR)
-				{
-				    if (mode & DOSFS_FILE_MODE_APPEND)
-				    {
-					status = dosfs_file_seek(volume, file, file->length);
-				    }
-				
-				    if (status == F_NO_ERROR)
-				    {
-#if (DOSFS_CONFIG_FILE_DATA_CACHE == 1)
-					file->data_cache.blkno = DOSFS_BLKNO_INVALID;
-#endif /* (DOSFS_CONFIG_FILE_DATA_CACHE == 1) */
+		*p_count = size;
+	    }
+	    else
+	    {
+		file->callback = NULL;
+		file->context = NULL;
 
-					file->mode = mode;
-				    }
-				}
-			    }
-			}
-		    }
+		if (status == F_ERR_BUSY)
+		{
+		    status = F_NO_ERROR;
 		}
 	    }
 	}
     }
-    else
+
+    if (file->status == F_NO_ERROR)
     {
-	status = F_ERR_NOMOREENTRY;
+	file->status = status;
     }
 
-    *p_file = file;
-
     return status;
 }
 
-static int dosfs_file_close(dosfs_volume_t *volume, dosfs_file_t *file)
+/* Returns the blkno the next byte of "file" is read from.
+ */
+static int dosfs_file_read_blkno(dosfs_volume_t *volume, dosfs_file_t *file, uint32_t *p_blkno)
 {
     int status = F_NO_ERROR;
+    uint32_t clsno;
 
-    if (file->mode & DOSFS_FILE_MODE_WRITE)
+    *p_blkno = file->blkno;
+
+    if ((file->blkno == file->blkno_e) && (file->clsno != DOSFS_CLSNO_NONE))
     {
-	status = dosfs_file_flush(volume, file, TRUE);
-    }
+#if (DOSFS_CONFIG_CONTIGUOUS_SUPPORTED == 1)
+	if (!(file->flags & DOSFS_FILE_FLAG_CONTIGUOUS))
+#endif /* (DOSFS_CONFIG_CONTIGUOUS_SUPPORTED == 1) */
+	{
+	    status = dosfs_file_cluster_next(volume, file, file->clsno, file->position, &clsno);
 
-    file->mode = 0;
-    file->dir_clsno = DOSFS_CLSNO_NONE;
-    file->dir_index = 0;
+	    if (status == F_NO_ERROR)
+	    {
+		*p_blkno = DOSFS_CLSNO_TO_BLKNO(clsno);
+	    }
+	}
+    }
 
     return status;
 }
 
-static int dosfs_file_read(dosfs_volume_t *volume, dosfs_file_t *file, uint8_t *data, uint32_t count, uint32_t *p_count)
+/* Map the whole content of "file", if it occupies consecutive clusters and the device can map
+ * the corresponding blocks in place.
+ */
+static int dosfs_file_map(dosfs_volume_t *volume, dosfs_file_t *file, const void **p_data)
 {
     int status = F_NO_ERROR;
     dosfs_device_t *device;
-    uint32_t blkno, blkno_e, blkcnt, clsno, position, total, size;
-    dosfs_cache_entry_t *entry;
+    uint32_t clsno, clsdata, clscnt, blkcnt;
 
     device = DOSFS_VOLUME_DEVICE(volume);
 
-    *p_count = 0;
-
-    if (file->position >= file->length)
+    if (!device->interface->map || (file->length == 0) || (file->first_clsno == DOSFS_CLSNO_NONE))
     {
-	count = 0;
+	return F_ERR_NOTUSEABLE;
     }
-    else
+
+#if (DOSFS_CONFIG_CONTIGUOUS_SUPPORTED == 1)
+    if (!(file->flags & DOSFS_FILE_FLAG_CONTIGUOUS))
+#endif /* (DOSFS_CONFIG_CONTIGUOUS_SUPPORTED == 1) */
     {
-	if (count > (file->length - file->position))
+	clsno = file->first_clsno;
+
+	for (clscnt = DOSFS_OFFSET_TO_CLSCNT(file->length -1); (status == F_NO_ERROR) && (clscnt != 0); clscnt--)
 	{
-	    count = (file->length - file->position);
+	    status = dosfs_cluster_read(volume, clsno, &clsdata);
+
+	    if (status == F_NO_ERROR)
+	    {
+		if (clsdata != (clsno +1))
+		{
+		    status = F_ERR_NOTUSEABLE;
+		}
+
+		clsno = clsdata;
+	    }
 	}
     }
 
-    if (count != 0)
+    if (status == F_NO_ERROR)
     {
-	total = count;
+	status = dosfs_data_cache_flush(volume, file);
 
-        position = file->position;
-        clsno = file->clsno;
-        blkno = file->blkno;
-        blkno_e = file->blkno_e;
+	blkcnt = (file->length + DOSFS_BLK_MASK) >> DOSFS_BLK_SHIFT;
 
-	/* Take care of the case where there is an empty cluster chain,
-	 * but file->length is not 0.
-	 */
-	if (clsno == DOSFS_CLSNO_NONE)
+#if (DOSFS_CONFIG_WRITE_BACK_ENTRIES != 0)
+	if (status == F_NO_ERROR)
 	{
-	    status = F_ERR_EOF;
+	    status = dosfs_write_back_flush(volume, DOSFS_CLSNO_TO_BLKNO(file->first_clsno), blkcnt);
 	}
-        else
+#endif /* (DOSFS_CONFIG_WRITE_BACK_ENTRIES != 0) */
+
+	if (status == F_NO_ERROR)
 	{
-	    if (blkno == blkno_e)
+	    status = (*device->interface->map)(device->context, DOSFS_CLSNO_TO_BLKNO(file->first_clsno), blkcnt, p_data);
+	}
+    }
+
+    return status;
+}
+
+/* Serve a set of reads on different files in disk order. Each step reads one
+ * request up to the end of its current cluster (or all of it for a sequential file). The next step is taken from the
+ * request that continues where the device left off, otherwise from the one with
+ * the next higher blkno (wrapping around). Both SDMMC and SDSPI keep a READ_MULTIPLE
+ * open across reads at consecutive addresses, so files whose clusters interleave
+ * on the media (e.g. recorded concurrently) are read with a single command. At
+ * most 32 requests are scheduled together.
+ */
+static void dosfs_file_read_multiple(dosfs_volume_t *volume, F_READ_REQUEST *requests, unsigned int count)
+{
+    int status;
+    unsigned int index, select;
+    uint32_t pending, blkno, blkno_s, blkno_n, size, total;
+    dosfs_file_t *file;
+    F_READ_REQUEST *request;
+
+    pending = 0;
+
+    for (index = 0; index < count; index++)
+    {
+	request = &requests[index];
+
+	if ((request->status == F_NO_ERROR) && (DOSFS_FILE_VOLUME(request->file) == volume))
+	{
+	    if ((request->count < request->size) && (request->file->position < request->file->length))
 	    {
-#if (DOSFS_CONFIG_CONTIGUOUS_SUPPORTED == 1)
-		if (file->flags & DOSFS_FILE_FLAG_CONTIGUOUS)
+		pending |= (1ul << index);
+	    }
+	}
+    }
+
+    blkno_n = 0;
+
+    while (pending)
+    {
+	select = count;
+	blkno_s = 0;
+
+	for (index = 0; index < count; index++)
+	{
+	    if (pending & (1ul << index))
+	    {
+		request = &requests[index];
+
+		status = dosfs_file_read_blkno(volume, request->file, &blkno);
+
+		if (status != F_NO_ERROR)
 		{
-		    clsno++;
-		    blkno_e += volume->cls_blk_size;
+		    request->status = status;
+
+		    pending &= ~(1ul << index);
 		}
 		else
-#endif /* (DOSFS_CONFIG_CONTIGUOUS_SUPPORTED == 1) */
 		{
-		    status = dosfs_cluster_chain_seek(volume, clsno, 1, &clsno);
-
-		    if (status == F_NO_ERROR)
+		    /* Order by distance from "blkno_n" going forward, so an exact
+		     * continuation is 0, and anything below "blkno_n" comes last.
+		     */
+		    blkno -= blkno_n;
+		    
+		    if ((select == count) || (blkno < blkno_s))
 		    {
-			blkno = DOSFS_CLSNO_TO_BLKNO(clsno);
-			blkno_e = blkno + volume->cls_blk_size;
+			select = index;
+			blkno_s = blkno;
 		    }
 		}
 	    }
 	}
 
-        if (status == F_NO_ERROR)
-        {
-            if (((position & DOSFS_BLK_MASK) + count) < DOSFS_BLK_SIZE)
-            {
-                status = dosfs_data_cache_read(volume, file, blkno, &entry);
-	    
-                if (status == F_NO_ERROR)
-                {
-                    memcpy(data, entry->data + (position & DOSFS_BLK_MASK), count);
-
-                    position += count;
-                    count = 0;
+	if (select != count)
+	{
+	    request = &requests[select];
+	    file = request->file;
 
-                    if (!(position & DOSFS_BLK_MASK))
-                    {
-                        blkno++;
-                    }
-                }
-            }
-            else
-            {
-                if (position & DOSFS_BLK_MASK)
-                {
-                    status = dosfs_data_cache_read(volume, file, blkno, &entry);
-	    
-                    if (status == F_NO_ERROR)
-                    {
-                        size = (DOSFS_BLK_SIZE - (position & DOSFS_BLK_MASK));
+	    /* A file marked as sequential reads the rest of its request in one step, which
+	     * dosfs_file_read() issues as one device read per run of consecutive clusters.
+	     */
+	    if (file->mode & DOSFS_FILE_MODE_SEQUENTIAL)
+	    {
+		size = (uint32_t)(request->size - request->count);
+	    }
+	    else
+	    {
+		size = volume->cls_size - (file->position & volume->cls_mask);
 
-                        memcpy(data, entry->data + (DOSFS_BLK_SIZE - size), size);
+		if (size > (uint32_t)(request->size - request->count))
+		{
+		    size = (uint32_t)(request->size - request->count);
+		}
+	    }
 
-                        position += size;
-                        data += size;
-                        count -= size;
+	    status = dosfs_file_read(volume, file, (uint8_t*)request->buffer + request->count, size, &total);
 
-                        blkno++;
-                    }
-                }
+	    request->count += total;
 
-                while ((status == F_NO_ERROR) && (count != 0))
-                {
-                    if (blkno == blkno_e)
-                    {
-#if (DOSFS_CONFIG_CONTIGUOUS_SUPPORTED == 1)
-			if (file->flags & DOSFS_FILE_FLAG_CONTIGUOUS)
-			{
-			    clsno++;
-			    blkno_e += volume->cls_blk_size;
-			}
-			else
-#endif /* (DOSFS_CONFIG_CONTIGUOUS_SUPPORTED == 1) */
-			{
-			    status = dosfs_cluster_chain_seek(volume, clsno, 1, &clsno);
-			    
-			    if (status == F_NO_ERROR)
-			    {
-				blkno = DOSFS_CLSNO_TO_BLKNO(clsno);
-				blkno_e = blkno + volume->cls_blk_size;
-			    }
-			}
-		    }
-                
-                    if (status == F_NO_ERROR)
-                    {
-                        if (count < DOSFS_BLK_SIZE)
-                        {
-                            status = dosfs_data_cache_read(volume, file, blkno, &entry);
-                    
-                            if (status == F_NO_ERROR)
-                            {
-                                memcpy(data, entry->data, count);
+	    if (status != F_NO_ERROR)
+	    {
+		request->status = status;
+	    }
 
-                                position += count;
-                                data += count;
-                                count = 0;
-                            }
-                        }
-                        else
-                        {
-			    size = volume->cls_size - (position & volume->cls_mask);
-                            
-                            if (size > count)
-                            {
-                                size = count & ~DOSFS_BLK_MASK;
-                            }
+	    if ((status != F_NO_ERROR) || (total != size) || (request->count == request->size) || (file->position >= file->length))
+	    {
+		pending &= ~(1ul << select);
+	    }
 
-                            blkcnt = size >> DOSFS_BLK_SHIFT;
+	    blkno_n = file->blkno;
+	}
+    }
+}
 
-                            status = dosfs_data_cache_flush(volume, file);
+/* Apply an f_advise() hint. F_ADVICE_SEQUENTIAL/F_ADVICE_RANDOM replace the access pattern
+ * given with "S"/"R" to f_open(), F_ADVICE_NOCACHE is kept in file->flags. F_ADVICE_WILLNEED
+ * maps the clusters of [offset, offset + length) and loads the block at "offset", while
+ * leaving the file position alone.
+ */
+static int dosfs_file_advise(dosfs_volume_t *volume, dosfs_file_t *file, uint32_t offset, uint32_t length, uint32_t advice)
+{
+    int status = F_NO_ERROR;
+    uint32_t position, clsno, blkno, blkno_e, blkno_r;
+    dosfs_cache_entry_t *entry;
 
-                            if (status == F_NO_ERROR)
-                            {
-                                status = (*device->interface->read)(device->context, blkno, data, blkcnt, !!(file->mode & DOSFS_FILE_MODE_SEQUENTIAL));
+    file->mode &= ~(DOSFS_FILE_MODE_SEQUENTIAL | DOSFS_FILE_MODE_RANDOM);
+    file->flags &= ~DOSFS_FILE_FLAG_NO_CACHE;
 
-#if (DOSFS_CONFIG_MEDIA_FAILURE_SUPPORTED == 1)
-				if (status == F_ERR_INVALIDSECTOR)
-				{
-				    volume->flags |= DOSFS_VOLUME_FLAG_MEDIA_FAILURE;
-				}
-#endif /* (DOSFS_CONFIG_MEDIA_FAILURE_SUPPORTED == 1) */
+    if (advice & F_ADVICE_SEQUENTIAL)
+    {
+	file->mode |= DOSFS_FILE_MODE_SEQUENTIAL;
+    }
 
-                                if (status == F_NO_ERROR)
-                                {
-                                    position += size;
-                                    data += size;
-                                    count -= size;
+    if (advice & F_ADVICE_RANDOM)
+    {
+	file->mode |= DOSFS_FILE_MODE_RANDOM;
+    }
 
-                                    blkno += blkcnt;
-                                }
+    if (advice & F_ADVICE_NOCACHE)
+    {
+	file->flags |= DOSFS_FILE_FLAG_NO_CACHE;
 
-				/* After any data related disk operation, "file->status" needs
-				 * to be checked asynchronously for a previous error.
-				 */
-				if (file->status != F_NO_ERROR)
-				{
-				    status = file->status;
-				}
-                            }
-                        }
-                    }
-                }
-            }
-        
-            if (status == F_NO_ERROR)
-            {
-                file->position = position;
-                file->clsno = clsno;
-                file->blkno = blkno;
-                file->blkno_e = blkno_e;
-            }
-        }
+	status = dosfs_data_cache_flush(volume, file);
 
-	*p_count = total - count;
+	if (status == F_NO_ERROR)
+	{
+	    dosfs_data_cache_release(volume, file);
+	}
     }
 
-    if (file->status == F_NO_ERROR)
-    {
-	file->status = status;
+    if ((status == F_NO_ERROR) && (advice & F_ADVICE_WILLNEED) && (offset < file->length) && (length != 0))
+    {
+#if (DOSFS_CONFIG_EXTENT_ENTRIES != 0)
+	if (!(file->mode & DOSFS_FILE_MODE_WRITE) && (file->extent_clscnt == 0))
+	{
+	    status = dosfs_file_extent_build(volume, file);
+	}
+#endif /* (DOSFS_CONFIG_EXTENT_ENTRIES != 0) */
+
+	if ((status == F_NO_ERROR) && !(file->flags & DOSFS_FILE_FLAG_NO_CACHE))
+	{
+	    position = file->position;
+	    clsno = file->clsno;
+	    blkno = file->blkno;
+	    blkno_e = file->blkno_e;
+
+	    status = dosfs_file_seek(volume, file, offset);
+
+	    if (status == F_NO_ERROR)
+	    {
+		status = dosfs_file_read_blkno(volume, file, &blkno_r);
+
+		if (status == F_NO_ERROR)
+		{
+		    status = dosfs_data_cache_read(volume, file, blkno_r, &entry);
+		}
+	    }
+
+	    file->position = position;
+	    file->clsno = clsno;
+	    file->blkno = blkno;
+	    file->blkno_e = blkno_e;
+	}
     }
 
     return status;
@@ -8450,7 +11373,13 @@ static int dosfs_file_write(dosfs_volume_t *volume, dosfs_file_t *file, const ui
 	{
 	    if (count != 0)
 	    {
-		file->flags |= DOSFS_FILE_FLAG_DATA_MODIFIED;
+		/* An overwrite in place does not update the modification time, so that
+		 * it is only a data write.
+		 */
+		if (!(file->flags & DOSFS_FILE_FLAG_IN_PLACE) || ((file->position + count) > file->length))
+		{
+		    file->flags |= DOSFS_FILE_FLAG_DATA_MODIFIED;
+		}
 
 		total  = count;
 		offset = (file->length + DOSFS_BLK_MASK) & ~DOSFS_BLK_MASK;
@@ -8652,7 +11581,9 @@ static int dosfs_file_write(dosfs_volume_t *volume, dosfs_file_t *file, const ui
 
 					if (status == F_NO_ERROR)
 					{
-					    status = (*device->interface->write)(device->context, blkno, data, blkcnt, &file->status);
+					    dosfs_volume_invalidate(volume, blkno, blkcnt);
+
+					    status = dosfs_device_write(device, blkno, data, blkcnt, &file->status);
 
 #if (DOSFS_CONFIG_MEDIA_FAILURE_SUPPORTED == 1)
 					    if (status == F_ERR_INVALIDSECTOR)
@@ -8688,7 +11619,7 @@ static int dosfs_file_write(dosfs_volume_t *volume, dosfs_file_t *file, const ui
 		    {
 			if (!(file->mode & DOSFS_FILE_MODE_SEQUENTIAL))
 			{
-			    status = (*device->interface->sync)(device->context, !!(file->mode & DOSFS_FILE_MODE_RANDOM));
+			    status = dosfs_device_sync(device, !!(file->mode & DOSFS_FILE_MODE_RANDOM));
 			}
 
 			if (file->status != F_NO_ERROR)
@@ -8770,6 +11701,60 @@ int f_initvolume(void)
     return status;
 }
 
+#if (DOSFS_CONFIG_STORAGE_SHARED_SUPPORTED == 1)
+
+/* Like f_initvolume(), but without taking the volume away from USB/MSC. The volume
+ * is mounted write protected, and device reads are interleaved with the SCSI
+ * commands of the host. Caches are invalidated when the host writes, so that new
+ * files and directories show up. Mind that a file the host rewrites while it is
+ * open here returns stale or mixed data.
+ */
+int f_initvolume_shared(void)
+{
+    int status = F_NO_ERROR;
+    dosfs_volume_t *volume;
+    dosfs_device_t *device; 
+    uint32_t o_lock, n_lock;
+
+    volume = DOSFS_DEFAULT_VOLUME();
+    device = DOSFS_VOLUME_DEVICE(volume);
+
+    while (1)
+    {
+	o_lock = device->lock;
+	
+	if (!(o_lock & (DOSFS_DEVICE_LOCK_VOLUME | DOSFS_DEVICE_LOCK_INIT)))
+	{
+	    n_lock = (o_lock | DOSFS_DEVICE_LOCK_SHARED) & ~DOSFS_DEVICE_LOCK_STALE;
+	    
+	    if (armv7m_atomic_compare_exchange(&device->lock, &o_lock, n_lock))
+	    {
+		break;
+	    }
+	}
+	
+	armv7m_core_yield();
+    }
+
+    status = dosfs_volume_lock_noinit(volume);
+    
+    if (status == F_NO_ERROR)
+    {
+	status = dosfs_volume_init(volume, device);
+        
+	status = dosfs_volume_unlock(volume, status);
+    }
+
+    if (status != F_NO_ERROR)
+    {
+	armv7m_atomic_and(&device->lock, ~DOSFS_DEVICE_LOCK_SHARED);
+    }
+
+    return status;
+}
+
+#endif /* (DOSFS_CONFIG_STORAGE_SHARED_SUPPORTED == 1) */
+
 int f_delvolume(void)
 {
     int status = F_NO_ERROR;
@@ -8787,7 +11772,14 @@ int f_delvolume(void)
 
 	if (status == F_NO_ERROR)
 	{
-	    status = (*device->interface->release)(device->context);
+#if (DOSFS_CONFIG_STORAGE_SHARED_SUPPORTED == 1)
+	    /* The host may still use the device of a shared volume.
+	     */
+	    if (!(device->lock & DOSFS_DEVICE_LOCK_SHARED))
+#endif /* (DOSFS_CONFIG_STORAGE_SHARED_SUPPORTED == 1) */
+	    {
+		status = (*device->interface->release)(device->context);
+	    }
 
 	    if (status == F_NO_ERROR)
 	    {
@@ -8800,12 +11792,36 @@ int f_delvolume(void)
 
     if (status == F_NO_ERROR)
     {
-	armv7m_atomic_and(&device->lock, ~DOSFS_DEVICE_LOCK_VOLUME);
+	armv7m_atomic_and(&device->lock, ~(DOSFS_DEVICE_LOCK_VOLUME | DOSFS_DEVICE_LOCK_SHARED | DOSFS_DEVICE_LOCK_STALE));
+    }
+
+    return status;
+}
+
+/* Select the drive the volume functions (f_initvolume(), f_format(), ...) and paths
+ * without a "N:" prefix refer to.
+ */
+int f_chdrive(int drive)
+{
+    int status = F_NO_ERROR;
+
+    if ((drive < 0) || (drive >= DOSFS_CONFIG_MAX_VOLUMES))
+    {
+	status = F_ERR_INVALIDDRIVE;
+    }
+    else
+    {
+	dosfs_volume_default = &dosfs_volume_table[drive];
     }
 
     return status;
 }
 
+int f_getdrive(void)
+{
+    return dosfs_volume_default - &dosfs_volume_table[0];
+}
+
 int f_checkvolume(void)
 {
     int status = F_NO_ERROR;
@@ -8819,7 +11835,20 @@ int f_checkvolume(void)
     
     if (status == F_NO_ERROR)
     {
-        status = (*device->interface->sync)(device->context, true);
+        status = dosfs_device_sync(device, true);
+
+#if (DOSFS_CONFIG_VOLUME_DIRTY_SUPPORTED == 1) && (DOSFS_CONFIG_TRANSACTION_SAFE_SUPPORTED == 0)
+	/* A volume mounted dirty stays marked as such on disk, till it got checked.
+	 * Turn it into a dirty state of this mount, so that dosfs_volume_clean() clears
+	 * the dirty bit in the boot sector.
+	 */
+	if ((status == F_NO_ERROR) && (volume->flags & DOSFS_VOLUME_FLAG_MOUNTED_DIRTY))
+	{
+	    volume->flags = (volume->flags & ~DOSFS_VOLUME_FLAG_MOUNTED_DIRTY) | DOSFS_VOLUME_FLAG_VOLUME_DIRTY;
+
+	    status = dosfs_volume_clean(volume, status);
+	}
+#endif /* (DOSFS_CONFIG_VOLUME_DIRTY_SUPPORTED == 1) && (DOSFS_CONFIG_TRANSACTION_SAFE_SUPPORTED == 0) */
 
 	status = dosfs_volume_unlock(volume, status);
     }
@@ -8872,13 +11901,22 @@ int f_hardformat(int fattype)
     
     if (status == F_NO_ERROR)
     {
-	status = dosfs_volume_unmount(volume);
+#if (DOSFS_CONFIG_STORAGE_SHARED_SUPPORTED == 1)
+	if (device->lock & DOSFS_DEVICE_LOCK_SHARED)
+	{
+	    status = F_ERR_WRITEPROTECT;
+	}
+	else
+#endif /* (DOSFS_CONFIG_STORAGE_SHARED_SUPPORTED == 1) */
+	{
+	    status = dosfs_volume_unmount(volume);
+	}
 
 	if (status == F_NO_ERROR)
 	{
 	    volume->dir_cache.blkno = DOSFS_BLKNO_INVALID;
 
-	    status = dosfs_device_format(device, volume->dir_cache.data);
+	    status = dosfs_device_format(device, volume->dir_cache.data, (fattype & (F_FORMAT_ALIGN | F_FORMAT_STREAMING | F_FORMAT_SMALL_FILES)));
         }
         
 	status = dosfs_volume_unlock(volume, status);
@@ -8892,6 +11930,9 @@ int f_getfreespace(F_SPACE *pspace)
 {
     int status = F_NO_ERROR;
     uint32_t clsno, clsno_e, clscnt_total, clscnt_free, clsdata;
+#if (DOSFS_CONFIG_FREE_BITMAP_ENTRIES != 0)
+    uint32_t clscnt_g;
+#endif /* (DOSFS_CONFIG_FREE_BITMAP_ENTRIES != 0) */
     dosfs_volume_t *volume;
 
     volume = DOSFS_DEFAULT_VOLUME();
@@ -8900,6 +11941,15 @@ int f_getfreespace(F_SPACE *pspace)
     
     if (status == F_NO_ERROR)
     {
+#if (DOSFS_CONFIG_EXFAT_SUPPORTED == 1)
+	if (volume->flags & DOSFS_VOLUME_FLAG_EXFAT)
+	{
+	    clscnt_total = volume->last_clsno - 1;
+
+	    status = dosfs_exfat_count_free(volume, &clscnt_free);
+	}
+	else
+#endif /* (DOSFS_CONFIG_EXFAT_SUPPORTED == 1) */
 #if (DOSFS_CONFIG_FSINFO_SUPPORTED == 1)
 	if (volume->flags & DOSFS_VOLUME_FLAG_FSINFO_VALID)
 	{
@@ -8911,9 +11961,23 @@ int f_getfreespace(F_SPACE *pspace)
 	{
 	    clscnt_total = volume->last_clsno - 1;
 	    clscnt_free = 0;
+#if (DOSFS_CONFIG_FREE_BITMAP_ENTRIES != 0)
+	    clscnt_g = 0;
+#endif /* (DOSFS_CONFIG_FREE_BITMAP_ENTRIES != 0) */
 
 	    for (clsno = 2, clsno_e = volume->last_clsno; ((status == F_NO_ERROR) && (clsno <= clsno_e)); clsno++)
 	    {
+#if (DOSFS_CONFIG_FREE_BITMAP_ENTRIES != 0)
+		/* A group known to be full contributes no free clusters.
+		 */
+		if ((clsno == dosfs_free_bitmap_first(volume, clsno)) && dosfs_free_bitmap_full(volume, clsno))
+		{
+		    clsno = dosfs_free_bitmap_last(volume, clsno);
+
+		    continue;
+		}
+#endif /* (DOSFS_CONFIG_FREE_BITMAP_ENTRIES != 0) */
+
 		/* Bypass cluster cache on read while scanning.
 		 */
 		status = dosfs_cluster_read_uncached(volume, clsno, &clsdata);
@@ -8923,7 +11987,22 @@ int f_getfreespace(F_SPACE *pspace)
 		    if (clsdata == DOSFS_CLSNO_FREE)
 		    {
 			clscnt_free++;
+#if (DOSFS_CONFIG_FREE_BITMAP_ENTRIES != 0)
+			clscnt_g++;
+#endif /* (DOSFS_CONFIG_FREE_BITMAP_ENTRIES != 0) */
+		    }
+
+#if (DOSFS_CONFIG_FREE_BITMAP_ENTRIES != 0)
+		    if (clsno == dosfs_free_bitmap_last(volume, clsno))
+		    {
+			if (clscnt_g == 0)
+			{
+			    dosfs_free_bitmap_set(volume, clsno);
+			}
+
+			clscnt_g = 0;
 		    }
+#endif /* (DOSFS_CONFIG_FREE_BITMAP_ENTRIES != 0) */
 		}
 	    }
 
@@ -9009,6 +12088,139 @@ int f_getserial(unsigned long *p_serial)
     return status;
 }
 
+/* Report in "*p_dirty" whether the volume was not cleanly unmounted before it got mounted,
+ * i.e. whether f_checkvolume() should be run. f_checkvolume() clears the state.
+ */
+int f_getdirty(int *p_dirty)
+{
+    int status = F_NO_ERROR;
+    dosfs_volume_t *volume;
+
+    volume = DOSFS_DEFAULT_VOLUME();
+    
+    status = dosfs_volume_lock(volume);
+    
+    if (status == F_NO_ERROR)
+    {
+#if (DOSFS_CONFIG_VOLUME_DIRTY_SUPPORTED == 1)
+	*p_dirty = !!(volume->flags & DOSFS_VOLUME_FLAG_MOUNTED_DIRTY);
+#else /* (DOSFS_CONFIG_VOLUME_DIRTY_SUPPORTED == 1) */
+	*p_dirty = 1;
+#endif /* (DOSFS_CONFIG_VOLUME_DIRTY_SUPPORTED == 1) */
+
+	status = dosfs_volume_unlock(volume, status);
+    }
+
+    return status;
+}
+
+
+/* Supply (or with a NULL "data" remove) the memory for the sector cache. "size" is in bytes,
+ * each entry takes F_CACHE_ENTRY_SIZE bytes. The cache starts out empty, and is invalidated
+ * whenever the volume gets (re)mounted.
+ */
+int f_setcache(void *data, unsigned long size)
+{
+    int status = F_NO_ERROR;
+    uint32_t index, count;
+    dosfs_volume_t *volume;
+
+    volume = DOSFS_DEFAULT_VOLUME();
+
+    status = dosfs_volume_lock_nomount(volume);
+    
+    if (status == F_NO_ERROR)
+    {
+	count = data ? (size / F_CACHE_ENTRY_SIZE) : 0;
+
+	if ((uint32_t)data & 3)
+	{
+	    status = F_ERR_NOTUSEABLE;
+	}
+	else
+	{
+	    volume->sector_count = 0;
+
+	    if (count)
+	    {
+		volume->sector_data = (uint8_t*)data;
+		volume->sector_blkno = (uint32_t*)((void*)((uint8_t*)data + (count * DOSFS_BLK_SIZE)));
+		volume->sector_stamp = volume->sector_blkno + count;
+
+		for (index = 0; index < count; index++)
+		{
+		    volume->sector_blkno[index] = DOSFS_BLKNO_INVALID;
+		    volume->sector_stamp[index] = 0;
+		}
+	    }
+	    else
+	    {
+		volume->sector_data = NULL;
+		volume->sector_blkno = NULL;
+		volume->sector_stamp = NULL;
+	    }
+
+	    volume->sector_count = count;
+	    volume->sector_clock = 0;
+	    volume->sector_hits = 0;
+	    volume->sector_misses = 0;
+	}
+
+	status = dosfs_volume_unlock(volume, status);
+    }
+
+    return status;
+}
+
+int f_getcache(F_CACHE *pcache)
+{
+    int status = F_NO_ERROR;
+    dosfs_volume_t *volume;
+
+    volume = DOSFS_DEFAULT_VOLUME();
+    
+    status = dosfs_volume_lock_nomount(volume);
+    
+    if (status == F_NO_ERROR)
+    {
+	pcache->size = volume->sector_count;
+	pcache->hits = volume->sector_hits;
+	pcache->misses = volume->sector_misses;
+
+	status = dosfs_volume_unlock(volume, status);
+    }
+
+    return status;
+}
+
+
+int f_getstatistics(F_STATISTICS *pstatistics, int reset)
+{
+    int status = F_NO_ERROR;
+    dosfs_volume_t *volume;
+    dosfs_device_t *device;
+
+    volume = DOSFS_DEFAULT_VOLUME();
+    
+    status = dosfs_volume_lock_nomount(volume);
+    
+    if (status == F_NO_ERROR)
+    {
+	device = DOSFS_VOLUME_DEVICE(volume);
+
+	memcpy(pstatistics, &device->statistics, sizeof(F_STATISTICS));
+
+	if (reset)
+	{
+	    memset(&device->statistics, 0, offsetof(F_STATISTICS, clock));
+	}
+
+	status = dosfs_volume_unlock(volume, status);
+    }
+
+    return status;
+}
+
 
 int f_setlabel(const char *volname)
 {
@@ -9104,67 +12316,76 @@ int f_getlabel(char *volname, int length)
     {
 	dosname = NULL;
 
-	status = dosfs_path_find_entry(volume, DOSFS_CLSNO_NONE, 0, 0, dosfs_path_find_callback_volume, NULL, NULL, NULL, &dir);
-
-	if (status == F_NO_ERROR)
+#if (DOSFS_CONFIG_EXFAT_SUPPORTED == 1)
+	if (volume->flags & DOSFS_VOLUME_FLAG_EXFAT)
+	{
+	    status = dosfs_exfat_get_label(volume, volname, length);
+	}
+	else
+#endif /* (DOSFS_CONFIG_EXFAT_SUPPORTED == 1) */
 	{
-	    volname_e = volname + length;
+	    status = dosfs_path_find_entry(volume, DOSFS_CLSNO_NONE, 0, 0, dosfs_path_find_callback_volume, NULL, NULL, NULL, &dir);
 
-	    if (dir == NULL)
+	    if (status == F_NO_ERROR)
 	    {
+		volname_e = volname + length;
+
+		if (dir == NULL)
+		{
 #if (DOSFS_CONFIG_VOLUME_DIRTY_SUPPORTED == 1) || (DOSFS_CONFIG_TRANSACTION_SAFE_SUPPORTED == 1)
-		boot = (dosfs_boot_t*)((void*)&volume->bs_data[0]);
+		    boot = (dosfs_boot_t*)((void*)&volume->bs_data[0]);
 #else /* (DOSFS_CONFIG_VOLUME_DIRTY_SUPPORTED == 1) || (DOSFS_CONFIG_TRANSACTION_SAFE_SUPPORTED == 1) */
 
-		boot = (dosfs_boot_t*)((void*)volume->dir_cache.data);
+		    boot = (dosfs_boot_t*)((void*)volume->dir_cache.data);
 
-		status = dosfs_dir_cache_flush(volume);
+		    status = dosfs_dir_cache_flush(volume);
 		
-		if (status == F_NO_ERROR)
-		{
-		    status = dosfs_volume_read(volume, volume->boot_blkno, (uint8_t*)boot);
-		}
+		    if (status == F_NO_ERROR)
+		    {
+			status = dosfs_volume_read(volume, volume->boot_blkno, (uint8_t*)boot);
+		    }
 
-		if (status == F_NO_ERROR)
+		    if (status == F_NO_ERROR)
 #endif /* (DOSFS_CONFIG_VOLUME_DIRTY_SUPPORTED == 1) || (DOSFS_CONFIG_TRANSACTION_SAFE_SUPPORTED == 1) */
-		{
-		    if (volume->type != DOSFS_VOLUME_TYPE_FAT32)
 		    {
-			if (boot->bpb40.bs_boot_sig == 0x29)
+			if (volume->type != DOSFS_VOLUME_TYPE_FAT32)
 			{
-			    dosname = (const uint8_t*)boot->bpb40.bs_vol_lab;
+			    if (boot->bpb40.bs_boot_sig == 0x29)
+			    {
+				dosname = (const uint8_t*)boot->bpb40.bs_vol_lab;
+			    }
 			}
-		    }
-		    else
-		    {
-			if (boot->bpb71.bs_boot_sig == 0x29)
+			else
 			{
-			    dosname = (const uint8_t*)boot->bpb71.bs_vol_lab;
+			    if (boot->bpb71.bs_boot_sig == 0x29)
+			    {
+				dosname = (const uint8_t*)boot->bpb71.bs_vol_lab;
+			    }
 			}
 		    }
 		}
+		else
+		{
+		    dosname = (const uint8_t*)dir->dir_name;
+		}
 	    }
-	    else
-	    {
-		dosname = (const uint8_t*)dir->dir_name;
-	    }
-	}
 
-	if (status == F_NO_ERROR)
-	{
-	    if (dosname != NULL)
+	    if (status == F_NO_ERROR)
 	    {
-		volname = dosfs_name_label_to_cstring(dosname, volname, volname_e);
+		if (dosname != NULL)
+		{
+		    volname = dosfs_name_label_to_cstring(dosname, volname, volname_e);
 
-		if (volname == NULL)
+		    if (volname == NULL)
+		    {
+			status = F_ERR_TOOLONGNAME;
+		    }
+		}
+		else
 		{
-		    status = F_ERR_TOOLONGNAME;
+		    status = F_ERR_NOTFOUND;
 		}
 	    }
-	    else
-	    {
-		status = F_ERR_NOTFOUND;
-	    }
 	}
 
 	status = dosfs_volume_unlock(volume, status);
@@ -9457,7 +12678,16 @@ int f_chdir(const char *dirname)
              * so special code this here.
              */
             volume->cwd_clsno = DOSFS_CLSNO_NONE;
+#if (DOSFS_CONFIG_EXFAT_SUPPORTED == 1)
+	    volume->cwd_clscnt = 0;
+#endif /* (DOSFS_CONFIG_EXFAT_SUPPORTED == 1) */
         }
+#if (DOSFS_CONFIG_EXFAT_SUPPORTED == 1)
+	else if (volume->flags & DOSFS_VOLUME_FLAG_EXFAT)
+	{
+	    status = dosfs_exfat_change_directory(volume, dirname);
+	}
+#endif /* (DOSFS_CONFIG_EXFAT_SUPPORTED == 1) */
         else
         {
             status = dosfs_path_find_directory(volume, dirname, &dirname, &clsno_d);
@@ -9570,6 +12800,15 @@ int f_getcwd(char *dirname, int length)
 	
 	    index = length -1;
 	    
+#if (DOSFS_CONFIG_EXFAT_SUPPORTED == 1)
+	    /* exFAT has no ".." entries to walk up the directory tree.
+	     */
+	    if ((clsno_s != DOSFS_CLSNO_NONE) && (volume->flags & DOSFS_VOLUME_FLAG_EXFAT))
+	    {
+		status = F_ERR_NOTFOUND;
+	    }
+	    else
+#endif /* (DOSFS_CONFIG_EXFAT_SUPPORTED == 1) */
 	    if (clsno_s != DOSFS_CLSNO_NONE)
 	    {
 		blkno = volume->cls_blk_offset + (clsno_s << volume->cls_blk_shift);
@@ -9862,6 +13101,14 @@ int f_rename(const char *filename, const char *newname)
 							memcpy(dir->dir_name, volume->dir.dir_name, 11);
 						    
 							dir->dir_nt_reserved = volume->dir.dir_nt_reserved;
+
+#if (DOSFS_CONFIG_DIR_INDEX_ENTRIES != 0)
+							volume->index_clsno = DOSFS_CLSNO_END_OF_CHAIN;
+#endif /* (DOSFS_CONFIG_DIR_INDEX_ENTRIES != 0) */
+
+#if (DOSFS_CONFIG_REOPEN_ENTRIES != 0)
+							dosfs_file_reopen_invalidate(volume, NULL);
+#endif /* (DOSFS_CONFIG_REOPEN_ENTRIES != 0) */
 						    
 							status = dosfs_dir_cache_write(volume);
 						    }
@@ -9902,6 +13149,14 @@ int f_move(const char *filename, const char *newname)
 
     volume = DOSFS_PATH_VOLUME(filename);
 
+    /* Moving is only possible within a drive, so "newname" may only name
+     * the drive of "filename".
+     */
+    if (volume && (dosfs_path_volume(&newname, volume) != volume))
+    {
+	volume = NULL;
+    }
+
     status = dosfs_volume_lock(volume);
     
     if (status == F_NO_ERROR)
@@ -10209,12 +13464,17 @@ int f_findfirst(const char *filename, F_FIND *find)
     
     if (status == F_NO_ERROR)
     {
+	find->find_volume = volume - &dosfs_volume_table[0];
 	find->find_index = 0;
 
         status = dosfs_path_find_directory(volume, filename, &filename, &find->find_clsno);
             
         if (status == F_NO_ERROR)
         {
+#if (DOSFS_CONFIG_EXFAT_SUPPORTED == 1)
+	    find->find_clscnt = (volume->flags & DOSFS_VOLUME_FLAG_EXFAT) ? volume->exfat_clscnt_d : 0;
+#endif /* (DOSFS_CONFIG_EXFAT_SUPPORTED == 1) */
+
 #if (DOSFS_CONFIG_VFAT_SUPPORTED == 0)
 
 	    /* For non-VFAT, build a MSDOS style template where '*' is expanded into
@@ -10476,6 +13736,18 @@ F_FILE * f_open(const char *filename, const char *type)
 	{
 	    mode |= DOSFS_FILE_MODE_RANDOM;
 	}
+#if (DOSFS_CONFIG_EXTENT_ENTRIES != 0)
+	else if (c == 'M')
+	{
+	    mode |= DOSFS_FILE_MODE_EXTENT;
+	}
+#endif /* (DOSFS_CONFIG_EXTENT_ENTRIES != 0) */
+	else if (c == 'P')
+	{
+	    /* Writes that do not extend the file leave its directory entry alone.
+	     */
+	    mode |= DOSFS_FILE_MODE_IN_PLACE;
+	}
 #if (DOSFS_CONFIG_CONTIGUOUS_SUPPORTED == 1)
 	else if ((c == ',') && (*type != '\0'))
 	{
@@ -10703,6 +13975,267 @@ long f_read(void *buffer, long size, long count, F_FILE *file)
     return result;
 }
 
+/* Read up to "size" bytes into "buffer" without waiting for the device. The block
+ * aligned part within the current cluster is handed to the device as a background
+ * transfer; otherwise (unaligned position, short read, or a device without DMA) the
+ * read is done synchronously. The return value is the number of bytes that will be
+ * delivered. If it is non-zero, "callback" is invoked exactly once when the data has
+ * arrived, possibly from an interrupt handler, and possibly before f_read_async()
+ * returns. "buffer" and "file" must not be touched until then.
+ */
+long f_read_async(void *buffer, long size, F_FILE *file, F_CALLBACK callback, void *context)
+{
+    int status = F_NO_ERROR;
+    long result = 0;
+    uint32_t total;
+    dosfs_volume_t *volume;
+
+    if (!file || !file->mode)
+    {
+        status = F_ERR_NOTOPEN;
+    }
+    else
+    {
+        if (!(file->mode & DOSFS_FILE_MODE_READ))
+        {
+            status = F_ERR_ACCESSDENIED;
+        }
+        else
+        {
+	    status = file->status;
+		
+	    if ((status == F_NO_ERROR) && (size > 0) && callback)
+	    {
+		volume = DOSFS_FILE_VOLUME(file);
+		    
+		status = dosfs_volume_lock(volume);
+		    
+		if (status == F_NO_ERROR)
+		{
+		    status = dosfs_file_read_async(volume, file, (uint8_t*)buffer, (unsigned long)size, callback, context, &total);
+
+		    if ((status == F_NO_ERROR) && (total == 0))
+		    {
+			status = dosfs_file_read(volume, file, (uint8_t*)buffer, (unsigned long)size, &total);
+
+			status = dosfs_volume_unlock(volume, status);
+
+			if (total)
+			{
+			    (*callback)(context, status);
+			}
+		    }
+		    else
+		    {
+			status = dosfs_volume_unlock(volume, status);
+		    }
+
+		    result = total;
+		}
+	    }
+        }
+    }
+
+    return result;
+}
+
+/* Read into the buffers of several files with one call, issuing the device reads
+ * in disk order (see dosfs_file_read_multiple()). Each request reports the number
+ * of bytes read in "count" and its own error in "status". The return value is
+ * the first error of any request. Files on different drives are scheduled per
+ * drive.
+ */
+int f_read_multiple(F_READ_REQUEST *requests, int count)
+{
+    int status = F_NO_ERROR;
+    int index, offset, chunk;
+    dosfs_volume_t *volume;
+    F_READ_REQUEST *request;
+
+    for (index = 0; index < count; index++)
+    {
+	request = &requests[index];
+
+	request->count = 0;
+
+	if (!request->file || !request->file->mode)
+	{
+	    request->status = F_ERR_NOTOPEN;
+	}
+	else
+	{
+	    if (!(request->file->mode & DOSFS_FILE_MODE_READ))
+	    {
+		request->status = F_ERR_ACCESSDENIED;
+	    }
+	    else
+	    {
+		request->status = request->file->status;
+	    }
+	}
+    }
+
+    for (offset = 0; offset < count; offset += chunk)
+    {
+	chunk = ((count - offset) > 32) ? 32 : (count - offset);
+
+	for (volume = &dosfs_volume_table[0]; volume < &dosfs_volume_table[DOSFS_CONFIG_MAX_VOLUMES]; volume++)
+	{
+	    for (index = offset; index < (offset + chunk); index++)
+	    {
+		if ((requests[index].status == F_NO_ERROR) && (DOSFS_FILE_VOLUME(requests[index].file) == volume))
+		{
+		    break;
+		}
+	    }
+
+	    if (index == (offset + chunk))
+	    {
+		continue;
+	    }
+
+	    status = dosfs_volume_lock(volume);
+
+	    if (status == F_NO_ERROR)
+	    {
+		dosfs_file_read_multiple(volume, &requests[offset], chunk);
+
+		status = dosfs_volume_unlock(volume, status);
+	    }
+
+	    if (status != F_NO_ERROR)
+	    {
+		for (index = offset; index < (offset + chunk); index++)
+		{
+		    if ((requests[index].status == F_NO_ERROR) && (DOSFS_FILE_VOLUME(requests[index].file) == volume))
+		    {
+			requests[index].status = status;
+		    }
+		}
+	    }
+	}
+    }
+
+    for (index = 0, status = F_NO_ERROR; (index < count) && (status == F_NO_ERROR); index++)
+    {
+	status = requests[index].status;
+    }
+
+    return status;
+}
+
+/* Returns a pointer to the content of "file" in "*p_data", if the device can map it in place. The
+ * mapping stays valid until f_unmap(), as long as the file is not modified or deleted. If the file
+ * cannot be mapped F_ERR_NOTUSEABLE is returned, and it has to be read via f_read().
+ */
+/* Tell how "file" is going to be read, like posix_fadvise(). The access pattern
+ * (F_ADVICE_SEQUENTIAL, F_ADVICE_RANDOM or neither) and F_ADVICE_NOCACHE replace the
+ * previous hints, F_ADVICE_WILLNEED prepares [offset, offset + length) for a read.
+ */
+int f_advise(F_FILE *file, long offset, long length, int advice)
+{
+    int status = F_NO_ERROR;
+    dosfs_volume_t *volume;
+
+    if (!file || !file->mode)
+    {
+        status = F_ERR_NOTOPEN;
+    }
+    else
+    {
+	status = file->status;
+
+	if (status == F_NO_ERROR)
+	{
+	    if ((offset < 0) || (length < 0) || ((advice & (F_ADVICE_SEQUENTIAL | F_ADVICE_RANDOM)) == (F_ADVICE_SEQUENTIAL | F_ADVICE_RANDOM)))
+	    {
+		status = F_ERR_NOTUSEABLE;
+	    }
+	    else
+	    {
+		volume = DOSFS_FILE_VOLUME(file);
+
+		status = dosfs_volume_lock(volume);
+        
+		if (status == F_NO_ERROR)
+		{
+		    status = dosfs_file_advise(volume, file, (uint32_t)offset, (uint32_t)length, (uint32_t)advice);
+
+		    status = dosfs_volume_unlock(volume, status);
+		}
+	    }
+	}
+    }
+
+    return status;
+}
+
+int f_map(F_FILE *file, const void **p_data)
+{
+    int status = F_NO_ERROR;
+    dosfs_volume_t *volume;
+
+    if (!file || !file->mode)
+    {
+        status = F_ERR_NOTOPEN;
+    }
+    else
+    {
+	status = file->status;
+
+	if (status == F_NO_ERROR)
+	{
+	    if (!(file->mode & DOSFS_FILE_MODE_READ))
+	    {
+		status = F_ERR_ACCESSDENIED;
+	    }
+	    else
+	    {
+		volume = DOSFS_FILE_VOLUME(file);
+
+		status = dosfs_volume_lock(volume);
+
+		if (status == F_NO_ERROR)
+		{
+		    status = dosfs_file_map(volume, file, p_data);
+
+		    status = dosfs_volume_unlock(volume, status);
+		}
+	    }
+	}
+    }
+
+    return status;
+}
+
+int f_unmap(const void *data)
+{
+    int status = F_NO_ERROR;
+    dosfs_volume_t *volume;
+    dosfs_device_t *device;
+
+    volume = DOSFS_DEFAULT_VOLUME();
+    device = DOSFS_VOLUME_DEVICE(volume);
+
+    status = dosfs_volume_lock(volume);
+
+    if (status == F_NO_ERROR)
+    {
+	if (!device->interface->unmap)
+	{
+	    status = F_ERR_NOTUSEABLE;
+	}
+	else
+	{
+	    status = (*device->interface->unmap)(device->context, data);
+	}
+
+	status = dosfs_volume_unlock(volume, status);
+    }
+
+    return status;
+}
+
 int f_seek(F_FILE *file, long offset, int whence)
 {
     int status = F_NO_ERROR;
@@ -10866,7 +14399,7 @@ int f_rewind(F_FILE *file)
 
 	    if (status == F_NO_ERROR)
 	    {
-		status = (*device->interface->sync)(device->context, true);
+		status = dosfs_device_sync(device, true);
 
 		if (status == F_NO_ERROR)
 		{
@@ -11090,6 +14623,55 @@ int f_seteof(F_FILE *file)
     return status;
 }
 
+#if (DOSFS_CONFIG_CONTIGUOUS_SUPPORTED == 1)
+/* Reserve a contiguous cluster chain of "size" bytes for an empty file
+ * opened for writing. This is the same as the ",<size>" suffix to f_open(),
+ * just after the fact. Subsequent f_write() calls within "size" only
+ * touch data sectors, the FAT is not updated.
+ */
+int f_reserve(F_FILE *file, long size)
+{
+    int status = F_NO_ERROR;
+    dosfs_volume_t *volume;
+
+    if (!file || !file->mode)
+    {
+        status = F_ERR_NOTOPEN;
+    }
+    else
+    {
+	status = file->status;
+	
+	if (status == F_NO_ERROR)
+	{
+	    if (!(file->mode & DOSFS_FILE_MODE_WRITE))
+	    {
+		status = F_ERR_ACCESSDENIED;
+	    }
+	    else if ((size <= 0) || (file->length != 0) || (file->first_clsno != DOSFS_CLSNO_NONE))
+	    {
+		status = F_ERR_NOTUSEABLE;
+	    }
+	    else
+	    {
+		volume = DOSFS_FILE_VOLUME(file);
+
+		status = dosfs_volume_lock(volume);
+        
+		if (status == F_NO_ERROR)
+		{
+		    status = dosfs_file_reserve(volume, file, (uint32_t)size);
+
+		    status = dosfs_volume_unlock(volume, status);
+		}
+	    }
+	}
+    }
+
+    return status;
+}
+#endif /* (DOSFS_CONFIG_CONTIGUOUS_SUPPORTED == 1) */
+
 F_FILE * f_truncate(const char *filename, long length)
 {
     int status = F_NO_ERROR;
@@ -33,9 +33,51 @@
 
 #include "dosfs_core.h"
 
-dosfs_device_t dosfs_device;
+dosfs_device_t dosfs_device_table[DOSFS_CONFIG_MAX_VOLUMES];
 
-int dosfs_device_format(dosfs_device_t *device, uint8_t *data)
+/* Hand out the device slot for a driver. A driver that initializes again gets its
+ * old slot back, otherwise the first unused one is taken, so that the drive number
+ * follows the order in which the drivers got initialized. The slot is returned with
+ * DOSFS_DEVICE_LOCK_INIT set, which the driver clears when done.
+ */
+dosfs_device_t *dosfs_device_attach(const dosfs_device_interface_t *interface, void *context)
+{
+    dosfs_device_t *device, *device_s, *device_e;
+
+    device = NULL;
+
+    device_s = &dosfs_device_table[0];
+    device_e = &dosfs_device_table[DOSFS_CONFIG_MAX_VOLUMES];
+
+    do
+    {
+	if (device_s->interface == interface)
+	{
+	    device = device_s;
+
+	    break;
+	}
+
+	if (!device && !device_s->interface)
+	{
+	    device = device_s;
+	}
+
+	device_s++;
+    }
+    while (device_s < device_e);
+
+    if (device)
+    {
+	device->lock = DOSFS_DEVICE_LOCK_INIT;
+	device->context = context;
+	device->interface = interface;
+    }
+
+    return device;
+}
+
+int dosfs_device_format(dosfs_device_t *device, uint8_t *data, uint32_t options)
 {
     int status = F_NO_ERROR;
     uint8_t media, write_protected, zero_status;
@@ -219,6 +261,29 @@ int dosfs_device_format(dosfs_device_t *device, uint8_t *data)
 			    blk_unit_size = 128;
 			}
 		    }
+
+		    /* F_FORMAT_STREAMING picks the largest cluster that still leaves a FAT16 (64k at most),
+		     * F_FORMAT_SMALL_FILES the smallest one that still fits (4k at least). F_FORMAT_ALIGN
+		     * replaces the erase unit guess above with the AU the card reports, so that the
+		     * MBR padding and the system area end on an AU boundary.
+		     */
+		    if (options & F_FORMAT_STREAMING)
+		    {
+			for (cls_blk_shift = 7; (cls_blk_shift != 3) && ((blkcnt >> cls_blk_shift) < 8192); cls_blk_shift--)
+			{
+			}
+		    }
+		    else if (options & F_FORMAT_SMALL_FILES)
+		    {
+			for (cls_blk_shift = 3; (cls_blk_shift != 7) && ((blkcnt >> cls_blk_shift) > 65536); cls_blk_shift++)
+			{
+			}
+		    }
+
+		    if ((options & F_FORMAT_ALIGN) && (au_size > blk_unit_size) && !(au_size & (au_size -1)) && (au_size <= (blkcnt / 16)))
+		    {
+			blk_unit_size = au_size;
+		    }
 		}
 
 		/*
@@ -339,7 +404,63 @@ int dosfs_device_format(dosfs_device_t *device, uint8_t *data)
 
 		num_fats = 2;
 
-		if (blkcnt <= 67108864) /* <= 32GB  -> 4MB  */
+		if (options & (F_FORMAT_ALIGN | F_FORMAT_STREAMING | F_FORMAT_SMALL_FILES))
+		{
+		    /* The defaults below are 32k/4MB up to 32GB and 64k/16MB above. F_FORMAT_STREAMING
+		     * uses 64k clusters, F_FORMAT_SMALL_FILES 4k clusters, and F_FORMAT_ALIGN the
+		     * AU the card reports. The system area is then sized like for FAT12/FAT16,
+		     * with at least 9 reserved blocks, backing off to smaller clusters if there
+		     * would be too few for FAT32.
+		     */
+		    if (options & F_FORMAT_STREAMING)
+		    {
+			cls_blk_shift = 7;
+		    }
+		    else if (options & F_FORMAT_SMALL_FILES)
+		    {
+			cls_blk_shift = 3;
+		    }
+		    else
+		    {
+			cls_blk_shift = (blkcnt <= 67108864) ? 6 : 7;
+		    }
+
+		    blk_unit_size = (blkcnt <= 67108864) ? 8192 : 32768;
+
+		    if ((options & F_FORMAT_ALIGN) && (au_size > blk_unit_size) && !(au_size & (au_size -1)) && (au_size <= (blkcnt / 64)))
+		    {
+			blk_unit_size = au_size;
+		    }
+
+		    do
+		    {
+			clscnt = ((blkcnt - 2 * blk_unit_size) & ~(blk_unit_size -1)) >> cls_blk_shift;
+
+			do
+			{
+			    clscnt_e = clscnt;
+
+			    fat_blkcnt = ((clscnt + 2) * 4 + (DOSFS_BLK_SIZE -1)) >> DOSFS_BLK_SHIFT;
+
+			    clus_blkno = blk_unit_size + ((9 + num_fats * fat_blkcnt + (blk_unit_size -1)) & ~(blk_unit_size -1));
+
+			    clscnt = ((blkcnt - clus_blkno) & ~(blk_unit_size -1)) >> cls_blk_shift;
+
+			    if (clscnt > clscnt_e)
+			    {
+				clscnt = clscnt_e;
+			    }
+			}
+			while (clscnt != clscnt_e);
+
+			if (clscnt < 65525)
+			{
+			    cls_blk_shift--;
+			}
+		    }
+		    while ((clscnt < 65525) && (cls_blk_shift != 0));
+		}
+		else if (blkcnt <= 67108864) /* <= 32GB  -> 4MB  */
 		{
 		    cls_blk_shift = 6;
 		    blk_unit_size = 8192;
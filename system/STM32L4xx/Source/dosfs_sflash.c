@@ -31,6 +31,7 @@
 #include "dosfs_sflash.h"
 
 #include <stdio.h>
+#include <stdlib.h>
 
 #if (DOSFS_CONFIG_SFLASH_DEBUG == 1)
 #include <assert.h>
@@ -38,10 +39,10 @@
 
 dosfs_sflash_t dosfs_sflash;
 
-static uint32_t dosfs_sflash_cache[2 * (DOSFS_SFLASH_BLOCK_SIZE / sizeof(uint32_t))];
+static uint32_t dosfs_sflash_cache[2 * (DOSFS_SFLASH_BLOCK_SIZE / sizeof(uint32_t))] __noinit;
 
 #if (DOSFS_CONFIG_SFLASH_DEBUG == 1)
-static uint8_t sflash_data_shadow[DOSFS_SFLASH_DATA_SIZE]; /* 16 MB */
+static uint8_t sflash_data_shadow[DOSFS_SFLASH_DATA_SIZE];
 static uint16_t sflash_xlate_shadow[DOSFS_SFLASH_DATA_SIZE / DOSFS_SFLASH_BLOCK_SIZE];
 #endif /* DOSFS_CONFIG_SFLASH_DEBUG == 1 */
 
@@ -346,17 +347,30 @@ static uint32_t dosfs_sflash_nor_identify(dosfs_sflash_t *sflash)
 		if ((rx_data[2] & 0x20) && !sflash->command_read)
 		{
 		    /* FAST READ 1-4-4
+		     *
+		     * The mode bits are sent in the first mode clocks, and the remaining ones become wait
+		     * states. 8 mode bits take 2 clocks, 16 mode bits 4. With fewer mode plus dummy clocks
+		     * than that, 1-1-4 is used instead.
 		     */
 			  
 		    if (rx_data[8] & 0xe0)
 		    {
-			if ((rx_data[8] & 0xe0) <= 0x40)
+			if (((rx_data[8] & 0xe0) <= 0x40) && (((rx_data[8] & 0x1f) + (rx_data[8] >> 5)) >= 2))
 			{
 			    sflash->command_read = ((((rx_data[8] & 0x1f) + (rx_data[8] >> 5) -2) << QSPI_COMMAND_WAIT_STATES_SHIFT) |
 						    address_bits |
 						    QSPI_COMMAND_DATA_QUAD | QSPI_COMMAND_MODE_QUAD | QSPI_COMMAND_ADDRESS_QUAD | QSPI_COMMAND_INSTRUCTION_SINGLE |
 						    rx_data[9]);
 			}
+			else if (((rx_data[8] & 0xe0) <= 0x80) && (((rx_data[8] & 0x1f) + (rx_data[8] >> 5)) >= 4))
+			{
+			    /* Up to 4 mode clocks are covered by sending 16 mode bits (all 0, i.e. no continuous read).
+			     */
+			    sflash->command_read = ((((rx_data[8] & 0x1f) + (rx_data[8] >> 5) -4) << QSPI_COMMAND_WAIT_STATES_SHIFT) |
+						    address_bits |
+						    QSPI_COMMAND_DATA_QUAD | QSPI_COMMAND_MODE_SIZE_16BIT | QSPI_COMMAND_MODE_QUAD | QSPI_COMMAND_ADDRESS_QUAD | QSPI_COMMAND_INSTRUCTION_SINGLE |
+						    rx_data[9]);
+			}
 		    }
 		    else
 		    {
@@ -515,7 +529,10 @@ static bool dosfs_sflash_nor_erase(dosfs_sflash_t *sflash, uint32_t address)
 
 	stm32l4_qspi_wait(&sflash->qspi, DOSFS_SFLASH_COMMAND_RDFS, 0x000000, &temp[0], 1, 0x80, 0x80, QSPI_CONTROL_ASYNC);
 
-	while (!stm32l4_qspi_done(&sflash->qspi)) { }
+	while (!stm32l4_qspi_done(&sflash->qspi))
+	{
+	    armv7m_core_yield();
+	}
 
 	if (temp[0] & 0x20)
 	{
@@ -532,7 +549,10 @@ static bool dosfs_sflash_nor_erase(dosfs_sflash_t *sflash, uint32_t address)
 
 	stm32l4_qspi_wait(&sflash->qspi, DOSFS_SFLASH_COMMAND_RDSR, 0x000000, &temp[0], 1, 0x01, 0x00, QSPI_CONTROL_ASYNC);
 
-	while (!stm32l4_qspi_done(&sflash->qspi)) { }
+	while (!stm32l4_qspi_done(&sflash->qspi))
+	{
+	    armv7m_core_yield();
+	}
 
 	if (sflash->features & DOSFS_SFLASH_FEATURE_RDSR)
 	{
@@ -587,7 +607,10 @@ static bool dosfs_sflash_nor_write(dosfs_sflash_t *sflash, uint32_t address, uin
 	
 	stm32l4_qspi_wait(&sflash->qspi, DOSFS_SFLASH_COMMAND_RDFS, 0x000000, &temp[0], 1, 0x80, 0x80, QSPI_CONTROL_ASYNC);
 
-	while (!stm32l4_qspi_done(&sflash->qspi)) { }
+	while (!stm32l4_qspi_done(&sflash->qspi))
+	{
+	    armv7m_core_yield();
+	}
 
 	if (temp[0] & 0x10)
 	{
@@ -613,7 +636,10 @@ static bool dosfs_sflash_nor_write(dosfs_sflash_t *sflash, uint32_t address, uin
 
 	stm32l4_qspi_wait(&sflash->qspi, DOSFS_SFLASH_COMMAND_RDSR, 0x000000, &temp[0], 1, 0x01, 0x00, QSPI_CONTROL_ASYNC);
 
-	while (!stm32l4_qspi_done(&sflash->qspi)) { }
+	while (!stm32l4_qspi_done(&sflash->qspi))
+	{
+	    armv7m_core_yield();
+	}
 
 	if (sflash->features & DOSFS_SFLASH_FEATURE_RDSR)
 	{
@@ -635,8 +661,27 @@ static bool dosfs_sflash_nor_write(dosfs_sflash_t *sflash, uint32_t address, uin
     }
 }
 
-static void dosfs_sflash_nor_read(dosfs_sflash_t *sflash, uint32_t address, uint32_t count, uint8_t *data)
+static void dosfs_sflash_nor_read_wait(dosfs_sflash_t *sflash)
 {
+    if (sflash->read_pending)
+    {
+	while (!stm32l4_qspi_done(&sflash->qspi))
+	{
+	    armv7m_core_yield();
+	}
+
+	sflash->read_pending = false;
+    }
+}
+
+/* Issues a read, but does not wait for a DMA transfer to finish. The next
+ * dosfs_sflash_nor_read_start(), dosfs_sflash_nor_read() or
+ * dosfs_sflash_nor_read_wait() completes it.
+ */
+static void dosfs_sflash_nor_read_start(dosfs_sflash_t *sflash, uint32_t address, uint32_t count, uint8_t *data)
+{
+    dosfs_sflash_nor_read_wait(sflash);
+
     if (sflash->address != (address >> 24))
     {
 	sflash->address = (address >> 24);
@@ -651,7 +696,7 @@ static void dosfs_sflash_nor_read(dosfs_sflash_t *sflash, uint32_t address, uint
     {
 	stm32l4_qspi_receive(&sflash->qspi, sflash->command_read, address, data, count, QSPI_CONTROL_ASYNC);    
 
-	while (!stm32l4_qspi_done(&sflash->qspi)) { }
+	sflash->read_pending = true;
     }
     else
     {
@@ -659,6 +704,12 @@ static void dosfs_sflash_nor_read(dosfs_sflash_t *sflash, uint32_t address, uint
     }
 }
 
+static void dosfs_sflash_nor_read(dosfs_sflash_t *sflash, uint32_t address, uint32_t count, uint8_t *data)
+{
+    dosfs_sflash_nor_read_start(sflash, address, count, data);
+    dosfs_sflash_nor_read_wait(sflash);
+}
+
 #else /* (DOSFS_CONFIG_SFLASH_SIMULATE == 0) */
 
 static uint32_t dosfs_sflash_nor_identify(dosfs_sflash_t *sflash)
@@ -731,9 +782,12 @@ static void dosfs_sflash_nor_read(dosfs_sflash_t *sflash, uint32_t address, uint
     }
 }
 
+#define dosfs_sflash_nor_read_start(_sflash, _address, _count, _data) dosfs_sflash_nor_read((_sflash), (_address), (_count), (_data))
+#define dosfs_sflash_nor_read_wait(_sflash) /**/
+
 #endif /* DOSFS_CONFIG_SFLASH_SIMULATE != 0 */
 
-#if (DOSFS_SFLASH_DATA_SIZE == 0x02000000)
+#if (DOSFS_SFLASH_DATA_SIZE > 0x01000000)
 
 static inline uint32_t dosfs_sflash_ftl_sector_lookup(dosfs_sflash_t *sflash, uint32_t index)
 {
@@ -768,7 +822,7 @@ static inline void dosfs_sflash_ftl_sector_assign(dosfs_sflash_t *sflash, uint32
 
 #endif /* DOSFS_SFLASH_DATA_SIZE */
 
-static uint32_t dosfs_sflash_ftl_translate(dosfs_sflash_t *sflash, uint32_t logical)
+static __optimize_speed uint32_t dosfs_sflash_ftl_translate(dosfs_sflash_t *sflash, uint32_t logical)
 {
     return ((dosfs_sflash_ftl_sector_lookup(sflash, (logical >> DOSFS_SFLASH_LOGICAL_SECTOR_SHIFT)) << DOSFS_SFLASH_LOGICAL_SECTOR_SHIFT) + (logical & DOSFS_SFLASH_LOGICAL_BLOCK_MASK)) * DOSFS_SFLASH_BLOCK_SIZE;
 }
@@ -911,10 +965,17 @@ static void dosfs_sflash_ftl_swap(dosfs_sflash_t *sflash, uint32_t victim_offset
     sflash->reclaim_erase_count = victim_erase_count;
 }
 
-static void dosfs_sflash_ftl_reclaim(dosfs_sflash_t *sflash, uint32_t victim_offset)
+/* A reclaim is split into three parts, so that the background reclaim can spread it over
+ * several steps: dosfs_sflash_ftl_reclaim_start() marks the victim, dosfs_sflash_ftl_reclaim_copy()
+ * copies the live blocks to the (uncommitted) reclaim sector, and dosfs_sflash_ftl_reclaim_commit()
+ * writes the reclaim header and erases the victim. Until the commit the victim still holds all
+ * of its data and the mapping is unchanged, so reads can go on in between. Nothing that modifies
+ * the FTL may, which is why any write or discard first completes a reclaim in progress.
+ */
+static void dosfs_sflash_ftl_reclaim_start(dosfs_sflash_t *sflash, uint32_t victim_offset)
 {
-    uint32_t index, victim_sector, victim_delta, victim_erase_count, erase_info[4], n;
-    uint32_t *cache, *data;
+    uint32_t victim_erase_count, erase_info[4];
+    uint32_t *cache;
 
     /* Mark the reclaim erase unit as reclaim type so that upon
      * a crash the data can be recovered.
@@ -924,18 +985,13 @@ static void dosfs_sflash_ftl_reclaim(dosfs_sflash_t *sflash, uint32_t victim_off
      */
 
     cache = sflash->cache[0];
-    data = sflash->cache[1];
 
     sflash->xlate_logical = DOSFS_SFLASH_BLOCK_RESERVED;
     
     dosfs_sflash_nor_read(sflash, victim_offset, DOSFS_SFLASH_BLOCK_SIZE, (uint8_t*)cache);
 
-    victim_sector = cache[0] & DOSFS_SFLASH_INFO_DATA_MASK;
     victim_erase_count = dosfs_sflash_ftl_info_extract(cache, 0);
 
-    // printf("==== RECLAIM ==== %08x (%d=%d (%d)), %d\n", victim_offset, victim_sector, (sflash->victim_delta[victim_sector] + sflash->victim_score[victim_sector]), victim_erase_count, sflash->alloc_free);
-
-    
     /* Mark the victim sector as VICTIM and record the "reclaim_offset" (ERASE -> VICTIM).
      */
     cache[0] = (cache[0] & ~DOSFS_SFLASH_INFO_TYPE_MASK) | DOSFS_SFLASH_INFO_TYPE_VICTIM;
@@ -951,12 +1007,61 @@ static void dosfs_sflash_ftl_reclaim(dosfs_sflash_t *sflash, uint32_t victim_off
     dosfs_sflash_ftl_info_merge(cache, 3, erase_info[3]);
 
     dosfs_sflash_nor_write(sflash, victim_offset, DOSFS_SFLASH_INFO_EXTENDED_TOTAL, (const uint8_t*)cache);
+}
+
+/* Copy up to "count" live blocks of the victim, starting with block "index". Returns the index
+ * to continue with, DOSFS_SFLASH_BLOCK_INFO_ENTRIES once all of them have been copied.
+ */
+static uint32_t dosfs_sflash_ftl_reclaim_copy(dosfs_sflash_t *sflash, uint32_t victim_offset, uint32_t index, uint32_t count)
+{
+    uint32_t *cache, *data;
+
+    cache = sflash->cache[0];
+    data = sflash->cache[1];
+
+    /* In between steps the cache may have been used for xlate/xlate2 lookups.
+     */
+    sflash->xlate_logical = DOSFS_SFLASH_BLOCK_RESERVED;
+    sflash->xlate2_logical = DOSFS_SFLASH_BLOCK_RESERVED;
+
+    dosfs_sflash_nor_read(sflash, victim_offset, DOSFS_SFLASH_BLOCK_SIZE, (uint8_t*)cache);
+
+    for (; (index < DOSFS_SFLASH_BLOCK_INFO_ENTRIES) && count; index++)
+    {
+	if (!(cache[index] & DOSFS_SFLASH_INFO_NOT_WRITTEN_TO) && ((cache[index] & DOSFS_SFLASH_INFO_TYPE_MASK) != DOSFS_SFLASH_INFO_TYPE_DELETED))
+	{
+	    dosfs_sflash_nor_read(sflash, victim_offset + (index * DOSFS_SFLASH_BLOCK_SIZE), DOSFS_SFLASH_BLOCK_SIZE, (uint8_t*)data);
+
+	    dosfs_sflash_nor_write(sflash, sflash->reclaim_offset + (index * DOSFS_SFLASH_BLOCK_SIZE), DOSFS_SFLASH_PAGE_SIZE, (const uint8_t*)data);
+	    dosfs_sflash_nor_write(sflash, sflash->reclaim_offset + (index * DOSFS_SFLASH_BLOCK_SIZE) + DOSFS_SFLASH_PAGE_SIZE, DOSFS_SFLASH_PAGE_SIZE, (const uint8_t*)data + DOSFS_SFLASH_PAGE_SIZE);
+
+	    count--;
+	}
+    }
+
+    return index;
+}
+
+static void dosfs_sflash_ftl_reclaim_commit(dosfs_sflash_t *sflash, uint32_t victim_offset)
+{
+    uint32_t index, victim_sector, victim_delta, victim_erase_count, erase_info[4], n;
+    uint32_t *cache;
+
+    cache = sflash->cache[0];
+
+    sflash->xlate_logical = DOSFS_SFLASH_BLOCK_RESERVED;
+    sflash->xlate2_logical = DOSFS_SFLASH_BLOCK_RESERVED;
+
+    dosfs_sflash_nor_read(sflash, victim_offset, DOSFS_SFLASH_BLOCK_SIZE, (uint8_t*)cache);
+
+    victim_sector = cache[0] & DOSFS_SFLASH_INFO_DATA_MASK;
+    victim_erase_count = dosfs_sflash_ftl_info_extract(cache, 0);
+
+    // printf("==== RECLAIM ==== %08x (%d=%d (%d)), %d\n", victim_offset, victim_sector, (sflash->victim_delta[victim_sector] + sflash->victim_score[victim_sector]), victim_erase_count, sflash->alloc_free);
 
     sflash->alloc_sector = victim_sector;
     
     {
-	sflash->xlate_logical = DOSFS_SFLASH_BLOCK_RESERVED;
-
 	sflash->alloc_count   = 0;
 	sflash->alloc_index   = 0;
 	sflash->alloc_mask[0] = 0;
@@ -964,9 +1069,6 @@ static void dosfs_sflash_ftl_reclaim(dosfs_sflash_t *sflash, uint32_t victim_off
 	sflash->alloc_mask[2] = 0;
 	sflash->alloc_mask[3] = 0;
 
-	/* Here the reclaim sector stays in uncommitted state.
-	 */
-
 	n = 0;
 
 	for (index = 1; index < DOSFS_SFLASH_BLOCK_INFO_ENTRIES; index++)
@@ -998,15 +1100,6 @@ static void dosfs_sflash_ftl_reclaim(dosfs_sflash_t *sflash, uint32_t victim_off
 		    sflash->alloc_count++;
 		    sflash->alloc_free++;
 		}
-		else
-		{
-		    sflash->xlate2_logical = DOSFS_SFLASH_BLOCK_RESERVED;
-
-		    dosfs_sflash_nor_read(sflash, victim_offset + (index * DOSFS_SFLASH_BLOCK_SIZE), DOSFS_SFLASH_BLOCK_SIZE, (uint8_t*)data);
-
-		    dosfs_sflash_nor_write(sflash, sflash->reclaim_offset + (index * DOSFS_SFLASH_BLOCK_SIZE), DOSFS_SFLASH_PAGE_SIZE, (const uint8_t*)data);
-		    dosfs_sflash_nor_write(sflash, sflash->reclaim_offset + (index * DOSFS_SFLASH_BLOCK_SIZE) + DOSFS_SFLASH_PAGE_SIZE, DOSFS_SFLASH_PAGE_SIZE, (const uint8_t*)data + DOSFS_SFLASH_PAGE_SIZE);
-		}
 	    }
 	}
 
@@ -1069,21 +1162,32 @@ static void dosfs_sflash_ftl_reclaim(dosfs_sflash_t *sflash, uint32_t victim_off
     sflash->victim_score[victim_sector] = (sflash->alloc_count ? 0 : DOSFS_SFLASH_VICTIM_ALLOCATED_MASK);
 }
 
+static void dosfs_sflash_ftl_reclaim(dosfs_sflash_t *sflash, uint32_t victim_offset)
+{
+    dosfs_sflash_ftl_reclaim_start(sflash, victim_offset);
+    dosfs_sflash_ftl_reclaim_copy(sflash, victim_offset, 1, DOSFS_SFLASH_BLOCK_INFO_ENTRIES);
+    dosfs_sflash_ftl_reclaim_commit(sflash, victim_offset);
+}
+
 
 static void dosfs_sflash_ftl_format(dosfs_sflash_t *sflash)
 {
     uint32_t offset, erase_count, erase_info[8];
     uint32_t *cache;
 
+#if (DOSFS_CONFIG_SFLASH_SIMULATE == 0)
     stm32l4_gpio_pin_configure(GPIO_PIN_PB2, (GPIO_PUPD_NONE | GPIO_OSPEED_HIGH | GPIO_OTYPE_PUSHPULL | GPIO_MODE_OUTPUT));
     stm32l4_gpio_pin_configure(GPIO_PIN_PA10, (GPIO_PUPD_NONE | GPIO_OSPEED_HIGH | GPIO_OTYPE_PUSHPULL | GPIO_MODE_OUTPUT));
+#endif /* (DOSFS_CONFIG_SFLASH_SIMULATE == 0) */
 
     cache = sflash->cache[0];
 
     for (offset = 0; offset < sflash->data_size; offset += DOSFS_SFLASH_ERASE_SIZE)
     {
+#if (DOSFS_CONFIG_SFLASH_SIMULATE == 0)
 	stm32l4_gpio_pin_write(GPIO_PIN_PB2, !(offset & DOSFS_SFLASH_ERASE_SIZE));
 	stm32l4_gpio_pin_write(GPIO_PIN_PA10, !!(offset & DOSFS_SFLASH_ERASE_SIZE));
+#endif /* (DOSFS_CONFIG_SFLASH_SIMULATE == 0) */
 
 	erase_count = 1;
 
@@ -1131,8 +1235,10 @@ static void dosfs_sflash_ftl_format(dosfs_sflash_t *sflash)
     memset(&sflash_xlate_shadow, 0xff, sizeof(sflash_xlate_shadow));
 #endif /* DOSFS_CONFIG_SFLASH_DEBUG == 1 */
 
+#if (DOSFS_CONFIG_SFLASH_SIMULATE == 0)
     stm32l4_gpio_pin_configure(GPIO_PIN_PB2, (GPIO_PUPD_NONE | GPIO_OSPEED_HIGH | GPIO_OTYPE_PUSHPULL | GPIO_MODE_INPUT));
     stm32l4_gpio_pin_configure(GPIO_PIN_PA10, (GPIO_PUPD_NONE | GPIO_OSPEED_HIGH | GPIO_OTYPE_PUSHPULL | GPIO_MODE_INPUT));
+#endif /* (DOSFS_CONFIG_SFLASH_SIMULATE == 0) */
 }
 
 /* Modify XLATE/XLATE_SECONDARY mappings. Assumption is that XLATE/XLATE_SECONDARY already
@@ -1638,16 +1744,43 @@ static bool dosfs_sflash_ftl_collect(dosfs_sflash_t *sflash, const uint32_t *cac
     return true;
 }
 
+/* Scan xlate_table and xlate2_table for the case where there is a xlate2 entry but
+ * no xlate entry. This can occure while xlate2 is converted to an xlate entry,
+ * which means the xlate2 entry is really an xlate entry.
+ *
+ * Also scan xlate/xlate2 for entries where UNCOMITTED is set, but BLOCK_MASK is not all 1s.
+ * If the block pointed to is DELETED, then also delete it in xlate/xlate2, otherwise
+ * clear the UNCOMITTED bit. This recovers from a crash during a write operation.
+ */
+
+static void dosfs_sflash_ftl_mount_xlate(dosfs_sflash_t *sflash)
+{
+    uint32_t xlate_segment, xlate2_logical;
+
+    for (xlate_segment = 0; xlate_segment < sflash->xlate_count; xlate_segment++)
+    {
+	if ((sflash->xlate_table[xlate_segment] == DOSFS_SFLASH_BLOCK_NOT_ALLOCATED) && (sflash->xlate2_table[xlate_segment] != DOSFS_SFLASH_BLOCK_NOT_ALLOCATED))
+	{
+	    xlate2_logical = sflash->xlate2_table[xlate_segment];
+	    
+	    dosfs_sflash_ftl_info_type(sflash, xlate2_logical, (DOSFS_SFLASH_INFO_EXTENDED_MASK | DOSFS_SFLASH_INFO_TYPE_XLATE | DOSFS_SFLASH_INFO_DATA_MASK));
+	    
+	    sflash->xlate_table[xlate_segment] = xlate2_logical;
+	    sflash->xlate2_table[xlate_segment] = DOSFS_SFLASH_BLOCK_NOT_ALLOCATED;
+	}
+    }
+}
+
 static bool dosfs_sflash_ftl_mount(dosfs_sflash_t *sflash)
 {
-    uint32_t offset, erase_offset, reclaim_offset, victim_offset, victim_sector, victim_erase_count, victim_index, erase_count, erase_count_min, erase_count_max, erase_info[8];
-    uint32_t xlate_segment, xlate2_logical, data_written[2], data_deleted[2];
+    uint32_t offset, erase_offset, reclaim_offset, victim_offset, victim_sector, victim_erase_count, victim_index, victim_delta, erase_count, erase_count_min, erase_count_max, erase_info[8];
+    uint32_t data_written[2], data_deleted[2];
     uint32_t *cache;
 
     // printf("==== MOUNT %d ====\n", sizeof(dosfs_sflash_t));
 
     memset(&sflash->sector_table[0], 0xff, sizeof(sflash->sector_table));
-#if (DOSFS_SFLASH_DATA_SIZE == 0x02000000)
+#if (DOSFS_SFLASH_DATA_SIZE > 0x01000000)
     memset(&sflash->sector_mask[0], 0xff, sizeof(sflash->sector_mask));
 #endif /* DOSFS_SFLASH_DATA_SIZE */
     memset(&sflash->block_table[0], 0xff, sizeof(sflash->block_table));
@@ -1662,6 +1795,11 @@ static bool dosfs_sflash_ftl_mount(dosfs_sflash_t *sflash)
     sflash->reclaim_offset = DOSFS_SFLASH_PHYSICAL_ILLEGAL;
     sflash->reclaim_erase_count = 0xffffffff;
 
+#if (DOSFS_SFLASH_RECLAIM_BACKGROUND == 1)
+    sflash->reclaim_victim = DOSFS_SFLASH_PHYSICAL_ILLEGAL;
+    sflash->reclaim_index = 0;
+#endif /* (DOSFS_SFLASH_RECLAIM_BACKGROUND == 1) */
+
     sflash->alloc_sector = 0;
     sflash->alloc_index = 0;
     sflash->alloc_count = 0;
@@ -1785,11 +1923,56 @@ static bool dosfs_sflash_ftl_mount(dosfs_sflash_t *sflash)
 		
 	    if (erase_count_max < erase_count)
 	    {
+		/* Rebase the wear level deltas collected so far onto the new maximum.
+		 */
+		if (erase_count_max != 0)
+		{
+		    for (victim_index = 0; victim_index < (sflash->data_size / DOSFS_SFLASH_ERASE_SIZE); victim_index++)
+		    {
+			victim_delta = sflash->victim_delta[victim_index] + (erase_count - erase_count_max);
+
+			sflash->victim_delta[victim_index] = (victim_delta > 255) ? 255 : victim_delta;
+		    }
+		}
+
 		erase_count_max = erase_count;
 	    }
+
+	    /* Collect the wear level info while the header is at hand, so that the common
+	     * case (no crash to recover from) does not need a 2nd pass over all erase units.
+	     */
+	    if ((cache[0] & DOSFS_SFLASH_INFO_TYPE_MASK) == DOSFS_SFLASH_INFO_TYPE_ERASE)
+	    {
+		victim_index = cache[0] & DOSFS_SFLASH_INFO_DATA_MASK;
+	    }
+	    else
+	    {
+		victim_index = (sflash->data_size / DOSFS_SFLASH_ERASE_SIZE) -1;
+	    }
+
+	    victim_delta = erase_count_max - erase_count;
+
+	    sflash->victim_delta[victim_index] = (victim_delta > 255) ? 255 : victim_delta;
 	}
     }
 
+    if ((erase_offset == DOSFS_SFLASH_PHYSICAL_ILLEGAL) &&
+	(reclaim_offset == DOSFS_SFLASH_PHYSICAL_ILLEGAL) &&
+	(victim_offset == DOSFS_SFLASH_PHYSICAL_ILLEGAL) &&
+	(data_written[0] == DOSFS_SFLASH_BLOCK_NOT_ALLOCATED) &&
+	(data_deleted[0] == DOSFS_SFLASH_BLOCK_NOT_ALLOCATED))
+    {
+	dosfs_sflash_ftl_mount_xlate(sflash);
+
+	sflash->erase_count_max = erase_count_max;
+
+	sflash->alloc_count = 0;
+    
+	dosfs_sflash_ftl_check(sflash);
+
+	return true;
+    }
+
     /* Check for the case where a crash happened during the reclaim process.
      * In that case, erase the victim and update the wear level info
      */
@@ -1882,27 +2065,7 @@ static bool dosfs_sflash_ftl_mount(dosfs_sflash_t *sflash)
 	}
     }
 
-    /* Scan xlate_table and xlate2_table for the case where there is a xlate2 entry but
-     * no xlate entry. This can occure while xlate2 is converted to an xlate entry,
-     * which means the xlate2 entry is really an xlate entry.
-     *
-     * Also scan xlate/xlate2 for entries where UNCOMITTED is set, but BLOCK_MASK is not all 1s.
-     * If the block pointed to is DELETED, then also delete it in xlate/xlate2, otherwise
-     * clear the UNCOMITTED bit. This recovers from a crash during a write operation.
-     */
-
-    for (xlate_segment = 0; xlate_segment < sflash->xlate_count; xlate_segment++)
-    {
-	if ((sflash->xlate_table[xlate_segment] == DOSFS_SFLASH_BLOCK_NOT_ALLOCATED) && (sflash->xlate2_table[xlate_segment] != DOSFS_SFLASH_BLOCK_NOT_ALLOCATED))
-	{
-	    xlate2_logical = sflash->xlate2_table[xlate_segment];
-	    
-	    dosfs_sflash_ftl_info_type(sflash, xlate2_logical, (DOSFS_SFLASH_INFO_EXTENDED_MASK | DOSFS_SFLASH_INFO_TYPE_XLATE | DOSFS_SFLASH_INFO_DATA_MASK));
-	    
-	    sflash->xlate_table[xlate_segment] = xlate2_logical;
-	    sflash->xlate2_table[xlate_segment] = DOSFS_SFLASH_BLOCK_NOT_ALLOCATED;
-	}
-    }
+    dosfs_sflash_ftl_mount_xlate(sflash);
 
     if (data_written[0] != DOSFS_SFLASH_BLOCK_NOT_ALLOCATED)
     {
@@ -2226,9 +2389,12 @@ static void dosfs_sflash_ftl_write(dosfs_sflash_t *sflash, uint32_t address, con
     }
 }
 
-static void dosfs_sflash_ftl_read(dosfs_sflash_t *sflash, uint32_t address, uint8_t *data)
+/* Returns the physical offset of the data for "address", or DOSFS_SFLASH_PHYSICAL_ILLEGAL if there is none.
+ */
+
+static __optimize_speed uint32_t dosfs_sflash_ftl_lookup(dosfs_sflash_t *sflash, uint32_t address)
 {
-    uint32_t read_logical, read_offset, xlate_segment, xlate_index;
+    uint32_t read_logical, xlate_segment, xlate_index;
     uint16_t *xlate_cache, *xlate2_cache;
 
     DOSFS_SFLASH_STATISTICS_COUNT_N(sflash_ftl_read, 512);
@@ -2298,8 +2464,24 @@ static void dosfs_sflash_ftl_read(dosfs_sflash_t *sflash, uint32_t address, uint
 
     if ((read_logical != DOSFS_SFLASH_BLOCK_NOT_ALLOCATED) && (read_logical != DOSFS_SFLASH_BLOCK_DELETED))
     {
-	read_offset = dosfs_sflash_ftl_translate(sflash, read_logical);
-    
+	return dosfs_sflash_ftl_translate(sflash, read_logical);
+    }
+    else
+    {
+	return DOSFS_SFLASH_PHYSICAL_ILLEGAL;
+    }
+}
+
+#if (DOSFS_CONFIG_SFLASH_DEBUG == 1)
+
+static void dosfs_sflash_ftl_read(dosfs_sflash_t *sflash, uint32_t address, uint8_t *data)
+{
+    uint32_t read_offset;
+
+    read_offset = dosfs_sflash_ftl_lookup(sflash, address);
+
+    if (read_offset != DOSFS_SFLASH_PHYSICAL_ILLEGAL)
+    {
 	dosfs_sflash_nor_read(sflash, read_offset, DOSFS_SFLASH_BLOCK_SIZE, (uint8_t*)data);
     }
     else
@@ -2307,9 +2489,55 @@ static void dosfs_sflash_ftl_read(dosfs_sflash_t *sflash, uint32_t address, uint
 	memset(data, 0xff, DOSFS_SFLASH_BLOCK_SIZE);
     }
 
-#if (DOSFS_CONFIG_SFLASH_DEBUG == 1)
     assert (!memcmp(&sflash_data_shadow[address * 512], data, 512));
+}
+
 #endif /* DOSFS_CONFIG_SFLASH_DEBUG == 1 */
+
+/* Read "length" blocks, merging blocks that happen to be physically consecutive into a single
+ * (DMA) read, so that the command/address/dummy overhead is only paid once per run. The read
+ * of a run is left in flight while the translation of the next run is looked up.
+ */
+
+static __optimize_speed void dosfs_sflash_ftl_read_multiple(dosfs_sflash_t *sflash, uint32_t address, uint8_t *data, uint32_t length)
+{
+    uint32_t read_offset, read_count, next_offset;
+
+    /* Each block is looked up once. The lookup that ends a run is carried over as the start of the next run.
+     */
+    next_offset = dosfs_sflash_ftl_lookup(sflash, address);
+
+    while (length)
+    {
+	read_offset = next_offset;
+	read_count = 0;
+
+	do
+	{
+	    read_count++;
+
+	    next_offset = (read_count < length) ? dosfs_sflash_ftl_lookup(sflash, address + read_count) : DOSFS_SFLASH_PHYSICAL_ILLEGAL;
+	}
+	while ((read_offset != DOSFS_SFLASH_PHYSICAL_ILLEGAL) &&
+	       (read_count < length) &&
+	       (read_count < DOSFS_SFLASH_READ_BLOCKS_MAX) &&
+	       (next_offset == (read_offset + read_count * DOSFS_SFLASH_BLOCK_SIZE)));
+
+	if (read_offset != DOSFS_SFLASH_PHYSICAL_ILLEGAL)
+	{
+	    dosfs_sflash_nor_read_start(sflash, read_offset, read_count * DOSFS_SFLASH_BLOCK_SIZE, data);
+	}
+	else
+	{
+	    memset(data, 0xff, DOSFS_SFLASH_BLOCK_SIZE);
+	}
+
+	address += read_count;
+	data += (read_count * DOSFS_SFLASH_BLOCK_SIZE);
+	length -= read_count;
+    }
+
+    dosfs_sflash_nor_read_wait(sflash);
 }
 
 static void dosfs_sflash_ftl_discard(dosfs_sflash_t *sflash, uint32_t address)
@@ -2410,6 +2638,128 @@ static void dosfs_sflash_ftl_discard(dosfs_sflash_t *sflash, uint32_t address)
     }
 }
 
+#if (DOSFS_SFLASH_RECLAIM_BACKGROUND == 1)
+
+/* The foreground dosfs_sflash_ftl_write() only reclaims once there are no more than 16 free
+ * blocks left. To keep it from ever getting there, erase units are reclaimed from the timer
+ * callback (i.e. PendSV context) once the device has been idle for a while. A reclaim is
+ * spread over several callbacks, so that PendSV is never held up for longer than it takes
+ * to copy DOSFS_CONFIG_SFLASH_RECLAIM_STEP blocks, or to erase one unit: the first step marks
+ * the victim, the following ones copy its live blocks, the last one commits and erases. If the
+ * thread got preempted while it was inside the FTL, the step is simply retried later. Victim
+ * selection is the same as in the foreground, so wear leveling is unchanged.
+ */
+static void dosfs_sflash_reclaim_callback(armv7m_timer_t *timer)
+{
+    dosfs_sflash_t *sflash = (dosfs_sflash_t*)&dosfs_sflash;
+    uint32_t alloc_free;
+
+    if (sflash->state != DOSFS_SFLASH_STATE_READY)
+    {
+	return;
+    }
+
+    if (sflash->busy)
+    {
+	armv7m_timer_start(&sflash->reclaim_timer, DOSFS_CONFIG_SFLASH_RECLAIM_IDLE);
+
+	return;
+    }
+
+#if (DOSFS_SFLASH_MAP_FILES == 1)
+    /* A reclaim could move mapped blocks. The last dosfs_sflash_unmap() reschedules it.
+     */
+    if (sflash->map_count)
+    {
+	return;
+    }
+#endif /* (DOSFS_SFLASH_MAP_FILES == 1) */
+
+    if (sflash->reclaim_victim == DOSFS_SFLASH_PHYSICAL_ILLEGAL)
+    {
+	if (sflash->alloc_free < DOSFS_CONFIG_SFLASH_RECLAIM_WATERMARK)
+	{
+	    stm32l4_qspi_select(&sflash->qspi);
+
+	    sflash->reclaim_victim = dosfs_sflash_ftl_victim(sflash);
+	    sflash->reclaim_index = 1;
+
+	    dosfs_sflash_ftl_reclaim_start(sflash, sflash->reclaim_victim);
+
+	    stm32l4_qspi_unselect(&sflash->qspi);
+
+	    armv7m_timer_start(&sflash->reclaim_timer, 1);
+	}
+    }
+    else if (sflash->reclaim_index < DOSFS_SFLASH_BLOCK_INFO_ENTRIES)
+    {
+	stm32l4_qspi_select(&sflash->qspi);
+
+	sflash->reclaim_index = dosfs_sflash_ftl_reclaim_copy(sflash, sflash->reclaim_victim, sflash->reclaim_index, DOSFS_CONFIG_SFLASH_RECLAIM_STEP);
+
+	stm32l4_qspi_unselect(&sflash->qspi);
+
+	armv7m_timer_start(&sflash->reclaim_timer, 1);
+    }
+    else
+    {
+	alloc_free = sflash->alloc_free;
+
+	stm32l4_qspi_select(&sflash->qspi);
+
+	dosfs_sflash_ftl_reclaim_commit(sflash, sflash->reclaim_victim);
+
+	stm32l4_qspi_unselect(&sflash->qspi);
+
+	sflash->reclaim_victim = DOSFS_SFLASH_PHYSICAL_ILLEGAL;
+
+	/* If the reclaim did not free up any blocks, all that is left is live data. Don't
+	 * keep on erasing till the next write or discard.
+	 */
+	if ((sflash->alloc_free > alloc_free) && (sflash->alloc_free < DOSFS_CONFIG_SFLASH_RECLAIM_WATERMARK))
+	{
+	    armv7m_timer_start(&sflash->reclaim_timer, 1);
+	}
+    }
+}
+
+/* A write or discard changes the FTL state a reclaim in progress was started from, hence it
+ * gets completed first. Called with the QSPI selected.
+ */
+static void dosfs_sflash_reclaim_finish(dosfs_sflash_t *sflash)
+{
+    if (sflash->reclaim_victim != DOSFS_SFLASH_PHYSICAL_ILLEGAL)
+    {
+	dosfs_sflash_ftl_reclaim_copy(sflash, sflash->reclaim_victim, sflash->reclaim_index, DOSFS_SFLASH_BLOCK_INFO_ENTRIES);
+	dosfs_sflash_ftl_reclaim_commit(sflash, sflash->reclaim_victim);
+
+	sflash->reclaim_victim = DOSFS_SFLASH_PHYSICAL_ILLEGAL;
+    }
+}
+
+static void dosfs_sflash_reclaim_schedule(dosfs_sflash_t *sflash)
+{
+    /* Restarting the timer pushes the reclaim out, so it only runs after the device
+     * has been idle for DOSFS_CONFIG_SFLASH_RECLAIM_IDLE ms.
+     */
+    if (sflash->alloc_free < DOSFS_CONFIG_SFLASH_RECLAIM_WATERMARK)
+    {
+	armv7m_timer_start(&sflash->reclaim_timer, DOSFS_CONFIG_SFLASH_RECLAIM_IDLE);
+    }
+}
+
+#else /* (DOSFS_SFLASH_RECLAIM_BACKGROUND == 1) */
+
+static inline void dosfs_sflash_reclaim_schedule(dosfs_sflash_t *sflash)
+{
+}
+
+static inline void dosfs_sflash_reclaim_finish(dosfs_sflash_t *sflash)
+{
+}
+
+#endif /* (DOSFS_SFLASH_RECLAIM_BACKGROUND == 1) */
+
 static int dosfs_sflash_release(void *context)
 {
     int status = F_NO_ERROR;
@@ -2455,6 +2805,10 @@ static int dosfs_sflash_format(void *context)
     printf("SFLASH_FORMAT\n");
 #endif /* (DOSFS_CONFIG_SFLASH_SIMULATE_TRACE == 1) */
 
+#if (DOSFS_SFLASH_RECLAIM_BACKGROUND == 1)
+    sflash->busy = true;
+#endif /* (DOSFS_SFLASH_RECLAIM_BACKGROUND == 1) */
+
     stm32l4_qspi_select(&sflash->qspi);
 
     dosfs_sflash_ftl_format(sflash);
@@ -2472,6 +2826,10 @@ static int dosfs_sflash_format(void *context)
 
     stm32l4_qspi_unselect(&sflash->qspi);
 
+#if (DOSFS_SFLASH_RECLAIM_BACKGROUND == 1)
+    sflash->busy = false;
+#endif /* (DOSFS_SFLASH_RECLAIM_BACKGROUND == 1) */
+
     return status;
 }
 
@@ -2495,8 +2853,14 @@ static int dosfs_sflash_discard(void *context, uint32_t address, uint32_t length
     }
     else
     {
+#if (DOSFS_SFLASH_RECLAIM_BACKGROUND == 1)
+	sflash->busy = true;
+#endif /* (DOSFS_SFLASH_RECLAIM_BACKGROUND == 1) */
+
 	stm32l4_qspi_select(&sflash->qspi);
 
+	dosfs_sflash_reclaim_finish(sflash);
+
 	while (length--)
 	{
 	    dosfs_sflash_ftl_discard(sflash, address);
@@ -2505,6 +2869,12 @@ static int dosfs_sflash_discard(void *context, uint32_t address, uint32_t length
 	}
 
 	stm32l4_qspi_unselect(&sflash->qspi);
+
+#if (DOSFS_SFLASH_RECLAIM_BACKGROUND == 1)
+	sflash->busy = false;
+#endif /* (DOSFS_SFLASH_RECLAIM_BACKGROUND == 1) */
+
+	dosfs_sflash_reclaim_schedule(sflash);
     }
 
     return status;
@@ -2525,16 +2895,29 @@ static int dosfs_sflash_read(void *context, uint32_t address, uint8_t *data, uin
     }
     else
     {
+#if (DOSFS_SFLASH_RECLAIM_BACKGROUND == 1)
+	sflash->busy = true;
+#endif /* (DOSFS_SFLASH_RECLAIM_BACKGROUND == 1) */
+
 	stm32l4_qspi_select(&sflash->qspi);
 
+#if (DOSFS_CONFIG_SFLASH_DEBUG == 1)
 	while (length--)
 	{
 	    dosfs_sflash_ftl_read(sflash, address, data);
 	    
 	    address++;
+	    data += DOSFS_SFLASH_BLOCK_SIZE;
 	}
+#else /* DOSFS_CONFIG_SFLASH_DEBUG == 1 */
+	dosfs_sflash_ftl_read_multiple(sflash, address, data, length);
+#endif /* DOSFS_CONFIG_SFLASH_DEBUG == 1 */
 
 	stm32l4_qspi_unselect(&sflash->qspi);
+
+#if (DOSFS_SFLASH_RECLAIM_BACKGROUND == 1)
+	sflash->busy = false;
+#endif /* (DOSFS_SFLASH_RECLAIM_BACKGROUND == 1) */
     }
 
     return status;
@@ -2555,16 +2938,29 @@ static int dosfs_sflash_write(void *context, uint32_t address, const uint8_t *da
     }
     else
     {
+#if (DOSFS_SFLASH_RECLAIM_BACKGROUND == 1)
+	sflash->busy = true;
+#endif /* (DOSFS_SFLASH_RECLAIM_BACKGROUND == 1) */
+
 	stm32l4_qspi_select(&sflash->qspi);
 
+	dosfs_sflash_reclaim_finish(sflash);
+
 	while (length--)
 	{
 	    dosfs_sflash_ftl_write(sflash, address, data);
 	    
 	    address++;
+	    data += DOSFS_SFLASH_BLOCK_SIZE;
 	}
 
 	stm32l4_qspi_unselect(&sflash->qspi);
+
+#if (DOSFS_SFLASH_RECLAIM_BACKGROUND == 1)
+	sflash->busy = false;
+#endif /* (DOSFS_SFLASH_RECLAIM_BACKGROUND == 1) */
+
+	dosfs_sflash_reclaim_schedule(sflash);
     }
 
     return status;
@@ -2583,6 +2979,193 @@ static int dosfs_sflash_sync(void *context, bool wait)
     return status;
 }
 
+#if (DOSFS_SFLASH_MAPPED == 1)
+
+const void *dosfs_sflash_mapped(uint32_t *p_size)
+{
+    dosfs_sflash_t *sflash = (dosfs_sflash_t*)&dosfs_sflash;
+
+    if (sflash->qspi.map == 0)
+    {
+	return NULL;
+    }
+
+    *p_size = DOSFS_CONFIG_SFLASH_MAPPED_SIZE;
+
+    return (const void*)(QSPI_BASE + sflash->data_size);
+}
+
+int dosfs_sflash_mapped_erase(uint32_t offset)
+{
+    dosfs_sflash_t *sflash = (dosfs_sflash_t*)&dosfs_sflash;
+    int status = F_NO_ERROR;
+
+    if (sflash->qspi.map == 0)
+    {
+	return F_ERR_ONDRIVE;
+    }
+
+    if ((offset & (DOSFS_SFLASH_ERASE_SIZE -1)) || (offset >= DOSFS_CONFIG_SFLASH_MAPPED_SIZE))
+    {
+	return F_ERR_INVALIDSECTOR;
+    }
+
+#if (DOSFS_SFLASH_RECLAIM_BACKGROUND == 1)
+    sflash->busy = true;
+#endif /* (DOSFS_SFLASH_RECLAIM_BACKGROUND == 1) */
+
+    stm32l4_qspi_select(&sflash->qspi);
+
+    if (!dosfs_sflash_nor_erase(sflash, sflash->data_size + offset))
+    {
+	status = F_ERR_WRITE;
+    }
+
+    stm32l4_qspi_unselect(&sflash->qspi);
+
+#if (DOSFS_SFLASH_RECLAIM_BACKGROUND == 1)
+    sflash->busy = false;
+#endif /* (DOSFS_SFLASH_RECLAIM_BACKGROUND == 1) */
+
+    return status;
+}
+
+int dosfs_sflash_mapped_program(uint32_t offset, const uint8_t *data, uint32_t count)
+{
+    dosfs_sflash_t *sflash = (dosfs_sflash_t*)&dosfs_sflash;
+    int status = F_NO_ERROR;
+    uint32_t size;
+
+    if (sflash->qspi.map == 0)
+    {
+	return F_ERR_ONDRIVE;
+    }
+
+    if ((offset > DOSFS_CONFIG_SFLASH_MAPPED_SIZE) || (count > (DOSFS_CONFIG_SFLASH_MAPPED_SIZE - offset)))
+    {
+	return F_ERR_INVALIDSECTOR;
+    }
+
+#if (DOSFS_SFLASH_RECLAIM_BACKGROUND == 1)
+    sflash->busy = true;
+#endif /* (DOSFS_SFLASH_RECLAIM_BACKGROUND == 1) */
+
+    stm32l4_qspi_select(&sflash->qspi);
+
+    while (count)
+    {
+	/* A program operation cannot cross a page boundary.
+	 */
+	size = DOSFS_SFLASH_PAGE_SIZE - (offset & (DOSFS_SFLASH_PAGE_SIZE -1));
+
+	if (size > count)
+	{
+	    size = count;
+	}
+
+	if (!dosfs_sflash_nor_write(sflash, sflash->data_size + offset, size, data))
+	{
+	    status = F_ERR_WRITE;
+
+	    break;
+	}
+
+	offset += size;
+	data += size;
+	count -= size;
+    }
+
+    stm32l4_qspi_unselect(&sflash->qspi);
+
+#if (DOSFS_SFLASH_RECLAIM_BACKGROUND == 1)
+    sflash->busy = false;
+#endif /* (DOSFS_SFLASH_RECLAIM_BACKGROUND == 1) */
+
+    return status;
+}
+
+#endif /* (DOSFS_SFLASH_MAPPED == 1) */
+
+#if (DOSFS_SFLASH_MAP_FILES == 1)
+
+/* Returns a pointer into the memory mapped device for "length" blocks starting at "address", if
+ * the FTL holds all of them in physically consecutive blocks. That is the case if they were
+ * written sequentially into freshly erased space; as block 0 of each erase unit holds its info
+ * entries, a run never covers more than one erase unit.
+ */
+static int dosfs_sflash_map(void *context, uint32_t address, uint32_t length, const void **p_data)
+{
+    dosfs_sflash_t *sflash = (dosfs_sflash_t*)context;
+    int status = F_NO_ERROR;
+    uint32_t offset, index;
+
+    if (sflash->state != DOSFS_SFLASH_STATE_READY)
+    {
+	return F_ERR_ONDRIVE;
+    }
+
+    if ((sflash->qspi.map == 0) || (length == 0) || (length > ((DOSFS_SFLASH_ERASE_SIZE / DOSFS_SFLASH_BLOCK_SIZE) -1)))
+    {
+	return F_ERR_NOTUSEABLE;
+    }
+
+#if (DOSFS_SFLASH_RECLAIM_BACKGROUND == 1)
+    sflash->busy = true;
+#endif /* (DOSFS_SFLASH_RECLAIM_BACKGROUND == 1) */
+
+    stm32l4_qspi_select(&sflash->qspi);
+
+    offset = dosfs_sflash_ftl_lookup(sflash, address);
+
+    for (index = 1; (index < length) && (offset != DOSFS_SFLASH_PHYSICAL_ILLEGAL); index++)
+    {
+	if (dosfs_sflash_ftl_lookup(sflash, address + index) != (offset + index * DOSFS_SFLASH_BLOCK_SIZE))
+	{
+	    offset = DOSFS_SFLASH_PHYSICAL_ILLEGAL;
+	}
+    }
+
+    stm32l4_qspi_unselect(&sflash->qspi);
+
+    if (offset == DOSFS_SFLASH_PHYSICAL_ILLEGAL)
+    {
+	status = F_ERR_NOTUSEABLE;
+    }
+    else
+    {
+	sflash->map_count++;
+
+	*p_data = (const void*)(QSPI_BASE + offset);
+    }
+
+#if (DOSFS_SFLASH_RECLAIM_BACKGROUND == 1)
+    sflash->busy = false;
+#endif /* (DOSFS_SFLASH_RECLAIM_BACKGROUND == 1) */
+
+    return status;
+}
+
+static int dosfs_sflash_unmap(void *context, const void *data)
+{
+    dosfs_sflash_t *sflash = (dosfs_sflash_t*)context;
+
+    if (sflash->map_count == 0)
+    {
+	return F_ERR_NOTUSEABLE;
+    }
+
+    sflash->map_count--;
+
+    if (sflash->map_count == 0)
+    {
+	dosfs_sflash_reclaim_schedule(sflash);
+    }
+
+    return F_NO_ERROR;
+}
+
+#endif /* (DOSFS_SFLASH_MAP_FILES == 1) */
+
 static const dosfs_device_interface_t dosfs_sflash_interface = {
     dosfs_sflash_release,
     dosfs_sflash_info,
@@ -2592,6 +3175,14 @@ static const dosfs_device_interface_t dosfs_sflash_interface = {
     dosfs_sflash_read,
     dosfs_sflash_write,
     dosfs_sflash_sync,
+    NULL,
+#if (DOSFS_SFLASH_MAP_FILES == 1)
+    dosfs_sflash_map,
+    dosfs_sflash_unmap,
+#else /* (DOSFS_SFLASH_MAP_FILES == 1) */
+    NULL,
+    NULL,
+#endif /* (DOSFS_SFLASH_MAP_FILES == 1) */
 };
 
 int dosfs_sflash_init(void)
@@ -2599,15 +3190,39 @@ int dosfs_sflash_init(void)
     dosfs_sflash_t *sflash = (dosfs_sflash_t*)&dosfs_sflash;
     int status = F_NO_ERROR;
     uint8_t data[DOSFS_BLK_SIZE];
+    dosfs_device_t *device;
+
+    device = dosfs_device_attach(&dosfs_sflash_interface, (void*)sflash);
 
-    dosfs_device.lock = DOSFS_DEVICE_LOCK_INIT;
-    dosfs_device.context = (void*)sflash;
-    dosfs_device.interface = &dosfs_sflash_interface;
+    if (!device)
+    {
+	return F_ERR_INITFUNC;
+    }
     
     if (sflash->state == DOSFS_SFLASH_STATE_NONE)
     {
+#if (DOSFS_SFLASH_RECLAIM_BACKGROUND == 1)
+	armv7m_timer_create(&sflash->reclaim_timer, dosfs_sflash_reclaim_callback);
+#endif /* (DOSFS_SFLASH_RECLAIM_BACKGROUND == 1) */
+
 	sflash->data_size = dosfs_sflash_nor_identify(sflash);
 
+#if (DOSFS_SFLASH_MAPPED == 1)
+	if (sflash->data_size <= DOSFS_CONFIG_SFLASH_MAPPED_SIZE)
+	{
+	    sflash->data_size = 0;
+	}
+	else
+	{
+	    sflash->data_size -= DOSFS_CONFIG_SFLASH_MAPPED_SIZE;
+	}
+#endif /* (DOSFS_SFLASH_MAPPED == 1) */
+
+	if (sflash->data_size > DOSFS_SFLASH_DATA_SIZE)
+	{
+	    sflash->data_size = DOSFS_SFLASH_DATA_SIZE;
+	}
+
 	if (sflash->data_size == 0)
 	{
 	    status = F_ERR_INVALIDMEDIA;
@@ -2625,7 +3240,7 @@ int dosfs_sflash_init(void)
 	    {
 		stm32l4_qspi_unselect(&sflash->qspi);
 
-		status = dosfs_device_format(&dosfs_device, data);
+		status = dosfs_device_format(device, data, 0);
 
 		if (status == F_NO_ERROR)
 		{
@@ -2643,11 +3258,20 @@ int dosfs_sflash_init(void)
 		stm32l4_qspi_unselect(&sflash->qspi);
 
 		sflash->state = DOSFS_SFLASH_STATE_READY;
+
+		dosfs_sflash_reclaim_schedule(sflash);
 	    }
+
+#if (DOSFS_SFLASH_MEMORY_MAPPED == 1)
+	    /* From here on every FTL access (select/unselect) suspends/resumes the memory mapped
+	     * mode. The FTL is only ever entered from thread or PendSV context.
+	     */
+	    stm32l4_qspi_map(&sflash->qspi, sflash->command_read);
+#endif /* (DOSFS_SFLASH_MEMORY_MAPPED == 1) */
 	}
     }
 
-    dosfs_device.lock = 0;
+    device->lock = 0;
 
     return status;
 }
@@ -30,18 +30,288 @@
 #include <stdint.h>
 #include <stdbool.h>
 #include <stdio.h>
+#include <string.h>
 
 #include "armv7m.h"
 #include "dosfs_core.h"
 #include "usbd_msc.h"
 
+/* Small SCSI WRITEs (the host's scattered FAT and directory updates) are
+ * copied into a staging area and acknowledged right away. The staging area
+ * is drained from a timer once the host is idle, and on SYNCHRONIZE CACHE,
+ * eject or when it runs full. While staged data is pending the device stays
+ * locked for DOSFS (DOSFS_DEVICE_LOCK_SCSI).
+ */
+
+#define DOSFS_STORAGE_STAGE_NONE 0xffffffff
+
+#if defined(STM32L476xx) || defined(STM32L496xx)
+#define DOSFS_STORAGE_IRQn OTG_FS_IRQn
+#else
+#define DOSFS_STORAGE_IRQn USB_IRQn
+#endif
+
+static uint32_t dosfs_storage_stage_address[DOSFS_CONFIG_STORAGE_STAGE_ENTRIES];
+static uint8_t dosfs_storage_stage_data[DOSFS_CONFIG_STORAGE_STAGE_ENTRIES][DOSFS_BLK_SIZE] __attribute__((aligned(4))) __noinit;
+static volatile uint32_t dosfs_storage_stage_count = 0;
+static armv7m_timer_t dosfs_storage_stage_timer;
+
+static volatile uint8_t dosfs_storage_write_status = F_NO_ERROR;
+static bool dosfs_storage_write_open = false;
+static volatile bool dosfs_storage_active = false;
+
+static bool dosfs_storage_read_last;
+static uint8_t *dosfs_storage_read_data;
+static uint32_t dosfs_storage_read_address;
+static uint32_t dosfs_storage_read_count;
+
+#if (DOSFS_CONFIG_STORAGE_SHARED_SUPPORTED == 1)
+/* With DOSFS_DEVICE_LOCK_SHARED the sketch reads the volume while the host owns
+ * it. Sketch reads run with the USB interrupt masked in between SCSI commands
+ * ("dosfs_storage_shared_busy" holds off the staging timer), and see the staged
+ * data just like the host does. Host writes are collected as a block range,
+ * which DOSFS picks up via dosfs_storage_shared_stale() to invalidate its caches.
+ */
+static volatile bool dosfs_storage_shared_busy = false;
+static bool dosfs_storage_shared_enable;
+static uint32_t dosfs_storage_shared_blkno_s = DOSFS_STORAGE_STAGE_NONE;
+static uint32_t dosfs_storage_shared_blkno_e = 0;
+#endif /* (DOSFS_CONFIG_STORAGE_SHARED_SUPPORTED == 1) */
+
+static void dosfs_storage_release(void)
+{
+    dosfs_storage_active = false;
+
+    if (!dosfs_storage_stage_count)
+    {
+	armv7m_atomic_and(&dosfs_device.lock, ~DOSFS_DEVICE_LOCK_SCSI);
+    }
+}
+
+#if (DOSFS_CONFIG_STORAGE_SHARED_SUPPORTED == 1)
+
+static void dosfs_storage_shared_modify(uint32_t address, uint32_t count)
+{
+    if (dosfs_device.lock & DOSFS_DEVICE_LOCK_SHARED)
+    {
+	if (dosfs_storage_shared_blkno_s > address)
+	{
+	    dosfs_storage_shared_blkno_s = address;
+	}
+
+	if (dosfs_storage_shared_blkno_e < (address + count))
+	{
+	    dosfs_storage_shared_blkno_e = (address + count);
+	}
+
+	armv7m_atomic_or(&dosfs_device.lock, DOSFS_DEVICE_LOCK_STALE);
+    }
+}
+
+#endif /* (DOSFS_CONFIG_STORAGE_SHARED_SUPPORTED == 1) */
+
+static void dosfs_storage_stage_invalidate(uint32_t address, uint32_t count)
+{
+    unsigned int index;
+
+    for (index = 0; index < DOSFS_CONFIG_STORAGE_STAGE_ENTRIES; index++)
+    {
+	if ((dosfs_storage_stage_address[index] != DOSFS_STORAGE_STAGE_NONE) && 
+	    (dosfs_storage_stage_address[index] >= address) &&
+	    (dosfs_storage_stage_address[index] < (address + count)))
+	{
+	    dosfs_storage_stage_address[index] = DOSFS_STORAGE_STAGE_NONE;
+	    dosfs_storage_stage_count--;
+	}
+    }
+}
+
+static void dosfs_storage_stage_overlay(uint8_t *data, uint32_t address, uint32_t count)
+{
+    unsigned int index;
+
+    if (dosfs_storage_stage_count)
+    {
+	for (index = 0; index < DOSFS_CONFIG_STORAGE_STAGE_ENTRIES; index++)
+	{
+	    if ((dosfs_storage_stage_address[index] != DOSFS_STORAGE_STAGE_NONE) && 
+		(dosfs_storage_stage_address[index] >= address) &&
+		(dosfs_storage_stage_address[index] < (address + count)))
+	    {
+		memcpy(data + (dosfs_storage_stage_address[index] - address) * DOSFS_BLK_SIZE, &dosfs_storage_stage_data[index][0], DOSFS_BLK_SIZE);
+	    }
+	}
+    }
+}
+
+static void dosfs_storage_stage_insert(const uint8_t *data, uint32_t address)
+{
+    unsigned int index, entry;
+
+    entry = DOSFS_CONFIG_STORAGE_STAGE_ENTRIES;
+
+    for (index = 0; index < DOSFS_CONFIG_STORAGE_STAGE_ENTRIES; index++)
+    {
+	if (dosfs_storage_stage_address[index] == address)
+	{
+	    entry = index;
+
+	    break;
+	}
+
+	if ((entry == DOSFS_CONFIG_STORAGE_STAGE_ENTRIES) && (dosfs_storage_stage_address[index] == DOSFS_STORAGE_STAGE_NONE))
+	{
+	    entry = index;
+	}
+    }
+
+    if (dosfs_storage_stage_address[entry] != address)
+    {
+	dosfs_storage_stage_address[entry] = address;
+	dosfs_storage_stage_count++;
+    }
+
+    memcpy(&dosfs_storage_stage_data[entry][0], data, DOSFS_BLK_SIZE);
+}
+
+/* Write out all staged blocks in ascending order, so that runs of consecutive
+ * blocks end up in one WRITE_MULTIPLE, and wait for the card to finish.
+ */
+static int dosfs_storage_stage_flush(void)
+{
+    int status = F_NO_ERROR;
+    unsigned int index, entry;
+
+    while (dosfs_storage_stage_count)
+    {
+	entry = DOSFS_CONFIG_STORAGE_STAGE_ENTRIES;
+
+	for (index = 0; index < DOSFS_CONFIG_STORAGE_STAGE_ENTRIES; index++)
+	{
+	    if ((dosfs_storage_stage_address[index] != DOSFS_STORAGE_STAGE_NONE) &&
+		((entry == DOSFS_CONFIG_STORAGE_STAGE_ENTRIES) || (dosfs_storage_stage_address[index] < dosfs_storage_stage_address[entry])))
+	    {
+		entry = index;
+	    }
+	}
+
+	status = (*dosfs_device.interface->write)(dosfs_device.context, dosfs_storage_stage_address[entry], &dosfs_storage_stage_data[entry][0], 1, &dosfs_storage_write_status);
+
+	if (status != F_NO_ERROR)
+	{
+	    break;
+	}
+
+	dosfs_storage_stage_address[entry] = DOSFS_STORAGE_STAGE_NONE;
+	dosfs_storage_stage_count--;
+    }
+
+    if (status == F_NO_ERROR)
+    {
+	status = (*dosfs_device.interface->sync)(dosfs_device.context, true);
+    }
+
+    if ((status == F_NO_ERROR) && (dosfs_storage_write_status != F_NO_ERROR))
+    {
+	status = dosfs_storage_write_status;
+    }
+
+    dosfs_storage_write_status = F_NO_ERROR;
+
+    if (status != F_NO_ERROR)
+    {
+	/* There is no way to report this to the host other than failing the
+	 * command at hand, so the staged data is dropped.
+	 */
+	for (index = 0; index < DOSFS_CONFIG_STORAGE_STAGE_ENTRIES; index++)
+	{
+	    dosfs_storage_stage_address[index] = DOSFS_STORAGE_STAGE_NONE;
+	}
+
+	dosfs_storage_stage_count = 0;
+    }
+
+    return status;
+}
+
+static void dosfs_storage_stage_timeout(armv7m_timer_t *timer)
+{
+#if (DOSFS_CONFIG_STORAGE_SHARED_SUPPORTED == 1)
+    /* PendSV may have preempted a sketch read, which owns the device till
+     * dosfs_storage_shared_leave(). Try again a little later.
+     */
+    if (dosfs_storage_shared_busy)
+    {
+	armv7m_timer_start(&dosfs_storage_stage_timer, 1);
+
+	return;
+    }
+#endif /* (DOSFS_CONFIG_STORAGE_SHARED_SUPPORTED == 1) */
+
+    /* This runs from PendSV, so the USB interrupt (and with it the SCSI command
+     * processing) is blocked while the staging area is drained.
+     */
+    NVIC_DisableIRQ(DOSFS_STORAGE_IRQn);
+
+    if (dosfs_storage_stage_count)
+    {
+	dosfs_storage_stage_flush();
+
+	if (!dosfs_storage_active)
+	{
+	    armv7m_atomic_and(&dosfs_device.lock, ~DOSFS_DEVICE_LOCK_SCSI);
+	}
+    }
+
+    NVIC_EnableIRQ(DOSFS_STORAGE_IRQn);
+}
+
 static int8_t dosfs_storage_init(uint8_t lun)
 {
+    unsigned int index;
+
+    if (!dosfs_storage_stage_timer.callback)
+    {
+	for (index = 0; index < DOSFS_CONFIG_STORAGE_STAGE_ENTRIES; index++)
+	{
+	    dosfs_storage_stage_address[index] = DOSFS_STORAGE_STAGE_NONE;
+	}
+
+	armv7m_timer_create(&dosfs_storage_stage_timer, dosfs_storage_stage_timeout);
+    }
+
     return 0;
 }
 
+static int8_t dosfs_storage_flush(uint8_t lun)
+{
+    int status = F_NO_ERROR;
+
+    armv7m_timer_stop(&dosfs_storage_stage_timer);
+
+    if (dosfs_storage_stage_count)
+    {
+	status = dosfs_storage_stage_flush();
+
+	if (!dosfs_storage_active)
+	{
+	    armv7m_atomic_and(&dosfs_device.lock, ~DOSFS_DEVICE_LOCK_SCSI);
+	}
+    }
+
+    return ((status == F_NO_ERROR) ? 0 : -1);
+}
+
 static int8_t dosfs_storage_deinit(uint8_t lun)
 {
+    if (dosfs_device.interface)
+    {
+	dosfs_storage_flush(lun);
+    }
+
+    dosfs_storage_active = false;
+    dosfs_storage_write_open = false;
+
     dosfs_device.lock &= ~(DOSFS_DEVICE_LOCK_ACCESSED | DOSFS_DEVICE_LOCK_SCSI | DOSFS_DEVICE_LOCK_MEDIUM);
 
     return 0;
@@ -125,6 +395,8 @@ static int8_t dosfs_storage_start_stop_unit(uint8_t lun, uint8_t start, uint8_t
 
     if (!start && loej)
     {
+	dosfs_storage_flush(lun);
+
 	dosfs_device.lock &= ~(DOSFS_DEVICE_LOCK_ACCESSED | DOSFS_DEVICE_LOCK_SCSI | DOSFS_DEVICE_LOCK_MEDIUM);
 	dosfs_device.lock |= DOSFS_DEVICE_LOCK_EJECTED;
     }
@@ -165,6 +437,8 @@ static int8_t dosfs_storage_acquire(uint8_t lun)
     }
     
     dosfs_device.lock |= DOSFS_DEVICE_LOCK_SCSI;
+
+    dosfs_storage_active = true;
     
     return 0;
 }
@@ -173,18 +447,23 @@ static int8_t dosfs_storage_read(uint8_t lun, uint8_t *buf, uint32_t blk_addr, u
 {
     int status;
 
-    status = (*dosfs_device.interface->read)(dosfs_device.context, blk_addr, buf, blk_len, false);
+    /* Hosts read mostly sequentially, so keep the READ_MULTIPLE open for the
+     * next chunk or the next SCSI READ.
+     */
+    status = (*dosfs_device.interface->read)(dosfs_device.context, blk_addr, buf, blk_len, true);
 
     if (status != F_NO_ERROR)
     {
-	dosfs_device.lock &= ~DOSFS_DEVICE_LOCK_SCSI;
+	dosfs_storage_release();
 
 	return -1;
     }
 
+    dosfs_storage_stage_overlay(buf, blk_addr, blk_len);
+
     if (last)
     {
-	dosfs_device.lock &= ~DOSFS_DEVICE_LOCK_SCSI;
+	dosfs_storage_release();
     }
 
     dosfs_device.lock |= DOSFS_DEVICE_LOCK_ACCESSED;
@@ -194,20 +473,75 @@ static int8_t dosfs_storage_read(uint8_t lun, uint8_t *buf, uint32_t blk_addr, u
 
 static int8_t dosfs_storage_write(uint8_t lun, uint8_t *buf, uint32_t blk_addr, uint16_t blk_len, uint8_t last)
 {
-    int status;
+    int status = F_NO_ERROR;
+    uint32_t offset;
+
+    if (last && !dosfs_storage_write_open && (blk_len <= DOSFS_CONFIG_STORAGE_STAGE_ENTRIES))
+    {
+	if ((dosfs_storage_stage_count + blk_len) > DOSFS_CONFIG_STORAGE_STAGE_ENTRIES)
+	{
+	    status = dosfs_storage_stage_flush();
+	}
+
+	if (status == F_NO_ERROR)
+	{
+	    for (offset = 0; offset < blk_len; offset++)
+	    {
+		dosfs_storage_stage_insert(buf + offset * DOSFS_BLK_SIZE, blk_addr + offset);
+	    }
+
+#if (DOSFS_CONFIG_STORAGE_SHARED_SUPPORTED == 1)
+	    dosfs_storage_shared_modify(blk_addr, blk_len);
+#endif /* (DOSFS_CONFIG_STORAGE_SHARED_SUPPORTED == 1) */
 
-    status = (*dosfs_device.interface->write)(dosfs_device.context, blk_addr, buf, blk_len, NULL);
+	    armv7m_timer_start(&dosfs_storage_stage_timer, DOSFS_CONFIG_STORAGE_STAGE_TIMEOUT);
+	}
+    }
+    else
+    {
+	/* Staged data for this range is older than what the host sends now.
+	 */
+	dosfs_storage_stage_invalidate(blk_addr, blk_len);
+
+	dosfs_storage_write_open = !last;
+
+	/* Keep the WRITE_MULTIPLE open across the chunks of a SCSI WRITE, so that they
+	 * get coalesced into one multi-block transfer. At the end only the stop token is
+	 * sent, the card's programming busy overlaps with the next command. Errors the
+	 * card reports at that time end up in "dosfs_storage_write_status" and fail the
+	 * next SCSI WRITE.
+	 */
+	status = (*dosfs_device.interface->write)(dosfs_device.context, blk_addr, buf, blk_len, &dosfs_storage_write_status);
+
+#if (DOSFS_CONFIG_STORAGE_SHARED_SUPPORTED == 1)
+	dosfs_storage_shared_modify(blk_addr, blk_len);
+#endif /* (DOSFS_CONFIG_STORAGE_SHARED_SUPPORTED == 1) */
+
+	if ((status == F_NO_ERROR) && last)
+	{
+	    status = (*dosfs_device.interface->sync)(dosfs_device.context, false);
+	}
+
+	if ((status == F_NO_ERROR) && (dosfs_storage_write_status != F_NO_ERROR))
+	{
+	    status = dosfs_storage_write_status;
+
+	    dosfs_storage_write_status = F_NO_ERROR;
+	}
+    }
 
     if (status != F_NO_ERROR)
     {
-	dosfs_device.lock &= ~DOSFS_DEVICE_LOCK_SCSI;
+	dosfs_storage_write_open = false;
+
+	dosfs_storage_release();
 
 	return -1;
     }
 
     if (last)
     {
-	dosfs_device.lock &= ~DOSFS_DEVICE_LOCK_SCSI;
+	dosfs_storage_release();
     }
 
     dosfs_device.lock |= DOSFS_DEVICE_LOCK_ACCESSED;
@@ -215,6 +549,162 @@ static int8_t dosfs_storage_write(uint8_t lun, uint8_t *buf, uint32_t blk_addr,
     return 0;
 }
 
+static void dosfs_storage_read_callback(void *context, int status)
+{
+    volatile uint8_t *p_status = (volatile uint8_t*)context;
+
+    /* This is called from the DMA interrupt, which preempts the USB interrupt,
+     * hence the atomic updates of "dosfs_device.lock".
+     */
+    if (status != F_NO_ERROR)
+    {
+	dosfs_storage_release();
+
+	*p_status = MSC_PIPE_ERROR;
+    }
+    else
+    {
+	dosfs_storage_stage_overlay(dosfs_storage_read_data, dosfs_storage_read_address, dosfs_storage_read_count);
+
+	if (dosfs_storage_read_last)
+	{
+	    dosfs_storage_release();
+	}
+
+	armv7m_atomic_or(&dosfs_device.lock, DOSFS_DEVICE_LOCK_ACCESSED);
+
+	*p_status = MSC_PIPE_DONE;
+    }
+}
+
+static int8_t dosfs_storage_read_async(uint8_t lun, uint8_t *buf, uint32_t blk_addr, uint16_t blk_len, uint8_t last, volatile uint8_t *p_status)
+{
+    int status;
+
+    if (!dosfs_device.interface->read_async)
+    {
+	return -1;
+    }
+
+    dosfs_storage_read_last = last;
+    dosfs_storage_read_data = buf;
+    dosfs_storage_read_address = blk_addr;
+    dosfs_storage_read_count = blk_len;
+
+    status = (*dosfs_device.interface->read_async)(dosfs_device.context, blk_addr, buf, blk_len, dosfs_storage_read_callback, (void*)p_status);
+
+    if (status != F_NO_ERROR)
+    {
+	/* F_ERR_BUSY (no DMA) just means the caller reads synchronously.
+	 */ 
+	return -1;
+    }
+
+    return 0;
+}
+
+#if (DOSFS_CONFIG_STORAGE_SHARED_SUPPORTED == 1)
+
+static void dosfs_storage_shared_enter(void)
+{
+    uint32_t mask;
+
+    mask = (1ul << ((uint32_t)DOSFS_STORAGE_IRQn & 31));
+
+    while (1)
+    {
+	dosfs_storage_shared_enable = !!(NVIC->ISER[(uint32_t)DOSFS_STORAGE_IRQn >> 5] & mask);
+
+	NVIC_DisableIRQ(DOSFS_STORAGE_IRQn);
+
+	/* A SCSI READ/WRITE owns the device from dosfs_storage_acquire() till
+	 * dosfs_storage_release(), possibly across several USB transfers.
+	 */
+	if (!dosfs_storage_active)
+	{
+	    dosfs_storage_shared_busy = true;
+
+	    break;
+	}
+
+	if (dosfs_storage_shared_enable)
+	{
+	    NVIC_EnableIRQ(DOSFS_STORAGE_IRQn);
+	}
+
+	armv7m_core_yield();
+    }
+}
+
+static void dosfs_storage_shared_leave(void)
+{
+    dosfs_storage_shared_busy = false;
+
+    if (dosfs_storage_shared_enable)
+    {
+	NVIC_EnableIRQ(DOSFS_STORAGE_IRQn);
+    }
+}
+
+int dosfs_storage_shared_read(dosfs_device_t *device, uint32_t address, uint8_t *data, uint32_t length, bool prefetch)
+{
+    int status = F_NO_ERROR;
+
+    dosfs_storage_shared_enter();
+
+    status = (*device->interface->read)(device->context, address, data, length, prefetch);
+
+    if (status == F_NO_ERROR)
+    {
+	dosfs_storage_stage_overlay(data, address, length);
+    }
+
+    dosfs_storage_shared_leave();
+
+    return status;
+}
+
+int dosfs_storage_shared_sync(dosfs_device_t *device, bool wait)
+{
+    int status = F_NO_ERROR;
+
+    dosfs_storage_shared_enter();
+
+    status = (*device->interface->sync)(device->context, wait);
+
+    dosfs_storage_shared_leave();
+
+    return status;
+}
+
+/* Hand the range of blocks the host wrote since the last call to DOSFS, and
+ * clear DOSFS_DEVICE_LOCK_STALE. Returns false if there were no writes.
+ */
+bool dosfs_storage_shared_stale(uint32_t *p_blkno, uint32_t *p_blkcnt)
+{
+    bool stale = false;
+
+    dosfs_storage_shared_enter();
+
+    if (dosfs_device.lock & DOSFS_DEVICE_LOCK_STALE)
+    {
+	armv7m_atomic_and(&dosfs_device.lock, ~DOSFS_DEVICE_LOCK_STALE);
+
+	*p_blkno = dosfs_storage_shared_blkno_s;
+	*p_blkcnt = dosfs_storage_shared_blkno_e - dosfs_storage_shared_blkno_s;
+
+	dosfs_storage_shared_blkno_s = DOSFS_STORAGE_STAGE_NONE;
+	dosfs_storage_shared_blkno_e = 0;
+
+	stale = true;
+    }
+
+    dosfs_storage_shared_leave();
+
+    return stale;
+}
+
+#endif /* (DOSFS_CONFIG_STORAGE_SHARED_SUPPORTED == 1) */
 
 static int8_t dosfs_storage_get_maxlun(void)
 {
@@ -251,6 +741,8 @@ const USBD_StorageTypeDef dosfs_storage_interface =
     dosfs_storage_acquire,
     dosfs_storage_read,
     dosfs_storage_write,
+    dosfs_storage_read_async,
+    dosfs_storage_flush,
     dosfs_storage_get_maxlun,
     dosfs_storage_inquiry_data,
 };
@@ -45,6 +45,14 @@
 #define ADC_SAMPLE_TIME_247_5  6
 #define ADC_SAMPLE_TIME_640_5  7
 
+#define ADC_DMA_OPTION_SCAN		  \
+    (DMA_OPTION_EVENT_TRANSFER_ERROR |	  \
+     DMA_OPTION_PERIPHERAL_TO_MEMORY |	  \
+     DMA_OPTION_PERIPHERAL_DATA_SIZE_16 | \
+     DMA_OPTION_MEMORY_DATA_SIZE_16 |	  \
+     DMA_OPTION_MEMORY_DATA_INCREMENT |	  \
+     DMA_OPTION_PRIORITY_HIGH)
+
 
 typedef struct _stm32l4_adc_driver_t {
     stm32l4_adc_t     *instances[ADC_INSTANCE_COUNT];
@@ -61,6 +69,139 @@ static ADC_TypeDef * const stm32l4_adc_xlate_ADC[ADC_INSTANCE_COUNT] = {
 #endif /* defined(STM32L476xx) || defined(STM32L496xx) */
 };
 
+static const IRQn_Type stm32l4_adc_xlate_IRQn[ADC_INSTANCE_COUNT] = {
+    ADC1_2_IRQn,
+#if defined(STM32L476xx) || defined(STM32L496xx)
+    ADC1_2_IRQn,
+    ADC3_IRQn,
+#endif /* defined(STM32L476xx) || defined(STM32L496xx) */
+};
+
+static const uint8_t stm32l4_adc_xlate_DMA[ADC_INSTANCE_COUNT] = {
+    DMA_CHANNEL_DMA1_CH1_ADC1,
+#if defined(STM32L476xx) || defined(STM32L496xx)
+    DMA_CHANNEL_DMA1_CH2_ADC2,
+    DMA_CHANNEL_DMA1_CH3_ADC3,
+#endif /* defined(STM32L476xx) || defined(STM32L496xx) */
+};
+
+static void stm32l4_adc_dma_callback(stm32l4_adc_t *adc, uint32_t events)
+{
+    if (events & DMA_EVENT_TRANSFER_HALF)
+    {
+	if (adc->events & ADC_EVENT_SCAN_HALF)
+	{
+	    (*adc->callback)(adc->context, ADC_EVENT_SCAN_HALF);
+	}
+    }
+
+    if (events & DMA_EVENT_TRANSFER_DONE)
+    {
+	if (adc->events & ADC_EVENT_SCAN_DONE)
+	{
+	    (*adc->callback)(adc->context, ADC_EVENT_SCAN_DONE);
+	}
+    }
+}
+
+static void stm32l4_adc_interrupt(stm32l4_adc_t *adc)
+{
+    ADC_TypeDef *ADCx = adc->ADCx;
+
+    if ((ADCx->IER & ADC_IER_JEOSIE) && (ADCx->ISR & ADC_ISR_JEOS))
+    {
+	ADCx->ISR = (ADC_ISR_JEOC | ADC_ISR_JEOS);
+
+	if (adc->events & ADC_EVENT_INJECTED)
+	{
+	    (*adc->callback)(adc->context, ADC_EVENT_INJECTED);
+	}
+    }
+
+    if ((ADCx->IER & ADC_IER_AWD1IE) && (ADCx->ISR & ADC_ISR_AWD1))
+    {
+	/* One shot, as the flag gets set again for every conversion outside the window.
+	 */
+	ADCx->IER &= ~ADC_IER_AWD1IE;
+	ADCx->ISR = ADC_ISR_AWD1;
+
+	if (adc->events & ADC_EVENT_WATCHDOG)
+	{
+	    (*adc->callback)(adc->context, ADC_EVENT_WATCHDOG);
+	}
+    }
+}
+
+/* The temperature sensor switch (TSEN) can only be changed with the ADC disabled.
+ */
+static void stm32l4_adc_sensor(stm32l4_adc_t *adc, bool enable)
+{
+    ADC_TypeDef *ADCx = adc->ADCx;
+
+    ADCx->CR |= ADC_CR_ADDIS;
+
+    while (ADCx->CR & ADC_CR_ADEN)
+    {
+    }
+
+#if defined(STM32L476xx) || defined(STM32L496xx)
+    if (enable)
+    {
+	armv7m_atomic_or(&ADC123_COMMON->CCR, ADC_CCR_TSEN);
+    }
+    else
+    {
+	armv7m_atomic_and(&ADC123_COMMON->CCR, ~ADC_CCR_TSEN);
+    }
+#else /* defined(STM32L476xx) || defined(STM32L496xx) */
+    if (enable)
+    {
+	armv7m_atomic_or(&ADC1_COMMON->CCR, ADC_CCR_TSEN);
+    }
+    else
+    {
+	armv7m_atomic_and(&ADC1_COMMON->CCR, ~ADC_CCR_TSEN);
+    }
+#endif /* defined(STM32L476xx) || defined(STM32L496xx) */
+
+    ADCx->ISR = ADC_ISR_ADRDY;
+
+    do
+    {
+	ADCx->CR |= ADC_CR_ADEN;
+    }
+    while (!(ADCx->ISR & ADC_ISR_ADRDY));
+
+    if (enable)
+    {
+	armv7m_core_udelay(120);
+    }
+
+    /* Disabling the ADC stopped the injected group.
+     */
+    if (adc->injected)
+    {
+	ADCx->CR |= ADC_CR_JADSTART;
+    }
+}
+
+/* Sample times for "channel", leaving the other channels alone, as regular
+ * and injected conversions share SMPR1/SMPR2.
+ */
+static void stm32l4_adc_sample(stm32l4_adc_t *adc, unsigned int channel, uint32_t adc_smp)
+{
+    ADC_TypeDef *ADCx = adc->ADCx;
+
+    if (channel < 10)
+    {
+	ADCx->SMPR1 = (ADCx->SMPR1 & ~(7 << (channel * 3))) | (adc_smp << (channel * 3));
+    }
+    else
+    {
+	ADCx->SMPR2 = (ADCx->SMPR2 & ~(7 << ((channel * 3) - 30))) | (adc_smp << ((channel * 3) - 30));
+    }
+}
+
 bool stm32l4_adc_create(stm32l4_adc_t *adc, unsigned int instance, unsigned int priority, unsigned int mode)
 {
     if (instance >= ADC_INSTANCE_COUNT)
@@ -72,12 +213,23 @@ bool stm32l4_adc_create(stm32l4_adc_t *adc, unsigned int instance, unsigned int
     adc->state = ADC_STATE_INIT;
     adc->instance = instance;
     adc->priority = priority;
+    adc->mode = 0;
+    adc->injected = 0;
     adc->callback = NULL;
     adc->context = NULL;
     adc->events = 0;
+    adc->watchdog = 0;
+    adc->threshold = 0;
+
+    if (stm32l4_dma_create(&adc->dma, stm32l4_adc_xlate_DMA[instance], adc->priority))
+    {
+	adc->mode |= ADC_MODE_DMA;
+    }
     
     stm32l4_adc_driver.instances[adc->instance] = adc;
 
+    NVIC_SetPriority(stm32l4_adc_xlate_IRQn[adc->instance], adc->priority);
+
     return true;
 }
 
@@ -88,6 +240,11 @@ bool stm32l4_adc_destroy(stm32l4_adc_t *adc)
 	return false;
     }
 
+    if (adc->mode & ADC_MODE_DMA)
+    {
+	stm32l4_dma_destroy(&adc->dma);
+    }
+
     stm32l4_adc_driver.instances[adc->instance] = NULL;
 
     adc->state = ADC_STATE_NONE;
@@ -156,6 +313,8 @@ bool stm32l4_adc_disable(stm32l4_adc_t *adc)
     adc->events = 0;
     adc->callback = NULL;
     adc->context = NULL;
+    adc->watchdog = 0;
+    adc->threshold = 0;
 
     adc->state = ADC_STATE_INIT;
 
@@ -170,6 +329,11 @@ bool stm32l4_adc_configure(stm32l4_adc_t *adc, uint32_t option)
     {
 	return false;
     }
+
+    if (((option & ADC_OPTION_RATIO_MASK) >> ADC_OPTION_RATIO_SHIFT) > 8)
+    {
+	return false;
+    }
     
     if (adc->state == ADC_STATE_BUSY)
     {
@@ -220,6 +384,20 @@ bool stm32l4_adc_configure(stm32l4_adc_t *adc, uint32_t option)
 	ADCx->CFGR = ADC_CFGR_OVRMOD | ADC_CFGR_JQDIS;
     }
 
+    /* Hardware oversampling: 2^RATIO conversions get accumulated and the sum
+     * shifted right by SHIFT bits.
+     */
+    if (option & ADC_OPTION_RATIO_MASK)
+    {
+	ADCx->CFGR2 = (ADC_CFGR2_ROVSE |
+		       ((((option & ADC_OPTION_RATIO_MASK) >> ADC_OPTION_RATIO_SHIFT) -1) << ADC_CFGR2_OVSR_Pos) |
+		       (((option & ADC_OPTION_SHIFT_MASK) >> ADC_OPTION_SHIFT_SHIFT) << ADC_CFGR2_OVSS_Pos));
+    }
+    else
+    {
+	ADCx->CFGR2 = 0;
+    }
+
     return true;
 }
 
@@ -301,27 +479,7 @@ uint32_t stm32l4_adc_convert(stm32l4_adc_t *adc, unsigned int channel)
     {
 	if (channel == ADC_CHANNEL_ADC1_TS)
 	{
-	    ADCx->CR |= ADC_CR_ADDIS;
-
-	    while (ADCx->CR & ADC_CR_ADEN)
-	    {
-	    }
-	    
-#if defined(STM32L476xx) || defined(STM32L496xx)
-  	    armv7m_atomic_or(&ADC123_COMMON->CCR, ADC_CCR_TSEN);
-#else /* defined(STM32L476xx) || defined(STM32L496xx) */
-  	    armv7m_atomic_or(&ADC1_COMMON->CCR, ADC_CCR_TSEN);
-#endif /* defined(STM32L476xx) || defined(STM32L496xx) */
-
-	    ADCx->ISR = ADC_ISR_ADRDY;
-
-	    do
-	    {
-		ADCx->CR |= ADC_CR_ADEN;
-	    }
-	    while (!(ADCx->ISR & ADC_ISR_ADRDY));
-
-	    armv7m_core_udelay(120);
+	    stm32l4_adc_sensor(adc, true);
 
 	    /* min time is 5us */
 	    adc_smp = ADC_SAMPLE_TIME_247_5;
@@ -342,8 +500,8 @@ uint32_t stm32l4_adc_convert(stm32l4_adc_t *adc, unsigned int channel)
     }
 
     ADCx->SQR1 = (channel << 6);
-    ADCx->SMPR1 = (channel < 10) ? (adc_smp << (channel * 3)) : 0;
-    ADCx->SMPR2 = (channel >= 10) ? (adc_smp << ((channel * 3) - 30)) : 0;
+
+    stm32l4_adc_sample(adc, channel, adc_smp);
 
     ADCx->CR |= ADC_CR_ADSTART;
     
@@ -367,26 +525,311 @@ uint32_t stm32l4_adc_convert(stm32l4_adc_t *adc, unsigned int channel)
 
     if ((adc->instance == ADC_INSTANCE_ADC1) && (channel == ADC_CHANNEL_ADC1_TS))
     {
-	ADCx->CR |= ADC_CR_ADDIS;
+	stm32l4_adc_sensor(adc, false);
+    }
 
-	while (ADCx->CR & ADC_CR_ADEN)
+    return convert;
+}
+
+bool stm32l4_adc_scan(stm32l4_adc_t *adc, const uint8_t *channels, unsigned int count, uint32_t trigger, uint16_t *data, uint16_t size)
+{
+    ADC_TypeDef *ADCx = adc->ADCx;
+    uint32_t adc_sqr[4], adc_smpr[2], adc_smsk[2], adc_smp;
+    unsigned int index, channel, sequence;
+    bool sensor;
+
+    if ((adc->state != ADC_STATE_READY) || !(adc->mode & ADC_MODE_DMA))
+    {
+	return false;
+    }
+
+    /* Each half of "data" has to hold a whole number of scans, so that the callback
+     * always sees complete sequences.
+     */
+    if ((count == 0) || (count > 16) || (size == 0) || (size % (2 * count)))
+    {
+	return false;
+    }
+
+    adc_sqr[0] = (count -1);
+    adc_sqr[1] = 0;
+    adc_sqr[2] = 0;
+    adc_sqr[3] = 0;
+    adc_smpr[0] = 0;
+    adc_smpr[1] = 0;
+    adc_smsk[0] = 0;
+    adc_smsk[1] = 0;
+
+    sensor = false;
+
+    for (index = 0; index < count; index++)
+    {
+	channel = channels[index];
+
+	if (channel > 18)
 	{
+	    return false;
 	}
-	
+
+	sequence = index +1;
+
+	if (sequence < 5)
+	{
+	    adc_sqr[0] |= (channel << (sequence * 6));
+	}
+	else
+	{
+	    adc_sqr[((sequence - 5) / 5) +1] |= (channel << (((sequence - 5) % 5) * 6));
+	}
+
+	/* TS stays switched on while scanning. TS and VBAT need the long sample times
+	 * (5us and 12us).
+	 */
+	adc_smp = ADC_SAMPLE_TIME_47_5;
+
+	if (adc->instance == ADC_INSTANCE_ADC1)
+	{
+	    if (channel == ADC_CHANNEL_ADC1_TS)
+	    {
+		adc_smp = ADC_SAMPLE_TIME_247_5;
+
+		sensor = true;
+	    }
+
+	    if (channel == ADC_CHANNEL_ADC1_VBAT)
+	    {
+		adc_smp = ADC_SAMPLE_TIME_640_5;
+	    }
+	}
+
+	if (channel < 10)
+	{
+	    adc_smpr[0] |= (adc_smp << (channel * 3));
+	    adc_smsk[0] |= (7 << (channel * 3));
+	}
+	else
+	{
+	    adc_smpr[1] |= (adc_smp << ((channel * 3) - 30));
+	    adc_smsk[1] |= (7 << ((channel * 3) - 30));
+	}
+    }
+
+    ADCx->SQR1 = adc_sqr[0];
+    ADCx->SQR2 = adc_sqr[1];
+    ADCx->SQR3 = adc_sqr[2];
+    ADCx->SQR4 = adc_sqr[3];
+    ADCx->SMPR1 = (ADCx->SMPR1 & ~adc_smsk[0]) | adc_smpr[0];
+    ADCx->SMPR2 = (ADCx->SMPR2 & ~adc_smsk[1]) | adc_smpr[1];
+
+    if (sensor)
+    {
+	stm32l4_adc_sensor(adc, true);
+    }
+
+    stm32l4_dma_enable(&adc->dma, (stm32l4_dma_callback_t)stm32l4_adc_dma_callback, adc);
+    stm32l4_dma_start_circular(&adc->dma, (uint32_t)data, (uint32_t)&ADCx->DR, size, ADC_DMA_OPTION_SCAN);
+
+    ADCx->CFGR = (ADC_CFGR_OVRMOD | ADC_CFGR_JQDIS | ADC_CFGR_DMAEN | ADC_CFGR_DMACFG | adc->watchdog |
+		  ((trigger << ADC_CFGR_EXTSEL_Pos) & ADC_CFGR_EXTSEL) | ADC_CFGR_EXTEN_0);
+    ADCx->TR1 = adc->threshold;
+
+    ADCx->ISR = (ADC_ISR_EOC | ADC_ISR_EOS | ADC_ISR_OVR | ADC_ISR_AWD1);
+
+    if (adc->watchdog)
+    {
+	ADCx->IER |= ADC_IER_AWD1IE;
+
+	NVIC_EnableIRQ(stm32l4_adc_xlate_IRQn[adc->instance]);
+    }
+
+    adc->state = ADC_STATE_SCAN;
+
+    ADCx->CR |= ADC_CR_ADSTART;
+
+    return true;
+}
+
+bool stm32l4_adc_stop(stm32l4_adc_t *adc)
+{
+    ADC_TypeDef *ADCx = adc->ADCx;
+
+    if (adc->state != ADC_STATE_SCAN)
+    {
+	return false;
+    }
+
+    ADCx->CR |= ADC_CR_ADSTP;
+
+    while (ADCx->CR & ADC_CR_ADSTP)
+    {
+    }
+
+    stm32l4_dma_stop(&adc->dma);
+    stm32l4_dma_disable(&adc->dma);
+
+    ADCx->IER &= ~ADC_IER_AWD1IE;
+
+    ADCx->CFGR = ADC_CFGR_OVRMOD | ADC_CFGR_JQDIS;
+
+    ADCx->ISR = (ADC_ISR_EOC | ADC_ISR_EOS | ADC_ISR_OVR | ADC_ISR_AWD1);
+
 #if defined(STM32L476xx) || defined(STM32L496xx)
-	armv7m_atomic_and(&ADC123_COMMON->CCR, ~ADC_CCR_TSEN);
+    if ((adc->instance == ADC_INSTANCE_ADC1) && (ADC123_COMMON->CCR & ADC_CCR_TSEN))
 #else /* defined(STM32L476xx) || defined(STM32L496xx) */
-	armv7m_atomic_and(&ADC1_COMMON->CCR, ~ADC_CCR_TSEN);
+    if ((adc->instance == ADC_INSTANCE_ADC1) && (ADC1_COMMON->CCR & ADC_CCR_TSEN))
 #endif /* defined(STM32L476xx) || defined(STM32L496xx) */
+    {
+	stm32l4_adc_sensor(adc, false);
+    }
 
-	ADCx->ISR = ADC_ISR_ADRDY;
+    adc->state = ADC_STATE_READY;
 
-	do
+    return true;
+}
+
+bool stm32l4_adc_inject(stm32l4_adc_t *adc, const uint8_t *channels, unsigned int count, uint32_t trigger)
+{
+    ADC_TypeDef *ADCx = adc->ADCx;
+    uint32_t adc_jsqr;
+    unsigned int index, channel;
+
+    if (((adc->state != ADC_STATE_READY) && (adc->state != ADC_STATE_SCAN)) || adc->injected)
+    {
+	return false;
+    }
+
+    if ((count == 0) || (count > 4))
+    {
+	return false;
+    }
+
+    adc_jsqr = ((count -1) << ADC_JSQR_JL_Pos) |
+	       (((trigger & 15) << ADC_JSQR_JEXTSEL_Pos) & ADC_JSQR_JEXTSEL) |
+	       ((trigger & ADC_INJECTED_TRIGGER_FALLING) ? ADC_JSQR_JEXTEN_1 : ADC_JSQR_JEXTEN_0);
+
+    for (index = 0; index < count; index++)
+    {
+	channel = channels[index];
+
+	if ((channel > 18) || ((adc->instance == ADC_INSTANCE_ADC1) && (channel == ADC_CHANNEL_ADC1_TS)))
 	{
-	    ADCx->CR |= ADC_CR_ADEN;
+	    return false;
 	}
-	while (!(ADCx->ISR & ADC_ISR_ADRDY));
+
+	adc_jsqr |= (channel << (ADC_JSQR_JSQ1_Pos + (index * 6)));
+
+	stm32l4_adc_sample(adc, channel, (((adc->instance == ADC_INSTANCE_ADC1) && (channel == ADC_CHANNEL_ADC1_VBAT)) ? ADC_SAMPLE_TIME_640_5 : ADC_SAMPLE_TIME_47_5));
     }
 
-    return convert;
+    /* JQDIS is set, so JSQR can be written as long as JADSTART is clear.
+     */
+    ADCx->JSQR = adc_jsqr;
+
+    ADCx->ISR = (ADC_ISR_JEOC | ADC_ISR_JEOS);
+    ADCx->IER |= ADC_IER_JEOSIE;
+
+    NVIC_EnableIRQ(stm32l4_adc_xlate_IRQn[adc->instance]);
+
+    adc->injected = count;
+
+    ADCx->CR |= ADC_CR_JADSTART;
+
+    return true;
+}
+
+bool stm32l4_adc_inject_stop(stm32l4_adc_t *adc)
+{
+    ADC_TypeDef *ADCx = adc->ADCx;
+
+    if (!adc->injected)
+    {
+	return false;
+    }
+
+    adc->injected = 0;
+
+    if (ADCx->CR & ADC_CR_JADSTART)
+    {
+	ADCx->CR |= ADC_CR_JADSTP;
+
+	while (ADCx->CR & ADC_CR_JADSTP)
+	{
+	}
+    }
+
+    ADCx->IER &= ~ADC_IER_JEOSIE;
+    ADCx->ISR = (ADC_ISR_JEOC | ADC_ISR_JEOS);
+
+    ADCx->JSQR = 0;
+
+    return true;
 }
+
+uint32_t stm32l4_adc_injected(stm32l4_adc_t *adc, unsigned int index)
+{
+    ADC_TypeDef *ADCx = adc->ADCx;
+
+    switch (index) {
+    case 0:  return ADCx->JDR1;
+    case 1:  return ADCx->JDR2;
+    case 2:  return ADCx->JDR3;
+    case 3:  return ADCx->JDR4;
+    default: return 0;
+    }
+}
+
+bool stm32l4_adc_watchdog(stm32l4_adc_t *adc, unsigned int channel, uint16_t low, uint16_t high)
+{
+    if (adc->state != ADC_STATE_READY)
+    {
+	return false;
+    }
+
+    if (channel > 18)
+    {
+	adc->watchdog = 0;
+	adc->threshold = 0;
+    }
+    else
+    {
+	adc->watchdog = (ADC_CFGR_AWD1EN | ADC_CFGR_AWD1SGL | (channel << ADC_CFGR_AWD1CH_Pos));
+	adc->threshold = ((((uint32_t)high & 0x0fff) << ADC_TR1_HT1_Pos) | ((uint32_t)low & 0x0fff));
+    }
+
+    return true;
+}
+
+#if defined(STM32L476xx) || defined(STM32L496xx)
+
+void ADC1_2_IRQHandler(void)
+{
+    if (stm32l4_adc_driver.instances[ADC_INSTANCE_ADC1])
+    {
+	stm32l4_adc_interrupt(stm32l4_adc_driver.instances[ADC_INSTANCE_ADC1]);
+    }
+
+    if (stm32l4_adc_driver.instances[ADC_INSTANCE_ADC2])
+    {
+	stm32l4_adc_interrupt(stm32l4_adc_driver.instances[ADC_INSTANCE_ADC2]);
+    }
+}
+
+void ADC3_IRQHandler(void)
+{
+    if (stm32l4_adc_driver.instances[ADC_INSTANCE_ADC3])
+    {
+	stm32l4_adc_interrupt(stm32l4_adc_driver.instances[ADC_INSTANCE_ADC3]);
+    }
+}
+
+#else /* defined(STM32L476xx) || defined(STM32L496xx) */
+
+void ADC1_IRQHandler(void)
+{
+    if (stm32l4_adc_driver.instances[ADC_INSTANCE_ADC1])
+    {
+	stm32l4_adc_interrupt(stm32l4_adc_driver.instances[ADC_INSTANCE_ADC1]);
+    }
+}
+
+#endif /* defined(STM32L476xx) || defined(STM32L496xx) */
@@ -0,0 +1,997 @@
+/*
+ * Copyright (c) 2017 Thomas Roell.  All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal with the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ *  1. Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimers.
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimers in the
+ *     documentation and/or other materials provided with the distribution.
+ *  3. Neither the name of Thomas Roell, nor the names of its contributors
+ *     may be used to endorse or promote products derived from this Software
+ *     without specific prior written permission.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ * CONTRIBUTORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * WITH THE SOFTWARE.
+ */
+
+#include <string.h>
+
+#include "stm32l4xx.h"
+
+#include "armv7m.h"
+
+#include "stm32l4_gpio.h"
+#include "stm32l4_can.h"
+#include "stm32l4_system.h"
+
+typedef struct _stm32l4_can_driver_t {
+    stm32l4_can_t      *instances[CAN_INSTANCE_COUNT];
+    bool               notify;
+} stm32l4_can_driver_t;
+
+static stm32l4_can_driver_t stm32l4_can_driver;
+
+#define CAN_INIT_TIMEOUT 0x00100000
+
+#define CAN_IER_RECEIVE  (CAN_IER_FMPIE0 | CAN_IER_FOVIE0 | CAN_IER_FMPIE1 | CAN_IER_FOVIE1)
+
+static CAN_TypeDef * const stm32l4_can_xlate_CAN[] = {
+    CAN1,
+#ifdef CAN2_BASE
+    CAN2,
+#endif
+};
+
+/* TX, RX0, RX1 and SCE are consecutive, so only the TX one is kept.
+ */
+static const IRQn_Type stm32l4_can_xlate_IRQn[] = {
+    CAN1_TX_IRQn,
+#ifdef CAN2_BASE
+    CAN2_TX_IRQn,
+#endif
+};
+
+stm32l4_ct_assert(STM32L4_NELEM(stm32l4_can_xlate_CAN) == CAN_INSTANCE_COUNT);
+stm32l4_ct_assert(STM32L4_NELEM(stm32l4_can_xlate_IRQn) == CAN_INSTANCE_COUNT);
+
+static uint32_t stm32l4_can_btr(uint32_t pclk, uint32_t bitrate)
+{
+    uint32_t brp, tq, ts1, ts2, sjw;
+
+    /* The smallest prescaler gives the most time quanta per bit, and with that
+     * the finest sample point placement.
+     */
+    for (brp = 1; brp <= 1024; brp++)
+    {
+	if (pclk % (brp * bitrate))
+	{
+	    continue;
+	}
+
+	tq = pclk / (brp * bitrate);
+
+	if (tq > 25)
+	{
+	    continue;
+	}
+
+	if (tq < 8)
+	{
+	    break;
+	}
+
+	ts2 = (tq + 4) / 8;
+	ts1 = tq - 1 - ts2;
+
+	if (ts1 > 16)
+	{
+	    ts1 = 16;
+	    ts2 = tq - 1 - ts1;
+	}
+
+	sjw = (ts2 < 4) ? ts2 : 4;
+
+	return (((sjw -1) << 24) | ((ts2 -1) << 20) | ((ts1 -1) << 16) | (brp -1));
+    }
+
+    return 0;
+}
+
+static bool stm32l4_can_init_mode(CAN_TypeDef *CANx, bool enter)
+{
+    uint32_t count;
+
+    if (!enter)
+    {
+	/* Leaving init mode completes after 11 recessive bits on RX, which a bus
+	 * held dominant never delivers. Nothing needs to wait for that though.
+	 */
+	CANx->MCR &= ~CAN_MCR_INRQ;
+
+	return true;
+    }
+
+    CANx->MCR = (CANx->MCR & ~CAN_MCR_SLEEP) | CAN_MCR_INRQ;
+
+    for (count = 0; count < CAN_INIT_TIMEOUT; count++)
+    {
+	if (CANx->MSR & CAN_MSR_INAK)
+	{
+	    return true;
+	}
+    }
+
+    return false;
+}
+
+/* The filter banks live in CAN1, so its clock stays on as long as any instance
+ * is enabled.
+ */
+static void stm32l4_can_clock(stm32l4_can_t *can, bool enable)
+{
+#ifdef CAN2_BASE
+    stm32l4_can_t *other;
+
+    other = stm32l4_can_driver.instances[(can->instance == CAN_INSTANCE_CAN1) ? CAN_INSTANCE_CAN2 : CAN_INSTANCE_CAN1];
+
+    if (enable)
+    {
+	stm32l4_system_periph_enable(SYSTEM_PERIPH_CAN1);
+
+	if (can->instance == CAN_INSTANCE_CAN2)
+	{
+	    stm32l4_system_periph_enable(SYSTEM_PERIPH_CAN2);
+	}
+    }
+    else
+    {
+	if (can->instance == CAN_INSTANCE_CAN2)
+	{
+	    stm32l4_system_periph_disable(SYSTEM_PERIPH_CAN2);
+	}
+
+	if (!other || (other->state != CAN_STATE_READY))
+	{
+	    stm32l4_system_periph_disable(SYSTEM_PERIPH_CAN1);
+	}
+    }
+#else /* CAN2_BASE */
+    if (enable)
+    {
+	stm32l4_system_periph_enable(SYSTEM_PERIPH_CAN1);
+    }
+    else
+    {
+	stm32l4_system_periph_disable(SYSTEM_PERIPH_CAN1);
+    }
+#endif /* CAN2_BASE */
+}
+
+static inline unsigned int stm32l4_can_filter_base(stm32l4_can_t *can)
+{
+    return can->instance * CAN_FILTER_COUNT;
+}
+
+/* The filter match index of a received frame counts the filters assigned to
+ * its FIFO, in bank order and independent of whether a bank is active. Every
+ * bank is 32 bit scale here, so a mask bank has 1 filter and a list bank 2.
+ */
+static void stm32l4_can_filter_map(stm32l4_can_t *can)
+{
+    unsigned int index, bank, fifo, count[2];
+
+    count[0] = 0;
+    count[1] = 0;
+
+    for (index = 0; index < CAN_FILTER_COUNT; index++)
+    {
+	bank = stm32l4_can_filter_base(can) + index;
+	fifo = (CAN1->FFA1R >> bank) & 1;
+
+	can->fmi[fifo][count[fifo]++] = index;
+
+	if (CAN1->FM1R & (1u << bank))
+	{
+	    can->fmi[fifo][count[fifo]++] = index;
+	}
+    }
+}
+
+/* Filter registers use the CAN_TIxR layout: STID in 31:21, or STID/EXID in 31:3
+ * for a 29 bit identifier, IDE in bit 2 and RTR in bit 1.
+ */
+static uint32_t stm32l4_can_id_bits(uint32_t id, bool extended)
+{
+    uint32_t bits;
+
+    if (extended)
+    {
+	bits = (id & CAN_ID_EXTENDED_MASK) << 3;
+    }
+    else
+    {
+	bits = (id & CAN_ID_STANDARD_MASK) << 21;
+    }
+
+    if (id & CAN_ID_EXTENDED)
+    {
+	bits |= CAN_TI0R_IDE;
+    }
+
+    if (id & CAN_ID_REMOTE)
+    {
+	bits |= CAN_TI0R_RTR;
+    }
+
+    return bits;
+}
+
+static bool stm32l4_can_filter_configure(stm32l4_can_t *can, unsigned int index, bool active, bool list, uint32_t fr1, uint32_t fr2, unsigned int fifo)
+{
+    uint32_t mask, basepri;
+
+    if (can->state != CAN_STATE_READY)
+    {
+	return false;
+    }
+
+    if ((index >= CAN_FILTER_COUNT) || (fifo > CAN_FIFO_1))
+    {
+	return false;
+    }
+
+    mask = 1u << (stm32l4_can_filter_base(can) + index);
+
+    basepri = armv7m_critical_enter(CAN_CRITICAL_PRIORITY);
+
+    CAN1->FMR |= CAN_FMR_FINIT;
+
+    CAN1->FA1R &= ~mask;
+
+    if (active)
+    {
+	CAN1->FS1R |= mask;
+
+	if (list)
+	{
+	    CAN1->FM1R |= mask;
+	}
+	else
+	{
+	    CAN1->FM1R &= ~mask;
+	}
+
+	if (fifo == CAN_FIFO_1)
+	{
+	    CAN1->FFA1R |= mask;
+	}
+	else
+	{
+	    CAN1->FFA1R &= ~mask;
+	}
+
+	CAN1->sFilterRegister[stm32l4_can_filter_base(can) + index].FR1 = fr1;
+	CAN1->sFilterRegister[stm32l4_can_filter_base(can) + index].FR2 = fr2;
+
+	CAN1->FA1R |= mask;
+    }
+
+    stm32l4_can_filter_map(can);
+
+    CAN1->FMR &= ~CAN_FMR_FINIT;
+
+    armv7m_critical_leave(basepri);
+
+    return true;
+}
+
+static void stm32l4_can_filter_reset(stm32l4_can_t *can)
+{
+    unsigned int base;
+    uint32_t mask, basepri;
+
+    base = stm32l4_can_filter_base(can);
+    mask = ((1u << CAN_FILTER_COUNT) -1) << base;
+
+    basepri = armv7m_critical_enter(CAN_CRITICAL_PRIORITY);
+
+    CAN1->FMR |= CAN_FMR_FINIT;
+
+#ifdef CAN2_BASE
+    CAN1->FMR = (CAN1->FMR & ~CAN_FMR_CAN2SB) | (CAN_FILTER_COUNT << CAN_FMR_CAN2SB_Pos);
+#endif
+
+    CAN1->FA1R &= ~mask;
+    CAN1->FS1R |= mask;
+    CAN1->FM1R &= ~mask;
+    CAN1->FFA1R &= ~mask;
+
+    /* Bank 0 accepts everything into FIFO 0.
+     */
+    CAN1->sFilterRegister[base].FR1 = 0;
+    CAN1->sFilterRegister[base].FR2 = 0;
+
+    CAN1->FA1R |= (1u << base);
+
+    stm32l4_can_filter_map(can);
+
+    CAN1->FMR &= ~CAN_FMR_FINIT;
+
+    armv7m_critical_leave(basepri);
+}
+
+static void stm32l4_can_mailbox(stm32l4_can_t *can, const stm32l4_can_frame_t *frame)
+{
+    CAN_TypeDef *CANx = can->CANx;
+    CAN_TxMailBox_TypeDef *MAILBOX;
+    uint32_t data[2];
+
+    MAILBOX = &CANx->sTxMailBox[(CANx->TSR & CAN_TSR_CODE) >> CAN_TSR_CODE_Pos];
+
+    memcpy(&data[0], &frame->data[0], 8);
+
+    MAILBOX->TDTR = frame->dlc & 15;
+    MAILBOX->TDLR = data[0];
+    MAILBOX->TDHR = data[1];
+    MAILBOX->TIR = stm32l4_can_id_bits(frame->id, !!(frame->id & CAN_ID_EXTENDED)) | CAN_TI0R_TXRQ;
+}
+
+static void stm32l4_can_notify_callback(void *context, uint32_t events)
+{
+    stm32l4_can_t *can;
+    unsigned int instance;
+    uint32_t btr;
+
+    for (instance = 0; instance < CAN_INSTANCE_COUNT; instance++)
+    {
+	can = stm32l4_can_driver.instances[instance];
+
+	if (can && (can->state == CAN_STATE_READY))
+	{
+	    if (events & SYSTEM_EVENT_PREPARE_CLOCKS)
+	    {
+		stm32l4_can_init_mode(can->CANx, true);
+	    }
+
+	    if (events & SYSTEM_EVENT_CHANGE_CLOCKS)
+	    {
+		/* Without a bit timing for the new PCLK1 the controller stays off the bus.
+		 */
+		btr = stm32l4_can_btr(stm32l4_system_pclk1(), can->bitrate);
+
+		if (btr)
+		{
+		    can->CANx->BTR = (can->CANx->BTR & (CAN_BTR_LBKM | CAN_BTR_SILM)) | btr;
+
+		    stm32l4_can_init_mode(can->CANx, false);
+		}
+	    }
+	}
+    }
+}
+
+static void stm32l4_can_tx_interrupt(stm32l4_can_t *can)
+{
+    CAN_TypeDef *CANx = can->CANx;
+    uint32_t can_tsr, events;
+    unsigned int mailbox, tx_read;
+
+    events = 0;
+
+    can_tsr = CANx->TSR;
+
+    for (mailbox = 0; mailbox < 3; mailbox++)
+    {
+	if (can_tsr & (CAN_TSR_RQCP0 << (8 * mailbox)))
+	{
+	    /* Writing RQCP clears TXOK, ALST and TERR as well.
+	     */
+	    CANx->TSR = (CAN_TSR_RQCP0 << (8 * mailbox));
+
+	    if (can_tsr & (CAN_TSR_TXOK0 << (8 * mailbox)))
+	    {
+		events |= CAN_EVENT_TRANSMIT;
+	    }
+	    else
+	    {
+		events |= CAN_EVENT_TX_ERROR;
+	    }
+	}
+    }
+
+    tx_read = can->tx_read;
+
+    while ((tx_read != can->tx_write) && (CANx->TSR & CAN_TSR_TME))
+    {
+	stm32l4_can_mailbox(can, &can->tx_queue[tx_read]);
+
+	tx_read++;
+
+	if (tx_read == CAN_TX_QUEUE_SIZE)
+	{
+	    tx_read = 0;
+	}
+    }
+
+    can->tx_read = tx_read;
+
+    events &= can->events;
+
+    if (events)
+    {
+	(*can->callback)(can->context, events);
+    }
+}
+
+/* RF1R has the same layout as RF0R.
+ */
+static void stm32l4_can_rx_interrupt(stm32l4_can_t *can, unsigned int fifo)
+{
+    CAN_TypeDef *CANx = can->CANx;
+    CAN_FIFOMailBox_TypeDef *MAILBOX = &CANx->sFIFOMailBox[fifo];
+    volatile uint32_t *RFR = (fifo == CAN_FIFO_1) ? &CANx->RF1R : &CANx->RF0R;
+    stm32l4_can_frame_t *frame;
+    uint32_t can_rir, can_rdtr, data[2], events;
+    unsigned int count, rx_write, rx_next;
+
+    events = 0;
+
+    if (*RFR & CAN_RF0R_FOVR0)
+    {
+	*RFR = CAN_RF0R_FOVR0;
+
+	can->rx_overruns++;
+
+	events |= CAN_EVENT_OVERRUN;
+    }
+
+    for (count = (*RFR & CAN_RF0R_FMP0); count; count--)
+    {
+	rx_write = can->rx_write;
+	rx_next = rx_write +1;
+
+	if (rx_next == can->rx_size)
+	{
+	    rx_next = 0;
+	}
+
+	if (rx_next == can->rx_read)
+	{
+	    can->rx_overruns++;
+
+	    events |= CAN_EVENT_OVERRUN;
+	}
+	else
+	{
+	    frame = &can->rx_data[rx_write];
+
+	    can_rir = MAILBOX->RIR;
+	    can_rdtr = MAILBOX->RDTR;
+	    data[0] = MAILBOX->RDLR;
+	    data[1] = MAILBOX->RDHR;
+
+	    if (can_rir & CAN_RI0R_IDE)
+	    {
+		frame->id = (can_rir >> 3) | CAN_ID_EXTENDED;
+	    }
+	    else
+	    {
+		frame->id = (can_rir >> 21);
+	    }
+
+	    if (can_rir & CAN_RI0R_RTR)
+	    {
+		frame->id |= CAN_ID_REMOTE;
+	    }
+
+	    frame->dlc = (can_rdtr & CAN_RDT0R_DLC);
+	    frame->filter = can->fmi[fifo][(can_rdtr & CAN_RDT0R_FMI) >> CAN_RDT0R_FMI_Pos];
+
+	    memcpy(&frame->data[0], &data[0], 8);
+
+	    __DMB();
+
+	    can->rx_write = rx_next;
+
+	    events |= CAN_EVENT_RECEIVE;
+	}
+
+	*RFR = CAN_RF0R_RFOM0;
+
+	while (*RFR & CAN_RF0R_RFOM0)
+	{
+	}
+    }
+
+    events &= can->events;
+
+    if (events)
+    {
+	(*can->callback)(can->context, events);
+    }
+}
+
+static void stm32l4_can_sce_interrupt(stm32l4_can_t *can)
+{
+    CAN_TypeDef *CANx = can->CANx;
+    uint32_t can_esr, events;
+
+    events = 0;
+
+    CANx->MSR = CAN_MSR_ERRI;
+
+    can_esr = CANx->ESR;
+
+    if (can_esr & CAN_ESR_LEC)
+    {
+	CANx->ESR = 0;
+
+	events |= CAN_EVENT_ERROR;
+    }
+
+    if (can_esr & CAN_ESR_EWGF)
+    {
+	events |= CAN_EVENT_ERROR_WARNING;
+    }
+
+    if (can_esr & CAN_ESR_EPVF)
+    {
+	events |= CAN_EVENT_ERROR_PASSIVE;
+    }
+
+    if (can_esr & CAN_ESR_BOFF)
+    {
+	events |= CAN_EVENT_BUS_OFF;
+    }
+
+    events &= can->events;
+
+    if (events)
+    {
+	(*can->callback)(can->context, events);
+    }
+}
+
+bool stm32l4_can_create(stm32l4_can_t *can, unsigned int instance, const stm32l4_can_pins_t *pins, unsigned int priority)
+{
+    if (instance >= CAN_INSTANCE_COUNT)
+    {
+	return false;
+    }
+
+    if (!stm32l4_can_driver.notify)
+    {
+	if (stm32l4_system_notify(-1, stm32l4_can_notify_callback, NULL, (SYSTEM_EVENT_PREPARE_CLOCKS | SYSTEM_EVENT_CHANGE_CLOCKS)) >= 0)
+	{
+	    stm32l4_can_driver.notify = true;
+	}
+    }
+
+    can->CANx = stm32l4_can_xlate_CAN[instance];
+    can->state = CAN_STATE_INIT;
+    can->instance = instance;
+    can->interrupt = stm32l4_can_xlate_IRQn[instance];
+    can->priority = priority;
+    can->pins = *pins;
+    can->callback = NULL;
+    can->context = NULL;
+    can->events = 0;
+
+    stm32l4_can_driver.instances[instance] = can;
+
+    return true;
+}
+
+bool stm32l4_can_destroy(stm32l4_can_t *can)
+{
+    if (can->state != CAN_STATE_INIT)
+    {
+	return false;
+    }
+
+    stm32l4_can_driver.instances[can->instance] = NULL;
+
+    can->state = CAN_STATE_NONE;
+
+    return true;
+}
+
+bool stm32l4_can_enable(stm32l4_can_t *can, stm32l4_can_frame_t *rx_data, uint16_t rx_size, uint32_t bitrate, uint32_t option, stm32l4_can_callback_t callback, void *context, uint32_t events)
+{
+    CAN_TypeDef *CANx = can->CANx;
+    uint32_t can_mcr, can_btr;
+    unsigned int n;
+
+    if (can->state != CAN_STATE_INIT)
+    {
+	return false;
+    }
+
+    if ((rx_data == NULL) || (rx_size < 2))
+    {
+	return false;
+    }
+
+    if ((bitrate == 0) || (bitrate > 1000000))
+    {
+	return false;
+    }
+
+    can_btr = stm32l4_can_btr(stm32l4_system_pclk1(), bitrate);
+
+    if (!can_btr)
+    {
+	return false;
+    }
+
+    can->rx_data = rx_data;
+    can->rx_size = rx_size;
+    can->rx_read = 0;
+    can->rx_write = 0;
+    can->tx_read = 0;
+    can->tx_write = 0;
+    can->rx_overruns = 0;
+    can->bitrate = bitrate;
+    can->option = option;
+
+    can->state = CAN_STATE_BUSY;
+
+    stm32l4_can_clock(can, true);
+
+    if (!stm32l4_can_init_mode(CANx, true))
+    {
+	stm32l4_can_clock(can, false);
+
+	can->state = CAN_STATE_INIT;
+
+	return false;
+    }
+
+    can_mcr = CAN_MCR_INRQ;
+
+    if (!(option & CAN_OPTION_TX_PRIORITY))
+    {
+	can_mcr |= CAN_MCR_TXFP;
+    }
+
+    if (option & CAN_OPTION_ONE_SHOT)
+    {
+	can_mcr |= CAN_MCR_NART;
+    }
+
+    if (option & CAN_OPTION_AUTO_BUS_OFF)
+    {
+	can_mcr |= CAN_MCR_ABOM;
+    }
+
+    if (option & CAN_OPTION_LOOPBACK)
+    {
+	can_btr |= CAN_BTR_LBKM;
+    }
+
+    if (option & CAN_OPTION_SILENT)
+    {
+	can_btr |= CAN_BTR_SILM;
+    }
+
+    CANx->MCR = can_mcr;
+    CANx->BTR = can_btr;
+
+    if (can->pins.rx != GPIO_PIN_NONE)
+    {
+	stm32l4_gpio_pin_configure(can->pins.rx, (GPIO_PUPD_PULLUP | GPIO_OSPEED_HIGH | GPIO_OTYPE_PUSHPULL | GPIO_MODE_ALTERNATE));
+    }
+
+    if (can->pins.tx != GPIO_PIN_NONE)
+    {
+	stm32l4_gpio_pin_configure(can->pins.tx, (GPIO_PUPD_NONE | GPIO_OSPEED_HIGH | GPIO_OTYPE_PUSHPULL | GPIO_MODE_ALTERNATE));
+    }
+
+    can->state = CAN_STATE_READY;
+
+    stm32l4_can_filter_reset(can);
+
+    stm32l4_can_notify(can, callback, context, events);
+
+    for (n = 0; n < 4; n++)
+    {
+	NVIC_SetPriority((IRQn_Type)(can->interrupt + n), can->priority);
+	NVIC_EnableIRQ((IRQn_Type)(can->interrupt + n));
+    }
+
+    stm32l4_can_init_mode(CANx, false);
+
+    return true;
+}
+
+bool stm32l4_can_disable(stm32l4_can_t *can)
+{
+    CAN_TypeDef *CANx = can->CANx;
+    uint32_t mask;
+    unsigned int n;
+
+    if (can->state != CAN_STATE_READY)
+    {
+	return false;
+    }
+
+    can->events = 0;
+    can->callback = NULL;
+    can->context = NULL;
+
+    CANx->IER = 0;
+
+    for (n = 0; n < 4; n++)
+    {
+	NVIC_DisableIRQ((IRQn_Type)(can->interrupt + n));
+    }
+
+    mask = ((1u << CAN_FILTER_COUNT) -1) << stm32l4_can_filter_base(can);
+
+    CAN1->FMR |= CAN_FMR_FINIT;
+    CAN1->FA1R &= ~mask;
+    CAN1->FMR &= ~CAN_FMR_FINIT;
+
+    /* Master reset, which leaves the controller in sleep mode.
+     */
+    CANx->MCR = CAN_MCR_RESET;
+
+    can->state = CAN_STATE_INIT;
+
+    stm32l4_can_clock(can, false);
+
+    if (can->pins.rx != GPIO_PIN_NONE)
+    {
+	stm32l4_gpio_pin_configure(can->pins.rx, (GPIO_PUPD_NONE | GPIO_MODE_ANALOG));
+    }
+
+    if (can->pins.tx != GPIO_PIN_NONE)
+    {
+	stm32l4_gpio_pin_configure(can->pins.tx, (GPIO_PUPD_NONE | GPIO_MODE_ANALOG));
+    }
+
+    return true;
+}
+
+bool stm32l4_can_notify(stm32l4_can_t *can, stm32l4_can_callback_t callback, void *context, uint32_t events)
+{
+    CAN_TypeDef *CANx = can->CANx;
+    uint32_t can_ier;
+
+    if (can->state != CAN_STATE_READY)
+    {
+	return false;
+    }
+
+    can->events = 0;
+
+    can->callback = callback;
+    can->context = context;
+    can->events = events;
+
+    /* Reception and the TX queue need their interrupts no matter which events
+     * are reported.
+     */
+    can_ier = CAN_IER_TMEIE | CAN_IER_RECEIVE;
+
+    if (events & (CAN_EVENT_ERROR | CAN_EVENT_ERROR_WARNING | CAN_EVENT_ERROR_PASSIVE | CAN_EVENT_BUS_OFF))
+    {
+	can_ier |= CAN_IER_ERRIE;
+
+	if (events & CAN_EVENT_ERROR)
+	{
+	    can_ier |= CAN_IER_LECIE;
+	}
+
+	if (events & CAN_EVENT_ERROR_WARNING)
+	{
+	    can_ier |= CAN_IER_EWGIE;
+	}
+
+	if (events & CAN_EVENT_ERROR_PASSIVE)
+	{
+	    can_ier |= CAN_IER_EPVIE;
+	}
+
+	if (events & CAN_EVENT_BUS_OFF)
+	{
+	    can_ier |= CAN_IER_BOFIE;
+	}
+    }
+
+    CANx->IER = can_ier;
+
+    return true;
+}
+
+bool stm32l4_can_filter_mask(stm32l4_can_t *can, unsigned int index, uint32_t id, uint32_t mask, unsigned int fifo)
+{
+    bool extended = !!(id & CAN_ID_EXTENDED);
+
+    return stm32l4_can_filter_configure(can, index, true, false, stm32l4_can_id_bits(id, extended), stm32l4_can_id_bits(mask, extended), fifo);
+}
+
+bool stm32l4_can_filter_list(stm32l4_can_t *can, unsigned int index, uint32_t id0, uint32_t id1, unsigned int fifo)
+{
+    return stm32l4_can_filter_configure(can, index, true, true, stm32l4_can_id_bits(id0, !!(id0 & CAN_ID_EXTENDED)), stm32l4_can_id_bits(id1, !!(id1 & CAN_ID_EXTENDED)), fifo);
+}
+
+bool stm32l4_can_filter_disable(stm32l4_can_t *can, unsigned int index)
+{
+    return stm32l4_can_filter_configure(can, index, false, false, 0, 0, CAN_FIFO_0);
+}
+
+bool stm32l4_can_receive(stm32l4_can_t *can, stm32l4_can_frame_t *frame)
+{
+    unsigned int rx_read;
+
+    rx_read = can->rx_read;
+
+    if (rx_read == can->rx_write)
+    {
+	return false;
+    }
+
+    *frame = can->rx_data[rx_read];
+
+    rx_read++;
+
+    if (rx_read == can->rx_size)
+    {
+	rx_read = 0;
+    }
+
+    __DMB();
+
+    can->rx_read = rx_read;
+
+    return true;
+}
+
+unsigned int stm32l4_can_count(stm32l4_can_t *can)
+{
+    unsigned int rx_read, rx_write;
+
+    rx_read = can->rx_read;
+    rx_write = can->rx_write;
+
+    return (rx_write >= rx_read) ? (rx_write - rx_read) : ((can->rx_size - rx_read) + rx_write);
+}
+
+bool stm32l4_can_transmit(stm32l4_can_t *can, const stm32l4_can_frame_t *frame)
+{
+    uint32_t basepri;
+    unsigned int tx_next;
+    bool success;
+
+    if (can->state != CAN_STATE_READY)
+    {
+	return false;
+    }
+
+    success = false;
+
+    basepri = armv7m_critical_enter(CAN_CRITICAL_PRIORITY);
+
+    if ((can->tx_read == can->tx_write) && (can->CANx->TSR & CAN_TSR_TME))
+    {
+	stm32l4_can_mailbox(can, frame);
+
+	success = true;
+    }
+    else
+    {
+	tx_next = can->tx_write +1;
+
+	if (tx_next == CAN_TX_QUEUE_SIZE)
+	{
+	    tx_next = 0;
+	}
+
+	if (tx_next != can->tx_read)
+	{
+	    can->tx_queue[can->tx_write] = *frame;
+	    can->tx_write = tx_next;
+
+	    success = true;
+	}
+    }
+
+    armv7m_critical_leave(basepri);
+
+    return success;
+}
+
+void stm32l4_can_abort(stm32l4_can_t *can)
+{
+    uint32_t basepri;
+
+    if (can->state != CAN_STATE_READY)
+    {
+	return;
+    }
+
+    basepri = armv7m_critical_enter(CAN_CRITICAL_PRIORITY);
+
+    can->tx_read = can->tx_write;
+
+    can->CANx->TSR = (CAN_TSR_ABRQ0 | CAN_TSR_ABRQ1 | CAN_TSR_ABRQ2);
+
+    armv7m_critical_leave(basepri);
+}
+
+bool stm32l4_can_done(stm32l4_can_t *can)
+{
+    if (can->state != CAN_STATE_READY)
+    {
+	return true;
+    }
+
+    return ((can->tx_read == can->tx_write) && ((can->CANx->TSR & CAN_TSR_TME) == CAN_TSR_TME));
+}
+
+uint32_t stm32l4_can_status(stm32l4_can_t *can)
+{
+    if (can->state != CAN_STATE_READY)
+    {
+	return 0;
+    }
+
+    return can->CANx->ESR;
+}
+
+void CAN1_TX_IRQHandler(void)
+{
+    stm32l4_can_tx_interrupt(stm32l4_can_driver.instances[CAN_INSTANCE_CAN1]);
+}
+
+void CAN1_RX0_IRQHandler(void)
+{
+    stm32l4_can_rx_interrupt(stm32l4_can_driver.instances[CAN_INSTANCE_CAN1], CAN_FIFO_0);
+}
+
+void CAN1_RX1_IRQHandler(void)
+{
+    stm32l4_can_rx_interrupt(stm32l4_can_driver.instances[CAN_INSTANCE_CAN1], CAN_FIFO_1);
+}
+
+void CAN1_SCE_IRQHandler(void)
+{
+    stm32l4_can_sce_interrupt(stm32l4_can_driver.instances[CAN_INSTANCE_CAN1]);
+}
+
+#ifdef CAN2_BASE
+
+void CAN2_TX_IRQHandler(void)
+{
+    stm32l4_can_tx_interrupt(stm32l4_can_driver.instances[CAN_INSTANCE_CAN2]);
+}
+
+void CAN2_RX0_IRQHandler(void)
+{
+    stm32l4_can_rx_interrupt(stm32l4_can_driver.instances[CAN_INSTANCE_CAN2], CAN_FIFO_0);
+}
+
+void CAN2_RX1_IRQHandler(void)
+{
+    stm32l4_can_rx_interrupt(stm32l4_can_driver.instances[CAN_INSTANCE_CAN2], CAN_FIFO_1);
+}
+
+void CAN2_SCE_IRQHandler(void)
+{
+    stm32l4_can_sce_interrupt(stm32l4_can_driver.instances[CAN_INSTANCE_CAN2]);
+}
+
+#endif /* CAN2_BASE */
@@ -45,18 +45,26 @@ extern int errno;
 extern uint32_t __HeapBase[];
 extern uint32_t __StackLimit[];
 
+/* Current and highest break, for armv7m_core_heap_statistics().
+ */
+void *__HeapCurrent = (void*)(&__HeapBase[0]);
+void *__HeapPeak = (void*)(&__HeapBase[0]);
+
 void * _sbrk (int nbytes)
 {
     void *p;
 
-    static void *__HeapCurrent = (void*)(&__HeapBase[0]);
-
     if (((uint8_t*)__HeapCurrent + nbytes) <= (uint8_t*)(&__StackLimit[0]))
     {
 	p = __HeapCurrent;
 	
 	__HeapCurrent = (void*)((uint8_t*)__HeapCurrent + nbytes);
 
+	if (__HeapPeak < __HeapCurrent)
+	{
+	    __HeapPeak = __HeapCurrent;
+	}
+
 	return p;
     }
     else
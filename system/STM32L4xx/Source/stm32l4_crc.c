@@ -0,0 +1,113 @@
+/*
+ * Copyright (c) 2017 Thomas Roell.  All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal with the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ *  1. Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimers.
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimers in the
+ *     documentation and/or other materials provided with the distribution.
+ *  3. Neither the name of Thomas Roell, nor the names of its contributors
+ *     may be used to endorse or promote products derived from this Software
+ *     without specific prior written permission.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ * CONTRIBUTORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * WITH THE SOFTWARE.
+ */
+
+#include "armv7m.h"
+
+#include "stm32l4xx.h"
+#include "stm32l4_crc.h"
+#include "stm32l4_system.h"
+
+#define CRC_DMA_OPTION_FEED		  \
+    (DMA_OPTION_MEMORY_TO_MEMORY |	  \
+     DMA_OPTION_MEMORY_TO_PERIPHERAL |	  \
+     DMA_OPTION_PERIPHERAL_DATA_SIZE_8 |  \
+     DMA_OPTION_MEMORY_DATA_SIZE_8 |	  \
+     DMA_OPTION_MEMORY_DATA_INCREMENT |	  \
+     DMA_OPTION_EVENT_TRANSFER_DONE |	  \
+     DMA_OPTION_PRIORITY_LOW)
+
+static volatile uint32_t stm32l4_crc_lock = 0;
+
+bool stm32l4_crc_acquire(uint32_t polynom, uint32_t init, uint32_t option)
+{
+    if (armv7m_atomic_exchange(&stm32l4_crc_lock, 1))
+    {
+	return false;
+    }
+
+    stm32l4_system_periph_enable(SYSTEM_PERIPH_CRC);
+
+    CRC->POL = polynom;
+    CRC->INIT = init;
+    CRC->CR = (option & (CRC_CR_POLYSIZE | CRC_CR_REV_IN_0 | CRC_CR_REV_OUT)) | CRC_CR_RESET;
+
+    return true;
+}
+
+void stm32l4_crc_release(void)
+{
+    stm32l4_system_periph_disable(SYSTEM_PERIPH_CRC);
+
+    armv7m_atomic_store(&stm32l4_crc_lock, 0);
+}
+
+void stm32l4_crc_reset(void)
+{
+    CRC->CR |= CRC_CR_RESET;
+}
+
+void __attribute__((optimize("O3"))) stm32l4_crc_update(const uint8_t *data, uint32_t count)
+{
+    const uint8_t *data_e;
+
+    data_e = data + count;
+
+    /* A 32 bit write to DR is processed MSB first, hence aligned words are byte
+     * swapped to keep the byte stream order. With REV_IN set to "bit reversal by
+     * byte", the bytes stay in place, so the byte swap is correct there as well.
+     */
+    while (((uint32_t)data & 3) && (data != data_e))
+    {
+	*((volatile uint8_t*)&CRC->DR) = *data++;
+    }
+
+    while ((uint32_t)(data_e - data) >= 4)
+    {
+	CRC->DR = __REV(*((const uint32_t*)((const void*)data)));
+
+	data += 4;
+    }
+
+    while (data != data_e)
+    {
+	*((volatile uint8_t*)&CRC->DR) = *data++;
+    }
+}
+
+void stm32l4_crc_update_dma(stm32l4_dma_t *dma, const uint8_t *data, uint16_t count)
+{
+    /* Byte sized transfers, as the DMA does not pack/swap, and 32 bit writes of
+     * little endian words would reorder the byte stream.
+     */
+    stm32l4_dma_start(dma, (uint32_t)&CRC->DR, (uint32_t)data, count, CRC_DMA_OPTION_FEED);
+}
+
+uint32_t stm32l4_crc_value(void)
+{
+    return CRC->DR;
+}
@@ -42,6 +42,32 @@ typedef struct _stm32l4_dac_driver_t {
 
 static stm32l4_dac_driver_t stm32l4_dac_driver;
 
+#define DAC_DMA_OPTION_STREAM		  \
+    (DMA_OPTION_MEMORY_TO_PERIPHERAL |	  \
+     DMA_OPTION_PERIPHERAL_DATA_SIZE_16 | \
+     DMA_OPTION_MEMORY_DATA_SIZE_16 |	  \
+     DMA_OPTION_MEMORY_DATA_INCREMENT |	  \
+     DMA_OPTION_PRIORITY_HIGH)
+
+static void stm32l4_dac_dma_callback(stm32l4_dac_t *dac, uint32_t events)
+{
+    if (events & DMA_EVENT_TRANSFER_HALF)
+    {
+	if (dac->events & DAC_EVENT_STREAM_HALF)
+	{
+	    (*dac->callback)(dac->context, DAC_EVENT_STREAM_HALF);
+	}
+    }
+
+    if (events & DMA_EVENT_TRANSFER_DONE)
+    {
+	if (dac->events & DAC_EVENT_STREAM_DONE)
+	{
+	    (*dac->callback)(dac->context, DAC_EVENT_STREAM_DONE);
+	}
+    }
+}
+
 bool stm32l4_dac_create(stm32l4_dac_t *dac, unsigned int instance, unsigned int priority, unsigned int mode)
 {
     if (instance != DAC_INSTANCE_DAC)
@@ -56,6 +82,7 @@ bool stm32l4_dac_create(stm32l4_dac_t *dac, unsigned int instance, unsigned int
     dac->callback = NULL;
     dac->context = NULL;
     dac->events = 0;
+    dac->stream = 0;
     
     stm32l4_dac_driver.instances[dac->instance] = dac;
 
@@ -108,6 +135,8 @@ bool stm32l4_dac_disable(stm32l4_dac_t *dac)
 	return false;
     }
 
+    stm32l4_dac_stop(dac);
+
     DACx->CR &= ~(DAC_CR_EN1
 #ifdef DAC_CR_EN2		  
 		  | DAC_CR_EN2
@@ -167,6 +196,11 @@ bool stm32l4_dac_channel(stm32l4_dac_t *dac, unsigned int channel, uint32_t outp
 	return false;
     }
 
+    if (dac->stream == (channel +1))
+    {
+	stm32l4_dac_stop(dac);
+    }
+
     if (channel == DAC_CHANNEL_1)
     {
 	DACx->CR &= ~(DAC_CR_EN1 | DAC_CR_TEN1 | DAC_CR_WAVE1 | DAC_CR_DMAEN1 | DAC_CR_DMAUDRIE1 | DAC_CR_CEN1);
@@ -321,3 +355,107 @@ bool stm32l4_dac_convert(stm32l4_dac_t *dac, unsigned int channel, uint32_t outp
     
     return true;
 }
+
+static const uint8_t stm32l4_dac_dac1_dma[] = {
+    DMA_CHANNEL_DMA1_CH3_DAC1,
+    DMA_CHANNEL_DMA2_CH4_DAC1,
+    DMA_CHANNEL_NONE,
+};
+
+#ifdef DAC_CR_EN2
+static const uint8_t stm32l4_dac_dac2_dma[] = {
+    DMA_CHANNEL_DMA1_CH4_DAC2,
+    DMA_CHANNEL_DMA2_CH5_DAC2,
+    DMA_CHANNEL_NONE,
+};
+#endif
+
+bool stm32l4_dac_stream(stm32l4_dac_t *dac, unsigned int channel, uint32_t trigger, const uint16_t *data, uint16_t size)
+{
+    DAC_TypeDef *DACx = dac->DACx;
+
+    if ((dac->state != DAC_STATE_READY) || dac->stream || (size < 2) || (size & 1))
+    {
+	return false;
+    }
+
+    /* The DAC DMA channels are shared with other peripherals, so they are only
+     * claimed while a stream is running.
+     */
+    if (channel == DAC_CHANNEL_1)
+    {
+	if (!stm32l4_dma_allocate(&dac->dma, stm32l4_dac_dac1_dma, dac->priority))
+	{
+	    return false;
+	}
+
+	stm32l4_dma_enable(&dac->dma, (stm32l4_dma_callback_t)stm32l4_dac_dma_callback, dac);
+	stm32l4_dma_start_circular(&dac->dma, (uint32_t)&DACx->DHR12R1, (uint32_t)data, size, DAC_DMA_OPTION_STREAM);
+
+	/* TSEL1/TEN1 can only be changed while the channel is disabled.
+	 */
+	DACx->CR &= ~(DAC_CR_EN1 | DAC_CR_TSEL1 | DAC_CR_WAVE1);
+	DACx->CR |= (((trigger << DAC_CR_TSEL1_Pos) & DAC_CR_TSEL1) | DAC_CR_TEN1 | DAC_CR_DMAEN1);
+	DACx->CR |= DAC_CR_EN1;
+    }
+#ifdef DAC_CR_EN2
+    else
+    {
+	if (!stm32l4_dma_allocate(&dac->dma, stm32l4_dac_dac2_dma, dac->priority))
+	{
+	    return false;
+	}
+
+	stm32l4_dma_enable(&dac->dma, (stm32l4_dma_callback_t)stm32l4_dac_dma_callback, dac);
+	stm32l4_dma_start_circular(&dac->dma, (uint32_t)&DACx->DHR12R2, (uint32_t)data, size, DAC_DMA_OPTION_STREAM);
+
+	DACx->CR &= ~(DAC_CR_EN2 | DAC_CR_TSEL2 | DAC_CR_WAVE2);
+	DACx->CR |= (((trigger << DAC_CR_TSEL2_Pos) & DAC_CR_TSEL2) | DAC_CR_TEN2 | DAC_CR_DMAEN2);
+	DACx->CR |= DAC_CR_EN2;
+    }
+#else
+    else
+    {
+	return false;
+    }
+#endif
+
+    dac->stream = channel +1;
+
+    return true;
+}
+
+bool stm32l4_dac_stop(stm32l4_dac_t *dac)
+{
+    DAC_TypeDef *DACx = dac->DACx;
+
+    if (!dac->stream)
+    {
+	return false;
+    }
+
+    if (dac->stream == (DAC_CHANNEL_1 +1))
+    {
+	DACx->CR &= ~DAC_CR_DMAEN1;
+	DACx->CR &= ~DAC_CR_EN1;
+	DACx->CR &= ~(DAC_CR_TEN1 | DAC_CR_TSEL1);
+	DACx->CR |= DAC_CR_EN1;
+    }
+#ifdef DAC_CR_EN2
+    else
+    {
+	DACx->CR &= ~DAC_CR_DMAEN2;
+	DACx->CR &= ~DAC_CR_EN2;
+	DACx->CR &= ~(DAC_CR_TEN2 | DAC_CR_TSEL2);
+	DACx->CR |= DAC_CR_EN2;
+    }
+#endif
+
+    stm32l4_dma_stop(&dac->dma);
+    stm32l4_dma_disable(&dac->dma);
+    stm32l4_dma_destroy(&dac->dma);
+
+    dac->stream = 0;
+
+    return true;
+}
@@ -0,0 +1,452 @@
+/*
+ * Copyright (c) 2017 Thomas Roell.  All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal with the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ *  1. Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimers.
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimers in the
+ *     documentation and/or other materials provided with the distribution.
+ *  3. Neither the name of Thomas Roell, nor the names of its contributors
+ *     may be used to endorse or promote products derived from this Software
+ *     without specific prior written permission.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ * CONTRIBUTORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * WITH THE SOFTWARE.
+ */
+
+
+#include <stdio.h>
+
+#include "stm32l4xx.h"
+
+#include "armv7m.h"
+
+#include "stm32l4_gpio.h"
+#include "stm32l4_dfsdm.h"
+#include "stm32l4_dma.h"
+#include "stm32l4_system.h"
+
+#if defined(STM32L452xx) || defined(STM32L476xx) || defined(STM32L496xx)
+
+#if defined(STM32L452xx)
+#define DFSDM_CHANNEL_COUNT 4
+#else /* defined(STM32L452xx) */
+#define DFSDM_CHANNEL_COUNT 8
+#endif /* defined(STM32L452xx) */
+
+typedef struct _stm32l4_dfsdm_driver_t {
+    stm32l4_dfsdm_t   *instances[DFSDM_INSTANCE_COUNT];
+    uint8_t           enables;      /* enabled filter instances */
+    uint8_t           channels;     /* channels in use by enabled instances */
+    uint16_t          divider;      /* CKOUT divider, shared by all instances */
+} stm32l4_dfsdm_driver_t;
+
+static stm32l4_dfsdm_driver_t stm32l4_dfsdm_driver;
+
+static DFSDM_Filter_TypeDef * const stm32l4_dfsdm_xlate_FLT[DFSDM_INSTANCE_COUNT] = {
+    DFSDM1_Filter0,
+    DFSDM1_Filter1,
+#if defined(STM32L476xx) || defined(STM32L496xx)
+    DFSDM1_Filter2,
+    DFSDM1_Filter3,
+#endif /* defined(STM32L476xx) || defined(STM32L496xx) */
+};
+
+static const uint8_t stm32l4_dfsdm_xlate_DMA[DFSDM_INSTANCE_COUNT] = {
+#if defined(STM32L452xx)
+    DMA_CHANNEL_DMA1_CH5_DFSDM1_FLT0,
+    DMA_CHANNEL_DMA1_CH6_DFSDM1_FLT1,
+#else /* defined(STM32L452xx) */
+    DMA_CHANNEL_DMA1_CH4_DFSDM1_FLT0,
+    DMA_CHANNEL_DMA1_CH5_DFSDM1_FLT1,
+    DMA_CHANNEL_DMA1_CH6_DFSDM1_FLT2,
+    DMA_CHANNEL_DMA1_CH7_DFSDM1_FLT3,
+#endif /* defined(STM32L452xx) */
+};
+
+#define DFSDM_DMA_OPTION_RECEIVE	  \
+    (DMA_OPTION_EVENT_TRANSFER_DONE |	  \
+     DMA_OPTION_PERIPHERAL_TO_MEMORY |	  \
+     DMA_OPTION_PERIPHERAL_DATA_SIZE_32 | \
+     DMA_OPTION_MEMORY_DATA_SIZE_32 |	  \
+     DMA_OPTION_MEMORY_DATA_INCREMENT |	  \
+     DMA_OPTION_PRIORITY_HIGH)
+
+#define DFSDM_CHANNEL(_channel) ((DFSDM_Channel_TypeDef*)(DFSDM1_Channel0_BASE + ((_channel) * 0x20)))
+
+/* The channel is implied by the DATIN pin, i.e. DATINy feeds channel y.
+ */
+static int stm32l4_dfsdm_xlate_channel(uint16_t pin)
+{
+    switch (pin) {
+#if defined(STM32L452xx)
+    case GPIO_PIN_PA7_DFSDM1_DATIN0:
+#endif /* defined(STM32L452xx) */
+    case GPIO_PIN_PB1_DFSDM1_DATIN0:
+    case GPIO_PIN_PD3_DFSDM1_DATIN0:
+	return 0;
+
+#if defined(STM32L452xx)
+    case GPIO_PIN_PA9_DFSDM1_DATIN1:
+#endif /* defined(STM32L452xx) */
+    case GPIO_PIN_PB12_DFSDM1_DATIN1:
+    case GPIO_PIN_PD6_DFSDM1_DATIN1:
+	return 1;
+
+    case GPIO_PIN_PB14_DFSDM1_DATIN2:
+    case GPIO_PIN_PE7_DFSDM1_DATIN2:
+	return 2;
+
+    case GPIO_PIN_PC7_DFSDM1_DATIN3:
+    case GPIO_PIN_PE4_DFSDM1_DATIN3:
+	return 3;
+
+#if defined(STM32L476xx) || defined(STM32L496xx)
+    case GPIO_PIN_PC0_DFSDM1_DATIN4:
+    case GPIO_PIN_PE10_DFSDM1_DATIN4:
+	return 4;
+
+    case GPIO_PIN_PB6_DFSDM1_DATIN5:
+    case GPIO_PIN_PE12_DFSDM1_DATIN5:
+	return 5;
+
+    case GPIO_PIN_PB8_DFSDM1_DATIN6:
+    case GPIO_PIN_PF13_DFSDM1_DATIN6:
+	return 6;
+
+    case GPIO_PIN_PB10_DFSDM1_DATIN7:
+    case GPIO_PIN_PD0_DFSDM1_DATIN7:
+	return 7;
+#endif /* defined(STM32L476xx) || defined(STM32L496xx) */
+
+    default:
+	return -1;
+    }
+}
+
+static bool stm32l4_dfsdm_ckout(uint16_t pin)
+{
+    switch (pin) {
+#if defined(STM32L452xx)
+    case GPIO_PIN_PA5_DFSDM1_CKOUT:
+#endif /* defined(STM32L452xx) */
+    case GPIO_PIN_PC2_DFSDM1_CKOUT:
+    case GPIO_PIN_PE9_DFSDM1_CKOUT:
+	return true;
+
+    default:
+	return false;
+    }
+}
+
+static void stm32l4_dfsdm_dma_callback(stm32l4_dfsdm_t *dfsdm, uint32_t events)
+{
+    dfsdm->state = DFSDM_STATE_READY;
+
+    if (dfsdm->events & DFSDM_EVENT_RECEIVE_REQUEST)
+    {
+	(*dfsdm->callback)(dfsdm->context, DFSDM_EVENT_RECEIVE_REQUEST);
+    }
+}
+
+bool stm32l4_dfsdm_create(stm32l4_dfsdm_t *dfsdm, unsigned int instance, const stm32l4_dfsdm_pins_t *pins, unsigned int priority)
+{
+    int channel;
+
+    if (instance >= DFSDM_INSTANCE_COUNT)
+    {
+	return false;
+    }
+
+    channel = stm32l4_dfsdm_xlate_channel(pins->datin);
+
+    if ((channel < 0) || !stm32l4_dfsdm_ckout(pins->ckout))
+    {
+	return false;
+    }
+
+    dfsdm->FLTx = stm32l4_dfsdm_xlate_FLT[instance];
+    dfsdm->state = DFSDM_STATE_INIT;
+    dfsdm->instance = instance;
+    dfsdm->channel = channel;
+    dfsdm->priority = priority;
+    dfsdm->pins = *pins;
+    dfsdm->rate = 0;
+
+    stm32l4_dfsdm_driver.instances[instance] = dfsdm;
+
+    return true;
+}
+
+bool stm32l4_dfsdm_destroy(stm32l4_dfsdm_t *dfsdm)
+{
+    if (dfsdm->state != DFSDM_STATE_INIT)
+    {
+	return false;
+    }
+
+    stm32l4_dfsdm_driver.instances[dfsdm->instance] = NULL;
+
+    dfsdm->state = DFSDM_STATE_NONE;
+
+    return true;
+}
+
+bool stm32l4_dfsdm_enable(stm32l4_dfsdm_t *dfsdm, uint32_t clock, uint32_t order, uint32_t oversampling, uint32_t option, stm32l4_dfsdm_callback_t callback, void *context, uint32_t events)
+{
+    DFSDM_Filter_TypeDef *FLTx = dfsdm->FLTx;
+    DFSDM_Channel_TypeDef *CHx;
+    uint32_t dfsdmclk, divider, channel, shift, index;
+    uint64_t gain;
+
+    if (dfsdm->state != DFSDM_STATE_INIT)
+    {
+	return false;
+    }
+
+    if ((clock == 0) || (order < 1) || (order > 5) || (oversampling < 1) || (oversampling > 1024))
+    {
+	return false;
+    }
+
+    /* A full scale bit stream yields +/- oversampling^order at the filter output, which is at most
+     * 32 bits signed. DTRBS shifts that down to fit into the 24 bit data register.
+     */
+    for (index = 0, gain = 1; index < order; index++)
+    {
+	gain *= oversampling;
+    }
+
+    if (gain > 0x80000000ull)
+    {
+	return false;
+    }
+
+    for (shift = 0; (gain >> shift) > 0x00800000; shift++)
+    {
+    }
+
+    /* The DFSDM kernel clock is PCLK2, CKOUT is divided down from there by 2 .. 256.
+     */
+    dfsdmclk = stm32l4_system_pclk2();
+
+    divider = (dfsdmclk + (clock / 2)) / clock;
+
+    if (divider < 2)
+    {
+	divider = 2;
+    }
+
+    if (divider > 256)
+    {
+	divider = 256;
+    }
+
+    if (stm32l4_dfsdm_driver.enables && (stm32l4_dfsdm_driver.divider != divider))
+    {
+	return false;
+    }
+
+    /* The second microphone on a DATIN pin is converted by the channel below, which picks
+     * up the pins of channel y via CHINSEL.
+     */
+    channel = dfsdm->channel;
+
+    if (option & DFSDM_OPTION_FALLING)
+    {
+	channel = (channel + (DFSDM_CHANNEL_COUNT -1)) % DFSDM_CHANNEL_COUNT;
+    }
+
+    if (stm32l4_dfsdm_driver.channels & (1u << channel))
+    {
+	return false;
+    }
+
+    /* FLTx shares its DMA channel with other peripherals, so it's only claimed while enabled.
+     */
+    if (!stm32l4_dma_create(&dfsdm->dma, stm32l4_dfsdm_xlate_DMA[dfsdm->instance], dfsdm->priority))
+    {
+	return false;
+    }
+
+    stm32l4_dma_enable(&dfsdm->dma, (stm32l4_dma_callback_t)stm32l4_dfsdm_dma_callback, dfsdm);
+
+    if (!stm32l4_dfsdm_driver.enables)
+    {
+	stm32l4_system_periph_enable(SYSTEM_PERIPH_DFSDM1);
+
+	DFSDM1_Channel0->CHCFGR1 = ((divider -1) << DFSDM_CHCFGR1_CKOUTDIV_Pos);
+	DFSDM1_Channel0->CHCFGR1 |= DFSDM_CHCFGR1_DFSDMEN;
+
+	stm32l4_dfsdm_driver.divider = divider;
+    }
+
+    stm32l4_dfsdm_driver.enables |= (1u << dfsdm->instance);
+    stm32l4_dfsdm_driver.channels |= (1u << channel);
+
+    stm32l4_gpio_pin_configure(dfsdm->pins.ckout, (GPIO_PUPD_NONE | GPIO_OSPEED_HIGH | GPIO_OTYPE_PUSHPULL | GPIO_MODE_ALTERNATE));
+    stm32l4_gpio_pin_configure(dfsdm->pins.datin, (GPIO_PUPD_NONE | GPIO_OSPEED_HIGH | GPIO_OTYPE_PUSHPULL | GPIO_MODE_ALTERNATE));
+
+    /* SPI input clocked by the internal CKOUT, on the rising or (SITP_0) falling edge.
+     */
+    CHx = DFSDM_CHANNEL(channel);
+
+    CHx->CHCFGR1 = ((CHx->CHCFGR1 & (DFSDM_CHCFGR1_DFSDMEN | DFSDM_CHCFGR1_CKOUTSRC | DFSDM_CHCFGR1_CKOUTDIV)) |
+		    DFSDM_CHCFGR1_SPICKSEL_0 |
+		    ((option & DFSDM_OPTION_FALLING) ? (DFSDM_CHCFGR1_CHINSEL | DFSDM_CHCFGR1_SITP_0) : 0));
+    CHx->CHCFGR2 = (shift << DFSDM_CHCFGR2_DTRBS_Pos);
+    CHx->CHCFGR1 |= DFSDM_CHCFGR1_CHEN;
+
+    /* Continuous fast mode regular conversions of the one channel, read by DMA. They are started
+     * by the first stm32l4_dfsdm_receive() (or with FLT0 for DFSDM_OPTION_SYNC).
+     */
+    FLTx->FLTCR1 = 0;
+    FLTx->FLTFCR = ((order << DFSDM_FLTFCR_FORD_Pos) | ((oversampling -1) << DFSDM_FLTFCR_FOSR_Pos));
+    FLTx->FLTCR1 = ((channel << DFSDM_FLTCR1_RCH_Pos) |
+		    DFSDM_FLTCR1_FAST |
+		    DFSDM_FLTCR1_RDMAEN |
+		    DFSDM_FLTCR1_RCONT |
+		    (((option & DFSDM_OPTION_SYNC) && (dfsdm->instance != DFSDM_INSTANCE_FLT0)) ? DFSDM_FLTCR1_RSYNC : 0));
+    FLTx->FLTCR1 |= DFSDM_FLTCR1_DFEN;
+
+    dfsdm->option = option;
+    dfsdm->rate = (dfsdmclk / divider) / oversampling;
+
+    stm32l4_dfsdm_notify(dfsdm, callback, context, events);
+
+    dfsdm->state = DFSDM_STATE_READY;
+
+    return true;
+}
+
+bool stm32l4_dfsdm_disable(stm32l4_dfsdm_t *dfsdm)
+{
+    DFSDM_Filter_TypeDef *FLTx = dfsdm->FLTx;
+    uint32_t channel, index;
+    bool shared;
+
+    if ((dfsdm->state != DFSDM_STATE_READY) && (dfsdm->state != DFSDM_STATE_RECEIVE))
+    {
+	return false;
+    }
+
+    FLTx->FLTCR1 = 0;
+
+    if (dfsdm->state == DFSDM_STATE_RECEIVE)
+    {
+	stm32l4_dma_stop(&dfsdm->dma);
+    }
+
+    stm32l4_dma_disable(&dfsdm->dma);
+    stm32l4_dma_destroy(&dfsdm->dma);
+
+    channel = dfsdm->channel;
+
+    if (dfsdm->option & DFSDM_OPTION_FALLING)
+    {
+	channel = (channel + (DFSDM_CHANNEL_COUNT -1)) % DFSDM_CHANNEL_COUNT;
+    }
+
+    DFSDM_CHANNEL(channel)->CHCFGR1 &= ~DFSDM_CHCFGR1_CHEN;
+
+    stm32l4_dfsdm_driver.enables &= ~(1u << dfsdm->instance);
+    stm32l4_dfsdm_driver.channels &= ~(1u << channel);
+
+    /* The rising/falling edge microphone pair shares the DATIN pin, and all share CKOUT.
+     */
+    for (index = 0, shared = false; index < DFSDM_INSTANCE_COUNT; index++)
+    {
+	if ((stm32l4_dfsdm_driver.enables & (1u << index)) && (stm32l4_dfsdm_driver.instances[index]->pins.datin == dfsdm->pins.datin))
+	{
+	    shared = true;
+	}
+    }
+
+    if (!shared)
+    {
+	stm32l4_gpio_pin_configure(dfsdm->pins.datin, (GPIO_PUPD_NONE | GPIO_MODE_ANALOG));
+    }
+
+    if (!stm32l4_dfsdm_driver.enables)
+    {
+	DFSDM1_Channel0->CHCFGR1 &= ~DFSDM_CHCFGR1_DFSDMEN;
+	DFSDM1_Channel0->CHCFGR1 = 0;
+
+	stm32l4_gpio_pin_configure(dfsdm->pins.ckout, (GPIO_PUPD_NONE | GPIO_MODE_ANALOG));
+
+	stm32l4_system_periph_disable(SYSTEM_PERIPH_DFSDM1);
+    }
+
+    dfsdm->state = DFSDM_STATE_INIT;
+
+    return true;
+}
+
+bool stm32l4_dfsdm_notify(stm32l4_dfsdm_t *dfsdm, stm32l4_dfsdm_callback_t callback, void *context, uint32_t events)
+{
+    if (dfsdm->state == DFSDM_STATE_NONE)
+    {
+	return false;
+    }
+
+    dfsdm->events = 0;
+
+    dfsdm->callback = callback;
+    dfsdm->context = context;
+    dfsdm->events = callback ? events : 0;
+
+    return true;
+}
+
+uint32_t stm32l4_dfsdm_rate(stm32l4_dfsdm_t *dfsdm)
+{
+    if ((dfsdm->state != DFSDM_STATE_READY) && (dfsdm->state != DFSDM_STATE_RECEIVE))
+    {
+	return 0;
+    }
+
+    return dfsdm->rate;
+}
+
+bool stm32l4_dfsdm_receive(stm32l4_dfsdm_t *dfsdm, int32_t *rx_data, uint16_t rx_count)
+{
+    DFSDM_Filter_TypeDef *FLTx = dfsdm->FLTx;
+
+    if ((dfsdm->state != DFSDM_STATE_READY) || (rx_count == 0))
+    {
+	return false;
+    }
+
+    dfsdm->state = DFSDM_STATE_RECEIVE;
+
+    stm32l4_dma_start(&dfsdm->dma, (uint32_t)rx_data, (uint32_t)&FLTx->FLTRDATAR, rx_count, DFSDM_DMA_OPTION_RECEIVE);
+
+    /* Conversions keep running between receives; a sample that was not picked up in time is
+     * simply overwritten (ROVRF).
+     */
+    if (!(FLTx->FLTISR & DFSDM_FLTISR_RCIP) && !(FLTx->FLTCR1 & DFSDM_FLTCR1_RSYNC))
+    {
+	FLTx->FLTCR1 |= DFSDM_FLTCR1_RSWSTART;
+    }
+
+    return true;
+}
+
+bool stm32l4_dfsdm_done(stm32l4_dfsdm_t *dfsdm)
+{
+    return (dfsdm->state == DFSDM_STATE_READY);
+}
+
+#endif /* defined(STM32L452xx) || defined(STM32L476xx) || defined(STM32L496xx) */
@@ -27,6 +27,7 @@
  */
 
 #include <stdio.h>
+#include <string.h>
 
 #include "stm32l4xx.h"
 
@@ -74,17 +75,54 @@ static const IRQn_Type stm32l4_dma_interrupt_table[16] = {
 };
 
 typedef struct _stm32l4_dma_driver_t {
-    stm32l4_dma_t          *instances[16];
+    stm32l4_dma_t          *instances[16];   /* owner, or for a shared channel the leasing client */
+    stm32l4_dma_t          *shared[16];      /* clients of a shared channel */
+    uint8_t                enables[16];      /* enabled clients of a shared channel */
     volatile uint32_t      mask;
+    volatile uint32_t      shares;
+    volatile uint32_t      conflicts;
     volatile uint32_t      sram1;
     volatile uint32_t      sram2;
     volatile uint32_t      flash;
     volatile uint32_t      dma1;
     volatile uint32_t      dma2;
+    volatile uint32_t      memory;
 } stm32l4_dma_driver_t;
 
 static stm32l4_dma_driver_t stm32l4_dma_driver;
 
+#define DMA_MEMORY_COUNT 2
+
+typedef struct _stm32l4_dma_memory_t {
+    stm32l4_dma_t          dma;
+    uint32_t               data;         /* memset() pattern */
+    uint32_t               address;      /* destination, tracked for sleep */
+    stm32l4_dma_callback_t callback;
+    void                   *context;
+} stm32l4_dma_memory_t;
+
+static stm32l4_dma_memory_t stm32l4_dma_memory[DMA_MEMORY_COUNT];
+
+static const uint8_t stm32l4_dma_memory_channels[] = {
+    DMA_CHANNEL_DMA2_CH1_INDEX,
+    DMA_CHANNEL_DMA2_CH2_INDEX,
+    DMA_CHANNEL_DMA2_CH3_INDEX,
+    DMA_CHANNEL_DMA2_CH4_INDEX,
+    DMA_CHANNEL_DMA2_CH5_INDEX,
+    DMA_CHANNEL_DMA2_CH6_INDEX,
+    DMA_CHANNEL_DMA2_CH7_INDEX,
+};
+
+static inline uint32_t stm32l4_dma_lock(void)
+{
+    return armv7m_critical_enter(DMA_CRITICAL_PRIORITY);
+}
+
+static inline void stm32l4_dma_unlock(uint32_t basepri)
+{
+    armv7m_critical_leave(basepri);
+}
+
 static void stm32l4_dma_track(uint32_t channel, uint32_t address)
 {
     if (address < 0x40000000)
@@ -127,7 +165,7 @@ static void stm32l4_dma_untrack(uint32_t channel, uint32_t address)
     }
 }
 
-static void stm32l4_dma_interrupt(stm32l4_dma_t *dma)
+static __fastcode __optimize_speed void stm32l4_dma_interrupt(stm32l4_dma_t *dma)
 {
     unsigned int shift;
     uint32_t events;
@@ -147,17 +185,152 @@ static void stm32l4_dma_interrupt(stm32l4_dma_t *dma)
 	DMA2->IFCR = (15 << shift);
     }
 
-    if (events)
+    ARMV7M_TRACE_EVENT(ARMV7M_TRACE_DMA, ((dma->channel << 8) | events));
+
+    if (events && dma->callback)
     {
 	(*dma->callback)(dma->context, events);
     }
 }
 
+static void stm32l4_dma_select(stm32l4_dma_t *dma)
+{
+    unsigned int shift;
+
+    shift = ((dma->channel & 7) -1) << 2;
+
+    if (!(dma->channel & 8))
+    {
+	armv7m_atomic_modify(&DMA1_CSELR->CSELR, (15 << shift), (dma->channel >> 4) << shift);
+    }
+    else
+    {
+	armv7m_atomic_modify(&DMA2_CSELR->CSELR, (15 << shift), (dma->channel >> 4) << shift);
+    }
+}
+
+static void stm32l4_dma_transfer(stm32l4_dma_t *dma, uint32_t tx_data, uint32_t rx_data, uint16_t xf_count, uint32_t option)
+{
+    DMA_Channel_TypeDef *DMA = dma->DMA;
+    unsigned int shift;
+
+    DMA->CCR &= ~DMA_CCR_EN;
+
+    shift = ((dma->channel & 7) -1) << 2;
+
+    if (!(dma->channel & 8))
+    {
+	DMA1->IFCR = (15 << shift);
+    }
+    else
+    {
+	DMA2->IFCR = (15 << shift);
+    }
+
+    stm32l4_dma_untrack(dma->channel, DMA->CMAR);
+
+    if (option & DMA_OPTION_MEMORY_TO_PERIPHERAL)
+    {
+	stm32l4_dma_track(dma->channel, rx_data);
+
+	DMA->CMAR = rx_data;
+	DMA->CPAR = tx_data;
+    }
+    else
+    {
+	stm32l4_dma_track(dma->channel, tx_data);
+
+	DMA->CMAR = tx_data;
+	DMA->CPAR = rx_data;
+    }
+
+    dma->size = xf_count;
+
+    DMA->CNDTR = xf_count;
+    DMA->CCR = option | DMA_CCR_EN;
+}
+
+/* A shared channel is leased to one client from stm32l4_dma_start() till
+ * stm32l4_dma_stop(). If another client holds the lease, the transfer is
+ * queued and false is returned.
+ */
+static bool stm32l4_dma_lease(stm32l4_dma_t *dma, uint32_t tx_data, uint32_t rx_data, uint16_t xf_count, uint32_t option)
+{
+    stm32l4_dma_t *lessee;
+    uint32_t basepri;
+
+    basepri = stm32l4_dma_lock();
+
+    lessee = stm32l4_dma_driver.instances[dma->channel & 15];
+
+    if (!lessee || (lessee == dma))
+    {
+	stm32l4_dma_driver.instances[dma->channel & 15] = dma;
+
+	stm32l4_dma_unlock(basepri);
+
+	return true;
+    }
+
+    dma->tx_data = tx_data;
+    dma->rx_data = rx_data;
+    dma->size = xf_count;
+    dma->option = option;
+    dma->flags |= DMA_FLAG_PENDING;
+
+    stm32l4_dma_unlock(basepri);
+
+    return false;
+}
+
+/* Passes the lease on to the next client with a queued transfer, round robin
+ * starting behind "dma".
+ */
+static void stm32l4_dma_release(stm32l4_dma_t *dma)
+{
+    stm32l4_dma_t *client, *lessee;
+    unsigned int index;
+    uint32_t basepri;
+
+    index = dma->channel & 15;
+
+    basepri = stm32l4_dma_lock();
+
+    lessee = NULL;
+
+    for (client = (dma->next ? dma->next : stm32l4_dma_driver.shared[index]); client != dma; client = (client->next ? client->next : stm32l4_dma_driver.shared[index]))
+    {
+	if (client->flags & DMA_FLAG_PENDING)
+	{
+	    lessee = client;
+
+	    break;
+	}
+    }
+
+    stm32l4_dma_driver.instances[index] = lessee;
+
+    if (lessee)
+    {
+	lessee->flags &= ~DMA_FLAG_PENDING;
+
+	stm32l4_dma_select(lessee);
+	stm32l4_dma_transfer(lessee, lessee->tx_data, lessee->rx_data, lessee->size, lessee->option);
+    }
+
+    stm32l4_dma_unlock(basepri);
+}
+
+static inline bool stm32l4_dma_leased(stm32l4_dma_t *dma)
+{
+    return (!(dma->flags & DMA_FLAG_SHARED) || (stm32l4_dma_driver.instances[dma->channel & 15] == dma));
+}
+
 stm32l4_dma_t *stm32l4_dma_get(uint8_t channel) {
   return stm32l4_dma_driver.instances[channel & 15];
 }
 
-bool stm32l4_dma_create(stm32l4_dma_t *dma, uint8_t channel, unsigned int priority)
+static bool stm32l4_dma_claim(stm32l4_dma_t *dma, uint8_t channel, unsigned int priority)
 {
     uint32_t o_mask, n_mask;
 
@@ -174,9 +347,11 @@ bool stm32l4_dma_create(stm32l4_dma_t *dma, uint8_t channel, unsigned int priori
     dma->DMA = stm32l4_dma_channel_table[channel & 15];
     dma->interrupt = stm32l4_dma_interrupt_table[channel & 15];
     dma->channel = channel;
+    dma->flags = 0;
 
     dma->callback = NULL;
     dma->context = NULL;
+    dma->next = NULL;
 
     stm32l4_dma_driver.instances[channel & 15] = dma;
 
@@ -185,9 +360,130 @@ bool stm32l4_dma_create(stm32l4_dma_t *dma, uint8_t channel, unsigned int priori
     return true;
 }
 
+bool stm32l4_dma_create(stm32l4_dma_t *dma, uint8_t channel, unsigned int priority)
+{
+    if (!stm32l4_dma_claim(dma, channel, priority))
+    {
+	armv7m_atomic_or(&stm32l4_dma_driver.conflicts, (1ul << (channel & 15)));
+
+	return false;
+    }
+
+    return true;
+}
+
+uint8_t stm32l4_dma_allocate(stm32l4_dma_t *dma, const uint8_t *channels, unsigned int priority)
+{
+    const uint8_t *channel;
+    uint32_t mask;
+
+    mask = 0;
+
+    for (channel = channels; *channel != DMA_CHANNEL_NONE; channel++)
+    {
+	if (stm32l4_dma_claim(dma, *channel, priority))
+	{
+	    return *channel;
+	}
+
+	mask |= (1ul << (*channel & 15));
+    }
+
+    armv7m_atomic_or(&stm32l4_dma_driver.conflicts, mask);
+
+    return DMA_CHANNEL_NONE;
+}
+
+bool stm32l4_dma_create_shared(stm32l4_dma_t *dma, uint8_t channel, unsigned int priority)
+{
+    unsigned int index;
+    uint32_t n_mask, basepri;
+    bool success;
+
+    index = channel & 15;
+    n_mask = (1ul << index);
+
+    basepri = stm32l4_dma_lock();
+
+    success = (!(stm32l4_dma_driver.mask & n_mask) || (stm32l4_dma_driver.shares & n_mask));
+
+    if (success)
+    {
+	dma->DMA = stm32l4_dma_channel_table[index];
+	dma->interrupt = stm32l4_dma_interrupt_table[index];
+	dma->channel = channel;
+	dma->flags = DMA_FLAG_SHARED;
+
+	dma->callback = NULL;
+	dma->context = NULL;
+
+	dma->next = stm32l4_dma_driver.shared[index];
+
+	stm32l4_dma_driver.shared[index] = dma;
+	stm32l4_dma_driver.mask |= n_mask;
+	stm32l4_dma_driver.shares |= n_mask;
+    }
+
+    stm32l4_dma_unlock(basepri);
+
+    if (!success)
+    {
+	armv7m_atomic_or(&stm32l4_dma_driver.conflicts, n_mask);
+    }
+
+    return success;
+}
+
+uint32_t stm32l4_dma_conflicts(bool clear)
+{
+    return (clear ? armv7m_atomic_exchange(&stm32l4_dma_driver.conflicts, 0) : stm32l4_dma_driver.conflicts);
+}
+
+uint8_t stm32l4_dma_owner(unsigned int index)
+{
+    stm32l4_dma_t *dma;
+
+    dma = stm32l4_dma_driver.instances[index & 15];
+
+    if (!dma)
+    {
+	dma = stm32l4_dma_driver.shared[index & 15];
+    }
+
+    return (dma ? dma->channel : DMA_CHANNEL_NONE);
+}
+
 void stm32l4_dma_destroy(stm32l4_dma_t *dma)
 {
-    uint32_t n_mask;
+    stm32l4_dma_t **p_dma;
+    unsigned int index;
+    uint32_t n_mask, basepri;
+
+    if (dma->flags & DMA_FLAG_SHARED)
+    {
+	index = dma->channel & 15;
+	n_mask = (1ul << index);
+
+	basepri = stm32l4_dma_lock();
+
+	for (p_dma = &stm32l4_dma_driver.shared[index]; *p_dma != dma; p_dma = &(*p_dma)->next)
+	{
+	}
+
+	*p_dma = dma->next;
+
+	if (!stm32l4_dma_driver.shared[index])
+	{
+	    stm32l4_dma_driver.shares &= ~n_mask;
+	    stm32l4_dma_driver.mask &= ~n_mask;
+	}
+
+	stm32l4_dma_unlock(basepri);
+
+	dma->flags = 0;
+
+	return;
+    }
 
     stm32l4_dma_driver.instances[dma->channel & 15] = NULL;
     
@@ -199,26 +495,47 @@ void stm32l4_dma_destroy(stm32l4_dma_t *dma)
 void stm32l4_dma_enable(stm32l4_dma_t *dma, stm32l4_dma_callback_t callback, void *context)
 {
     DMA_Channel_TypeDef *DMA = dma->DMA;
-    unsigned int shift;
+    uint32_t basepri;
 
     dma->callback = callback;
     dma->context = context;
 
-    shift = ((dma->channel & 7) -1) << 2;
+    if (dma->flags & DMA_FLAG_SHARED)
+    {
+	/* The request gets selected when a transfer is leased the channel.
+	 */
+	basepri = stm32l4_dma_lock();
+
+	if (stm32l4_dma_driver.enables[dma->channel & 15]++ == 0)
+	{
+	    if (!(dma->channel & 8))
+	    {
+		stm32l4_system_periph_cond_enable(SYSTEM_PERIPH_DMA1, &stm32l4_dma_driver.dma1, (1ul << (dma->channel & 7)));
+	    }
+	    else
+	    {
+		stm32l4_system_periph_cond_enable(SYSTEM_PERIPH_DMA2, &stm32l4_dma_driver.dma2, (1ul << (dma->channel & 7)));
+	    }
+
+	    DMA->CMAR = 0xffffffff;
+	}
+
+	stm32l4_dma_unlock(basepri);
+
+	return;
+    }
 
     if (!(dma->channel & 8))
     {
 	stm32l4_system_periph_cond_enable(SYSTEM_PERIPH_DMA1, &stm32l4_dma_driver.dma1, (1ul << (dma->channel & 7)));
-
-	armv7m_atomic_modify(&DMA1_CSELR->CSELR, (15 << shift), (dma->channel >> 4) << shift);
     }
     else
     {
 	stm32l4_system_periph_cond_enable(SYSTEM_PERIPH_DMA2, &stm32l4_dma_driver.dma2, (1ul << (dma->channel & 7)));
-
-	armv7m_atomic_modify(&DMA2_CSELR->CSELR, (15 << shift), (dma->channel >> 4) << shift);
     }
 
+    stm32l4_dma_select(dma);
+
     DMA->CMAR = 0xffffffff;
 
     if (callback)
@@ -230,6 +547,28 @@ void stm32l4_dma_enable(stm32l4_dma_t *dma, stm32l4_dma_callback_t callback, voi
 void stm32l4_dma_disable(stm32l4_dma_t *dma)
 {
     DMA_Channel_TypeDef *DMA = dma->DMA;
+    uint32_t basepri;
+
+    if (dma->flags & DMA_FLAG_SHARED)
+    {
+	basepri = stm32l4_dma_lock();
+
+	if (--stm32l4_dma_driver.enables[dma->channel & 15] == 0)
+	{
+	    if (!(dma->channel & 8))
+	    {
+		stm32l4_system_periph_cond_disable(SYSTEM_PERIPH_DMA1, &stm32l4_dma_driver.dma1, (1ul << (dma->channel & 7)));
+	    }
+	    else
+	    {
+		stm32l4_system_periph_cond_disable(SYSTEM_PERIPH_DMA2, &stm32l4_dma_driver.dma2, (1ul << (dma->channel & 7)));
+	    }
+	}
+
+	stm32l4_dma_unlock(basepri);
+
+	return;
+    }
 
     NVIC_DisableIRQ(dma->interrupt);
 
@@ -246,153 +585,604 @@ void stm32l4_dma_disable(stm32l4_dma_t *dma)
 }
 
 void stm32l4_dma_start(stm32l4_dma_t *dma, uint32_t tx_data, uint32_t rx_data, uint16_t xf_count, uint32_t option)
+{
+    if (dma->flags & DMA_FLAG_SHARED)
+    {
+	if (!stm32l4_dma_lease(dma, tx_data, rx_data, xf_count, option))
+	{
+	    return;
+	}
+
+	stm32l4_dma_select(dma);
+    }
+
+    stm32l4_dma_transfer(dma, tx_data, rx_data, xf_count, option);
+}
+
+void stm32l4_dma_start_circular(stm32l4_dma_t *dma, uint32_t tx_data, uint32_t rx_data, uint16_t xf_count, uint32_t option)
+{
+    stm32l4_dma_start(dma, tx_data, rx_data, xf_count, (option | DMA_OPTION_CIRCULAR | DMA_OPTION_EVENT_TRANSFER_HALF | DMA_OPTION_EVENT_TRANSFER_DONE));
+}
+
+uint16_t stm32l4_dma_stop(stm32l4_dma_t *dma)
+{
+    DMA_Channel_TypeDef *DMA = dma->DMA;
+    uint32_t basepri;
+    uint16_t count;
+
+    if (dma->flags & DMA_FLAG_SHARED)
+    {
+	basepri = stm32l4_dma_lock();
+
+	if (dma->flags & DMA_FLAG_PENDING)
+	{
+	    dma->flags &= ~DMA_FLAG_PENDING;
+
+	    stm32l4_dma_unlock(basepri);
+
+	    return 0;
+	}
+
+	stm32l4_dma_unlock(basepri);
+
+	if (!stm32l4_dma_leased(dma))
+	{
+	    return 0;
+	}
+    }
+
+    DMA->CCR &= ~(DMA_CCR_EN | DMA_CCR_TCIE | DMA_CCR_HTIE | DMA_CCR_TEIE);
+
+    stm32l4_dma_untrack(dma->channel, DMA->CMAR);
+
+    DMA->CMAR = 0xffffffff;
+
+    count = dma->size - (DMA->CNDTR & 0xffff);
+
+    if (dma->flags & DMA_FLAG_SHARED)
+    {
+	stm32l4_dma_release(dma);
+    }
+
+    return count;
+}
+
+uint16_t stm32l4_dma_count(stm32l4_dma_t *dma)
 {
     DMA_Channel_TypeDef *DMA = dma->DMA;
+
+    if (!stm32l4_dma_leased(dma))
+    {
+	return 0;
+    }
+
+    return dma->size - (DMA->CNDTR & 0xffff);
+}
+
+bool stm32l4_dma_done(stm32l4_dma_t *dma)
+{
     unsigned int shift;
 
-    DMA->CCR &= ~DMA_CCR_EN;
+    if (!stm32l4_dma_leased(dma))
+    {
+	return false;
+    }
 
     shift = ((dma->channel & 7) -1) << 2;
 
     if (!(dma->channel & 8))
     {
-	DMA1->IFCR = (15 << shift);
+	return !!(DMA1->ISR & (DMA_ISR_TCIF1 << shift));
     }
     else
     {
-	DMA2->IFCR = (15 << shift);
+	return !!(DMA2->ISR & (DMA_ISR_TCIF1 << shift));
     }
+}
 
-    stm32l4_dma_untrack(dma->channel, DMA->CMAR);
+void stm32l4_dma_poll(stm32l4_dma_t *dma)
+{
+    if (stm32l4_dma_leased(dma))
+    {
+	stm32l4_dma_interrupt(dma);
+    }
+}
 
-    if (option & DMA_OPTION_MEMORY_TO_PERIPHERAL)
+static void stm32l4_dma_memory_callback(void *context, uint32_t events)
+{
+    stm32l4_dma_memory_t *memory = (stm32l4_dma_memory_t*)context;
+    stm32l4_dma_callback_t callback;
+
+    stm32l4_dma_stop(&memory->dma);
+    stm32l4_dma_untrack(memory->dma.channel, memory->address);
+    stm32l4_dma_disable(&memory->dma);
+    stm32l4_dma_destroy(&memory->dma);
+
+    callback = memory->callback;
+    context = memory->context;
+
+    armv7m_atomic_and(&stm32l4_dma_driver.memory, ~(1ul << (memory - &stm32l4_dma_memory[0])));
+
+    if (callback)
     {
-	stm32l4_dma_track(dma->channel, rx_data);
+	(*callback)(context, (events & DMA_EVENT_TRANSFER_ERROR) ? DMA_EVENT_TRANSFER_ERROR : DMA_EVENT_TRANSFER_DONE);
+    }
+}
 
-	DMA->CMAR = rx_data;
-	DMA->CPAR = tx_data;
+/* Claims an engine and a DMA2 channel, and starts a memory to memory transfer
+ * of "count" units from "src" to "dst". Returns false if none was available.
+ */
+static bool stm32l4_dma_memory_start(uint32_t dst, uint32_t src, uint32_t count, uint32_t option, unsigned int priority, stm32l4_dma_callback_t callback, void *context, uint32_t data)
+{
+    stm32l4_dma_memory_t *memory;
+    unsigned int index, channel;
+    uint32_t o_mask, n_mask;
+
+    for (index = 0; index < DMA_MEMORY_COUNT; index++)
+    {
+	n_mask = (1ul << index);
+
+	o_mask = armv7m_atomic_or(&stm32l4_dma_driver.memory, n_mask);
+
+	if (!(o_mask & n_mask))
+	{
+	    break;
+	}
     }
-    else
+
+    if (index == DMA_MEMORY_COUNT)
     {
-	stm32l4_dma_track(dma->channel, tx_data);
+	return false;
+    }
 
-	DMA->CMAR = tx_data;
-	DMA->CPAR = rx_data;
+    memory = &stm32l4_dma_memory[index];
+
+    for (channel = 0; channel < sizeof(stm32l4_dma_memory_channels); channel++)
+    {
+	if (stm32l4_dma_claim(&memory->dma, stm32l4_dma_memory_channels[channel], priority))
+	{
+	    break;
+	}
     }
 
-    dma->size = xf_count;
+    if (channel == sizeof(stm32l4_dma_memory_channels))
+    {
+	armv7m_atomic_and(&stm32l4_dma_driver.memory, ~n_mask);
 
-    DMA->CNDTR = xf_count;
-    DMA->CCR = option | DMA_CCR_EN;
+	return false;
+    }
+
+    memory->data = data;
+    memory->address = dst;
+    memory->callback = callback;
+    memory->context = context;
+
+    stm32l4_dma_enable(&memory->dma, stm32l4_dma_memory_callback, memory);
+
+    stm32l4_dma_track(memory->dma.channel, dst);
+
+    /* With DMA_OPTION_MEMORY_TO_PERIPHERAL, CMAR is the source and CPAR the destination.
+     */
+    stm32l4_dma_start(&memory->dma, dst, ((option & DMA_OPTION_MEMORY_DATA_INCREMENT) ? src : (uint32_t)&memory->data), count,
+		      (option | DMA_OPTION_MEMORY_TO_MEMORY | DMA_OPTION_MEMORY_TO_PERIPHERAL | DMA_OPTION_PERIPHERAL_DATA_INCREMENT | DMA_OPTION_PRIORITY_LOW |
+		       DMA_OPTION_EVENT_TRANSFER_DONE | DMA_OPTION_EVENT_TRANSFER_ERROR));
+
+    return true;
 }
 
-uint16_t stm32l4_dma_stop(stm32l4_dma_t *dma)
+bool stm32l4_dma_memcpy_async(void *dst, const void *src, uint32_t size, unsigned int priority, stm32l4_dma_callback_t callback, void *context)
 {
-    DMA_Channel_TypeDef *DMA = dma->DMA;
+    uint8_t *d = (uint8_t*)dst;
+    const uint8_t *s = (const uint8_t*)src;
+    uint32_t head, tail, count, option;
 
-    DMA->CCR &= ~(DMA_CCR_EN | DMA_CCR_TCIE | DMA_CCR_HTIE | DMA_CCR_TEIE);
+    if (size >= DMA_MEMORY_MINIMUM)
+    {
+	if (!(((uint32_t)d ^ (uint32_t)s) & 3))
+	{
+	    head = (0 - (uint32_t)d) & 3;
+	    count = (size - head) >> 2;
+	    tail = size - head - (count << 2);
+	    option = DMA_OPTION_MEMORY_DATA_INCREMENT | DMA_OPTION_PERIPHERAL_DATA_SIZE_32 | DMA_OPTION_MEMORY_DATA_SIZE_32;
+	}
+	else
+	{
+	    /* Mutually misaligned, so fall back to byte transfers.
+	     */
+	    head = 0;
+	    count = size;
+	    tail = 0;
+	    option = DMA_OPTION_MEMORY_DATA_INCREMENT | DMA_OPTION_PERIPHERAL_DATA_SIZE_8 | DMA_OPTION_MEMORY_DATA_SIZE_8;
+	}
 
-    stm32l4_dma_untrack(dma->channel, DMA->CMAR);
+	if (count <= 0xffff)
+	{
+	    memcpy(d, s, head);
+	    memcpy(d + size - tail, s + size - tail, tail);
 
-    DMA->CMAR = 0xffffffff;
+	    if (stm32l4_dma_memory_start((uint32_t)(d + head), (uint32_t)(s + head), count, option, priority, callback, context, 0))
+	    {
+		return true;
+	    }
+	}
+    }
 
-    return dma->size - (DMA->CNDTR & 0xffff);
+    memcpy(d, s, size);
+
+    if (callback)
+    {
+	(*callback)(context, DMA_EVENT_TRANSFER_DONE);
+    }
+
+    return false;
 }
 
-uint16_t stm32l4_dma_count(stm32l4_dma_t *dma)
+bool stm32l4_dma_memset_async(void *dst, uint8_t data, uint32_t size, unsigned int priority, stm32l4_dma_callback_t callback, void *context)
 {
-    DMA_Channel_TypeDef *DMA = dma->DMA;
+    uint8_t *d = (uint8_t*)dst;
+    uint32_t head, tail, count;
 
-    return dma->size - (DMA->CNDTR & 0xffff);
+    if (size >= DMA_MEMORY_MINIMUM)
+    {
+	head = (0 - (uint32_t)d) & 3;
+	count = (size - head) >> 2;
+	tail = size - head - (count << 2);
+
+	if (count <= 0xffff)
+	{
+	    memset(d, data, head);
+	    memset(d + size - tail, data, tail);
+
+	    if (stm32l4_dma_memory_start((uint32_t)(d + head), 0, count, (DMA_OPTION_PERIPHERAL_DATA_SIZE_32 | DMA_OPTION_MEMORY_DATA_SIZE_32), priority, callback, context, (data * 0x01010101)))
+	    {
+		return true;
+	    }
+	}
+    }
+
+    memset(d, data, size);
+
+    if (callback)
+    {
+	(*callback)(context, DMA_EVENT_TRANSFER_DONE);
+    }
+
+    return false;
 }
 
-bool stm32l4_dma_done(stm32l4_dma_t *dma)
+#define DMA_PIPE_OPTION_MASK (DMA_OPTION_PERIPHERAL_DATA_SIZE_MASK | DMA_OPTION_MEMORY_DATA_SIZE_MASK | DMA_OPTION_PRIORITY_MASK)
+
+static void stm32l4_dma_pipe_attach(stm32l4_dma_t *dma, stm32l4_dma_callback_t callback, void *context, stm32l4_dma_callback_t *p_callback, void **p_context)
 {
-    unsigned int shift;
+    NVIC_DisableIRQ(dma->interrupt);
 
-    shift = ((dma->channel & 7) -1) << 2;
+    *p_callback = dma->callback;
+    *p_context = dma->context;
 
-    if (!(dma->channel & 8))
+    dma->callback = callback;
+    dma->context = context;
+
+    NVIC_EnableIRQ(dma->interrupt);
+}
+
+static void stm32l4_dma_pipe_detach(stm32l4_dma_t *dma, stm32l4_dma_callback_t callback, void *context)
+{
+    NVIC_DisableIRQ(dma->interrupt);
+
+    stm32l4_dma_stop(dma);
+
+    dma->callback = callback;
+    dma->context = context;
+
+    if (callback)
     {
-	return !!(DMA1->ISR & (DMA_ISR_TCIF1 << shift));
+	NVIC_EnableIRQ(dma->interrupt);
+    }
+}
+
+static void stm32l4_dma_pipe_sink_callback(stm32l4_dma_pipe_t *pipe, uint32_t events)
+{
+    if (pipe->callback)
+    {
+	(*pipe->callback)(pipe->context, events);
+    }
+}
+
+static void stm32l4_dma_pipe_source_callback(stm32l4_dma_pipe_t *pipe, uint32_t events)
+{
+    if ((pipe->state == DMA_PIPE_STATE_PRIME) && (events & DMA_EVENT_TRANSFER_HALF))
+    {
+	/* The first half of the ring is filled, so let the sink trail the source by
+	 * half a ring. Past this point only errors are of interest.
+	 */
+	pipe->source->DMA->CCR &= ~DMA_CCR_HTIE;
+
+	pipe->state = DMA_PIPE_STATE_ACTIVE;
+
+	stm32l4_dma_start_circular(pipe->sink, pipe->sink_data, pipe->data, pipe->count,
+				   (pipe->sink_option | DMA_OPTION_MEMORY_TO_PERIPHERAL | DMA_OPTION_MEMORY_DATA_INCREMENT | DMA_OPTION_EVENT_TRANSFER_ERROR));
+    }
+
+    if ((events & DMA_EVENT_TRANSFER_ERROR) && pipe->callback)
+    {
+	(*pipe->callback)(pipe->context, DMA_EVENT_TRANSFER_ERROR);
+    }
+}
+
+void stm32l4_dma_pipe_create(stm32l4_dma_pipe_t *pipe)
+{
+    pipe->source = NULL;
+    pipe->source_data = 0;
+    pipe->source_option = 0;
+    pipe->source_callback = NULL;
+    pipe->source_context = NULL;
+    pipe->sink = NULL;
+    pipe->sink_data = 0;
+    pipe->sink_option = 0;
+    pipe->sink_callback = NULL;
+    pipe->sink_context = NULL;
+    pipe->data = 0;
+    pipe->count = 0;
+    pipe->callback = NULL;
+    pipe->context = NULL;
+
+    pipe->state = DMA_PIPE_STATE_READY;
+}
+
+bool stm32l4_dma_pipe_source(stm32l4_dma_pipe_t *pipe, stm32l4_dma_t *dma, uint32_t data, uint32_t option)
+{
+    if (pipe->state != DMA_PIPE_STATE_READY)
+    {
+	return false;
+    }
+
+    pipe->source = dma;
+    pipe->source_data = data;
+    pipe->source_option = option & DMA_PIPE_OPTION_MASK;
+
+    return true;
+}
+
+bool stm32l4_dma_pipe_sink(stm32l4_dma_pipe_t *pipe, stm32l4_dma_t *dma, uint32_t data, uint32_t option)
+{
+    if (pipe->state != DMA_PIPE_STATE_READY)
+    {
+	return false;
+    }
+
+    pipe->sink = dma;
+    pipe->sink_data = data;
+    pipe->sink_option = option & DMA_PIPE_OPTION_MASK;
+
+    return true;
+}
+
+bool stm32l4_dma_pipe_start(stm32l4_dma_pipe_t *pipe, void *data, uint16_t xf_count, stm32l4_dma_callback_t callback, void *context)
+{
+    if ((pipe->state != DMA_PIPE_STATE_READY) || !pipe->sink || (xf_count < 2) || (xf_count & 1))
+    {
+	return false;
+    }
+
+    pipe->data = (uint32_t)data;
+    pipe->count = xf_count;
+    pipe->callback = callback;
+    pipe->context = context;
+
+    stm32l4_dma_pipe_attach(pipe->sink, (stm32l4_dma_callback_t)stm32l4_dma_pipe_sink_callback, pipe, &pipe->sink_callback, &pipe->sink_context);
+
+    if (pipe->source)
+    {
+	stm32l4_dma_pipe_attach(pipe->source, (stm32l4_dma_callback_t)stm32l4_dma_pipe_source_callback, pipe, &pipe->source_callback, &pipe->source_context);
+
+	pipe->state = DMA_PIPE_STATE_PRIME;
+
+	stm32l4_dma_start(pipe->source, pipe->data, pipe->source_data, pipe->count,
+			  (pipe->source_option | DMA_OPTION_PERIPHERAL_TO_MEMORY | DMA_OPTION_MEMORY_DATA_INCREMENT | DMA_OPTION_CIRCULAR |
+			   DMA_OPTION_EVENT_TRANSFER_HALF | DMA_OPTION_EVENT_TRANSFER_ERROR));
     }
     else
     {
-	return !!(DMA2->ISR & (DMA_ISR_TCIF1 << shift));
+	/* Without a source the ring has been primed by the caller, and gets refilled
+	 * half by half from the callback.
+	 */
+	pipe->state = DMA_PIPE_STATE_ACTIVE;
+
+	stm32l4_dma_start_circular(pipe->sink, pipe->sink_data, pipe->data, pipe->count,
+				   (pipe->sink_option | DMA_OPTION_MEMORY_TO_PERIPHERAL | DMA_OPTION_MEMORY_DATA_INCREMENT | DMA_OPTION_EVENT_TRANSFER_ERROR));
     }
+
+    return true;
 }
 
-void stm32l4_dma_poll(stm32l4_dma_t *dma)
+void stm32l4_dma_pipe_stop(stm32l4_dma_pipe_t *pipe)
+{
+    if ((pipe->state != DMA_PIPE_STATE_PRIME) && (pipe->state != DMA_PIPE_STATE_ACTIVE))
+    {
+	return;
+    }
+
+    if (pipe->source)
+    {
+	stm32l4_dma_pipe_detach(pipe->source, pipe->source_callback, pipe->source_context);
+    }
+
+    stm32l4_dma_pipe_detach(pipe->sink, pipe->sink_callback, pipe->sink_context);
+
+    pipe->state = DMA_PIPE_STATE_READY;
+}
+
+#define DMA_CHAIN_OPTION(_option) \
+    (((_option) & ~(DMA_OPTION_CIRCULAR | DMA_OPTION_EVENT_TRANSFER_HALF)) | DMA_OPTION_EVENT_TRANSFER_DONE | DMA_OPTION_EVENT_TRANSFER_ERROR)
+
+static __fastcode __optimize_speed void stm32l4_dma_chain_callback(stm32l4_dma_chain_t *chain, uint32_t events)
+{
+    const stm32l4_dma_descriptor_t *descriptor, *next;
+
+    if (chain->state != DMA_CHAIN_STATE_ACTIVE)
+    {
+	return;
+    }
+
+    descriptor = chain->current;
+
+    if (!(events & DMA_EVENT_TRANSFER_ERROR))
+    {
+	if (!(events & DMA_EVENT_TRANSFER_DONE))
+	{
+	    return;
+	}
+
+	next = descriptor->next;
+
+	if (next)
+	{
+	    /* Restart the channel first, the callback is not time critical.
+	     */
+	    chain->current = next;
+
+	    stm32l4_dma_transfer(chain->dma, next->tx_data, next->rx_data, next->xf_count, DMA_CHAIN_OPTION(next->option));
+
+	    if ((descriptor->option & DMA_OPTION_EVENT_TRANSFER_DONE) && chain->callback)
+	    {
+		(*chain->callback)(chain->context, DMA_EVENT_DESCRIPTOR_DONE);
+	    }
+
+	    return;
+	}
+    }
+
+    stm32l4_dma_pipe_detach(chain->dma, chain->dma_callback, chain->dma_context);
+
+    chain->state = DMA_CHAIN_STATE_READY;
+
+    if (chain->callback)
+    {
+	(*chain->callback)(chain->context, ((events & DMA_EVENT_TRANSFER_ERROR) ? DMA_EVENT_TRANSFER_ERROR : DMA_EVENT_TRANSFER_DONE));
+    }
+}
+
+void stm32l4_dma_chain_create(stm32l4_dma_chain_t *chain)
+{
+    chain->dma = NULL;
+    chain->current = NULL;
+    chain->dma_callback = NULL;
+    chain->dma_context = NULL;
+    chain->callback = NULL;
+    chain->context = NULL;
+
+    chain->state = DMA_CHAIN_STATE_READY;
+}
+
+/* "dma" has to be created and enabled by its driver. Its callback is restored once
+ * the chain ends.
+ */
+bool stm32l4_dma_chain_start(stm32l4_dma_chain_t *chain, stm32l4_dma_t *dma, const stm32l4_dma_descriptor_t *descriptor, stm32l4_dma_callback_t callback, void *context)
+{
+    if ((chain->state != DMA_CHAIN_STATE_READY) || (dma->flags & DMA_FLAG_SHARED) || !descriptor)
+    {
+	return false;
+    }
+
+    chain->dma = dma;
+    chain->current = descriptor;
+    chain->callback = callback;
+    chain->context = context;
+
+    stm32l4_dma_pipe_attach(dma, (stm32l4_dma_callback_t)stm32l4_dma_chain_callback, chain, &chain->dma_callback, &chain->dma_context);
+
+    chain->state = DMA_CHAIN_STATE_ACTIVE;
+
+    stm32l4_dma_transfer(dma, descriptor->tx_data, descriptor->rx_data, descriptor->xf_count, DMA_CHAIN_OPTION(descriptor->option));
+
+    return true;
+}
+
+void stm32l4_dma_chain_stop(stm32l4_dma_chain_t *chain)
+{
+    if (chain->state != DMA_CHAIN_STATE_ACTIVE)
+    {
+	return;
+    }
+
+    stm32l4_dma_pipe_detach(chain->dma, chain->dma_callback, chain->dma_context);
+
+    chain->state = DMA_CHAIN_STATE_READY;
+}
+
+/* The descriptor in flight, or NULL if the chain is not active.
+ */
+const stm32l4_dma_descriptor_t *stm32l4_dma_chain_current(stm32l4_dma_chain_t *chain)
 {
-    stm32l4_dma_interrupt(dma);
+    return ((chain->state == DMA_CHAIN_STATE_ACTIVE) ? chain->current : NULL);
 }
 
-void DMA1_Channel1_IRQHandler(void)
+__fastcode void DMA1_Channel1_IRQHandler(void)
 {
     stm32l4_dma_interrupt(stm32l4_dma_driver.instances[DMA_CHANNEL_DMA1_CH1_INDEX]);
 }
 
-void DMA1_Channel2_IRQHandler(void)
+__fastcode void DMA1_Channel2_IRQHandler(void)
 {
     stm32l4_dma_interrupt(stm32l4_dma_driver.instances[DMA_CHANNEL_DMA1_CH2_INDEX]);
 }
 
-void DMA1_Channel3_IRQHandler(void)
+__fastcode void DMA1_Channel3_IRQHandler(void)
 {
     stm32l4_dma_interrupt(stm32l4_dma_driver.instances[DMA_CHANNEL_DMA1_CH3_INDEX]);
 }
 
-void DMA1_Channel4_IRQHandler(void)
+__fastcode void DMA1_Channel4_IRQHandler(void)
 {
     stm32l4_dma_interrupt(stm32l4_dma_driver.instances[DMA_CHANNEL_DMA1_CH4_INDEX]);
 }
 
-void DMA1_Channel5_IRQHandler(void)
+__fastcode void DMA1_Channel5_IRQHandler(void)
 {
     stm32l4_dma_interrupt(stm32l4_dma_driver.instances[DMA_CHANNEL_DMA1_CH5_INDEX]);
 }
 
-void DMA1_Channel6_IRQHandler(void)
+__fastcode void DMA1_Channel6_IRQHandler(void)
 {
     stm32l4_dma_interrupt(stm32l4_dma_driver.instances[DMA_CHANNEL_DMA1_CH6_INDEX]);
 }
 
-void DMA1_Channel7_IRQHandler(void)
+__fastcode void DMA1_Channel7_IRQHandler(void)
 {
     stm32l4_dma_interrupt(stm32l4_dma_driver.instances[DMA_CHANNEL_DMA1_CH7_INDEX]);
 }
 
-void DMA2_Channel1_IRQHandler(void)
+__fastcode void DMA2_Channel1_IRQHandler(void)
 {
     stm32l4_dma_interrupt(stm32l4_dma_driver.instances[DMA_CHANNEL_DMA2_CH1_INDEX]);
 }
 
-void DMA2_Channel2_IRQHandler(void)
+__fastcode void DMA2_Channel2_IRQHandler(void)
 {
     stm32l4_dma_interrupt(stm32l4_dma_driver.instances[DMA_CHANNEL_DMA2_CH2_INDEX]);
 }
 
-void DMA2_Channel3_IRQHandler(void)
+__fastcode void DMA2_Channel3_IRQHandler(void)
 {
     stm32l4_dma_interrupt(stm32l4_dma_driver.instances[DMA_CHANNEL_DMA2_CH3_INDEX]);
 }
 
-void DMA2_Channel4_IRQHandler(void)
+__fastcode void DMA2_Channel4_IRQHandler(void)
 {
     stm32l4_dma_interrupt(stm32l4_dma_driver.instances[DMA_CHANNEL_DMA2_CH4_INDEX]);
 }
 
-void DMA2_Channel5_IRQHandler(void)
+__fastcode void DMA2_Channel5_IRQHandler(void)
 {
     stm32l4_dma_interrupt(stm32l4_dma_driver.instances[DMA_CHANNEL_DMA2_CH5_INDEX]);
 }
 
-void DMA2_Channel6_IRQHandler(void)
+__fastcode void DMA2_Channel6_IRQHandler(void)
 {
     stm32l4_dma_interrupt(stm32l4_dma_driver.instances[DMA_CHANNEL_DMA2_CH6_INDEX]);
 }
 
-void DMA2_Channel7_IRQHandler(void)
+__fastcode void DMA2_Channel7_IRQHandler(void)
 {
     stm32l4_dma_interrupt(stm32l4_dma_driver.instances[DMA_CHANNEL_DMA2_CH7_INDEX]);
 }
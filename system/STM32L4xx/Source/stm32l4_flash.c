@@ -86,6 +86,210 @@ uint32_t stm32l4_flash_size(void)
     return *((volatile uint16_t*)0x1fff75e0) * 1024;
 }
 
+#if defined(STM32L476xx) || defined(STM32L496xx)
+
+/* On dual bank parts the bank that is not executing code (the upper half of the flash,
+ * as the boot code leaves FB_MODE cleared) can be erased/programmed while the CPU keeps
+ * running from the other one. One page erase or one double word program is started at
+ * a time, and FLASH_IRQHandler() starts the next one on EOP.
+ */
+
+#define FLASH_STATE_NONE    0
+#define FLASH_STATE_ERASE   1
+#define FLASH_STATE_PROGRAM 2
+
+typedef struct _stm32l4_flash_device_t {
+    volatile uint32_t        state;
+    uint32_t                 address;
+    uint32_t                 count;
+    const uint8_t            *data;
+    stm32l4_flash_callback_t callback;
+    void                     *context;
+} stm32l4_flash_device_t;
+
+static stm32l4_flash_device_t stm32l4_flash_device;
+
+static void stm32l4_flash_start(void)
+{
+    stm32l4_flash_device_t *device = &stm32l4_flash_device;
+    const uint32_t flash_split = (FLASH_BASE + (stm32l4_flash_size() >> 1));
+    volatile uint32_t *flash;
+
+    if (device->state == FLASH_STATE_ERASE)
+    {
+	FLASH->CR = FLASH_CR_PER | FLASH_CR_BKER | ((((device->address - flash_split) / 2048) << 3) & FLASH_CR_PNB) | FLASH_CR_EOPIE | FLASH_CR_ERRIE;
+	FLASH->CR |= FLASH_CR_STRT;
+    }
+    else
+    {
+	flash = (volatile uint32_t*)device->address;
+
+	FLASH->CR = FLASH_CR_PG | FLASH_CR_EOPIE | FLASH_CR_ERRIE;
+
+	flash[0] = ((const uint32_t*)((const void*)device->data))[0];
+	flash[1] = ((const uint32_t*)((const void*)device->data))[1];
+
+	__DMB();
+    }
+}
+
+static bool stm32l4_flash_submit(uint32_t state, uint32_t address, const uint8_t *data, uint32_t count, stm32l4_flash_callback_t callback, void *context)
+{
+    stm32l4_flash_device_t *device = &stm32l4_flash_device;
+    const uint32_t flash_size = stm32l4_flash_size();
+    const uint32_t flash_split = (FLASH_BASE + (flash_size >> 1));
+    uint32_t primask;
+
+    if ((FLASH->CR & FLASH_CR_LOCK) || (count == 0) || (address < flash_split) || (count > ((FLASH_BASE + flash_size) - address)))
+    {
+	return false;
+    }
+
+    primask = __get_PRIMASK();
+
+    __disable_irq();
+
+    if (device->state != FLASH_STATE_NONE)
+    {
+	__set_PRIMASK(primask);
+
+	return false;
+    }
+
+    device->state = state;
+    device->address = address;
+    device->count = count;
+    device->data = data;
+    device->callback = callback;
+    device->context = context;
+
+    FLASH->SR = (FLASH_SR_EOP | FLASH_SR_OPERR | FLASH_SR_PROGERR | FLASH_SR_SIZERR | FLASH_SR_PGAERR | FLASH_SR_PGSERR | FLASH_SR_WRPERR | FLASH_SR_MISERR | FLASH_SR_FASTERR | FLASH_SR_RDERR);
+
+    stm32l4_flash_start();
+
+    __set_PRIMASK(primask);
+
+    return true;
+}
+
+void FLASH_IRQHandler(void)
+{
+    stm32l4_flash_device_t *device = &stm32l4_flash_device;
+    stm32l4_flash_callback_t callback;
+    uint32_t flash_sr, flash_acr;
+    bool success;
+
+    flash_sr = FLASH->SR;
+
+    FLASH->SR = (FLASH_SR_EOP | FLASH_SR_OPERR | FLASH_SR_PROGERR | FLASH_SR_SIZERR | FLASH_SR_PGAERR | FLASH_SR_PGSERR | FLASH_SR_WRPERR | FLASH_SR_MISERR | FLASH_SR_FASTERR | FLASH_SR_RDERR);
+
+    if (device->state == FLASH_STATE_NONE)
+    {
+	FLASH->CR &= ~(FLASH_CR_EOPIE | FLASH_CR_ERRIE);
+
+	return;
+    }
+
+    if (flash_sr & (FLASH_SR_OPERR | FLASH_SR_PROGERR | FLASH_SR_SIZERR | FLASH_SR_PGAERR | FLASH_SR_PGSERR | FLASH_SR_WRPERR | FLASH_SR_MISERR | FLASH_SR_FASTERR | FLASH_SR_RDERR))
+    {
+	success = false;
+    }
+    else
+    {
+	if (!(flash_sr & FLASH_SR_EOP))
+	{
+	    return;
+	}
+
+	if (device->state == FLASH_STATE_ERASE)
+	{
+	    device->address += 2048;
+	    device->count   -= 2048;
+	}
+	else
+	{
+	    device->address += 8;
+	    device->data    += 8;
+	    device->count   -= 8;
+	}
+
+	if (device->count)
+	{
+	    stm32l4_flash_start();
+
+	    return;
+	}
+
+	success = true;
+    }
+
+    FLASH->CR = 0;
+
+    /* The caches may hold stale data of the modified range.
+     */
+    flash_acr = FLASH->ACR;
+
+    FLASH->ACR = flash_acr & ~(FLASH_ACR_ICEN | FLASH_ACR_DCEN);
+    FLASH->ACR = (flash_acr & ~(FLASH_ACR_ICEN | FLASH_ACR_DCEN)) | (FLASH_ACR_ICRST | FLASH_ACR_DCRST);
+    FLASH->ACR = flash_acr;
+
+    callback = device->callback;
+
+    device->state = FLASH_STATE_NONE;
+
+    if (callback)
+    {
+	(*callback)(device->context, success);
+    }
+}
+
+#endif /* defined(STM32L476xx) || defined(STM32L496xx) */
+
+void stm32l4_flash_configure(unsigned int priority)
+{
+#if defined(STM32L476xx) || defined(STM32L496xx)
+    NVIC_SetPriority(FLASH_IRQn, priority);
+    NVIC_EnableIRQ(FLASH_IRQn);
+#endif /* defined(STM32L476xx) || defined(STM32L496xx) */
+}
+
+bool stm32l4_flash_erase_async(uint32_t address, uint32_t count, stm32l4_flash_callback_t callback, void *context)
+{
+#if defined(STM32L476xx) || defined(STM32L496xx)
+    if ((address & 2047) || (count & 2047))
+    {
+	return false;
+    }
+
+    return stm32l4_flash_submit(FLASH_STATE_ERASE, address, NULL, count, callback, context);
+#else /* defined(STM32L476xx) || defined(STM32L496xx) */
+    return false;
+#endif /* defined(STM32L476xx) || defined(STM32L496xx) */
+}
+
+bool stm32l4_flash_program_async(uint32_t address, const uint8_t *data, uint32_t count, stm32l4_flash_callback_t callback, void *context)
+{
+#if defined(STM32L476xx) || defined(STM32L496xx)
+    if ((address & 7) || (count & 7) || ((uint32_t)data & 3))
+    {
+	return false;
+    }
+
+    return stm32l4_flash_submit(FLASH_STATE_PROGRAM, address, data, count, callback, context);
+#else /* defined(STM32L476xx) || defined(STM32L496xx) */
+    return false;
+#endif /* defined(STM32L476xx) || defined(STM32L496xx) */
+}
+
+bool stm32l4_flash_busy(void)
+{
+#if defined(STM32L476xx) || defined(STM32L496xx)
+    return (stm32l4_flash_device.state != FLASH_STATE_NONE);
+#else /* defined(STM32L476xx) || defined(STM32L496xx) */
+    return false;
+#endif /* defined(STM32L476xx) || defined(STM32L496xx) */
+}
+
 bool stm32l4_flash_unlock(void)
 {
     uint32_t primask;
@@ -122,7 +326,7 @@ bool stm32l4_flash_erase(uint32_t address, uint32_t count)
 #endif /* defined(STM32L476xx) || defined(STM32L496xx) */
     uint32_t primask, flash_acr;
 
-    if (FLASH->CR & FLASH_CR_LOCK)
+    if ((FLASH->CR & FLASH_CR_LOCK) || stm32l4_flash_busy())
     {
 	return false;
     }
@@ -177,7 +381,7 @@ bool stm32l4_flash_program(uint32_t address, const uint8_t *data, uint32_t count
     bool success = true;
     uint32_t primask, flash_acr, chunk;
 
-    if (FLASH->CR & FLASH_CR_LOCK)
+    if ((FLASH->CR & FLASH_CR_LOCK) || stm32l4_flash_busy())
     {
 	return false;
     }
@@ -57,6 +57,26 @@ static stm32l4_i2c_driver_t stm32l4_i2c_driver;
      DMA_OPTION_MEMORY_DATA_INCREMENT |	  \
      DMA_OPTION_PRIORITY_MEDIUM)
 
+/*
+ * TIMINGR for 10kHz, 100kHz, 400kHz and 1MHz, from RM0351 for 16MHz. The kernel
+ * clock is always HSI16 (see stm32l4_i2c_enable()), so the values do not depend
+ * on SYSCLK/PCLK1, and switching the bus clock is a table lookup.
+ */
+static const uint32_t stm32l4_i2c_xlate_TIMINGR[4] = {
+    0x3042c3c7,
+    0x30420f13,
+    0x10320309,
+    0x00200106,
+};
+
+static unsigned int stm32l4_i2c_clock_index(uint32_t clock)
+{
+    if      (clock >= 1000000) { return 3; }
+    else if (clock >=  400000) { return 2; }
+    else if (clock >=  100000) { return 1; }
+    else                       { return 0; }
+}
+
 static void stm32l4_i2c_start(stm32l4_i2c_t *i2c)
 {
     stm32l4_system_periph_enable(SYSTEM_PERIPH_I2C1 + i2c->instance);
@@ -99,6 +119,54 @@ static void stm32l4_i2c_stop(stm32l4_i2c_t *i2c)
     stm32l4_system_periph_disable(SYSTEM_PERIPH_I2C1 + i2c->instance);
 }
 
+/*
+ * Select the clock for the next master transfer. TIMINGR can only be written
+ * with PE cleared, which is harmless while the master is idle. FM+ drive is
+ * switched along with it; pins affected by the FM+ erratum (fmp == 0) fall
+ * back to 400kHz.
+ */
+static void stm32l4_i2c_timing(stm32l4_i2c_t *i2c, uint32_t control)
+{
+    I2C_TypeDef *I2C = i2c->I2C;
+    unsigned int index;
+    uint32_t i2c_cr1, i2c_timingr;
+
+    if (control & I2C_CONTROL_CLOCK_MASK)
+    {
+	index = ((control & I2C_CONTROL_CLOCK_MASK) >> I2C_CONTROL_CLOCK_SHIFT) -1;
+    }
+    else
+    {
+	index = stm32l4_i2c_clock_index(i2c->clock);
+    }
+
+    if ((index == 3) && !i2c->fmp)
+    {
+	index = 2;
+    }
+
+    i2c_timingr = stm32l4_i2c_xlate_TIMINGR[index];
+
+    if (I2C->TIMINGR != i2c_timingr)
+    {
+	i2c_cr1 = I2C->CR1;
+
+	I2C->CR1 = i2c_cr1 & ~I2C_CR1_PE;
+
+	if (index == 3)
+	{
+	    armv7m_atomic_or(&SYSCFG->CFGR1, i2c->fmp);
+	}
+	else
+	{
+	    armv7m_atomic_and(&SYSCFG->CFGR1, ~i2c->fmp);
+	}
+
+	I2C->TIMINGR = i2c_timingr;
+	I2C->CR1 = i2c_cr1;
+    }
+}
+
 static void stm32l4_i2c_master_receive(stm32l4_i2c_t *i2c)
 {
     I2C_TypeDef *I2C = i2c->I2C;
@@ -714,23 +782,23 @@ bool stm32l4_i2c_create(stm32l4_i2c_t *i2c, unsigned int instance, const stm32l4
     {
 	switch (i2c->instance) {
 	case I2C_INSTANCE_I2C1:
-	    if ((!(mode & I2C_MODE_RX_DMA_SECONDARY) && stm32l4_dma_create(&i2c->rx_dma, DMA_CHANNEL_DMA1_CH7_I2C1_RX, i2c->priority)) ||
-		stm32l4_dma_create(&i2c->rx_dma, DMA_CHANNEL_DMA2_CH6_I2C1_RX, i2c->priority))
+	    if ((!(mode & I2C_MODE_RX_DMA_SECONDARY) && stm32l4_dma_create_shared(&i2c->rx_dma, DMA_CHANNEL_DMA1_CH7_I2C1_RX, i2c->priority)) ||
+		stm32l4_dma_create_shared(&i2c->rx_dma, DMA_CHANNEL_DMA2_CH6_I2C1_RX, i2c->priority))
 	    {
 		i2c->mode |= I2C_MODE_RX_DMA;
 	    }
 	    break;
 #ifdef I2C2_BASE
 	case I2C_INSTANCE_I2C2:
-	    if (stm32l4_dma_create(&i2c->rx_dma, DMA_CHANNEL_DMA1_CH5_I2C2_RX, i2c->priority)) { i2c->mode |= I2C_MODE_RX_DMA; }
+	    if (stm32l4_dma_create_shared(&i2c->rx_dma, DMA_CHANNEL_DMA1_CH5_I2C2_RX, i2c->priority)) { i2c->mode |= I2C_MODE_RX_DMA; }
 	    break;
 #endif
 	case I2C_INSTANCE_I2C3:
-	    if (stm32l4_dma_create(&i2c->rx_dma, DMA_CHANNEL_DMA1_CH3_I2C3_RX, i2c->priority)) { i2c->mode |= I2C_MODE_RX_DMA; }
+	    if (stm32l4_dma_create_shared(&i2c->rx_dma, DMA_CHANNEL_DMA1_CH3_I2C3_RX, i2c->priority)) { i2c->mode |= I2C_MODE_RX_DMA; }
 	    break;
 #ifdef I2C4_BASE
 	case I2C_INSTANCE_I2C4:
-	    if (stm32l4_dma_create(&i2c->rx_dma, DMA_CHANNEL_DMA2_CH1_I2C4_RX, i2c->priority)) { i2c->mode |= I2C_MODE_RX_DMA; }
+	    if (stm32l4_dma_create_shared(&i2c->rx_dma, DMA_CHANNEL_DMA2_CH1_I2C4_RX, i2c->priority)) { i2c->mode |= I2C_MODE_RX_DMA; }
 	    break;
 #endif
 	}
@@ -740,23 +808,23 @@ bool stm32l4_i2c_create(stm32l4_i2c_t *i2c, unsigned int instance, const stm32l4
     {
 	switch (i2c->instance) {
 	case I2C_INSTANCE_I2C1:
-	    if ((!(mode & I2C_MODE_TX_DMA_SECONDARY) && stm32l4_dma_create(&i2c->tx_dma, DMA_CHANNEL_DMA1_CH6_I2C1_TX, i2c->priority)) ||
-		stm32l4_dma_create(&i2c->tx_dma, DMA_CHANNEL_DMA2_CH7_I2C1_TX, i2c->priority))
+	    if ((!(mode & I2C_MODE_TX_DMA_SECONDARY) && stm32l4_dma_create_shared(&i2c->tx_dma, DMA_CHANNEL_DMA1_CH6_I2C1_TX, i2c->priority)) ||
+		stm32l4_dma_create_shared(&i2c->tx_dma, DMA_CHANNEL_DMA2_CH7_I2C1_TX, i2c->priority))
 	    {
 		i2c->mode |= I2C_MODE_TX_DMA;
 	    }
 	    break;
 #ifdef I2C2_BASE
 	case I2C_INSTANCE_I2C2:
-	    if (stm32l4_dma_create(&i2c->tx_dma, DMA_CHANNEL_DMA1_CH4_I2C2_TX, i2c->priority)) { i2c->mode |= I2C_MODE_TX_DMA; }
+	    if (stm32l4_dma_create_shared(&i2c->tx_dma, DMA_CHANNEL_DMA1_CH4_I2C2_TX, i2c->priority)) { i2c->mode |= I2C_MODE_TX_DMA; }
 	    break;
 #endif
 	case I2C_INSTANCE_I2C3:
-	    if (stm32l4_dma_create(&i2c->tx_dma, DMA_CHANNEL_DMA1_CH2_I2C3_TX, i2c->priority)) { i2c->mode |= I2C_MODE_TX_DMA; }
+	    if (stm32l4_dma_create_shared(&i2c->tx_dma, DMA_CHANNEL_DMA1_CH2_I2C3_TX, i2c->priority)) { i2c->mode |= I2C_MODE_TX_DMA; }
 	    break;
 #ifdef I2C4_BASE
 	case I2C_INSTANCE_I2C4:
-	    if (stm32l4_dma_create(&i2c->tx_dma, DMA_CHANNEL_DMA2_CH2_I2C4_TX, i2c->priority)) { i2c->mode |= I2C_MODE_TX_DMA; }
+	    if (stm32l4_dma_create_shared(&i2c->tx_dma, DMA_CHANNEL_DMA2_CH2_I2C4_TX, i2c->priority)) { i2c->mode |= I2C_MODE_TX_DMA; }
 	    break;
 #endif
 	}
@@ -913,6 +981,7 @@ bool stm32l4_i2c_configure(stm32l4_i2c_t *i2c, uint32_t clock, uint32_t option)
 {
     I2C_TypeDef *I2C = i2c->I2C;
     uint32_t pin_scl, pin_sda, i2c_cr1, i2c_cr2, i2c_oar1, i2c_oar2, i2c_timingr, syscfg_cfgr1;
+    bool fmp;
 
     if ((i2c->state != I2C_STATE_READY) && (i2c->state != I2C_STATE_BUSY))
     {
@@ -927,14 +996,20 @@ bool stm32l4_i2c_configure(stm32l4_i2c_t *i2c, uint32_t clock, uint32_t option)
     pin_scl = i2c->pins.scl;
     pin_sda = i2c->pins.sda;
 
+    fmp = true;
+
 #if defined(STM32L476xx)
     /* Silicon ERRATA 2.6.1. FM+ is not working on all pins.
      */
-    if ((clock == 1000000) &&
-	((pin_scl == GPIO_PIN_PB10_I2C2_SCL) || (pin_scl == GPIO_PIN_PF1_I2C2_SCL) || (pin_scl == GPIO_PIN_PG14_I2C1_SCL) ||
-	 (pin_sda == GPIO_PIN_PB11_I2C2_SDA) || (pin_sda == GPIO_PIN_PF0_I2C2_SDA) || (pin_sda == GPIO_PIN_PG13_I2C1_SDA)))
+    if ((pin_scl == GPIO_PIN_PB10_I2C2_SCL) || (pin_scl == GPIO_PIN_PF1_I2C2_SCL) || (pin_scl == GPIO_PIN_PG14_I2C1_SCL) ||
+	(pin_sda == GPIO_PIN_PB11_I2C2_SDA) || (pin_sda == GPIO_PIN_PF0_I2C2_SDA) || (pin_sda == GPIO_PIN_PG13_I2C1_SDA))
     {
-	return false;
+	if (clock == 1000000)
+	{
+	    return false;
+	}
+
+	fmp = false;
     }
 #endif /* defined(STM32L476xx) */
 
@@ -965,18 +1040,7 @@ bool stm32l4_i2c_configure(stm32l4_i2c_t *i2c, uint32_t clock, uint32_t option)
     i2c_cr2 = 0;
     i2c_oar1 = 0;
     i2c_oar2 = 0;
-    i2c_timingr = 0;
-
-    /*
-     * This is from RM0351 for 16MHz, i.e. HSI.
-     */
-    
-    switch (i2c->clock) {
-    case   10000: i2c_timingr = 0x3042c3c7; break;
-    case  100000: i2c_timingr = 0x30420f13; break;
-    case  400000: i2c_timingr = 0x10320309; break;
-    case 1000000: i2c_timingr = 0x00200106; break;
-    }
+    i2c_timingr = stm32l4_i2c_xlate_TIMINGR[stm32l4_i2c_clock_index(i2c->clock)];
     
     if (i2c->option & I2C_OPTION_ADDRESS_MASK)
     {
@@ -1040,6 +1104,8 @@ bool stm32l4_i2c_configure(stm32l4_i2c_t *i2c, uint32_t clock, uint32_t option)
 #endif
     }
 
+    i2c->fmp = fmp ? syscfg_cfgr1 : 0;
+
     if (i2c->clock == 1000000)
     {
 	armv7m_atomic_or(&SYSCFG->CFGR1, syscfg_cfgr1);
@@ -1191,6 +1257,8 @@ bool stm32l4_i2c_receive(stm32l4_i2c_t *i2c, uint16_t address, uint8_t *rx_data,
     if ((i2c->state == I2C_STATE_READY) && !(i2c->option & I2C_OPTION_ADDRESS_MASK))
     {
 	stm32l4_i2c_start(i2c);
+
+	stm32l4_i2c_timing(i2c, control);
     }
 
     stm32l4_i2c_master_receive(i2c);
@@ -1216,6 +1284,8 @@ bool stm32l4_i2c_transmit(stm32l4_i2c_t *i2c, uint16_t address, const uint8_t *t
     if ((i2c->state == I2C_STATE_READY) && !(i2c->option & I2C_OPTION_ADDRESS_MASK))
     {
 	stm32l4_i2c_start(i2c);
+
+	stm32l4_i2c_timing(i2c, control);
     }
 
     stm32l4_i2c_master_transmit(i2c);
@@ -1241,6 +1311,8 @@ bool stm32l4_i2c_transfer(stm32l4_i2c_t *i2c, uint16_t address, const uint8_t *t
     if ((i2c->state == I2C_STATE_READY) && !(i2c->option & I2C_OPTION_ADDRESS_MASK))
     {
 	stm32l4_i2c_start(i2c);
+
+	stm32l4_i2c_timing(i2c, control);
     }
 
     stm32l4_i2c_master_transmit(i2c);
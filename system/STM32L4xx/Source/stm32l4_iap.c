@@ -0,0 +1,450 @@
+/*
+ * Copyright (c) 2017 Thomas Roell.  All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal with the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ *  1. Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimers.
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimers in the
+ *     documentation and/or other materials provided with the distribution.
+ *  3. Neither the name of Thomas Roell, nor the names of its contributors
+ *     may be used to endorse or promote products derived from this Software
+ *     without specific prior written permission.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ * CONTRIBUTORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * WITH THE SOFTWARE.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "armv7m.h"
+
+#include "stm32l4xx.h"
+#include "stm32l4_iap.h"
+#include "stm32l4_crc.h"
+#include "stm32l4_flash.h"
+#include "dosfs_api.h"
+
+extern uint32_t __FlashBase;
+extern uint32_t __FlashLimit;
+
+#define IAP_PAGE_SIZE        2048
+#define IAP_BOOT_SIZE        1024   /* boot block at FLASH_BASE, not part of the image */
+#define IAP_INFO_OFFSET      460    /* stm32l4_iap_info_t within the image */
+
+#define IAP_FLASH_SR_ERRORS  (FLASH_SR_OPERR | FLASH_SR_PROGERR | FLASH_SR_SIZERR | FLASH_SR_PGAERR | FLASH_SR_PGSERR | FLASH_SR_WRPERR | FLASH_SR_MISERR | FLASH_SR_FASTERR | FLASH_SR_RDERR)
+
+typedef struct _stm32l4_iap_device_t {
+    uint32_t      address;   /* staged copy of FLASH_BASE, 0 if none */
+    uint32_t      size;      /* boot block plus image, rounded up to a page */
+} stm32l4_iap_device_t;
+
+static stm32l4_iap_device_t stm32l4_iap_device;
+
+static uint32_t stm32l4_iap_buffer[IAP_PAGE_SIZE / sizeof(uint32_t)] __noinit;
+
+/* The DFU suffix CRC is a CRC32 (zlib) without the final inversion. The CRC unit is used
+ * if it's available, a bitwise version otherwise.
+ */
+typedef struct _stm32l4_iap_crc_t {
+    bool          hardware;
+    uint32_t      value;
+} stm32l4_iap_crc_t;
+
+static void stm32l4_iap_crc_begin(stm32l4_iap_crc_t *crc)
+{
+    crc->hardware = stm32l4_crc_acquire(0x04c11db7, 0xffffffff, CRC_OPTION_POLYSIZE_32 | CRC_OPTION_REVERSE_INPUT | CRC_OPTION_REVERSE_OUTPUT);
+    crc->value = 0xffffffff;
+}
+
+static void stm32l4_iap_crc_update(stm32l4_iap_crc_t *crc, const uint8_t *data, uint32_t count)
+{
+    uint32_t value;
+    unsigned int i;
+
+    if (crc->hardware)
+    {
+	stm32l4_crc_update(data, count);
+    }
+    else
+    {
+	value = crc->value;
+
+	while (count--)
+	{
+	    value ^= *data++;
+
+	    for (i = 0; i < 8; i++)
+	    {
+		value = (value >> 1) ^ (0xedb88320 & -(value & 1));
+	    }
+	}
+
+	crc->value = value;
+    }
+}
+
+static uint32_t stm32l4_iap_crc_end(stm32l4_iap_crc_t *crc)
+{
+    if (crc->hardware)
+    {
+	crc->value = stm32l4_crc_value();
+
+	stm32l4_crc_release();
+    }
+
+    return crc->value;
+}
+
+static bool stm32l4_iap_check_suffix(const stm32l4_iap_suffix_t *suffix)
+{
+    return ((suffix->bLength == sizeof(stm32l4_iap_suffix_t)) &&
+	    (suffix->ucDfuSeSignature[0] == 'U') &&
+	    (suffix->ucDfuSeSignature[1] == 'F') &&
+	    (suffix->ucDfuSeSignature[2] == 'D') &&
+	    (suffix->idVendor == stm32l4_iap_prefix.idVendor) &&
+	    (suffix->idProduct == stm32l4_iap_prefix.idProduct));
+}
+
+static bool stm32l4_iap_check_image(const uint8_t *image, uint32_t size)
+{
+    const stm32l4_iap_info_t *info = (const stm32l4_iap_info_t*)((const void*)(image + IAP_INFO_OFFSET));
+    const stm32l4_iap_info_t *current = (const stm32l4_iap_info_t*)(FLASH_BASE + IAP_BOOT_SIZE + IAP_INFO_OFFSET);
+    uint32_t reset;
+
+    /* Same MCU as the running sketch, and a reset vector within the image.
+     */
+    if ((info->length != sizeof(stm32l4_iap_info_t)) || memcmp(&info->signature[0], &current->signature[0], sizeof(info->signature)))
+    {
+	return false;
+    }
+
+    if ((info->address != current->address) || (((info->address - (FLASH_BASE + IAP_BOOT_SIZE)) + info->size) > size))
+    {
+	return false;
+    }
+
+    reset = ((const uint32_t*)((const void*)image))[1] & ~1;
+
+    return ((reset >= (FLASH_BASE + IAP_BOOT_SIZE)) && (reset < (FLASH_BASE + IAP_BOOT_SIZE + size)));
+}
+
+int stm32l4_iap_stage(const char *path)
+{
+    stm32l4_iap_device_t *device = &stm32l4_iap_device;
+    uint8_t *data = (uint8_t*)&stm32l4_iap_buffer[0];
+    stm32l4_iap_suffix_t suffix;
+    stm32l4_iap_crc_t crc;
+    F_FILE *file;
+    uint32_t length, size, total, address, flash_base, flash_limit, offset, count, used;
+    bool success;
+    int status;
+
+    device->address = 0;
+    device->size = 0;
+
+    file = f_open(path, "r");
+
+    if (!file)
+    {
+	return IAP_STATUS_NOT_FOUND;
+    }
+
+    status = IAP_STATUS_SUCCESS;
+
+    length = f_length(file);
+
+    if (length < (IAP_INFO_OFFSET + sizeof(stm32l4_iap_info_t) + sizeof(stm32l4_iap_suffix_t)))
+    {
+	status = IAP_STATUS_INVALID_IMAGE;
+    }
+
+    if (status == IAP_STATUS_SUCCESS)
+    {
+	if ((f_seek(file, length - sizeof(stm32l4_iap_suffix_t), F_SEEK_SET) != F_NO_ERROR) ||
+	    (f_read(&suffix, 1, sizeof(stm32l4_iap_suffix_t), file) != sizeof(stm32l4_iap_suffix_t)) ||
+	    (f_seek(file, 0, F_SEEK_SET) != F_NO_ERROR))
+	{
+	    status = IAP_STATUS_NOT_FOUND;
+	}
+	else
+	{
+	    if (!stm32l4_iap_check_suffix(&suffix))
+	    {
+		status = IAP_STATUS_INVALID_IMAGE;
+	    }
+	}
+    }
+
+    size = length - sizeof(stm32l4_iap_suffix_t);
+    total = (IAP_BOOT_SIZE + size + (IAP_PAGE_SIZE -1)) & ~(IAP_PAGE_SIZE -1);
+    address = 0;
+
+    if (status == IAP_STATUS_SUCCESS)
+    {
+	/* The staged copy goes to the top of the free flash. It must not overlap the running
+	 * sketch, nor the range the new image is copied to later on.
+	 */
+	flash_base = ((uint32_t)&__FlashBase + (IAP_PAGE_SIZE -1)) & ~(IAP_PAGE_SIZE -1);
+	flash_limit = (uint32_t)&__FlashLimit & ~(IAP_PAGE_SIZE -1);
+
+	if ((flash_limit - flash_base) < total)
+	{
+	    status = IAP_STATUS_TOO_LARGE;
+	}
+	else
+	{
+	    address = flash_limit - total;
+
+	    if (address < (FLASH_BASE + total))
+	    {
+		status = IAP_STATUS_TOO_LARGE;
+	    }
+	}
+    }
+
+    if (status == IAP_STATUS_SUCCESS)
+    {
+	stm32l4_iap_crc_begin(&crc);
+
+	stm32l4_flash_unlock();
+
+	for (offset = 0; offset < total; offset += IAP_PAGE_SIZE)
+	{
+	    /* Page "offset" of the new flash contents: the current boot block followed by
+	     * the image, padded with 0xff.
+	     */
+	    used = IAP_PAGE_SIZE;
+
+	    if (used > ((IAP_BOOT_SIZE + size) - offset))
+	    {
+		used = (IAP_BOOT_SIZE + size) - offset;
+	    }
+
+	    if (offset == 0)
+	    {
+		memcpy(&data[0], (const uint8_t*)FLASH_BASE, IAP_BOOT_SIZE);
+
+		count = used - IAP_BOOT_SIZE;
+
+		success = (f_read(&data[IAP_BOOT_SIZE], 1, count, file) == (long)count);
+
+		if (success)
+		{
+		    stm32l4_iap_crc_update(&crc, &data[IAP_BOOT_SIZE], count);
+
+		    if (!stm32l4_iap_check_image(&data[IAP_BOOT_SIZE], size))
+		    {
+			status = IAP_STATUS_INVALID_IMAGE;
+
+			break;
+		    }
+		}
+	    }
+	    else
+	    {
+		count = used;
+
+		success = (f_read(&data[0], 1, count, file) == (long)count);
+
+		if (success)
+		{
+		    stm32l4_iap_crc_update(&crc, &data[0], count);
+		}
+	    }
+
+	    if (!success)
+	    {
+		status = IAP_STATUS_NOT_FOUND;
+
+		break;
+	    }
+
+	    memset(&data[used], 0xff, IAP_PAGE_SIZE - used);
+
+	    /* Only pages that do not hold the data already are erased and programmed, so
+	     * staging the same image again (or an image that differs only in parts) is quick.
+	     */
+	    if (memcmp((const uint8_t*)(address + offset), &data[0], IAP_PAGE_SIZE))
+	    {
+		if (!stm32l4_flash_erase(address + offset, IAP_PAGE_SIZE) ||
+		    !stm32l4_flash_program(address + offset, &data[0], (used + 7) & ~7))
+		{
+		    status = IAP_STATUS_FLASH_ERROR;
+
+		    break;
+		}
+	    }
+	}
+
+	stm32l4_flash_lock();
+
+	stm32l4_iap_crc_update(&crc, (const uint8_t*)&suffix, sizeof(stm32l4_iap_suffix_t) - sizeof(uint32_t));
+
+	if ((stm32l4_iap_crc_end(&crc) != suffix.dwCRC) && (status == IAP_STATUS_SUCCESS))
+	{
+	    status = IAP_STATUS_CRC_MISMATCH;
+	}
+    }
+
+    f_close(file);
+
+    if (status == IAP_STATUS_SUCCESS)
+    {
+	/* Verify the staged copy by reading it back.
+	 */
+	stm32l4_iap_crc_begin(&crc);
+	stm32l4_iap_crc_update(&crc, (const uint8_t*)(address + IAP_BOOT_SIZE), size);
+	stm32l4_iap_crc_update(&crc, (const uint8_t*)&suffix, sizeof(stm32l4_iap_suffix_t) - sizeof(uint32_t));
+
+	if ((stm32l4_iap_crc_end(&crc) != suffix.dwCRC) || memcmp((const uint8_t*)address, (const uint8_t*)FLASH_BASE, IAP_BOOT_SIZE))
+	{
+	    status = IAP_STATUS_FLASH_ERROR;
+	}
+    }
+
+    if (status == IAP_STATUS_SUCCESS)
+    {
+	device->address = address;
+	device->size = total;
+    }
+
+    return status;
+}
+
+/* Runs from SRAM with interrupts disabled, as the code in flash is overwritten. It must
+ * not call anything else (no library functions, no other driver code). A page is only
+ * erased/programmed if it differs from the staged copy, and double words that are
+ * all 0xff are left erased. Passes repeat till nothing needs to be changed anymore.
+ */
+static __fastcode __attribute__((noreturn)) void stm32l4_iap_copy(uint32_t address, uint32_t size)
+{
+    const uint32_t *source;
+    volatile uint32_t *target;
+    uint32_t offset, index, pass;
+    bool modified;
+
+    for (pass = 0; pass < 4; pass++)
+    {
+	modified = false;
+
+	for (offset = 0; offset < size; offset += IAP_PAGE_SIZE)
+	{
+	    IWDG->KR = 0xaaaa;
+
+	    source = (const uint32_t*)(address + offset);
+	    target = (volatile uint32_t*)(FLASH_BASE + offset);
+
+	    for (index = 0; index < (IAP_PAGE_SIZE / sizeof(uint32_t)); index++)
+	    {
+		if (source[index] != target[index])
+		{
+		    break;
+		}
+	    }
+
+	    if (index == (IAP_PAGE_SIZE / sizeof(uint32_t)))
+	    {
+		continue;
+	    }
+
+	    modified = true;
+
+	    /* The image is at most half the flash size, so it's always within the first bank.
+	     */
+	    FLASH->SR = IAP_FLASH_SR_ERRORS;
+	    FLASH->CR = FLASH_CR_PER | (((offset / IAP_PAGE_SIZE) << 3) & FLASH_CR_PNB);
+	    FLASH->CR |= FLASH_CR_STRT;
+
+	    while (FLASH->SR & FLASH_SR_BSY)
+	    {
+	    }
+
+	    FLASH->CR = 0;
+
+	    for (index = 0; index < (IAP_PAGE_SIZE / sizeof(uint32_t)); index += 2)
+	    {
+		if ((source[index +0] & source[index +1]) == 0xffffffff)
+		{
+		    continue;
+		}
+
+		FLASH->SR = IAP_FLASH_SR_ERRORS;
+		FLASH->CR = FLASH_CR_PG;
+
+		target[index +0] = source[index +0];
+		target[index +1] = source[index +1];
+
+		__DMB();
+
+		while (FLASH->SR & FLASH_SR_BSY)
+		{
+		}
+	    }
+
+	    FLASH->CR = 0;
+	}
+
+	if (!modified)
+	{
+	    break;
+	}
+    }
+
+    FLASH->CR = FLASH_CR_LOCK;
+
+    __DSB();
+
+    SCB->AIRCR = ((0x5fa << SCB_AIRCR_VECTKEY_Pos) | (SCB->AIRCR & SCB_AIRCR_PRIGROUP_Msk) | SCB_AIRCR_SYSRESETREQ_Msk);
+
+    __DSB();
+
+    while (1)
+    {
+    }
+}
+
+void stm32l4_iap_apply(void)
+{
+    stm32l4_iap_device_t *device = &stm32l4_iap_device;
+    uint32_t flash_acr;
+
+    if (!device->address)
+    {
+	return;
+    }
+
+    while (stm32l4_flash_busy())
+    {
+    }
+
+    __disable_irq();
+
+    if (FLASH->CR & FLASH_CR_LOCK)
+    {
+	FLASH->KEYR = 0x45670123;
+	FLASH->KEYR = 0xcdef89ab;
+    }
+
+    /* The caches would return stale data of the pages being rewritten.
+     */
+    flash_acr = FLASH->ACR & ~(FLASH_ACR_ICEN | FLASH_ACR_DCEN | FLASH_ACR_ICRST | FLASH_ACR_DCRST);
+
+    FLASH->ACR = flash_acr;
+    FLASH->ACR = flash_acr | (FLASH_ACR_ICRST | FLASH_ACR_DCRST);
+    FLASH->ACR = flash_acr;
+
+    stm32l4_iap_copy(device->address, device->size);
+}
@@ -102,6 +102,8 @@ static stm32l4_qspi_driver_t stm32l4_qspi_driver;
 #define QUADSPI_CR_FTHRES_8                 0x00000700
 #define QUADSPI_CR_FTHRES_16                0x00000F00
 
+#define QUADSPI_LPTR_MAPPED                 64
+
 static void stm32l4_qspi_dma_callback(stm32l4_qspi_t *qspi, uint32_t events);
 
 static inline __attribute__((optimize("O3"),always_inline)) void stm32l4_qspi_rd8(void *rx_data)
@@ -175,6 +177,7 @@ static void stm32l4_qspi_interrupt(stm32l4_qspi_t *qspi)
     case QSPI_STATE_READY:
     case QSPI_STATE_SELECTED:
     case QSPI_STATE_RECEIVE:
+    case QSPI_STATE_MAPPED:
 	break;
 
     case QSPI_STATE_TRANSMIT:
@@ -239,6 +242,8 @@ bool stm32l4_qspi_create(stm32l4_qspi_t *qspi, unsigned int instance, const stm3
 
     qspi->priority = priority;
     qspi->mode = mode & ~QSPI_MODE_DMA;
+    qspi->select = 0;
+    qspi->map = 0;
     
     if (mode & QSPI_MODE_DMA)
     {
@@ -386,7 +391,7 @@ bool stm32l4_qspi_notify(stm32l4_qspi_t *qspi, stm32l4_qspi_callback_t callback,
 
 bool stm32l4_qspi_select(stm32l4_qspi_t *qspi) 
 {
-    if ((qspi->state != QSPI_STATE_READY) && (qspi->state != QSPI_STATE_SELECTED))
+    if ((qspi->state != QSPI_STATE_READY) && (qspi->state != QSPI_STATE_SELECTED) && (qspi->state != QSPI_STATE_MAPPED))
     {
 	return false;
     }
@@ -395,9 +400,20 @@ bool stm32l4_qspi_select(stm32l4_qspi_t *qspi)
 
     if (qspi->select == 1)
     {
-	stm32l4_qspi_start(qspi);
+	if (qspi->state == QSPI_STATE_MAPPED)
+	{
+	    /* Suspend the memory mapped mode. The peripheral stays enabled.
+	     */
+	    QUADSPI->CR |= QUADSPI_CR_ABORT;
+
+	    while (QUADSPI->CR & QUADSPI_CR_ABORT) { }
+	}
+	else
+	{
+	    stm32l4_qspi_start(qspi);
 
-	QUADSPI->CR |= QUADSPI_CR_EN;
+	    QUADSPI->CR |= QUADSPI_CR_EN;
+	}
 
 	qspi->state = QSPI_STATE_SELECTED;
     }
@@ -416,11 +432,24 @@ bool stm32l4_qspi_unselect(stm32l4_qspi_t *qspi)
 
     if (qspi->select == 0)
     {
-	QUADSPI->CR &= ~QUADSPI_CR_EN;
+	if (qspi->map)
+	{
+	    /* Resume the memory mapped mode.
+	     */
+	    while (QUADSPI->SR & QUADSPI_SR_BUSY) { }
+
+	    QUADSPI->CCR = qspi->map | QUADSPI_CCR_FMODE_MEMORY_MAPPED;
 
-	stm32l4_qspi_stop(qspi);
+	    qspi->state = QSPI_STATE_MAPPED;
+	}
+	else
+	{
+	    QUADSPI->CR &= ~QUADSPI_CR_EN;
 
-	qspi->state = QSPI_STATE_READY;
+	    stm32l4_qspi_stop(qspi);
+
+	    qspi->state = QSPI_STATE_READY;
+	}
     }
 
     return true;
@@ -772,6 +801,52 @@ bool stm32l4_qspi_done(stm32l4_qspi_t *qspi)
     return ((qspi->state == QSPI_STATE_READY) || (qspi->state == QSPI_STATE_SELECTED));
 }
 
+bool stm32l4_qspi_map(stm32l4_qspi_t *qspi, uint32_t command)
+{
+    if (qspi->state != QSPI_STATE_READY)
+    {
+	return false;
+    }
+
+    qspi->map = command;
+
+    stm32l4_qspi_start(qspi);
+
+    /* Let NCS go high after QUADSPI_LPTR_MAPPED idle cycles, so that the memory can enter standby
+     * between accesses.
+     */
+    QUADSPI->LPTR = QUADSPI_LPTR_MAPPED;
+    QUADSPI->CR = (QUADSPI->CR & ~QUADSPI_CR_FTHRES) | QUADSPI_CR_TCEN | QUADSPI_CR_EN;
+
+    QUADSPI->CCR = qspi->map | QUADSPI_CCR_FMODE_MEMORY_MAPPED;
+
+    qspi->state = QSPI_STATE_MAPPED;
+
+    return true;
+}
+
+bool stm32l4_qspi_unmap(stm32l4_qspi_t *qspi)
+{
+    if (qspi->state != QSPI_STATE_MAPPED)
+    {
+	return false;
+    }
+
+    qspi->map = 0;
+
+    QUADSPI->CR |= QUADSPI_CR_ABORT;
+
+    while (QUADSPI->CR & QUADSPI_CR_ABORT) { }
+
+    QUADSPI->CR &= ~(QUADSPI_CR_TCEN | QUADSPI_CR_EN);
+
+    stm32l4_qspi_stop(qspi);
+
+    qspi->state = QSPI_STATE_READY;
+
+    return true;
+}
+
 void QUADSPI_IRQHandler(void)
 {
     stm32l4_qspi_interrupt(stm32l4_qspi_driver.instances[QSPI_INSTANCE_QUADSPI]);
@@ -0,0 +1,201 @@
+/*
+ * Copyright (c) 2017 Thomas Roell.  All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal with the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ *  1. Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimers.
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimers in the
+ *     documentation and/or other materials provided with the distribution.
+ *  3. Neither the name of Thomas Roell, nor the names of its contributors
+ *     may be used to endorse or promote products derived from this Software
+ *     without specific prior written permission.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ * CONTRIBUTORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * WITH THE SOFTWARE.
+ */
+
+#include "armv7m.h"
+
+#include "stm32l4xx.h"
+#include "stm32l4_rng.h"
+#include "stm32l4_system.h"
+
+#define RNG_STATE_NONE     0
+#define RNG_STATE_READY    1
+#define RNG_STATE_BUSY     2
+
+typedef struct _stm32l4_rng_device_t {
+    volatile uint8_t       state;
+    volatile uint32_t      head;
+    volatile uint32_t      tail;
+    uint32_t               data[RNG_POOL_SIZE];
+} stm32l4_rng_device_t;
+
+static stm32l4_rng_device_t stm32l4_rng_device;
+
+static void stm32l4_rng_start(void)
+{
+    stm32l4_rng_device_t *device = &stm32l4_rng_device;
+
+    device->state = RNG_STATE_BUSY;
+
+    stm32l4_system_clk48_acquire(SYSTEM_CLK48_REFERENCE_RNG);
+    stm32l4_system_periph_enable(SYSTEM_PERIPH_RNG);
+
+    RNG->CR = RNG_CR_RNGEN | RNG_CR_IE;
+}
+
+static void stm32l4_rng_stop(void)
+{
+    stm32l4_rng_device_t *device = &stm32l4_rng_device;
+
+    RNG->CR = 0;
+
+    stm32l4_system_periph_disable(SYSTEM_PERIPH_RNG);
+    stm32l4_system_clk48_release(SYSTEM_CLK48_REFERENCE_RNG);
+
+    device->state = RNG_STATE_READY;
+}
+
+bool stm32l4_rng_enable(unsigned int priority)
+{
+    stm32l4_rng_device_t *device = &stm32l4_rng_device;
+    uint32_t basepri;
+
+    if (device->state != RNG_STATE_NONE)
+    {
+	return true;
+    }
+
+    device->head = 0;
+    device->tail = 0;
+
+    NVIC_SetPriority(RNG_IRQn, priority);
+    NVIC_EnableIRQ(RNG_IRQn);
+
+    basepri = armv7m_critical_enter(RNG_CRITICAL_PRIORITY);
+
+    stm32l4_rng_start();
+
+    armv7m_critical_leave(basepri);
+
+    return true;
+}
+
+void stm32l4_rng_disable(void)
+{
+    stm32l4_rng_device_t *device = &stm32l4_rng_device;
+    uint32_t basepri;
+
+    if (device->state == RNG_STATE_NONE)
+    {
+	return;
+    }
+
+    basepri = armv7m_critical_enter(RNG_CRITICAL_PRIORITY);
+
+    if (device->state == RNG_STATE_BUSY)
+    {
+	stm32l4_rng_stop();
+    }
+
+    NVIC_DisableIRQ(RNG_IRQn);
+
+    device->state = RNG_STATE_NONE;
+
+    armv7m_critical_leave(basepri);
+}
+
+bool stm32l4_rng_read(uint32_t *p_data)
+{
+    stm32l4_rng_device_t *device = &stm32l4_rng_device;
+    uint32_t basepri, count;
+    bool success;
+
+    basepri = armv7m_critical_enter(RNG_CRITICAL_PRIORITY);
+
+    count = device->head - device->tail;
+
+    success = (count != 0);
+
+    if (success)
+    {
+	*p_data = device->data[device->tail & (RNG_POOL_SIZE -1)];
+
+	device->tail++;
+
+	count--;
+    }
+
+    if ((device->state == RNG_STATE_READY) && (count < (RNG_POOL_SIZE / 2)))
+    {
+	stm32l4_rng_start();
+    }
+
+    armv7m_critical_leave(basepri);
+
+    return success;
+}
+
+uint32_t stm32l4_rng_count(void)
+{
+    stm32l4_rng_device_t *device = &stm32l4_rng_device;
+
+    return (device->head - device->tail);
+}
+
+void RNG_IRQHandler(void)
+{
+    stm32l4_rng_device_t *device = &stm32l4_rng_device;
+    uint32_t rng_sr, data;
+
+    rng_sr = RNG->SR;
+
+    if (rng_sr & (RNG_SR_SEIS | RNG_SR_CEIS))
+    {
+	/* A seed error flags the output in the pipeline as unusable; clearing SEIS and
+	 * toggling RNGEN restarts the conditioning. A clock error (CLK48 too slow) is
+	 * cleared and the RNG keeps going once the clock is back.
+	 */
+	RNG->SR = 0;
+
+	if (rng_sr & RNG_SR_SEIS)
+	{
+	    RNG->CR = 0;
+	    RNG->CR = RNG_CR_RNGEN | RNG_CR_IE;
+	}
+
+	return;
+    }
+
+    if (rng_sr & RNG_SR_DRDY)
+    {
+	data = RNG->DR;
+
+	/* DR reads 0 if a seed error happened in between.
+	 */
+	if (data && ((device->head - device->tail) < RNG_POOL_SIZE))
+	{
+	    device->data[device->head & (RNG_POOL_SIZE -1)] = data;
+
+	    device->head++;
+	}
+
+	if ((device->head - device->tail) == RNG_POOL_SIZE)
+	{
+	    stm32l4_rng_stop();
+	}
+    }
+}
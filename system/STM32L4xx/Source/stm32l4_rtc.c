@@ -144,6 +144,48 @@ void stm32l4_rtc_get_time(stm32l4_rtc_time_t *p_time_return)
     p_time_return->ticks  = (255 - (o_ssr & 255)) * 128;
 }
 
+/* Time since 2000-01-01 00:00:00 in ticks (1/32768 second, at a 1/256 second resolution).
+ * With BYPSHAD set SSR/TR/DR are read straight from the counters, so there is no RSF wait,
+ * only a retry if SSR ticked in between.
+ */
+uint64_t stm32l4_rtc_get_clock(void)
+{
+    static const uint16_t days_before_month[12] = { 0, 31, 59, 90, 120, 151, 181, 212, 243, 273, 304, 334 };
+    uint32_t o_tr, o_dr, o_ssr, year, month, day, days, seconds;
+
+    do
+    {
+	o_ssr = RTC->SSR;
+	o_tr = RTC->TR;
+	o_dr = RTC->DR;
+    }
+    while (o_ssr != RTC->SSR);
+
+    year   = ((o_dr & RTC_DR_YU_Msk) >> RTC_DR_YU_Pos) + (((o_dr & RTC_DR_YT_Msk) >> RTC_DR_YT_Pos) * 10);
+    month  = ((o_dr & RTC_DR_MU_Msk) >> RTC_DR_MU_Pos) + (((o_dr & RTC_DR_MT_Msk) >> RTC_DR_MT_Pos) * 10);
+    day    = ((o_dr & RTC_DR_DU_Msk) >> RTC_DR_DU_Pos) + (((o_dr & RTC_DR_DT_Msk) >> RTC_DR_DT_Pos) * 10);
+
+    if ((month < 1) || (month > 12))
+    {
+	month = 1;
+    }
+
+    /* 2000 to 2099, so every 4th year is a leap year.
+     */
+    days = (year * 365) + ((year + 3) / 4) + days_before_month[month -1] + (day -1);
+
+    if ((month > 2) && !(year & 3))
+    {
+	days++;
+    }
+
+    seconds = ((((o_tr & RTC_TR_HT_Msk) >> RTC_TR_HT_Pos) * 10 + ((o_tr & RTC_TR_HU_Msk) >> RTC_TR_HU_Pos)) * 3600 +
+	       (((o_tr & RTC_TR_MNT_Msk) >> RTC_TR_MNT_Pos) * 10 + ((o_tr & RTC_TR_MNU_Msk) >> RTC_TR_MNU_Pos)) * 60 +
+	       (((o_tr & RTC_TR_ST_Msk) >> RTC_TR_ST_Pos) * 10 + ((o_tr & RTC_TR_SU_Msk) >> RTC_TR_SU_Pos)));
+
+    return ((((uint64_t)days * 86400) + seconds) * 32768) + ((255 - (o_ssr & 255)) * 128);
+}
+
 void stm32l4_rtc_set_calibration(int32_t calibration)
 {
     RTC->WPR = 0xca;
@@ -27,6 +27,7 @@
  */
 
 #include <stdio.h>
+#include <string.h>
 
 #include "stm32l4xx.h"
 
@@ -92,6 +93,7 @@ static stm32l4_sai_driver_t stm32l4_sai_driver;
      DMA_OPTION_PRIORITY_HIGH)
 
 static void stm32l4_sai_dma_callback(stm32l4_sai_t *sai, uint32_t events);
+static void stm32l4_sai_duplex_callback(stm32l4_sai_t *sai, uint32_t events);
 
 static void stm32l4_sai_start(stm32l4_sai_t *sai)
 {
@@ -119,10 +121,12 @@ static void stm32l4_sai_stop(stm32l4_sai_t *sai)
     stm32l4_system_periph_disable(SYSTEM_PERIPH_SAI1 + (sai->instance >> 1));
 }
 
-static __attribute__((optimize("O3"))) void stm32l4_sai_dma_callback(stm32l4_sai_t *sai, uint32_t events)
+static __fastcode __attribute__((optimize("O3"))) void stm32l4_sai_dma_callback(stm32l4_sai_t *sai, uint32_t events)
 {
     SAI_Block_TypeDef *SAIx = sai->SAIx;
 
+    ARMV7M_TRACE_EVENT(ARMV7M_TRACE_SAI_DMA, ((sai->instance << 16) | events));
+
     SAIx->CR1 &= ~SAI_xCR1_DMAEN;
 
     if (sai->state == SAI_STATE_RECEIVE_DMA)
@@ -169,6 +173,21 @@ static __attribute__((optimize("O3"))) void stm32l4_sai_dma_callback(stm32l4_sai
     }
 }
 
+/* Runs off the receive DMA of a duplex pair, with "sai" being the transmit block. The first half
+ * of both rings is handed out on the half transfer event. If the callback runs late and both
+ * events are pending, the second half is the current one.
+ */
+static __fastcode __attribute__((optimize("O3"))) void stm32l4_sai_duplex_callback(stm32l4_sai_t *sai, uint32_t events)
+{
+    uint32_t offset;
+
+    ARMV7M_TRACE_EVENT(ARMV7M_TRACE_SAI_DMA, ((sai->instance << 16) | events));
+
+    offset = (events & DMA_EVENT_TRANSFER_DONE) ? sai->duplex_count : 0;
+
+    (*sai->duplex_callback)(sai->duplex_context, ((const uint8_t*)sai->xf_data + offset), ((uint8_t*)sai->xf_data_e + offset), sai->duplex_count);
+}
+
 static __attribute__((optimize("O3"))) void stm32l4_sai_receive_8_callback(stm32l4_sai_t *sai)
 {
     SAI_Block_TypeDef *SAIx = sai->SAIx;
@@ -514,8 +533,10 @@ static __attribute__((optimize("O3"))) void stm32l4_sai_transmit_32_callback(stm
     }
 }
 
-static __attribute__((optimize("O3"))) void stm32l4_sai_interrupt(stm32l4_sai_t *sai)
+static __fastcode __attribute__((optimize("O3"))) void stm32l4_sai_interrupt(stm32l4_sai_t *sai)
 {
+    ARMV7M_TRACE_EVENT(ARMV7M_TRACE_SAI, ((sai->instance << 16) | (sai->SAIx->SR & 0xffff)));
+
     if (sai->xf_callback)
     {
 	(*sai->xf_callback)(sai);
@@ -542,6 +563,32 @@ static __attribute__((optimize("O3"))) void stm32l4_sai_interrupt(stm32l4_sai_t
     }
 }
 
+static const uint8_t stm32l4_sai_sai1_a_dma[] = {
+    DMA_CHANNEL_DMA2_CH6_SAI1_A,
+    DMA_CHANNEL_DMA2_CH1_SAI1_A,
+    DMA_CHANNEL_NONE,
+};
+
+static const uint8_t stm32l4_sai_sai1_b_dma[] = {
+    DMA_CHANNEL_DMA2_CH7_SAI1_B,
+    DMA_CHANNEL_DMA2_CH2_SAI1_B,
+    DMA_CHANNEL_NONE,
+};
+
+#if defined(STM32L476xx) || defined(STM32L496xx)
+static const uint8_t stm32l4_sai_sai2_a_dma[] = {
+    DMA_CHANNEL_DMA2_CH3_SAI2_A,
+    DMA_CHANNEL_DMA1_CH6_SAI2_A,
+    DMA_CHANNEL_NONE,
+};
+
+static const uint8_t stm32l4_sai_sai2_b_dma[] = {
+    DMA_CHANNEL_DMA2_CH4_SAI2_B,
+    DMA_CHANNEL_DMA1_CH7_SAI2_B,
+    DMA_CHANNEL_NONE,
+};
+#endif /* defined(STM32L476xx) || defined(STM32L496xx) */
+
 bool stm32l4_sai_create(stm32l4_sai_t *sai, unsigned int instance, const stm32l4_sai_pins_t *pins, unsigned int priority, unsigned int mode)
 {
     sai->state = SAI_STATE_INIT;
@@ -577,6 +624,7 @@ bool stm32l4_sai_create(stm32l4_sai_t *sai, unsigned int instance, const stm32l4
 
     sai->priority = priority;
     sai->pins = *pins;
+    sai->duplex = NULL;
 
     sai->mode = mode & ~SAI_MODE_DMA;
 
@@ -584,30 +632,26 @@ bool stm32l4_sai_create(stm32l4_sai_t *sai, unsigned int instance, const stm32l4
     {
 	switch (sai->instance) {
 	case SAI_INSTANCE_SAI1A:
-	    if ((!(mode & SAI_MODE_DMA_SECONDARY) && stm32l4_dma_create(&sai->dma, DMA_CHANNEL_DMA2_CH6_SAI1_A, sai->priority)) ||
-		stm32l4_dma_create(&sai->dma, DMA_CHANNEL_DMA2_CH1_SAI1_A, sai->priority))
+	    if (stm32l4_dma_allocate(&sai->dma, &stm32l4_sai_sai1_a_dma[(mode & SAI_MODE_DMA_SECONDARY) ? 1 : 0], sai->priority))
 	    {
 		sai->mode |= SAI_MODE_DMA;
 	    }
 	    break;
 	case SAI_INSTANCE_SAI1B:
-	    if ((!(mode & SAI_MODE_DMA_SECONDARY) && stm32l4_dma_create(&sai->dma, DMA_CHANNEL_DMA2_CH7_SAI1_B, sai->priority)) ||
-		stm32l4_dma_create(&sai->dma, DMA_CHANNEL_DMA2_CH2_SAI1_B, sai->priority))
+	    if (stm32l4_dma_allocate(&sai->dma, &stm32l4_sai_sai1_b_dma[(mode & SAI_MODE_DMA_SECONDARY) ? 1 : 0], sai->priority))
 	    {
 		sai->mode |= SAI_MODE_DMA;
 	    }
 	    break;
 #if defined(STM32L476xx) || defined(STM32L496xx)
 	case SAI_INSTANCE_SAI2A:
-	    if ((!(mode & SAI_MODE_DMA_SECONDARY) && stm32l4_dma_create(&sai->dma, DMA_CHANNEL_DMA2_CH3_SAI2_A, sai->priority)) ||
-		stm32l4_dma_create(&sai->dma, DMA_CHANNEL_DMA1_CH6_SAI2_A, sai->priority))
+	    if (stm32l4_dma_allocate(&sai->dma, &stm32l4_sai_sai2_a_dma[(mode & SAI_MODE_DMA_SECONDARY) ? 1 : 0], sai->priority))
 	    {
 		sai->mode |= SAI_MODE_DMA;
 	    }
 	    break;
 	case SAI_INSTANCE_SAI2B:
-	    if ((!(mode & SAI_MODE_DMA_SECONDARY) && stm32l4_dma_create(&sai->dma, DMA_CHANNEL_DMA2_CH4_SAI2_B, sai->priority)) ||
-		stm32l4_dma_create(&sai->dma, DMA_CHANNEL_DMA1_CH7_SAI2_B, sai->priority))
+	    if (stm32l4_dma_allocate(&sai->dma, &stm32l4_sai_sai2_b_dma[(mode & SAI_MODE_DMA_SECONDARY) ? 1 : 0], sai->priority))
 	    {
 		sai->mode |= SAI_MODE_DMA;
 	    }
@@ -691,13 +735,19 @@ bool stm32l4_sai_disable(stm32l4_sai_t *sai)
 	return false;
     }
 
-    stm32l4_system_saiclk_configure(SYSTEM_SAICLK_NONE);
+    /* A synchronous block runs off the clock and pins of its sister block.
+     */
+    if (!(sai->option & SAI_OPTION_SYNC))
+    {
+	stm32l4_system_saiclk_configure(SYSTEM_SAICLK_NONE);
+
+	stm32l4_gpio_pin_configure(sai->pins.sck, (GPIO_PUPD_NONE | GPIO_MODE_ANALOG));
+	stm32l4_gpio_pin_configure(sai->pins.fs, (GPIO_PUPD_NONE | GPIO_MODE_ANALOG));
+    }
 
-    stm32l4_gpio_pin_configure(sai->pins.sck, (GPIO_PUPD_NONE | GPIO_MODE_ANALOG));
-    stm32l4_gpio_pin_configure(sai->pins.fs, (GPIO_PUPD_NONE | GPIO_MODE_ANALOG));
     stm32l4_gpio_pin_configure(sai->pins.sd, (GPIO_PUPD_NONE | GPIO_MODE_ANALOG));
 
-    if (sai->option & SAI_OPTION_MCK)
+    if ((sai->option & (SAI_OPTION_MCK | SAI_OPTION_SYNC)) == SAI_OPTION_MCK)
     {
 	stm32l4_gpio_pin_configure(sai->pins.mck, (GPIO_PUPD_NONE | GPIO_MODE_ANALOG));
     }
@@ -710,7 +760,7 @@ bool stm32l4_sai_disable(stm32l4_sai_t *sai)
 bool stm32l4_sai_configure(stm32l4_sai_t *sai, uint32_t width, uint32_t clock, uint32_t option)
 {
     SAI_Block_TypeDef *SAIx = sai->SAIx;
-    uint32_t sai_cr1, sai_frcr, sai_slotr, saiclk;
+    uint32_t sai_cr1, sai_frcr, sai_slotr, saiclk, slots, slot_enable;
 
     if ((sai->state != SAI_STATE_READY) && (sai->state != SAI_STATE_BUSY))
     {
@@ -728,7 +778,13 @@ bool stm32l4_sai_configure(stm32l4_sai_t *sai, uint32_t width, uint32_t clock, u
 	return false;
     }
 
-    if (clock)
+    if (option & SAI_OPTION_SYNC)
+    {
+	saiclk = SYSTEM_SAICLK_NONE;
+
+	sai_cr1 |= (SAI_xCR1_MODE_1 | SAI_xCR1_SYNCEN_0);
+    }
+    else if (clock)
     {
 #if defined(STM32L432xx) || defined(STM32L433xx) || defined(STM32L452xx) || defined(STM32L496xx)
 	switch (clock) {
@@ -888,6 +944,36 @@ bool stm32l4_sai_configure(stm32l4_sai_t *sai, uint32_t width, uint32_t clock, u
 	sai_slotr = SAI_xSLOTR_NBSLOT_0 | (0x0003 << SAI_xSLOTR_SLOTEN_Pos);
 	break;
 
+    case SAI_OPTION_FORMAT_TDM:
+	sai_cr1 |= SAI_xCR1_CKSTR;
+
+	slots = ((option & SAI_OPTION_SLOTS_MASK) >> SAI_OPTION_SLOTS_SHIFT) +1;
+	slot_enable = (option & SAI_OPTION_SLOT_ENABLE_MASK) >> SAI_OPTION_SLOT_ENABLE_SHIFT;
+
+	if (!slot_enable)
+	{
+	    slot_enable = (1 << slots) -1;
+	}
+
+	/* The frame length has to be a power of 2 for MCKDIV to yield the sample rate.
+	 */
+	if (((slots != 4) && (slots != 8)) || (slot_enable >> slots))
+	{
+	    return false;
+	}
+
+	if (width <= 16)
+	{
+	    sai_frcr = (((slots * 16) -1) << SAI_xFRCR_FRL_Pos) | (0 << SAI_xFRCR_FSALL_Pos) | SAI_xFRCR_FSPOL | SAI_xFRCR_FSOFF;
+	    sai_slotr = ((slots -1) << SAI_xSLOTR_NBSLOT_Pos) | (slot_enable << SAI_xSLOTR_SLOTEN_Pos) | SAI_xSLOTR_SLOTSZ_0;
+	}
+	else
+	{
+	    sai_frcr = (((slots * 32) -1) << SAI_xFRCR_FRL_Pos) | (0 << SAI_xFRCR_FSALL_Pos) | SAI_xFRCR_FSPOL | SAI_xFRCR_FSOFF;
+	    sai_slotr = ((slots -1) << SAI_xSLOTR_NBSLOT_Pos) | (slot_enable << SAI_xSLOTR_SLOTEN_Pos) | SAI_xSLOTR_SLOTSZ_1;
+	}
+	break;
+
     default:
 	return false;
     }
@@ -901,13 +987,17 @@ bool stm32l4_sai_configure(stm32l4_sai_t *sai, uint32_t width, uint32_t clock, u
     SAIx->FRCR = sai_frcr;
     SAIx->SLOTR = sai_slotr;
 
-    stm32l4_system_saiclk_configure(saiclk);
+    if (!(option & SAI_OPTION_SYNC))
+    {
+	stm32l4_system_saiclk_configure(saiclk);
+
+	stm32l4_gpio_pin_configure(sai->pins.sck, (GPIO_PUPD_NONE | GPIO_OSPEED_HIGH | GPIO_OTYPE_PUSHPULL | GPIO_MODE_ALTERNATE));
+	stm32l4_gpio_pin_configure(sai->pins.fs, (GPIO_PUPD_NONE | GPIO_OSPEED_HIGH | GPIO_OTYPE_PUSHPULL | GPIO_MODE_ALTERNATE));
+    }
 
-    stm32l4_gpio_pin_configure(sai->pins.sck, (GPIO_PUPD_NONE | GPIO_OSPEED_HIGH | GPIO_OTYPE_PUSHPULL | GPIO_MODE_ALTERNATE));
-    stm32l4_gpio_pin_configure(sai->pins.fs, (GPIO_PUPD_NONE | GPIO_OSPEED_HIGH | GPIO_OTYPE_PUSHPULL | GPIO_MODE_ALTERNATE));
     stm32l4_gpio_pin_configure(sai->pins.sd, (GPIO_PUPD_NONE | GPIO_OSPEED_HIGH | GPIO_OTYPE_PUSHPULL | GPIO_MODE_ALTERNATE));
 
-    if (option & SAI_OPTION_MCK)
+    if ((option & (SAI_OPTION_MCK | SAI_OPTION_SYNC)) == SAI_OPTION_MCK)
     {
 	stm32l4_gpio_pin_configure(sai->pins.mck, (GPIO_PUPD_NONE | GPIO_OSPEED_HIGH | GPIO_OTYPE_PUSHPULL | GPIO_MODE_ALTERNATE));
     }
@@ -1148,12 +1238,189 @@ bool stm32l4_sai_transmit(stm32l4_sai_t *sai, const uint8_t *tx_data, uint16_t t
     return true;
 }
 
+bool stm32l4_sai_pipe(stm32l4_sai_t *sai, stm32l4_dma_pipe_t *pipe, bool receive)
+{
+    SAI_Block_TypeDef *SAIx = sai->SAIx;
+    uint32_t dma_option;
+
+    if (pipe)
+    {
+	if ((sai->state != SAI_STATE_READY) || !(sai->mode & SAI_MODE_DMA))
+	{
+	    return false;
+	}
+
+	if (receive)
+	{
+	    dma_option = ((sai->width <= 8) ? SAI_DMA_OPTION_RECEIVE_8 : ((sai->width <= 16) ? SAI_DMA_OPTION_RECEIVE_16 : SAI_DMA_OPTION_RECEIVE_32));
+
+	    if (!stm32l4_dma_pipe_source(pipe, &sai->dma, (uint32_t)&SAIx->DR, dma_option))
+	    {
+		return false;
+	    }
+	}
+	else
+	{
+	    dma_option = ((sai->width <= 8) ? SAI_DMA_OPTION_TRANSMIT_8 : ((sai->width <= 16) ? SAI_DMA_OPTION_TRANSMIT_16 : SAI_DMA_OPTION_TRANSMIT_32));
+
+	    if (!stm32l4_dma_pipe_sink(pipe, &sai->dma, (uint32_t)&SAIx->DR, dma_option))
+	    {
+		return false;
+	    }
+	}
+
+	stm32l4_sai_start(sai);
+
+	sai->state = SAI_STATE_PIPE;
+
+	/* The DMA requests stay pending until stm32l4_dma_pipe_start() enables the channel.
+	 */
+	if (receive)
+	{
+	    SAIx->CR2 = 0;
+	    SAIx->CR1 |= (SAI_xCR1_SAIEN | SAI_xCR1_MODE_0 | SAI_xCR1_DMAEN);
+	}
+	else
+	{
+	    SAIx->CR2 = SAI_xCR2_FTH_1;
+	    SAIx->CR1 |= (SAI_xCR1_SAIEN | SAI_xCR1_DMAEN);
+	}
+    }
+    else
+    {
+	if (sai->state != SAI_STATE_PIPE)
+	{
+	    return false;
+	}
+
+	SAIx->CR1 &= ~SAI_xCR1_DMAEN;
+	SAIx->CR1 &= ~(SAI_xCR1_SAIEN | SAI_xCR1_MODE_0);
+	SAIx->CR2 = SAI_xCR2_FFLUSH;
+	
+	SAIx->CLRFR = ~0;
+
+	stm32l4_sai_stop(sai);
+
+	sai->state = SAI_STATE_READY;
+    }
+
+    return true;
+}
+
+bool stm32l4_sai_duplex(stm32l4_sai_t *sai, stm32l4_sai_t *sai_rx, uint8_t *rx_data, uint8_t *tx_data, uint16_t count, stm32l4_sai_duplex_callback_t callback, void *context)
+{
+    SAI_Block_TypeDef *SAIx = sai->SAIx;
+    uint32_t rx_option, tx_option, dma_count;
+
+    if (sai_rx)
+    {
+	if ((sai->state != SAI_STATE_READY) || (sai_rx->state != SAI_STATE_READY) || !(sai->mode & sai_rx->mode & SAI_MODE_DMA))
+	{
+	    return false;
+	}
+
+	if (((sai->instance ^ 1) != sai_rx->instance) || (sai->option & SAI_OPTION_SYNC) || !(sai_rx->option & SAI_OPTION_SYNC) || (sai->width != sai_rx->width))
+	{
+	    return false;
+	}
+
+	if (sai->width <= 8)
+	{
+	    rx_option = SAI_DMA_OPTION_RECEIVE_8;
+	    tx_option = SAI_DMA_OPTION_TRANSMIT_8;
+	    dma_count = (2 * count) / 1;
+	}
+	else if (sai->width <= 16)
+	{
+	    rx_option = SAI_DMA_OPTION_RECEIVE_16;
+	    tx_option = SAI_DMA_OPTION_TRANSMIT_16;
+	    dma_count = (2 * count) / 2;
+	}
+	else
+	{
+	    rx_option = SAI_DMA_OPTION_RECEIVE_32;
+	    tx_option = SAI_DMA_OPTION_TRANSMIT_32;
+	    dma_count = (2 * count) / 4;
+	}
+
+	if (!callback || !dma_count || (dma_count > 65535))
+	{
+	    return false;
+	}
+
+	sai->duplex = sai_rx;
+	sai->duplex_callback = callback;
+	sai->duplex_context = context;
+	sai->duplex_count = count;
+	sai->xf_data = (void*)rx_data;
+	sai->xf_data_e = (void*)tx_data;
+
+	memset(tx_data, 0, (2 * count));
+
+	stm32l4_sai_start(sai);
+	stm32l4_sai_start(sai_rx);
+
+	/* Only the receive side interrupts, so that input and output are handed out together.
+	 */
+	stm32l4_dma_enable(&sai_rx->dma, (stm32l4_dma_callback_t)stm32l4_sai_duplex_callback, sai);
+
+	stm32l4_dma_start(&sai->dma, (uint32_t)&SAIx->DR, (uint32_t)tx_data, dma_count, ((tx_option & ~DMA_OPTION_EVENT_TRANSFER_DONE) | DMA_OPTION_CIRCULAR));
+	stm32l4_dma_start_circular(&sai_rx->dma, (uint32_t)rx_data, (uint32_t)&sai_rx->SAIx->DR, dma_count, (rx_option & ~DMA_OPTION_EVENT_TRANSFER_DONE));
+
+	sai->state = SAI_STATE_DUPLEX;
+	sai_rx->state = SAI_STATE_DUPLEX;
+
+	/* The synchronous slave has to be enabled first. It starts with the first frame of the
+	 * master, and the transmit FIFO is primed by the DMA before the master starts.
+	 */
+	sai_rx->SAIx->CR2 = 0;
+	sai_rx->SAIx->CR1 |= (SAI_xCR1_SAIEN | SAI_xCR1_MODE_0 | SAI_xCR1_DMAEN);
+
+	SAIx->CR2 = SAI_xCR2_FTH_1;
+	SAIx->CR1 |= SAI_xCR1_DMAEN;
+	SAIx->CR1 |= SAI_xCR1_SAIEN;
+    }
+    else
+    {
+	if (sai->state != SAI_STATE_DUPLEX)
+	{
+	    return false;
+	}
+
+	sai_rx = sai->duplex;
+
+	SAIx->CR1 &= ~SAI_xCR1_DMAEN;
+	sai_rx->SAIx->CR1 &= ~SAI_xCR1_DMAEN;
+
+	stm32l4_dma_stop(&sai->dma);
+	stm32l4_dma_stop(&sai_rx->dma);
+
+	SAIx->CR1 &= ~SAI_xCR1_SAIEN;
+	SAIx->CR2 = SAI_xCR2_FFLUSH;
+	SAIx->CLRFR = ~0;
+
+	sai_rx->SAIx->CR1 &= ~(SAI_xCR1_SAIEN | SAI_xCR1_MODE_0);
+	sai_rx->SAIx->CR2 = SAI_xCR2_FFLUSH;
+	sai_rx->SAIx->CLRFR = ~0;
+
+	stm32l4_sai_stop(sai_rx);
+	stm32l4_sai_stop(sai);
+
+	sai->duplex = NULL;
+
+	sai_rx->state = SAI_STATE_READY;
+	sai->state = SAI_STATE_READY;
+    }
+
+    return true;
+}
+
 bool stm32l4_sai_done(stm32l4_sai_t *sai)
 {
     return (sai->state == SAI_STATE_READY);
 }
 
-void SAI1_IRQHandler(void)
+__fastcode void SAI1_IRQHandler(void)
 {
     if (SAI1_Block_A->SR & SAI1_Block_A->IMR)
     {
@@ -1168,7 +1435,7 @@ void SAI1_IRQHandler(void)
 
 #if defined(STM32L476xx) || defined(STM32L496xx)
 
-void SAI2_IRQHandler(void)
+__fastcode void SAI2_IRQHandler(void)
 {
     if (SAI2_Block_A->SR & SAI2_Block_A->IMR)
     {
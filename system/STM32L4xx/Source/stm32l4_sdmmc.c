@@ -35,6 +35,12 @@
 
 static stm32l4_sdmmc_t stm32l4_sdmmc;
 
+static const uint8_t stm32l4_sdmmc_dma[] = {
+    DMA_CHANNEL_DMA2_CH4_SDMMC1,
+    DMA_CHANNEL_DMA2_CH5_SDMMC1,
+    DMA_CHANNEL_NONE,
+};
+
 #define SDMMC_DCTRL_DBLOCKSIZE_1B            (0u << SDMMC_DCTRL_DBLOCKSIZE_Pos)
 #define SDMMC_DCTRL_DBLOCKSIZE_2B            (1u << SDMMC_DCTRL_DBLOCKSIZE_Pos)
 #define SDMMC_DCTRL_DBLOCKSIZE_4B            (2u << SDMMC_DCTRL_DBLOCKSIZE_Pos)
@@ -85,6 +91,9 @@ static stm32l4_sdmmc_t stm32l4_sdmmc;
 #define SD_ACMD_SET_CLR_CARD_DETECT    (42)
 #define SD_ACMD_SEND_SCR               (51)
 
+#define SD_ERASE_ARGUMENT_ERASE        0x00000000
+#define SD_ERASE_ARGUMENT_DISCARD      0x00000001
+
 #define SD_R1_AKE_SEQ_ERROR            0x00000008
 #define SD_R1_ADD_CMD                  0x00000020
 #define SD_R1_READY_FOR_DATA           0x00000100
@@ -140,6 +149,20 @@ static stm32l4_sdmmc_t stm32l4_sdmmc;
 #define STM32L4_SDMMC_CONTROL_PREFETCH 0x00000002
 #define STM32L4_SDMMC_CONTROL_CONTINUE 0x00000004
 
+#define SDMMC_DMA_OPTION_RECEIVE	  \
+    (DMA_OPTION_PERIPHERAL_TO_MEMORY |	  \
+     DMA_OPTION_PERIPHERAL_DATA_SIZE_32 | \
+     DMA_OPTION_MEMORY_DATA_SIZE_32 |	  \
+     DMA_OPTION_MEMORY_DATA_INCREMENT |	  \
+     DMA_OPTION_PRIORITY_VERY_HIGH)
+
+#define SDMMC_DMA_OPTION_TRANSMIT	  \
+    (DMA_OPTION_MEMORY_TO_PERIPHERAL |	  \
+     DMA_OPTION_PERIPHERAL_DATA_SIZE_32 | \
+     DMA_OPTION_MEMORY_DATA_SIZE_32 |	  \
+     DMA_OPTION_MEMORY_DATA_INCREMENT |	  \
+     DMA_OPTION_PRIORITY_VERY_HIGH)
+
 static inline __attribute__((optimize("O3"),always_inline)) uint32_t stm32l4_sdmmc_slice(const uint8_t *data, uint32_t size, uint32_t start, uint32_t width)
 {
     uint32_t mask, shift;
@@ -177,6 +200,7 @@ static bool stm32l4_sdmmc_detect(stm32l4_sdmmc_t *sdmmc);
 static void stm32l4_sdmmc_select(stm32l4_sdmmc_t *sdmmc);
 static void stm32l4_sdmmc_deselect(stm32l4_sdmmc_t *sdmmc);
 static void stm32l4_sdmmc_mode(stm32l4_sdmmc_t *sdmmc, uint32_t mode);
+static void stm32l4_sdmmc_fallback(stm32l4_sdmmc_t *sdmmc);
 static int stm32l4_sdmmc_command(stm32l4_sdmmc_t *sdmmc, uint8_t index, uint32_t argument, uint32_t wait);
 static int stm32l4_sdmmc_receive(stm32l4_sdmmc_t *sdmmc, uint8_t index, uint32_t argument, uint8_t *data, uint32_t count, uint32_t *p_count, uint32_t control);
 static int stm32l4_sdmmc_transmit(stm32l4_sdmmc_t *sdmmc, const uint8_t *data, uint32_t count, bool *p_check, bool stop);
@@ -375,6 +399,108 @@ failure:
     return sdmmc_sta;
 }
 
+/* The DMA path is used for whole blocks into/from word aligned buffers. Anything
+ * else (the 8/64 byte SCR/SSR/SWITCH_FUNC reads, or unaligned buffers passed in
+ * by the file system) goes through the FIFO loops above.
+ */
+static inline bool stm32l4_sdmmc_dma_usable(const stm32l4_sdmmc_t *sdmmc, const uint8_t *data, uint32_t count)
+{
+    return (sdmmc->xf_dma && (count >= 512) && ((count >> 2) <= 65535) && !((uint32_t)data & 3));
+}
+
+static uint32_t stm32l4_sdmmc_read_dma(stm32l4_sdmmc_t *sdmmc, uint8_t *data, uint32_t count, uint32_t *p_count)
+{
+    uint32_t sdmmc_sta;
+
+    /* The DMA channel had been started by the caller. Same DBCKEND logic as in
+     * stm32l4_sdmmc_read_fifo(): once the DMA has moved data of the last block,
+     * the previous block is complete, so DBCKEND can be cleared and then waited
+     * for to make sure the CRC of the last block got checked.
+     */
+    do
+    {
+	sdmmc_sta = SDMMC1->STA;
+
+	if (sdmmc_sta & (SDMMC_STA_DCRCFAIL | SDMMC_STA_DTIMEOUT))
+	{
+	    goto failure;
+	}
+    }
+    while (stm32l4_dma_count(&sdmmc->dma) <= ((count >> 2) - 128));
+
+    SDMMC1->ICR = SDMMC_ICR_DBCKENDC;
+
+    do
+    {
+	sdmmc_sta = SDMMC1->STA;
+
+	if (sdmmc_sta & (SDMMC_STA_DCRCFAIL | SDMMC_STA_DTIMEOUT))
+	{
+	    goto failure;
+	}
+    }
+    while (!(sdmmc_sta & SDMMC_STA_DBCKEND));
+
+    while (!stm32l4_dma_done(&sdmmc->dma))
+    {
+    }
+
+failure:
+    *p_count = stm32l4_dma_stop(&sdmmc->dma) << 2;
+
+    return sdmmc_sta;
+}
+
+static uint32_t stm32l4_sdmmc_write_dma(stm32l4_sdmmc_t *sdmmc, const uint8_t *data, uint32_t count)
+{
+    uint32_t sdmmc_sta;
+
+    do
+    {
+	do
+	{
+	    sdmmc_sta = SDMMC1->STA;
+	    
+	    if (sdmmc_sta & SDMMC_STA_DTIMEOUT)
+	    {
+		goto failure;
+	    }
+	}
+	while (sdmmc_sta & SDMMC_STA_TXACT);
+
+	stm32l4_dma_start(&sdmmc->dma, (uint32_t)&SDMMC1->FIFO, (uint32_t)data, 128, SDMMC_DMA_OPTION_TRANSMIT);
+	
+	SDMMC1->DTIMER = sdmmc->write_timeout;
+	SDMMC1->DLEN = 512;
+	SDMMC1->DCTRL = SDMMC_DCTRL_DBLOCKSIZE_512B | SDMMC_DCTRL_DMAEN | SDMMC_DCTRL_DTEN;
+
+	/* DBCKEND is only signaled after the CRC status token is received, at which
+	 * point the DMA had drained the whole block.
+	 */
+	do
+	{
+	    sdmmc_sta = SDMMC1->STA;
+
+	    if (sdmmc_sta & (SDMMC_STA_DCRCFAIL | SDMMC_STA_DTIMEOUT))
+	    {
+		goto failure;
+	    }
+	}
+	while (!(sdmmc_sta & SDMMC_STA_DBCKEND));
+	
+	SDMMC1->ICR = SDMMC_ICR_DBCKENDC | SDMMC_ICR_DATAENDC | SDMMC_ICR_DTIMEOUTC | SDMMC_ICR_DCRCFAILC;
+
+	data += 512;
+	count -= 512;
+    }
+    while (count);
+    
+failure:
+    stm32l4_dma_stop(&sdmmc->dma);
+
+    return sdmmc_sta;
+}
+
 static bool stm32l4_sdmmc_detect(stm32l4_sdmmc_t *sdmmc)
 {
     bool detect;
@@ -434,10 +560,34 @@ static void stm32l4_sdmmc_mode(stm32l4_sdmmc_t *sdmmc, uint32_t mode)
 
 	stm32l4_system_clk48_release(SYSTEM_CLK48_REFERENCE_SDMMC1);
 
+	if (sdmmc->xf_dma)
+	{
+	    stm32l4_dma_disable(&sdmmc->dma);
+	    stm32l4_dma_destroy(&sdmmc->dma);
+
+	    sdmmc->xf_dma = 0;
+	}
+
 	sdmmc->speed = 0;
+
+	sdmmc->device->statistics.clock = 0;
     }
     else
     {
+	/* The DMA channel is claimed while the SDMMC is powered up. Either DMA2_CH4 or
+	 * DMA2_CH5 can serve SDMMC1. If both are in use elsewhere, the FIFO loops are
+	 * used instead.
+	 */
+	if (!sdmmc->speed && !sdmmc->xf_dma)
+	{
+	    if (stm32l4_dma_allocate(&sdmmc->dma, stm32l4_sdmmc_dma, DOSFS_CONFIG_SDCARD_DMA_PRIORITY))
+	    {
+		stm32l4_dma_enable(&sdmmc->dma, NULL, NULL);
+
+		sdmmc->xf_dma = 1;
+	    }
+	}
+
 	stm32l4_system_clk48_acquire(SYSTEM_CLK48_REFERENCE_SDMMC1);
 
 	stm32l4_system_periph_enable(SYSTEM_PERIPH_SDMMC1);
@@ -508,6 +658,25 @@ static void stm32l4_sdmmc_mode(stm32l4_sdmmc_t *sdmmc, uint32_t mode)
 	sdmmc->read_timeout  = (speed / (1000 / 100)) + 4114;
 	sdmmc->write_timeout = (speed / (1000 / 250)) + 4114;
 
+	sdmmc->device->statistics.clock = speed;
+
+    }
+}
+
+static void stm32l4_sdmmc_fallback(stm32l4_sdmmc_t *sdmmc)
+{
+    /* A data CRC error at 48MHz is taken as a sign that the card/board combination
+     * cannot sustain high speed timing. The card stays in high speed mode, which
+     * is fine with a slower clock, but the interface drops back to 24MHz for the
+     * retry, and for any later reset.
+     */
+    if (sdmmc->speed > 24000000)
+    {
+	STM32L4_SDMMC_STATISTICS_COUNT(sdcard_speed_fallback);
+
+	sdmmc->option &= ~STM32L4_SDMMC_OPTION_HIGH_SPEED;
+
+	stm32l4_sdmmc_mode(sdmmc, STM32L4_SDMMC_MODE_DATA_TRANSFER_WIDE);
     }
 }
 
@@ -565,7 +734,7 @@ static int stm32l4_sdmmc_command(stm32l4_sdmmc_t *sdmmc, uint8_t index, const ui
 #if (DOSFS_CONFIG_SDCARD_CRC == 1) && (DOSFS_CONFIG_SDCARD_COMMAND_RETRIES != 0)
 	    if (retries > 1)
 	    {
-		STM32L4_SDMMC_STATISTICS_COUNT(sdcard_command_retry);
+		STM32L4_SDMMC_RETRY_COUNT(sdcard_command_retry);
 		retries--;
 	    }
 	    else
@@ -646,12 +815,28 @@ static int stm32l4_sdmmc_receive(stm32l4_sdmmc_t *sdmmc, uint8_t index, const ui
 {
     int status = F_NO_ERROR;
     uint32_t sdmmc_dctrl, sdmmc_sta, response, blksz, offset;
+    bool dma;
 
     STM32L4_SDMMC_STATISTICS_COUNT(sdcard_receive);
 
+    dma = stm32l4_sdmmc_dma_usable(sdmmc, data, count);
+
     if (control & STM32L4_SDMMC_CONTROL_CONTINUE)
     {
 	blksz = 512;
+
+	/* DCTRL cannot be changed while the transfer is active, so a continued
+	 * transfer can only use the DMA if it had been started with DMAEN.
+	 */
+	if (!(SDMMC1->DCTRL & SDMMC_DCTRL_DMAEN))
+	{
+	    dma = false;
+	}
+
+	if (dma)
+	{
+	    stm32l4_dma_start(&sdmmc->dma, (uint32_t)data, (uint32_t)&SDMMC1->FIFO, (count >> 2), SDMMC_DMA_OPTION_RECEIVE);
+	}
     }
     else
     {
@@ -678,6 +863,13 @@ static int stm32l4_sdmmc_receive(stm32l4_sdmmc_t *sdmmc, uint8_t index, const ui
 		sdmmc_dctrl = SDMMC_DCTRL_DBLOCKSIZE_4B | SDMMC_DCTRL_DTDIR;
 	    }
 	}
+
+	if (dma)
+	{
+	    stm32l4_dma_start(&sdmmc->dma, (uint32_t)data, (uint32_t)&SDMMC1->FIFO, (count >> 2), SDMMC_DMA_OPTION_RECEIVE);
+
+	    sdmmc_dctrl |= SDMMC_DCTRL_DMAEN;
+	}
 	
 	SDMMC1->DTIMER = sdmmc->read_timeout; 
 	SDMMC1->DLEN = ((control & STM32L4_SDMMC_CONTROL_PREFETCH) ? 0x00ffffff : count);
@@ -688,7 +880,16 @@ static int stm32l4_sdmmc_receive(stm32l4_sdmmc_t *sdmmc, uint8_t index, const ui
 
     if (status == F_NO_ERROR)
     {
-	sdmmc_sta = stm32l4_sdmmc_read_fifo(sdmmc, data, count, &offset);
+	if (dma)
+	{
+	    STM32L4_SDMMC_STATISTICS_COUNT(sdcard_receive_dma);
+
+	    sdmmc_sta = stm32l4_sdmmc_read_dma(sdmmc, data, count, &offset);
+	}
+	else
+	{
+	    sdmmc_sta = stm32l4_sdmmc_read_fifo(sdmmc, data, count, &offset);
+	}
 
 	if (sdmmc_sta & (SDMMC_STA_DCRCFAIL | SDMMC_STA_DTIMEOUT))
 	{
@@ -699,6 +900,8 @@ static int stm32l4_sdmmc_receive(stm32l4_sdmmc_t *sdmmc, uint8_t index, const ui
 	    {
 		STM32L4_SDMMC_STATISTICS_COUNT(sdcard_receive_crcfail);
 
+		stm32l4_sdmmc_fallback(sdmmc);
+
 		if (offset > blksz)
 		{
 		    *p_count = (offset & ~(blksz - 1)) - blksz;
@@ -764,6 +967,11 @@ static int stm32l4_sdmmc_receive(stm32l4_sdmmc_t *sdmmc, uint8_t index, const ui
     }
     else
     {
+	if (dma)
+	{
+	    stm32l4_dma_stop(&sdmmc->dma);
+	}
+
 	SDMMC1->DCTRL = 0;
 	SDMMC1->ICR = SDMMC_ICR_DBCKENDC | SDMMC_ICR_DATAENDC | SDMMC_ICR_DTIMEOUTC | SDMMC_ICR_DCRCFAILC;
 
@@ -782,7 +990,16 @@ static int stm32l4_sdmmc_transmit(stm32l4_sdmmc_t *sdmmc, const uint8_t *data, u
 
     *p_check = false;
 
-    sdmmc_sta = stm32l4_sdmmc_write_fifo(sdmmc, data, count);
+    if (stm32l4_sdmmc_dma_usable(sdmmc, data, count))
+    {
+	STM32L4_SDMMC_STATISTICS_COUNT(sdcard_transmit_dma);
+
+	sdmmc_sta = stm32l4_sdmmc_write_dma(sdmmc, data, count);
+    }
+    else
+    {
+	sdmmc_sta = stm32l4_sdmmc_write_fifo(sdmmc, data, count);
+    }
 
     if (sdmmc_sta & (SDMMC_STA_DCRCFAIL | SDMMC_STA_DTIMEOUT))
     {
@@ -793,6 +1010,8 @@ static int stm32l4_sdmmc_transmit(stm32l4_sdmmc_t *sdmmc, const uint8_t *data, u
 	{
 	    STM32L4_SDMMC_STATISTICS_COUNT(sdcard_transmit_crcfail);
 
+	    stm32l4_sdmmc_fallback(sdmmc);
+
 	    *p_check = true;
 	}
 
@@ -983,6 +1202,10 @@ static int stm32l4_sdmmc_write_sync(stm32l4_sdmmc_t *sdmmc)
 		    
 		    status = F_ERR_ONDRIVE;
 		}
+		else
+		{
+		    armv7m_core_relax();
+		}
 	    }
 	}
     }
@@ -1130,7 +1353,7 @@ static uint32_t stm32l4_sdmmc_au_size_table[16] = {
 static int stm32l4_sdmmc_reset(stm32l4_sdmmc_t *sdmmc, uint32_t media)
 {
     int status = F_NO_ERROR;
-    uint32_t millis, count;
+    uint32_t millis, count, mode;
     uint8_t data[64];
 
     STM32L4_SDMMC_STATISTICS_COUNT(sdcard_reset);
@@ -1301,23 +1524,29 @@ static int stm32l4_sdmmc_reset(stm32l4_sdmmc_t *sdmmc, uint32_t media)
 	{
 	    if (stm32l4_sdmmc_slice(sdmmc->SCR, 64, 50, 1))
 	    {
+		mode = STM32L4_SDMMC_MODE_DATA_TRANSFER_WIDE;
+
 		if ((sdmmc->option & STM32L4_SDMMC_OPTION_HIGH_SPEED) && (stm32l4_sdmmc_slice(sdmmc->SCR, 64, 56, 4) >= 1) && stm32l4_sdmmc_slice(sdmmc->CSD, 128, 94, 1))
 		{
-		    status = stm32l4_sdmmc_receive(sdmmc, SD_CMD_SWITCH_FUNC, 0x80fffff1, data, 64, &count, STM32L4_SDMMC_CONTROL_STOP);
-		    
-		    if ((status == F_NO_ERROR) && (count == 64) && stm32l4_sdmmc_slice(data, 512, 496, 16))
-		    {
-			stm32l4_sdmmc_mode(sdmmc, STM32L4_SDMMC_MODE_DATA_TRANSFER_WIDE_HS);
-		    }
-		    else
+		    /* First ask (check mode) whether function 1 (high speed) of group 1 is
+		     * supported, then switch to it. The switch has only happened if the
+		     * group 1 status (bits 379:376) reports function 1 back. Otherwise the
+		     * card remains in default speed mode, and 24MHz is used.
+		     */
+		    status = stm32l4_sdmmc_receive(sdmmc, SD_CMD_SWITCH_FUNC, 0x00fffff1, data, 64, &count, STM32L4_SDMMC_CONTROL_STOP);
+
+		    if ((status == F_NO_ERROR) && (count == 64) && stm32l4_sdmmc_slice(data, 512, 401, 1))
 		    {
-			stm32l4_sdmmc_mode(sdmmc, STM32L4_SDMMC_MODE_DATA_TRANSFER_WIDE);
+			status = stm32l4_sdmmc_receive(sdmmc, SD_CMD_SWITCH_FUNC, 0x80fffff1, data, 64, &count, STM32L4_SDMMC_CONTROL_STOP);
+		    
+			if ((status == F_NO_ERROR) && (count == 64) && (stm32l4_sdmmc_slice(data, 512, 376, 4) == 1))
+			{
+			    mode = STM32L4_SDMMC_MODE_DATA_TRANSFER_WIDE_HS;
+			}
 		    }
 		}
-		else
-		{
-		    stm32l4_sdmmc_mode(sdmmc, STM32L4_SDMMC_MODE_DATA_TRANSFER_WIDE);
-		}
+
+		stm32l4_sdmmc_mode(sdmmc, mode);
 		
 		status = stm32l4_sdmmc_command(sdmmc, SD_CMD_APP_CMD, sdmmc->RCA, SD_WAIT_RESPONSE_SHORT);
 		
@@ -1558,9 +1787,8 @@ static int stm32l4_sdmmc_format(void *context)
     return F_NO_ERROR;
 }
 
-static int stm32l4_sdmmc_erase(void *context, uint32_t address, uint32_t length)
+static int stm32l4_sdmmc_erase_range(stm32l4_sdmmc_t *sdmmc, uint32_t address, uint32_t length, uint32_t argument)
 {
-    stm32l4_sdmmc_t *sdmmc = (stm32l4_sdmmc_t*)context;
     int status = F_NO_ERROR;
     uint32_t au_start, au_end, timeout, response, millis;
 
@@ -1598,7 +1826,7 @@ static int stm32l4_sdmmc_erase(void *context, uint32_t address, uint32_t length)
 	
 		if (status == F_NO_ERROR)
 		{
-		    status = stm32l4_sdmmc_command(sdmmc, SD_CMD_ERASE, 0, SD_WAIT_RESPONSE_SHORT);
+		    status = stm32l4_sdmmc_command(sdmmc, SD_CMD_ERASE, argument, SD_WAIT_RESPONSE_SHORT);
 
 		    if (status == F_NO_ERROR)
 		    {
@@ -1664,9 +1892,42 @@ static int stm32l4_sdmmc_erase(void *context, uint32_t address, uint32_t length)
     return status;
 }
 
+static int stm32l4_sdmmc_erase(void *context, uint32_t address, uint32_t length)
+{
+    stm32l4_sdmmc_t *sdmmc = (stm32l4_sdmmc_t*)context;
+
+    return stm32l4_sdmmc_erase_range(sdmmc, address, length, SD_ERASE_ARGUMENT_ERASE);
+}
+
 static int stm32l4_sdmmc_discard(void *context, uint32_t address, uint32_t length)
 {
-    return F_NO_ERROR;
+    stm32l4_sdmmc_t *sdmmc = (stm32l4_sdmmc_t*)context;
+    int status = F_NO_ERROR;
+    uint32_t au_start, au_end;
+
+    /* With DISCARD_SUPPORT (SD 5.0) the blocks are simply marked as unused, so
+     * any range can be passed on. Otherwise only the whole AUs within the range
+     * are erased, as erasing a partial AU makes the card copy the rest of it.
+     */
+    if (sdmmc->erase_size)
+    {
+	if (stm32l4_sdmmc_slice(sdmmc->SSR, 512, 313, 1))
+	{
+	    status = stm32l4_sdmmc_erase_range(sdmmc, address, length, SD_ERASE_ARGUMENT_DISCARD);
+	}
+	else
+	{
+	    au_start = ((address + (sdmmc->au_size -1)) / sdmmc->au_size);
+	    au_end   = ((address + length) / sdmmc->au_size);
+
+	    if (au_start < au_end)
+	    {
+		status = stm32l4_sdmmc_erase_range(sdmmc, (au_start * sdmmc->au_size), ((au_end - au_start) * sdmmc->au_size), SD_ERASE_ARGUMENT_ERASE);
+	    }
+	}
+    }
+
+    return status;
 }
 
 static int stm32l4_sdmmc_read(void *context, uint32_t address, uint8_t *data, uint32_t length, bool prefetch)
@@ -1695,7 +1956,7 @@ static int stm32l4_sdmmc_read(void *context, uint32_t address, uint8_t *data, ui
 #if (DOSFS_CONFIG_SDCARD_CRC == 1) && (DOSFS_CONFIG_SDCARD_DATA_RETRIES != 0)
 			if (retries)
 			{
-			    STM32L4_SDMMC_STATISTICS_COUNT(sdcard_receive_retry);
+			    STM32L4_SDMMC_RETRY_COUNT(sdcard_receive_retry);
 
 			    retries--;
 			
@@ -1783,7 +2044,7 @@ static int stm32l4_sdmmc_read(void *context, uint32_t address, uint8_t *data, ui
 
 			if (count)
 			{
-			    STM32L4_SDMMC_STATISTICS_COUNT(sdcard_receive_retry);
+			    STM32L4_SDMMC_RETRY_COUNT(sdcard_receive_retry);
 
 			    retries = DOSFS_CONFIG_SDCARD_DATA_RETRIES;
 
@@ -1793,7 +2054,7 @@ static int stm32l4_sdmmc_read(void *context, uint32_t address, uint8_t *data, ui
 			{
 			    if (retries)
 			    {
-				STM32L4_SDMMC_STATISTICS_COUNT(sdcard_receive_retry);
+				STM32L4_SDMMC_RETRY_COUNT(sdcard_receive_retry);
 				
 				retries--;
 				
@@ -1871,7 +2132,7 @@ static int stm32l4_sdmmc_write(void *context, uint32_t address, const uint8_t *d
 #if (DOSFS_CONFIG_SDCARD_CRC == 1) && (DOSFS_CONFIG_SDCARD_DATA_RETRIES != 0)
 			    if (retries)
 			    {
-				STM32L4_SDMMC_STATISTICS_COUNT(sdcard_transmit_retry);
+				STM32L4_SDMMC_RETRY_COUNT(sdcard_transmit_retry);
 			    
 				retries--;
 			    
@@ -1912,7 +2173,25 @@ static int stm32l4_sdmmc_write(void *context, uint32_t address, const uint8_t *d
 	    {
 		if (sdmmc->state != STM32L4_SDMMC_STATE_WRITE_MULTIPLE)
 		{
-		    status = stm32l4_sdmmc_command(sdmmc, SD_CMD_WRITE_MULTIPLE_BLOCK, (address << sdmmc->shift), SD_WAIT_RESPONSE_SHORT);
+		    /* Tell the card up front how many blocks are about to be written
+		     * (ACMD23), so it can pre-erase them instead of stalling for an
+		     * erase in the middle of the stream. This is only a hint; writing
+		     * past the count (a streamed write going on) is fine.
+		     */
+		    if (length > 1)
+		    {
+			status = stm32l4_sdmmc_command(sdmmc, SD_CMD_APP_CMD, sdmmc->RCA, SD_WAIT_RESPONSE_SHORT);
+
+			if (status == F_NO_ERROR)
+			{
+			    status = stm32l4_sdmmc_command(sdmmc, SD_ACMD_SET_WR_BLK_ERASE_COUNT, (length & 0x007fffff), SD_WAIT_RESPONSE_SHORT);
+			}
+		    }
+
+		    if (status == F_NO_ERROR)
+		    {
+			status = stm32l4_sdmmc_command(sdmmc, SD_CMD_WRITE_MULTIPLE_BLOCK, (address << sdmmc->shift), SD_WAIT_RESPONSE_SHORT);
+		    }
 			
 		    if (status == F_NO_ERROR)
 		    {
@@ -1962,7 +2241,7 @@ static int stm32l4_sdmmc_write(void *context, uint32_t address, const uint8_t *d
 
 					    if (offset)
 					    {
-						STM32L4_SDMMC_STATISTICS_COUNT(sdcard_transmit_retry);
+						STM32L4_SDMMC_RETRY_COUNT(sdcard_transmit_retry);
 						    
 						retries = DOSFS_CONFIG_SDCARD_DATA_RETRIES;
 						    
@@ -1972,7 +2251,7 @@ static int stm32l4_sdmmc_write(void *context, uint32_t address, const uint8_t *d
 					    {
 						if (retries)
 						{
-						    STM32L4_SDMMC_STATISTICS_COUNT(sdcard_transmit_retry);
+						    STM32L4_SDMMC_RETRY_COUNT(sdcard_transmit_retry);
 							
 						    retries--;
 							
@@ -2054,6 +2333,9 @@ static const dosfs_device_interface_t stm32l4_sdmmc_interface = {
     stm32l4_sdmmc_read,
     stm32l4_sdmmc_write,
     stm32l4_sdmmc_sync,
+    NULL,
+    NULL,
+    NULL,
 };
 
 int stm32l4_sdmmc_initialize(uint32_t option)
@@ -2061,9 +2343,16 @@ int stm32l4_sdmmc_initialize(uint32_t option)
     stm32l4_sdmmc_t *sdmmc = (stm32l4_sdmmc_t*)&stm32l4_sdmmc;
     int status = F_NO_ERROR;
 
-    dosfs_device.lock = DOSFS_DEVICE_LOCK_INIT;
-    dosfs_device.context = (void*)sdmmc;
-    dosfs_device.interface = &stm32l4_sdmmc_interface;
+    sdmmc->device = dosfs_device_attach(&stm32l4_sdmmc_interface, (void*)sdmmc);
+
+    if (!sdmmc->device)
+    {
+	return F_ERR_INITFUNC;
+    }
+
+#if (DOSFS_CONFIG_SDCARD_HIGH_SPEED == 1)
+    option |= STM32L4_SDMMC_OPTION_HIGH_SPEED;
+#endif /* (DOSFS_CONFIG_SDCARD_HIGH_SPEED == 1) */
 
     sdmmc->option = option;
 
@@ -2077,7 +2366,7 @@ int stm32l4_sdmmc_initialize(uint32_t option)
 	sdmmc->state = STM32L4_SDMMC_STATE_INIT;
     }
     
-    dosfs_device.lock = 0;
+    sdmmc->device->lock = 0;
 
     return status;
 }
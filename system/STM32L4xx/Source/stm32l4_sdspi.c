@@ -29,6 +29,7 @@
 #include "stm32l4_sdspi.h"
 #include "stm32l4_system.h"
 
+#include "armv7m.h"
 #include "armv7m_systick.h"
 
 static stm32l4_sdspi_t stm32l4_sdspi;
@@ -61,6 +62,9 @@ static stm32l4_sdspi_t stm32l4_sdspi;
 #define SD_ACMD_SET_CLR_CARD_DETECT    (42)
 #define SD_ACMD_SEND_SCR               (51)
 
+#define SD_ERASE_ARGUMENT_ERASE        0x00000000
+#define SD_ERASE_ARGUMENT_DISCARD      0x00000001
+
 #define SD_R1_VALID_MASK               0x80
 #define SD_R1_VALID_DATA               0x00
 #define SD_R1_IN_IDLE_STATE            0x01
@@ -104,6 +108,34 @@ static stm32l4_sdspi_t stm32l4_sdspi;
 #define SD_DATA_ERROR_CARD_ECC_FAILED  0x04
 #define SD_DATA_ERROR_OUT_OF_RANGE     0x08
 
+#define SDSPI_RX_DMA_OPTION_RECEIVE_8	  \
+    (DMA_OPTION_EVENT_TRANSFER_DONE |     \
+     DMA_OPTION_PERIPHERAL_TO_MEMORY |	  \
+     DMA_OPTION_PERIPHERAL_DATA_SIZE_8 |  \
+     DMA_OPTION_MEMORY_DATA_SIZE_8 |	  \
+     DMA_OPTION_MEMORY_DATA_INCREMENT |	  \
+     DMA_OPTION_PRIORITY_HIGH)
+
+#define SDSPI_RX_DMA_OPTION_RECEIVE_16	  \
+    (DMA_OPTION_EVENT_TRANSFER_DONE |     \
+     DMA_OPTION_PERIPHERAL_TO_MEMORY |	  \
+     DMA_OPTION_PERIPHERAL_DATA_SIZE_16 | \
+     DMA_OPTION_MEMORY_DATA_SIZE_16 |	  \
+     DMA_OPTION_MEMORY_DATA_INCREMENT |	  \
+     DMA_OPTION_PRIORITY_HIGH)
+
+#define SDSPI_TX_DMA_OPTION_RECEIVE_8	  \
+    (DMA_OPTION_MEMORY_TO_PERIPHERAL |	  \
+     DMA_OPTION_PERIPHERAL_DATA_SIZE_8 |  \
+     DMA_OPTION_MEMORY_DATA_SIZE_8 |	  \
+     DMA_OPTION_PRIORITY_HIGH)
+
+#define SDSPI_TX_DMA_OPTION_RECEIVE_16	  \
+    (DMA_OPTION_MEMORY_TO_PERIPHERAL |	  \
+     DMA_OPTION_PERIPHERAL_DATA_SIZE_16 | \
+     DMA_OPTION_MEMORY_DATA_SIZE_16 |	  \
+     DMA_OPTION_PRIORITY_HIGH)
+
 static inline __attribute__((optimize("O3"),always_inline)) uint32_t stm32l4_sdspi_slice(const uint8_t *data, uint32_t size, uint32_t start, uint32_t width)
 {
     uint32_t mask, shift;
@@ -252,7 +284,10 @@ static __attribute__((optimize("O3"))) uint16_t stm32l4_sdspi_compute_crc16(cons
 static bool stm32l4_sdspi_detect(stm32l4_sdspi_t *sdspi);
 static void stm32l4_sdspi_select(stm32l4_sdspi_t *sdspi);
 static void stm32l4_sdspi_deselect(stm32l4_sdspi_t *sdspi);
+static uint32_t stm32l4_sdspi_divide(stm32l4_sdspi_t *sdspi, uint32_t speed, uint32_t *p_clock);
 static void stm32l4_sdspi_mode(stm32l4_sdspi_t *sdspi, uint32_t mode);
+static void stm32l4_sdspi_speed(stm32l4_sdspi_t *sdspi, uint32_t speed);
+static void stm32l4_sdspi_fallback(stm32l4_sdspi_t *sdspi);
 static int stm32l4_sdspi_command(stm32l4_sdspi_t *sdspi, uint8_t index, uint32_t argument, uint32_t wait);
 static int stm32l4_sdspi_wait_ready(stm32l4_sdspi_t *sdspi, uint32_t timeout);
 static int stm32l4_sdspi_receive(stm32l4_sdspi_t *sdspi, uint8_t *data, uint32_t count, uint32_t *p_count);
@@ -263,6 +298,10 @@ static int stm32l4_sdspi_write_sync(stm32l4_sdspi_t *sdspi);
 
 static int stm32l4_sdspi_idle(stm32l4_sdspi_t *sdspi, uint32_t *p_media);
 static int stm32l4_sdspi_reset(stm32l4_sdspi_t *sdspi, uint32_t media);
+#if (DOSFS_CONFIG_SDCARD_CRC == 1) && (DOSFS_CONFIG_SDCARD_SPEED_TRAINING == 1)
+static int stm32l4_sdspi_verify(stm32l4_sdspi_t *sdspi);
+static void stm32l4_sdspi_train(stm32l4_sdspi_t *sdspi);
+#endif /* (DOSFS_CONFIG_SDCARD_CRC == 1) && (DOSFS_CONFIG_SDCARD_SPEED_TRAINING == 1) */
 static int stm32l4_sdspi_lock(stm32l4_sdspi_t *sdspi, int state, uint32_t address);
 static int stm32l4_sdspi_unlock(stm32l4_sdspi_t *sdspi, int status);
 
@@ -298,7 +337,7 @@ static inline __attribute__((optimize("O3"),always_inline)) uint8_t stm32l4_sdsp
     return data;
 }
 
-static inline __attribute__((optimize("O3"))) uint16_t stm32l4_sdspi_read_block(stm32l4_sdspi_t *sdspi, uint8_t *data, uint32_t count)
+static __fastcode __attribute__((optimize("O3"))) uint16_t stm32l4_sdspi_read_block(stm32l4_sdspi_t *sdspi, uint8_t *data, uint32_t count)
 {
     SPI_TypeDef *SPI = sdspi->SPI;
     uint32_t spi_cr1, spi_cr2;
@@ -490,6 +529,35 @@ static void stm32l4_sdspi_deselect(stm32l4_sdspi_t *sdspi)
     stm32l4_system_periph_disable(SYSTEM_PERIPH_SPI1 + sdspi->instance);
 }
 
+/* The SPI clock is the APB clock divided by a power of 2 (2 to 256). Pick the
+ * fastest one that is not above "speed".
+ */
+static uint32_t stm32l4_sdspi_divide(stm32l4_sdspi_t *sdspi, uint32_t speed, uint32_t *p_clock)
+{
+    uint32_t clock, divide;
+
+    if (sdspi->instance == SPI_INSTANCE_SPI1)
+    {
+	clock = stm32l4_system_pclk2() / 2;
+    }
+    else
+    {
+	clock = stm32l4_system_pclk1() / 2;
+    }
+
+    divide = 0;
+	
+    while ((clock > speed) && (divide < 7))
+    {
+	clock /= 2;
+	divide++;
+    }
+
+    *p_clock = clock;
+
+    return divide;
+}
+
 static void stm32l4_sdspi_mode(stm32l4_sdspi_t *sdspi, uint32_t mode)
 {
     SPI_TypeDef *SPI = sdspi->SPI;
@@ -526,25 +594,10 @@ static void stm32l4_sdspi_mode(stm32l4_sdspi_t *sdspi, uint32_t mode)
 	}
 	else
 	{
-	    speed = 25000000;
-	}
-
-	if (sdspi->instance == SPI_INSTANCE_SPI1)
-	{
-	    clock = stm32l4_system_pclk2() / 2;
-	}
-	else
-	{
-	    clock = stm32l4_system_pclk1() / 2;
+	    speed = STM32L4_SDSPI_SPEED_DEFAULT;
 	}
 
-	divide = 0;
-	
-	while ((clock > speed) && (divide < 7))
-	{
-	    clock /= 2;
-	    divide++;
-	}
+	divide = stm32l4_sdspi_divide(sdspi, speed, &clock);
 	
 	sdspi->cr1 = SPI_CR1_SSM | SPI_CR1_SSI | SPI_CR1_MSTR | SPI_CR1_CPHA | SPI_CR1_CPOL | (divide << SPI_CR1_BR_Pos);
 	sdspi->cr2 = 0;
@@ -578,6 +631,46 @@ static void stm32l4_sdspi_mode(stm32l4_sdspi_t *sdspi, uint32_t mode)
     }
     
     sdspi->speed = clock;
+
+    sdspi->device->statistics.clock = clock;
+}
+
+/* Switch the clock of an enabled SPI in data transfer mode to the fastest one
+ * not above "speed".
+ */
+static void stm32l4_sdspi_speed(stm32l4_sdspi_t *sdspi, uint32_t speed)
+{
+    SPI_TypeDef *SPI = sdspi->SPI;
+    uint32_t clock, divide;
+
+    divide = stm32l4_sdspi_divide(sdspi, speed, &clock);
+
+    while (SPI->SR & SPI_SR_BSY) { }
+
+    sdspi->cr1 = (sdspi->cr1 & ~SPI_CR1_BR) | (divide << SPI_CR1_BR_Pos);
+
+    SPI->CR1 = sdspi->cr1;
+    SPI->CR1 = sdspi->cr1 | SPI_CR1_SPE;
+
+    sdspi->speed = clock;
+
+    sdspi->device->statistics.clock = clock;
+}
+
+static void stm32l4_sdspi_fallback(stm32l4_sdspi_t *sdspi)
+{
+    /* A data CRC error above the default clock is taken as a sign that the card/board
+     * combination cannot sustain the trained clock. The interface drops to the next
+     * slower clock for the retry, and any later training stays below it.
+     */
+    if (sdspi->speed > STM32L4_SDSPI_SPEED_DEFAULT)
+    {
+	STM32L4_SDSPI_STATISTICS_COUNT(sdcard_speed_fallback);
+
+	sdspi->speed_limit = sdspi->speed -1;
+
+	stm32l4_sdspi_speed(sdspi, sdspi->speed_limit);
+    }
 }
 
 /*
@@ -615,6 +708,10 @@ static int stm32l4_sdspi_wait_ready(stm32l4_sdspi_t *sdspi, uint32_t timeout)
 	{
 	    status = F_ERR_ONDRIVE;
 	}
+	else
+	{
+	    armv7m_core_relax();
+	}
     }
     while (status == F_NO_ERROR);
 
@@ -634,6 +731,8 @@ static int stm32l4_sdspi_command(stm32l4_sdspi_t *sdspi, uint8_t index, uint32_t
 
     STM32L4_SDSPI_STATISTICS_COUNT(sdcard_command);
 
+    ARMV7M_TRACE_EVENT(ARMV7M_TRACE_SDSPI_CMD, index);
+
     data[0] = 0x40 | index;
     data[1] = argument >> 24;
     data[2] = argument >> 16;
@@ -738,7 +837,7 @@ static int stm32l4_sdspi_command(stm32l4_sdspi_t *sdspi, uint8_t index, uint32_t
 	        stm32l4_gpio_pin_write(sdspi->pins.cs, 1);
 	        stm32l4_gpio_pin_write(sdspi->pins.cs, 0);
 
-		STM32L4_SDSPI_STATISTICS_COUNT(sdcard_command_retry);
+		STM32L4_SDSPI_RETRY_COUNT(sdcard_command_retry);
 		    
 		retries--;
 	    }
@@ -786,6 +885,8 @@ static int stm32l4_sdspi_receive(stm32l4_sdspi_t *sdspi, uint8_t *data, uint32_t
 
     STM32L4_SDSPI_STATISTICS_COUNT(sdcard_receive);
 
+    ARMV7M_TRACE_EVENT(ARMV7M_TRACE_SDSPI_RX, count);
+
     total = count;
     blksz = (count >= 512) ? 512 : count;
 
@@ -816,6 +917,8 @@ static int stm32l4_sdspi_receive(stm32l4_sdspi_t *sdspi, uint8_t *data, uint32_t
 	    {
 	        STM32L4_SDSPI_STATISTICS_COUNT(sdcard_receive_crcfail);
 
+		stm32l4_sdspi_fallback(sdspi);
+
 		/* On a CRC error always send a STOP_TRANSMISSION, just to make sure.
 		 */
 		status = stm32l4_sdspi_command(sdspi, SD_CMD_STOP_TRANSMISSION, 0, 0);
@@ -881,6 +984,8 @@ static int stm32l4_sdspi_transmit(stm32l4_sdspi_t *sdspi, uint8_t start, const u
 
     STM32L4_SDSPI_STATISTICS_COUNT(sdcard_transmit);
 
+    ARMV7M_TRACE_EVENT(ARMV7M_TRACE_SDSPI_TX, count);
+
     *p_check = false;
 
     total = count;
@@ -928,6 +1033,8 @@ static int stm32l4_sdspi_transmit(stm32l4_sdspi_t *sdspi, uint8_t start, const u
 			if (response == SD_DATA_RESPONSE_CRC_ERROR)
 			{
 			    STM32L4_SDSPI_STATISTICS_COUNT(sdcard_transmit_crcfail);
+
+			    stm32l4_sdspi_fallback(sdspi);
 			}
 			else
 			{
@@ -1238,6 +1345,101 @@ static uint32_t stm32l4_sdspi_au_size_table[16] = {
     131072,  /* 64MB  */
 };
 
+#if (DOSFS_CONFIG_SDCARD_CRC == 1) && (DOSFS_CONFIG_SDCARD_SPEED_TRAINING == 1)
+
+/* Read the SD Status a few times at the current clock, and check that it comes
+ * back with a good CRC16, with the same data as at the default clock, and without
+ * any command retries.
+ */
+static int stm32l4_sdspi_verify(stm32l4_sdspi_t *sdspi)
+{
+    int status = F_NO_ERROR;
+    uint32_t retries, count;
+    uint8_t SSR[64];
+    unsigned int n;
+
+    retries = sdspi->device->statistics.retries;
+
+    for (n = 0; n < 4; n++)
+    {
+	status = stm32l4_sdspi_command(sdspi, SD_CMD_APP_CMD, 0, 0);
+		
+	if (status == F_NO_ERROR)
+	{
+	    status = stm32l4_sdspi_command(sdspi, SD_ACMD_SD_STATUS, 0, 1);
+
+	    if (status == F_NO_ERROR)
+	    {
+		status = stm32l4_sdspi_receive(sdspi, &SSR[0], 64, &count);
+		    
+		if ((status == F_NO_ERROR) && ((count != 64) || memcmp(&SSR[0], &sdspi->SSR[0], 64)))
+		{
+		    status = F_ERR_READ;
+		}
+	    }
+	}
+
+	if ((status == F_NO_ERROR) && (retries != sdspi->device->statistics.retries))
+	{
+	    status = F_ERR_READ;
+	}
+
+	if (status != F_NO_ERROR)
+	{
+	    break;
+	}
+    }
+
+    return status;
+}
+
+/* Try the clocks above the default one, fastest first, and keep the first one
+ * that passes stm32l4_sdspi_verify(). A clock that fails is not tried again
+ * until the next stm32l4_sdspi_initialize(). The retries caused by the training
+ * are not reported.
+ */
+static void stm32l4_sdspi_train(stm32l4_sdspi_t *sdspi)
+{
+    int status = F_ERR_READ;
+    uint32_t speed, retries;
+
+    retries = sdspi->device->statistics.retries;
+
+    while ((status != F_NO_ERROR) && (sdspi->speed_limit > STM32L4_SDSPI_SPEED_DEFAULT))
+    {
+	stm32l4_sdspi_speed(sdspi, sdspi->speed_limit);
+
+	speed = sdspi->speed;
+
+	if (speed <= STM32L4_SDSPI_SPEED_DEFAULT)
+	{
+	    break;
+	}
+
+	status = stm32l4_sdspi_verify(sdspi);
+
+	if (status != F_NO_ERROR)
+	{
+	    sdspi->speed_limit = speed -1;
+
+	    /* Let the card finish whatever it was sending at a clock that is known to work.
+	     */
+	    stm32l4_sdspi_speed(sdspi, STM32L4_SDSPI_SPEED_DEFAULT);
+
+	    stm32l4_sdspi_wait_ready(sdspi, 250);
+	}
+    }
+
+    if (status != F_NO_ERROR)
+    {
+	stm32l4_sdspi_speed(sdspi, STM32L4_SDSPI_SPEED_DEFAULT);
+    }
+
+    sdspi->device->statistics.retries = retries;
+}
+
+#endif /* (DOSFS_CONFIG_SDCARD_CRC == 1) && (DOSFS_CONFIG_SDCARD_SPEED_TRAINING == 1) */
+
 static int stm32l4_sdspi_reset(stm32l4_sdspi_t *sdspi, uint32_t media)
 {
     int status = F_NO_ERROR;
@@ -1386,6 +1588,13 @@ static int stm32l4_sdspi_reset(stm32l4_sdspi_t *sdspi, uint32_t media)
 	{
 	    status = stm32l4_sdspi_command(sdspi, SD_CMD_SET_BLOCKLEN, 512, 0);
 	}
+
+#if (DOSFS_CONFIG_SDCARD_CRC == 1) && (DOSFS_CONFIG_SDCARD_SPEED_TRAINING == 1)
+	if (status == F_NO_ERROR)
+	{
+	    stm32l4_sdspi_train(sdspi);
+	}
+#endif /* (DOSFS_CONFIG_SDCARD_CRC == 1) && (DOSFS_CONFIG_SDCARD_SPEED_TRAINING == 1) */
     }
 
     if (status == F_NO_ERROR)
@@ -1436,6 +1645,14 @@ static int stm32l4_sdspi_lock(stm32l4_sdspi_t *sdspi, int state, uint32_t addres
     int status = F_NO_ERROR;
     uint32_t media;
 
+    /* Wait for a pending stm32l4_sdspi_read_async() to finish. The
+     * completion is signalled from the DMA interrupt.
+     */
+    while (sdspi->xf_state != STM32L4_SDSPI_XF_STATE_NONE)
+    {
+	armv7m_core_yield();
+    }
+
 #if defined(DOSFS_PORT_SDCARD_LOCK)
     status = DOSFS_PORT_SDCARD_LOCK();
     
@@ -1614,9 +1831,8 @@ static int stm32l4_sdspi_format(void *context)
     return F_NO_ERROR;
 }
 
-static int stm32l4_sdspi_erase(void *context, uint32_t address, uint32_t length)
+static int stm32l4_sdspi_erase_range(stm32l4_sdspi_t *sdspi, uint32_t address, uint32_t length, uint32_t argument)
 {
-    stm32l4_sdspi_t *sdspi = (stm32l4_sdspi_t*)context;
     int status = F_NO_ERROR;
     uint32_t au_start, au_end, timeout;
 
@@ -1654,7 +1870,7 @@ static int stm32l4_sdspi_erase(void *context, uint32_t address, uint32_t length)
 	
 		if (status == F_NO_ERROR)
 		{
-		    status = stm32l4_sdspi_command(sdspi, SD_CMD_ERASE, 0, 0);
+		    status = stm32l4_sdspi_command(sdspi, SD_CMD_ERASE, argument, 0);
 
 		    if (status == F_NO_ERROR)
 		    {
@@ -1702,9 +1918,42 @@ static int stm32l4_sdspi_erase(void *context, uint32_t address, uint32_t length)
     return status;
 }
 
+static int stm32l4_sdspi_erase(void *context, uint32_t address, uint32_t length)
+{
+    stm32l4_sdspi_t *sdspi = (stm32l4_sdspi_t*)context;
+
+    return stm32l4_sdspi_erase_range(sdspi, address, length, SD_ERASE_ARGUMENT_ERASE);
+}
+
 static int stm32l4_sdspi_discard(void *context, uint32_t address, uint32_t length)
 {
-    return F_NO_ERROR;
+    stm32l4_sdspi_t *sdspi = (stm32l4_sdspi_t*)context;
+    int status = F_NO_ERROR;
+    uint32_t au_start, au_end;
+
+    /* With DISCARD_SUPPORT (SD 5.0) the blocks are simply marked as unused, so
+     * any range can be passed on. Otherwise only the whole AUs within the range
+     * are erased, as erasing a partial AU makes the card copy the rest of it.
+     */
+    if (sdspi->erase_size)
+    {
+	if (stm32l4_sdspi_slice(sdspi->SSR, 512, 313, 1))
+	{
+	    status = stm32l4_sdspi_erase_range(sdspi, address, length, SD_ERASE_ARGUMENT_DISCARD);
+	}
+	else
+	{
+	    au_start = ((address + (sdspi->au_size -1)) / sdspi->au_size);
+	    au_end   = ((address + length) / sdspi->au_size);
+
+	    if (au_start < au_end)
+	    {
+		status = stm32l4_sdspi_erase_range(sdspi, (au_start * sdspi->au_size), ((au_end - au_start) * sdspi->au_size), SD_ERASE_ARGUMENT_ERASE);
+	    }
+	}
+    }
+
+    return status;
 }
 
 static int stm32l4_sdspi_read(void *context, uint32_t address, uint8_t *data, uint32_t length, bool prefetch)
@@ -1737,7 +1986,7 @@ static int stm32l4_sdspi_read(void *context, uint32_t address, uint8_t *data, ui
 #if (DOSFS_CONFIG_SDCARD_CRC == 1) && (DOSFS_CONFIG_SDCARD_DATA_RETRIES != 0)
 			    if (retries)
 			    {
-				STM32L4_SDSPI_STATISTICS_COUNT(sdcard_receive_retry);
+				STM32L4_SDSPI_RETRY_COUNT(sdcard_receive_retry);
 				
 				retries--;
 				
@@ -1813,7 +2062,7 @@ static int stm32l4_sdspi_read(void *context, uint32_t address, uint8_t *data, ui
 			    
 			    if (count)
 			    {
-				STM32L4_SDSPI_STATISTICS_COUNT(sdcard_receive_retry);
+				STM32L4_SDSPI_RETRY_COUNT(sdcard_receive_retry);
 				
 				retries = DOSFS_CONFIG_SDCARD_DATA_RETRIES;
 				
@@ -1823,7 +2072,7 @@ static int stm32l4_sdspi_read(void *context, uint32_t address, uint8_t *data, ui
 			    {
 				if (retries)
 				{
-				    STM32L4_SDSPI_STATISTICS_COUNT(sdcard_receive_retry);
+				    STM32L4_SDSPI_RETRY_COUNT(sdcard_receive_retry);
 				    
 				    retries--;
 				    
@@ -1894,7 +2143,7 @@ static int stm32l4_sdspi_write(void *context, uint32_t address, const uint8_t *d
 #if (DOSFS_CONFIG_SDCARD_CRC == 1) && (DOSFS_CONFIG_SDCARD_DATA_RETRIES != 0)
 			    if (retries)
 			    {
-				STM32L4_SDSPI_STATISTICS_COUNT(sdcard_transmit_retry);
+				STM32L4_SDSPI_RETRY_COUNT(sdcard_transmit_retry);
 			    
 				retries--;
 			    
@@ -1935,7 +2184,25 @@ static int stm32l4_sdspi_write(void *context, uint32_t address, const uint8_t *d
 	    {
 		if (sdspi->state != STM32L4_SDSPI_STATE_WRITE_MULTIPLE)
 		{
-		    status = stm32l4_sdspi_command(sdspi, SD_CMD_WRITE_MULTIPLE_BLOCK, (address << sdspi->shift), 0);
+		    /* Tell the card up front how many blocks are about to be written
+		     * (ACMD23), so it can pre-erase them instead of stalling for an
+		     * erase in the middle of the stream. This is only a hint; writing
+		     * past the count (a streamed write going on) is fine.
+		     */
+		    if (length > 1)
+		    {
+			status = stm32l4_sdspi_command(sdspi, SD_CMD_APP_CMD, 0, 0);
+
+			if (status == F_NO_ERROR)
+			{
+			    status = stm32l4_sdspi_command(sdspi, SD_ACMD_SET_WR_BLK_ERASE_COUNT, (length & 0x007fffff), 0);
+			}
+		    }
+
+		    if (status == F_NO_ERROR)
+		    {
+			status = stm32l4_sdspi_command(sdspi, SD_CMD_WRITE_MULTIPLE_BLOCK, (address << sdspi->shift), 0);
+		    }
 			
 		    if (status == F_NO_ERROR)
 		    {
@@ -1989,7 +2256,7 @@ static int stm32l4_sdspi_write(void *context, uint32_t address, const uint8_t *d
 
 						if (offset)
 						{
-						    STM32L4_SDSPI_STATISTICS_COUNT(sdcard_transmit_retry);
+						    STM32L4_SDSPI_RETRY_COUNT(sdcard_transmit_retry);
 						    
 						    retries = DOSFS_CONFIG_SDCARD_DATA_RETRIES;
 						    
@@ -1999,7 +2266,7 @@ static int stm32l4_sdspi_write(void *context, uint32_t address, const uint8_t *d
 						{
 						    if (retries)
 						    {
-							STM32L4_SDSPI_STATISTICS_COUNT(sdcard_transmit_retry);
+							STM32L4_SDSPI_RETRY_COUNT(sdcard_transmit_retry);
 							
 							retries--;
 							
@@ -2073,6 +2340,327 @@ static int stm32l4_sdspi_sync(void *context, bool wait)
     return status;
 }
 
+static bool stm32l4_sdspi_dma_acquire(stm32l4_sdspi_t *sdspi)
+{
+    /* The DMA channels are claimed lazily on the first asynchronous read, so
+     * that a SPI instance that is also used through the SPI library can still
+     * get its own channels (the secondary SPI1 channels are used if the primary
+     * ones are taken).
+     */
+    if (!sdspi->xf_dma)
+    {
+	switch (sdspi->instance) {
+	case SPI_INSTANCE_SPI1:
+	    if (stm32l4_dma_create(&sdspi->rx_dma, DMA_CHANNEL_DMA1_CH2_SPI1_RX, DOSFS_CONFIG_SDCARD_DMA_PRIORITY) ||
+		stm32l4_dma_create(&sdspi->rx_dma, DMA_CHANNEL_DMA2_CH3_SPI1_RX, DOSFS_CONFIG_SDCARD_DMA_PRIORITY))
+	    {
+		if (stm32l4_dma_create(&sdspi->tx_dma, DMA_CHANNEL_DMA1_CH3_SPI1_TX, DOSFS_CONFIG_SDCARD_DMA_PRIORITY) ||
+		    stm32l4_dma_create(&sdspi->tx_dma, DMA_CHANNEL_DMA2_CH4_SPI1_TX, DOSFS_CONFIG_SDCARD_DMA_PRIORITY))
+		{
+		    sdspi->xf_dma = 1;
+		}
+		else
+		{
+		    stm32l4_dma_destroy(&sdspi->rx_dma);
+		}
+	    }
+	    break;
+
+	case SPI_INSTANCE_SPI3:
+	    if (stm32l4_dma_create(&sdspi->rx_dma, DMA_CHANNEL_DMA2_CH1_SPI3_RX, DOSFS_CONFIG_SDCARD_DMA_PRIORITY))
+	    {
+		if (stm32l4_dma_create(&sdspi->tx_dma, DMA_CHANNEL_DMA2_CH2_SPI3_TX, DOSFS_CONFIG_SDCARD_DMA_PRIORITY))
+		{
+		    sdspi->xf_dma = 1;
+		}
+		else
+		{
+		    stm32l4_dma_destroy(&sdspi->rx_dma);
+		}
+	    }
+	    break;
+	}
+    }
+
+    return !!sdspi->xf_dma;
+}
+
+static void stm32l4_sdspi_xf_token(stm32l4_sdspi_t *sdspi)
+{
+    SPI_TypeDef *SPI = sdspi->SPI;
+
+    /* Clock out a single 0xff and let the RX DMA pick up the
+     * response, which is either 0xff (busy), a "Start Block Token"
+     * or a "Data Error Token".
+     */
+    SPI->CR1 = sdspi->cr1;
+    SPI->CR2 = sdspi->cr2 | SPI_CR2_DS_8BIT | SPI_CR2_FRXTH | SPI_CR2_RXDMAEN;
+
+    stm32l4_dma_start(&sdspi->rx_dma, (uint32_t)&sdspi->xf_token, (uint32_t)&SPI->DR, 1, SDSPI_RX_DMA_OPTION_RECEIVE_8);
+
+    SPI->CR1 = sdspi->cr1 | SPI_CR1_SPE;
+
+    stm32l4_sdspi_wr8(SPI, &sdspi->xf_default);
+}
+
+static void stm32l4_sdspi_xf_data(stm32l4_sdspi_t *sdspi)
+{
+    SPI_TypeDef *SPI = sdspi->SPI;
+    uint32_t spi_cr1;
+
+    spi_cr1 = sdspi->cr1;
+
+    SPI->CR1 = spi_cr1;
+    SPI->CR1 = spi_cr1 | SPI_CR1_CRCEN | SPI_CR1_CRCL;
+    SPI->SR  = 0;
+
+    /* With CRC16 generation, the last 2 bytes transmitted are the CRC16, rather
+     * than 0xff. Hence drive the MOSI line high for the duration of the block.
+     */
+    stm32l4_gpio_pin_write(sdspi->pins.mosi, 1);
+    stm32l4_gpio_pin_output(sdspi->pins.mosi);
+
+    if ((uint32_t)sdspi->xf_data & 1)
+    {
+	SPI->CR2 = sdspi->cr2 | SPI_CR2_DS_8BIT | SPI_CR2_FRXTH | SPI_CR2_RXDMAEN | SPI_CR2_TXDMAEN;
+
+	stm32l4_dma_start(&sdspi->rx_dma, (uint32_t)sdspi->xf_data, (uint32_t)&SPI->DR, DOSFS_BLK_SIZE, SDSPI_RX_DMA_OPTION_RECEIVE_8);
+	stm32l4_dma_start(&sdspi->tx_dma, (uint32_t)&SPI->DR, (uint32_t)&sdspi->xf_default, DOSFS_BLK_SIZE, SDSPI_TX_DMA_OPTION_RECEIVE_8);
+
+	sdspi->xf_state = STM32L4_SDSPI_XF_STATE_DATA_8;
+    }
+    else
+    {
+	SPI->CR2 = sdspi->cr2 | SPI_CR2_DS_8BIT | SPI_CR2_RXDMAEN | SPI_CR2_TXDMAEN;
+
+	stm32l4_dma_start(&sdspi->rx_dma, (uint32_t)sdspi->xf_data, (uint32_t)&SPI->DR, DOSFS_BLK_SIZE / 2, SDSPI_RX_DMA_OPTION_RECEIVE_16);
+	stm32l4_dma_start(&sdspi->tx_dma, (uint32_t)&SPI->DR, (uint32_t)&sdspi->xf_default, DOSFS_BLK_SIZE / 2, SDSPI_TX_DMA_OPTION_RECEIVE_16);
+
+	sdspi->xf_state = STM32L4_SDSPI_XF_STATE_DATA_16;
+    }
+
+    SPI->CR1 = spi_cr1 | SPI_CR1_CRCEN | SPI_CR1_CRCL | SPI_CR1_SPE;
+}
+
+static void stm32l4_sdspi_xf_done(stm32l4_sdspi_t *sdspi, int status)
+{
+    SPI_TypeDef *SPI = sdspi->SPI;
+    F_CALLBACK callback;
+    void *context;
+
+    SPI->CR1 = sdspi->cr1;
+    SPI->CR2 = sdspi->cr2 | SPI_CR2_DS_8BIT | SPI_CR2_FRXTH;
+    SPI->CR1 = sdspi->cr1 | SPI_CR1_SPE;
+
+    stm32l4_dma_disable(&sdspi->rx_dma);
+    stm32l4_dma_disable(&sdspi->tx_dma);
+
+    stm32l4_sdspi_deselect(sdspi);
+
+    if (status != F_NO_ERROR)
+    {
+	STM32L4_SDSPI_STATISTICS_COUNT(sdcard_receive_fail);
+
+	if (sdspi->state == STM32L4_SDSPI_STATE_READ_MULTIPLE)
+	{
+	    /* Force a STOP_TRANSMISSION on the next access.
+	     */
+	    sdspi->address = 0xffffffff;
+	}
+
+	if (status == F_ERR_ONDRIVE)
+	{
+	    /* The card cannot be reset from within the interrupt
+	     * handler. Leave that to the next stm32l4_sdspi_lock().
+	     */
+	    sdspi->state = STM32L4_SDSPI_STATE_RESET;
+	}
+    }
+
+#if defined(DOSFS_PORT_SDCARD_UNLOCK)
+    DOSFS_PORT_SDCARD_UNLOCK();
+#endif /* DOSFS_PORT_SDCARD_UNLOCK */
+
+    callback = sdspi->xf_callback;
+    context = sdspi->xf_context;
+
+    sdspi->xf_callback = NULL;
+    sdspi->xf_context = NULL;
+
+    sdspi->xf_state = STM32L4_SDSPI_XF_STATE_NONE;
+
+    (*callback)(context, status);
+}
+
+static void stm32l4_sdspi_dma_callback(void *context, uint32_t events)
+{
+    stm32l4_sdspi_t *sdspi = (stm32l4_sdspi_t*)context;
+    SPI_TypeDef *SPI = sdspi->SPI;
+    uint32_t spi_cr1;
+    uint8_t token;
+    bool crcerr;
+
+    switch (sdspi->xf_state) {
+    case STM32L4_SDSPI_XF_STATE_TOKEN:
+	token = sdspi->xf_token;
+
+	if (token == SD_START_READ_TOKEN)
+	{
+	    stm32l4_sdspi_xf_data(sdspi);
+	}
+	else if ((token & SD_DATA_ERROR_TOKEN_VALID_MASK) == SD_DATA_ERROR_TOKEN_VALID_DATA)
+	{
+	    sdspi->state = STM32L4_SDSPI_STATE_READY;
+
+	    stm32l4_sdspi_xf_done(sdspi, ((token & SD_DATA_ERROR_CARD_ECC_FAILED) ? F_ERR_INVALIDSECTOR : F_ERR_ONDRIVE));
+	}
+	else
+	{
+	    if (((uint32_t)armv7m_systick_millis() - sdspi->xf_millis) > 100)
+	    {
+	        STM32L4_SDSPI_STATISTICS_COUNT(sdcard_receive_timeout);
+
+		stm32l4_sdspi_xf_done(sdspi, F_ERR_ONDRIVE);
+	    }
+	    else
+	    {
+		stm32l4_sdspi_xf_token(sdspi);
+	    }
+	}
+	break;
+
+    case STM32L4_SDSPI_XF_STATE_DATA_8:
+	/* The TX DMA is done, and the SPI appends the CRC16, which
+	 * needs to be received separately.
+	 */
+	stm32l4_dma_start(&sdspi->rx_dma, (uint32_t)&sdspi->xf_crc16[0], (uint32_t)&SPI->DR, 2, SDSPI_RX_DMA_OPTION_RECEIVE_8);
+
+	sdspi->xf_state = STM32L4_SDSPI_XF_STATE_CRC16;
+	break;
+
+    case STM32L4_SDSPI_XF_STATE_DATA_16:
+	stm32l4_dma_start(&sdspi->rx_dma, (uint32_t)&sdspi->xf_crc16[0], (uint32_t)&SPI->DR, 1, SDSPI_RX_DMA_OPTION_RECEIVE_16);
+
+	sdspi->xf_state = STM32L4_SDSPI_XF_STATE_CRC16;
+	break;
+
+    case STM32L4_SDSPI_XF_STATE_CRC16:
+	while (SPI->SR & SPI_SR_BSY) { }
+
+	crcerr = !!(SPI->SR & SPI_SR_CRCERR);
+
+	spi_cr1 = sdspi->cr1;
+
+	SPI->CR1 = spi_cr1 | SPI_CR1_CRCEN | SPI_CR1_CRCL;
+	SPI->CR1 = spi_cr1;
+	SPI->CR2 = sdspi->cr2 | SPI_CR2_DS_8BIT | SPI_CR2_FRXTH;
+	SPI->CR1 = spi_cr1 | SPI_CR1_SPE;
+
+	stm32l4_gpio_pin_alternate(sdspi->pins.mosi);
+
+#if (DOSFS_CONFIG_SDCARD_CRC == 1)
+	if (crcerr)
+	{
+	    STM32L4_SDSPI_STATISTICS_COUNT(sdcard_receive_crcfail);
+
+	    stm32l4_sdspi_fallback(sdspi);
+
+	    stm32l4_sdspi_xf_done(sdspi, F_ERR_READ);
+	}
+	else
+#endif /* (DOSFS_CONFIG_SDCARD_CRC == 1)  */
+	{
+	    (void)crcerr;
+
+	    STM32L4_SDSPI_STATISTICS_COUNT(sdcard_read_multiple);
+
+	    sdspi->address++;
+	    sdspi->count++;
+
+	    sdspi->xf_data += DOSFS_BLK_SIZE;
+	    sdspi->xf_count--;
+
+	    if (sdspi->xf_count)
+	    {
+		sdspi->xf_state = STM32L4_SDSPI_XF_STATE_TOKEN;
+		sdspi->xf_millis = armv7m_systick_millis();
+
+		stm32l4_sdspi_xf_token(sdspi);
+	    }
+	    else
+	    {
+		stm32l4_sdspi_xf_done(sdspi, F_NO_ERROR);
+	    }
+	}
+	break;
+
+    default:
+	break;
+    }
+}
+
+/* Queue a READ_MULTIPLE of "length" blocks, which is completed in the background by
+ * the SPI RX/TX DMA. Per block the DMA interrupt polls for the "Start Block Token",
+ * receives the data and checks the CRC16. "callback" is invoked from the DMA interrupt
+ * once all blocks are received or on the first error.
+ *
+ * The card is left in READ_MULTIPLE mode, so that a subsequent sequential read picks up
+ * without a new command. F_ERR_BUSY is returned if no DMA channels are available, in
+ * which case the caller should fall back to the blocking path.
+ */
+static int stm32l4_sdspi_read_async(void *context, uint32_t address, uint8_t *data, uint32_t length, F_CALLBACK callback, void *callback_context)
+{
+    stm32l4_sdspi_t *sdspi = (stm32l4_sdspi_t*)context;
+    int status = F_NO_ERROR;
+
+    if (!stm32l4_sdspi_dma_acquire(sdspi))
+    {
+	return F_ERR_BUSY;
+    }
+
+    status = stm32l4_sdspi_lock(sdspi, STM32L4_SDSPI_STATE_READ_MULTIPLE, address);
+
+    if (status == F_NO_ERROR)
+    {
+	if (sdspi->state != STM32L4_SDSPI_STATE_READ_MULTIPLE)
+	{
+	    status = stm32l4_sdspi_command(sdspi, SD_CMD_READ_MULTIPLE_BLOCK, (address << sdspi->shift), 1);
+
+	    if (status == F_NO_ERROR)
+	    {
+		sdspi->state = STM32L4_SDSPI_STATE_READ_MULTIPLE;
+		sdspi->address = address;
+		sdspi->count = 0;
+	    }
+	}
+
+	if (status == F_NO_ERROR)
+	{
+	    STM32L4_SDSPI_STATISTICS_COUNT(sdcard_receive);
+
+	    sdspi->xf_default = 0xffff;
+	    sdspi->xf_data = data;
+	    sdspi->xf_count = length;
+	    sdspi->xf_millis = armv7m_systick_millis();
+	    sdspi->xf_callback = callback;
+	    sdspi->xf_context = callback_context;
+
+	    stm32l4_dma_enable(&sdspi->rx_dma, stm32l4_sdspi_dma_callback, sdspi);
+	    stm32l4_dma_enable(&sdspi->tx_dma, NULL, NULL);
+
+	    sdspi->xf_state = STM32L4_SDSPI_XF_STATE_TOKEN;
+
+	    stm32l4_sdspi_xf_token(sdspi);
+	}
+	else
+	{
+	    status = stm32l4_sdspi_unlock(sdspi, status);
+	}
+    }
+
+    return status;
+}
+
 static const dosfs_device_interface_t stm32l4_sdspi_interface = {
     stm32l4_sdspi_release,
     stm32l4_sdspi_info,
@@ -2082,6 +2670,9 @@ static const dosfs_device_interface_t stm32l4_sdspi_interface = {
     stm32l4_sdspi_read,
     stm32l4_sdspi_write,
     stm32l4_sdspi_sync,
+    stm32l4_sdspi_read_async,
+    NULL,
+    NULL,
 };
 
 
@@ -2094,11 +2685,15 @@ int stm32l4_sdspi_initialize_with_pins(int instance,
     stm32l4_sdspi_t *sdspi = (stm32l4_sdspi_t*)&stm32l4_sdspi;
     int status = F_NO_ERROR;
 
-    dosfs_device.lock = DOSFS_DEVICE_LOCK_INIT;
-    dosfs_device.context = (void*)sdspi;
-    dosfs_device.interface = &stm32l4_sdspi_interface;
+    sdspi->device = dosfs_device_attach(&stm32l4_sdspi_interface, (void*)sdspi);
+
+    if (!sdspi->device)
+    {
+	return F_ERR_INITFUNC;
+    }
 
     sdspi->option = 0;
+    sdspi->speed_limit = STM32L4_SDSPI_SPEED_LIMIT;
 
     if (sdspi->state == STM32L4_SDSPI_STATE_NONE) {
       sdspi->instance  = instance;
@@ -2119,7 +2714,7 @@ int stm32l4_sdspi_initialize_with_pins(int instance,
       sdspi->state = STM32L4_SDSPI_STATE_INIT;
     }
     
-    dosfs_device.lock = 0;
+    sdspi->device->lock = 0;
 
     return status;
 }
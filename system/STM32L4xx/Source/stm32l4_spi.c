@@ -129,6 +129,21 @@ static stm32l4_spi_driver_t stm32l4_spi_driver;
      DMA_OPTION_MEMORY_DATA_INCREMENT |	  \
      DMA_OPTION_PRIORITY_MEDIUM)
 
+#define SPI_RX_DMA_OPTION_SLAVE_8	  \
+    (DMA_OPTION_PERIPHERAL_TO_MEMORY |	  \
+     DMA_OPTION_CIRCULAR |		  \
+     DMA_OPTION_PERIPHERAL_DATA_SIZE_8 |  \
+     DMA_OPTION_MEMORY_DATA_SIZE_8 |	  \
+     DMA_OPTION_MEMORY_DATA_INCREMENT |	  \
+     DMA_OPTION_PRIORITY_HIGH)
+
+#define SPI_TX_DMA_OPTION_SLAVE_8	  \
+    (DMA_OPTION_MEMORY_TO_PERIPHERAL |	  \
+     DMA_OPTION_CIRCULAR |		  \
+     DMA_OPTION_PERIPHERAL_DATA_SIZE_8 |  \
+     DMA_OPTION_MEMORY_DATA_SIZE_8 |	  \
+     DMA_OPTION_PRIORITY_HIGH)
+
 static void stm32l4_spi_dma_callback(stm32l4_spi_t *spi, uint32_t events);
 
 static inline __attribute__((optimize("O3"),always_inline)) void stm32l4_spi_rd8(SPI_TypeDef *SPI, void *rx_data)
@@ -192,6 +207,8 @@ static void stm32l4_spi_dma_callback(stm32l4_spi_t *spi, uint32_t events)
     SPI_TypeDef *SPI = spi->SPI;
     uint32_t spi_cr1;
 
+    ARMV7M_TRACE_EVENT(ARMV7M_TRACE_SPI_DMA, ((spi->instance << 16) | events));
+
     if (SPI->CR1 & SPI_CR1_CRCEN)
     {
 	if (spi->xf_size != 0)
@@ -260,6 +277,8 @@ static void stm32l4_spi_finish(stm32l4_spi_t *spi, uint32_t events)
 {
     SPI_TypeDef *SPI = spi->SPI;
 
+    ARMV7M_TRACE_EVENT(ARMV7M_TRACE_SPI_DONE, ((spi->instance << 16) | events));
+
     NVIC_DisableIRQ(spi->interrupt);
 	
     SPI->CR2 = spi->cr2 | (SPI_CR2_DS_8BIT | SPI_CR2_FRXTH);
@@ -296,6 +315,7 @@ static void stm32l4_spi_interrupt(stm32l4_spi_t *spi)
     case SPI_STATE_TRANSMIT_16_DMA:
     case SPI_STATE_TRANSFER_8_DMA:
     case SPI_STATE_TRANSFER_16_DMA:
+    case SPI_STATE_FRAMES_DMA:
 	break;
 
     case SPI_STATE_HALFDUPLEX_8_M:
@@ -736,6 +756,18 @@ static void stm32l4_spi_interrupt(stm32l4_spi_t *spi)
     }
 }
 
+static const uint8_t stm32l4_spi_spi1_rx_dma[] = {
+    DMA_CHANNEL_DMA1_CH2_SPI1_RX,
+    DMA_CHANNEL_DMA2_CH3_SPI1_RX,
+    DMA_CHANNEL_NONE,
+};
+
+static const uint8_t stm32l4_spi_spi1_tx_dma[] = {
+    DMA_CHANNEL_DMA1_CH3_SPI1_TX,
+    DMA_CHANNEL_DMA2_CH4_SPI1_TX,
+    DMA_CHANNEL_NONE,
+};
+
 bool stm32l4_spi_create(stm32l4_spi_t *spi, unsigned int instance, const stm32l4_spi_pins_t *pins, unsigned int priority, unsigned int mode)
 {
     spi->state = SPI_STATE_INIT;
@@ -774,8 +806,7 @@ bool stm32l4_spi_create(stm32l4_spi_t *spi, unsigned int instance, const stm32l4
     {
 	switch (spi->instance) {
 	case SPI_INSTANCE_SPI1:
-	    if ((!(mode & SPI_MODE_RX_DMA_SECONDARY) && stm32l4_dma_create(&spi->rx_dma, DMA_CHANNEL_DMA1_CH2_SPI1_RX, spi->priority)) ||
-		stm32l4_dma_create(&spi->rx_dma, DMA_CHANNEL_DMA2_CH3_SPI1_RX, spi->priority))
+	    if (stm32l4_dma_allocate(&spi->rx_dma, &stm32l4_spi_spi1_rx_dma[(mode & SPI_MODE_RX_DMA_SECONDARY) ? 1 : 0], spi->priority))
 	    {
 		spi->mode |= SPI_MODE_RX_DMA;
 	    }
@@ -795,8 +826,7 @@ bool stm32l4_spi_create(stm32l4_spi_t *spi, unsigned int instance, const stm32l4
     {
 	switch (spi->instance) {
 	case SPI_INSTANCE_SPI1:
-	    if ((!(mode & SPI_MODE_TX_DMA_SECONDARY) && stm32l4_dma_create(&spi->tx_dma, DMA_CHANNEL_DMA1_CH3_SPI1_TX, spi->priority)) ||
-		stm32l4_dma_create(&spi->tx_dma, DMA_CHANNEL_DMA2_CH4_SPI1_TX, spi->priority))
+	    if (stm32l4_dma_allocate(&spi->tx_dma, &stm32l4_spi_spi1_tx_dma[(mode & SPI_MODE_TX_DMA_SECONDARY) ? 1 : 0], spi->priority))
 	    {
 		spi->mode |= SPI_MODE_TX_DMA;
 	    }
@@ -863,6 +893,18 @@ bool stm32l4_spi_destroy(stm32l4_spi_t *spi)
     return true;
 }
 
+/* Returns the stm32l4_spi_t that currently owns "instance", or NULL if there is none.
+ */
+stm32l4_spi_t *stm32l4_spi_get(unsigned int instance)
+{
+    if (instance >= SPI_INSTANCE_COUNT)
+    {
+	return NULL;
+    }
+
+    return stm32l4_spi_driver.instances[instance];
+}
+
 uint32_t stm32l4_spi_clock(stm32l4_spi_t *spi)
 {
     if (spi->instance == SPI_INSTANCE_SPI1)
@@ -1044,7 +1086,7 @@ bool stm32l4_spi_configure(stm32l4_spi_t *spi, uint32_t option)
     return true;
 }
 
-__attribute__((optimize("O3"))) void stm32l4_spi_exchange(stm32l4_spi_t *spi, const uint8_t *tx_data, uint8_t *rx_data, unsigned int count)
+__optimize_speed void stm32l4_spi_exchange(stm32l4_spi_t *spi, const uint8_t *tx_data, uint8_t *rx_data, unsigned int count)
 {
     SPI_TypeDef *SPI = spi->SPI;
     uint8_t *rx_data_e;
@@ -1228,7 +1270,7 @@ __attribute__((optimize("O3"))) void stm32l4_spi_exchange(stm32l4_spi_t *spi, co
     }
 }
 
-uint8_t stm32l4_spi_exchange8(stm32l4_spi_t *spi, uint8_t data)
+__optimize_speed uint8_t stm32l4_spi_exchange8(stm32l4_spi_t *spi, uint8_t data)
 {
     SPI_TypeDef *SPI = spi->SPI;
 
@@ -1240,7 +1282,7 @@ uint8_t stm32l4_spi_exchange8(stm32l4_spi_t *spi, uint8_t data)
     return data;
 }
 
-uint16_t stm32l4_spi_exchange16(stm32l4_spi_t *spi, uint16_t data)
+__optimize_speed uint16_t stm32l4_spi_exchange16(stm32l4_spi_t *spi, uint16_t data)
 {
     SPI_TypeDef *SPI = spi->SPI;
 
@@ -1270,6 +1312,151 @@ uint16_t stm32l4_spi_exchange16(stm32l4_spi_t *spi, uint16_t data)
     return data;
 }
 
+/* Frames of up to 8 bits are accessed as bytes with RXNE at 8 bits (FRXTH), wider ones as
+ * half words with RXNE at 16 bits. The 32 bit FIFO then holds 4 or 2 frames, so 3 or 2
+ * frames are kept in flight ahead of the one being read back.
+ */
+__optimize_speed void stm32l4_spi_exchange_frames(stm32l4_spi_t *spi, const uint16_t *tx_data, uint16_t *rx_data, unsigned int count, unsigned int bits)
+{
+    SPI_TypeDef *SPI = spi->SPI;
+    unsigned int depth, tx_count, rx_count;
+    uint16_t data;
+
+    if ((bits < 4) || (bits > 16) || (count == 0))
+    {
+	return;
+    }
+
+    if (bits <= 8)
+    {
+	SPI->CR2 = spi->cr2 | ((bits -1) << SPI_CR2_DS_Pos) | SPI_CR2_FRXTH;
+
+	depth = 3;
+    }
+    else
+    {
+	SPI->CR2 = spi->cr2 | ((bits -1) << SPI_CR2_DS_Pos);
+
+	depth = 2;
+    }
+
+    tx_count = 0;
+    rx_count = 0;
+
+    while (rx_count != count)
+    {
+	while ((tx_count != count) && ((tx_count - rx_count) < depth))
+	{
+	    data = tx_data ? tx_data[tx_count] : 0xffff;
+
+	    if (bits <= 8)
+	    {
+		*((volatile uint8_t*)(&SPI->DR)) = data;
+	    }
+	    else
+	    {
+		SPI->DR = data;
+	    }
+
+	    tx_count++;
+	}
+
+	while (!(SPI->SR & SPI_SR_RXNE)) { }
+
+	if (bits <= 8)
+	{
+	    data = *((volatile uint8_t*)(&SPI->DR));
+	}
+	else
+	{
+	    data = SPI->DR;
+	}
+
+	if (rx_data)
+	{
+	    rx_data[rx_count] = data;
+	}
+
+	rx_count++;
+    }
+
+    SPI->CR2 = spi->cr2 | (SPI_CR2_DS_8BIT | SPI_CR2_FRXTH);
+}
+
+bool stm32l4_spi_transfer_frames(stm32l4_spi_t *spi, const uint16_t *tx_data, uint16_t *rx_data, unsigned int count, unsigned int bits)
+{
+    SPI_TypeDef *SPI = spi->SPI;
+    uint32_t spi_cr1, spi_cr2, rx_option, tx_option;
+
+    if (spi->state != SPI_STATE_SELECTED)
+    {
+	return false;
+    }
+
+    if ((spi->mode & (SPI_MODE_RX_DMA | SPI_MODE_TX_DMA)) != (SPI_MODE_RX_DMA | SPI_MODE_TX_DMA))
+    {
+	return false;
+    }
+
+    if ((bits < 4) || (bits > 16) || (count == 0) || (count > 65535))
+    {
+	return false;
+    }
+
+    spi_cr1 = spi->cr1 | (spi->option & (SPI_OPTION_MODE_MASK | SPI_OPTION_DIV_MASK | SPI_OPTION_LSB_FIRST));
+    spi_cr2 = spi->cr2 | ((bits -1) << SPI_CR2_DS_Pos) | SPI_CR2_RXDMAEN | SPI_CR2_TXDMAEN;
+
+    /* The DMA widens/narrows between the 8 or 16 bit DR access and the 16 bit memory side.
+     */
+    rx_option = (DMA_OPTION_EVENT_TRANSFER_DONE | DMA_OPTION_PERIPHERAL_TO_MEMORY | DMA_OPTION_MEMORY_DATA_SIZE_16 | DMA_OPTION_PRIORITY_MEDIUM);
+    tx_option = (DMA_OPTION_MEMORY_TO_PERIPHERAL | DMA_OPTION_MEMORY_DATA_SIZE_16 | DMA_OPTION_PRIORITY_MEDIUM);
+
+    if (bits <= 8)
+    {
+	spi_cr2 |= SPI_CR2_FRXTH;
+
+	rx_option |= DMA_OPTION_PERIPHERAL_DATA_SIZE_8;
+	tx_option |= DMA_OPTION_PERIPHERAL_DATA_SIZE_8;
+    }
+    else
+    {
+	rx_option |= DMA_OPTION_PERIPHERAL_DATA_SIZE_16;
+	tx_option |= DMA_OPTION_PERIPHERAL_DATA_SIZE_16;
+    }
+
+    spi->xf_count = 0;
+    spi->xf_size = count;
+    spi->tx_data = (const uint8_t*)tx_data;
+    spi->rx_data = (uint8_t*)rx_data;
+
+    SPI->CR1 = spi_cr1;
+    SPI->CR2 = spi_cr2;
+
+    if (rx_data)
+    {
+	stm32l4_dma_start(&spi->rx_dma, (uint32_t)rx_data, (uint32_t)&SPI->DR, count, (rx_option | DMA_OPTION_MEMORY_DATA_INCREMENT));
+    }
+    else
+    {
+	stm32l4_dma_start(&spi->rx_dma, (uint32_t)&spi->rx_null, (uint32_t)&SPI->DR, count, rx_option);
+    }
+
+    if (tx_data)
+    {
+	stm32l4_dma_start(&spi->tx_dma, (uint32_t)&SPI->DR, (uint32_t)tx_data, count, (tx_option | DMA_OPTION_MEMORY_DATA_INCREMENT));
+    }
+    else
+    {
+	stm32l4_dma_start(&spi->tx_dma, (uint32_t)&SPI->DR, (uint32_t)&spi->tx_default, count, tx_option);
+    }
+
+    spi->state = SPI_STATE_FRAMES_DMA;
+
+    SPI->CR1 = spi_cr1 | SPI_CR1_SPE;
+
+    return true;
+}
+
 bool stm32l4_spi_receive(stm32l4_spi_t *spi, uint8_t *rx_data, unsigned int rx_count, uint32_t control)
 {
     SPI_TypeDef *SPI = spi->SPI;
@@ -1813,6 +2000,177 @@ bool stm32l4_spi_transfer(stm32l4_spi_t *spi, const uint8_t *tx_data, uint8_t *r
     return true;
 }
 
+bool stm32l4_spi_pipe(stm32l4_spi_t *spi, stm32l4_dma_pipe_t *pipe, bool receive, bool wide)
+{
+    SPI_TypeDef *SPI = spi->SPI;
+    uint32_t spi_cr1, spi_cr2;
+
+    spi_cr1 = spi->cr1 | (spi->option & (SPI_OPTION_MODE_MASK | SPI_OPTION_DIV_MASK | SPI_OPTION_LSB_FIRST));
+
+    if (pipe)
+    {
+	if (spi->state != SPI_STATE_SELECTED)
+	{
+	    return false;
+	}
+
+	/* A pipe only moves data in one direction, so the SPI is run either as
+	 * a receive-only or as a transmit-only (BIDIOE) interface.
+	 */
+	if (receive)
+	{
+	    if (!(spi->mode & SPI_MODE_RX_DMA) ||
+		!stm32l4_dma_pipe_source(pipe, &spi->rx_dma, (uint32_t)&SPI->DR, (wide ? SPI_RX_DMA_OPTION_RECEIVE_16 : SPI_RX_DMA_OPTION_RECEIVE_8)))
+	    {
+		return false;
+	    }
+
+	    spi_cr1 |= SPI_CR1_RXONLY;
+	    spi_cr2 = spi->cr2 | (wide ? SPI_CR2_DS_16BIT : (SPI_CR2_DS_8BIT | SPI_CR2_FRXTH)) | SPI_CR2_RXDMAEN;
+	}
+	else
+	{
+	    if (!(spi->mode & SPI_MODE_TX_DMA) ||
+		!stm32l4_dma_pipe_sink(pipe, &spi->tx_dma, (uint32_t)&SPI->DR, (wide ? SPI_TX_DMA_OPTION_TRANSMIT_16 : SPI_TX_DMA_OPTION_TRANSMIT_8)))
+	    {
+		return false;
+	    }
+
+	    spi_cr1 |= (SPI_CR1_BIDIMODE | SPI_CR1_BIDIOE);
+	    spi_cr2 = spi->cr2 | (wide ? SPI_CR2_DS_16BIT : SPI_CR2_DS_8BIT) | SPI_CR2_TXDMAEN;
+	}
+
+	spi->state = SPI_STATE_PIPE;
+
+	SPI->CR1 = spi_cr1;
+	SPI->CR2 = spi_cr2;
+	SPI->CR1 = spi_cr1 | SPI_CR1_SPE;
+    }
+    else
+    {
+	if (spi->state != SPI_STATE_PIPE)
+	{
+	    return false;
+	}
+
+	if (!(SPI->CR1 & SPI_CR1_RXONLY))
+	{
+	    while (SPI->SR & SPI_SR_FTLVL) { }
+	    while (SPI->SR & SPI_SR_BSY) { }
+	}
+
+	SPI->CR1 = spi_cr1;
+
+	while (SPI->SR & SPI_SR_FRLVL)
+	{
+	    SPI->DR;
+	}
+
+	SPI->CR2 = spi->cr2 | (SPI_CR2_DS_8BIT | SPI_CR2_FRXTH);
+	SPI->CR1 = spi_cr1 | SPI_CR1_SPE;
+
+	spi->state = SPI_STATE_SELECTED;
+    }
+
+    return true;
+}
+
+bool stm32l4_spi_slave(stm32l4_spi_t *spi, uint32_t option, uint16_t ss, uint8_t *rx_data, const uint8_t *tx_data, uint16_t count)
+{
+    SPI_TypeDef *SPI = spi->SPI;
+
+    if (rx_data)
+    {
+	if ((spi->state != SPI_STATE_READY) || (ss == GPIO_PIN_NONE) || (count == 0))
+	{
+	    return false;
+	}
+
+	if ((spi->mode & (SPI_MODE_RX_DMA | SPI_MODE_TX_DMA)) != (SPI_MODE_RX_DMA | SPI_MODE_TX_DMA))
+	{
+	    return false;
+	}
+
+	spi->option = option;
+	spi->slave_ss = (ss & ~GPIO_PIN_AFSEL_MASK) | (((spi->instance == SPI_INSTANCE_SPI3) ? 6 : 5) << GPIO_PIN_AFSEL_SHIFT);
+
+	stm32l4_spi_start(spi);
+
+	spi->state = SPI_STATE_SLAVE;
+
+	stm32l4_system_lock(SYSTEM_LOCK_SLEEP);
+
+	stm32l4_gpio_pin_configure(spi->slave_ss, (GPIO_PUPD_PULLUP | GPIO_OSPEED_HIGH | GPIO_OTYPE_PUSHPULL | GPIO_MODE_ALTERNATE));
+
+	/* Slave DMA setup order from RM0394: RXDMAEN, then both DMA channels, then
+	 * TXDMAEN, and SPE last.
+	 */
+	SPI->CR1 = (spi->option & (SPI_OPTION_MODE_MASK | SPI_OPTION_LSB_FIRST));
+	SPI->CR2 = (SPI_CR2_DS_8BIT | SPI_CR2_FRXTH | SPI_CR2_RXDMAEN);
+
+	stm32l4_dma_start(&spi->rx_dma, (uint32_t)rx_data, (uint32_t)&SPI->DR, count, SPI_RX_DMA_OPTION_SLAVE_8);
+
+	if (tx_data)
+	{
+	    stm32l4_dma_start(&spi->tx_dma, (uint32_t)&SPI->DR, (uint32_t)tx_data, count, (SPI_TX_DMA_OPTION_SLAVE_8 | DMA_OPTION_MEMORY_DATA_INCREMENT));
+	}
+	else
+	{
+	    stm32l4_dma_start(&spi->tx_dma, (uint32_t)&SPI->DR, (uint32_t)&spi->tx_default, count, SPI_TX_DMA_OPTION_SLAVE_8);
+	}
+
+	SPI->CR2 = (SPI_CR2_DS_8BIT | SPI_CR2_FRXTH | SPI_CR2_RXDMAEN | SPI_CR2_TXDMAEN);
+	SPI->CR1 = (spi->option & (SPI_OPTION_MODE_MASK | SPI_OPTION_LSB_FIRST)) | SPI_CR1_SPE;
+    }
+    else
+    {
+	if (spi->state != SPI_STATE_SLAVE)
+	{
+	    return false;
+	}
+
+	SPI->CR1 = 0;
+
+	stm32l4_dma_stop(&spi->tx_dma);
+	stm32l4_dma_stop(&spi->rx_dma);
+
+	/* Bytes the TX DMA had already pushed into the TX FIFO can only be dropped
+	 * by a peripheral reset.
+	 */
+	stm32l4_system_periph_reset(SYSTEM_PERIPH_SPI1 + spi->instance);
+
+	SPI->CRCPR = 0x1021;
+	SPI->CR2 = spi->cr2;
+	SPI->CR1 = spi->cr1;
+
+	stm32l4_gpio_pin_configure(spi->slave_ss, (GPIO_PUPD_NONE | GPIO_MODE_ANALOG));
+
+	stm32l4_system_unlock(SYSTEM_LOCK_SLEEP);
+
+	spi->state = SPI_STATE_READY;
+
+	stm32l4_spi_stop(spi);
+    }
+
+    return true;
+}
+
+uint16_t stm32l4_spi_slave_offset(stm32l4_spi_t *spi)
+{
+    SPI_TypeDef *SPI = spi->SPI;
+
+    if (spi->state != SPI_STATE_SLAVE)
+    {
+	return 0;
+    }
+
+    /* Let the RX DMA catch up with what is still in the RX FIFO.
+     */
+    while (SPI->SR & SPI_SR_FRLVL) { }
+
+    return stm32l4_dma_count(&spi->rx_dma);
+}
+
 bool stm32l4_spi_done(stm32l4_spi_t *spi)
 {
     return (spi->state <= SPI_STATE_SELECTED);
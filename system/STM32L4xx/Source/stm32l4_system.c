@@ -41,9 +41,20 @@ extern uint32_t __backup_start__;
 extern uint32_t __backup_end__;
 extern uint32_t __etextbkp;
 
+#define SYSTEM_SAICLK_CACHE_COUNT 4
+
+typedef struct _stm32l4_system_saiclk_entry_t {
+    uint32_t                  clock;
+    uint32_t                  fref;
+    uint32_t                  fvco;   /* upper VCO limit */
+    uint32_t                  config; /* N/P fields of PLLSAIxCFGR */
+    int32_t                   error;  /* ppm */
+} stm32l4_system_saiclk_entry_t;
+
 typedef struct _stm32l4_system_device_t {
     uint16_t                  reset;
     uint16_t                  wakeup;
+    uint8_t                   stop; /* SYSTEM_STOP_* of the last stm32l4_system_stop() */
     uint32_t                  lseclk;
     uint32_t                  hseclk;
     uint32_t                  sysclk;
@@ -52,11 +63,15 @@ typedef struct _stm32l4_system_device_t {
     uint32_t                  pclk1;
     uint32_t                  pclk2;
     uint32_t                  saiclk;
+    int32_t                   saiclk_error; /* ppm */
+    uint8_t                   saiclk_next;
+    stm32l4_system_saiclk_entry_t saiclk_cache[SYSTEM_SAICLK_CACHE_COUNT];
     uint8_t                   clk48; /* bitfield of systems using hsi48 clock */
     uint8_t                   mco;
     uint8_t                   lsco;
     uint8_t                   lsi;
     uint8_t                   hsi16;
+    uint32_t                  flash; /* FLASH_ACR cache/prefetch enables */
 #if defined(STM32L432xx) || defined(STM32L433xx) || defined(STM32L452xx) || defined(STM32L496xx)
     uint8_t                   hsi48;
 #endif
@@ -74,6 +89,7 @@ static volatile uint32_t * const stm32l4_system_xlate_RSTR[] = {
     NULL,            /* SYSTEM_PERIPH_SRAM2 */
     &RCC->AHB1RSTR,  /* SYSTEM_PERIPH_DMA1 */
     &RCC->AHB1RSTR,  /* SYSTEM_PERIPH_DMA2 */
+    &RCC->AHB1RSTR,  /* SYSTEM_PERIPH_CRC */
     &RCC->AHB2RSTR,  /* SYSTEM_PERIPH_GPIOA */
     &RCC->AHB2RSTR,  /* SYSTEM_PERIPH_GPIOB */
 #ifdef GPIOC_BASE
@@ -102,6 +118,8 @@ static volatile uint32_t * const stm32l4_system_xlate_RSTR[] = {
 #else
     &RCC->APB1RSTR1, /* SYSTEM_PERIPH_USB */
 #endif
+    &RCC->AHB2RSTR,  /* SYSTEM_PERIPH_RNG */
+    &RCC->AHB1RSTR,  /* SYSTEM_PERIPH_TSC */
     &RCC->APB2RSTR,  /* SYSTEM_PERIPH_USART1 */
     &RCC->APB1RSTR1, /* SYSTEM_PERIPH_USART2 */
 #ifdef USART3_BASE
@@ -175,6 +193,7 @@ static uint32_t const stm32l4_system_xlate_RSTMSK[] = {
     0,                        /* SYSTEM_PERIPH_SRAM2 */
     RCC_AHB1RSTR_DMA1RST,     /* SYSTEM_PERIPH_DMA1 */
     RCC_AHB1RSTR_DMA2RST,     /* SYSTEM_PERIPH_DMA2 */
+    RCC_AHB1RSTR_CRCRST,      /* SYSTEM_PERIPH_CRC */
     RCC_AHB2RSTR_GPIOARST,    /* SYSTEM_PERIPH_GPIOA */
     RCC_AHB2RSTR_GPIOBRST,    /* SYSTEM_PERIPH_GPIOB */
 #ifdef GPIOC_BASE
@@ -203,6 +222,8 @@ static uint32_t const stm32l4_system_xlate_RSTMSK[] = {
 #else
     RCC_APB1RSTR1_USBFSRST,   /* SYSTEM_PERIPH_USB */
 #endif
+    RCC_AHB2RSTR_RNGRST,      /* SYSTEM_PERIPH_RNG */
+    RCC_AHB1RSTR_TSCRST,      /* SYSTEM_PERIPH_TSC */
     RCC_APB2RSTR_USART1RST,   /* SYSTEM_PERIPH_USART1 */
     RCC_APB1RSTR1_USART2RST,  /* SYSTEM_PERIPH_USART2 */
 #ifdef USART3_BASE
@@ -276,6 +297,7 @@ static volatile uint32_t * const stm32l4_system_xlate_ENR[] = {
     NULL,           /* SYSTEM_PERIPH_SRAM2 */
     &RCC->AHB1ENR,  /* SYSTEM_PERIPH_DMA1 */
     &RCC->AHB1ENR,  /* SYSTEM_PERIPH_DMA2 */
+    &RCC->AHB1ENR,  /* SYSTEM_PERIPH_CRC */
     &RCC->AHB2ENR,  /* SYSTEM_PERIPH_GPIOA */
     &RCC->AHB2ENR,  /* SYSTEM_PERIPH_GPIOB */
 #ifdef GPIOC_BASE
@@ -304,6 +326,8 @@ static volatile uint32_t * const stm32l4_system_xlate_ENR[] = {
 #else
     &RCC->APB1ENR1, /* SYSTEM_PERIPH_USB */
 #endif
+    &RCC->AHB2ENR,  /* SYSTEM_PERIPH_RNG */
+    &RCC->AHB1ENR,  /* SYSTEM_PERIPH_TSC */
     &RCC->APB2ENR,  /* SYSTEM_PERIPH_USART1 */
     &RCC->APB1ENR1, /* SYSTEM_PERIPH_USART2 */
 #ifdef USART3_BASE
@@ -377,6 +401,7 @@ static uint32_t const stm32l4_system_xlate_ENMSK[] = {
     0,                      /* SYSTEM_PERIPH_SRAM2 */
     RCC_AHB1ENR_DMA1EN,     /* SYSTEM_PERIPH_DMA1 */
     RCC_AHB1ENR_DMA2EN,     /* SYSTEM_PERIPH_DMA2 */
+    RCC_AHB1ENR_CRCEN,      /* SYSTEM_PERIPH_CRC */
     RCC_AHB2ENR_GPIOAEN,    /* SYSTEM_PERIPH_GPIOA */
     RCC_AHB2ENR_GPIOBEN,    /* SYSTEM_PERIPH_GPIOB */
 #ifdef GPIOC_BASE
@@ -405,6 +430,8 @@ static uint32_t const stm32l4_system_xlate_ENMSK[] = {
 #else
     RCC_APB1ENR1_USBFSEN,   /* SYSTEM_PERIPH_USB */
 #endif
+    RCC_AHB2ENR_RNGEN,      /* SYSTEM_PERIPH_RNG */
+    RCC_AHB1ENR_TSCEN,      /* SYSTEM_PERIPH_TSC */
     RCC_APB2ENR_USART1EN,   /* SYSTEM_PERIPH_USART1 */
     RCC_APB1ENR1_USART2EN,  /* SYSTEM_PERIPH_USART2 */
 #ifdef USART3_BASE
@@ -478,6 +505,7 @@ static volatile uint32_t * const stm32l4_system_xlate_SMENR[] = {
     &RCC->AHB2SMENR,  /* SYSTEM_PERIPH_SRAM2 */
     &RCC->AHB1SMENR,  /* SYSTEM_PERIPH_DMA1 */
     &RCC->AHB1SMENR,  /* SYSTEM_PERIPH_DMA2 */
+    &RCC->AHB1SMENR,  /* SYSTEM_PERIPH_CRC */
     &RCC->AHB2SMENR,  /* SYSTEM_PERIPH_GPIOA */
     &RCC->AHB2SMENR,  /* SYSTEM_PERIPH_GPIOB */
 #ifdef GPIOC_BASE
@@ -506,6 +534,8 @@ static volatile uint32_t * const stm32l4_system_xlate_SMENR[] = {
 #else
     &RCC->APB1SMENR1, /* SYSTEM_PERIPH_USB */
 #endif
+    &RCC->AHB2SMENR,  /* SYSTEM_PERIPH_RNG */
+    &RCC->AHB1SMENR,  /* SYSTEM_PERIPH_TSC */
     &RCC->APB2SMENR,  /* SYSTEM_PERIPH_USART1 */
     &RCC->APB1SMENR1, /* SYSTEM_PERIPH_USART2 */
 #ifdef USART3_BASE
@@ -579,6 +609,7 @@ static uint32_t const stm32l4_system_xlate_SMENMSK[] = {
     RCC_AHB2SMENR_SRAM2SMEN,    /* SYSTEM_PERIPH_SRAM2 */
     RCC_AHB1SMENR_DMA1SMEN,     /* SYSTEM_PERIPH_DMA1 */
     RCC_AHB1SMENR_DMA2SMEN,     /* SYSTEM_PERIPH_DMA2 */
+    RCC_AHB1SMENR_CRCSMEN,      /* SYSTEM_PERIPH_CRC */
     RCC_AHB2SMENR_GPIOASMEN,    /* SYSTEM_PERIPH_GPIOA */
     RCC_AHB2SMENR_GPIOBSMEN,    /* SYSTEM_PERIPH_GPIOB */
 #ifdef GPIOC_BASE
@@ -607,6 +638,8 @@ static uint32_t const stm32l4_system_xlate_SMENMSK[] = {
 #else
     RCC_APB1SMENR1_USBFSSMEN,   /* SYSTEM_PERIPH_USB */
 #endif
+    RCC_AHB2SMENR_RNGSMEN,      /* SYSTEM_PERIPH_RNG */
+    RCC_AHB1SMENR_TSCSMEN,      /* SYSTEM_PERIPH_TSC */
     RCC_APB2SMENR_USART1SMEN,   /* SYSTEM_PERIPH_USART1 */
     RCC_APB1SMENR1_USART2SMEN,  /* SYSTEM_PERIPH_USART2 */
 #ifdef USART3_BASE
@@ -773,6 +806,15 @@ void stm32l4_system_initialize(uint32_t hclk, uint32_t pclk1, uint32_t pclk2, ui
 
     __disable_irq();
 
+    stm32l4_system_device.flash = FLASH_ACR_ICEN | FLASH_ACR_DCEN;
+
+    if (option & SYSTEM_OPTION_FLASH_PREFETCH)
+    {
+	stm32l4_system_device.flash |= FLASH_ACR_PRFTEN;
+    }
+
+    FLASH->ACR = (FLASH->ACR & ~(FLASH_ACR_ICEN | FLASH_ACR_DCEN | FLASH_ACR_PRFTEN)) | stm32l4_system_device.flash;
+
     if (PWR->SR1 & PWR_SR1_SBF)
     {
 	stm32l4_system_device.reset = SYSTEM_RESET_STANDBY;
@@ -1052,11 +1094,217 @@ void stm32l4_system_initialize(uint32_t hclk, uint32_t pclk1, uint32_t pclk2, ui
     __set_PRIMASK(primask);
 }
 
+/* The wait states follow HCLK/range in stm32l4_system_sysclk_configure(), while the
+ * cache/prefetch enables set here are kept across clock changes.
+ */
+void stm32l4_system_flash_configure(uint32_t option)
+{
+    uint32_t primask, flash_acr;
+
+    primask = __get_PRIMASK();
+
+    __disable_irq();
+
+    stm32l4_system_device.flash = 0;
+
+    if (option & SYSTEM_FLASH_ICACHE)
+    {
+	stm32l4_system_device.flash |= FLASH_ACR_ICEN;
+    }
+
+    if (option & SYSTEM_FLASH_DCACHE)
+    {
+	stm32l4_system_device.flash |= FLASH_ACR_DCEN;
+    }
+
+    if (option & SYSTEM_FLASH_PREFETCH)
+    {
+	stm32l4_system_device.flash |= FLASH_ACR_PRFTEN;
+    }
+
+    /* A cache can only be reset while it's disabled, so start out with clean caches.
+     */
+    flash_acr = FLASH->ACR & ~(FLASH_ACR_ICEN | FLASH_ACR_DCEN | FLASH_ACR_PRFTEN);
+
+    FLASH->ACR = flash_acr;
+    FLASH->ACR = flash_acr | (FLASH_ACR_ICRST | FLASH_ACR_DCRST);
+    FLASH->ACR = flash_acr | stm32l4_system_device.flash;
+
+    __set_PRIMASK(primask);
+}
+
+void stm32l4_system_flash_invalidate(void)
+{
+    uint32_t primask, flash_acr;
+
+    primask = __get_PRIMASK();
+
+    __disable_irq();
+
+    flash_acr = FLASH->ACR;
+
+    FLASH->ACR = flash_acr & ~(FLASH_ACR_ICEN | FLASH_ACR_DCEN);
+    FLASH->ACR = (flash_acr & ~(FLASH_ACR_ICEN | FLASH_ACR_DCEN)) | (FLASH_ACR_ICRST | FLASH_ACR_DCRST);
+    FLASH->ACR = flash_acr;
+
+    __set_PRIMASK(primask);
+}
+
+/* The PLLSAI output is fref * N / P, with fref being the PLL input after the shared
+ * PLLM divider. That is 4MHz (HSE, or MSI without LSE), or 3997696Hz (MSI locked to
+ * LSE, 122 * 32768). All N (8..86) that keep the VCO within its limits are tried
+ * with the P closest to "clock". P is PLLSAI1PDIV (2..31) on STM32L432/L433/L452/L496,
+ * and 7 or 17 on STM32L476. The result is cached, as the search is redone on every
+ * clock change.
+ */
+
+static int32_t stm32l4_system_saiclk_ppm(uint32_t fvco, uint32_t p, uint32_t clock)
+{
+    return (int32_t)((((int64_t)fvco - ((int64_t)clock * p)) * 1000000) / ((int64_t)clock * p));
+}
+
+static uint32_t stm32l4_system_saiclk_search(uint32_t clock, int32_t *p_error)
+{
+    stm32l4_system_saiclk_entry_t *entry;
+    uint32_t fref, fvco_max, fvco, n, p, p_min, p_max, n_best, p_best;
+    uint64_t delta, delta_best;
+    unsigned int index;
+
+#if defined(STM32L432xx) || defined(STM32L433xx) || defined(STM32L452xx) || defined(STM32L496xx)
+    if (stm32l4_system_device.hclk <= 24000000)
+    {
+	/* Range 2 uses MSI, and limits the VCO to 128MHz. */
+	fref = stm32l4_system_device.lseclk ? 3997696 : 4000000;
+	fvco_max = 128000000;
+    }
+    else
+#endif
+    {
+	fref = (stm32l4_system_device.lseclk && !stm32l4_system_device.hseclk) ? 3997696 : 4000000;
+	fvco_max = 344000000;
+    }
+
+    for (index = 0; index < SYSTEM_SAICLK_CACHE_COUNT; index++)
+    {
+	entry = &stm32l4_system_device.saiclk_cache[index];
+
+	if ((entry->clock == clock) && (entry->fref == fref) && (entry->fvco == fvco_max))
+	{
+	    *p_error = entry->error;
+
+	    return entry->config;
+	}
+    }
+
+    n_best = 0;
+    p_best = 1;
+    delta_best = 0;
+
+    for (n = 8; n <= 86; n++)
+    {
+	fvco = fref * n;
+
+	if ((fvco < 64000000) || (fvco > fvco_max))
+	{
+	    continue;
+	}
+
+#if defined(STM32L432xx) || defined(STM32L433xx) || defined(STM32L452xx) || defined(STM32L496xx)
+	p_min = fvco / clock;
+	p_max = p_min +1;
+
+	if (p_min < 2)
+	{
+	    p_min = 2;
+	}
+
+	if (p_min > 31)
+	{
+	    p_min = 31;
+	}
+
+	if (p_max > 31)
+	{
+	    p_max = 31;
+	}
+#else
+	p_min = 7;
+	p_max = 17;
+#endif
+
+	for (p = p_min; p <= p_max; p++)
+	{
+#if defined(STM32L476xx)
+	    if ((p != 7) && (p != 17))
+	    {
+		continue;
+	    }
+#endif
+	    /* |fvco / p - clock| relative to clock, compared without a division */
+	    delta = (fvco > ((uint64_t)clock * p)) ? (fvco - ((uint64_t)clock * p)) : (((uint64_t)clock * p) - fvco);
+
+	    if (!n_best || ((delta * p_best) < (delta_best * p)))
+	    {
+		n_best = n;
+		p_best = p;
+		delta_best = delta;
+	    }
+	}
+    }
+
+    entry = &stm32l4_system_device.saiclk_cache[stm32l4_system_device.saiclk_next];
+
+    stm32l4_system_device.saiclk_next = (stm32l4_system_device.saiclk_next +1) % SYSTEM_SAICLK_CACHE_COUNT;
+
+    entry->clock = clock;
+    entry->fref = fref;
+    entry->fvco = fvco_max;
+    entry->error = stm32l4_system_saiclk_ppm(fref * n_best, p_best, clock);
+#if defined(STM32L432xx) || defined(STM32L433xx) || defined(STM32L452xx) || defined(STM32L496xx)
+    entry->config = (p_best << 27) | (n_best << 8);
+#else
+    entry->config = (n_best << 8) | ((p_best == 17) ? RCC_PLLSAI2CFGR_PLLSAI2P : 0);
+#endif
+
+    *p_error = entry->error;
+
+    return entry->config;
+}
+
+#if defined(STM32L476xx)
+
+/* PLLSAI1 (SYSTEM_SAICLK_11289600) is fixed at N = 48 by the 48MHz USB clock, and
+ * divided by 17. PLLSAI2 (SYSTEM_SAICLK_49152000) comes from the search.
+ */
+static int32_t stm32l4_system_saiclk_estimate(uint32_t clock)
+{
+    int32_t error;
+
+    if (clock == SYSTEM_SAICLK_11289600)
+    {
+	return stm32l4_system_saiclk_ppm(((stm32l4_system_device.lseclk && !stm32l4_system_device.hseclk) ? 3997696 : 4000000) * 48, 17, clock);
+    }
+
+    if (clock == SYSTEM_SAICLK_49152000)
+    {
+	stm32l4_system_saiclk_search(clock, &error);
+
+	return error;
+    }
+
+    return 0;
+}
+
+#endif /* defined(STM32L476xx) */
+
 bool stm32l4_system_sysclk_configure(uint32_t hclk, uint32_t pclk1, uint32_t pclk2)
 {
     uint32_t sysclk, fclk, oclk, fvco, fpll, mout, nout, rout, n, r;
     uint32_t msirange, hpre, ppre1, ppre2, latency;
     uint32_t primask, apb1enr1, mask, slot;
+#if defined(STM32L476xx)
+    int32_t error;
+#endif
     
     if (hclk <= 24000000)
     {
@@ -1225,7 +1473,7 @@ bool stm32l4_system_sysclk_configure(uint32_t hclk, uint32_t pclk1, uint32_t pcl
     {
     }
     
-    FLASH->ACR = FLASH_ACR_ICEN | FLASH_ACR_DCEN | FLASH_ACR_LATENCY_4WS;
+    FLASH->ACR = stm32l4_system_device.flash | FLASH_ACR_LATENCY_4WS;
 
 #if defined(STM32L432xx) || defined(STM32L433xx) || defined(STM32L452xx) || defined(STM32L496xx)
     if (stm32l4_system_device.hsi48)
@@ -1450,23 +1698,12 @@ bool stm32l4_system_sysclk_configure(uint32_t hclk, uint32_t pclk1, uint32_t pcl
 	RCC->CFGR |= RCC_CFGR_STOPWUCK;
     }
     
-    FLASH->ACR = FLASH_ACR_ICEN | FLASH_ACR_DCEN | latency;
+    FLASH->ACR = stm32l4_system_device.flash | latency;
     
 #if defined(STM32L432xx) || defined(STM32L433xx) || defined(STM32L452xx) || defined(STM32L496xx)
     if (stm32l4_system_device.saiclk)
     {
-	if (hclk <= 24000000)
-	{
-	    if      (stm32l4_system_device.saiclk == SYSTEM_SAICLK_8192000)  { RCC->PLLSAI1CFGR = ((15 << 27) | (31 << 8) | RCC_PLLSAI1CFGR_PLLSAI1PEN); }
-	    else if (stm32l4_system_device.saiclk == SYSTEM_SAICLK_11289600) { RCC->PLLSAI1CFGR = ((11 << 27) | (31 << 8) | RCC_PLLSAI1CFGR_PLLSAI1PEN); }
-	    else                                                             { RCC->PLLSAI1CFGR = (( 5 << 27) | (31 << 8) | RCC_PLLSAI1CFGR_PLLSAI1PEN); }
-	}
-	else
-	{
-	    if      (stm32l4_system_device.saiclk == SYSTEM_SAICLK_8192000)  { RCC->PLLSAI1CFGR = ((21 << 27) | (43 << 8) | RCC_PLLSAI1CFGR_PLLSAI1PEN); }
-	    else if (stm32l4_system_device.saiclk == SYSTEM_SAICLK_11289600) { RCC->PLLSAI1CFGR = ((17 << 27) | (48 << 8) | RCC_PLLSAI1CFGR_PLLSAI1PEN); }
-	    else                                                             { RCC->PLLSAI1CFGR = (( 7 << 27) | (43 << 8) | RCC_PLLSAI1CFGR_PLLSAI1PEN); }
-	}
+	RCC->PLLSAI1CFGR = stm32l4_system_saiclk_search(stm32l4_system_device.saiclk, &stm32l4_system_device.saiclk_error) | RCC_PLLSAI1CFGR_PLLSAI1PEN;
 	
 	RCC->CR |= RCC_CR_PLLSAI1ON;
 	
@@ -1514,7 +1751,9 @@ bool stm32l4_system_sysclk_configure(uint32_t hclk, uint32_t pclk1, uint32_t pcl
      */
     
     RCC->PLLSAI1CFGR = ((48 << 8) |(((4 >> 1) -1) << 21) | RCC_PLLSAI1CFGR_PLLSAI1P);
-    RCC->PLLSAI2CFGR = ((86 << 8));
+    RCC->PLLSAI2CFGR = stm32l4_system_saiclk_search(SYSTEM_SAICLK_49152000, &error);
+
+    stm32l4_system_device.saiclk_error = stm32l4_system_saiclk_estimate(stm32l4_system_device.saiclk);
     
     if (stm32l4_system_device.saiclk)
     {
@@ -1635,7 +1874,7 @@ static void stm32l4_system_select_range_1(void)
 	if   (stm32l4_system_device.hclk <= 16000000) { latency = FLASH_ACR_LATENCY_0WS; }
 	else                                          { latency = FLASH_ACR_LATENCY_1WS; }
 
-	FLASH->ACR = FLASH_ACR_ICEN | FLASH_ACR_DCEN | latency;
+	FLASH->ACR = stm32l4_system_device.flash | latency;
     }
 }
 
@@ -1651,7 +1890,7 @@ static void stm32l4_system_select_range_2(void)
 	else if (stm32l4_system_device.hclk <= 18000000) { latency = FLASH_ACR_LATENCY_2WS; }
 	else                                             { latency = FLASH_ACR_LATENCY_3WS; }
 	
-	FLASH->ACR = FLASH_ACR_ICEN | FLASH_ACR_DCEN | latency;
+	FLASH->ACR = stm32l4_system_device.flash | latency;
 	
 	/* Switch to Range 2 */
 	apb1enr1 = RCC->APB1ENR1;
@@ -1768,20 +2007,11 @@ void stm32l4_system_saiclk_configure(unsigned int clock)
     {
     }
 
+    stm32l4_system_device.saiclk_error = 0;
+
     if (clock)
     {
-	if (stm32l4_system_device.hclk <= 24000000)
-	{
-	    if      (clock == SYSTEM_SAICLK_8192000)  { RCC->PLLSAI1CFGR = ((15 << 27) | (31 << 8) | RCC_PLLSAI1CFGR_PLLSAI1PEN); }
-	    else if (clock == SYSTEM_SAICLK_11289600) { RCC->PLLSAI1CFGR = ((11 << 27) | (31 << 8) | RCC_PLLSAI1CFGR_PLLSAI1PEN); }
-	    else                                      { RCC->PLLSAI1CFGR = (( 5 << 27) | (31 << 8) | RCC_PLLSAI1CFGR_PLLSAI1PEN); clock = SYSTEM_SAICLK_24576000; }
-	}
-	else
-	{
-	    if      (clock == SYSTEM_SAICLK_8192000)  { RCC->PLLSAI1CFGR = ((21 << 27) | (43 << 8) | RCC_PLLSAI1CFGR_PLLSAI1PEN); }
-	    else if (clock == SYSTEM_SAICLK_11289600) { RCC->PLLSAI1CFGR = ((17 << 27) | (48 << 8) | RCC_PLLSAI1CFGR_PLLSAI1PEN); }
-	    else                                      { RCC->PLLSAI1CFGR = (( 7 << 27) | (43 << 8) | RCC_PLLSAI1CFGR_PLLSAI1PEN); clock = SYSTEM_SAICLK_24576000; }
-	}
+	RCC->PLLSAI1CFGR = stm32l4_system_saiclk_search(clock, &stm32l4_system_device.saiclk_error) | RCC_PLLSAI1CFGR_PLLSAI1PEN;
 
 	RCC->CR |= RCC_CR_PLLSAI1ON;
 		
@@ -1836,6 +2066,7 @@ void stm32l4_system_saiclk_configure(unsigned int clock)
     }
 	    
     stm32l4_system_device.saiclk = clock;
+    stm32l4_system_device.saiclk_error = stm32l4_system_saiclk_estimate(clock);
 
     if (stm32l4_system_device.saiclk != SYSTEM_SAICLK_11289600)
     {
@@ -2212,6 +2443,11 @@ uint32_t stm32l4_system_saiclk(void)
     return stm32l4_system_device.saiclk;
 }
 
+int32_t stm32l4_system_saiclk_error(void)
+{
+    return stm32l4_system_device.saiclk_error;
+}
+
 int stm32l4_system_notify(int slot, stm32l4_system_callback_t callback, void *context, uint32_t events)
 {
     unsigned int i, mask;
@@ -2467,9 +2703,60 @@ static void stm32l4_system_resume(void)
     }
 }
 
+/* Time since 2000-01-01 in 1/256 seconds, as kept by the RTC. Reading SSR first latches
+ * TR/DR. Coming out of STOP the shadow registers need to be resynchronized first.
+ */
+static uint64_t stm32l4_system_rtc_clock(bool sync)
+{
+    static const uint16_t days_before_month[12] = { 0, 31, 59, 90, 120, 151, 181, 212, 243, 273, 304, 334 };
+    uint32_t ssr, tr, dr, year, month, days, seconds;
+
+    if (sync)
+    {
+	RTC->WPR = 0xca;
+	RTC->WPR = 0x53;
+
+	RTC->ISR &= ~RTC_ISR_RSF;
+
+	RTC->WPR = 0x00;
+
+	while (!(RTC->ISR & RTC_ISR_RSF))
+	{
+	}
+    }
+
+    ssr = RTC->SSR;
+    tr = RTC->TR;
+    dr = RTC->DR;
+
+    seconds = ((((tr & RTC_TR_HT) >> RTC_TR_HT_Pos) * 10 + ((tr & RTC_TR_HU) >> RTC_TR_HU_Pos)) * 3600 +
+	       (((tr & RTC_TR_MNT) >> RTC_TR_MNT_Pos) * 10 + ((tr & RTC_TR_MNU) >> RTC_TR_MNU_Pos)) * 60 +
+	       (((tr & RTC_TR_ST) >> RTC_TR_ST_Pos) * 10 + ((tr & RTC_TR_SU) >> RTC_TR_SU_Pos)));
+
+    year  = ((dr & RTC_DR_YT) >> RTC_DR_YT_Pos) * 10 + ((dr & RTC_DR_YU) >> RTC_DR_YU_Pos);
+    month = ((dr & RTC_DR_MT) >> RTC_DR_MT_Pos) * 10 + ((dr & RTC_DR_MU) >> RTC_DR_MU_Pos);
+
+    if ((month < 1) || (month > 12))
+    {
+	month = 1;
+    }
+
+    /* Every 4th year is a leap year within 2000 ... 2099.
+     */
+    days = (year * 365) + ((year + 3) / 4) + days_before_month[month -1] + (((dr & RTC_DR_DT) >> RTC_DR_DT_Pos) * 10 + ((dr & RTC_DR_DU) >> RTC_DR_DU_Pos)) -1;
+
+    if (!(year & 3) && (month > 2))
+    {
+	days++;
+    }
+
+    return ((((uint64_t)days * 86400) + seconds) * 256) + (255 - (ssr & 255));
+}
+
 bool stm32l4_system_stop(uint32_t timeout)
 {
-    uint32_t primask, apb1enr1, slot, mask;
+    uint32_t primask, apb1enr1, slot, mask, wakeup, timeout_next, elapsed;
+    uint64_t clock;
 
     primask = __get_PRIMASK();
 
@@ -2494,11 +2781,24 @@ bool stm32l4_system_stop(uint32_t timeout)
 
     armv7m_systick_disable();
 
-    if (timeout)
+    /* Tickless STOP: no SysTick runs, so wake up for the earliest armv7m_timer deadline
+     * if that comes before "timeout", and fold the time spent in STOP back into millis()
+     * and the timers afterwards.
+     */
+    wakeup = timeout;
+
+    if (armv7m_timer_next(&timeout_next) && (!wakeup || (wakeup > timeout_next)))
     {
-	stm32l4_rtc_wakeup(timeout);
+	wakeup = timeout_next;
     }
 
+    if (wakeup)
+    {
+	stm32l4_rtc_wakeup(wakeup);
+    }
+
+    clock = stm32l4_system_rtc_clock(false);
+
     apb1enr1 = RCC->APB1ENR1;
 
     if (!(apb1enr1 & RCC_APB1ENR1_PWREN))
@@ -2525,6 +2825,22 @@ bool stm32l4_system_stop(uint32_t timeout)
 
     SCB->SCR &= ~SCB_SCR_SLEEPDEEP_Msk;
 
+    /* An expired wakeup timer gives the exact time spent, otherwise the RTC has to do
+     * (at 1/256 second resolution).
+     */
+    if (wakeup && (RTC->ISR & RTC_ISR_WUTF))
+    {
+	elapsed = wakeup;
+
+	stm32l4_system_device.stop = ((wakeup == timeout) ? SYSTEM_STOP_TIMEOUT : SYSTEM_STOP_TIMER);
+    }
+    else
+    {
+	elapsed = (uint32_t)(((stm32l4_system_rtc_clock(true) - clock) * 1000) / 256);
+
+	stm32l4_system_device.stop = SYSTEM_STOP_EVENT;
+    }
+
     stm32l4_system_resume();
 
     if (!(apb1enr1 & RCC_APB1ENR1_PWREN))
@@ -2532,11 +2848,13 @@ bool stm32l4_system_stop(uint32_t timeout)
 	RCC->APB1ENR1 &= ~RCC_APB1ENR1_PWREN;
     }
 
-    if (timeout)
+    if (wakeup)
     {
 	stm32l4_rtc_wakeup(0);
     }
 
+    armv7m_systick_advance(elapsed);
+
     armv7m_systick_enable();
 
     mask = stm32l4_system_device.event[SYSTEM_INDEX_RESUME];
@@ -2554,6 +2872,11 @@ bool stm32l4_system_stop(uint32_t timeout)
     return true;
 }
 
+uint32_t stm32l4_system_stop_reason(void)
+{
+    return stm32l4_system_device.stop;
+}
+
 static void stm32l4_system_deepsleep(uint32_t lpms, uint32_t config, uint32_t timeout)
 {
     if (timeout)
@@ -2565,7 +2888,7 @@ static void stm32l4_system_deepsleep(uint32_t lpms, uint32_t config, uint32_t ti
 
     /* ERRATA 2.1.15. WAR: Switch MSI to 4MHz before entering STANDBY/SHUTDOWN mode */
 
-    FLASH->ACR = FLASH_ACR_ICEN | FLASH_ACR_DCEN | FLASH_ACR_LATENCY_4WS;
+    FLASH->ACR = stm32l4_system_device.flash | FLASH_ACR_LATENCY_4WS;
 
     /* Select the proper voltage range */
 
@@ -38,6 +38,9 @@
 
 typedef struct _stm32l4_timer_driver_t {
     stm32l4_timer_t   *instances[TIMER_INSTANCE_COUNT];
+    uint32_t          clock[TIMER_INSTANCE_COUNT];
+    uint32_t          prescaler[TIMER_INSTANCE_COUNT];
+    bool              notify;
 } stm32l4_timer_driver_t;
 
 static stm32l4_timer_driver_t stm32l4_timer_driver;
@@ -102,6 +105,112 @@ static const IRQn_Type stm32l4_timer_xlate_IRQn[] = {
 
 stm32l4_ct_assert(STM32L4_NELEM(stm32l4_timer_xlate_IRQn) == TIMER_INSTANCE_COUNT);
 
+static const uint8_t stm32l4_timer_xlate_DMA[] = {
+    DMA_CHANNEL_DMA1_CH6_TIM1_UP,
+    DMA_CHANNEL_DMA1_CH2_TIM2_UP,
+#ifdef TIM3_BASE
+    DMA_CHANNEL_DMA1_CH3_TIM3_UP,
+#endif    
+#ifdef TIM4_BASE
+    DMA_CHANNEL_DMA1_CH7_TIM4_UP,
+#endif    
+#ifdef TIM5_BASE
+    DMA_CHANNEL_DMA2_CH2_TIM5_UP,
+#endif
+#ifdef TIM6_BASE
+    DMA_CHANNEL_DMA2_CH4_TIM6_UP,
+#endif    
+#ifdef TIM7_BASE
+    DMA_CHANNEL_DMA2_CH5_TIM7_UP,
+#endif    
+#ifdef TIM8_BASE
+    DMA_CHANNEL_DMA2_CH1_TIM8_UP,
+#endif
+    DMA_CHANNEL_DMA1_CH5_TIM15_UP,
+    DMA_CHANNEL_DMA1_CH6_TIM16_UP,
+#ifdef TIM17_BASE
+    DMA_CHANNEL_DMA1_CH7_TIM17_UP,
+#endif
+};
+
+stm32l4_ct_assert(STM32L4_NELEM(stm32l4_timer_xlate_DMA) == TIMER_INSTANCE_COUNT);
+
+static const uint8_t stm32l4_timer_xlate_DMA_CC[][4] = {
+    { DMA_CHANNEL_DMA1_CH2_TIM1_CH1, DMA_CHANNEL_DMA1_CH3_TIM1_CH2, DMA_CHANNEL_DMA1_CH7_TIM1_CH3, DMA_CHANNEL_DMA1_CH4_TIM1_CH4 },
+    { DMA_CHANNEL_DMA1_CH5_TIM2_CH1, DMA_CHANNEL_DMA1_CH7_TIM2_CH2, DMA_CHANNEL_DMA1_CH1_TIM2_CH3, DMA_CHANNEL_DMA1_CH7_TIM2_CH4 },
+#ifdef TIM3_BASE
+    { DMA_CHANNEL_DMA1_CH6_TIM3_CH1, DMA_CHANNEL_NONE,              DMA_CHANNEL_DMA1_CH2_TIM3_CH3, DMA_CHANNEL_DMA1_CH3_TIM3_CH4 },
+#endif    
+#ifdef TIM4_BASE
+    { DMA_CHANNEL_DMA1_CH1_TIM4_CH1, DMA_CHANNEL_DMA1_CH4_TIM4_CH2, DMA_CHANNEL_DMA1_CH5_TIM4_CH3, DMA_CHANNEL_NONE              },
+#endif    
+#ifdef TIM5_BASE
+    { DMA_CHANNEL_DMA2_CH5_TIM5_CH1, DMA_CHANNEL_DMA2_CH4_TIM5_CH2, DMA_CHANNEL_DMA2_CH2_TIM5_CH3, DMA_CHANNEL_DMA2_CH1_TIM5_CH4 },
+#endif
+#ifdef TIM6_BASE
+    { DMA_CHANNEL_NONE,              DMA_CHANNEL_NONE,              DMA_CHANNEL_NONE,              DMA_CHANNEL_NONE              },
+#endif    
+#ifdef TIM7_BASE
+    { DMA_CHANNEL_NONE,              DMA_CHANNEL_NONE,              DMA_CHANNEL_NONE,              DMA_CHANNEL_NONE              },
+#endif    
+#ifdef TIM8_BASE
+    { DMA_CHANNEL_DMA2_CH6_TIM8_CH1, DMA_CHANNEL_DMA2_CH7_TIM8_CH2, DMA_CHANNEL_DMA2_CH1_TIM8_CH3, DMA_CHANNEL_DMA2_CH2_TIM8_CH4 },
+#endif
+    { DMA_CHANNEL_DMA1_CH5_TIM15_CH1, DMA_CHANNEL_NONE,             DMA_CHANNEL_NONE,              DMA_CHANNEL_NONE              },
+    { DMA_CHANNEL_DMA1_CH3_TIM16_CH1, DMA_CHANNEL_NONE,             DMA_CHANNEL_NONE,              DMA_CHANNEL_NONE              },
+#ifdef TIM17_BASE
+    { DMA_CHANNEL_DMA1_CH1_TIM17_CH1, DMA_CHANNEL_NONE,             DMA_CHANNEL_NONE,              DMA_CHANNEL_NONE              },
+#endif
+};
+
+stm32l4_ct_assert(STM32L4_NELEM(stm32l4_timer_xlate_DMA_CC) == TIMER_INSTANCE_COUNT);
+
+#define TIMER_DMA_OPTION_STREAM		  \
+    (DMA_OPTION_EVENT_TRANSFER_DONE |	  \
+     DMA_OPTION_MEMORY_TO_PERIPHERAL |	  \
+     DMA_OPTION_PERIPHERAL_DATA_SIZE_32 | \
+     DMA_OPTION_MEMORY_DATA_SIZE_16 |	  \
+     DMA_OPTION_MEMORY_DATA_INCREMENT |	  \
+     DMA_OPTION_PRIORITY_VERY_HIGH)
+
+#define TIMER_DMA_OPTION_CAPTURE	  \
+    (DMA_OPTION_EVENT_TRANSFER_DONE |	  \
+     DMA_OPTION_PERIPHERAL_TO_MEMORY |	  \
+     DMA_OPTION_PERIPHERAL_DATA_SIZE_32 | \
+     DMA_OPTION_MEMORY_DATA_SIZE_16 |	  \
+     DMA_OPTION_MEMORY_DATA_INCREMENT |	  \
+     DMA_OPTION_PRIORITY_VERY_HIGH)
+
+#define TIMER_DMA_OPTION_PATTERN	  \
+    (DMA_OPTION_EVENT_TRANSFER_DONE |	  \
+     DMA_OPTION_MEMORY_TO_PERIPHERAL |	  \
+     DMA_OPTION_PERIPHERAL_DATA_SIZE_32 | \
+     DMA_OPTION_MEMORY_DATA_SIZE_32 |	  \
+     DMA_OPTION_MEMORY_DATA_INCREMENT |	  \
+     DMA_OPTION_PRIORITY_VERY_HIGH)
+
+#define TIMER_DIER_DMA_MASK (TIM_DIER_UDE | TIM_DIER_CC1DE | TIM_DIER_CC2DE | TIM_DIER_CC3DE | TIM_DIER_CC4DE)
+
+static void stm32l4_timer_dma_callback(stm32l4_timer_t *timer, uint32_t events)
+{
+    TIM_TypeDef *TIM = timer->TIM;
+    stm32l4_timer_callback_t callback;
+
+    armv7m_atomic_and(&TIM->DIER, ~TIMER_DIER_DMA_MASK);
+
+    stm32l4_dma_disable(&timer->dma);
+    stm32l4_dma_destroy(&timer->dma);
+
+    callback = timer->stream_callback;
+
+    timer->stream_callback = NULL;
+
+    if (callback)
+    {
+	(*callback)(timer->stream_context, TIMER_EVENT_STREAM_DONE);
+    }
+}
+
 static void stm32l4_timer_interrupt(stm32l4_timer_t *timer)
 {
     TIM_TypeDef *TIM = timer->TIM;
@@ -155,7 +264,54 @@ static void stm32l4_timer_interrupt(stm32l4_timer_t *timer)
 
 	if (events)
 	{
+#if (ARMV7M_CORE_FPU_STATISTICS == 1)
+	    uint32_t fpu_state = armv7m_core_fpu_enter();
+#endif /* ARMV7M_CORE_FPU_STATISTICS == 1 */
+
 	    (*timer->callback)(timer->context, events);
+
+#if (ARMV7M_CORE_FPU_STATISTICS == 1)
+	    armv7m_core_fpu_leave(fpu_state);
+#endif /* ARMV7M_CORE_FPU_STATISTICS == 1 */
+	}
+    }
+}
+
+/* The prescaler of a running timer is rescaled on a clock change, so that the tick
+ * rate computed by the caller at stm32l4_timer_configure() time is kept. The rate
+ * is exact if the new clock divides evenly, otherwise it is rounded to the nearest
+ * prescaler. The new prescaler takes effect on the next update event.
+ */
+static void stm32l4_timer_notify_callback(void *context, uint32_t events)
+{
+    stm32l4_timer_t *timer;
+    unsigned int instance;
+    uint32_t clock, prescaler;
+
+    for (instance = 0; instance < TIMER_INSTANCE_COUNT; instance++)
+    {
+	timer = stm32l4_timer_driver.instances[instance];
+
+	if (timer && (timer->state >= TIMER_STATE_READY))
+	{
+	    clock = stm32l4_timer_clock(timer);
+
+	    if (stm32l4_timer_driver.clock[instance] && (stm32l4_timer_driver.clock[instance] != clock))
+	    {
+		prescaler = (((uint64_t)clock * (stm32l4_timer_driver.prescaler[instance] +1)) + (stm32l4_timer_driver.clock[instance] / 2)) / stm32l4_timer_driver.clock[instance];
+
+		if (prescaler == 0)
+		{
+		    prescaler = 1;
+		}
+
+		if (prescaler > 65536)
+		{
+		    prescaler = 65536;
+		}
+
+		timer->TIM->PSC = prescaler -1;
+	    }
 	}
     }
 }
@@ -167,10 +323,26 @@ bool stm32l4_timer_create(stm32l4_timer_t *timer, unsigned int instance, unsigne
 	return false;
     }
 
+    /* An instance belongs to one stm32l4_timer_t at a time, till stm32l4_timer_destroy().
+     */
+    if (stm32l4_timer_driver.instances[instance] && (stm32l4_timer_driver.instances[instance] != timer))
+    {
+	return false;
+    }
+
+    if (!stm32l4_timer_driver.notify)
+    {
+	if (stm32l4_system_notify(-1, stm32l4_timer_notify_callback, NULL, SYSTEM_EVENT_CHANGE_CLOCKS) >= 0)
+	{
+	    stm32l4_timer_driver.notify = true;
+	}
+    }
+
     timer->TIM = stm32l4_timer_xlate_TIM[instance];
     timer->state = TIMER_STATE_INIT;
     timer->instance = instance;
     timer->priority = priority;
+    timer->trigger = TIMER_TRIGGER_NONE;
     timer->callback = NULL;
     timer->context = NULL;
     timer->events = 0;
@@ -179,6 +351,9 @@ bool stm32l4_timer_create(stm32l4_timer_t *timer, unsigned int instance, unsigne
     timer->capture[1] = 0;
     timer->capture[2] = 0;
     timer->capture[3] = 0;
+    timer->stream_callback = NULL;
+    timer->stream_context = NULL;
+    timer->dma.DMA = NULL;
     
     stm32l4_timer_driver.instances[timer->instance] = timer;
 
@@ -364,7 +539,7 @@ bool stm32l4_timer_disable(stm32l4_timer_t *timer)
 bool stm32l4_timer_configure(stm32l4_timer_t *timer, uint32_t prescaler, uint32_t period, uint32_t option)
 {
     TIM_TypeDef *TIM = timer->TIM;
-    uint32_t tim_cr1, tim_smcr, tim_bdtr;
+    uint32_t tim_cr1, tim_cr2, tim_smcr, tim_bdtr;
 
     if ((timer->state != TIMER_STATE_BUSY) && (timer->state != TIMER_STATE_READY))
     {
@@ -423,9 +598,19 @@ bool stm32l4_timer_configure(stm32l4_timer_t *timer, uint32_t prescaler, uint32_
     }
 
     tim_cr1 = 0;
+    tim_cr2 = 0;
     tim_smcr = 0;
     tim_bdtr = TIM_BDTR_MOE;
 
+    if (option & TIMER_OPTION_TRIGGER_UPDATE)
+    {
+	tim_cr2 |= TIM_CR2_MMS_1; /* TRGO on update event, e.g. to pace ADC conversions */
+    }
+    else
+    {
+	tim_cr2 |= (timer->trigger << TIM_CR2_MMS_Pos);
+    }
+
     if (option & TIMER_OPTION_ENCODER_MODE_MASK)
     {
 	tim_smcr |= (((option & TIMER_OPTION_ENCODER_MODE_MASK) >> TIMER_OPTION_ENCODER_MODE_SHIFT) << 0);
@@ -465,12 +650,21 @@ bool stm32l4_timer_configure(stm32l4_timer_t *timer, uint32_t prescaler, uint32_
 	}
     }
 
+    if (option & TIMER_OPTION_ONE_PULSE)
+    {
+	tim_cr1 |= TIM_CR1_OPM;
+    }
+
     TIM->CR1  = tim_cr1;
+    TIM->CR2  = tim_cr2;
     TIM->SMCR = tim_smcr;
     TIM->BDTR = tim_bdtr;
     TIM->ARR  = period;
     TIM->PSC  = prescaler;
 
+    stm32l4_timer_driver.clock[timer->instance] = stm32l4_timer_clock(timer);
+    stm32l4_timer_driver.prescaler[timer->instance] = prescaler;
+
     if (timer->instance == TIMER_INSTANCE_TIM1)
     {
 	TIM->RCR = 0;
@@ -572,6 +766,13 @@ bool stm32l4_timer_stop(stm32l4_timer_t *timer)
 
     armv7m_atomic_and(&TIM->CR1, ~TIM_CR1_CEN);
 
+    if (TIM->DIER & TIMER_DIER_DMA_MASK)
+    {
+	stm32l4_dma_stop(&timer->dma);
+
+	stm32l4_timer_dma_callback(timer, 0);
+    }
+
     timer->state = TIMER_STATE_READY;
 
     return true;
@@ -617,6 +818,50 @@ bool stm32l4_timer_period(stm32l4_timer_t *timer, uint32_t period, bool offset)
     return true;
 }
 
+bool stm32l4_timer_trigger(stm32l4_timer_t *timer, uint32_t trigger)
+{
+    TIM_TypeDef *TIM = timer->TIM;
+
+    if ((timer->state != TIMER_STATE_READY) && (timer->state != TIMER_STATE_ACTIVE))
+    {
+	return false;
+    }
+
+    timer->trigger = trigger;
+
+    armv7m_atomic_modify(&TIM->CR2, TIM_CR2_MMS, (trigger << TIM_CR2_MMS_Pos));
+
+    return true;
+}
+
+bool stm32l4_timer_slave(stm32l4_timer_t *timer, uint32_t slave)
+{
+    TIM_TypeDef *TIM = timer->TIM;
+    uint32_t tim_smcr;
+
+    if ((timer->state != TIMER_STATE_READY) && (timer->state != TIMER_STATE_ACTIVE))
+    {
+	return false;
+    }
+
+    tim_smcr = (((slave & TIMER_SLAVE_INPUT_MASK) >> TIMER_SLAVE_INPUT_SHIFT) << TIM_SMCR_TS_Pos);
+
+    if (slave & 0x00000008)
+    {
+	tim_smcr |= TIM_SMCR_SMS_3;
+    }
+
+    tim_smcr |= (slave & 0x00000007);
+
+    /* SMS gets written last, so that the trigger input is stable when the slave mode kicks in.
+     */
+    armv7m_atomic_modify(&TIM->SMCR, (TIM_SMCR_SMS | TIM_SMCR_TS), 0);
+    armv7m_atomic_modify(&TIM->SMCR, TIM_SMCR_TS, (tim_smcr & TIM_SMCR_TS));
+    armv7m_atomic_modify(&TIM->SMCR, TIM_SMCR_SMS, (tim_smcr & TIM_SMCR_SMS));
+
+    return true;
+}
+
 bool stm32l4_timer_channel(stm32l4_timer_t *timer, unsigned int channel, uint32_t compare, uint32_t control)
 {
     TIM_TypeDef *TIM = timer->TIM;
@@ -668,6 +913,8 @@ bool stm32l4_timer_channel(stm32l4_timer_t *timer, unsigned int channel, uint32_
 	    case TIMER_CONTROL_COMPARE_FORCED_INACTIVE: tim_ccmr |= (                  (4 << 4)); break;
 	    case TIMER_CONTROL_PWM:                     tim_ccmr |= (TIM_CCMR1_OC1PE | (6 << 4)); break;
 	    case TIMER_CONTROL_PWM_INVERTED:            tim_ccmr |= (TIM_CCMR1_OC1PE | (7 << 4)); break;
+	    case TIMER_CONTROL_RETRIGGERABLE:           tim_ccmr |= (TIM_CCMR1_OC1PE | TIM_CCMR1_OC1M_3 | (0 << 4)); break;
+	    case TIMER_CONTROL_RETRIGGERABLE_INVERTED:  tim_ccmr |= (TIM_CCMR1_OC1PE | TIM_CCMR1_OC1M_3 | (1 << 4)); break;
 	    }
 
 	    tim_ccer |= (TIM_CCER_CC1E |
@@ -749,6 +996,277 @@ bool stm32l4_timer_compare(stm32l4_timer_t *timer, unsigned int channel, uint32_
     return true;
 }
 
+/* Update the compare values of all channels in "mask" (bit n for TIMER_CHANNEL_n+1) from
+ * "compare[channel]". Update events are held off while the CCRx registers are written, so
+ * that with preloaded (PWM) channels all new values take effect at the same period boundary.
+ */
+bool stm32l4_timer_compare_multiple(stm32l4_timer_t *timer, uint32_t mask, const uint32_t *compare)
+{
+    TIM_TypeDef *TIM = timer->TIM;
+
+    if ((timer->state != TIMER_STATE_READY) && (timer->state != TIMER_STATE_ACTIVE))
+    {
+	return false;
+    }
+
+    armv7m_atomic_or(&TIM->CR1, TIM_CR1_UDIS);
+
+    if (mask & (1u << TIMER_CHANNEL_1)) { TIM->CCR1 = compare[TIMER_CHANNEL_1]; }
+    if (mask & (1u << TIMER_CHANNEL_2)) { TIM->CCR2 = compare[TIMER_CHANNEL_2]; }
+    if (mask & (1u << TIMER_CHANNEL_3)) { TIM->CCR3 = compare[TIMER_CHANNEL_3]; }
+    if (mask & (1u << TIMER_CHANNEL_4)) { TIM->CCR4 = compare[TIMER_CHANNEL_4]; }
+    if (mask & (1u << TIMER_CHANNEL_5)) { TIM->CCR5 = compare[TIMER_CHANNEL_5]; }
+    if (mask & (1u << TIMER_CHANNEL_6)) { TIM->CCR6 = compare[TIMER_CHANNEL_6]; }
+
+    armv7m_atomic_and(&TIM->CR1, ~TIM_CR1_UDIS);
+
+    return true;
+}
+
+/* Stream "data" into the CCRx register of "channel", one value per update event (i.e. per
+ * period), without CPU involvement. The channel has to be set up (preloaded PWM), and the
+ * timer running. Finishing "data" with a 0 slot leaves the output idle low.
+ */
+bool stm32l4_timer_stream(stm32l4_timer_t *timer, unsigned int channel, const uint16_t *data, uint16_t count, stm32l4_timer_callback_t callback, void *context)
+{
+    TIM_TypeDef *TIM = timer->TIM;
+    volatile uint32_t *ccr;
+
+    if ((timer->state != TIMER_STATE_ACTIVE) || (count == 0) || !stm32l4_timer_stream_done(timer))
+    {
+	return false;
+    }
+
+    switch (channel) {
+    case TIMER_CHANNEL_1: ccr = &TIM->CCR1; break;
+    case TIMER_CHANNEL_2: ccr = &TIM->CCR2; break;
+    case TIMER_CHANNEL_3: ccr = &TIM->CCR3; break;
+    case TIMER_CHANNEL_4: ccr = &TIM->CCR4; break;
+    default:
+	return false;
+    }
+
+    /* The UP DMA channels are shared with other peripherals, so they are only claimed
+     * for the duration of a stream.
+     */
+    if (!stm32l4_dma_create(&timer->dma, stm32l4_timer_xlate_DMA[timer->instance], timer->priority))
+    {
+	return false;
+    }
+
+    timer->stream_callback = callback;
+    timer->stream_context = context;
+
+    stm32l4_dma_enable(&timer->dma, (stm32l4_dma_callback_t)stm32l4_timer_dma_callback, timer);
+    stm32l4_dma_start(&timer->dma, (uint32_t)ccr, (uint32_t)data, count, TIMER_DMA_OPTION_STREAM);
+
+    armv7m_atomic_or(&TIM->DIER, TIM_DIER_UDE);
+
+    return true;
+}
+
+/* Like stm32l4_timer_stream(), but "data" is repeated over and over till stm32l4_timer_stream_stop().
+ * "data" may be rewritten while it is streamed, a new value is picked up the next time it comes around.
+ */
+bool stm32l4_timer_stream_cyclic(stm32l4_timer_t *timer, unsigned int channel, const uint16_t *data, uint16_t count)
+{
+    TIM_TypeDef *TIM = timer->TIM;
+    volatile uint32_t *ccr;
+
+    if ((timer->state != TIMER_STATE_ACTIVE) || (count == 0) || !stm32l4_timer_stream_done(timer))
+    {
+	return false;
+    }
+
+    switch (channel) {
+    case TIMER_CHANNEL_1: ccr = &TIM->CCR1; break;
+    case TIMER_CHANNEL_2: ccr = &TIM->CCR2; break;
+    case TIMER_CHANNEL_3: ccr = &TIM->CCR3; break;
+    case TIMER_CHANNEL_4: ccr = &TIM->CCR4; break;
+    default:
+	return false;
+    }
+
+    if (!stm32l4_dma_create(&timer->dma, stm32l4_timer_xlate_DMA[timer->instance], timer->priority))
+    {
+	return false;
+    }
+
+    timer->stream_callback = NULL;
+    timer->stream_context = NULL;
+
+    stm32l4_dma_enable(&timer->dma, (stm32l4_dma_callback_t)stm32l4_timer_dma_callback, timer);
+    stm32l4_dma_start(&timer->dma, (uint32_t)ccr, (uint32_t)data, count, ((TIMER_DMA_OPTION_STREAM & ~DMA_OPTION_EVENT_TRANSFER_DONE) | DMA_OPTION_CIRCULAR));
+
+    armv7m_atomic_or(&TIM->DIER, TIM_DIER_UDE);
+
+    return true;
+}
+
+static bool stm32l4_timer_update_dma_start(stm32l4_timer_t *timer, uint32_t dst, uint32_t src, uint16_t count, uint32_t option, stm32l4_timer_callback_t callback, void *context)
+{
+    TIM_TypeDef *TIM = timer->TIM;
+
+    if ((timer->state != TIMER_STATE_ACTIVE) || (count == 0) || !stm32l4_timer_stream_done(timer))
+    {
+	return false;
+    }
+
+    if (!stm32l4_dma_create(&timer->dma, stm32l4_timer_xlate_DMA[timer->instance], timer->priority))
+    {
+	return false;
+    }
+
+    timer->stream_callback = callback;
+    timer->stream_context = context;
+
+    stm32l4_dma_enable(&timer->dma, (stm32l4_dma_callback_t)stm32l4_timer_dma_callback, timer);
+    stm32l4_dma_start(&timer->dma, dst, src, count, option);
+
+    armv7m_atomic_or(&TIM->DIER, TIM_DIER_UDE);
+
+    return true;
+}
+
+/* Write "data" into the 32 bit register at "address", one word per update event, without CPU
+ * involvement. With a GPIO port's BSRR as "address" this sets and clears any pins of the port
+ * at once, at up to a few MHz. "callback" gets TIMER_EVENT_STREAM_DONE after the last word.
+ */
+bool stm32l4_timer_pattern(stm32l4_timer_t *timer, volatile uint32_t *address, const uint32_t *data, uint16_t count, stm32l4_timer_callback_t callback, void *context)
+{
+    return stm32l4_timer_update_dma_start(timer, (uint32_t)address, (uint32_t)data, count, TIMER_DMA_OPTION_PATTERN, callback, context);
+}
+
+/* Like stm32l4_timer_pattern(), but "data" is repeated over and over till stm32l4_timer_stream_stop().
+ */
+bool stm32l4_timer_pattern_cyclic(stm32l4_timer_t *timer, volatile uint32_t *address, const uint32_t *data, uint16_t count)
+{
+    return stm32l4_timer_update_dma_start(timer, (uint32_t)address, (uint32_t)data, count, ((TIMER_DMA_OPTION_PATTERN & ~DMA_OPTION_EVENT_TRANSFER_DONE) | DMA_OPTION_CIRCULAR), NULL, NULL);
+}
+
+/* Aborts a stream, leaving the timer running. CCRx keeps the last value written.
+ */
+bool stm32l4_timer_stream_stop(stm32l4_timer_t *timer)
+{
+    if (timer->state != TIMER_STATE_ACTIVE)
+    {
+	return false;
+    }
+
+    if (timer->TIM->DIER & TIMER_DIER_DMA_MASK)
+    {
+	stm32l4_dma_stop(&timer->dma);
+
+	stm32l4_timer_dma_callback(timer, 0);
+    }
+
+    return true;
+}
+
+bool stm32l4_timer_stream_done(stm32l4_timer_t *timer)
+{
+    return !(timer->TIM->DIER & TIMER_DIER_DMA_MASK);
+}
+
+/* Number of transfers left in the current pass of a stream, 0 if there is none.
+ */
+uint16_t stm32l4_timer_stream_count(stm32l4_timer_t *timer)
+{
+    if (stm32l4_timer_stream_done(timer))
+    {
+	return 0;
+    }
+
+    return stm32l4_dma_count(&timer->dma);
+}
+
+/* Record the next "count" captures of "channel" (which has to be set up as input capture)
+ * into "data" via DMA, without CPU involvement. Only the lower 16 bits of each capture
+ * are stored. "callback" gets TIMER_EVENT_STREAM_DONE once "data" is full. Completion can
+ * also be polled via stm32l4_timer_stream_done(), and stm32l4_timer_stop() aborts.
+ */
+bool stm32l4_timer_capture_stream(stm32l4_timer_t *timer, unsigned int channel, uint16_t *data, uint16_t count, stm32l4_timer_callback_t callback, void *context)
+{
+    TIM_TypeDef *TIM = timer->TIM;
+    volatile uint32_t *ccr;
+
+    if ((timer->state != TIMER_STATE_ACTIVE) || (count == 0) || (channel > TIMER_CHANNEL_4) || !stm32l4_timer_stream_done(timer))
+    {
+	return false;
+    }
+
+    if (stm32l4_timer_xlate_DMA_CC[timer->instance][channel] == DMA_CHANNEL_NONE)
+    {
+	return false;
+    }
+
+    switch (channel) {
+    case TIMER_CHANNEL_1: ccr = &TIM->CCR1; break;
+    case TIMER_CHANNEL_2: ccr = &TIM->CCR2; break;
+    case TIMER_CHANNEL_3: ccr = &TIM->CCR3; break;
+    default:              ccr = &TIM->CCR4; break;
+    }
+
+    if (!stm32l4_dma_create(&timer->dma, stm32l4_timer_xlate_DMA_CC[timer->instance][channel], timer->priority))
+    {
+	return false;
+    }
+
+    timer->stream_callback = callback;
+    timer->stream_context = context;
+
+    stm32l4_dma_enable(&timer->dma, (stm32l4_dma_callback_t)stm32l4_timer_dma_callback, timer);
+    stm32l4_dma_start(&timer->dma, (uint32_t)data, (uint32_t)ccr, count, TIMER_DMA_OPTION_CAPTURE);
+
+    armv7m_atomic_or(&TIM->DIER, (TIM_DIER_CC1DE << channel));
+
+    return true;
+}
+
+/* Read the 32 bit register at "address" once per update event, and store the lower 16 bits
+ * into "data" via DMA. With a GPIO port's IDR as "address" this samples all pins of the port
+ * at once, at up to a few MHz. "callback" gets TIMER_EVENT_STREAM_DONE once "data" is full.
+ */
+bool stm32l4_timer_sample(stm32l4_timer_t *timer, const volatile uint32_t *address, uint16_t *data, uint16_t count, stm32l4_timer_callback_t callback, void *context)
+{
+    return stm32l4_timer_update_dma_start(timer, (uint32_t)data, (uint32_t)address, count, TIMER_DMA_OPTION_CAPTURE, callback, context);
+}
+
+/* Like stm32l4_timer_sample(), but "data" is used as a ring that is overwritten over and over
+ * till stm32l4_timer_stream_stop(). The write position is count - stm32l4_timer_stream_count().
+ */
+bool stm32l4_timer_sample_cyclic(stm32l4_timer_t *timer, const volatile uint32_t *address, uint16_t *data, uint16_t count)
+{
+    return stm32l4_timer_update_dma_start(timer, (uint32_t)data, (uint32_t)address, count, ((TIMER_DMA_OPTION_CAPTURE & ~DMA_OPTION_EVENT_TRANSFER_DONE) | DMA_OPTION_CIRCULAR), NULL, NULL);
+}
+
+/* Expand "count" bytes, MSB first, into one compare value per bit, "zero" or "one". This
+ * is the slot format of WS2811/WS2812 style single wire LEDs. Returns the number of slots.
+ */
+unsigned int stm32l4_timer_stream_encode(uint16_t *slots, const uint8_t *data, unsigned int count, uint16_t zero, uint16_t one)
+{
+    const uint8_t *data_e = data + count;
+    uint32_t byte;
+
+    while (data != data_e)
+    {
+	byte = *data++;
+
+	slots[0] = (byte & 0x80) ? one : zero;
+	slots[1] = (byte & 0x40) ? one : zero;
+	slots[2] = (byte & 0x20) ? one : zero;
+	slots[3] = (byte & 0x10) ? one : zero;
+	slots[4] = (byte & 0x08) ? one : zero;
+	slots[5] = (byte & 0x04) ? one : zero;
+	slots[6] = (byte & 0x02) ? one : zero;
+	slots[7] = (byte & 0x01) ? one : zero;
+
+	slots += 8;
+    }
+
+    return count * 8;
+}
+
 uint32_t stm32l4_timer_capture(stm32l4_timer_t *timer, unsigned int channel)
 {
     if (channel <= TIMER_CHANNEL_4)
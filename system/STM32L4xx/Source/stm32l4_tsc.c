@@ -0,0 +1,601 @@
+/*
+ * Copyright (c) 2017 Thomas Roell.  All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal with the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ *  1. Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimers.
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimers in the
+ *     documentation and/or other materials provided with the distribution.
+ *  3. Neither the name of Thomas Roell, nor the names of its contributors
+ *     may be used to endorse or promote products derived from this Software
+ *     without specific prior written permission.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ * CONTRIBUTORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * WITH THE SOFTWARE.
+ */
+
+#include <stdlib.h>
+
+#include "armv7m.h"
+
+#include "stm32l4xx.h"
+
+#include "stm32l4_gpio.h"
+#include "stm32l4_tsc.h"
+#include "stm32l4_system.h"
+
+typedef struct _stm32l4_tsc_driver_t {
+    stm32l4_tsc_t      *instance;
+} stm32l4_tsc_driver_t;
+
+static stm32l4_tsc_driver_t stm32l4_tsc_driver;
+
+#define TSC_CALIBRATE_COUNT      8
+#define TSC_PULSE_CLOCK          4000000
+#define TSC_PIN_AF               0x0900
+
+/* GPIO_PIN_Pxy of group G, IO n at index (G * 4 + n). This is the same for all
+ * L4 parts; pins a package does not have are just not usable.
+ */
+static const uint8_t stm32l4_tsc_xlate_pin[TSC_GROUP_COUNT * 4] = {
+    0x1c, 0x1d, 0x1e, 0x1f,  /* G1: PB12, PB13, PB14, PB15 */
+    0x14, 0x15, 0x16, 0x17,  /* G2: PB4, PB5, PB6, PB7 */
+    0x0f, 0x2a, 0x2b, 0x2c,  /* G3: PA15, PC10, PC11, PC12 */
+    0x26, 0x27, 0x28, 0x29,  /* G4: PC6, PC7, PC8, PC9 */
+    0x4a, 0x4b, 0x4c, 0x4d,  /* G5: PE10, PE11, PE12, PE13 */
+    0x3a, 0x3b, 0x3c, 0x3d,  /* G6: PD10, PD11, PD12, PD13 */
+    0x42, 0x43, 0x44, 0x45,  /* G7: PE2, PE3, PE4, PE5 */
+    0x5e, 0x5f, 0x60, 0x61,  /* G8: PF14, PF15, PG0, PG1 */
+};
+
+static int stm32l4_tsc_lookup(uint16_t pin)
+{
+    unsigned int index;
+
+    for (index = 0; index < (TSC_GROUP_COUNT * 4); index++)
+    {
+	if (stm32l4_tsc_xlate_pin[index] == (pin & 0xff))
+	{
+	    return index;
+	}
+    }
+
+    return -1;
+}
+
+static void stm32l4_tsc_acquire(stm32l4_tsc_t *tsc)
+{
+    uint32_t hclk, pgpsc, mcv;
+
+    if (tsc->phase == 0)
+    {
+	/* The pulse generator runs off HCLK, so its prescaler follows the current
+	 * clock setup, aiming for at most TSC_PULSE_CLOCK.
+	 */
+	hclk = stm32l4_system_hclk();
+
+	for (pgpsc = 0; (pgpsc < 7) && ((hclk >> pgpsc) > TSC_PULSE_CLOCK); pgpsc++)
+	{
+	}
+
+	mcv = 6 - ((tsc->option & TSC_OPTION_MAX_COUNT_MASK) >> TSC_OPTION_MAX_COUNT_SHIFT);
+
+	TSC->CR = ((1 << TSC_CR_CTPH_Pos) |
+		   (1 << TSC_CR_CTPL_Pos) |
+		   (pgpsc << TSC_CR_PGPSC_Pos) |
+		   (mcv << TSC_CR_MCV_Pos) |
+		   ((tsc->option & TSC_OPTION_SPREAD_SPECTRUM) ? (TSC_CR_SSE | (15 << TSC_CR_SSD_Pos)) : 0) |
+		   TSC_CR_TSCE);
+    }
+
+    tsc->busy = true;
+
+    TSC->IOCCR = tsc->ioccr[tsc->phase];
+    TSC->IOGCSR = tsc->iogcsr[tsc->phase];
+    TSC->ICR = (TSC_ICR_EOAIC | TSC_ICR_MCEIC);
+    TSC->CR |= TSC_CR_START;
+}
+
+/* Acquisitions are started from the timer, so that the sampling capacitors
+ * (held low by IODEF in between) get at least a millisecond to discharge.
+ */
+static void stm32l4_tsc_timer_callback(armv7m_timer_t *timer)
+{
+    stm32l4_tsc_t *tsc = stm32l4_tsc_driver.instance;
+
+    if (!tsc || (tsc->state < TSC_STATE_CALIBRATE))
+    {
+	return;
+    }
+
+    if (tsc->busy)
+    {
+	armv7m_timer_start(&tsc->timer, 1);
+    }
+    else
+    {
+	stm32l4_tsc_acquire(tsc);
+    }
+}
+
+static uint32_t stm32l4_tsc_process(stm32l4_tsc_t *tsc)
+{
+    stm32l4_tsc_channel_t *channel;
+    unsigned int index;
+    uint32_t events, mask, value, base, threshold;
+    int32_t delta;
+
+    events = 0;
+
+    if (tsc->state == TSC_STATE_CALIBRATE)
+    {
+	/* The first cycle is thrown away; the following TSC_CALIBRATE_COUNT ones are
+	 * averaged into the Q4 baseline.
+	 */
+	if (tsc->calibrate != 0)
+	{
+	    for (index = 0; index < tsc->channel_count; index++)
+	    {
+		tsc->channels[index].baseline += ((uint32_t)tsc->channels[index].value << 4) / TSC_CALIBRATE_COUNT;
+	    }
+	}
+
+	if (tsc->calibrate == TSC_CALIBRATE_COUNT)
+	{
+	    tsc->state = TSC_STATE_ACTIVE;
+	}
+	else
+	{
+	    tsc->calibrate++;
+	}
+
+	return events;
+    }
+
+    for (index = 0, mask = 1; index < tsc->channel_count; index++, mask <<= 1)
+    {
+	channel = &tsc->channels[index];
+
+	value = channel->value;
+	base = channel->baseline >> 4;
+	threshold = channel->threshold ? channel->threshold : (base >> 4);
+	delta = (int32_t)base - (int32_t)value;
+
+	if (tsc->touched & mask)
+	{
+	    if (delta < (int32_t)(threshold / 2))
+	    {
+		tsc->touched &= ~mask;
+		tsc->changed |= mask;
+
+		events |= TSC_EVENT_RELEASE;
+	    }
+	}
+	else
+	{
+	    if (delta > (int32_t)threshold)
+	    {
+		tsc->touched |= mask;
+		tsc->changed |= mask;
+
+		events |= TSC_EVENT_TOUCH;
+	    }
+	}
+
+	if (!(tsc->touched & mask))
+	{
+	    if ((value << 4) > channel->baseline)
+	    {
+		channel->baseline += (((value << 4) - channel->baseline) >> 4);
+	    }
+	    else
+	    {
+		channel->baseline -= ((channel->baseline - (value << 4)) >> 8);
+	    }
+	}
+    }
+
+    return events;
+}
+
+bool stm32l4_tsc_create(stm32l4_tsc_t *tsc, unsigned int priority)
+{
+    if (stm32l4_tsc_driver.instance)
+    {
+	return false;
+    }
+
+    tsc->state = TSC_STATE_INIT;
+    tsc->priority = priority;
+    tsc->channel_count = 0;
+    tsc->phase_count = 0;
+    tsc->callback = NULL;
+    tsc->context = NULL;
+    tsc->events = 0;
+    tsc->sampling = 0;
+
+    armv7m_timer_create(&tsc->timer, stm32l4_tsc_timer_callback);
+
+    stm32l4_tsc_driver.instance = tsc;
+
+    return true;
+}
+
+bool stm32l4_tsc_destroy(stm32l4_tsc_t *tsc)
+{
+    if (tsc->state != TSC_STATE_INIT)
+    {
+	return false;
+    }
+
+    stm32l4_tsc_driver.instance = NULL;
+
+    tsc->state = TSC_STATE_NONE;
+
+    return true;
+}
+
+bool stm32l4_tsc_sampling(stm32l4_tsc_t *tsc, uint16_t pin)
+{
+    unsigned int index;
+    int entry;
+
+    if (tsc->state != TSC_STATE_INIT)
+    {
+	return false;
+    }
+
+    entry = stm32l4_tsc_lookup(pin);
+
+    if (entry < 0)
+    {
+	return false;
+    }
+
+    if (tsc->sampling & (15u << (entry & ~3)))
+    {
+	return false;
+    }
+
+    for (index = 0; index < tsc->channel_count; index++)
+    {
+	if (((tsc->channels[index].group * 4) + tsc->channels[index].io) == entry)
+	{
+	    return false;
+	}
+    }
+
+    tsc->sampling |= (1u << entry);
+
+    return true;
+}
+
+int stm32l4_tsc_channel(stm32l4_tsc_t *tsc, uint16_t pin, uint16_t threshold)
+{
+    stm32l4_tsc_channel_t *channel;
+    unsigned int index;
+    int entry;
+
+    if (tsc->state != TSC_STATE_INIT)
+    {
+	return -1;
+    }
+
+    if (tsc->channel_count == TSC_CHANNEL_COUNT)
+    {
+	return -1;
+    }
+
+    entry = stm32l4_tsc_lookup(pin);
+
+    if ((entry < 0) || (tsc->sampling & (1u << entry)))
+    {
+	return -1;
+    }
+
+    for (index = 0; index < tsc->channel_count; index++)
+    {
+	if (((tsc->channels[index].group * 4) + tsc->channels[index].io) == entry)
+	{
+	    return -1;
+	}
+    }
+
+    channel = &tsc->channels[tsc->channel_count];
+
+    channel->pin = TSC_PIN_AF | stm32l4_tsc_xlate_pin[entry];
+    channel->group = entry >> 2;
+    channel->io = entry & 3;
+    channel->threshold = threshold;
+    channel->value = 0;
+    channel->baseline = 0;
+
+    return tsc->channel_count++;
+}
+
+bool stm32l4_tsc_enable(stm32l4_tsc_t *tsc, uint32_t period, uint32_t option, stm32l4_tsc_callback_t callback, void *context, uint32_t events)
+{
+    stm32l4_tsc_channel_t *channel;
+    unsigned int index, group, phase, entry;
+    uint32_t used;
+
+    if (tsc->state != TSC_STATE_INIT)
+    {
+	return false;
+    }
+
+    if (tsc->channel_count == 0)
+    {
+	return false;
+    }
+
+    /* Each group with channels needs its sampling capacitor. Channels are
+     * distributed over the phases in the order they were added.
+     */
+    for (phase = 0; phase < 3; phase++)
+    {
+	tsc->ioccr[phase] = 0;
+	tsc->iogcsr[phase] = 0;
+
+	for (group = 0; group < TSC_GROUP_COUNT; group++)
+	{
+	    tsc->xlate[phase][group] = -1;
+	}
+    }
+
+    tsc->phase_count = 0;
+
+    for (index = 0; index < tsc->channel_count; index++)
+    {
+	channel = &tsc->channels[index];
+
+	if (!(tsc->sampling & (15u << (channel->group * 4))))
+	{
+	    return false;
+	}
+
+	for (phase = 0; tsc->iogcsr[phase] & (1u << channel->group); phase++)
+	{
+	}
+
+	tsc->ioccr[phase] |= (1u << ((channel->group * 4) + channel->io));
+	tsc->iogcsr[phase] |= (1u << channel->group);
+	tsc->xlate[phase][channel->group] = index;
+
+	if (tsc->phase_count <= phase)
+	{
+	    tsc->phase_count = phase +1;
+	}
+
+	channel->value = 0;
+	channel->baseline = 0;
+    }
+
+    tsc->period = period ? period : 1;
+    tsc->option = option;
+    tsc->phase = 0;
+    tsc->calibrate = 0;
+    tsc->busy = false;
+    tsc->touched = 0;
+    tsc->changed = 0;
+    tsc->errors = 0;
+
+    stm32l4_system_periph_enable(SYSTEM_PERIPH_TSC);
+
+    used = tsc->sampling | tsc->ioccr[0] | tsc->ioccr[1] | tsc->ioccr[2];
+
+    TSC->CR = 0;
+    TSC->IER = (TSC_IER_EOAIE | TSC_IER_MCEIE);
+    TSC->IOHCR = ~used;
+    TSC->IOASCR = 0;
+    TSC->IOSCR = tsc->sampling;
+
+    for (entry = 0; entry < (TSC_GROUP_COUNT * 4); entry++)
+    {
+	if (tsc->sampling & (1u << entry))
+	{
+	    stm32l4_gpio_pin_configure((TSC_PIN_AF | stm32l4_tsc_xlate_pin[entry]), (GPIO_PUPD_NONE | GPIO_OSPEED_LOW | GPIO_OTYPE_OPENDRAIN | GPIO_MODE_ALTERNATE));
+	}
+    }
+
+    for (index = 0; index < tsc->channel_count; index++)
+    {
+	stm32l4_gpio_pin_configure(tsc->channels[index].pin, (GPIO_PUPD_NONE | GPIO_OSPEED_LOW | GPIO_OTYPE_PUSHPULL | GPIO_MODE_ALTERNATE));
+    }
+
+    tsc->state = TSC_STATE_READY;
+
+    stm32l4_tsc_notify(tsc, callback, context, events);
+
+    NVIC_SetPriority(TSC_IRQn, tsc->priority);
+    NVIC_EnableIRQ(TSC_IRQn);
+
+    tsc->state = TSC_STATE_CALIBRATE;
+
+    armv7m_timer_start(&tsc->timer, 1);
+
+    return true;
+}
+
+bool stm32l4_tsc_disable(stm32l4_tsc_t *tsc)
+{
+    unsigned int index, entry;
+
+    if (tsc->state < TSC_STATE_READY)
+    {
+	return false;
+    }
+
+    tsc->state = TSC_STATE_READY;
+
+    armv7m_timer_stop(&tsc->timer);
+
+    NVIC_DisableIRQ(TSC_IRQn);
+
+    TSC->IER = 0;
+    TSC->CR = 0;
+    TSC->ICR = (TSC_ICR_EOAIC | TSC_ICR_MCEIC);
+
+    stm32l4_system_periph_disable(SYSTEM_PERIPH_TSC);
+
+    for (entry = 0; entry < (TSC_GROUP_COUNT * 4); entry++)
+    {
+	if (tsc->sampling & (1u << entry))
+	{
+	    stm32l4_gpio_pin_configure((TSC_PIN_AF | stm32l4_tsc_xlate_pin[entry]), (GPIO_PUPD_NONE | GPIO_MODE_ANALOG));
+	}
+    }
+
+    for (index = 0; index < tsc->channel_count; index++)
+    {
+	stm32l4_gpio_pin_configure(tsc->channels[index].pin, (GPIO_PUPD_NONE | GPIO_MODE_ANALOG));
+    }
+
+    tsc->events = 0;
+    tsc->callback = NULL;
+    tsc->context = NULL;
+
+    tsc->busy = false;
+
+    tsc->state = TSC_STATE_INIT;
+
+    return true;
+}
+
+bool stm32l4_tsc_notify(stm32l4_tsc_t *tsc, stm32l4_tsc_callback_t callback, void *context, uint32_t events)
+{
+    if (tsc->state < TSC_STATE_READY)
+    {
+	return false;
+    }
+
+    tsc->events = 0;
+
+    tsc->callback = callback;
+    tsc->context = context;
+    tsc->events = events;
+
+    return true;
+}
+
+uint32_t stm32l4_tsc_touched(stm32l4_tsc_t *tsc)
+{
+    return tsc->touched;
+}
+
+uint32_t stm32l4_tsc_changed(stm32l4_tsc_t *tsc)
+{
+    uint32_t changed;
+
+    changed = tsc->changed;
+
+    armv7m_atomic_and(&tsc->changed, ~changed);
+
+    return changed;
+}
+
+uint32_t stm32l4_tsc_value(stm32l4_tsc_t *tsc, unsigned int channel)
+{
+    if (channel >= tsc->channel_count)
+    {
+	return 0;
+    }
+
+    return tsc->channels[channel].value;
+}
+
+uint32_t stm32l4_tsc_baseline(stm32l4_tsc_t *tsc, unsigned int channel)
+{
+    if (channel >= tsc->channel_count)
+    {
+	return 0;
+    }
+
+    return (tsc->channels[channel].baseline >> 4);
+}
+
+void TSC_IRQHandler(void)
+{
+    stm32l4_tsc_t *tsc = stm32l4_tsc_driver.instance;
+    unsigned int group, phase;
+    uint32_t tsc_isr, tsc_iogcsr, events, maximum;
+    int index;
+
+    tsc_isr = TSC->ISR;
+
+    TSC->ICR = (TSC_ICR_EOAIC | TSC_ICR_MCEIC);
+
+    if (!tsc || (tsc->state < TSC_STATE_CALIBRATE) || !(tsc_isr & (TSC_ISR_EOAF | TSC_ISR_MCEF)))
+    {
+	return;
+    }
+
+    events = 0;
+
+    phase = tsc->phase;
+
+    tsc_iogcsr = TSC->IOGCSR;
+
+    maximum = (256u << ((TSC->CR & TSC_CR_MCV) >> TSC_CR_MCV_Pos)) -1;
+
+    for (group = 0; group < TSC_GROUP_COUNT; group++)
+    {
+	index = tsc->xlate[phase][group];
+
+	if (index >= 0)
+	{
+	    /* Groups that did not complete (GxS clear) stopped at the max count error.
+	     */
+	    if (tsc_iogcsr & (1u << (16 + group)))
+	    {
+		tsc->channels[index].value = TSC->IOGXCR[group];
+	    }
+	    else
+	    {
+		tsc->channels[index].value = maximum;
+
+		tsc->errors |= (1u << index);
+
+		events |= TSC_EVENT_ERROR;
+	    }
+	}
+    }
+
+    tsc->busy = false;
+
+    phase++;
+
+    if (phase == tsc->phase_count)
+    {
+	tsc->phase = 0;
+
+	events |= (stm32l4_tsc_process(tsc) | TSC_EVENT_ACQUIRE);
+
+	armv7m_timer_start(&tsc->timer, tsc->period);
+    }
+    else
+    {
+	tsc->phase = phase;
+
+	armv7m_timer_start(&tsc->timer, 1);
+    }
+
+    events &= tsc->events;
+
+    if (events)
+    {
+	(*tsc->callback)(tsc->context, events);
+    }
+}
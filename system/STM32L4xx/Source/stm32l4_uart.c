@@ -50,10 +50,7 @@ static stm32l4_uart_driver_t stm32l4_uart_driver;
 #define LPUART_HIGH_SPEED
 
 #define UART_RX_DMA_OPTION		  \
-    (DMA_OPTION_EVENT_TRANSFER_DONE |     \
-     DMA_OPTION_EVENT_TRANSFER_HALF |     \
-     DMA_OPTION_CIRCULAR |		  \
-     DMA_OPTION_PERIPHERAL_TO_MEMORY |	  \
+    (DMA_OPTION_PERIPHERAL_TO_MEMORY |	  \
      DMA_OPTION_PERIPHERAL_DATA_SIZE_32 | \
      DMA_OPTION_MEMORY_DATA_SIZE_8 |	  \
      DMA_OPTION_MEMORY_DATA_INCREMENT |	  \
@@ -99,11 +96,83 @@ static const IRQn_Type stm32l4_uart_xlate_IRQn[] = {
 stm32l4_ct_assert(STM32L4_NELEM(stm32l4_uart_xlate_USART) == UART_INSTANCE_COUNT);
 stm32l4_ct_assert(STM32L4_NELEM(stm32l4_uart_xlate_IRQn) == UART_INSTANCE_COUNT);
 
+/* Circular mode, interrupt side: advance "rx_write" to the DMA position and
+ * account the new data in "rx_total". This needs to be called at least once
+ * per half of the ring, which the DMA half/full interrupts guarantee.
+ */
+static uint32_t stm32l4_uart_dma_ring(stm32l4_uart_t *uart)
+{
+    uint32_t rx_write, rx_count;
+
+    rx_write = stm32l4_dma_count(&uart->rx_dma);
+
+    if (rx_write >= uart->rx_size)
+    {
+	rx_write = 0;
+    }
+
+    if (rx_write >= uart->rx_write)
+    {
+	rx_count = rx_write - uart->rx_write;
+    }
+    else
+    {
+	rx_count = (uart->rx_size - uart->rx_write) + rx_write;
+    }
+
+    if (!rx_count)
+    {
+	return 0;
+    }
+
+    uart->rx_write = rx_write;
+    uart->rx_total += rx_count;
+
+    return UART_EVENT_RECEIVE;
+}
+
+/* Circular mode, reader side: fold what the interrupt side accounted into "rx_count".
+ * If the DMA lapped the reader, skip ahead to the oldest byte that is still intact.
+ */
+static void stm32l4_uart_rx_sync(stm32l4_uart_t *uart)
+{
+    uint32_t rx_total, rx_count;
+
+    if (uart->mode & UART_MODE_RX_DMA_CIRCULAR)
+    {
+	rx_total = uart->rx_total;
+	rx_count = uart->rx_count + (rx_total - uart->rx_base);
+
+	uart->rx_base = rx_total;
+
+	if (rx_count > uart->rx_size)
+	{
+	    uart->rx_read = (uart->rx_read + (rx_count - uart->rx_size)) % uart->rx_size;
+
+	    rx_count = uart->rx_size;
+	}
+
+	uart->rx_count = rx_count;
+    }
+}
+
 static void stm32l4_uart_dma_callback(stm32l4_uart_t *uart, uint32_t events)
 {
     uint32_t rx_index, rx_count, rx_total, rx_size, rx_write;
     bool overrun = false;
 
+    if (uart->mode & UART_MODE_RX_DMA_CIRCULAR)
+    {
+	events = stm32l4_uart_dma_ring(uart) & uart->events;
+
+	if (events)
+	{
+	    (*uart->callback)(uart->context, events);
+	}
+
+	return;
+    }
+
     rx_index = uart->rx_index;
     rx_count = stm32l4_dma_count(&uart->rx_dma);
 
@@ -164,6 +233,38 @@ static void stm32l4_uart_dma_callback(stm32l4_uart_t *uart, uint32_t events)
     }
 }
 
+static uint32_t stm32l4_uart_brr(stm32l4_uart_t *uart, uint32_t bitrate)
+{
+    if (uart->instance == UART_INSTANCE_LPUART1)
+    {
+#ifdef LPUART_HIGH_SPEED
+	if (!(uart->mode & UART_MODE_WAKEUP))
+	{
+	    return (256UL * 16000000UL + (unsigned long)(bitrate >> 1)) / (unsigned long)bitrate;  /* HSI */
+	}
+#endif
+	return (256 * 32768 + (bitrate >> 1)) / bitrate;  /* LSE */
+    }
+    else
+    {
+	return ((16000000 + (bitrate >> 1)) / bitrate);   /* HSI */
+    }
+}
+
+/* BRR can only be written with UE cleared.
+ */
+static void stm32l4_uart_bitrate(stm32l4_uart_t *uart, uint32_t brr)
+{
+    USART_TypeDef *USART = uart->USART;
+    uint32_t usart_cr1;
+
+    usart_cr1 = USART->CR1;
+
+    USART->CR1 = usart_cr1 & ~USART_CR1_UE;
+    USART->BRR = brr;
+    USART->CR1 = usart_cr1;
+}
+
 static void stm32l4_uart_interrupt(stm32l4_uart_t *uart)
 {
     USART_TypeDef *USART = uart->USART;
@@ -215,7 +316,11 @@ static void stm32l4_uart_interrupt(stm32l4_uart_t *uart)
     {
 	if (USART->CR1 & USART_CR1_RTOIE)
 	{
-	    if (uart->mode & UART_MODE_RX_DMA)
+	    if (uart->mode & UART_MODE_RX_DMA_CIRCULAR)
+	    {
+		events |= stm32l4_uart_dma_ring(uart);
+	    }
+	    else if (uart->mode & UART_MODE_RX_DMA)
 	    {
 		rx_index = uart->rx_index;
 		rx_count = stm32l4_dma_count(&uart->rx_dma);
@@ -292,18 +397,42 @@ static void stm32l4_uart_interrupt(stm32l4_uart_t *uart)
 
 	if (USART->CR1 & USART_CR1_TCIE)
 	{
-	    if (uart->mode & UART_MODE_TX_DMA)
+	    if (uart->state == UART_STATE_FRAME)
 	    {
-		stm32l4_dma_stop(&uart->tx_dma);
-		
-		armv7m_atomic_and(&USART->CR3, ~USART_CR3_DMAT);
+		/* The break character is out, switch back to the configured bitrate
+		 * and send the frame data.
+		 */
+		armv7m_atomic_and(&USART->CR1, ~USART_CR1_TCIE);
+
+		stm32l4_uart_bitrate(uart, uart->brr);
+
+		uart->state = UART_STATE_READY;
+
+		stm32l4_uart_transmit(uart, uart->tx_data, uart->tx_count);
 	    }
+	    else
+	    {
+		if (uart->mode & UART_MODE_TX_DMA)
+		{
+		    stm32l4_dma_stop(&uart->tx_dma);
+		
+		    armv7m_atomic_and(&USART->CR3, ~USART_CR3_DMAT);
+		}
 
-	    armv7m_atomic_and(&USART->CR1, ~USART_CR1_TCIE);
+		armv7m_atomic_and(&USART->CR1, ~USART_CR1_TCIE);
 
-	    uart->state = UART_STATE_READY;
+		uart->state = UART_STATE_READY;
 	    
-	    events |= UART_EVENT_TRANSMIT;
+		events |= UART_EVENT_TRANSMIT;
+	    }
+	}
+    }
+
+    if (USART->ISR & USART_ISR_IDLE)
+    {
+	if (uart->mode & UART_MODE_RX_DMA_CIRCULAR)
+	{
+	    events |= stm32l4_uart_dma_ring(uart);
 	}
     }
 
@@ -353,6 +482,18 @@ static void stm32l4_uart_interrupt(stm32l4_uart_t *uart)
     }
 }
 
+static const uint8_t stm32l4_uart_usart1_rx_dma[] = {
+    DMA_CHANNEL_DMA1_CH5_USART1_RX,
+    DMA_CHANNEL_DMA2_CH7_USART1_RX,
+    DMA_CHANNEL_NONE,
+};
+
+static const uint8_t stm32l4_uart_usart1_tx_dma[] = {
+    DMA_CHANNEL_DMA1_CH4_USART1_TX,
+    DMA_CHANNEL_DMA2_CH6_USART1_TX,
+    DMA_CHANNEL_NONE,
+};
+
 bool stm32l4_uart_create(stm32l4_uart_t *uart, unsigned int instance, const stm32l4_uart_pins_t *pins, unsigned int priority, unsigned int mode)
 {
     if (instance >= UART_INSTANCE_COUNT)
@@ -370,14 +511,13 @@ bool stm32l4_uart_create(stm32l4_uart_t *uart, unsigned int instance, const stm3
     uart->context = NULL;
     uart->events = 0;
 
-    uart->mode = mode & ~(UART_MODE_RX_DMA | UART_MODE_TX_DMA);
+    uart->mode = mode & ~(UART_MODE_RX_DMA | UART_MODE_TX_DMA | UART_MODE_RX_DMA_CIRCULAR | UART_MODE_WAKEUP);
 
     if (mode & UART_MODE_RX_DMA)
     {
 	switch (instance) {
 	case UART_INSTANCE_USART1:
-	    if ((!(mode & UART_MODE_RX_DMA_SECONDARY) && stm32l4_dma_create(&uart->rx_dma, DMA_CHANNEL_DMA1_CH5_USART1_RX, uart->priority)) ||
-		stm32l4_dma_create(&uart->rx_dma, DMA_CHANNEL_DMA2_CH7_USART1_RX, uart->priority))
+	    if (stm32l4_dma_allocate(&uart->rx_dma, &stm32l4_uart_usart1_rx_dma[(mode & UART_MODE_RX_DMA_SECONDARY) ? 1 : 0], uart->priority))
 	    {
 		uart->mode |= UART_MODE_RX_DMA;
 	    }
@@ -413,8 +553,7 @@ bool stm32l4_uart_create(stm32l4_uart_t *uart, unsigned int instance, const stm3
     {
 	switch (instance) {
 	case UART_INSTANCE_USART1:
-	    if ((!(mode & UART_MODE_TX_DMA_SECONDARY) && stm32l4_dma_create(&uart->tx_dma, DMA_CHANNEL_DMA1_CH4_USART1_TX, uart->priority)) ||
-		stm32l4_dma_create(&uart->tx_dma, DMA_CHANNEL_DMA2_CH6_USART1_TX, uart->priority))
+	    if (stm32l4_dma_allocate(&uart->tx_dma, &stm32l4_uart_usart1_tx_dma[(mode & UART_MODE_TX_DMA_SECONDARY) ? 1 : 0], uart->priority))
 	    {
 		uart->mode |= UART_MODE_TX_DMA;
 	    }
@@ -519,15 +658,29 @@ bool stm32l4_uart_enable(stm32l4_uart_t *uart, uint8_t *rx_data, uint16_t rx_siz
     uart->rx_index = 0;
     uart->rx_event = 0;
     uart->rx_count = 0;
+    uart->rx_total = 0;
+    uart->rx_base = 0;
+
+    if ((uart->mode & UART_MODE_RX_DMA) && (option & UART_OPTION_RX_DMA_CIRCULAR))
+    {
+	uart->mode |= UART_MODE_RX_DMA_CIRCULAR;
+    }
+
+    /* HSI16 is off in STOP2, so LPUART1 has to run from LSE to keep receiving.
+     */
+    if ((uart->instance == UART_INSTANCE_LPUART1) && (option & UART_OPTION_WAKEUP))
+    {
+	uart->mode |= UART_MODE_WAKEUP;
+    }
 
 #ifdef LPUART_HIGH_SPEED
-    stm32l4_system_hsi16_enable();
+    if (!(uart->mode & UART_MODE_WAKEUP))
 #else
     if (uart->instance != UART_INSTANCE_LPUART1)
+#endif    
     {
 	stm32l4_system_hsi16_enable();
     }
-#endif    
 
     switch (uart->instance) {
     case UART_INSTANCE_USART1:
@@ -553,10 +706,15 @@ bool stm32l4_uart_enable(stm32l4_uart_t *uart, uint8_t *rx_data, uint16_t rx_siz
 #endif
     case UART_INSTANCE_LPUART1:
 #ifdef LPUART_HIGH_SPEED
-        armv7m_atomic_modify(&RCC->CCIPR, RCC_CCIPR_LPUART1SEL, RCC_CCIPR_LPUART1SEL_1); /* HSI */
-#else      
-        armv7m_atomic_modify(&RCC->CCIPR, RCC_CCIPR_LPUART1SEL, (RCC_CCIPR_LPUART1SEL_0 | RCC_CCIPR_LPUART1SEL_1)); /* LSE */
+	if (!(uart->mode & UART_MODE_WAKEUP))
+	{
+	    armv7m_atomic_modify(&RCC->CCIPR, RCC_CCIPR_LPUART1SEL, RCC_CCIPR_LPUART1SEL_1); /* HSI */
+	}
+	else
 #endif	
+	{
+	    armv7m_atomic_modify(&RCC->CCIPR, RCC_CCIPR_LPUART1SEL, (RCC_CCIPR_LPUART1SEL_0 | RCC_CCIPR_LPUART1SEL_1)); /* LSE */
+	}
 	break;
     }
 
@@ -564,6 +722,8 @@ bool stm32l4_uart_enable(stm32l4_uart_t *uart, uint8_t *rx_data, uint16_t rx_siz
 
     if (!stm32l4_uart_configure(uart, bitrate, option))
     {
+	uart->mode &= ~UART_MODE_WAKEUP;
+
 	uart->state = UART_STATE_INIT;
 
 	return false;
@@ -610,13 +770,15 @@ bool stm32l4_uart_disable(stm32l4_uart_t *uart)
     stm32l4_system_periph_disable(SYSTEM_PERIPH_USART1 + uart->instance);
 
 #ifdef LPUART_HIGH_SPEED
-    stm32l4_system_hsi16_disable();
+    if (!(uart->mode & UART_MODE_WAKEUP))
 #else    
     if (uart->instance != UART_INSTANCE_LPUART1)
+#endif    
     {
 	stm32l4_system_hsi16_disable();
     }
-#endif    
+
+    uart->mode &= ~(UART_MODE_RX_DMA_CIRCULAR | UART_MODE_WAKEUP);
 
     if (uart->pins.rx != GPIO_PIN_NONE)
     {
@@ -659,12 +821,14 @@ bool stm32l4_uart_configure(stm32l4_uart_t *uart, uint32_t bitrate, uint32_t opt
 	return false;
     }
 
-#ifndef LPUART_HIGH_SPEED    
+#ifdef LPUART_HIGH_SPEED    
+    if ((bitrate > 9600) && (uart->mode & UART_MODE_WAKEUP))
+#else
     if ((bitrate > 9600) && (uart->instance == UART_INSTANCE_LPUART1))
+#endif    
     {
 	return false;
     }
-#endif    
     if (bitrate > 921600)
     {
 	return false;
@@ -695,6 +859,11 @@ bool stm32l4_uart_configure(stm32l4_uart_t *uart, uint32_t bitrate, uint32_t opt
 	return false;
     }
 
+    if ((option & UART_OPTION_WAKEUP) && (uart->instance != UART_INSTANCE_LPUART1))
+    {
+	return false;
+    }
+
     if (uart->state == UART_STATE_BUSY)
     {
 	stm32l4_system_periph_enable(SYSTEM_PERIPH_USART1 + uart->instance);
@@ -725,6 +894,14 @@ bool stm32l4_uart_configure(stm32l4_uart_t *uart, uint32_t bitrate, uint32_t opt
 	    usart_cr1 |= USART_CR1_RXNEIE;
 	}
 
+	/* With UESM set the LSE clocked LPUART1 stays functional in STOP2, and
+	 * RXNE wakes up the core for every received byte.
+	 */
+	if (uart->mode & UART_MODE_WAKEUP)
+	{
+	    usart_cr1 |= USART_CR1_UESM;
+	}
+
 	USART->RTOR = 32;
     }
 
@@ -836,25 +1013,24 @@ bool stm32l4_uart_configure(stm32l4_uart_t *uart, uint32_t bitrate, uint32_t opt
 	usart_cr2 |= USART_CR2_DATAINV;
     }
 
-    if (uart->instance == UART_INSTANCE_LPUART1)
-    {
-#ifdef LPUART_HIGH_SPEED
-      USART->BRR = (256UL * 16000000UL + (unsigned long)(bitrate >> 1)) / (unsigned long)bitrate;  /* HSI */
-#else
-      USART->BRR = (256 * 32768 + (bitrate >> 1)) / bitrate;  /* LSE */
-#endif
-    }
-    else
-    {
-	USART->BRR = ((16000000 + (bitrate >> 1)) / bitrate);   /* HSI */
-    }
+    uart->brr = stm32l4_uart_brr(uart, bitrate);
+
+    USART->BRR = uart->brr;
 
     if (uart->mode & UART_MODE_RX_DMA)
     {
 	if (uart->state == UART_STATE_BUSY)
 	{
 	    stm32l4_dma_enable(&uart->rx_dma, (stm32l4_dma_callback_t)stm32l4_uart_dma_callback, uart);
-	    stm32l4_dma_start(&uart->rx_dma, (uint32_t)uart->rx_fifo, (uint32_t)&USART->RDR, 16, UART_RX_DMA_OPTION);
+
+	    if (uart->mode & UART_MODE_RX_DMA_CIRCULAR)
+	    {
+		stm32l4_dma_start_circular(&uart->rx_dma, (uint32_t)uart->rx_data, (uint32_t)&USART->RDR, uart->rx_size, UART_RX_DMA_OPTION);
+	    }
+	    else
+	    {
+		stm32l4_dma_start_circular(&uart->rx_dma, (uint32_t)uart->rx_fifo, (uint32_t)&USART->RDR, 16, UART_RX_DMA_OPTION);
+	    }
 	}
     }
 
@@ -888,7 +1064,7 @@ bool stm32l4_uart_configure(stm32l4_uart_t *uart, uint32_t bitrate, uint32_t opt
 	    usart_cr1 |= USART_CR1_PEIE;
 	}
 
-	if (uart->events & UART_EVENT_IDLE)
+	if ((uart->events & UART_EVENT_IDLE) || (uart->mode & UART_MODE_RX_DMA_CIRCULAR))
 	{
 	    usart_cr1 |= USART_CR1_IDLEIE;
 	}
@@ -951,7 +1127,7 @@ bool stm32l4_uart_notify(stm32l4_uart_t *uart, stm32l4_uart_callback_t callback,
 	    armv7m_atomic_and(&USART->CR1, ~USART_CR1_PEIE);
 	}
 
-	if (uart->events & UART_EVENT_IDLE)
+	if ((uart->events & UART_EVENT_IDLE) || (uart->mode & UART_MODE_RX_DMA_CIRCULAR))
 	{
 	    armv7m_atomic_or(&USART->CR1, USART_CR1_IDLEIE);
 	}
@@ -994,6 +1170,8 @@ unsigned int stm32l4_uart_receive(stm32l4_uart_t *uart, uint8_t *rx_data, uint16
 	return false;
     }
 
+    stm32l4_uart_rx_sync(uart);
+
     rx_size = uart->rx_count;
 
     if (rx_count > rx_size)
@@ -1046,6 +1224,8 @@ unsigned int stm32l4_uart_count(stm32l4_uart_t *uart)
 	return 0;
     }
 
+    stm32l4_uart_rx_sync(uart);
+
     return uart->rx_count;
 }
 
@@ -1056,6 +1236,8 @@ int stm32l4_uart_peek(stm32l4_uart_t *uart)
 	return -1;
     }
 
+    stm32l4_uart_rx_sync(uart);
+
     if (!uart->rx_count)
     {
 	return -1;
@@ -1064,6 +1246,61 @@ int stm32l4_uart_peek(stm32l4_uart_t *uart)
     return uart->rx_data[uart->rx_read];
 }
 
+/* Return the contiguous span of received data at the read position, without copying.
+ * It stays valid till it gets released with stm32l4_uart_consume().
+ */
+unsigned int stm32l4_uart_peek_buffer(stm32l4_uart_t *uart, const uint8_t **p_data_return)
+{
+    uint32_t rx_size, rx_read;
+
+    if (uart->state < UART_STATE_READY)
+    {
+	return 0;
+    }
+
+    stm32l4_uart_rx_sync(uart);
+
+    rx_size = uart->rx_count;
+    rx_read = uart->rx_read;
+
+    if ((rx_read + rx_size) > uart->rx_size)
+    {
+	rx_size = uart->rx_size - rx_read;
+    }
+
+    *p_data_return = &uart->rx_data[rx_read];
+
+    return rx_size;
+}
+
+void stm32l4_uart_consume(stm32l4_uart_t *uart, uint16_t rx_count)
+{
+    uint32_t rx_read;
+
+    if (uart->state < UART_STATE_READY)
+    {
+	return;
+    }
+
+    stm32l4_uart_rx_sync(uart);
+
+    if (rx_count > uart->rx_count)
+    {
+	rx_count = uart->rx_count;
+    }
+
+    rx_read = uart->rx_read + rx_count;
+
+    if (rx_read >= uart->rx_size)
+    {
+	rx_read -= uart->rx_size;
+    }
+
+    uart->rx_read = rx_read;
+
+    armv7m_atomic_sub(&uart->rx_count, rx_count);
+}
+
 bool stm32l4_uart_transmit(stm32l4_uart_t *uart, const uint8_t *tx_data, uint16_t tx_count)
 {
     USART_TypeDef *USART = uart->USART;
@@ -1128,6 +1365,34 @@ bool stm32l4_uart_send_break(stm32l4_uart_t *uart)
     return true;
 }
 
+bool stm32l4_uart_transmit_frame(stm32l4_uart_t *uart, const uint8_t *tx_data, uint16_t tx_count, uint32_t break_bitrate)
+{
+    USART_TypeDef *USART = uart->USART;
+
+    if (uart->state != UART_STATE_READY)
+    {
+	return false;
+    }
+
+    if ((break_bitrate == 0) || (tx_count == 0))
+    {
+	return false;
+    }
+
+    uart->state = UART_STATE_FRAME;
+
+    uart->tx_data  = tx_data;
+    uart->tx_count = tx_count;
+
+    stm32l4_uart_bitrate(uart, stm32l4_uart_brr(uart, break_bitrate));
+
+    USART->TDR = 0x00;
+
+    armv7m_atomic_or(&USART->CR1, USART_CR1_TCIE);
+
+    return true;
+}
+
 bool stm32l4_uart_done(stm32l4_uart_t *uart)
 {
     return (uart->state == UART_STATE_READY);
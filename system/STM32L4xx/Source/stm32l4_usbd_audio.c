@@ -0,0 +1,227 @@
+/*
+ * Copyright (c) 2017 Thomas Roell.  All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal with the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ *  1. Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimers.
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimers in the
+ *     documentation and/or other materials provided with the distribution.
+ *  3. Neither the name of Thomas Roell, nor the names of its contributors
+ *     may be used to endorse or promote products derived from this Software
+ *     without specific prior written permission.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ * CONTRIBUTORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * WITH THE SOFTWARE.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include "stm32l4xx.h"
+
+#include "armv7m.h"
+#include "stm32l4_usbd_audio.h"
+#include "usbd_audio.h"
+
+#if (USBD_AUDIO_SAMPLE_RATE != AUDIO_SAMPLE_RATE) || (USBD_AUDIO_FRAME_SIZE != AUDIO_FRAME_SIZE) || (USBD_AUDIO_PACKET_SIZE != AUDIO_OUT_PACKET_SIZE)
+#error "stm32l4_usbd_audio.h does not match usbd_audio.h"
+#endif
+
+typedef struct _stm32l4_usbd_audio_device_t {
+    struct _USBD_HandleTypeDef     *USBD;
+    volatile uint8_t               streaming;
+    volatile uint8_t               mute;
+    volatile int16_t               volume;
+    stm32l4_usbd_audio_receive_t   receive;
+    stm32l4_usbd_audio_feedback_t  feedback;
+    stm32l4_usbd_audio_event_t     event;
+    void                           *context;
+    uint32_t                       rx_data[USBD_AUDIO_PACKET_SIZE / 4];
+} stm32l4_usbd_audio_device_t;
+
+static stm32l4_usbd_audio_device_t stm32l4_usbd_audio_device;
+
+static void stm32l4_usbd_audio_init(USBD_HandleTypeDef *USBD)
+{
+    stm32l4_usbd_audio_device.USBD = USBD;
+    stm32l4_usbd_audio_device.streaming = 0;
+    stm32l4_usbd_audio_device.mute = 0;
+    stm32l4_usbd_audio_device.volume = AUDIO_VOLUME_MAX;
+}
+
+static void stm32l4_usbd_audio_deinit(void)
+{
+    stm32l4_usbd_audio_device.streaming = 0;
+
+    stm32l4_usbd_audio_device.USBD = NULL;
+}
+
+static uint8_t *stm32l4_usbd_audio_start(void)
+{
+    uint8_t *data = NULL;
+
+    stm32l4_usbd_audio_device.streaming = 1;
+
+    if (stm32l4_usbd_audio_device.event)
+    {
+	(*stm32l4_usbd_audio_device.event)(stm32l4_usbd_audio_device.context, USBD_AUDIO_EVENT_START);
+    }
+
+    if (stm32l4_usbd_audio_device.receive)
+    {
+	data = (*stm32l4_usbd_audio_device.receive)(stm32l4_usbd_audio_device.context, NULL, 0);
+    }
+
+    return (data ? data : (uint8_t*)&stm32l4_usbd_audio_device.rx_data[0]);
+}
+
+static void stm32l4_usbd_audio_stop(void)
+{
+    if (stm32l4_usbd_audio_device.streaming)
+    {
+	stm32l4_usbd_audio_device.streaming = 0;
+
+	if (stm32l4_usbd_audio_device.event)
+	{
+	    (*stm32l4_usbd_audio_device.event)(stm32l4_usbd_audio_device.context, USBD_AUDIO_EVENT_STOP);
+	}
+    }
+}
+
+/* Without a "receive" callback (or if it has no buffer to offer) packets go
+ * to "rx_data" and are dropped.
+ */
+static uint8_t *stm32l4_usbd_audio_receive(uint8_t *data, uint32_t count)
+{
+    if (!stm32l4_usbd_audio_device.receive)
+    {
+	return (uint8_t*)&stm32l4_usbd_audio_device.rx_data[0];
+    }
+
+    if (data == (uint8_t*)&stm32l4_usbd_audio_device.rx_data[0])
+    {
+	data = (*stm32l4_usbd_audio_device.receive)(stm32l4_usbd_audio_device.context, NULL, 0);
+    }
+    else
+    {
+	data = (*stm32l4_usbd_audio_device.receive)(stm32l4_usbd_audio_device.context, data, count);
+    }
+
+    return (data ? data : (uint8_t*)&stm32l4_usbd_audio_device.rx_data[0]);
+}
+
+static uint32_t stm32l4_usbd_audio_feedback(void)
+{
+    if (stm32l4_usbd_audio_device.feedback)
+    {
+	return (*stm32l4_usbd_audio_device.feedback)(stm32l4_usbd_audio_device.context);
+    }
+
+    return USBD_AUDIO_FEEDBACK_NOMINAL;
+}
+
+static void stm32l4_usbd_audio_control(uint8_t control, int16_t value)
+{
+    uint32_t events;
+
+    if (control == AUDIO_CONTROL_MUTE)
+    {
+	stm32l4_usbd_audio_device.mute = value;
+
+	events = USBD_AUDIO_EVENT_MUTE;
+    }
+    else
+    {
+	stm32l4_usbd_audio_device.volume = value;
+
+	events = USBD_AUDIO_EVENT_VOLUME;
+    }
+
+    if (stm32l4_usbd_audio_device.event)
+    {
+	(*stm32l4_usbd_audio_device.event)(stm32l4_usbd_audio_device.context, events);
+    }
+}
+
+const USBD_AUDIO_ItfTypeDef stm32l4_usbd_audio_interface = {
+    stm32l4_usbd_audio_init,
+    stm32l4_usbd_audio_deinit,
+    stm32l4_usbd_audio_start,
+    stm32l4_usbd_audio_stop,
+    stm32l4_usbd_audio_receive,
+    stm32l4_usbd_audio_feedback,
+    stm32l4_usbd_audio_control,
+};
+
+bool stm32l4_usbd_audio_enable(stm32l4_usbd_audio_receive_t receive, stm32l4_usbd_audio_feedback_t feedback, stm32l4_usbd_audio_event_t event, void *context)
+{
+    if (stm32l4_usbd_audio_device.receive)
+    {
+	return false;
+    }
+
+#if defined(STM32L476xx) || defined(STM32L496xx)
+    NVIC_DisableIRQ(OTG_FS_IRQn);
+#else
+    NVIC_DisableIRQ(USB_IRQn);
+#endif
+
+    stm32l4_usbd_audio_device.receive = receive;
+    stm32l4_usbd_audio_device.feedback = feedback;
+    stm32l4_usbd_audio_device.event = event;
+    stm32l4_usbd_audio_device.context = context;
+
+#if defined(STM32L476xx) || defined(STM32L496xx)
+    NVIC_EnableIRQ(OTG_FS_IRQn);
+#else
+    NVIC_EnableIRQ(USB_IRQn);
+#endif
+
+    return true;
+}
+
+void stm32l4_usbd_audio_disable(void)
+{
+#if defined(STM32L476xx) || defined(STM32L496xx)
+    NVIC_DisableIRQ(OTG_FS_IRQn);
+#else
+    NVIC_DisableIRQ(USB_IRQn);
+#endif
+
+    stm32l4_usbd_audio_device.receive = NULL;
+    stm32l4_usbd_audio_device.feedback = NULL;
+    stm32l4_usbd_audio_device.event = NULL;
+    stm32l4_usbd_audio_device.context = NULL;
+
+#if defined(STM32L476xx) || defined(STM32L496xx)
+    NVIC_EnableIRQ(OTG_FS_IRQn);
+#else
+    NVIC_EnableIRQ(USB_IRQn);
+#endif
+}
+
+bool stm32l4_usbd_audio_streaming(void)
+{
+    return stm32l4_usbd_audio_device.streaming;
+}
+
+bool stm32l4_usbd_audio_mute(void)
+{
+    return stm32l4_usbd_audio_device.mute;
+}
+
+int16_t stm32l4_usbd_audio_volume(void)
+{
+    return stm32l4_usbd_audio_device.volume;
+}
@@ -40,8 +40,14 @@
 extern void USBD_Detach(void);
 extern void USBD_RegisterCallbacks(void(*sof_callback)(void), void(*suspend_callback)(void), void(*resume_callback)(void));
 
+/* "receive" and "transmit" start a packet on the CDC or the WEBUSB data endpoints. They are
+ * set up by stm32l4_usbd_cdc_create()/stm32l4_usbd_cdc_create_webusb(), so that only the
+ * device actually used by a sketch (and its class driver) ends up being linked in.
+ */
 typedef struct _stm32l4_usbd_cdc_device_t {
   struct _USBD_HandleTypeDef     *USBD;
+  void                           (*receive)(struct _USBD_HandleTypeDef *USBD, uint8_t *rx_data);
+  uint8_t                        (*transmit)(struct _USBD_HandleTypeDef *USBD, const uint8_t *tx_data, uint32_t tx_count);
   volatile uint8_t               rx_busy;
   volatile uint8_t               tx_busy;
   volatile uint8_t               tx_flush;
@@ -50,6 +56,14 @@ typedef struct _stm32l4_usbd_cdc_device_t {
   uint32_t                       timeout;
   volatile stm32l4_usbd_cdc_info_t cdc_info;
   stm32l4_usbd_cdc_t             *instances[USBD_CDC_INSTANCE_COUNT];
+  volatile uint8_t               rx_raw;
+  volatile uint8_t               raw_index;
+  volatile uint8_t               raw_busy;
+  volatile uint32_t              raw_size;
+  uint8_t                        *raw_block[2];
+  stm32l4_usbd_webusb_block_callback_t raw_block_callback;
+  stm32l4_usbd_webusb_request_callback_t raw_request_callback;
+  void                           *raw_context;
 } stm32l4_usbd_cdc_device_t;
 
 static stm32l4_usbd_cdc_device_t stm32l4_usbd_cdc_device;
@@ -81,6 +95,10 @@ static void stm32l4_usbd_cdc_sof_callback2(stm32l4_usbd_cdc_device_t* device) {
 
 static void stm32l4_usbd_cdc_sof_callback() {
   stm32l4_usbd_cdc_sof_callback2(&stm32l4_usbd_cdc_device);
+}
+
+static void stm32l4_usbd_webusb_sof_callback() {
+  stm32l4_usbd_cdc_sof_callback2(&stm32l4_usbd_cdc_device);
   stm32l4_usbd_cdc_sof_callback2(&stm32l4_usbd_webusb_device);
 }
 
@@ -107,6 +125,10 @@ static void stm32l4_usbd_cdc_suspend_callback2(stm32l4_usbd_cdc_device_t* device
 
 static void stm32l4_usbd_cdc_suspend_callback() {
   stm32l4_usbd_cdc_suspend_callback2(&stm32l4_usbd_cdc_device);
+}
+
+static void stm32l4_usbd_webusb_suspend_callback() {
+  stm32l4_usbd_cdc_suspend_callback2(&stm32l4_usbd_cdc_device);
   stm32l4_usbd_cdc_suspend_callback2(&stm32l4_usbd_webusb_device);
 }
 
@@ -123,18 +145,43 @@ static void stm32l4_usbd_cdc_resume_callback2(stm32l4_usbd_cdc_device_t* device)
 
 static void stm32l4_usbd_cdc_resume_callback() {
   stm32l4_usbd_cdc_resume_callback2(&stm32l4_usbd_cdc_device);
+}
+
+static void stm32l4_usbd_webusb_resume_callback() {
+  stm32l4_usbd_cdc_resume_callback2(&stm32l4_usbd_cdc_device);
   stm32l4_usbd_cdc_resume_callback2(&stm32l4_usbd_webusb_device);
 }
 
+static void stm32l4_usbd_cdc_receive_packet(USBD_HandleTypeDef *USBD, uint8_t *rx_data) {
+  USBD_CDC_SetRxBuffer(USBD, rx_data);
+  USBD_CDC_ReceivePacket(USBD);
+}
+
+static uint8_t stm32l4_usbd_cdc_transmit_packet(USBD_HandleTypeDef *USBD, const uint8_t *tx_data, uint32_t tx_count) {
+  USBD_CDC_SetTxBuffer(USBD, tx_data, tx_count);
+  return USBD_CDC_TransmitPacket(USBD);
+}
+
+static void stm32l4_usbd_webusb_receive_packet(USBD_HandleTypeDef *USBD, uint8_t *rx_data) {
+  USBD_WEBUSB_SetRxBuffer(USBD, rx_data);
+  USBD_WEBUSB_ReceivePacket(USBD);
+}
+
+static uint8_t stm32l4_usbd_webusb_transmit_packet(USBD_HandleTypeDef *USBD, const uint8_t *tx_data, uint32_t tx_count) {
+  USBD_WEBUSB_SetTxBuffer(USBD, tx_data, tx_count);
+  return USBD_WEBUSB_TransmitPacket(USBD);
+}
+
 static void stm32l4_usbd_cdc_setrxbuffer(stm32l4_usbd_cdc_device_t* device) {
   stm32l4_usbd_cdc_t *usbd_cdc = device->instances[0];
-  if (device == &stm32l4_usbd_cdc_device) {
-    USBD_CDC_SetRxBuffer(device->USBD, &usbd_cdc->rx_data[usbd_cdc->rx_write]);
-    USBD_CDC_ReceivePacket(device->USBD);
-  } else if (device == &stm32l4_usbd_webusb_device) {
-    USBD_WEBUSB_SetRxBuffer(device->USBD, &usbd_cdc->rx_data[usbd_cdc->rx_write]);
-    USBD_WEBUSB_ReceivePacket(device->USBD);
+
+  /* In raw mode the OUT endpoint belongs to stm32l4_usbd_webusb_raw_receive().
+   */
+  if (device->raw_size)
+  {
+    return;
   }
+  (*device->receive)(device->USBD, &usbd_cdc->rx_data[usbd_cdc->rx_write]);
 
   device->rx_busy = 1;
 }
@@ -160,10 +207,6 @@ static void stm32l4_usbd_cdc_init2(stm32l4_usbd_cdc_device_t* device, USBD_Handl
     usbd_cdc->state = USBD_CDC_STATE_RESET;
     stm32l4_usbd_cdc_setrxbuffer(device);
   }
-  
-  USBD_RegisterCallbacks(stm32l4_usbd_cdc_sof_callback,
-			 stm32l4_usbd_cdc_suspend_callback,
-			 stm32l4_usbd_cdc_resume_callback);
 }
 
 
@@ -304,6 +347,10 @@ static void stm32l4_usbd_cdc_tx_done2(stm32l4_usbd_cdc_device_t* device) {
 
 static void stm32l4_usbd_cdc_init(USBD_HandleTypeDef *USBD) {
   stm32l4_usbd_cdc_init2(&stm32l4_usbd_cdc_device, USBD);
+
+  USBD_RegisterCallbacks(stm32l4_usbd_cdc_sof_callback,
+			 stm32l4_usbd_cdc_suspend_callback,
+			 stm32l4_usbd_cdc_resume_callback);
 }
 static void stm32l4_usbd_cdc_deinit(void) { stm32l4_usbd_cdc_deinit2(&stm32l4_usbd_cdc_device); }
 static void stm32l4_usbd_cdc_control(uint8_t command, uint8_t *data, uint16_t length) {
@@ -322,15 +369,108 @@ const USBD_CDC_ItfTypeDef stm32l4_usbd_cdc_interface = {
     stm32l4_usbd_cdc_tx_done,
 };
 
+/* Raw WebUSB mode: every bulk OUT transfer is received as one block of up to "raw_size" bytes
+ * straight into one of two block buffers. A transfer ends with a full block or a short
+ * packet. While both blocks are owned by the application the endpoint stays unarmed and the
+ * host gets NAKed, which is the flow control.
+ */
+static void stm32l4_usbd_webusb_raw_receive(stm32l4_usbd_cdc_device_t* device) {
+  unsigned int index;
+
+  index = device->raw_index;
+
+  if (device->USBD && device->raw_size && !device->rx_busy && !(device->raw_busy & (1u << index)))
+  {
+    USBD_WEBUSB_SetRxBuffer(device->USBD, device->raw_block[index]);
+    USBD_WEBUSB_ReceiveBlock(device->USBD, device->raw_size);
+
+    device->rx_raw = 1;
+    device->rx_busy = 1;
+  }
+}
+
+static void stm32l4_usbd_webusb_cdc_receive(stm32l4_usbd_cdc_device_t* device) {
+  stm32l4_usbd_cdc_t *usbd_cdc = device->instances[0];
+
+  if (device->USBD && !device->rx_busy && usbd_cdc && (usbd_cdc->state > USBD_CDC_STATE_INIT) && (usbd_cdc->state != USBD_CDC_STATE_RESET))
+  {
+    if ((usbd_cdc->rx_wrap - usbd_cdc->rx_count) >= USBD_CDC_DATA_MAX_PACKET_SIZE)
+    {
+      stm32l4_usbd_cdc_setrxbuffer(device);
+    }
+  }
+}
+
 static void stm32l4_usbd_webusb_init(USBD_HandleTypeDef *USBD) {
+  stm32l4_usbd_webusb_device.rx_raw = 0;
+
   stm32l4_usbd_cdc_init2(&stm32l4_usbd_webusb_device, USBD);
+
+  /* WEBUSB is initialized after CDC, and takes over the callbacks for both devices.
+   */
+  USBD_RegisterCallbacks(stm32l4_usbd_webusb_sof_callback,
+			 stm32l4_usbd_webusb_suspend_callback,
+			 stm32l4_usbd_webusb_resume_callback);
+
+  stm32l4_usbd_webusb_raw_receive(&stm32l4_usbd_webusb_device);
+}
+static void stm32l4_usbd_webusb_deinit(void) {
+  stm32l4_usbd_webusb_device.rx_raw = 0;
+
+  stm32l4_usbd_cdc_deinit2(&stm32l4_usbd_webusb_device);
 }
-static void stm32l4_usbd_webusb_deinit(void) { stm32l4_usbd_cdc_deinit2(&stm32l4_usbd_webusb_device); }
 static void stm32l4_usbd_webusb_control(uint8_t command, uint8_t *data, uint16_t length) {
-  stm32l4_usbd_cdc_control2(&stm32l4_usbd_webusb_device, command, data, length);
+  stm32l4_usbd_cdc_device_t *device = &stm32l4_usbd_webusb_device;
+
+  if (device->raw_request_callback && (command != USBD_CDC_SET_LINE_CODING) && (command != USBD_CDC_GET_LINE_CODING) && (command != USBD_CDC_SET_CONTROL_LINE_STATE))
+  {
+    (*device->raw_request_callback)(device->raw_context, command, data, length);
+  }
+  else
+  {
+    stm32l4_usbd_cdc_control2(device, command, data, length);
+  }
 }
 static void stm32l4_usbd_webusb_rx_ready(uint8_t *data, uint32_t length) {
-  stm32l4_usbd_cdc_rx_ready2(&stm32l4_usbd_webusb_device, data, length);
+  stm32l4_usbd_cdc_device_t *device = &stm32l4_usbd_webusb_device;
+  unsigned int index;
+
+  if (device->rx_raw)
+  {
+    device->rx_raw = 0;
+    device->rx_busy = 0;
+
+    if (device->raw_size)
+    {
+      /* A zero length packet (the host ending a transfer at a block boundary) re-arms the same block.
+       */
+      if (length)
+      {
+	index = device->raw_index;
+
+	device->raw_busy |= (1u << index);
+	device->raw_index = index ^ 1;
+
+	(*device->raw_block_callback)(device->raw_context, data, length);
+      }
+
+      stm32l4_usbd_webusb_raw_receive(device);
+    }
+    else
+    {
+      /* Raw mode got disabled with a block in flight, so the data is dropped.
+       */
+      stm32l4_usbd_webusb_cdc_receive(device);
+    }
+  }
+  else
+  {
+    stm32l4_usbd_cdc_rx_ready2(device, data, length);
+
+    /* Raw mode got enabled with a CDC packet in flight.
+     */
+    stm32l4_usbd_webusb_raw_receive(device);
+  }
 }
 static void stm32l4_usbd_webusb_tx_done() { stm32l4_usbd_cdc_tx_done2(&stm32l4_usbd_webusb_device); }
 
@@ -358,6 +498,8 @@ bool stm32l4_usbd_cdc_create(stm32l4_usbd_cdc_t *usbd_cdc)
     usbd_cdc->events = 0;
 
     stm32l4_usbd_cdc_device_t* device = &stm32l4_usbd_cdc_device;
+    device->receive = stm32l4_usbd_cdc_receive_packet;
+    device->transmit = stm32l4_usbd_cdc_transmit_packet;
     device->instances[0] = usbd_cdc;
     usbd_cdc->device = (void *)device;
 
@@ -380,12 +522,106 @@ bool stm32l4_usbd_cdc_create_webusb(stm32l4_usbd_cdc_t *usbd_cdc)
     usbd_cdc->events = 0;
 
     stm32l4_usbd_cdc_device_t* device = &stm32l4_usbd_webusb_device;
+    device->receive = stm32l4_usbd_webusb_receive_packet;
+    device->transmit = stm32l4_usbd_webusb_transmit_packet;
     device->instances[0] = usbd_cdc;
     usbd_cdc->device = (void *)device;
 
     return true;
 }
 
+bool stm32l4_usbd_webusb_raw_enable(uint8_t *block0, uint8_t *block1, uint32_t size, stm32l4_usbd_webusb_block_callback_t block_callback, stm32l4_usbd_webusb_request_callback_t request_callback, void *context)
+{
+    stm32l4_usbd_cdc_device_t *device = &stm32l4_usbd_webusb_device;
+
+    if (device->raw_size || !block0 || !block1 || !block_callback || !size || (size & (USBD_CDC_DATA_MAX_PACKET_SIZE -1)) || (size > 65535))
+    {
+	return false;
+    }
+
+#if defined(STM32L476xx) || defined(STM32L496xx)
+    NVIC_DisableIRQ(OTG_FS_IRQn);
+#else
+    NVIC_DisableIRQ(USB_IRQn);
+#endif
+
+    device->raw_block[0] = block0;
+    device->raw_block[1] = block1;
+    device->raw_block_callback = block_callback;
+    device->raw_request_callback = request_callback;
+    device->raw_context = context;
+    device->raw_index = 0;
+    device->raw_busy = 0;
+    device->raw_size = size;
+
+    stm32l4_usbd_webusb_raw_receive(device);
+
+#if defined(STM32L476xx) || defined(STM32L496xx)
+    NVIC_EnableIRQ(OTG_FS_IRQn);
+#else
+    NVIC_EnableIRQ(USB_IRQn);
+#endif
+
+    return true;
+}
+
+void stm32l4_usbd_webusb_raw_disable(void)
+{
+    stm32l4_usbd_cdc_device_t *device = &stm32l4_usbd_webusb_device;
+
+#if defined(STM32L476xx) || defined(STM32L496xx)
+    NVIC_DisableIRQ(OTG_FS_IRQn);
+#else
+    NVIC_DisableIRQ(USB_IRQn);
+#endif
+
+    device->raw_size = 0;
+    device->raw_busy = 0;
+    device->raw_block_callback = NULL;
+    device->raw_request_callback = NULL;
+    device->raw_context = NULL;
+
+    stm32l4_usbd_webusb_cdc_receive(device);
+
+#if defined(STM32L476xx) || defined(STM32L496xx)
+    NVIC_EnableIRQ(OTG_FS_IRQn);
+#else
+    NVIC_EnableIRQ(USB_IRQn);
+#endif
+}
+
+void stm32l4_usbd_webusb_raw_release(uint8_t *block)
+{
+    stm32l4_usbd_cdc_device_t *device = &stm32l4_usbd_webusb_device;
+
+#if defined(STM32L476xx) || defined(STM32L496xx)
+    NVIC_DisableIRQ(OTG_FS_IRQn);
+#else
+    NVIC_DisableIRQ(USB_IRQn);
+#endif
+
+    if (device->raw_size)
+    {
+	if (block == device->raw_block[0])
+	{
+	    device->raw_busy &= ~1u;
+	}
+
+	if (block == device->raw_block[1])
+	{
+	    device->raw_busy &= ~2u;
+	}
+
+	stm32l4_usbd_webusb_raw_receive(device);
+    }
+
+#if defined(STM32L476xx) || defined(STM32L496xx)
+    NVIC_EnableIRQ(OTG_FS_IRQn);
+#else
+    NVIC_EnableIRQ(USB_IRQn);
+#endif
+}
+
 bool stm32l4_usbd_cdc_destroy(stm32l4_usbd_cdc_t *usbd_cdc)
 {
     if (usbd_cdc->state != USBD_CDC_STATE_INIT)
@@ -570,6 +806,81 @@ int stm32l4_usbd_cdc_peek(stm32l4_usbd_cdc_t *usbd_cdc)
     return usbd_cdc->rx_data[usbd_cdc->rx_read];
 }
 
+/* Return the contiguous span of received data at the read position, straight out of
+ * the buffer the OUT packets land in. It stays valid till it gets released with
+ * stm32l4_usbd_cdc_consume().
+ */
+unsigned int stm32l4_usbd_cdc_peek_buffer(stm32l4_usbd_cdc_t *usbd_cdc, const uint8_t **p_data_return)
+{
+    uint32_t rx_size, rx_read, rx_wrap;
+
+    if (usbd_cdc->state < USBD_CDC_STATE_READY)
+    {
+	return 0;
+    }
+
+    rx_size = usbd_cdc->rx_count;
+    rx_read = usbd_cdc->rx_read;
+    rx_wrap = usbd_cdc->rx_wrap;
+
+    if ((rx_read + rx_size) > rx_wrap)
+    {
+	rx_size = rx_wrap - rx_read;
+    }
+
+    *p_data_return = &usbd_cdc->rx_data[rx_read];
+
+    return rx_size;
+}
+
+void stm32l4_usbd_cdc_consume(stm32l4_usbd_cdc_t *usbd_cdc, uint16_t rx_count)
+{
+    uint32_t rx_size, rx_read, rx_wrap;
+
+    if (usbd_cdc->state < USBD_CDC_STATE_READY)
+    {
+	return;
+    }
+    stm32l4_usbd_cdc_device_t* device = (stm32l4_usbd_cdc_device_t*)usbd_cdc->device;
+
+    if (rx_count > usbd_cdc->rx_count)
+    {
+	rx_count = usbd_cdc->rx_count;
+    }
+
+    rx_read = usbd_cdc->rx_read;
+    rx_wrap = usbd_cdc->rx_wrap;
+    rx_size = rx_count;
+
+    if ((rx_read + rx_size) > rx_wrap)
+    {
+	rx_size = rx_wrap - rx_read;
+    }
+
+    rx_read += rx_size;
+
+    if (rx_read == rx_wrap)
+    {
+	rx_read = 0;
+
+	usbd_cdc->rx_wrap = usbd_cdc->rx_size;
+    }
+
+    rx_read += (rx_count - rx_size);
+
+    usbd_cdc->rx_read = rx_read;
+
+    armv7m_atomic_sub(&usbd_cdc->rx_count, rx_count);
+
+    if (!device->rx_busy && (usbd_cdc->state != USBD_CDC_STATE_RESET))
+    {
+	if ((usbd_cdc->rx_wrap - usbd_cdc->rx_count) >= USBD_CDC_DATA_MAX_PACKET_SIZE)
+	{
+	  stm32l4_usbd_cdc_setrxbuffer(device);
+	}
+    }
+}
+
 bool stm32l4_usbd_cdc_transmit(stm32l4_usbd_cdc_t *usbd_cdc, const uint8_t *tx_data, uint32_t tx_count)
 {
     int status = 1;
@@ -605,13 +916,7 @@ bool stm32l4_usbd_cdc_transmit(stm32l4_usbd_cdc_t *usbd_cdc, const uint8_t *tx_d
     {
 	device->tx_busy = 1;
 
-	if (device == &stm32l4_usbd_cdc_device) {
-	  USBD_CDC_SetTxBuffer(device->USBD, tx_data, tx_count);
-	  status = USBD_CDC_TransmitPacket(device->USBD);
-	} else if (device == &stm32l4_usbd_webusb_device) {
-	  USBD_WEBUSB_SetTxBuffer(device->USBD, tx_data, tx_count);
-	  status = USBD_WEBUSB_TransmitPacket(device->USBD);
-	}
+	status = (*device->transmit)(device->USBD, tx_data, tx_count);
 	
 #if defined(STM32L476xx) || defined(STM32L496xx)
 	NVIC_EnableIRQ(OTG_FS_IRQn);
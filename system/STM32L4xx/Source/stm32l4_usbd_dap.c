@@ -66,10 +66,16 @@ void stm32l4_usbd_dap_initialize(uint16_t pin_swclk, uint16_t pin_swdio)
     DAP_PINS.SWDIO_BIT = 1ul << ((pin_swdio & GPIO_PIN_INDEX_MASK) >> GPIO_PIN_INDEX_SHIFT);
     DAP_PINS.SWDIO_PIN = pin_swdio;
     DAP_PINS.SWDIO_OUTPUT = 1ul << (((pin_swdio & GPIO_PIN_INDEX_MASK) >> GPIO_PIN_INDEX_SHIFT) * 2);
+    DAP_PINS.SWDIO_SHIFT = ((pin_swdio & GPIO_PIN_INDEX_MASK) >> GPIO_PIN_INDEX_SHIFT);
 
     DAP_Setup();
 }
 
+void stm32l4_usbd_dap_swo_initialize(unsigned int instance, uint16_t pin_swo, unsigned int priority)
+{
+    SWO_Setup(instance, pin_swo, priority);
+}
+
 static void stm32l4_usbd_dap_routine(void)
 {
     uint32_t rx_read, rx_index, rx_queue, tx_write, tx_index, status;
@@ -226,8 +232,6 @@ static void stm32l4_usbd_dap_tx_done(void)
     {
 	stm32l4_usbd_dap_device.tx_busy = 0;
     }
-
-    stm32l4_usbd_dap_device.tx_busy = 0;
 }
 
 const USBD_HID_ItfTypeDef stm32l4_usbd_dap_interface = {
@@ -27,6 +27,7 @@
  */
 
 #include <stdio.h>
+#include <string.h>
 #include "stm32l4xx.h"
 
 #include "armv7m.h"
@@ -38,6 +39,10 @@ typedef struct _stm32l4_usbd_hid_device_t {
     struct _USBD_HandleTypeDef     *USBD;
     uint8_t                        tx_data[64];
     volatile uint8_t               tx_busy;
+    volatile uint8_t               queue_read;
+    volatile uint8_t               queue_write;
+    uint8_t                        queue_count[USBD_HID_QUEUE_SIZE];
+    uint8_t                        queue_data[USBD_HID_QUEUE_SIZE][1 + USBD_HID_REPORT_SIZE];
 } stm32l4_usbd_hid_device_t;
 
 static stm32l4_usbd_hid_device_t stm32l4_usbd_hid_device;
@@ -46,11 +51,15 @@ static void stm32l4_usbd_hid_init(USBD_HandleTypeDef *USBD)
 {
     stm32l4_usbd_hid_device.USBD = USBD;
     stm32l4_usbd_hid_device.tx_busy = 0;
+    stm32l4_usbd_hid_device.queue_read = 0;
+    stm32l4_usbd_hid_device.queue_write = 0;
 }
 
 static void stm32l4_usbd_hid_deinit(void)
 {
     stm32l4_usbd_hid_device.tx_busy = 0;
+    stm32l4_usbd_hid_device.queue_read = 0;
+    stm32l4_usbd_hid_device.queue_write = 0;
 
     stm32l4_usbd_hid_device.USBD = NULL;
 }
@@ -68,9 +77,28 @@ static void stm32l4_usbd_hid_rx_ready(const uint8_t *data, uint32_t length)
 {
 }
 
+/* Called from the USB interrupt. The next queued report (if any) goes out right away, so the
+ * host sees one report per polling interval while the queue drains. "tx_busy" stays set till
+ * the queue is empty.
+ */
 static void stm32l4_usbd_hid_tx_done(void)
 {
-    stm32l4_usbd_hid_device.tx_busy = 0;
+    unsigned int index;
+
+    if (stm32l4_usbd_hid_device.queue_read != stm32l4_usbd_hid_device.queue_write)
+    {
+	index = stm32l4_usbd_hid_device.queue_read & (USBD_HID_QUEUE_SIZE -1);
+
+	memcpy(&stm32l4_usbd_hid_device.tx_data[0], &stm32l4_usbd_hid_device.queue_data[index][0], stm32l4_usbd_hid_device.queue_count[index]);
+
+	stm32l4_usbd_hid_device.queue_read++;
+
+	USBD_HID_SendReport(stm32l4_usbd_hid_device.USBD, &stm32l4_usbd_hid_device.tx_data[0], stm32l4_usbd_hid_device.queue_count[index]);
+    }
+    else
+    {
+	stm32l4_usbd_hid_device.tx_busy = 0;
+    }
 }
 
 const USBD_HID_ItfTypeDef stm32l4_usbd_hid_interface = {
@@ -106,6 +134,73 @@ void stm32l4_usbd_hid_send_report(uint8_t id, const uint8_t *data, uint32_t coun
     }
 }
 
+bool stm32l4_usbd_hid_queue_report(uint8_t id, const uint8_t *data, uint32_t count, stm32l4_usbd_hid_merge_t merge)
+{
+    unsigned int index;
+    bool success = true;
+
+    if (count > USBD_HID_REPORT_SIZE)
+    {
+	return true;
+    }
+
+#if defined(STM32L476xx) || defined(STM32L496xx)
+    NVIC_DisableIRQ(OTG_FS_IRQn);
+#else
+    NVIC_DisableIRQ(USB_IRQn);
+#endif
+
+    if (stm32l4_usbd_hid_device.USBD)
+    {
+	if (!stm32l4_usbd_hid_device.tx_busy)
+	{
+	    stm32l4_usbd_hid_device.tx_data[0] = id;
+	    memcpy(&stm32l4_usbd_hid_device.tx_data[1], data, count);
+	
+	    stm32l4_usbd_hid_device.tx_busy = 1;
+
+	    USBD_HID_SendReport(stm32l4_usbd_hid_device.USBD, &stm32l4_usbd_hid_device.tx_data[0], count+1);
+	}
+	else
+	{
+	    /* Only the last queued report can be merged into, as the ones before it have to be
+	     * seen by the host in order.
+	     */
+	    index = (stm32l4_usbd_hid_device.queue_write -1) & (USBD_HID_QUEUE_SIZE -1);
+
+	    if (!merge ||
+		(stm32l4_usbd_hid_device.queue_read == stm32l4_usbd_hid_device.queue_write) ||
+		(stm32l4_usbd_hid_device.queue_data[index][0] != id) ||
+		(stm32l4_usbd_hid_device.queue_count[index] != (count+1)) ||
+		!(*merge)(&stm32l4_usbd_hid_device.queue_data[index][1], data, count))
+	    {
+		if ((uint8_t)(stm32l4_usbd_hid_device.queue_write - stm32l4_usbd_hid_device.queue_read) != USBD_HID_QUEUE_SIZE)
+		{
+		    index = stm32l4_usbd_hid_device.queue_write & (USBD_HID_QUEUE_SIZE -1);
+
+		    stm32l4_usbd_hid_device.queue_data[index][0] = id;
+		    memcpy(&stm32l4_usbd_hid_device.queue_data[index][1], data, count);
+		    stm32l4_usbd_hid_device.queue_count[index] = count+1;
+
+		    stm32l4_usbd_hid_device.queue_write++;
+		}
+		else
+		{
+		    success = false;
+		}
+	    }
+	}
+    }
+
+#if defined(STM32L476xx) || defined(STM32L496xx)
+    NVIC_EnableIRQ(OTG_FS_IRQn);
+#else
+    NVIC_EnableIRQ(USB_IRQn);
+#endif
+
+    return success;
+}
+
 bool stm32l4_usbd_hid_done()
 {
     return !stm32l4_usbd_hid_device.tx_busy;
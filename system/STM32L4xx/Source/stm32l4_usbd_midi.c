@@ -0,0 +1,311 @@
+/*
+ * Copyright (c) 2017 Thomas Roell.  All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal with the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ *  1. Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimers.
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimers in the
+ *     documentation and/or other materials provided with the distribution.
+ *  3. Neither the name of Thomas Roell, nor the names of its contributors
+ *     may be used to endorse or promote products derived from this Software
+ *     without specific prior written permission.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ * CONTRIBUTORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * WITH THE SOFTWARE.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include "stm32l4xx.h"
+
+#include "armv7m.h"
+#include "stm32l4_usbd_midi.h"
+#include "usbd_midi.h"
+
+#if (USBD_MIDI_PACKET_EVENTS != (MIDI_PACKET_SIZE / 4))
+#error "stm32l4_usbd_midi.h does not match usbd_midi.h"
+#endif
+
+/* Both queues use free running indices. The receive queue is filled by the USB
+ * interrupt and drained by stm32l4_usbd_midi_receive(), the transmit queue is
+ * filled by stm32l4_usbd_midi_transmit() and drained by the USB interrupt.
+ */
+typedef struct _stm32l4_usbd_midi_device_t {
+    struct _USBD_HandleTypeDef     *USBD;
+    stm32l4_usbd_midi_callback_t   callback;
+    void                           *context;
+    uint32_t                       events;
+    volatile uint8_t               rx_hold;
+    volatile uint32_t              rx_read;
+    volatile uint32_t              rx_write;
+    volatile uint32_t              tx_read;
+    volatile uint32_t              tx_write;
+    uint32_t                       rx_data[USBD_MIDI_QUEUE_SIZE];
+    uint32_t                       tx_data[USBD_MIDI_QUEUE_SIZE];
+} stm32l4_usbd_midi_device_t;
+
+static stm32l4_usbd_midi_device_t stm32l4_usbd_midi_device;
+
+static void stm32l4_usbd_midi_send(void)
+{
+    uint32_t tx_read, count, index, data[USBD_MIDI_PACKET_EVENTS];
+
+    tx_read = stm32l4_usbd_midi_device.tx_read;
+    count = stm32l4_usbd_midi_device.tx_write - tx_read;
+
+    if (count)
+    {
+	if (count > USBD_MIDI_PACKET_EVENTS)
+	{
+	    count = USBD_MIDI_PACKET_EVENTS;
+	}
+
+	for (index = 0; index < count; index++)
+	{
+	    data[index] = stm32l4_usbd_midi_device.tx_data[(tx_read + index) & (USBD_MIDI_QUEUE_SIZE -1)];
+	}
+
+	if (USBD_MIDI_TransmitPacket(stm32l4_usbd_midi_device.USBD, (const uint8_t*)&data[0], count * 4) == USBD_OK)
+	{
+	    stm32l4_usbd_midi_device.tx_read = tx_read + count;
+
+	    if (stm32l4_usbd_midi_device.events & USBD_MIDI_EVENT_TRANSMIT)
+	    {
+		(*stm32l4_usbd_midi_device.callback)(stm32l4_usbd_midi_device.context, USBD_MIDI_EVENT_TRANSMIT);
+	    }
+	}
+    }
+}
+
+static void stm32l4_usbd_midi_init(USBD_HandleTypeDef *USBD)
+{
+    stm32l4_usbd_midi_device.USBD = USBD;
+    stm32l4_usbd_midi_device.rx_hold = 0;
+}
+
+static void stm32l4_usbd_midi_deinit(void)
+{
+    stm32l4_usbd_midi_device.USBD = NULL;
+}
+
+/* Zero events are padding, and are dropped. If there is no room for another full packet
+ * the endpoint stays NAKed till stm32l4_usbd_midi_receive() has made room.
+ */
+static uint8_t stm32l4_usbd_midi_packet(uint8_t *data, uint32_t count)
+{
+    uint32_t rx_write, index, event;
+
+    rx_write = stm32l4_usbd_midi_device.rx_write;
+
+    for (index = 0; index < (count / 4); index++)
+    {
+	event = ((const uint32_t*)data)[index];
+
+	if (event && ((rx_write - stm32l4_usbd_midi_device.rx_read) != USBD_MIDI_QUEUE_SIZE))
+	{
+	    stm32l4_usbd_midi_device.rx_data[rx_write & (USBD_MIDI_QUEUE_SIZE -1)] = event;
+
+	    rx_write++;
+	}
+    }
+
+    stm32l4_usbd_midi_device.rx_write = rx_write;
+
+    if (stm32l4_usbd_midi_device.events & USBD_MIDI_EVENT_RECEIVE)
+    {
+	(*stm32l4_usbd_midi_device.callback)(stm32l4_usbd_midi_device.context, USBD_MIDI_EVENT_RECEIVE);
+    }
+
+    if ((USBD_MIDI_QUEUE_SIZE - (stm32l4_usbd_midi_device.rx_write - stm32l4_usbd_midi_device.rx_read)) < USBD_MIDI_PACKET_EVENTS)
+    {
+	stm32l4_usbd_midi_device.rx_hold = 1;
+
+	return 0;
+    }
+
+    return 1;
+}
+
+/* A full packet goes out right away, anything less waits for the next SOF.
+ */
+static void stm32l4_usbd_midi_tx_done(void)
+{
+    if ((stm32l4_usbd_midi_device.tx_write - stm32l4_usbd_midi_device.tx_read) >= USBD_MIDI_PACKET_EVENTS)
+    {
+	stm32l4_usbd_midi_send();
+    }
+}
+
+static void stm32l4_usbd_midi_sof(void)
+{
+    stm32l4_usbd_midi_send();
+}
+
+const USBD_MIDI_ItfTypeDef stm32l4_usbd_midi_interface = {
+    stm32l4_usbd_midi_init,
+    stm32l4_usbd_midi_deinit,
+    stm32l4_usbd_midi_packet,
+    stm32l4_usbd_midi_tx_done,
+    stm32l4_usbd_midi_sof,
+};
+
+bool stm32l4_usbd_midi_enable(stm32l4_usbd_midi_callback_t callback, void *context, uint32_t events)
+{
+    if (stm32l4_usbd_midi_device.callback)
+    {
+	return false;
+    }
+
+#if defined(STM32L476xx) || defined(STM32L496xx)
+    NVIC_DisableIRQ(OTG_FS_IRQn);
+#else
+    NVIC_DisableIRQ(USB_IRQn);
+#endif
+
+    stm32l4_usbd_midi_device.callback = callback;
+    stm32l4_usbd_midi_device.context = context;
+    stm32l4_usbd_midi_device.events = callback ? events : 0;
+
+#if defined(STM32L476xx) || defined(STM32L496xx)
+    NVIC_EnableIRQ(OTG_FS_IRQn);
+#else
+    NVIC_EnableIRQ(USB_IRQn);
+#endif
+
+    return true;
+}
+
+void stm32l4_usbd_midi_disable(void)
+{
+#if defined(STM32L476xx) || defined(STM32L496xx)
+    NVIC_DisableIRQ(OTG_FS_IRQn);
+#else
+    NVIC_DisableIRQ(USB_IRQn);
+#endif
+
+    stm32l4_usbd_midi_device.callback = NULL;
+    stm32l4_usbd_midi_device.context = NULL;
+    stm32l4_usbd_midi_device.events = 0;
+
+#if defined(STM32L476xx) || defined(STM32L496xx)
+    NVIC_EnableIRQ(OTG_FS_IRQn);
+#else
+    NVIC_EnableIRQ(USB_IRQn);
+#endif
+}
+
+bool stm32l4_usbd_midi_connected(void)
+{
+    return (stm32l4_usbd_midi_device.USBD != NULL);
+}
+
+unsigned int stm32l4_usbd_midi_count(void)
+{
+    return (stm32l4_usbd_midi_device.rx_write - stm32l4_usbd_midi_device.rx_read);
+}
+
+unsigned int stm32l4_usbd_midi_receive(uint32_t *data, unsigned int count)
+{
+    uint32_t rx_read, rx_write, index;
+
+    rx_read = stm32l4_usbd_midi_device.rx_read;
+    rx_write = stm32l4_usbd_midi_device.rx_write;
+
+    if (count > (rx_write - rx_read))
+    {
+	count = (rx_write - rx_read);
+    }
+
+    for (index = 0; index < count; index++)
+    {
+	data[index] = stm32l4_usbd_midi_device.rx_data[(rx_read + index) & (USBD_MIDI_QUEUE_SIZE -1)];
+    }
+
+    stm32l4_usbd_midi_device.rx_read = rx_read + count;
+
+    if (stm32l4_usbd_midi_device.rx_hold && ((USBD_MIDI_QUEUE_SIZE - (rx_write - (rx_read + count))) >= USBD_MIDI_PACKET_EVENTS))
+    {
+#if defined(STM32L476xx) || defined(STM32L496xx)
+	NVIC_DisableIRQ(OTG_FS_IRQn);
+#else
+	NVIC_DisableIRQ(USB_IRQn);
+#endif
+
+	if (stm32l4_usbd_midi_device.rx_hold)
+	{
+	    stm32l4_usbd_midi_device.rx_hold = 0;
+
+	    if (stm32l4_usbd_midi_device.USBD)
+	    {
+		USBD_MIDI_ReceivePacket(stm32l4_usbd_midi_device.USBD);
+	    }
+	}
+
+#if defined(STM32L476xx) || defined(STM32L496xx)
+	NVIC_EnableIRQ(OTG_FS_IRQn);
+#else
+	NVIC_EnableIRQ(USB_IRQn);
+#endif
+    }
+
+    return count;
+}
+
+unsigned int stm32l4_usbd_midi_space(void)
+{
+    return (USBD_MIDI_QUEUE_SIZE - (stm32l4_usbd_midi_device.tx_write - stm32l4_usbd_midi_device.tx_read));
+}
+
+unsigned int stm32l4_usbd_midi_transmit(const uint32_t *data, unsigned int count)
+{
+    uint32_t tx_read, tx_write, index;
+
+    tx_read = stm32l4_usbd_midi_device.tx_read;
+    tx_write = stm32l4_usbd_midi_device.tx_write;
+
+    if (count > (USBD_MIDI_QUEUE_SIZE - (tx_write - tx_read)))
+    {
+	count = (USBD_MIDI_QUEUE_SIZE - (tx_write - tx_read));
+    }
+
+    for (index = 0; index < count; index++)
+    {
+	stm32l4_usbd_midi_device.tx_data[(tx_write + index) & (USBD_MIDI_QUEUE_SIZE -1)] = data[index];
+    }
+
+    stm32l4_usbd_midi_device.tx_write = tx_write + count;
+
+    return count;
+}
+
+void stm32l4_usbd_midi_flush(void)
+{
+#if defined(STM32L476xx) || defined(STM32L496xx)
+    NVIC_DisableIRQ(OTG_FS_IRQn);
+#else
+    NVIC_DisableIRQ(USB_IRQn);
+#endif
+
+    if (stm32l4_usbd_midi_device.USBD)
+    {
+	stm32l4_usbd_midi_send();
+    }
+
+#if defined(STM32L476xx) || defined(STM32L496xx)
+    NVIC_EnableIRQ(OTG_FS_IRQn);
+#else
+    NVIC_EnableIRQ(USB_IRQn);
+#endif
+}
@@ -42,87 +42,87 @@
 extern const PinDescription g_APinDescription[] =
 {
   // 0, Data1 / ID
-  { GPIOA, GPIO_PIN_MASK(GPIO_PIN_PA7),  GPIO_PIN_PA7_TIM1_CH1N,   (PIN_ATTR_ADC | PIN_ATTR_EXTI | PIN_ATTR_PWM),   PWM_INSTANCE_TIM1,  PWM_CHANNEL_1, ADC_INPUT_12    },
+  { GPIO_PIN_PA7_TIM1_CH1N,  GPIO_PIN_MASK(GPIO_PIN_PA7),  (PIN_ATTR_ADC | PIN_ATTR_EXTI | PIN_ATTR_PWM),   PWM_INSTANCE_TIM1,  PWM_CHANNEL_1, ADC_INPUT_12    },
   // 1, Join PA7 (data1/ID) 
-  { GPIOA, GPIO_PIN_MASK(GPIO_PIN_PA6),  GPIO_PIN_PA6,             (PIN_ATTR_ADC | PIN_ATTR_EXTI),                  PWM_INSTANCE_NONE,  PWM_CHANNEL_NONE, ADC_INPUT_11    },
+  { GPIO_PIN_PA6,            GPIO_PIN_MASK(GPIO_PIN_PA6),  (PIN_ATTR_ADC | PIN_ATTR_EXTI),                  PWM_INSTANCE_NONE,  PWM_CHANNEL_NONE, ADC_INPUT_11    },
   
   // 2, data2 (joined with PB4), WS2811, uart1 tx
-  { GPIOA, GPIO_PIN_MASK(GPIO_PIN_PA9),  GPIO_PIN_PA9_TIM1_CH2,    (PIN_ATTR_EXTI | PIN_ATTR_PWM),                   PWM_INSTANCE_TIM1,  PWM_CHANNEL_2, ADC_INPUT_NONE },
+  { GPIO_PIN_PA9_TIM1_CH2,   GPIO_PIN_MASK(GPIO_PIN_PA9),  (PIN_ATTR_EXTI | PIN_ATTR_PWM),                   PWM_INSTANCE_TIM1,  PWM_CHANNEL_2, ADC_INPUT_NONE },
   // 3, Join with PA9 (data2), spi1 miso, uart1 cts
-  { GPIOB, GPIO_PIN_MASK(GPIO_PIN_PB4),  GPIO_PIN_PB4,             (PIN_ATTR_EXTI),                                 PWM_INSTANCE_NONE,  PWM_CHANNEL_NONE, ADC_INPUT_NONE },
+  { GPIO_PIN_PB4,            GPIO_PIN_MASK(GPIO_PIN_PB4),  (PIN_ATTR_EXTI),                                 PWM_INSTANCE_NONE,  PWM_CHANNEL_NONE, ADC_INPUT_NONE },
 
   // 4, data3 (joined with PB5), WS2811, uart1 rx
-  { GPIOA, GPIO_PIN_MASK(GPIO_PIN_PA10), GPIO_PIN_PA10_TIM1_CH3,   (PIN_ATTR_EXTI | PIN_ATTR_PWM),                   PWM_INSTANCE_TIM1,  PWM_CHANNEL_3, ADC_INPUT_NONE },
+  { GPIO_PIN_PA10_TIM1_CH3,  GPIO_PIN_MASK(GPIO_PIN_PA10), (PIN_ATTR_EXTI | PIN_ATTR_PWM),                   PWM_INSTANCE_TIM1,  PWM_CHANNEL_3, ADC_INPUT_NONE },
   // 5, Join PA10 (data3), spi1 mosi, sai sd b
-  { GPIOB, GPIO_PIN_MASK(GPIO_PIN_PB5),  GPIO_PIN_PB5,             (PIN_ATTR_EXTI),                                 PWM_INSTANCE_NONE,  PWM_CHANNEL_NONE, ADC_INPUT_NONE },
+  { GPIO_PIN_PB5,            GPIO_PIN_MASK(GPIO_PIN_PB5),  (PIN_ATTR_EXTI),                                 PWM_INSTANCE_NONE,  PWM_CHANNEL_NONE, ADC_INPUT_NONE },
 
   // 6, neopixels 4
-  { GPIOA, GPIO_PIN_MASK(GPIO_PIN_PA4),  GPIO_PIN_PA4,             (PIN_ATTR_ADC | PIN_ATTR_DAC | PIN_ATTR_EXTI),   PWM_INSTANCE_NONE,  PWM_CHANNEL_NONE, ADC_INPUT_9    },
+  { GPIO_PIN_PA4,            GPIO_PIN_MASK(GPIO_PIN_PA4),  (PIN_ATTR_ADC | PIN_ATTR_DAC | PIN_ATTR_EXTI),   PWM_INSTANCE_NONE,  PWM_CHANNEL_NONE, ADC_INPUT_9    },
 
   // 7, Free 1, WS2811, spi1 sck, sai sck b, uart 1 rts
-  { GPIOB, GPIO_PIN_MASK(GPIO_PIN_PB3),  GPIO_PIN_PB3_TIM2_CH2,    (PIN_ATTR_PWM | PIN_ATTR_EXTI),                  PWM_INSTANCE_TIM2,  PWM_CHANNEL_2,    ADC_INPUT_NONE },
+  { GPIO_PIN_PB3_TIM2_CH2,   GPIO_PIN_MASK(GPIO_PIN_PB3),  (PIN_ATTR_PWM | PIN_ATTR_EXTI),                  PWM_INSTANCE_TIM2,  PWM_CHANNEL_2,    ADC_INPUT_NONE },
   // 8, FREE 2, WS2811, PWM, spi2 sck, uart3 tx, i2c4 scl
-  { GPIOB, GPIO_PIN_MASK(GPIO_PIN_PB10), GPIO_PIN_PB10_TIM2_CH3,   (PIN_ATTR_PWM | PIN_ATTR_EXTI),                  PWM_INSTANCE_TIM2,  PWM_CHANNEL_3,    ADC_INPUT_NONE },
+  { GPIO_PIN_PB10_TIM2_CH3,  GPIO_PIN_MASK(GPIO_PIN_PB10), (PIN_ATTR_PWM | PIN_ATTR_EXTI),                  PWM_INSTANCE_TIM2,  PWM_CHANNEL_3,    ADC_INPUT_NONE },
   // 9, FREE 3, joined with PC2, WS2811, PWM, uart3 rx, i2c4 scl
-  { GPIOB, GPIO_PIN_MASK(GPIO_PIN_PB11), GPIO_PIN_PB11_TIM2_CH4,   (PIN_ATTR_PWM | PIN_ATTR_EXTI),                  PWM_INSTANCE_TIM2,  PWM_CHANNEL_4,    ADC_INPUT_NONE },
+  { GPIO_PIN_PB11_TIM2_CH4,  GPIO_PIN_MASK(GPIO_PIN_PB11), (PIN_ATTR_PWM | PIN_ATTR_EXTI),                  PWM_INSTANCE_TIM2,  PWM_CHANNEL_4,    ADC_INPUT_NONE },
   // 10, join pb11 (Free 3), spi2 miso, adc
-  { GPIOC, GPIO_PIN_MASK(GPIO_PIN_PC2),  GPIO_PIN_PC2,            (PIN_ATTR_ADC | PIN_ATTR_EXTI),                   PWM_INSTANCE_NONE,  PWM_CHANNEL_NONE, ADC_INPUT_3 },
+  { GPIO_PIN_PC2,            GPIO_PIN_MASK(GPIO_PIN_PC2),  (PIN_ATTR_ADC | PIN_ATTR_EXTI),                   PWM_INSTANCE_NONE,  PWM_CHANNEL_NONE, ADC_INPUT_3 },
 
   // 11, Button 1 (POW), joined with PC5, i2c2 sda
-  { GPIOB, GPIO_PIN_MASK(GPIO_PIN_PB14), GPIO_PIN_PB14,            (PIN_ATTR_EXTI),                                 PWM_INSTANCE_NONE,  PWM_CHANNEL_NONE, ADC_INPUT_NONE },
+  { GPIO_PIN_PB14,           GPIO_PIN_MASK(GPIO_PIN_PB14), (PIN_ATTR_EXTI),                                 PWM_INSTANCE_NONE,  PWM_CHANNEL_NONE, ADC_INPUT_NONE },
   // 12, Join PB14 (Button 1), adc, wkup
-  { GPIOC, GPIO_PIN_MASK(GPIO_PIN_PC5),  GPIO_PIN_PC5,            (PIN_ATTR_ADC | PIN_ATTR_EXTI | PIN_ATTR_WKUP5),  PWM_INSTANCE_NONE,  PWM_CHANNEL_NONE, ADC_INPUT_14 },
+  { GPIO_PIN_PC5,            GPIO_PIN_MASK(GPIO_PIN_PC5),  (PIN_ATTR_ADC | PIN_ATTR_EXTI | PIN_ATTR_WKUP5),  PWM_INSTANCE_NONE,  PWM_CHANNEL_NONE, ADC_INPUT_14 },
   // 13, Button 2 (AUX), joined with PA2, i2c2 scl
-  { GPIOB, GPIO_PIN_MASK(GPIO_PIN_PB13), GPIO_PIN_PB13,            (PIN_ATTR_EXTI),                                 PWM_INSTANCE_NONE,  PWM_CHANNEL_NONE, ADC_INPUT_NONE },
+  { GPIO_PIN_PB13,           GPIO_PIN_MASK(GPIO_PIN_PB13), (PIN_ATTR_EXTI),                                 PWM_INSTANCE_NONE,  PWM_CHANNEL_NONE, ADC_INPUT_NONE },
   // 14, Joined to PB13 (Button 2), adc, wkup
-  { GPIOA, GPIO_PIN_MASK(GPIO_PIN_PA2),  GPIO_PIN_PA2_TIM2_CH3,    (PIN_ATTR_PWM | PIN_ATTR_EXTI | PIN_ATTR_WKUP4), PWM_INSTANCE_TIM2,  PWM_CHANNEL_3,    ADC_INPUT_7 },
+  { GPIO_PIN_PA2_TIM2_CH3,   GPIO_PIN_MASK(GPIO_PIN_PA2),  (PIN_ATTR_PWM | PIN_ATTR_EXTI | PIN_ATTR_WKUP4), PWM_INSTANCE_TIM2,  PWM_CHANNEL_3,    ADC_INPUT_7 },
   // 15, Button 3 (AUX2), spi2 mosi
-  { GPIOB, GPIO_PIN_MASK(GPIO_PIN_PB15), GPIO_PIN_PB15_TIM15_CH2,  (PIN_ATTR_PWM | PIN_ATTR_EXTI),                  PWM_INSTANCE_TIM15, PWM_CHANNEL_2,    ADC_INPUT_NONE },
+  { GPIO_PIN_PB15_TIM15_CH2, GPIO_PIN_MASK(GPIO_PIN_PB15), (PIN_ATTR_PWM | PIN_ATTR_EXTI),                  PWM_INSTANCE_TIM15, PWM_CHANNEL_2,    ADC_INPUT_NONE },
 
   // 16, RX, i2c3 scl, adc
-  { GPIOC, GPIO_PIN_MASK(GPIO_PIN_PC0),  GPIO_PIN_PC0,            (PIN_ATTR_ADC | PIN_ATTR_EXTI),                   PWM_INSTANCE_NONE,  PWM_CHANNEL_NONE, ADC_INPUT_1 },
+  { GPIO_PIN_PC0,            GPIO_PIN_MASK(GPIO_PIN_PC0),  (PIN_ATTR_ADC | PIN_ATTR_EXTI),                   PWM_INSTANCE_NONE,  PWM_CHANNEL_NONE, ADC_INPUT_1 },
   // 17, TX, i2c3 sda, adc
-  { GPIOC, GPIO_PIN_MASK(GPIO_PIN_PC1),  GPIO_PIN_PC1,            (PIN_ATTR_ADC | PIN_ATTR_EXTI),                   PWM_INSTANCE_NONE,  PWM_CHANNEL_NONE, ADC_INPUT_2 },
+  { GPIO_PIN_PC1,            GPIO_PIN_MASK(GPIO_PIN_PC1),  (PIN_ATTR_ADC | PIN_ATTR_EXTI),                   PWM_INSTANCE_NONE,  PWM_CHANNEL_NONE, ADC_INPUT_2 },
 
   // 18, I2C SDA
-  { GPIOB, GPIO_PIN_MASK(GPIO_PIN_PB7),  GPIO_PIN_PB7,             (PIN_ATTR_EXTI),                                 PWM_INSTANCE_NONE,  PWM_CHANNEL_NONE, ADC_INPUT_NONE },
+  { GPIO_PIN_PB7,            GPIO_PIN_MASK(GPIO_PIN_PB7),  (PIN_ATTR_EXTI),                                 PWM_INSTANCE_NONE,  PWM_CHANNEL_NONE, ADC_INPUT_NONE },
   // 19, I2C SCL
-  { GPIOB, GPIO_PIN_MASK(GPIO_PIN_PB8),  GPIO_PIN_PB8,             PIN_ATTR_EXTI,                                   PWM_INSTANCE_NONE, PWM_CHANNEL_1, ADC_INPUT_NONE    },
+  { GPIO_PIN_PB8,            GPIO_PIN_MASK(GPIO_PIN_PB8),  PIN_ATTR_EXTI,                                   PWM_INSTANCE_NONE, PWM_CHANNEL_1, ADC_INPUT_NONE    },
 
   // 20, LED Channel 1
-  { GPIOA, GPIO_PIN_MASK(GPIO_PIN_PA1),  GPIO_PIN_PA1_TIM15_CH1N,  (PIN_ATTR_PWM | PIN_ATTR_EXTI),                  PWM_INSTANCE_TIM15, PWM_CHANNEL_1,    ADC_INPUT_NONE },
+  { GPIO_PIN_PA1_TIM15_CH1N, GPIO_PIN_MASK(GPIO_PIN_PA1),  (PIN_ATTR_PWM | PIN_ATTR_EXTI),                  PWM_INSTANCE_TIM15, PWM_CHANNEL_1,    ADC_INPUT_NONE },
   // 21, LED Channel 2
-  { GPIOB, GPIO_PIN_MASK(GPIO_PIN_PB1),  GPIO_PIN_PB1_TIM3_CH4,    (PIN_ATTR_ADC | PIN_ATTR_PWM | PIN_ATTR_EXTI),   PWM_INSTANCE_TIM3,  PWM_CHANNEL_4,    ADC_INPUT_16   },
+  { GPIO_PIN_PB1_TIM3_CH4,   GPIO_PIN_MASK(GPIO_PIN_PB1),  (PIN_ATTR_ADC | PIN_ATTR_PWM | PIN_ATTR_EXTI),   PWM_INSTANCE_TIM3,  PWM_CHANNEL_4,    ADC_INPUT_16   },
   // 22, LED Channel 3
-  { GPIOC, GPIO_PIN_MASK(GPIO_PIN_PC7),  GPIO_PIN_PC7_TIM3_CH2,   (PIN_ATTR_PWM | PIN_ATTR_EXTI),                   PWM_INSTANCE_TIM3,  PWM_CHANNEL_2, ADC_INPUT_NONE },
+  { GPIO_PIN_PC7_TIM3_CH2,   GPIO_PIN_MASK(GPIO_PIN_PC7),  (PIN_ATTR_PWM | PIN_ATTR_EXTI),                   PWM_INSTANCE_TIM3,  PWM_CHANNEL_2, ADC_INPUT_NONE },
   // 23, LED Channel 4
-  { GPIOB, GPIO_PIN_MASK(GPIO_PIN_PB6),  GPIO_PIN_PB6_TIM16_CH1N,  (PIN_ATTR_PWM | PIN_ATTR_EXTI),                  PWM_INSTANCE_TIM16, PWM_CHANNEL_1, ADC_INPUT_NONE },
+  { GPIO_PIN_PB6_TIM16_CH1N, GPIO_PIN_MASK(GPIO_PIN_PB6),  (PIN_ATTR_PWM | PIN_ATTR_EXTI),                  PWM_INSTANCE_TIM16, PWM_CHANNEL_1, ADC_INPUT_NONE },
   // 24, LED Channel 5
-  { GPIOC, GPIO_PIN_MASK(GPIO_PIN_PC6),  GPIO_PIN_PC6_TIM3_CH1,   (PIN_ATTR_PWM | PIN_ATTR_EXTI),                   PWM_INSTANCE_TIM3,  PWM_CHANNEL_1, ADC_INPUT_NONE },
+  { GPIO_PIN_PC6_TIM3_CH1,   GPIO_PIN_MASK(GPIO_PIN_PC6),  (PIN_ATTR_PWM | PIN_ATTR_EXTI),                   PWM_INSTANCE_TIM3,  PWM_CHANNEL_1, ADC_INPUT_NONE },
   // 25, LED Channel 6
-  { GPIOB, GPIO_PIN_MASK(GPIO_PIN_PB0),  GPIO_PIN_PB0_TIM3_CH3,   (PIN_ATTR_ADC | PIN_ATTR_PWM | PIN_ATTR_EXTI),    PWM_INSTANCE_TIM3,  PWM_CHANNEL_3,    ADC_INPUT_15   },
+  { GPIO_PIN_PB0_TIM3_CH3,   GPIO_PIN_MASK(GPIO_PIN_PB0),  (PIN_ATTR_ADC | PIN_ATTR_PWM | PIN_ATTR_EXTI),    PWM_INSTANCE_TIM3,  PWM_CHANNEL_3,    ADC_INPUT_15   },
 
   // 26, Onboard LED
-  { GPIOA, GPIO_PIN_MASK(GPIO_PIN_PA15), GPIO_PIN_PA15_TIM2_CH1,   (PIN_ATTR_EXTI | PIN_ATTR_PWM),                  PWM_INSTANCE_TIM2,  PWM_CHANNEL_1,    ADC_INPUT_NONE },
+  { GPIO_PIN_PA15_TIM2_CH1,  GPIO_PIN_MASK(GPIO_PIN_PA15), (PIN_ATTR_EXTI | PIN_ATTR_PWM),                  PWM_INSTANCE_TIM2,  PWM_CHANNEL_1,    ADC_INPUT_NONE },
 
   // 27, detect charging  (is this really a wakeup pin?)
-  { GPIOA, GPIO_PIN_MASK(GPIO_PIN_PA0),  GPIO_PIN_PA0_TIM2_CH1,  (PIN_ATTR_ADC|PIN_ATTR_PWM|PIN_ATTR_EXTI|PIN_ATTR_WKUP1), PWM_INSTANCE_TIM2, PWM_CHANNEL_1, ADC_INPUT_5 },
+  { GPIO_PIN_PA0_TIM2_CH1,   GPIO_PIN_MASK(GPIO_PIN_PA0),  (PIN_ATTR_ADC|PIN_ATTR_PWM|PIN_ATTR_EXTI|PIN_ATTR_WKUP1), PWM_INSTANCE_TIM2, PWM_CHANNEL_1, ADC_INPUT_5 },
 
   // 28, Touch Cap
-  { GPIOB, GPIO_PIN_MASK(GPIO_PIN_PB12), GPIO_PIN_PB12,            (PIN_ATTR_EXTI),                                 PWM_INSTANCE_NONE,  PWM_CHANNEL_NONE, ADC_INPUT_NONE },
+  { GPIO_PIN_PB12,           GPIO_PIN_MASK(GPIO_PIN_PB12), (PIN_ATTR_EXTI),                                 PWM_INSTANCE_NONE,  PWM_CHANNEL_NONE, ADC_INPUT_NONE },
   
   // 29, vtest
-  { GPIOC, GPIO_PIN_MASK(GPIO_PIN_PC4),  GPIO_PIN_PC4,            (PIN_ATTR_ADC | PIN_ATTR_EXTI),                   PWM_INSTANCE_NONE,  PWM_CHANNEL_NONE, ADC_INPUT_13 },
+  { GPIO_PIN_PC4,            GPIO_PIN_MASK(GPIO_PIN_PC4),  (PIN_ATTR_ADC | PIN_ATTR_EXTI),                   PWM_INSTANCE_NONE,  PWM_CHANNEL_NONE, ADC_INPUT_13 },
 
   // 30, Motion Interrupt
-  { GPIOC, GPIO_PIN_MASK(GPIO_PIN_PC13), GPIO_PIN_PC13,           (PIN_ATTR_EXTI | PIN_ATTR_WKUP2),                 PWM_INSTANCE_NONE,  PWM_CHANNEL_NONE, ADC_INPUT_NONE },
+  { GPIO_PIN_PC13,           GPIO_PIN_MASK(GPIO_PIN_PC13), (PIN_ATTR_EXTI | PIN_ATTR_WKUP2),                 PWM_INSTANCE_NONE,  PWM_CHANNEL_NONE, ADC_INPUT_NONE },
 
   // 31, Booster Enable
-  { GPIOH, GPIO_PIN_MASK(GPIO_PIN_PH0),  GPIO_PIN_PH0,            (PIN_ATTR_EXTI),                                  PWM_INSTANCE_NONE,  PWM_CHANNEL_NONE, ADC_INPUT_NONE },
+  { GPIO_PIN_PH0,            GPIO_PIN_MASK(GPIO_PIN_PH0),  (PIN_ATTR_EXTI),                                  PWM_INSTANCE_NONE,  PWM_CHANNEL_NONE, ADC_INPUT_NONE },
   // 32, Amplifier Enable
-  { GPIOH, GPIO_PIN_MASK(GPIO_PIN_PH1),  GPIO_PIN_PH1,             0,                                               PWM_INSTANCE_NONE,  PWM_CHANNEL_NONE, ADC_INPUT_NONE },
+  { GPIO_PIN_PH1,            GPIO_PIN_MASK(GPIO_PIN_PH1),  0,                                               PWM_INSTANCE_NONE,  PWM_CHANNEL_NONE, ADC_INPUT_NONE },
   // 33, BOOT button
-  { GPIOH, GPIO_PIN_MASK(GPIO_PIN_PH3),  GPIO_PIN_PH3,             0,                                               PWM_INSTANCE_NONE,  PWM_CHANNEL_NONE, ADC_INPUT_NONE },
+  { GPIO_PIN_PH3,            GPIO_PIN_MASK(GPIO_PIN_PH3),  0,                                               PWM_INSTANCE_NONE,  PWM_CHANNEL_NONE, ADC_INPUT_NONE },
 };
 
 stm32l4_ct_assert(STM32L4_NELEM(g_APinDescription) ==  NUM_TOTAL_PINS);
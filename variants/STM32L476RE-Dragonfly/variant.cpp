@@ -40,83 +40,83 @@
 extern const PinDescription g_APinDescription[NUM_TOTAL_PINS] =
 {
     // 0..13 - Digital pins
-    { GPIOC, GPIO_PIN_MASK(GPIO_PIN_PC5),  GPIO_PIN_PC5,            (PIN_ATTR_EXTI | PIN_ATTR_WKUP5),                               PWM_INSTANCE_NONE,  PWM_CHANNEL_NONE, ADC_INPUT_NONE },
-    { GPIOC, GPIO_PIN_MASK(GPIO_PIN_PC4),  GPIO_PIN_PC4,            (PIN_ATTR_EXTI),                                                PWM_INSTANCE_NONE,  PWM_CHANNEL_NONE, ADC_INPUT_NONE },
-    { GPIOB, GPIO_PIN_MASK(GPIO_PIN_PB12), GPIO_PIN_PB12,           (PIN_ATTR_EXTI),                                                PWM_INSTANCE_NONE,  PWM_CHANNEL_NONE, ADC_INPUT_NONE },
-    { GPIOB, GPIO_PIN_MASK(GPIO_PIN_PB13), GPIO_PIN_PB13_TIM1_CH1N, (PIN_ATTR_PWM | PIN_ATTR_EXTI),                                 PWM_INSTANCE_TIM1,  PWM_CHANNEL_1,    ADC_INPUT_NONE },
-    { GPIOB, GPIO_PIN_MASK(GPIO_PIN_PB14), GPIO_PIN_PB14_TIM1_CH2N, (PIN_ATTR_PWM | PIN_ATTR_EXTI),                                 PWM_INSTANCE_TIM1,  PWM_CHANNEL_2,    ADC_INPUT_NONE },
-    { GPIOB, GPIO_PIN_MASK(GPIO_PIN_PB15), GPIO_PIN_PB15_TIM1_CH3N, (PIN_ATTR_PWM | PIN_ATTR_EXTI),                                 PWM_INSTANCE_TIM1,  PWM_CHANNEL_3,    ADC_INPUT_NONE },
+    { GPIO_PIN_PC5,            GPIO_PIN_MASK(GPIO_PIN_PC5),  (PIN_ATTR_EXTI | PIN_ATTR_WKUP5),                               PWM_INSTANCE_NONE,  PWM_CHANNEL_NONE, ADC_INPUT_NONE },
+    { GPIO_PIN_PC4,            GPIO_PIN_MASK(GPIO_PIN_PC4),  (PIN_ATTR_EXTI),                                                PWM_INSTANCE_NONE,  PWM_CHANNEL_NONE, ADC_INPUT_NONE },
+    { GPIO_PIN_PB12,           GPIO_PIN_MASK(GPIO_PIN_PB12), (PIN_ATTR_EXTI),                                                PWM_INSTANCE_NONE,  PWM_CHANNEL_NONE, ADC_INPUT_NONE },
+    { GPIO_PIN_PB13_TIM1_CH1N, GPIO_PIN_MASK(GPIO_PIN_PB13), (PIN_ATTR_PWM | PIN_ATTR_EXTI),                                 PWM_INSTANCE_TIM1,  PWM_CHANNEL_1,    ADC_INPUT_NONE },
+    { GPIO_PIN_PB14_TIM1_CH2N, GPIO_PIN_MASK(GPIO_PIN_PB14), (PIN_ATTR_PWM | PIN_ATTR_EXTI),                                 PWM_INSTANCE_TIM1,  PWM_CHANNEL_2,    ADC_INPUT_NONE },
+    { GPIO_PIN_PB15_TIM1_CH3N, GPIO_PIN_MASK(GPIO_PIN_PB15), (PIN_ATTR_PWM | PIN_ATTR_EXTI),                                 PWM_INSTANCE_TIM1,  PWM_CHANNEL_3,    ADC_INPUT_NONE },
 #if (DOSFS_SDCARD >= 2)
-    { NULL,  GPIO_PIN_MASK(GPIO_PIN_PC9),  GPIO_PIN_PC9,            0,                                                              PWM_INSTANCE_NONE,  PWM_CHANNEL_NONE, ADC_INPUT_NONE },
-    { NULL,  GPIO_PIN_MASK(GPIO_PIN_PC8),  GPIO_PIN_PC8,            0,                                                              PWM_INSTANCE_NONE,  PWM_CHANNEL_NONE, ADC_INPUT_NONE },
+    { GPIO_PIN_PC9,            0,                            0,                                                              PWM_INSTANCE_NONE,  PWM_CHANNEL_NONE, ADC_INPUT_NONE },
+    { GPIO_PIN_PC8,            0,                            0,                                                              PWM_INSTANCE_NONE,  PWM_CHANNEL_NONE, ADC_INPUT_NONE },
 #else /* DOSFS_SDCARD >= 2 */
-    { GPIOC, GPIO_PIN_MASK(GPIO_PIN_PC9),  GPIO_PIN_PC9_TIM3_CH4,   (PIN_ATTR_PWM),                                                 PWM_INSTANCE_TIM3,  PWM_CHANNEL_4,    ADC_INPUT_NONE },
-    { GPIOC, GPIO_PIN_MASK(GPIO_PIN_PC8),  GPIO_PIN_PC8_TIM3_CH3,   (PIN_ATTR_PWM | PIN_ATTR_EXTI),                                 PWM_INSTANCE_TIM3,  PWM_CHANNEL_3,    ADC_INPUT_NONE },
+    { GPIO_PIN_PC9_TIM3_CH4,   GPIO_PIN_MASK(GPIO_PIN_PC9),  (PIN_ATTR_PWM),                                                 PWM_INSTANCE_TIM3,  PWM_CHANNEL_4,    ADC_INPUT_NONE },
+    { GPIO_PIN_PC8_TIM3_CH3,   GPIO_PIN_MASK(GPIO_PIN_PC8),  (PIN_ATTR_PWM | PIN_ATTR_EXTI),                                 PWM_INSTANCE_TIM3,  PWM_CHANNEL_3,    ADC_INPUT_NONE },
 #endif /* DOSFS_SDCARD >= 2 */
-    { GPIOA, GPIO_PIN_MASK(GPIO_PIN_PA3),  GPIO_PIN_PA3_TIM5_CH4,   (PIN_ATTR_ADC | PIN_ATTR_PWM | PIN_ATTR_EXTI),                  PWM_INSTANCE_TIM5,  PWM_CHANNEL_4,    ADC_INPUT_8    },
-    { GPIOA, GPIO_PIN_MASK(GPIO_PIN_PA2),  GPIO_PIN_PA2_TIM5_CH3,   (PIN_ATTR_ADC | PIN_ATTR_PWM | PIN_ATTR_EXTI | PIN_ATTR_WKUP4), PWM_INSTANCE_TIM5,  PWM_CHANNEL_3,    ADC_INPUT_7    },
+    { GPIO_PIN_PA3_TIM5_CH4,   GPIO_PIN_MASK(GPIO_PIN_PA3),  (PIN_ATTR_ADC | PIN_ATTR_PWM | PIN_ATTR_EXTI),                  PWM_INSTANCE_TIM5,  PWM_CHANNEL_4,    ADC_INPUT_8    },
+    { GPIO_PIN_PA2_TIM5_CH3,   GPIO_PIN_MASK(GPIO_PIN_PA2),  (PIN_ATTR_ADC | PIN_ATTR_PWM | PIN_ATTR_EXTI | PIN_ATTR_WKUP4), PWM_INSTANCE_TIM5,  PWM_CHANNEL_3,    ADC_INPUT_7    },
 #if (DOSFS_SDCARD >= 1)
-    { NULL,  GPIO_PIN_MASK(GPIO_PIN_PD2),  GPIO_PIN_PD2,            0,                                                              PWM_INSTANCE_NONE,  PWM_CHANNEL_NONE, ADC_INPUT_NONE },
-    { NULL,  GPIO_PIN_MASK(GPIO_PIN_PC12), GPIO_PIN_PC12,           0,                                                              PWM_INSTANCE_NONE,  PWM_CHANNEL_NONE, ADC_INPUT_NONE },
-    { NULL,  GPIO_PIN_MASK(GPIO_PIN_PC11), GPIO_PIN_PC11,           0,                                                              PWM_INSTANCE_NONE,  PWM_CHANNEL_NONE, ADC_INPUT_NONE },
-    { NULL,  GPIO_PIN_MASK(GPIO_PIN_PC10), GPIO_PIN_PC10,           0,                                                              PWM_INSTANCE_NONE,  PWM_CHANNEL_NONE, ADC_INPUT_NONE },
+    { GPIO_PIN_PD2,            0,                            0,                                                              PWM_INSTANCE_NONE,  PWM_CHANNEL_NONE, ADC_INPUT_NONE },
+    { GPIO_PIN_PC12,           0,                            0,                                                              PWM_INSTANCE_NONE,  PWM_CHANNEL_NONE, ADC_INPUT_NONE },
+    { GPIO_PIN_PC11,           0,                            0,                                                              PWM_INSTANCE_NONE,  PWM_CHANNEL_NONE, ADC_INPUT_NONE },
+    { GPIO_PIN_PC10,           0,                            0,                                                              PWM_INSTANCE_NONE,  PWM_CHANNEL_NONE, ADC_INPUT_NONE },
 #else /* DOSFS_SDCARD >= 1 */
-    { GPIOD, GPIO_PIN_MASK(GPIO_PIN_PD2),  GPIO_PIN_PD2,            (PIN_ATTR_EXTI),                                                PWM_INSTANCE_NONE,  PWM_CHANNEL_NONE, ADC_INPUT_NONE },
-    { GPIOC, GPIO_PIN_MASK(GPIO_PIN_PC12), GPIO_PIN_PC12,           (PIN_ATTR_EXTI),                                                PWM_INSTANCE_NONE,  PWM_CHANNEL_NONE, ADC_INPUT_NONE },
-    { GPIOC, GPIO_PIN_MASK(GPIO_PIN_PC11), GPIO_PIN_PC11,           (PIN_ATTR_EXTI),                                                PWM_INSTANCE_NONE,  PWM_CHANNEL_NONE, ADC_INPUT_NONE },
-    { GPIOC, GPIO_PIN_MASK(GPIO_PIN_PC10), GPIO_PIN_PC10,           (PIN_ATTR_EXTI),                                                PWM_INSTANCE_NONE,  PWM_CHANNEL_NONE, ADC_INPUT_NONE },
+    { GPIO_PIN_PD2,            GPIO_PIN_MASK(GPIO_PIN_PD2),  (PIN_ATTR_EXTI),                                                PWM_INSTANCE_NONE,  PWM_CHANNEL_NONE, ADC_INPUT_NONE },
+    { GPIO_PIN_PC12,           GPIO_PIN_MASK(GPIO_PIN_PC12), (PIN_ATTR_EXTI),                                                PWM_INSTANCE_NONE,  PWM_CHANNEL_NONE, ADC_INPUT_NONE },
+    { GPIO_PIN_PC11,           GPIO_PIN_MASK(GPIO_PIN_PC11), (PIN_ATTR_EXTI),                                                PWM_INSTANCE_NONE,  PWM_CHANNEL_NONE, ADC_INPUT_NONE },
+    { GPIO_PIN_PC10,           GPIO_PIN_MASK(GPIO_PIN_PC10), (PIN_ATTR_EXTI),                                                PWM_INSTANCE_NONE,  PWM_CHANNEL_NONE, ADC_INPUT_NONE },
 #endif /* DOSFS_SDCARD >= 1 */
 
     // 14..19 - Analog pins
-    { GPIOA, GPIO_PIN_MASK(GPIO_PIN_PA4),  GPIO_PIN_PA4,            (PIN_ATTR_ADC | PIN_ATTR_DAC | PIN_ATTR_EXTI),                  PWM_INSTANCE_NONE,  PWM_CHANNEL_NONE, ADC_INPUT_9    },
-    { GPIOA, GPIO_PIN_MASK(GPIO_PIN_PA5),  GPIO_PIN_PA5,            (PIN_ATTR_ADC | PIN_ATTR_DAC | PIN_ATTR_EXTI),                  PWM_INSTANCE_NONE,  PWM_CHANNEL_NONE, ADC_INPUT_10   },
-    { GPIOC, GPIO_PIN_MASK(GPIO_PIN_PC3),  GPIO_PIN_PC3,            (PIN_ATTR_ADC | PIN_ATTR_EXTI),                                 PWM_INSTANCE_NONE,  PWM_CHANNEL_NONE, ADC_INPUT_4    },
-    { GPIOC, GPIO_PIN_MASK(GPIO_PIN_PC2),  GPIO_PIN_PC2,            (PIN_ATTR_ADC | PIN_ATTR_EXTI),                                 PWM_INSTANCE_NONE,  PWM_CHANNEL_NONE, ADC_INPUT_3    },
-    { GPIOC, GPIO_PIN_MASK(GPIO_PIN_PC1),  GPIO_PIN_PC1,            (PIN_ATTR_ADC | PIN_ATTR_EXTI),                                 PWM_INSTANCE_NONE,  PWM_CHANNEL_NONE, ADC_INPUT_2    },
-    { GPIOC, GPIO_PIN_MASK(GPIO_PIN_PC0),  GPIO_PIN_PC0,            (PIN_ATTR_ADC | PIN_ATTR_EXTI),                                 PWM_INSTANCE_NONE,  PWM_CHANNEL_NONE, ADC_INPUT_1    },
+    { GPIO_PIN_PA4,            GPIO_PIN_MASK(GPIO_PIN_PA4),  (PIN_ATTR_ADC | PIN_ATTR_DAC | PIN_ATTR_EXTI),                  PWM_INSTANCE_NONE,  PWM_CHANNEL_NONE, ADC_INPUT_9    },
+    { GPIO_PIN_PA5,            GPIO_PIN_MASK(GPIO_PIN_PA5),  (PIN_ATTR_ADC | PIN_ATTR_DAC | PIN_ATTR_EXTI),                  PWM_INSTANCE_NONE,  PWM_CHANNEL_NONE, ADC_INPUT_10   },
+    { GPIO_PIN_PC3,            GPIO_PIN_MASK(GPIO_PIN_PC3),  (PIN_ATTR_ADC | PIN_ATTR_EXTI),                                 PWM_INSTANCE_NONE,  PWM_CHANNEL_NONE, ADC_INPUT_4    },
+    { GPIO_PIN_PC2,            GPIO_PIN_MASK(GPIO_PIN_PC2),  (PIN_ATTR_ADC | PIN_ATTR_EXTI),                                 PWM_INSTANCE_NONE,  PWM_CHANNEL_NONE, ADC_INPUT_3    },
+    { GPIO_PIN_PC1,            GPIO_PIN_MASK(GPIO_PIN_PC1),  (PIN_ATTR_ADC | PIN_ATTR_EXTI),                                 PWM_INSTANCE_NONE,  PWM_CHANNEL_NONE, ADC_INPUT_2    },
+    { GPIO_PIN_PC0,            GPIO_PIN_MASK(GPIO_PIN_PC0),  (PIN_ATTR_ADC | PIN_ATTR_EXTI),                                 PWM_INSTANCE_NONE,  PWM_CHANNEL_NONE, ADC_INPUT_1    },
 
     // 20..21 - I2C pins (SDA,SCL)
-    { GPIOB, GPIO_PIN_MASK(GPIO_PIN_PB9),  GPIO_PIN_PB9_TIM4_CH4,   (PIN_ATTR_PWM),                                                 PWM_INSTANCE_TIM4,  PWM_CHANNEL_4,    ADC_INPUT_NONE },
-    { GPIOB, GPIO_PIN_MASK(GPIO_PIN_PB8),  GPIO_PIN_PB8_TIM4_CH3,   (PIN_ATTR_PWM | PIN_ATTR_EXTI),                                 PWM_INSTANCE_TIM4,  PWM_CHANNEL_3,    ADC_INPUT_NONE },
+    { GPIO_PIN_PB9_TIM4_CH4,   GPIO_PIN_MASK(GPIO_PIN_PB9),  (PIN_ATTR_PWM),                                                 PWM_INSTANCE_TIM4,  PWM_CHANNEL_4,    ADC_INPUT_NONE },
+    { GPIO_PIN_PB8_TIM4_CH3,   GPIO_PIN_MASK(GPIO_PIN_PB8),  (PIN_ATTR_PWM | PIN_ATTR_EXTI),                                 PWM_INSTANCE_TIM4,  PWM_CHANNEL_3,    ADC_INPUT_NONE },
 
     // 22..24 - SPI/ICSP pins (MISO,MOSI,SCK)
-    { GPIOB, GPIO_PIN_MASK(GPIO_PIN_PB4),  GPIO_PIN_PB4,            (PIN_ATTR_EXTI),                                                PWM_INSTANCE_NONE,  PWM_CHANNEL_NONE, ADC_INPUT_NONE },
-    { GPIOB, GPIO_PIN_MASK(GPIO_PIN_PB5),  GPIO_PIN_PB5,            (PIN_ATTR_EXTI),                                                PWM_INSTANCE_NONE,  PWM_CHANNEL_NONE, ADC_INPUT_NONE },
-    { GPIOB, GPIO_PIN_MASK(GPIO_PIN_PB3),  GPIO_PIN_PB3,            (PIN_ATTR_EXTI),                                                PWM_INSTANCE_NONE,  PWM_CHANNEL_NONE, ADC_INPUT_NONE },
+    { GPIO_PIN_PB4,            GPIO_PIN_MASK(GPIO_PIN_PB4),  (PIN_ATTR_EXTI),                                                PWM_INSTANCE_NONE,  PWM_CHANNEL_NONE, ADC_INPUT_NONE },
+    { GPIO_PIN_PB5,            GPIO_PIN_MASK(GPIO_PIN_PB5),  (PIN_ATTR_EXTI),                                                PWM_INSTANCE_NONE,  PWM_CHANNEL_NONE, ADC_INPUT_NONE },
+    { GPIO_PIN_PB3,            GPIO_PIN_MASK(GPIO_PIN_PB3),  (PIN_ATTR_EXTI),                                                PWM_INSTANCE_NONE,  PWM_CHANNEL_NONE, ADC_INPUT_NONE },
 
     // 25..26 - RX/TX LEDS (output only)
-    { GPIOB, GPIO_PIN_MASK(GPIO_PIN_PB2),  GPIO_PIN_PB2,            0,                                                              PWM_INSTANCE_NONE,  PWM_CHANNEL_NONE, ADC_INPUT_NONE },
-    { GPIOA, GPIO_PIN_MASK(GPIO_PIN_PA10), GPIO_PIN_PA10,           0,                                                              PWM_INSTANCE_NONE,  PWM_CHANNEL_NONE, ADC_INPUT_NONE },
+    { GPIO_PIN_PB2,            GPIO_PIN_MASK(GPIO_PIN_PB2),  0,                                                              PWM_INSTANCE_NONE,  PWM_CHANNEL_NONE, ADC_INPUT_NONE },
+    { GPIO_PIN_PA10,           GPIO_PIN_MASK(GPIO_PIN_PA10), 0,                                                              PWM_INSTANCE_NONE,  PWM_CHANNEL_NONE, ADC_INPUT_NONE },
 
     // 27..29 - USB (VBUS,DM,DP)
-    { NULL,  GPIO_PIN_MASK(GPIO_PIN_PA9),  GPIO_PIN_PA9,            0,                                                              PWM_INSTANCE_NONE,  PWM_CHANNEL_NONE, ADC_INPUT_NONE },
-    { NULL,  GPIO_PIN_MASK(GPIO_PIN_PA11), GPIO_PIN_PA11,           0,                                                              PWM_INSTANCE_NONE,  PWM_CHANNEL_NONE, ADC_INPUT_NONE },
-    { NULL,  GPIO_PIN_MASK(GPIO_PIN_PA12), GPIO_PIN_PA12,           0,                                                              PWM_INSTANCE_NONE,  PWM_CHANNEL_NONE, ADC_INPUT_NONE },
+    { GPIO_PIN_PA9,            0,                            0,                                                              PWM_INSTANCE_NONE,  PWM_CHANNEL_NONE, ADC_INPUT_NONE },
+    { GPIO_PIN_PA11,           0,                            0,                                                              PWM_INSTANCE_NONE,  PWM_CHANNEL_NONE, ADC_INPUT_NONE },
+    { GPIO_PIN_PA12,           0,                            0,                                                              PWM_INSTANCE_NONE,  PWM_CHANNEL_NONE, ADC_INPUT_NONE },
 
     // 30..31 - UART pins (TX,RX)
-    { GPIOA, GPIO_PIN_MASK(GPIO_PIN_PA0),  GPIO_PIN_PA0_TIM5_CH1,   (PIN_ATTR_ADC | PIN_ATTR_PWM | PIN_ATTR_EXTI | PIN_ATTR_WKUP1), PWM_INSTANCE_TIM5,  PWM_CHANNEL_1,    ADC_INPUT_5    },
-    { GPIOA, GPIO_PIN_MASK(GPIO_PIN_PA1),  GPIO_PIN_PA1_TIM5_CH2,   (PIN_ATTR_ADC | PIN_ATTR_PWM | PIN_ATTR_EXTI),                  PWM_INSTANCE_TIM5,  PWM_CHANNEL_2,    ADC_INPUT_6    },
+    { GPIO_PIN_PA0_TIM5_CH1,   GPIO_PIN_MASK(GPIO_PIN_PA0),  (PIN_ATTR_ADC | PIN_ATTR_PWM | PIN_ATTR_EXTI | PIN_ATTR_WKUP1), PWM_INSTANCE_TIM5,  PWM_CHANNEL_1,    ADC_INPUT_5    },
+    { GPIO_PIN_PA1_TIM5_CH2,   GPIO_PIN_MASK(GPIO_PIN_PA1),  (PIN_ATTR_ADC | PIN_ATTR_PWM | PIN_ATTR_EXTI),                  PWM_INSTANCE_TIM5,  PWM_CHANNEL_2,    ADC_INPUT_6    },
 
     // 32..37 QSPI pins (NCS,CK,IO0,IO1,IO2,IO3)
-    { NULL,  GPIO_PIN_MASK(GPIO_PIN_PB11), GPIO_PIN_PB11,           0,                                                              PWM_INSTANCE_NONE,  PWM_CHANNEL_NONE, ADC_INPUT_NONE },
-    { NULL,  GPIO_PIN_MASK(GPIO_PIN_PB10), GPIO_PIN_PB10,           0,                                                              PWM_INSTANCE_NONE,  PWM_CHANNEL_NONE, ADC_INPUT_NONE },
-    { NULL,  GPIO_PIN_MASK(GPIO_PIN_PB1),  GPIO_PIN_PB1,            0,                                                              PWM_INSTANCE_NONE,  PWM_CHANNEL_NONE, ADC_INPUT_NONE },
-    { NULL,  GPIO_PIN_MASK(GPIO_PIN_PB0),  GPIO_PIN_PB0,            0,                                                              PWM_INSTANCE_NONE,  PWM_CHANNEL_NONE, ADC_INPUT_NONE },
-    { NULL,  GPIO_PIN_MASK(GPIO_PIN_PA7),  GPIO_PIN_PA7,            0,                                                              PWM_INSTANCE_NONE,  PWM_CHANNEL_NONE, ADC_INPUT_NONE },
-    { NULL,  GPIO_PIN_MASK(GPIO_PIN_PA6),  GPIO_PIN_PA6,            0,                                                              PWM_INSTANCE_NONE,  PWM_CHANNEL_NONE, ADC_INPUT_NONE },
+    { GPIO_PIN_PB11,           0,                            0,                                                              PWM_INSTANCE_NONE,  PWM_CHANNEL_NONE, ADC_INPUT_NONE },
+    { GPIO_PIN_PB10,           0,                            0,                                                              PWM_INSTANCE_NONE,  PWM_CHANNEL_NONE, ADC_INPUT_NONE },
+    { GPIO_PIN_PB1,            0,                            0,                                                              PWM_INSTANCE_NONE,  PWM_CHANNEL_NONE, ADC_INPUT_NONE },
+    { GPIO_PIN_PB0,            0,                            0,                                                              PWM_INSTANCE_NONE,  PWM_CHANNEL_NONE, ADC_INPUT_NONE },
+    { GPIO_PIN_PA7,            0,                            0,                                                              PWM_INSTANCE_NONE,  PWM_CHANNEL_NONE, ADC_INPUT_NONE },
+    { GPIO_PIN_PA6,            0,                            0,                                                              PWM_INSTANCE_NONE,  PWM_CHANNEL_NONE, ADC_INPUT_NONE },
 
     // 38..40 - Digital pins (ATN,39,40)
-    { GPIOA, GPIO_PIN_MASK(GPIO_PIN_PA8),  GPIO_PIN_PA8,            (PIN_ATTR_EXTI),                                                PWM_INSTANCE_NONE,  PWM_CHANNEL_NONE, ADC_INPUT_NONE },
-    { GPIOC, GPIO_PIN_MASK(GPIO_PIN_PC7),  GPIO_PIN_PC7_TIM3_CH2,   (PIN_ATTR_PWM | PIN_ATTR_EXTI),                                 PWM_INSTANCE_TIM3,  PWM_CHANNEL_2,    ADC_INPUT_NONE },
-    { GPIOC, GPIO_PIN_MASK(GPIO_PIN_PC6),  GPIO_PIN_PC6_TIM3_CH1,   (PIN_ATTR_PWM | PIN_ATTR_EXTI),                                 PWM_INSTANCE_TIM3,  PWM_CHANNEL_1,    ADC_INPUT_NONE },
+    { GPIO_PIN_PA8,            GPIO_PIN_MASK(GPIO_PIN_PA8),  (PIN_ATTR_EXTI),                                                PWM_INSTANCE_NONE,  PWM_CHANNEL_NONE, ADC_INPUT_NONE },
+    { GPIO_PIN_PC7_TIM3_CH2,   GPIO_PIN_MASK(GPIO_PIN_PC7),  (PIN_ATTR_PWM | PIN_ATTR_EXTI),                                 PWM_INSTANCE_TIM3,  PWM_CHANNEL_2,    ADC_INPUT_NONE },
+    { GPIO_PIN_PC6_TIM3_CH1,   GPIO_PIN_MASK(GPIO_PIN_PC6),  (PIN_ATTR_PWM | PIN_ATTR_EXTI),                                 PWM_INSTANCE_TIM3,  PWM_CHANNEL_1,    ADC_INPUT_NONE },
 
     // 41..43 - PAD pins (INT,SDA,SCL)
-    { GPIOA, GPIO_PIN_MASK(GPIO_PIN_PA15), GPIO_PIN_PA15,           (PIN_ATTR_EXTI),                                                PWM_INSTANCE_NONE,  PWM_CHANNEL_NONE, ADC_INPUT_NONE },
-    { GPIOB, GPIO_PIN_MASK(GPIO_PIN_PB7),  GPIO_PIN_PB7,            0,                                                              PWM_INSTANCE_NONE,  PWM_CHANNEL_NONE, ADC_INPUT_NONE },
-    { GPIOB, GPIO_PIN_MASK(GPIO_PIN_PB6),  GPIO_PIN_PB6,            0,                                                              PWM_INSTANCE_NONE,  PWM_CHANNEL_NONE, ADC_INPUT_NONE },
+    { GPIO_PIN_PA15,           GPIO_PIN_MASK(GPIO_PIN_PA15), (PIN_ATTR_EXTI),                                                PWM_INSTANCE_NONE,  PWM_CHANNEL_NONE, ADC_INPUT_NONE },
+    { GPIO_PIN_PB7,            GPIO_PIN_MASK(GPIO_PIN_PB7),  0,                                                              PWM_INSTANCE_NONE,  PWM_CHANNEL_NONE, ADC_INPUT_NONE },
+    { GPIO_PIN_PB6,            GPIO_PIN_MASK(GPIO_PIN_PB6),  0,                                                              PWM_INSTANCE_NONE,  PWM_CHANNEL_NONE, ADC_INPUT_NONE },
 
     // 44 - Button 
-    { GPIOC, GPIO_PIN_MASK(GPIO_PIN_PC13), GPIO_PIN_PC13,           (PIN_ATTR_EXTI | PIN_ATTR_WKUP2),                               PWM_INSTANCE_NONE,  PWM_CHANNEL_NONE, ADC_INPUT_NONE },
+    { GPIO_PIN_PC13,           GPIO_PIN_MASK(GPIO_PIN_PC13), (PIN_ATTR_EXTI | PIN_ATTR_WKUP2),                               PWM_INSTANCE_NONE,  PWM_CHANNEL_NONE, ADC_INPUT_NONE },
 };
 
 extern const unsigned int g_PWMInstances[PWM_INSTANCE_COUNT] = {